@@ -20,7 +20,14 @@
 /* No #includes allowed here */
 
 /* This header file contains configuration information for all the
- * possible cellular module types.
+ * possible cellular module types.  The same values are held, for
+ * all of the module types at once, in gModuleProfiles[] in
+ * cellular_ctrl.c so that the timings, RAT and context limits,
+ * MQTT publish limits and AT command differences can follow the
+ * module detected at power-on: if you change a value here,
+ * change it there also.  Buffer sizes and which features are
+ * built in at all are taken from here, for the module the code
+ * is built for, and do not change at run-time.
  */
 
 /* ----------------------------------------------------------------
@@ -55,6 +62,17 @@
 # define CELLULAR_CFG_BAUD_RATE                      115200
 #endif
 
+#ifndef CELLULAR_CFG_BAUD_RATE_HIGH
+/** If this is set to a baud rate higher than CELLULAR_CFG_BAUD_RATE
+ * (e.g. 460800 or 921600) then, once the module is found to be
+ * alive at power-on or after a reboot, it is asked to move to this
+ * baud rate with AT+IPR and the UART is moved to match.  If the
+ * link does not come up at the new rate both ends are returned to
+ * CELLULAR_CFG_BAUD_RATE.  Zero switches this off.
+ */
+# define CELLULAR_CFG_BAUD_RATE_HIGH                 0
+#endif
+
 /* ----------------------------------------------------------------
  * COMPILE-TIME MACROS FOR SARA-R5
  * -------------------------------------------------------------- */
@@ -86,7 +104,8 @@
  */
 # define CELLULAR_CTRL_COMMAND_MINIMUM_RESPONSE_TIME_MS 5000
 
-/** The time to wait before the cellular module is ready at boot.
+/** The maximum time to wait for the cellular module to be ready
+ * at boot; it is polled and used as soon as it responds.
  */
 # define CELLULAR_CTRL_BOOT_WAIT_TIME_MS 5000
 
@@ -105,6 +124,11 @@
  */
 # define CELLULAR_CTRL_MAX_NUM_SIMULTANEOUS_RATS 1
 
+/** The maximum number of PDP contexts that can be active at
+ * the same time, each mapped to its own internal profile.
+ */
+# define CELLULAR_CTRL_MAX_NUM_ACTIVE_CONTEXTS 4
+
 /** Supported RATs: a bitmap of the _CELLULAR_CTRL_RAT_BIT_x values
  * defined in cellular_ctrl.h, for this case
  * _CELLULAR_CTRL_RAT_BIT_CATM1 = 0x08.
@@ -115,6 +139,31 @@
  */
 # define CELLULAR_CTRL_SECURITY_ROOT_OF_TRUST 1
 
+/** Whether the module can resume TLS sessions (AT+USECPRF
+ * op code 13).
+ */
+# define CELLULAR_CTRL_SECURITY_TLS_SESSION_RESUMPTION 1
+
+/** The time to wait after the '@' prompt of AT+USOST/AT+USOWR
+ * before sending the data: the AT commands manual asks for
+ * a minimum of 50 ms.
+ */
+# ifndef CELLULAR_SOCK_PROMPT_GUARD_TIME_MS
+#  define CELLULAR_SOCK_PROMPT_GUARD_TIME_MS 50
+# endif
+
+/** Whether the module can connect a TCP socket asynchronously,
+ * AT+USOCO with a final parameter of 1, completion being
+ * indicated by the +UUSOCO URC.
+ */
+# define CELLULAR_SOCK_ASYNC_CONNECT_IS_SUPPORTED 1
+
+/** Whether the module can close a TCP socket asynchronously,
+ * AT+USOCL with a final parameter of 1, completion being
+ * indicated by the +UUSOCL URC.
+ */
+# define CELLULAR_SOCK_ASYNC_CLOSE_IS_SUPPORTED 1
+
 /** Whether MQTT is supported by the module or not.
  */
 # define CELLULAR_MQTT_IS_SUPPORTED 1
@@ -126,11 +175,29 @@
  */
 # define CELLULAR_MQTT_SERVER_RESPONSE_WAIT_SECONDS 240
 
-/** The maximum length of an MQTT publish message.
- * TODO: use '>' mode and this can be the same as
- * the publish length.
+/** Whether the module supports publishing MQTT messages
+ * in binary form, AT+UMQTTC=9 with a '>' prompt, rather
+ * than as a hex string.
+ */
+# define CELLULAR_MQTT_BINARY_PUBLISH_IS_SUPPORTED 1
+
+/** The maximum length of an MQTT publish message; this is
+ * the binary publish limit, the hex form being limited
+ * to half of this.
  */
-# define CELLULAR_MQTT_PUBLISH_MAX_LENGTH_BYTES 512
+# define CELLULAR_MQTT_PUBLISH_MAX_LENGTH_BYTES 1024
+
+/** Whether messages longer than
+ * CELLULAR_MQTT_PUBLISH_MAX_LENGTH_BYTES are published by
+ * first writing them to a file on the module with AT+UDWNFILE
+ * and then publishing that file; not needed here.
+ */
+# define CELLULAR_MQTT_PUBLISH_FILE_IS_SUPPORTED 0
+
+/** The maximum length of an MQTT publish message by any
+ * means.
+ */
+# define CELLULAR_MQTT_PUBLISH_ANY_MAX_LENGTH_BYTES CELLULAR_MQTT_PUBLISH_MAX_LENGTH_BYTES
 
 /** The maximum length of an MQTT read message.
  * TODO: check this.
@@ -142,6 +209,40 @@
  */
 # define CELLULAR_MQTT_READ_TOPIC_MAX_LENGTH_BYTES 1024
 
+/** Whether the module has a file system that can be reached
+ * through AT+UDWNFILE, AT+URDBLOCK, AT+ULSTFILE and AT+UDELFILE.
+ */
+# define CELLULAR_FS_IS_SUPPORTED 1
+
+/** The most to ask for with a single AT+URDBLOCK.  This is
+ * an upper bound, not the limit of the module: cellularFsRead()
+ * asks for less if the module gives back less, or refuses the
+ * request, and so learns the real limit at run time.
+ */
+# define CELLULAR_FS_READ_BLOCK_MAX_LENGTH_BYTES 1024
+
+/** Whether the module has an HTTP(S) client, AT+UHTTP/AT+UHTTPC.
+ */
+# define CELLULAR_HTTP_IS_SUPPORTED 1
+
+/** The time to wait for an HTTP request to complete.
+ */
+# define CELLULAR_HTTP_SERVER_RESPONSE_WAIT_SECONDS 180
+
+/** Whether the module has an MQTT-SN client, AT+UMQTTSN/AT+UMQTTSNC.
+ */
+# define CELLULAR_MQTT_SN_IS_SUPPORTED 1
+
+/** The time to wait for an MQTT-SN gateway related operation
+ * to be completed.
+ */
+# define CELLULAR_MQTT_SN_SERVER_RESPONSE_WAIT_SECONDS 240
+
+/** The maximum length of an MQTT-SN publish message, which
+ * is sent in hex form.
+ */
+# define CELLULAR_MQTT_SN_PUBLISH_MAX_LENGTH_BYTES 512
+
 #endif // CELLULAR_CFG_MODULE_SARA_R5
 
 /* ----------------------------------------------------------------
@@ -177,7 +278,8 @@
  */
 # define CELLULAR_CTRL_COMMAND_MINIMUM_RESPONSE_TIME_MS 2000
 
-/** The time to wait before the cellular module is ready at boot.
+/** The maximum time to wait for the cellular module to be ready
+ * at boot; it is polled and used as soon as it responds.
  */
 # define CELLULAR_CTRL_BOOT_WAIT_TIME_MS 6000
 
@@ -196,6 +298,11 @@
  */
 # define CELLULAR_CTRL_MAX_NUM_SIMULTANEOUS_RATS 3
 
+/** The maximum number of PDP contexts that can be active at
+ * the same time: SARA-R4 supports only one.
+ */
+# define CELLULAR_CTRL_MAX_NUM_ACTIVE_CONTEXTS 1
+
 /** Supported RATs: a bitmap of the _CELLULAR_CTRL_RAT_BIT_x values
  * defined in cellular_ctrl.h, for this case
  * _CELLULAR_CTRL_RAT_BIT_GPRS | _CELLULAR_CTRL_RAT_BIT_CATM1 |
@@ -212,6 +319,34 @@
 #  define CELLULAR_CTRL_SECURITY_ROOT_OF_TRUST 0
 # endif
 
+/** Whether the module can resume TLS sessions (AT+USECPRF
+ * op code 13).
+ */
+# define CELLULAR_CTRL_SECURITY_TLS_SESSION_RESUMPTION 0
+
+/** The time to wait after the '@' prompt of AT+USOST/AT+USOWR
+ * before sending the data: the AT commands manual asks for
+ * a minimum of 50 ms.
+ */
+# ifndef CELLULAR_SOCK_PROMPT_GUARD_TIME_MS
+#  define CELLULAR_SOCK_PROMPT_GUARD_TIME_MS 50
+# endif
+
+/** Whether the module can connect a TCP socket asynchronously;
+ * not all SARA-R4 firmware versions support the asynchronous
+ * form of AT+USOCO so it is not used.
+ */
+# define CELLULAR_SOCK_ASYNC_CONNECT_IS_SUPPORTED 0
+
+/** Whether the module can close a TCP socket asynchronously,
+ * AT+USOCL with a final parameter of 1, completion being
+ * indicated by the +UUSOCL URC: SARA-R4 is strict about
+ * waiting for the ack for the ack for the ack when closing
+ * a TCP socket, which can take a long time, hence this is
+ * always used.
+ */
+# define CELLULAR_SOCK_ASYNC_CLOSE_IS_SUPPORTED 1
+
 # ifndef CELLULAR_MQTT_IS_SUPPORTED
 /** Whether MQTT is supported by the module or not.
  * Note: the SARA-R412M-02B modules shipped on C030-R412M
@@ -241,11 +376,36 @@
 
 # endif
 
+/** Whether the module supports publishing MQTT messages
+ * in binary form rather than as a hex string.
+ */
+# define CELLULAR_MQTT_BINARY_PUBLISH_IS_SUPPORTED 0
+
 /** The maximum length of an MQTT publish message.
  * TODO: check this
  */
 # define CELLULAR_MQTT_PUBLISH_MAX_LENGTH_BYTES 64
 
+/** Whether messages longer than
+ * CELLULAR_MQTT_PUBLISH_MAX_LENGTH_BYTES are published by
+ * first writing them to a file on the module with AT+UDWNFILE
+ * and then publishing that file (AT+UMQTTC=3).
+ */
+# define CELLULAR_MQTT_PUBLISH_FILE_IS_SUPPORTED 1
+
+/** The maximum length of an MQTT publish message by any
+ * means.  Here that is a limit of this code, not of the
+ * module: it is the most that cellularMqttPublish() will write
+ * to a file on the module for publishing and, with
+ * CELLULAR_CFG_STATIC_ALLOC, it sizes each publish slot, so
+ * it is kept to what applications need, messages of up to
+ * 2 kbytes.  The module judges for itself whether a message
+ * of a given length will fit: if it refuses the AT+UDWNFILE
+ * or the AT+UMQTTC=3 the publish fails with
+ * CELLULAR_MQTT_AT_ERROR.
+ */
+# define CELLULAR_MQTT_PUBLISH_ANY_MAX_LENGTH_BYTES 2048
+
 /** The maximum length of an MQTT read message.
  * TODO: check this.
  */
@@ -256,6 +416,39 @@
  */
 # define CELLULAR_MQTT_READ_TOPIC_MAX_LENGTH_BYTES 1024
 
+/** Whether the module has a file system that can be reached
+ * through AT+UDWNFILE, AT+URDBLOCK, AT+ULSTFILE and AT+UDELFILE.
+ */
+# define CELLULAR_FS_IS_SUPPORTED 1
+
+/** The most to ask for with a single AT+URDBLOCK.  This is
+ * an upper bound, not the limit of the module: cellularFsRead()
+ * asks for less if the module gives back less, or refuses the
+ * request, and so learns the real limit at run time.
+ */
+# define CELLULAR_FS_READ_BLOCK_MAX_LENGTH_BYTES 512
+
+/** Whether the module has an HTTP(S) client, AT+UHTTP/AT+UHTTPC.
+ */
+# define CELLULAR_HTTP_IS_SUPPORTED 1
+
+/** The time to wait for an HTTP request to complete.
+ */
+# define CELLULAR_HTTP_SERVER_RESPONSE_WAIT_SECONDS 180
+
+/** Whether the module has an MQTT-SN client: SARA-R4 does not.
+ */
+# define CELLULAR_MQTT_SN_IS_SUPPORTED 0
+
+/** The time to wait for an MQTT-SN gateway related operation
+ * to be completed; not used.
+ */
+# define CELLULAR_MQTT_SN_SERVER_RESPONSE_WAIT_SECONDS 240
+
+/** The maximum length of an MQTT-SN publish message; not used.
+ */
+# define CELLULAR_MQTT_SN_PUBLISH_MAX_LENGTH_BYTES 512
+
 #endif // CELLULAR_CFG_MODULE_SARA_R4
 
 #endif // _CELLULAR_CFG_MODULE_H_
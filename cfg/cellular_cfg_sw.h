@@ -33,6 +33,471 @@
 # define CELLULAR_CFG_ENABLE_LOGGING                 1
 #endif
 
+#ifndef CELLULAR_CFG_LOG_LEVEL
+/** The log level threshold of each module unless set otherwise
+ * below: 1 for errors only, 2 to add warnings, 3 to add
+ * information, which is what cellularPortLog() emits, and 4 to
+ * add debug, the chatty messages from time-critical paths such
+ * as URC handlers; see CELLULAR_PORT_LOG_LEVEL_xxx in
+ * cellular_port_debug.h.  Messages above the threshold of their
+ * module are removed by the compiler.
+ */
+# define CELLULAR_CFG_LOG_LEVEL                      4
+#endif
+
+#ifndef CELLULAR_CFG_LOG_LEVEL_CTRL_AT
+/** The log level threshold of the AT client.
+ */
+# define CELLULAR_CFG_LOG_LEVEL_CTRL_AT              CELLULAR_CFG_LOG_LEVEL
+#endif
+
+#ifndef CELLULAR_CFG_LOG_LEVEL_CTRL
+/** The log level threshold of ctrl, including CMUX.
+ */
+# define CELLULAR_CFG_LOG_LEVEL_CTRL                 CELLULAR_CFG_LOG_LEVEL
+#endif
+
+#ifndef CELLULAR_CFG_LOG_LEVEL_SOCK
+/** The log level threshold of sockets.
+ */
+# define CELLULAR_CFG_LOG_LEVEL_SOCK                 CELLULAR_CFG_LOG_LEVEL
+#endif
+
+#ifndef CELLULAR_CFG_LOG_LEVEL_MQTT
+/** The log level threshold of MQTT.
+ */
+# define CELLULAR_CFG_LOG_LEVEL_MQTT                 CELLULAR_CFG_LOG_LEVEL
+#endif
+
+#ifndef CELLULAR_CFG_LOG_LEVEL_PORT
+/** The log level threshold of the porting layer.
+ */
+# define CELLULAR_CFG_LOG_LEVEL_PORT                 CELLULAR_CFG_LOG_LEVEL
+#endif
+
+#ifndef CELLULAR_CFG_LOG_DEFERRED
+/** Set this to 1 to have logging store the format and arguments
+ * of each message in a ring buffer, to be formatted and emitted
+ * later by a low priority task, rather than formatting it there
+ * and then, so that a build with logging switched on keeps
+ * close to the timing of one without.  Strings passed with
+ * "%s" are copied; if the ring buffer is full messages are
+ * lost, and the number lost is logged.  Messages logged this
+ * way may come out after ones logged directly with
+ * cellularPortLogF(), e.g. test results.
+ */
+# define CELLULAR_CFG_LOG_DEFERRED                   0
+#endif
+
+#ifndef CELLULAR_CFG_LOG_DEFERRED_BUFFER_SIZE_BYTES
+/** The size of the ring buffer with CELLULAR_CFG_LOG_DEFERRED;
+ * a message with a few integer arguments takes around 30 bytes.
+ */
+# define CELLULAR_CFG_LOG_DEFERRED_BUFFER_SIZE_BYTES 2048
+#endif
+
+#ifndef CELLULAR_CFG_FOOTPRINT_SMALL
+/** Set this to 1 to have the defaults below favour RAM over
+ * throughput and capacity: smaller AT client buffers, a smaller
+ * CMUX receive buffer and shorter DNS, MQTT publish and topic
+ * tables.  Any value set explicitly still wins.
+ */
+# define CELLULAR_CFG_FOOTPRINT_SMALL                0
+#endif
+
+#ifndef CELLULAR_CFG_SOCK_WRITE_PIPELINE
+/** Set this to 1 to have a TCP socket write that spans several
+ * AT+USOWR segments hold on to the AT interface for the whole
+ * write and send each AT+USOWR as soon as the previous one has
+ * been answered, rather than letting go of the AT interface and
+ * waiting out the usual inter-command delay between segments.
+ */
+# define CELLULAR_CFG_SOCK_WRITE_PIPELINE            0
+#endif
+
+#ifndef CELLULAR_CFG_SOCK_TX_COALESCE_TIME_MS
+/** For a TCP socket that has been given a send buffer with
+ * CELLULAR_SOCK_OPT_SNDBUF, the age in milliseconds beyond which
+ * buffered data is sent at the next write rather than being
+ * coalesced further.
+ */
+# define CELLULAR_CFG_SOCK_TX_COALESCE_TIME_MS       100
+#endif
+
+#ifndef CELLULAR_CFG_SOCK_DNS_CACHE_NUM_ENTRIES
+/** The number of host names whose IP addresses are remembered
+ * by cellularSockGetHostByName(); set to 0 to not cache.
+ */
+# if CELLULAR_CFG_FOOTPRINT_SMALL
+#  define CELLULAR_CFG_SOCK_DNS_CACHE_NUM_ENTRIES    1
+# else
+#  define CELLULAR_CFG_SOCK_DNS_CACHE_NUM_ENTRIES    4
+# endif
+#endif
+
+#ifndef CELLULAR_CFG_SOCK_DNS_CACHE_TTL_SECONDS
+/** How long an entry in the DNS cache remains valid for.  The
+ * module does not report the TTL of a DNS record so this is
+ * used for all of them.
+ */
+# define CELLULAR_CFG_SOCK_DNS_CACHE_TTL_SECONDS     300
+#endif
+
+#ifndef CELLULAR_CFG_SOCK_DNS_ASYNC_QUEUE_LENGTH
+/** The number of cellularSockGetHostByNameAsync() look-ups that
+ * can be waiting at any one time.
+ */
+# if CELLULAR_CFG_FOOTPRINT_SMALL
+#  define CELLULAR_CFG_SOCK_DNS_ASYNC_QUEUE_LENGTH   1
+# else
+#  define CELLULAR_CFG_SOCK_DNS_ASYNC_QUEUE_LENGTH   4
+# endif
+#endif
+
+#ifndef CELLULAR_CFG_SOCK_DIRECT_LINK_GUARD_TIME_MS
+/** The period of silence in milliseconds either side of the
+ * "+++" escape sequence that takes a socket out of direct-link
+ * mode; this must be longer than the module's escape guard
+ * time (S12, one second by default).
+ */
+# define CELLULAR_CFG_SOCK_DIRECT_LINK_GUARD_TIME_MS 1200
+#endif
+
+#ifndef CELLULAR_CFG_AFR_SECURE_PROFILE
+/** The security profile that the module should use when TLS
+ * is required on an amazon-freertos secure socket; the TLS
+ * handshake and encryption then happen in the module rather
+ * than through mbedTLS on this MCU.  -1 means use mbedTLS.
+ */
+# define CELLULAR_CFG_AFR_SECURE_PROFILE             -1
+#endif
+
+#ifndef CELLULAR_CFG_CTRL_REG_POLL_INTERVAL_MS
+/** While waiting to register, cellularCtrlConnect() relies on
+ * the +CREG/+CGREG/+CEREG URCs to learn of changes; if none
+ * arrive for this long it queries the module itself, just in
+ * case one has gone missing.
+ */
+# define CELLULAR_CFG_CTRL_REG_POLL_INTERVAL_MS      30000
+#endif
+
+#ifndef CELLULAR_CFG_CTRL_TIME_UTC_CACHE_SECONDS
+/** cellularCtrlGetTimeUtc() reads the time from the module with
+ * AT+CCLK? once and then works it out from the tick timer of
+ * this MCU, reading it again when the network sends a NITZ time
+ * update (+CTZE), when the module is powered on or rebooted and
+ * after this many seconds, to limit the effect of any drift
+ * between the tick timer and the clock of the module.  Set to 0
+ * to read the time from the module on every call.
+ */
+# define CELLULAR_CFG_CTRL_TIME_UTC_CACHE_SECONDS    3600
+#endif
+
+#ifndef CELLULAR_CFG_CTRL_BAND_LEARNING_STAGE_SECONDS
+/** With band learning switched on (see
+ * cellularCtrlSetBandLearning()) cellularCtrlConnect() first tries
+ * a band mask narrowed to the bands it has connected on before,
+ * widening it if that doesn't work out: this is how long each
+ * narrowed band mask is given.
+ */
+# define CELLULAR_CFG_CTRL_BAND_LEARNING_STAGE_SECONDS 60
+#endif
+
+#ifndef CELLULAR_CFG_CTRL_E2E_CHUNK_SIZE_BYTES
+/** The amount of plain text that the streaming form of end to
+ * end encryption, cellularSecurityEndToEndEncryptUpdate(),
+ * passes to the module in one go; each chunk comes back with
+ * its own CELLULAR_CTRL_END_TO_END_ENCRYPT_HEADER_SIZE_BYTES
+ * header.  A buffer of this size plus the header is allocated
+ * for the duration of the stream.
+ */
+# if CELLULAR_CFG_FOOTPRINT_SMALL
+#  define CELLULAR_CFG_CTRL_E2E_CHUNK_SIZE_BYTES     256
+# else
+#  define CELLULAR_CFG_CTRL_E2E_CHUNK_SIZE_BYTES     1024
+# endif
+#endif
+
+#ifndef CELLULAR_CFG_CTRL_E2E_PROMPT_GUARD_TIME_MS
+/** The time to wait after the '>' prompt of AT+USECE2EDATAENC
+ * before sending the plain text.
+ */
+# define CELLULAR_CFG_CTRL_E2E_PROMPT_GUARD_TIME_MS  50
+#endif
+
+#ifndef CELLULAR_CFG_CTRL_TX_SCHEDULER_MAX_BYTES
+/** The most data that the transmit scheduler will hold back,
+ * see cellularCtrlTxSchedulerSend(); each queued send is
+ * copied into the heap along with a small header.
+ */
+# if CELLULAR_CFG_FOOTPRINT_SMALL
+#  define CELLULAR_CFG_CTRL_TX_SCHEDULER_MAX_BYTES   1024
+# else
+#  define CELLULAR_CFG_CTRL_TX_SCHEDULER_MAX_BYTES   8192
+# endif
+#endif
+
+#ifndef CELLULAR_CFG_CTRL_AT_BUFF_SIZE
+/** The size of the receive buffer of an AT client, which must be
+ * a power of two: big enough for the biggest thing that pops out
+ * of the module without a read, e.g. a large LWM2M object, up
+ * to the limit of the AT interface.
+ */
+# if CELLULAR_CFG_FOOTPRINT_SMALL
+#  define CELLULAR_CFG_CTRL_AT_BUFF_SIZE            512
+# else
+#  define CELLULAR_CFG_CTRL_AT_BUFF_SIZE            1024
+# endif
+#endif
+
+#ifndef CELLULAR_CFG_CTRL_AT_TX_BUFF_SIZE
+/** The size of the buffer in which an AT client assembles an
+ * AT command so that it goes to the UART in one write; a longer
+ * command is sent in chunks of this size.
+ */
+# if CELLULAR_CFG_FOOTPRINT_SMALL
+#  define CELLULAR_CFG_CTRL_AT_TX_BUFF_SIZE         128
+# else
+#  define CELLULAR_CFG_CTRL_AT_TX_BUFF_SIZE         256
+# endif
+#endif
+
+#ifndef CELLULAR_CFG_CTRL_AT_TRACE_NUM_RECORDS
+/** The number of records in the AT trace, which keeps the
+ * start of the most recent AT commands and responses in RAM,
+ * with a time-stamp, so that they can be printed out on demand
+ * with cellular_ctrl_at_trace_print() rather than being logged
+ * as they happen.  Set to 0 to leave the trace out.  When the
+ * trace is present, printing of AT commands and responses as
+ * they happen starts off switched off; it can be switched on
+ * again with cellular_ctrl_at_print_at_set().
+ */
+# define CELLULAR_CFG_CTRL_AT_TRACE_NUM_RECORDS      0
+#endif
+
+#ifndef CELLULAR_CFG_CTRL_AT_SEND_DELAY_MIN_MS
+/** The AT client waits a while after each response before sending
+ * the next command; the delay starts out at the value set with
+ * cellular_ctrl_at_set_send_delay() and, while commands keep
+ * succeeding, shrinks towards this minimum, returning to the full
+ * value as soon as a command fails or times out.  This is the
+ * minimum for configuration commands and queries.
+ */
+# define CELLULAR_CFG_CTRL_AT_SEND_DELAY_MIN_MS      5
+#endif
+
+#ifndef CELLULAR_CFG_CTRL_AT_SEND_DELAY_DATA_MIN_MS
+/** As CELLULAR_CFG_CTRL_AT_SEND_DELAY_MIN_MS but for commands
+ * that move user data, e.g. AT+USOWR, AT+USORD.
+ */
+# define CELLULAR_CFG_CTRL_AT_SEND_DELAY_DATA_MIN_MS 0
+#endif
+
+#ifndef CELLULAR_CFG_CTRL_AT_STATS_NUM_COMMANDS
+/** The number of different AT commands for which the AT client
+ * keeps statistics (counts, bytes, errors, time-outs and a
+ * latency histogram), see cellular_ctrl_at_stats_get(); the
+ * last entry collects everything that doesn't fit.  Set to 0
+ * to leave the statistics out.
+ */
+# define CELLULAR_CFG_CTRL_AT_STATS_NUM_COMMANDS     0
+#endif
+
+#ifndef CELLULAR_CFG_CTRL_AT_URC_BUDGET_MS
+/** The time a URC handler may take, with the AT stream locked
+ * and hence everyone else kept waiting, before the AT client
+ * logs a warning about it; the time each handler takes is
+ * kept anyway, see cellular_ctrl_at_urc_stats_get().  Set to
+ * 0 for no warnings.
+ */
+# define CELLULAR_CFG_CTRL_AT_URC_BUDGET_MS          20
+#endif
+
+#ifndef CELLULAR_CFG_CTRL_AT_RECOVERY_TIMEOUTS
+/** The number of AT command timeouts in a row, with the module
+ * powered on, after which the control driver starts recovering
+ * the AT link, see cellularCtrlIsRecovering().  Set to 0 to
+ * leave that to the application.
+ */
+# define CELLULAR_CFG_CTRL_AT_RECOVERY_TIMEOUTS      3
+#endif
+
+#ifndef CELLULAR_CFG_MQTT_PUBLISH_QUEUE_LENGTH
+/** The number of publishes which cellularMqttPublishAsync()
+ * will hold, each with a malloc()ed copy of its topic and
+ * message, while they wait to be sent and for the server
+ * to respond.  With CELLULAR_CFG_STATIC_ALLOC this many
+ * publish slots of maximum size are reserved up-front.
+ */
+# if CELLULAR_CFG_FOOTPRINT_SMALL
+#  define CELLULAR_CFG_MQTT_PUBLISH_QUEUE_LENGTH     1
+# else
+#  define CELLULAR_CFG_MQTT_PUBLISH_QUEUE_LENGTH     4
+# endif
+#endif
+
+#ifndef CELLULAR_CFG_MQTT_MAX_NUM_TOPICS
+/** The number of topics that can be registered with
+ * cellularMqttTopicRegister() at any one time; each costs
+ * one pointer of RAM.
+ */
+# if CELLULAR_CFG_FOOTPRINT_SMALL
+#  define CELLULAR_CFG_MQTT_MAX_NUM_TOPICS           4
+# else
+#  define CELLULAR_CFG_MQTT_MAX_NUM_TOPICS           8
+# endif
+#endif
+
+#ifndef CELLULAR_CFG_CMUX_MAX_NUM_CHANNELS
+/** The number of CMUX virtual channels (DLCIs 1 upwards) that
+ * can be open at any one time, not counting the CMUX control
+ * channel.
+ */
+# define CELLULAR_CFG_CMUX_MAX_NUM_CHANNELS          3
+#endif
+
+#ifndef CELLULAR_CFG_CMUX_FRAME_SIZE
+/** The maximum size of the information field of a CMUX frame,
+ * N1 in 3GPP 27.010, as given to the module in AT+CMUX.
+ */
+# define CELLULAR_CFG_CMUX_FRAME_SIZE                127
+#endif
+
+#ifndef CELLULAR_CFG_CMUX_CHANNEL_RX_BUFFER_SIZE
+/** The size of the receive buffer that is malloc()ed for each
+ * CMUX virtual channel when it is opened (or, with
+ * CELLULAR_CFG_STATIC_ALLOC, reserved for each channel up-front).
+ */
+# if CELLULAR_CFG_FOOTPRINT_SMALL
+#  define CELLULAR_CFG_CMUX_CHANNEL_RX_BUFFER_SIZE   256
+# else
+#  define CELLULAR_CFG_CMUX_CHANNEL_RX_BUFFER_SIZE   1024
+# endif
+#endif
+
+#ifndef CELLULAR_CFG_PORT_MALLOC_POOL
+/** Set this to 1 to have pCellularPort_malloc() and
+ * pCellularPort_mallocTag() take memory from pools of
+ * fixed-size blocks, the number of blocks of each size being
+ * set by the CELLULAR_CFG_PORT_MALLOC_POOL_NUM_xxx values
+ * below, and keep statistics on memory use per tag and per
+ * pool.  An allocation that doesn't fit a pool, or finds its
+ * pool empty, comes from the heap.
+ */
+# define CELLULAR_CFG_PORT_MALLOC_POOL               0
+#endif
+
+#ifndef CELLULAR_CFG_PORT_MALLOC_POOL_NUM_32
+/** The number of 32 byte blocks with CELLULAR_CFG_PORT_MALLOC_POOL;
+ * each block also costs a header of 8 bytes.
+ */
+# define CELLULAR_CFG_PORT_MALLOC_POOL_NUM_32        16
+#endif
+
+#ifndef CELLULAR_CFG_PORT_MALLOC_POOL_NUM_64
+/** The number of 64 byte blocks with CELLULAR_CFG_PORT_MALLOC_POOL.
+ */
+# define CELLULAR_CFG_PORT_MALLOC_POOL_NUM_64        16
+#endif
+
+#ifndef CELLULAR_CFG_PORT_MALLOC_POOL_NUM_128
+/** The number of 128 byte blocks with CELLULAR_CFG_PORT_MALLOC_POOL.
+ */
+# define CELLULAR_CFG_PORT_MALLOC_POOL_NUM_128       8
+#endif
+
+#ifndef CELLULAR_CFG_PORT_MALLOC_POOL_NUM_256
+/** The number of 256 byte blocks with CELLULAR_CFG_PORT_MALLOC_POOL.
+ */
+# define CELLULAR_CFG_PORT_MALLOC_POOL_NUM_256       4
+#endif
+
+#ifndef CELLULAR_CFG_PORT_MALLOC_POOL_NUM_512
+/** The number of 512 byte blocks with CELLULAR_CFG_PORT_MALLOC_POOL.
+ */
+# define CELLULAR_CFG_PORT_MALLOC_POOL_NUM_512       4
+#endif
+
+#ifndef CELLULAR_CFG_PORT_MALLOC_POOL_NUM_1024
+/** The number of 1024 byte blocks with CELLULAR_CFG_PORT_MALLOC_POOL.
+ */
+# define CELLULAR_CFG_PORT_MALLOC_POOL_NUM_1024      2
+#endif
+
+#ifndef CELLULAR_CFG_PORT_MALLOC_POOL_NUM_2048
+/** The number of 2048 byte blocks with CELLULAR_CFG_PORT_MALLOC_POOL.
+ */
+# define CELLULAR_CFG_PORT_MALLOC_POOL_NUM_2048      2
+#endif
+
+#ifndef CELLULAR_CFG_STATIC_ALLOC
+/** Set this to 1 to have the tasks, queues and mutexes of the
+ * port layer, and the buffers used by sockets, CMUX and MQTT
+ * while running, taken from fixed pools sized by the
+ * CELLULAR_CFG_STATIC_ALLOC_xxx values below rather than from
+ * the heap.  The underlying OS must support static allocation:
+ * for FreeRTOS configSUPPORT_STATIC_ALLOCATION must be 1, which
+ * the FreeRTOSConfig.h files here do when this is defined to 1
+ * on the compiler command-line, and on ESP32
+ * CONFIG_SUPPORT_STATIC_ALLOCATION must be set in sdkconfig.
+ */
+# define CELLULAR_CFG_STATIC_ALLOC                   0
+#endif
+
+#ifndef CELLULAR_CFG_STATIC_ALLOC_NUM_TASKS
+/** The number of tasks that can exist at any one time with
+ * CELLULAR_CFG_STATIC_ALLOC: the AT client URC and callback
+ * tasks, the DNS task and the CMUX task.  Add one for each
+ * task the application creates through cellularPortTaskCreate().
+ */
+# define CELLULAR_CFG_STATIC_ALLOC_NUM_TASKS         4
+#endif
+
+#ifndef CELLULAR_CFG_STATIC_ALLOC_TASK_STACK_SIZE_BYTES
+/** The memory from which task stacks are taken with
+ * CELLULAR_CFG_STATIC_ALLOC: enough for the sum of the
+ * xxx_STACK_SIZE_BYTES values in
+ * cellular_cfg_os_platform_specific.h plus any application
+ * tasks.  A stack is only carved off the first time a task
+ * slot is used, the slot keeping it thereafter.
+ */
+# define CELLULAR_CFG_STATIC_ALLOC_TASK_STACK_SIZE_BYTES (1024 * 16)
+#endif
+
+#ifndef CELLULAR_CFG_STATIC_ALLOC_NUM_QUEUES
+/** The number of queues that can exist at any one time with
+ * CELLULAR_CFG_STATIC_ALLOC; each socket waiter and each CMUX
+ * channel has one.
+ */
+# define CELLULAR_CFG_STATIC_ALLOC_NUM_QUEUES        20
+#endif
+
+#ifndef CELLULAR_CFG_STATIC_ALLOC_QUEUE_STORAGE_BYTES
+/** The memory from which queue storage, queue length times
+ * item size, is taken with CELLULAR_CFG_STATIC_ALLOC; carved
+ * off in the same way as task stacks.
+ */
+# define CELLULAR_CFG_STATIC_ALLOC_QUEUE_STORAGE_BYTES (1024 * 3)
+#endif
+
+#ifndef CELLULAR_CFG_STATIC_ALLOC_NUM_MUTEXES
+/** The number of mutexes that can exist at any one time with
+ * CELLULAR_CFG_STATIC_ALLOC; each socket has one, as does each
+ * CMUX channel.
+ */
+# define CELLULAR_CFG_STATIC_ALLOC_NUM_MUTEXES       32
+#endif
+
+#ifndef CELLULAR_CFG_STATIC_ALLOC_MQTT_TOPIC_MAX_LENGTH_BYTES
+/** The longest topic name, including terminator, that
+ * cellularMqttPublishAsync() can copy with
+ * CELLULAR_CFG_STATIC_ALLOC; each of the
+ * CELLULAR_CFG_MQTT_PUBLISH_QUEUE_LENGTH publish slots has
+ * room for this plus the longest message.
+ */
+# define CELLULAR_CFG_STATIC_ALLOC_MQTT_TOPIC_MAX_LENGTH_BYTES 128
+#endif
+
 #endif // _CELLULAR_CFG_SW_H_
 
 // End of file
@@ -164,6 +164,73 @@
 # define CELLULAR_CFG_TEST_MQTT_PASSWORD  NULL
 #endif
 
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS: HTTP RELATED
+ * -------------------------------------------------------------- */
+
+#ifndef CELLULAR_CFG_TEST_HTTP_SERVER_DOMAIN_NAME
+/** Server to use for HTTP testing: it must answer
+ * CELLULAR_CFG_TEST_HTTP_GET_PATH with a body of
+ * CELLULAR_CFG_TEST_HTTP_GET_SIZE_BYTES and echo back
+ * what is sent to CELLULAR_CFG_TEST_HTTP_POST_PATH.
+ */
+# define CELLULAR_CFG_TEST_HTTP_SERVER_DOMAIN_NAME  "httpbin.org"
+#endif
+
+#ifndef CELLULAR_CFG_TEST_HTTP_GET_SIZE_BYTES
+/** The size of the body to GET during HTTP testing.
+ */
+# define CELLULAR_CFG_TEST_HTTP_GET_SIZE_BYTES 5000
+#endif
+
+#ifndef CELLULAR_CFG_TEST_HTTP_GET_PATH
+/** The path to GET during HTTP testing.
+ */
+# define CELLULAR_CFG_TEST_HTTP_GET_PATH  "/bytes/5000"
+#endif
+
+#ifndef CELLULAR_CFG_TEST_HTTP_POST_PATH
+/** The path to POST to during HTTP testing.
+ */
+# define CELLULAR_CFG_TEST_HTTP_POST_PATH  "/post"
+#endif
+
+#ifndef CELLULAR_CFG_TEST_HTTP_MISSING_PATH
+/** A path that the HTTP test server does not have.
+ */
+# define CELLULAR_CFG_TEST_HTTP_MISSING_PATH  "/status/404"
+#endif
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS: MQTT-SN RELATED
+ * -------------------------------------------------------------- */
+
+#ifndef CELLULAR_CFG_TEST_MQTT_SN_SERVER_DOMAIN_NAME
+/** MQTT-SN gateway to use for testing: there is no public one,
+ * so this must usually be overridden with the address of a
+ * gateway (e.g. Eclipse Paho MQTT-SN) that forwards to a broker.
+ */
+# define CELLULAR_CFG_TEST_MQTT_SN_SERVER_DOMAIN_NAME  "mqtt-sn.local:2442"
+#endif
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS: BENCHMARK RELATED
+ * -------------------------------------------------------------- */
+
+/** The tag at the start of a benchmark result line that is meant
+ * for a machine rather than a person: the rest of the line is
+ * "<name> <value> <unit>", where name contains no spaces and value
+ * is an integer.  run_unit_tests_and_detect_outcome.py picks these
+ * lines up, attaches them to the test that emitted them in its
+ * report and compares them with a baseline.
+ */
+#define CELLULAR_CFG_TEST_METRIC_TAG "CELLULAR_TEST_METRIC:"
+
+/** The format of a benchmark result line, for cellularPortLog(),
+ * taking the name as a string, the value as an int32_t and the
+ * unit as a string.
+ */
+#define CELLULAR_CFG_TEST_METRIC_FORMAT CELLULAR_CFG_TEST_METRIC_TAG " %s %d %s\n"
 
 #endif // _CELLULAR_CFG_TEST_H_
 
@@ -156,14 +156,30 @@ extern "C" {
 # error CELLULAR_CTRL_SUPPORTED_RATS_BITMAP must be defined in cellular_cfg_module.h.
 #endif
 
-/** The PDP context ID to use.
+/** The maximum number of PDP contexts that may be active at
+ * any one time.
+ */
+#ifndef CELLULAR_CTRL_MAX_NUM_ACTIVE_CONTEXTS
+# error CELLULAR_CTRL_MAX_NUM_ACTIVE_CONTEXTS must be defined in cellular_cfg_module.h.
+#endif
+
+/** The PDP context ID used by cellularCtrlConnect(); further
+ * contexts may be brought up with cellularCtrlActivateContext(),
+ * using IDs from CELLULAR_CTRL_CONTEXT_ID + 1 up to
+ * CELLULAR_CTRL_CONTEXT_ID + CELLULAR_CTRL_MAX_NUM_ACTIVE_CONTEXTS - 1.
  */
 #define CELLULAR_CTRL_CONTEXT_ID 1
 
-/** The module profile ID to use.
+/** The module profile ID used for CELLULAR_CTRL_CONTEXT_ID.
  */
 #define CELLULAR_CTRL_PROFILE_ID 1
 
+/** The module profile ID used for a given PDP context ID.
+ */
+#define CELLULAR_CTRL_PROFILE_ID_FOR_CONTEXT(contextId) (CELLULAR_CTRL_PROFILE_ID + \
+                                                         (contextId) -             \
+                                                         CELLULAR_CTRL_CONTEXT_ID)
+
 /** The number of digits in an IP address, including room for a
  * NULL terminator, i.e. "255.255.255.255\x00" .
  */
@@ -188,6 +204,11 @@ extern "C" {
  */
 #define CELLULAR_CTRL_END_TO_END_ENCRYPT_HEADER_SIZE_BYTES 32
 
+/** The number of security profiles (AT+USECPRF) in the module,
+ * numbered from zero.
+ */
+#define CELLULAR_CTRL_SECURITY_PROFILE_MAX_NUM 5
+
 /* ----------------------------------------------------------------
  * TYPES
  * -------------------------------------------------------------- */
@@ -278,6 +299,108 @@ typedef enum {
     CELLULAR_CTRL_MAX_NUM_NETWORK_STATUS
 } CellularCtrlNetworkStatus_t;
 
+/** The stages of an asynchronous connection attempt, see
+ * cellularCtrlConnectAsync().
+ */
+typedef enum {
+    CELLULAR_CTRL_CONNECT_STATE_IDLE = 0,    //!< not started.
+    CELLULAR_CTRL_CONNECT_STATE_PREPARING,   //!< reading the SIM and setting up.
+    CELLULAR_CTRL_CONNECT_STATE_REGISTERING, //!< radio on, waiting for the network.
+    CELLULAR_CTRL_CONNECT_STATE_ATTACHING,   //!< registered, waiting for attach.
+    CELLULAR_CTRL_CONNECT_STATE_ACTIVATING,  //!< activating the PDP context.
+    CELLULAR_CTRL_CONNECT_STATE_CONNECTED,   //!< done: success.
+    CELLULAR_CTRL_CONNECT_STATE_FAILED,      //!< done: failure, radio left off.
+    CELLULAR_CTRL_MAX_NUM_CONNECT_STATES
+} CellularCtrlConnectState_t;
+
+/** The cellular module types.
+ */
+typedef enum {
+    CELLULAR_CTRL_MODULE_TYPE_UNKNOWN = 0,
+    CELLULAR_CTRL_MODULE_TYPE_SARA_R5,
+    CELLULAR_CTRL_MODULE_TYPE_SARA_R412M_02B,
+    CELLULAR_CTRL_MODULE_TYPE_SARA_R412M_03B,
+    CELLULAR_CTRL_MAX_NUM_MODULE_TYPES
+} CellularCtrlModuleType_t;
+
+/** The capabilities, timings and AT command differences of a
+ * cellular module; the values for the module this code was
+ * built for are the same as those in cellular_cfg_module.h.
+ */
+typedef struct {
+    CellularCtrlModuleType_t moduleType;
+    const char *pModelPrefix;           //!< how AT+CGMM starts for this module.
+    int32_t pwrOnPullTimeMs;
+    int32_t pwrOffPullTimeMs;
+    int32_t commandTimeoutMs;
+    int32_t commandMinimumResponseTimeMs;
+    int32_t bootWaitTimeMs;
+    int32_t powerDownWaitSeconds;
+    int32_t rebootCommandWaitTimeMs;
+    int32_t rebootCfun;                 //!< the AT+CFUN value that reboots the module.
+    int32_t maxNumSimultaneousRats;
+    uint32_t supportedRatsBitmap;
+    int32_t ucgedMode;                  //!< the AT+UCGED mode the radio parameters are read in, 2 or 5.
+    int32_t maxNumActiveContexts;
+    bool contextNeedsInternalProfile;   //!< a context must also be mapped to an internal profile with AT+UPSD.
+    bool securityRootOfTrust;
+    bool securitySealNeedsApn;          //!< AT+USECOPCMD="cfgpdn" must be sent before sealing.
+    int32_t sockPromptGuardTimeMs;
+    bool mqttIsSupported;
+    bool mqttSaraR4Syntax;              //!< AT+UMQTT as on SARA-R4: outcomes in the response, settings and messages in URCs.
+    bool mqttBinaryPublishIsSupported;
+    int32_t mqttPublishMaxLengthBytes;
+    bool mqttPublishFileIsSupported;    //!< longer messages can be published from a file, AT+UMQTTC=3.
+    bool mqttLocalPortIsSupported;      //!< the local port can be set and read, AT+UMQTT=1.
+    bool mqttSessionCleanIsSupported;   //!< session cleaning can be switched, AT+UMQTT=12.
+    int32_t mqttReadMessageMaxLengthBytes;
+    int32_t mqttReadTopicMaxLengthBytes;
+} CellularCtrlModuleProfile_t;
+
+/** The state of a streamed end to end encryption, see
+ * cellularSecurityEndToEndEncryptInit(); the contents are
+ * private to the implementation.
+ */
+typedef struct {
+    int32_t (*pOutput) (const void *, size_t, void *);
+    void *pOutputParam;
+    char *pBuffer;
+    size_t bufferLength;
+    int32_t errorCodeOrSize;
+} CellularSecurityEndToEndEncryptStream_t;
+
+/** The types of security credential that may be stored in the
+ * module, see cellularCtrlSecurityCredentialStore(); the values
+ * match AT+USECMNG.
+ */
+typedef enum {
+    CELLULAR_CTRL_SECURITY_CREDENTIAL_ROOT_CA = 0,     //!< a trusted root CA certificate.
+    CELLULAR_CTRL_SECURITY_CREDENTIAL_CLIENT_CERT = 1, //!< the client certificate.
+    CELLULAR_CTRL_SECURITY_CREDENTIAL_CLIENT_KEY = 2,  //!< the client private key.
+    CELLULAR_CTRL_SECURITY_CREDENTIAL_SERVER_CERT = 3, //!< a server certificate.
+    CELLULAR_CTRL_MAX_NUM_SECURITY_CREDENTIALS
+} CellularCtrlSecurityCredential_t;
+
+/** The settings of a security profile in the module, see
+ * cellularCtrlSecurityProfileSet(); a negative integer or
+ * a NULL string means "leave at the module's default".
+ * Credentials are referred to by the name they were stored
+ * under with cellularCtrlSecurityCredentialStore().
+ */
+typedef struct {
+    int32_t validationLevel;     //!< 0 none, 1 root CA, 2 plus URL, 3 plus date.
+    int32_t tlsVersion;          //!< 0 any, 1 1.0, 2 1.1, 3 1.2, 4 1.3.
+    int32_t cipherSuite;         //!< 0 automatic else see the AT manual.
+    const char *pRootCaName;     //!< the trusted root CA certificate.
+    const char *pServerNameStr;  //!< the expected server host name.
+    const char *pClientCertName; //!< the client certificate.
+    const char *pClientKeyName;  //!< the client private key.
+    const char *pSniStr;         //!< the server name indication.
+    int32_t sessionResumption;   //!< 1 to have the module cache and resume TLS sessions
+                                 //!  with the server, 0 not to; only where
+                                 //!  CELLULAR_CTRL_SECURITY_TLS_SESSION_RESUMPTION is 1.
+} CellularCtrlSecurityProfile_t;
+
 /* ----------------------------------------------------------------
  * FUNCTIONS
  * -------------------------------------------------------------- */
@@ -423,6 +546,24 @@ void cellularCtrlHardPowerOff(bool trulyHard,
  */
 int32_t cellularCtrlGetConsecutiveAtTimeouts();
 
+/** Determine whether the AT link to the cellular module is being
+ * recovered.  Once the module, powered on, has given
+ * CELLULAR_CFG_CTRL_AT_RECOVERY_TIMEOUTS AT command timeouts in
+ * a row, this driver works its way up a ladder in the background:
+ * flush and re-synchronise, send the "+++" escape sequence in
+ * case the module has been left in a data mode,
+ * cellularCtrlReboot() and finally cellularCtrlHardPowerOff()
+ * followed by cellularCtrlPowerOn(), stopping at the first
+ * rung that brings the module back.  While that is under way
+ * anything that would send an AT command fails at once, rather
+ * than waiting for a timeout.  If the last rung fails the
+ * module is left to the application.  Note that a reboot or a
+ * power cycle loses any network connection, sockets, etc.
+ *
+ * @return true if the AT link is being recovered, else false.
+ */
+bool cellularCtrlIsRecovering();
+
 /** Re-boot the cellular module.  The module will be reset with
  * a proper detach from the network and any NV parameters
  * will be saved.  If this function returns successfully
@@ -433,6 +574,23 @@ int32_t cellularCtrlGetConsecutiveAtTimeouts();
  */
 int32_t cellularCtrlReboot();
 
+/** Start 3GPP 27.010 multiplexing (CMUX) on the UART to the
+ * module and move the AT interface on to a virtual channel
+ * of it.  Further virtual channels can then be opened with
+ * cellularCtrlCmuxChannelOpen() (see cellular_ctrl_cmux.h),
+ * each one appearing as a UART of its own.  CMUX is stopped
+ * automatically if the module is powered off or rebooted.
+ *
+ * @return zero on success or negative error code on failure.
+ */
+int32_t cellularCtrlCmuxStart();
+
+/** Stop CMUX, returning the module and the AT interface to
+ * the plain UART.  Any other virtual channels should be
+ * finished with before this is called.
+ */
+void cellularCtrlCmuxStop();
+
 /** Set the bands to be used by the cellular module.
  * The module must be powered on for this to work and the
  * module must be re-booted afterwards (with a call to
@@ -557,7 +715,14 @@ int32_t cellularCtrlSetMnoProfile(int32_t mnoProfile);
 int32_t cellularCtrlGetMnoProfile();
 
 /** Register with the cellular network and obtain a PDP
- * context.
+ * context.  The operator, access technology and APN of the
+ * last successful connection, and the IMSI of the SIM it was
+ * made with, are remembered (in non-volatile storage, if the
+ * platform provides cellularPortNvStore()).  If the same SIM
+ * is present the next time, the module is steered to that
+ * operator first with AT+COPS=4, which falls back to automatic
+ * selection, and the APN database is entered at the APN that
+ * worked.
  *
  * @param pKeepGoingCallback a callback function that governs how
  *                           long registration will continue for.
@@ -587,6 +752,255 @@ int32_t cellularCtrlConnect(bool (*pKeepGoingCallback) (void),
                             const char *pApn, const char *pUsername,
                             const char *pPassword);
 
+/** Forget the settings of the last successful connection so
+ * that the next cellularCtrlConnect() starts from scratch, e.g.
+ * because the device has been moved to another country.  This
+ * includes any bands learnt with cellularCtrlSetBandLearning().
+ */
+void cellularCtrlForgetLastGood();
+
+/** Switch band learning on or off; it is off by default.  With
+ * band learning on, when a connection is made on CAT-M1 or NB1
+ * the band it was made on, worked out from the EARFCN, is
+ * remembered along with the other last-known-good settings.
+ * cellularCtrlConnect() then first sets the band mask of that
+ * RAT to the band of the last connection, then to all of the
+ * bands connections have been made on, giving each
+ * CELLULAR_CFG_CTRL_BAND_LEARNING_STAGE_SECONDS, before
+ * putting back the band mask as it was, so that a device that
+ * doesn't move finds its cell without scanning every band.
+ * Each change of band mask costs a reboot of the module; the
+ * narrowed band mask is left in place once connected, so a
+ * subsequent cellularCtrlGetBandMask() will return it.  A band
+ * mask set with cellularCtrlSetBandMask() is taken as the new
+ * widest band mask.  Band learning applies to
+ * cellularCtrlConnect() only: a connection made with
+ * cellularCtrlConnectAsync() is learnt from but the band mask
+ * is not narrowed for it.  Switching band learning off, or
+ * calling cellularCtrlForgetLastGood(), puts the widest band
+ * mask back, to take effect at the next reboot.
+ *
+ * @param onNotOff true to switch band learning on, else false.
+ */
+void cellularCtrlSetBandLearning(bool onNotOff);
+
+/** Get whether band learning is on.
+ *
+ * @return true if band learning is on, else false.
+ */
+bool cellularCtrlIsBandLearning();
+
+/** Get the E-UTRA band, as numbered by 3GPP TS 36.101, that an
+ * EARFCN, e.g. as returned by cellularCtrlGetEarfcn(), is in.
+ *
+ * @param earfcn the downlink EARFCN.
+ * @return       the band, e.g. 20, or negative error code if
+ *               the EARFCN is not in a band supported here.
+ */
+int32_t cellularCtrlEarfcnToBand(int32_t earfcn);
+
+/** As cellularCtrlConnect() but without blocking: the
+ * connection steps are carried out in the background, one
+ * short step at a time, by the task that runs the callbacks of
+ * the AT layer, and pCallback is called at each stage; the
+ * calling task is free to get on with other things in the
+ * meantime.  While this is going on the only other functions
+ * of this API that may be called are cellularCtrlConnectAsyncCancel(),
+ * cellularCtrlGetConnectState() and ones which only read
+ * information, e.g. cellularCtrlIsRegistered().
+ *
+ * @param pApn           pointer to a string giving the APN to
+ *                       use, up to 64 characters; set to NULL
+ *                       to use the APN database, as for
+ *                       cellularCtrlConnect().  The string is
+ *                       copied so need not be kept.
+ * @param pUsername      pointer to a string giving the user name
+ *                       for PPP authentication, up to 64
+ *                       characters; may be NULL.  Copied.
+ * @param pPassword      pointer to a string giving the password
+ *                       for PPP authentication, up to 64
+ *                       characters; must be non-NULL if pUsername
+ *                       is non-NULL.  Copied.
+ * @param timeoutSeconds the time to give the whole attempt.
+ * @param pCallback      the function to call at each change of
+ *                       state, with the new state, zero or, for
+ *                       CELLULAR_CTRL_CONNECT_STATE_FAILED,
+ *                       the negative error code, and
+ *                       pCallbackParam; it is called from the
+ *                       AT callbacks task, should return
+ *                       quickly and must not call this API
+ *                       other than to read information. May be
+ *                       NULL, in which case
+ *                       cellularCtrlGetConnectState() may be
+ *                       polled instead.
+ * @param pCallbackParam a parameter to pass to pCallback.
+ * @return               zero if the attempt has been started,
+ *                       else negative error code, e.g.
+ *                       CELLULAR_CTRL_CONNECTED if an attempt is
+ *                       already in progress.
+ */
+int32_t cellularCtrlConnectAsync(const char *pApn, const char *pUsername,
+                                 const char *pPassword,
+                                 int32_t timeoutSeconds,
+                                 void (*pCallback) (CellularCtrlConnectState_t,
+                                                    int32_t,
+                                                    void *),
+                                 void *pCallbackParam);
+
+/** Cancel an asynchronous connection attempt.  This returns
+ * at once: the attempt ends, with a callback for
+ * CELLULAR_CTRL_CONNECT_STATE_FAILED, once its current step
+ * has finished.
+ */
+void cellularCtrlConnectAsyncCancel();
+
+/** Get the state of the last asynchronous connection attempt.
+ *
+ * @return the state.
+ */
+CellularCtrlConnectState_t cellularCtrlGetConnectState();
+
+/** Request 3GPP power saving mode (PSM) from the network.  When
+ * the network agrees and the module has nothing to do it will go
+ * into deep sleep, emerging every periodicWakeupSeconds to tell
+ * the network it is still there; the module will NOT respond to
+ * AT commands while asleep, hence if an AT command is sent while
+ * the module is known to be asleep this driver first wakes it up
+ * (using the PWR_ON pin) and restores its AT settings, which will
+ * take a few seconds.  The values the network actually grants may
+ * differ from those requested.
+ *
+ * @param onNotOff              true to request PSM, false to
+ *                              switch it off.
+ * @param periodicWakeupSeconds the requested periodic wake-up
+ *                              time (T3412 extended) in seconds,
+ *                              rounded up to what 3GPP can encode;
+ *                              ignored if onNotOff is false.
+ * @param activeTimeSeconds     the requested time to stay awake
+ *                              after returning to idle mode (T3324)
+ *                              in seconds, rounded up to what
+ *                              3GPP can encode; ignored if onNotOff
+ *                              is false.
+ * @return                      zero on success or negative error
+ *                              code on failure.
+ */
+int32_t cellularCtrlSetPsm(bool onNotOff, int32_t periodicWakeupSeconds,
+                           int32_t activeTimeSeconds);
+
+/** Get the requested 3GPP power saving mode (PSM) settings.
+ *
+ * @param pOnNotOff              pointer to a place to put whether
+ *                               PSM is requested; may be NULL.
+ * @param pPeriodicWakeupSeconds pointer to a place to put the
+ *                               requested periodic wake-up time
+ *                               in seconds, -1 if there is none;
+ *                               may be NULL.
+ * @param pActiveTimeSeconds     pointer to a place to put the
+ *                               requested active time in seconds,
+ *                               -1 if there is none; may be NULL.
+ * @return                       zero on success or negative error
+ *                               code on failure.
+ */
+int32_t cellularCtrlGetPsm(bool *pOnNotOff, int32_t *pPeriodicWakeupSeconds,
+                           int32_t *pActiveTimeSeconds);
+
+/** Request extended discontinuous reception (eDRX) from the network
+ * for the given RAT.
+ *
+ * @param rat      the RAT to set eDRX for.
+ * @param onNotOff true to request eDRX, false to switch it off.
+ * @param edrxMs   the requested eDRX cycle in milliseconds,
+ *                 rounded up to the next cycle length that 3GPP
+ *                 can encode (5120 ms to 10485760 ms); ignored if
+ *                 onNotOff is false.
+ * @return         zero on success or negative error code on
+ *                 failure.
+ */
+int32_t cellularCtrlSetEdrx(CellularCtrlRat_t rat, bool onNotOff,
+                            int32_t edrxMs);
+
+/** Get the requested eDRX settings for the given RAT.
+ *
+ * @param rat       the RAT to get the eDRX settings for.
+ * @param pOnNotOff pointer to a place to put whether eDRX is
+ *                  requested; may be NULL.
+ * @param pEdrxMs   pointer to a place to put the requested eDRX
+ *                  cycle in milliseconds, -1 if there is none;
+ *                  may be NULL.
+ * @return          zero on success or negative error code on
+ *                  failure.
+ */
+int32_t cellularCtrlGetEdrx(CellularCtrlRat_t rat, bool *pOnNotOff,
+                            int32_t *pEdrxMs);
+
+/** Get whether the module has told us that it has gone into
+ * PSM deep sleep.
+ *
+ * @return true if the module is asleep, else false.
+ */
+bool cellularCtrlIsAsleep();
+
+/** Use the ring indicator (RI) output of the cellular module as
+ * a wake-up source for the host: the module is told (AT+URING)
+ * to pulse RI low whenever it has a URC to send and an interrupt
+ * is set on pinRi, see cellularPortGpioInterruptSet(), so that
+ * when RI falls pinRi is sent to queueHandle.  The host may then
+ * sleep as deeply as it likes, e.g. with a task blocked on
+ * queueHandle and the MCU in a low-power mode, until the module
+ * has something to say.  The setting is re-applied by
+ * cellularCtrlPowerOn() and removed by cellularCtrlDeinit().
+ *
+ * @param pinRi       the GPIO input connected to the RI pin of
+ *                    the module, -1 to stop using RI.
+ * @param queueHandle the queue to send pinRi to, created with an
+ *                    item size of sizeof(int32_t); ignored if
+ *                    pinRi is -1.
+ * @return            zero on success or negative error code on
+ *                    failure; CELLULAR_CTRL_NOT_SUPPORTED if the
+ *                    platform has no GPIO interrupts.
+ */
+int32_t cellularCtrlSetRingIndicator(int32_t pinRi,
+                                     CellularPortQueueHandle_t queueHandle);
+
+/** Activate a further PDP context, e.g. one on a private APN
+ * for telemetry alongside the public one brought up by
+ * cellularCtrlConnect() for firmware downloads.  The module
+ * must already be registered with the network, i.e.
+ * cellularCtrlConnect() must have succeeded.
+ *
+ * @param contextId the ID of the context to activate, from
+ *                  CELLULAR_CTRL_CONTEXT_ID + 1 to
+ *                  CELLULAR_CTRL_CONTEXT_ID +
+ *                  CELLULAR_CTRL_MAX_NUM_ACTIVE_CONTEXTS - 1.
+ * @param pApn      pointer to a string giving the APN to
+ *                  use; set to NULL if no APN is required
+ *                  by the service provider.
+ * @param pUsername pointer to a string giving the user name
+ *                  for PPP authentication; may be set to
+ *                  NULL if no user name or password is
+ *                  required.
+ * @param pPassword pointer to a string giving the password
+ *                  for PPP authentication; must be
+ *                  non-NULL if pUsername is non-NULL.
+ * @return          zero on success or negative error code on
+ *                  failure.
+ */
+int32_t cellularCtrlActivateContext(int32_t contextId,
+                                    const char *pApn,
+                                    const char *pUsername,
+                                    const char *pPassword);
+
+/** Deactivate a PDP context that was activated with
+ * cellularCtrlActivateContext().  Any sockets using it will
+ * not work afterwards and should be closed.  To deactivate
+ * CELLULAR_CTRL_CONTEXT_ID use cellularCtrlDisconnect().
+ *
+ * @param contextId the ID of the context to deactivate.
+ * @return          zero on success or negative error code on
+ *                  failure.
+ */
+int32_t cellularCtrlDeactivateContext(int32_t contextId);
+
 /** Disconnect the cellular module from the network.
  *
  * @return zero on success or negative error code on failure.
@@ -668,6 +1082,20 @@ int32_t cellularCtrlGetMccMnc(int32_t *pMcc, int32_t *pMnc);
  */
 int32_t cellularCtrlGetIpAddressStr(char *pStr);
 
+/** As cellularCtrlGetIpAddressStr() but for the given PDP context.
+ *
+ * @param contextId the ID of the PDP context.
+ * @param pStr      should point to storage of length at least
+ *                  CELLULAR_CTRL_IP_ADDRESS_SIZE bytes in size
+ *                  or may be NULL.
+ * @return          on success, the number of characters that
+ *                  would be copied into pStr if it is not NULL,
+ *                  NOT including the terminator, on failure
+ *                  negative error code.
+ */
+int32_t cellularCtrlGetIpAddressStrForContext(int32_t contextId,
+                                              char *pStr);
+
 /** Get the APN currently in use.
  *
  * @param pStr    a pointer to size bytes of storage into which
@@ -770,6 +1198,96 @@ int32_t cellularCtrlGetCellId();
  */
 int32_t cellularCtrlGetEarfcn();
 
+/** Start the transmit scheduler, which holds back traffic that
+ * can wait, see cellularCtrlTxSchedulerSend(), until the radio
+ * conditions are good, since sending at the edge of coverage
+ * can cost many times the energy and time of sending in good
+ * coverage.  While anything is held back the scheduler calls
+ * cellularCtrlRefreshRadioParameters() every checkIntervalSeconds,
+ * from a task of its own, and releases everything held back,
+ * in the order it was sent, when the RSRP is at least
+ * rsrpThresholdDbm and the SNR, if the module reports one, is
+ * at least snrThresholdDb; anything whose deadline arrives
+ * first is released then, whatever the radio conditions.  The
+ * radio conditions are taken to remain as measured for
+ * checkIntervalSeconds, so traffic sent while they are known to
+ * be good goes straight away.  Where no RSRP is reported, e.g.
+ * on GERAN, traffic is held back until its deadline.  Nothing
+ * is checked, and so the module is not woken, while nothing
+ * is held back.
+ *
+ * @param rsrpThresholdDbm     the lowest RSRP at which traffic
+ *                             is released.
+ * @param snrThresholdDb       the lowest SNR at which traffic
+ *                             is released.
+ * @param checkIntervalSeconds how often to check the radio
+ *                             conditions while traffic is held
+ *                             back; must be greater than zero.
+ * @return                     zero on success else negative
+ *                             error code.
+ */
+int32_t cellularCtrlTxSchedulerStart(int32_t rsrpThresholdDbm,
+                                     int32_t snrThresholdDb,
+                                     int32_t checkIntervalSeconds);
+
+/** Stop the transmit scheduler; anything held back is sent
+ * before this returns.
+ */
+void cellularCtrlTxSchedulerStop();
+
+/** Send data through the transmit scheduler.  If the scheduler
+ * is not running or deadlineSeconds is zero or less, i.e. the
+ * traffic is urgent, pSend is called at once, in the context of
+ * this function.  Otherwise the data is copied and held back,
+ * see cellularCtrlTxSchedulerStart(), and pSend is called from
+ * the task of the scheduler when the radio conditions are good
+ * or deadlineSeconds have passed, whichever is first.  At most
+ * CELLULAR_CFG_CTRL_TX_SCHEDULER_MAX_BYTES can be held back.
+ * cellularSockWriteDeferred() and cellularMqttPublishDeferred()
+ * use this for sockets and MQTT.
+ *
+ * @param pSend           the function that does the sending, e.g.
+ *                        one that calls cellularSockWrite(); it
+ *                        is given the data, its size and
+ *                        pSendParam and should return zero or
+ *                        positive on success, else negative error
+ *                        code, which is logged if the send was
+ *                        held back.  Cannot be NULL.
+ * @param pSendParam      passed to pSend as its third parameter.
+ * @param pData           the data to send; may be NULL only if
+ *                        dataSizeBytes is zero.
+ * @param dataSizeBytes   the number of bytes at pData.
+ * @param deadlineSeconds the longest time the data may be held
+ *                        back for, zero or less for urgent data.
+ * @return                the return value of pSend if it was
+ *                        called at once, dataSizeBytes if the
+ *                        data has been held back, else negative
+ *                        error code, e.g. CELLULAR_CTRL_NO_MEMORY
+ *                        if there is no room to hold it back.
+ */
+int32_t cellularCtrlTxSchedulerSend(int32_t (*pSend) (const void *,
+                                                      size_t,
+                                                      void *),
+                                    void *pSendParam,
+                                    const void *pData,
+                                    size_t dataSizeBytes,
+                                    int32_t deadlineSeconds);
+
+/** Release everything held back by the transmit scheduler now,
+ * whatever the radio conditions; the sends happen in the task
+ * of the scheduler, this does not wait for them.
+ *
+ * @return zero on success else negative error code.
+ */
+int32_t cellularCtrlTxSchedulerFlush();
+
+/** Get the number of bytes held back by the transmit scheduler.
+ *
+ * @return the number of bytes held back, else negative error
+ *         code.
+ */
+int32_t cellularCtrlTxSchedulerGetPendingBytes();
+
 /** Get the IMEI of the cellular module.
  *
  * @param pImei a pointer to CELLULAR_CTRL_IMEI_SIZE bytes
@@ -810,6 +1328,22 @@ int32_t cellularCtrlGetImsi(char *pImsi);
  */
 int32_t cellularCtrlGetIccidStr(char *pStr, size_t size);
 
+/** Read the IMEI, IMSI, ICCID, manufacturer, model and firmware
+ * version strings from the cellular module into the identity cache
+ * so that subsequent calls to cellularCtrlGetImei() etc. return
+ * without talking to the module.  The queries are sent as two
+ * AT command lines, one for the module identity and one for the
+ * SIM identity, which is considerably quicker than asking for each
+ * individually.  The module identity is fetched in this way
+ * anyway at power on; calling this function is useful when
+ * several of the SIM identities are going to be needed, e.g. after
+ * a SIM change.
+ *
+ * @return 0 on success, negative error code on failure, e.g.
+ *         if there is no SIM.
+ */
+int32_t cellularCtrlRefreshIdentity();
+
 /** Get the manufacturer identification string from the cellular
  * module.
  *
@@ -845,6 +1379,24 @@ int32_t cellularCtrlGetManufacturerStr(char *pStr, size_t size);
  */
 int32_t cellularCtrlGetModelStr(char *pStr, size_t size);
 
+/** Get the capability and timing profile of the cellular module.
+ * Until the module has been powered on this is the profile
+ * of the module the code was built for; cellularCtrlPowerOn()
+ * then reads the model (AT+CGMM) and, if it is a module that
+ * is known, switches to the profile for that module.  The
+ * timings, RAT and context limits and AT command differences
+ * of this driver and of the MQTT client follow the profile, so
+ * one image can drive any of the known modules.  Buffer sizes,
+ * and whether a feature is built in at all, are still set at
+ * compile time by cellular_cfg_module.h for the module the
+ * code was built for: e.g. a SARA-R5 image driving a SARA-R4
+ * can only publish MQTT messages from a file if
+ * CELLULAR_MQTT_PUBLISH_FILE_IS_SUPPORTED was set.
+ *
+ * @return a pointer to the profile, never NULL.
+ */
+const CellularCtrlModuleProfile_t *pCellularCtrlGetModuleProfile();
+
 /** Get the firmware version string from the cellular module.
  *
  * @param pStr    a pointer to size bytes of storage into which
@@ -864,7 +1416,11 @@ int32_t cellularCtrlGetFirmwareVersionStr(char *pStr, size_t size);
 
 /** Get the UTC time according to cellular.  This feature requires
  * a connection to have been activated and support for this feature
- * is optional in the cellular network.
+ * is optional in the cellular network.  The time is read from the
+ * module once and then worked out from the tick timer, so that
+ * calling this often costs no AT traffic; it is read again when
+ * the network sends a time update, when the module is powered on
+ * or rebooted and after CELLULAR_CFG_CTRL_TIME_UTC_CACHE_SECONDS.
  *
  * @return  on success the Unix UTC time, else negative error code.
  */
@@ -941,6 +1497,106 @@ int32_t cellularSecurityEndToEndEncrypt(const void *pDataIn,
                                         void *pDataOut,
                                         size_t dataSizeBytes);
 
+/** Start a streamed end to end encryption, for data that is
+ * too large to encrypt in one go or that is to be written out
+ * as it is encrypted, e.g. straight into a socket or an MQTT
+ * publish.  The plain text passed to
+ * cellularSecurityEndToEndEncryptUpdate() is encrypted in
+ * chunks of CELLULAR_CFG_CTRL_E2E_CHUNK_SIZE_BYTES, the last
+ * chunk being shorter; each chunk of cipher text, which is
+ * CELLULAR_CTRL_END_TO_END_ENCRYPT_HEADER_SIZE_BYTES longer
+ * than its plain text, is passed to pOutput as soon as the
+ * module has returned it.  cellularSecurityEndToEndEncryptFinal()
+ * must be called to finish, even if an error has occurred.
+ *
+ * @param pStream      a place to keep the state of the stream;
+ *                     cannot be NULL.
+ * @param pOutput      the function to call with each chunk of
+ *                     cipher text; it is called with the AT
+ *                     interface unlocked so it may, for instance,
+ *                     call cellularSockWrite().  It should
+ *                     return zero or a positive value on
+ *                     success, else the stream is stopped and
+ *                     the negative value returned by the next
+ *                     call.  Cannot be NULL.
+ * @param pOutputParam a parameter to pass to pOutput, may be
+ *                     NULL.
+ * @return             zero on success else negative error code.
+ */
+int32_t cellularSecurityEndToEndEncryptInit(CellularSecurityEndToEndEncryptStream_t *pStream,
+                                            int32_t (*pOutput) (const void *,
+                                                                size_t,
+                                                                void *),
+                                            void *pOutputParam);
+
+/** Add plain text to a streamed end to end encryption; any
+ * full chunks are encrypted and passed to the output function
+ * before this returns, the remainder is held back.
+ *
+ * @param pStream       the stream.
+ * @param pData         the plain text.
+ * @param dataSizeBytes the number of bytes at pData.
+ * @return              zero on success else negative error code.
+ */
+int32_t cellularSecurityEndToEndEncryptUpdate(CellularSecurityEndToEndEncryptStream_t *pStream,
+                                              const void *pData,
+                                              size_t dataSizeBytes);
+
+/** Finish a streamed end to end encryption: any plain text
+ * held back is encrypted and passed to the output function
+ * and the stream is closed.
+ *
+ * @param pStream the stream.
+ * @return        on success the total number of bytes of cipher
+ *                text passed to the output function, else
+ *                negative error code.
+ */
+int32_t cellularSecurityEndToEndEncryptFinal(CellularSecurityEndToEndEncryptStream_t *pStream);
+
+/** Store a security credential, e.g. a certificate or a
+ * private key, in the module, replacing any existing credential
+ * of the same type and name.  The credential can then be
+ * referred to by name in a security profile, see
+ * cellularCtrlSecurityProfileSet().
+ *
+ * @param type      the type of credential.
+ * @param pNameStr  the NULL terminated name to store the
+ *                  credential under; cannot be NULL.
+ * @param pData     the credential, PEM or DER format; cannot
+ *                  be NULL.
+ * @param sizeBytes the number of bytes at pData.
+ * @return          zero on success else negative error code.
+ */
+int32_t cellularCtrlSecurityCredentialStore(CellularCtrlSecurityCredential_t type,
+                                            const char *pNameStr,
+                                            const char *pData,
+                                            size_t sizeBytes);
+
+/** Remove a security credential from the module.
+ *
+ * @param type     the type of credential.
+ * @param pNameStr the NULL terminated name the credential was
+ *                 stored under; cannot be NULL.
+ * @return         zero on success else negative error code.
+ */
+int32_t cellularCtrlSecurityCredentialRemove(CellularCtrlSecurityCredential_t type,
+                                             const char *pNameStr);
+
+/** Set up a security profile in the module, which can then be
+ * used for TLS by the module, e.g. with the socket option
+ * CELLULAR_SOCK_OPT_SECURE_PROFILE or with
+ * cellularMqttSetSecurityOn().  The profile is first reset to
+ * the module's defaults.
+ *
+ * @param profileId the security profile, 0 to
+ *                  CELLULAR_CTRL_SECURITY_PROFILE_MAX_NUM - 1.
+ * @param pProfile  the settings; may be NULL, in which case the
+ *                  profile is just reset.
+ * @return          zero on success else negative error code.
+ */
+int32_t cellularCtrlSecurityProfileSet(int32_t profileId,
+                                       const CellularCtrlSecurityProfile_t *pProfile);
+
 #ifdef __cplusplus
 }
 #endif
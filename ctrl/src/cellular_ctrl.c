@@ -20,11 +20,15 @@
  * cellular_port* to maintain portability.
  */
 
+// The log level threshold of this module, see cellular_port_debug.h.
+#define CELLULAR_PORT_LOG_THRESHOLD CELLULAR_CFG_LOG_LEVEL_CTRL
+
 #ifdef CELLULAR_CFG_OVERRIDE
 # include "cellular_cfg_override.h" // For a customer's configuration override
 #endif
 #include "cellular_cfg_sw.h"
 #include "cellular_cfg_module.h"
+#include "cellular_cfg_os_platform_specific.h"
 #include "cellular_port_clib.h"
 #include "cellular_port.h"
 #include "cellular_port_debug.h"
@@ -32,6 +36,7 @@
 #include "cellular_port_gpio.h"
 #include "cellular_port_uart.h"
 #include "cellular_ctrl_at.h"
+#include "cellular_ctrl_cmux.h"
 #include "cellular_ctrl_apn_db.h"
 #include "cellular_ctrl.h"
 
@@ -54,6 +59,95 @@
  */
 #define CELLULAR_CTRL_MAX_NUM_CONTEXTS 7
 
+/** How long to wait for a registration URC before checking
+ * the keep-going callback again.
+ */
+#define CELLULAR_CTRL_REG_EVENT_WAIT_MS 1000
+
+/** The maximum length of the user name or password given
+ * to cellularCtrlConnectAsync(), including room for a NULL
+ * terminator.
+ */
+#define CELLULAR_CTRL_CONNECT_ASYNC_CREDENTIAL_LENGTH (64 + 1)
+
+/** The number of times to check for attach and the
+ * interval between checks.
+ */
+#define CELLULAR_CTRL_ATTACH_ATTEMPTS 10
+#define CELLULAR_CTRL_ATTACH_INTERVAL_MS 1000
+
+/** The AT timeout to use when polling the module to find out
+ * if it has finished booting.
+ */
+#define CELLULAR_CTRL_BOOT_POLL_TIMEOUT_MS 500
+
+/** The gap between polls of the module while it is booting.
+ */
+#define CELLULAR_CTRL_BOOT_POLL_INTERVAL_MS 100
+
+/** The AT timeout to use when checking if the module answers
+ * again during recovery of the AT link; cellular_ctrl_at_sync()
+ * makes up to ten attempts.
+ */
+#define CELLULAR_CTRL_RECOVERY_SYNC_TIMEOUT_MS 300
+
+/** How long to leave after changing baud rate for the
+ * dust to settle before talking to the module again.
+ */
+#define CELLULAR_CTRL_BAUD_RATE_SETTLE_MS 100
+
+/** The number of times to poke the module when looking
+ * for it at the baud rate it is not expected to be on.
+ */
+#define CELLULAR_CTRL_IS_ALIVE_ATTEMPTS_BAUD_RATE 2
+
+/** The CMUX channel that the AT client is moved on to when
+ * CMUX is started.
+ */
+#define CELLULAR_CTRL_CMUX_CHANNEL_AT 1
+
+#ifndef CELLULAR_CTRL_URING_MODE
+/** The AT+URING mode used while the ring indicator line of the
+ * module is in use: 1 pulses RI on every URC.
+ */
+# define CELLULAR_CTRL_URING_MODE 1
+#endif
+
+/** The size of the identity cache entries for the manufacturer,
+ * model and firmware version strings, including the terminator;
+ * longer strings are simply not cached.
+ */
+#define CELLULAR_CTRL_ID_CACHE_STRING_SIZE 32
+
+/** The ID under which the last-known-good connection settings are
+ * kept in non-volatile storage.
+ */
+#define CELLULAR_CTRL_NV_ID_LAST_GOOD 0
+
+/** The version of CellularCtrlLastGood_t: change this if the
+ * structure changes so that an old one in non-volatile storage
+ * is ignored.
+ */
+#define CELLULAR_CTRL_LAST_GOOD_VERSION 2
+
+/** The most band masks band learning will try in one call to
+ * cellularCtrlConnect(): that of the band of the last connection,
+ * that of all the bands learnt and then the wide one.
+ */
+#define CELLULAR_CTRL_BAND_LEARNING_MAX_NUM_STAGES 3
+
+/** The commands that wake the task of the transmit scheduler.
+ */
+#define CELLULAR_CTRL_TX_SCHEDULER_WAKE  0
+#define CELLULAR_CTRL_TX_SCHEDULER_FLUSH 1
+#define CELLULAR_CTRL_TX_SCHEDULER_EXIT  2
+
+/** The length of the queue of the transmit scheduler: since a
+ * wake and a flush are never queued twice there is always room
+ * for each command.
+ */
+#define CELLULAR_CTRL_TX_SCHEDULER_QUEUE_LENGTH 3
+
 /* ----------------------------------------------------------------
  * TYPES
  * -------------------------------------------------------------- */
@@ -73,6 +167,117 @@ typedef struct {
     const char *pResponseStr;
 } CellularCtrlRegTypes_t;
 
+/** Cache of the identity strings that don't change while the
+ * module is powered; an empty string means "not cached".
+ */
+typedef struct {
+    char imei[CELLULAR_CTRL_IMEI_SIZE + 1];
+    char imsi[CELLULAR_CTRL_IMSI_SIZE + 1];
+    char iccid[CELLULAR_CTRL_ICCID_BUFFER_SIZE];
+    char manufacturer[CELLULAR_CTRL_ID_CACHE_STRING_SIZE];
+    char model[CELLULAR_CTRL_ID_CACHE_STRING_SIZE];
+    char firmwareVersion[CELLULAR_CTRL_ID_CACHE_STRING_SIZE];
+} CellularCtrlIdCache_t;
+
+/** Cache of the UTC time, see cellularCtrlGetTimeUtc().
+ */
+typedef struct {
+    bool valid;
+    int32_t timeUtc;   //!< the time when it was read...
+    int64_t tickMs;    //!< ...and the tick time at that point.
+    volatile int32_t updateCount; //!< count of NITZ updates.
+} CellularCtrlTimeCache_t;
+
+/** The state of an asynchronous connection attempt, see
+ * cellularCtrlConnectAsync().
+ */
+typedef struct {
+    volatile CellularCtrlConnectState_t state;
+    volatile bool cancel;
+    bool stateEntered; //!< false on the first step in a state.
+    int64_t stopTimeMs;
+    int64_t lastEventTimeMs;
+    int32_t regType;
+    size_t count;
+    char imsi[CELLULAR_CTRL_IMSI_SIZE];
+    bool imsiValid;
+    char apn[CELLULAR_CTRL_APN_LENGTH];
+    char username[CELLULAR_CTRL_CONNECT_ASYNC_CREDENTIAL_LENGTH];
+    char password[CELLULAR_CTRL_CONNECT_ASYNC_CREDENTIAL_LENGTH];
+    const char *pApnConfig; //!< APN database entries still to try.
+    const char *pApn;       //!< the APN being tried, NULL for the network default.
+    const char *pUsername;
+    const char *pPassword;
+    void (*pCallback) (CellularCtrlConnectState_t, int32_t, void *);
+    void *pCallbackParam;
+} CellularCtrlConnectAsync_t;
+
+/** The rungs of the ladder climbed when the AT link stops
+ * answering, see atTimeoutCallback(), mildest first.
+ */
+typedef enum {
+    CELLULAR_CTRL_RECOVERY_STATE_IDLE = 0,
+    CELLULAR_CTRL_RECOVERY_STATE_SYNC,       //!< flush and synchronise.
+    CELLULAR_CTRL_RECOVERY_STATE_ESCAPE,     //!< escape from a data mode.
+    CELLULAR_CTRL_RECOVERY_STATE_REBOOT,     //!< cellularCtrlReboot().
+    CELLULAR_CTRL_RECOVERY_STATE_POWER_CYCLE //!< cellularCtrlHardPowerOff() then on.
+} CellularCtrlRecoveryState_t;
+
+/** The settings of the last successful connection.
+ */
+typedef struct {
+    int32_t version; //!< CELLULAR_CTRL_LAST_GOOD_VERSION when valid.
+    char imsi[CELLULAR_CTRL_IMSI_SIZE];
+    char mccMnc[7]; //!< Numeric operator, e.g. "234010".
+    int32_t accessTechnology; //!< The <AcT> from AT+COPS?.
+    int32_t earfcn;
+    int32_t cellId;
+    char apn[CELLULAR_CTRL_APN_LENGTH]; //!< Empty for the network default.
+    int32_t bandRat; //!< The RAT the band masks below are for, -1 if none.
+    uint64_t bandMaskLast[2];    //!< The band of the last connection.
+    uint64_t bandMaskLearnt[2];  //!< All the bands connections were made on.
+    uint64_t bandMaskWide[2];    //!< The band mask before it was narrowed.
+    uint64_t bandMaskApplied[2]; //!< The band mask band learning last set.
+} CellularCtrlLastGood_t;
+
+/** A range of downlink EARFCNs and the E-UTRA band it is in.
+ */
+typedef struct {
+    int32_t band;
+    int32_t earfcnFirst;
+    int32_t earfcnLast;
+} CellularCtrlEarfcnRange_t;
+
+/** A send held back by the transmit scheduler; the data follows
+ * the structure in the same allocation.
+ */
+typedef struct CellularCtrlTxSchedulerEntry_t {
+    int32_t (*pSend) (const void *, size_t, void *);
+    void *pSendParam;
+    int64_t deadlineMs;
+    size_t dataSizeBytes;
+    struct CellularCtrlTxSchedulerEntry_t *pNext;
+} CellularCtrlTxSchedulerEntry_t;
+
+/** The state of the transmit scheduler, see
+ * cellularCtrlTxSchedulerStart().
+ */
+typedef struct {
+    CellularPortMutexHandle_t mutex; //!< protects everything below it.
+    CellularPortMutexHandle_t mutexTaskRunning;
+    CellularPortTaskHandle_t taskHandle;
+    CellularPortQueueHandle_t queue;
+    bool running;      //!< true while sends may be held back.
+    bool wakePending;  //!< true while a wake is on the queue.
+    bool flushPending; //!< true while a flush is on the queue.
+    CellularCtrlTxSchedulerEntry_t *pFirst;
+    CellularCtrlTxSchedulerEntry_t *pLast;
+    size_t pendingBytes;
+    int32_t rsrpThresholdDbm;
+    int32_t snrThresholdDb;
+    int64_t checkIntervalMs;
+} CellularCtrlTxScheduler_t;
+
 /* ----------------------------------------------------------------
  * VARIABLES
  * -------------------------------------------------------------- */
@@ -95,11 +300,24 @@ static int32_t gPinPwrOn;
  */
 static int32_t gPinVInt;
 
+/** The GPIO pin connected to the RI output of the cellular
+ * module, -1 if RI is not in use.
+ */
+static int32_t gPinRi = -1;
+
 /** The UART number we will be using to talk to the
  * cellular module.
  */
 static int32_t gUart;
 
+/** The event queue of the UART, needed to start CMUX.
+ */
+static CellularPortQueueHandle_t gQueueUart;
+
+/** The baud rate the UART is currently running at.
+ */
+static int32_t gBaudRate;
+
 /** The number of consecutive timeouts on the AT interface.
  */
 static int32_t gAtNumConsecutiveTimeouts;
@@ -108,6 +326,60 @@ static int32_t gAtNumConsecutiveTimeouts;
  */
 static CellularCtrlNetworkStatus_t gNetworkStatus[CELLULAR_CTRL_MAX_NUM_RANS];
 
+/** Queue, of length one, which the registration URCs use to let
+ * tryConnect() know that the network status has changed.
+ */
+static CellularPortQueueHandle_t gQueueRegEvent = NULL;
+
+/** Set when an event is waiting on gQueueRegEvent so that a URC
+ * never blocks trying to send another.
+ */
+static volatile bool gRegEventPending = false;
+
+/** The settings of the last successful connection.
+ */
+static CellularCtrlLastGood_t gLastGood;
+
+/** Whether band learning is on, see cellularCtrlSetBandLearning().
+ */
+static bool gBandLearning = false;
+
+/** The keep-going callback of the application while band
+ * learning is trying a narrowed band mask.
+ */
+static bool (*gpBandLearningKeepGoingCallback) (void) = NULL;
+
+/** The time at which band learning gives up on a narrowed
+ * band mask.
+ */
+static int64_t gBandLearningStopTimeMs;
+
+/** The identity cache.
+ */
+static CellularCtrlIdCache_t gIdCache;
+
+/** The UTC time cache.
+ */
+static CellularCtrlTimeCache_t gTimeCache;
+
+/** The asynchronous connection attempt.
+ */
+static CellularCtrlConnectAsync_t gConnectAsync;
+
+/** How far the recovery of the AT link has got.
+ */
+static volatile CellularCtrlRecoveryState_t gRecoveryState = CELLULAR_CTRL_RECOVERY_STATE_IDLE;
+
+/** Set while the module is on and configured, when a run of AT
+ * timeouts means that it has stopped answering rather than that
+ * it is off or still booting.
+ */
+static volatile bool gRecoveryArmed = false;
+
+/** The transmit scheduler.
+ */
+static CellularCtrlTxScheduler_t gTxScheduler = {NULL};
+
 /** The RSSI of the serving cell.
  */
 static int32_t gRssiDbm;
@@ -181,6 +453,111 @@ static const int32_t gRssiConvertLte[] = {-118, -115, -113, -110, -108, -105, -1
                                           -78,  -76,  -74,  -73,  -71,  -69,  -68,  -65,   /* 16 - 23 */
                                           -63,  -61,  -60,  -59,  -58,  -55,  -53,  -48};  /* 24 - 31 */
 
+/** The multipliers, in seconds, of the units of a 3GPP "GPRS Timer 3"
+ * (3GPP TS 24.008 table 10.5.163a), as used for the requested
+ * periodic TAU (T3412 extended) in AT+CPSMS, indexed by the unit
+ * bits; -1 marks "deactivated".
+ */
+static const int32_t gGprsTimer3UnitSeconds[] = {600,     // 000: 10 minutes
+                                                 3600,    // 001: 1 hour
+                                                 36000,   // 010: 10 hours
+                                                 2,       // 011: 2 seconds
+                                                 30,      // 100: 30 seconds
+                                                 60,      // 101: 1 minute
+                                                 1152000, // 110: 320 hours
+                                                 -1};     // 111: deactivated
+
+/** As gGprsTimer3UnitSeconds[] but for a "GPRS Timer 2"
+ * (3GPP TS 24.008 table 10.5.163), as used for the requested
+ * active time (T3324) in AT+CPSMS.
+ */
+static const int32_t gGprsTimer2UnitSeconds[] = {2,    // 000: 2 seconds
+                                                 60,   // 001: 1 minute
+                                                 360,  // 010: decihours
+                                                 -1,   // 011: as 001
+                                                 -1,   // 100: as 001
+                                                 -1,   // 101: as 001
+                                                 -1,   // 110: as 001
+                                                 -1};  // 111: deactivated
+
+/** The eDRX cycle lengths, in milliseconds, for each of the
+ * sixteen values of the 4-bit eDRX value for E-UTRAN
+ * (3GPP TS 24.008 table 10.5.5.32).
+ */
+static const int32_t gEdrxCycleMs[] = {5120, 10240, 20480, 40960,
+                                       61440, 81920, 102400, 122880,
+                                       143360, 163840, 327680, 655360,
+                                       1310720, 2621440, 5242880, 10485760};
+
+/** The <AcT-type> used by AT+CEDRXS for each RAT,
+ * -1 where eDRX is not supported.
+ */
+static const int8_t gCedrxsActTypeForRat[] = {-1, // CELLULAR_CTRL_RAT_UNKNOWN_OR_NOT_USED
+                                              2,  // CELLULAR_CTRL_RAT_GPRS
+                                              3,  // CELLULAR_CTRL_RAT_UMTS
+                                              4,  // CELLULAR_CTRL_RAT_LTE
+                                              4,  // CELLULAR_CTRL_RAT_CATM1
+                                              5}; // CELLULAR_CTRL_RAT_NB1
+
+/** The capability and timing profiles of the modules that
+ * this driver knows about, matched against the start of the
+ * AT+CGMM response, more specific prefixes first.  The values
+ * here must be kept in step with cellular_cfg_module.h.
+ */
+static const CellularCtrlModuleProfile_t gModuleProfiles[] = {
+    {CELLULAR_CTRL_MODULE_TYPE_SARA_R5, "SARA-R5",
+     1500,   // pwrOnPullTimeMs
+     2000,   // pwrOffPullTimeMs
+     8000,   // commandTimeoutMs
+     5000,   // commandMinimumResponseTimeMs
+     5000,   // bootWaitTimeMs
+     20,     // powerDownWaitSeconds
+     15000,  // rebootCommandWaitTimeMs
+     16,     // rebootCfun: SARA-R5 doesn't support 15
+     1,      // maxNumSimultaneousRats
+     0x08UL, // supportedRatsBitmap
+     2,      // ucgedMode
+     4,      // maxNumActiveContexts
+     true,   // contextNeedsInternalProfile
+     true,   // securityRootOfTrust
+     true,   // securitySealNeedsApn
+     50,     // sockPromptGuardTimeMs
+     true,   // mqttIsSupported
+     false,  // mqttSaraR4Syntax
+     true,   // mqttBinaryPublishIsSupported
+     1024,   // mqttPublishMaxLengthBytes
+     false,  // mqttPublishFileIsSupported
+     false,  // mqttLocalPortIsSupported
+     false,  // mqttSessionCleanIsSupported
+     1024,   // mqttReadMessageMaxLengthBytes
+     1024},  // mqttReadTopicMaxLengthBytes
+    {CELLULAR_CTRL_MODULE_TYPE_SARA_R412M_02B, "SARA-R412M-02B",
+     300, 2000, 8000, 2000, 6000, 35, 10000, 15, 3, 0x19UL, 5, 1, false,
+     false, // securityRootOfTrust
+     false, 50, true, true, false, 64, true, true, true, 1024, 1024},
+    {CELLULAR_CTRL_MODULE_TYPE_SARA_R412M_03B, "SARA-R412M-03B",
+     300, 2000, 8000, 2000, 6000, 35, 10000, 15, 3, 0x19UL, 5, 1, false,
+     true,  // securityRootOfTrust
+     false, 50, true, true, false, 64, true, true, true, 1024, 1024}
+};
+
+/** The profile of the module in use, starting with the
+ * one this code was built for.
+ */
+static const CellularCtrlModuleProfile_t *gpModuleProfile =
+#if defined(CELLULAR_CFG_MODULE_SARA_R5)
+    &(gModuleProfiles[0]);
+#elif defined(CELLULAR_CFG_MODULE_SARA_R412M_02B)
+    &(gModuleProfiles[1]);
+#else
+    &(gModuleProfiles[2]);
+#endif
+
+/** SNR in dB, rounded towards zero, for a difference between
+ * RSSI and RSRP of 1 to 6 dB (the first entry is not used).
+ */
+static const int8_t gSnrDbForSmallDifference[] = {0, 5, 2, 0, -1, -3, -4};
+
 /** Array to convert the RAT emitted by AT+COPS to one of our RATs.
  */
 static const CellularCtrlRat_t gCopsRatToCellularRat[] = {CELLULAR_CTRL_RAT_GPRS,                // 0: GSM
@@ -209,6 +586,41 @@ static const CellularCtrlRan_t gRanForRat[] = {CELLULAR_CTRL_RAN_UNKNOWN_OR_NOT_
                                                CELLULAR_CTRL_RAN_EUTRAN,              // CELLULAR_CTRL_RAT_CATM1
                                                CELLULAR_CTRL_RAN_EUTRAN};             // CELLULAR_CTRL_RAT_NB1
 
+// The downlink EARFCNs of the E-UTRA FDD bands, from 3GPP TS 36.101
+// table 5.7.3-1
+static const CellularCtrlEarfcnRange_t gEarfcnRanges[] = {{1,  0,     599},
+                                                          {2,  600,   1199},
+                                                          {3,  1200,  1949},
+                                                          {4,  1950,  2399},
+                                                          {5,  2400,  2649},
+                                                          {6,  2650,  2749},
+                                                          {7,  2750,  3449},
+                                                          {8,  3450,  3799},
+                                                          {9,  3800,  4149},
+                                                          {10, 4150,  4749},
+                                                          {11, 4750,  4949},
+                                                          {12, 5010,  5179},
+                                                          {13, 5180,  5279},
+                                                          {14, 5280,  5379},
+                                                          {17, 5730,  5849},
+                                                          {18, 5850,  5999},
+                                                          {19, 6000,  6149},
+                                                          {20, 6150,  6449},
+                                                          {21, 6450,  6599},
+                                                          {24, 7700,  8039},
+                                                          {25, 8040,  8689},
+                                                          {26, 8690,  9039},
+                                                          {27, 9040,  9209},
+                                                          {28, 9210,  9659},
+                                                          {31, 9870,  9919},
+                                                          {66, 66436, 67335},
+                                                          {71, 68586, 68935},
+                                                          {72, 68936, 68985},
+                                                          {73, 68986, 69035},
+                                                          {74, 69036, 69465},
+                                                          {85, 70366, 70545}
+                                                         };
+
 /* ----------------------------------------------------------------
  * STATIC FUNCTIONS: URCS AND RELATED FUNCTIONS
  * -------------------------------------------------------------- */
@@ -222,47 +634,47 @@ static void setNetworkStatus(int32_t status, CellularCtrlRan_t ran)
         case 0:
         case 2:
             // Not (yet) registered
-            cellularPortLog("%d: NReg\n", ran);
+            cellularPortLogDebug("%d: NReg\n", ran);
         break;
         case 1:
             // Registered on the home network
-            cellularPortLog("%d: RegH\n", ran);
+            cellularPortLogDebug("%d: RegH\n", ran);
         break;
         case 3:
             // Registeration denied
-            cellularPortLog("%d: Deny\n", ran);
+            cellularPortLogDebug("%d: Deny\n", ran);
         break;
         case 4:
             // Out of coverage
-            cellularPortLog("%d: OoC\n", ran);
+            cellularPortLogDebug("%d: OoC\n", ran);
         break;
         case 5:
             // Registered on a roaming network
-            cellularPortLog("%d: RegR\n", ran);
+            cellularPortLogDebug("%d: RegR\n", ran);
         break;
         case 6:
             // Registered for SMS only on the home network
-            cellularPortLog("%d: RegS\n", ran);
+            cellularPortLogDebug("%d: RegS\n", ran);
         break;
         case 7:
             // Registered for SMS only on a roaming network
-            cellularPortLog("%d: RegS\n", ran);
+            cellularPortLogDebug("%d: RegS\n", ran);
         break;
         case 8:
             // Registered for emergency service only
-            cellularPortLog("%d: RegE\n", ran);
+            cellularPortLogDebug("%d: RegE\n", ran);
         break;
         case 9:
             // Registered for circuit switched fall-back on the home network
-            cellularPortLog("%d: RegC\n", ran);
+            cellularPortLogDebug("%d: RegC\n", ran);
         break;
         case 10:
             // Registered for circuit switched fall-back on a roaming network
-            cellularPortLog("%d: RegC\n", ran);
+            cellularPortLogDebug("%d: RegC\n", ran);
         break;
         default:
             // Unknown registration status
-            cellularPortLog("%d: Unk %d\n", ran, status);
+            cellularPortLogDebug("%d: Unk %d\n", ran, status);
         break;
     }
 
@@ -270,6 +682,14 @@ static void setNetworkStatus(int32_t status, CellularCtrlRan_t ran)
                                    sizeof(gStatus3gppToCellularNetworkStatus[0]))) {
         gNetworkStatus[ran] = gStatus3gppToCellularNetworkStatus[status];
     }
+
+    // Let anyone waiting know that something has changed;
+    // the status is written above first so that a waiter
+    // which has just cleared gRegEventPending will see it
+    if ((gQueueRegEvent != NULL) && !gRegEventPending) {
+        gRegEventPending = true;
+        cellularPortQueueSend(gQueueRegEvent, &ran);
+    }
 }
 
 // Registration on a network (AT+CREG/CGREG/CEREG).
@@ -320,10 +740,160 @@ static void CEREG_urc(void *pUnused)
     CXREG_urc(CELLULAR_CTRL_RAN_EUTRAN);
 }
 
+// The SIM has changed state (AT+USIMSTAT): whatever it was, the
+// SIM-related parts of the identity cache can no longer be relied
+// upon.
+static void UUSIMSTAT_urc(void *pUnused)
+{
+    (void) pUnused;
+
+    gIdCache.imsi[0] = 0;
+    gIdCache.iccid[0] = 0;
+}
+
+// The network has sent a time update (AT+CTZR=2): the time
+// cache is now out of date and the next call to
+// cellularCtrlGetTimeUtc() will read the time again.
+static void CTZE_urc(void *pUnused)
+{
+    (void) pUnused;
+
+    gTimeCache.valid = false;
+    gTimeCache.updateCount++;
+}
+
+// Power saving state (AT+UPSMR).
+static void UUPSMR_urc(void *pUnused)
+{
+    (void) pUnused;
+
+    // 0 means the module has come out of PSM, 1 that
+    // it is entering PSM, 2 that PSM entry was blocked
+    if (cellular_ctrl_at_read_int() == 1) {
+        cellularPortLogDebug("PSM\n");
+        cellular_ctrl_at_set_asleep(true);
+    } else {
+        cellular_ctrl_at_set_asleep(false);
+    }
+}
+
 /* ----------------------------------------------------------------
  * STATIC FUNCTIONS: MISC
  * -------------------------------------------------------------- */
 
+// Empty the identity cache.
+static void idCacheClear()
+{
+    pCellularPort_memset(&gIdCache, 0, sizeof(gIdCache));
+}
+
+// Empty the time cache.
+static void timeCacheClear()
+{
+    gTimeCache.valid = false;
+    gTimeCache.updateCount++;
+}
+
+// Copy a string from the identity cache into a buffer of the
+// given size, truncating it if necessary, and return its length.
+static int32_t idCacheCopy(const char *pCache, char *pStr, size_t size)
+{
+    size_t length = cellularPort_strlen(pCache);
+
+    if (length > size - 1) {
+        length = size - 1;
+    }
+    pCellularPort_memcpy(pStr, pCache, length);
+    *(pStr + length) = 0;
+
+    return (int32_t) length;
+}
+
+// Read the next information response of a pipelined identity
+// query into an identity cache string entry, leaving the entry
+// empty if it could not be read in full.
+static void idCacheReadString(char *pCache)
+{
+    int32_t bytesRead;
+
+    cellular_ctrl_at_resp_next(NULL);
+    // Don't want characters in the string being interpreted
+    // as delimiters
+    cellular_ctrl_at_set_delimiter(0);
+    bytesRead = cellular_ctrl_at_read_string(pCache,
+                                             CELLULAR_CTRL_ID_CACHE_STRING_SIZE,
+                                             false);
+    cellular_ctrl_at_set_default_delimiter();
+    if ((bytesRead <= 0) || (bytesRead >= CELLULAR_CTRL_ID_CACHE_STRING_SIZE - 1)) {
+        *pCache = 0;
+    }
+}
+
+// Fill the identity cache, sending the queries for the module
+// identity on one AT command line and, if withSim is true,
+// those for the SIM identity on another; doing it this way
+// costs two command/response turn-arounds, and two send
+// delays, instead of six.  The cache is only updated for a
+// line where all of the answers arrived.
+static int32_t idCacheFill(bool withSim)
+{
+    CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_AT_ERROR;
+    CellularCtrlIdCache_t cache;
+    int32_t bytesRead;
+
+    pCellularPort_memset(&cache, 0, sizeof(cache));
+    cellular_ctrl_at_lock();
+    cellular_ctrl_at_cmd_start("AT+CGSN");
+    cellular_ctrl_at_cmd_append("+CGMI");
+    cellular_ctrl_at_cmd_append("+CGMM");
+    cellular_ctrl_at_cmd_append("+CGMR");
+    cellular_ctrl_at_cmd_stop();
+    cellular_ctrl_at_resp_next(NULL);
+    bytesRead = cellular_ctrl_at_read_bytes((uint8_t *) cache.imei,
+                                            CELLULAR_CTRL_IMEI_SIZE);
+    idCacheReadString(cache.manufacturer);
+    idCacheReadString(cache.model);
+    idCacheReadString(cache.firmwareVersion);
+    cellular_ctrl_at_resp_stop();
+    if ((cellular_ctrl_at_get_last_error() == 0) &&
+        (bytesRead == CELLULAR_CTRL_IMEI_SIZE) &&
+        (cache.manufacturer[0] != 0) && (cache.model[0] != 0) &&
+        (cache.firmwareVersion[0] != 0)) {
+        errorCode = CELLULAR_CTRL_SUCCESS;
+        pCellularPort_memcpy(gIdCache.imei, cache.imei, sizeof(gIdCache.imei));
+        pCellularPort_memcpy(gIdCache.manufacturer, cache.manufacturer,
+                             sizeof(gIdCache.manufacturer));
+        pCellularPort_memcpy(gIdCache.model, cache.model, sizeof(gIdCache.model));
+        pCellularPort_memcpy(gIdCache.firmwareVersion, cache.firmwareVersion,
+                             sizeof(gIdCache.firmwareVersion));
+    }
+
+    if (withSim && (errorCode == CELLULAR_CTRL_SUCCESS)) {
+        errorCode = CELLULAR_CTRL_AT_ERROR;
+        cellular_ctrl_at_cmd_start("AT+CIMI");
+        cellular_ctrl_at_cmd_append("+CCID");
+        cellular_ctrl_at_cmd_stop();
+        cellular_ctrl_at_resp_next(NULL);
+        bytesRead = cellular_ctrl_at_read_bytes((uint8_t *) cache.imsi,
+                                                CELLULAR_CTRL_IMSI_SIZE);
+        cellular_ctrl_at_resp_next("+CCID:");
+        cellular_ctrl_at_read_string(cache.iccid, sizeof(cache.iccid), false);
+        cellular_ctrl_at_resp_stop();
+        // A (plausibly) complete ICCID is at least 19 digits
+        if ((cellular_ctrl_at_get_last_error() == 0) &&
+            (bytesRead == CELLULAR_CTRL_IMSI_SIZE) &&
+            (cellularPort_strlen(cache.iccid) >= 19) &&
+            (cellularPort_strlen(cache.iccid) < sizeof(cache.iccid))) {
+            errorCode = CELLULAR_CTRL_SUCCESS;
+            pCellularPort_memcpy(gIdCache.imsi, cache.imsi, sizeof(gIdCache.imsi));
+            pCellularPort_memcpy(gIdCache.iccid, cache.iccid, sizeof(gIdCache.iccid));
+        }
+    }
+    cellular_ctrl_at_unlock();
+
+    return (int32_t) errorCode;
+}
+
 // Strip non-printable characters from an ASCII string (not very efficiently).
 // stringLength is the length that strlen() would return, i.e. not including
 // any final terminator.
@@ -347,11 +917,12 @@ static int32_t strip_ctrl(char *pString, int32_t stringLength)
     return numCharsRemoved;
 }
 
-// Callback function to detect the cellular module becoming
-// unresponsive.
-static void atTimeoutCallback(void *pNumConsecutiveTimeouts)
+// Set the network status back to unknown for all RANs.
+static void clearNetworkStatus()
 {
-    gAtNumConsecutiveTimeouts = *((int32_t *) pNumConsecutiveTimeouts);
+    for (size_t x = 0; x < sizeof(gNetworkStatus) / sizeof(gNetworkStatus[0]); x++) {
+        gNetworkStatus[x] = CELLULAR_CTRL_NETWORK_STATUS_UNKNOWN;
+    }
 }
 
 // Set the radio parameters back to defaults.
@@ -364,6 +935,27 @@ static void clearRadioParameters()
     gEarfcn = -1;
 }
 
+// Convert a string with a decimal point, e.g. "-105.50", to
+// the nearest integer without going through floating point.
+static int32_t decimalStrToInt(const char *pStr)
+{
+    int32_t value;
+    char *pEnd = NULL;
+
+    value = cellularPort_strtol(pStr, &pEnd, 10);
+    if ((pEnd != NULL) && (*pEnd == '.') &&
+        (*(pEnd + 1) >= '5') && (*(pEnd + 1) <= '9')) {
+        // Round away from zero, as before
+        if (*pStr == '-') {
+            value--;
+        } else {
+            value++;
+        }
+    }
+
+    return value;
+}
+
 // Check that the cellular module is alive.
 static CellularCtrlErrorCode_t moduleIsAlive(int32_t attempts)
 {
@@ -376,7 +968,7 @@ static CellularCtrlErrorCode_t moduleIsAlive(int32_t attempts)
     // time
     for (uint32_t x = 0; !cellularIsAlive && (x < attempts); x++) {
         cellular_ctrl_at_lock();
-        cellular_ctrl_at_set_at_timeout(CELLULAR_CTRL_COMMAND_MINIMUM_RESPONSE_TIME_MS, false);
+        cellular_ctrl_at_set_at_timeout(gpModuleProfile->commandMinimumResponseTimeMs, false);
         cellular_ctrl_at_cmd_start("AT");
         cellular_ctrl_at_cmd_stop_read_resp();
         cellularIsAlive = (cellular_ctrl_at_get_last_error() == 0);
@@ -392,149 +984,582 @@ static CellularCtrlErrorCode_t moduleIsAlive(int32_t attempts)
     return errorCode;
 }
 
-// Configure one item in the cellular module.
-static bool moduleConfigureOne(int32_t uart,
-                               char *pAtString)
+#if CELLULAR_CFG_BAUD_RATE_HIGH > 0
+// Move the UART at this end to the given baud rate,
+// throwing away anything received at the old rate.
+static void uartBaudRateSet(int32_t baudRate)
+{
+    char buffer[8];
+
+    if (cellularPortUartSetBaudRate(gUart, baudRate) == 0) {
+        gBaudRate = baudRate;
+    }
+    cellularPortTaskBlock(CELLULAR_CTRL_BAUD_RATE_SETTLE_MS);
+    while (cellularPortUartRead(gUart, buffer, sizeof(buffer)) > 0) {}
+}
+
+// Ask the module to move to the given baud rate, move
+// the UART at this end to match and check that the
+// two ends can still talk.
+static bool moduleBaudRateSet(int32_t baudRate)
 {
     bool success = false;
 
     cellular_ctrl_at_lock();
-    cellular_ctrl_at_cmd_start(pAtString);
+    cellular_ctrl_at_cmd_start("AT+IPR=");
+    cellular_ctrl_at_write_int(baudRate);
     cellular_ctrl_at_cmd_stop_read_resp();
     if (cellular_ctrl_at_unlock_return_error() == 0) {
-        success = true;
+        // The OK comes back at the old rate,
+        // the module switches after that
+        uartBaudRateSet(baudRate);
+        success = cellular_ctrl_at_sync(CELLULAR_CTRL_BOOT_POLL_TIMEOUT_MS);
     }
 
     return success;
 }
+#endif
 
-// Configure the cellular module.
-static CellularCtrlErrorCode_t moduleConfigure(int32_t uart)
+// Move the link to CELLULAR_CFG_BAUD_RATE_HIGH, if there is one,
+// falling back to CELLULAR_CFG_BAUD_RATE if that doesn't work.
+static void baudRateEscalate()
 {
-    CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_NOT_CONFIGURED;
-
-    // Configure the module
-    if (moduleConfigureOne(uart, "ATE0") && // Echo off
-        // Extended errors on
-        moduleConfigureOne(uart, "AT+CMEE=2") &&
-        // DCD circuit (109) changes in accordance with the carrier
-        moduleConfigureOne(uart, "AT&C1") &&
-        // Ignore changes to DTR
-        moduleConfigureOne(uart, "AT&D0") &&
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
-        // Switch on channel and environment reporting for EUTRAN
-        moduleConfigureOne(uart, "AT+UCGED=5") &&
-#endif
-        // TODO switch off power saving until it is integrated into this API
-        moduleConfigureOne(uart, "AT+CPSMS=0") && 
-        // TODO switch off UART power saving until it is integrated into this API
-        moduleConfigureOne(uart, "AT+UPSV=0") &&
-        // Stay in airplane mode until commanded to connect
-        moduleConfigureOne(uart, "AT+CFUN=4")) {
-        // TODO: check if AT&K3 requires both directions
-        // of flow control to be on or just one of them
-        if (cellularPortIsRtsFlowControlEnabled(uart) &&
-            cellularPortIsCtsFlowControlEnabled(uart)) {
-            if (moduleConfigureOne(uart, "AT&K3")) { // RTS/CTS handshaking on
-                errorCode = CELLULAR_CTRL_SUCCESS;
-            }
+#if CELLULAR_CFG_BAUD_RATE_HIGH > 0
+    if (gBaudRate != CELLULAR_CFG_BAUD_RATE_HIGH) {
+        if (moduleBaudRateSet(CELLULAR_CFG_BAUD_RATE_HIGH)) {
+            cellularPortLog("CELLULAR_CTRL: UART now running at %d bits/s.\n",
+                            gBaudRate);
         } else {
-            if (moduleConfigureOne(uart, "AT&K0")) { // RTS/CTS handshaking off
-                errorCode = CELLULAR_CTRL_SUCCESS;
+            cellularPortLog("CELLULAR_CTRL: no response at %d bits/s, falling"
+                            " back to %d bits/s.\n", CELLULAR_CFG_BAUD_RATE_HIGH,
+                            CELLULAR_CFG_BAUD_RATE);
+            // The module may or may not have switched: try
+            // the usual rate and, if the module isn't there,
+            // tell it to come back from the high rate
+            uartBaudRateSet(CELLULAR_CFG_BAUD_RATE);
+            if (moduleIsAlive(1) != CELLULAR_CTRL_SUCCESS) {
+                uartBaudRateSet(CELLULAR_CFG_BAUD_RATE_HIGH);
+                cellular_ctrl_at_lock();
+                cellular_ctrl_at_cmd_start("AT+IPR=");
+                cellular_ctrl_at_write_int(CELLULAR_CFG_BAUD_RATE);
+                cellular_ctrl_at_cmd_stop_read_resp();
+                cellular_ctrl_at_unlock();
+                uartBaudRateSet(CELLULAR_CFG_BAUD_RATE);
             }
         }
     }
+#endif
+}
+
+// Check that the cellular module is alive and, if it isn't,
+// look for it at the other baud rate it might be running at:
+// the module may have rebooted to a different rate or this
+// end may have been restarted with the module left at the
+// high rate.
+static CellularCtrlErrorCode_t moduleIsAliveAnyBaudRate(int32_t attempts)
+{
+    CellularCtrlErrorCode_t errorCode = moduleIsAlive(attempts);
+#if CELLULAR_CFG_BAUD_RATE_HIGH > 0
+    int32_t baudRate = gBaudRate;
+
+    if (errorCode != CELLULAR_CTRL_SUCCESS) {
+        if (baudRate == CELLULAR_CFG_BAUD_RATE_HIGH) {
+            uartBaudRateSet(CELLULAR_CFG_BAUD_RATE);
+        } else {
+            uartBaudRateSet(CELLULAR_CFG_BAUD_RATE_HIGH);
+        }
+        errorCode = moduleIsAlive(CELLULAR_CTRL_IS_ALIVE_ATTEMPTS_BAUD_RATE);
+        if (errorCode != CELLULAR_CTRL_SUCCESS) {
+            // Not there either, put things back as they were
+            uartBaudRateSet(baudRate);
+        }
+    }
+#endif
 
     return errorCode;
 }
 
-// Get an ID string from the cellular module.
-static int32_t getString(const char *pCmd, char *pBuffer, size_t bufferSize)
+// Stop CMUX, if it is running, and put the AT client back
+// on the physical UART.  If tellModule is false the module
+// is assumed to have already left CMUX mode, e.g. because
+// it has been powered off or rebooted.
+static void cmuxStop(bool tellModule)
 {
-    CellularCtrlErrorCode_t errorCodeOrSize = CELLULAR_CTRL_NOT_INITIALISED;
-    int32_t bytesRead;
-    int32_t atError;
+    if (cellularCtrlCmuxIsRunning()) {
+        cellular_ctrl_at_lock();
+        cellular_ctrl_at_set_uart(gUart, gQueueUart);
+        // Give the URC task a chance to move off the
+        // virtual UART's event queue before it is deleted
+        cellularPortTaskBlock(100);
+        cellularCtrlCmuxDeinit(tellModule);
+        cellular_ctrl_at_unlock();
+    }
+}
 
-    if (gInitialised) {
-        errorCodeOrSize = CELLULAR_CTRL_INVALID_PARAMETER;
-        if (pBuffer != NULL) {
-            errorCodeOrSize = CELLULAR_CTRL_AT_ERROR;
-            cellular_ctrl_at_lock();
-            cellular_ctrl_at_cmd_start(pCmd);
-            cellular_ctrl_at_cmd_stop();
-            cellular_ctrl_at_resp_start(NULL, false);
-            // Don't want characters in the string being interpreted
-            // as delimiters
-            cellular_ctrl_at_set_delimiter(0);
-            bytesRead = cellular_ctrl_at_read_string(pBuffer, bufferSize, true);
-            cellular_ctrl_at_resp_stop();
-            cellular_ctrl_at_set_default_delimiter();
-            atError = cellular_ctrl_at_unlock_return_error();
-            if ((bytesRead >= 0) && (atError == 0)) {
-                // If it is fully formed (i.e. the provided buffer was long
-                // enough to hold it all) the string will have \r\n\r\n on
-                // the end, remove that here
-                errorCodeOrSize = bytesRead - strip_ctrl(pBuffer, cellularPort_strlen(pBuffer));
-                cellularPortLog("CELLULAR_CTRL: ID string, length %d character(s), returned by %s is \"%s\".\n",
-                                errorCodeOrSize, pCmd, pBuffer);
-            } else {
-                cellularPortLog("CELLULAR_CTRL: unable to read ID string using %s.\n", pCmd);
+// Pick the profile for the module from what AT+CGMM says.
+static void moduleProfileDetect()
+{
+    char buffer[CELLULAR_CTRL_ID_CACHE_STRING_SIZE];
+    const CellularCtrlModuleProfile_t *pProfile = NULL;
+
+    // Fetch the module identity in one go while we're here,
+    // the model string then comes from the cache
+    idCacheFill(false);
+    pCellularPort_memset(buffer, 0, sizeof(buffer));
+    if (cellularCtrlGetModelStr(buffer, sizeof(buffer)) > 0) {
+        for (size_t x = 0; (pProfile == NULL) &&
+                           (x < sizeof(gModuleProfiles) / sizeof(gModuleProfiles[0])); x++) {
+            if (cellularPort_memcmp(buffer, gModuleProfiles[x].pModelPrefix,
+                                    cellularPort_strlen(gModuleProfiles[x].pModelPrefix)) == 0) {
+                pProfile = &(gModuleProfiles[x]);
             }
         }
+        if (pProfile == NULL) {
+            cellularPortLog("CELLULAR_CTRL: module \"%s\" is not known, using"
+                            " the profile for module type %d.\n", buffer,
+                            gpModuleProfile->moduleType);
+        } else if (pProfile != gpModuleProfile) {
+            // Buffer sizes and what is built in still come
+            // from the module type this code was built for
+            cellularPortLog("CELLULAR_CTRL: module is \"%s\", not the module"
+                            " type (%d) this code was built for, switching to"
+                            " its profile.\n", buffer, gpModuleProfile->moduleType);
+            gpModuleProfile = pProfile;
+        }
     }
-
-    return (int32_t) errorCodeOrSize;
 }
 
-// Prepare for connection with the network.
-static bool prepareConnect()
+// Configure one item in the cellular module.
+static bool moduleConfigureOne(int32_t uart,
+                               char *pAtString)
 {
     bool success = false;
-    int32_t status;
-
-    cellularPortLog("CELLULAR_CTRL: preparing to connect...\n");
-    // Make sure URC handler is registered
-    cellular_ctrl_at_set_urc_handler("+CREG:", CREG_urc, NULL);
-    cellular_ctrl_at_set_urc_handler("+CGREG:", CGREG_urc, NULL);
-    cellular_ctrl_at_set_urc_handler("+CEREG:", CEREG_urc, NULL);
 
-    // Switch on the unsolicited result codes for registration
     cellular_ctrl_at_lock();
-    cellular_ctrl_at_cmd_start("AT+CREG=1");
+    cellular_ctrl_at_cmd_start(pAtString);
     cellular_ctrl_at_cmd_stop_read_resp();
     if (cellular_ctrl_at_unlock_return_error() == 0) {
-        cellular_ctrl_at_lock();
-        cellular_ctrl_at_cmd_start("AT+CGREG=1");
-        cellular_ctrl_at_cmd_stop_read_resp();
-        if (cellular_ctrl_at_unlock_return_error() == 0) {
-            cellular_ctrl_at_lock();
-            cellular_ctrl_at_cmd_start("AT+CEREG=1");
-            cellular_ctrl_at_cmd_stop_read_resp();
-            if (cellular_ctrl_at_unlock_return_error() == 0) {
-                cellular_ctrl_at_lock();
-                // See if we are already in automatic mode
-                cellular_ctrl_at_cmd_start("AT+COPS?");
-                cellular_ctrl_at_cmd_stop();
-                cellular_ctrl_at_resp_start("+COPS:", false);
-                status = cellular_ctrl_at_read_int();
-                cellular_ctrl_at_resp_stop();
-                if (cellular_ctrl_at_unlock_return_error() == 0) {
-                    if (status != 0) {
-                        // If we aren't, set it
-                        cellular_ctrl_at_lock();
-                        cellular_ctrl_at_cmd_start("AT+COPS=0");
-                        cellular_ctrl_at_cmd_stop_read_resp();
-                        if (cellular_ctrl_at_unlock_return_error() == 0) {
-                            success = true;
+        success = true;
+    }
+
+    return success;
+}
+
+// Return the single command line that sets everything which
+// only lives in the active profile and so has to be sent every
+// time the module boots: echo off, DCD circuit (109) changes in
+// accordance with the carrier, ignore changes to DTR, RTS/CTS
+// handshaking on or off and extended errors on.
+static const char *pVolatileConfigStr(int32_t uart)
+{
+    const char *pStr = "ATE0&C1&D0&K0+CMEE=2";
+
+    // TODO: check if AT&K3 requires both directions
+    // of flow control to be on or just one of them
+    if (cellularPortIsRtsFlowControlEnabled(uart) &&
+        cellularPortIsCtsFlowControlEnabled(uart)) {
+        pStr = "ATE0&C1&D0&K3+CMEE=2";
+    }
+
+    return pStr;
+}
+
+// Configure the cellular module.
+// Tell the module whether to pulse its RI line when it has
+// a URC to send.
+static int32_t ringIndicatorConfigure(bool onNotOff)
+{
+    cellular_ctrl_at_lock();
+    cellular_ctrl_at_cmd_start("AT+URING=");
+    cellular_ctrl_at_write_int(onNotOff ? CELLULAR_CTRL_URING_MODE : 0);
+    cellular_ctrl_at_cmd_stop_read_resp();
+    return cellular_ctrl_at_unlock_return_error();
+}
+
+static CellularCtrlErrorCode_t moduleConfigure(int32_t uart)
+{
+    CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_NOT_CONFIGURED;
+    bool success;
+    bool flowControlOn;
+    int32_t upsv;
+    int32_t cfun;
+
+    flowControlOn = cellularPortIsRtsFlowControlEnabled(uart) &&
+                    cellularPortIsCtsFlowControlEnabled(uart);
+
+    // Get onto the fastest baud rate available
+    // before doing anything else
+    baudRateEscalate();
+
+    // First the settings which only live in the active profile,
+    // and so have to be sent every time, all on one command line
+    success = moduleConfigureOne(uart, (char *) pVolatileConfigStr(uart));
+    if (!success) {
+        // Do it the long way in case the module didn't like that
+        success = moduleConfigureOne(uart, "ATE0") &&
+                  moduleConfigureOne(uart, "AT+CMEE=2") &&
+                  moduleConfigureOne(uart, "AT&C1") &&
+                  moduleConfigureOne(uart, "AT&D0") &&
+                  moduleConfigureOne(uart, flowControlOn ? "AT&K3" : "AT&K0");
+    }
+
+    if (success) {
+        // With echo off the module can be asked what it is,
+        // which decides the rest
+        moduleProfileDetect();
+        if (gpModuleProfile->ucgedMode == 5) {
+            // Switch on channel and environment reporting
+            // for EUTRAN; this also only lives in the
+            // active profile
+            success = moduleConfigureOne(uart, "AT+UCGED=5");
+        }
+    }
+
+    if (success) {
+        // Ask for +UUSIMSTAT URCs so that the identity cache can be
+        // cleared if the SIM changes; not fatal if this fails, the
+        // cache is cleared on every power-on and reboot anyway
+        moduleConfigureOne(uart, "AT+USIMSTAT=1");
+        // Ask for +CTZE URCs so that the time cache is refreshed
+        // when the network sends the time; if this fails the
+        // cache just ages out instead
+        moduleConfigureOne(uart, "AT+CTZR=2");
+        // Likewise, RI goes back to being quiet after a power cycle
+        if (gPinRi >= 0) {
+            ringIndicatorConfigure(true);
+        }
+        // The rest are kept by the module in non-volatile memory
+        // and changing them has more of an effect, so read them
+        // all in one go and only write those that are different
+        cellular_ctrl_at_lock();
+        // Note: 3GPP power saving (AT+CPSMS) is left alone,
+        // that is up to cellularCtrlSetPsm()
+        cellular_ctrl_at_cmd_start("AT+UPSV?;+CFUN?");
+        cellular_ctrl_at_cmd_stop();
+        cellular_ctrl_at_resp_start("+UPSV:", false);
+        upsv = cellular_ctrl_at_read_int();
+        cellular_ctrl_at_resp_start("+CFUN:", false);
+        cfun = cellular_ctrl_at_read_int();
+        cellular_ctrl_at_resp_stop();
+        if (cellular_ctrl_at_unlock_return_error() != 0) {
+            upsv = -1;
+            cfun = -1;
+        }
+        // TODO switch off UART power saving until it is integrated into this API
+        if (((upsv == 0) || moduleConfigureOne(uart, "AT+UPSV=0")) &&
+            // Stay in airplane mode until commanded to connect
+            ((cfun == 4) || moduleConfigureOne(uart, "AT+CFUN=4"))) {
+            errorCode = CELLULAR_CTRL_SUCCESS;
+        }
+    }
+
+    return errorCode;
+}
+
+// Poll the module with "AT", using a short AT timeout, until it
+// answers (if alive is true) or stops answering (if alive is
+// false), giving up after timeoutMs; returns true if it got there.
+// This is used instead of a fixed wait when the module is booting.
+static bool waitForAlive(bool alive, int32_t timeoutMs)
+{
+    int64_t startTimeMs = cellularPortGetTickTimeMs();
+    bool isAlive = !alive;
+
+    while ((isAlive != alive) &&
+           (cellularPortGetTickTimeMs() - startTimeMs < timeoutMs)) {
+        cellular_ctrl_at_lock();
+        cellular_ctrl_at_set_at_timeout(CELLULAR_CTRL_BOOT_POLL_TIMEOUT_MS, false);
+        cellular_ctrl_at_cmd_start("AT");
+        cellular_ctrl_at_cmd_stop_read_resp();
+        isAlive = (cellular_ctrl_at_get_last_error() == 0);
+        cellular_ctrl_at_clear_error();
+        cellular_ctrl_at_restore_at_timeout();
+        cellular_ctrl_at_unlock();
+        if (isAlive != alive) {
+            cellularPortTaskBlock(CELLULAR_CTRL_BOOT_POLL_INTERVAL_MS);
+        }
+    }
+
+    return (isAlive == alive);
+}
+
+// Get an ID string from the cellular module.
+// pCache is the entry in the identity cache for the string,
+// CELLULAR_CTRL_ID_CACHE_STRING_SIZE bytes long.
+static int32_t getString(const char *pCmd, char *pBuffer, size_t bufferSize,
+                         char *pCache)
+{
+    CellularCtrlErrorCode_t errorCodeOrSize = CELLULAR_CTRL_NOT_INITIALISED;
+    int32_t bytesRead;
+    int32_t atError;
+    int32_t stripped;
+
+    if (gInitialised) {
+        errorCodeOrSize = CELLULAR_CTRL_INVALID_PARAMETER;
+        if ((pBuffer != NULL) && (bufferSize > 0) && (*pCache != 0)) {
+            errorCodeOrSize = idCacheCopy(pCache, pBuffer, bufferSize);
+        } else if (pBuffer != NULL) {
+            errorCodeOrSize = CELLULAR_CTRL_AT_ERROR;
+            cellular_ctrl_at_lock();
+            cellular_ctrl_at_cmd_start(pCmd);
+            cellular_ctrl_at_cmd_stop();
+            cellular_ctrl_at_resp_start(NULL, false);
+            // Don't want characters in the string being interpreted
+            // as delimiters
+            cellular_ctrl_at_set_delimiter(0);
+            bytesRead = cellular_ctrl_at_read_string(pBuffer, bufferSize, true);
+            cellular_ctrl_at_resp_stop();
+            cellular_ctrl_at_set_default_delimiter();
+            atError = cellular_ctrl_at_unlock_return_error();
+            if ((bytesRead >= 0) && (atError == 0)) {
+                // If it is fully formed (i.e. the provided buffer was long
+                // enough to hold it all) the string will have \r\n\r\n on
+                // the end, remove that here
+                stripped = strip_ctrl(pBuffer, cellularPort_strlen(pBuffer));
+                errorCodeOrSize = bytesRead - stripped;
+                cellularPortLog("CELLULAR_CTRL: ID string, length %d character(s), returned by %s is \"%s\".\n",
+                                errorCodeOrSize, pCmd, pBuffer);
+                // Only cache it if we got all of it, i.e. there
+                // was a \r\n to remove from the end
+                if ((stripped > 0) &&
+                    (errorCodeOrSize < CELLULAR_CTRL_ID_CACHE_STRING_SIZE)) {
+                    idCacheCopy(pBuffer, pCache, CELLULAR_CTRL_ID_CACHE_STRING_SIZE);
+                }
+            } else {
+                cellularPortLog("CELLULAR_CTRL: unable to read ID string using %s.\n", pCmd);
+            }
+        }
+    }
+
+    return (int32_t) errorCodeOrSize;
+}
+
+// Load the last-known-good connection settings from non-volatile
+// storage, if the platform has any.
+static void lastGoodLoad()
+{
+    if ((cellularPortNvRetrieve(CELLULAR_CTRL_NV_ID_LAST_GOOD,
+                                &gLastGood, sizeof(gLastGood)) != sizeof(gLastGood)) ||
+        (gLastGood.version != CELLULAR_CTRL_LAST_GOOD_VERSION)) {
+        pCellularPort_memset(&gLastGood, 0, sizeof(gLastGood));
+    }
+}
+
+// Return the last-known-good connection settings if they were
+// made with the SIM that has the given IMSI, else NULL.
+static const CellularCtrlLastGood_t *pLastGoodGet(const char *pImsi)
+{
+    const CellularCtrlLastGood_t *pLastGood = NULL;
+
+    if ((pImsi != NULL) &&
+        (gLastGood.version == CELLULAR_CTRL_LAST_GOOD_VERSION) &&
+        (cellularPort_memcmp(gLastGood.imsi, pImsi,
+                             sizeof(gLastGood.imsi)) == 0)) {
+        pLastGood = &gLastGood;
+    }
+
+    return pLastGood;
+}
+
+// Set the bit for an E-UTRA band in a pair of band masks,
+// as used by AT+UBANDMASK.
+static void bandMaskSetBit(uint64_t *pBandMask, int32_t band)
+{
+    if ((band >= 1) && (band <= 64)) {
+        pBandMask[0] |= 1ULL << (band - 1);
+    } else if ((band >= 65) && (band <= 128)) {
+        pBandMask[1] |= 1ULL << (band - 65);
+    }
+}
+
+// If band learning is on and the connection in pLastGood was
+// made on CAT-M1 or NB1, add the band it was made on to the
+// bands learnt.
+static void bandLearningRecord(CellularCtrlLastGood_t *pLastGood)
+{
+    CellularCtrlRat_t rat = CELLULAR_CTRL_RAT_UNKNOWN_OR_NOT_USED;
+    int32_t band;
+
+    // The modules supported here do CAT-M1 rather than LTE,
+    // so that is what an AT+COPS <AcT> of 7 means
+    if (pLastGood->accessTechnology == 7) {
+        rat = CELLULAR_CTRL_RAT_CATM1;
+    } else if (pLastGood->accessTechnology == 9) {
+        rat = CELLULAR_CTRL_RAT_NB1;
+    }
+    band = cellularCtrlEarfcnToBand(pLastGood->earfcn);
+    if (gBandLearning && (rat != CELLULAR_CTRL_RAT_UNKNOWN_OR_NOT_USED) &&
+        (band > 0)) {
+        if (pLastGood->bandRat != (int32_t) rat) {
+            // What was learnt for another RAT is no use
+            pLastGood->bandRat = (int32_t) rat;
+            pCellularPort_memset(pLastGood->bandMaskLearnt, 0,
+                                 sizeof(pLastGood->bandMaskLearnt));
+            pCellularPort_memset(pLastGood->bandMaskWide, 0,
+                                 sizeof(pLastGood->bandMaskWide));
+            pCellularPort_memset(pLastGood->bandMaskApplied, 0,
+                                 sizeof(pLastGood->bandMaskApplied));
+        }
+        pCellularPort_memset(pLastGood->bandMaskLast, 0,
+                             sizeof(pLastGood->bandMaskLast));
+        bandMaskSetBit(pLastGood->bandMaskLast, band);
+        bandMaskSetBit(pLastGood->bandMaskLearnt, band);
+    }
+}
+
+// Remember the settings of the connection that has just been made
+// with the given IMSI and APN, writing them to non-volatile
+// storage only if they have changed.
+static void lastGoodSave(const char *pImsi, const char *pApn)
+{
+    CellularCtrlLastGood_t lastGood;
+    const CellularCtrlLastGood_t *pLastGood;
+    int32_t bytesRead;
+
+    pCellularPort_memset(&lastGood, 0, sizeof(lastGood));
+    lastGood.version = CELLULAR_CTRL_LAST_GOOD_VERSION;
+    pCellularPort_memcpy(lastGood.imsi, pImsi, sizeof(lastGood.imsi));
+    // Carry forward what has been learnt about bands with this SIM
+    lastGood.bandRat = -1;
+    pLastGood = pLastGoodGet(pImsi);
+    if (pLastGood != NULL) {
+        lastGood.bandRat = pLastGood->bandRat;
+        pCellularPort_memcpy(lastGood.bandMaskLast, pLastGood->bandMaskLast,
+                             sizeof(lastGood.bandMaskLast));
+        pCellularPort_memcpy(lastGood.bandMaskLearnt, pLastGood->bandMaskLearnt,
+                             sizeof(lastGood.bandMaskLearnt));
+        pCellularPort_memcpy(lastGood.bandMaskWide, pLastGood->bandMaskWide,
+                             sizeof(lastGood.bandMaskWide));
+        pCellularPort_memcpy(lastGood.bandMaskApplied, pLastGood->bandMaskApplied,
+                             sizeof(lastGood.bandMaskApplied));
+    }
+    if (pApn != NULL) {
+        pCellularPort_strncpy(lastGood.apn, pApn, sizeof(lastGood.apn) - 1);
+    }
+    cellular_ctrl_at_lock();
+    // Numeric format
+    cellular_ctrl_at_cmd_start("AT+COPS=3,2");
+    cellular_ctrl_at_cmd_stop_read_resp();
+    cellular_ctrl_at_cmd_start("AT+COPS?");
+    cellular_ctrl_at_cmd_stop();
+    cellular_ctrl_at_resp_start("+COPS:", false);
+    // Skip past <mode> and <format>
+    cellular_ctrl_at_skip_param(2);
+    bytesRead = cellular_ctrl_at_read_string(lastGood.mccMnc,
+                                             sizeof(lastGood.mccMnc),
+                                             false);
+    lastGood.accessTechnology = cellular_ctrl_at_read_int();
+    cellular_ctrl_at_resp_stop();
+    if ((cellular_ctrl_at_unlock_return_error() == 0) &&
+        (bytesRead >= 5) && (lastGood.accessTechnology >= 0)) {
+        if (cellularCtrlRefreshRadioParameters() == 0) {
+            lastGood.earfcn = gEarfcn;
+            lastGood.cellId = gCellId;
+        } else {
+            lastGood.earfcn = -1;
+            lastGood.cellId = -1;
+        }
+        bandLearningRecord(&lastGood);
+        if (cellularPort_memcmp(&lastGood, &gLastGood, sizeof(lastGood)) != 0) {
+            pCellularPort_memcpy(&gLastGood, &lastGood, sizeof(gLastGood));
+            // OK for this to fail, the platform may not have anywhere
+            // to store it, we still have it in RAM
+            cellularPortNvStore(CELLULAR_CTRL_NV_ID_LAST_GOOD,
+                                &gLastGood, sizeof(gLastGood));
+        }
+    }
+}
+
+// Move pApnConfig, a set of entries from the APN database, on to
+// the entry for pApn, if there is one.
+static const char *pApnConfigSkipTo(const char *pApnConfig,
+                                    const char *pApn)
+{
+    const char *pEntry = pApnConfig;
+
+    while ((*pEntry != 0) && (cellularPort_strcmp(pEntry, pApn) != 0)) {
+        // Skip the APN, user name and password
+        for (size_t x = 0; x < 3; x++) {
+            pEntry += cellularPort_strlen(pEntry) + 1;
+        }
+    }
+    if (*pEntry == 0) {
+        pEntry = pApnConfig;
+    }
+
+    return pEntry;
+}
+
+// Prepare for connection with the network, steering the module
+// towards the operator in pLastGood if it is not NULL.
+static bool prepareConnect(const CellularCtrlLastGood_t *pLastGood)
+{
+    bool success = false;
+    int32_t status;
+
+    cellularPortLog("CELLULAR_CTRL: preparing to connect...\n");
+    // Make sure URC handler is registered
+    cellular_ctrl_at_set_urc_handler("+CREG:", CREG_urc, NULL);
+    cellular_ctrl_at_set_urc_handler("+CGREG:", CGREG_urc, NULL);
+    cellular_ctrl_at_set_urc_handler("+CEREG:", CEREG_urc, NULL);
+
+    // Switch on the unsolicited result codes for registration
+    cellular_ctrl_at_lock();
+    cellular_ctrl_at_cmd_start("AT+CREG=1");
+    cellular_ctrl_at_cmd_stop_read_resp();
+    if (cellular_ctrl_at_unlock_return_error() == 0) {
+        cellular_ctrl_at_lock();
+        cellular_ctrl_at_cmd_start("AT+CGREG=1");
+        cellular_ctrl_at_cmd_stop_read_resp();
+        if (cellular_ctrl_at_unlock_return_error() == 0) {
+            cellular_ctrl_at_lock();
+            cellular_ctrl_at_cmd_start("AT+CEREG=1");
+            cellular_ctrl_at_cmd_stop_read_resp();
+            if (cellular_ctrl_at_unlock_return_error() == 0) {
+                if ((pLastGood != NULL) && !cellularCtrlIsRegistered()) {
+                    // Try the operator we were last on first; with
+                    // mode 4 the module drops back to automatic
+                    // selection by itself if that doesn't work out
+                    cellularPortLog("CELLULAR_CTRL: trying operator %s, <AcT> %d, first.\n",
+                                    pLastGood->mccMnc, pLastGood->accessTechnology);
+                    cellular_ctrl_at_lock();
+                    cellular_ctrl_at_cmd_start("AT+COPS=");
+                    cellular_ctrl_at_write_int(4);
+                    cellular_ctrl_at_write_int(2); // Numeric format
+                    cellular_ctrl_at_write_string(pLastGood->mccMnc, true);
+                    cellular_ctrl_at_write_int(pLastGood->accessTechnology);
+                    cellular_ctrl_at_cmd_stop_read_resp();
+                    success = (cellular_ctrl_at_unlock_return_error() == 0);
+                    if (!success) {
+                        cellularPortLog("CELLULAR_CTRL: unable to set manual/automatic network selection mode.\n");
+                    }
+                }
+                if (!success) {
+                    cellular_ctrl_at_lock();
+                    // See if we are already in automatic mode
+                    cellular_ctrl_at_cmd_start("AT+COPS?");
+                    cellular_ctrl_at_cmd_stop();
+                    cellular_ctrl_at_resp_start("+COPS:", false);
+                    status = cellular_ctrl_at_read_int();
+                    cellular_ctrl_at_resp_stop();
+                    if (cellular_ctrl_at_unlock_return_error() == 0) {
+                        if (status != 0) {
+                            // If we aren't, set it
+                            cellular_ctrl_at_lock();
+                            cellular_ctrl_at_cmd_start("AT+COPS=0");
+                            cellular_ctrl_at_cmd_stop_read_resp();
+                            if (cellular_ctrl_at_unlock_return_error() == 0) {
+                                success = true;
+                            } else {
+                                cellularPortLog("CELLULAR_CTRL: unable to set automatic network selection mode.\n");
+                            }
                         } else {
-                            cellularPortLog("CELLULAR_CTRL: unable to set automatic network selection mode.\n");
+                            // Good to go
+                            success = true;
                         }
                     } else {
-                        // Good to go
-                        success = true;
+                        cellularPortLog("CELLULAR_CTRL: unable to check automatic network selection mode.\n");
                     }
-                } else {
-                    cellularPortLog("CELLULAR_CTRL: unable to check automatic network selection mode.\n");
                 }
             } else {
                 cellularPortLog("CELLULAR_CTRL: unable to set +CEREG URCs.\n");
@@ -549,107 +1574,211 @@ static bool prepareConnect()
     return success;
 }
 
-// Register with the cellular network and obtain a PDP context.
-static CellularCtrlErrorCode_t tryConnect(bool (*pKeepGoingCallback) (void),
-                                          const char *pApn,
-                                          const char *pUsername,
-                                          const char *pPassword)
+// Query the registration status with the given entry from gRegTypes,
+// returning false if the AT interface reported an error.  This is
+// only a back-stop in case the +CxREG URCs should go quiet.
+static bool queryRegistration(int32_t regType)
 {
-    CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_AT_ERROR;
-    bool keepGoing = true;
-    bool attached = false;
-    bool activated = false;
-    int32_t regType;
     int32_t status;
-    char buffer[64];
 
-    if (pKeepGoingCallback()) {
-        // Set up context definition
-        cellular_ctrl_at_lock();
-        cellular_ctrl_at_cmd_start("AT+CGDCONT=");
-        cellular_ctrl_at_write_int(CELLULAR_CTRL_CONTEXT_ID);
-        cellular_ctrl_at_write_string("IP", true);
-        if (pApn != NULL) {
-            cellular_ctrl_at_write_string(pApn, true);
-        }
-        cellular_ctrl_at_cmd_stop_read_resp();
-        if (cellular_ctrl_at_unlock_return_error() != 0) {
-            cellularPortLog("CELLULAR_CTRL: unable to define context %d.\n",
-                            CELLULAR_CTRL_CONTEXT_ID);
-            keepGoing = false;
-        }
+    cellular_ctrl_at_lock();
+    cellular_ctrl_at_set_at_timeout(gpModuleProfile->commandMinimumResponseTimeMs, false);
+    cellular_ctrl_at_cmd_start(gRegTypes[regType].pQueryStr);
+    cellular_ctrl_at_cmd_stop();
+    cellular_ctrl_at_resp_start(gRegTypes[regType].pResponseStr, false);
+    // Ignore the first parameter
+    cellular_ctrl_at_read_int();
+    status = cellular_ctrl_at_read_int();
+    if (status < 0) {
+        cellularPortLog("CELLULAR_CTRL: URC dodgeroo.\n");
+        // It is possible for the module to spit-out
+        // a "+CxREG: y" URC while we're waiting for
+        // the "+CxREG: x,y" response from the AT+CxREG
+        // command. If that happens status will be -1 'cos
+        // there's only a single integer in the URC.
+        // So now wait for the actual response
+        cellular_ctrl_at_resp_start(gRegTypes[regType].pResponseStr, false);
+        cellular_ctrl_at_read_int();
+        status = cellular_ctrl_at_read_int();
+    }
+    if (status >= 0) {
+        setNetworkStatus(status, gRegTypes[regType].ran);
+    }
+    cellular_ctrl_at_resp_stop();
+    cellular_ctrl_at_restore_at_timeout();
+
+    return (cellular_ctrl_at_unlock_return_error() == 0);
+}
+
+// Define a PDP context and set up its authentication, if required.
+static bool defineContext(int32_t contextId, const char *pApn,
+                          const char *pUsername, const char *pPassword)
+{
+    bool success = true;
+
+    cellular_ctrl_at_lock();
+    cellular_ctrl_at_cmd_start("AT+CGDCONT=");
+    cellular_ctrl_at_write_int(contextId);
+    cellular_ctrl_at_write_string("IP", true);
+    if (pApn != NULL) {
+        cellular_ctrl_at_write_string(pApn, true);
+    }
+    cellular_ctrl_at_cmd_stop_read_resp();
+    if (cellular_ctrl_at_unlock_return_error() != 0) {
+        cellularPortLog("CELLULAR_CTRL: unable to define context %d.\n",
+                        contextId);
+        success = false;
     }
 
-    // Set up authentication mode, if required
-    if (keepGoing && pKeepGoingCallback() &&
-        (pUsername != NULL) && (pPassword != NULL)) {
+    if (success && (pUsername != NULL) && (pPassword != NULL)) {
         cellular_ctrl_at_lock();
         cellular_ctrl_at_cmd_start("AT+UAUTHREQ=");
-        cellular_ctrl_at_write_int(CELLULAR_CTRL_CONTEXT_ID);
+        cellular_ctrl_at_write_int(contextId);
         cellular_ctrl_at_write_int(3); // Automatic choice of authentication type
         cellular_ctrl_at_write_string(pPassword, true);
         cellular_ctrl_at_write_string(pUsername, true);
         cellular_ctrl_at_cmd_stop_read_resp();
         if (cellular_ctrl_at_unlock_return_error() != 0) {
             cellularPortLog("CELLULAR_CTRL: unable to authenticate with user name \"%s\".\n", pUsername);
-            keepGoing = false;
+            success = false;
+        }
+    }
+
+    return success;
+}
+
+// Activate a PDP context that has been defined, mapping it to
+// an internal profile where the module requires that.
+// pKeepGoingCallback may be NULL.
+static CellularCtrlErrorCode_t activateContext(bool (*pKeepGoingCallback) (void),
+                                               int32_t contextId)
+{
+    CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_CONTEXT_ACTIVATION_FAILURE;
+    bool activated = false;
+    int32_t status;
+
+    for (size_t x = 0; ((pKeepGoingCallback == NULL) || pKeepGoingCallback()) &&
+                       (errorCode != CELLULAR_CTRL_SUCCESS) &&
+                       (x < 10); x++) {
+        cellular_ctrl_at_lock();
+        cellular_ctrl_at_set_at_timeout(gpModuleProfile->commandMinimumResponseTimeMs, false);
+        cellular_ctrl_at_cmd_start("AT+CGACT?");
+        cellular_ctrl_at_cmd_stop();
+        status = -1;
+        for (size_t y = 0; (status < 0) &&
+                           (y < CELLULAR_CTRL_MAX_NUM_CONTEXTS); y++) {
+            cellular_ctrl_at_resp_start("+CGACT:", false);
+            // Check if this is our context ID
+            if (cellular_ctrl_at_read_int() == contextId) {
+                status = cellular_ctrl_at_read_int();
+                activated = (status == 1);
+            }
+        }
+        cellular_ctrl_at_resp_stop();
+        if (activated) {
+            cellular_ctrl_at_restore_at_timeout();
+            if (cellular_ctrl_at_unlock_return_error() == 0) {
+                if (!gpModuleProfile->contextNeedsInternalProfile) {
+                    // E.g. SARA-R4 only supports a single context
+                    // at any one time and so doesn't require that.
+                    errorCode = CELLULAR_CTRL_SUCCESS;
+                } else {
+                    // Use AT+UPSD to map the context to an internal
+                    // modem profile e.g. AT+UPSD=0,100,1, then
+                    // activate that profile e.g. AT+UPSDA=0,3.
+                    cellular_ctrl_at_lock();
+                    cellular_ctrl_at_cmd_start("AT+UPSD=");
+                    cellular_ctrl_at_write_int(CELLULAR_CTRL_PROFILE_ID_FOR_CONTEXT(contextId));
+                    cellular_ctrl_at_write_int(100);
+                    cellular_ctrl_at_write_int(contextId);
+                    cellular_ctrl_at_cmd_stop_read_resp();
+                    cellular_ctrl_at_cmd_start("AT+UPSDA=");
+                    cellular_ctrl_at_write_int(CELLULAR_CTRL_PROFILE_ID_FOR_CONTEXT(contextId));
+                    cellular_ctrl_at_write_int(3);
+                    cellular_ctrl_at_cmd_stop_read_resp();
+                    if (cellular_ctrl_at_unlock_return_error() == 0) {
+                        errorCode = CELLULAR_CTRL_SUCCESS;
+                    }
+                }
+            }
+        } else {
+            // Help it on its way.
+            cellularPortTaskBlock(1000);
+            cellular_ctrl_at_cmd_start("AT+CGACT=");
+            cellular_ctrl_at_write_int(1);
+            cellular_ctrl_at_write_int(contextId);
+            cellular_ctrl_at_cmd_stop_read_resp();
+            cellular_ctrl_at_restore_at_timeout();
+            cellular_ctrl_at_unlock();
         }
     }
 
+    return errorCode;
+}
+
+// Check whether the module is attached (AT+CGATT).
+static bool isAttached()
+{
+    bool attached;
+
+    cellular_ctrl_at_lock();
+    cellular_ctrl_at_set_at_timeout(gpModuleProfile->commandMinimumResponseTimeMs, false);
+    cellular_ctrl_at_cmd_start("AT+CGATT?");
+    cellular_ctrl_at_cmd_stop();
+    cellular_ctrl_at_resp_start("+CGATT:", false);
+    attached = (cellular_ctrl_at_read_int() == 1);
+    cellular_ctrl_at_resp_stop();
+    cellular_ctrl_at_restore_at_timeout();
+    cellular_ctrl_at_unlock();
+
+    return attached;
+}
+
+// Register with the cellular network and obtain a PDP context.
+static CellularCtrlErrorCode_t tryConnect(bool (*pKeepGoingCallback) (void),
+                                          const char *pApn,
+                                          const char *pUsername,
+                                          const char *pPassword)
+{
+    CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_AT_ERROR;
+    bool keepGoing = true;
+    bool attached = false;
+    int32_t regType;
+    CellularCtrlRan_t ran;
+    int64_t lastEventTimeMs;
+    char buffer[64];
+
+    if (pKeepGoingCallback()) {
+        keepGoing = defineContext(CELLULAR_CTRL_CONTEXT_ID, pApn,
+                                  pUsername, pPassword);
+    }
+
     // Now come out of airplane mode and try to register
     cellular_ctrl_at_lock();
     cellular_ctrl_at_cmd_start("AT+CFUN=1");
     cellular_ctrl_at_cmd_stop_read_resp();
     cellular_ctrl_at_unlock();
-    // Wait for registration to succeed
+    // Wait for registration to succeed: the +CxREG URCs
+    // switched on in prepareConnect() tell us when anything
+    // changes, only if they go quiet for
+    // CELLULAR_CFG_CTRL_REG_POLL_INTERVAL_MS do we ask
     errorCode = CELLULAR_CTRL_NOT_REGISTERED;
     regType = 0;
+    lastEventTimeMs = cellularPortGetTickTimeMs();
     while (keepGoing && pKeepGoingCallback() && !cellularCtrlIsRegistered()) {
-        // Prod the modem anyway, we've nout much else to do
-        cellular_ctrl_at_lock();
-        cellular_ctrl_at_set_at_timeout(CELLULAR_CTRL_COMMAND_MINIMUM_RESPONSE_TIME_MS, false);
-        cellular_ctrl_at_cmd_start(gRegTypes[regType].pQueryStr);
-        cellular_ctrl_at_cmd_stop();
-        cellular_ctrl_at_resp_start(gRegTypes[regType].pResponseStr, false);
-        // Ignore the first parameter
-        cellular_ctrl_at_read_int();
-        status = cellular_ctrl_at_read_int();
-        if (status >= 0) {
-            setNetworkStatus(status, gRegTypes[regType].ran);
-        } else {
-            cellularPortLog("CELLULAR_CTRL: URC dodgeroo.\n");
-            // It is possible for the module to spit-out 
-            // a "+CxREG: y" URC while we're waiting for
-            // the "+CxREG: x,y" response from the AT+CxREG
-            // command. If that happens status will be -1 'cos
-            // there's only a single integer in the URC.
-            // So now wait for the actual response
-            cellular_ctrl_at_resp_start(gRegTypes[regType].pResponseStr, false);
-            cellular_ctrl_at_read_int();
-            status = cellular_ctrl_at_read_int();
-            if (status >= 0) {
-                setNetworkStatus(status, gRegTypes[regType].ran);
-            } else {
-                // And, yes, I've seen it happen twice.  Don't dare
-                // put a loop in here so just one more time...
-                cellular_ctrl_at_resp_start(gRegTypes[regType].pResponseStr, false);
-                cellular_ctrl_at_read_int();
-                status = cellular_ctrl_at_read_int();
-                if (status >= 0) {
-                    setNetworkStatus(status, gRegTypes[regType].ran);
-                }
+        if (cellularPortQueueTryReceive(gQueueRegEvent,
+                                        CELLULAR_CTRL_REG_EVENT_WAIT_MS,
+                                        &ran) == 0) {
+            gRegEventPending = false;
+            lastEventTimeMs = cellularPortGetTickTimeMs();
+        } else if (cellularPortGetTickTimeMs() - lastEventTimeMs >
+                   CELLULAR_CFG_CTRL_REG_POLL_INTERVAL_MS) {
+            keepGoing = queryRegistration(regType);
+            regType++;
+            if (regType >= sizeof(gRegTypes) / sizeof(gRegTypes[0])) {
+                regType = 0;
             }
-        }
-        cellular_ctrl_at_resp_stop();
-        cellular_ctrl_at_restore_at_timeout();
-        if (cellular_ctrl_at_unlock_return_error() != 0) {
-            keepGoing = false;
-        } else {
-            cellularPortTaskBlock(300);
-        }
-        regType++;
-        if (regType >= sizeof(gRegTypes) / sizeof(gRegTypes[0])) {
-            regType = 0;
+            lastEventTimeMs = cellularPortGetTickTimeMs();
         }
     }
 
@@ -671,110 +1800,418 @@ static CellularCtrlErrorCode_t tryConnect(bool (*pKeepGoingCallback) (void),
             // Wait for AT+CGATT to return 1
             // SARA R4/N4 AT Command Manual UBX-17003787, section 13.5
             for (size_t x = 0; !attached && pKeepGoingCallback() &&
-                               (x < 10); x++) {
-                cellular_ctrl_at_lock();
-                cellular_ctrl_at_set_at_timeout(CELLULAR_CTRL_COMMAND_MINIMUM_RESPONSE_TIME_MS, false);
-                cellular_ctrl_at_cmd_start("AT+CGATT?");
-                cellular_ctrl_at_cmd_stop();
-                cellular_ctrl_at_resp_start("+CGATT:", false);
-                attached = (cellular_ctrl_at_read_int() == 1);
-                cellular_ctrl_at_resp_stop();
-                cellular_ctrl_at_restore_at_timeout();
-                cellular_ctrl_at_unlock();
+                               (x < CELLULAR_CTRL_ATTACH_ATTEMPTS); x++) {
+                attached = isAttached();
                 if (!attached) {
-                    cellularPortTaskBlock(1000);
+                    cellularPortTaskBlock(CELLULAR_CTRL_ATTACH_INTERVAL_MS);
+                }
+            }
+
+            if (attached) {
+                // Activate a PDP context
+                errorCode = activateContext(pKeepGoingCallback,
+                                            CELLULAR_CTRL_CONTEXT_ID);
+                if (pKeepGoingCallback() && (errorCode != CELLULAR_CTRL_SUCCESS)) {
+                    cellularPortLog("CELLULAR_CTRL: unable to activate a PDP context");
+                    if (pApn != NULL) {
+                        cellularPortLog(", is APN \"%s\" correct?\n", pApn);
+                    } else {
+                        cellularPortLog(" (no APN specified).\n");
+                    }
+                }
+            }
+        } else {
+            cellularPortLog("CELLULAR_CTRL: unable to register with the network");
+            if (pApn != NULL) {
+                cellularPortLog(", is APN \"%s\" correct and is an antenna connected?\n", pApn);
+            } else {
+                cellularPortLog(", does an APN need to be specified and is an antenna connected?\n");
+            }
+        }
+    }
+
+    if (errorCode != CELLULAR_CTRL_SUCCESS) {
+        // Switch radio off after that failure
+        cellular_ctrl_at_lock();
+        cellular_ctrl_at_cmd_start("AT+CFUN=4");
+        cellular_ctrl_at_cmd_stop_read_resp();
+        cellular_ctrl_at_unlock();
+    }
+
+    return errorCode;
+}
+
+// Prepare for connection and try to connect with pApn or, if that
+// is NULL and pImsi is not, with each APN for pImsi in the APN
+// database in turn, starting at the one in pLastGood; *ppApnUsed
+// is set to the APN that was tried last.
+static CellularCtrlErrorCode_t connectApns(bool (*pKeepGoingCallback) (void),
+                                           const char *pImsi,
+                                           const CellularCtrlLastGood_t *pLastGood,
+                                           const char *pApn,
+                                           const char *pUsername,
+                                           const char *pPassword,
+                                           const char **ppApnUsed)
+{
+    CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_AT_ERROR;
+    const char *pApnConfig = NULL;
+
+    if (prepareConnect(pLastGood)) {
+        // Set up the APN look-up since none is specified,
+        // starting at the one that worked last time
+        if ((pApn == NULL) && (pImsi != NULL)) {
+            pApnConfig = apnconfig(pImsi);
+            if ((pApnConfig != NULL) && (pLastGood != NULL)) {
+                pApnConfig = pApnConfigSkipTo(pApnConfig,
+                                              pLastGood->apn);
+            }
+        }
+        // Now try to connect, potentially multiple times
+        do {
+            if (pApnConfig != NULL) {
+                pApn = _APN_GET(pApnConfig);
+                pUsername = _APN_GET(pApnConfig);
+                pPassword = _APN_GET(pApnConfig);
+                cellularPortLog("CELLULAR_CTRL: APN from database is \"%s\".\n", pApn);
+            } else {
+                if (pApn != NULL) {
+                    cellularPortLog("CELLULAR_CTRL: user-specified APN is \"%s\".\n", pApn);
+                } else {
+                    cellularPortLog("CELLULAR_CTRL: default APN will be used by network.\n");
+                }
+            }
+            // Register and activate PDP context
+            errorCode = tryConnect(pKeepGoingCallback, pApn,
+                                   pUsername, pPassword);
+        } while ((errorCode != CELLULAR_CTRL_SUCCESS) &&
+                 (pApnConfig != NULL) &&
+                 (*pApnConfig != 0) &&
+                 pKeepGoingCallback());
+    }
+    *ppApnUsed = pApn;
+
+    return errorCode;
+}
+
+// If band learning has narrowed the band mask, put the wide one
+// back; like any band mask change this takes effect at the next
+// reboot of the module.
+static void bandLearningRestore()
+{
+    if ((gLastGood.version == CELLULAR_CTRL_LAST_GOOD_VERSION) &&
+        (gLastGood.bandRat >= 0) &&
+        ((gLastGood.bandMaskWide[0] != 0) || (gLastGood.bandMaskWide[1] != 0)) &&
+        ((gLastGood.bandMaskApplied[0] != gLastGood.bandMaskWide[0]) ||
+         (gLastGood.bandMaskApplied[1] != gLastGood.bandMaskWide[1])) &&
+        (cellularCtrlSetBandMask((CellularCtrlRat_t) gLastGood.bandRat,
+                                 gLastGood.bandMaskWide[0],
+                                 gLastGood.bandMaskWide[1]) == 0)) {
+        pCellularPort_memcpy(gLastGood.bandMaskApplied, gLastGood.bandMaskWide,
+                             sizeof(gLastGood.bandMaskApplied));
+        cellularPortNvStore(CELLULAR_CTRL_NV_ID_LAST_GOOD,
+                            &gLastGood, sizeof(gLastGood));
+    }
+}
+
+// The keep-going callback while band learning is trying a
+// narrowed band mask.
+static bool bandLearningKeepGoing()
+{
+    return (cellularPortGetTickTimeMs() < gBandLearningStopTimeMs) &&
+           gpBandLearningKeepGoingCallback();
+}
+
+// Work out the band masks that band learning should try, in
+// order, from gLastGood: the band of the last connection,
+// all of the bands learnt, each only if it is narrower than the
+// one before, and finally the wide band mask.
+static size_t bandLearningStages(uint64_t (*pStages)[2])
+{
+    const uint64_t *pNarrowed[] = {gLastGood.bandMaskLast,
+                                   gLastGood.bandMaskLearnt};
+    size_t numStages = 0;
+    uint64_t *pPrevious = gLastGood.bandMaskWide;
+
+    for (size_t x = 0; x < sizeof(pNarrowed) / sizeof(pNarrowed[0]); x++) {
+        pStages[numStages][0] = pNarrowed[x][0] & gLastGood.bandMaskWide[0];
+        pStages[numStages][1] = pNarrowed[x][1] & gLastGood.bandMaskWide[1];
+        if (((pStages[numStages][0] != 0) || (pStages[numStages][1] != 0)) &&
+            ((pStages[numStages][0] != pPrevious[0]) ||
+             (pStages[numStages][1] != pPrevious[1])) &&
+            ((pStages[numStages][0] != gLastGood.bandMaskWide[0]) ||
+             (pStages[numStages][1] != gLastGood.bandMaskWide[1]))) {
+            pPrevious = pStages[numStages];
+            numStages++;
+        }
+    }
+    pStages[numStages][0] = gLastGood.bandMaskWide[0];
+    pStages[numStages][1] = gLastGood.bandMaskWide[1];
+    numStages++;
+
+    return numStages;
+}
+
+// Connect as connectApns() does but with band learning: the
+// band mask for gLastGood.bandRat is narrowed to each of the
+// stages from bandLearningStages() in turn, rebooting the module
+// to apply it, and each narrowed stage is given
+// CELLULAR_CFG_CTRL_BAND_LEARNING_STAGE_SECONDS.
+static CellularCtrlErrorCode_t bandLearningConnect(bool (*pKeepGoingCallback) (void),
+                                                   const char *pImsi,
+                                                   const char *pApn,
+                                                   const char *pUsername,
+                                                   const char *pPassword,
+                                                   const char **ppApnUsed)
+{
+    CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_NOT_REGISTERED;
+    CellularCtrlRat_t rat = (CellularCtrlRat_t) gLastGood.bandRat;
+    uint64_t stages[CELLULAR_CTRL_BAND_LEARNING_MAX_NUM_STAGES][2];
+    uint64_t current[2];
+    size_t numStages;
+    bool applied;
+
+    if (cellularCtrlGetBandMask(rat, &(current[0]), &(current[1])) != 0) {
+        // Can't tell what the band mask is, don't touch it
+        return connectApns(pKeepGoingCallback, pImsi, &gLastGood,
+                           pApn, pUsername, pPassword, ppApnUsed);
+    }
+    if ((current[0] != gLastGood.bandMaskApplied[0]) ||
+        (current[1] != gLastGood.bandMaskApplied[1])) {
+        // The band mask is not one that band learning set, so
+        // it has been set by someone else: it is the wide one
+        pCellularPort_memcpy(gLastGood.bandMaskWide, current,
+                             sizeof(gLastGood.bandMaskWide));
+        pCellularPort_memcpy(gLastGood.bandMaskApplied, current,
+                             sizeof(gLastGood.bandMaskApplied));
+        cellularPortNvStore(CELLULAR_CTRL_NV_ID_LAST_GOOD,
+                            &gLastGood, sizeof(gLastGood));
+    }
+
+    numStages = bandLearningStages(stages);
+    for (size_t x = 0; (x < numStages) &&
+                       (errorCode != CELLULAR_CTRL_SUCCESS) &&
+                       pKeepGoingCallback(); x++) {
+        applied = true;
+        if ((stages[x][0] != current[0]) || (stages[x][1] != current[1])) {
+            cellularPortLog("CELLULAR_CTRL: band learning, trying band mask 0x%08x%08x %08x%08x.\n",
+                            (uint32_t) (stages[x][1] >> 32), (uint32_t) stages[x][1],
+                            (uint32_t) (stages[x][0] >> 32), (uint32_t) stages[x][0]);
+            applied = (cellularCtrlSetBandMask(rat, stages[x][0],
+                                               stages[x][1]) == 0) &&
+                      (cellularCtrlReboot() == 0);
+            if (applied) {
+                // Record what was applied before trying it so that,
+                // should we be reset part way, the narrowed band
+                // mask is not taken to be the wide one next time
+                pCellularPort_memcpy(current, stages[x], sizeof(current));
+                pCellularPort_memcpy(gLastGood.bandMaskApplied, current,
+                                     sizeof(gLastGood.bandMaskApplied));
+                cellularPortNvStore(CELLULAR_CTRL_NV_ID_LAST_GOOD,
+                                    &gLastGood, sizeof(gLastGood));
+            }
+        }
+        if (x < numStages - 1) {
+            if (applied) {
+                gpBandLearningKeepGoingCallback = pKeepGoingCallback;
+                gBandLearningStopTimeMs = cellularPortGetTickTimeMs() +
+                                          (CELLULAR_CFG_CTRL_BAND_LEARNING_STAGE_SECONDS * 1000);
+                errorCode = connectApns(bandLearningKeepGoing, pImsi,
+                                        &gLastGood, pApn, pUsername,
+                                        pPassword, ppApnUsed);
+            }
+        } else {
+            // The wide band mask gets whatever time is left,
+            // whether it could be put back or not
+            errorCode = connectApns(pKeepGoingCallback, pImsi,
+                                    &gLastGood, pApn, pUsername,
+                                    pPassword, ppApnUsed);
+        }
+    }
+
+    return errorCode;
+}
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS: ASYNCHRONOUS CONNECT
+ * -------------------------------------------------------------- */
+
+// Stop the callbacks task calling ctrlPoll() if neither an
+// asynchronous connection attempt nor a recovery of the AT
+// link needs it any more.
+static void pollCancelIfIdle()
+{
+    if ((gRecoveryState == CELLULAR_CTRL_RECOVERY_STATE_IDLE) &&
+        ((gConnectAsync.state == CELLULAR_CTRL_CONNECT_STATE_IDLE) ||
+         (gConnectAsync.state == CELLULAR_CTRL_CONNECT_STATE_CONNECTED) ||
+         (gConnectAsync.state == CELLULAR_CTRL_CONNECT_STATE_FAILED))) {
+        cellular_ctrl_at_set_callbacks_poll(NULL, NULL);
+    }
+}
+
+// The keep-going callback for an asynchronous connection attempt.
+static bool connectAsyncKeepGoing()
+{
+    return !gConnectAsync.cancel &&
+           (cellularPortGetTickTimeMs() < gConnectAsync.stopTimeMs);
+}
+
+// Move an asynchronous connection attempt to a new state,
+// telling the application about it.
+static void connectAsyncSetState(CellularCtrlConnectState_t state,
+                                 CellularCtrlErrorCode_t errorCode)
+{
+    gConnectAsync.state = state;
+    gConnectAsync.stateEntered = false;
+    gConnectAsync.count = 0;
+    if ((state == CELLULAR_CTRL_CONNECT_STATE_CONNECTED) ||
+        (state == CELLULAR_CTRL_CONNECT_STATE_FAILED)) {
+        // All done, stop being called
+        pollCancelIfIdle();
+        if (state == CELLULAR_CTRL_CONNECT_STATE_FAILED) {
+            // Switch radio off after that failure
+            cellular_ctrl_at_lock();
+            cellular_ctrl_at_cmd_start("AT+CFUN=4");
+            cellular_ctrl_at_cmd_stop_read_resp();
+            cellular_ctrl_at_unlock();
+        }
+    }
+    if (gConnectAsync.pCallback != NULL) {
+        gConnectAsync.pCallback(state, (int32_t) errorCode,
+                                gConnectAsync.pCallbackParam);
+    }
+}
+
+// Do the next step of an asynchronous connection attempt;
+// called over and over by the callbacks task of the AT
+// layer, each call taking no more than a second or so.
+// This follows the same steps as tryConnect().
+static void connectAsyncStep(void *pUnused)
+{
+    CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_SUCCESS;
+    const CellularCtrlLastGood_t *pLastGood = NULL;
+    CellularCtrlRan_t ran;
+
+    (void) pUnused;
+
+    switch (gConnectAsync.state) {
+        case CELLULAR_CTRL_CONNECT_STATE_PREPARING:
+            gConnectAsync.imsiValid = (cellularCtrlGetImsi(gConnectAsync.imsi) == 0);
+            if (gConnectAsync.imsiValid) {
+                pLastGood = pLastGoodGet(gConnectAsync.imsi);
+            }
+            if (prepareConnect(pLastGood)) {
+                if ((gConnectAsync.pApn == NULL) && gConnectAsync.imsiValid) {
+                    gConnectAsync.pApnConfig = apnconfig(gConnectAsync.imsi);
+                    if ((gConnectAsync.pApnConfig != NULL) && (pLastGood != NULL)) {
+                        gConnectAsync.pApnConfig = pApnConfigSkipTo(gConnectAsync.pApnConfig,
+                                                                    pLastGood->apn);
+                    }
                 }
+                connectAsyncSetState(CELLULAR_CTRL_CONNECT_STATE_REGISTERING,
+                                     CELLULAR_CTRL_SUCCESS);
+            } else {
+                errorCode = CELLULAR_CTRL_AT_ERROR;
             }
-
-            if (attached) {
-                // Activate a PDP context
-                errorCode = CELLULAR_CTRL_CONTEXT_ACTIVATION_FAILURE;
-                for (size_t x = 0; pKeepGoingCallback() &&
-                                   (errorCode != CELLULAR_CTRL_SUCCESS) &&
-                                   (x < 10); x++) {
+        break;
+        case CELLULAR_CTRL_CONNECT_STATE_REGISTERING:
+            if (!gConnectAsync.stateEntered) {
+                if (gConnectAsync.pApnConfig != NULL) {
+                    gConnectAsync.pApn = _APN_GET(gConnectAsync.pApnConfig);
+                    gConnectAsync.pUsername = _APN_GET(gConnectAsync.pApnConfig);
+                    gConnectAsync.pPassword = _APN_GET(gConnectAsync.pApnConfig);
+                    cellularPortLog("CELLULAR_CTRL: APN from database is \"%s\".\n",
+                                    gConnectAsync.pApn);
+                }
+                if (defineContext(CELLULAR_CTRL_CONTEXT_ID, gConnectAsync.pApn,
+                                  gConnectAsync.pUsername, gConnectAsync.pPassword)) {
                     cellular_ctrl_at_lock();
-                    cellular_ctrl_at_set_at_timeout(CELLULAR_CTRL_COMMAND_MINIMUM_RESPONSE_TIME_MS, false);
-                    cellular_ctrl_at_cmd_start("AT+CGACT?");
-                    cellular_ctrl_at_cmd_stop();
-                    status = -1;
-                    for (size_t y = 0; (status < 0) &&
-                                       (y < CELLULAR_CTRL_MAX_NUM_CONTEXTS); x++) {
-                        cellular_ctrl_at_resp_start("+CGACT:", false);
-                        // Check if this is our context ID
-                        if (cellular_ctrl_at_read_int() == CELLULAR_CTRL_CONTEXT_ID) {
-                            status = cellular_ctrl_at_read_int();
-                            activated = (status == 1);
-                        }
-                    }
-                    cellular_ctrl_at_resp_stop();
-                    if (activated) {
-                        cellular_ctrl_at_restore_at_timeout();
-                        if (cellular_ctrl_at_unlock_return_error() == 0) {
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
-                            // SARA-R4 only supports a single context at any
-                            // one time and so doesn't require that.
-                            errorCode = CELLULAR_CTRL_SUCCESS;
-#else
-                            // Use AT+UPSD to map the context to an internal
-                            // modem profile e.g. AT+UPSD=0,100,1, then
-                            // activate that profile e.g. AT+UPSDA=0,3.
-                            cellular_ctrl_at_lock();
-                            // Map profile ID CELLULAR_CTRL_PROFILE_ID to
-                            // context ID CELLULAR_CTRL_CONTEXT_ID
-                            cellular_ctrl_at_cmd_start("AT+UPSD=");
-                            cellular_ctrl_at_write_int(CELLULAR_CTRL_PROFILE_ID);
-                            cellular_ctrl_at_write_int(100);
-                            cellular_ctrl_at_write_int(CELLULAR_CTRL_CONTEXT_ID);
-                            cellular_ctrl_at_cmd_stop_read_resp();
-                            // Activate profile ID CELLULAR_CTRL_PROFILE_ID
-                            cellular_ctrl_at_cmd_start("AT+UPSDA=");
-                            cellular_ctrl_at_write_int(CELLULAR_CTRL_PROFILE_ID);
-                            cellular_ctrl_at_write_int(3);
-                            cellular_ctrl_at_cmd_stop_read_resp();
-                            if (cellular_ctrl_at_unlock_return_error() == 0) {
-                                errorCode = CELLULAR_CTRL_SUCCESS;
-                            }
-#endif
-                        }
-                    } else {
-                        // Help it on its way.
-                        cellularPortTaskBlock(1000);
-                        cellular_ctrl_at_cmd_start("AT+CGACT=");
-                        cellular_ctrl_at_write_int(1);
-                        cellular_ctrl_at_write_int(CELLULAR_CTRL_CONTEXT_ID);
-                        cellular_ctrl_at_cmd_stop_read_resp();
-                        cellular_ctrl_at_restore_at_timeout();
-                        cellular_ctrl_at_unlock();
-                    }
+                    cellular_ctrl_at_cmd_start("AT+CFUN=1");
+                    cellular_ctrl_at_cmd_stop_read_resp();
+                    cellular_ctrl_at_unlock();
+                    gConnectAsync.regType = 0;
+                    gConnectAsync.lastEventTimeMs = cellularPortGetTickTimeMs();
+                    gConnectAsync.stateEntered = true;
+                } else {
+                    errorCode = CELLULAR_CTRL_NOT_REGISTERED;
                 }
-                if (pKeepGoingCallback() && (errorCode != CELLULAR_CTRL_SUCCESS)) {
-                    cellularPortLog("CELLULAR_CTRL: unable to activate a PDP context");
-                    if (pApn != NULL) {
-                        cellularPortLog(", is APN \"%s\" correct?\n", pApn);
-                    } else {
-                        cellularPortLog(" (no APN specified).\n");
+            } else if (cellularCtrlIsRegistered()) {
+                connectAsyncSetState(CELLULAR_CTRL_CONNECT_STATE_ATTACHING,
+                                     CELLULAR_CTRL_SUCCESS);
+            } else if (cellularPortQueueTryReceive(gQueueRegEvent,
+                                                   CELLULAR_CTRL_REG_EVENT_WAIT_MS,
+                                                   &ran) == 0) {
+                gRegEventPending = false;
+                gConnectAsync.lastEventTimeMs = cellularPortGetTickTimeMs();
+            } else if (cellularPortGetTickTimeMs() - gConnectAsync.lastEventTimeMs >
+                       CELLULAR_CFG_CTRL_REG_POLL_INTERVAL_MS) {
+                if (queryRegistration(gConnectAsync.regType)) {
+                    gConnectAsync.regType++;
+                    if (gConnectAsync.regType >= sizeof(gRegTypes) / sizeof(gRegTypes[0])) {
+                        gConnectAsync.regType = 0;
                     }
+                    gConnectAsync.lastEventTimeMs = cellularPortGetTickTimeMs();
+                } else {
+                    errorCode = CELLULAR_CTRL_NOT_REGISTERED;
                 }
             }
-        } else {
-            cellularPortLog("CELLULAR_CTRL: unable to register with the network");
-            if (pApn != NULL) {
-                cellularPortLog(", is APN \"%s\" correct and is an antenna connected?\n", pApn);
+        break;
+        case CELLULAR_CTRL_CONNECT_STATE_ATTACHING:
+            if (isAttached()) {
+                connectAsyncSetState(CELLULAR_CTRL_CONNECT_STATE_ACTIVATING,
+                                     CELLULAR_CTRL_SUCCESS);
             } else {
-                cellularPortLog(", does an APN need to be specified and is an antenna connected?\n");
+                gConnectAsync.count++;
+                if (gConnectAsync.count < CELLULAR_CTRL_ATTACH_ATTEMPTS) {
+                    cellularPortTaskBlock(CELLULAR_CTRL_ATTACH_INTERVAL_MS);
+                } else {
+                    errorCode = CELLULAR_CTRL_NOT_REGISTERED;
+                }
             }
-        }
+        break;
+        case CELLULAR_CTRL_CONNECT_STATE_ACTIVATING:
+            errorCode = activateContext(connectAsyncKeepGoing,
+                                        CELLULAR_CTRL_CONTEXT_ID);
+            if (errorCode == CELLULAR_CTRL_SUCCESS) {
+                if (gConnectAsync.imsiValid) {
+                    lastGoodSave(gConnectAsync.imsi, gConnectAsync.pApn);
+                }
+                connectAsyncSetState(CELLULAR_CTRL_CONNECT_STATE_CONNECTED,
+                                     CELLULAR_CTRL_SUCCESS);
+            } else if ((gConnectAsync.pApnConfig != NULL) &&
+                       (*gConnectAsync.pApnConfig != 0) &&
+                       connectAsyncKeepGoing()) {
+                // Try the next APN from the database
+                cellular_ctrl_at_lock();
+                cellular_ctrl_at_cmd_start("AT+CFUN=4");
+                cellular_ctrl_at_cmd_stop_read_resp();
+                cellular_ctrl_at_unlock();
+                connectAsyncSetState(CELLULAR_CTRL_CONNECT_STATE_REGISTERING,
+                                     CELLULAR_CTRL_SUCCESS);
+                errorCode = CELLULAR_CTRL_SUCCESS;
+            }
+        break;
+        default:
+            // Nothing to do, make sure we don't get called again
+            pollCancelIfIdle();
+        break;
     }
 
-    if (errorCode != CELLULAR_CTRL_SUCCESS) {
-        // Switch radio off after that failure
-        cellular_ctrl_at_lock();
-        cellular_ctrl_at_cmd_start("AT+CFUN=4");
-        cellular_ctrl_at_cmd_stop_read_resp();
-        cellular_ctrl_at_unlock();
+    if ((gConnectAsync.state != CELLULAR_CTRL_CONNECT_STATE_CONNECTED) &&
+        (gConnectAsync.state != CELLULAR_CTRL_CONNECT_STATE_FAILED) &&
+        (gConnectAsync.state != CELLULAR_CTRL_CONNECT_STATE_IDLE)) {
+        if (!connectAsyncKeepGoing()) {
+            cellularPortLog("CELLULAR_CTRL: asynchronous connect %s.\n",
+                            gConnectAsync.cancel ? "cancelled" : "timed out");
+            if (errorCode == CELLULAR_CTRL_SUCCESS) {
+                errorCode = CELLULAR_CTRL_NOT_REGISTERED;
+            }
+            connectAsyncSetState(CELLULAR_CTRL_CONNECT_STATE_FAILED, errorCode);
+        } else if (errorCode != CELLULAR_CTRL_SUCCESS) {
+            cellularPortLog("CELLULAR_CTRL: asynchronous connect failed in state %d"
+                            " (error %d).\n", gConnectAsync.state, errorCode);
+            connectAsyncSetState(CELLULAR_CTRL_CONNECT_STATE_FAILED, errorCode);
+        }
     }
-
-    return errorCode;
 }
 
 // Wait for power off to complete
@@ -784,6 +2221,19 @@ void waitForPowerOff(bool (*pKeepGoingCallback) (void),
 {
     bool moduleIsOff = false;
     int64_t endTimeMs = cellularPortGetTickTimeMs() + (timeoutSeconds * 1000);
+    CellularPortQueueHandle_t queueVInt = NULL;
+    int32_t pin;
+
+    // If we have a VInt pin, ask to be woken when it falls
+    // rather than polling it; not all platforms can do this
+    if ((pinVInt >= 0) &&
+        (cellularPortQueueCreate(1, sizeof(int32_t), &queueVInt) == 0) &&
+        (cellularPortGpioInterruptSet(pinVInt,
+                                      CELLULAR_PORT_GPIO_INTERRUPT_FALLING_EDGE,
+                                      queueVInt) != 0)) {
+        cellularPortQueueDelete(queueVInt);
+        queueVInt = NULL;
+    }
 
     while (!moduleIsOff &&
            (cellularPortGetTickTimeMs() < endTimeMs) &&
@@ -797,19 +2247,31 @@ void waitForPowerOff(bool (*pKeepGoingCallback) (void),
             // Wait for the module to stop responding at the AT interface
             // by poking it with "AT"
             cellular_ctrl_at_lock();
-            cellular_ctrl_at_set_at_timeout(CELLULAR_CTRL_COMMAND_MINIMUM_RESPONSE_TIME_MS, false);
+            cellular_ctrl_at_set_at_timeout(gpModuleProfile->commandMinimumResponseTimeMs, false);
             cellular_ctrl_at_cmd_start("AT");
             cellular_ctrl_at_cmd_stop_read_resp();
             moduleIsOff = (cellular_ctrl_at_get_last_error() != 0);
             cellular_ctrl_at_restore_at_timeout();
             cellular_ctrl_at_unlock();
         }
-        // Relax a bit
-        cellularPortTaskBlock(1000);
+        // Relax a bit, or until VInt falls; once VInt is
+        // low the module is off and there is no need to wait
+        if (queueVInt != NULL) {
+            if (!moduleIsOff) {
+                cellularPortQueueTryReceive(queueVInt, 1000, &pin);
+            }
+        } else {
+            cellularPortTaskBlock(1000);
+        }
     }
-}
 
-#ifdef CELLULAR_CFG_MODULE_SARA_R5
+    if (queueVInt != NULL) {
+        cellularPortGpioInterruptSet(pinVInt,
+                                     CELLULAR_PORT_GPIO_INTERRUPT_NONE,
+                                     NULL);
+        cellularPortQueueDelete(queueVInt);
+    }
+}
 
 // Convert RSRP in 36.133 format to dBm.
 // Returns 0 if the number is not known.
@@ -848,10 +2310,533 @@ static int32_t rsrqToDb(int32_t rsrq)
         }
     }
 
-    return rsrqDb;
-}
+    return rsrqDb;
+}
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS: AT LINK RECOVERY
+ * -------------------------------------------------------------- */
+
+// Take the next step up the ladder of recovery of the AT link,
+// called by ctrlPoll() on the callbacks task of the AT client,
+// the only task that the AT client lets talk to the module
+// while this is going on.  The first two steps take a second
+// or two, a reboot or a power cycle as long as the module
+// takes to boot.
+static void recoveryStep()
+{
+    bool recovered = false;
+
+    cellularPortLog("CELLULAR_CTRL: AT link recovery, step %d.\n",
+                    gRecoveryState);
+    switch (gRecoveryState) {
+        case CELLULAR_CTRL_RECOVERY_STATE_SYNC:
+            // Throw away anything half-received and see
+            // if the module answers
+            cellular_ctrl_at_lock();
+            cellular_ctrl_at_flush();
+            cellular_ctrl_at_unlock();
+            recovered = cellular_ctrl_at_sync(CELLULAR_CTRL_RECOVERY_SYNC_TIMEOUT_MS);
+        break;
+        case CELLULAR_CTRL_RECOVERY_STATE_ESCAPE:
+            // The module may have been left in a data mode,
+            // e.g. a direct-link socket that we lost track of
+            cellular_ctrl_at_escape(CELLULAR_CFG_SOCK_DIRECT_LINK_GUARD_TIME_MS);
+            recovered = cellular_ctrl_at_sync(CELLULAR_CTRL_RECOVERY_SYNC_TIMEOUT_MS);
+        break;
+        case CELLULAR_CTRL_RECOVERY_STATE_REBOOT:
+            recovered = (cellularCtrlReboot() == 0);
+        break;
+        case CELLULAR_CTRL_RECOVERY_STATE_POWER_CYCLE:
+            cellularCtrlHardPowerOff(false, NULL);
+            recovered = (cellularCtrlPowerOn(NULL) == 0);
+        break;
+        default:
+        break;
+    }
+
+    if (recovered || (gRecoveryState >= CELLULAR_CTRL_RECOVERY_STATE_POWER_CYCLE)) {
+        if (recovered) {
+            cellularPortLog("CELLULAR_CTRL: AT link recovered.\n");
+            gAtNumConsecutiveTimeouts = 0;
+        } else {
+            // Leave it to the application from here: not
+            // armed, so that this doesn't go round again
+            cellularPortLog("CELLULAR_CTRL: AT link recovery failed.\n");
+        }
+        gRecoveryArmed = recovered;
+        gRecoveryState = CELLULAR_CTRL_RECOVERY_STATE_IDLE;
+        cellular_ctrl_at_set_recovering(false);
+        pollCancelIfIdle();
+    } else {
+        gRecoveryState++;
+    }
+}
+
+// The function which the callbacks task of the AT client calls
+// when it is idle: recovery of the AT link comes first, an
+// asynchronous connection attempt is held until it is done.
+static void ctrlPoll(void *pUnused)
+{
+    if (gRecoveryState != CELLULAR_CTRL_RECOVERY_STATE_IDLE) {
+        recoveryStep();
+    } else {
+        connectAsyncStep(pUnused);
+    }
+}
+
+// Callback function to detect the cellular module becoming
+// unresponsive, run on the callbacks task of the AT client,
+// which starts recovery of the AT link once there have been
+// CELLULAR_CFG_CTRL_AT_RECOVERY_TIMEOUTS in a row.
+static void atTimeoutCallback(void *pNumConsecutiveTimeouts)
+{
+    gAtNumConsecutiveTimeouts = *((int32_t *) pNumConsecutiveTimeouts);
+#if CELLULAR_CFG_CTRL_AT_RECOVERY_TIMEOUTS > 0
+    if (gRecoveryArmed &&
+        (gRecoveryState == CELLULAR_CTRL_RECOVERY_STATE_IDLE) &&
+        (gAtNumConsecutiveTimeouts >= CELLULAR_CFG_CTRL_AT_RECOVERY_TIMEOUTS)) {
+        cellularPortLog("CELLULAR_CTRL: %d AT timeouts in a row, recovering"
+                        " the AT link.\n", gAtNumConsecutiveTimeouts);
+        // Everyone else fails at once from here on
+        cellular_ctrl_at_set_recovering(true);
+        gRecoveryState = CELLULAR_CTRL_RECOVERY_STATE_SYNC;
+        cellular_ctrl_at_set_callbacks_poll(ctrlPoll, NULL);
+    }
+#endif
+}
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS: POWER SAVING
+ * -------------------------------------------------------------- */
+
+// Encode a time in seconds as an 8-bit 3GPP GPRS timer string, e.g.
+// "00100011", using pUnitSeconds (one of gGprsTimer3UnitSeconds[]
+// or gGprsTimer2UnitSeconds[]) and rounding up: the unit chosen is
+// the finest one that can hold the time.  pStr must have room for
+// nine characters.  Returns false if the time can't be encoded.
+static bool gprsTimerEncode(int32_t seconds, const int32_t *pUnitSeconds,
+                            char *pStr)
+{
+    int32_t bestUnit = -1;
+    int32_t value = 0;
+    int32_t x;
+    int32_t bits;
+
+    for (int32_t unit = 0; unit < 8; unit++) {
+        if (pUnitSeconds[unit] > 0) {
+            x = (seconds + pUnitSeconds[unit] - 1) / pUnitSeconds[unit];
+            if ((x <= 31) &&
+                ((bestUnit < 0) ||
+                 (pUnitSeconds[unit] < pUnitSeconds[bestUnit]))) {
+                bestUnit = unit;
+                value = x;
+            }
+        }
+    }
+
+    if (bestUnit >= 0) {
+        bits = (bestUnit << 5) | value;
+        for (x = 0; x < 8; x++) {
+            pStr[x] = (bits & (0x80 >> x)) ? '1' : '0';
+        }
+        pStr[x] = 0;
+    }
+
+    return (bestUnit >= 0);
+}
+
+// Decode an 8-bit 3GPP GPRS timer string into seconds using
+// pUnitSeconds; returns -1 if it is not valid or is deactivated.
+static int32_t gprsTimerDecode(const char *pStr, const int32_t *pUnitSeconds)
+{
+    int32_t seconds = -1;
+    int32_t bits = 0;
+    int32_t x;
+
+    for (x = 0; (x < 8) && ((pStr[x] == '0') || (pStr[x] == '1')); x++) {
+        bits = (bits << 1) | (pStr[x] - '0');
+    }
+    if (x == 8) {
+        x = pUnitSeconds[bits >> 5];
+        if (x < 0) {
+            // Values 011 to 110 of a GPRS Timer 2 are as 001
+            if ((pUnitSeconds == gGprsTimer2UnitSeconds) &&
+                ((bits >> 5) < 7)) {
+                x = pUnitSeconds[1];
+            }
+        }
+        if (x > 0) {
+            seconds = x * (bits & 0x1f);
+        }
+    }
+
+    return seconds;
+}
+
+// Wake the module up from deep sleep.  This is called by the
+// AT layer with the AT stream already locked so it must
+// only use the cellular_ctrl_at_cmd_*() functions.
+static void wakeUpCallback(void *pUnused)
+{
+    int64_t startTimeMs;
+    bool awake = false;
+
+    (void) pUnused;
+
+    cellularPortLog("CELLULAR_CTRL: waking module up.\n");
+    // The same pulse as for power-on wakes the module from PSM
+    cellularPortGpioSet(gPinPwrOn, 0);
+    cellularPortTaskBlock(gpModuleProfile->pwrOnPullTimeMs);
+    cellularPortGpioSet(gPinPwrOn, 1);
+
+    // Wait for it to answer
+    startTimeMs = cellularPortGetTickTimeMs();
+    cellular_ctrl_at_set_at_timeout(CELLULAR_CTRL_BOOT_POLL_TIMEOUT_MS, false);
+    while (!awake && (cellularPortGetTickTimeMs() - startTimeMs <
+                      gpModuleProfile->bootWaitTimeMs)) {
+        cellular_ctrl_at_cmd_start("AT");
+        cellular_ctrl_at_cmd_stop_read_resp();
+        awake = (cellular_ctrl_at_get_last_error() == 0);
+        cellular_ctrl_at_clear_error();
+        if (!awake) {
+            cellularPortTaskBlock(CELLULAR_CTRL_BOOT_POLL_INTERVAL_MS);
+        }
+    }
+    cellular_ctrl_at_restore_at_timeout();
+
+    if (awake) {
+        // Coming out of deep sleep is like a boot so the
+        // settings that only live in the active profile
+        // need to be sent again
+        cellular_ctrl_at_cmd_start(pVolatileConfigStr(gUart));
+        cellular_ctrl_at_cmd_stop_read_resp();
+        cellular_ctrl_at_clear_error();
+        if (gpModuleProfile->ucgedMode == 5) {
+            cellular_ctrl_at_cmd_start("AT+UCGED=5");
+            cellular_ctrl_at_cmd_stop_read_resp();
+            cellular_ctrl_at_clear_error();
+        }
+        gAtNumConsecutiveTimeouts = 0;
+    } else {
+        cellularPortLog("CELLULAR_CTRL: module did not wake up.\n");
+    }
+}
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS: SECURITY PROFILES
+ * -------------------------------------------------------------- */
+
+// Set an integer operation of a security profile, if it
+// is not negative.  The AT stream must be locked.
+static void securityProfileSetInt(int32_t profileId, int32_t opCode,
+                                  int32_t value)
+{
+    if (value >= 0) {
+        cellular_ctrl_at_cmd_start("AT+USECPRF=");
+        cellular_ctrl_at_write_int(profileId);
+        cellular_ctrl_at_write_int(opCode);
+        cellular_ctrl_at_write_int(value);
+        cellular_ctrl_at_cmd_stop_read_resp();
+    }
+}
+
+// Set a string operation of a security profile, if it
+// is not NULL.  The AT stream must be locked.
+static void securityProfileSetString(int32_t profileId, int32_t opCode,
+                                     const char *pStr)
+{
+    if (pStr != NULL) {
+        cellular_ctrl_at_cmd_start("AT+USECPRF=");
+        cellular_ctrl_at_write_int(profileId);
+        cellular_ctrl_at_write_int(opCode);
+        cellular_ctrl_at_write_string(pStr, true);
+        cellular_ctrl_at_cmd_stop_read_resp();
+    }
+}
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS: END TO END ENCRYPTION
+ * -------------------------------------------------------------- */
+
+#if CELLULAR_CTRL_SECURITY_ROOT_OF_TRUST
+// Tell the module which APN to use on the PDP context that
+// it establishes for the security service functions, which
+// current SARA-R5 devices need before they can be sealed.
+static CellularCtrlErrorCode_t securitySealApnSet()
+{
+    CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_NO_MEMORY;
+    char *pApn;
+
+    pApn = pCellularPort_mallocTag(CELLULAR_CTRL_APN_LENGTH,
+                                   CELLULAR_PORT_MALLOC_TAG_CTRL);
+    if (pApn != NULL) {
+        errorCode = cellularCtrlGetApnStr(pApn, CELLULAR_CTRL_APN_LENGTH);
+        if (errorCode > 0) {
+            errorCode = CELLULAR_CTRL_AT_ERROR;
+            cellular_ctrl_at_lock();
+            cellular_ctrl_at_cmd_start("AT+USECOPCMD=");
+            cellular_ctrl_at_write_string("cfgpdn", true);
+            cellular_ctrl_at_write_string(pApn, true);
+            cellular_ctrl_at_cmd_stop_read_resp();
+            if (cellular_ctrl_at_unlock_return_error() == 0) {
+                errorCode = CELLULAR_CTRL_SUCCESS;
+            }
+        }
+        // Free memory
+        cellularPort_free(pApn);
+    }
+
+    return errorCode;
+}
+
+// Have the module encrypt one block of data, returning the
+// number of bytes of cipher text written to pDataOut or
+// negative error code.  pDataIn and pDataOut may be the
+// same buffer since the plain text has all been sent before
+// the cipher text is read.
+static int32_t e2eEncryptChunk(const void *pDataIn, void *pDataOut,
+                               size_t dataSizeBytes)
+{
+    int32_t errorCodeOrSize = (int32_t) CELLULAR_CTRL_AT_ERROR;
+    int32_t sizeOutBytes = 0;
+    uint8_t quoteMark;
+
+    cellular_ctrl_at_lock();
+    cellular_ctrl_at_cmd_start("AT+USECE2EDATAENC=");
+    cellular_ctrl_at_write_int(dataSizeBytes);
+    cellular_ctrl_at_cmd_stop();
+    // Wait for the prompt
+    if (cellular_ctrl_at_wait_char('>')) {
+        // Wait for it...
+        cellularPortTaskBlock(CELLULAR_CFG_CTRL_E2E_PROMPT_GUARD_TIME_MS);
+        // Go!
+        cellular_ctrl_at_write_bytes((uint8_t *) pDataIn,
+                                     dataSizeBytes);
+        // Grab the response
+        cellular_ctrl_at_resp_start("+USECE2EDATAENC:", false);
+        // Read the amount of data that has been encryptd
+        sizeOutBytes = cellular_ctrl_at_read_int();
+        if (sizeOutBytes > dataSizeBytes +
+                           CELLULAR_CTRL_END_TO_END_ENCRYPT_HEADER_SIZE_BYTES) {
+            sizeOutBytes = dataSizeBytes +
+                           CELLULAR_CTRL_END_TO_END_ENCRYPT_HEADER_SIZE_BYTES;
+        }
+        // Don't stop for anything!
+        cellular_ctrl_at_set_delimiter(0);
+        cellular_ctrl_at_set_stop_tag(NULL);
+        // Get the leading quote mark out of the way
+        cellular_ctrl_at_read_bytes(&quoteMark, 1);
+        // Now read the actual data
+        cellular_ctrl_at_read_bytes((uint8_t *) pDataOut,
+                                    sizeOutBytes);
+        cellular_ctrl_at_resp_stop();
+        cellular_ctrl_at_set_default_delimiter();
+        if (cellular_ctrl_at_unlock_return_error() == 0) {
+            // All is good
+            errorCodeOrSize = sizeOutBytes;
+        }
+    } else {
+        cellular_ctrl_at_unlock();
+    }
+
+    return errorCodeOrSize;
+}
+#endif // CELLULAR_CTRL_SECURITY_ROOT_OF_TRUST
+
+// Encrypt the plain text held in a stream, in place, and
+// pass the cipher text to the output function; this is
+// done with the AT interface unlocked so that the output
+// function can write to a socket or MQTT.  Any error,
+// from here or from the output function, is latched in
+// the stream.
+static void e2eStreamFlush(CellularSecurityEndToEndEncryptStream_t *pStream)
+{
+#if CELLULAR_CTRL_SECURITY_ROOT_OF_TRUST
+    int32_t sizeOrError;
+
+    sizeOrError = e2eEncryptChunk(pStream->pBuffer, pStream->pBuffer,
+                                  pStream->bufferLength);
+    pStream->bufferLength = 0;
+    if (sizeOrError >= 0) {
+        pStream->errorCodeOrSize += sizeOrError;
+        sizeOrError = pStream->pOutput(pStream->pBuffer, sizeOrError,
+                                       pStream->pOutputParam);
+    }
+    if (sizeOrError < 0) {
+        pStream->errorCodeOrSize = sizeOrError;
+    }
+#else
+    pStream->errorCodeOrSize = (int32_t) CELLULAR_CTRL_NOT_SUPPORTED;
+#endif // CELLULAR_CTRL_SECURITY_ROOT_OF_TRUST
+}
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS: TRANSMIT SCHEDULER
+ * -------------------------------------------------------------- */
+
+// Put a command on the queue of the transmit scheduler, unless
+// the same one is already there, so that the queue never fills.
+// gTxScheduler.mutex must be locked on entry.
+static void txSchedulerCommand(uint8_t command)
+{
+    bool *pPending = NULL;
+
+    if (command == CELLULAR_CTRL_TX_SCHEDULER_WAKE) {
+        pPending = &gTxScheduler.wakePending;
+    } else if (command == CELLULAR_CTRL_TX_SCHEDULER_FLUSH) {
+        pPending = &gTxScheduler.flushPending;
+    }
+    if ((pPending == NULL) || !*pPending) {
+        if (pPending != NULL) {
+            *pPending = true;
+        }
+        cellularPortQueueSend(gTxScheduler.queue, &command);
+    }
+}
+
+// Refresh the radio parameters and determine if they
+// are good enough to release what is held back.
+static bool txSchedulerRadioIsGood()
+{
+    bool isGood = false;
+    int32_t rsrpDbm;
+    int32_t snrDb;
+
+    if (cellularCtrlRefreshRadioParameters() == 0) {
+        rsrpDbm = cellularCtrlGetRsrpDbm();
+        isGood = (rsrpDbm < 0) &&
+                 (rsrpDbm >= gTxScheduler.rsrpThresholdDbm) &&
+                 ((cellularCtrlGetSnrDb(&snrDb) != 0) ||
+                  (snrDb >= gTxScheduler.snrThresholdDb));
+        cellularPortLog("CELLULAR_CTRL: transmit scheduler sees RSRP %d dBm,"
+                        " radio conditions are %s.\n", rsrpDbm,
+                        isGood ? "good" : "not good enough");
+    }
+
+    return isGood;
+}
+
+// Get how long the task of the transmit scheduler should
+// wait for, -1 for ever.
+static int64_t txSchedulerWaitMs(int64_t nextCheckMs, int64_t nowMs)
+{
+    int64_t untilMs = -1;
+    CellularCtrlTxSchedulerEntry_t *pEntry;
+
+    CELLULAR_PORT_MUTEX_LOCK(gTxScheduler.mutex);
+
+    if (gTxScheduler.pFirst != NULL) {
+        untilMs = nextCheckMs;
+        for (pEntry = gTxScheduler.pFirst; pEntry != NULL; pEntry = pEntry->pNext) {
+            if (pEntry->deadlineMs < untilMs) {
+                untilMs = pEntry->deadlineMs;
+            }
+        }
+        untilMs -= nowMs;
+        if (untilMs < 0) {
+            untilMs = 0;
+        }
+    }
+
+    CELLULAR_PORT_MUTEX_UNLOCK(gTxScheduler.mutex);
+
+    return untilMs;
+}
+
+// Send what is held back, in the order it was given: everything
+// if releaseAll is true, else everything up to and including the
+// last send whose deadline has arrived, so that the order of, for
+// instance, the data on a TCP socket is kept.
+static void txSchedulerRelease(bool releaseAll, int64_t nowMs)
+{
+    CellularCtrlTxSchedulerEntry_t *pEntry;
+    CellularCtrlTxSchedulerEntry_t *pLastToGo = NULL;
+    int32_t errorCode;
+    bool done = false;
+
+    CELLULAR_PORT_MUTEX_LOCK(gTxScheduler.mutex);
+    for (pEntry = gTxScheduler.pFirst; pEntry != NULL; pEntry = pEntry->pNext) {
+        if (releaseAll || (pEntry->deadlineMs <= nowMs)) {
+            pLastToGo = pEntry;
+        }
+    }
+    CELLULAR_PORT_MUTEX_UNLOCK(gTxScheduler.mutex);
+
+    // Only this task takes entries off the front, so the list
+    // need not be locked while sending
+    while ((pLastToGo != NULL) && !done) {
+        CELLULAR_PORT_MUTEX_LOCK(gTxScheduler.mutex);
+        pEntry = gTxScheduler.pFirst;
+        gTxScheduler.pFirst = pEntry->pNext;
+        if (gTxScheduler.pFirst == NULL) {
+            gTxScheduler.pLast = NULL;
+        }
+        gTxScheduler.pendingBytes -= pEntry->dataSizeBytes;
+        CELLULAR_PORT_MUTEX_UNLOCK(gTxScheduler.mutex);
+
+        errorCode = pEntry->pSend((const void *) (pEntry + 1),
+                                  pEntry->dataSizeBytes,
+                                  pEntry->pSendParam);
+        if (errorCode < 0) {
+            cellularPortLog("CELLULAR_CTRL: transmit scheduler send of %d"
+                            " byte(s) failed (%d).\n",
+                            (int32_t) pEntry->dataSizeBytes, errorCode);
+        }
+        done = (pEntry == pLastToGo);
+        cellularPort_free(pEntry);
+    }
+}
+
+// The task of the transmit scheduler.
+static void txSchedulerTask(void *pParameters)
+{
+    uint8_t command;
+    bool keepGoing = true;
+    bool radioIsGood = false;
+    int64_t nextCheckMs = 0;
+    int64_t nowMs;
+    int64_t waitMs;
+
+    CELLULAR_PORT_MUTEX_LOCK(gTxScheduler.mutexTaskRunning);
+
+    (void) pParameters;
+
+    while (keepGoing) {
+        command = CELLULAR_CTRL_TX_SCHEDULER_WAKE;
+        waitMs = txSchedulerWaitMs(nextCheckMs, cellularPortGetTickTimeMs());
+        if (waitMs < 0) {
+            cellularPortQueueReceive(gTxScheduler.queue, &command);
+        } else {
+            cellularPortQueueTryReceive(gTxScheduler.queue, (int32_t) waitMs,
+                                        &command);
+        }
+        CELLULAR_PORT_MUTEX_LOCK(gTxScheduler.mutex);
+        if (command == CELLULAR_CTRL_TX_SCHEDULER_WAKE) {
+            gTxScheduler.wakePending = false;
+        } else if (command == CELLULAR_CTRL_TX_SCHEDULER_FLUSH) {
+            gTxScheduler.flushPending = false;
+        }
+        CELLULAR_PORT_MUTEX_UNLOCK(gTxScheduler.mutex);
+        keepGoing = (command != CELLULAR_CTRL_TX_SCHEDULER_EXIT);
+
+        nowMs = cellularPortGetTickTimeMs();
+        if (keepGoing && (command != CELLULAR_CTRL_TX_SCHEDULER_FLUSH) &&
+            (gTxScheduler.pFirst != NULL) && (nowMs >= nextCheckMs)) {
+            // What was measured is out of date
+            radioIsGood = txSchedulerRadioIsGood();
+            nextCheckMs = cellularPortGetTickTimeMs() + gTxScheduler.checkIntervalMs;
+        }
+        txSchedulerRelease(!keepGoing || radioIsGood ||
+                           (command == CELLULAR_CTRL_TX_SCHEDULER_FLUSH),
+                           nowMs);
+    }
+
+    CELLULAR_PORT_MUTEX_UNLOCK(gTxScheduler.mutexTaskRunning);
 
-#endif
+    // Delete ourself
+    cellularPortTaskDelete(NULL);
+}
 
 /* ----------------------------------------------------------------
  * PUBLIC FUNCTIONS
@@ -938,16 +2923,45 @@ int32_t cellularCtrlInit(int32_t pinEnablePower,
                     if (platformError == 0) {
                         // With that all done, initialise the AT command parser
                         errorCode = cellular_ctrl_at_init(uart, queueUart);
+                        if ((errorCode == 0) &&
+                            (cellularPortQueueCreate(1, sizeof(CellularCtrlRan_t),
+                                                     &gQueueRegEvent) != 0)) {
+                            cellular_ctrl_at_deinit(uart);
+                            errorCode = CELLULAR_CTRL_PLATFORM_ERROR;
+                        }
                         if (errorCode == 0) {
-                            cellular_ctrl_at_set_at_timeout(CELLULAR_CTRL_COMMAND_TIMEOUT_MS, true);
+                            gRegEventPending = false;
+                            cellular_ctrl_at_set_at_timeout(gpModuleProfile->commandTimeoutMs,
+                                                            true);
                             gPinEnablePower = pinEnablePower;
                             gPinPwrOn = pinPwrOn;
                             gPinVInt = pinVInt;
                             gUart = uart;
-                            for (size_t x = 0; x < sizeof(gNetworkStatus) / sizeof(gNetworkStatus[0]); x++) {
-                                gNetworkStatus[x] = CELLULAR_CTRL_NETWORK_STATUS_UNKNOWN;
-                            }
+                            gQueueUart = queueUart;
+                            gBaudRate = CELLULAR_CFG_BAUD_RATE;
+                            clearNetworkStatus();
                             clearRadioParameters();
+                            idCacheClear();
+                            timeCacheClear();
+                            cellular_ctrl_at_set_urc_handler("+UUSIMSTAT:",
+                                                             UUSIMSTAT_urc, NULL);
+                            cellular_ctrl_at_set_urc_handler("+CTZE:",
+                                                             CTZE_urc, NULL);
+                            cellular_ctrl_at_set_urc_handler("+UUPSMR:",
+                                                             UUPSMR_urc, NULL);
+                            // The registration URCs may already be
+                            // switched on in a module that stayed
+                            // powered, don't let them be taken as
+                            // the response to a command
+                            cellular_ctrl_at_set_urc_handler("+CREG:",
+                                                             CREG_urc, NULL);
+                            cellular_ctrl_at_set_urc_handler("+CGREG:",
+                                                             CGREG_urc, NULL);
+                            cellular_ctrl_at_set_urc_handler("+CEREG:",
+                                                             CEREG_urc, NULL);
+                            cellular_ctrl_at_set_wake_up_callback(wakeUpCallback,
+                                                                  NULL);
+                            lastGoodLoad();
                             gAtNumConsecutiveTimeouts = 0;
                             cellular_ctrl_at_set_at_timeout_callback(atTimeoutCallback);
                             gInitialised = true;
@@ -974,8 +2988,21 @@ void cellularCtrlDeinit()
 {
     if (gInitialised) {
         // Tidy up
+        cellularCtrlTxSchedulerStop();
+        if (gPinRi >= 0) {
+            cellularPortGpioInterruptSet(gPinRi,
+                                         CELLULAR_PORT_GPIO_INTERRUPT_NONE,
+                                         NULL);
+            gPinRi = -1;
+        }
         cellular_ctrl_at_set_at_timeout_callback(NULL);
+        gRecoveryArmed = false;
+        gRecoveryState = CELLULAR_CTRL_RECOVERY_STATE_IDLE;
+        cmuxStop(false);
         cellular_ctrl_at_deinit(gUart);
+        gConnectAsync.state = CELLULAR_CTRL_CONNECT_STATE_IDLE;
+        cellularPortQueueDelete(gQueueRegEvent);
+        gQueueRegEvent = NULL;
         gInitialised = false;
     }
 }
@@ -1016,6 +3043,10 @@ int32_t cellularCtrlPowerOn(const char *pPin)
         if (gPinEnablePower >= 0) {
             enablePowerAtStart = cellularPortGpioGet(gPinEnablePower);
         }
+        // The module, or the SIM, may have been swapped
+        idCacheClear();
+        // ...and its clock will have started again
+        timeCacheClear();
         errorCode = CELLULAR_CTRL_PIN_ENTRY_NOT_SUPPORTED;
         if (pPin == NULL) {
             errorCode = CELLULAR_CTRL_PLATFORM_ERROR;
@@ -1026,7 +3057,7 @@ int32_t cellularCtrlPowerOn(const char *pPin)
             // Note: doing this even if there is an enable power
             // pin for safety sake
             if (((gPinVInt >= 0) && cellularPortGpioGet(gPinVInt)) ||
-                (moduleIsAlive(1) == CELLULAR_CTRL_SUCCESS)) {
+                (moduleIsAliveAnyBaudRate(1) == CELLULAR_CTRL_SUCCESS)) {
                 cellularPortLog("CELLULAR_CTRL: powering on, module is already on, flushing...\n");
                 // Configure the module
                 errorCode = moduleConfigure(gUart);
@@ -1043,22 +3074,31 @@ int32_t cellularCtrlPowerOn(const char *pPin)
                     if (platformError == 0) {
                         // Power the module on by holding the PWR_ON pin low
                         // for the correct number of milliseconds
-                        cellularPortTaskBlock(CELLULAR_CTRL_PWR_ON_PULL_TIME_MS);
+                        cellularPortTaskBlock(gpModuleProfile->pwrOnPullTimeMs);
                         // Not bothering with checking return code here
                         // as it would have barfed on the last one if
                         // it were going to
                         cellularPortGpioSet(gPinPwrOn, 1);
-                        cellularPortTaskBlock(CELLULAR_CTRL_BOOT_WAIT_TIME_MS);
-#ifdef CELLULAR_CFG_MODULE_SARA_R5
+                        // Carry on as soon as the module answers
+                        // rather than waiting for the worst case
+                        errorCode = CELLULAR_CTRL_NOT_RESPONDING;
+                        if (waitForAlive(true, gpModuleProfile->bootWaitTimeMs)) {
+                            errorCode = CELLULAR_CTRL_SUCCESS;
+                        }
                         // SARA-R5 chucks out a load of stuff after
-                        // boot at the moment: flush it away
+                        // boot at the moment: flush it away; done
+                        // whatever the module since which module
+                        // it is isn't known until it is configured
                         char buffer[8];
                         while (cellularPortUartRead(gUart, buffer, sizeof(buffer)) > 0) {}
-#endif
-                        // Cellular module should be up, see if it's there
-                        // and, if so, configure it
-                        errorCode = moduleIsAlive(CELLULAR_CTRL_IS_ALIVE_ATTEMPTS_POWER_ON);
+                        // If it didn't answer in time, give it the
+                        // usual number of chances before giving up
+                        if (errorCode != CELLULAR_CTRL_SUCCESS) {
+                            errorCode = moduleIsAliveAnyBaudRate(CELLULAR_CTRL_IS_ALIVE_ATTEMPTS_POWER_ON);
+                        }
                         if (errorCode == CELLULAR_CTRL_SUCCESS) {
+                            // Timeouts while it was booting don't count
+                            gAtNumConsecutiveTimeouts = 0;
                             // Configure the module
                             errorCode = moduleConfigure(gUart);
                         }
@@ -1079,6 +3119,9 @@ int32_t cellularCtrlPowerOn(const char *pPin)
         } else {
             cellularPortLog("CELLULAR_CTRL: a SIM PIN has been set but PIN entry is not supported I'm afraid.\n");
         }
+        if (errorCode == CELLULAR_CTRL_SUCCESS) {
+            gRecoveryArmed = true;
+        }
     }
 
     return (int32_t) errorCode;
@@ -1089,6 +3132,7 @@ void cellularCtrlPowerOff(bool (*pKeepGoingCallback) (void))
 {
     if (gInitialised) {
         cellularPortLog("CELLULAR_CTRL: powering off with AT command.\n");
+        gRecoveryArmed = false;
         // Send the power off command and then pull the power
         // No error checking, we're going dowwwwwn...
         cellular_ctrl_at_lock();
@@ -1097,9 +3141,10 @@ void cellularCtrlPowerOff(bool (*pKeepGoingCallback) (void))
         cellular_ctrl_at_cmd_start("AT+CPWROFF");
         cellular_ctrl_at_cmd_stop_read_resp();
         cellular_ctrl_at_unlock();
+        cmuxStop(false);
         // Wait for the module to power down
         waitForPowerOff(pKeepGoingCallback, gPinVInt,
-                        CELLULAR_CTRL_POWER_DOWN_WAIT_SECONDS);
+                        gpModuleProfile->powerDownWaitSeconds);
         // Now switch off power if possible
         if (gPinEnablePower >= 0) {
             cellularPortGpioSet(gPinEnablePower, 0);
@@ -1113,6 +3158,8 @@ void cellularCtrlPowerOff(bool (*pKeepGoingCallback) (void))
 void cellularCtrlHardPowerOff(bool trulyHard, bool (*pKeepGoingCallback) (void))
 {
     if (gInitialised) {
+        gRecoveryArmed = false;
+        cmuxStop(false);
         // If we have control of power and the user
         // wants a truly hard power off then just do it.
         if (trulyHard && (gPinEnablePower > 0)) {
@@ -1123,13 +3170,13 @@ void cellularCtrlHardPowerOff(bool trulyHard, bool (*pKeepGoingCallback) (void))
             cellularPortGpioSet(gPinPwrOn, 0);
             // Power off the module by pulling the PWR_ON pin
             // low for the correct number of milliseconds
-            cellularPortTaskBlock(CELLULAR_CTRL_PWR_OFF_PULL_TIME_MS);
+            cellularPortTaskBlock(gpModuleProfile->pwrOffPullTimeMs);
             cellularPortGpioSet(gPinPwrOn, 1);
             // Clear out the old RF readings
             clearRadioParameters();
             // Wait for the module to power down
             waitForPowerOff(pKeepGoingCallback, gPinVInt,
-                            CELLULAR_CTRL_POWER_DOWN_WAIT_SECONDS);
+                            gpModuleProfile->powerDownWaitSeconds);
             // Now switch off power if possible
             if (gPinEnablePower > 0) {
                 cellularPortGpioSet(gPinEnablePower, 0);
@@ -1146,50 +3193,123 @@ int32_t cellularCtrlGetConsecutiveAtTimeouts()
     return gAtNumConsecutiveTimeouts;
 }
 
+// Determine whether the AT link is being recovered.
+bool cellularCtrlIsRecovering()
+{
+    return gRecoveryState != CELLULAR_CTRL_RECOVERY_STATE_IDLE;
+}
+
 // Re-boot the cellular module.
 int32_t cellularCtrlReboot()
 {
     CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_NOT_INITIALISED;
+    bool wasArmed = gRecoveryArmed;
 
     if (gInitialised) {
         errorCode = CELLULAR_CTRL_AT_ERROR;
         cellularPortLog("CELLULAR_CTRL: rebooting.\n");
+        // The timeouts while the module reboots are expected
+        gRecoveryArmed = false;
         cellular_ctrl_at_lock();
-        cellular_ctrl_at_set_at_timeout(CELLULAR_CTRL_REBOOT_COMMAND_WAIT_TIME_MS,
+        cellular_ctrl_at_set_at_timeout(gpModuleProfile->rebootCommandWaitTimeMs,
                                         false);
-        // Clear out the old RF readings
+        // Clear out the old RF readings, identity and time
         clearRadioParameters();
-#ifdef CELLULAR_CFG_MODULE_SARA_R5
-        // SARA-R5 doesn't support 15 (which doesn't reset the SIM)
-        cellular_ctrl_at_cmd_start("AT+CFUN=16");
-#else
-        cellular_ctrl_at_cmd_start("AT+CFUN=15");
-#endif
+        idCacheClear();
+        timeCacheClear();
+        // 15 doesn't reset the SIM but not all modules
+        // support it
+        cellular_ctrl_at_cmd_start("AT+CFUN=");
+        cellular_ctrl_at_write_int(gpModuleProfile->rebootCfun);
         cellular_ctrl_at_cmd_stop_read_resp();
         cellular_ctrl_at_restore_at_timeout();
         if (cellular_ctrl_at_unlock_return_error() == 0) {
-            // Wait for the module to boot
-            cellularPortTaskBlock(CELLULAR_CTRL_BOOT_WAIT_TIME_MS);
-#ifdef CELLULAR_CFG_MODULE_SARA_R5
+            // The module will come back without CMUX
+            cmuxStop(false);
+            // Wait for the module to go away and then
+            // come back, rather than waiting for the
+            // worst case; if we don't see it go
+            // away then that was the worst case anyway
+            if (waitForAlive(false, gpModuleProfile->bootWaitTimeMs)) {
+                waitForAlive(true, gpModuleProfile->bootWaitTimeMs);
+            }
             // SARA-R5 chucks out a load of stuff after
-            // boot at the moment: flush it away
+            // boot at the moment: flush it away, whatever
+            // the module, as for power-on
             char buffer[8];
             while (cellularPortUartRead(gUart, buffer, sizeof(buffer)) > 0) {}
-#endif
             // Wait for the module to return to life
             // and configure it
-            errorCode = moduleIsAlive(CELLULAR_CTRL_IS_ALIVE_ATTEMPTS_POWER_ON);
+            errorCode = moduleIsAliveAnyBaudRate(CELLULAR_CTRL_IS_ALIVE_ATTEMPTS_POWER_ON);
             if (errorCode == CELLULAR_CTRL_SUCCESS) {
                 // Configure the module
                 errorCode = moduleConfigure(gUart);
             }
+            // Any registration URCs that turned up while
+            // the module rebooted no longer hold
+            clearNetworkStatus();
+            gRecoveryArmed = (errorCode == CELLULAR_CTRL_SUCCESS);
             gAtNumConsecutiveTimeouts = 0;
+        } else {
+            // Didn't even start
+            gRecoveryArmed = wasArmed;
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Start CMUX and move the AT client on to a virtual channel.
+int32_t cellularCtrlCmuxStart()
+{
+    CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_NOT_INITIALISED;
+    CellularPortQueueHandle_t queueChannel;
+    int32_t uartChannel;
+
+    if (gInitialised) {
+        errorCode = CELLULAR_CTRL_SUCCESS;
+        if (!cellularCtrlCmuxIsRunning()) {
+            errorCode = CELLULAR_CTRL_AT_ERROR;
+            cellular_ctrl_at_lock();
+            // Basic option, UIH frames, existing port speed
+            cellular_ctrl_at_cmd_start("AT+CMUX=");
+            cellular_ctrl_at_write_int(0);
+            cellular_ctrl_at_write_int(0);
+            cellular_ctrl_at_write_string("", false);
+            cellular_ctrl_at_write_int(CELLULAR_CFG_CMUX_FRAME_SIZE);
+            cellular_ctrl_at_cmd_stop_read_resp();
+            if (cellular_ctrl_at_get_last_error() == 0) {
+                // The module is now talking CMUX: keep the
+                // AT interface locked until the AT client
+                // has been moved on to its channel
+                errorCode = CELLULAR_CTRL_PLATFORM_ERROR;
+                if (cellularCtrlCmuxInit(gUart, gQueueUart) == 0) {
+                    uartChannel = cellularCtrlCmuxChannelOpen(CELLULAR_CTRL_CMUX_CHANNEL_AT,
+                                                              &queueChannel);
+                    if ((uartChannel >= 0) &&
+                        (cellular_ctrl_at_set_uart(uartChannel, queueChannel) == 0)) {
+                        errorCode = CELLULAR_CTRL_SUCCESS;
+                    } else {
+                        cellularCtrlCmuxDeinit(true);
+                    }
+                }
+            }
+            cellular_ctrl_at_clear_error();
+            cellular_ctrl_at_unlock();
         }
     }
 
     return (int32_t) errorCode;
 }
 
+// Stop CMUX.
+void cellularCtrlCmuxStop()
+{
+    if (gInitialised) {
+        cmuxStop(true);
+    }
+}
+
 // Set the bands to be used by the cellular module.
 int32_t cellularCtrlSetBandMask(CellularCtrlRat_t rat,
                                 uint64_t bandMask1,
@@ -1400,7 +3520,8 @@ int32_t cellularCtrlSetRat(CellularCtrlRat_t rat)
 int32_t cellularCtrlSetRatRank(CellularCtrlRat_t rat, int32_t rank)
 {
     CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_NOT_INITIALISED;
-    int32_t rats[CELLULAR_CTRL_MAX_NUM_SIMULTANEOUS_RATS];
+    int32_t rats[CELLULAR_CTRL_MAX_NUM_RATS];
+    size_t numRats = gpModuleProfile->maxNumSimultaneousRats;
 
     if (gInitialised) {
         errorCode = CELLULAR_CTRL_INVALID_PARAMETER;
@@ -1409,14 +3530,14 @@ int32_t cellularCtrlSetRatRank(CellularCtrlRat_t rat, int32_t rank)
         if ((rat >= CELLULAR_CTRL_RAT_UNKNOWN_OR_NOT_USED) &&
             (rat < CELLULAR_CTRL_MAX_NUM_RATS)) {
             if ((rank >= 0) &&
-                (rank < CELLULAR_CTRL_MAX_NUM_SIMULTANEOUS_RATS)) {
+                (rank < gpModuleProfile->maxNumSimultaneousRats)) {
                 // Assume there are no RATs
-                for (size_t x = 0; x < sizeof(rats) / sizeof(rats[0]); x++) {
+                for (size_t x = 0; x < numRats; x++) {
                     rats[x] = CELLULAR_CTRL_RAT_UNKNOWN_OR_NOT_USED;
                 }
                 // Get the existing RATs
                 errorCode = CELLULAR_CTRL_AT_ERROR;
-                for (size_t x = 0; x < sizeof(rats) / sizeof(rats[0]); x++) {
+                for (size_t x = 0; x < numRats; x++) {
                     rats[x] = cellularCtrlGetRat(x);
                     if (rats[x] == CELLULAR_CTRL_RAT_UNKNOWN_OR_NOT_USED) {
                         break;
@@ -1428,8 +3549,8 @@ int32_t cellularCtrlSetRatRank(CellularCtrlRat_t rat, int32_t rank)
                 cellularPortLog("CELLULAR_CTRL: setting the RAT at rank %d to %d (in module terms %d).\n",
                                 rank, rat, gCellularRatToLocalRat[rat]);
                 // Remove duplicates
-                for (size_t x = 0; x < sizeof(rats) / sizeof(rats[0]); x++) {
-                    for (size_t y = x + 1; y < sizeof(rats) / sizeof(rats[0]); y++) {
+                for (size_t x = 0; x < numRats; x++) {
+                    for (size_t y = x + 1; y < numRats; y++) {
                         if ((rats[x] > CELLULAR_CTRL_RAT_UNKNOWN_OR_NOT_USED) && (rats[x] == rats[y])) {
                             rats[y] = CELLULAR_CTRL_RAT_UNKNOWN_OR_NOT_USED;
                         }
@@ -1438,14 +3559,14 @@ int32_t cellularCtrlSetRatRank(CellularCtrlRat_t rat, int32_t rank)
 
                 // Send the AT command
                 cellularPortLog("CELLULAR_CTRL: RATs (removing duplicates) become:\n");
-                for (size_t x = 0, y = 0; x < sizeof(rats) / sizeof(rats[0]); x++) {
+                for (size_t x = 0, y = 0; x < numRats; x++) {
                     cellularPortLog("  rank[%d]: %d (in module terms %d).\n",
                                     x, rats[x], gCellularRatToLocalRat[rats[x]]);
                     y++;
                 }
                 cellular_ctrl_at_lock();
                 cellular_ctrl_at_cmd_start("AT+URAT=");
-                for (size_t x = 0; x < sizeof(rats) / sizeof(rats[0]); x++) {
+                for (size_t x = 0; x < numRats; x++) {
                     if (rats[x] != CELLULAR_CTRL_RAT_UNKNOWN_OR_NOT_USED) {
                         cellular_ctrl_at_write_int(gCellularRatToLocalRat[rats[x]]);
                     }
@@ -1465,24 +3586,25 @@ int32_t cellularCtrlSetRatRank(CellularCtrlRat_t rat, int32_t rank)
 int32_t cellularCtrlGetRat(int32_t rank)
 {
     CellularCtrlErrorCode_t errorCodeOrRat = CELLULAR_CTRL_NOT_INITIALISED;
-    CellularCtrlRat_t rats[CELLULAR_CTRL_MAX_NUM_SIMULTANEOUS_RATS];
+    CellularCtrlRat_t rats[CELLULAR_CTRL_MAX_NUM_RATS];
+    size_t numRats = gpModuleProfile->maxNumSimultaneousRats;
     int32_t rat;
 
     // Assume there are no RATs
-    for (size_t x = 0; x < sizeof(rats) / sizeof (rats[0]); x++) {
+    for (size_t x = 0; x < numRats; x++) {
         rats[x] = CELLULAR_CTRL_RAT_UNKNOWN_OR_NOT_USED;
     }
 
     if (gInitialised) {
         errorCodeOrRat = CELLULAR_CTRL_INVALID_PARAMETER;
-        if ((rank >= 0) && (rank < CELLULAR_CTRL_MAX_NUM_SIMULTANEOUS_RATS)) {
+        if ((rank >= 0) && (rank < gpModuleProfile->maxNumSimultaneousRats)) {
             // Get the RAT from the module
             cellular_ctrl_at_lock();
             cellular_ctrl_at_cmd_start("AT+URAT?");
             cellular_ctrl_at_cmd_stop();
             cellular_ctrl_at_resp_start("+URAT:", false);
             // Read up to N integers representing the RATs
-            for (size_t x = 0; x < sizeof(rats) / sizeof (rats[0]); x++) {
+            for (size_t x = 0; x < numRats; x++) {
                 rat =  cellular_ctrl_at_read_int();
                 if ((rat >= 0) &&
                     (rat < sizeof (gLocalRatToCellularRat) /
@@ -1494,7 +3616,7 @@ int32_t cellularCtrlGetRat(int32_t rank)
             cellular_ctrl_at_unlock();
             errorCodeOrRat = rats[rank];
             cellularPortLog("CELLULAR_CTRL: RATs are:\n");
-            for (size_t x = 0; x < sizeof(rats) / sizeof(rats[0]); x++) {
+            for (size_t x = 0; x < numRats; x++) {
                 cellularPortLog("  rank[%d]: %d (in module terms %d).\n",
                                 x, rats[x], gCellularRatToLocalRat[rats[x]]);
             }
@@ -1602,7 +3724,8 @@ int32_t cellularCtrlConnect(bool (*pKeepGoingCallback) (void),
 {
     CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_NOT_INITIALISED;
     char imsi[CELLULAR_CTRL_IMSI_SIZE];
-    const char *pApnConfig = NULL;
+    const char *pImsi = NULL;
+    const CellularCtrlLastGood_t *pLastGood = NULL;
     int64_t startTime;
 
     if (gInitialised) {
@@ -1610,44 +3733,458 @@ int32_t cellularCtrlConnect(bool (*pKeepGoingCallback) (void),
         if ((pUsername == NULL) ||
             ((pUsername != NULL) && (pPassword != NULL))) {
             errorCode = CELLULAR_CTRL_AT_ERROR;
-            if (prepareConnect()) {
-                // Set up the APN look-up since none is specified
-                if ((pApn == NULL) && (cellularCtrlGetImsi(imsi) == 0)) {
-                    pApnConfig = apnconfig(imsi);
+            if (cellularCtrlGetImsi(imsi) == 0) {
+                pImsi = imsi;
+                pLastGood = pLastGoodGet(pImsi);
+            }
+            startTime = cellularPortGetTickTimeMs();
+            if (gBandLearning && (pLastGood != NULL) &&
+                (pLastGood->bandRat >= 0)) {
+                errorCode = bandLearningConnect(pKeepGoingCallback, pImsi,
+                                                pApn, pUsername, pPassword,
+                                                &pApn);
+            } else {
+                errorCode = connectApns(pKeepGoingCallback, pImsi,
+                                        pLastGood, pApn, pUsername,
+                                        pPassword, &pApn);
+            }
+            if (errorCode == CELLULAR_CTRL_SUCCESS) {
+                cellularPortLog("CELLULAR_CTRL: connected after %d second(s).\n",
+                                (int32_t) ((cellularPortGetTickTimeMs() - startTime) / 1000));
+                if (pImsi != NULL) {
+                    lastGoodSave(pImsi, pApn);
                 }
-                // Now try to connect, potentially multiple times
-                startTime = cellularPortGetTickTimeMs();
-                do {
-                    if (pApnConfig != NULL) {
-                        pApn = _APN_GET(pApnConfig);
-                        pUsername = _APN_GET(pApnConfig);
-                        pPassword = _APN_GET(pApnConfig);
-                        cellularPortLog("CELLULAR_CTRL: APN from database is \"%s\".\n", pApn);
-                    } else {
-                        if (pApn != NULL) {
-                            cellularPortLog("CELLULAR_CTRL: user-specified APN is \"%s\".\n", pApn);
-                        } else {
-                            cellularPortLog("CELLULAR_CTRL: default APN will be used by network.\n");
-                        }
-                    }
-                    // Register and activate PDP context
-                    errorCode = tryConnect(pKeepGoingCallback, pApn,
-                                           pUsername, pPassword);
-                } while ((errorCode != CELLULAR_CTRL_SUCCESS) &&
-                         (pApnConfig != NULL) &&
-                         (*pApnConfig != 0) &&
-                         pKeepGoingCallback());
+            } else {
+                cellularPortLog("CELLULAR_CTRL: connection attempt stopped after %d second(s).\n",
+                                (int32_t) ((cellularPortGetTickTimeMs() - startTime) / 1000));
+            }
+            // This to avoid warnings about unused variables when 
+            // cellularPortLog() is compiled out
+            (void) startTime;
+        }
+    }
 
+    return (int32_t) errorCode;
+}
+
+// Forget the settings of the last successful connection.
+void cellularCtrlForgetLastGood()
+{
+    if (gInitialised) {
+        bandLearningRestore();
+    }
+    pCellularPort_memset(&gLastGood, 0, sizeof(gLastGood));
+    cellularPortNvStore(CELLULAR_CTRL_NV_ID_LAST_GOOD,
+                        &gLastGood, sizeof(gLastGood));
+}
+
+// Switch band learning on or off.
+void cellularCtrlSetBandLearning(bool onNotOff)
+{
+    if (!onNotOff && gBandLearning && gInitialised) {
+        bandLearningRestore();
+    }
+    gBandLearning = onNotOff;
+}
+
+// Get whether band learning is on.
+bool cellularCtrlIsBandLearning()
+{
+    return gBandLearning;
+}
+
+// Get the E-UTRA band that an EARFCN is in.
+int32_t cellularCtrlEarfcnToBand(int32_t earfcn)
+{
+    int32_t errorCodeOrBand = (int32_t) CELLULAR_CTRL_NOT_FOUND;
+
+    for (size_t x = 0; (x < sizeof(gEarfcnRanges) / sizeof(gEarfcnRanges[0])) &&
+                       (errorCodeOrBand < 0); x++) {
+        if ((earfcn >= gEarfcnRanges[x].earfcnFirst) &&
+            (earfcn <= gEarfcnRanges[x].earfcnLast)) {
+            errorCodeOrBand = gEarfcnRanges[x].band;
+        }
+    }
+
+    return errorCodeOrBand;
+}
+
+// Start an asynchronous connection attempt.
+int32_t cellularCtrlConnectAsync(const char *pApn, const char *pUsername,
+                                 const char *pPassword,
+                                 int32_t timeoutSeconds,
+                                 void (*pCallback) (CellularCtrlConnectState_t,
+                                                    int32_t,
+                                                    void *),
+                                 void *pCallbackParam)
+{
+    CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_NOT_INITIALISED;
+
+    if (gInitialised) {
+        errorCode = CELLULAR_CTRL_INVALID_PARAMETER;
+        if (((pUsername == NULL) || (pPassword != NULL)) &&
+            ((pApn == NULL) || (cellularPort_strlen(pApn) < sizeof(gConnectAsync.apn))) &&
+            ((pUsername == NULL) || (cellularPort_strlen(pUsername) < sizeof(gConnectAsync.username))) &&
+            ((pPassword == NULL) || (cellularPort_strlen(pPassword) < sizeof(gConnectAsync.password)))) {
+            errorCode = CELLULAR_CTRL_CONNECTED;
+            if ((gConnectAsync.state == CELLULAR_CTRL_CONNECT_STATE_IDLE) ||
+                (gConnectAsync.state == CELLULAR_CTRL_CONNECT_STATE_CONNECTED) ||
+                (gConnectAsync.state == CELLULAR_CTRL_CONNECT_STATE_FAILED)) {
+                pCellularPort_memset(&gConnectAsync, 0, sizeof(gConnectAsync));
+                if (pApn != NULL) {
+                    pCellularPort_strcpy(gConnectAsync.apn, pApn);
+                    gConnectAsync.pApn = gConnectAsync.apn;
+                }
+                if (pUsername != NULL) {
+                    pCellularPort_strcpy(gConnectAsync.username, pUsername);
+                    gConnectAsync.pUsername = gConnectAsync.username;
+                }
+                if (pPassword != NULL) {
+                    pCellularPort_strcpy(gConnectAsync.password, pPassword);
+                    gConnectAsync.pPassword = gConnectAsync.password;
+                }
+                gConnectAsync.stopTimeMs = cellularPortGetTickTimeMs() +
+                                           (((int64_t) timeoutSeconds) * 1000);
+                gConnectAsync.pCallback = pCallback;
+                gConnectAsync.pCallbackParam = pCallbackParam;
+                gConnectAsync.state = CELLULAR_CTRL_CONNECT_STATE_PREPARING;
+                cellularPortLog("CELLULAR_CTRL: starting asynchronous connect.\n");
+                cellular_ctrl_at_set_callbacks_poll(ctrlPoll, NULL);
+                errorCode = CELLULAR_CTRL_SUCCESS;
+            }
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Cancel an asynchronous connection attempt.
+void cellularCtrlConnectAsyncCancel()
+{
+    gConnectAsync.cancel = true;
+}
+
+// Get the state of the asynchronous connection attempt.
+CellularCtrlConnectState_t cellularCtrlGetConnectState()
+{
+    return gConnectAsync.state;
+}
+
+// Activate a further PDP context.
+int32_t cellularCtrlActivateContext(int32_t contextId,
+                                    const char *pApn,
+                                    const char *pUsername,
+                                    const char *pPassword)
+{
+    CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_NOT_INITIALISED;
+
+    if (gInitialised) {
+        errorCode = CELLULAR_CTRL_INVALID_PARAMETER;
+        if ((contextId > CELLULAR_CTRL_CONTEXT_ID) &&
+            (contextId < CELLULAR_CTRL_CONTEXT_ID + gpModuleProfile->maxNumActiveContexts)) {
+            errorCode = CELLULAR_CTRL_NOT_REGISTERED;
+            if (cellularCtrlIsRegistered()) {
+                errorCode = CELLULAR_CTRL_AT_ERROR;
+                if (defineContext(contextId, pApn, pUsername, pPassword)) {
+                    errorCode = activateContext(NULL, contextId);
+                }
                 if (errorCode == CELLULAR_CTRL_SUCCESS) {
-                    cellularPortLog("CELLULAR_CTRL: connected after %d second(s).\n",
-                                    (int32_t) ((cellularPortGetTickTimeMs() - startTime) / 1000));
+                    cellularPortLog("CELLULAR_CTRL: context %d activated.\n",
+                                    contextId);
+                } else {
+                    cellularPortLog("CELLULAR_CTRL: unable to activate context %d.\n",
+                                    contextId);
+                }
+            }
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Deactivate a PDP context.
+int32_t cellularCtrlDeactivateContext(int32_t contextId)
+{
+    CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_NOT_INITIALISED;
+
+    if (gInitialised) {
+        errorCode = CELLULAR_CTRL_INVALID_PARAMETER;
+        if ((contextId > CELLULAR_CTRL_CONTEXT_ID) &&
+            (contextId < CELLULAR_CTRL_CONTEXT_ID + gpModuleProfile->maxNumActiveContexts)) {
+            errorCode = CELLULAR_CTRL_AT_ERROR;
+            cellular_ctrl_at_lock();
+            if (gpModuleProfile->contextNeedsInternalProfile) {
+                // Deactivate the internal profile first
+                cellular_ctrl_at_cmd_start("AT+UPSDA=");
+                cellular_ctrl_at_write_int(CELLULAR_CTRL_PROFILE_ID_FOR_CONTEXT(contextId));
+                cellular_ctrl_at_write_int(4);
+                cellular_ctrl_at_cmd_stop_read_resp();
+                // Doesn't matter if that fails, the profile
+                // may never have got that far
+                cellular_ctrl_at_clear_error();
+            }
+            cellular_ctrl_at_cmd_start("AT+CGACT=");
+            cellular_ctrl_at_write_int(0);
+            cellular_ctrl_at_write_int(contextId);
+            cellular_ctrl_at_cmd_stop_read_resp();
+            if (cellular_ctrl_at_unlock_return_error() == 0) {
+                errorCode = CELLULAR_CTRL_SUCCESS;
+                cellularPortLog("CELLULAR_CTRL: context %d deactivated.\n",
+                                contextId);
+            }
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Set 3GPP power saving mode.
+int32_t cellularCtrlSetPsm(bool onNotOff, int32_t periodicWakeupSeconds,
+                           int32_t activeTimeSeconds)
+{
+    CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_NOT_INITIALISED;
+    char periodicWakeupStr[9];
+    char activeTimeStr[9];
+
+    if (gInitialised) {
+        errorCode = CELLULAR_CTRL_INVALID_PARAMETER;
+        if (!onNotOff ||
+            (gprsTimerEncode(periodicWakeupSeconds, gGprsTimer3UnitSeconds,
+                             periodicWakeupStr) &&
+             gprsTimerEncode(activeTimeSeconds, gGprsTimer2UnitSeconds,
+                             activeTimeStr))) {
+            errorCode = CELLULAR_CTRL_AT_ERROR;
+            cellular_ctrl_at_lock();
+            if (onNotOff) {
+                // Make sure we hear about it when the module
+                // goes to sleep
+                cellular_ctrl_at_cmd_start("AT+UPSMR=1");
+                cellular_ctrl_at_cmd_stop_read_resp();
+                // SARA R4/N4 AT Command Manual UBX-17003787, section 7.19
+                cellular_ctrl_at_cmd_start("AT+CPSMS=1,,,");
+                cellular_ctrl_at_write_string(periodicWakeupStr, true);
+                cellular_ctrl_at_write_string(activeTimeStr, true);
+            } else {
+                cellular_ctrl_at_cmd_start("AT+CPSMS=0");
+            }
+            cellular_ctrl_at_cmd_stop_read_resp();
+            if (cellular_ctrl_at_unlock_return_error() == 0) {
+                errorCode = CELLULAR_CTRL_SUCCESS;
+                if (onNotOff) {
+                    cellularPortLog("CELLULAR_CTRL: PSM requested with periodic wake-up"
+                                    " \"%s\" and active time \"%s\".\n",
+                                    periodicWakeupStr, activeTimeStr);
+                } else {
+                    cellularPortLog("CELLULAR_CTRL: PSM switched off.\n");
+                }
+            }
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Get the requested 3GPP power saving mode settings.
+int32_t cellularCtrlGetPsm(bool *pOnNotOff, int32_t *pPeriodicWakeupSeconds,
+                           int32_t *pActiveTimeSeconds)
+{
+    CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_NOT_INITIALISED;
+    int32_t mode;
+    char periodicWakeupStr[9];
+    char activeTimeStr[9];
+
+    if (gInitialised) {
+        errorCode = CELLULAR_CTRL_AT_ERROR;
+        periodicWakeupStr[0] = 0;
+        activeTimeStr[0] = 0;
+        cellular_ctrl_at_lock();
+        cellular_ctrl_at_cmd_start("AT+CPSMS?");
+        cellular_ctrl_at_cmd_stop();
+        cellular_ctrl_at_resp_start("+CPSMS:", false);
+        mode = cellular_ctrl_at_read_int();
+        // Skip the 2G/3G timers
+        cellular_ctrl_at_skip_param(2);
+        cellular_ctrl_at_read_string(periodicWakeupStr,
+                                     sizeof(periodicWakeupStr), false);
+        cellular_ctrl_at_read_string(activeTimeStr,
+                                     sizeof(activeTimeStr), false);
+        cellular_ctrl_at_resp_stop();
+        if ((cellular_ctrl_at_unlock_return_error() == 0) && (mode >= 0)) {
+            errorCode = CELLULAR_CTRL_SUCCESS;
+            if (pOnNotOff != NULL) {
+                *pOnNotOff = (mode == 1);
+            }
+            if (pPeriodicWakeupSeconds != NULL) {
+                *pPeriodicWakeupSeconds = gprsTimerDecode(periodicWakeupStr,
+                                                          gGprsTimer3UnitSeconds);
+            }
+            if (pActiveTimeSeconds != NULL) {
+                *pActiveTimeSeconds = gprsTimerDecode(activeTimeStr,
+                                                      gGprsTimer2UnitSeconds);
+            }
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Set eDRX.
+int32_t cellularCtrlSetEdrx(CellularCtrlRat_t rat, bool onNotOff,
+                            int32_t edrxMs)
+{
+    CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_NOT_INITIALISED;
+    int32_t value = 0;
+    char edrxStr[5];
+
+    if (gInitialised) {
+        errorCode = CELLULAR_CTRL_INVALID_PARAMETER;
+        if ((rat >= 0) && (rat < sizeof(gCedrxsActTypeForRat) /
+                                 sizeof(gCedrxsActTypeForRat[0])) &&
+            (gCedrxsActTypeForRat[rat] >= 0)) {
+            // Find the shortest cycle that is at least edrxMs
+            while ((value < sizeof(gEdrxCycleMs) / sizeof(gEdrxCycleMs[0]) - 1) &&
+                   (gEdrxCycleMs[value] < edrxMs)) {
+                value++;
+            }
+            for (int32_t x = 0; x < 4; x++) {
+                edrxStr[x] = (value & (0x08 >> x)) ? '1' : '0';
+            }
+            edrxStr[4] = 0;
+            errorCode = CELLULAR_CTRL_AT_ERROR;
+            cellular_ctrl_at_lock();
+            cellular_ctrl_at_cmd_start("AT+CEDRXS=");
+            cellular_ctrl_at_write_int(onNotOff ? 1 : 0);
+            cellular_ctrl_at_write_int(gCedrxsActTypeForRat[rat]);
+            if (onNotOff) {
+                cellular_ctrl_at_write_string(edrxStr, true);
+            }
+            cellular_ctrl_at_cmd_stop_read_resp();
+            if (cellular_ctrl_at_unlock_return_error() == 0) {
+                errorCode = CELLULAR_CTRL_SUCCESS;
+                cellularPortLog("CELLULAR_CTRL: eDRX %s for RAT %d",
+                                onNotOff ? "requested" : "switched off", rat);
+                if (onNotOff) {
+                    cellularPortLog(", cycle %d ms", gEdrxCycleMs[value]);
+                }
+                cellularPortLog(".\n");
+            }
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Get the requested eDRX settings.
+int32_t cellularCtrlGetEdrx(CellularCtrlRat_t rat, bool *pOnNotOff,
+                            int32_t *pEdrxMs)
+{
+    CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_NOT_INITIALISED;
+    int32_t actType = -1;
+    int32_t value = -1;
+    char edrxStr[5];
+
+    if (gInitialised) {
+        errorCode = CELLULAR_CTRL_INVALID_PARAMETER;
+        if ((rat >= 0) && (rat < sizeof(gCedrxsActTypeForRat) /
+                                 sizeof(gCedrxsActTypeForRat[0])) &&
+            (gCedrxsActTypeForRat[rat] >= 0)) {
+            errorCode = CELLULAR_CTRL_AT_ERROR;
+            cellular_ctrl_at_lock();
+            cellular_ctrl_at_cmd_start("AT+CEDRXS?");
+            cellular_ctrl_at_cmd_stop();
+            // One line for each <AcT-type> that has eDRX
+            // requested, none at all if there are none
+            for (size_t x = 0; (actType != gCedrxsActTypeForRat[rat]) &&
+                               (x < sizeof(gCedrxsActTypeForRat) /
+                                    sizeof(gCedrxsActTypeForRat[0])); x++) {
+                cellular_ctrl_at_resp_start("+CEDRXS:", false);
+                actType = cellular_ctrl_at_read_int();
+                if (actType < 0) {
+                    break;
+                }
+                if ((actType == gCedrxsActTypeForRat[rat]) &&
+                    (cellular_ctrl_at_read_string(edrxStr, sizeof(edrxStr), false) == 4)) {
+                    value = 0;
+                    for (size_t y = 0; y < 4; y++) {
+                        value = (value << 1) | (edrxStr[y] == '1');
+                    }
+                }
+            }
+            cellular_ctrl_at_resp_stop();
+            // The line being missing is not an error
+            cellular_ctrl_at_clear_error();
+            if (cellular_ctrl_at_unlock_return_error() == 0) {
+                errorCode = CELLULAR_CTRL_SUCCESS;
+                if (pOnNotOff != NULL) {
+                    *pOnNotOff = (value >= 0);
+                }
+                if (pEdrxMs != NULL) {
+                    *pEdrxMs = -1;
+                    if (value >= 0) {
+                        *pEdrxMs = gEdrxCycleMs[value];
+                    }
+                }
+            }
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Get whether the module is asleep.
+bool cellularCtrlIsAsleep()
+{
+    return cellular_ctrl_at_is_asleep();
+}
+
+// Use the ring indicator line of the module as a wake-up source.
+int32_t cellularCtrlSetRingIndicator(int32_t pinRi,
+                                     CellularPortQueueHandle_t queueHandle)
+{
+    CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_NOT_INITIALISED;
+    CellularPortGpioConfig_t gpioConfig = CELLULAR_PORT_GPIO_CONFIG_DEFAULT;
+    int32_t platformError = 0;
+
+    if (gInitialised) {
+        errorCode = CELLULAR_CTRL_INVALID_PARAMETER;
+        if ((pinRi < 0) || (queueHandle != NULL)) {
+            // Out with the old
+            if (gPinRi >= 0) {
+                cellularPortGpioInterruptSet(gPinRi,
+                                             CELLULAR_PORT_GPIO_INTERRUPT_NONE,
+                                             NULL);
+                gPinRi = -1;
+            }
+            errorCode = CELLULAR_CTRL_SUCCESS;
+            if (pinRi >= 0) {
+                // RI is active low and the module drives it
+                // both ways, hence no pull
+                gpioConfig.pin = pinRi;
+                gpioConfig.direction = CELLULAR_PORT_GPIO_DIRECTION_INPUT;
+                platformError = cellularPortGpioConfig(&gpioConfig);
+                if (platformError == 0) {
+                    platformError = cellularPortGpioInterruptSet(pinRi,
+                                                                 CELLULAR_PORT_GPIO_INTERRUPT_FALLING_EDGE,
+                                                                 queueHandle);
+                }
+                if (platformError == 0) {
+                    gPinRi = pinRi;
                 } else {
-                    cellularPortLog("CELLULAR_CTRL: connection attempt stopped after %d second(s).\n",
-                                    (int32_t) ((cellularPortGetTickTimeMs() - startTime) / 1000));
+                    cellularPortLog("CELLULAR_CTRL: unable to set an interrupt"
+                                    " on RI pin %d (0x%02x), error code %d.\n",
+                                    pinRi, pinRi, platformError);
+                    errorCode = CELLULAR_CTRL_PLATFORM_ERROR;
+                    if (platformError == CELLULAR_PORT_NOT_IMPLEMENTED) {
+                        errorCode = CELLULAR_CTRL_NOT_SUPPORTED;
+                    }
                 }
-                // This to avoid warnings about unused variables when 
-                // cellularPortLog() is compiled out
-                (void) startTime;
+            }
+            // Tell the module, it may not be on, in which case
+            // moduleConfigure() will do this at power-on
+            if ((errorCode == CELLULAR_CTRL_SUCCESS) &&
+                (ringIndicatorConfigure(gPinRi >= 0) != 0)) {
+                cellularPortLog("CELLULAR_CTRL: module did not accept"
+                                " AT+URING, it may be off.\n");
             }
         }
     }
@@ -1692,7 +4229,7 @@ int32_t cellularCtrlDisconnect()
                     for (int32_t x = 0; x < sizeof(gRegTypes) / sizeof(gRegTypes[0]); x++) {
                         // Prod the modem to see if it's done
                         cellular_ctrl_at_lock();
-                        cellular_ctrl_at_set_at_timeout(CELLULAR_CTRL_COMMAND_MINIMUM_RESPONSE_TIME_MS, false);
+                        cellular_ctrl_at_set_at_timeout(gpModuleProfile->commandMinimumResponseTimeMs, false);
                         cellular_ctrl_at_cmd_start(gRegTypes[x].pQueryStr);
                         cellular_ctrl_at_cmd_stop();
                         cellular_ctrl_at_resp_start(gRegTypes[x].pResponseStr, false);
@@ -1892,9 +4429,17 @@ int32_t cellularCtrlGetMccMnc(int32_t *pMcc, int32_t *pMnc)
 
 // Get the currently allocated IP address as a string.
 int32_t cellularCtrlGetIpAddressStr(char *pStr)
+{
+    return cellularCtrlGetIpAddressStrForContext(CELLULAR_CTRL_CONTEXT_ID,
+                                                 pStr);
+}
+
+// Get the IP address allocated to the given context as a string.
+int32_t cellularCtrlGetIpAddressStrForContext(int32_t contextId,
+                                              char *pStr)
 {
     CellularCtrlErrorCode_t errorCodeOrSize = CELLULAR_CTRL_NOT_INITIALISED;
-    int32_t contextId;
+    int32_t readContextId;
     char buffer[CELLULAR_CTRL_IP_ADDRESS_SIZE];
 
     if (gInitialised) {
@@ -1902,14 +4447,14 @@ int32_t cellularCtrlGetIpAddressStr(char *pStr)
         errorCodeOrSize = CELLULAR_CTRL_NO_CONTEXT_ACTIVATED;
         cellular_ctrl_at_lock();
         cellular_ctrl_at_cmd_start("AT+CGPADDR=");
-        cellular_ctrl_at_write_int(CELLULAR_CTRL_CONTEXT_ID);
+        cellular_ctrl_at_write_int(contextId);
         cellular_ctrl_at_cmd_stop();
         cellular_ctrl_at_resp_start("+CGPADDR:", false);
-        contextId = cellular_ctrl_at_read_int();
+        readContextId = cellular_ctrl_at_read_int();
         cellular_ctrl_at_read_string(buffer, sizeof(buffer), false);
         cellular_ctrl_at_resp_stop();
         if (cellular_ctrl_at_unlock_return_error() == 0) {
-            if (contextId == CELLULAR_CTRL_CONTEXT_ID) {
+            if (readContextId == contextId) {
                 errorCodeOrSize = cellularPort_strlen(buffer);
                 if (pStr != NULL) {
                     pCellularPort_strcpy(pStr, buffer);
@@ -1965,17 +4510,13 @@ int32_t cellularCtrlRefreshRadioParameters()
 {
     CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_NOT_INITIALISED;
     int32_t x;
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
-    double rsrx;
-    char buf[16];
-#endif
-#ifdef CELLULAR_CFG_MODULE_SARA_R5
-    int32_t bytesRead;
     int32_t atError;
-    char *pBuffer;
+    bool useUcged;
+    char buf[16];
+    int32_t bytesRead = -1;
+    char *pBuffer = NULL;
     char *pStr;
     char *pSave;
-#endif
 
     if (gInitialised) {
         errorCode = CELLULAR_CTRL_NOT_REGISTERED;
@@ -1987,27 +4528,45 @@ int32_t cellularCtrlRefreshRadioParameters()
             // The mechanisms to get the radio information
             // are different between EUTRAN and GERAN but
             // AT+CSQ works in all cases though it sometimes
-            // doesn't return a reading.
+            // doesn't return a reading.  Where AT+UCGED is
+            // also needed it is sent on the same command
+            // line so that there is only one round trip.
+            // Note that AT+UCGED is used
+            // rather than AT+CESQ as, in my experience,
+            // it is more reliable in reporting answers.
+            if (gpModuleProfile->ucgedMode == 5) {
+                // UCGED=5 (e.g. SARA-R4) is only
+                // supported in EUTRAN mode
+                useUcged = (cellularCtrlGetNetworkStatus(CELLULAR_CTRL_RAN_EUTRAN) == CELLULAR_CTRL_NETWORK_STATUS_REGISTERED);
+            } else {
+                // Malloc some memory to read the AT+UCGED response into
+                pBuffer = (char *) pCellularPort_mallocTag(128,
+                                                           CELLULAR_PORT_MALLOC_TAG_CTRL);
+                useUcged = (pBuffer != NULL);
+            }
             cellular_ctrl_at_lock();
-            cellular_ctrl_at_cmd_start("AT+CSQ");
+            if (useUcged) {
+                cellular_ctrl_at_cmd_start("AT+CSQ;+UCGED?");
+            } else {
+                cellular_ctrl_at_cmd_start("AT+CSQ");
+            }
             cellular_ctrl_at_cmd_stop();
-            cellular_ctrl_at_resp_start("+CSQ:", false);
-            x = cellular_ctrl_at_read_int();
-            gRxQual = cellular_ctrl_at_read_int();
+            cellular_ctrl_at_read_fields("+CSQ:", "i,i", &x, &gRxQual);
             if (gRxQual == 99) {
                 gRxQual = -1;
             }
-            cellular_ctrl_at_resp_stop();
-            // AT+CSQ returns a coded RSSI value
-            // The mapping is defined in the array gRssiConvertLte[].
-            if (cellular_ctrl_at_unlock_return_error() == 0) {
-                if ((x >= 0) && (x < sizeof(gRssiConvertLte) / sizeof(gRssiConvertLte[0]))) {
-                    gRssiDbm = gRssiConvertLte[x];
+            if (useUcged && (gpModuleProfile->ucgedMode == 5)) {
+                cellular_ctrl_at_read_fields("+RSRP:", "i,i,s", &gCellId, &gEarfcn,
+                                             buf, sizeof(buf));
+                if (buf[0] != '\0') {
+                    gRsrpDbm = decimalStrToInt(buf);
                 }
-                // Note that AT+UCGED is used
-                // rather than AT+CESQ as, in my experience,
-                // it is more reliable in reporting answers.
-#ifdef CELLULAR_CFG_MODULE_SARA_R5
+                // Skip past cell ID and EARFCN since they will be the same
+                cellular_ctrl_at_read_fields("+RSRQ:", "-,-,s", buf, sizeof(buf));
+                if (buf[0] != '\0') {
+                    gRsrqDb = decimalStrToInt(buf);
+                }
+            } else if (useUcged) {
                 // For UCGED=2, which is what SARA-R5
                 // supports, the response is a multi-line one:
                 // +UCGED: 2
@@ -2016,100 +4575,64 @@ int32_t cellularCtrlRefreshRadioParameters()
                 // e.g.
                 // 6,4,001,01
                 // 2525,5,50,50,e8fe,1a2d001,1,d60814d1,8001,01,28,31,13.75,3,1,10,28,-50,-6,0,255,255,0
-                // Malloc some memory to read the whole thing into
-                pBuffer = (char *) pCellularPort_malloc(128);
-                if (pBuffer != NULL) {
-                    cellular_ctrl_at_lock();
-                    cellular_ctrl_at_cmd_start("AT+UCGED?");
-                    cellular_ctrl_at_cmd_stop();
-                    cellular_ctrl_at_resp_start("+UCGED:", false);
-                    cellular_ctrl_at_skip_param(1);
-                    // Next two lines of response
-                    // Don't want characters in the string being interpreted
-                    // as delimiters
-                    cellular_ctrl_at_set_delimiter(0);
-                    cellular_ctrl_at_resp_start(NULL, false);
-                    // Read beyond stop tag to ignore \r\n
-                    bytesRead = cellular_ctrl_at_read_string(pBuffer, 128, true);
-                    cellular_ctrl_at_resp_stop();
-                    cellular_ctrl_at_set_default_delimiter();
-                    atError = cellular_ctrl_at_unlock_return_error();
-                    if ((bytesRead > 0) && (atError == 0)) {
-                        // Find the '\r' at the end of the first line and replace it
-                        // with ','
-                        pStr = pCellularPort_strchr(pBuffer, '\r');
-                        if (pStr != NULL) {
-                            *pStr = ',';
-                            // Remove all the other control characters
-                            bytesRead -= strip_ctrl(pBuffer, cellularPort_strlen(pBuffer));
-                            if (bytesRead > 0) {
-                                // Now find all the bits we want
-                                pStr = pCellularPort_strtok_r(pBuffer, ",", &pSave);
-                                for (x = 1; pStr != NULL; x++) {
-                                    if (x == 5) {
-                                        // EARFCN is element 5
-                                        gEarfcn = cellularPort_strtol(pStr, NULL, 10);
-                                    } else if (x == 11) {
-                                        // Physical Cell ID is element 11
-                                        gCellId = cellularPort_strtol(pStr, NULL, 10);
-                                    } else if (x == 15) {
-                                        // RSRP is element 15,
-                                        // coded as specified in TS 36.133
-                                        gRsrpDbm = rsrpToDbm(cellularPort_strtol(pStr, NULL, 10));
-                                    } else if (x == 16) {
-                                        // RSRQ is element 16
-                                        // coded as specified in TS 36.133
-                                        gRsrqDb = rsrqToDb(cellularPort_strtol(pStr, NULL, 10));
-                                        errorCode = CELLULAR_CTRL_SUCCESS;
-                                   }
-                                   pStr = pCellularPort_strtok_r(NULL, ",", &pSave);
+                cellular_ctrl_at_resp_start("+UCGED:", false);
+                cellular_ctrl_at_skip_param(1);
+                // Next two lines of response
+                // Don't want characters in the string being interpreted
+                // as delimiters
+                cellular_ctrl_at_set_delimiter(0);
+                cellular_ctrl_at_resp_start(NULL, false);
+                // Read beyond stop tag to ignore \r\n
+                bytesRead = cellular_ctrl_at_read_string(pBuffer, 128, true);
+            }
+            cellular_ctrl_at_resp_stop();
+            cellular_ctrl_at_set_default_delimiter();
+            atError = cellular_ctrl_at_unlock_return_error();
+            if (atError == 0) {
+                // AT+CSQ returns a coded RSSI value
+                // The mapping is defined in the array gRssiConvertLte[].
+                if ((x >= 0) && (x < sizeof(gRssiConvertLte) / sizeof(gRssiConvertLte[0]))) {
+                    gRssiDbm = gRssiConvertLte[x];
+                }
+                if (gpModuleProfile->ucgedMode == 5) {
+                    // If AT+UCGED couldn't be used, that's all we can get
+                    errorCode = CELLULAR_CTRL_SUCCESS;
+                } else if (bytesRead > 0) {
+                    // Find the '\r' at the end of the first line and replace it
+                    // with ','
+                    pStr = pCellularPort_strchr(pBuffer, '\r');
+                    if (pStr != NULL) {
+                        *pStr = ',';
+                        // Remove all the other control characters
+                        bytesRead -= strip_ctrl(pBuffer, cellularPort_strlen(pBuffer));
+                        if (bytesRead > 0) {
+                            // Now find all the bits we want
+                            pStr = pCellularPort_strtok_r(pBuffer, ",", &pSave);
+                            for (x = 1; pStr != NULL; x++) {
+                                if (x == 5) {
+                                    // EARFCN is element 5
+                                    gEarfcn = cellularPort_strtol(pStr, NULL, 10);
+                                } else if (x == 11) {
+                                    // Physical Cell ID is element 11
+                                    gCellId = cellularPort_strtol(pStr, NULL, 10);
+                                } else if (x == 15) {
+                                    // RSRP is element 15,
+                                    // coded as specified in TS 36.133
+                                    gRsrpDbm = rsrpToDbm(cellularPort_strtol(pStr, NULL, 10));
+                                } else if (x == 16) {
+                                    // RSRQ is element 16
+                                    // coded as specified in TS 36.133
+                                    gRsrqDb = rsrqToDb(cellularPort_strtol(pStr, NULL, 10));
+                                    errorCode = CELLULAR_CTRL_SUCCESS;
                                 }
+                                pStr = pCellularPort_strtok_r(NULL, ",", &pSave);
                             }
                         }
                     }
-                    // Free memory again
-                    cellularPort_free(pBuffer);
-                }
-#endif
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
-                // SARA-R4 only supports UCGED=5, and it only
-                // supports UCGED at all in EUTRAN mode
-                if (cellularCtrlGetNetworkStatus(CELLULAR_CTRL_RAN_EUTRAN) == CELLULAR_CTRL_NETWORK_STATUS_REGISTERED) {
-                    cellular_ctrl_at_lock();
-                    cellular_ctrl_at_cmd_start("AT+UCGED?");
-                    cellular_ctrl_at_cmd_stop();
-                    cellular_ctrl_at_resp_start("+RSRP:", false);
-                    gCellId = cellular_ctrl_at_read_int();
-                    gEarfcn = cellular_ctrl_at_read_int();
-                    if (cellular_ctrl_at_read_string(buf, sizeof(buf), false) > 0) {
-                        rsrx = cellularPort_strtof(buf, NULL);
-                        if (rsrx >= 0) {
-                            gRsrpDbm = (int32_t) (rsrx + 0.5);
-                        } else {
-                            gRsrpDbm = (int32_t) (rsrx - 0.5);
-                        }
-                    }
-                    cellular_ctrl_at_resp_start("+RSRQ:", false);
-                    // Skip past cell ID and EARFCN since they will be the same
-                    cellular_ctrl_at_skip_param(2);
-                    if (cellular_ctrl_at_read_string(buf, sizeof(buf), false) > 0) {
-                        rsrx = cellularPort_strtof(buf, NULL);
-                        if (rsrx >= 0) {
-                            gRsrqDb = (int32_t) (rsrx + 0.5);
-                        } else {
-                            gRsrqDb = (int32_t) (rsrx - 0.5);
-                        }
-                    }
-                    cellular_ctrl_at_resp_stop();
-                    if (cellular_ctrl_at_unlock_return_error() == 0) {
-                        errorCode = CELLULAR_CTRL_SUCCESS;
-                    }
-                } else {
-                    // Can't use AT+UCGED, that's all we can get
-                     errorCode = CELLULAR_CTRL_SUCCESS;
                 }
-#endif
             }
+            // Free memory again
+            cellularPort_free(pBuffer);
         }
     }
 
@@ -2156,26 +4679,25 @@ int32_t cellularCtrlGetRxQual()
 int32_t cellularCtrlGetSnrDb(int32_t *pSnrDb)
 {
     CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_NOT_INITIALISED;
-    double rssi;
-    double rsrp;
-    double snrDb;
+    int32_t differenceDb;
 
     if (gInitialised) {
         errorCode = CELLULAR_CTRL_INVALID_PARAMETER;
 
-        if ((pSnrDb != NULL) && (gRssiDbm < 0) && (gRsrpDbm < 0)) {
-            // SNR = RSRP / (RSSI - RSRP).
-            // First convert from dBm
-            rssi = cellularPort_pow(10.0, ((double) gRssiDbm) / 10);
-            rsrp = cellularPort_pow(10.0, ((double) gRsrpDbm) / 10);
-
-            if (cellularPort_errno_get() == 0) {
-                snrDb = 10 * cellularPort_log10(rsrp / (rssi - rsrp));
-                if (cellularPort_errno_get() == 0) {
-                    *pSnrDb = (int32_t) snrDb;
-                    errorCode = CELLULAR_CTRL_SUCCESS;
-                }
+        // SNR = RSRP / (RSSI - RSRP) which, with RSSI - RSRP in dB
+        // as d, is -10 * log10(10^(d / 10) - 1); for d of seven or
+        // more that is 1 - d to the nearest dB (rounding towards
+        // zero), below that gSnrDbForSmallDifference[] holds it
+        differenceDb = gRssiDbm - gRsrpDbm;
+        if ((pSnrDb != NULL) && (gRssiDbm < 0) && (gRsrpDbm < 0) &&
+            (differenceDb > 0)) {
+            if (differenceDb < sizeof(gSnrDbForSmallDifference) /
+                               sizeof(gSnrDbForSmallDifference[0])) {
+                *pSnrDb = gSnrDbForSmallDifference[differenceDb];
+            } else {
+                *pSnrDb = 1 - differenceDb;
             }
+            errorCode = CELLULAR_CTRL_SUCCESS;
         }
     }
 
@@ -2192,6 +4714,163 @@ int32_t cellularCtrlGetEarfcn() {
     return gEarfcn;
 }
 
+// Start the transmit scheduler.
+int32_t cellularCtrlTxSchedulerStart(int32_t rsrpThresholdDbm,
+                                     int32_t snrThresholdDb,
+                                     int32_t checkIntervalSeconds)
+{
+    CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_NOT_INITIALISED;
+
+    if (gInitialised) {
+        errorCode = CELLULAR_CTRL_INVALID_PARAMETER;
+        if (checkIntervalSeconds > 0) {
+            errorCode = CELLULAR_CTRL_PLATFORM_ERROR;
+            // The mutexes, once created, are kept so that
+            // cellularCtrlTxSchedulerSend() can always lock them
+            if (((gTxScheduler.mutex != NULL) ||
+                 (cellularPortMutexCreate(&gTxScheduler.mutex) == 0)) &&
+                ((gTxScheduler.mutexTaskRunning != NULL) ||
+                 (cellularPortMutexCreate(&gTxScheduler.mutexTaskRunning) == 0))) {
+                CELLULAR_PORT_MUTEX_LOCK(gTxScheduler.mutex);
+                gTxScheduler.rsrpThresholdDbm = rsrpThresholdDbm;
+                gTxScheduler.snrThresholdDb = snrThresholdDb;
+                gTxScheduler.checkIntervalMs = ((int64_t) checkIntervalSeconds) * 1000;
+                if (gTxScheduler.taskHandle != NULL) {
+                    // Already running: just take on the new settings
+                    errorCode = CELLULAR_CTRL_SUCCESS;
+                } else if (cellularPortQueueCreate(CELLULAR_CTRL_TX_SCHEDULER_QUEUE_LENGTH,
+                                                   sizeof(uint8_t),
+                                                   &gTxScheduler.queue) == 0) {
+                    gTxScheduler.wakePending = false;
+                    gTxScheduler.flushPending = false;
+                    if (cellularPortTaskCreate(txSchedulerTask, "ctrl_tx_sched",
+                                               CELLULAR_CTRL_TASK_TX_SCHEDULER_STACK_SIZE_BYTES,
+                                               NULL,
+                                               CELLULAR_CTRL_TASK_TX_SCHEDULER_PRIORITY,
+                                               &gTxScheduler.taskHandle) == 0) {
+                        gTxScheduler.running = true;
+                        errorCode = CELLULAR_CTRL_SUCCESS;
+                    } else {
+                        cellularPortQueueDelete(gTxScheduler.queue);
+                        gTxScheduler.queue = NULL;
+                        gTxScheduler.taskHandle = NULL;
+                    }
+                }
+                CELLULAR_PORT_MUTEX_UNLOCK(gTxScheduler.mutex);
+            }
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Stop the transmit scheduler.
+void cellularCtrlTxSchedulerStop()
+{
+    if (gTxScheduler.taskHandle != NULL) {
+        // Once nothing more can be held back the task
+        // sends what remains on its way out
+        CELLULAR_PORT_MUTEX_LOCK(gTxScheduler.mutex);
+        gTxScheduler.running = false;
+        txSchedulerCommand(CELLULAR_CTRL_TX_SCHEDULER_EXIT);
+        CELLULAR_PORT_MUTEX_UNLOCK(gTxScheduler.mutex);
+        CELLULAR_PORT_MUTEX_LOCK(gTxScheduler.mutexTaskRunning);
+        CELLULAR_PORT_MUTEX_UNLOCK(gTxScheduler.mutexTaskRunning);
+        cellularPortQueueDelete(gTxScheduler.queue);
+        gTxScheduler.queue = NULL;
+        gTxScheduler.taskHandle = NULL;
+    }
+}
+
+// Send data through the transmit scheduler.
+int32_t cellularCtrlTxSchedulerSend(int32_t (*pSend) (const void *,
+                                                      size_t,
+                                                      void *),
+                                    void *pSendParam,
+                                    const void *pData,
+                                    size_t dataSizeBytes,
+                                    int32_t deadlineSeconds)
+{
+    CellularCtrlErrorCode_t errorCodeOrSize = CELLULAR_CTRL_INVALID_PARAMETER;
+    CellularCtrlTxSchedulerEntry_t *pEntry = NULL;
+    bool sendNow = true;
+
+    if ((pSend != NULL) && ((pData != NULL) || (dataSizeBytes == 0))) {
+        if ((deadlineSeconds > 0) && (gTxScheduler.mutex != NULL)) {
+            CELLULAR_PORT_MUTEX_LOCK(gTxScheduler.mutex);
+            if (gTxScheduler.running) {
+                sendNow = false;
+                errorCodeOrSize = CELLULAR_CTRL_NO_MEMORY;
+                if (gTxScheduler.pendingBytes + dataSizeBytes <=
+                    CELLULAR_CFG_CTRL_TX_SCHEDULER_MAX_BYTES) {
+                    pEntry = (CellularCtrlTxSchedulerEntry_t *) pCellularPort_mallocTag(sizeof(*pEntry) +
+                                                                                        dataSizeBytes,
+                                                                                        CELLULAR_PORT_MALLOC_TAG_CTRL);
+                }
+                if (pEntry != NULL) {
+                    pEntry->pSend = pSend;
+                    pEntry->pSendParam = pSendParam;
+                    pEntry->deadlineMs = cellularPortGetTickTimeMs() +
+                                         (((int64_t) deadlineSeconds) * 1000);
+                    pEntry->dataSizeBytes = dataSizeBytes;
+                    pEntry->pNext = NULL;
+                    if (dataSizeBytes > 0) {
+                        pCellularPort_memcpy(pEntry + 1, pData, dataSizeBytes);
+                    }
+                    if (gTxScheduler.pLast != NULL) {
+                        gTxScheduler.pLast->pNext = pEntry;
+                    } else {
+                        gTxScheduler.pFirst = pEntry;
+                    }
+                    gTxScheduler.pLast = pEntry;
+                    gTxScheduler.pendingBytes += dataSizeBytes;
+                    // The task decides whether it can go now
+                    txSchedulerCommand(CELLULAR_CTRL_TX_SCHEDULER_WAKE);
+                    errorCodeOrSize = (CellularCtrlErrorCode_t) dataSizeBytes;
+                }
+            }
+            CELLULAR_PORT_MUTEX_UNLOCK(gTxScheduler.mutex);
+        }
+        if (sendNow) {
+            errorCodeOrSize = (CellularCtrlErrorCode_t) pSend(pData, dataSizeBytes,
+                                                              pSendParam);
+        }
+    }
+
+    return (int32_t) errorCodeOrSize;
+}
+
+// Release everything held back by the transmit scheduler.
+int32_t cellularCtrlTxSchedulerFlush()
+{
+    CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_NOT_INITIALISED;
+
+    if (gTxScheduler.mutex != NULL) {
+        CELLULAR_PORT_MUTEX_LOCK(gTxScheduler.mutex);
+        if (gTxScheduler.running) {
+            txSchedulerCommand(CELLULAR_CTRL_TX_SCHEDULER_FLUSH);
+            errorCode = CELLULAR_CTRL_SUCCESS;
+        }
+        CELLULAR_PORT_MUTEX_UNLOCK(gTxScheduler.mutex);
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Get the number of bytes held back by the transmit scheduler.
+int32_t cellularCtrlTxSchedulerGetPendingBytes()
+{
+    CellularCtrlErrorCode_t errorCodeOrSize = CELLULAR_CTRL_NOT_INITIALISED;
+
+    if (gTxScheduler.mutex != NULL) {
+        CELLULAR_PORT_MUTEX_LOCK(gTxScheduler.mutex);
+        errorCodeOrSize = (CellularCtrlErrorCode_t) gTxScheduler.pendingBytes;
+        CELLULAR_PORT_MUTEX_UNLOCK(gTxScheduler.mutex);
+    }
+
+    return (int32_t) errorCodeOrSize;
+}
+
 // Get the 15 digit IMEI of the cellular module.
 int32_t cellularCtrlGetImei(char *pImei)
 {
@@ -2201,7 +4880,10 @@ int32_t cellularCtrlGetImei(char *pImei)
 
     if (gInitialised) {
         errorCode = CELLULAR_CTRL_INVALID_PARAMETER;
-        if (pImei != NULL) {
+        if ((pImei != NULL) && (gIdCache.imei[0] != 0)) {
+            pCellularPort_memcpy(pImei, gIdCache.imei, CELLULAR_CTRL_IMEI_SIZE);
+            errorCode = CELLULAR_CTRL_SUCCESS;
+        } else if (pImei != NULL) {
             errorCode = CELLULAR_CTRL_AT_ERROR;
             cellular_ctrl_at_lock();
             cellular_ctrl_at_cmd_start("AT+CGSN");
@@ -2213,6 +4895,7 @@ int32_t cellularCtrlGetImei(char *pImei)
             atError = cellular_ctrl_at_unlock_return_error();
             if ((bytesRead == CELLULAR_CTRL_IMEI_SIZE) && (atError == 0)) {
                 errorCode = CELLULAR_CTRL_SUCCESS;
+                pCellularPort_memcpy(gIdCache.imei, pImei, CELLULAR_CTRL_IMEI_SIZE);
                 cellularPortLog("CELLULAR_CTRL: IMEI is %.*s.\n",
                                 CELLULAR_CTRL_IMEI_SIZE, pImei);
             } else {
@@ -2233,7 +4916,10 @@ int32_t cellularCtrlGetImsi(char *pImsi)
 
     if (gInitialised) {
         errorCode = CELLULAR_CTRL_INVALID_PARAMETER;
-        if (pImsi != NULL) {
+        if ((pImsi != NULL) && (gIdCache.imsi[0] != 0)) {
+            pCellularPort_memcpy(pImsi, gIdCache.imsi, CELLULAR_CTRL_IMSI_SIZE);
+            errorCode = CELLULAR_CTRL_SUCCESS;
+        } else if (pImsi != NULL) {
             errorCode = CELLULAR_CTRL_AT_ERROR;
             cellular_ctrl_at_lock();
             cellular_ctrl_at_cmd_start("AT+CIMI");
@@ -2245,6 +4931,7 @@ int32_t cellularCtrlGetImsi(char *pImsi)
             atError = cellular_ctrl_at_unlock_return_error();
             if ((bytesRead == CELLULAR_CTRL_IMSI_SIZE) && (atError == 0)) {
                 errorCode = CELLULAR_CTRL_SUCCESS;
+                pCellularPort_memcpy(gIdCache.imsi, pImsi, CELLULAR_CTRL_IMSI_SIZE);
                 cellularPortLog("CELLULAR_CTRL: IMSI is %.*s.\n",
                                 CELLULAR_CTRL_IMSI_SIZE, pImsi);
             } else {
@@ -2265,7 +4952,10 @@ int32_t cellularCtrlGetIccidStr(char *pStr, size_t size)
 
     if (gInitialised) {
         errorCode = CELLULAR_CTRL_INVALID_PARAMETER;
-        if (pStr != NULL) {
+        if ((pStr != NULL) && (size > 0) && (gIdCache.iccid[0] != 0)) {
+            idCacheCopy(gIdCache.iccid, pStr, size);
+            errorCode = CELLULAR_CTRL_SUCCESS;
+        } else if (pStr != NULL) {
             errorCode = CELLULAR_CTRL_AT_ERROR;
             cellular_ctrl_at_lock();
             cellular_ctrl_at_cmd_start("AT+CCID");
@@ -2277,6 +4967,11 @@ int32_t cellularCtrlGetIccidStr(char *pStr, size_t size)
             if ((bytesRead >= 0) && (atError == 0)) {
                 errorCode = CELLULAR_CTRL_SUCCESS;
                 cellularPortLog("CELLULAR_CTRL: ICCID is %s.\n", pStr);
+                // A (plausibly) complete ICCID is at least 19 digits
+                if ((cellularPort_strlen(pStr) >= 19) &&
+                    (cellularPort_strlen(pStr) < sizeof(gIdCache.iccid))) {
+                    idCacheCopy(pStr, gIdCache.iccid, sizeof(gIdCache.iccid));
+                }
             } else {
                 cellularPortLog("CELLULAR_CTRL: unable to read ICCID.\n");
             }
@@ -2286,22 +4981,43 @@ int32_t cellularCtrlGetIccidStr(char *pStr, size_t size)
     return (int32_t) errorCode;
 }
 
+// Read all of the identity strings into the cache in one go.
+int32_t cellularCtrlRefreshIdentity()
+{
+    CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_NOT_INITIALISED;
+
+    if (gInitialised) {
+        errorCode = idCacheFill(true);
+        if (errorCode != CELLULAR_CTRL_SUCCESS) {
+            cellularPortLog("CELLULAR_CTRL: unable to refresh identity.\n");
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
 // Get the manufacturer string from the cellular module.
 int32_t cellularCtrlGetManufacturerStr(char *pStr, size_t size)
 {
-    return getString("AT+CGMI", pStr, size);
+    return getString("AT+CGMI", pStr, size, gIdCache.manufacturer);
 }
 
 // Get the model string from the cellular module.
 int32_t cellularCtrlGetModelStr(char *pStr, size_t size)
 {
-    return getString("AT+CGMM", pStr, size);
+    return getString("AT+CGMM", pStr, size, gIdCache.model);
+}
+
+// Get the capability and timing profile of the module.
+const CellularCtrlModuleProfile_t *pCellularCtrlGetModuleProfile()
+{
+    return gpModuleProfile;
 }
 
 // Get the firmware version string from the cellular module.
 int32_t cellularCtrlGetFirmwareVersionStr(char *pStr, size_t size)
 {
-    return getString("AT+CGMR", pStr, size);
+    return getString("AT+CGMR", pStr, size, gIdCache.firmwareVersion);
 }
 
 // Get the UTC time according to cellular.
@@ -2309,68 +5025,87 @@ int32_t cellularCtrlGetTimeUtc()
 {
     CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_NOT_INITIALISED;
     int32_t timeUtc;
-    char buffer[32];
+    char buffer[24]; // Enough room for "yy/MM/dd,hh:mm:ss+TZ"
     CellularPort_tm timeInfo;
     int32_t bytesRead;
     int32_t atError;
     int32_t offset = 0;
+    int32_t updateCount;
+    int64_t tickMs;
 
     if (gInitialised) {
-        errorCode = CELLULAR_CTRL_AT_ERROR;
-        cellular_ctrl_at_lock();
-        cellular_ctrl_at_cmd_start("AT+CCLK?");
-        cellular_ctrl_at_cmd_stop();
-        cellular_ctrl_at_resp_start("+CCLK:", false);
-        bytesRead = cellular_ctrl_at_read_string(buffer, sizeof(buffer), false);
-        cellular_ctrl_at_resp_stop();
-        atError = cellular_ctrl_at_unlock_return_error();
-        if ((bytesRead >= 17) && (atError == 0)) {
-            cellularPortLog("CELLULAR_CTRL: time is %s.\n", buffer);
-            // The format of the returned string is
-            // "yy/MM/dd,hh:mm:ss+TZ" but the +TZ may be omitted
-
-            // Two-digit year converted to years since 1900
-            offset = 0;
-            buffer[offset + 2] = 0;
-            timeInfo.tm_year = cellularPort_atoi(&(buffer[offset])) + 2000 - 1900;
-            // Months converted to months since January
-            offset = 3;
-            buffer[offset + 2] = 0;
-            timeInfo.tm_mon = cellularPort_atoi(&(buffer[offset])) - 1;
-            // Day of month
-            offset = 6;
-            buffer[offset + 2] = 0;
-            timeInfo.tm_mday = cellularPort_atoi(&(buffer[offset]));
-            // Hours since midnight
-            offset = 9;
-            buffer[offset + 2] = 0;
-            timeInfo.tm_hour = cellularPort_atoi(&(buffer[offset]));
-            // Minutes after the hour
-            offset = 12;
-            buffer[offset + 2] = 0;
-            timeInfo.tm_min = cellularPort_atoi(&(buffer[offset]));
-            // Seconds after the hour
-            offset = 15;
-            buffer[offset + 2] = 0;
-            timeInfo.tm_sec = cellularPort_atoi(&(buffer[offset]));
-            // Get the time in seconds from this
-            timeUtc = cellularPort_mktime(&timeInfo);
-            if ((timeUtc >= 0) && (bytesRead >= 20)) {
-                // There's a timezone, expressed in 15 minute intervals,
-                // subtract it to get UTC
-                offset = 18;
+        tickMs = cellularPortGetTickTimeMs();
+        if (gTimeCache.valid &&
+            (tickMs - gTimeCache.tickMs < ((int64_t) CELLULAR_CFG_CTRL_TIME_UTC_CACHE_SECONDS) * 1000)) {
+            // Work it out from the cache, no need to ask the module
+            timeUtc = gTimeCache.timeUtc + (int32_t) ((tickMs - gTimeCache.tickMs) / 1000);
+            errorCode = CELLULAR_CTRL_SUCCESS;
+        } else {
+            // Note the count of updates so that, should a NITZ
+            // update arrive while the time is being read, what
+            // is read doesn't end up in the cache
+            updateCount = gTimeCache.updateCount;
+            errorCode = CELLULAR_CTRL_AT_ERROR;
+            cellular_ctrl_at_lock();
+            cellular_ctrl_at_cmd_start("AT+CCLK?");
+            cellular_ctrl_at_cmd_stop();
+            cellular_ctrl_at_resp_start("+CCLK:", false);
+            bytesRead = cellular_ctrl_at_read_string(buffer, sizeof(buffer), false);
+            cellular_ctrl_at_resp_stop();
+            atError = cellular_ctrl_at_unlock_return_error();
+            if ((bytesRead >= 17) && (atError == 0)) {
+                cellularPortLog("CELLULAR_CTRL: time is %s.\n", buffer);
+                // The format of the returned string is
+                // "yy/MM/dd,hh:mm:ss+TZ" but the +TZ may be omitted
+
+                // Two-digit year converted to years since 1900
+                offset = 0;
                 buffer[offset + 2] = 0;
-                timeUtc -= cellularPort_atoi(&(buffer[offset])) * 15 * 60;
-            }
+                timeInfo.tm_year = cellularPort_atoi(&(buffer[offset])) + 2000 - 1900;
+                // Months converted to months since January
+                offset = 3;
+                buffer[offset + 2] = 0;
+                timeInfo.tm_mon = cellularPort_atoi(&(buffer[offset])) - 1;
+                // Day of month
+                offset = 6;
+                buffer[offset + 2] = 0;
+                timeInfo.tm_mday = cellularPort_atoi(&(buffer[offset]));
+                // Hours since midnight
+                offset = 9;
+                buffer[offset + 2] = 0;
+                timeInfo.tm_hour = cellularPort_atoi(&(buffer[offset]));
+                // Minutes after the hour
+                offset = 12;
+                buffer[offset + 2] = 0;
+                timeInfo.tm_min = cellularPort_atoi(&(buffer[offset]));
+                // Seconds after the hour
+                offset = 15;
+                buffer[offset + 2] = 0;
+                timeInfo.tm_sec = cellularPort_atoi(&(buffer[offset]));
+                // Get the time in seconds from this
+                timeUtc = cellularPort_mktime(&timeInfo);
+                if ((timeUtc >= 0) && (bytesRead >= 20)) {
+                    // There's a timezone, expressed in 15 minute intervals,
+                    // subtract it to get UTC
+                    offset = 18;
+                    buffer[offset + 2] = 0;
+                    timeUtc -= cellularPort_atoi(&(buffer[offset])) * 15 * 60;
+                }
 
-            if (timeUtc >= 0) {
-                errorCode = CELLULAR_CTRL_SUCCESS;
-                cellularPortLog("CELLULAR_CTRL: UTC time is %d.\n", timeUtc);
+                if (timeUtc >= 0) {
+                    errorCode = CELLULAR_CTRL_SUCCESS;
+                    cellularPortLog("CELLULAR_CTRL: UTC time is %d.\n", timeUtc);
+                    if (updateCount == gTimeCache.updateCount) {
+                        gTimeCache.timeUtc = timeUtc;
+                        gTimeCache.tickMs = tickMs;
+                        gTimeCache.valid = true;
+                    }
+                } else {
+                    cellularPortLog("CELLULAR_CTRL: unable to calculate UTC time.\n");
+                }
             } else {
-                cellularPortLog("CELLULAR_CTRL: unable to calculate UTC time.\n");
+                cellularPortLog("CELLULAR_CTRL: unable to read time with AT+CCLK.\n");
             }
-        } else {
-            cellularPortLog("CELLULAR_CTRL: unable to read time with AT+CCLK.\n");
         }
     }
 
@@ -2383,57 +5118,36 @@ int32_t cellularCtrlSetSecuritySeal(char *pDeviceInfoStr,
                                     bool (*pKeepGoingCallback) (void))
 {
     CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_NOT_SUPPORTED;
-# ifdef CELLULAR_CFG_MODULE_SARA_R5
-    char *pApn;
-# endif
 
 #if CELLULAR_CTRL_SECURITY_ROOT_OF_TRUST
     errorCode = CELLULAR_CTRL_NOT_INITIALISED;
-    if (gInitialised) {
+    if (gInitialised && !gpModuleProfile->securityRootOfTrust) {
+        errorCode = CELLULAR_CTRL_NOT_SUPPORTED;
+    } else if (gInitialised) {
         errorCode = CELLULAR_CTRL_INVALID_PARAMETER;
         if ((pDeviceInfoStr != NULL) &&
             (pDeviceSerialNumberStr != NULL)) {
-# ifdef CELLULAR_CFG_MODULE_SARA_R5
-            errorCode = CELLULAR_CTRL_NO_MEMORY;
-            // On current SARA-R5 devices, need to tell
-            // the module which APN to use on the PDP
-            // context that it establishes for the
-            // security service functions
-            pApn = pCellularPort_malloc(CELLULAR_CTRL_APN_LENGTH);
-            if (pApn != NULL) {
-                errorCode = cellularCtrlGetApnStr(pApn, CELLULAR_CTRL_APN_LENGTH);
-                if (errorCode > 0) {
-                    errorCode = CELLULAR_CTRL_AT_ERROR;
-                    cellular_ctrl_at_lock();
-                    cellular_ctrl_at_cmd_start("AT+USECOPCMD=");
-                    cellular_ctrl_at_write_string("cfgpdn", true);
-                    cellular_ctrl_at_write_string(pApn, true);
-                    cellular_ctrl_at_cmd_stop_read_resp();
-                    if (cellular_ctrl_at_unlock_return_error() == 0) {
-# else
-                        errorCode = CELLULAR_CTRL_AT_ERROR;
-# endif // CELLULAR_CFG_MODULE_SARA_R5
-                        cellular_ctrl_at_lock();
-                        cellular_ctrl_at_cmd_start("AT+USECDEVINFO=");
-                        cellular_ctrl_at_write_string(pDeviceInfoStr, true);
-                        cellular_ctrl_at_write_string(pDeviceSerialNumberStr, true);
-                        cellular_ctrl_at_cmd_stop_read_resp();
-                        if (cellular_ctrl_at_unlock_return_error() == 0) {
-                            while ((errorCode != CELLULAR_CTRL_SUCCESS) &&
-                                   ((pKeepGoingCallback == NULL) ||
-                                     pKeepGoingCallback())) {
-                                errorCode = cellularCtrlGetSecuritySeal();
-                            }
-                        } else {
-                            cellularPortLog("CELLULAR_CTRL: request for security sealing refused.\n");
-                        }
-# ifdef CELLULAR_CFG_MODULE_SARA_R5
+            errorCode = CELLULAR_CTRL_SUCCESS;
+            if (gpModuleProfile->securitySealNeedsApn) {
+                errorCode = securitySealApnSet();
+            }
+            if (errorCode == CELLULAR_CTRL_SUCCESS) {
+                errorCode = CELLULAR_CTRL_AT_ERROR;
+                cellular_ctrl_at_lock();
+                cellular_ctrl_at_cmd_start("AT+USECDEVINFO=");
+                cellular_ctrl_at_write_string(pDeviceInfoStr, true);
+                cellular_ctrl_at_write_string(pDeviceSerialNumberStr, true);
+                cellular_ctrl_at_cmd_stop_read_resp();
+                if (cellular_ctrl_at_unlock_return_error() == 0) {
+                    while ((errorCode != CELLULAR_CTRL_SUCCESS) &&
+                           ((pKeepGoingCallback == NULL) ||
+                             pKeepGoingCallback())) {
+                        errorCode = cellularCtrlGetSecuritySeal();
                     }
+                } else {
+                    cellularPortLog("CELLULAR_CTRL: request for security sealing refused.\n");
                 }
-                // Free memory
-                cellularPort_free(pApn);
             }
-# endif // CELLULAR_CFG_MODULE_SARA_R5
         }
     }
 #endif // CELLULAR_CTRL_SECURITY_ROOT_OF_TRUST
@@ -2452,7 +5166,9 @@ int32_t cellularCtrlGetSecuritySeal()
     int32_t deviceIsActivated;
 
     errorCode = CELLULAR_CTRL_NOT_INITIALISED;
-    if (gInitialised) {
+    if (gInitialised && !gpModuleProfile->securityRootOfTrust) {
+        errorCode = CELLULAR_CTRL_NOT_SUPPORTED;
+    } else if (gInitialised) {
         cellular_ctrl_at_lock();
         cellular_ctrl_at_cmd_start("AT+USECDEVINFO?");
         cellular_ctrl_at_cmd_stop();
@@ -2491,53 +5207,16 @@ int32_t cellularSecurityEndToEndEncrypt(const void *pDataIn,
     CellularCtrlErrorCode_t errorCodeOrSize = CELLULAR_CTRL_NOT_SUPPORTED;
 
 #if CELLULAR_CTRL_SECURITY_ROOT_OF_TRUST
-    int32_t sizeOutBytes = 0;
-    uint8_t quoteMark;
-
     errorCodeOrSize = CELLULAR_CTRL_NOT_INITIALISED;
-    if (gInitialised) {
+    if (gInitialised && !gpModuleProfile->securityRootOfTrust) {
+        errorCodeOrSize = CELLULAR_CTRL_NOT_SUPPORTED;
+    } else if (gInitialised) {
         if (dataSizeBytes > 0) {
             errorCodeOrSize = CELLULAR_CTRL_INVALID_PARAMETER;
             if ((pDataIn != NULL) &&
                 (pDataOut != NULL)) {
-                errorCodeOrSize = CELLULAR_CTRL_AT_ERROR;
-                cellular_ctrl_at_lock();
-                cellular_ctrl_at_cmd_start("AT+USECE2EDATAENC=");
-                cellular_ctrl_at_write_int(dataSizeBytes);
-                cellular_ctrl_at_cmd_stop();
-                // Wait for the prompt
-                if (cellular_ctrl_at_wait_char('>')) {
-                    // Wait for it...
-                    cellularPortTaskBlock(50);
-                    // Go!
-                    cellular_ctrl_at_write_bytes((uint8_t *) pDataIn,
-                                                 dataSizeBytes);
-                    // Grab the response
-                    cellular_ctrl_at_resp_start("+USECE2EDATAENC:", false);
-                    // Read the amount of data that has been encryptd
-                    sizeOutBytes = cellular_ctrl_at_read_int();
-                    if (sizeOutBytes > dataSizeBytes +
-                                       CELLULAR_CTRL_END_TO_END_ENCRYPT_HEADER_SIZE_BYTES) {
-                        sizeOutBytes = dataSizeBytes +
-                                       CELLULAR_CTRL_END_TO_END_ENCRYPT_HEADER_SIZE_BYTES;
-                    }
-                    // Don't stop for anything!
-                    cellular_ctrl_at_set_delimiter(0);
-                    cellular_ctrl_at_set_stop_tag(NULL);
-                    // Get the leading quote mark out of the way
-                    cellular_ctrl_at_read_bytes(&quoteMark, 1);
-                    // Now read the actual data
-                    cellular_ctrl_at_read_bytes((uint8_t *) pDataOut,
-                                                sizeOutBytes);
-                    cellular_ctrl_at_resp_stop();
-                    cellular_ctrl_at_set_default_delimiter();
-                    if (cellular_ctrl_at_unlock_return_error() == 0) {
-                        // All is good
-                        errorCodeOrSize = sizeOutBytes;
-                    }
-                } else {
-                    cellular_ctrl_at_unlock();
-                }
+                errorCodeOrSize = e2eEncryptChunk(pDataIn, pDataOut,
+                                                  dataSizeBytes);
             }
         } else {
             errorCodeOrSize = CELLULAR_CTRL_SUCCESS;
@@ -2548,4 +5227,214 @@ int32_t cellularSecurityEndToEndEncrypt(const void *pDataIn,
     return (int32_t) errorCodeOrSize;
 }
 
+// Start a streamed end to end encryption.
+int32_t cellularSecurityEndToEndEncryptInit(CellularSecurityEndToEndEncryptStream_t *pStream,
+                                            int32_t (*pOutput) (const void *,
+                                                                size_t,
+                                                                void *),
+                                            void *pOutputParam)
+{
+    CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_INVALID_PARAMETER;
+
+    if (pStream != NULL) {
+        pStream->pBuffer = NULL;
+        pStream->bufferLength = 0;
+        pStream->errorCodeOrSize = CELLULAR_CTRL_NOT_SUPPORTED;
+#if CELLULAR_CTRL_SECURITY_ROOT_OF_TRUST
+        pStream->errorCodeOrSize = CELLULAR_CTRL_NOT_INITIALISED;
+        if (gInitialised && !gpModuleProfile->securityRootOfTrust) {
+            pStream->errorCodeOrSize = CELLULAR_CTRL_NOT_SUPPORTED;
+        } else if (gInitialised) {
+            pStream->errorCodeOrSize = CELLULAR_CTRL_INVALID_PARAMETER;
+            if (pOutput != NULL) {
+                pStream->errorCodeOrSize = CELLULAR_CTRL_NO_MEMORY;
+                // The buffer holds a chunk of plain text and is
+                // then overwritten with its cipher text
+                pStream->pBuffer = (char *) pCellularPort_mallocTag(CELLULAR_CFG_CTRL_E2E_CHUNK_SIZE_BYTES +
+                                                                    CELLULAR_CTRL_END_TO_END_ENCRYPT_HEADER_SIZE_BYTES,
+                                                                    CELLULAR_PORT_MALLOC_TAG_CTRL);
+                if (pStream->pBuffer != NULL) {
+                    pStream->pOutput = pOutput;
+                    pStream->pOutputParam = pOutputParam;
+                    pStream->errorCodeOrSize = CELLULAR_CTRL_SUCCESS;
+                }
+            }
+        }
+#else
+        (void) pOutput;
+        (void) pOutputParam;
+#endif // CELLULAR_CTRL_SECURITY_ROOT_OF_TRUST
+        errorCode = (CellularCtrlErrorCode_t) pStream->errorCodeOrSize;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Add plain text to a streamed end to end encryption.
+int32_t cellularSecurityEndToEndEncryptUpdate(CellularSecurityEndToEndEncryptStream_t *pStream,
+                                              const void *pData,
+                                              size_t dataSizeBytes)
+{
+    CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_INVALID_PARAMETER;
+    size_t thisSize;
+
+    if ((pStream != NULL) && ((pData != NULL) || (dataSizeBytes == 0))) {
+        if (pStream->errorCodeOrSize < 0) {
+            errorCode = (CellularCtrlErrorCode_t) pStream->errorCodeOrSize;
+        } else if (pStream->pBuffer != NULL) {
+            while ((dataSizeBytes > 0) && (pStream->errorCodeOrSize >= 0)) {
+                thisSize = CELLULAR_CFG_CTRL_E2E_CHUNK_SIZE_BYTES -
+                           pStream->bufferLength;
+                if (thisSize > dataSizeBytes) {
+                    thisSize = dataSizeBytes;
+                }
+                pCellularPort_memcpy(pStream->pBuffer + pStream->bufferLength,
+                                     pData, thisSize);
+                pStream->bufferLength += thisSize;
+                pData = (const char *) pData + thisSize;
+                dataSizeBytes -= thisSize;
+                if (pStream->bufferLength >= CELLULAR_CFG_CTRL_E2E_CHUNK_SIZE_BYTES) {
+                    e2eStreamFlush(pStream);
+                }
+            }
+            errorCode = CELLULAR_CTRL_SUCCESS;
+            if (pStream->errorCodeOrSize < 0) {
+                errorCode = (CellularCtrlErrorCode_t) pStream->errorCodeOrSize;
+            }
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Finish a streamed end to end encryption.
+int32_t cellularSecurityEndToEndEncryptFinal(CellularSecurityEndToEndEncryptStream_t *pStream)
+{
+    int32_t errorCodeOrSize = (int32_t) CELLULAR_CTRL_INVALID_PARAMETER;
+
+    if (pStream != NULL) {
+        if (pStream->pBuffer != NULL) {
+            if ((pStream->errorCodeOrSize >= 0) &&
+                (pStream->bufferLength > 0)) {
+                e2eStreamFlush(pStream);
+            }
+            cellularPort_free(pStream->pBuffer);
+            pStream->pBuffer = NULL;
+        }
+        errorCodeOrSize = pStream->errorCodeOrSize;
+    }
+
+    return errorCodeOrSize;
+}
+
+// Store a security credential in the module.
+int32_t cellularCtrlSecurityCredentialStore(CellularCtrlSecurityCredential_t type,
+                                            const char *pNameStr,
+                                            const char *pData,
+                                            size_t sizeBytes)
+{
+    CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_NOT_INITIALISED;
+
+    if (gInitialised) {
+        errorCode = CELLULAR_CTRL_INVALID_PARAMETER;
+        if ((type >= 0) && (type < CELLULAR_CTRL_MAX_NUM_SECURITY_CREDENTIALS) &&
+            (pNameStr != NULL) && (pData != NULL) && (sizeBytes > 0)) {
+            errorCode = CELLULAR_CTRL_AT_ERROR;
+            cellular_ctrl_at_lock();
+            cellular_ctrl_at_cmd_start("AT+USECMNG=");
+            // Import from serial
+            cellular_ctrl_at_write_int(0);
+            cellular_ctrl_at_write_int(type);
+            cellular_ctrl_at_write_string(pNameStr, true);
+            cellular_ctrl_at_write_int(sizeBytes);
+            cellular_ctrl_at_cmd_stop();
+            // Wait for the prompt
+            if (cellular_ctrl_at_wait_char('>')) {
+                // Wait for it...
+                cellularPortTaskBlock(50);
+                // Go!
+                cellular_ctrl_at_write_bytes((const uint8_t *) pData,
+                                             sizeBytes);
+                // The response carries the MD5 hash of
+                // what was stored, which we don't need
+                cellular_ctrl_at_resp_start("+USECMNG:", false);
+                cellular_ctrl_at_resp_stop();
+                if (cellular_ctrl_at_unlock_return_error() == 0) {
+                    cellularPortLog("CELLULAR_CTRL: security credential type %d"
+                                    " stored as \"%s\".\n", type, pNameStr);
+                    errorCode = CELLULAR_CTRL_SUCCESS;
+                }
+            } else {
+                cellular_ctrl_at_unlock();
+            }
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Remove a security credential from the module.
+int32_t cellularCtrlSecurityCredentialRemove(CellularCtrlSecurityCredential_t type,
+                                             const char *pNameStr)
+{
+    CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_NOT_INITIALISED;
+
+    if (gInitialised) {
+        errorCode = CELLULAR_CTRL_INVALID_PARAMETER;
+        if ((type >= 0) && (type < CELLULAR_CTRL_MAX_NUM_SECURITY_CREDENTIALS) &&
+            (pNameStr != NULL)) {
+            errorCode = CELLULAR_CTRL_AT_ERROR;
+            cellular_ctrl_at_lock();
+            cellular_ctrl_at_cmd_start("AT+USECMNG=");
+            cellular_ctrl_at_write_int(2);
+            cellular_ctrl_at_write_int(type);
+            cellular_ctrl_at_write_string(pNameStr, true);
+            cellular_ctrl_at_cmd_stop_read_resp();
+            if (cellular_ctrl_at_unlock_return_error() == 0) {
+                errorCode = CELLULAR_CTRL_SUCCESS;
+            }
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Set up a security profile in the module.
+int32_t cellularCtrlSecurityProfileSet(int32_t profileId,
+                                       const CellularCtrlSecurityProfile_t *pProfile)
+{
+    CellularCtrlErrorCode_t errorCode = CELLULAR_CTRL_NOT_INITIALISED;
+
+    if (gInitialised) {
+        errorCode = CELLULAR_CTRL_INVALID_PARAMETER;
+        if ((profileId >= 0) &&
+            (profileId < CELLULAR_CTRL_SECURITY_PROFILE_MAX_NUM)) {
+            errorCode = CELLULAR_CTRL_AT_ERROR;
+            cellular_ctrl_at_lock();
+            // Start from the defaults
+            cellular_ctrl_at_cmd_start("AT+USECPRF=");
+            cellular_ctrl_at_write_int(profileId);
+            cellular_ctrl_at_cmd_stop_read_resp();
+            if (pProfile != NULL) {
+                // The op codes are those of AT+USECPRF;
+                // an error sticks, so check once at the end
+                securityProfileSetInt(profileId, 0, pProfile->validationLevel);
+                securityProfileSetInt(profileId, 1, pProfile->tlsVersion);
+                securityProfileSetInt(profileId, 2, pProfile->cipherSuite);
+                securityProfileSetString(profileId, 3, pProfile->pRootCaName);
+                securityProfileSetString(profileId, 4, pProfile->pServerNameStr);
+                securityProfileSetString(profileId, 5, pProfile->pClientCertName);
+                securityProfileSetString(profileId, 6, pProfile->pClientKeyName);
+                securityProfileSetString(profileId, 10, pProfile->pSniStr);
+                securityProfileSetInt(profileId, 13, pProfile->sessionResumption);
+            }
+            if (cellular_ctrl_at_unlock_return_error() == 0) {
+                errorCode = CELLULAR_CTRL_SUCCESS;
+            }
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
 // End of file
@@ -51,6 +51,17 @@ extern "C" {
     *cfg ? cfg : NULL; \
     cfg  += cellularPort_strlen(cfg) + 1
 
+/**
+ * Helper to generate the look-up key for an MCC/MNC pair; the
+ * number of digits in the MNC is part of the key since, for
+ * instance, MNC "01" and MNC "001" are different networks.
+ * Note: give the MCC and MNC as decimal numbers WITHOUT leading
+ * zeroes, otherwise C will take them to be octal.
+ */
+#define _APN_KEY(mcc,mnc,mncDigits) ((((uint32_t) (mcc)) << 11) | \
+                                     (((mncDigits) == 3) ? 0x400UL : 0) | \
+                                     ((uint32_t) (mnc)))
+
 /* ----------------------------------------------------------------
  * TYPES
  * -------------------------------------------------------------- */
@@ -59,8 +70,8 @@ extern "C" {
  * APN lookup struct
  */
 typedef struct {
-    const char *mccmnc; /**< mobile country code (MCC) and mobile network code MNC */
-    const char *cfg;     /**<  APN configuration string, use _APN macro to generate */
+    uint32_t key;    /**< mobile country code (MCC) and mobile network code MNC, use _APN_KEY macro to generate */
+    const char *cfg; /**< APN configuration string, use _APN macro to generate */
 } APN_t;
 
 /* ----------------------------------------------------------------
@@ -73,137 +84,246 @@ typedef struct {
 static const char *apndef = _APN("internet",,);
 
 /**
- * List of special APNs for different network operators.
+ * APN settings shared by many MNCs.
+ */
+static const char gApnCfgJpSoftbank[] = _APN("open.softbank.ne.jp", "opensoftbank", "ebMNuX1FIHg9d3DA")
+                                        _APN("smile.world", "dna1trop", "so2t3k3m2a");
+static const char gApnCfgJpDocomo[] = _APN("bmobilewap",,) /*BMobile*/
+                                      _APN("mpr2.bizho.net", "Mopera U",) /* DoCoMo */
+                                      _APN("bmobile.ne.jp", "bmobile@wifi2", "bmobile"); /*BMobile*/
+static const char gApnCfgGbTelefonica[] = _APN("mobile.o2.co.uk", "faster", "web") /* contract */
+                                          _APN("mobile.o2.co.uk", "bypass", "web") /* pre-pay */
+                                          _APN("payandgo.o2.co.uk", "payandgo", "payandgo");
+static const char gApnCfgUsTMobile[] = _APN("epc.tmobile.com",,)
+                                       _APN("fast.tmobile.com",,); /* LTE */
+static const char gApnCfgUsAtt[] = _APN("phone",,)
+                                   _APN("wap.cingular", "WAP@CINGULARGPRS.COM", "CINGULAR1")
+                                   _APN("isp.cingular", "ISP@CINGULARGPRS.COM", "CINGULAR1");
+
+/**
+ * List of special APNs for different network operators, one
+ * entry per MCC/MNC, searched with a binary search and hence
+ * the entries MUST be in ascending order of key: order by MCC
+ * then, within an MCC, all of the two-digit MNCs in ascending
+ * order followed by all of the three-digit MNCs in ascending
+ * order.  The ctrlApnDb test checks this.
  *
  * No need to add default, "internet" will be used as a default if no entry matches.
  * The APN without username/password have to be listed first.
  */
-
 static const APN_t apnlut[] = {
 // MCC Country
-//  { /* Operator */ "MCC-MNC[,MNC]" _APN(APN,USERNAME,PASSWORD) },
-// MCC must be 3 digits
-// MNC must be either 2 or 3 digits
-// MCC must be separated by '-' from MNC, multiple MNC can be separated by ','
-
-// 232 Austria - AUT
-    { /* T-Mobile */ "232-03",  _APN("m2m.business",,) },
+//  { /* Operator */ _APN_KEY(MCC, MNC, MNC digits), _APN(APN,USERNAME,PASSWORD) },
 
-// 460 China - CN
-    { /* CN Mobile */"460-00",  _APN("cmnet",,)
-        _APN("cmwap",,)
-    },
-    { /* Unicom */   "460-01",  _APN("3gnet",,)
-        _APN("uninet", "uninet", "uninet")
-    },
+// 204 Netherlands - NL
+    { /* Vodafone */ _APN_KEY(204, 4, 2),  _APN("public4.m2minternet.com",,) },
 
-// 262 Germany - DE
-    { /* T-Mobile */ "262-01",  _APN("internet.t-mobile", "t-mobile", "tm") },
-    { /* T-Mobile */ "262-02,06",
-        _APN("m2m.business",,)
-    },
+// 214 Spain
+    { /* Telefonica */ _APN_KEY(214, 7, 2), _APN("m2mtrial.telefonica.com",,) /* Cat-M1 */ },
 
 // 222 Italy - IT
-    { /* TIM */      "222-01",  _APN("ibox.tim.it",,) },
-    { /* Vodafone */ "222-10",  _APN("web.omnitel.it",,) },
-    { /* Wind */     "222-88",  _APN("internet.wind.biz",,) },
+    { /* TIM */      _APN_KEY(222, 1, 2),  _APN("ibox.tim.it",,) },
+    { /* Vodafone */ _APN_KEY(222, 10, 2), _APN("web.omnitel.it",,) },
+    { /* Wind */     _APN_KEY(222, 88, 2), _APN("internet.wind.biz",,) },
 
-// 440 Japan - JP
-    { /* Softbank */ "440-04,06,20,40,41,42,43,44,45,46,47,48,90,91,92,93,94,95"
-        ",96,97,98",
-        _APN("open.softbank.ne.jp", "opensoftbank", "ebMNuX1FIHg9d3DA")
-        _APN("smile.world", "dna1trop", "so2t3k3m2a")
-    },
-    { /* NTTDoCoMo */"440-09,10,11,12,13,14,15,16,17,18,19,21,22,23,24,25,26,27,"
-        "28,29,30,31,32,33,34,35,36,37,38,39,58,59,60,61,62,63,"
-        "64,65,66,67,68,69,87,99",
-        _APN("bmobilewap",,) /*BMobile*/
-        _APN("mpr2.bizho.net", "Mopera U",) /* DoCoMo */
-        _APN("bmobile.ne.jp", "bmobile@wifi2", "bmobile") /*BMobile*/
+// 228 Switzerland - CH
+    { /* Swisscom */ _APN_KEY(228, 1, 2),  _APN("gprs.swisscom.ch",,) },
+    { /* Orange */   _APN_KEY(228, 3, 2),  _APN("internet",,) /* contract */
+                                           _APN("click",,)    /* pre-pay */
     },
 
-// 204 Netherlands - NL
-    { /* Vodafone */ "204-04",  _APN("public4.m2minternet.com",,) },
+// 232 Austria - AUT
+    { /* T-Mobile */ _APN_KEY(232, 3, 2),  _APN("m2m.business",,) },
 
-// 293 Slovenia - SI
-    { /* Si.mobil */ "293-40",  _APN("internet.simobil.si",,) },
-    { /* Tusmobil */ "293-70",  _APN("internet.tusmobil.si",,) },
+// 234 United Kingdom - GB
+    { /* Telefonica */ _APN_KEY(234, 2, 2),  gApnCfgGbTelefonica },
+    { /* Telefonica */ _APN_KEY(234, 10, 2), gApnCfgGbTelefonica },
+    { /* Telefonica */ _APN_KEY(234, 11, 2), gApnCfgGbTelefonica },
+    { /* Vodafone */   _APN_KEY(234, 15, 2), _APN("internet", "web", "web")        /* contract */
+                                             _APN("pp.vodafone.co.uk", "wap", "wap")  /* pre-pay */
+    },
+    { /* Three */      _APN_KEY(234, 20, 2), _APN("three.co.uk",,) },
+    { /* Jersey */     _APN_KEY(234, 50, 2), _APN("jtm2m",,) /* as used on u-blox C030 U201 boards */ },
 
 // 240 Sweden SE
-    { /* Telia */    "240-01",  _APN("online.telia.se",,) },
-    { /* Telenor */  "240-06,08",
-        _APN("services.telenor.se",,)
-    },
-    { /* Tele2 */    "240-07",  _APN("mobileinternet.tele2.se",,) },
+    { /* Telia */    _APN_KEY(240, 1, 2),  _APN("online.telia.se",,) },
+    { /* Telenor */  _APN_KEY(240, 6, 2),  _APN("services.telenor.se",,) },
+    { /* Tele2 */    _APN_KEY(240, 7, 2),  _APN("mobileinternet.tele2.se",,) },
+    { /* Telenor */  _APN_KEY(240, 8, 2),  _APN("services.telenor.se",,) },
 
-// 228 Switzerland - CH
-    { /* Swisscom */ "228-01",  _APN("gprs.swisscom.ch",,) },
-    { /* Orange */   "228-03",  _APN("internet",,) /* contract */
-        _APN("click",,)    /* pre-pay */
-    },
+// 262 Germany - DE
+    { /* T-Mobile */ _APN_KEY(262, 1, 2),  _APN("internet.t-mobile", "t-mobile", "tm") },
+    { /* T-Mobile */ _APN_KEY(262, 2, 2),  _APN("m2m.business",,) },
+    { /* T-Mobile */ _APN_KEY(262, 6, 2),  _APN("m2m.business",,) },
 
-// 234 United Kingdom - GB
-    { /* Telefonica */       "234-02,10,11",
-        _APN("mobile.o2.co.uk", "faster", "web") /* contract */
-        _APN("mobile.o2.co.uk", "bypass", "web") /* pre-pay */
-        _APN("payandgo.o2.co.uk", "payandgo", "payandgo")
-    },
-    { /* Vodafone */ "234-15",  _APN("internet", "web", "web")        /* contract */
-        _APN("pp.vodafone.co.uk", "wap", "wap")  /* pre-pay */
-    },
-    { /* Three */    "234-20",  _APN("three.co.uk",,) },
-    { /* Jersey */   "234-50",  _APN("jtm2m",,) /* as used on u-blox C030 U201 boards */ },
+// 293 Slovenia - SI
+    { /* Si.mobil */ _APN_KEY(293, 40, 2), _APN("internet.simobil.si",,) },
+    { /* Tusmobil */ _APN_KEY(293, 70, 2), _APN("internet.tusmobil.si",,) },
 
 // 310 United States of America - US
-    { /* T-Mobile */ "310-026,260,490",
-        _APN("epc.tmobile.com",,)
-        _APN("fast.tmobile.com",,) /* LTE */
+    { /* T-Mobile */ _APN_KEY(310, 26, 3),  gApnCfgUsTMobile },
+    { /* AT&T */     _APN_KEY(310, 30, 3),  gApnCfgUsAtt },
+    { /* AT&T */     _APN_KEY(310, 150, 3), gApnCfgUsAtt },
+    { /* AT&T */     _APN_KEY(310, 170, 3), gApnCfgUsAtt },
+    { /* T-Mobile */ _APN_KEY(310, 260, 3), gApnCfgUsTMobile },
+    { /* AT&T */     _APN_KEY(310, 410, 3), gApnCfgUsAtt },
+    { /* T-Mobile */ _APN_KEY(310, 490, 3), gApnCfgUsTMobile },
+    { /* AT&T */     _APN_KEY(310, 560, 3), gApnCfgUsAtt },
+    { /* AT&T */     _APN_KEY(310, 680, 3), gApnCfgUsAtt },
+
+// 440 Japan - JP
+    { /* Softbank  */ _APN_KEY(440, 4, 2), gApnCfgJpSoftbank },
+    { /* Softbank  */ _APN_KEY(440, 6, 2), gApnCfgJpSoftbank },
+    { /* NTTDoCoMo */ _APN_KEY(440, 9, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 10, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 11, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 12, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 13, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 14, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 15, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 16, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 17, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 18, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 19, 2), gApnCfgJpDocomo },
+    { /* Softbank  */ _APN_KEY(440, 20, 2), gApnCfgJpSoftbank },
+    { /* NTTDoCoMo */ _APN_KEY(440, 21, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 22, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 23, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 24, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 25, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 26, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 27, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 28, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 29, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 30, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 31, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 32, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 33, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 34, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 35, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 36, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 37, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 38, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 39, 2), gApnCfgJpDocomo },
+    { /* Softbank  */ _APN_KEY(440, 40, 2), gApnCfgJpSoftbank },
+    { /* Softbank  */ _APN_KEY(440, 41, 2), gApnCfgJpSoftbank },
+    { /* Softbank  */ _APN_KEY(440, 42, 2), gApnCfgJpSoftbank },
+    { /* Softbank  */ _APN_KEY(440, 43, 2), gApnCfgJpSoftbank },
+    { /* Softbank  */ _APN_KEY(440, 44, 2), gApnCfgJpSoftbank },
+    { /* Softbank  */ _APN_KEY(440, 45, 2), gApnCfgJpSoftbank },
+    { /* Softbank  */ _APN_KEY(440, 46, 2), gApnCfgJpSoftbank },
+    { /* Softbank  */ _APN_KEY(440, 47, 2), gApnCfgJpSoftbank },
+    { /* Softbank  */ _APN_KEY(440, 48, 2), gApnCfgJpSoftbank },
+    { /* NTTDoCoMo */ _APN_KEY(440, 58, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 59, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 60, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 61, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 62, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 63, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 64, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 65, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 66, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 67, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 68, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 69, 2), gApnCfgJpDocomo },
+    { /* NTTDoCoMo */ _APN_KEY(440, 87, 2), gApnCfgJpDocomo },
+    { /* Softbank  */ _APN_KEY(440, 90, 2), gApnCfgJpSoftbank },
+    { /* Softbank  */ _APN_KEY(440, 91, 2), gApnCfgJpSoftbank },
+    { /* Softbank  */ _APN_KEY(440, 92, 2), gApnCfgJpSoftbank },
+    { /* Softbank  */ _APN_KEY(440, 93, 2), gApnCfgJpSoftbank },
+    { /* Softbank  */ _APN_KEY(440, 94, 2), gApnCfgJpSoftbank },
+    { /* Softbank  */ _APN_KEY(440, 95, 2), gApnCfgJpSoftbank },
+    { /* Softbank  */ _APN_KEY(440, 96, 2), gApnCfgJpSoftbank },
+    { /* Softbank  */ _APN_KEY(440, 97, 2), gApnCfgJpSoftbank },
+    { /* Softbank  */ _APN_KEY(440, 98, 2), gApnCfgJpSoftbank },
+    { /* NTTDoCoMo */ _APN_KEY(440, 99, 2), gApnCfgJpDocomo },
+
+// 460 China - CN
+    { /* CN Mobile */ _APN_KEY(460, 0, 2), _APN("cmnet",,)
+                                           _APN("cmwap",,)
     },
-    { /* AT&T */     "310-030,150,170,260,410,560,680",
-        _APN("phone",,)
-        _APN("wap.cingular", "WAP@CINGULARGPRS.COM", "CINGULAR1")
-        _APN("isp.cingular", "ISP@CINGULARGPRS.COM", "CINGULAR1")
+    { /* Unicom */    _APN_KEY(460, 1, 2), _APN("3gnet",,)
+                                           _APN("uninet", "uninet", "uninet")
     },
 
 // 901 International - INT
-    { /* Transatel */ "901-37", _APN("netgprs.com", "tsl", "tsl") },
-
-// 214 Spain
-    { /* Telefonica */       "214-07",
-        _APN("m2mtrial.telefonica.com",,) /* Cat-M1 */
-    },
+    { /* Transatel */ _APN_KEY(901, 37, 2), _APN("netgprs.com", "tsl", "tsl") },
 };
 
 /* ----------------------------------------------------------------
  * FUNCTIONS
  * -------------------------------------------------------------- */
 
+/**
+ * Convert a number of decimal digits to an integer.
+ *
+ * @param p  pointer to the digits.
+ * @param n  the number of digits.
+ * @return   the integer or -1 if any of the characters is
+ *           not a digit.
+ */
+static int32_t apndigits(const char *p, size_t n)
+{
+    int32_t x = 0;
+
+    for (size_t i = 0; (i < n) && (x >= 0); i++) {
+        if ((p[i] >= '0') && (p[i] <= '9')) {
+            x = (x * 10) + (p[i] - '0');
+        } else {
+            x = -1;
+        }
+    }
+
+    return x;
+}
+
+/**
+ * Find the entry for a key in the table with a binary search.
+ *
+ * @param key  the key, see _APN_KEY.
+ * @return     the APN configuration string or NULL if there
+ *             is no entry for the key.
+ */
+static const char *apnlookup(uint32_t key)
+{
+    const char *config = NULL;
+    size_t lower = 0;
+    size_t upper = sizeof(apnlut) / sizeof(*apnlut);
+    size_t middle;
+
+    while ((lower < upper) && !config) {
+        middle = lower + ((upper - lower) / 2);
+        if (apnlut[middle].key < key) {
+            lower = middle + 1;
+        } else if (apnlut[middle].key > key) {
+            upper = middle;
+        } else {
+            config = apnlut[middle].cfg;
+        }
+    }
+
+    return config;
+}
+
 /**
  * Configuring APN by extraction from IMSI and matching the table.
  *
- * @param imsi  strinf containing IMSI
+ * @param imsi  string containing IMSI
  */
-const char *apnconfig(const char *imsi)
+static const char *apnconfig(const char *imsi)
 {
     const char *config = NULL;
+    int32_t mcc;
+    int32_t mnc;
+
     if (imsi && *imsi) {
-        // many carriers use internet without username and password, so use this as default
-        // now try to lookup the setting for our table
-        for (size_t i = 0; i < sizeof(apnlut) / sizeof(*apnlut) && !config; i ++) {
-            const char *p = apnlut[i].mccmnc;
-            // check the MCC
-            if ((0 == cellularPort_memcmp(imsi, p, 3))) {
-                p += 3;
-                // check all the MNC, MNC length can be 2 or 3 digits
-                while (((p[0] == '-') || (p[0] == ',')) &&
-                        (p[1] >= '0') && (p[1] <= '9') &&
-                        (p[2] >= '0') && (p[2] <= '9') && !config) {
-                    int l = ((p[3] >= '0') && (p[3] <= '9')) ? 3 : 2;
-                    if (0 == cellularPort_memcmp(imsi + 3, p + 1, l)) {
-                        config = apnlut[i].cfg;
-                    }
-                    p += 1 + l;
-                }
+        mcc = apndigits(imsi, 3);
+        // MNC length can be 2 or 3 digits and the IMSI doesn't
+        // say which, so try both
+        for (size_t l = 3; (l >= 2) && (mcc >= 0) && !config; l--) {
+            mnc = apndigits(imsi + 3, l);
+            if (mnc >= 0) {
+                config = apnlookup(_APN_KEY(mcc, mnc, l));
             }
         }
     }
@@ -15,8 +15,9 @@
  * limitations under the License.
  */
 
-// Define this to print AT strings out in full always
-#define DEBUG_PRINT_FULL_AT_STRING
+// Define DEBUG_PRINT_FULL_AT_STRING to print AT strings out
+// in full always, rather than just the first
+// CELLULAR_CTRL_AT_DEBUG_MAXLEN characters or so
 
 /* Only #includes of cellular_* are allowed here, no C lib,
  * no platform stuff and no OS stuff.  Anything required from
@@ -24,6 +25,9 @@
  * cellular_port* to maintain portability.
  */
 
+// The log level threshold of this module, see cellular_port_debug.h.
+#define CELLULAR_PORT_LOG_THRESHOLD CELLULAR_CFG_LOG_LEVEL_CTRL_AT
+
 // Note: no dependency here on HW or module type
 #ifdef CELLULAR_CFG_OVERRIDE
 # include "cellular_cfg_override.h" // For a customer's configuration override
@@ -37,6 +41,7 @@
 #include "cellular_port_gpio.h"
 #include "cellular_port_uart.h"
 #include "cellular_ctrl_at.h"
+#include "cellular_ctrl_cmux.h"
 
 /* ----------------------------------------------------------------
  * COMPILE-TIME MACROS
@@ -46,18 +51,52 @@
 // processing then you also need to increase this time.
 #define CELLULAR_CTRL_AT_URC_TIMEOUT_MS   100
 
-// The minimum delay between the end of the last response and
-// sending a new AT command.
+// The delay between the end of the last response and sending a
+// new AT command, at the outset and after any failure; it then
+// shrinks towards CELLULAR_CFG_CTRL_AT_SEND_DELAY_MIN_MS or
+// CELLULAR_CFG_CTRL_AT_SEND_DELAY_DATA_MIN_MS while commands
+// succeed.
 #define CELLULAR_CTRL_AT_SEND_DELAY       25
 
 // Suppress logging of very big packet payloads, maxlen is approximate
 // due to write/read are cached.
 #define CELLULAR_CTRL_AT_DEBUG_MAXLEN     80
 
-// Big enough for the biggest thing that pops out without a read, which
-// is a LWM2M read of a very large object, up to the limit of the AT
-// interface
-#define CELLULAR_CTRL_AT_BUFF_SIZE        1024
+// The size of the receive buffer (see CELLULAR_CFG_CTRL_AT_BUFF_SIZE).
+// The receive buffer is circular and is indexed by masking so this
+// MUST be a power of two.
+#define CELLULAR_CTRL_AT_BUFF_SIZE        CELLULAR_CFG_CTRL_AT_BUFF_SIZE
+
+#if (CELLULAR_CTRL_AT_BUFF_SIZE & (CELLULAR_CTRL_AT_BUFF_SIZE - 1)) != 0
+# error CELLULAR_CTRL_AT_BUFF_SIZE must be a power of two
+#endif
+
+// Mask to turn a free-running receive buffer count into an index.
+#define CELLULAR_CTRL_AT_BUFF_MASK        (CELLULAR_CTRL_AT_BUFF_SIZE - 1)
+
+// The size of the buffer in which an AT command is assembled
+// so that it goes to the UART in one write at
+// cellular_ctrl_at_cmd_stop(); a longer command is sent in
+// chunks of this size.
+#define CELLULAR_CTRL_AT_TX_BUFF_SIZE     CELLULAR_CFG_CTRL_AT_TX_BUFF_SIZE
+
+// The size of the copy kept of the prefix given to
+// cellular_ctrl_at_resp_start(), including terminator: the
+// longest in use, "+USECE2EDATAENC:", is well under this.
+#define CELLULAR_CTRL_AT_INFO_RESP_PREFIX_SIZE 24
+
+// The number of already-read bytes that fill_buffer() will never
+// overwrite, so that the tokenizer can step back over a
+// consumed character or tag: must be at least as big as the
+// longest tag (see cellular_ctrl_at_tag_t).
+#define CELLULAR_CTRL_AT_BUFF_LOOKBEHIND  8
+
+// The number of bytes of data kept in each AT trace record.
+#define CELLULAR_CTRL_AT_TRACE_RECORD_DATA_LENGTH 48
+
+// The number of bytes of data in each line of an AT capture,
+// see cellular_ctrl_at_capture_set().
+#define CELLULAR_CTRL_AT_CAPTURE_LINE_DATA_LENGTH 32
 
 // A marker to check for buffer overruns
 #define CELLULAR_CTRL_AT_MARKER           "DEADBEEF"
@@ -86,6 +125,9 @@
 #define CELLULAR_CTRL_AT_OK_LENGTH               4
 #define CELLULAR_CTRL_AT_CRLF                    "\r\n"
 #define CELLULAR_CTRL_AT_CRLF_LENGTH             2
+#define CELLULAR_CTRL_AT_DIRECT_LINK_CONNECT     "CONNECT"
+#define CELLULAR_CTRL_AT_DIRECT_LINK_DISCONNECT  "DISCONNECT"
+#define CELLULAR_CTRL_AT_DIRECT_LINK_ESCAPE      "+++"
 #define CELLULAR_CTRL_AT_CME_ERROR               "+CME ERROR:"
 #define CELLULAR_CTRL_AT_CME_ERROR_LENGTH        11
 #define CELLULAR_CTRL_AT_CMS_ERROR               "+CMS ERROR:"
@@ -96,28 +138,51 @@
 #define CELLULAR_CTRL_AT_OUTPUT_DELIMITER        "\r"
 #define CELLULAR_CTRL_AT_OUTPUT_DELIMITER_LENGTH 1
 
-// The default list delimiter on the AT interface.
-#define CELLULAR_CTRL_AT_DEFAULT_DELIMITER ','
-
-// The maximum length of the callback queue.  Each item in the queue
-// will be sizeof(cellular_ctrl_at_callback_t) bytes big.
-#define CELLULAR_CTRL_AT_CALLBACK_QUEUE_LENGTH 10
+// The number of characters at the start of a URC prefix (including
+// the leading '+') that are used to look the URC up in the URC
+// index; URC prefixes shorter than this are checked separately.
+#define CELLULAR_CTRL_AT_URC_KEY_LENGTH 6
 
-// The queue length for controlling the URC task, actually
-// just telling it to exit.
-#define CELLULAR_CTRL_AT_URC_CONTROL_QUEUE_LENGTH 5
+// The number of buckets in the URC index: must be a power of two.
+#define CELLULAR_CTRL_AT_URC_INDEX_SIZE 16
 
-// The time for the URC task to wait on the UART event queue.
-#define CELLULAR_CTRL_AT_URC_EVENT_UART_WAIT_MS 1000
+// The default list delimiter on the AT interface.
+#define CELLULAR_CTRL_AT_DEFAULT_DELIMITER ','
 
-// The time for the URC task to wait on the control event queue.
-#define CELLULAR_CTRL_AT_URC_EVENT_CONTROL_WAIT_MS 10
+// The number of callbacks that may be waiting at each priority,
+// see cellular_ctrl_at_client_callback_priority(); each takes
+// sizeof(cellular_ctrl_at_callback_entry_t) bytes in the AT client.
+#define CELLULAR_CTRL_AT_CALLBACK_QUEUE_LENGTH 16
 
 // Guard for the URC task data receive loop to make sure
 // it can't be drowned by the UART interrupt, preventing
 // control commands from getting in.
 #define CELLULAR_CTRL_AT_URC_DATA_LOOP_GUARD 100
 
+// How long the URC task waits, once the module is asleep, for
+// the UART to be quiet before suspending it; otherwise the URC
+// task blocks on the UART event queue indefinitely so that the
+// processor is free to sleep.
+#define CELLULAR_CTRL_AT_URC_TASK_WAIT_MS 1000
+
+// How often cellular_ctrl_at_client_set_uart() repeats the
+// wake-up it sends to the URC task on the old UART's event
+// queue, which someone else (e.g. the CMUX demultiplexer) may
+// take, and how many times it will do so.
+#define CELLULAR_CTRL_AT_URC_TASK_MOVE_WAIT_MS 100
+#define CELLULAR_CTRL_AT_URC_TASK_MOVE_TRIES 10
+
+// The longest fill_buffer() blocks on the UART event queue at
+// a time while waiting for data: the wait ends as soon as an
+// event arrives, this only puts a bound on how late data is
+// picked up should its event have been lost (e.g. the event
+// queue being full) or taken by the URC task.
+#define CELLULAR_CTRL_AT_FILL_BUFFER_WAIT_MAX_MS 50
+
+// How long fill_buffer() sleeps between reads when it can't
+// block on the UART event queue.
+#define CELLULAR_CTRL_AT_FILL_BUFFER_SLEEP_MS 10
+
 // The stack size for the URC task.
 #ifndef CELLULAR_CTRL_AT_TASK_URC_STACK_SIZE_BYTES
 # error CELLULAR_CTRL_AT_TASK_URC_STACK_SIZE_BYTES must be defined in cellular_cfg_os_platform_specific.h
@@ -163,7 +228,12 @@ typedef struct cellular_ctrl_at_urc_t {
     int prefix_len;
     void (*cb) (void *);
     void *cb_param;
+    uint32_t count;
+    int64_t total_ms;
+    int32_t max_ms;
+    uint32_t over_budget;
     struct cellular_ctrl_at_urc_t *next;
+    struct cellular_ctrl_at_urc_t *next_in_bucket;
 } cellular_ctrl_at_urc_t;
 
 // Definition of a tag.
@@ -173,14 +243,19 @@ typedef struct {
     bool found;
 } cellular_ctrl_at_tag_t;
 
-// Definition of the receive buffer
+// Definition of the receive buffer: this is a circular buffer,
+// recv_pos and recv_len are free-running counts which are only
+// ever incremented (or stepped back by less than
+// CELLULAR_CTRL_AT_BUFF_LOOKBEHIND), the index into recv_buff
+// is obtained with CELLULAR_CTRL_AT_BUFF_MASK and the number of
+// unread bytes is always recv_len - recv_pos.
 typedef struct {
     char mk0[CELLULAR_CTRL_AT_MARKER_SIZE];
     char recv_buff[CELLULAR_CTRL_AT_BUFF_SIZE];
     char mk1[CELLULAR_CTRL_AT_MARKER_SIZE];
-    // reading position
+    // total number of bytes written into recv_buff
     size_t recv_len;
-    // reading length
+    // total number of bytes read from recv_buff
     size_t recv_pos;
 } cellular_ctrl_at_buf_t;
 
@@ -190,11 +265,207 @@ typedef struct {
     void *param;
 } cellular_ctrl_at_callback_t;
 
-// Control of the URC task.
-typedef enum {
-    CELLULAR_CTRL_AT_CONTROL_NONE,
-    CELLULAR_CTRL_AT_CONTROL_TERMINATE
-} cellular_ctrl_at_control_t;
+// A callback waiting to be run: if has_data is true the
+// callback is passed a pointer to a copy of data rather
+// than cb.param, see cellular_ctrl_at_client_callback_data().
+typedef struct {
+    cellular_ctrl_at_callback_t cb;
+    bool has_data;
+    uint8_t data_len;
+    uint8_t data[CELLULAR_CTRL_AT_CALLBACK_DATA_MAX_LENGTH_BYTES];
+} cellular_ctrl_at_callback_entry_t;
+
+// The callbacks waiting to be run at one priority, a ring.
+typedef struct {
+    cellular_ctrl_at_callback_entry_t entries[CELLULAR_CTRL_AT_CALLBACK_QUEUE_LENGTH];
+    size_t head;
+    size_t count;
+} cellular_ctrl_at_callback_ring_t;
+
+#if CELLULAR_CFG_CTRL_AT_TRACE_NUM_RECORDS > 0
+// A record in the AT trace: one command sent or one
+// lump of response data received.
+typedef struct {
+    int64_t time_ms;
+    bool tx;
+    // total number of bytes in the command/response
+    size_t len;
+    // number of those bytes that are in data
+    size_t stored_len;
+    char data[CELLULAR_CTRL_AT_TRACE_RECORD_DATA_LENGTH];
+} cellular_ctrl_at_trace_record_t;
+#endif
+
+// The state of an AT client.
+struct cellular_ctrl_at_client_t {
+    // Mutex to control access to the UART stream.
+    CellularPortMutexHandle_t mtx_stream;
+
+    // Task buffer and task stack for the URC task.
+    CellularPortTaskHandle_t task_handle_urc;
+
+    // Mutex to determine whether the URC task is running.
+    CellularPortMutexHandle_t mtx_urc_task_running;
+
+    // Task buffer and task stack for call-backs.
+    CellularPortTaskHandle_t task_handle_callbacks;
+
+    // Mutex to determine whether the call-backs task is running.
+    CellularPortMutexHandle_t mtx_callbacks_task_running;
+
+    // Queue to feed the call-backs task: each callback waiting
+    // in callbacks[] has an entry here which gets the task to
+    // run the highest priority callback waiting at that time;
+    // the queue is also how the task is told to exit.
+    CellularPortQueueHandle_t queue_callbacks;
+
+    // Mutex to protect callbacks[].
+    CellularPortMutexHandle_t mtx_callbacks;
+
+    // The callbacks waiting to be run, one ring per priority.
+    cellular_ctrl_at_callback_ring_t callbacks[CELLULAR_CTRL_AT_CALLBACK_NUM_PRIORITIES];
+    cellular_ctrl_at_callback_stats_t callback_stats;
+
+    // Queue to feed the URC task with UART data; this is also
+    // how the URC task is told to exit.
+    CellularPortQueueHandle_t queue_uart;
+
+    // The queue the URC task is waiting on, which lags
+    // queue_uart when the AT client is moved to a new UART.
+    volatile CellularPortQueueHandle_t queue_uart_urc_task;
+
+    // The UART port to use, -1 means not initialised.
+    int32_t uart;
+
+    cellular_ctrl_at_error_code_t last_error;
+    int32_t last_3gpp_error;
+    cellular_ctrl_at_device_err_t  last_at_error;
+    uint16_t urc_string_max_length;
+
+    // Linked-list anchor for URC handlers
+    cellular_ctrl_at_urc_t *urcs;
+
+    // Index of the URC handlers, hashed on the first
+    // CELLULAR_CTRL_AT_URC_KEY_LENGTH characters of the prefix,
+    // with the last entry used for any prefixes that are shorter
+    // than that.
+    cellular_ctrl_at_urc_t *urc_index[CELLULAR_CTRL_AT_URC_INDEX_SIZE + 1];
+
+    uint32_t at_timeout_ms;
+    uint32_t previous_at_timeout;
+    int32_t at_num_consecutive_timeouts;
+
+    void(*at_timeout_callback)(void *);
+
+    uint32_t at_send_delay_ms;
+    // Per class of command, the minimum the send delay may
+    // shrink to and the delay that applies now
+    uint32_t at_send_delay_min_ms[CELLULAR_CTRL_AT_SEND_DELAY_NUM_CLASSES];
+    uint32_t at_send_delay_now_ms[CELLULAR_CTRL_AT_SEND_DELAY_NUM_CLASSES];
+    cellular_ctrl_at_send_delay_class_t send_delay_class_next;
+    cellular_ctrl_at_send_delay_class_t send_delay_class;
+    int64_t last_response_stop_ms;
+    int64_t cmd_start_ms;
+    cellular_ctrl_at_timing_t timing;
+
+    // Busy time of the URC and call-backs tasks, indexed by
+    // cellular_ctrl_at_task_t; each entry is only written by
+    // its own task.
+    cellular_ctrl_at_task_stats_t task_stats[CELLULAR_CTRL_AT_NUM_TASKS];
+
+    // The buffer
+    cellular_ctrl_at_buf_t buf;
+
+    cellular_ctrl_at_scope_type current_scope;
+
+    // tag to stop response scope
+    cellular_ctrl_at_tag_t resp_stop;
+    // tag to stop information response scope
+    cellular_ctrl_at_tag_t info_stop;
+    // tag to stop element scope
+    cellular_ctrl_at_tag_t elem_stop;
+    // reference to the stop tag of current scope (resp/info/elem)
+    cellular_ctrl_at_tag_t *stop_tag;
+
+    // delimiter between parameters and also used for delimiting
+    // elements of information response
+    char delimiter;
+    // set true on prefix match -> indicates start of an information
+    // response or of an element
+    bool prefix_matched;
+    // set true on URC match
+    bool urc_matched;
+    // set true on (CME)(CMS)ERROR
+    bool error_found;
+    // Max length of OK,(CME)(CMS)ERROR and URCs
+    size_t max_resp_length;
+
+    // prefix set during resp_start and used to try matching
+    // possible information responses
+    char info_resp_prefix[CELLULAR_CTRL_AT_INFO_RESP_PREFIX_SIZE];
+    bool cmd_start;
+    bool use_delimiter;
+
+    // the AT command being assembled, see write_staged()
+    char tx_buf[CELLULAR_CTRL_AT_TX_BUFF_SIZE];
+    size_t tx_len;
+
+    // time when a command or an URC processing was started
+    int64_t start_time_ms;
+
+    // Whether the module is in direct-link (transparent)
+    // mode, in which case the UART stream carries raw data
+    // and must not be parsed for AT responses or URCs
+    volatile bool direct_link_active;
+
+    // Whether the module is asleep (e.g. in 3GPP power saving
+    // mode) and so has to be woken up before the next command
+    volatile bool asleep;
+
+    // Whether the AT link is being recovered by the callbacks
+    // task, in which case everyone else fails at once
+    volatile bool recovering;
+
+    // Callback that wakes the module up, and its parameter
+    void (*wake_up_callback)(void *);
+    void *wake_up_callback_param;
+
+    // Function that the callbacks task calls whenever it has
+    // no callbacks to run, and its parameter
+    void (*volatile callbacks_poll)(void *);
+    void *volatile callbacks_poll_param;
+
+    // Whether general debug is on or off
+    bool debug_on;
+
+    // Whether printing of AT commands and responses is on or off
+    bool print_at_on;
+
+    // Whether capture of everything sent and received is on or off
+    bool capture_on;
+
+#if CELLULAR_CFG_CTRL_AT_TRACE_NUM_RECORDS > 0
+    // The AT trace records, used circularly.
+    cellular_ctrl_at_trace_record_t trace[CELLULAR_CFG_CTRL_AT_TRACE_NUM_RECORDS];
+
+    // Free-running count of the trace records used.
+    size_t trace_count;
+
+    // Set to force the next trace data into a new record.
+    bool trace_new_record;
+#endif
+
+#if CELLULAR_CFG_CTRL_AT_STATS_NUM_COMMANDS > 0
+    // The AT command statistics.
+    cellular_ctrl_at_stats_t stats[CELLULAR_CFG_CTRL_AT_STATS_NUM_COMMANDS];
+
+    // The statistics of the command in progress, if any.
+    cellular_ctrl_at_stats_t *stats_current;
+
+    // Set if the command in progress has timed out.
+    bool stats_timed_out;
+#endif
+};
 
 /* ----------------------------------------------------------------
  * VARIABLES
@@ -208,127 +479,151 @@ static const uint8_t _map_3gpp_errors[][2] =  {
     { 146, 46 }, { 178, 65 }, { 179, 66 }, { 180, 48 }, { 181, 83 }, { 171, 49 },
 };
 
-// Mutex to control access to the UART stream.
-static CellularPortMutexHandle_t _mtx_stream;
-
-// Task buffer and task stack for the URC task.
-static CellularPortTaskHandle_t _task_handle_urc;
-
-// Mutex to determine whether the URC task is running.
-static CellularPortMutexHandle_t _mtx_urc_task_running;
+// The two hex digits of every byte value, in order, so that
+// cellular_ctrl_at_client_write_hex() needs one lookup per byte.
+#define HEX_ROW(h) h "0" h "1" h "2" h "3" h "4" h "5" h "6" h "7" \
+                   h "8" h "9" h "a" h "b" h "c" h "d" h "e" h "f"
+static const char _hex_pairs[] = HEX_ROW("0") HEX_ROW("1") HEX_ROW("2") HEX_ROW("3")
+                                 HEX_ROW("4") HEX_ROW("5") HEX_ROW("6") HEX_ROW("7")
+                                 HEX_ROW("8") HEX_ROW("9") HEX_ROW("a") HEX_ROW("b")
+                                 HEX_ROW("c") HEX_ROW("d") HEX_ROW("e") HEX_ROW("f");
+#undef HEX_ROW
 
-// Task buffer and task stack for call-backs.
-static CellularPortTaskHandle_t _task_handle_callbacks;
+// The default AT client, which is the one used by those
+// functions that do not take an AT client as a parameter.
+static cellular_ctrl_at_client_t _client_default = {.uart = -1};
 
-// Mutex to determine whether the call-backs task is running.
-static CellularPortMutexHandle_t _mtx_callbacks_task_running;
 
-// Queue to feed the call-backs task.
-static CellularPortQueueHandle_t _queue_callbacks;
-
-// Queue to feed the URC task with UART data.
-static CellularPortQueueHandle_t _queue_uart;
-
-// Queue to control the URC task.
-static CellularPortQueueHandle_t _queue_urc_control;
-
-// The UART port to use, -1 means not initialised.
-static int32_t _uart = -1;
-
-static cellular_ctrl_at_error_code_t _last_error;
-static int32_t _last_3gpp_error;
-static cellular_ctrl_at_device_err_t  _last_at_error;
-static uint16_t _urc_string_max_length;
-
-// Linked-list anchor for URC handlers
-static cellular_ctrl_at_urc_t *_urcs;
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
 
-static uint32_t _at_timeout_ms;
-static uint32_t _previous_at_timeout;
-static int32_t _at_num_consecutive_timeouts;
+// The value of a hex digit; anything that isn't one is
+// treated as zero.
+static int32_t hex_digit_value(char c)
+{
+    if ((c >= '0') && (c <= '9')) {
+        return c - '0';
+    }
+    // Folding to lower case takes care of 'A' to 'F'
+    c |= 0x20;
+    if ((c >= 'a') && (c <= 'f')) {
+        return c - 'a' + 10;
+    }
 
-static void(*_at_timeout_callback)(void *);
+    return 0;
+}
 
-static uint32_t _at_send_delay_ms;
-static int64_t _last_response_stop_ms;
+int32_t hex_str_to_int(const char *hex_string, int32_t hex_string_length)
+{
+    int32_t integer_output = 0;
 
-// The buffer
-static cellular_ctrl_at_buf_t _buf;
+    for (size_t i = 0; i < hex_string_length && hex_string[i] != '\0'; i++) {
+        integer_output = (integer_output << 4) | hex_digit_value(hex_string[i]);
+    }
 
-static cellular_ctrl_at_scope_type _current_scope;
+    return integer_output;
+}
 
-// tag to stop response scope
-static cellular_ctrl_at_tag_t _resp_stop;
-// tag to stop information response scope
-static cellular_ctrl_at_tag_t _info_stop;
-// tag to stop element scope
-static cellular_ctrl_at_tag_t _elem_stop;
-// reference to the stop tag of current scope (resp/info/elem)
-static cellular_ctrl_at_tag_t *_stop_tag;
+// buf may be the same as str, in which case the conversion
+// is done in place.
+int32_t hex_str_to_char_str(const char *str, int32_t len, char *buf)
+{
+    int32_t str_count = 0;
+    for (size_t i = 0; i + 1 < len; i += 2) {
+        buf[str_count] = (char) ((hex_digit_value(str[i]) << 4) |
+                                 hex_digit_value(str[i + 1]));
+        str_count++;
+    }
 
-// delimiter between parameters and also used for delimiting
-// elements of information response
-static char _delimiter;
-// set true on prefix match -> indicates start of an information
-// response or of an element
-static bool _prefix_matched;
-// set true on URC match
-static bool _urc_matched;
-// set true on (CME)(CMS)ERROR
-static bool _error_found;
-// Max length of OK,(CME)(CMS)ERROR and URCs
-static size_t _max_resp_length;
+    return str_count;
+}
 
-// prefix set during resp_start and used to try matching
-// possible information responses
-static char _info_resp_prefix[CELLULAR_CTRL_AT_BUFF_SIZE];
-static bool _cmd_start;
-static bool _use_delimiter;
+// The UART functions used by this code: these go to a
+// CMUX virtual UART if that is what the AT client has been
+// pointed at, else to the physical UART.
+static int32_t uart_read(cellular_ctrl_at_client_t *at, char *buf, size_t len)
+{
+    if (CELLULAR_CTRL_CMUX_IS_UART(at->uart)) {
+        return cellularCtrlCmuxRead(at->uart, buf, len);
+    }
+    return cellularPortUartRead(at->uart, buf, len);
+}
 
-// time when a command or an URC processing was started
-static int64_t _start_time_ms;
+static int32_t uart_read_span(cellular_ctrl_at_client_t *at, const char **pp_data)
+{
+    if (CELLULAR_CTRL_CMUX_IS_UART(at->uart)) {
+        return cellularCtrlCmuxReadSpan(at->uart, pp_data);
+    }
+    return cellularPortUartReadSpan(at->uart, pp_data);
+}
 
-// Whether general debug is on or off
-static bool _debug_on = false;
+static int32_t uart_read_commit(cellular_ctrl_at_client_t *at, size_t len)
+{
+    if (CELLULAR_CTRL_CMUX_IS_UART(at->uart)) {
+        return cellularCtrlCmuxReadCommit(at->uart, len);
+    }
+    return cellularPortUartReadCommit(at->uart, len);
+}
 
-// Whether printing of AT commands and responses is on or off
-static bool _print_at_on = true;
+static int32_t uart_write(cellular_ctrl_at_client_t *at, const char *buf, size_t len)
+{
+    if (CELLULAR_CTRL_CMUX_IS_UART(at->uart)) {
+        return cellularCtrlCmuxWrite(at->uart, buf, len);
+    }
+    return cellularPortUartWrite(at->uart, buf, len);
+}
 
-/* ----------------------------------------------------------------
- * STATIC FUNCTIONS
- * -------------------------------------------------------------- */
+static int32_t uart_get_receive_size(cellular_ctrl_at_client_t *at)
+{
+    if (CELLULAR_CTRL_CMUX_IS_UART(at->uart)) {
+        return cellularCtrlCmuxGetReceiveSize(at->uart);
+    }
+    return cellularPortUartGetReceiveSize(at->uart);
+}
 
-int32_t hex_str_to_int(const char *hex_string, int32_t hex_string_length)
+static int32_t uart_event_send(int32_t uart, CellularPortQueueHandle_t queue,
+                               int32_t size_or_error)
 {
-    const int32_t base = 16;
-    int32_t character_as_integer, integer_output = 0;
+    if (CELLULAR_CTRL_CMUX_IS_UART(uart)) {
+        return cellularCtrlCmuxEventSend(queue, size_or_error);
+    }
+    return cellularPortUartEventSend(queue, size_or_error);
+}
 
-    for (size_t i = 0; i < hex_string_length && hex_string[i] != '\0'; i++) {
-        if (hex_string[i] >= '0' && hex_string[i] <= '9') {
-            character_as_integer = hex_string[i] - '0';
-        } else if (hex_string[i] >= 'A' && hex_string[i] <= 'F') {
-            character_as_integer = hex_string[i] - 'A' + 10;
-        } else {
-            character_as_integer = hex_string[i] - 'a' + 10;
-        }
-        integer_output *= base;
-        integer_output += character_as_integer;
+static int32_t uart_event_receive(int32_t uart, CellularPortQueueHandle_t queue)
+{
+    if (CELLULAR_CTRL_CMUX_IS_UART(uart)) {
+        return cellularCtrlCmuxEventReceive(queue);
     }
+    return cellularPortUartEventReceive(queue);
+}
 
-    return integer_output;
+static int32_t uart_event_try_receive(int32_t uart, CellularPortQueueHandle_t queue,
+                                      int32_t wait_ms)
+{
+    if (CELLULAR_CTRL_CMUX_IS_UART(uart)) {
+        return cellularCtrlCmuxEventTryReceive(queue, wait_ms);
+    }
+    return cellularPortUartEventTryReceive(queue, wait_ms);
 }
 
-int32_t hex_str_to_char_str(const char *str, int32_t len, char *buf)
+// Virtual UARTs have no hardware to suspend: the physical UART
+// underneath belongs to the CMUX multiplexer.
+static int32_t uart_suspend(cellular_ctrl_at_client_t *at)
 {
-    int32_t str_count = 0;
-    for (size_t i = 0; i + 1 < len; i += 2) {
-        int32_t upper = hex_str_to_int(str + i, 1);
-        int32_t lower = hex_str_to_int(str + i + 1, 1);
-        buf[str_count] = ((upper << 4) & 0xF0) | (lower & 0x0F);
-        str_count++;
+    if (CELLULAR_CTRL_CMUX_IS_UART(at->uart)) {
+        return CELLULAR_PORT_NOT_IMPLEMENTED;
     }
+    return cellularPortUartSuspend(at->uart);
+}
 
-    return str_count;
+static int32_t uart_resume(cellular_ctrl_at_client_t *at)
+{
+    if (CELLULAR_CTRL_CMUX_IS_UART(at->uart)) {
+        return CELLULAR_PORT_NOT_IMPLEMENTED;
+    }
+    return cellularPortUartResume(at->uart);
 }
 
 // Copy content of one char buffer to another
@@ -340,82 +635,282 @@ static void set_string(char *dest, const char *src,
     dest[src_len] = '\0';
 }
 
-// Find occurrence of one char buffer inside
-// another char buffer.
-static const char *mem_str(const char *dest,
-                              size_t dest_len,
-                              const char *src,
-                              size_t src_len)
+// Print characters, making the non-printable ones visible;
+// if lines is true then line endings are printed as such.
+static void print_chars(const char *p, int len, bool lines)
 {
-    if (dest_len >= src_len) {
-        for (size_t i = 0; i < dest_len - src_len + 1; ++i) {
-            if (cellularPort_memcmp(dest + i, src, src_len) == 0) {
-                return dest + i;
+    for (int32_t i = 0; i < len; i++) {
+        char c = *p++;
+        if (!cellularPort_isprint((int32_t) c)) {
+            if (lines && (c == '\r')) {
+                cellularPortLogDebug("%c", '\n');
+            } else if (lines && (c == '\n')) {
+                // Do nothing
+            } else {
+                cellularPortLogDebug("[%d]", c);
             }
+        } else {
+            cellularPortLogDebug("%c", c);
         }
     }
-
-    return NULL;
 }
 
 // Print out AT commands and responses.
-static void print_at(const char *p, int len)
-{
-    if (_print_at_on) {
-        for (int32_t i = 0; i < len; i++) {
-            char c = *p++;
-            if (!cellularPort_isprint((int32_t) c)) {
-                if (c == '\r') {
-                    cellularPortLog("%c", '\n');
-                } else if (c == '\n') {
-                    // Do nothing
-                } else {
-                    cellularPortLog("[%d]", c);
-                }
-            } else {
-                cellularPortLog("%c", c);
-            }
+static void print_at(cellular_ctrl_at_client_t *at, const char *p, int len)
+{
+    if (at->print_at_on) {
+        print_chars(p, len, true);
+    }
+}
+
+// Log a chunk of what was sent or received in the capture
+// format, see cellular_ctrl_at_capture_set().
+static void capture_at(cellular_ctrl_at_client_t *at, const char *p, size_t len, bool tx)
+{
+    char hex[(CELLULAR_CTRL_AT_CAPTURE_LINE_DATA_LENGTH * 2) + 1];
+    int64_t time_ms = cellularPortGetTickTimeMs();
+    size_t line_len;
+    size_t x;
+
+    for (size_t offset = 0; offset < len; offset += line_len) {
+        line_len = len - offset;
+        if (line_len > CELLULAR_CTRL_AT_CAPTURE_LINE_DATA_LENGTH) {
+            line_len = CELLULAR_CTRL_AT_CAPTURE_LINE_DATA_LENGTH;
+        }
+        for (x = 0; x < line_len; x++) {
+            hex[x * 2] = "0123456789abcdef"[((uint8_t) p[offset + x]) >> 4];
+            hex[(x * 2) + 1] = "0123456789abcdef"[((uint8_t) p[offset + x]) & 0x0f];
+        }
+        hex[x * 2] = 0;
+        cellularPortLog(CELLULAR_CTRL_AT_CAPTURE_TAG " %d %d %s %d %d %s\n",
+                        (int32_t) time_ms, at->uart, tx ? "TX" : "RX",
+                        (int32_t) len, (int32_t) offset, hex);
+    }
+}
+
+// Add AT commands and responses to the trace, appending
+// to the most recent record if it is in the same direction;
+// also where the capture is done from.
+static void trace_at(cellular_ctrl_at_client_t *at, const char *p, size_t len, bool tx)
+{
+    if (at->capture_on) {
+        capture_at(at, p, len, tx);
+    }
+#if CELLULAR_CFG_CTRL_AT_TRACE_NUM_RECORDS > 0
+    cellular_ctrl_at_trace_record_t *record = NULL;
+    size_t copy_len;
+
+    if ((at->trace_count > 0) && !at->trace_new_record) {
+        record = &(at->trace[(at->trace_count - 1) % CELLULAR_CFG_CTRL_AT_TRACE_NUM_RECORDS]);
+        if (record->tx != tx) {
+            record = NULL;
+        }
+    }
+    if (record == NULL) {
+        record = &(at->trace[at->trace_count % CELLULAR_CFG_CTRL_AT_TRACE_NUM_RECORDS]);
+        at->trace_count++;
+        record->time_ms = cellularPortGetTickTimeMs();
+        record->tx = tx;
+        record->len = 0;
+        record->stored_len = 0;
+    }
+    at->trace_new_record = false;
+
+    copy_len = sizeof(record->data) - record->stored_len;
+    if (copy_len > len) {
+        copy_len = len;
+    }
+    pCellularPort_memcpy(record->data + record->stored_len, p, copy_len);
+    record->stored_len += copy_len;
+    record->len += len;
+#else
+    (void) p;
+    (void) len;
+    (void) tx;
+#endif
+}
+
+// Start collecting statistics for an AT command.
+static void stats_start(cellular_ctrl_at_client_t *at, const char *cmd)
+{
+#if CELLULAR_CFG_CTRL_AT_STATS_NUM_COMMANDS > 0
+    size_t len = 0;
+    cellular_ctrl_at_stats_t *stats = NULL;
+
+    // The prefix is everything up to any parameters
+    while ((len < CELLULAR_CTRL_AT_STATS_PREFIX_LENGTH) && (cmd[len] != '\0') &&
+           (cmd[len] != '=') && (cmd[len] != '?')) {
+        len++;
+    }
+    // Keep the last entry for everything else
+    for (size_t x = 0; (stats == NULL) &&
+                       (x < CELLULAR_CFG_CTRL_AT_STATS_NUM_COMMANDS - 1); x++) {
+        if (at->stats[x].prefix[0] == '\0') {
+            pCellularPort_memcpy(at->stats[x].prefix, cmd, len);
+            at->stats[x].prefix[len] = '\0';
+            stats = &(at->stats[x]);
+        } else if ((cellularPort_memcmp(at->stats[x].prefix, cmd, len) == 0) &&
+                   (at->stats[x].prefix[len] == '\0')) {
+            stats = &(at->stats[x]);
+        }
+    }
+    if (stats == NULL) {
+        stats = &(at->stats[CELLULAR_CFG_CTRL_AT_STATS_NUM_COMMANDS - 1]);
+        stats->prefix[0] = '*';
+        stats->prefix[1] = '\0';
+    }
+    stats->count++;
+    at->stats_current = stats;
+    at->stats_timed_out = false;
+#else
+    (void) cmd;
+#endif
+}
+
+// Finish collecting statistics for an AT command.
+static void stats_stop(cellular_ctrl_at_client_t *at, int32_t duration_ms)
+{
+#if CELLULAR_CFG_CTRL_AT_STATS_NUM_COMMANDS > 0
+    size_t bucket = 0;
+    int32_t limit_ms = CELLULAR_CTRL_AT_STATS_HISTOGRAM_BASE_MS;
+    cellular_ctrl_at_stats_t *stats = at->stats_current;
+
+    if (stats != NULL) {
+        if (at->last_error != CELLULAR_CTRL_AT_SUCCESS) {
+            stats->errors++;
+        }
+        if (at->stats_timed_out) {
+            stats->timeouts++;
+        }
+        stats->total_ms += duration_ms;
+        if (duration_ms > stats->max_ms) {
+            stats->max_ms = duration_ms;
+        }
+        while ((bucket < CELLULAR_CTRL_AT_STATS_HISTOGRAM_NUM_BUCKETS - 1) &&
+               (duration_ms >= limit_ms)) {
+            bucket++;
+            limit_ms <<= 1;
+        }
+        stats->histogram[bucket]++;
+        at->stats_current = NULL;
+    }
+#else
+    (void) duration_ms;
+#endif
+}
+
+// Count bytes in the statistics of the current AT command.
+// Put the send delay for all classes of command back to the
+// full at_send_delay_ms.
+static void send_delay_reset(cellular_ctrl_at_client_t *at)
+{
+    for (size_t x = 0; x < CELLULAR_CTRL_AT_SEND_DELAY_NUM_CLASSES; x++) {
+        at->at_send_delay_now_ms[x] = at->at_send_delay_ms;
+    }
+}
+
+// Adapt the send delay at the end of a command: if it succeeded
+// the delay for its class moves half way towards the minimum,
+// if it failed or timed out everything backs off to the full
+// delay since the module may be struggling.
+static void send_delay_adapt(cellular_ctrl_at_client_t *at)
+{
+    uint32_t *p_now = &(at->at_send_delay_now_ms[at->send_delay_class]);
+    uint32_t min_ms = at->at_send_delay_min_ms[at->send_delay_class];
+
+    if (at->last_error == CELLULAR_CTRL_AT_SUCCESS) {
+        if (*p_now > min_ms) {
+            *p_now = min_ms + ((*p_now - min_ms) >> 1);
+        }
+    } else {
+        send_delay_reset(at);
+    }
+}
+
+static void stats_bytes(cellular_ctrl_at_client_t *at, size_t len, bool tx)
+{
+#if CELLULAR_CFG_CTRL_AT_STATS_NUM_COMMANDS > 0
+    if (at->stats_current != NULL) {
+        if (tx) {
+            at->stats_current->bytes_tx += len;
+        } else {
+            at->stats_current->bytes_rx += len;
         }
     }
+#else
+    (void) len;
+    (void) tx;
+#endif
 }
 
 // Set last error.
-static void set_error(cellular_ctrl_at_error_code_t error)
+static void set_error(cellular_ctrl_at_client_t *at, cellular_ctrl_at_error_code_t error)
 {
     if (error != CELLULAR_CTRL_AT_SUCCESS) {
-        if (_debug_on) {
+        if (at->debug_on) {
             cellularPortLog("CELLULAR_AT: AT error %d\n", error);
         }
     }
-    if (_last_error == CELLULAR_CTRL_AT_SUCCESS) {
-        _last_error = error;
+    if (at->last_error == CELLULAR_CTRL_AT_SUCCESS) {
+        at->last_error = error;
     }
 }
 
-// Sets to 0 the reading position, reading length and the whole
-// buffer content.
-static void reset_buffer()
+// Sets to 0 the reading position and reading length,
+// discarding any unread content.
+static void reset_buffer(cellular_ctrl_at_client_t *at)
+{
+    at->buf.recv_pos = 0;
+    at->buf.recv_len = 0;
+}
+
+// Return the number of unread bytes in the receive buffer.
+static size_t buf_unread(cellular_ctrl_at_client_t *at)
+{
+    return at->buf.recv_len - at->buf.recv_pos;
+}
+
+// Compare size bytes of str against the unread content
+// of the receive buffer starting offset bytes from the
+// reading position, taking account of wrap; the caller
+// must have checked that there are enough unread bytes.
+static bool buf_compare(cellular_ctrl_at_client_t *at,
+                        size_t offset, const char *str, size_t size)
 {
-    _buf.recv_pos = 0;
-    _buf.recv_len = 0;
+    size_t start = (at->buf.recv_pos + offset) & CELLULAR_CTRL_AT_BUFF_MASK;
+    size_t first = CELLULAR_CTRL_AT_BUFF_SIZE - start;
+
+    if (first > size) {
+        first = size;
+    }
+
+    return (cellularPort_memcmp(at->buf.recv_buff + start, str, first) == 0) &&
+           ((first == size) ||
+            (cellularPort_memcmp(at->buf.recv_buff, str + first, size - first) == 0));
 }
 
-// Reading position set to 0 and buffer's unread content moved
-// to beginning.
-static void rewind_buffer()
+// Find occurrence of str in the unread content of
+// the receive buffer.
+static bool buf_find(cellular_ctrl_at_client_t *at, const char *str, size_t size)
 {
-    if (_buf.recv_pos > 0 && _buf.recv_len >= _buf.recv_pos) {
-        _buf.recv_len -= _buf.recv_pos;
-        // move what is not read to beginning of buffer
-        pCellularPort_memmove(_buf.recv_buff, _buf.recv_buff + _buf.recv_pos, _buf.recv_len);
-        _buf.recv_pos = 0;
+    size_t unread = buf_unread(at);
+
+    if (unread >= size) {
+        for (size_t i = 0; i < unread - size + 1; ++i) {
+            if ((at->buf.recv_buff[(at->buf.recv_pos + i) & CELLULAR_CTRL_AT_BUFF_MASK] == *str) &&
+                buf_compare(at, i, str, size)) {
+                return true;
+            }
+        }
     }
+
+    return false;
 }
 
 // Calculate remaining time for polling based on request start
 // time and AT timeout.
 // Returns 0 or time in ms for polling.
-static int32_t poll_timeout(int32_t at_timeout)
+static int32_t poll_timeout(cellular_ctrl_at_client_t *at, int32_t at_timeout)
 {
     int64_t timeout;
 
@@ -423,12 +918,12 @@ static int32_t poll_timeout(int32_t at_timeout)
         // No need to worry about overflow here, we're never awake
         // for long enough
         int64_t now_ms = cellularPortGetTickTimeMs();
-        if (now_ms >= _start_time_ms + at_timeout) {
+        if (now_ms >= at->start_time_ms + at_timeout) {
             timeout = 0;
-        } else if (_start_time_ms + at_timeout - now_ms > INT_MAX) {
+        } else if (at->start_time_ms + at_timeout - now_ms > INT_MAX) {
             timeout = INT_MAX;
         } else {
-            timeout = _start_time_ms + at_timeout - now_ms;
+            timeout = at->start_time_ms + at_timeout - now_ms;
         }
     } else {
         timeout = 0;
@@ -437,74 +932,244 @@ static int32_t poll_timeout(int32_t at_timeout)
     return timeout;
 }
 
-// Reads from serial to receiving buffer.
+// Reads from serial to receiving buffer, making room by
+// discarding the oldest unread data if the buffer is full.
 // Returns true on successful read OR false on timeout.
-static bool fill_buffer(bool wait_for_timeout)
+// Between reads this blocks on the UART event queue, rather than
+// spinning, for at most the time remaining.  An event taken here
+// needs no passing on: the data it announces is read here and
+// unlocking the AT client sends a fresh event if anything is left
+// over.  A zero-sized event (e.g. data that doesn't yet complete
+// a line, on a port that detects lines) is just a reason to read
+// again.  A negative event (the signal for the URC task to exit)
+// is put back and the wait is then done by sleeping.
+static bool fill_buffer(cellular_ctrl_at_client_t *at, bool wait_for_timeout)
 {
     int32_t at_timeout = -1;
+    int32_t wait_ms;
+    int32_t event;
+    size_t discard;
+    bool use_events = true;
 
     if (wait_for_timeout) {
-        at_timeout = _at_timeout_ms;
-        if (cellularPortTaskIsThis(_task_handle_urc)) {
+        at_timeout = at->at_timeout_ms;
+        if (cellularPortTaskIsThis(at->task_handle_urc)) {
             at_timeout = CELLULAR_CTRL_AT_URC_TIMEOUT_MS;
         }
     }
-    // Reset buffer when full
-    if (sizeof(_buf.recv_buff) == _buf.recv_len) {
-        if (_debug_on) {
-            cellularPortLog("CELLULAR_CTRL: !!! overflow.\n");
+    // Work out how much room there is, keeping back
+    // the look-behind area
+    size_t space = CELLULAR_CTRL_AT_BUFF_SIZE - CELLULAR_CTRL_AT_BUFF_LOOKBEHIND -
+                   buf_unread(at);
+    size_t write_index;
+
+    // When full the unread data can't be anything the
+    // tokenizer is waiting for (e.g. a line with no
+    // CELLULAR_CTRL_AT_CRLF) and, left there, would block
+    // everything that follows: throw away all but the last
+    // CELLULAR_CTRL_AT_BUFF_LOOKBEHIND bytes of it, which
+    // may be the start of a tag, and carry on reading
+    if (space == 0) {
+        discard = buf_unread(at) - CELLULAR_CTRL_AT_BUFF_LOOKBEHIND;
+        if (at->debug_on) {
+            cellularPortLog("CELLULAR_AT: !!! overflow, %d unread byte(s)"
+                            " discarded.\n", (int32_t) discard);
         }
-        print_at((char *) (_buf.recv_buff), _buf.recv_len);
-        reset_buffer();
+        at->buf.recv_pos += discard;
+        space = discard;
+    }
+    write_index = at->buf.recv_len & CELLULAR_CTRL_AT_BUFF_MASK;
+
+    // Only read up to the end of the buffer, the next
+    // call will carry on from the start
+    if (space > CELLULAR_CTRL_AT_BUFF_SIZE - write_index) {
+        space = CELLULAR_CTRL_AT_BUFF_SIZE - write_index;
     }
 
-    while (poll_timeout(at_timeout) > 0) {
-        int32_t len = cellularPortUartRead(_uart,
-                                           _buf.recv_buff + _buf.recv_len,
-                                           sizeof(_buf.recv_buff) - _buf.recv_len);
+    while ((wait_ms = poll_timeout(at, at_timeout)) > 0) {
+        int32_t len = uart_read(at, at->buf.recv_buff + write_index,
+                                space);
         if (len > 0) {
-            print_at((char *) (_buf.recv_buff) + _buf.recv_len, len);
-            _buf.recv_len += len;
+            trace_at(at, (char *) (at->buf.recv_buff) + write_index, len, false);
+            stats_bytes(at, len, false);
+            print_at(at, (char *) (at->buf.recv_buff) + write_index, len);
+            at->buf.recv_len += len;
             return true;
         }
+        if (wait_ms > CELLULAR_CTRL_AT_FILL_BUFFER_WAIT_MAX_MS) {
+            wait_ms = CELLULAR_CTRL_AT_FILL_BUFFER_WAIT_MAX_MS;
+        }
+        if (use_events) {
+            event = uart_event_try_receive(at->uart, at->queue_uart, wait_ms);
+            if ((event < 0) && (event != CELLULAR_PORT_TIMEOUT)) {
+                uart_event_send(at->uart, at->queue_uart, event);
+                use_events = false;
+            }
+        } else {
+            if (wait_ms > CELLULAR_CTRL_AT_FILL_BUFFER_SLEEP_MS) {
+                wait_ms = CELLULAR_CTRL_AT_FILL_BUFFER_SLEEP_MS;
+            }
+            cellularPortTaskBlock(wait_ms);
+        }
     }
 
-    cellularPort_assert(CELLULAR_CTRL_AT_GUARD_CHECK(_buf));
+    cellularPort_assert(CELLULAR_CTRL_AT_GUARD_CHECK(at->buf));
 
     return false;
 }
 
+// Run the highest priority callback that is waiting; this is
+// what the callbacks task receives on its queue.
+static void callback_run_next(void *param)
+{
+    cellular_ctrl_at_client_t *at = (cellular_ctrl_at_client_t *) param;
+    cellular_ctrl_at_callback_ring_t *p_ring;
+    cellular_ctrl_at_callback_entry_t entry;
+
+    entry.cb.function = NULL;
+
+    CELLULAR_PORT_MUTEX_LOCK(at->mtx_callbacks);
+
+    for (size_t x = 0; (entry.cb.function == NULL) &&
+                       (x < CELLULAR_CTRL_AT_CALLBACK_NUM_PRIORITIES); x++) {
+        p_ring = &(at->callbacks[x]);
+        if (p_ring->count > 0) {
+            entry = p_ring->entries[p_ring->head];
+            p_ring->head = (p_ring->head + 1) % CELLULAR_CTRL_AT_CALLBACK_QUEUE_LENGTH;
+            p_ring->count--;
+        }
+    }
+
+    CELLULAR_PORT_MUTEX_UNLOCK(at->mtx_callbacks);
+
+    if (entry.cb.function != NULL) {
+        if (entry.has_data) {
+            // The copy lives here until the callback returns
+            entry.cb.function(entry.data);
+        } else {
+            entry.cb.function(entry.cb.param);
+        }
+    }
+}
+
+// Queue a callback to be run by the callbacks task at the given
+// priority; if coalesce is true and the same callback with the
+// same parameter (or data) is already waiting at that priority
+// it is not queued again.  If p_data is not NULL the callback
+// is passed a copy of the data_len bytes there, which must be
+// no more than CELLULAR_CTRL_AT_CALLBACK_DATA_MAX_LENGTH_BYTES,
+// instead of param.  Returns true if the callback is (now)
+// waiting.
+static bool callback_post(cellular_ctrl_at_client_t *at,
+                          void (*function)(void *), void *param,
+                          const void *p_data, size_t data_len,
+                          cellular_ctrl_at_callback_priority_t priority,
+                          bool coalesce)
+{
+    cellular_ctrl_at_callback_ring_t *p_ring;
+    cellular_ctrl_at_callback_entry_t *p_entry;
+    cellular_ctrl_at_callback_t cb;
+    bool has_data = (p_data != NULL);
+    bool waiting = false;
+    bool queued = false;
+    size_t pending = 0;
+
+    if (priority >= CELLULAR_CTRL_AT_CALLBACK_NUM_PRIORITIES) {
+        priority = CELLULAR_CTRL_AT_CALLBACK_PRIORITY_NORMAL;
+    }
+    p_ring = &(at->callbacks[priority]);
+
+    CELLULAR_PORT_MUTEX_LOCK(at->mtx_callbacks);
+
+    if (coalesce) {
+        for (size_t x = 0; !waiting && (x < p_ring->count); x++) {
+            p_entry = &(p_ring->entries[(p_ring->head + x) % CELLULAR_CTRL_AT_CALLBACK_QUEUE_LENGTH]);
+            if ((p_entry->cb.function == function) &&
+                (p_entry->has_data == has_data) &&
+                (has_data ? ((p_entry->data_len == data_len) &&
+                             (cellularPort_memcmp(p_entry->data, p_data, data_len) == 0)) :
+                 (p_entry->cb.param == param))) {
+                at->callback_stats.coalesced[priority]++;
+                waiting = true;
+            }
+        }
+    }
+
+    if (!waiting) {
+        if (p_ring->count < CELLULAR_CTRL_AT_CALLBACK_QUEUE_LENGTH) {
+            p_entry = &(p_ring->entries[(p_ring->head + p_ring->count) %
+                                        CELLULAR_CTRL_AT_CALLBACK_QUEUE_LENGTH]);
+            p_entry->cb.function = function;
+            p_entry->cb.param = param;
+            p_entry->has_data = has_data;
+            p_entry->data_len = (uint8_t) data_len;
+            if (has_data) {
+                pCellularPort_memcpy(p_entry->data, p_data, data_len);
+            }
+            p_ring->count++;
+            at->callback_stats.queued[priority]++;
+            for (size_t x = 0; x < CELLULAR_CTRL_AT_CALLBACK_NUM_PRIORITIES; x++) {
+                pending += at->callbacks[x].count;
+            }
+            if (pending > at->callback_stats.max_pending) {
+                at->callback_stats.max_pending = pending;
+            }
+            waiting = true;
+            queued = true;
+        } else {
+            at->callback_stats.overflows[priority]++;
+        }
+    }
+
+    CELLULAR_PORT_MUTEX_UNLOCK(at->mtx_callbacks);
+
+    if (queued) {
+        // One entry on the queue per callback waiting, so
+        // this can't block
+        cb.function = callback_run_next;
+        cb.param = at;
+        cellularPortQueueSend(at->queue_callbacks, &cb);
+    }
+
+    return waiting;
+}
+
 // Gets char from receiving buffer.
 // Resets and fills the buffer if all are already read
 // (receiving position equals receiving length).
 // Returns a next char or -1 on failure (also sets error flag).
-static int32_t get_char()
+static int32_t get_char(cellular_ctrl_at_client_t *at)
 {
-    cellular_ctrl_at_callback_t cb;
-
-    if (_buf.recv_pos == _buf.recv_len) {
-        reset_buffer(); // try to read as much as possible
-        if (!fill_buffer(true)) {
-            if (_debug_on) {
+    if (buf_unread(at) == 0) {
+        if (!fill_buffer(at, true)) {
+            if (at->debug_on) {
                 cellularPortLog("CELLULAR_AT: timeout.\n");
             }
-            _at_num_consecutive_timeouts++;
-            if (_at_timeout_callback != NULL) {
-                cb.function = _at_timeout_callback;
-                cb.param = &_at_num_consecutive_timeouts;
-                cellularPortQueueSend(_queue_callbacks, &cb);
+            at->at_num_consecutive_timeouts++;
+#if CELLULAR_CFG_CTRL_AT_STATS_NUM_COMMANDS > 0
+            at->stats_timed_out = true;
+#endif
+            if (at->at_timeout_callback != NULL) {
+                (void) callback_post(at, at->at_timeout_callback,
+                                     &at->at_num_consecutive_timeouts,
+                                     NULL, 0,
+                                     CELLULAR_CTRL_AT_CALLBACK_PRIORITY_HIGH,
+                                     true);
             }
-            set_error(CELLULAR_CTRL_AT_DEVICE_ERROR);
+            set_error(at, CELLULAR_CTRL_AT_DEVICE_ERROR);
             return -1; // timeout to read
         } else {
-            _at_num_consecutive_timeouts = 0;
+            at->at_num_consecutive_timeouts = 0;
         }
     }
 
-    return _buf.recv_buff[_buf.recv_pos++];
+    // Cast to unsigned so that a received 0xFF can't be
+    // mistaken for -1
+    return (uint8_t) at->buf.recv_buff[at->buf.recv_pos++ & CELLULAR_CTRL_AT_BUFF_MASK];
 }
 
-static void set_tag(cellular_ctrl_at_tag_t *tag_dst, const char *tag_seq)
+static void set_tag(cellular_ctrl_at_client_t *at,
+                    cellular_ctrl_at_tag_t *tag_dst, const char *tag_seq)
 {
     if (tag_seq) {
         size_t tag_len = cellularPort_strlen(tag_seq);
@@ -512,21 +1177,21 @@ static void set_tag(cellular_ctrl_at_tag_t *tag_dst, const char *tag_seq)
         tag_dst->len = tag_len;
         tag_dst->found = false;
     } else {
-        _stop_tag = NULL;
+        at->stop_tag = NULL;
     }
 }
 
 // Checks if current char in buffer matches ch and
 // consumes it, if no match leaves the buffer unchanged.
-static bool consume_char(char ch)
+static bool consume_char(cellular_ctrl_at_client_t *at, char ch)
 {
-    int32_t read_char = get_char();
+    int32_t read_char = get_char(at);
     if (read_char == -1) {
         return false;
     }
     // If we read something else than ch, recover it
     if (read_char != ch) {
-        _buf.recv_pos--;
+        at->buf.recv_pos--;
         return false;
     }
 
@@ -535,13 +1200,14 @@ static bool consume_char(char ch)
 
 // Consumes the received content until tag is found.
 // Consumes the tag only if consume_tag flag is true.
-static bool consume_to_tag(const char *tag, bool consume_tag)
+static bool consume_to_tag(cellular_ctrl_at_client_t *at,
+                           const char *tag, bool consume_tag)
 {
     size_t match_pos = 0;
     size_t tag_length = cellularPort_strlen(tag);
 
     while (true) {
-        int32_t c = get_char();
+        int32_t c = get_char(at);
         if (c == -1) {
             return false;
         }
@@ -559,33 +1225,127 @@ static bool consume_to_tag(const char *tag, bool consume_tag)
     }
 
     if (!consume_tag) {
-        _buf.recv_pos -= tag_length;
+        at->buf.recv_pos -= tag_length;
     }
 
     return true;
 }
 
+// Copy up to len bytes out of the receive buffer, taking
+// account of wrap; buf may be NULL to throw the bytes away.
+// Returns the number of bytes copied.
+static size_t buf_read(cellular_ctrl_at_client_t *at, uint8_t *buf, size_t len)
+{
+    size_t unread = buf_unread(at);
+    size_t read_len = 0;
+    size_t read_index;
+    size_t this_len;
+
+    if (len > unread) {
+        len = unread;
+    }
+    while (read_len < len) {
+        read_index = at->buf.recv_pos & CELLULAR_CTRL_AT_BUFF_MASK;
+        this_len = CELLULAR_CTRL_AT_BUFF_SIZE - read_index;
+        if (this_len > len - read_len) {
+            this_len = len - read_len;
+        }
+        if (buf != NULL) {
+            pCellularPort_memcpy(buf + read_len,
+                                 at->buf.recv_buff + read_index,
+                                 this_len);
+        }
+        at->buf.recv_pos += this_len;
+        read_len += this_len;
+    }
+
+    return read_len;
+}
+
+// Read len bytes without looking for a stop tag, moving
+// whole blocks at a time: first whatever is already in
+// the receive buffer then, where the platform supports it,
+// straight from the UART receive buffer, saving a copy,
+// else by filling the receive buffer in as large a chunk
+// as the UART offers.  buf may be NULL to throw the bytes
+// away.  Returns the number of bytes read or -1 on failure
+// (also sets error flag).
+static int32_t read_bytes_block(cellular_ctrl_at_client_t *at, uint8_t *buf, size_t len)
+{
+    size_t read_len = 0;
+    const char *span;
+    int32_t span_len;
+    int32_t c;
+    bool print_at_on = at->print_at_on;
+
+    while (read_len < len) {
+        if (buf_unread(at) > 0) {
+            read_len += buf_read(at, (buf != NULL) ? buf + read_len : NULL,
+                                 len - read_len);
+        } else {
+            span_len = uart_read_span(at, &span);
+            if (span_len > 0) {
+                if (span_len > len - read_len) {
+                    span_len = len - read_len;
+                }
+                if (buf != NULL) {
+                    pCellularPort_memcpy(buf + read_len, span, span_len);
+                }
+                trace_at(at, span, span_len, false);
+                stats_bytes(at, span_len, false);
+                print_at(at, span, span_len);
+                uart_read_commit(at, span_len);
+                at->at_num_consecutive_timeouts = 0;
+                read_len += span_len;
+            } else {
+                // Let get_char() do the waiting, it will fill the
+                // receive buffer with all that has arrived
+                c = get_char(at);
+                if (c == -1) {
+                    set_error(at, CELLULAR_CTRL_AT_DEVICE_ERROR);
+                    at->print_at_on = print_at_on;
+                    return -1;
+                }
+                if (buf != NULL) {
+                    buf[read_len] = c;
+                }
+                read_len++;
+            }
+        }
+#ifndef DEBUG_PRINT_FULL_AT_STRING
+        if (at->print_at_on && (read_len >= CELLULAR_CTRL_AT_DEBUG_MAXLEN)) {
+            print_at(at, "...", sizeof("..."));
+            at->print_at_on = false;
+        }
+#endif
+    }
+
+    at->print_at_on = print_at_on;
+    return read_len;
+}
+
 // Set scope.
-static void set_scope(cellular_ctrl_at_scope_type scope_type)
+static void set_scope(cellular_ctrl_at_client_t *at,
+                      cellular_ctrl_at_scope_type scope_type)
 {
-    if (_current_scope != scope_type) {
-        _current_scope = scope_type;
-        switch (_current_scope) {
+    if (at->current_scope != scope_type) {
+        at->current_scope = scope_type;
+        switch (at->current_scope) {
             case CELLULAR_CTRL_AT_SCOPE_TYPE_RESP:
-                _stop_tag = &_resp_stop;
-                _stop_tag->found = false;
+                at->stop_tag = &at->resp_stop;
+                at->stop_tag->found = false;
                 break;
             case CELLULAR_CTRL_AT_SCOPE_TYPE_INFO:
-                _stop_tag = &_info_stop;
-                _stop_tag->found = false;
-                consume_char(' ');
+                at->stop_tag = &at->info_stop;
+                at->stop_tag->found = false;
+                consume_char(at, ' ');
                 break;
             case CELLULAR_CTRL_AT_SCOPE_TYPE_ELEM:
-                _stop_tag = &_elem_stop;
-                _stop_tag->found = false;
+                at->stop_tag = &at->elem_stop;
+                at->stop_tag->found = false;
                 break;
             case CELLULAR_CTRL_AT_SCOPE_TYPE_NOT_SET:
-                _stop_tag = NULL;
+                at->stop_tag = NULL;
                 return;
             default:
                 break;
@@ -593,69 +1353,128 @@ static void set_scope(cellular_ctrl_at_scope_type scope_type)
     }
 }
 
-static cellular_ctrl_at_scope_type get_scope()
+static cellular_ctrl_at_scope_type get_scope(cellular_ctrl_at_client_t *at)
 {
-    return _current_scope;
+    return at->current_scope;
 }
 
 // Consumes to information response stop tag which is CELLULAR_CTRL_AT_CRLF.
 // Sets scope to response.
-static void information_response_stop()
+static void information_response_stop(cellular_ctrl_at_client_t *at)
 {
-    if (cellular_ctrl_at_consume_to_stop_tag()) {
-        set_scope(CELLULAR_CTRL_AT_SCOPE_TYPE_RESP);
+    if (cellular_ctrl_at_client_consume_to_stop_tag(at)) {
+        set_scope(at, CELLULAR_CTRL_AT_SCOPE_TYPE_RESP);
     }
 }
 
 // Consumes to element stop tag. Sets scope to
 // information response.
-static void information_response_element_stop()
+static void information_response_element_stop(cellular_ctrl_at_client_t *at)
 {
-    if (cellular_ctrl_at_consume_to_stop_tag()) {
-        set_scope(CELLULAR_CTRL_AT_SCOPE_TYPE_INFO);
+    if (cellular_ctrl_at_client_consume_to_stop_tag(at)) {
+        set_scope(at, CELLULAR_CTRL_AT_SCOPE_TYPE_INFO);
     }
 }
 
-// Rewinds the receiving buffer and compares it against given str.
-static bool match(const char *str, size_t size)
+// Compares the unread content of the receiving buffer against
+// given str.
+static bool match(cellular_ctrl_at_client_t *at, const char *str, size_t size)
 {
-    rewind_buffer();
-
-    if ((_buf.recv_len - _buf.recv_pos) < size) {
+    if (buf_unread(at) < size) {
         return false;
     }
 
-    if (str &&
-        (cellularPort_memcmp(_buf.recv_buff + _buf.recv_pos, str, size) == 0)) {
+    if (str && buf_compare(at, 0, str, size)) {
         // consume matching part
-        _buf.recv_pos += size;
+        at->buf.recv_pos += size;
         return true;
     }
 
     return false;
 }
 
-// Iterates URCs and checks if they match the receiving
-// buffer content. If URC match sets the scope to information
-// response and after URC's cb returns finishes the information
-// response scope (consumes to CELLULAR_CTRL_AT_CRLF).
-static bool match_urc()
+// Return the entry in at->urc_index for a URC prefix, reading
+// the key either from the given string or, if str is NULL,
+// from the unread content of the receive buffer; the caller
+// must have checked that enough characters are present.
+static size_t urc_index_key(cellular_ctrl_at_client_t *at, const char *str)
 {
-    rewind_buffer();
-    size_t prefix_len = 0;
-    for (cellular_ctrl_at_urc_t *urc = _urcs; urc; urc = urc->next) {
+    uint32_t hash = 0;
+    char c;
+
+    for (size_t i = 0; i < CELLULAR_CTRL_AT_URC_KEY_LENGTH; i++) {
+        if (str != NULL) {
+            c = *(str + i);
+        } else {
+            c = at->buf.recv_buff[(at->buf.recv_pos + i) & CELLULAR_CTRL_AT_BUFF_MASK];
+        }
+        hash = (hash * 31) + (uint8_t) c;
+    }
+
+    return hash & (CELLULAR_CTRL_AT_URC_INDEX_SIZE - 1);
+}
+
+// Return the at->urc_index entry a URC prefix belongs in.
+static size_t urc_index_entry(cellular_ctrl_at_client_t *at,
+                              const char *prefix, size_t prefix_len)
+{
+    if (prefix_len < CELLULAR_CTRL_AT_URC_KEY_LENGTH) {
+        return CELLULAR_CTRL_AT_URC_INDEX_SIZE;
+    }
+
+    return urc_index_key(at, prefix);
+}
+
+// Account for the time a URC handler took, with the
+// stream locked, warning if it was over budget; to keep
+// the log quiet only a new longest time is warned of.
+static void urc_stats_add(cellular_ctrl_at_urc_t *urc,
+                          int32_t duration_ms)
+{
+    bool new_max = (duration_ms > urc->max_ms);
+
+    urc->count++;
+    urc->total_ms += duration_ms;
+    if (new_max) {
+        urc->max_ms = duration_ms;
+    }
+#if CELLULAR_CFG_CTRL_AT_URC_BUDGET_MS > 0
+    if (duration_ms > CELLULAR_CFG_CTRL_AT_URC_BUDGET_MS) {
+        urc->over_budget++;
+        if (new_max) {
+            cellularPortLog("CELLULAR_AT: warning, handler for URC \"%s\""
+                            " took %d ms, budget %d ms.\n", urc->prefix,
+                            duration_ms, CELLULAR_CFG_CTRL_AT_URC_BUDGET_MS);
+        }
+    }
+#endif
+}
+
+// Checks the URCs in one at->urc_index entry against the receiving
+// buffer content.  If URC match sets the scope to information
+// response and after URC's cb returns finishes the information
+// response scope (consumes to CELLULAR_CTRL_AT_CRLF).
+static bool match_urc_entry(cellular_ctrl_at_client_t *at, size_t entry)
+{
+    size_t prefix_len = 0;
+    for (cellular_ctrl_at_urc_t *urc = at->urc_index[entry]; urc;
+         urc = urc->next_in_bucket) {
         prefix_len = urc->prefix_len;
-        if (_buf.recv_len >= prefix_len) {
-            if (match(urc->prefix, prefix_len)) {
-                set_scope(CELLULAR_CTRL_AT_SCOPE_TYPE_INFO);
+        if (buf_unread(at) >= prefix_len) {
+            if (match(at, urc->prefix, prefix_len)) {
+                set_scope(at, CELLULAR_CTRL_AT_SCOPE_TYPE_INFO);
                 int64_t now_ms = cellularPortGetTickTimeMs();
                 if (urc->cb) {
                     urc->cb(urc->cb_param);
                 }
-                information_response_stop();
+                information_response_stop(at);
                 // Add the amount of time spent in the URC
                 // world to the start time
-                _start_time_ms += cellularPortGetTickTimeMs() - now_ms;
+                now_ms = cellularPortGetTickTimeMs() - now_ms;
+                at->start_time_ms += now_ms;
+                at->timing.num_urcs++;
+                at->timing.urc_ms += now_ms;
+                urc_stats_add(urc, (int32_t) now_ms);
 
                 return true;
             }
@@ -664,26 +1483,40 @@ static bool match_urc()
     return false;
 }
 
+// Checks if a URC matches the receiving buffer content, only
+// comparing against the URCs that share its hash and those
+// with short prefixes.
+static bool match_urc(cellular_ctrl_at_client_t *at)
+{
+    if ((buf_unread(at) >= CELLULAR_CTRL_AT_URC_KEY_LENGTH) &&
+        match_urc_entry(at, urc_index_key(at, NULL))) {
+        return true;
+    }
+
+    return match_urc_entry(at, CELLULAR_CTRL_AT_URC_INDEX_SIZE);
+}
+
 // Convert AT error code from CME/CMS ERROR responses
 // to 3GPP error code.
-static void set_3gpp_error(int32_t error,
+static void set_3gpp_error(cellular_ctrl_at_client_t *at,
+                           int32_t error,
                            cellular_ctrl_at_device_error_type_t error_type)
 {
-    if (_last_3gpp_error) { // don't overwrite likely root cause error
+    if (at->last_3gpp_error) { // don't overwrite likely root cause error
         return;
     }
 
     if ((error_type == CELLULAR_CTRL_AT_DEVICE_ERROR_TYPE_CMS) && (error < 128)) {
         // CMS errors 0-127 maps straight to 3GPP errors
-        _last_3gpp_error = error;
+        at->last_3gpp_error = error;
     } else {
         for (size_t i = 0; i < sizeof(_map_3gpp_errors) /
                                sizeof(_map_3gpp_errors[0]); i++) {
             if (_map_3gpp_errors[i][0] == error) {
-                _last_3gpp_error = _map_3gpp_errors[i][1];
-                if (_debug_on) {
+                at->last_3gpp_error = _map_3gpp_errors[i][1];
+                if (at->debug_on) {
                     cellularPortLog("CELLULAR_AT: 3GPP error code %d.\n",
-                                    cellular_ctrl_at_get_3gpp_error());
+                                    cellular_ctrl_at_client_get_3gpp_error(at));
                 }
                 break;
             }
@@ -693,44 +1526,45 @@ static void set_3gpp_error(int32_t error,
 
 // Reads the error code if expected and sets it as
 // last error.
-static void at_error(bool error_code_expected,
+static void at_error(cellular_ctrl_at_client_t *at,
+                     bool error_code_expected,
                      cellular_ctrl_at_device_error_type_t error_type)
 {
     if (error_code_expected &&
         (error_type == CELLULAR_CTRL_AT_DEVICE_ERROR_TYPE_CMS ||
          error_type == CELLULAR_CTRL_AT_DEVICE_ERROR_TYPE_CME)) {
-        set_scope(CELLULAR_CTRL_AT_SCOPE_TYPE_INFO);
-        int32_t error = cellular_ctrl_at_read_int();
+        set_scope(at, CELLULAR_CTRL_AT_SCOPE_TYPE_INFO);
+        int32_t error = cellular_ctrl_at_client_read_int(at);
 
         if (error != -1) {
-            set_3gpp_error(error, error_type);
-            _last_at_error.errCode = error;
-            _last_at_error.errType = error_type;
-            if (_debug_on) {
+            set_3gpp_error(at, error, error_type);
+            at->last_at_error.errCode = error;
+            at->last_at_error.errType = error_type;
+            if (at->debug_on) {
                 cellularPortLog("CELLULAR_AT: AT error code %d.\n", error);
             }
         } else {
-            if (_debug_on) {
+            if (at->debug_on) {
                 cellularPortLog("CELLULAR_AT: ERROR reading failed\n");
             }
         }
     }
 
-    set_error(CELLULAR_CTRL_AT_DEVICE_ERROR);
+    set_error(at, CELLULAR_CTRL_AT_DEVICE_ERROR);
 }
 
 // Checks if any of the error strings are matching the
 // receiving buffer content.
-static bool match_error()
+static bool match_error(cellular_ctrl_at_client_t *at)
 {
-    if (match(CELLULAR_CTRL_AT_CME_ERROR, CELLULAR_CTRL_AT_CME_ERROR_LENGTH)) {
-        at_error(true, CELLULAR_CTRL_AT_DEVICE_ERROR_TYPE_CME);
+    if (match(at, CELLULAR_CTRL_AT_CME_ERROR, CELLULAR_CTRL_AT_CME_ERROR_LENGTH)) {
+        at_error(at, true, CELLULAR_CTRL_AT_DEVICE_ERROR_TYPE_CME);
         return true;
-    } else if (match(CELLULAR_CTRL_AT_CMS_ERROR, CELLULAR_CTRL_AT_CMS_ERROR_LENGTH)) {
-        at_error(true, CELLULAR_CTRL_AT_DEVICE_ERROR_TYPE_CMS);
+    } else if (match(at, CELLULAR_CTRL_AT_CMS_ERROR, CELLULAR_CTRL_AT_CMS_ERROR_LENGTH)) {
+        at_error(at, true, CELLULAR_CTRL_AT_DEVICE_ERROR_TYPE_CMS);
         return true;
-    } else if (match(CELLULAR_CTRL_AT_ERROR_, CELLULAR_CTRL_AT_ERROR_LENGTH)) {
-        at_error(false, CELLULAR_CTRL_AT_DEVICE_ERROR_TYPE_NO_ERROR);
+    } else if (match(at, CELLULAR_CTRL_AT_ERROR_, CELLULAR_CTRL_AT_ERROR_LENGTH)) {
+        at_error(at, false, CELLULAR_CTRL_AT_DEVICE_ERROR_TYPE_NO_ERROR);
         return true;
     }
     return false;
@@ -738,62 +1572,62 @@ static bool match_error()
 
 // Checks if receiving buffer contains OK, ERROR,
 // URC or given prefix.
-static void resp(const char *prefix, bool crLfFirst, bool check_urc)
+static void resp(cellular_ctrl_at_client_t *at,
+                 const char *prefix, bool crLfFirst, bool check_urc)
 {
-    _prefix_matched = false;
-    _urc_matched = false;
-    _error_found = false;
+    at->prefix_matched = false;
+    at->urc_matched = false;
+    at->error_found = false;
 
-    while (cellular_ctrl_at_get_last_error() == CELLULAR_CTRL_AT_SUCCESS) {
+    while (cellular_ctrl_at_client_get_last_error(at) == CELLULAR_CTRL_AT_SUCCESS) {
         if (crLfFirst) {
-            match(CELLULAR_CTRL_AT_CRLF, CELLULAR_CTRL_AT_CRLF_LENGTH);
+            match(at, CELLULAR_CTRL_AT_CRLF, CELLULAR_CTRL_AT_CRLF_LENGTH);
         }
 
-        if (match(CELLULAR_CTRL_AT_OK, CELLULAR_CTRL_AT_OK_LENGTH)) {
-            set_scope(CELLULAR_CTRL_AT_SCOPE_TYPE_RESP);
-            _stop_tag->found = true;
+        if (match(at, CELLULAR_CTRL_AT_OK, CELLULAR_CTRL_AT_OK_LENGTH)) {
+            set_scope(at, CELLULAR_CTRL_AT_SCOPE_TYPE_RESP);
+            at->stop_tag->found = true;
             return;
         }
 
-        if (match_error()) {
-            _error_found = true;
+        if (match_error(at)) {
+            at->error_found = true;
             return;
         }
 
-        if (prefix && match(prefix, cellularPort_strlen(prefix))) {
-            _prefix_matched = true;
+        if (prefix && match(at, prefix, cellularPort_strlen(prefix))) {
+            at->prefix_matched = true;
             return;
         }
 
-        if (check_urc && match_urc()) {
-            _urc_matched = true;
-            cellular_ctrl_at_clear_error();
+        if (check_urc && match_urc(at)) {
+            at->urc_matched = true;
+            cellular_ctrl_at_client_clear_error(at);
             continue;
         }
 
         // If no match found, look for CELLULAR_CTRL_AT_CRLF and consume
         // everything up to and including CELLULAR_CTRL_AT_CRLF
-        if (mem_str(_buf.recv_buff, _buf.recv_len, CELLULAR_CTRL_AT_CRLF,
-                    CELLULAR_CTRL_AT_CRLF_LENGTH)) {
+        if (buf_find(at, CELLULAR_CTRL_AT_CRLF, CELLULAR_CTRL_AT_CRLF_LENGTH)) {
             // If no prefix, return on CELLULAR_CTRL_AT_CRLF - means data to read
             if (!prefix) {
                 return;
             }
-            consume_to_tag(CELLULAR_CTRL_AT_CRLF, true);
+            consume_to_tag(at, CELLULAR_CTRL_AT_CRLF, true);
         } else {
             // If no prefix, no CELLULAR_CTRL_AT_CRLF and no more chance to
             // match for OK, ERROR or URC (since max resp
             // length is already in buffer) return so data
             // could be read
             if (!prefix &&
-                ((_buf.recv_len - _buf.recv_pos) >= _max_resp_length)) {
+                (buf_unread(at) >= at->max_resp_length)) {
                 return;
             }
-            if (!fill_buffer(true)) {
+            if (!fill_buffer(at, true)) {
                 // if we don't get any match and no data
                 // within timeout, set an error to indicate
                 // need for recovery
-                set_error(CELLULAR_CTRL_AT_DEVICE_ERROR);
+                set_error(at, CELLULAR_CTRL_AT_DEVICE_ERROR);
             }
         }
     }
@@ -802,59 +1636,97 @@ static void resp(const char *prefix, bool crLfFirst, bool check_urc)
     // recover and retry
 }
 
-static size_t write(const void *data, size_t len)
+static size_t write(cellular_ctrl_at_client_t *at, const void *data, size_t len)
 {
     size_t write_len = 0;
-    bool print_at_on = _print_at_on;
+    bool print_at_on = at->print_at_on;
+    int64_t start_ms = cellularPortGetTickTimeMs();
 
     for (; write_len < len;) {
-        int32_t ret = cellularPortUartWrite(_uart,
-                                            (const char *) data + write_len,
-                                            len - write_len);
+        int32_t ret = uart_write(at, (const char *) data + write_len,
+                                 len - write_len);
         if (ret < 0) {
-            set_error(CELLULAR_CTRL_AT_DEVICE_ERROR);
-            _print_at_on = print_at_on;
+            set_error(at, CELLULAR_CTRL_AT_DEVICE_ERROR);
+            at->print_at_on = print_at_on;
+            at->timing.tx_ms += cellularPortGetTickTimeMs() - start_ms;
             return 0;
         }
+        trace_at(at, (const char *) data + write_len, ret, true);
+        stats_bytes(at, ret, true);
 #ifdef DEBUG_PRINT_FULL_AT_STRING
-        print_at((const char *) data + write_len, ret);
+        print_at(at, (const char *) data + write_len, ret);
 #else
-        if (_print_at_on && (write_len < CELLULAR_CTRL_AT_DEBUG_MAXLEN)) {
+        if (at->print_at_on && (write_len < CELLULAR_CTRL_AT_DEBUG_MAXLEN)) {
             if (write_len + ret < CELLULAR_CTRL_AT_DEBUG_MAXLEN) {
-                print_at((const char *) data + write_len, ret);
+                print_at(at, (const char *) data + write_len, ret);
             } else {
-                print_at("...", sizeof("..."));
-                _print_at_on = false;
+                print_at(at, "...", sizeof("..."));
+                at->print_at_on = false;
             }
         }
 #endif
         write_len += (size_t) ret;
     }
 
-    _print_at_on = print_at_on;
+    at->print_at_on = print_at_on;
+    at->timing.tx_ms += cellularPortGetTickTimeMs() - start_ms;
 
     return write_len;
 }
 
+// Send whatever has been staged by write_staged().
+static void flush_staged(cellular_ctrl_at_client_t *at)
+{
+    size_t len = at->tx_len;
+
+    if (len > 0) {
+        at->tx_len = 0;
+        (void) write(at, at->tx_buf, len);
+    }
+}
+
+// Add data to the AT command being assembled in tx_buf,
+// sending what has been assembled so far first if there
+// isn't room; data that is larger than tx_buf is written
+// straight out.  Returns len or, if the UART write failed,
+// zero, in which case at->last_error will have been set.
+static size_t write_staged(cellular_ctrl_at_client_t *at,
+                           const void *data, size_t len)
+{
+    if (at->tx_len + len > sizeof(at->tx_buf)) {
+        flush_staged(at);
+        if (len > sizeof(at->tx_buf)) {
+            return write(at, data, len);
+        }
+    }
+    if (at->last_error != CELLULAR_CTRL_AT_SUCCESS) {
+        return 0;
+    }
+    pCellularPort_memcpy(at->tx_buf + at->tx_len, data, len);
+    at->tx_len += len;
+
+    return len;
+}
+
 // Do common checks before sending sub-parameters
-static bool check_cmd_send()
+static bool check_cmd_send(cellular_ctrl_at_client_t *at)
 {
-    if ((_last_error != CELLULAR_CTRL_AT_SUCCESS)) {
+    if ((at->last_error != CELLULAR_CTRL_AT_SUCCESS)) {
         return false;
     }
 
     // Don't write delimiter if flag was set so
-    if (!_use_delimiter) {
+    if (!at->use_delimiter) {
         return true;
     }
 
     // Don't write delimiter if this is the first sub-parameter
-    if (_cmd_start) {
-        _cmd_start = false;
+    if (at->cmd_start) {
+        at->cmd_start = false;
     } else {
-        if (write(&_delimiter, 1) != 1) {
+        if (write_staged(at, &at->delimiter, 1) != 1) {
             // Writing of delimiter failed, return.
-            // write() will already have set _last_error
+            // write() will already have set at->last_error
             return false;
         }
     }
@@ -862,9 +1734,9 @@ static bool check_cmd_send()
     return true;
 }
 
-static bool find_urc_handler(const char *prefix)
+static bool find_urc_handler(cellular_ctrl_at_client_t *at, const char *prefix)
 {
-    cellular_ctrl_at_urc_t *urc = _urcs;
+    cellular_ctrl_at_urc_t *urc = at->urcs;
     while (urc) {
         if (cellularPort_strcmp(prefix, urc->prefix) == 0) {
             return true;
@@ -878,100 +1750,254 @@ static bool find_urc_handler(const char *prefix)
 // Just unlock the UART stream, don't kick off
 // any further data receipt.  This is used in
 // task_urc to avoid recursion.
-static void cellular_ctrl_at_unlock_no_data_check()
-{
-    cellularPortMutexUnlock(_mtx_stream);
-}
-
-// Convert a string which should contain
-// something like "7587387289371387" (and
-// be NULL terminated) into a uint64_t
-// Any leading crap is ignored and conversion
-// stops when a non-numeric character is reached.
-static uint64_t strToUint64(char *buf)
-{
-    uint64_t uint64 = 0;
-    int32_t length;
-    const char *numerals = "0123456789";
-    uint64_t multiplier;
-
-    // Skip things that aren't numerals
-    buf += cellularPort_strcspn(buf, numerals);
-    // Determine the length of the numerals part
-    length = cellularPort_strspn(buf, numerals);
-    while (length > 0) {
-        multiplier = (uint64_t) cellularPort_pow(10, (length - 1));
-        uint64 += (*buf - '0') * multiplier;
-        length--;
-        buf++;
-    }
-
-    return uint64;
-}
-
-// Convert a uint64_t into a string,
-// returning the length of string that
-// would be required even if bufLen were
-// too small (i.e. just like snprintf() would).
-static int32_t uint64ToStr(char *buf, size_t bufLen,
-                           uint64_t uint64)
-{
-    int32_t sizeOrError = -1;
-    int32_t x;
-    // Max value of a uint64_t is
-    // 18,446,744,073,709,551,616,
-    // so maximum divisor is
-    // 10,000,000,00,000,000,000.
-    uint64_t divisor = 10000000000000000000U;
-
-    if (bufLen > 0) {
-        sizeOrError = 0;
-        // Cut the divisor down to size
-        while (uint64 < divisor) {
-            divisor /= 10;
-        }
-        if (divisor == 0) {
-            divisor = 1;
-        }
-
-        // Reduce bufLen by 1 to allow for the terminator
-        bufLen--;
-        // Now write the numerals
-        while (divisor > 0) {
-            x = uint64 / divisor;
-            if (bufLen > 0) {
-                *buf = x + '0';
+static void cellular_ctrl_at_unlock_no_data_check(cellular_ctrl_at_client_t *at)
+{
+    cellularPortMutexUnlock(at->mtx_stream);
+}
+
+// The states of read_number().
+typedef enum {
+    READ_NUMBER_LEADING,  // before the digits
+    READ_NUMBER_SIGN,     // a sign has been read, digits must follow
+    READ_NUMBER_DIGITS,   // in the digits
+    READ_NUMBER_DONE      // the number has ended
+} read_number_state_t;
+
+// Read an integer sub-parameter straight out of the receive
+// buffer, with no intermediate string, consuming up to and
+// including the delimiter or stop tag just as
+// cellular_ctrl_at_read_string() does.  If is_signed is true
+// the number is parsed the way strtol() would parse it, i.e.
+// leading white space and a sign are allowed, else anything
+// that isn't a numeral is skipped until the digits begin.
+// The magnitude saturates at UINT64_MAX.  Returns the number
+// of characters in the sub-parameter, excluding quotes, or -1
+// on error.  The caller must have checked that there is a
+// stop tag.
+static int32_t read_number(cellular_ctrl_at_client_t *at, bool is_signed,
+                           bool *negative, uint64_t *magnitude)
+{
+    read_number_state_t state = READ_NUMBER_LEADING;
+    int32_t len = 0;
+    size_t match_pos = 0;
+    bool in_quotes = false;
+    int32_t c;
+
+    *negative = false;
+    *magnitude = 0;
+    while (true) {
+        c = get_char(at);
+        if (c == -1) {
+            set_error(at, CELLULAR_CTRL_AT_DEVICE_ERROR);
+            return -1;
+        } else if (!in_quotes && (c == at->delimiter)) {
+            break;
+        } else if (c == '\"') {
+            match_pos = 0;
+            in_quotes = !in_quotes;
+            continue;
+        } else if (!in_quotes && at->stop_tag->len &&
+                   (c == at->stop_tag->tag[match_pos])) {
+            match_pos++;
+            if (match_pos == at->stop_tag->len) {
+                at->stop_tag->found = true;
+                // The characters of the tag are not part of
+                // the sub-parameter
+                len -= at->stop_tag->len - 1;
+                break;
+            }
+        } else if (match_pos) {
+            match_pos = 0;
+        }
+        len++;
+
+        // A partly-matched stop tag is never numeric
+        // and so just ends the number
+        if ((c >= '0') && (c <= '9')) {
+            if (state != READ_NUMBER_DONE) {
+                state = READ_NUMBER_DIGITS;
+                if (*magnitude > (UINT64_MAX - (c - '0')) / 10) {
+                    *magnitude = UINT64_MAX;
+                } else {
+                    *magnitude = (*magnitude * 10) + (c - '0');
+                }
+            }
+        } else if (state == READ_NUMBER_LEADING) {
+            if (is_signed) {
+                if ((c == '-') || (c == '+')) {
+                    *negative = (c == '-');
+                    state = READ_NUMBER_SIGN;
+                } else if ((c != ' ') && ((c < '\t') || (c > '\r'))) {
+                    // Not white space either
+                    state = READ_NUMBER_DONE;
+                }
+            }
+        } else {
+            state = READ_NUMBER_DONE;
+        }
+    }
+
+    return len;
+}
+
+// Convert the result of read_number() into an int32_t,
+// saturating as strtol() would.
+static int32_t number_to_int32(bool negative, uint64_t magnitude)
+{
+    if (negative) {
+        if (magnitude > ((uint64_t) INT32_MAX) + 1) {
+            return INT32_MIN;
+        }
+        return (int32_t) (0 - (int64_t) magnitude);
+    }
+    if (magnitude > INT32_MAX) {
+        return INT32_MAX;
+    }
+
+    return (int32_t) magnitude;
+}
+
+// Write the decimal form of a number into buf, which must be
+// at least 21 bytes long, returning the number of characters
+// written; no terminator is added.  This is used in place of
+// sprintf() to keep the C library's formatted I/O, and the
+// stack it needs, out of the AT path.
+static size_t format_number(char *buf, bool negative, uint64_t magnitude)
+{
+    char digits[20];
+    size_t num_digits = 0;
+    size_t len = 0;
+    uint32_t low;
+
+    // Divisions of 64 bit values are done in software on
+    // most of the targets so do as few of them as possible
+    while (magnitude > UINT32_MAX) {
+        digits[num_digits] = (char) ('0' + (magnitude % 10));
+        num_digits++;
+        magnitude /= 10;
+    }
+    low = (uint32_t) magnitude;
+    do {
+        digits[num_digits] = (char) ('0' + (low % 10));
+        num_digits++;
+        low /= 10;
+    } while (low > 0);
+
+    if (negative) {
+        buf[len] = '-';
+        len++;
+    }
+    while (num_digits > 0) {
+        num_digits--;
+        buf[len] = digits[num_digits];
+        len++;
+    }
+
+    return len;
+}
+
+// Lock the UART stream, waking the module up first if it
+// is asleep and wake_up is true.
+static void lock(cellular_ctrl_at_client_t *at, bool wake_up)
+{
+    bool fail_fast;
+
+    if (at->uart >= 0) {
+        cellularPortMutexLock(at->mtx_stream);
+        cellular_ctrl_at_client_clear_error(at);
+        // While the link is being recovered only the
+        // callbacks task, which does the recovering, gets
+        // to talk to the module
+        fail_fast = at->recovering &&
+                    !cellularPortTaskIsThis(at->task_handle_callbacks);
+        if (wake_up && at->asleep && (at->wake_up_callback != NULL) &&
+            !at->direct_link_active && !fail_fast) {
+            // Clear the flag first, the callback will be
+            // sending AT commands of its own
+            at->asleep = false;
+            uart_resume(at);
+            at->wake_up_callback(at->wake_up_callback_param);
+            cellular_ctrl_at_client_clear_error(at);
+        }
+        // No need to worry about overflow here, we're never awake
+        // for long enough
+        at->start_time_ms = cellularPortGetTickTimeMs();
+        if (at->direct_link_active || fail_fast) {
+            // Whatever is sent now would go to the far end
+            // as data, or would only wait for a timeout, so
+            // make everything a no-op
+            set_error(at, CELLULAR_CTRL_AT_DEVICE_ERROR);
+        }
+    }
+}
+
+// Suspend the UART to save power if nothing is waiting to be
+// processed; the module must be asleep.  The UART resumes by
+// itself when the module next sends something or when it is
+// written to.  Platforms that can't suspend a UART just say so.
+// Returns false if it is worth trying again later, i.e. there
+// was something waiting.
+static bool suspend_if_idle(cellular_ctrl_at_client_t *at)
+{
+    int32_t error_code = CELLULAR_PORT_SUCCESS;
+    bool done = true;
+
+    if (at->uart >= 0) {
+        lock(at, false);
+        if (at->asleep && !at->direct_link_active) {
+            done = false;
+            if (buf_unread(at) == 0) {
+                error_code = uart_suspend(at);
+                done = (error_code == 0) ||
+                       (error_code == CELLULAR_PORT_NOT_IMPLEMENTED);
+                if ((error_code == 0) && at->debug_on) {
+                    cellularPortLog("CELLULAR_AT: module asleep, UART suspended.\n");
+                }
             }
-            uint64 -= x * divisor;
-            sizeOrError++;
-            bufLen--;
-            buf++;
-            divisor /= 10;
         }
-        // Add the terminator
-        *buf = '\0';
+        cellular_ctrl_at_unlock_no_data_check(at);
     }
 
-    return sizeOrError;
+    return done;
+}
+
+// Add a stretch of work, begun at start_ms, to the statistics
+// of a task.
+static void task_stats_add(cellular_ctrl_at_task_stats_t *p_stats,
+                           int64_t start_ms)
+{
+    int32_t busy_ms = (int32_t) (cellularPortGetTickTimeMs() - start_ms);
+
+    p_stats->num_runs++;
+    p_stats->busy_ms += busy_ms;
+    if (busy_ms > p_stats->max_busy_ms) {
+        p_stats->max_busy_ms = busy_ms;
+    }
 }
 
 // Task to find urc's from the AT response, triggered through
-// something being written to _queue_uart.
+// something being written to at->queue_uart.  The task blocks on
+// at->queue_uart, with no timeout unless the module has just
+// gone to sleep, and so only runs when there is work to do.
 // If an invalid event (e.g. a negative size) is received, the
-// task will exit in an orderly fashion.
+// task will exit in an orderly fashion; a zero-length event
+// just sends it around again to pick up any change of UART.
 static void task_urc(void *parameters)
 {
+    cellular_ctrl_at_client_t *at = (cellular_ctrl_at_client_t *) parameters;
     int32_t data_size_or_error = 0;
-    cellular_ctrl_at_control_t control = CELLULAR_CTRL_AT_CONTROL_NONE;
-
-    CELLULAR_PORT_MUTEX_LOCK(_mtx_urc_task_running);
+    int32_t receive_size;
+    int32_t uart;
+    CellularPortQueueHandle_t queue;
+    bool idle_done = false;
+    int64_t start_ms;
 
-    (void) parameters;
+    CELLULAR_PORT_MUTEX_LOCK(at->mtx_urc_task_running);
 
     // Pause to let the function that created
     // this task return and fill in the parameter
-    // _task_handle_urc, otherwise the call to
-    // cellularPortTaskIsThis(_task_handle_urc)
+    // at->task_handle_urc, otherwise the call to
+    // cellularPortTaskIsThis(at->task_handle_urc)
     // in fill_buffer() will not work and, should
     // data be arriving from the UART when we
     // start, we'll end up sitting around for
@@ -980,60 +2006,103 @@ static void task_urc(void *parameters)
     // timeout.
     cellularPortTaskBlock(100);
 
-    if (_debug_on) {
+    if (at->debug_on) {
         cellularPortLog("CELLULAR_AT: task_urc() started.\n");
     }
 
-    while (control != CELLULAR_CTRL_AT_CONTROL_TERMINATE) {
-        data_size_or_error = cellularPortUartEventTryReceive(_queue_uart,
-                                                             CELLULAR_CTRL_AT_URC_EVENT_UART_WAIT_MS);
+    while (data_size_or_error >= 0) {
+        // Let cellular_ctrl_at_client_set_uart() know
+        // which queue we're waiting on
+        uart = at->uart;
+        queue = at->queue_uart;
+        at->queue_uart_urc_task = queue;
+        // Wait for UART data or for an invalid event, which
+        // is the signal to exit
+        if (at->asleep && !idle_done) {
+            data_size_or_error = uart_event_try_receive(uart, queue,
+                                                        CELLULAR_CTRL_AT_URC_TASK_WAIT_MS);
+        } else {
+            data_size_or_error = uart_event_receive(uart, queue);
+        }
+        if (data_size_or_error == CELLULAR_PORT_TIMEOUT) {
+            data_size_or_error = 0;
+            // All quiet: if the module is asleep there's
+            // no need to keep the UART running
+            if (at->asleep) {
+                idle_done = suspend_if_idle(at);
+            }
+        } else if ((data_size_or_error > 0) && (queue != at->queue_uart)) {
+            // The AT client has moved on and this event
+            // belongs to the new owner of the old UART
+            uart_event_send(uart, queue, data_size_or_error);
+            data_size_or_error = 0;
+            idle_done = false;
+        } else if (data_size_or_error >= 0) {
+            idle_done = false;
+        }
         if (data_size_or_error > 0) {
 
+            // Whoever has the AT interface may be blocked in
+            // fill_buffer() waiting for the data this event
+            // announces, hand the event back to them
+            if (cellularPortMutexTryLock(at->mtx_stream, 0) == 0) {
+                cellularPortMutexUnlock(at->mtx_stream);
+            } else {
+                uart_event_send(at->uart, at->queue_uart, data_size_or_error);
+            }
+
             // Potential URC data is available, lock the AT
-            // AT interface and process it for URCs
-            cellular_ctrl_at_lock();
-
-            if ((data_size_or_error > 0) || (_buf.recv_pos < _buf.recv_len)) {
-                if (_debug_on) {
-                    cellularPortLog("CELLULAR_AT: possible URC data readable %d,"
-                                    " already buffered %u.\n", data_size_or_error,
-                                    _buf.recv_len - _buf.recv_pos);
+            // AT interface and process it for URCs; data from
+            // the module doesn't need the module to be woken
+            lock(at, false);
+            start_ms = cellularPortGetTickTimeMs();
+
+            // In direct-link mode the data belongs to whoever
+            // is reading the direct link, leave it alone
+            if (!at->direct_link_active &&
+                ((data_size_or_error > 0) || (buf_unread(at) > 0))) {
+                if (at->debug_on) {
+                    cellularPortLogDebug("CELLULAR_AT: possible URC data readable %d,"
+                                         " already buffered %u.\n", data_size_or_error,
+                                         buf_unread(at));
                 }
-                _current_scope = CELLULAR_CTRL_AT_SCOPE_TYPE_NOT_SET;
+                at->current_scope = CELLULAR_CTRL_AT_SCOPE_TYPE_NOT_SET;
                 for (int32_t data_loop_count = 0;
                      data_loop_count < CELLULAR_CTRL_AT_URC_DATA_LOOP_GUARD;
                      data_loop_count++) {
                     // Search through the URCs
-                    if (match_urc()) {
-                        // If there's a match, see if more data is availble
-                        data_size_or_error = cellularPortUartGetReceiveSize(_uart);
-                        if ((data_size_or_error <= 0) &&
-                            (_buf.recv_pos >= _buf.recv_len)) {
+                    if (match_urc(at)) {
+                        // If there's a match, see if more data is availble;
+                        // this must not touch data_size_or_error, only
+                        // a negative event from the queue ends the task
+                        receive_size = uart_get_receive_size(at);
+                        if ((receive_size <= 0) &&
+                            (buf_unread(at) == 0)) {
                             // We have no more data to process, leave this loop
                             break;
                         }
                     // If no match was found, look for CELLULAR_CTRL_AT_CRLF
-                    } else if (mem_str(_buf.recv_buff, _buf.recv_len,
-                                       CELLULAR_CTRL_AT_CRLF, CELLULAR_CTRL_AT_CRLF_LENGTH)) {
+                    } else if (buf_find(at, CELLULAR_CTRL_AT_CRLF,
+                                        CELLULAR_CTRL_AT_CRLF_LENGTH)) {
                         // Consume everything up to the CELLULAR_CTRL_AT_CRLF
-                        consume_to_tag(CELLULAR_CTRL_AT_CRLF, true);
+                        consume_to_tag(at, CELLULAR_CTRL_AT_CRLF, true);
                     } else {
                         // If no match was found and there's no CR/LF to consume up to,
                         // bring in more data and we'll check it again
-                        if (fill_buffer(true)) {
+                        if (fill_buffer(at, true)) {
                             // Start the cycle again as if we'd just done
                             // cellular_ctrl_at_lock()
-                            _start_time_ms = cellularPortGetTickTimeMs();
+                            at->start_time_ms = cellularPortGetTickTimeMs();
                         } else {
                             // There is no more data: consume anything that could not be handled
                             // and leave this loop
-                            reset_buffer();
+                            reset_buffer(at);
                             break;
                         }
                     }
                 }
-                if (_debug_on) {
-                    cellularPortLog("CELLULAR_AT: URC checking done.\n");
+                if (at->debug_on) {
+                    cellularPortLogDebug("CELLULAR_AT: URC checking done.\n");
                 }
             }
 
@@ -1041,18 +2110,15 @@ static void task_urc(void *parameters)
             // checking for more data, which would try
             // to queue stuff on this task and I'm not
             // sure that's safe
-            cellular_ctrl_at_unlock_no_data_check();
+            cellular_ctrl_at_unlock_no_data_check(at);
+            task_stats_add(&at->task_stats[CELLULAR_CTRL_AT_TASK_URC],
+                           start_ms);
         }
-
-        // Check if there's anything for us on the control queue
-        cellularPortQueueTryReceive(_queue_urc_control,
-                                    CELLULAR_CTRL_AT_URC_EVENT_CONTROL_WAIT_MS,
-                                    (void *) &control);
     }
 
-    CELLULAR_PORT_MUTEX_UNLOCK(_mtx_urc_task_running);
+    CELLULAR_PORT_MUTEX_UNLOCK(at->mtx_urc_task_running);
 
-    if (_debug_on) {
+    if (at->debug_on) {
         cellularPortLog("CELLULAR_AT: task_urc() ended.\n");
     }
 
@@ -1068,18 +2134,26 @@ static void dummy(void *param)
     cellularPort_assert(false);
 }
 
+// Function that does nothing, queued to get the callbacks
+// task out of its wait so that it notices a poll function.
+static void kick(void *param)
+{
+    (void) param;
+}
+
 // Task in the context of which call-backs are called.
 // If a callback structure is received with a NULL function
 // pointer then this task exits in an orderly fashion.
 static void task_callbacks(void *parameters)
 {
+    cellular_ctrl_at_client_t *at = (cellular_ctrl_at_client_t *) parameters;
     cellular_ctrl_at_callback_t cb;
+    cellular_ctrl_at_task_stats_t *p_stats = &at->task_stats[CELLULAR_CTRL_AT_TASK_CALLBACKS];
+    int64_t start_ms;
 
-    CELLULAR_PORT_MUTEX_LOCK(_mtx_callbacks_task_running);
+    CELLULAR_PORT_MUTEX_LOCK(at->mtx_callbacks_task_running);
 
-    (void) parameters;
-
-    if (_debug_on) {
+    if (at->debug_on) {
         cellularPortLog("CELLULAR_AT: task_callbacks() started.\n");
     }
 
@@ -1087,16 +2161,35 @@ static void task_callbacks(void *parameters)
     cb.param = NULL;
 
     while (cb.function != NULL) {
-        if (cellularPortQueueReceive(_queue_callbacks, &cb) == 0) {
+        if (at->callbacks_poll != NULL) {
+            // Callbacks come first, the poll function
+            // is only called when there are none
+            if (cellularPortQueueTryReceive(at->queue_callbacks, 0, &cb) == 0) {
+                if (cb.function != NULL) {
+                    start_ms = cellularPortGetTickTimeMs();
+                    cb.function(cb.param);
+                    task_stats_add(p_stats, start_ms);
+                }
+            } else {
+                cb.function = dummy;
+                if (at->callbacks_poll != NULL) {
+                    start_ms = cellularPortGetTickTimeMs();
+                    at->callbacks_poll(at->callbacks_poll_param);
+                    task_stats_add(p_stats, start_ms);
+                }
+            }
+        } else if (cellularPortQueueReceive(at->queue_callbacks, &cb) == 0) {
             if (cb.function != NULL) {
+                start_ms = cellularPortGetTickTimeMs();
                 cb.function(cb.param);
+                task_stats_add(p_stats, start_ms);
             }
         }
     }
 
-    CELLULAR_PORT_MUTEX_UNLOCK(_mtx_callbacks_task_running);
+    CELLULAR_PORT_MUTEX_UNLOCK(at->mtx_callbacks_task_running);
 
-    if (_debug_on) {
+    if (at->debug_on) {
         cellularPortLog("CELLULAR_AT: task_callbacks() ended.\n");
     }
 
@@ -1109,12 +2202,11 @@ static void task_callbacks(void *parameters)
  * -------------------------------------------------------------- */
 
 // Initialise the AT client.
-cellular_ctrl_at_error_code_t cellular_ctrl_at_init(int32_t uart,
-                                                    CellularPortQueueHandle_t queue_uart)
+cellular_ctrl_at_error_code_t cellular_ctrl_at_client_init(cellular_ctrl_at_client_t *at,
+                                                           int32_t uart,
+                                                           CellularPortQueueHandle_t queue_uart)
 {
-    cellular_ctrl_at_control_t ctrl = CELLULAR_CTRL_AT_CONTROL_TERMINATE;
-
-    if (_uart >= 0) {
+    if (at->uart >= 0) {
         return CELLULAR_CTRL_AT_SUCCESS;
     }
 
@@ -1122,90 +2214,112 @@ cellular_ctrl_at_error_code_t cellular_ctrl_at_init(int32_t uart,
         return CELLULAR_CTRL_AT_INVALID_PARAMETER;
     }
 
-    _queue_uart = queue_uart;
-    _at_timeout_ms = CELLULAR_CTRL_AT_COMMAND_DEFAULT_TIMEOUT_MS;
-    _at_timeout_callback = NULL;
-    _at_num_consecutive_timeouts = 0;
-    _at_send_delay_ms = CELLULAR_CTRL_AT_SEND_DELAY,
-    _last_error = CELLULAR_CTRL_AT_SUCCESS;
-    _last_3gpp_error = 0;
-    _urc_string_max_length = 0;
-    _urcs = NULL;
-    _previous_at_timeout = _at_timeout_ms;
-    _last_response_stop_ms = 0;
-    _stop_tag = NULL;
-    _delimiter = CELLULAR_CTRL_AT_DEFAULT_DELIMITER;
-    _prefix_matched = false;
-    _urc_matched = false;
-    _error_found = false;
-    _max_resp_length = CELLULAR_CTRL_AT_MAX_RESP_LENGTH;
-    _debug_on = false;
-    _print_at_on = true;
-    _cmd_start = false;
-    _use_delimiter = true;
-    _start_time_ms = 0;
-    cellular_ctrl_at_clear_error();
+    at->queue_uart = queue_uart;
+    at->queue_uart_urc_task = NULL;
+    at->at_timeout_ms = CELLULAR_CTRL_AT_COMMAND_DEFAULT_TIMEOUT_MS;
+    at->at_timeout_callback = NULL;
+    at->at_num_consecutive_timeouts = 0;
+    at->at_send_delay_ms = CELLULAR_CTRL_AT_SEND_DELAY;
+    at->at_send_delay_min_ms[CELLULAR_CTRL_AT_SEND_DELAY_CLASS_CONFIG] = CELLULAR_CFG_CTRL_AT_SEND_DELAY_MIN_MS;
+    at->at_send_delay_min_ms[CELLULAR_CTRL_AT_SEND_DELAY_CLASS_DATA] = CELLULAR_CFG_CTRL_AT_SEND_DELAY_DATA_MIN_MS;
+    send_delay_reset(at);
+    at->send_delay_class_next = CELLULAR_CTRL_AT_SEND_DELAY_CLASS_CONFIG;
+    at->send_delay_class = CELLULAR_CTRL_AT_SEND_DELAY_CLASS_CONFIG;
+    at->last_error = CELLULAR_CTRL_AT_SUCCESS;
+    at->last_3gpp_error = 0;
+    at->urc_string_max_length = 0;
+    at->urcs = NULL;
+    pCellularPort_memset(at->urc_index, 0, sizeof(at->urc_index));
+    at->previous_at_timeout = at->at_timeout_ms;
+    at->last_response_stop_ms = 0;
+    at->cmd_start_ms = 0;
+    pCellularPort_memset(&at->timing, 0, sizeof(at->timing));
+    pCellularPort_memset(at->task_stats, 0, sizeof(at->task_stats));
+#if CELLULAR_CFG_CTRL_AT_STATS_NUM_COMMANDS > 0
+    pCellularPort_memset(at->stats, 0, sizeof(at->stats));
+    at->stats_current = NULL;
+#endif
+    at->stop_tag = NULL;
+    at->delimiter = CELLULAR_CTRL_AT_DEFAULT_DELIMITER;
+    at->prefix_matched = false;
+    at->urc_matched = false;
+    at->error_found = false;
+    at->max_resp_length = CELLULAR_CTRL_AT_MAX_RESP_LENGTH;
+    at->debug_on = false;
+    at->capture_on = false;
+#if CELLULAR_CFG_CTRL_AT_TRACE_NUM_RECORDS > 0
+    at->print_at_on = false;
+    at->trace_count = 0;
+    at->trace_new_record = true;
+#else
+    at->print_at_on = true;
+#endif
+    at->cmd_start = false;
+    at->use_delimiter = true;
+    at->start_time_ms = 0;
+    cellular_ctrl_at_client_clear_error(at);
 
     // Set up the buffer and it's protection markers
-    reset_buffer();
-    pCellularPort_memset(_buf.recv_buff, 0, sizeof(_buf.recv_buff));
-    pCellularPort_memcpy(_buf.mk0, CELLULAR_CTRL_AT_MARKER,
+    reset_buffer(at);
+    pCellularPort_memset(at->buf.recv_buff, 0, sizeof(at->buf.recv_buff));
+    pCellularPort_memcpy(at->buf.mk0, CELLULAR_CTRL_AT_MARKER,
                          CELLULAR_CTRL_AT_MARKER_SIZE);
-    pCellularPort_memcpy(_buf.mk1, CELLULAR_CTRL_AT_MARKER,
+    pCellularPort_memcpy(at->buf.mk1, CELLULAR_CTRL_AT_MARKER,
                          CELLULAR_CTRL_AT_MARKER_SIZE);
-    pCellularPort_memset(_info_resp_prefix, 0, sizeof(_info_resp_prefix));
+    pCellularPort_memset(at->info_resp_prefix, 0, sizeof(at->info_resp_prefix));
 
-    _current_scope = CELLULAR_CTRL_AT_SCOPE_TYPE_NOT_SET;
-    set_tag(&_resp_stop, CELLULAR_CTRL_AT_OK);
-    set_tag(&_info_stop, CELLULAR_CTRL_AT_CRLF);
-    set_tag(&_elem_stop, ")");
+    at->current_scope = CELLULAR_CTRL_AT_SCOPE_TYPE_NOT_SET;
+    set_tag(at, &at->resp_stop, CELLULAR_CTRL_AT_OK);
+    set_tag(at, &at->info_stop, CELLULAR_CTRL_AT_CRLF);
+    set_tag(at, &at->elem_stop, ")");
 
     // Mutex protections for the data stream and the tasks
-    if (cellularPortMutexCreate(&_mtx_stream) != 0) {
+    if (cellularPortMutexCreate(&at->mtx_stream) != 0) {
         return CELLULAR_CTRL_AT_OUT_OF_MEMORY;
     }
-    if (cellularPortMutexCreate(&_mtx_urc_task_running) != 0) {
-        cellularPortMutexDelete(_mtx_stream);
+    if (cellularPortMutexCreate(&at->mtx_urc_task_running) != 0) {
+        cellularPortMutexDelete(at->mtx_stream);
         return CELLULAR_CTRL_AT_OUT_OF_MEMORY;
     }
-    if (cellularPortMutexCreate(&_mtx_callbacks_task_running) != 0) {
-        cellularPortMutexDelete(_mtx_stream);
-        cellularPortMutexDelete(_mtx_urc_task_running);
+    if (cellularPortMutexCreate(&at->mtx_callbacks_task_running) != 0) {
+        cellularPortMutexDelete(at->mtx_stream);
+        cellularPortMutexDelete(at->mtx_urc_task_running);
         return CELLULAR_CTRL_AT_OUT_OF_MEMORY;
     }
-
-    // Start a queue to feed the callbacks task
-    if (cellularPortQueueCreate(CELLULAR_CTRL_AT_CALLBACK_QUEUE_LENGTH,
-                                sizeof(cellular_ctrl_at_callback_t),
-                                &_queue_callbacks) != 0) {
-        cellularPortMutexDelete(_mtx_stream);
-        cellularPortMutexDelete(_mtx_urc_task_running);
-        cellularPortMutexDelete(_mtx_callbacks_task_running);
+    if (cellularPortMutexCreate(&at->mtx_callbacks) != 0) {
+        cellularPortMutexDelete(at->mtx_stream);
+        cellularPortMutexDelete(at->mtx_urc_task_running);
+        cellularPortMutexDelete(at->mtx_callbacks_task_running);
         return CELLULAR_CTRL_AT_OUT_OF_MEMORY;
     }
-
-    // Start a queue to control the URC task
-    if (cellularPortQueueCreate(CELLULAR_CTRL_AT_URC_CONTROL_QUEUE_LENGTH,
-                                sizeof(cellular_ctrl_at_control_t),
-                                &_queue_urc_control) != 0) {
-        cellularPortMutexDelete(_mtx_stream);
-        cellularPortMutexDelete(_mtx_urc_task_running);
-        cellularPortMutexDelete(_mtx_callbacks_task_running);
-        cellularPortQueueDelete(_queue_callbacks);
+    pCellularPort_memset(at->callbacks, 0, sizeof(at->callbacks));
+    pCellularPort_memset(&at->callback_stats, 0, sizeof(at->callback_stats));
+
+    // Start a queue to feed the callbacks task: room for one
+    // entry for every callback that may be waiting plus the
+    // kick and exit messages
+    if (cellularPortQueueCreate((CELLULAR_CTRL_AT_CALLBACK_QUEUE_LENGTH *
+                                 CELLULAR_CTRL_AT_CALLBACK_NUM_PRIORITIES) + 2,
+                                sizeof(cellular_ctrl_at_callback_t),
+                                &at->queue_callbacks) != 0) {
+        cellularPortMutexDelete(at->mtx_stream);
+        cellularPortMutexDelete(at->mtx_urc_task_running);
+        cellularPortMutexDelete(at->mtx_callbacks_task_running);
+        cellularPortMutexDelete(at->mtx_callbacks);
         return CELLULAR_CTRL_AT_OUT_OF_MEMORY;
     }
 
     // Start a task to handle out of band responses
     if (cellularPortTaskCreate(task_urc, "at_task_urc",
                                CELLULAR_CTRL_AT_TASK_URC_STACK_SIZE_BYTES,
-                               NULL,
+                               at,
                                CELLULAR_CTRL_AT_TASK_URC_PRIORITY,
-                               &_task_handle_urc) != 0) {
-        cellularPortMutexDelete(_mtx_stream);
-        cellularPortMutexDelete(_mtx_urc_task_running);
-        cellularPortMutexDelete(_mtx_callbacks_task_running);
-        cellularPortQueueDelete(_queue_callbacks);
-        cellularPortQueueDelete(_queue_urc_control);
+                               &at->task_handle_urc) != 0) {
+        cellularPortMutexDelete(at->mtx_stream);
+        cellularPortMutexDelete(at->mtx_urc_task_running);
+        cellularPortMutexDelete(at->mtx_callbacks_task_running);
+        cellularPortMutexDelete(at->mtx_callbacks);
+        cellularPortQueueDelete(at->queue_callbacks);
         return CELLULAR_CTRL_AT_OUT_OF_MEMORY;
     }
 
@@ -1217,18 +2331,18 @@ cellular_ctrl_at_error_code_t cellular_ctrl_at_init(int32_t uart,
     // Start a task to run callbacks
     if (cellularPortTaskCreate(task_callbacks, "at_callbacks",
                                CELLULAR_CTRL_TASK_CALLBACK_STACK_SIZE_BYTES,
-                               NULL,
+                               at,
                                CELLULAR_CTRL_TASK_CALLBACK_PRIORITY,
-                               &_task_handle_callbacks) != 0) {
+                               &at->task_handle_callbacks) != 0) {
         // Get urc task to exit
-        cellularPortQueueSend(_queue_urc_control, (void *) &ctrl);
-        CELLULAR_PORT_MUTEX_LOCK(_mtx_urc_task_running);
-        CELLULAR_PORT_MUTEX_UNLOCK(_mtx_urc_task_running);
-        cellularPortMutexDelete(_mtx_stream);
-        cellularPortMutexDelete(_mtx_urc_task_running);
-        cellularPortMutexDelete(_mtx_callbacks_task_running);
-        cellularPortQueueDelete(_queue_callbacks);
-        cellularPortQueueDelete(_queue_urc_control);
+        uart_event_send(uart, at->queue_uart, -1);
+        CELLULAR_PORT_MUTEX_LOCK(at->mtx_urc_task_running);
+        CELLULAR_PORT_MUTEX_UNLOCK(at->mtx_urc_task_running);
+        cellularPortMutexDelete(at->mtx_stream);
+        cellularPortMutexDelete(at->mtx_urc_task_running);
+        cellularPortMutexDelete(at->mtx_callbacks_task_running);
+        cellularPortMutexDelete(at->mtx_callbacks);
+        cellularPortQueueDelete(at->queue_callbacks);
         // Pause here to allow the task deletion that was
         // requested above to actually occur in the idle thread,
         // required by some RTOSs (e.g. FreeRTOS)
@@ -1241,100 +2355,194 @@ cellular_ctrl_at_error_code_t cellular_ctrl_at_init(int32_t uart,
     // required by some RTOSs (e.g. FreeRTOS)
     cellularPortTaskBlock(100);
 
-    // Set _uart now that all is good
-    _uart = uart;
+    // Set at->uart now that all is good
+    at->uart = uart;
+
+    return CELLULAR_CTRL_AT_SUCCESS;
+}
+
+// Move the AT client to a different UART.
+cellular_ctrl_at_error_code_t cellular_ctrl_at_client_set_uart(cellular_ctrl_at_client_t *at,
+                                                               int32_t uart,
+                                                               CellularPortQueueHandle_t queue_uart)
+{
+    int32_t old_uart = at->uart;
+    CellularPortQueueHandle_t old_queue_uart = at->queue_uart;
+
+    if (at->uart < 0) {
+        return CELLULAR_CTRL_AT_NOT_INITIALISED;
+    }
+
+    if ((uart < 0) || (queue_uart == NULL)) {
+        return CELLULAR_CTRL_AT_INVALID_PARAMETER;
+    }
+
+    if ((uart != old_uart) || (queue_uart != old_queue_uart)) {
+        reset_buffer(at);
+        at->queue_uart = queue_uart;
+        at->uart = uart;
+        // The URC task may be blocked on the old queue:
+        // a zero-length event sends it round its loop
+        // and on to the new one; someone else may take
+        // the event, so keep at it until the URC task
+        // is seen to have moved
+        uart_event_send(old_uart, old_queue_uart, 0);
+        for (size_t x = 0; (at->queue_uart_urc_task == old_queue_uart) &&
+                           (x < CELLULAR_CTRL_AT_URC_TASK_MOVE_TRIES); x++) {
+            cellularPortTaskBlock(CELLULAR_CTRL_AT_URC_TASK_MOVE_WAIT_MS);
+            if (at->queue_uart_urc_task == old_queue_uart) {
+                uart_event_send(old_uart, old_queue_uart, 0);
+            }
+        }
+        if (at->debug_on) {
+            cellularPortLog("CELLULAR_AT: now using UART %d.\n", uart);
+        }
+    }
 
     return CELLULAR_CTRL_AT_SUCCESS;
 }
 
 // Deinitialise the AT client.
-void cellular_ctrl_at_deinit()
+void cellular_ctrl_at_client_deinit(cellular_ctrl_at_client_t *at)
 {
     cellular_ctrl_at_callback_t cb;
-    cellular_ctrl_at_control_t ctrl = CELLULAR_CTRL_AT_CONTROL_TERMINATE;
 
-    if (_uart >= 0) {
+    if (at->uart >= 0) {
         // The caller needs to make sure that no read/write
         // is in progress when this function is called.
+        at->direct_link_active = false;
+        at->asleep = false;
+        at->recovering = false;
+        at->wake_up_callback = NULL;
+        at->callbacks_poll = NULL;
 
         // Get urc task to exit
-        cellularPortQueueSend(_queue_urc_control, (void *) &ctrl);
-        CELLULAR_PORT_MUTEX_LOCK(_mtx_urc_task_running);
-        CELLULAR_PORT_MUTEX_UNLOCK(_mtx_urc_task_running);
+        uart_event_send(at->uart, at->queue_uart, -1);
+        CELLULAR_PORT_MUTEX_LOCK(at->mtx_urc_task_running);
+        CELLULAR_PORT_MUTEX_UNLOCK(at->mtx_urc_task_running);
 
         // Get callbacks task to exit
         cb.function = NULL;
         cb.param = NULL;
-        cellularPortQueueSend(_queue_callbacks, (void *) &cb);
-        CELLULAR_PORT_MUTEX_LOCK(_mtx_callbacks_task_running);
-        CELLULAR_PORT_MUTEX_UNLOCK(_mtx_callbacks_task_running);
+        cellularPortQueueSend(at->queue_callbacks, (void *) &cb);
+        CELLULAR_PORT_MUTEX_LOCK(at->mtx_callbacks_task_running);
+        CELLULAR_PORT_MUTEX_UNLOCK(at->mtx_callbacks_task_running);
 
          // Free memory
-        while (_urcs) {
-            cellular_ctrl_at_urc_t *urc = _urcs;
-            _urcs = urc->next;
+        while (at->urcs) {
+            cellular_ctrl_at_urc_t *urc = at->urcs;
+            at->urcs = urc->next;
             cellularPort_free(urc);
         }
+        pCellularPort_memset(at->urc_index, 0, sizeof(at->urc_index));
 
         // Tidy up
-        cellularPortMutexDelete(_mtx_stream);
-        cellularPortMutexDelete(_mtx_urc_task_running);
-        cellularPortMutexDelete(_mtx_callbacks_task_running);
-        cellularPortQueueDelete(_queue_callbacks);
-        cellularPortQueueDelete(_queue_urc_control);
-        cellularPort_assert(CELLULAR_CTRL_AT_GUARD_CHECK(_buf));
+        cellularPortMutexDelete(at->mtx_stream);
+        cellularPortMutexDelete(at->mtx_urc_task_running);
+        cellularPortMutexDelete(at->mtx_callbacks_task_running);
+        cellularPortMutexDelete(at->mtx_callbacks);
+        cellularPortQueueDelete(at->queue_callbacks);
+        cellularPort_assert(CELLULAR_CTRL_AT_GUARD_CHECK(at->buf));
 
         // Pause here to allow the tidy-up to occur in the idle thread,
         // required by some RTOSs (e.g. FreeRTOS).
         cellularPortTaskBlock(100);
 
-        _uart = -1;
+        at->uart = -1;
     }
 }
 
-bool cellular_ctrl_at_debug_get()
+// Create an AT client.
+cellular_ctrl_at_client_t *cellular_ctrl_at_client_create(int32_t uart,
+                                                          CellularPortQueueHandle_t queue_uart)
 {
-    return _debug_on;
+    cellular_ctrl_at_client_t *at;
+
+    at = (cellular_ctrl_at_client_t *) pCellularPort_mallocTag(sizeof(*at),
+                                                               CELLULAR_PORT_MALLOC_TAG_AT);
+    if (at != NULL) {
+        pCellularPort_memset(at, 0, sizeof(*at));
+        at->uart = -1;
+        if (cellular_ctrl_at_client_init(at, uart,
+                                         queue_uart) != CELLULAR_CTRL_AT_SUCCESS) {
+            cellularPort_free(at);
+            at = NULL;
+        }
+    }
+
+    return at;
 }
 
-void cellular_ctrl_at_debug_set(bool onNotOff)
+// Destroy an AT client.
+void cellular_ctrl_at_client_destroy(cellular_ctrl_at_client_t *at)
 {
-    _debug_on = onNotOff;
+    if ((at != NULL) && (at != &_client_default)) {
+        cellular_ctrl_at_client_deinit(at);
+        cellularPort_free(at);
+    }
 }
 
-bool cellular_ctrl_at_print_at_get()
+// Get the default AT client.
+cellular_ctrl_at_client_t *cellular_ctrl_at_client_default()
 {
-    return _print_at_on;
+    return &_client_default;
 }
 
-void cellular_ctrl_at_print_at_set(bool onNotOff)
+bool cellular_ctrl_at_client_debug_get(cellular_ctrl_at_client_t *at)
 {
-    _print_at_on = onNotOff;
+    return at->debug_on;
 }
 
-cellular_ctrl_at_error_code_t cellular_ctrl_at_set_urc_handler(const char *prefix,
-                                                               void (callback) (void *),
-                                                               void *callback_param)
+void cellular_ctrl_at_client_debug_set(cellular_ctrl_at_client_t *at, bool onNotOff)
+{
+    at->debug_on = onNotOff;
+}
+
+bool cellular_ctrl_at_client_print_at_get(cellular_ctrl_at_client_t *at)
+{
+    return at->print_at_on;
+}
+
+void cellular_ctrl_at_client_print_at_set(cellular_ctrl_at_client_t *at, bool onNotOff)
+{
+    at->print_at_on = onNotOff;
+}
+
+bool cellular_ctrl_at_client_capture_get(cellular_ctrl_at_client_t *at)
+{
+    return at->capture_on;
+}
+
+void cellular_ctrl_at_client_capture_set(cellular_ctrl_at_client_t *at, bool onNotOff)
 {
-    if (_uart < 0) {
+    at->capture_on = onNotOff;
+}
+
+cellular_ctrl_at_error_code_t cellular_ctrl_at_client_set_urc_handler(cellular_ctrl_at_client_t *at,
+                                                                      const char *prefix,
+                                                                      void (callback) (void *),
+                                                                      void *callback_param)
+{
+    if (at->uart < 0) {
         return  CELLULAR_CTRL_AT_NOT_INITIALISED;
     } else {
-        if (find_urc_handler(prefix)) {
-            if (_debug_on) {
+        if (find_urc_handler(at, prefix)) {
+            if (at->debug_on) {
                 cellularPortLog("CELLULAR_AT: URC already added with prefix \"%s\".\n", prefix);
             }
             return CELLULAR_CTRL_AT_SUCCESS;
         }
 
-        cellular_ctrl_at_urc_t *urc = (cellular_ctrl_at_urc_t *) pCellularPort_malloc(sizeof(cellular_ctrl_at_urc_t));
+        cellular_ctrl_at_urc_t *urc = (cellular_ctrl_at_urc_t *) pCellularPort_mallocTag(sizeof(cellular_ctrl_at_urc_t),
+                                                                                         CELLULAR_PORT_MALLOC_TAG_AT);
         if (!urc) {
             return CELLULAR_CTRL_AT_OUT_OF_MEMORY;
         } else {
             size_t prefix_len = cellularPort_strlen(prefix);
-            if (prefix_len > _urc_string_max_length) {
-                _urc_string_max_length = prefix_len;
-                if (_urc_string_max_length > _max_resp_length) {
-                    _max_resp_length = _urc_string_max_length;
+            if (prefix_len > at->urc_string_max_length) {
+                at->urc_string_max_length = prefix_len;
+                if (at->urc_string_max_length > at->max_resp_length) {
+                    at->max_resp_length = at->urc_string_max_length;
                 }
             }
 
@@ -1342,27 +2550,51 @@ cellular_ctrl_at_error_code_t cellular_ctrl_at_set_urc_handler(const char *prefi
             urc->prefix_len = prefix_len;
             urc->cb = callback;
             urc->cb_param = callback_param;
-            urc->next = _urcs;
-            _urcs = urc;
+            urc->count = 0;
+            urc->total_ms = 0;
+            urc->max_ms = 0;
+            urc->over_budget = 0;
+            urc->next = at->urcs;
+            at->urcs = urc;
+            // Add it to the index also, ahead of any
+            // shorter prefixes so that, where one prefix
+            // begins with another, the longer one wins
+            size_t entry = urc_index_entry(at, prefix, prefix_len);
+            cellular_ctrl_at_urc_t **ppBucket = &(at->urc_index[entry]);
+            while ((*ppBucket != NULL) &&
+                   ((*ppBucket)->prefix_len > prefix_len)) {
+                ppBucket = &((*ppBucket)->next_in_bucket);
+            }
+            urc->next_in_bucket = *ppBucket;
+            *ppBucket = urc;
         }
     }
 
     return CELLULAR_CTRL_AT_SUCCESS;
 }
 
-void cellular_ctrl_at_remove_urc_handler(const char *prefix)
+void cellular_ctrl_at_client_remove_urc_handler(cellular_ctrl_at_client_t *at,
+                                                const char *prefix)
 {
-    cellular_ctrl_at_urc_t *current = _urcs;
+    cellular_ctrl_at_urc_t *current = at->urcs;
     cellular_ctrl_at_urc_t *prev = NULL;
+    cellular_ctrl_at_urc_t **ppBucket;
 
-    if (_uart >= 0) {
+    if (at->uart >= 0) {
         while (current) {
             if (cellularPort_strcmp(prefix, current->prefix) == 0) {
                 if (prev) {
                     prev->next = current->next;
                 } else {
-                    _urcs = current->next;
+                    at->urcs = current->next;
+                }
+                // Remove it from the index also
+                ppBucket = &(at->urc_index[urc_index_entry(at, current->prefix,
+                                                           current->prefix_len)]);
+                while (*ppBucket != current) {
+                    ppBucket = &((*ppBucket)->next_in_bucket);
                 }
+                *ppBucket = current->next_in_bucket;
                 cellularPort_free(current);
                 break;
             }
@@ -1373,163 +2605,331 @@ void cellular_ctrl_at_remove_urc_handler(const char *prefix)
 }
 
 // Make a callback resulting from a URC
-bool cellular_ctrl_at_callback(void (callback)(void *),
-                                   void *callback_param)
+bool cellular_ctrl_at_client_callback(cellular_ctrl_at_client_t *at,
+                                      void (callback)(void *),
+                                          void *callback_param)
 {
-    cellular_ctrl_at_callback_t cb;
+    return cellular_ctrl_at_client_callback_priority(at, callback, callback_param,
+                                                     CELLULAR_CTRL_AT_CALLBACK_PRIORITY_NORMAL,
+                                                     false);
+}
+
+// Make a callback at a given priority.
+bool cellular_ctrl_at_client_callback_priority(cellular_ctrl_at_client_t *at,
+                                               void (callback)(void *),
+                                               void *callback_param,
+                                               cellular_ctrl_at_callback_priority_t priority,
+                                               bool coalesce)
+{
+    bool success = false;
 
-    cb.function = callback;
-    cb.param = callback_param;
+    if ((at->uart >= 0) && (callback != NULL)) {
+        success = callback_post(at, callback, callback_param,
+                                NULL, 0, priority, coalesce);
+    }
 
-    return cellularPortQueueSend(_queue_callbacks, &cb) == 0;
+    return success;
 }
 
-// Lock the UART stream.
-void cellular_ctrl_at_lock()
+// Make a callback at a given priority with a copy of some data.
+bool cellular_ctrl_at_client_callback_data(cellular_ctrl_at_client_t *at,
+                                           void (callback)(void *),
+                                           const void *p_data, size_t data_len,
+                                           cellular_ctrl_at_callback_priority_t priority,
+                                           bool coalesce)
 {
-    if (_uart >= 0) {
-        cellularPortMutexLock(_mtx_stream);
-        cellular_ctrl_at_clear_error();
-        // No need to worry about overflow here, we're never awake
-        // for long enough
-        _start_time_ms = cellularPortGetTickTimeMs();
+    bool success = false;
+
+    if ((at->uart >= 0) && (callback != NULL) &&
+        ((p_data != NULL) || (data_len == 0)) &&
+        (data_len <= CELLULAR_CTRL_AT_CALLBACK_DATA_MAX_LENGTH_BYTES)) {
+        // A non-NULL pointer marks this as a data callback
+        // even if there is no data
+        if (p_data == NULL) {
+            p_data = at;
+        }
+        success = callback_post(at, callback, NULL, p_data, data_len,
+                                priority, coalesce);
+    }
+
+    return success;
+}
+
+// Get the callback statistics.
+void cellular_ctrl_at_client_callback_stats_get(cellular_ctrl_at_client_t *at,
+                                                cellular_ctrl_at_callback_stats_t *p_stats)
+{
+    if ((at->uart >= 0) && (p_stats != NULL)) {
+        CELLULAR_PORT_MUTEX_LOCK(at->mtx_callbacks);
+        *p_stats = at->callback_stats;
+        CELLULAR_PORT_MUTEX_UNLOCK(at->mtx_callbacks);
+    }
+}
+
+// Reset the callback statistics.
+void cellular_ctrl_at_client_callback_stats_reset(cellular_ctrl_at_client_t *at)
+{
+    if (at->uart >= 0) {
+        CELLULAR_PORT_MUTEX_LOCK(at->mtx_callbacks);
+        pCellularPort_memset(&at->callback_stats, 0, sizeof(at->callback_stats));
+        CELLULAR_PORT_MUTEX_UNLOCK(at->mtx_callbacks);
     }
 }
 
+// Lock the UART stream.
+void cellular_ctrl_at_client_lock(cellular_ctrl_at_client_t *at)
+{
+    lock(at, true);
+}
+
 // Unlock the UART stream and kick off a receive
 // if one was lounging around.
-void cellular_ctrl_at_unlock()
+void cellular_ctrl_at_client_unlock(cellular_ctrl_at_client_t *at)
 {
     int32_t sizeBytes = 0;
 
-    if (_uart >= 0) {
-        cellular_ctrl_at_unlock_no_data_check();
-        sizeBytes = cellularPortUartGetReceiveSize(_uart);
-        if ((sizeBytes > 0) ||
-            (_buf.recv_pos < _buf.recv_len)) {
-            cellularPortUartEventSend(_queue_uart, sizeBytes);
+    if (at->uart >= 0) {
+        cellular_ctrl_at_unlock_no_data_check(at);
+        sizeBytes = uart_get_receive_size(at);
+        if ((sizeBytes > 0) || (buf_unread(at) > 0)) {
+            uart_event_send(at->uart, at->queue_uart, sizeBytes);
         }
-        cellularPort_assert(CELLULAR_CTRL_AT_GUARD_CHECK(_buf));
+        cellularPort_assert(CELLULAR_CTRL_AT_GUARD_CHECK(at->buf));
     }
 }
 
 // Unlock the UART stream and return the last error.
-cellular_ctrl_at_error_code_t cellular_ctrl_at_unlock_return_error()
+cellular_ctrl_at_error_code_t cellular_ctrl_at_client_unlock_return_error(cellular_ctrl_at_client_t *at)
 {
-    cellular_ctrl_at_error_code_t error = _last_error;
-    cellular_ctrl_at_unlock();
+    cellular_ctrl_at_error_code_t error = at->last_error;
+    cellular_ctrl_at_client_unlock(at);
     return error;
 }
 
-void cellular_ctrl_at_set_at_timeout(uint32_t timeout_milliseconds,
-                                     bool default_timeout)
+void cellular_ctrl_at_client_set_at_timeout(cellular_ctrl_at_client_t *at,
+                                            uint32_t timeout_milliseconds,
+                                            bool default_timeout)
 {
-    if (_uart >= 0) {
+    if (at->uart >= 0) {
         if (default_timeout) {
-            _previous_at_timeout = timeout_milliseconds;
-            _at_timeout_ms = timeout_milliseconds;
-        } else if (timeout_milliseconds != _at_timeout_ms) {
-            _previous_at_timeout = _at_timeout_ms;
-            _at_timeout_ms = timeout_milliseconds;
+            at->previous_at_timeout = timeout_milliseconds;
+            at->at_timeout_ms = timeout_milliseconds;
+        } else if (timeout_milliseconds != at->at_timeout_ms) {
+            at->previous_at_timeout = at->at_timeout_ms;
+            at->at_timeout_ms = timeout_milliseconds;
         }
     }
 }
 
-void cellular_ctrl_at_set_at_timeout_callback(void (callback)(void *))
+void cellular_ctrl_at_client_set_at_timeout_callback(cellular_ctrl_at_client_t *at,
+                                                     void (callback)(void *))
 {
-    if (_uart >= 0) {
-        _at_timeout_callback = callback;
+    if (at->uart >= 0) {
+        at->at_timeout_callback = callback;
     }
 }
 
-
-void cellular_ctrl_at_restore_at_timeout()
+// Set the callback that wakes the module up.
+void cellular_ctrl_at_client_set_wake_up_callback(cellular_ctrl_at_client_t *at,
+                                                  void (*callback)(void *),
+                                                  void *callback_param)
 {
-    if (_uart >= 0) {
-        if (_previous_at_timeout != _at_timeout_ms) {
-            _at_timeout_ms = _previous_at_timeout;
-        }
+    if (at->uart >= 0) {
+        at->wake_up_callback = callback;
+        at->wake_up_callback_param = callback_param;
     }
 }
 
-void cellular_ctrl_at_skip_len(int32_t len, uint32_t count)
+// Set the function the callbacks task calls when idle.
+void cellular_ctrl_at_client_set_callbacks_poll(cellular_ctrl_at_client_t *at,
+                                                void (*poll)(void *),
+                                                void *poll_param)
 {
-    if (_uart >= 0) {
-        if ((_last_error != CELLULAR_CTRL_AT_SUCCESS) ||
-            (_stop_tag && _stop_tag->found)) {
-            return;
+    if (at->uart >= 0) {
+        at->callbacks_poll_param = poll_param;
+        at->callbacks_poll = poll;
+        if (poll != NULL) {
+            // Kick the callbacks task out of its wait
+            cellular_ctrl_at_client_callback(at, kick, NULL);
         }
+    }
+}
 
-        for (uint32_t i = 0; i < count; i++) {
-            int32_t read_len = 0;
-            while (read_len < len) {
-                int32_t c = get_char();
-                if (c == -1) {
-                    set_error(CELLULAR_CTRL_AT_DEVICE_ERROR);
-                    return;
-                }
-                read_len++;
-            }
-        }
+// Set whether the module is asleep.
+void cellular_ctrl_at_client_set_asleep(cellular_ctrl_at_client_t *at, bool asleep)
+{
+    bool was_asleep = at->asleep;
+
+    at->asleep = asleep;
+    if (asleep && !was_asleep && (at->uart >= 0)) {
+        // The URC task may be blocked indefinitely: send
+        // it round its loop to start timing the quiet
+        // period after which the UART is suspended
+        uart_event_send(at->uart, at->queue_uart, 0);
     }
 }
 
-void cellular_ctrl_at_skip_param(uint32_t count)
+// Get whether the module is asleep.
+bool cellular_ctrl_at_client_is_asleep(cellular_ctrl_at_client_t *at)
 {
-    if (_uart >= 0) {
-        if ((_last_error != CELLULAR_CTRL_AT_SUCCESS) ||
-            (_stop_tag && _stop_tag->found)) {
-            return;
-        }
+    return at->asleep;
+}
 
-        for (uint32_t i = 0; (i < count) && (_stop_tag && !_stop_tag->found); i++) {
-            size_t match_pos = 0;
-            while (true) {
-                int c = get_char();
-                if (c == -1) {
-                    set_error(CELLULAR_CTRL_AT_DEVICE_ERROR);
-                    return;
-                } else if (c == _delimiter) {
-                    break;
-                } else if (_stop_tag && _stop_tag->len && (c == _stop_tag->tag[match_pos])) {
-                    match_pos++;
-                    if (match_pos == _stop_tag->len) {
-                        _stop_tag->found = true;
-                        break;
-                    }
-                } else if (match_pos) {
-                    match_pos = 0;
-                }
-            }
-        }
-    }
+// Set whether the AT link is being recovered.
+void cellular_ctrl_at_client_set_recovering(cellular_ctrl_at_client_t *at,
+                                            bool recovering)
+{
+    at->recovering = recovering;
 }
 
-int32_t cellular_ctrl_at_read_bytes(uint8_t *buf, size_t len)
+// Get whether the AT link is being recovered.
+bool cellular_ctrl_at_client_is_recovering(cellular_ctrl_at_client_t *at)
 {
-    size_t read_len = 0;
-    size_t match_pos = 0;
+    return at->recovering;
+}
 
-    if ((_uart < 0) || (_last_error != CELLULAR_CTRL_AT_SUCCESS) ||
-        (_stop_tag && _stop_tag->found)) {
-        return -1;
-    }
 
-    bool print_at_on = _print_at_on;
-    for (; read_len < (len + match_pos); read_len++) {
-        int32_t c = get_char();
-        if (c == -1) {
-            set_error(CELLULAR_CTRL_AT_DEVICE_ERROR);
-            _print_at_on = print_at_on;
+void cellular_ctrl_at_client_restore_at_timeout(cellular_ctrl_at_client_t *at)
+{
+    if (at->uart >= 0) {
+        if (at->previous_at_timeout != at->at_timeout_ms) {
+            at->at_timeout_ms = at->previous_at_timeout;
+        }
+    }
+}
+
+void cellular_ctrl_at_client_set_send_delay(cellular_ctrl_at_client_t *at,
+                                            uint32_t delay_ms)
+{
+    at->at_send_delay_ms = delay_ms;
+    send_delay_reset(at);
+}
+
+uint32_t cellular_ctrl_at_client_get_send_delay(cellular_ctrl_at_client_t *at)
+{
+    return at->at_send_delay_ms;
+}
+
+void cellular_ctrl_at_client_set_send_delay_min(cellular_ctrl_at_client_t *at,
+                                                cellular_ctrl_at_send_delay_class_t delay_class,
+                                                uint32_t delay_ms)
+{
+    if (delay_class < CELLULAR_CTRL_AT_SEND_DELAY_NUM_CLASSES) {
+        at->at_send_delay_min_ms[delay_class] = delay_ms;
+        if (at->at_send_delay_now_ms[delay_class] < delay_ms) {
+            at->at_send_delay_now_ms[delay_class] = delay_ms;
+        }
+        if (at->at_send_delay_now_ms[delay_class] > at->at_send_delay_ms) {
+            at->at_send_delay_now_ms[delay_class] = at->at_send_delay_ms;
+        }
+    }
+}
+
+void cellular_ctrl_at_client_set_send_delay_class(cellular_ctrl_at_client_t *at,
+                                                  cellular_ctrl_at_send_delay_class_t delay_class)
+{
+    if (delay_class < CELLULAR_CTRL_AT_SEND_DELAY_NUM_CLASSES) {
+        at->send_delay_class_next = delay_class;
+    }
+}
+
+uint32_t cellular_ctrl_at_client_get_send_delay_now(cellular_ctrl_at_client_t *at,
+                                                    cellular_ctrl_at_send_delay_class_t delay_class)
+{
+    uint32_t delay_ms = 0;
+
+    if (delay_class < CELLULAR_CTRL_AT_SEND_DELAY_NUM_CLASSES) {
+        delay_ms = at->at_send_delay_now_ms[delay_class];
+    }
+
+    return delay_ms;
+}
+
+void cellular_ctrl_at_client_skip_len(cellular_ctrl_at_client_t *at,
+                                      int32_t len, uint32_t count)
+{
+    if (at->uart >= 0) {
+        if ((at->last_error != CELLULAR_CTRL_AT_SUCCESS) ||
+            (at->stop_tag && at->stop_tag->found)) {
+            return;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+            int32_t read_len = 0;
+            while (read_len < len) {
+                int32_t c = get_char(at);
+                if (c == -1) {
+                    set_error(at, CELLULAR_CTRL_AT_DEVICE_ERROR);
+                    return;
+                }
+                read_len++;
+            }
+        }
+    }
+}
+
+void cellular_ctrl_at_client_skip_param(cellular_ctrl_at_client_t *at, uint32_t count)
+{
+    if (at->uart >= 0) {
+        if ((at->last_error != CELLULAR_CTRL_AT_SUCCESS) ||
+            (at->stop_tag && at->stop_tag->found)) {
+            return;
+        }
+
+        for (uint32_t i = 0; (i < count) && (at->stop_tag && !at->stop_tag->found); i++) {
+            size_t match_pos = 0;
+            while (true) {
+                int c = get_char(at);
+                if (c == -1) {
+                    set_error(at, CELLULAR_CTRL_AT_DEVICE_ERROR);
+                    return;
+                } else if (c == at->delimiter) {
+                    break;
+                } else if (at->stop_tag && at->stop_tag->len && (c == at->stop_tag->tag[match_pos])) {
+                    match_pos++;
+                    if (match_pos == at->stop_tag->len) {
+                        at->stop_tag->found = true;
+                        break;
+                    }
+                } else if (match_pos) {
+                    match_pos = 0;
+                }
+            }
+        }
+    }
+}
+
+int32_t cellular_ctrl_at_client_read_bytes(cellular_ctrl_at_client_t *at,
+                                           uint8_t *buf, size_t len)
+{
+    size_t read_len = 0;
+    size_t match_pos = 0;
+
+    if ((at->uart < 0) || (at->last_error != CELLULAR_CTRL_AT_SUCCESS) ||
+        (at->stop_tag && at->stop_tag->found)) {
+        return -1;
+    }
+
+    // Nothing to look for, move whole blocks
+    if ((at->stop_tag == NULL) || (at->stop_tag->len == 0)) {
+        return read_bytes_block(at, buf, len);
+    }
+
+    bool print_at_on = at->print_at_on;
+    for (; read_len < (len + match_pos); read_len++) {
+        int32_t c = get_char(at);
+        if (c == -1) {
+            set_error(at, CELLULAR_CTRL_AT_DEVICE_ERROR);
+            at->print_at_on = print_at_on;
             return -1;
-        } else if (_stop_tag &&
-                   _stop_tag->len &&
-                   (c == _stop_tag->tag[match_pos])) {
+        } else if (at->stop_tag &&
+                   at->stop_tag->len &&
+                   (c == at->stop_tag->tag[match_pos])) {
             match_pos++;
-            if (match_pos == _stop_tag->len) {
-                _stop_tag->found = true;
+            if (match_pos == at->stop_tag->len) {
+                at->stop_tag->found = true;
                 // remove tag from string if it was matched
-                read_len -= _stop_tag->len - 1;
+                read_len -= at->stop_tag->len - 1;
                 break;
             }
         } else if (match_pos) {
@@ -1539,22 +2939,23 @@ int32_t cellular_ctrl_at_read_bytes(uint8_t *buf, size_t len)
             buf[read_len] = c;
         }
 #ifndef DEBUG_PRINT_FULL_AT_STRING
-        if (_print_at_on && (read_len >= CELLULAR_CTRL_AT_DEBUG_MAXLEN)) {
-            print_at("...", sizeof("..."));
-            _print_at_on = false;
+        if (at->print_at_on && (read_len >= CELLULAR_CTRL_AT_DEBUG_MAXLEN)) {
+            print_at(at, "...", sizeof("..."));
+            at->print_at_on = false;
         }
 #endif
     }
 
-    _print_at_on = print_at_on;
+    at->print_at_on = print_at_on;
     return read_len;
 }
 
-int32_t cellular_ctrl_at_read_string(char *buf, size_t size,
-                                     bool read_even_stop_tag)
+int32_t cellular_ctrl_at_client_read_string(cellular_ctrl_at_client_t *at,
+                                            char *buf, size_t size,
+                                            bool read_even_stop_tag)
 {
-    if ((_uart < 0) || (_last_error != CELLULAR_CTRL_AT_SUCCESS) ||
-        (_stop_tag && _stop_tag->found &&
+    if ((at->uart < 0) || (at->last_error != CELLULAR_CTRL_AT_SUCCESS) ||
+        (at->stop_tag && at->stop_tag->found &&
          read_even_stop_tag == false)) {
         return -1;
     }
@@ -1565,11 +2966,11 @@ int32_t cellular_ctrl_at_read_string(char *buf, size_t size,
     bool in_quotes = false;
 
     for (; len < (size - 1 + match_pos); len++) {
-        int32_t c = get_char();
+        int32_t c = get_char(at);
         if (c == -1) {
-            set_error(CELLULAR_CTRL_AT_DEVICE_ERROR);
+            set_error(at, CELLULAR_CTRL_AT_DEVICE_ERROR);
             return -1;
-        } else if (!in_quotes && (c == _delimiter)) {
+        } else if (!in_quotes && (c == at->delimiter)) {
             if (buf != NULL) {
                 buf[len] = '\0';
             }
@@ -1580,14 +2981,14 @@ int32_t cellular_ctrl_at_read_string(char *buf, size_t size,
             len--;
             in_quotes = !in_quotes;
             continue;
-        } else if (!in_quotes && _stop_tag &&
-                   _stop_tag->len &&
-                   (c == _stop_tag->tag[match_pos])) {
+        } else if (!in_quotes && at->stop_tag &&
+                   at->stop_tag->len &&
+                   (c == at->stop_tag->tag[match_pos])) {
             match_pos++;
-            if (match_pos == _stop_tag->len) {
-                _stop_tag->found = true;
+            if (match_pos == at->stop_tag->len) {
+                at->stop_tag->found = true;
                 // remove tag from string if it was matched
-                len -= _stop_tag->len - 1;
+                len -= at->stop_tag->len - 1;
                 if (buf != NULL) {
                     buf[len] = '\0';
                 }
@@ -1609,22 +3010,22 @@ int32_t cellular_ctrl_at_read_string(char *buf, size_t size,
     }
 
     // Consume to delimiter or stop_tag
-    if (!delimiter_found && _stop_tag && !_stop_tag->found) {
+    if (!delimiter_found && at->stop_tag && !at->stop_tag->found) {
         // Note:  match_pos was being reset to zero here but
         // that means that if half of the tag was matched in the
         // for() loop above it will be missed here
         while (1) {
-            int32_t c = get_char();
+            int32_t c = get_char(at);
             if (c == -1) {
-                set_error(CELLULAR_CTRL_AT_DEVICE_ERROR);
+                set_error(at, CELLULAR_CTRL_AT_DEVICE_ERROR);
                 break;
-            } else if (c == _delimiter) {
+            } else if (c == at->delimiter) {
                 break;
-            } else if (_stop_tag->len &&
-                       (c == _stop_tag->tag[match_pos])) {
+            } else if (at->stop_tag->len &&
+                       (c == at->stop_tag->tag[match_pos])) {
                 match_pos++;
-                if (match_pos == _stop_tag->len) {
-                    _stop_tag->found = true;
+                if (match_pos == at->stop_tag->len) {
+                    at->stop_tag->found = true;
                     break;
                 }
             }
@@ -1634,26 +3035,27 @@ int32_t cellular_ctrl_at_read_string(char *buf, size_t size,
     return len;
 }
 
-int32_t cellular_ctrl_at_read_hex_string(char *buf, size_t size)
+int32_t cellular_ctrl_at_client_read_hex_string(cellular_ctrl_at_client_t *at,
+                                                char *buf, size_t size)
 {
-    if ((_uart < 0) || (_last_error != CELLULAR_CTRL_AT_SUCCESS) || !_stop_tag || _stop_tag->found) {
+    if ((at->uart < 0) || (at->last_error != CELLULAR_CTRL_AT_SUCCESS) || !at->stop_tag || at->stop_tag->found) {
         return -1;
     }
 
     size_t match_pos = 0;
 
-    consume_char('\"');
+    consume_char(at, '\"');
 
-    if ((_last_error != CELLULAR_CTRL_AT_SUCCESS)) {
+    if ((at->last_error != CELLULAR_CTRL_AT_SUCCESS)) {
         return -1;
     }
 
     size_t read_idx = 0;
     size_t buf_idx = 0;
-    char hexbuf[2];
+    int32_t upper = 0;
 
     for (; read_idx < size * 2 + match_pos; read_idx++) {
-        int32_t c = get_char();
+        int32_t c = get_char(at);
 
         if (match_pos) {
             buf_idx++;
@@ -1662,22 +3064,22 @@ int32_t cellular_ctrl_at_read_hex_string(char *buf, size_t size)
         }
 
         if (c == -1) {
-            set_error(CELLULAR_CTRL_AT_DEVICE_ERROR);
+            set_error(at, CELLULAR_CTRL_AT_DEVICE_ERROR);
             return -1;
         }
-        if (c == _delimiter) {
+        if (c == at->delimiter) {
             break;
         } else if (c == '\"') {
             match_pos = 0;
             read_idx--;
             continue;
-        } else if (_stop_tag->len &&
-                   (c == _stop_tag->tag[match_pos])) {
+        } else if (at->stop_tag->len &&
+                   (c == at->stop_tag->tag[match_pos])) {
             match_pos++;
-            if (match_pos == _stop_tag->len) {
-                _stop_tag->found = true;
+            if (match_pos == at->stop_tag->len) {
+                at->stop_tag->found = true;
                 // remove tag from string if it was matched
-                buf_idx -= _stop_tag->len - 1;
+                buf_idx -= at->stop_tag->len - 1;
                 break;
             }
         } else if (match_pos) {
@@ -1687,9 +3089,10 @@ int32_t cellular_ctrl_at_read_hex_string(char *buf, size_t size)
         if (match_pos) {
             buf[buf_idx] = c;
         } else {
-            hexbuf[read_idx % 2] = c;
-            if (read_idx % 2 == 1) {
-                hex_str_to_char_str(hexbuf, 2, buf + buf_idx);
+            if (read_idx % 2 == 0) {
+                upper = hex_digit_value((char) c);
+            } else {
+                buf[buf_idx] = (char) ((upper << 4) | hex_digit_value((char) c));
             }
         }
     }
@@ -1701,134 +3104,222 @@ int32_t cellular_ctrl_at_read_hex_string(char *buf, size_t size)
     return buf_idx;
 }
 
-int32_t cellular_ctrl_at_read_int()
+int32_t cellular_ctrl_at_client_read_int(cellular_ctrl_at_client_t *at)
 {
-    if ((_uart < 0) || (_last_error != CELLULAR_CTRL_AT_SUCCESS) || !_stop_tag || _stop_tag->found) {
+    if ((at->uart < 0) || (at->last_error != CELLULAR_CTRL_AT_SUCCESS) || !at->stop_tag || at->stop_tag->found) {
         return -1;
     }
 
-    char buff[32]; // enough for an integer
-    char *first_no_digit;
+    bool negative;
+    uint64_t magnitude;
 
-    if (cellular_ctrl_at_read_string(buff,
-                                     (size_t) sizeof(buff),
-                                     false) == 0) {
+    if (read_number(at, true, &negative, &magnitude) <= 0) {
         return -1;
     }
 
-    return cellularPort_strtol(buff, &first_no_digit, 10);
+    return number_to_int32(negative, magnitude);
 }
 
-int32_t cellular_ctrl_at_read_uint64(uint64_t *uint64)
+int32_t cellular_ctrl_at_client_read_uint64(cellular_ctrl_at_client_t *at,
+                                            uint64_t *uint64)
 {
-    if ((_uart < 0) || (_last_error != CELLULAR_CTRL_AT_SUCCESS) || !_stop_tag || _stop_tag->found) {
+    if ((at->uart < 0) || (at->last_error != CELLULAR_CTRL_AT_SUCCESS) || !at->stop_tag || at->stop_tag->found) {
         return -1;
     }
 
-    char buff[32]; // enough for an integer
+    bool negative;
 
-    if (cellular_ctrl_at_read_string(buff,
-                                     (size_t) sizeof(buff),
-                                     false) == 0) {
+    // Can't rely on there being 64 bit sscanf() support
+    // in the underlying library, hence we do our own thing
+    if (read_number(at, false, &negative, uint64) <= 0) {
         return -1;
-    } else {
-        // Would use sscanf() here but we cannot
-        // rely on there being 64 bit sscanf() support
-        // in the underlying library, hence
-        // we do our own thing
-        *uint64 = strToUint64(buff);
     }
 
     return 0;
 }
 
-void cellular_ctrl_at_set_delimiter(char delimiter)
+// Read the sub-parameters of an information response
+// according to a template; the body of
+// cellular_ctrl_at_client_read_fields().
+static int32_t read_fields(cellular_ctrl_at_client_t *at,
+                           const char *prefix, const char *format,
+                           va_list args)
+{
+    int32_t num_read = 0;
+    bool negative;
+    uint64_t magnitude;
+    int32_t *p_int;
+    uint64_t *p_uint64;
+    char *p_str;
+    size_t size;
+    bool ok;
+
+    if (at->uart < 0) {
+        return 0;
+    }
+
+    if (prefix != NULL) {
+        cellular_ctrl_at_client_resp_start(at, prefix, false);
+    }
+
+    for (; *format != '\0'; format++) {
+        ok = (at->last_error == CELLULAR_CTRL_AT_SUCCESS) &&
+             (at->stop_tag != NULL) && !at->stop_tag->found;
+        switch (*format) {
+            case 'i':
+                p_int = va_arg(args, int32_t *);
+                ok = ok && (read_number(at, true, &negative, &magnitude) > 0);
+                if (p_int != NULL) {
+                    *p_int = ok ? number_to_int32(negative, magnitude) : -1;
+                }
+                break;
+            case 'u':
+                p_uint64 = va_arg(args, uint64_t *);
+                ok = ok && (read_number(at, false, &negative, &magnitude) > 0);
+                if (ok && (p_uint64 != NULL)) {
+                    *p_uint64 = magnitude;
+                }
+                break;
+            case 's':
+                p_str = va_arg(args, char *);
+                size = va_arg(args, size_t);
+                if ((p_str != NULL) && (size > 0)) {
+                    *p_str = '\0';
+                } else {
+                    p_str = NULL;
+                    size = 0;
+                }
+                // With nowhere to put the string the whole
+                // sub-parameter is still consumed
+                ok = ok && (cellular_ctrl_at_client_read_string(at, p_str,
+                                                                (p_str != NULL) ? size : INT32_MAX,
+                                                                false) >= 0);
+                break;
+            case '-':
+                if (ok) {
+                    cellular_ctrl_at_client_skip_param(at, 1);
+                    ok = (at->last_error == CELLULAR_CTRL_AT_SUCCESS);
+                }
+                break;
+            default:
+                // Separators, or anything else
+                continue;
+        }
+        if (ok) {
+            num_read++;
+        }
+    }
+
+    return num_read;
+}
+
+int32_t cellular_ctrl_at_client_read_fields(cellular_ctrl_at_client_t *at,
+                                            const char *prefix,
+                                            const char *format, ...)
 {
-    _delimiter = delimiter;
+    va_list args;
+    int32_t num_read;
+
+    va_start(args, format);
+    num_read = read_fields(at, prefix, format, args);
+    va_end(args);
+
+    return num_read;
 }
 
-void cellular_ctrl_at_set_default_delimiter()
+void cellular_ctrl_at_client_set_delimiter(cellular_ctrl_at_client_t *at, char delimiter)
 {
-    _delimiter = CELLULAR_CTRL_AT_DEFAULT_DELIMITER;
+    at->delimiter = delimiter;
 }
 
-void cellular_ctrl_at_use_delimiter(bool use_delimiter)
+void cellular_ctrl_at_client_set_default_delimiter(cellular_ctrl_at_client_t *at)
 {
-    _use_delimiter = use_delimiter;
+    at->delimiter = CELLULAR_CTRL_AT_DEFAULT_DELIMITER;
 }
 
-void cellular_ctrl_at_set_stop_tag(const char *stop_tag_seq)
+void cellular_ctrl_at_client_use_delimiter(cellular_ctrl_at_client_t *at,
+                                           bool use_delimiter)
+{
+    at->use_delimiter = use_delimiter;
+}
+
+void cellular_ctrl_at_client_set_stop_tag(cellular_ctrl_at_client_t *at,
+                                          const char *stop_tag_seq)
 {
-    if ((_uart < 0) || (_last_error != CELLULAR_CTRL_AT_SUCCESS) ||
-        !_stop_tag) {
+    if ((at->uart < 0) || (at->last_error != CELLULAR_CTRL_AT_SUCCESS) ||
+        !at->stop_tag) {
         return;
     }
 
-    set_tag(_stop_tag, stop_tag_seq);
+    set_tag(at, at->stop_tag, stop_tag_seq);
 }
 
-void cellular_ctrl_at_clear_error()
+void cellular_ctrl_at_client_clear_error(cellular_ctrl_at_client_t *at)
 {
-    if (_uart >= 0) {
-        _last_error = CELLULAR_CTRL_AT_SUCCESS;
-        _last_at_error.errCode = 0;
-        _last_at_error.errType = CELLULAR_CTRL_AT_DEVICE_ERROR_TYPE_NO_ERROR;
-        _last_3gpp_error = 0;
+    if (at->uart >= 0) {
+        at->last_error = CELLULAR_CTRL_AT_SUCCESS;
+        at->last_at_error.errCode = 0;
+        at->last_at_error.errType = CELLULAR_CTRL_AT_DEVICE_ERROR_TYPE_NO_ERROR;
+        at->last_3gpp_error = 0;
     }
 }
 
-cellular_ctrl_at_error_code_t cellular_ctrl_at_get_last_error()
+cellular_ctrl_at_error_code_t cellular_ctrl_at_client_get_last_error(cellular_ctrl_at_client_t *at)
 {
-    return _last_error;
+    return at->last_error;
 }
 
-cellular_ctrl_at_device_err_t cellular_ctrl_at_get_last_device_error()
+cellular_ctrl_at_device_err_t cellular_ctrl_at_client_get_last_device_error(cellular_ctrl_at_client_t *at)
 {
-    return _last_at_error;
+    return at->last_at_error;
 }
 
-int32_t cellular_ctrl_at_get_3gpp_error()
+int32_t cellular_ctrl_at_client_get_3gpp_error(cellular_ctrl_at_client_t *at)
 {
-    return _last_3gpp_error;
+    return at->last_3gpp_error;
 }
 
-void cellular_ctrl_at_resp_start(const char *prefix, bool stop)
+void cellular_ctrl_at_client_resp_start(cellular_ctrl_at_client_t *at,
+                                        const char *prefix, bool stop)
 {
-    if ((_uart < 0) || (_last_error != CELLULAR_CTRL_AT_SUCCESS)) {
+    if ((at->uart < 0) || (at->last_error != CELLULAR_CTRL_AT_SUCCESS)) {
         return;
     }
 
-    set_scope(CELLULAR_CTRL_AT_SCOPE_TYPE_NOT_SET);
+    // In case the command was not finished off
+    // with cellular_ctrl_at_cmd_stop()
+    flush_staged(at);
+
+    set_scope(at, CELLULAR_CTRL_AT_SCOPE_TYPE_NOT_SET);
     // Try get as much data as possible
-    rewind_buffer();
-    (void) fill_buffer(false);
+    (void) fill_buffer(at, false);
 
     if (prefix) {
-        cellularPort_assert(cellularPort_strlen(prefix) < CELLULAR_CTRL_AT_BUFF_SIZE);
+        cellularPort_assert(cellularPort_strlen(prefix) < sizeof(at->info_resp_prefix));
         // copy prefix so we can later use it without having
         // to provide again for info_resp
-        pCellularPort_strcpy(_info_resp_prefix, prefix);
+        pCellularPort_strcpy(at->info_resp_prefix, prefix);
     }
 
-    set_scope(CELLULAR_CTRL_AT_SCOPE_TYPE_RESP);
+    set_scope(at, CELLULAR_CTRL_AT_SCOPE_TYPE_RESP);
 
-    resp(prefix, true, true);
+    resp(at, prefix, true, true);
 
-    if (!stop && prefix && _prefix_matched) {
-        set_scope(CELLULAR_CTRL_AT_SCOPE_TYPE_INFO);
+    if (!stop && prefix && at->prefix_matched) {
+        set_scope(at, CELLULAR_CTRL_AT_SCOPE_TYPE_INFO);
     }
 }
 
 // Check URC because of error as URC
-bool cellular_ctrl_at_info_resp()
+bool cellular_ctrl_at_client_info_resp(cellular_ctrl_at_client_t *at)
 {
-    if ((_uart < 0) || (_last_error != CELLULAR_CTRL_AT_SUCCESS) ||
-        _resp_stop.found) {
+    if ((at->uart < 0) || (at->last_error != CELLULAR_CTRL_AT_SUCCESS) ||
+        at->resp_stop.found) {
         return false;
     }
 
-    if (_prefix_matched) {
-        _prefix_matched = false;
+    if (at->prefix_matched) {
+        at->prefix_matched = false;
         return true;
     }
 
@@ -1836,27 +3327,27 @@ bool cellular_ctrl_at_info_resp()
     // started (looping), stop the previous one.
     // Trying to handle stopping in this level instead
     // of doing it in upper level.
-    if (get_scope() == CELLULAR_CTRL_AT_SCOPE_TYPE_INFO) {
-        information_response_stop();
+    if (get_scope(at) == CELLULAR_CTRL_AT_SCOPE_TYPE_INFO) {
+        information_response_stop(at);
     }
 
-    resp(_info_resp_prefix, true, false);
+    resp(at, at->info_resp_prefix, true, false);
 
-    if (_prefix_matched) {
-        set_scope(CELLULAR_CTRL_AT_SCOPE_TYPE_INFO);
-        _prefix_matched = false;
+    if (at->prefix_matched) {
+        set_scope(at, CELLULAR_CTRL_AT_SCOPE_TYPE_INFO);
+        at->prefix_matched = false;
         return true;
     }
 
     // On mismatch go to response scope
-    set_scope(CELLULAR_CTRL_AT_SCOPE_TYPE_RESP);
+    set_scope(at, CELLULAR_CTRL_AT_SCOPE_TYPE_RESP);
 
     return false;
 }
 
-bool cellular_ctrl_at_info_elem(char start_tag)
+bool cellular_ctrl_at_client_info_elem(cellular_ctrl_at_client_t *at, char start_tag)
 {
-    if ((_uart < 0) || (_last_error != CELLULAR_CTRL_AT_SUCCESS)) {
+    if ((at->uart < 0) || (at->last_error != CELLULAR_CTRL_AT_SUCCESS)) {
         return false;
     }
 
@@ -1865,218 +3356,344 @@ bool cellular_ctrl_at_info_elem(char start_tag)
     // previous one.
     // Trying to handle stopping in this level
     // instead of doing it in upper level.
-    if (get_scope() == CELLULAR_CTRL_AT_SCOPE_TYPE_ELEM) {
-        information_response_element_stop();
+    if (get_scope(at) == CELLULAR_CTRL_AT_SCOPE_TYPE_ELEM) {
+        information_response_element_stop(at);
     }
 
-    consume_char(_delimiter);
+    consume_char(at, at->delimiter);
 
-    if (consume_char(start_tag)) {
-        _prefix_matched = true;
-        set_scope(CELLULAR_CTRL_AT_SCOPE_TYPE_ELEM);
+    if (consume_char(at, start_tag)) {
+        at->prefix_matched = true;
+        set_scope(at, CELLULAR_CTRL_AT_SCOPE_TYPE_ELEM);
         return true;
     }
 
     // On mismatch go to information response scope
-    set_scope(CELLULAR_CTRL_AT_SCOPE_TYPE_INFO);
+    set_scope(at, CELLULAR_CTRL_AT_SCOPE_TYPE_INFO);
 
     return false;
 }
 
-bool cellular_ctrl_at_consume_to_stop_tag()
+bool cellular_ctrl_at_client_consume_to_stop_tag(cellular_ctrl_at_client_t *at)
 {
-    if ((_uart < 0) || !_stop_tag ||
-        (_stop_tag && _stop_tag->found) || _error_found) {
+    if ((at->uart < 0) || !at->stop_tag ||
+        (at->stop_tag && at->stop_tag->found) || at->error_found) {
         return true;
     }
 
-    if (consume_to_tag((const char *) _stop_tag->tag, true)) {
+    if (consume_to_tag(at, (const char *) at->stop_tag->tag, true)) {
         return true;
     }
 
-    if (_debug_on) {
+    if (at->debug_on) {
         cellularPortLog("CELLULAR_AT: stop tag not found.\n");
     }
 
-    set_error(CELLULAR_CTRL_AT_DEVICE_ERROR);
+    set_error(at, CELLULAR_CTRL_AT_DEVICE_ERROR);
 
     return false;
 }
 
-void cellular_ctrl_at_resp_stop()
+void cellular_ctrl_at_client_resp_next(cellular_ctrl_at_client_t *at,
+                                       const char *prefix)
+{
+    if ((at->uart < 0) || (at->last_error != CELLULAR_CTRL_AT_SUCCESS)) {
+        return;
+    }
+
+    // If this is not the first information response, finish
+    // off the line of the previous one; if the final OK has
+    // already turned up there is nothing more to be had
+    if (at->current_scope != CELLULAR_CTRL_AT_SCOPE_TYPE_NOT_SET) {
+        if (at->resp_stop.found || at->error_found) {
+            return;
+        }
+        if (at->current_scope == CELLULAR_CTRL_AT_SCOPE_TYPE_ELEM) {
+            information_response_element_stop(at);
+        }
+        if (at->current_scope == CELLULAR_CTRL_AT_SCOPE_TYPE_INFO) {
+            information_response_stop(at);
+        }
+    }
+
+    cellular_ctrl_at_client_resp_start(at, prefix, false);
+
+    // A response without a prefix is just a line: put it in
+    // information response scope so that reading stops at the
+    // end of the line rather than at the final OK
+    if ((prefix == NULL) && (at->last_error == CELLULAR_CTRL_AT_SUCCESS) &&
+        !at->resp_stop.found && !at->error_found) {
+        set_scope(at, CELLULAR_CTRL_AT_SCOPE_TYPE_INFO);
+    }
+}
+
+void cellular_ctrl_at_client_resp_stop(cellular_ctrl_at_client_t *at)
 {
-    if (_uart >= 0) {
+    if (at->uart >= 0) {
         // Do not return on error so that we
         // can consume whatever there is in the buffer
-        if (_current_scope == CELLULAR_CTRL_AT_SCOPE_TYPE_ELEM) {
-            information_response_element_stop();
-            set_scope(CELLULAR_CTRL_AT_SCOPE_TYPE_INFO);
+        if (at->current_scope == CELLULAR_CTRL_AT_SCOPE_TYPE_ELEM) {
+            information_response_element_stop(at);
+            set_scope(at, CELLULAR_CTRL_AT_SCOPE_TYPE_INFO);
         }
 
-        if (_current_scope == CELLULAR_CTRL_AT_SCOPE_TYPE_INFO) {
-            information_response_stop();
+        if (at->current_scope == CELLULAR_CTRL_AT_SCOPE_TYPE_INFO) {
+            information_response_stop(at);
         }
 
         // Go for response stop_tag
-        if (cellular_ctrl_at_consume_to_stop_tag()) {
-            set_scope(CELLULAR_CTRL_AT_SCOPE_TYPE_NOT_SET);
+        if (cellular_ctrl_at_client_consume_to_stop_tag(at)) {
+            set_scope(at, CELLULAR_CTRL_AT_SCOPE_TYPE_NOT_SET);
         }
 
         // Restore stop tag to OK
-        set_tag(&_resp_stop, CELLULAR_CTRL_AT_OK);
+        set_tag(at, &at->resp_stop, CELLULAR_CTRL_AT_OK);
         // Reset info resp prefix
-        pCellularPort_memset(_info_resp_prefix, 0, sizeof(_info_resp_prefix));
+        pCellularPort_memset(at->info_resp_prefix, 0, sizeof(at->info_resp_prefix));
 
         // No need to worry about overflow here, we're never awake
         // for long enough
-        _last_response_stop_ms = cellularPortGetTickTimeMs();
+        at->last_response_stop_ms = cellularPortGetTickTimeMs();
+        if (at->cmd_start_ms > 0) {
+            at->timing.command_ms += at->last_response_stop_ms - at->cmd_start_ms;
+            stats_stop(at, (int32_t) (at->last_response_stop_ms - at->cmd_start_ms));
+            at->cmd_start_ms = 0;
+            send_delay_adapt(at);
+        }
+#if CELLULAR_CFG_CTRL_AT_TRACE_NUM_RECORDS > 0
+        at->trace_new_record = true;
+#endif
     }
 }
 
-void cellular_ctrl_at_cmd_start(const char *cmd)
+void cellular_ctrl_at_client_cmd_start(cellular_ctrl_at_client_t *at, const char *cmd)
 {
     int32_t delay_ms;
 
-    if (_uart >= 0) {
-        if (_at_send_delay_ms) {
-            delay_ms = (_last_response_stop_ms + _at_send_delay_ms) - cellularPortGetTickTimeMs();
+    if (at->uart >= 0) {
+        at->send_delay_class = at->send_delay_class_next;
+        at->send_delay_class_next = CELLULAR_CTRL_AT_SEND_DELAY_CLASS_CONFIG;
+        if (at->at_send_delay_now_ms[at->send_delay_class]) {
+            delay_ms = (at->last_response_stop_ms +
+                        at->at_send_delay_now_ms[at->send_delay_class]) - cellularPortGetTickTimeMs();
             if (delay_ms > 0) {
                 cellularPortTaskBlock(delay_ms);
             }
         }
 
-        if (_last_error != CELLULAR_CTRL_AT_SUCCESS) {
+        if (at->last_error != CELLULAR_CTRL_AT_SUCCESS) {
             return;
         }
 
-        (void) write(cmd, cellularPort_strlen(cmd));
+        if (at->cmd_start_ms > 0) {
+            // The previous command never got to a response
+            // stop, finish it off here
+            stats_stop(at, (int32_t) (cellularPortGetTickTimeMs() - at->cmd_start_ms));
+        }
+        at->cmd_start_ms = cellularPortGetTickTimeMs();
+        // Each command gets the full AT timeout, even when
+        // several are sent under one lock
+        at->start_time_ms = at->cmd_start_ms;
+        at->timing.num_commands++;
+        stats_start(at, cmd);
+#if CELLULAR_CFG_CTRL_AT_TRACE_NUM_RECORDS > 0
+        at->trace_new_record = true;
+#endif
+        // Anything left over from a command that failed
+        // part way through is thrown away
+        at->tx_len = 0;
+        (void) write_staged(at, cmd, cellularPort_strlen(cmd));
 
-        _cmd_start = true;
+        at->cmd_start = true;
     }
 }
 
-void cellular_ctrl_at_write_uint64(uint64_t param)
+void cellular_ctrl_at_client_write_uint64(cellular_ctrl_at_client_t *at, uint64_t param)
 {
     // do common checks before sending sub-parameter
-    if ((_uart < 0) || (check_cmd_send() == false)) {
+    if ((at->uart < 0) || (check_cmd_send(at) == false)) {
         return;
     }
 
     // write the integer sub-parameter
-    const int32_t str_len = 24;
-    char number_string[str_len];
-    int32_t result = uint64ToStr(number_string, str_len, param);
-    if (result > 0 && result < str_len) {
-        (void) write(number_string, cellularPort_strlen(number_string));
-    }
+    char number_string[21];
+    (void) write_staged(at, number_string,
+                        format_number(number_string, false, param));
 }
 
-void cellular_ctrl_at_write_int(int32_t param)
+void cellular_ctrl_at_client_write_int(cellular_ctrl_at_client_t *at, int32_t param)
 {
     // do common checks before sending sub-parameter
-    if ((_uart < 0) || (check_cmd_send() == false)) {
+    if ((at->uart < 0) || (check_cmd_send(at) == false)) {
         return;
     }
 
     // write the integer sub-parameter
-    const uint32_t str_len = 12;
-    char number_string[str_len];
-    int32_t result = cellularPort_sprintf(number_string, "%d", param);
-    if (result > 0 && result < str_len) {
-        (void) write(number_string, cellularPort_strlen(number_string));
-    }
+    char number_string[21];
+    (void) write_staged(at, number_string,
+                        format_number(number_string, param < 0,
+                                      (param < 0) ? (uint64_t) (0 - (int64_t) param) :
+                                                    (uint64_t) param));
 }
 
-void cellular_ctrl_at_write_string(const char *param,
-                                   bool useQuotations)
+void cellular_ctrl_at_client_write_string(cellular_ctrl_at_client_t *at,
+                                          const char *param,
+                                          bool useQuotations)
 {
     // do common checks before sending sub-parameter
-    if ((_uart < 0) || (check_cmd_send() == false)) {
+    if ((at->uart < 0) || (check_cmd_send(at) == false)) {
         return;
     }
 
     // we are writing string, surround it with quotes
-    if (useQuotations && (write("\"", 1) != 1)) {
+    if (useQuotations && (write_staged(at, "\"", 1) != 1)) {
         return;
     }
 
-    (void) write(param, cellularPort_strlen(param));
+    (void) write_staged(at, param, cellularPort_strlen(param));
 
     if (useQuotations) {
         // we are writing string, surround it with quotes
-        (void) write("\"", 1);
+        (void) write_staged(at, "\"", 1);
     }
 }
 
-void cellular_ctrl_at_cmd_stop()
+void cellular_ctrl_at_client_write_hex(cellular_ctrl_at_client_t *at,
+                                       const void *data, size_t len,
+                                       bool useQuotations)
+{
+    const uint8_t *p = (const uint8_t *) data;
+    size_t room;
+    char *out;
+
+    // do common checks before sending sub-parameter
+    if ((at->uart < 0) || (check_cmd_send(at) == false)) {
+        return;
+    }
+
+    if (useQuotations && (write_staged(at, "\"", 1) != 1)) {
+        return;
+    }
+
+    // Encode straight into tx_buf, sending it each time it fills
+    while ((len > 0) && (at->last_error == CELLULAR_CTRL_AT_SUCCESS)) {
+        room = (sizeof(at->tx_buf) - at->tx_len) / 2;
+        if (room == 0) {
+            flush_staged(at);
+            continue;
+        }
+        if (room > len) {
+            room = len;
+        }
+        out = at->tx_buf + at->tx_len;
+        at->tx_len += room * 2;
+        len -= room;
+        for (; room > 0; room--) {
+            out[0] = _hex_pairs[(*p << 1)];
+            out[1] = _hex_pairs[(*p << 1) + 1];
+            out += 2;
+            p++;
+        }
+    }
+
+    if (useQuotations) {
+        (void) write_staged(at, "\"", 1);
+    }
+}
+
+void cellular_ctrl_at_client_cmd_append(cellular_ctrl_at_client_t *at,
+                                        const char *cmd)
 {
-    if ((_uart < 0) || (_last_error != CELLULAR_CTRL_AT_SUCCESS)) {
+    if ((at->uart < 0) || (at->last_error != CELLULAR_CTRL_AT_SUCCESS)) {
         return;
     }
 
-    // Finish with delimiter
-    (void) write(CELLULAR_CTRL_AT_OUTPUT_DELIMITER,
-                 CELLULAR_CTRL_AT_OUTPUT_DELIMITER_LENGTH);
+    // Chain the command onto the line, no "AT" required
+    if (write_staged(at, ";", 1) == 1) {
+        (void) write_staged(at, cmd, cellularPort_strlen(cmd));
+    }
+
+    // Its first sub-parameter needs no delimiter
+    at->cmd_start = true;
 }
 
-void cellular_ctrl_at_cmd_stop_read_resp()
+void cellular_ctrl_at_client_cmd_stop(cellular_ctrl_at_client_t *at)
 {
-    if (_uart >= 0) {
-        cellular_ctrl_at_cmd_stop();
-        cellular_ctrl_at_resp_start(NULL, false);
-        cellular_ctrl_at_resp_stop();
+    if ((at->uart < 0) || (at->last_error != CELLULAR_CTRL_AT_SUCCESS)) {
+        return;
     }
+
+    // Finish with delimiter and send the lot
+    (void) write_staged(at, CELLULAR_CTRL_AT_OUTPUT_DELIMITER,
+                        CELLULAR_CTRL_AT_OUTPUT_DELIMITER_LENGTH);
+    flush_staged(at);
 }
 
-size_t cellular_ctrl_at_write_bytes(const uint8_t *data, size_t len)
+void cellular_ctrl_at_client_cmd_stop_read_resp(cellular_ctrl_at_client_t *at)
+{
+    if (at->uart >= 0) {
+        cellular_ctrl_at_client_cmd_stop(at);
+        cellular_ctrl_at_client_resp_start(at, NULL, false);
+        cellular_ctrl_at_client_resp_stop(at);
+    }
+}
+
+size_t cellular_ctrl_at_client_write_bytes(cellular_ctrl_at_client_t *at,
+                                           const uint8_t *data, size_t len)
 {
-    if ((_uart < 0) || (_last_error != CELLULAR_CTRL_AT_SUCCESS)) {
+    if ((at->uart < 0) || (at->last_error != CELLULAR_CTRL_AT_SUCCESS)) {
+        return 0;
+    }
+
+    // Anything staged must go first
+    flush_staged(at);
+    if (at->last_error != CELLULAR_CTRL_AT_SUCCESS) {
         return 0;
     }
 
-    return write(data, len);
+    return write(at, data, len);
 }
 
-void cellular_ctrl_at_flush()
+void cellular_ctrl_at_client_flush(cellular_ctrl_at_client_t *at)
 {
-    if (_uart >= 0) {
-        if (_debug_on) {
+    if (at->uart >= 0) {
+        if (at->debug_on) {
             cellularPortLog("CELLULAR_AT: flush.\n");
         }
-        reset_buffer();
-        while (fill_buffer(false)) {
-            reset_buffer();
+        reset_buffer(at);
+        while (fill_buffer(at, false)) {
+            reset_buffer(at);
         }
     }
 }
 
-bool cellular_ctrl_at_sync(int32_t timeout_ms)
+bool cellular_ctrl_at_client_sync(cellular_ctrl_at_client_t *at, int32_t timeout_ms)
 {
-    if (_uart >= 0) {
-        if (_debug_on) {
+    if (at->uart >= 0) {
+        if (at->debug_on) {
             cellularPortLog("CELLULAR_AT: sync.\n");
         }
         // poll for 10 seconds
         for (int i = 0; i < 10; i++) {
-            cellular_ctrl_at_lock();
-            cellular_ctrl_at_set_at_timeout(timeout_ms, false);
+            cellular_ctrl_at_client_lock(at);
+            cellular_ctrl_at_client_set_at_timeout(at, timeout_ms, false);
             // For sync use an AT command that is supported
             // by all modems and likely not used frequently,
             // especially a common response like OK could
             // be response to previous request.
-            cellular_ctrl_at_cmd_start("AT+CMEE?");
-            cellular_ctrl_at_cmd_stop();
-            cellular_ctrl_at_resp_start("+CMEE:", false);
-            cellular_ctrl_at_resp_stop();
-            cellular_ctrl_at_restore_at_timeout();
+            cellular_ctrl_at_client_cmd_start(at, "AT+CMEE?");
+            cellular_ctrl_at_client_cmd_stop(at);
+            cellular_ctrl_at_client_resp_start(at, "+CMEE:", false);
+            cellular_ctrl_at_client_resp_stop(at);
+            cellular_ctrl_at_client_restore_at_timeout(at);
             // TODO: the original code didn't clear the
             // error, so I've left that the same here,
             // though it seems odd to do so
-            if (cellular_ctrl_at_unlock_return_error() == CELLULAR_CTRL_AT_SUCCESS) {
+            if (cellular_ctrl_at_client_unlock_return_error(at) == CELLULAR_CTRL_AT_SUCCESS) {
                 return true;
             }
         }
-        if (_debug_on) {
+        if (at->debug_on) {
             cellularPortLog("CELLULAR_AT: sync failed.\n");
         }
     }
@@ -2085,31 +3702,828 @@ bool cellular_ctrl_at_sync(int32_t timeout_ms)
 }
 
 // Wait for a single character to arrive.
-bool cellular_ctrl_at_wait_char(char chr)
+bool cellular_ctrl_at_client_wait_char(cellular_ctrl_at_client_t *at, char chr)
 {
     int32_t c;
+    bool found = false;
+    int64_t start_ms = cellularPortGetTickTimeMs();
 
-    _error_found = false;
+    at->error_found = false;
 
-    if (_uart >= 0) {
-        while (cellular_ctrl_at_get_last_error() == CELLULAR_CTRL_AT_SUCCESS) {
-            c = get_char();
+    if (at->uart >= 0) {
+        while (!found && !at->error_found &&
+               (cellular_ctrl_at_client_get_last_error(at) == CELLULAR_CTRL_AT_SUCCESS)) {
+            c = get_char(at);
             // Continue to look for URCs,
             // you never know when the sneaky
             // buggers might turn up
-            match_urc();
-            if (match_error()) {
-                _error_found = true;
-                return false;
+            match_urc(at);
+            if (match_error(at)) {
+                at->error_found = true;
+            } else if (c == chr) {
+                found = true;
             }
+        }
+    }
 
-            if (c == chr) {
-                return true;
+    at->timing.prompt_wait_ms += cellularPortGetTickTimeMs() - start_ms;
+
+    return found;
+}
+
+// Enter direct-link mode.
+bool cellular_ctrl_at_client_direct_link_enter(cellular_ctrl_at_client_t *at)
+{
+    const char *tag = CELLULAR_CTRL_AT_DIRECT_LINK_CONNECT;
+    size_t tag_length = cellularPort_strlen(tag);
+    size_t match_pos = 0;
+    int32_t c;
+
+    at->error_found = false;
+
+    if ((at->uart >= 0) && !at->direct_link_active) {
+        while ((match_pos < tag_length) && !at->error_found &&
+               (cellular_ctrl_at_client_get_last_error(at) == CELLULAR_CTRL_AT_SUCCESS)) {
+            c = get_char(at);
+            match_urc(at);
+            if (match_error(at)) {
+                at->error_found = true;
+            } else if (c == tag[match_pos]) {
+                match_pos++;
+            } else {
+                match_pos = 0;
+                if (c == tag[match_pos]) {
+                    match_pos++;
+                }
+            }
+        }
+        if ((match_pos == tag_length) &&
+            consume_to_tag(at, CELLULAR_CTRL_AT_CRLF, true)) {
+            // Anything after the CR/LF is already data
+            // and is left in the buffer for
+            // cellular_ctrl_at_direct_link_read()
+            at->direct_link_active = true;
+            if (at->debug_on) {
+                cellularPortLog("CELLULAR_AT: direct link entered.\n");
             }
         }
     }
 
-    return false;
+    return at->direct_link_active;
+}
+
+// Write raw data to the direct link.
+int32_t cellular_ctrl_at_client_direct_link_write(cellular_ctrl_at_client_t *at,
+                                                  const uint8_t *data,
+                                                  size_t len)
+{
+    int32_t size_or_error = -1;
+    bool print_at_on = at->print_at_on;
+
+    if (at->uart >= 0) {
+        cellularPortMutexLock(at->mtx_stream);
+        if (at->direct_link_active) {
+            // Don't print raw data, it may be binary
+            at->print_at_on = false;
+            at->last_error = CELLULAR_CTRL_AT_SUCCESS;
+            size_or_error = (int32_t) write(at, data, len);
+            if (at->last_error != CELLULAR_CTRL_AT_SUCCESS) {
+                size_or_error = -1;
+            }
+            at->print_at_on = print_at_on;
+        }
+        cellularPortMutexUnlock(at->mtx_stream);
+    }
+
+    return size_or_error;
+}
+
+// Read whatever raw data is available from the direct link.
+int32_t cellular_ctrl_at_client_direct_link_read(cellular_ctrl_at_client_t *at,
+                                                 uint8_t *buf, size_t len)
+{
+    int32_t size_or_error = -1;
+    int32_t read_len;
+
+    if (at->uart >= 0) {
+        cellularPortMutexLock(at->mtx_stream);
+        if (at->direct_link_active) {
+            // Anything that arrived behind the CONNECT
+            // comes first
+            size_or_error = (int32_t) buf_read(at, buf, len);
+            if (buf_unread(at) == 0) {
+                reset_buffer(at);
+            }
+            if ((size_t) size_or_error < len) {
+                read_len = uart_read(at, (char *) buf + size_or_error,
+                                     len - size_or_error);
+                if (read_len > 0) {
+                    trace_at(at, (char *) buf + size_or_error, read_len, false);
+                    stats_bytes(at, read_len, false);
+                    size_or_error += read_len;
+                }
+            }
+        }
+        cellularPortMutexUnlock(at->mtx_stream);
+    }
+
+    return size_or_error;
+}
+
+// Leave direct-link mode.
+bool cellular_ctrl_at_client_direct_link_exit(cellular_ctrl_at_client_t *at,
+                                              int32_t guard_time_ms)
+{
+    bool success = false;
+
+    if (at->uart >= 0) {
+        cellularPortMutexLock(at->mtx_stream);
+        if (at->direct_link_active) {
+            // The escape sequence only counts if there is
+            // silence on either side of it
+            cellularPortTaskBlock(guard_time_ms);
+            at->last_error = CELLULAR_CTRL_AT_SUCCESS;
+            write(at, CELLULAR_CTRL_AT_DIRECT_LINK_ESCAPE,
+                  cellularPort_strlen(CELLULAR_CTRL_AT_DIRECT_LINK_ESCAPE));
+            cellularPortTaskBlock(guard_time_ms);
+            // Back to AT commands: anything still to
+            // come from the far end is thrown away on
+            // the way to the DISCONNECT
+            at->direct_link_active = false;
+            cellular_ctrl_at_client_clear_error(at);
+            at->start_time_ms = cellularPortGetTickTimeMs();
+            success = consume_to_tag(at, CELLULAR_CTRL_AT_DIRECT_LINK_DISCONNECT,
+                                     true) &&
+                      consume_to_tag(at, CELLULAR_CTRL_AT_CRLF, true);
+            if (at->debug_on) {
+                cellularPortLog("CELLULAR_AT: direct link exited%s.\n",
+                                success ? "" : " (no DISCONNECT)");
+            }
+        } else {
+            success = true;
+        }
+        // Let the URC task look at anything that followed
+        cellular_ctrl_at_client_unlock(at);
+    }
+
+    return success;
+}
+
+// Send the escape sequence whatever mode the module is
+// thought to be in and throw away whatever comes back.
+void cellular_ctrl_at_client_escape(cellular_ctrl_at_client_t *at,
+                                    int32_t guard_time_ms)
+{
+    if (at->uart >= 0) {
+        cellularPortMutexLock(at->mtx_stream);
+        cellularPortTaskBlock(guard_time_ms);
+        at->last_error = CELLULAR_CTRL_AT_SUCCESS;
+        write(at, CELLULAR_CTRL_AT_DIRECT_LINK_ESCAPE,
+              cellularPort_strlen(CELLULAR_CTRL_AT_DIRECT_LINK_ESCAPE));
+        cellularPortTaskBlock(guard_time_ms);
+        at->direct_link_active = false;
+        cellular_ctrl_at_client_flush(at);
+        cellular_ctrl_at_client_clear_error(at);
+        if (at->debug_on) {
+            cellularPortLog("CELLULAR_AT: escape sequence sent.\n");
+        }
+        cellular_ctrl_at_client_unlock(at);
+    }
+}
+
+// Print out the AT trace.
+void cellular_ctrl_at_client_trace_print(cellular_ctrl_at_client_t *at)
+{
+#if CELLULAR_CFG_CTRL_AT_TRACE_NUM_RECORDS > 0
+    size_t first = 0;
+    cellular_ctrl_at_trace_record_t *record;
+
+    if (at->uart >= 0) {
+        cellularPortMutexLock(at->mtx_stream);
+        if (at->trace_count > CELLULAR_CFG_CTRL_AT_TRACE_NUM_RECORDS) {
+            first = at->trace_count - CELLULAR_CFG_CTRL_AT_TRACE_NUM_RECORDS;
+        }
+        cellularPortLog("CELLULAR_AT: trace, %d record(s):\n",
+                        at->trace_count - first);
+        for (size_t x = first; x < at->trace_count; x++) {
+            record = &(at->trace[x % CELLULAR_CFG_CTRL_AT_TRACE_NUM_RECORDS]);
+            cellularPortLog("CELLULAR_AT: %d ms %s %d byte(s) \"",
+                            (int32_t) record->time_ms,
+                            record->tx ? "TX" : "RX", record->len);
+            print_chars(record->data, record->stored_len, false);
+            cellularPortLog("\"%s\n", (record->len > record->stored_len) ? "..." : "");
+        }
+        cellularPortMutexUnlock(at->mtx_stream);
+    }
+#endif
+}
+
+// Empty the AT trace.
+void cellular_ctrl_at_client_trace_clear(cellular_ctrl_at_client_t *at)
+{
+#if CELLULAR_CFG_CTRL_AT_TRACE_NUM_RECORDS > 0
+    if (at->uart >= 0) {
+        cellularPortMutexLock(at->mtx_stream);
+        at->trace_count = 0;
+        at->trace_new_record = true;
+        cellularPortMutexUnlock(at->mtx_stream);
+    }
+#endif
+}
+
+// Get the statistics for an AT command.
+int32_t cellular_ctrl_at_client_stats_get(cellular_ctrl_at_client_t *at,
+                                          size_t index,
+                                          cellular_ctrl_at_stats_t *p_stats)
+{
+    int32_t error_code = CELLULAR_CTRL_AT_NOT_IMPLEMENTED;
+
+#if CELLULAR_CFG_CTRL_AT_STATS_NUM_COMMANDS > 0
+    error_code = CELLULAR_CTRL_AT_INVALID_PARAMETER;
+    if ((p_stats != NULL) &&
+        (index < CELLULAR_CFG_CTRL_AT_STATS_NUM_COMMANDS)) {
+        // Entries are used in order, the others entry
+        // follows straight on from the last one used
+        if ((at->stats[index].prefix[0] == '\0') &&
+            ((index == 0) || (at->stats[index - 1].prefix[0] != '\0'))) {
+            index = CELLULAR_CFG_CTRL_AT_STATS_NUM_COMMANDS - 1;
+        }
+        if (at->stats[index].prefix[0] != '\0') {
+            *p_stats = at->stats[index];
+            error_code = CELLULAR_CTRL_AT_SUCCESS;
+        }
+    }
+#else
+    (void) index;
+    (void) p_stats;
+#endif
+
+    return error_code;
+}
+
+// Reset the AT command statistics.
+void cellular_ctrl_at_client_stats_reset(cellular_ctrl_at_client_t *at)
+{
+#if CELLULAR_CFG_CTRL_AT_STATS_NUM_COMMANDS > 0
+    pCellularPort_memset(at->stats, 0, sizeof(at->stats));
+    at->stats_current = NULL;
+#endif
+}
+
+// Get the accumulated AT stage timings.
+void cellular_ctrl_at_client_timing_get(cellular_ctrl_at_client_t *at,
+                                        cellular_ctrl_at_timing_t *p_timing)
+{
+    if (p_timing != NULL) {
+        *p_timing = at->timing;
+    }
+}
+
+// Reset the accumulated AT stage timings.
+void cellular_ctrl_at_client_timing_reset(cellular_ctrl_at_client_t *at)
+{
+    pCellularPort_memset(&at->timing, 0, sizeof(at->timing));
+}
+
+// Get the statistics for one of the tasks of an AT client.
+int32_t cellular_ctrl_at_client_task_stats_get(cellular_ctrl_at_client_t *at,
+                                               cellular_ctrl_at_task_t task,
+                                               cellular_ctrl_at_task_stats_t *p_stats)
+{
+    int32_t error_code = CELLULAR_CTRL_AT_INVALID_PARAMETER;
+    CellularPortTaskHandle_t task_handle;
+
+    if (at->uart < 0) {
+        error_code = CELLULAR_CTRL_AT_NOT_INITIALISED;
+    } else if ((p_stats != NULL) && (task >= 0) &&
+               (task < CELLULAR_CTRL_AT_NUM_TASKS)) {
+        *p_stats = at->task_stats[task];
+        task_handle = at->task_handle_callbacks;
+        if (task == CELLULAR_CTRL_AT_TASK_URC) {
+            task_handle = at->task_handle_urc;
+        }
+        p_stats->stack_min_free_bytes = cellularPortTaskStackMinFree(task_handle);
+        error_code = CELLULAR_CTRL_AT_SUCCESS;
+    }
+
+    return error_code;
+}
+
+// Reset the busy-time statistics of the tasks of an AT client.
+void cellular_ctrl_at_client_task_stats_reset(cellular_ctrl_at_client_t *at)
+{
+    pCellularPort_memset(at->task_stats, 0, sizeof(at->task_stats));
+}
+
+// Get the statistics for a URC handler.
+int32_t cellular_ctrl_at_client_urc_stats_get(cellular_ctrl_at_client_t *at,
+                                              size_t index,
+                                              cellular_ctrl_at_urc_stats_t *p_stats)
+{
+    int32_t error_code = CELLULAR_CTRL_AT_INVALID_PARAMETER;
+    cellular_ctrl_at_urc_t *urc;
+    size_t len;
+
+    if (at->uart < 0) {
+        error_code = CELLULAR_CTRL_AT_NOT_INITIALISED;
+    } else if (p_stats != NULL) {
+        // Lock the stream so that the handler can't be
+        // running, or being removed, while this is read
+        cellularPortMutexLock(at->mtx_stream);
+        urc = at->urcs;
+        for (size_t x = 0; (urc != NULL) && (x < index); x++) {
+            urc = urc->next;
+        }
+        if (urc != NULL) {
+            len = urc->prefix_len;
+            if (len > CELLULAR_CTRL_AT_STATS_PREFIX_LENGTH) {
+                len = CELLULAR_CTRL_AT_STATS_PREFIX_LENGTH;
+            }
+            pCellularPort_memcpy(p_stats->prefix, urc->prefix, len);
+            p_stats->prefix[len] = '\0';
+            p_stats->count = urc->count;
+            p_stats->total_ms = urc->total_ms;
+            p_stats->max_ms = urc->max_ms;
+            p_stats->over_budget = urc->over_budget;
+            error_code = CELLULAR_CTRL_AT_SUCCESS;
+        }
+        cellularPortMutexUnlock(at->mtx_stream);
+    }
+
+    return error_code;
+}
+
+// Reset the statistics of all of the URC handlers.
+void cellular_ctrl_at_client_urc_stats_reset(cellular_ctrl_at_client_t *at)
+{
+    if (at->uart >= 0) {
+        cellularPortMutexLock(at->mtx_stream);
+        for (cellular_ctrl_at_urc_t *urc = at->urcs; urc != NULL; urc = urc->next) {
+            urc->count = 0;
+            urc->total_ms = 0;
+            urc->max_ms = 0;
+            urc->over_budget = 0;
+        }
+        cellularPortMutexUnlock(at->mtx_stream);
+    }
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS: THE DEFAULT AT CLIENT
+ * -------------------------------------------------------------- */
+
+cellular_ctrl_at_error_code_t cellular_ctrl_at_init(int32_t uart,
+                                                    CellularPortQueueHandle_t queue_uart)
+{
+    return cellular_ctrl_at_client_init(&_client_default, uart, queue_uart);
+}
+
+cellular_ctrl_at_error_code_t cellular_ctrl_at_set_uart(int32_t uart,
+                                                        CellularPortQueueHandle_t queue_uart)
+{
+    return cellular_ctrl_at_client_set_uart(&_client_default, uart, queue_uart);
+}
+
+void cellular_ctrl_at_deinit()
+{
+    cellular_ctrl_at_client_deinit(&_client_default);
+}
+
+bool cellular_ctrl_at_debug_get()
+{
+    return cellular_ctrl_at_client_debug_get(&_client_default);
+}
+
+void cellular_ctrl_at_debug_set(bool onNotOff)
+{
+    cellular_ctrl_at_client_debug_set(&_client_default, onNotOff);
+}
+
+bool cellular_ctrl_at_print_at_get()
+{
+    return cellular_ctrl_at_client_print_at_get(&_client_default);
+}
+
+void cellular_ctrl_at_print_at_set(bool onNotOff)
+{
+    cellular_ctrl_at_client_print_at_set(&_client_default, onNotOff);
+}
+
+bool cellular_ctrl_at_capture_get()
+{
+    return cellular_ctrl_at_client_capture_get(&_client_default);
+}
+
+void cellular_ctrl_at_capture_set(bool onNotOff)
+{
+    cellular_ctrl_at_client_capture_set(&_client_default, onNotOff);
+}
+
+cellular_ctrl_at_error_code_t cellular_ctrl_at_set_urc_handler(const char *prefix,
+                                                               void (callback) (void *),
+                                                               void *callback_param)
+{
+    return cellular_ctrl_at_client_set_urc_handler(&_client_default,
+                                                   prefix,
+                                                   callback,
+                                                   callback_param);
+}
+
+void cellular_ctrl_at_remove_urc_handler(const char *prefix)
+{
+    cellular_ctrl_at_client_remove_urc_handler(&_client_default, prefix);
+}
+
+bool cellular_ctrl_at_callback(void (callback)(void *),
+                                   void *callback_param)
+{
+    return cellular_ctrl_at_client_callback(&_client_default, callback, callback_param);
+}
+
+bool cellular_ctrl_at_callback_priority(void (callback)(void *),
+                                        void *callback_param,
+                                        cellular_ctrl_at_callback_priority_t priority,
+                                        bool coalesce)
+{
+    return cellular_ctrl_at_client_callback_priority(&_client_default, callback,
+                                                     callback_param, priority,
+                                                     coalesce);
+}
+
+bool cellular_ctrl_at_callback_data(void (callback)(void *),
+                                    const void *p_data, size_t data_len,
+                                    cellular_ctrl_at_callback_priority_t priority,
+                                    bool coalesce)
+{
+    return cellular_ctrl_at_client_callback_data(&_client_default, callback,
+                                                 p_data, data_len, priority,
+                                                 coalesce);
+}
+
+void cellular_ctrl_at_callback_stats_get(cellular_ctrl_at_callback_stats_t *p_stats)
+{
+    cellular_ctrl_at_client_callback_stats_get(&_client_default, p_stats);
+}
+
+void cellular_ctrl_at_callback_stats_reset()
+{
+    cellular_ctrl_at_client_callback_stats_reset(&_client_default);
+}
+
+void cellular_ctrl_at_lock()
+{
+    cellular_ctrl_at_client_lock(&_client_default);
+}
+
+void cellular_ctrl_at_unlock()
+{
+    cellular_ctrl_at_client_unlock(&_client_default);
+}
+
+cellular_ctrl_at_error_code_t cellular_ctrl_at_unlock_return_error()
+{
+    return cellular_ctrl_at_client_unlock_return_error(&_client_default);
+}
+
+void cellular_ctrl_at_set_at_timeout(uint32_t timeout_milliseconds,
+                                     bool default_timeout)
+{
+    cellular_ctrl_at_client_set_at_timeout(&_client_default,
+                                           timeout_milliseconds,
+                                           default_timeout);
+}
+
+void cellular_ctrl_at_set_at_timeout_callback(void (callback)(void *))
+{
+    cellular_ctrl_at_client_set_at_timeout_callback(&_client_default, callback);
+}
+
+void cellular_ctrl_at_set_wake_up_callback(void (*callback)(void *),
+                                           void *callback_param)
+{
+    cellular_ctrl_at_client_set_wake_up_callback(&_client_default,
+                                                 callback,
+                                                 callback_param);
+}
+
+void cellular_ctrl_at_set_callbacks_poll(void (*poll)(void *),
+                                         void *poll_param)
+{
+    cellular_ctrl_at_client_set_callbacks_poll(&_client_default, poll, poll_param);
+}
+
+void cellular_ctrl_at_set_asleep(bool asleep)
+{
+    cellular_ctrl_at_client_set_asleep(&_client_default, asleep);
+}
+
+bool cellular_ctrl_at_is_asleep()
+{
+    return cellular_ctrl_at_client_is_asleep(&_client_default);
+}
+
+void cellular_ctrl_at_set_recovering(bool recovering)
+{
+    cellular_ctrl_at_client_set_recovering(&_client_default, recovering);
+}
+
+bool cellular_ctrl_at_is_recovering()
+{
+    return cellular_ctrl_at_client_is_recovering(&_client_default);
+}
+
+void cellular_ctrl_at_restore_at_timeout()
+{
+    cellular_ctrl_at_client_restore_at_timeout(&_client_default);
+}
+
+void cellular_ctrl_at_set_send_delay(uint32_t delay_ms)
+{
+    cellular_ctrl_at_client_set_send_delay(&_client_default, delay_ms);
+}
+
+uint32_t cellular_ctrl_at_get_send_delay()
+{
+    return cellular_ctrl_at_client_get_send_delay(&_client_default);
+}
+
+void cellular_ctrl_at_set_send_delay_min(cellular_ctrl_at_send_delay_class_t delay_class,
+                                         uint32_t delay_ms)
+{
+    cellular_ctrl_at_client_set_send_delay_min(&_client_default, delay_class, delay_ms);
+}
+
+void cellular_ctrl_at_set_send_delay_class(cellular_ctrl_at_send_delay_class_t delay_class)
+{
+    cellular_ctrl_at_client_set_send_delay_class(&_client_default, delay_class);
+}
+
+uint32_t cellular_ctrl_at_get_send_delay_now(cellular_ctrl_at_send_delay_class_t delay_class)
+{
+    return cellular_ctrl_at_client_get_send_delay_now(&_client_default, delay_class);
+}
+
+void cellular_ctrl_at_skip_len(int32_t len, uint32_t count)
+{
+    cellular_ctrl_at_client_skip_len(&_client_default, len, count);
+}
+
+void cellular_ctrl_at_skip_param(uint32_t count)
+{
+    cellular_ctrl_at_client_skip_param(&_client_default, count);
+}
+
+int32_t cellular_ctrl_at_read_bytes(uint8_t *buf, size_t len)
+{
+    return cellular_ctrl_at_client_read_bytes(&_client_default, buf, len);
+}
+
+int32_t cellular_ctrl_at_read_string(char *buf, size_t size,
+                                     bool read_even_stop_tag)
+{
+    return cellular_ctrl_at_client_read_string(&_client_default,
+                                               buf,
+                                               size,
+                                               read_even_stop_tag);
+}
+
+int32_t cellular_ctrl_at_read_hex_string(char *buf, size_t size)
+{
+    return cellular_ctrl_at_client_read_hex_string(&_client_default, buf, size);
+}
+
+int32_t cellular_ctrl_at_read_int()
+{
+    return cellular_ctrl_at_client_read_int(&_client_default);
+}
+
+int32_t cellular_ctrl_at_read_uint64(uint64_t *uint64)
+{
+    return cellular_ctrl_at_client_read_uint64(&_client_default, uint64);
+}
+
+int32_t cellular_ctrl_at_read_fields(const char *prefix,
+                                     const char *format, ...)
+{
+    va_list args;
+    int32_t num_read;
+
+    va_start(args, format);
+    num_read = read_fields(&_client_default, prefix, format, args);
+    va_end(args);
+
+    return num_read;
+}
+
+void cellular_ctrl_at_set_delimiter(char delimiter)
+{
+    cellular_ctrl_at_client_set_delimiter(&_client_default, delimiter);
+}
+
+void cellular_ctrl_at_set_default_delimiter()
+{
+    cellular_ctrl_at_client_set_default_delimiter(&_client_default);
+}
+
+void cellular_ctrl_at_use_delimiter(bool use_delimiter)
+{
+    cellular_ctrl_at_client_use_delimiter(&_client_default, use_delimiter);
+}
+
+void cellular_ctrl_at_set_stop_tag(const char *stop_tag_seq)
+{
+    cellular_ctrl_at_client_set_stop_tag(&_client_default, stop_tag_seq);
+}
+
+void cellular_ctrl_at_clear_error()
+{
+    cellular_ctrl_at_client_clear_error(&_client_default);
+}
+
+cellular_ctrl_at_error_code_t cellular_ctrl_at_get_last_error()
+{
+    return cellular_ctrl_at_client_get_last_error(&_client_default);
+}
+
+cellular_ctrl_at_device_err_t cellular_ctrl_at_get_last_device_error()
+{
+    return cellular_ctrl_at_client_get_last_device_error(&_client_default);
+}
+
+int32_t cellular_ctrl_at_get_3gpp_error()
+{
+    return cellular_ctrl_at_client_get_3gpp_error(&_client_default);
+}
+
+void cellular_ctrl_at_resp_start(const char *prefix, bool stop)
+{
+    cellular_ctrl_at_client_resp_start(&_client_default, prefix, stop);
+}
+
+bool cellular_ctrl_at_info_resp()
+{
+    return cellular_ctrl_at_client_info_resp(&_client_default);
+}
+
+bool cellular_ctrl_at_info_elem(char start_tag)
+{
+    return cellular_ctrl_at_client_info_elem(&_client_default, start_tag);
+}
+
+bool cellular_ctrl_at_consume_to_stop_tag()
+{
+    return cellular_ctrl_at_client_consume_to_stop_tag(&_client_default);
+}
+
+void cellular_ctrl_at_resp_next(const char *prefix)
+{
+    cellular_ctrl_at_client_resp_next(&_client_default, prefix);
+}
+
+void cellular_ctrl_at_resp_stop()
+{
+    cellular_ctrl_at_client_resp_stop(&_client_default);
+}
+
+void cellular_ctrl_at_cmd_start(const char *cmd)
+{
+    cellular_ctrl_at_client_cmd_start(&_client_default, cmd);
+}
+
+void cellular_ctrl_at_write_uint64(uint64_t param)
+{
+    cellular_ctrl_at_client_write_uint64(&_client_default, param);
+}
+
+void cellular_ctrl_at_write_int(int32_t param)
+{
+    cellular_ctrl_at_client_write_int(&_client_default, param);
+}
+
+void cellular_ctrl_at_write_string(const char *param,
+                                   bool useQuotations)
+{
+    cellular_ctrl_at_client_write_string(&_client_default, param, useQuotations);
+}
+
+void cellular_ctrl_at_write_hex(const void *data, size_t len,
+                                bool useQuotes)
+{
+    cellular_ctrl_at_client_write_hex(&_client_default, data, len, useQuotes);
+}
+
+void cellular_ctrl_at_cmd_append(const char *cmd)
+{
+    cellular_ctrl_at_client_cmd_append(&_client_default, cmd);
+}
+
+void cellular_ctrl_at_cmd_stop()
+{
+    cellular_ctrl_at_client_cmd_stop(&_client_default);
+}
+
+void cellular_ctrl_at_cmd_stop_read_resp()
+{
+    cellular_ctrl_at_client_cmd_stop_read_resp(&_client_default);
+}
+
+size_t cellular_ctrl_at_write_bytes(const uint8_t *data, size_t len)
+{
+    return cellular_ctrl_at_client_write_bytes(&_client_default, data, len);
+}
+
+void cellular_ctrl_at_flush()
+{
+    cellular_ctrl_at_client_flush(&_client_default);
+}
+
+bool cellular_ctrl_at_sync(int32_t timeout_ms)
+{
+    return cellular_ctrl_at_client_sync(&_client_default, timeout_ms);
+}
+
+bool cellular_ctrl_at_wait_char(char chr)
+{
+    return cellular_ctrl_at_client_wait_char(&_client_default, chr);
+}
+
+bool cellular_ctrl_at_direct_link_enter()
+{
+    return cellular_ctrl_at_client_direct_link_enter(&_client_default);
+}
+
+int32_t cellular_ctrl_at_direct_link_write(const uint8_t *data,
+                                           size_t len)
+{
+    return cellular_ctrl_at_client_direct_link_write(&_client_default, data, len);
+}
+
+int32_t cellular_ctrl_at_direct_link_read(uint8_t *buf, size_t len)
+{
+    return cellular_ctrl_at_client_direct_link_read(&_client_default, buf, len);
+}
+
+bool cellular_ctrl_at_direct_link_exit(int32_t guard_time_ms)
+{
+    return cellular_ctrl_at_client_direct_link_exit(&_client_default, guard_time_ms);
+}
+
+void cellular_ctrl_at_escape(int32_t guard_time_ms)
+{
+    cellular_ctrl_at_client_escape(&_client_default, guard_time_ms);
+}
+
+void cellular_ctrl_at_trace_print()
+{
+    cellular_ctrl_at_client_trace_print(&_client_default);
+}
+
+void cellular_ctrl_at_trace_clear()
+{
+    cellular_ctrl_at_client_trace_clear(&_client_default);
+}
+
+int32_t cellular_ctrl_at_stats_get(size_t index,
+                                   cellular_ctrl_at_stats_t *p_stats)
+{
+    return cellular_ctrl_at_client_stats_get(&_client_default, index, p_stats);
+}
+
+void cellular_ctrl_at_stats_reset()
+{
+    cellular_ctrl_at_client_stats_reset(&_client_default);
+}
+
+void cellular_ctrl_at_timing_get(cellular_ctrl_at_timing_t *p_timing)
+{
+    cellular_ctrl_at_client_timing_get(&_client_default, p_timing);
+}
+
+void cellular_ctrl_at_timing_reset()
+{
+    cellular_ctrl_at_client_timing_reset(&_client_default);
+}
+
+int32_t cellular_ctrl_at_task_stats_get(cellular_ctrl_at_task_t task,
+                                        cellular_ctrl_at_task_stats_t *p_stats)
+{
+    return cellular_ctrl_at_client_task_stats_get(&_client_default, task, p_stats);
+}
+
+void cellular_ctrl_at_task_stats_reset()
+{
+    cellular_ctrl_at_client_task_stats_reset(&_client_default);
+}
+
+int32_t cellular_ctrl_at_urc_stats_get(size_t index,
+                                       cellular_ctrl_at_urc_stats_t *p_stats)
+{
+    return cellular_ctrl_at_client_urc_stats_get(&_client_default, index, p_stats);
+}
+
+void cellular_ctrl_at_urc_stats_reset()
+{
+    cellular_ctrl_at_client_urc_stats_reset(&_client_default);
 }
 
 // End of file
@@ -20,9 +20,13 @@
 
 /* No #includes allowed here */
 
-/* This header file defines the cellular AT client API.  These functions
- * are thread-safe with the proviso that there can be only a single
- * UART in use at any one time.
+/* This header file defines the cellular AT client API.  The functions
+ * that do not take an AT client as a parameter work on a default AT
+ * client; further AT clients, each on their own UART, may be created
+ * with cellular_ctrl_at_client_create() and used through the
+ * cellular_ctrl_at_client_*() functions.  The functions are
+ * thread-safe with the proviso that each AT client must be on a
+ * different UART.
  */
 
 #ifdef __cplusplus
@@ -39,6 +43,33 @@ extern "C" {
 # define CELLULAR_CTRL_AT_COMMAND_DEFAULT_TIMEOUT_MS 8000
 #endif
 
+/** The maximum length of the command prefix used to key
+ * the AT command statistics, e.g. "AT+USOWR".
+ */
+#define CELLULAR_CTRL_AT_STATS_PREFIX_LENGTH 12
+
+/** The number of bytes that cellular_ctrl_at_callback_data()
+ * will copy for the callback; enough for a handful of integers
+ * read from a URC.
+ */
+#define CELLULAR_CTRL_AT_CALLBACK_DATA_MAX_LENGTH_BYTES 16
+
+/** The tag at the start of each line of an AT capture, see
+ * cellular_ctrl_at_capture_set().
+ */
+#define CELLULAR_CTRL_AT_CAPTURE_TAG "CELLULAR_AT_CAPTURE:"
+
+/** The number of buckets in each AT command latency histogram.
+ */
+#define CELLULAR_CTRL_AT_STATS_HISTOGRAM_NUM_BUCKETS 10
+
+/** The upper limit of the first bucket in each AT command
+ * latency histogram; each subsequent bucket has twice the
+ * limit of the previous one and the last bucket has no
+ * upper limit.
+ */
+#define CELLULAR_CTRL_AT_STATS_HISTOGRAM_BASE_MS 16
+
 /* ----------------------------------------------------------------
  * TYPES
  * -------------------------------------------------------------- */
@@ -69,6 +100,109 @@ typedef enum {
     CELLULAR_CTRL_AT_DEVICE_ERROR = -6
 } cellular_ctrl_at_error_code_t;
 
+/** The priorities at which callbacks may be queued, see
+ * cellular_ctrl_at_callback_priority(); all of the callbacks
+ * waiting at a higher priority are run before any at a lower
+ * priority.
+ */
+typedef enum {
+    CELLULAR_CTRL_AT_CALLBACK_PRIORITY_HIGH = 0, //!< e.g. AT time-outs, loss of network.
+    CELLULAR_CTRL_AT_CALLBACK_PRIORITY_NORMAL,   //!< what cellular_ctrl_at_callback() uses.
+    CELLULAR_CTRL_AT_CALLBACK_PRIORITY_LOW,      //!< e.g. "data is waiting" notifications.
+    CELLULAR_CTRL_AT_CALLBACK_NUM_PRIORITIES
+} cellular_ctrl_at_callback_priority_t;
+
+/** Statistics for the callbacks queue, accumulated since the AT
+ * client was initialised or cellular_ctrl_at_callback_stats_reset()
+ * was last called; each array is indexed by
+ * cellular_ctrl_at_callback_priority_t.
+ */
+typedef struct {
+    uint32_t queued[CELLULAR_CTRL_AT_CALLBACK_NUM_PRIORITIES];    //!< callbacks queued.
+    uint32_t coalesced[CELLULAR_CTRL_AT_CALLBACK_NUM_PRIORITIES]; //!< callbacks already waiting and so not queued again.
+    uint32_t overflows[CELLULAR_CTRL_AT_CALLBACK_NUM_PRIORITIES]; //!< callbacks thrown away because the queue was full.
+    uint32_t max_pending;  //!< the most callbacks ever waiting at once.
+} cellular_ctrl_at_callback_stats_t;
+
+/** The classes of AT command for the purposes of the delay
+ * before sending, see cellular_ctrl_at_set_send_delay_class().
+ */
+typedef enum {
+    CELLULAR_CTRL_AT_SEND_DELAY_CLASS_CONFIG = 0, //!< the default: configuration, queries, etc.
+    CELLULAR_CTRL_AT_SEND_DELAY_CLASS_DATA,       //!< moving user data, e.g. AT+USOWR.
+    CELLULAR_CTRL_AT_SEND_DELAY_NUM_CLASSES
+} cellular_ctrl_at_send_delay_class_t;
+
+/** Time spent in the various stages of AT command handling,
+ * accumulated since the AT client was initialised or
+ * cellular_ctrl_at_timing_reset() was last called.  All
+ * times are in milliseconds and hence coarse for any single
+ * command; they are intended to be read across many.
+ */
+typedef struct {
+    uint32_t num_commands;   //!< commands started.
+    int64_t command_ms;      //!< from sending a command to the end of its response.
+    int64_t tx_ms;           //!< writing to the UART.
+    int64_t prompt_wait_ms;  //!< in cellular_ctrl_at_wait_char().
+    uint32_t num_urcs;       //!< URCs handled.
+    int64_t urc_ms;          //!< in URC handlers.
+} cellular_ctrl_at_timing_t;
+
+/** The tasks of an AT client, see cellular_ctrl_at_task_stats_get().
+ */
+typedef enum {
+    CELLULAR_CTRL_AT_TASK_URC = 0,   //!< the URC task, in which URC handlers run.
+    CELLULAR_CTRL_AT_TASK_CALLBACKS, //!< the call-backs task, in which user callbacks run.
+    CELLULAR_CTRL_AT_NUM_TASKS
+} cellular_ctrl_at_task_t;
+
+/** Statistics for one of the tasks of an AT client; busy time
+ * is accumulated since the AT client was initialised or
+ * cellular_ctrl_at_task_stats_reset() was last called, the
+ * stack figure is over the lifetime of the task.  A large
+ * max_busy_ms for the URC task means that it is likely holding
+ * up application tasks of a lower priority.
+ */
+typedef struct {
+    int32_t stack_min_free_bytes; //!< the least stack ever free, from cellularPortTaskStackMinFree().
+    uint32_t num_runs;            //!< times the task woke up to do something.
+    int64_t busy_ms;              //!< total time spent doing something rather than waiting.
+    int32_t max_busy_ms;          //!< the longest time spent doing something at one go.
+} cellular_ctrl_at_task_stats_t;
+
+/** Statistics for one AT command, covering the time from
+ * cellular_ctrl_at_cmd_start() to cellular_ctrl_at_resp_stop().
+ */
+typedef struct {
+    char prefix[CELLULAR_CTRL_AT_STATS_PREFIX_LENGTH + 1]; //!< e.g. "AT+USORD", "*" for all the others.
+    uint32_t count;      //!< times the command was sent.
+    uint32_t errors;     //!< times the command ended in error, including time-outs.
+    uint32_t timeouts;   //!< times the command timed out.
+    uint32_t bytes_tx;   //!< bytes sent, including any data after a prompt.
+    uint32_t bytes_rx;   //!< bytes received, including any URCs that turned up.
+    int64_t total_ms;    //!< total time taken.
+    int32_t max_ms;      //!< longest time taken.
+    uint32_t histogram[CELLULAR_CTRL_AT_STATS_HISTOGRAM_NUM_BUCKETS]; //!< see CELLULAR_CTRL_AT_STATS_HISTOGRAM_BASE_MS.
+} cellular_ctrl_at_stats_t;
+
+/** Statistics for one URC handler, accumulated since it was
+ * set or cellular_ctrl_at_urc_stats_reset() was last called.
+ * The time includes reading to the end of the URC line after
+ * the handler has returned.
+ */
+typedef struct {
+    char prefix[CELLULAR_CTRL_AT_STATS_PREFIX_LENGTH + 1]; //!< e.g. "+UUSORD:", truncated if need be.
+    uint32_t count;       //!< times the handler was called.
+    int64_t total_ms;     //!< total time taken.
+    int32_t max_ms;       //!< longest time taken.
+    uint32_t over_budget; //!< times the handler took longer than CELLULAR_CFG_CTRL_AT_URC_BUDGET_MS.
+} cellular_ctrl_at_urc_stats_t;
+
+/** An AT client, the contents of which are private to the
+ * implementation.
+ */
+typedef struct cellular_ctrl_at_client_t cellular_ctrl_at_client_t;
+
 /* ----------------------------------------------------------------
  * VARIABLES
  * -------------------------------------------------------------- */
@@ -94,6 +228,22 @@ cellular_ctrl_at_error_code_t cellular_ctrl_at_init(int32_t uart,
  */
 void cellular_ctrl_at_deinit();
 
+/** Move the AT client to a different UART, e.g. onto a CMUX
+ * virtual UART (see cellular_ctrl_cmux.h) once CMUX has been
+ * started, or back to the physical UART when it is stopped.
+ * Anything buffered from the old UART is thrown away.  This
+ * must be called with the AT interface locked (i.e. between
+ * cellular_ctrl_at_lock() and cellular_ctrl_at_unlock()) so
+ * that nothing is in progress on the old UART.
+ *
+ * @param uart             the UART to use.
+ * @param queue_uart       the event queue associated with the UART.
+ * @return                 zero on success, otherwise negative error
+ *                         code.
+ */
+cellular_ctrl_at_error_code_t cellular_ctrl_at_set_uart(int32_t uart,
+                                                        CellularPortQueueHandle_t queue_uart);
+
 /** Get whether general debug prints are on or off.
  *
  * @return  true if debug prints are on, else false.
@@ -121,15 +271,47 @@ bool cellular_ctrl_at_print_at_get();
  */
 void cellular_ctrl_at_print_at_set(bool onNotOff);
 
+/** Get whether capture of everything sent and received is
+ * on or off.
+ *
+ * @return  true if capture is on, else false.
+ */
+bool cellular_ctrl_at_capture_get();
+
+/** Switch capture of everything sent and received on or off.
+ * Unlike the printing of AT commands and responses the capture
+ * is complete and keeps the chunking of the data as it passed
+ * through the UART, so that it can be played back exactly by
+ * cellular_sim and cellular_replay on the POSIX platform.  Each
+ * chunk is logged, in pieces of up to 32 bytes, as lines of
+ * the form:
+ *
+ * CELLULAR_AT_CAPTURE: <time ms> <uart> <TX|RX> <length> <offset> <hex>
+ *
+ * where length is that of the whole chunk and offset is where
+ * in the chunk the hex data of this line begins; anything
+ * ahead of CELLULAR_AT_CAPTURE: on a line is ignored, so the
+ * capture can be taken from a log with other things in it.
+ * Logging every byte in hex is slow: this is for capturing
+ * traffic to be played back later, not for leaving on.
+ *
+ * @param onNotOff  set to true to capture, else false.
+ */
+void cellular_ctrl_at_capture_set(bool onNotOff);
+
 /** Set the handler for a URC. If the URC is found when parsing AT
  * responses, then the handler is called.  If a handler is
- * already set then this is ignored.
+ * already set then this is ignored.  Where one prefix begins
+ * with another, e.g. "+UUMQTTSNC:" and "+UUMQTT", the longer
+ * is tried first, whichever order they were set in.
  * IMPORTANT: don't do anything heavy in a handler, e.g. don't
  * printf() or, at most, print a few characters; URC handlers have
  * to run quickly as they are interleaved with everything else
- * in handling incoming UART data.  If you need to do anything
- * heavy then have your handler call cellular_ctrl_at_callback()
- * instead.
+ * in handling incoming UART data, with the AT stream locked.
+ * If you need to do anything heavy then have your handler read
+ * the parameters of the URC and pass them to
+ * cellular_ctrl_at_callback_data() instead.  How long each
+ * handler takes is recorded, see cellular_ctrl_at_urc_stats_get().
  *
  * @param prefix          register URC prefix for callback. URC
  *                        could be for example "+CMTI: ".
@@ -165,6 +347,68 @@ void cellular_ctrl_at_remove_urc_handler(const char *prefix);
 bool cellular_ctrl_at_callback(void (callback)(void *),
                                void *callback_param);
 
+/** As cellular_ctrl_at_callback() but with a priority: callbacks
+ * waiting at a higher priority are run first so that, for
+ * instance, a burst of "data is waiting" notifications can't hold
+ * up the handling of an AT time-out.  If coalesce is true and the
+ * same callback with the same parameter is already waiting at
+ * the same priority then it is not queued again, which suits
+ * callbacks that say "go and look" rather than carry news of
+ * their own.  A fixed number of callbacks may be waiting at each
+ * priority; if that is exceeded the callback is thrown away,
+ * false is returned and the overflow count for the priority in
+ * cellular_ctrl_at_callback_stats_get() is incremented.
+ *
+ * @param callback        the callback function.
+ * @param callback_param  the single callback parameter.
+ * @param priority        the priority of the callback.
+ * @param coalesce        true if the callback need not be
+ *                        queued again if it is already waiting.
+ * @return                true if the callback is waiting to
+ *                        be run, else false.
+ */
+bool cellular_ctrl_at_callback_priority(void (callback)(void *),
+                                        void *callback_param,
+                                        cellular_ctrl_at_callback_priority_t priority,
+                                        bool coalesce);
+
+/** As cellular_ctrl_at_callback_priority() but, rather than
+ * a pointer, the callback is passed a pointer to a copy of
+ * data_len bytes from p_data, made when the callback is queued;
+ * the copy is valid only until the callback returns.  This is
+ * for URC handlers: read the parameters of the URC into a local
+ * variable, hand them over with this and return, leaving the
+ * heavy work to be done in the callbacks task without the AT
+ * stream locked.  Coalescing compares the data as well as the
+ * callback.
+ *
+ * @param callback  the callback function.
+ * @param p_data    the data to copy; may be NULL if data_len
+ *                  is zero.
+ * @param data_len  the number of bytes at p_data, at most
+ *                  CELLULAR_CTRL_AT_CALLBACK_DATA_MAX_LENGTH_BYTES.
+ * @param priority  the priority of the callback.
+ * @param coalesce  true if the callback need not be queued
+ *                  again if it is already waiting with the
+ *                  same data.
+ * @return          true if the callback is waiting to be run,
+ *                  else false.
+ */
+bool cellular_ctrl_at_callback_data(void (callback)(void *),
+                                    const void *p_data, size_t data_len,
+                                    cellular_ctrl_at_callback_priority_t priority,
+                                    bool coalesce);
+
+/** Get the statistics for the callbacks queue.
+ *
+ * @param p_stats a place to put the statistics.
+ */
+void cellular_ctrl_at_callback_stats_get(cellular_ctrl_at_callback_stats_t *p_stats);
+
+/** Reset the statistics for the callbacks queue.
+ */
+void cellular_ctrl_at_callback_stats_reset();
+
 /** returns the last error while parsing AT responses.
  *
  * @return last error.
@@ -215,11 +459,131 @@ void cellular_ctrl_at_set_at_timeout(uint32_t timeout_milliseconds,
  */
 void cellular_ctrl_at_set_at_timeout_callback(void (callback)(void *));
 
+/** Set a callback that will be called to wake the module up
+ * if it has been marked as asleep with
+ * cellular_ctrl_at_set_asleep(), e.g. because it has entered
+ * 3GPP power saving mode.  The callback is made from inside
+ * cellular_ctrl_at_lock(), i.e. with the UART stream already
+ * locked, the next time anyone wants to talk to the module,
+ * hence sockets etc. carry on without knowing that the module
+ * was ever asleep.  The callback must NOT call
+ * cellular_ctrl_at_lock() or cellular_ctrl_at_unlock() but
+ * may otherwise send AT commands and read their responses.
+ *
+ * @param callback        the callback; use NULL to cancel
+ *                        a previous callback.
+ * @param callback_param  a parameter to pass to the callback.
+ */
+void cellular_ctrl_at_set_wake_up_callback(void (*callback)(void *),
+                                           void *callback_param);
+
+/** Set a function that the callbacks task (see
+ * cellular_ctrl_at_callback()) calls, over and over, whenever
+ * it has no callbacks to run; this allows a long-running job,
+ * written as a series of short steps, to run in the background.
+ * Each call should return within a second or so since, while it
+ * runs, queued callbacks have to wait.  The poll function may
+ * cancel itself by calling this function with NULL but must
+ * not set a different poll function.
+ *
+ * @param poll       the poll function; use NULL to cancel.
+ * @param poll_param a parameter to pass to the poll function.
+ */
+void cellular_ctrl_at_set_callbacks_poll(void (*poll)(void *),
+                                         void *poll_param);
+
+/** Mark the module as asleep or awake.  This may be called
+ * from a URC handler.  While the module is asleep and nothing
+ * is arriving from it the AT client suspends the UART, on
+ * platforms that support it, to save power: see
+ * cellularPortUartSuspend().
+ *
+ * @param asleep true if the module is asleep, else false.
+ */
+void cellular_ctrl_at_set_asleep(bool asleep);
+
+/** Get whether the module is marked as asleep.
+ *
+ * @return true if the module is asleep, else false.
+ */
+bool cellular_ctrl_at_is_asleep();
+
+/** Mark the AT link as being recovered, e.g. because the module
+ * has stopped answering, or as back to normal.  While it is being
+ * recovered cellular_ctrl_at_lock() called from any task other
+ * than the callbacks task (see cellular_ctrl_at_callback()) sets
+ * an error straight away, as in direct-link mode, so that callers
+ * fail at once rather than each waiting for a timeout; the
+ * recovery itself must be run by the callbacks task, e.g. from
+ * a function set with cellular_ctrl_at_set_callbacks_poll().
+ *
+ * @param recovering true if the AT link is being recovered,
+ *                   else false.
+ */
+void cellular_ctrl_at_set_recovering(bool recovering);
+
+/** Get whether the AT link is marked as being recovered.
+ *
+ * @return true if the AT link is being recovered, else false.
+ */
+bool cellular_ctrl_at_is_recovering();
+
 /** Restore timeout to previous timeout. Handy if there is
  * a need to change timeout temporarily.
  */
 void cellular_ctrl_at_restore_at_timeout();
 
+/** Set the delay between the end of the last response and
+ * sending a new AT command.  This is the delay that applies at
+ * the outset and after any command fails or times out; while
+ * commands keep succeeding the delay for each class of command
+ * shrinks, halving the distance each time, towards the minimum
+ * set with cellular_ctrl_at_set_send_delay_min().
+ *
+ * @param delay_ms the delay in milliseconds; zero for none.
+ */
+void cellular_ctrl_at_set_send_delay(uint32_t delay_ms);
+
+/** Get the delay between the end of the last response and
+ * sending a new AT command, as set with
+ * cellular_ctrl_at_set_send_delay().
+ *
+ * @return the delay in milliseconds.
+ */
+uint32_t cellular_ctrl_at_get_send_delay();
+
+/** Set the minimum that the delay before sending a command of a
+ * given class may shrink to while commands keep succeeding.  The
+ * defaults are CELLULAR_CFG_CTRL_AT_SEND_DELAY_MIN_MS and
+ * CELLULAR_CFG_CTRL_AT_SEND_DELAY_DATA_MIN_MS; setting the
+ * minimum to the value passed to cellular_ctrl_at_set_send_delay()
+ * fixes the delay for that class.
+ *
+ * @param delay_class the class of command.
+ * @param delay_ms    the minimum delay in milliseconds; this is
+ *                    capped at the value passed to
+ *                    cellular_ctrl_at_set_send_delay().
+ */
+void cellular_ctrl_at_set_send_delay_min(cellular_ctrl_at_send_delay_class_t delay_class,
+                                         uint32_t delay_ms);
+
+/** Set the class of the next command sent, for the purposes of
+ * the delay before sending it; after that command the class
+ * returns to CELLULAR_CTRL_AT_SEND_DELAY_CLASS_CONFIG.  Call this
+ * between cellular_ctrl_at_lock() and cellular_ctrl_at_cmd_start().
+ *
+ * @param delay_class the class of the next command.
+ */
+void cellular_ctrl_at_set_send_delay_class(cellular_ctrl_at_send_delay_class_t delay_class);
+
+/** Get the delay that currently applies before sending a
+ * command of the given class.
+ *
+ * @param delay_class the class of command.
+ * @return            the delay in milliseconds.
+ */
+uint32_t cellular_ctrl_at_get_send_delay_now(cellular_ctrl_at_send_delay_class_t delay_class);
+
 /** Clear pending error flag. By default, error is cleared
  * only in at_lock().
  */
@@ -244,8 +608,12 @@ void cellular_ctrl_at_flush();
 bool cellular_ctrl_at_sync(int32_t timeout_ms);
 
 /** Starts the command writing by clearing the last error and
- * writing the given command. In case of failure when writing,
- * the last error is set to AT_DEVICE_ERROR.
+ * writing the given command.  The command and its
+ * sub-parameters are assembled in a buffer and go to the UART
+ * in one write at cellular_ctrl_at_cmd_stop() (or before
+ * anything is written with cellular_ctrl_at_write_bytes()).
+ * In case of failure when writing, the last error is set to
+ * AT_DEVICE_ERROR.
  *
  * @param cmd  AT command to be written to modem.
  */
@@ -283,8 +651,45 @@ void cellular_ctrl_at_write_uint64(uint64_t param);
  */
 void cellular_ctrl_at_write_string(const char *param, bool useQuotes);
 
+/** Writes binary data as a hex string AT command sub-parameter,
+ * e.g. "AV" as "4156", for commands that take binary data in hex
+ * form.  The data is encoded a byte at a time through a lookup
+ * table straight into the buffer in which the AT command is
+ * assembled, so no hex copy of the data need be made first.
+ * Starts with the delimiter if not the first param after
+ * cmd_start.  In case of failure when writing, the last error
+ * is set to AT_DEVICE_ERROR.
+ *
+ * @param data          the binary data.
+ * @param len           the number of bytes at data.
+ * @param useQuotes     flag indicating whether the hex string
+ *                      should be included in quotation marks.
+ */
+void cellular_ctrl_at_write_hex(const void *data, size_t len,
+                                bool useQuotes);
+
+/** Append a further command to the command line begun with
+ * cellular_ctrl_at_cmd_start(), separated from what went before by
+ * a semicolon, so that several commands go to the module as one
+ * command line, e.g. cellular_ctrl_at_cmd_start("AT+CGSN")
+ * followed by cellular_ctrl_at_cmd_append("+CIMI") sends
+ * "AT+CGSN;+CIMI".  Sub-parameters for the appended command may
+ * then be written as normal.  The module runs the commands in
+ * order, giving the information response of each in turn and a
+ * single "OK" at the end, or stopping with "ERROR" at the
+ * first one that fails; use cellular_ctrl_at_resp_next() to read
+ * each information response.  The whole command line must fit
+ * within the module's command line buffer (e.g. 544 characters
+ * for SARA-R4).
+ *
+ * @param cmd the command to append, without the "AT", e.g.
+ *            "+CIMI".
+ */
+void cellular_ctrl_at_cmd_append(const char *cmd);
+
 /** Stops the AT command by writing command-line terminator CR to
- * mark command as finished.
+ * mark command as finished and sends the assembled command to
+ * the UART.
  */
 void cellular_ctrl_at_cmd_stop();
 
@@ -398,21 +803,55 @@ int32_t cellular_ctrl_at_read_string(char *str, size_t size,
  */
 int32_t cellular_ctrl_at_read_hex_string(char *str, size_t size);
 
-/** Reads as string and converts result to integer. Supports
- * only positive integers.
+/** Reads an integer, parsing it directly from the received
+ * data. Supports only positive integers.
  *
  * @return the positive integer or -1 in case of error.
  */
 int32_t cellular_ctrl_at_read_int();
 
-/** Reads as string and converts result to uint64_t. Supports
- * only positive integers.
+/** Reads a uint64_t, parsing it directly from the received
+ * data. Supports only positive integers.
  *
  * @param uint64 a place to put the uint64_t.
  * @return       zero on success, -1 in case of error.
  */
 int32_t cellular_ctrl_at_read_uint64(uint64_t *uint64);
 
+/** Reads several sub-parameters of an information response
+ * in one call, according to a template, in place of a chain
+ * of cellular_ctrl_at_skip_param(), cellular_ctrl_at_read_int()
+ * and cellular_ctrl_at_read_string() calls.  If prefix is not
+ * NULL then cellular_ctrl_at_resp_start(prefix, false) is
+ * called first, otherwise reading carries on from the current
+ * position.  format contains one character per sub-parameter,
+ * optionally separated by commas for readability:
+ *
+ * - 'i': an integer, read into the int32_t * that follows,
+ * - 'u': a uint64_t, read into the uint64_t * that follows,
+ * - 's': a string, read into the char * that follows, of the
+ *        size given by the size_t that follows that,
+ * - '-': a sub-parameter to be skipped.
+ *
+ * A NULL pointer may be given to skip an 'i', 'u' or 's'
+ * sub-parameter.  A sub-parameter that cannot be read is
+ * returned as it would be by the individual functions: -1
+ * for 'i', unchanged for 'u' and an empty string for 's'.
+ * cellular_ctrl_at_resp_stop() must still be called at the
+ * end of the response.  For example:
+ *
+ * cellular_ctrl_at_read_fields("+USORF:", "-,s,i,i", NULL, 0,
+ *                              buf, sizeof(buf), &port, &len);
+ *
+ * @param prefix the prefix of the information response, or
+ *               NULL to carry on in the current one.
+ * @param format the template.
+ * @return       the number of sub-parameters in format that
+ *               were read successfully, skipped ones included.
+ */
+int32_t cellular_ctrl_at_read_fields(const char *prefix,
+                                     const char *format, ...);
+
 /** This looks for necessary matches: prefix, OK, ERROR, URCs
  * and sets the correct scope.
  *
@@ -426,6 +865,25 @@ int32_t cellular_ctrl_at_read_uint64(uint64_t *uint64);
  */
 void cellular_ctrl_at_resp_start(const char *prefix, bool stop);
 
+/** Move on to the information response of the next command on a
+ * command line assembled with cellular_ctrl_at_cmd_append(); call
+ * this in place of cellular_ctrl_at_resp_start() for every
+ * command on the line, including the first, then call
+ * cellular_ctrl_at_resp_stop() once at the end.  Whatever remains
+ * of the line of the previous information response is skipped
+ * and then prefix is looked for as cellular_ctrl_at_resp_start()
+ * would.  If prefix is NULL the next line is taken to be the
+ * information response and is put into information response
+ * scope, so that reads stop at its end rather than running on
+ * into the information responses that follow.  Once the final
+ * "OK" has been found any further calls do nothing and reads
+ * return errors.
+ *
+ * @param prefix the prefix of the information response, e.g.
+ *               "+CCID:", NULL if it has no prefix.
+ */
+void cellular_ctrl_at_resp_next(const char *prefix);
+
 /**  Ends all scopes starting from current scope.
  *   Consumes everything until the scope's stop tag is found,
  *   then goes to next scope until response scope is ending.
@@ -474,12 +932,420 @@ bool cellular_ctrl_at_consume_to_stop_tag();
  */
 bool cellular_ctrl_at_wait_char(char chr);
 
+/** Enter direct-link (transparent) mode: call this between
+ * cellular_ctrl_at_lock() and cellular_ctrl_at_unlock(),
+ * once the command that asks the module for direct-link mode
+ * (e.g. AT+USODL) has been sent, in place of reading the
+ * response.  It waits for the "CONNECT" that the module sends
+ * on entry.  From then until cellular_ctrl_at_direct_link_exit()
+ * the UART stream carries only raw data: the URC task
+ * leaves it alone and anything between cellular_ctrl_at_lock()
+ * and cellular_ctrl_at_unlock() fails with
+ * CELLULAR_CTRL_AT_DEVICE_ERROR.
+ *
+ * @return true if direct-link mode was entered, else false.
+ */
+bool cellular_ctrl_at_direct_link_enter();
+
+/** Write raw data over the direct link; do NOT call this
+ * between cellular_ctrl_at_lock() and cellular_ctrl_at_unlock().
+ *
+ * @param data the data to write.
+ * @param len  the number of bytes at data.
+ * @return     the number of bytes written or -1 if
+ *             direct-link mode is not active or the
+ *             write failed.
+ */
+int32_t cellular_ctrl_at_direct_link_write(const uint8_t *data,
+                                           size_t len);
+
+/** Read whatever raw data is available from the direct link,
+ * without waiting; do NOT call this between
+ * cellular_ctrl_at_lock() and cellular_ctrl_at_unlock().
+ *
+ * @param buf the place to put the data.
+ * @param len the amount of storage at buf.
+ * @return    the number of bytes read, which may be zero,
+ *            or -1 if direct-link mode is not active.
+ */
+int32_t cellular_ctrl_at_direct_link_read(uint8_t *buf, size_t len);
+
+/** Leave direct-link mode by sending the escape sequence,
+ * "+++", with a period of silence either side, and waiting
+ * for the "DISCONNECT" from the module, throwing away any
+ * raw data that arrives in the meantime.  Does nothing if
+ * direct-link mode is not active.  Do NOT call this between
+ * cellular_ctrl_at_lock() and cellular_ctrl_at_unlock().
+ *
+ * @param guard_time_ms the period of silence required either
+ *                      side of the escape sequence, which
+ *                      must be longer than that configured
+ *                      in the module (S12, one second by
+ *                      default).
+ * @return              true if direct-link mode was left
+ *                      cleanly, else false.
+ */
+bool cellular_ctrl_at_direct_link_exit(int32_t guard_time_ms);
+
+/** Send the escape sequence, "+++", with a period of silence
+ * either side, whether or not direct-link mode is thought to be
+ * active, then throw away whatever the module sends back.  This
+ * is for bringing back a module that has stopped answering AT
+ * commands because it has been left in a data mode; it does not
+ * check that the module answers afterwards, use
+ * cellular_ctrl_at_sync() for that.  Do NOT call this between
+ * cellular_ctrl_at_lock() and cellular_ctrl_at_unlock().
+ *
+ * @param guard_time_ms the period of silence required either
+ *                      side of the escape sequence, as for
+ *                      cellular_ctrl_at_direct_link_exit().
+ */
+void cellular_ctrl_at_escape(int32_t guard_time_ms);
+
 /** Return the last 3GPP error code.
  *
  * @return last 3GPP error code.
  */
 int32_t cellular_ctrl_at_get_3gpp_error();
 
+/** Print out the AT trace, oldest record first; does nothing
+ * if CELLULAR_CFG_CTRL_AT_TRACE_NUM_RECORDS is 0.  Each record
+ * is one AT command or one chunk of received data, truncated
+ * to the record size but with the full length shown.
+ * Note that this locks the UART stream while it prints, do
+ * NOT call it between at_lock() and at_unlock().
+ */
+void cellular_ctrl_at_trace_print();
+
+/** Empty the AT trace.
+ */
+void cellular_ctrl_at_trace_clear();
+
+/** Get the statistics for an AT command; does nothing if
+ * CELLULAR_CFG_CTRL_AT_STATS_NUM_COMMANDS is 0.  Commands are
+ * added in the order they are first sent so index can be
+ * counted up from zero until an error is returned to
+ * retrieve all of them.
+ *
+ * @param index   the index of the command.
+ * @param p_stats a place to put the statistics; cannot be NULL.
+ * @return        zero on success else negative error code.
+ */
+int32_t cellular_ctrl_at_stats_get(size_t index,
+                                   cellular_ctrl_at_stats_t *p_stats);
+
+/** Reset the AT command statistics.
+ */
+void cellular_ctrl_at_stats_reset();
+
+/** Get the accumulated AT stage timings.
+ *
+ * @param p_timing a place to put the timings; cannot be NULL.
+ */
+void cellular_ctrl_at_timing_get(cellular_ctrl_at_timing_t *p_timing);
+
+/** Reset the accumulated AT stage timings to zero.
+ */
+void cellular_ctrl_at_timing_reset();
+
+/** Get the statistics for one of the tasks of the AT client.
+ *
+ * @param task    the task.
+ * @param p_stats a place to put the statistics; cannot be NULL.
+ * @return        zero on success else negative error code.
+ */
+int32_t cellular_ctrl_at_task_stats_get(cellular_ctrl_at_task_t task,
+                                        cellular_ctrl_at_task_stats_t *p_stats);
+
+/** Reset the busy-time statistics of the tasks of the AT client;
+ * the stack figures cannot be reset.
+ */
+void cellular_ctrl_at_task_stats_reset();
+
+/** Get the statistics for a URC handler.  Handlers are indexed
+ * most recently set first so index can be counted up from zero
+ * until an error is returned to retrieve all of them.
+ * Note that this locks the UART stream, do NOT call it between
+ * at_lock() and at_unlock().
+ *
+ * @param index   the index of the URC handler.
+ * @param p_stats a place to put the statistics; cannot be NULL.
+ * @return        zero on success else negative error code.
+ */
+int32_t cellular_ctrl_at_urc_stats_get(size_t index,
+                                       cellular_ctrl_at_urc_stats_t *p_stats);
+
+/** Reset the statistics of all of the URC handlers.
+ */
+void cellular_ctrl_at_urc_stats_reset();
+
+/* ----------------------------------------------------------------
+ * FUNCTIONS: EXPLICIT AT CLIENT
+ * -------------------------------------------------------------- */
+
+/** Create an AT client on its own UART, e.g. a CMUX virtual UART
+ * or the UART of a second module; the client has its own URC and
+ * call-backs tasks, buffers and state, entirely separate from the
+ * default AT client that the functions above work on.
+ *
+ * @param uart       the UART to use; this must have already been
+ *                   configured by the caller.
+ * @param queue_uart the event queue associated with the UART,
+ *                   which must have already been set up by the
+ *                   caller.
+ * @return           the AT client or NULL on failure.
+ */
+cellular_ctrl_at_client_t *cellular_ctrl_at_client_create(int32_t uart,
+                                                          CellularPortQueueHandle_t queue_uart);
+
+/** Destroy an AT client created with
+ * cellular_ctrl_at_client_create(), shutting it down first.
+ *
+ * @param at the AT client; may be NULL.
+ */
+void cellular_ctrl_at_client_destroy(cellular_ctrl_at_client_t *at);
+
+/** Get the default AT client, the one that the functions
+ * which do not take an AT client as a parameter work on.
+ *
+ * @return the default AT client.
+ */
+cellular_ctrl_at_client_t *cellular_ctrl_at_client_default();
+
+/** The functions below are the equivalent of those above of the
+ * same name without "_client", with the AT client to use as the
+ * first parameter.  Note that a URC handler or a call-back for a
+ * client other than the default one must use these functions
+ * to talk to that client; the simplest way is to pass the client
+ * as the handler's parameter.
+ */
+
+cellular_ctrl_at_error_code_t cellular_ctrl_at_client_init(cellular_ctrl_at_client_t *at,
+                                                           int32_t uart,
+                                                           CellularPortQueueHandle_t queue_uart);
+
+cellular_ctrl_at_error_code_t cellular_ctrl_at_client_set_uart(cellular_ctrl_at_client_t *at,
+                                                               int32_t uart,
+                                                               CellularPortQueueHandle_t queue_uart);
+
+void cellular_ctrl_at_client_deinit(cellular_ctrl_at_client_t *at);
+
+bool cellular_ctrl_at_client_debug_get(cellular_ctrl_at_client_t *at);
+
+void cellular_ctrl_at_client_debug_set(cellular_ctrl_at_client_t *at, bool onNotOff);
+
+bool cellular_ctrl_at_client_print_at_get(cellular_ctrl_at_client_t *at);
+
+void cellular_ctrl_at_client_print_at_set(cellular_ctrl_at_client_t *at, bool onNotOff);
+
+bool cellular_ctrl_at_client_capture_get(cellular_ctrl_at_client_t *at);
+
+void cellular_ctrl_at_client_capture_set(cellular_ctrl_at_client_t *at, bool onNotOff);
+
+cellular_ctrl_at_error_code_t cellular_ctrl_at_client_set_urc_handler(cellular_ctrl_at_client_t *at,
+                                                                      const char *prefix,
+                                                                      void (callback) (void *),
+                                                                      void *callback_param);
+
+void cellular_ctrl_at_client_remove_urc_handler(cellular_ctrl_at_client_t *at,
+                                                const char *prefix);
+
+bool cellular_ctrl_at_client_callback(cellular_ctrl_at_client_t *at,
+                                      void (callback)(void *),
+                                          void *callback_param);
+
+bool cellular_ctrl_at_client_callback_priority(cellular_ctrl_at_client_t *at,
+                                               void (callback)(void *),
+                                               void *callback_param,
+                                               cellular_ctrl_at_callback_priority_t priority,
+                                               bool coalesce);
+
+bool cellular_ctrl_at_client_callback_data(cellular_ctrl_at_client_t *at,
+                                           void (callback)(void *),
+                                           const void *p_data, size_t data_len,
+                                           cellular_ctrl_at_callback_priority_t priority,
+                                           bool coalesce);
+
+void cellular_ctrl_at_client_callback_stats_get(cellular_ctrl_at_client_t *at,
+                                                cellular_ctrl_at_callback_stats_t *p_stats);
+
+void cellular_ctrl_at_client_callback_stats_reset(cellular_ctrl_at_client_t *at);
+
+void cellular_ctrl_at_client_lock(cellular_ctrl_at_client_t *at);
+
+void cellular_ctrl_at_client_unlock(cellular_ctrl_at_client_t *at);
+
+cellular_ctrl_at_error_code_t cellular_ctrl_at_client_unlock_return_error(cellular_ctrl_at_client_t *at);
+
+void cellular_ctrl_at_client_set_at_timeout(cellular_ctrl_at_client_t *at,
+                                            uint32_t timeout_milliseconds,
+                                            bool default_timeout);
+
+void cellular_ctrl_at_client_set_at_timeout_callback(cellular_ctrl_at_client_t *at,
+                                                     void (callback)(void *));
+
+void cellular_ctrl_at_client_set_wake_up_callback(cellular_ctrl_at_client_t *at,
+                                                  void (*callback)(void *),
+                                                  void *callback_param);
+
+void cellular_ctrl_at_client_set_callbacks_poll(cellular_ctrl_at_client_t *at,
+                                                void (*poll)(void *),
+                                                void *poll_param);
+
+void cellular_ctrl_at_client_set_asleep(cellular_ctrl_at_client_t *at, bool asleep);
+
+bool cellular_ctrl_at_client_is_asleep(cellular_ctrl_at_client_t *at);
+
+void cellular_ctrl_at_client_set_recovering(cellular_ctrl_at_client_t *at,
+                                            bool recovering);
+
+bool cellular_ctrl_at_client_is_recovering(cellular_ctrl_at_client_t *at);
+
+void cellular_ctrl_at_client_restore_at_timeout(cellular_ctrl_at_client_t *at);
+
+void cellular_ctrl_at_client_set_send_delay(cellular_ctrl_at_client_t *at,
+                                            uint32_t delay_ms);
+
+uint32_t cellular_ctrl_at_client_get_send_delay(cellular_ctrl_at_client_t *at);
+
+void cellular_ctrl_at_client_set_send_delay_min(cellular_ctrl_at_client_t *at,
+                                                cellular_ctrl_at_send_delay_class_t delay_class,
+                                                uint32_t delay_ms);
+
+void cellular_ctrl_at_client_set_send_delay_class(cellular_ctrl_at_client_t *at,
+                                                  cellular_ctrl_at_send_delay_class_t delay_class);
+
+uint32_t cellular_ctrl_at_client_get_send_delay_now(cellular_ctrl_at_client_t *at,
+                                                    cellular_ctrl_at_send_delay_class_t delay_class);
+
+void cellular_ctrl_at_client_skip_len(cellular_ctrl_at_client_t *at,
+                                      int32_t len, uint32_t count);
+
+void cellular_ctrl_at_client_skip_param(cellular_ctrl_at_client_t *at, uint32_t count);
+
+int32_t cellular_ctrl_at_client_read_bytes(cellular_ctrl_at_client_t *at,
+                                           uint8_t *buf, size_t len);
+
+int32_t cellular_ctrl_at_client_read_string(cellular_ctrl_at_client_t *at,
+                                            char *buf, size_t size,
+                                            bool read_even_stop_tag);
+
+int32_t cellular_ctrl_at_client_read_hex_string(cellular_ctrl_at_client_t *at,
+                                                char *buf, size_t size);
+
+int32_t cellular_ctrl_at_client_read_int(cellular_ctrl_at_client_t *at);
+
+int32_t cellular_ctrl_at_client_read_uint64(cellular_ctrl_at_client_t *at,
+                                            uint64_t *uint64);
+
+int32_t cellular_ctrl_at_client_read_fields(cellular_ctrl_at_client_t *at,
+                                            const char *prefix,
+                                            const char *format, ...);
+
+void cellular_ctrl_at_client_set_delimiter(cellular_ctrl_at_client_t *at, char delimiter);
+
+void cellular_ctrl_at_client_set_default_delimiter(cellular_ctrl_at_client_t *at);
+
+void cellular_ctrl_at_client_use_delimiter(cellular_ctrl_at_client_t *at,
+                                           bool use_delimiter);
+
+void cellular_ctrl_at_client_set_stop_tag(cellular_ctrl_at_client_t *at,
+                                          const char *stop_tag_seq);
+
+void cellular_ctrl_at_client_clear_error(cellular_ctrl_at_client_t *at);
+
+cellular_ctrl_at_error_code_t cellular_ctrl_at_client_get_last_error(cellular_ctrl_at_client_t *at);
+
+cellular_ctrl_at_device_err_t cellular_ctrl_at_client_get_last_device_error(cellular_ctrl_at_client_t *at);
+
+int32_t cellular_ctrl_at_client_get_3gpp_error(cellular_ctrl_at_client_t *at);
+
+void cellular_ctrl_at_client_resp_start(cellular_ctrl_at_client_t *at,
+                                        const char *prefix, bool stop);
+
+bool cellular_ctrl_at_client_info_resp(cellular_ctrl_at_client_t *at);
+
+bool cellular_ctrl_at_client_info_elem(cellular_ctrl_at_client_t *at, char start_tag);
+
+bool cellular_ctrl_at_client_consume_to_stop_tag(cellular_ctrl_at_client_t *at);
+
+void cellular_ctrl_at_client_resp_next(cellular_ctrl_at_client_t *at,
+                                       const char *prefix);
+
+void cellular_ctrl_at_client_resp_stop(cellular_ctrl_at_client_t *at);
+
+void cellular_ctrl_at_client_cmd_start(cellular_ctrl_at_client_t *at, const char *cmd);
+
+void cellular_ctrl_at_client_write_uint64(cellular_ctrl_at_client_t *at, uint64_t param);
+
+void cellular_ctrl_at_client_write_int(cellular_ctrl_at_client_t *at, int32_t param);
+
+void cellular_ctrl_at_client_write_string(cellular_ctrl_at_client_t *at,
+                                          const char *param,
+                                          bool useQuotations);
+
+void cellular_ctrl_at_client_write_hex(cellular_ctrl_at_client_t *at,
+                                       const void *data, size_t len,
+                                       bool useQuotations);
+
+void cellular_ctrl_at_client_cmd_append(cellular_ctrl_at_client_t *at,
+                                        const char *cmd);
+
+void cellular_ctrl_at_client_cmd_stop(cellular_ctrl_at_client_t *at);
+
+void cellular_ctrl_at_client_cmd_stop_read_resp(cellular_ctrl_at_client_t *at);
+
+size_t cellular_ctrl_at_client_write_bytes(cellular_ctrl_at_client_t *at,
+                                           const uint8_t *data, size_t len);
+
+void cellular_ctrl_at_client_flush(cellular_ctrl_at_client_t *at);
+
+bool cellular_ctrl_at_client_sync(cellular_ctrl_at_client_t *at, int32_t timeout_ms);
+
+bool cellular_ctrl_at_client_wait_char(cellular_ctrl_at_client_t *at, char chr);
+
+bool cellular_ctrl_at_client_direct_link_enter(cellular_ctrl_at_client_t *at);
+
+int32_t cellular_ctrl_at_client_direct_link_write(cellular_ctrl_at_client_t *at,
+                                                  const uint8_t *data,
+                                                  size_t len);
+
+int32_t cellular_ctrl_at_client_direct_link_read(cellular_ctrl_at_client_t *at,
+                                                 uint8_t *buf, size_t len);
+
+bool cellular_ctrl_at_client_direct_link_exit(cellular_ctrl_at_client_t *at,
+                                              int32_t guard_time_ms);
+
+void cellular_ctrl_at_client_escape(cellular_ctrl_at_client_t *at,
+                                    int32_t guard_time_ms);
+
+void cellular_ctrl_at_client_trace_print(cellular_ctrl_at_client_t *at);
+
+void cellular_ctrl_at_client_trace_clear(cellular_ctrl_at_client_t *at);
+
+int32_t cellular_ctrl_at_client_stats_get(cellular_ctrl_at_client_t *at,
+                                          size_t index,
+                                          cellular_ctrl_at_stats_t *p_stats);
+
+void cellular_ctrl_at_client_stats_reset(cellular_ctrl_at_client_t *at);
+
+void cellular_ctrl_at_client_timing_get(cellular_ctrl_at_client_t *at,
+                                        cellular_ctrl_at_timing_t *p_timing);
+
+void cellular_ctrl_at_client_timing_reset(cellular_ctrl_at_client_t *at);
+
+int32_t cellular_ctrl_at_client_task_stats_get(cellular_ctrl_at_client_t *at,
+                                               cellular_ctrl_at_task_t task,
+                                               cellular_ctrl_at_task_stats_t *p_stats);
+
+void cellular_ctrl_at_client_task_stats_reset(cellular_ctrl_at_client_t *at);
+
+int32_t cellular_ctrl_at_client_urc_stats_get(cellular_ctrl_at_client_t *at,
+                                              size_t index,
+                                              cellular_ctrl_at_urc_stats_t *p_stats);
+
+void cellular_ctrl_at_client_urc_stats_reset(cellular_ctrl_at_client_t *at);
+
 #ifdef __cplusplus
 }
 #endif
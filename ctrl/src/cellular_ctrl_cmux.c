@@ -0,0 +1,1103 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Only #includes of cellular_* are allowed here, no C lib,
+ * no platform stuff and no OS stuff.  Anything required from
+ * the platform/C library/OS must be brought in through
+ * cellular_port* to maintain portability.
+ */
+
+// The log level threshold of this module, see cellular_port_debug.h.
+#define CELLULAR_PORT_LOG_THRESHOLD CELLULAR_CFG_LOG_LEVEL_CTRL
+
+#ifdef CELLULAR_CFG_OVERRIDE
+# include "cellular_cfg_override.h" // For a customer's configuration override
+#endif
+#include "cellular_cfg_sw.h"
+#include "cellular_cfg_os_platform_specific.h"
+#include "cellular_port_clib.h"
+#include "cellular_port.h"
+#include "cellular_port_debug.h"
+#include "cellular_port_os.h"
+#include "cellular_port_uart.h"
+#include "cellular_ctrl_cmux.h"
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS
+ * -------------------------------------------------------------- */
+
+/** The flag that starts and ends every basic option frame.
+ */
+#define CELLULAR_CTRL_CMUX_FLAG 0xF9
+
+/** The EA (extension) bit, set in the last octet of a field.
+ */
+#define CELLULAR_CTRL_CMUX_EA 0x01
+
+/** The C/R (command/response) bit of the address octet and of
+ * the type octet of a control channel message.
+ */
+#define CELLULAR_CTRL_CMUX_CR 0x02
+
+/** The P/F (poll/final) bit of the control octet.
+ */
+#define CELLULAR_CTRL_CMUX_PF 0x10
+
+/** Frame types, as carried in the control octet without the
+ * P/F bit.
+ */
+#define CELLULAR_CTRL_CMUX_FRAME_SABM 0x2F
+#define CELLULAR_CTRL_CMUX_FRAME_UA   0x63
+#define CELLULAR_CTRL_CMUX_FRAME_DM   0x0F
+#define CELLULAR_CTRL_CMUX_FRAME_DISC 0x43
+#define CELLULAR_CTRL_CMUX_FRAME_UIH  0xEF
+
+/** Control channel message types, as carried in the type octet
+ * with EA set and C/R clear.
+ */
+#define CELLULAR_CTRL_CMUX_MSG_CLD 0xC1
+#define CELLULAR_CTRL_CMUX_MSG_MSC 0xE1
+
+/** The V.24 signals octet sent in an MSC command when a channel
+ * is opened: DV, RTR and RTC set, flow control off.
+ */
+#define CELLULAR_CTRL_CMUX_MSC_SIGNALS 0x8D
+
+/** The largest DLCI that the address octet can carry.
+ */
+#define CELLULAR_CTRL_CMUX_DLCI_MAX 63
+
+/** The FCS of a correctly received frame, when calculated
+ * across the header and the received FCS.
+ */
+#define CELLULAR_CTRL_CMUX_FCS_GOOD 0xCF
+
+/** Room needed in the transmit buffer beyond the information
+ * field: opening flag, address, control, two length octets,
+ * FCS and closing flag.
+ */
+#define CELLULAR_CTRL_CMUX_FRAME_OVERHEAD 7
+
+/** How long to wait for the module to respond to a SABM or
+ * DISC frame, T1 in 3GPP 27.010 (which defaults to 100 ms but
+ * a module may be busy for rather longer than that).
+ */
+#define CELLULAR_CTRL_CMUX_RESPONSE_TIMEOUT_MS 3000
+
+/** The number of times to send a SABM or DISC frame before
+ * giving up, N2 in 3GPP 27.010.
+ */
+#define CELLULAR_CTRL_CMUX_RETRIES 3
+
+/** How often demuxTaskStop() repeats the wake-up it sends to
+ * the demultiplexer task, which blocks on the physical UART
+ * event queue indefinitely: while the AT client is being moved
+ * back on to the physical UART it may take the wake-up.
+ */
+#define CELLULAR_CTRL_CMUX_STOP_WAIT_MS 100
+
+/** The size of the chunks in which the demultiplexer task reads
+ * from the physical UART.
+ */
+#define CELLULAR_CTRL_CMUX_READ_CHUNK_SIZE 64
+
+/* ----------------------------------------------------------------
+ * TYPES
+ * -------------------------------------------------------------- */
+
+/** The states of the receive frame decoder.
+ */
+typedef enum {
+    CELLULAR_CTRL_CMUX_RX_STATE_FLAG,
+    CELLULAR_CTRL_CMUX_RX_STATE_ADDRESS,
+    CELLULAR_CTRL_CMUX_RX_STATE_CONTROL,
+    CELLULAR_CTRL_CMUX_RX_STATE_LENGTH,
+    CELLULAR_CTRL_CMUX_RX_STATE_LENGTH_2,
+    CELLULAR_CTRL_CMUX_RX_STATE_INFO,
+    CELLULAR_CTRL_CMUX_RX_STATE_FCS,
+    CELLULAR_CTRL_CMUX_RX_STATE_CLOSING_FLAG
+} CellularCtrlCmuxRxState_t;
+
+/** The receive frame decoder.
+ */
+typedef struct {
+    CellularCtrlCmuxRxState_t state;
+    uint8_t address;
+    uint8_t control;
+    uint8_t fcs;
+    size_t length;
+    size_t index;
+    char info[CELLULAR_CFG_CMUX_FRAME_SIZE];
+} CellularCtrlCmuxRx_t;
+
+/** A virtual channel.  The mutex exists for as long as CMUX is
+ * running; everything else is only valid while dlci is
+ * non-zero.  The receive buffer is a ring written by the
+ * demultiplexer task and read by the user of the virtual UART.
+ */
+typedef struct {
+    CellularPortMutexHandle_t mutex;
+    int32_t dlci;
+    volatile bool open;
+    CellularPortQueueHandle_t queue;
+    char *pBuffer;
+    size_t readIndex;
+    size_t count;
+    int32_t lostBytes;
+} CellularCtrlCmuxChannel_t;
+
+/* ----------------------------------------------------------------
+ * VARIABLES
+ * -------------------------------------------------------------- */
+
+/** The physical UART, -1 when CMUX is not running.
+ */
+static int32_t gUart = -1;
+
+/** The event queue of the physical UART.
+ */
+static CellularPortQueueHandle_t gQueueUart = NULL;
+
+/** Mutex to serialise opening and closing of channels.
+ */
+static CellularPortMutexHandle_t gMutex = NULL;
+
+/** Mutex to serialise the writing of frames to the physical
+ * UART; separate from gMutex so that the demultiplexer task
+ * can respond to the module while a channel is being opened.
+ */
+static CellularPortMutexHandle_t gTxMutex = NULL;
+
+/** Queue on which the demultiplexer task posts the responses
+ * it receives, ((DLCI << 8) | frame or message type).
+ */
+static CellularPortQueueHandle_t gQueueResponse = NULL;
+
+/** The demultiplexer task.
+ */
+static CellularPortTaskHandle_t gTaskHandle = NULL;
+
+/** Mutex held by the demultiplexer task while it is running.
+ */
+static CellularPortMutexHandle_t gMutexTaskRunning = NULL;
+
+/** Flag to tell the demultiplexer task to exit.
+ */
+static volatile bool gTaskExit = false;
+
+/** The receive frame decoder, only used by the demultiplexer
+ * task.
+ */
+static CellularCtrlCmuxRx_t gRx;
+
+/** Buffer in which frames are assembled for transmit, protected
+ * by gTxMutex.
+ */
+static char gTxBuffer[CELLULAR_CFG_CMUX_FRAME_SIZE + CELLULAR_CTRL_CMUX_FRAME_OVERHEAD];
+
+/** The virtual channels.
+ */
+static CellularCtrlCmuxChannel_t gChannels[CELLULAR_CFG_CMUX_MAX_NUM_CHANNELS];
+
+#if CELLULAR_CFG_STATIC_ALLOC
+/** The receive buffers of the virtual channels, indexed as
+ * gChannels.
+ */
+static char gChannelRxBuffers[CELLULAR_CFG_CMUX_MAX_NUM_CHANNELS][CELLULAR_CFG_CMUX_CHANNEL_RX_BUFFER_SIZE];
+#endif
+
+/** Table for the FCS, which is a CRC-8 using the reversed
+ * polynomial x^8 + x^2 + x + 1, from 3GPP 27.010 annex B.
+ */
+static const uint8_t gFcsTable[] = {
+    0x00, 0x91, 0xe3, 0x72, 0x07, 0x96, 0xe4, 0x75,
+    0x0e, 0x9f, 0xed, 0x7c, 0x09, 0x98, 0xea, 0x7b,
+    0x1c, 0x8d, 0xff, 0x6e, 0x1b, 0x8a, 0xf8, 0x69,
+    0x12, 0x83, 0xf1, 0x60, 0x15, 0x84, 0xf6, 0x67,
+    0x38, 0xa9, 0xdb, 0x4a, 0x3f, 0xae, 0xdc, 0x4d,
+    0x36, 0xa7, 0xd5, 0x44, 0x31, 0xa0, 0xd2, 0x43,
+    0x24, 0xb5, 0xc7, 0x56, 0x23, 0xb2, 0xc0, 0x51,
+    0x2a, 0xbb, 0xc9, 0x58, 0x2d, 0xbc, 0xce, 0x5f,
+    0x70, 0xe1, 0x93, 0x02, 0x77, 0xe6, 0x94, 0x05,
+    0x7e, 0xef, 0x9d, 0x0c, 0x79, 0xe8, 0x9a, 0x0b,
+    0x6c, 0xfd, 0x8f, 0x1e, 0x6b, 0xfa, 0x88, 0x19,
+    0x62, 0xf3, 0x81, 0x10, 0x65, 0xf4, 0x86, 0x17,
+    0x48, 0xd9, 0xab, 0x3a, 0x4f, 0xde, 0xac, 0x3d,
+    0x46, 0xd7, 0xa5, 0x34, 0x41, 0xd0, 0xa2, 0x33,
+    0x54, 0xc5, 0xb7, 0x26, 0x53, 0xc2, 0xb0, 0x21,
+    0x5a, 0xcb, 0xb9, 0x28, 0x5d, 0xcc, 0xbe, 0x2f,
+    0xe0, 0x71, 0x03, 0x92, 0xe7, 0x76, 0x04, 0x95,
+    0xee, 0x7f, 0x0d, 0x9c, 0xe9, 0x78, 0x0a, 0x9b,
+    0xfc, 0x6d, 0x1f, 0x8e, 0xfb, 0x6a, 0x18, 0x89,
+    0xf2, 0x63, 0x11, 0x80, 0xf5, 0x64, 0x16, 0x87,
+    0xd8, 0x49, 0x3b, 0xaa, 0xdf, 0x4e, 0x3c, 0xad,
+    0xd6, 0x47, 0x35, 0xa4, 0xd1, 0x40, 0x32, 0xa3,
+    0xc4, 0x55, 0x27, 0xb6, 0xc3, 0x52, 0x20, 0xb1,
+    0xca, 0x5b, 0x29, 0xb8, 0xcd, 0x5c, 0x2e, 0xbf,
+    0x90, 0x01, 0x73, 0xe2, 0x97, 0x06, 0x74, 0xe5,
+    0x9e, 0x0f, 0x7d, 0xec, 0x99, 0x08, 0x7a, 0xeb,
+    0x8c, 0x1d, 0x6f, 0xfe, 0x8b, 0x1a, 0x68, 0xf9,
+    0x82, 0x13, 0x61, 0xf0, 0x85, 0x14, 0x66, 0xf7,
+    0xa8, 0x39, 0x4b, 0xda, 0xaf, 0x3e, 0x4c, 0xdd,
+    0xa6, 0x37, 0x45, 0xd4, 0xa1, 0x30, 0x42, 0xd3,
+    0xb4, 0x25, 0x57, 0xc6, 0xb3, 0x22, 0x50, 0xc1,
+    0xba, 0x2b, 0x59, 0xc8, 0xbd, 0x2c, 0x5e, 0xcf
+};
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS: TRANSMIT
+ * -------------------------------------------------------------- */
+
+// Send a frame; isCommand sets the C/R bit of the address,
+// which is set for commands and UIH frames from us
+// and clear for our responses.
+static int32_t frameSend(int32_t dlci, uint8_t control,
+                         bool isCommand, const char *pInfo,
+                         size_t length)
+{
+    int32_t sizeOrErrorCode;
+    size_t x = 0;
+    uint8_t fcs = 0xFF;
+
+    CELLULAR_PORT_MUTEX_LOCK(gTxMutex);
+
+    gTxBuffer[x++] = (char) CELLULAR_CTRL_CMUX_FLAG;
+    gTxBuffer[x++] = (char) ((dlci << 2) |
+                             (isCommand ? CELLULAR_CTRL_CMUX_CR : 0) |
+                             CELLULAR_CTRL_CMUX_EA);
+    gTxBuffer[x++] = (char) control;
+    if (length > 0x7F) {
+        gTxBuffer[x++] = (char) ((length & 0x7F) << 1);
+        gTxBuffer[x++] = (char) (length >> 7);
+    } else {
+        gTxBuffer[x++] = (char) ((length << 1) | CELLULAR_CTRL_CMUX_EA);
+    }
+    // The FCS covers only the header in the basic option
+    for (size_t y = 1; y < x; y++) {
+        fcs = gFcsTable[fcs ^ (uint8_t) gTxBuffer[y]];
+    }
+    if (length > 0) {
+        pCellularPort_memcpy(gTxBuffer + x, pInfo, length);
+        x += length;
+    }
+    gTxBuffer[x++] = (char) (0xFF - fcs);
+    gTxBuffer[x++] = (char) CELLULAR_CTRL_CMUX_FLAG;
+
+    sizeOrErrorCode = cellularPortUartWrite(gUart, gTxBuffer, x);
+
+    CELLULAR_PORT_MUTEX_UNLOCK(gTxMutex);
+
+    return sizeOrErrorCode;
+}
+
+// Send a message on the control channel.
+static int32_t controlMessageSend(uint8_t type, bool isCommand,
+                                  const char *pValue, size_t length)
+{
+    char buffer[2 + 4];
+
+    if (length > sizeof(buffer) - 2) {
+        length = sizeof(buffer) - 2;
+    }
+    buffer[0] = (char) (type | (isCommand ? CELLULAR_CTRL_CMUX_CR : 0));
+    buffer[1] = (char) ((length << 1) | CELLULAR_CTRL_CMUX_EA);
+    if (length > 0) {
+        pCellularPort_memcpy(buffer + 2, pValue, length);
+    }
+
+    return frameSend(0, CELLULAR_CTRL_CMUX_FRAME_UIH, true,
+                     buffer, length + 2);
+}
+
+// Wait for a given response from the demultiplexer task.
+static bool responseWait(int32_t expected, int32_t timeoutMs)
+{
+    bool success = false;
+    int32_t response;
+    int64_t startTimeMs = cellularPortGetTickTimeMs();
+    int64_t remainingMs = timeoutMs;
+
+    while (!success && (remainingMs > 0)) {
+        if (cellularPortQueueTryReceive(gQueueResponse, (int32_t) remainingMs,
+                                        &response) == 0) {
+            success = (response == expected);
+        }
+        remainingMs = timeoutMs - (cellularPortGetTickTimeMs() - startTimeMs);
+    }
+
+    return success;
+}
+
+// Send a SABM or DISC frame and wait for UA, retrying as
+// necessary; DM is taken as a refusal.
+static bool commandSend(int32_t dlci, uint8_t control)
+{
+    bool success = false;
+    int32_t response;
+
+    for (size_t x = 0; !success && (x < CELLULAR_CTRL_CMUX_RETRIES); x++) {
+        // Throw away anything stale
+        while (cellularPortQueueTryReceive(gQueueResponse, 0, &response) == 0) {}
+        if (frameSend(dlci, control | CELLULAR_CTRL_CMUX_PF, true, NULL, 0) > 0) {
+            success = responseWait((dlci << 8) | CELLULAR_CTRL_CMUX_FRAME_UA,
+                                   CELLULAR_CTRL_CMUX_RESPONSE_TIMEOUT_MS);
+        }
+    }
+
+    return success;
+}
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS: RECEIVE
+ * -------------------------------------------------------------- */
+
+// Get the channel for a virtual UART, NULL if there is none.
+static CellularCtrlCmuxChannel_t *pChannelGet(int32_t uart)
+{
+    CellularCtrlCmuxChannel_t *pChannel = NULL;
+    int32_t dlci = uart - CELLULAR_CTRL_CMUX_UART_BASE;
+
+    if ((gUart >= 0) && (dlci > 0)) {
+        for (size_t x = 0; (pChannel == NULL) &&
+                           (x < sizeof(gChannels) / sizeof(gChannels[0])); x++) {
+            if (gChannels[x].dlci == dlci) {
+                pChannel = &(gChannels[x]);
+            }
+        }
+    }
+
+    return pChannel;
+}
+
+// Post a response for whoever is waiting in responseWait().
+static void responsePost(int32_t dlci, uint8_t type)
+{
+    int32_t response;
+
+    // The queue is only one deep and only this task writes
+    // to it so, having emptied it, the send won't block
+    while (cellularPortQueueTryReceive(gQueueResponse, 0, &response) == 0) {}
+    response = (dlci << 8) | type;
+    cellularPortQueueSend(gQueueResponse, &response);
+}
+
+// Put received data into a channel.
+static void channelDeliver(int32_t dlci, const char *pData,
+                           size_t length)
+{
+    CellularCtrlCmuxChannel_t *pChannel;
+    size_t writeIndex;
+    size_t thisLength;
+    bool wasEmpty;
+
+    pChannel = pChannelGet(CELLULAR_CTRL_CMUX_UART(dlci));
+    if (pChannel != NULL) {
+        CELLULAR_PORT_MUTEX_LOCK(pChannel->mutex);
+
+        // Check again now that we have the lock
+        if ((pChannel->dlci == dlci) && (pChannel->pBuffer != NULL)) {
+            wasEmpty = (pChannel->count == 0);
+            if (length > CELLULAR_CFG_CMUX_CHANNEL_RX_BUFFER_SIZE - pChannel->count) {
+                pChannel->lostBytes += length - (CELLULAR_CFG_CMUX_CHANNEL_RX_BUFFER_SIZE -
+                                                 pChannel->count);
+                length = CELLULAR_CFG_CMUX_CHANNEL_RX_BUFFER_SIZE - pChannel->count;
+            }
+            while (length > 0) {
+                writeIndex = (pChannel->readIndex + pChannel->count) %
+                             CELLULAR_CFG_CMUX_CHANNEL_RX_BUFFER_SIZE;
+                thisLength = CELLULAR_CFG_CMUX_CHANNEL_RX_BUFFER_SIZE - writeIndex;
+                if (thisLength > length) {
+                    thisLength = length;
+                }
+                pCellularPort_memcpy(pChannel->pBuffer + writeIndex,
+                                     pData, thisLength);
+                pChannel->count += thisLength;
+                pData += thisLength;
+                length -= thisLength;
+            }
+            // Let the reader know when data turns up in an
+            // empty buffer; after that it is up to the reader
+            // to check for more, as it would with a real UART
+            if (wasEmpty && (pChannel->count > 0)) {
+                cellularCtrlCmuxEventSend(pChannel->queue,
+                                          (int32_t) pChannel->count);
+            }
+        }
+
+        CELLULAR_PORT_MUTEX_UNLOCK(pChannel->mutex);
+    }
+}
+
+// Handle a message arriving on the control channel.
+static void controlMessageReceive(const char *pInfo, size_t length)
+{
+    uint8_t type;
+
+    if (length >= 2) {
+        type = (uint8_t) pInfo[0];
+        if (type & CELLULAR_CTRL_CMUX_CR) {
+            // A command from the module (e.g. MSC, flow control
+            // or test): reply with the same values
+            controlMessageSend(type & ~CELLULAR_CTRL_CMUX_CR, false,
+                               pInfo + 2, length - 2);
+        } else if (type == CELLULAR_CTRL_CMUX_MSG_CLD) {
+            // The only response that anyone waits for
+            responsePost(0, type);
+        }
+    }
+}
+
+// Handle a complete, correctly received, frame.
+static void frameReceive(int32_t dlci, uint8_t control,
+                         const char *pInfo, size_t length)
+{
+    switch (control & ~CELLULAR_CTRL_CMUX_PF) {
+        case CELLULAR_CTRL_CMUX_FRAME_UIH:
+            if (dlci == 0) {
+                controlMessageReceive(pInfo, length);
+            } else {
+                channelDeliver(dlci, pInfo, length);
+            }
+        break;
+        case CELLULAR_CTRL_CMUX_FRAME_UA:
+        case CELLULAR_CTRL_CMUX_FRAME_DM:
+            responsePost(dlci, control & ~CELLULAR_CTRL_CMUX_PF);
+        break;
+        case CELLULAR_CTRL_CMUX_FRAME_DISC:
+            // The module is closing a channel, or everything
+            cellularPortLog("CELLULAR_CTRL_CMUX: module closed DLCI %d.\n", dlci);
+            for (size_t x = 0; x < sizeof(gChannels) / sizeof(gChannels[0]); x++) {
+                if ((dlci == 0) || (gChannels[x].dlci == dlci)) {
+                    gChannels[x].open = false;
+                }
+            }
+            frameSend(dlci, CELLULAR_CTRL_CMUX_FRAME_UA | CELLULAR_CTRL_CMUX_PF,
+                      false, NULL, 0);
+        break;
+        case CELLULAR_CTRL_CMUX_FRAME_SABM:
+            // We're the initiator, we don't accept channels
+            frameSend(dlci, CELLULAR_CTRL_CMUX_FRAME_DM | CELLULAR_CTRL_CMUX_PF,
+                      false, NULL, 0);
+        break;
+        default:
+        break;
+    }
+}
+
+// Run a received byte through the frame decoder.
+static void rxByte(uint8_t byte)
+{
+    switch (gRx.state) {
+        case CELLULAR_CTRL_CMUX_RX_STATE_FLAG:
+            if (byte == CELLULAR_CTRL_CMUX_FLAG) {
+                gRx.state = CELLULAR_CTRL_CMUX_RX_STATE_ADDRESS;
+            }
+        break;
+        case CELLULAR_CTRL_CMUX_RX_STATE_ADDRESS:
+            // Stay here through repeated flags
+            if (byte != CELLULAR_CTRL_CMUX_FLAG) {
+                gRx.address = byte;
+                gRx.fcs = gFcsTable[0xFF ^ byte];
+                gRx.state = CELLULAR_CTRL_CMUX_RX_STATE_CONTROL;
+            }
+        break;
+        case CELLULAR_CTRL_CMUX_RX_STATE_CONTROL:
+            gRx.control = byte;
+            gRx.fcs = gFcsTable[gRx.fcs ^ byte];
+            gRx.state = CELLULAR_CTRL_CMUX_RX_STATE_LENGTH;
+        break;
+        case CELLULAR_CTRL_CMUX_RX_STATE_LENGTH:
+            gRx.fcs = gFcsTable[gRx.fcs ^ byte];
+            gRx.length = byte >> 1;
+            gRx.index = 0;
+            if (byte & CELLULAR_CTRL_CMUX_EA) {
+                gRx.state = CELLULAR_CTRL_CMUX_RX_STATE_INFO;
+                if (gRx.length == 0) {
+                    gRx.state = CELLULAR_CTRL_CMUX_RX_STATE_FCS;
+                }
+            } else {
+                gRx.state = CELLULAR_CTRL_CMUX_RX_STATE_LENGTH_2;
+            }
+        break;
+        case CELLULAR_CTRL_CMUX_RX_STATE_LENGTH_2:
+            gRx.fcs = gFcsTable[gRx.fcs ^ byte];
+            gRx.length |= ((size_t) byte) << 7;
+            gRx.state = CELLULAR_CTRL_CMUX_RX_STATE_INFO;
+            if (gRx.length == 0) {
+                gRx.state = CELLULAR_CTRL_CMUX_RX_STATE_FCS;
+            }
+        break;
+        case CELLULAR_CTRL_CMUX_RX_STATE_INFO:
+            // Anything longer than we agreed is rubbish
+            // but count it through so as to stay in step
+            if (gRx.index < sizeof(gRx.info)) {
+                gRx.info[gRx.index] = (char) byte;
+            }
+            gRx.index++;
+            if (gRx.index >= gRx.length) {
+                gRx.state = CELLULAR_CTRL_CMUX_RX_STATE_FCS;
+            }
+        break;
+        case CELLULAR_CTRL_CMUX_RX_STATE_FCS:
+            if ((gFcsTable[gRx.fcs ^ byte] == CELLULAR_CTRL_CMUX_FCS_GOOD) &&
+                (gRx.length <= sizeof(gRx.info))) {
+                frameReceive(gRx.address >> 2, gRx.control,
+                             gRx.info, gRx.length);
+            }
+            gRx.state = CELLULAR_CTRL_CMUX_RX_STATE_CLOSING_FLAG;
+        break;
+        case CELLULAR_CTRL_CMUX_RX_STATE_CLOSING_FLAG:
+            // The closing flag of one frame may also be the
+            // opening flag of the next
+            gRx.state = CELLULAR_CTRL_CMUX_RX_STATE_FLAG;
+            if (byte == CELLULAR_CTRL_CMUX_FLAG) {
+                gRx.state = CELLULAR_CTRL_CMUX_RX_STATE_ADDRESS;
+            }
+        break;
+        default:
+            gRx.state = CELLULAR_CTRL_CMUX_RX_STATE_FLAG;
+        break;
+    }
+}
+
+// The demultiplexer task: read the physical UART and
+// hand frames out to the virtual channels.
+static void demuxTask(void *pParam)
+{
+    char buffer[CELLULAR_CTRL_CMUX_READ_CHUNK_SIZE];
+    int32_t sizeBytes;
+
+    (void) pParam;
+
+    CELLULAR_PORT_MUTEX_LOCK(gMutexTaskRunning);
+
+    while (!gTaskExit) {
+        // Don't care what the event says, just look at the UART;
+        // should the AT client take an event meant for us while
+        // it is being moved on to a virtual UART it passes it on
+        cellularPortUartEventReceive(gQueueUart);
+        do {
+            sizeBytes = cellularPortUartRead(gUart, buffer, sizeof(buffer));
+            for (int32_t x = 0; x < sizeBytes; x++) {
+                rxByte((uint8_t) buffer[x]);
+            }
+        } while (sizeBytes > 0);
+    }
+
+    CELLULAR_PORT_MUTEX_UNLOCK(gMutexTaskRunning);
+
+    // Delete ourself
+    cellularPortTaskDelete(NULL);
+}
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS: HOUSEKEEPING
+ * -------------------------------------------------------------- */
+
+// Free a channel; the channel mutex must be locked.
+static void channelFree(CellularCtrlCmuxChannel_t *pChannel)
+{
+#if !CELLULAR_CFG_STATIC_ALLOC
+    cellularPort_free(pChannel->pBuffer);
+#endif
+    pChannel->pBuffer = NULL;
+    pChannel->dlci = 0;
+    pChannel->open = false;
+    pChannel->count = 0;
+    pChannel->readIndex = 0;
+}
+
+// Free everything; the demultiplexer task must not be running.
+static void resourcesFree()
+{
+    for (size_t x = 0; x < sizeof(gChannels) / sizeof(gChannels[0]); x++) {
+        if (gChannels[x].mutex != NULL) {
+            cellularPortMutexDelete(gChannels[x].mutex);
+            gChannels[x].mutex = NULL;
+        }
+        if (gChannels[x].pBuffer != NULL) {
+            channelFree(&(gChannels[x]));
+            cellularPortQueueDelete(gChannels[x].queue);
+            gChannels[x].queue = NULL;
+        }
+    }
+    if (gQueueResponse != NULL) {
+        cellularPortQueueDelete(gQueueResponse);
+        gQueueResponse = NULL;
+    }
+    if (gMutexTaskRunning != NULL) {
+        cellularPortMutexDelete(gMutexTaskRunning);
+        gMutexTaskRunning = NULL;
+    }
+    if (gTxMutex != NULL) {
+        cellularPortMutexDelete(gTxMutex);
+        gTxMutex = NULL;
+    }
+    if (gMutex != NULL) {
+        cellularPortMutexDelete(gMutex);
+        gMutex = NULL;
+    }
+    gUart = -1;
+    gQueueUart = NULL;
+}
+
+// Stop the demultiplexer task.
+static void demuxTaskStop()
+{
+    gTaskExit = true;
+    // Use a zero-length event rather than an error to
+    // wake the task: should someone else take it by
+    // mistake no harm is done, it is just sent again
+    cellularPortUartEventSend(gQueueUart, 0);
+    while (cellularPortMutexTryLock(gMutexTaskRunning,
+                                    CELLULAR_CTRL_CMUX_STOP_WAIT_MS) != 0) {
+        cellularPortUartEventSend(gQueueUart, 0);
+    }
+    cellularPortMutexUnlock(gMutexTaskRunning);
+    // Pause here to allow the task deletion that was
+    // requested above to actually occur in the idle thread,
+    // required by some RTOSs (e.g. FreeRTOS)
+    cellularPortTaskBlock(100);
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// Start CMUX.
+int32_t cellularCtrlCmuxInit(int32_t uart,
+                             CellularPortQueueHandle_t queueUart)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_SUCCESS;
+
+    if (gUart < 0) {
+        errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+        if ((uart >= 0) && !CELLULAR_CTRL_CMUX_IS_UART(uart) &&
+            (queueUart != NULL)) {
+            errorCode = CELLULAR_PORT_OUT_OF_MEMORY;
+            gUart = uart;
+            gQueueUart = queueUart;
+            gTaskExit = false;
+            pCellularPort_memset(&gRx, 0, sizeof(gRx));
+            gRx.state = CELLULAR_CTRL_CMUX_RX_STATE_FLAG;
+            pCellularPort_memset(gChannels, 0, sizeof(gChannels));
+            if ((cellularPortMutexCreate(&gMutex) == 0) &&
+                (cellularPortMutexCreate(&gTxMutex) == 0) &&
+                (cellularPortMutexCreate(&gMutexTaskRunning) == 0) &&
+                (cellularPortQueueCreate(1, sizeof(int32_t),
+                                         &gQueueResponse) == 0)) {
+                errorCode = CELLULAR_PORT_SUCCESS;
+                for (size_t x = 0; (errorCode == CELLULAR_PORT_SUCCESS) &&
+                                   (x < sizeof(gChannels) / sizeof(gChannels[0])); x++) {
+                    if (cellularPortMutexCreate(&(gChannels[x].mutex)) != 0) {
+                        errorCode = CELLULAR_PORT_OUT_OF_MEMORY;
+                    }
+                }
+                if ((errorCode == CELLULAR_PORT_SUCCESS) &&
+                    (cellularPortTaskCreate(demuxTask, "cmux",
+                                            CELLULAR_CTRL_CMUX_TASK_STACK_SIZE_BYTES,
+                                            NULL,
+                                            CELLULAR_CTRL_CMUX_TASK_PRIORITY,
+                                            &gTaskHandle) == 0)) {
+                    // Pause here to allow the task creation that was
+                    // requested above to actually occur in the idle thread,
+                    // required by some RTOSs (e.g. FreeRTOS).
+                    cellularPortTaskBlock(100);
+                    // Establish the control channel
+                    errorCode = CELLULAR_PORT_TIMEOUT;
+                    if (commandSend(0, CELLULAR_CTRL_CMUX_FRAME_SABM)) {
+                        errorCode = CELLULAR_PORT_SUCCESS;
+                        cellularPortLog("CELLULAR_CTRL_CMUX: started on UART %d.\n",
+                                        uart);
+                    } else {
+                        cellularPortLog("CELLULAR_CTRL_CMUX: no response from"
+                                        " module to SABM on DLCI 0.\n");
+                        demuxTaskStop();
+                    }
+                } else {
+                    errorCode = CELLULAR_PORT_OUT_OF_MEMORY;
+                }
+            }
+            if (errorCode != CELLULAR_PORT_SUCCESS) {
+                resourcesFree();
+            }
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Stop CMUX.
+void cellularCtrlCmuxDeinit(bool tellModule)
+{
+    CellularCtrlCmuxChannel_t *pChannel;
+    CellularPortQueueHandle_t queue;
+
+    if (gUart >= 0) {
+        CELLULAR_PORT_MUTEX_LOCK(gMutex);
+
+        for (size_t x = 0; x < sizeof(gChannels) / sizeof(gChannels[0]); x++) {
+            pChannel = &(gChannels[x]);
+            if (pChannel->dlci > 0) {
+                if (tellModule && pChannel->open) {
+                    commandSend(pChannel->dlci, CELLULAR_CTRL_CMUX_FRAME_DISC);
+                }
+                CELLULAR_PORT_MUTEX_LOCK(pChannel->mutex);
+                queue = pChannel->queue;
+                pChannel->queue = NULL;
+                channelFree(pChannel);
+                CELLULAR_PORT_MUTEX_UNLOCK(pChannel->mutex);
+                cellularPortQueueDelete(queue);
+            }
+        }
+        if (tellModule) {
+            // Tell the module to leave CMUX mode and wait
+            // for it to say that it has
+            controlMessageSend(CELLULAR_CTRL_CMUX_MSG_CLD, true, NULL, 0);
+            responseWait(CELLULAR_CTRL_CMUX_MSG_CLD,
+                         CELLULAR_CTRL_CMUX_RESPONSE_TIMEOUT_MS);
+        }
+
+        CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
+
+        demuxTaskStop();
+        resourcesFree();
+        cellularPortLog("CELLULAR_CTRL_CMUX: stopped.\n");
+    }
+}
+
+// Determine whether CMUX is running.
+bool cellularCtrlCmuxIsRunning()
+{
+    return gUart >= 0;
+}
+
+// Open a CMUX channel.
+int32_t cellularCtrlCmuxChannelOpen(int32_t channel,
+                                    CellularPortQueueHandle_t *pQueue)
+{
+    int32_t uartOrErrorCode = (int32_t) CELLULAR_PORT_NOT_INITIALISED;
+    CellularCtrlCmuxChannel_t *pChannel = NULL;
+    CellularPortQueueHandle_t queue = NULL;
+    char *pBuffer;
+    char value[2];
+
+    if (gUart >= 0) {
+        uartOrErrorCode = (int32_t) CELLULAR_PORT_INVALID_PARAMETER;
+        if ((channel > 0) && (channel <= CELLULAR_CTRL_CMUX_DLCI_MAX) &&
+            (pQueue != NULL)) {
+
+            CELLULAR_PORT_MUTEX_LOCK(gMutex);
+
+            pChannel = pChannelGet(CELLULAR_CTRL_CMUX_UART(channel));
+            if (pChannel != NULL) {
+                // Already open
+                uartOrErrorCode = CELLULAR_CTRL_CMUX_UART(channel);
+                *pQueue = pChannel->queue;
+            } else {
+                uartOrErrorCode = (int32_t) CELLULAR_PORT_OUT_OF_MEMORY;
+                for (size_t x = 0; (pChannel == NULL) &&
+                                   (x < sizeof(gChannels) / sizeof(gChannels[0])); x++) {
+                    if (gChannels[x].dlci == 0) {
+                        pChannel = &(gChannels[x]);
+                    }
+                }
+                if (pChannel != NULL) {
+#if CELLULAR_CFG_STATIC_ALLOC
+                    pBuffer = gChannelRxBuffers[pChannel - gChannels];
+#else
+                    pBuffer = (char *) pCellularPort_mallocTag(CELLULAR_CFG_CMUX_CHANNEL_RX_BUFFER_SIZE,
+                                                               CELLULAR_PORT_MALLOC_TAG_CMUX);
+#endif
+                    if ((pBuffer != NULL) &&
+                        (cellularPortQueueCreate(CELLULAR_PORT_UART_EVENT_QUEUE_SIZE,
+                                                 sizeof(int32_t), &queue) == 0)) {
+                        // Set the channel up before the SABM goes
+                        // so that anything the module sends straight
+                        // after its UA has somewhere to go
+                        CELLULAR_PORT_MUTEX_LOCK(pChannel->mutex);
+                        pChannel->pBuffer = pBuffer;
+                        pChannel->queue = queue;
+                        pChannel->readIndex = 0;
+                        pChannel->count = 0;
+                        pChannel->lostBytes = 0;
+                        pChannel->open = false;
+                        pChannel->dlci = channel;
+                        CELLULAR_PORT_MUTEX_UNLOCK(pChannel->mutex);
+                        if (commandSend(channel, CELLULAR_CTRL_CMUX_FRAME_SABM)) {
+                            pChannel->open = true;
+                            // Tell the module that we're ready
+                            value[0] = (char) ((channel << 2) | CELLULAR_CTRL_CMUX_CR |
+                                               CELLULAR_CTRL_CMUX_EA);
+                            value[1] = (char) CELLULAR_CTRL_CMUX_MSC_SIGNALS;
+                            controlMessageSend(CELLULAR_CTRL_CMUX_MSG_MSC, true,
+                                               value, sizeof(value));
+                            uartOrErrorCode = CELLULAR_CTRL_CMUX_UART(channel);
+                            *pQueue = queue;
+                        } else {
+                            cellularPortLog("CELLULAR_CTRL_CMUX: module refused to"
+                                            " open DLCI %d.\n", channel);
+                            CELLULAR_PORT_MUTEX_LOCK(pChannel->mutex);
+                            channelFree(pChannel);
+                            pChannel->queue = NULL;
+                            CELLULAR_PORT_MUTEX_UNLOCK(pChannel->mutex);
+                            cellularPortQueueDelete(queue);
+                            uartOrErrorCode = (int32_t) CELLULAR_PORT_TIMEOUT;
+                        }
+                    } else {
+#if !CELLULAR_CFG_STATIC_ALLOC
+                        cellularPort_free(pBuffer);
+#endif
+                    }
+                }
+            }
+
+            CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
+        }
+    }
+
+    return uartOrErrorCode;
+}
+
+// Close a CMUX channel.
+int32_t cellularCtrlCmuxChannelClose(int32_t uart)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_NOT_INITIALISED;
+    CellularCtrlCmuxChannel_t *pChannel;
+    CellularPortQueueHandle_t queue;
+
+    if (gUart >= 0) {
+        errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+
+        CELLULAR_PORT_MUTEX_LOCK(gMutex);
+
+        pChannel = pChannelGet(uart);
+        if (pChannel != NULL) {
+            errorCode = CELLULAR_PORT_SUCCESS;
+            if (pChannel->open &&
+                !commandSend(pChannel->dlci, CELLULAR_CTRL_CMUX_FRAME_DISC)) {
+                // Carry on and free it anyway
+                errorCode = CELLULAR_PORT_TIMEOUT;
+            }
+            CELLULAR_PORT_MUTEX_LOCK(pChannel->mutex);
+            queue = pChannel->queue;
+            pChannel->queue = NULL;
+            channelFree(pChannel);
+            CELLULAR_PORT_MUTEX_UNLOCK(pChannel->mutex);
+            cellularPortQueueDelete(queue);
+        }
+
+        CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Push an event onto the event queue of a virtual UART.
+int32_t cellularCtrlCmuxEventSend(const CellularPortQueueHandle_t queueHandle,
+                                  int32_t sizeBytesOrError)
+{
+    int32_t errorCode = (int32_t) CELLULAR_PORT_INVALID_PARAMETER;
+
+    if (queueHandle != NULL) {
+        errorCode = cellularPortQueueSend(queueHandle, &sizeBytesOrError);
+    }
+
+    return errorCode;
+}
+
+// Receive an event from a virtual UART, blocking.
+int32_t cellularCtrlCmuxEventReceive(const CellularPortQueueHandle_t queueHandle)
+{
+    int32_t sizeOrErrorCode = (int32_t) CELLULAR_PORT_INVALID_PARAMETER;
+    int32_t event;
+
+    if (queueHandle != NULL) {
+        sizeOrErrorCode = (int32_t) CELLULAR_PORT_PLATFORM_ERROR;
+        if (cellularPortQueueReceive(queueHandle, &event) == 0) {
+            sizeOrErrorCode = event;
+        }
+    }
+
+    return sizeOrErrorCode;
+}
+
+// Receive an event from a virtual UART with a timeout.
+int32_t cellularCtrlCmuxEventTryReceive(const CellularPortQueueHandle_t queueHandle,
+                                        int32_t waitMs)
+{
+    int32_t sizeOrErrorCode = (int32_t) CELLULAR_PORT_INVALID_PARAMETER;
+    int32_t event;
+
+    if (queueHandle != NULL) {
+        sizeOrErrorCode = (int32_t) CELLULAR_PORT_TIMEOUT;
+        if (cellularPortQueueTryReceive(queueHandle, waitMs, &event) == 0) {
+            sizeOrErrorCode = event;
+        }
+    }
+
+    return sizeOrErrorCode;
+}
+
+// Get the number of bytes waiting on a virtual UART.
+int32_t cellularCtrlCmuxGetReceiveSize(int32_t uart)
+{
+    int32_t sizeOrErrorCode = (int32_t) CELLULAR_PORT_INVALID_PARAMETER;
+    CellularCtrlCmuxChannel_t *pChannel = pChannelGet(uart);
+
+    if (pChannel != NULL) {
+        sizeOrErrorCode = (int32_t) pChannel->count;
+    }
+
+    return sizeOrErrorCode;
+}
+
+// Read from a virtual UART.
+int32_t cellularCtrlCmuxRead(int32_t uart, char *pBuffer,
+                             size_t sizeBytes)
+{
+    int32_t sizeOrErrorCode = (int32_t) CELLULAR_PORT_INVALID_PARAMETER;
+    CellularCtrlCmuxChannel_t *pChannel = pChannelGet(uart);
+    size_t thisSize;
+
+    if ((pChannel != NULL) && (pBuffer != NULL)) {
+        sizeOrErrorCode = 0;
+
+        CELLULAR_PORT_MUTEX_LOCK(pChannel->mutex);
+
+        if (sizeBytes > pChannel->count) {
+            sizeBytes = pChannel->count;
+        }
+        while (sizeBytes > 0) {
+            thisSize = CELLULAR_CFG_CMUX_CHANNEL_RX_BUFFER_SIZE - pChannel->readIndex;
+            if (thisSize > sizeBytes) {
+                thisSize = sizeBytes;
+            }
+            pCellularPort_memcpy(pBuffer, pChannel->pBuffer + pChannel->readIndex,
+                                 thisSize);
+            pChannel->readIndex = (pChannel->readIndex + thisSize) %
+                                  CELLULAR_CFG_CMUX_CHANNEL_RX_BUFFER_SIZE;
+            pChannel->count -= thisSize;
+            pBuffer += thisSize;
+            sizeBytes -= thisSize;
+            sizeOrErrorCode += (int32_t) thisSize;
+        }
+
+        CELLULAR_PORT_MUTEX_UNLOCK(pChannel->mutex);
+    }
+
+    return sizeOrErrorCode;
+}
+
+// Get a pointer to the contiguous data waiting on a virtual UART.
+int32_t cellularCtrlCmuxReadSpan(int32_t uart, const char **ppData)
+{
+    int32_t sizeOrErrorCode = (int32_t) CELLULAR_PORT_INVALID_PARAMETER;
+    CellularCtrlCmuxChannel_t *pChannel = pChannelGet(uart);
+
+    if ((pChannel != NULL) && (ppData != NULL)) {
+
+        CELLULAR_PORT_MUTEX_LOCK(pChannel->mutex);
+
+        sizeOrErrorCode = (int32_t) (CELLULAR_CFG_CMUX_CHANNEL_RX_BUFFER_SIZE -
+                                     pChannel->readIndex);
+        if (sizeOrErrorCode > (int32_t) pChannel->count) {
+            sizeOrErrorCode = (int32_t) pChannel->count;
+        }
+        *ppData = pChannel->pBuffer + pChannel->readIndex;
+
+        CELLULAR_PORT_MUTEX_UNLOCK(pChannel->mutex);
+    }
+
+    return sizeOrErrorCode;
+}
+
+// Mark data obtained through cellularCtrlCmuxReadSpan() as read.
+int32_t cellularCtrlCmuxReadCommit(int32_t uart, size_t sizeBytes)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularCtrlCmuxChannel_t *pChannel = pChannelGet(uart);
+
+    if (pChannel != NULL) {
+
+        CELLULAR_PORT_MUTEX_LOCK(pChannel->mutex);
+
+        if (sizeBytes <= pChannel->count) {
+            pChannel->readIndex = (pChannel->readIndex + sizeBytes) %
+                                  CELLULAR_CFG_CMUX_CHANNEL_RX_BUFFER_SIZE;
+            pChannel->count -= sizeBytes;
+            errorCode = CELLULAR_PORT_SUCCESS;
+        }
+
+        CELLULAR_PORT_MUTEX_UNLOCK(pChannel->mutex);
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Write to a virtual UART.
+int32_t cellularCtrlCmuxWrite(int32_t uart, const char *pBuffer,
+                              size_t sizeBytes)
+{
+    int32_t sizeOrErrorCode = (int32_t) CELLULAR_PORT_INVALID_PARAMETER;
+    CellularCtrlCmuxChannel_t *pChannel = pChannelGet(uart);
+    size_t thisSize;
+    int32_t sentSize = 0;
+    int32_t errorCode = 0;
+
+    if ((pChannel != NULL) && (pBuffer != NULL)) {
+        sizeOrErrorCode = (int32_t) CELLULAR_PORT_NOT_INITIALISED;
+        if (pChannel->open) {
+            // One UIH frame per CELLULAR_CFG_CMUX_FRAME_SIZE bytes
+            while ((sizeBytes > 0) && (errorCode >= 0)) {
+                thisSize = sizeBytes;
+                if (thisSize > CELLULAR_CFG_CMUX_FRAME_SIZE) {
+                    thisSize = CELLULAR_CFG_CMUX_FRAME_SIZE;
+                }
+                errorCode = frameSend(pChannel->dlci, CELLULAR_CTRL_CMUX_FRAME_UIH,
+                                      true, pBuffer, thisSize);
+                if (errorCode >= 0) {
+                    pBuffer += thisSize;
+                    sizeBytes -= thisSize;
+                    sentSize += (int32_t) thisSize;
+                }
+            }
+            // Report what was sent, only reporting an error
+            // if nothing at all got through
+            sizeOrErrorCode = sentSize;
+            if ((sentSize == 0) && (errorCode < 0)) {
+                sizeOrErrorCode = errorCode;
+            }
+        }
+    }
+
+    return sizeOrErrorCode;
+}
+
+// Get the number of bytes lost on a virtual UART.
+int32_t cellularCtrlCmuxGetLostBytes(int32_t uart)
+{
+    int32_t lostOrErrorCode = (int32_t) CELLULAR_PORT_INVALID_PARAMETER;
+    CellularCtrlCmuxChannel_t *pChannel = pChannelGet(uart);
+
+    if (pChannel != NULL) {
+        lostOrErrorCode = pChannel->lostBytes;
+    }
+
+    return lostOrErrorCode;
+}
+
+// End of file
@@ -0,0 +1,216 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _CELLULAR_CTRL_CMUX_H_
+#define _CELLULAR_CTRL_CMUX_H_
+
+/* No #includes allowed here */
+
+/* This header file defines a 3GPP 27.010 (CMUX) multiplexer, basic
+ * option, which presents virtual UARTs over the physical UART to
+ * the cellular module.  The functions for a virtual UART mirror
+ * those of cellular_port_uart.h so that a user of a UART, e.g. the
+ * AT client, can be pointed at a virtual UART instead of a physical
+ * one.  The module must already have been put into CMUX mode with
+ * AT+CMUX before cellularCtrlCmuxInit() is called; this is done by
+ * cellularCtrlCmuxStart() in the cellular control API.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS
+ * -------------------------------------------------------------- */
+
+/** Virtual UART numbers start here, well clear of any physical
+ * UART number.
+ */
+#define CELLULAR_CTRL_CMUX_UART_BASE 0x100
+
+/** The virtual UART number for a given CMUX channel (DLCI).
+ */
+#define CELLULAR_CTRL_CMUX_UART(channel) (CELLULAR_CTRL_CMUX_UART_BASE + (channel))
+
+/** Determine if a UART number is that of a CMUX virtual UART.
+ */
+#define CELLULAR_CTRL_CMUX_IS_UART(uart) ((uart) >= CELLULAR_CTRL_CMUX_UART_BASE)
+
+/* ----------------------------------------------------------------
+ * FUNCTIONS
+ * -------------------------------------------------------------- */
+
+/** Start the CMUX multiplexer on a physical UART: a task is
+ * started to demultiplex frames arriving on the UART and the
+ * CMUX control channel (DLCI 0) is established with the module.
+ * While CMUX is running nothing else should read from or write
+ * to the physical UART.
+ *
+ * @param uart      the physical UART that the module is on.
+ * @param queueUart the event queue of the physical UART.
+ * @return          zero on success or negative error code on
+ *                  failure.
+ */
+int32_t cellularCtrlCmuxInit(int32_t uart,
+                             CellularPortQueueHandle_t queueUart);
+
+/** Stop the CMUX multiplexer: any open channels are closed, the
+ * module is told to leave CMUX mode and the demultiplexer task
+ * is stopped.  Anyone using a virtual UART must have stopped
+ * doing so before this is called.
+ *
+ * @param tellModule if true the channels are closed and the
+ *                   module is told to leave CMUX mode, else
+ *                   only the local side is torn down, e.g.
+ *                   because the module has been powered off
+ *                   or rebooted.
+ */
+void cellularCtrlCmuxDeinit(bool tellModule);
+
+/** Determine whether the CMUX multiplexer is running.
+ *
+ * @return true if cellularCtrlCmuxInit() has been called
+ *         successfully, else false.
+ */
+bool cellularCtrlCmuxIsRunning();
+
+/** Open a CMUX channel, giving a virtual UART.
+ *
+ * @param channel  the channel (DLCI) to open, 1 upwards.
+ * @param pQueue   a place to put the handle of the event queue
+ *                 of the virtual UART; cannot be NULL.
+ * @return         the virtual UART number on success, else
+ *                 negative error code.
+ */
+int32_t cellularCtrlCmuxChannelOpen(int32_t channel,
+                                    CellularPortQueueHandle_t *pQueue);
+
+/** Close a CMUX channel.  The event queue of the virtual UART
+ * is deleted so nothing must be waiting on it.
+ *
+ * @param uart the virtual UART number returned by
+ *             cellularCtrlCmuxChannelOpen().
+ * @return     zero on success or negative error code.
+ */
+int32_t cellularCtrlCmuxChannelClose(int32_t uart);
+
+/** Push an event onto the event queue of a virtual UART; the
+ * equivalent of cellularPortUartEventSend().
+ *
+ * @param queueHandle      the event queue of the virtual UART.
+ * @param sizeBytesOrError the number of bytes received or
+ *                         negative error code.
+ * @return                 zero on success else negative error
+ *                         code.
+ */
+int32_t cellularCtrlCmuxEventSend(const CellularPortQueueHandle_t queueHandle,
+                                  int32_t sizeBytesOrError);
+
+/** Receive an event from the event queue of a virtual UART,
+ * blocking until one turns up; the equivalent of
+ * cellularPortUartEventReceive().
+ *
+ * @param queueHandle the event queue of the virtual UART.
+ * @return            the number of bytes received else negative
+ *                    error code.
+ */
+int32_t cellularCtrlCmuxEventReceive(const CellularPortQueueHandle_t queueHandle);
+
+/** Receive an event from the event queue of a virtual UART
+ * with a timeout; the equivalent of
+ * cellularPortUartEventTryReceive().
+ *
+ * @param queueHandle the event queue of the virtual UART.
+ * @param waitMs      the time to wait in milliseconds.
+ * @return            the number of bytes received else negative
+ *                    error code, CELLULAR_PORT_TIMEOUT if
+ *                    nothing turned up.
+ */
+int32_t cellularCtrlCmuxEventTryReceive(const CellularPortQueueHandle_t queueHandle,
+                                        int32_t waitMs);
+
+/** Get the number of bytes waiting in the receive buffer of a
+ * virtual UART; the equivalent of
+ * cellularPortUartGetReceiveSize().
+ *
+ * @param uart the virtual UART number.
+ * @return     the number of bytes waiting or negative error
+ *             code.
+ */
+int32_t cellularCtrlCmuxGetReceiveSize(int32_t uart);
+
+/** Read from a virtual UART, no waiting around; the equivalent
+ * of cellularPortUartRead().
+ *
+ * @param uart      the virtual UART number.
+ * @param pBuffer   a pointer to a buffer in which to store
+ *                  received bytes.
+ * @param sizeBytes the size of buffer pointed to by pBuffer.
+ * @return          the number of bytes received or negative
+ *                  error code.
+ */
+int32_t cellularCtrlCmuxRead(int32_t uart, char *pBuffer,
+                             size_t sizeBytes);
+
+/** Get a pointer to the contiguous data waiting in the receive
+ * buffer of a virtual UART; the equivalent of
+ * cellularPortUartReadSpan().
+ *
+ * @param uart   the virtual UART number.
+ * @param ppData a place to put a pointer to the received
+ *               data; cannot be NULL.
+ * @return       the number of contiguous bytes available at
+ *               *ppData or negative error code.
+ */
+int32_t cellularCtrlCmuxReadSpan(int32_t uart, const char **ppData);
+
+/** Mark data obtained through cellularCtrlCmuxReadSpan() as
+ * read; the equivalent of cellularPortUartReadCommit().
+ *
+ * @param uart      the virtual UART number.
+ * @param sizeBytes the number of bytes that have been read.
+ * @return          zero on success or negative error code.
+ */
+int32_t cellularCtrlCmuxReadCommit(int32_t uart, size_t sizeBytes);
+
+/** Write to a virtual UART, blocking until all the data has
+ * been sent; the equivalent of cellularPortUartWrite().
+ *
+ * @param uart      the virtual UART number.
+ * @param pBuffer   a pointer to a buffer of data to send.
+ * @param sizeBytes the number of bytes in pBuffer.
+ * @return          the number of bytes sent or negative
+ *                  error code.
+ */
+int32_t cellularCtrlCmuxWrite(int32_t uart, const char *pBuffer,
+                              size_t sizeBytes);
+
+/** Get the number of bytes that have been thrown away on a
+ * virtual UART because its receive buffer was full.
+ *
+ * @param uart the virtual UART number.
+ * @return     the number of bytes lost or negative error code.
+ */
+int32_t cellularCtrlCmuxGetLostBytes(int32_t uart);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _CELLULAR_CTRL_CMUX_H_
+
+// End of file
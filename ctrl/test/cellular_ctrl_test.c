@@ -34,6 +34,9 @@
 #include "cellular_port_uart.h"
 #include "cellular_port_test_platform_specific.h"
 #include "cellular_ctrl.h"
+#include "cellular_ctrl_cmux.h"
+#include "cellular_ctrl_at.h"
+#include "cellular_ctrl_apn_db.h" // For apnlut[] and apnconfig()
 #include "cellular_cfg_test.h"
 
 /** Note: some of these tests use cellularPort_rand() but they
@@ -95,6 +98,15 @@ static int64_t gStopTimeMS;
 // handle.
 static CellularPortQueueHandle_t gUartQueueHandle = NULL;
 
+// The states reported by connectAsyncCallback(), in order.
+static volatile CellularCtrlConnectState_t gConnectStates[CELLULAR_CTRL_MAX_NUM_CONNECT_STATES * 2];
+
+// The number of entries in gConnectStates.
+static volatile size_t gNumConnectStates = 0;
+
+// The error code reported with the last connect state.
+static volatile int32_t gConnectErrorCode = 0;
+
 #if CELLULAR_CTRL_SECURITY_ROOT_OF_TRUST
 // A string of all possible characters, used
 // when testing end to end encryption
@@ -105,6 +117,12 @@ static const char gAllChars[] = "the quick brown fox jumps over the lazy dog "
                                 "\x1d\x1e!\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~\x7f";
 #endif
 
+// The characters passed to txSchedulerSendCallback(), in order.
+static char gTxSchedulerSent[8];
+
+// The number of characters in gTxSchedulerSent.
+static volatile size_t gTxSchedulerNumSent = 0;
+
 /* ----------------------------------------------------------------
  * STATIC FUNCTIONS
  * -------------------------------------------------------------- */
@@ -121,6 +139,75 @@ static bool keepGoingCallback()
     return keepGoing;
 }
 
+// Callback for cellularCtrlConnectAsync(), recording the states.
+static void connectAsyncCallback(CellularCtrlConnectState_t state,
+                                 int32_t errorCode,
+                                 void *pParam)
+{
+    (void) pParam;
+
+    if (gNumConnectStates < sizeof(gConnectStates) / sizeof(gConnectStates[0])) {
+        gConnectStates[gNumConnectStates] = state;
+        gNumConnectStates++;
+    }
+    gConnectErrorCode = errorCode;
+}
+
+#if CELLULAR_CTRL_SECURITY_ROOT_OF_TRUST
+// Output callback for a streamed end to end encryption, checking
+// that no chunk of cipher text is bigger than it should be and
+// adding up the total at pParam.
+static int32_t e2eStreamOutputCallback(const void *pData,
+                                       size_t sizeBytes,
+                                       void *pParam)
+{
+    int32_t errorCode = -1;
+
+    if ((pData != NULL) &&
+        (sizeBytes <= CELLULAR_CFG_CTRL_E2E_CHUNK_SIZE_BYTES +
+                      CELLULAR_CTRL_END_TO_END_ENCRYPT_HEADER_SIZE_BYTES)) {
+        *((size_t *) pParam) += sizeBytes;
+        errorCode = 0;
+    }
+
+    return errorCode;
+}
+#endif
+
+// Send callback for the transmit scheduler, recording
+// the single character it is given.
+static int32_t txSchedulerSendCallback(const void *pData,
+                                       size_t dataSizeBytes,
+                                       void *pParam)
+{
+    (void) pParam;
+
+    if ((dataSizeBytes == 1) &&
+        (gTxSchedulerNumSent < sizeof(gTxSchedulerSent) - 1)) {
+        gTxSchedulerSent[gTxSchedulerNumSent] = *((const char *) pData);
+        gTxSchedulerNumSent++;
+        gTxSchedulerSent[gTxSchedulerNumSent] = 0;
+    }
+
+    return (int32_t) dataSizeBytes;
+}
+
+// Wait for the transmit scheduler to have sent numSent
+// things, returning true if it does.
+static bool txSchedulerWaitSent(size_t numSent, int32_t timeoutMs)
+{
+    int64_t stopTimeMs = cellularPortGetTickTimeMs() + timeoutMs;
+
+    while ((gTxSchedulerNumSent < numSent) &&
+           (cellularPortGetTickTimeMs() < stopTimeMs)) {
+        cellularPortTaskBlock(100);
+    }
+
+    return gTxSchedulerNumSent >= numSent;
+}
+
+// The modem simulator of the POSIX platform is never switched off
+#if !defined(CELLULAR_PORT_TEST_SIMULATOR) || !CELLULAR_PORT_TEST_SIMULATOR
 // Test power on/off and aliveness, parameterised with the VInt pin.
 // Note: no checking of cellularCtrlGetConsecutiveAtTimeouts() here as
 // we're deliberately doing things that should cause timeouts.
@@ -292,6 +379,7 @@ static void cellularCtrlTestPowerAliveVInt(int32_t pinVint)
 
     cellularPortDeinit();
 }
+#endif // !defined(CELLULAR_PORT_TEST_SIMULATOR) || !CELLULAR_PORT_TEST_SIMULATOR
 
 // Do a connect/disconnect test on the specified RAT.
 static void connectDisconnect(CellularCtrlRat_t rat)
@@ -305,6 +393,7 @@ static void connectDisconnect(CellularCtrlRat_t rat)
     int32_t bytesRead;
     bool screwy = false;
     int32_t y;
+    int64_t startTimeMs;
     const char *pApn = CELLULAR_CFG_TEST_APN;
     const char *pUsername = CELLULAR_CFG_TEST_USERNAME;
     const char *pPassword = CELLULAR_CFG_TEST_PASSWORD;
@@ -369,6 +458,9 @@ static void connectDisconnect(CellularCtrlRat_t rat)
         }
     }
 
+    // Start without any last-known-good settings
+    cellularCtrlForgetLastGood();
+
     cellularPortLog("CELLULAR_CTRL_TEST: set a very short connect time-out to achieve a fail...\n");
     gStopTimeMS = cellularPortGetTickTimeMs() + 0;
 
@@ -434,15 +526,51 @@ static void connectDisconnect(CellularCtrlRat_t rat)
                               (bytesRead == cellularPort_strlen(buffer)));
     cellularPortLog("CELLULAR_CTRL_TEST: IP address \"%s\".\n", buffer);
 
+#if CELLULAR_CTRL_MAX_NUM_ACTIVE_CONTEXTS > 1
+    // Bring up a second context alongside the first
+    cellularPortLog("CELLULAR_CTRL_TEST: activating a second PDP context...\n");
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlActivateContext(CELLULAR_CTRL_CONTEXT_ID + 1,
+                                                          pApn, NULL, NULL) == 0);
+    bytesRead = cellularCtrlGetIpAddressStrForContext(CELLULAR_CTRL_CONTEXT_ID + 1,
+                                                      buffer);
+    CELLULAR_PORT_TEST_ASSERT((bytesRead > 0) && (bytesRead < sizeof(buffer) - 1) &&
+                              (bytesRead == cellularPort_strlen(buffer)));
+    cellularPortLog("CELLULAR_CTRL_TEST: second IP address \"%s\".\n", buffer);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlGetIpAddressStr(NULL) > 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlDeactivateContext(CELLULAR_CTRL_CONTEXT_ID + 1) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlGetIpAddressStrForContext(CELLULAR_CTRL_CONTEXT_ID + 1,
+                                                                    NULL) <= 0);
+    // The first context should be unaffected
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlGetIpAddressStr(NULL) > 0);
+#endif
+
     // Read the time
     cellularPortLog("CELLULAR_CTRL_TEST: reading network time...\n");
     y = cellularCtrlGetTimeUtc();
     // Don't assert on this, it is optional in the network
     cellularPortLog("CELLULAR_CTRL_TEST: time is %d.\n", y);
+    if (y >= 0) {
+        // A second read should come from the cache and agree
+        bytesRead = cellularCtrlGetTimeUtc();
+        cellularPortLog("CELLULAR_CTRL_TEST: time again is %d.\n", bytesRead);
+        CELLULAR_PORT_TEST_ASSERT((bytesRead >= y) && (bytesRead <= y + 2));
+    }
 
     cellularPortLog("CELLULAR_CTRL_TEST: disconnecting...\n");
     CELLULAR_PORT_TEST_ASSERT(cellularCtrlDisconnect() == 0);
 
+    // Connect again, which should now start from the
+    // settings of the connection above
+    cellularPortLog("CELLULAR_CTRL_TEST: connecting again with the last-known-good settings...\n");
+    startTimeMs = cellularPortGetTickTimeMs();
+    gStopTimeMS = startTimeMs + (CELLULAR_CFG_TEST_CONNECT_TIMEOUT_SECONDS * 1000);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlConnect(keepGoingCallback, NULL, NULL, NULL) == 0);
+    cellularPortLog("CELLULAR_CTRL_TEST: connected in %d ms.\n",
+                    (int32_t) (cellularPortGetTickTimeMs() - startTimeMs));
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlIsRegistered());
+    cellularPortLog("CELLULAR_CTRL_TEST: disconnecting...\n");
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlDisconnect() == 0);
+
     if (pApn != NULL) {
         cellularPortLog("CELLULAR_CTRL_TEST: waiting %d second(s) to connect to APN \"%s\"...\n",
                         CELLULAR_CFG_TEST_CONNECT_TIMEOUT_SECONDS, pApn);
@@ -581,6 +709,63 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularCtrlTestInitialisation(),
     cellularPortDeinit();
 }
 
+/** Check that the APN database is in the order that its binary
+ * search needs and that look-ups find the right entries.
+ * No module is required for this test.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularCtrlTestApnDb(),
+                            "ctrlApnDb",
+                            "ctrl")
+{
+    const char *pConfig;
+
+    cellularPortLog("CELLULAR_CTRL_TEST: checking %d APN database entries...\n",
+                    sizeof(apnlut) / sizeof(apnlut[0]));
+    for (size_t x = 1; x < sizeof(apnlut) / sizeof(apnlut[0]); x++) {
+        if (apnlut[x].key <= apnlut[x - 1].key) {
+            cellularPortLog("CELLULAR_CTRL_TEST: APN database entry %d (MCC %d)"
+                            " is out of order.\n", x, apnlut[x].key >> 11);
+        }
+        CELLULAR_PORT_TEST_ASSERT(apnlut[x].key > apnlut[x - 1].key);
+    }
+
+    // First entry, last entry, a three-digit MNC and no entry
+    pConfig = apnconfig("204041234567890");
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_strcmp(pConfig, "public4.m2minternet.com") == 0);
+    pConfig = apnconfig("901371234567890");
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_strcmp(pConfig, "netgprs.com") == 0);
+    pConfig = apnconfig("310260123456789");
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_strcmp(pConfig, "epc.tmobile.com") == 0);
+    pConfig = apnconfig("310030123456789");
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_strcmp(pConfig, "phone") == 0);
+    pConfig = apnconfig("001011234567890");
+    CELLULAR_PORT_TEST_ASSERT(pConfig == apndef);
+    pConfig = apnconfig("");
+    CELLULAR_PORT_TEST_ASSERT(pConfig == apndef);
+}
+
+/** Check the conversion of EARFCN to band used by band learning.
+ * No module is required for this test.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularCtrlTestEarfcnToBand(),
+                            "ctrlEarfcnToBand",
+                            "ctrl")
+{
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlEarfcnToBand(0) == 1);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlEarfcnToBand(599) == 1);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlEarfcnToBand(600) == 2);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlEarfcnToBand(2525) == 5);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlEarfcnToBand(3749) == 8);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlEarfcnToBand(6300) == 20);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlEarfcnToBand(9300) == 28);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlEarfcnToBand(66500) == 66);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlEarfcnToBand(70545) == 85);
+    // Gaps and out of range
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlEarfcnToBand(5000) < 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlEarfcnToBand(-1) < 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlEarfcnToBand(100000) < 0);
+}
+
 /** Test security sealing.
  * Note: this test will only attempt a seal if
  * CELLULAR_CTRL_SECURITY_DEVICE_INFORMATION is defined
@@ -733,6 +918,9 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularCtrlTestSecurityEndToEndEncryption(),
     int32_t y;
 #if CELLULAR_CTRL_SECURITY_ROOT_OF_TRUST
     char *pData;
+    CellularSecurityEndToEndEncryptStream_t stream;
+    size_t totalOutputBytes = 0;
+    size_t numChunks;
 #endif
 
     CELLULAR_PORT_TEST_ASSERT(cellularPortInit() == 0);
@@ -770,6 +958,27 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularCtrlTestSecurityEndToEndEncryption(),
                                                                                                           CELLULAR_CTRL_END_TO_END_ENCRYPT_HEADER_SIZE_BYTES);
         CELLULAR_PORT_TEST_ASSERT(cellularPort_memcmp(pData, gAllChars, sizeof(gAllChars)) != 0);
         cellularPort_free(pData);
+
+        // Now stream enough copies of the same data through to
+        // need more than one chunk, ending part way into a chunk
+        cellularPortLog("CELLULAR_CTRL_TEST: requesting streamed end to end encryption...\n");
+        CELLULAR_PORT_TEST_ASSERT(cellularSecurityEndToEndEncryptInit(&stream,
+                                                                      e2eStreamOutputCallback,
+                                                                      &totalOutputBytes) == 0);
+        y = 0;
+        for (size_t x = 0; x < (CELLULAR_CFG_CTRL_E2E_CHUNK_SIZE_BYTES / sizeof(gAllChars)) + 2; x++) {
+            CELLULAR_PORT_TEST_ASSERT(cellularSecurityEndToEndEncryptUpdate(&stream, gAllChars,
+                                                                            sizeof(gAllChars)) == 0);
+            y += sizeof(gAllChars);
+        }
+        numChunks = (y + CELLULAR_CFG_CTRL_E2E_CHUNK_SIZE_BYTES - 1) / CELLULAR_CFG_CTRL_E2E_CHUNK_SIZE_BYTES;
+        y = cellularSecurityEndToEndEncryptFinal(&stream);
+        cellularPortLog("CELLULAR_CTRL_TEST: streamed %d byte(s) of cipher text in %d chunk(s).\n",
+                        y, (int) numChunks);
+        CELLULAR_PORT_TEST_ASSERT(y > 0);
+        CELLULAR_PORT_TEST_ASSERT(y == totalOutputBytes);
+        CELLULAR_PORT_TEST_ASSERT(y <= (sizeof(gAllChars) * ((CELLULAR_CFG_CTRL_E2E_CHUNK_SIZE_BYTES / sizeof(gAllChars)) + 2)) +
+                                       (numChunks * CELLULAR_CTRL_END_TO_END_ENCRYPT_HEADER_SIZE_BYTES));
     } else {
         cellularPortLog("CELLULAR_CTRL_TEST: NOT RUNNING test of end to end "
                         "encryption as the cellular module is not security "
@@ -792,6 +1001,68 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularCtrlTestSecurityEndToEndEncryption(),
     cellularPortDeinit();
 }
 
+/** Test setting up a security profile; storing a real credential
+ * is left to the examples since it needs a real certificate.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularCtrlTestSecurityProfile(),
+                            "ctrlSecurityProfile",
+                            "ctrl")
+{
+    CellularCtrlSecurityProfile_t profile = {0};
+    int32_t y;
+
+    CELLULAR_PORT_TEST_ASSERT(cellularPortInit() == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartInit(CELLULAR_CFG_PIN_TXD,
+                                                   CELLULAR_CFG_PIN_RXD,
+                                                   CELLULAR_CFG_PIN_CTS,
+                                                   CELLULAR_CFG_PIN_RTS,
+                                                   CELLULAR_CFG_BAUD_RATE,
+                                                   CELLULAR_CFG_RTS_THRESHOLD,
+                                                   CELLULAR_CFG_UART,
+                                                   &gUartQueueHandle) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlInit(CELLULAR_CFG_PIN_ENABLE_POWER,
+                                               CELLULAR_CFG_PIN_PWR_ON,
+                                               CELLULAR_CFG_PIN_VINT,
+                                               false,
+                                               CELLULAR_CFG_UART,
+                                               gUartQueueHandle) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlPowerOn(NULL) == 0);
+
+    cellularPortLog("CELLULAR_CTRL_TEST: checking bad parameters...\n");
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlSecurityProfileSet(-1, NULL) < 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlSecurityProfileSet(CELLULAR_CTRL_SECURITY_PROFILE_MAX_NUM,
+                                                             NULL) < 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlSecurityCredentialStore(CELLULAR_CTRL_SECURITY_CREDENTIAL_ROOT_CA,
+                                                                  NULL, "x", 1) < 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlSecurityCredentialStore(CELLULAR_CTRL_SECURITY_CREDENTIAL_ROOT_CA,
+                                                                  "x", NULL, 1) < 0);
+
+    cellularPortLog("CELLULAR_CTRL_TEST: setting up security profile 0...\n");
+    profile.validationLevel = 0;
+    profile.tlsVersion = 0;
+    profile.cipherSuite = -1;
+    profile.pSniStr = "ublox.com";
+    profile.sessionResumption = -1;
+#if CELLULAR_CTRL_SECURITY_TLS_SESSION_RESUMPTION
+    profile.sessionResumption = 1;
+#endif
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlSecurityProfileSet(0, &profile) == 0);
+    // Put it back to the defaults
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlSecurityProfileSet(0, NULL) == 0);
+
+    cellularPortLog("CELLULAR_CTRL_TEST: finishing off...\n");
+    cellularCtrlPowerOff(NULL);
+
+    // Check the number of consecutive AT timeouts
+    y = cellularCtrlGetConsecutiveAtTimeouts();
+    cellularPortLog("CELLULAR_CTRL_TEST: there have been %d consecutive AT timeouts.\n", y);
+    CELLULAR_PORT_TEST_ASSERT(y <= CELLULAR_CTRL_AT_CONSECUTIVE_TIMEOUTS_LIMIT);
+
+    cellularCtrlDeinit();
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartDeinit(CELLULAR_CFG_UART) == 0);
+    cellularPortDeinit();
+}
+
 // Only include the band-masks tests for modules with NB1 and CATM1
 // in their support bitmap since the relevant AT command is only available there.
 #if (CELLULAR_CTRL_SUPPORTED_RATS_BITMAP & (_CELLULAR_CTRL_SUPPORTED_RATS_BIT_NB1 | \
@@ -991,6 +1262,8 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularCtrlTestSetBandMask(),
 #endif // CELLULAR_CTRL_SUPPORTED_RATS_BITMAP & (_CELLULAR_CTRL_SUPPORTED_RATS_BIT_NB1 | 
        //                                        _CELLULAR_CTRL_SUPPORTED_RATS_BIT_CATM1)
 
+// The modem simulator of the POSIX platform is never switched off
+#if !defined(CELLULAR_PORT_TEST_SIMULATOR) || !CELLULAR_PORT_TEST_SIMULATOR
 /** Test power on/off and aliveness.
  * Note: it may seem more logical to put this test early on, however
  * in that case that the previous test run failed, the
@@ -1010,6 +1283,108 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularCtrlTestPowerAlive(),
     cellularCtrlTestPowerAliveVInt(CELLULAR_CFG_PIN_VINT);
 #endif
 }
+#endif // !defined(CELLULAR_PORT_TEST_SIMULATOR) || !CELLULAR_PORT_TEST_SIMULATOR
+
+/** Test that, while the AT link is marked as being recovered,
+ * everyone but the callbacks task of the AT client fails at once.
+ * The recovery itself needs a module that has stopped answering
+ * and so is not tested here.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularCtrlTestAtRecovery(),
+                            "ctrlAtRecovery",
+                            "ctrl")
+{
+    int64_t timeMs;
+
+    CELLULAR_PORT_TEST_ASSERT(cellularPortInit() == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartInit(CELLULAR_CFG_PIN_TXD,
+                                                   CELLULAR_CFG_PIN_RXD,
+                                                   CELLULAR_CFG_PIN_CTS,
+                                                   CELLULAR_CFG_PIN_RTS,
+                                                   CELLULAR_CFG_BAUD_RATE,
+                                                   CELLULAR_CFG_RTS_THRESHOLD,
+                                                   CELLULAR_CFG_UART,
+                                                   &gUartQueueHandle) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlInit(CELLULAR_CFG_PIN_ENABLE_POWER,
+                                               CELLULAR_CFG_PIN_PWR_ON,
+                                               CELLULAR_CFG_PIN_VINT,
+                                               false,
+                                               CELLULAR_CFG_UART,
+                                               gUartQueueHandle) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlPowerOn(NULL) == 0);
+    CELLULAR_PORT_TEST_ASSERT(!cellularCtrlIsRecovering());
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlIsAlive());
+
+    // Mark the link as being recovered: this task is not
+    // the callbacks task so it should fail, and fast
+    cellular_ctrl_at_set_recovering(true);
+    CELLULAR_PORT_TEST_ASSERT(cellular_ctrl_at_is_recovering());
+    timeMs = cellularPortGetTickTimeMs();
+    CELLULAR_PORT_TEST_ASSERT(!cellularCtrlIsAlive());
+    timeMs = cellularPortGetTickTimeMs() - timeMs;
+    cellularPortLog("CELLULAR_CTRL_TEST: failing took %d ms.\n", (int32_t) timeMs);
+    CELLULAR_PORT_TEST_ASSERT(timeMs < CELLULAR_CTRL_COMMAND_MINIMUM_RESPONSE_TIME_MS);
+    // Failing fast is not a timeout
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlGetConsecutiveAtTimeouts() == 0);
+
+    // Back to normal
+    cellular_ctrl_at_set_recovering(false);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlIsAlive());
+
+    cellularCtrlPowerOff(NULL);
+    cellularCtrlDeinit();
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartDeinit(CELLULAR_CFG_UART) == 0);
+    cellularPortDeinit();
+}
+
+// Needs the modem simulator of the POSIX platform, which sends a
+// line with no CR/LF that is longer than the receive buffer of the
+// AT client in response to ATI9
+#if defined(CELLULAR_PORT_TEST_SIMULATOR) && CELLULAR_PORT_TEST_SIMULATOR
+/** Test that a line which overflows the receive buffer of the AT
+ * client is thrown away and the "OK" after it still found, rather
+ * than the command failing and the line blocking those that follow.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularCtrlTestAtOverflow(),
+                            "ctrlAtOverflow",
+                            "ctrl")
+{
+    CELLULAR_PORT_TEST_ASSERT(cellularPortInit() == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartInit(CELLULAR_CFG_PIN_TXD,
+                                                   CELLULAR_CFG_PIN_RXD,
+                                                   CELLULAR_CFG_PIN_CTS,
+                                                   CELLULAR_CFG_PIN_RTS,
+                                                   CELLULAR_CFG_BAUD_RATE,
+                                                   CELLULAR_CFG_RTS_THRESHOLD,
+                                                   CELLULAR_CFG_UART,
+                                                   &gUartQueueHandle) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlInit(CELLULAR_CFG_PIN_ENABLE_POWER,
+                                               CELLULAR_CFG_PIN_PWR_ON,
+                                               CELLULAR_CFG_PIN_VINT,
+                                               false,
+                                               CELLULAR_CFG_UART,
+                                               gUartQueueHandle) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlPowerOn(NULL) == 0);
+
+    // Look for a prefix that never comes so that the whole
+    // line has to be buffered while searching for it
+    cellular_ctrl_at_lock();
+    cellular_ctrl_at_cmd_start("ATI9");
+    cellular_ctrl_at_cmd_stop();
+    cellular_ctrl_at_resp_start("+NOTHERE:", false);
+    cellular_ctrl_at_resp_stop();
+    CELLULAR_PORT_TEST_ASSERT(cellular_ctrl_at_unlock_return_error() == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlGetConsecutiveAtTimeouts() == 0);
+
+    // Nothing should be left behind to upset the next command
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlIsAlive());
+
+    cellularCtrlPowerOff(NULL);
+    cellularCtrlDeinit();
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartDeinit(CELLULAR_CFG_UART) == 0);
+    cellularPortDeinit();
+}
+#endif // defined(CELLULAR_PORT_TEST_SIMULATOR) && CELLULAR_PORT_TEST_SIMULATOR
 
 /** Test set/get RAT.
  */
@@ -1381,6 +1756,84 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularCtrlTestConnectedThings(),
     connectDisconnect(CELLULAR_CFG_TEST_RAT);
 }
 
+/** Connect without blocking, checking that the states are
+ * reported in order and that this task keeps running meanwhile.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularCtrlTestConnectAsync(),
+                            "ctrlConnectAsync",
+                            "ctrl")
+{
+    int64_t startTimeMs;
+    int32_t loops = 0;
+
+    CELLULAR_PORT_TEST_ASSERT(cellularPortInit() == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartInit(CELLULAR_CFG_PIN_TXD,
+                                                   CELLULAR_CFG_PIN_RXD,
+                                                   CELLULAR_CFG_PIN_CTS,
+                                                   CELLULAR_CFG_PIN_RTS,
+                                                   CELLULAR_CFG_BAUD_RATE,
+                                                   CELLULAR_CFG_RTS_THRESHOLD,
+                                                   CELLULAR_CFG_UART,
+                                                   &gUartQueueHandle) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlInit(CELLULAR_CFG_PIN_ENABLE_POWER,
+                                               CELLULAR_CFG_PIN_PWR_ON,
+                                               CELLULAR_CFG_PIN_VINT,
+                                               false,
+                                               CELLULAR_CFG_UART,
+                                               gUartQueueHandle) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlPowerOn(NULL) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlGetConnectState() == CELLULAR_CTRL_CONNECT_STATE_IDLE);
+
+    cellularPortLog("CELLULAR_CTRL_TEST: connecting asynchronously...\n");
+    gNumConnectStates = 0;
+    gConnectErrorCode = 0;
+    startTimeMs = cellularPortGetTickTimeMs();
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlConnectAsync(NULL, NULL, NULL,
+                                                       CELLULAR_CFG_TEST_CONNECT_TIMEOUT_SECONDS,
+                                                       connectAsyncCallback,
+                                                       NULL) == 0);
+    // A second attempt while the first is going should be refused
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlConnectAsync(NULL, NULL, NULL,
+                                                       CELLULAR_CFG_TEST_CONNECT_TIMEOUT_SECONDS,
+                                                       connectAsyncCallback,
+                                                       NULL) < 0);
+    while ((cellularCtrlGetConnectState() != CELLULAR_CTRL_CONNECT_STATE_CONNECTED) &&
+           (cellularCtrlGetConnectState() != CELLULAR_CTRL_CONNECT_STATE_FAILED) &&
+           (cellularPortGetTickTimeMs() - startTimeMs <
+            (CELLULAR_CFG_TEST_CONNECT_TIMEOUT_SECONDS + 10) * 1000)) {
+        // This task is free to do other work
+        cellularPortTaskBlock(100);
+        loops++;
+    }
+    cellularPortLog("CELLULAR_CTRL_TEST: asynchronous connect ended in state %d"
+                    " (error %d) after %d ms, %d loop(s) of this task.\n",
+                    cellularCtrlGetConnectState(), gConnectErrorCode,
+                    (int32_t) (cellularPortGetTickTimeMs() - startTimeMs), loops);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlGetConnectState() == CELLULAR_CTRL_CONNECT_STATE_CONNECTED);
+    CELLULAR_PORT_TEST_ASSERT(gConnectErrorCode == 0);
+    CELLULAR_PORT_TEST_ASSERT(loops > 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlIsRegistered());
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlGetIpAddressStr(NULL) > 0);
+    // The states must have come in order, ending in connected;
+    // REGISTERING may appear more than once if more than one APN
+    // was tried
+    CELLULAR_PORT_TEST_ASSERT(gNumConnectStates >= 4);
+    CELLULAR_PORT_TEST_ASSERT(gConnectStates[0] == CELLULAR_CTRL_CONNECT_STATE_REGISTERING);
+    for (size_t x = 1; x < gNumConnectStates; x++) {
+        CELLULAR_PORT_TEST_ASSERT((gConnectStates[x] > gConnectStates[x - 1]) ||
+                                  (gConnectStates[x] == CELLULAR_CTRL_CONNECT_STATE_REGISTERING));
+    }
+    CELLULAR_PORT_TEST_ASSERT(gConnectStates[gNumConnectStates - 1] == CELLULAR_CTRL_CONNECT_STATE_CONNECTED);
+
+    cellularPortLog("CELLULAR_CTRL_TEST: disconnecting...\n");
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlDisconnect() == 0);
+
+    cellularCtrlPowerOff(NULL);
+    cellularCtrlDeinit();
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartDeinit(CELLULAR_CFG_UART) == 0);
+    cellularPortDeinit();
+}
+
 /** Test get/set MNO profile.  Note that this test requires the
  * ability to connect with a network in order to check that
  * setting of an MNO profile is not allowed when connected.
@@ -1677,6 +2130,7 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularCtrlTestReadImeiEtc(),
                             "ctrl")
 {
     char buffer[64];
+    char buffer2[64];
     int32_t bytesRead;
     int32_t y;
 
@@ -1757,6 +2211,11 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularCtrlTestReadImeiEtc(),
     pCellularPort_memset(buffer, 0, sizeof(buffer));
     bytesRead = cellularCtrlGetModelStr(buffer, sizeof(buffer));
     CELLULAR_PORT_TEST_ASSERT((bytesRead > 0) && (bytesRead < sizeof(buffer) - 1) && (bytesRead == cellularPort_strlen(buffer)));
+    // Power-on should have picked the profile for this model
+    cellularPortLog("CELLULAR_CTRL_TEST: model is \"%s\", module profile is for \"%s\".\n",
+                    buffer, pCellularCtrlGetModuleProfile()->pModelPrefix);
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_memcmp(buffer, pCellularCtrlGetModuleProfile()->pModelPrefix,
+                                                  cellularPort_strlen(pCellularCtrlGetModuleProfile()->pModelPrefix)) == 0);
     cellularPortLog("CELLULAR_CTRL_TEST: getting and checking firmware version string...\n");
     // First use an unrealistically short buffer and check
     // that there is no overrun
@@ -1771,6 +2230,42 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularCtrlTestReadImeiEtc(),
     bytesRead = cellularCtrlGetFirmwareVersionStr(buffer, sizeof(buffer));
     CELLULAR_PORT_TEST_ASSERT((bytesRead > 0) && (bytesRead < sizeof(buffer) - 1) && (bytesRead == cellularPort_strlen(buffer)));
 
+    // Second time around these come from the identity
+    // cache: check that they are the same and that a
+    // short buffer is still not overrun
+    cellularPortLog("CELLULAR_CTRL_TEST: checking cached firmware version string...\n");
+    pCellularPort_memset(buffer2, 0, sizeof(buffer2));
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlGetFirmwareVersionStr(buffer2, sizeof(buffer2)) == bytesRead);
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_strcmp(buffer, buffer2) == 0);
+    pCellularPort_memset(buffer2, 0, sizeof(buffer2));
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlGetFirmwareVersionStr(buffer2, 2) == 1);
+    CELLULAR_PORT_TEST_ASSERT((buffer2[0] == buffer[0]) && (buffer2[1] == 0));
+    cellularPortLog("CELLULAR_CTRL_TEST: checking cached IMEI...\n");
+    pCellularPort_memset(buffer, 0, sizeof(buffer));
+    pCellularPort_memset(buffer2, 0, sizeof(buffer2));
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlGetImei(buffer) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlGetImei(buffer2) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_memcmp(buffer, buffer2, sizeof(buffer)) == 0);
+
+    // Refresh the lot with pipelined queries and check that
+    // the answers are the same as those obtained individually
+    cellularPortLog("CELLULAR_CTRL_TEST: refreshing identity in one go...\n");
+    pCellularPort_memset(buffer2, 0, sizeof(buffer2));
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlGetImsi(buffer2) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlRefreshIdentity() == 0);
+    pCellularPort_memset(buffer, 0, sizeof(buffer));
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlGetImsi(buffer) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_memcmp(buffer, buffer2, sizeof(buffer)) == 0);
+    pCellularPort_memset(buffer, 0, sizeof(buffer));
+    pCellularPort_memset(buffer2, 0, sizeof(buffer2));
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlGetImei(buffer) == 0);
+    for (size_t x = 0; x < CELLULAR_CTRL_IMEI_SIZE; x++) {
+        CELLULAR_PORT_TEST_ASSERT((buffer[x] >= '0') && (buffer[x] <= '9'));
+    }
+    bytesRead = cellularCtrlGetIccidStr(buffer2, sizeof(buffer2));
+    CELLULAR_PORT_TEST_ASSERT(bytesRead >= 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_strlen(buffer2) >= 19);
+
     cellularCtrlPowerOff(NULL);
 
     // Check the number of consecutive AT timeouts
@@ -1783,6 +2278,245 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularCtrlTestReadImeiEtc(),
     cellularPortDeinit();
 }
 
+/** Test setting and getting the PSM and eDRX settings; note
+ * that this only checks what is requested, what the network
+ * grants will be different.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularCtrlTestPsmEdrx(),
+                            "ctrlPsmEdrx",
+                            "ctrl")
+{
+    bool onNotOff;
+    int32_t periodicWakeupSeconds;
+    int32_t activeTimeSeconds;
+    int32_t edrxMs;
+
+    CELLULAR_PORT_TEST_ASSERT(cellularPortInit() == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartInit(CELLULAR_CFG_PIN_TXD,
+                                                   CELLULAR_CFG_PIN_RXD,
+                                                   CELLULAR_CFG_PIN_CTS,
+                                                   CELLULAR_CFG_PIN_RTS,
+                                                   CELLULAR_CFG_BAUD_RATE,
+                                                   CELLULAR_CFG_RTS_THRESHOLD,
+                                                   CELLULAR_CFG_UART,
+                                                   &gUartQueueHandle) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlInit(CELLULAR_CFG_PIN_ENABLE_POWER,
+                                               CELLULAR_CFG_PIN_PWR_ON,
+                                               CELLULAR_CFG_PIN_VINT,
+                                               false,
+                                               CELLULAR_CFG_UART,
+                                               gUartQueueHandle) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlPowerOn(NULL) == 0);
+    CELLULAR_PORT_TEST_ASSERT(!cellularCtrlIsAsleep());
+
+    cellularPortLog("CELLULAR_CTRL_TEST: requesting PSM...\n");
+    // One hour and one minute can both be encoded exactly
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlSetPsm(true, 3600, 60) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlGetPsm(&onNotOff,
+                                                 &periodicWakeupSeconds,
+                                                 &activeTimeSeconds) == 0);
+    cellularPortLog("CELLULAR_CTRL_TEST: PSM %s, periodic wake-up %d second(s),"
+                    " active time %d second(s).\n", onNotOff ? "on" : "off",
+                    periodicWakeupSeconds, activeTimeSeconds);
+    CELLULAR_PORT_TEST_ASSERT(onNotOff);
+    CELLULAR_PORT_TEST_ASSERT(periodicWakeupSeconds == 3600);
+    CELLULAR_PORT_TEST_ASSERT(activeTimeSeconds == 60);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlSetPsm(false, 0, 0) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlGetPsm(&onNotOff, NULL, NULL) == 0);
+    CELLULAR_PORT_TEST_ASSERT(!onNotOff);
+
+    cellularPortLog("CELLULAR_CTRL_TEST: requesting eDRX...\n");
+    // Something which isn't a cycle length should be rounded up
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlSetEdrx(CELLULAR_CFG_TEST_RAT,
+                                                  true, 20000) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlGetEdrx(CELLULAR_CFG_TEST_RAT,
+                                                  &onNotOff, &edrxMs) == 0);
+    cellularPortLog("CELLULAR_CTRL_TEST: eDRX %s, cycle %d ms.\n",
+                    onNotOff ? "on" : "off", edrxMs);
+    CELLULAR_PORT_TEST_ASSERT(onNotOff);
+    CELLULAR_PORT_TEST_ASSERT(edrxMs == 20480);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlSetEdrx(CELLULAR_CFG_TEST_RAT,
+                                                  false, 0) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlGetEdrx(CELLULAR_CFG_TEST_RAT,
+                                                  &onNotOff, &edrxMs) == 0);
+    CELLULAR_PORT_TEST_ASSERT(!onNotOff);
+    CELLULAR_PORT_TEST_ASSERT(edrxMs < 0);
+
+    cellularCtrlPowerOff(NULL);
+    cellularCtrlDeinit();
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartDeinit(CELLULAR_CFG_UART) == 0);
+    cellularPortDeinit();
+}
+
+// The modem simulator of the POSIX platform does no CMUX framing
+#if !defined(CELLULAR_PORT_TEST_SIMULATOR) || !CELLULAR_PORT_TEST_SIMULATOR
+/** Test CMUX: the AT interface should carry on working on its
+ * virtual channel and a second channel should give an AT
+ * interface of its own which can be used at the same time.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularCtrlTestCmux(),
+                            "ctrlCmux",
+                            "ctrl")
+{
+    CellularPortQueueHandle_t queueChannel = NULL;
+    int32_t uartChannel;
+    cellular_ctrl_at_client_t *pAtClient;
+    char buffer[32];
+    int32_t sizeBytes = 0;
+    int64_t startTimeMs;
+
+    CELLULAR_PORT_TEST_ASSERT(cellularPortInit() == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartInit(CELLULAR_CFG_PIN_TXD,
+                                                   CELLULAR_CFG_PIN_RXD,
+                                                   CELLULAR_CFG_PIN_CTS,
+                                                   CELLULAR_CFG_PIN_RTS,
+                                                   CELLULAR_CFG_BAUD_RATE,
+                                                   CELLULAR_CFG_RTS_THRESHOLD,
+                                                   CELLULAR_CFG_UART,
+                                                   &gUartQueueHandle) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlInit(CELLULAR_CFG_PIN_ENABLE_POWER,
+                                               CELLULAR_CFG_PIN_PWR_ON,
+                                               CELLULAR_CFG_PIN_VINT,
+                                               false,
+                                               CELLULAR_CFG_UART,
+                                               gUartQueueHandle) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlPowerOn(NULL) == 0);
+
+    cellularPortLog("CELLULAR_CTRL_TEST: starting CMUX...\n");
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlCmuxStart() == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlCmuxIsRunning());
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlIsAlive());
+
+    // Open a second channel and talk AT on it directly
+    uartChannel = cellularCtrlCmuxChannelOpen(2, &queueChannel);
+    cellularPortLog("CELLULAR_CTRL_TEST: second CMUX channel is UART %d.\n",
+                    uartChannel);
+    CELLULAR_PORT_TEST_ASSERT(CELLULAR_CTRL_CMUX_IS_UART(uartChannel));
+    CELLULAR_PORT_TEST_ASSERT(queueChannel != NULL);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlCmuxWrite(uartChannel, "AT\r", 3) == 3);
+    startTimeMs = cellularPortGetTickTimeMs();
+    while ((sizeBytes < (int32_t) sizeof(buffer) - 1) &&
+           (cellularPortGetTickTimeMs() - startTimeMs < 5000)) {
+        if (cellularCtrlCmuxEventTryReceive(queueChannel, 100) >= 0) {
+            sizeBytes += cellularCtrlCmuxRead(uartChannel, buffer + sizeBytes,
+                                              sizeof(buffer) - sizeBytes - 1);
+        }
+        buffer[sizeBytes] = '\0';
+        if (pCellularPort_strstr(buffer, "OK") != NULL) {
+            break;
+        }
+    }
+    CELLULAR_PORT_TEST_ASSERT(pCellularPort_strstr(buffer, "OK") != NULL);
+    // Meanwhile the AT interface should still work
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlIsAlive());
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlCmuxGetLostBytes(uartChannel) == 0);
+
+    // Now run a second AT client on the channel alongside the
+    // default one
+    pAtClient = cellular_ctrl_at_client_create(uartChannel, queueChannel);
+    CELLULAR_PORT_TEST_ASSERT(pAtClient != NULL);
+    CELLULAR_PORT_TEST_ASSERT(pAtClient != cellular_ctrl_at_client_default());
+    CELLULAR_PORT_TEST_ASSERT(cellular_ctrl_at_client_sync(pAtClient, 1000));
+    cellular_ctrl_at_client_lock(pAtClient);
+    cellular_ctrl_at_client_cmd_start(pAtClient, "AT");
+    cellular_ctrl_at_client_cmd_stop(pAtClient);
+    cellular_ctrl_at_client_resp_start(pAtClient, NULL, false);
+    cellular_ctrl_at_client_resp_stop(pAtClient);
+    CELLULAR_PORT_TEST_ASSERT(cellular_ctrl_at_client_unlock_return_error(pAtClient) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlIsAlive());
+    cellular_ctrl_at_client_destroy(pAtClient);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlCmuxChannelClose(uartChannel) == 0);
+
+    cellularPortLog("CELLULAR_CTRL_TEST: stopping CMUX...\n");
+    cellularCtrlCmuxStop();
+    CELLULAR_PORT_TEST_ASSERT(!cellularCtrlCmuxIsRunning());
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlIsAlive());
+
+    cellularCtrlPowerOff(NULL);
+    cellularCtrlDeinit();
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartDeinit(CELLULAR_CFG_UART) == 0);
+    cellularPortDeinit();
+}
+#endif // !defined(CELLULAR_PORT_TEST_SIMULATOR) || !CELLULAR_PORT_TEST_SIMULATOR
+
+/** Test the transmit scheduler: the module is not registered so
+ * the radio conditions are never good enough and only deadlines,
+ * flushing and stopping release what is held back.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularCtrlTestTxScheduler(),
+                            "ctrlTxScheduler",
+                            "ctrl")
+{
+    int64_t startTimeMs;
+
+    gTxSchedulerNumSent = 0;
+    gTxSchedulerSent[0] = 0;
+
+    CELLULAR_PORT_TEST_ASSERT(cellularPortInit() == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartInit(CELLULAR_CFG_PIN_TXD,
+                                                   CELLULAR_CFG_PIN_RXD,
+                                                   CELLULAR_CFG_PIN_CTS,
+                                                   CELLULAR_CFG_PIN_RTS,
+                                                   CELLULAR_CFG_BAUD_RATE,
+                                                   CELLULAR_CFG_RTS_THRESHOLD,
+                                                   CELLULAR_CFG_UART,
+                                                   &gUartQueueHandle) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlInit(CELLULAR_CFG_PIN_ENABLE_POWER,
+                                               CELLULAR_CFG_PIN_PWR_ON,
+                                               CELLULAR_CFG_PIN_VINT,
+                                               false,
+                                               CELLULAR_CFG_UART,
+                                               gUartQueueHandle) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlPowerOn(NULL) == 0);
+
+    cellularPortLog("CELLULAR_CTRL_TEST: sending with the scheduler stopped...\n");
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlTxSchedulerSend(txSchedulerSendCallback,
+                                                          NULL, "a", 1, 60) == 1);
+    CELLULAR_PORT_TEST_ASSERT(gTxSchedulerNumSent == 1);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlTxSchedulerSend(NULL, NULL, "a", 1, 60) < 0);
+
+    cellularPortLog("CELLULAR_CTRL_TEST: starting the transmit scheduler...\n");
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlTxSchedulerStart(0, 0, 0) < 0);
+    // No RSRP is ever zero dBm or better
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlTxSchedulerStart(0, 0, 1) == 0);
+    startTimeMs = cellularPortGetTickTimeMs();
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlTxSchedulerSend(txSchedulerSendCallback,
+                                                          NULL, "b", 1, 3) == 1);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlTxSchedulerSend(txSchedulerSendCallback,
+                                                          NULL, "c", 1, 60) == 1);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlTxSchedulerGetPendingBytes() == 2);
+    // Urgent traffic goes straight away
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlTxSchedulerSend(txSchedulerSendCallback,
+                                                          NULL, "d", 1, 0) == 1);
+    CELLULAR_PORT_TEST_ASSERT(gTxSchedulerNumSent == 2);
+
+    cellularPortLog("CELLULAR_CTRL_TEST: waiting for a deadline...\n");
+    CELLULAR_PORT_TEST_ASSERT(txSchedulerWaitSent(3, 10000));
+    cellularPortLog("CELLULAR_CTRL_TEST: deadline of 3 seconds met after %d ms.\n",
+                    (int32_t) (cellularPortGetTickTimeMs() - startTimeMs));
+    CELLULAR_PORT_TEST_ASSERT(cellularPortGetTickTimeMs() - startTimeMs >= 3000);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlTxSchedulerGetPendingBytes() == 1);
+
+    cellularPortLog("CELLULAR_CTRL_TEST: flushing...\n");
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlTxSchedulerFlush() == 0);
+    CELLULAR_PORT_TEST_ASSERT(txSchedulerWaitSent(4, 5000));
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlTxSchedulerGetPendingBytes() == 0);
+
+    cellularPortLog("CELLULAR_CTRL_TEST: stopping with something held back...\n");
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlTxSchedulerSend(txSchedulerSendCallback,
+                                                          NULL, "e", 1, 60) == 1);
+    cellularCtrlTxSchedulerStop();
+    CELLULAR_PORT_TEST_ASSERT(gTxSchedulerNumSent == 5);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlTxSchedulerGetPendingBytes() == 0);
+    cellularPortLog("CELLULAR_CTRL_TEST: sent \"%s\".\n", gTxSchedulerSent);
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_strcmp(gTxSchedulerSent, "adbce") == 0);
+
+    cellularCtrlPowerOff(NULL);
+    cellularCtrlDeinit();
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartDeinit(CELLULAR_CFG_UART) == 0);
+    cellularPortDeinit();
+}
+
 /** Clean-up to be run at the end of this round of tests, just
  * in case there were test failures which would have resulted
  * in the deinitialisation being skipped.
@@ -0,0 +1,183 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _CELLULAR_FS_H_
+#define _CELLULAR_FS_H_
+
+/* No #includes allowed here */
+
+/* This header file defines an API for moving files to and from the
+ * file system of the cellular module, in large blocks, straight
+ * between the AT interface and the application's buffers, so that
+ * a payload that the module is to use from a file (e.g. for HTTP,
+ * MQTT publish-from-file or FOTA) need never be staged whole in
+ * MCU RAM.  The functions are stateless and thread-safe: each AT
+ * command is sent with the AT interface locked, so file transfers
+ * interleave safely with other AT traffic, and no initialisation
+ * is required beyond that of cellular_ctrl.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS
+ * -------------------------------------------------------------- */
+
+/** The maximum length of a file name on the module, not
+ * including the terminator.
+ */
+#define CELLULAR_FS_FILE_NAME_MAX_LENGTH_BYTES 248
+
+/** Whether the module has a file system that can be reached
+ * through AT+UDWNFILE/AT+URDBLOCK.
+ */
+#ifndef CELLULAR_FS_IS_SUPPORTED
+# error CELLULAR_FS_IS_SUPPORTED must be defined in cellular_cfg_module.h.
+#endif
+
+/** The most that cellularFsRead() asks for with a single
+ * AT+URDBLOCK; less is asked for if the module will not give
+ * this much in one go.
+ */
+#ifndef CELLULAR_FS_READ_BLOCK_MAX_LENGTH_BYTES
+# error CELLULAR_FS_READ_BLOCK_MAX_LENGTH_BYTES must be defined in cellular_cfg_module.h.
+#endif
+
+/* ----------------------------------------------------------------
+ * TYPES
+ * -------------------------------------------------------------- */
+
+/** Error codes.
+ */
+typedef enum {
+    CELLULAR_FS_SUCCESS = 0,
+    CELLULAR_FS_UNKNOWN_ERROR = -1,
+    CELLULAR_FS_NOT_INITIALISED = -2,
+    CELLULAR_FS_NOT_IMPLEMENTED = -3,
+    CELLULAR_FS_NOT_RESPONDING = -4,
+    CELLULAR_FS_INVALID_PARAMETER = -5,
+    CELLULAR_FS_NO_MEMORY = -6,
+    CELLULAR_FS_PLATFORM_ERROR = -7,
+    CELLULAR_FS_AT_ERROR = -8,
+    CELLULAR_FS_NOT_SUPPORTED = -9,
+    CELLULAR_FS_ABORTED = -10,
+    CELLULAR_FS_FORCE_32_BIT = 0x7FFFFFFF // Force this enum to be 32 bit
+                                          // as it can be used as a size
+                                          // also
+} CellularFsErrorCode_t;
+
+/* ----------------------------------------------------------------
+ * FUNCTIONS
+ * -------------------------------------------------------------- */
+
+/** Write data to a file on the module, AT+UDWNFILE, the data
+ * going straight from pData to the UART.  If the file already
+ * exists the data is appended to it: a file larger than the
+ * MCU could hold at once can be built up by calling this
+ * repeatedly, calling cellularFsDelete() first to start afresh.
+ *
+ * @param pFileNameStr the NULL terminated name of the file.
+ * @param pData        the data to write.
+ * @param sizeBytes    the number of bytes at pData, must be
+ *                     greater than zero.
+ * @return             zero on success or negative error code.
+ */
+int32_t cellularFsWrite(const char *pFileNameStr,
+                        const void *pData, size_t sizeBytes);
+
+/** As cellularFsWrite() but with the data, sizeBytes of it in
+ * total, being fetched from the application a chunk at a time
+ * during the transfer, so that it may come from wherever the
+ * application keeps it (e.g. external flash) without being
+ * copied into one buffer first.  The AT interface is locked for
+ * the whole transfer, so pSourceCallback must not itself use
+ * the AT interface.
+ *
+ * @param pFileNameStr    the NULL terminated name of the file.
+ * @param sizeBytes       the total number of bytes to write,
+ *                        must be greater than zero.
+ * @param pSourceCallback called for each chunk of data: it
+ *                        must set *ppData to point at the
+ *                        next chunk, which must remain valid
+ *                        until the next call, and return its
+ *                        length, or return zero or a negative
+ *                        value to abort.  Anything beyond what
+ *                        remains of sizeBytes is ignored.  If
+ *                        the transfer is aborted the module is
+ *                        given filler to complete it and the
+ *                        file is then deleted.
+ * @param pCallbackParam  a parameter passed to pSourceCallback.
+ * @return                zero on success or negative error code,
+ *                        CELLULAR_FS_ABORTED if pSourceCallback
+ *                        aborted the transfer.
+ */
+int32_t cellularFsWriteStream(const char *pFileNameStr,
+                              size_t sizeBytes,
+                              int32_t (*pSourceCallback) (const char **ppData,
+                                                          void *pCallbackParam),
+                              void *pCallbackParam);
+
+/** Read from a file on the module, AT+URDBLOCK, starting at
+ * a given offset, the data going straight from the UART to
+ * pBuffer.  The read is made in blocks of at most
+ * CELLULAR_FS_READ_BLOCK_MAX_LENGTH_BYTES, the AT interface
+ * being released between blocks, and stops at the end of
+ * the file.  The block size comes down to what the module
+ * will give in one go: if it returns a block that is short of
+ * the end of the file, or refuses the first block, which is
+ * then asked for again in smaller pieces, that size is used
+ * from then on.  Hence a read that ends short of sizeBytes
+ * takes one more AT+URDBLOCK to find the end of the file and
+ * a read that fails, e.g. because the file does not exist,
+ * takes a few more AT+URDBLOCKs to fail.
+ *
+ * @param pFileNameStr the NULL terminated name of the file.
+ * @param offset       the offset into the file to start
+ *                     reading from.
+ * @param pBuffer      a place to put the data.
+ * @param sizeBytes    the number of bytes to read.
+ * @return             the number of bytes read, which will be
+ *                     less than sizeBytes if the end of the file
+ *                     was reached, or negative error code.
+ */
+int32_t cellularFsRead(const char *pFileNameStr, size_t offset,
+                       void *pBuffer, size_t sizeBytes);
+
+/** Get the size of a file on the module, AT+ULSTFILE.
+ *
+ * @param pFileNameStr the NULL terminated name of the file.
+ * @return             the size of the file in bytes or negative
+ *                     error code, e.g. if there is no such file.
+ */
+int32_t cellularFsGetSize(const char *pFileNameStr);
+
+/** Delete a file on the module, AT+UDELFILE.
+ *
+ * @param pFileNameStr the NULL terminated name of the file.
+ * @return             zero on success or negative error code,
+ *                     e.g. if there is no such file.
+ */
+int32_t cellularFsDelete(const char *pFileNameStr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _CELLULAR_FS_H_
+
+// End of file
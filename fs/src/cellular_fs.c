@@ -0,0 +1,407 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Only #includes of cellular_* are allowed here, no C lib,
+ * no platform stuff and no OS stuff.  Anything required from
+ * the platform/C library/OS must be brought in through
+ * cellular_port* to maintain portability.
+ */
+
+#ifdef CELLULAR_CFG_OVERRIDE
+# include "cellular_cfg_override.h" // For a customer's configuration override
+#endif
+#include "cellular_cfg_sw.h"
+#include "cellular_cfg_module.h"
+#include "cellular_port_clib.h"
+#include "cellular_port.h"
+#include "cellular_port_debug.h"
+#include "cellular_port_os.h"
+#include "cellular_ctrl_at.h"
+#include "cellular_fs.h"
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS
+ * -------------------------------------------------------------- */
+
+/** The size of the block of filler sent to the module to
+ * complete an AT+UDWNFILE that the application has aborted.
+ */
+#define CELLULAR_FS_FILLER_SIZE_BYTES 64
+
+/** The least that cellularFsRead() will come down to asking
+ * for with a single AT+URDBLOCK when the module refuses a
+ * request as too big.
+ */
+#define CELLULAR_FS_READ_BLOCK_MIN_LENGTH_BYTES 64
+
+/* ----------------------------------------------------------------
+ * TYPES
+ * -------------------------------------------------------------- */
+
+/** The state of a write from a buffer, for bufferSource().
+ */
+typedef struct {
+    const char *pData;
+    size_t sizeBytes;
+} CellularFsBuffer_t;
+
+/* ----------------------------------------------------------------
+ * VARIABLES
+ * -------------------------------------------------------------- */
+
+#if CELLULAR_FS_IS_SUPPORTED
+// Filler for an aborted AT+UDWNFILE.
+static const uint8_t gFiller[CELLULAR_FS_FILLER_SIZE_BYTES] = {0};
+
+// The most to ask for with a single AT+URDBLOCK, learnt from
+// what the module gives back: it starts at
+// CELLULAR_FS_READ_BLOCK_MAX_LENGTH_BYTES and comes down to
+// the size of a block that the module returned short of the
+// end of the file or, if the module refused a request, to
+// the size of the first smaller request that it accepted.
+// Only written with the AT interface locked.
+static size_t gReadBlockSizeBytes = CELLULAR_FS_READ_BLOCK_MAX_LENGTH_BYTES;
+#endif
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+#if CELLULAR_FS_IS_SUPPORTED
+// Check that a file name is usable.
+static bool fileNameIsValid(const char *pFileNameStr)
+{
+    size_t length;
+
+    if (pFileNameStr == NULL) {
+        return false;
+    }
+    length = cellularPort_strlen(pFileNameStr);
+
+    return (length > 0) && (length <= CELLULAR_FS_FILE_NAME_MAX_LENGTH_BYTES);
+}
+#endif
+
+// The source for cellularFsWrite(): the whole buffer in one go.
+static int32_t bufferSource(const char **ppData, void *pParam)
+{
+    CellularFsBuffer_t *pBuffer = (CellularFsBuffer_t *) pParam;
+    int32_t sizeBytes = (int32_t) pBuffer->sizeBytes;
+
+    *ppData = pBuffer->pData;
+    pBuffer->pData += pBuffer->sizeBytes;
+    pBuffer->sizeBytes = 0;
+
+    return sizeBytes;
+}
+
+#if CELLULAR_FS_IS_SUPPORTED
+// Delete a file, AT interface locked; the outcome is left
+// in the last error of the AT client.
+static void deleteLocked(const char *pFileNameStr)
+{
+    cellular_ctrl_at_cmd_start("AT+UDELFILE=");
+    cellular_ctrl_at_write_string(pFileNameStr, true);
+    cellular_ctrl_at_cmd_stop_read_resp();
+}
+
+// Read a block with AT+URDBLOCK, AT interface locked, returning
+// the number of bytes read or negative error code.
+static int32_t readBlockLocked(const char *pFileNameStr, size_t offset,
+                               char *pBuffer, size_t sizeBytes)
+{
+    int32_t sizeOrErrorCode = (int32_t) CELLULAR_FS_AT_ERROR;
+    int32_t blockSizeBytes = -1;
+    uint8_t quoteMark;
+
+    cellular_ctrl_at_set_send_delay_class(CELLULAR_CTRL_AT_SEND_DELAY_CLASS_DATA);
+    cellular_ctrl_at_cmd_start("AT+URDBLOCK=");
+    cellular_ctrl_at_write_string(pFileNameStr, true);
+    cellular_ctrl_at_write_int((int32_t) offset);
+    cellular_ctrl_at_write_int((int32_t) sizeBytes);
+    cellular_ctrl_at_cmd_stop();
+    // +URDBLOCK: "name",<length>,"<data>"
+    cellular_ctrl_at_read_fields("+URDBLOCK:", "-,i", &blockSizeBytes);
+    if (blockSizeBytes > 0) {
+        // Don't stop for anything!
+        cellular_ctrl_at_set_delimiter(0);
+        cellular_ctrl_at_set_stop_tag(NULL);
+        // Get the leading quote mark out of the way
+        cellular_ctrl_at_read_bytes(&quoteMark, 1);
+        if ((size_t) blockSizeBytes > sizeBytes) {
+            // Not asked for: take what was, pour the rest away
+            cellular_ctrl_at_read_bytes((uint8_t *) pBuffer, sizeBytes);
+            cellular_ctrl_at_read_bytes(NULL, blockSizeBytes - sizeBytes);
+            blockSizeBytes = (int32_t) sizeBytes;
+        } else {
+            cellular_ctrl_at_read_bytes((uint8_t *) pBuffer, blockSizeBytes);
+        }
+    }
+    cellular_ctrl_at_resp_stop();
+    cellular_ctrl_at_set_default_delimiter();
+    if ((cellular_ctrl_at_get_last_error() == 0) && (blockSizeBytes >= 0)) {
+        sizeOrErrorCode = blockSizeBytes;
+    }
+
+    return sizeOrErrorCode;
+}
+#endif
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// Write to a file from a buffer.
+int32_t cellularFsWrite(const char *pFileNameStr,
+                        const void *pData, size_t sizeBytes)
+{
+    CellularFsBuffer_t buffer;
+
+    if (pData == NULL) {
+        return (int32_t) CELLULAR_FS_INVALID_PARAMETER;
+    }
+    buffer.pData = (const char *) pData;
+    buffer.sizeBytes = sizeBytes;
+
+    return cellularFsWriteStream(pFileNameStr, sizeBytes,
+                                 bufferSource, &buffer);
+}
+
+// Write to a file from chunks provided by the application.
+int32_t cellularFsWriteStream(const char *pFileNameStr,
+                              size_t sizeBytes,
+                              int32_t (*pSourceCallback) (const char **ppData,
+                                                          void *pCallbackParam),
+                              void *pCallbackParam)
+{
+    CellularFsErrorCode_t errorCode = CELLULAR_FS_INVALID_PARAMETER;
+    const char *pChunk;
+    int32_t chunkSizeBytes;
+    size_t leftBytes = sizeBytes;
+    size_t x;
+
+#if CELLULAR_FS_IS_SUPPORTED
+    if (fileNameIsValid(pFileNameStr) && (sizeBytes > 0) &&
+        (pSourceCallback != NULL)) {
+        errorCode = CELLULAR_FS_AT_ERROR;
+        cellular_ctrl_at_lock();
+        cellular_ctrl_at_set_send_delay_class(CELLULAR_CTRL_AT_SEND_DELAY_CLASS_DATA);
+        cellular_ctrl_at_cmd_start("AT+UDWNFILE=");
+        cellular_ctrl_at_write_string(pFileNameStr, true);
+        cellular_ctrl_at_write_int((int32_t) sizeBytes);
+        cellular_ctrl_at_cmd_stop();
+        // Wait for the prompt and then send the data
+        // straight from wherever the application has it
+        if (cellular_ctrl_at_wait_char('>')) {
+            while (leftBytes > 0) {
+                pChunk = NULL;
+                chunkSizeBytes = pSourceCallback(&pChunk, pCallbackParam);
+                if ((chunkSizeBytes <= 0) || (pChunk == NULL)) {
+                    break;
+                }
+                if ((size_t) chunkSizeBytes > leftBytes) {
+                    chunkSizeBytes = (int32_t) leftBytes;
+                }
+                if (cellular_ctrl_at_write_bytes((const uint8_t *) pChunk,
+                                                 chunkSizeBytes) != (size_t) chunkSizeBytes) {
+                    break;
+                }
+                leftBytes -= chunkSizeBytes;
+            }
+            // If the application gave up the module is still
+            // waiting for the rest: give it filler so that
+            // it comes out of data mode
+            while ((leftBytes > 0) &&
+                   (cellular_ctrl_at_get_last_error() == 0)) {
+                x = leftBytes;
+                if (x > sizeof(gFiller)) {
+                    x = sizeof(gFiller);
+                }
+                cellular_ctrl_at_write_bytes(gFiller, x);
+                leftBytes -= x;
+                errorCode = CELLULAR_FS_ABORTED;
+            }
+            cellular_ctrl_at_resp_start(NULL, false);
+            cellular_ctrl_at_resp_stop();
+            if (errorCode == CELLULAR_FS_ABORTED) {
+                // Don't leave the filler lying around
+                cellular_ctrl_at_clear_error();
+                deleteLocked(pFileNameStr);
+            } else if (cellular_ctrl_at_get_last_error() == 0) {
+                errorCode = CELLULAR_FS_SUCCESS;
+            }
+        }
+        cellular_ctrl_at_unlock();
+        if (errorCode != CELLULAR_FS_SUCCESS) {
+            cellularPortLog("CELLULAR_FS: unable to write %d byte(s) to"
+                            " file \"%s\" (%d).\n", (int32_t) sizeBytes,
+                            pFileNameStr, errorCode);
+        }
+    }
+#else
+    (void) pFileNameStr;
+    (void) sizeBytes;
+    (void) pSourceCallback;
+    (void) pCallbackParam;
+    (void) pChunk;
+    (void) chunkSizeBytes;
+    (void) leftBytes;
+    (void) x;
+    errorCode = CELLULAR_FS_NOT_SUPPORTED;
+#endif
+
+    return (int32_t) errorCode;
+}
+
+// Read from a file.
+int32_t cellularFsRead(const char *pFileNameStr, size_t offset,
+                       void *pBuffer, size_t sizeBytes)
+{
+    int32_t sizeOrErrorCode = (int32_t) CELLULAR_FS_INVALID_PARAMETER;
+    int32_t blockSizeBytes;
+    size_t readBytes = 0;
+    size_t x;
+    size_t shortBlockSizeBytes = 0;
+
+#if CELLULAR_FS_IS_SUPPORTED
+    if (fileNameIsValid(pFileNameStr) && (pBuffer != NULL)) {
+        sizeOrErrorCode = 0;
+        while ((sizeOrErrorCode >= 0) && (readBytes < sizeBytes)) {
+            x = sizeBytes - readBytes;
+            if (x > gReadBlockSizeBytes) {
+                x = gReadBlockSizeBytes;
+            }
+            // Lock per block so that other AT traffic
+            // is not held up for the whole read
+            cellular_ctrl_at_lock();
+            blockSizeBytes = readBlockLocked(pFileNameStr, offset + readBytes,
+                                             ((char *) pBuffer) + readBytes, x);
+            // Some modules refuse to give more than a certain
+            // amount in one go: if the first request is refused
+            // try smaller ones, the first that is accepted
+            // setting the size for every read after it
+            while ((blockSizeBytes < 0) && (readBytes == 0) &&
+                   (x > CELLULAR_FS_READ_BLOCK_MIN_LENGTH_BYTES)) {
+                x /= 2;
+                if (x < CELLULAR_FS_READ_BLOCK_MIN_LENGTH_BYTES) {
+                    x = CELLULAR_FS_READ_BLOCK_MIN_LENGTH_BYTES;
+                }
+                cellular_ctrl_at_clear_error();
+                blockSizeBytes = readBlockLocked(pFileNameStr, offset,
+                                                 (char *) pBuffer, x);
+                if (blockSizeBytes > 0) {
+                    gReadBlockSizeBytes = x;
+                }
+            }
+            if ((blockSizeBytes > 0) && (shortBlockSizeBytes > 0)) {
+                // The last block came up short but wasn't the
+                // end of the file: that is all the module will
+                // give in one go
+                gReadBlockSizeBytes = shortBlockSizeBytes;
+                shortBlockSizeBytes = 0;
+            }
+            cellular_ctrl_at_unlock();
+            if (blockSizeBytes <= 0) {
+                // The end of the file: some modules give an error
+                // rather than an empty block when asked to read
+                // from there, that is only an error if nothing
+                // has been read
+                if ((blockSizeBytes < 0) && (readBytes == 0)) {
+                    sizeOrErrorCode = blockSizeBytes;
+                }
+                break;
+            }
+            readBytes += blockSizeBytes;
+            if ((size_t) blockSizeBytes < x) {
+                // Either the end of the file or the most the
+                // module gives in one go: the next block, which
+                // will be empty at the end of the file, says which
+                shortBlockSizeBytes = blockSizeBytes;
+            }
+        }
+        if (sizeOrErrorCode >= 0) {
+            sizeOrErrorCode = (int32_t) readBytes;
+        }
+    }
+#else
+    (void) pFileNameStr;
+    (void) offset;
+    (void) pBuffer;
+    (void) sizeBytes;
+    (void) blockSizeBytes;
+    (void) readBytes;
+    (void) x;
+    (void) shortBlockSizeBytes;
+    sizeOrErrorCode = (int32_t) CELLULAR_FS_NOT_SUPPORTED;
+#endif
+
+    return sizeOrErrorCode;
+}
+
+// Get the size of a file.
+int32_t cellularFsGetSize(const char *pFileNameStr)
+{
+    int32_t sizeOrErrorCode = (int32_t) CELLULAR_FS_INVALID_PARAMETER;
+    int32_t sizeBytes = -1;
+
+#if CELLULAR_FS_IS_SUPPORTED
+    if (fileNameIsValid(pFileNameStr)) {
+        sizeOrErrorCode = (int32_t) CELLULAR_FS_AT_ERROR;
+        cellular_ctrl_at_lock();
+        cellular_ctrl_at_cmd_start("AT+ULSTFILE=");
+        // Size of a file
+        cellular_ctrl_at_write_int(2);
+        cellular_ctrl_at_write_string(pFileNameStr, true);
+        cellular_ctrl_at_cmd_stop();
+        cellular_ctrl_at_read_fields("+ULSTFILE:", "i", &sizeBytes);
+        cellular_ctrl_at_resp_stop();
+        if ((cellular_ctrl_at_unlock_return_error() == 0) &&
+            (sizeBytes >= 0)) {
+            sizeOrErrorCode = sizeBytes;
+        }
+    }
+#else
+    (void) pFileNameStr;
+    (void) sizeBytes;
+    sizeOrErrorCode = (int32_t) CELLULAR_FS_NOT_SUPPORTED;
+#endif
+
+    return sizeOrErrorCode;
+}
+
+// Delete a file.
+int32_t cellularFsDelete(const char *pFileNameStr)
+{
+    CellularFsErrorCode_t errorCode = CELLULAR_FS_INVALID_PARAMETER;
+
+#if CELLULAR_FS_IS_SUPPORTED
+    if (fileNameIsValid(pFileNameStr)) {
+        errorCode = CELLULAR_FS_AT_ERROR;
+        cellular_ctrl_at_lock();
+        deleteLocked(pFileNameStr);
+        if (cellular_ctrl_at_unlock_return_error() == 0) {
+            errorCode = CELLULAR_FS_SUCCESS;
+        }
+    }
+#else
+    (void) pFileNameStr;
+    errorCode = CELLULAR_FS_NOT_SUPPORTED;
+#endif
+
+    return (int32_t) errorCode;
+}
+
+// End of file
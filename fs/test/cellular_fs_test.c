@@ -0,0 +1,234 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Only #includes of cellular_* are allowed here, no C lib,
+ * no platform stuff and no OS stuff.  Anything required from
+ * the platform/C library/OS must be brought in through
+ * cellular_port* to maintain portability.
+ */
+
+#ifdef CELLULAR_CFG_OVERRIDE
+# include "cellular_cfg_override.h" // For a customer's configuration override
+#endif
+#include "cellular_cfg_sw.h"
+#include "cellular_cfg_module.h"
+#include "cellular_cfg_hw_platform_specific.h"
+#include "cellular_port_clib.h"
+#include "cellular_port.h"
+#include "cellular_port_debug.h"
+#include "cellular_port_os.h"
+#include "cellular_port_uart.h"
+#include "cellular_port_test_platform_specific.h"
+#include "cellular_ctrl.h"
+#include "cellular_fs.h"
+#include "cellular_cfg_test.h"
+
+#if CELLULAR_FS_IS_SUPPORTED
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS
+ * -------------------------------------------------------------- */
+
+// The name of the file to test with.
+#define CELLULAR_FS_TEST_FILE_NAME "ucell_fs_test"
+
+// The size of the test file: more than two read blocks and
+// not a multiple of one.
+#define CELLULAR_FS_TEST_FILE_SIZE_BYTES ((CELLULAR_FS_READ_BLOCK_MAX_LENGTH_BYTES * 2) + 100)
+
+// The size of the chunks handed over by sourceCallback().
+#define CELLULAR_FS_TEST_CHUNK_SIZE_BYTES 100
+
+/* ----------------------------------------------------------------
+ * TYPES
+ * -------------------------------------------------------------- */
+
+/* ----------------------------------------------------------------
+ * VARIABLES
+ * -------------------------------------------------------------- */
+
+// The UART queue handle: kept as a global variable
+// because if a test fails init will have run but
+// deinit will have been skipped.  With this as a global,
+// when the inits skip doing their thing because
+// things are already init'ed, the subsequent
+// functions will continue to use this valid queue
+// handle.
+static CellularPortQueueHandle_t gUartQueueHandle = NULL;
+
+// A string of all possible characters, including strings
+// that might appear as terminators in the AT interface
+static const char gAllChars[] = "the quick brown fox jumps over the lazy dog "
+                                "THE QUICK BROWN FOX JUMPS OVER THE LAZY DOG 0123456789 "
+                                "\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d\x0e"
+                                "\x0f\x10\x11\x12\x13\x14\x15\x16\x17\x18\x19\x1a\x1b\x1c"
+                                "\x1d\x1e!\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~\x7f"
+                                "\r\nOK\r\n \r\nERROR\r\n";
+
+// What is written to the file.
+static char gFileContents[CELLULAR_FS_TEST_FILE_SIZE_BYTES];
+
+// What is read from the file.
+static char gReadBuffer[CELLULAR_FS_TEST_FILE_SIZE_BYTES + 10];
+
+// How far through gFileContents sourceCallback() has got.
+static size_t gSourceOffset;
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// Hand over gFileContents a chunk at a time from gSourceOffset,
+// giving up at the point given by *pParam.
+static int32_t sourceCallback(const char **ppData, void *pParam)
+{
+    size_t stopAt = *((size_t *) pParam);
+    int32_t sizeBytes = CELLULAR_FS_TEST_CHUNK_SIZE_BYTES;
+
+    if (gSourceOffset >= stopAt) {
+        return 0;
+    }
+    if (sizeBytes > (int32_t) (stopAt - gSourceOffset)) {
+        sizeBytes = (int32_t) (stopAt - gSourceOffset);
+    }
+    *ppData = gFileContents + gSourceOffset;
+    gSourceOffset += sizeBytes;
+
+    return sizeBytes;
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+/** Write a file in two parts, one from a buffer and one
+ * streamed, read it back in whole and in part, abort a
+ * streamed write and delete the file.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularFsTestWriteRead(),
+                            "fsWriteRead",
+                            "fs")
+{
+    size_t firstPartBytes = CELLULAR_FS_TEST_FILE_SIZE_BYTES / 3;
+    size_t stopAt;
+    size_t offset;
+    int32_t x;
+
+    for (x = 0; x < (int32_t) sizeof(gFileContents); x++) {
+        gFileContents[x] = gAllChars[x % (sizeof(gAllChars) - 1)];
+    }
+
+    CELLULAR_PORT_TEST_ASSERT(cellularPortInit() == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartInit(CELLULAR_CFG_PIN_TXD,
+                                                   CELLULAR_CFG_PIN_RXD,
+                                                   CELLULAR_CFG_PIN_CTS,
+                                                   CELLULAR_CFG_PIN_RTS,
+                                                   CELLULAR_CFG_BAUD_RATE,
+                                                   CELLULAR_CFG_RTS_THRESHOLD,
+                                                   CELLULAR_CFG_UART,
+                                                   &gUartQueueHandle) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlInit(CELLULAR_CFG_PIN_ENABLE_POWER,
+                                               CELLULAR_CFG_PIN_PWR_ON,
+                                               CELLULAR_CFG_PIN_VINT,
+                                               false,
+                                               CELLULAR_CFG_UART,
+                                               gUartQueueHandle) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlPowerOn(NULL) == 0);
+
+    // Bad parameters
+    CELLULAR_PORT_TEST_ASSERT(cellularFsWrite(NULL, gFileContents, 1) == CELLULAR_FS_INVALID_PARAMETER);
+    CELLULAR_PORT_TEST_ASSERT(cellularFsWrite("", gFileContents, 1) == CELLULAR_FS_INVALID_PARAMETER);
+    CELLULAR_PORT_TEST_ASSERT(cellularFsWrite(CELLULAR_FS_TEST_FILE_NAME, NULL, 1) == CELLULAR_FS_INVALID_PARAMETER);
+    CELLULAR_PORT_TEST_ASSERT(cellularFsWrite(CELLULAR_FS_TEST_FILE_NAME, gFileContents, 0) == CELLULAR_FS_INVALID_PARAMETER);
+    CELLULAR_PORT_TEST_ASSERT(cellularFsRead(CELLULAR_FS_TEST_FILE_NAME, 0, NULL, 1) == CELLULAR_FS_INVALID_PARAMETER);
+
+    // Start afresh, don't care if there was no file
+    cellularFsDelete(CELLULAR_FS_TEST_FILE_NAME);
+    CELLULAR_PORT_TEST_ASSERT(cellularFsGetSize(CELLULAR_FS_TEST_FILE_NAME) < 0);
+
+    // Write the first part from the buffer and append the
+    // rest streamed
+    cellularPortLog("CELLULAR_FS_TEST: writing %d byte(s) to \"%s\"...\n",
+                    (int32_t) sizeof(gFileContents), CELLULAR_FS_TEST_FILE_NAME);
+    CELLULAR_PORT_TEST_ASSERT(cellularFsWrite(CELLULAR_FS_TEST_FILE_NAME,
+                                              gFileContents,
+                                              firstPartBytes) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularFsGetSize(CELLULAR_FS_TEST_FILE_NAME) == (int32_t) firstPartBytes);
+    gSourceOffset = firstPartBytes;
+    stopAt = sizeof(gFileContents);
+    CELLULAR_PORT_TEST_ASSERT(cellularFsWriteStream(CELLULAR_FS_TEST_FILE_NAME,
+                                                    sizeof(gFileContents) - firstPartBytes,
+                                                    sourceCallback, &stopAt) == 0);
+    CELLULAR_PORT_TEST_ASSERT(gSourceOffset == sizeof(gFileContents));
+    CELLULAR_PORT_TEST_ASSERT(cellularFsGetSize(CELLULAR_FS_TEST_FILE_NAME) == (int32_t) sizeof(gFileContents));
+
+    // Read it all back, asking for more than there is
+    pCellularPort_memset(gReadBuffer, 0, sizeof(gReadBuffer));
+    x = cellularFsRead(CELLULAR_FS_TEST_FILE_NAME, 0, gReadBuffer, sizeof(gReadBuffer));
+    cellularPortLog("CELLULAR_FS_TEST: read %d byte(s).\n", x);
+    CELLULAR_PORT_TEST_ASSERT(x == (int32_t) sizeof(gFileContents));
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_memcmp(gReadBuffer, gFileContents, sizeof(gFileContents)) == 0);
+
+    // Read a part that straddles a block boundary
+    offset = CELLULAR_FS_READ_BLOCK_MAX_LENGTH_BYTES - 10;
+    pCellularPort_memset(gReadBuffer, 0, sizeof(gReadBuffer));
+    CELLULAR_PORT_TEST_ASSERT(cellularFsRead(CELLULAR_FS_TEST_FILE_NAME, offset,
+                                             gReadBuffer, 20) == 20);
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_memcmp(gReadBuffer, gFileContents + offset, 20) == 0);
+
+    // Read from the end
+    CELLULAR_PORT_TEST_ASSERT(cellularFsRead(CELLULAR_FS_TEST_FILE_NAME,
+                                             sizeof(gFileContents),
+                                             gReadBuffer, 10) == 0);
+
+    // Start again and abort a streamed write part way:
+    // there should be no file left behind
+    CELLULAR_PORT_TEST_ASSERT(cellularFsDelete(CELLULAR_FS_TEST_FILE_NAME) == 0);
+    gSourceOffset = 0;
+    stopAt = CELLULAR_FS_TEST_CHUNK_SIZE_BYTES * 2;
+    CELLULAR_PORT_TEST_ASSERT(cellularFsWriteStream(CELLULAR_FS_TEST_FILE_NAME,
+                                                    sizeof(gFileContents),
+                                                    sourceCallback, &stopAt) == CELLULAR_FS_ABORTED);
+    CELLULAR_PORT_TEST_ASSERT(cellularFsGetSize(CELLULAR_FS_TEST_FILE_NAME) < 0);
+
+    // Check that the AT interface is still fine
+    CELLULAR_PORT_TEST_ASSERT(cellularFsWrite(CELLULAR_FS_TEST_FILE_NAME,
+                                              gFileContents, 10) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularFsDelete(CELLULAR_FS_TEST_FILE_NAME) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularFsDelete(CELLULAR_FS_TEST_FILE_NAME) < 0);
+
+    cellularCtrlPowerOff(NULL);
+    cellularCtrlDeinit();
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartDeinit(CELLULAR_CFG_UART) == 0);
+    cellularPortDeinit();
+}
+
+/** Clean-up to be run at the end of this round of tests, just
+ * in case there were test failures which would have resulted
+ * in the deinitialisation being skipped.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularFsTestCleanUp(),
+                            "fsCleanUp",
+                            "fs")
+{
+    cellularCtrlDeinit();
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartDeinit(CELLULAR_CFG_UART) == 0);
+    cellularPortDeinit();
+}
+
+#endif // CELLULAR_FS_IS_SUPPORTED
+
+// End of file
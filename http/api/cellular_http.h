@@ -0,0 +1,272 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _CELLULAR_HTTP_H_
+#define _CELLULAR_HTTP_H_
+
+/* No #includes allowed here */
+
+/* This header file defines the cellular HTTP client API, which uses
+ * the HTTP(S) client inside the module (AT+UHTTP/AT+UHTTPC): the
+ * module does the TCP and TLS work, writes the response into a file
+ * on its file system and the response body is then streamed to the
+ * application in large blocks through the fs API, so that a large
+ * GET costs a handful of AT commands rather than one per socket
+ * read.  These functions are thread-safe with the proviso that
+ * there is only one HTTP client instance underneath: requests
+ * are made one at a time.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS
+ * -------------------------------------------------------------- */
+
+/** The maximum length of an HTTP server address string.
+ */
+#ifndef CELLULAR_HTTP_SERVER_ADDRESS_STRING_MAX_LENGTH_BYTES
+# define CELLULAR_HTTP_SERVER_ADDRESS_STRING_MAX_LENGTH_BYTES 256
+#endif
+
+/** The HTTP profile of the module that is used.
+ */
+#ifndef CELLULAR_HTTP_PROFILE_ID
+# define CELLULAR_HTTP_PROFILE_ID 0
+#endif
+
+/** The name of the file on the module which the response
+ * to a request is written to by cellularHttpGet(),
+ * cellularHttpHead() and cellularHttpPost().
+ */
+#ifndef CELLULAR_HTTP_RESPONSE_FILE_NAME
+# define CELLULAR_HTTP_RESPONSE_FILE_NAME "ucell_http_rsp"
+#endif
+
+/** The name of the file on the module which the body of
+ * a request is written to by cellularHttpPost().
+ */
+#ifndef CELLULAR_HTTP_REQUEST_FILE_NAME
+# define CELLULAR_HTTP_REQUEST_FILE_NAME "ucell_http_req"
+#endif
+
+/** Whether the module has an HTTP client.
+ */
+#ifndef CELLULAR_HTTP_IS_SUPPORTED
+# error CELLULAR_HTTP_IS_SUPPORTED must be defined in cellular_cfg_module.h.
+#endif
+
+/** The time to wait for an HTTP request to be completed.
+ */
+#ifndef CELLULAR_HTTP_SERVER_RESPONSE_WAIT_SECONDS
+# error CELLULAR_HTTP_SERVER_RESPONSE_WAIT_SECONDS must be defined in cellular_cfg_module.h.
+#endif
+
+/* ----------------------------------------------------------------
+ * TYPES
+ * -------------------------------------------------------------- */
+
+/** Error codes.
+ */
+typedef enum {
+    CELLULAR_HTTP_SUCCESS = 0,
+    CELLULAR_HTTP_UNKNOWN_ERROR = -1,
+    CELLULAR_HTTP_NOT_INITIALISED = -2,
+    CELLULAR_HTTP_NOT_IMPLEMENTED = -3,
+    CELLULAR_HTTP_NOT_RESPONDING = -4,
+    CELLULAR_HTTP_INVALID_PARAMETER = -5,
+    CELLULAR_HTTP_NO_MEMORY = -6,
+    CELLULAR_HTTP_PLATFORM_ERROR = -7,
+    CELLULAR_HTTP_AT_ERROR = -8,
+    CELLULAR_HTTP_NOT_SUPPORTED = -9,
+    CELLULAR_HTTP_TIMEOUT = -10,
+    CELLULAR_HTTP_BAD_ADDRESS = -11,
+    CELLULAR_HTTP_REQUEST_FAILED = -12,
+    CELLULAR_HTTP_BAD_RESPONSE = -13,
+    CELLULAR_HTTP_FORCE_32_BIT = 0x7FFFFFFF // Force this enum to be 32 bit
+                                            // as it can be used as a size
+                                            // also
+} CellularHttpErrorCode_t;
+
+/** The content type of the body of a POST, as understood
+ * by AT+UHTTPC.
+ */
+typedef enum {
+    CELLULAR_HTTP_CONTENT_TYPE_FORM_URLENCODED = 0,
+    CELLULAR_HTTP_CONTENT_TYPE_TEXT_PLAIN = 1,
+    CELLULAR_HTTP_CONTENT_TYPE_OCTET_STREAM = 2,
+    CELLULAR_HTTP_CONTENT_TYPE_MULTIPART_FORM_DATA = 3,
+    CELLULAR_HTTP_CONTENT_TYPE_JSON = 4,
+    CELLULAR_HTTP_CONTENT_TYPE_XML = 5,
+    MAX_NUM_CELLULAR_HTTP_CONTENT_TYPES
+} CellularHttpContentType_t;
+
+/* ----------------------------------------------------------------
+ * FUNCTIONS
+ * -------------------------------------------------------------- */
+
+/** Initialise the HTTP client, pointing it at a server.  If the
+ * client is already initialised then this function returns
+ * immediately.  The cellular module must be powered up for this
+ * function to work.
+ * IMPORTANT: if you re-boot the cellular module after calling
+ * this function you will lose all settings and must call
+ * cellularHttpDeinit() followed by cellularHttpInit() to put
+ * them back again.
+ *
+ * @param pServerNameStr     the NULL terminated string that gives
+ *                           the name of the server, a domain name
+ *                           or an IP address, optionally followed
+ *                           by a port number, e.g.
+ *                           "example.com:8080"; without a port
+ *                           number 80, or 443 once security is on,
+ *                           is used.
+ * @param pUserNameStr       the NULL terminated user name for
+ *                           basic authentication, NULL for none.
+ * @param pPasswordStr       the NULL terminated password for
+ *                           basic authentication, ignored if
+ *                           pUserNameStr is NULL.
+ * @param pKeepGoingCallback a request has to wait for the server
+ *                           and this may take some time: while
+ *                           waiting this callback is called and
+ *                           while it returns true the wait
+ *                           continues, until the request is
+ *                           complete or
+ *                           CELLULAR_HTTP_SERVER_RESPONSE_WAIT_SECONDS
+ *                           is reached.  May be used to feed a
+ *                           watchdog.  May be NULL.
+ * @return                   zero on success or negative error code.
+ */
+int32_t cellularHttpInit(const char *pServerNameStr,
+                         const char *pUserNameStr,
+                         const char *pPasswordStr,
+                         bool (*pKeepGoingCallback)(void));
+
+/** Shut-down the HTTP client.
+ */
+void cellularHttpDeinit();
+
+/** Switch HTTPS on, using a security profile already set up
+ * on the module with AT+USECPRF.
+ * IMPORTANT: a re-boot of the cellular module will lose your
+ * setting.
+ *
+ * @param securityProfileId the security profile ID, -1 for
+ *                          the module's default.
+ * @return                  zero on success or negative error code.
+ */
+int32_t cellularHttpSetSecurityOn(int32_t securityProfileId);
+
+/** Switch HTTPS off.
+ *
+ * @return zero on success or negative error code.
+ */
+int32_t cellularHttpSetSecurityOff();
+
+/** GET a resource from the server, leaving the whole response,
+ * headers and body, in a file on the module: for a payload that
+ * the module is to use itself, e.g. for FOTA, or which the
+ * application will read with cellularFsRead() later.
+ *
+ * @param pPathStr     the NULL terminated path on the server,
+ *                     e.g. "/firmware/v2.bin".
+ * @param pFileNameStr the NULL terminated name of the file on
+ *                     the module to write the response to.
+ * @return             the HTTP status code of the response,
+ *                     e.g. 200, or negative error code.
+ */
+int32_t cellularHttpGetToFile(const char *pPathStr,
+                              const char *pFileNameStr);
+
+/** GET a resource from the server, delivering the body of the
+ * response to the application through a callback in blocks
+ * as large as the buffer it provides.
+ *
+ * @param pPathStr       the NULL terminated path on the server.
+ * @param pBuffer        a buffer to read the response into, which
+ *                       must be large enough to hold all of the
+ *                       response headers; a buffer of at least
+ *                       CELLULAR_FS_READ_BLOCK_MAX_LENGTH_BYTES
+ *                       gives the fewest AT commands.
+ * @param bufferSizeBytes the size of pBuffer.
+ * @param pBodyCallback  called with each block of the body in
+ *                       turn, the offset of that block in the
+ *                       body and pCallbackParam; it returns
+ *                       false to stop the delivery.  May be
+ *                       NULL if only the status is wanted.
+ * @param pCallbackParam a parameter passed to pBodyCallback.
+ * @return               the HTTP status code of the response,
+ *                       e.g. 200, or negative error code; the
+ *                       body is delivered whatever the status.
+ */
+int32_t cellularHttpGet(const char *pPathStr,
+                        char *pBuffer, size_t bufferSizeBytes,
+                        bool (*pBodyCallback)(const char *pData,
+                                              size_t sizeBytes,
+                                              size_t offset,
+                                              void *pCallbackParam),
+                        void *pCallbackParam);
+
+/** As cellularHttpGet() but a HEAD request: only the status
+ * of the response is returned.
+ *
+ * @param pPathStr the NULL terminated path on the server.
+ * @return         the HTTP status code of the response or
+ *                 negative error code.
+ */
+int32_t cellularHttpHead(const char *pPathStr);
+
+/** POST data to the server, the data being written to a file
+ * on the module first with cellularFsWrite(), the body of the
+ * response being delivered as for cellularHttpGet().
+ *
+ * @param pPathStr        the NULL terminated path on the server.
+ * @param pData           the data to POST.
+ * @param sizeBytes       the number of bytes at pData.
+ * @param contentType     the content type of pData.
+ * @param pBuffer         as for cellularHttpGet().
+ * @param bufferSizeBytes as for cellularHttpGet().
+ * @param pBodyCallback   as for cellularHttpGet().
+ * @param pCallbackParam  as for cellularHttpGet().
+ * @return                the HTTP status code of the response or
+ *                        negative error code.
+ */
+int32_t cellularHttpPost(const char *pPathStr,
+                         const void *pData, size_t sizeBytes,
+                         CellularHttpContentType_t contentType,
+                         char *pBuffer, size_t bufferSizeBytes,
+                         bool (*pBodyCallback)(const char *pData,
+                                               size_t sizeBytes,
+                                               size_t offset,
+                                               void *pCallbackParam),
+                         void *pCallbackParam);
+
+/** Get the last HTTP error code from the module, AT+UHTTPER.
+ *
+ * @return an error code, the meaning of which is utterly module
+ *         specific, or negative error code.
+ */
+int32_t cellularHttpGetLastErrorCode();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _CELLULAR_HTTP_H_
+
+// End of file
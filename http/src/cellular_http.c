@@ -0,0 +1,705 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Only #includes of cellular_* are allowed here, no C lib,
+ * no platform stuff and no OS stuff.  Anything required from
+ * the platform/C library/OS must be brought in through
+ * cellular_port* to maintain portability.
+ */
+
+#ifdef CELLULAR_CFG_OVERRIDE
+# include "cellular_cfg_override.h" // For a customer's configuration override
+#endif
+#include "cellular_cfg_sw.h"
+#include "cellular_cfg_module.h"
+#include "cellular_port_clib.h"
+#include "cellular_port.h"
+#include "cellular_port_debug.h"
+#include "cellular_port_os.h"
+#include "cellular_ctrl_at.h"
+#include "cellular_ctrl.h"
+#include "cellular_sock.h" // Required for IP address manipulation
+#include "cellular_fs.h"
+#include "cellular_http.h"
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS
+ * -------------------------------------------------------------- */
+
+/** Return "not supported" if this module doesn't support HTTP.
+ */
+#if CELLULAR_HTTP_IS_SUPPORTED
+# define CELLULAR_HTTP_DEFAULT_ERROR_CODE CELLULAR_HTTP_NOT_INITIALISED
+#else
+# define CELLULAR_HTTP_DEFAULT_ERROR_CODE CELLULAR_HTTP_NOT_SUPPORTED
+#endif
+
+/** The longest to wait on gQueueUrcEvent before calling
+ * gpKeepGoingCallback again while waiting for the server.
+ */
+#define CELLULAR_HTTP_URC_EVENT_WAIT_MS 1000
+
+/** Room for the status line of a response, enough for
+ * "HTTP/1.1 200".
+ */
+#define CELLULAR_HTTP_STATUS_LINE_LENGTH_BYTES 16
+
+/* ----------------------------------------------------------------
+ * TYPES
+ * -------------------------------------------------------------- */
+
+/** The HTTP commands of AT+UHTTPC.
+ */
+typedef enum {
+    CELLULAR_HTTP_COMMAND_HEAD = 0,
+    CELLULAR_HTTP_COMMAND_GET = 1,
+    CELLULAR_HTTP_COMMAND_POST_FILE = 4
+} CellularHttpCommand_t;
+
+/** What the +UUHTTPCR URC tells us.
+ */
+typedef struct {
+    bool updateFlag;
+    int32_t command;
+    int32_t result;
+} HttpUrcStatus_t;
+
+/* ----------------------------------------------------------------
+ * VARIABLES
+ * -------------------------------------------------------------- */
+
+/** Callback to be called while waiting for the server.
+ */
+static bool (*gpKeepGoingCallback)(void) = NULL;
+
+/** Mutex protection, held for the whole of a request.
+ */
+static CellularPortMutexHandle_t gMutex = NULL;
+
+/** Queue which UUHTTPCR_urc() uses to wake up a request
+ * that is waiting for the server.
+ */
+static CellularPortQueueHandle_t gQueueUrcEvent = NULL;
+
+/** Set when an event is waiting on gQueueUrcEvent so that a URC
+ * never blocks trying to send another.
+ */
+static volatile bool gUrcEventPending = false;
+
+/** Store the status values from the URC.
+ */
+static volatile HttpUrcStatus_t gUrcStatus;
+
+#if CELLULAR_CFG_STATIC_ALLOC
+/** Buffer in which cellularHttpInit() works on the server
+ * address.
+ */
+static char gServerAddress[CELLULAR_HTTP_SERVER_ADDRESS_STRING_MAX_LENGTH_BYTES + 1];
+#endif
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS: URCS AND RELATED FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// +UUHTTPCR: <profile>,<command>,<result>
+static void UUHTTPCR_urc(void *pUnused)
+{
+    int32_t profileId;
+    int32_t command;
+    int32_t result;
+    int32_t dummy = 0;
+
+    (void) pUnused;
+
+    profileId = cellular_ctrl_at_read_int();
+    command = cellular_ctrl_at_read_int();
+    result = cellular_ctrl_at_read_int();
+    if ((profileId == CELLULAR_HTTP_PROFILE_ID) && (result >= 0)) {
+        gUrcStatus.command = command;
+        gUrcStatus.result = result;
+        gUrcStatus.updateFlag = true;
+        if ((gQueueUrcEvent != NULL) && !gUrcEventPending) {
+            gUrcEventPending = true;
+            cellularPortQueueSend(gQueueUrcEvent, &dummy);
+        }
+    }
+}
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS: MISC
+ * -------------------------------------------------------------- */
+
+// Clear gUrcStatus.updateFlag and any event left over
+// from before, ready to wait for the server.
+static void clearUrcEvent()
+{
+    int32_t dummy;
+
+    gUrcStatus.updateFlag = false;
+    while (cellularPortQueueTryReceive(gQueueUrcEvent, 0, &dummy) == 0) {}
+    gUrcEventPending = false;
+}
+
+// Wait for an event from a URC, or for
+// CELLULAR_HTTP_URC_EVENT_WAIT_MS, returning false if
+// stopTimeMs has passed or gpKeepGoingCallback() says stop.
+static bool waitUrcEvent(int64_t stopTimeMs)
+{
+    int32_t dummy;
+    bool keepGoing;
+
+    keepGoing = (cellularPortGetTickTimeMs() < stopTimeMs) &&
+                ((gpKeepGoingCallback == NULL) ||
+                 gpKeepGoingCallback());
+    if (keepGoing &&
+        (cellularPortQueueTryReceive(gQueueUrcEvent,
+                                     CELLULAR_HTTP_URC_EVENT_WAIT_MS,
+                                     &dummy) == 0)) {
+        gUrcEventPending = false;
+    }
+
+    return keepGoing;
+}
+
+// Get the error codes of the HTTP profile, returning the
+// second, the detailed one, or negative error code.
+static int32_t getErrorCode()
+{
+    int32_t err1 = -1;
+    int32_t err2 = -1;
+
+    cellular_ctrl_at_lock();
+    cellular_ctrl_at_cmd_start("AT+UHTTPER=");
+    cellular_ctrl_at_write_int(CELLULAR_HTTP_PROFILE_ID);
+    cellular_ctrl_at_cmd_stop();
+    // Skip the profile ID
+    cellular_ctrl_at_read_fields("+UHTTPER:", "-,i,i", &err1, &err2);
+    cellular_ctrl_at_resp_stop();
+    if (cellular_ctrl_at_unlock_return_error() != 0) {
+        err2 = (int32_t) CELLULAR_HTTP_AT_ERROR;
+    }
+    cellularPortLog("CELLULAR_HTTP: error codes %d, %d.\n", err1, err2);
+
+    return err2;
+}
+
+// Send an AT+UHTTP command that has been started, returning
+// 0 for success or negative error code.
+static CellularHttpErrorCode_t atHttpStopCmdGetRespAndUnlock()
+{
+    CellularHttpErrorCode_t errorCode = CELLULAR_HTTP_AT_ERROR;
+
+    cellular_ctrl_at_cmd_stop_read_resp();
+    if (cellular_ctrl_at_unlock_return_error() == 0) {
+        errorCode = CELLULAR_HTTP_SUCCESS;
+    }
+
+    return errorCode;
+}
+
+// Start an AT+UHTTP command for our profile with the given
+// operation code.
+static void atHttpCmdStart(int32_t opCode)
+{
+    cellular_ctrl_at_lock();
+    cellular_ctrl_at_cmd_start("AT+UHTTP=");
+    cellular_ctrl_at_write_int(CELLULAR_HTTP_PROFILE_ID);
+    cellular_ctrl_at_write_int(opCode);
+}
+
+// Set the server from a string that may be an IP address
+// or a domain name, either with an optional port number.
+static CellularHttpErrorCode_t setServer(const char *pServerNameStr)
+{
+    CellularHttpErrorCode_t errorCode = CELLULAR_HTTP_NO_MEMORY;
+    CellularSockAddress_t address;
+    char *pAddress;
+    char *pTmp;
+    int32_t port = -1;
+
+#if CELLULAR_CFG_STATIC_ALLOC
+    pAddress = gServerAddress;
+#else
+    pAddress = (char *) pCellularPort_mallocTag(CELLULAR_HTTP_SERVER_ADDRESS_STRING_MAX_LENGTH_BYTES + 1,
+                                                CELLULAR_PORT_MALLOC_TAG_HTTP);
+#endif
+    if (pAddress != NULL) {
+        errorCode = CELLULAR_HTTP_BAD_ADDRESS;
+        pCellularPort_memset(&address, 0, sizeof(address));
+        if (cellularSockStringToAddress(pServerNameStr,
+                                        &address) == 0) {
+            // An IP address: convert the bit that isn't
+            // a port number back into a string
+            if (cellularSockIpAddressToString(&(address.ipAddress),
+                                              pAddress,
+                                              CELLULAR_HTTP_SERVER_ADDRESS_STRING_MAX_LENGTH_BYTES) == 0) {
+                atHttpCmdStart(0);
+                cellular_ctrl_at_write_string(pAddress, true);
+                errorCode = atHttpStopCmdGetRespAndUnlock();
+                if (address.port > 0) {
+                    port = address.port;
+                }
+            }
+        } else {
+            // A domain name, which has to be copied
+            // in order to remove any port number
+            pCellularPort_strcpy(pAddress, pServerNameStr);
+            port = cellularSockDomainGetPort(pAddress);
+            pTmp = pCellularSockDomainRemovePort(pAddress);
+            atHttpCmdStart(1);
+            cellular_ctrl_at_write_string(pTmp, true);
+            errorCode = atHttpStopCmdGetRespAndUnlock();
+        }
+        if ((errorCode == CELLULAR_HTTP_SUCCESS) && (port >= 0)) {
+            atHttpCmdStart(5);
+            cellular_ctrl_at_write_int(port);
+            errorCode = atHttpStopCmdGetRespAndUnlock();
+        }
+#if !CELLULAR_CFG_STATIC_ALLOC
+        cellularPort_free(pAddress);
+#endif
+    }
+
+    return errorCode;
+}
+
+// Get the status code from the start of a response,
+// e.g. "HTTP/1.1 200 OK", returning it or negative error code.
+static int32_t statusCodeGet(const char *pResponse, size_t sizeBytes)
+{
+    int32_t statusCodeOrError = (int32_t) CELLULAR_HTTP_BAD_RESPONSE;
+    size_t x = 0;
+
+    if ((sizeBytes > 5) &&
+        (cellularPort_memcmp(pResponse, "HTTP/", 5) == 0)) {
+        // Skip the version
+        while ((x < sizeBytes) && (pResponse[x] != ' ')) {
+            x++;
+        }
+        if ((x + 3 < sizeBytes) &&
+            cellularPort_isdigit((int32_t) pResponse[x + 1]) &&
+            cellularPort_isdigit((int32_t) pResponse[x + 2]) &&
+            cellularPort_isdigit((int32_t) pResponse[x + 3])) {
+            statusCodeOrError = ((pResponse[x + 1] - '0') * 100) +
+                                ((pResponse[x + 2] - '0') * 10) +
+                                (pResponse[x + 3] - '0');
+        }
+    }
+
+    return statusCodeOrError;
+}
+
+// Find the end of the headers in a response, returning the
+// offset of the body or -1 if the end of the headers is not
+// within sizeBytes.
+static int32_t bodyOffsetGet(const char *pResponse, size_t sizeBytes)
+{
+    int32_t offset = -1;
+
+    for (size_t x = 0; (x + 4 <= sizeBytes) && (offset < 0); x++) {
+        if ((pResponse[x] == '\r') && (pResponse[x + 1] == '\n') &&
+            (pResponse[x + 2] == '\r') && (pResponse[x + 3] == '\n')) {
+            offset = (int32_t) x + 4;
+        }
+    }
+
+    return offset;
+}
+
+// Make a request, the response going to pFileNameStr, and wait
+// for it to complete; gMutex must be locked.  Returns zero
+// on success or negative error code.
+static CellularHttpErrorCode_t requestLocked(CellularHttpCommand_t command,
+                                             const char *pPathStr,
+                                             const char *pFileNameStr,
+                                             CellularHttpContentType_t contentType)
+{
+    CellularHttpErrorCode_t errorCode = CELLULAR_HTTP_AT_ERROR;
+    int64_t stopTimeMs;
+
+    clearUrcEvent();
+    cellular_ctrl_at_lock();
+    cellular_ctrl_at_cmd_start("AT+UHTTPC=");
+    cellular_ctrl_at_write_int(CELLULAR_HTTP_PROFILE_ID);
+    cellular_ctrl_at_write_int(command);
+    cellular_ctrl_at_write_string(pPathStr, true);
+    cellular_ctrl_at_write_string(pFileNameStr, true);
+    if (command == CELLULAR_HTTP_COMMAND_POST_FILE) {
+        cellular_ctrl_at_write_string(CELLULAR_HTTP_REQUEST_FILE_NAME, true);
+        cellular_ctrl_at_write_int(contentType);
+    }
+    cellular_ctrl_at_cmd_stop_read_resp();
+    if (cellular_ctrl_at_unlock_return_error() == 0) {
+        // Wait for +UUHTTPCR
+        errorCode = CELLULAR_HTTP_TIMEOUT;
+        stopTimeMs = cellularPortGetTickTimeMs() +
+                     (CELLULAR_HTTP_SERVER_RESPONSE_WAIT_SECONDS * 1000);
+        while ((!gUrcStatus.updateFlag ||
+                (gUrcStatus.command != (int32_t) command)) &&
+               waitUrcEvent(stopTimeMs)) {}
+        if (gUrcStatus.updateFlag &&
+            (gUrcStatus.command == (int32_t) command)) {
+            errorCode = CELLULAR_HTTP_SUCCESS;
+            if (gUrcStatus.result != 1) {
+                errorCode = CELLULAR_HTTP_REQUEST_FAILED;
+                getErrorCode();
+            }
+        }
+    }
+
+    return errorCode;
+}
+
+// Get the status code of the response in the given file,
+// returning it or negative error code.
+static int32_t fileStatusCodeGet(const char *pFileNameStr)
+{
+    char buffer[CELLULAR_HTTP_STATUS_LINE_LENGTH_BYTES];
+    int32_t sizeOrErrorCode;
+
+    sizeOrErrorCode = cellularFsRead(pFileNameStr, 0, buffer, sizeof(buffer));
+    if (sizeOrErrorCode < 0) {
+        return (int32_t) CELLULAR_HTTP_AT_ERROR;
+    }
+
+    return statusCodeGet(buffer, sizeOrErrorCode);
+}
+
+// Deliver the body of the response in the given file to
+// pBodyCallback a buffer at a time, returning the status
+// code of the response or negative error code.
+static int32_t bodyDeliver(const char *pFileNameStr,
+                           char *pBuffer, size_t bufferSizeBytes,
+                           bool (*pBodyCallback)(const char *,
+                                                 size_t, size_t,
+                                                 void *),
+                           void *pCallbackParam)
+{
+    int32_t statusCodeOrError;
+    int32_t sizeOrErrorCode;
+    int32_t bodyOffset;
+    size_t fileOffset;
+    size_t offset = 0;
+    bool keepGoing;
+
+    // The first buffer-full has the headers in it
+    sizeOrErrorCode = cellularFsRead(pFileNameStr, 0, pBuffer, bufferSizeBytes);
+    if (sizeOrErrorCode < 0) {
+        return (int32_t) CELLULAR_HTTP_AT_ERROR;
+    }
+    statusCodeOrError = statusCodeGet(pBuffer, sizeOrErrorCode);
+    if ((statusCodeOrError >= 0) && (pBodyCallback != NULL)) {
+        bodyOffset = bodyOffsetGet(pBuffer, sizeOrErrorCode);
+        if (bodyOffset < 0) {
+            // Either the headers are broken or they
+            // don't fit into the buffer
+            cellularPortLog("CELLULAR_HTTP: end of headers not found in"
+                            " first %d byte(s) of response.\n",
+                            sizeOrErrorCode);
+            return (int32_t) CELLULAR_HTTP_BAD_RESPONSE;
+        }
+        keepGoing = true;
+        if (sizeOrErrorCode > bodyOffset) {
+            keepGoing = pBodyCallback(pBuffer + bodyOffset,
+                                      sizeOrErrorCode - bodyOffset,
+                                      0, pCallbackParam);
+            offset = sizeOrErrorCode - bodyOffset;
+        }
+        fileOffset = sizeOrErrorCode;
+        // The rest of the body, straight from the file
+        // system of the module into the application's buffer
+        while (keepGoing && ((size_t) sizeOrErrorCode == bufferSizeBytes)) {
+            sizeOrErrorCode = cellularFsRead(pFileNameStr, fileOffset,
+                                             pBuffer, bufferSizeBytes);
+            if (sizeOrErrorCode < 0) {
+                statusCodeOrError = (int32_t) CELLULAR_HTTP_AT_ERROR;
+                keepGoing = false;
+            } else if (sizeOrErrorCode > 0) {
+                keepGoing = pBodyCallback(pBuffer, sizeOrErrorCode,
+                                          offset, pCallbackParam);
+                offset += sizeOrErrorCode;
+                fileOffset += sizeOrErrorCode;
+            }
+        }
+    }
+
+    return statusCodeOrError;
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// Initialise the HTTP client.
+int32_t cellularHttpInit(const char *pServerNameStr,
+                         const char *pUserNameStr,
+                         const char *pPasswordStr,
+                         bool (*pKeepGoingCallback)(void))
+{
+    CellularHttpErrorCode_t errorCode = CELLULAR_HTTP_NOT_SUPPORTED;
+
+#if CELLULAR_HTTP_IS_SUPPORTED
+    errorCode = CELLULAR_HTTP_SUCCESS;
+    if (gMutex == NULL) {
+        errorCode = CELLULAR_HTTP_BAD_ADDRESS;
+        if ((pServerNameStr != NULL) &&
+            (cellularPort_strlen(pServerNameStr) <= CELLULAR_HTTP_SERVER_ADDRESS_STRING_MAX_LENGTH_BYTES)) {
+            // Start with a clean profile
+            cellular_ctrl_at_lock();
+            cellular_ctrl_at_cmd_start("AT+UHTTP=");
+            cellular_ctrl_at_write_int(CELLULAR_HTTP_PROFILE_ID);
+            errorCode = atHttpStopCmdGetRespAndUnlock();
+            if (errorCode == CELLULAR_HTTP_SUCCESS) {
+                errorCode = setServer(pServerNameStr);
+            }
+            // Now deal with the credentials
+            if ((errorCode == CELLULAR_HTTP_SUCCESS) && (pUserNameStr != NULL)) {
+                atHttpCmdStart(2);
+                cellular_ctrl_at_write_string(pUserNameStr, true);
+                errorCode = atHttpStopCmdGetRespAndUnlock();
+                if ((errorCode == CELLULAR_HTTP_SUCCESS) && (pPasswordStr != NULL)) {
+                    atHttpCmdStart(3);
+                    cellular_ctrl_at_write_string(pPasswordStr, true);
+                    errorCode = atHttpStopCmdGetRespAndUnlock();
+                }
+                if (errorCode == CELLULAR_HTTP_SUCCESS) {
+                    // Basic authentication
+                    atHttpCmdStart(4);
+                    cellular_ctrl_at_write_int(1);
+                    errorCode = atHttpStopCmdGetRespAndUnlock();
+                }
+            }
+            if (errorCode == CELLULAR_HTTP_SUCCESS) {
+                // Finally, create the mutex that we use for re-entrancy
+                // protection and the queue a URC uses to wake us up
+                errorCode = CELLULAR_HTTP_PLATFORM_ERROR;
+                if (cellularPortQueueCreate(1, sizeof(int32_t),
+                                            &gQueueUrcEvent) == 0) {
+                    if (cellularPortMutexCreate(&gMutex) == 0) {
+                        gUrcEventPending = false;
+                        pCellularPort_memset((void *) &gUrcStatus, 0, sizeof(gUrcStatus));
+                        gpKeepGoingCallback = pKeepGoingCallback;
+                        cellular_ctrl_at_set_urc_handler("+UUHTTPCR:", UUHTTPCR_urc, NULL);
+                        errorCode = CELLULAR_HTTP_SUCCESS;
+                    } else {
+                        cellularPortQueueDelete(gQueueUrcEvent);
+                        gQueueUrcEvent = NULL;
+                    }
+                }
+            }
+        }
+    }
+#else
+    (void) pServerNameStr;
+    (void) pUserNameStr;
+    (void) pPasswordStr;
+    (void) pKeepGoingCallback;
+#endif
+
+    return (int32_t) errorCode;
+}
+
+// Shut-down the HTTP client.
+void cellularHttpDeinit()
+{
+    if (gMutex != NULL) {
+        // Make sure no request is in progress
+        CELLULAR_PORT_MUTEX_LOCK(gMutex);
+        cellular_ctrl_at_remove_urc_handler("+UUHTTPCR:");
+        cellularPortQueueDelete(gQueueUrcEvent);
+        gQueueUrcEvent = NULL;
+        gpKeepGoingCallback = NULL;
+        CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
+        cellularPortMutexDelete(gMutex);
+        gMutex = NULL;
+    }
+}
+
+// Switch HTTPS on.
+int32_t cellularHttpSetSecurityOn(int32_t securityProfileId)
+{
+    CellularHttpErrorCode_t errorCode = CELLULAR_HTTP_DEFAULT_ERROR_CODE;
+
+    if (gMutex != NULL) {
+        // No need to lock the mutex, the
+        // mutex protection of the AT interface
+        // lock is sufficient
+        atHttpCmdStart(6);
+        cellular_ctrl_at_write_int(1);
+        if (securityProfileId >= 0) {
+            cellular_ctrl_at_write_int(securityProfileId);
+        }
+        errorCode = atHttpStopCmdGetRespAndUnlock();
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Switch HTTPS off.
+int32_t cellularHttpSetSecurityOff()
+{
+    CellularHttpErrorCode_t errorCode = CELLULAR_HTTP_DEFAULT_ERROR_CODE;
+
+    if (gMutex != NULL) {
+        atHttpCmdStart(6);
+        cellular_ctrl_at_write_int(0);
+        errorCode = atHttpStopCmdGetRespAndUnlock();
+    }
+
+    return (int32_t) errorCode;
+}
+
+// GET to a file on the module.
+int32_t cellularHttpGetToFile(const char *pPathStr,
+                              const char *pFileNameStr)
+{
+    int32_t statusCodeOrError = (int32_t) CELLULAR_HTTP_DEFAULT_ERROR_CODE;
+
+    if (gMutex != NULL) {
+        statusCodeOrError = (int32_t) CELLULAR_HTTP_INVALID_PARAMETER;
+        if ((pPathStr != NULL) && (pFileNameStr != NULL)) {
+            CELLULAR_PORT_MUTEX_LOCK(gMutex);
+            statusCodeOrError = (int32_t) requestLocked(CELLULAR_HTTP_COMMAND_GET,
+                                                        pPathStr, pFileNameStr,
+                                                        MAX_NUM_CELLULAR_HTTP_CONTENT_TYPES);
+            if (statusCodeOrError == 0) {
+                statusCodeOrError = fileStatusCodeGet(pFileNameStr);
+            }
+            CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
+        }
+    }
+
+    return statusCodeOrError;
+}
+
+// GET, delivering the body through a callback.
+int32_t cellularHttpGet(const char *pPathStr,
+                        char *pBuffer, size_t bufferSizeBytes,
+                        bool (*pBodyCallback)(const char *pData,
+                                              size_t sizeBytes,
+                                              size_t offset,
+                                              void *pCallbackParam),
+                        void *pCallbackParam)
+{
+    int32_t statusCodeOrError = (int32_t) CELLULAR_HTTP_DEFAULT_ERROR_CODE;
+
+    if (gMutex != NULL) {
+        statusCodeOrError = (int32_t) CELLULAR_HTTP_INVALID_PARAMETER;
+        if ((pPathStr != NULL) && (pBuffer != NULL) &&
+            (bufferSizeBytes >= CELLULAR_HTTP_STATUS_LINE_LENGTH_BYTES)) {
+            CELLULAR_PORT_MUTEX_LOCK(gMutex);
+            statusCodeOrError = (int32_t) requestLocked(CELLULAR_HTTP_COMMAND_GET,
+                                                        pPathStr,
+                                                        CELLULAR_HTTP_RESPONSE_FILE_NAME,
+                                                        MAX_NUM_CELLULAR_HTTP_CONTENT_TYPES);
+            if (statusCodeOrError == 0) {
+                statusCodeOrError = bodyDeliver(CELLULAR_HTTP_RESPONSE_FILE_NAME,
+                                                pBuffer, bufferSizeBytes,
+                                                pBodyCallback, pCallbackParam);
+                // Don't leave the response taking up room
+                cellularFsDelete(CELLULAR_HTTP_RESPONSE_FILE_NAME);
+            }
+            CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
+        }
+    }
+
+    return statusCodeOrError;
+}
+
+// HEAD.
+int32_t cellularHttpHead(const char *pPathStr)
+{
+    int32_t statusCodeOrError = (int32_t) CELLULAR_HTTP_DEFAULT_ERROR_CODE;
+
+    if (gMutex != NULL) {
+        statusCodeOrError = (int32_t) CELLULAR_HTTP_INVALID_PARAMETER;
+        if (pPathStr != NULL) {
+            CELLULAR_PORT_MUTEX_LOCK(gMutex);
+            statusCodeOrError = (int32_t) requestLocked(CELLULAR_HTTP_COMMAND_HEAD,
+                                                        pPathStr,
+                                                        CELLULAR_HTTP_RESPONSE_FILE_NAME,
+                                                        MAX_NUM_CELLULAR_HTTP_CONTENT_TYPES);
+            if (statusCodeOrError == 0) {
+                statusCodeOrError = fileStatusCodeGet(CELLULAR_HTTP_RESPONSE_FILE_NAME);
+                cellularFsDelete(CELLULAR_HTTP_RESPONSE_FILE_NAME);
+            }
+            CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
+        }
+    }
+
+    return statusCodeOrError;
+}
+
+// POST.
+int32_t cellularHttpPost(const char *pPathStr,
+                         const void *pData, size_t sizeBytes,
+                         CellularHttpContentType_t contentType,
+                         char *pBuffer, size_t bufferSizeBytes,
+                         bool (*pBodyCallback)(const char *pData,
+                                               size_t sizeBytes,
+                                               size_t offset,
+                                               void *pCallbackParam),
+                         void *pCallbackParam)
+{
+    int32_t statusCodeOrError = (int32_t) CELLULAR_HTTP_DEFAULT_ERROR_CODE;
+
+    if (gMutex != NULL) {
+        statusCodeOrError = (int32_t) CELLULAR_HTTP_INVALID_PARAMETER;
+        if ((pPathStr != NULL) && (pData != NULL) && (sizeBytes > 0) &&
+            (contentType >= 0) &&
+            (contentType < MAX_NUM_CELLULAR_HTTP_CONTENT_TYPES) &&
+            (pBuffer != NULL) &&
+            (bufferSizeBytes >= CELLULAR_HTTP_STATUS_LINE_LENGTH_BYTES)) {
+            CELLULAR_PORT_MUTEX_LOCK(gMutex);
+            // AT+UDWNFILE appends, so get rid of any
+            // request file left behind, don't care if
+            // there isn't one
+            cellularFsDelete(CELLULAR_HTTP_REQUEST_FILE_NAME);
+            statusCodeOrError = (int32_t) CELLULAR_HTTP_AT_ERROR;
+            if (cellularFsWrite(CELLULAR_HTTP_REQUEST_FILE_NAME,
+                                pData, sizeBytes) == 0) {
+                statusCodeOrError = (int32_t) requestLocked(CELLULAR_HTTP_COMMAND_POST_FILE,
+                                                            pPathStr,
+                                                            CELLULAR_HTTP_RESPONSE_FILE_NAME,
+                                                            contentType);
+                if (statusCodeOrError == 0) {
+                    statusCodeOrError = bodyDeliver(CELLULAR_HTTP_RESPONSE_FILE_NAME,
+                                                    pBuffer, bufferSizeBytes,
+                                                    pBodyCallback, pCallbackParam);
+                    cellularFsDelete(CELLULAR_HTTP_RESPONSE_FILE_NAME);
+                }
+                cellularFsDelete(CELLULAR_HTTP_REQUEST_FILE_NAME);
+            }
+            CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
+        }
+    }
+
+    return statusCodeOrError;
+}
+
+// Get the last HTTP error code.
+int32_t cellularHttpGetLastErrorCode()
+{
+    int32_t errorCode = (int32_t) CELLULAR_HTTP_DEFAULT_ERROR_CODE;
+
+    if (gMutex != NULL) {
+        errorCode = getErrorCode();
+    }
+
+    return errorCode;
+}
+
+// End of file
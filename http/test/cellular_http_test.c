@@ -0,0 +1,236 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Only #includes of cellular_* are allowed here, no C lib,
+ * no platform stuff and no OS stuff.  Anything required from
+ * the platform/C library/OS must be brought in through
+ * cellular_port* to maintain portability.
+ */
+
+#ifdef CELLULAR_CFG_OVERRIDE
+# include "cellular_cfg_override.h" // For a customer's configuration override
+#endif
+#include "cellular_cfg_sw.h"
+#include "cellular_cfg_module.h"
+#include "cellular_cfg_hw_platform_specific.h"
+#include "cellular_port_clib.h"
+#include "cellular_port.h"
+#include "cellular_port_debug.h"
+#include "cellular_port_os.h"
+#include "cellular_port_uart.h"
+#include "cellular_port_test_platform_specific.h"
+#include "cellular_ctrl.h"
+#include "cellular_fs.h"
+#include "cellular_http.h"
+#include "cellular_cfg_test.h"
+
+#if CELLULAR_HTTP_IS_SUPPORTED
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS
+ * -------------------------------------------------------------- */
+
+// The name of the file for cellularHttpGetToFile().
+#define CELLULAR_HTTP_TEST_FILE_NAME "ucell_http_test"
+
+/* ----------------------------------------------------------------
+ * TYPES
+ * -------------------------------------------------------------- */
+
+/* ----------------------------------------------------------------
+ * VARIABLES
+ * -------------------------------------------------------------- */
+
+// Used for keepGoingCallback() timeout.
+static int64_t gStopTimeMs;
+
+// The UART queue handle: kept as a global variable
+// for the same reasons as in the sockets tests.
+static CellularPortQueueHandle_t gUartQueueHandle = NULL;
+
+// Buffer that responses are read into.
+static char gBuffer[CELLULAR_FS_READ_BLOCK_MAX_LENGTH_BYTES];
+
+// The total number of body bytes bodyCallback() has been given.
+static size_t gBodySizeBytes;
+
+// Set if bodyCallback() is called with an unexpected offset.
+static bool gBodyOffsetBad;
+
+// What is POSTed.
+static const char gPostData[] = "The quick brown fox jumps over the lazy dog";
+
+// Set if bodyCallback() sees gPostData in the body.
+static bool gPostDataFound;
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// Callback function for the cellular connection process.
+static bool keepGoingCallback()
+{
+    bool keepGoing = true;
+
+    if (cellularPortGetTickTimeMs() > gStopTimeMs) {
+        keepGoing = false;
+    }
+
+    return keepGoing;
+}
+
+// Count the body and look for gPostData in it: good enough
+// so long as it doesn't straddle two blocks, which it won't
+// for a response this short.
+static bool bodyCallback(const char *pData, size_t sizeBytes,
+                         size_t offset, void *pParam)
+{
+    size_t length = sizeof(gPostData) - 1;
+
+    (void) pParam;
+
+    if (offset != gBodySizeBytes) {
+        gBodyOffsetBad = true;
+    }
+    gBodySizeBytes += sizeBytes;
+    for (size_t x = 0; (x + length <= sizeBytes) && !gPostDataFound; x++) {
+        if (cellularPort_memcmp(pData + x, gPostData, length) == 0) {
+            gPostDataFound = true;
+        }
+    }
+
+    return true;
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+/** GET, HEAD and POST with the HTTP client.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularHttpTestRequests(),
+                            "httpRequests",
+                            "http")
+{
+    int32_t x;
+    int64_t startTimeMs;
+
+    CELLULAR_PORT_TEST_ASSERT(cellularPortInit() == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartInit(CELLULAR_CFG_PIN_TXD,
+                                                   CELLULAR_CFG_PIN_RXD,
+                                                   CELLULAR_CFG_PIN_CTS,
+                                                   CELLULAR_CFG_PIN_RTS,
+                                                   CELLULAR_CFG_BAUD_RATE,
+                                                   CELLULAR_CFG_RTS_THRESHOLD,
+                                                   CELLULAR_CFG_UART,
+                                                   &gUartQueueHandle) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlInit(CELLULAR_CFG_PIN_ENABLE_POWER,
+                                               CELLULAR_CFG_PIN_PWR_ON,
+                                               CELLULAR_CFG_PIN_VINT,
+                                               false,
+                                               CELLULAR_CFG_UART,
+                                               gUartQueueHandle) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlPowerOn(NULL) == 0);
+
+    // Not initialised yet
+    CELLULAR_PORT_TEST_ASSERT(cellularHttpHead("/") == CELLULAR_HTTP_NOT_INITIALISED);
+
+    gStopTimeMs = cellularPortGetTickTimeMs() + (CELLULAR_CFG_TEST_CONNECT_TIMEOUT_SECONDS * 1000);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlConnect(keepGoingCallback,
+                                                  CELLULAR_CFG_TEST_APN,
+                                                  CELLULAR_CFG_TEST_USERNAME,
+                                                  CELLULAR_CFG_TEST_PASSWORD) == 0);
+
+    CELLULAR_PORT_TEST_ASSERT(cellularHttpInit(CELLULAR_CFG_TEST_HTTP_SERVER_DOMAIN_NAME,
+                                               NULL, NULL, NULL) == 0);
+
+    // Bad parameters
+    CELLULAR_PORT_TEST_ASSERT(cellularHttpGet(NULL, gBuffer, sizeof(gBuffer),
+                                              NULL, NULL) == CELLULAR_HTTP_INVALID_PARAMETER);
+    CELLULAR_PORT_TEST_ASSERT(cellularHttpGet("/", NULL, sizeof(gBuffer),
+                                              NULL, NULL) == CELLULAR_HTTP_INVALID_PARAMETER);
+
+    // GET, body delivered through the callback
+    cellularPortLog("CELLULAR_HTTP_TEST: GET \"%s\"...\n",
+                    CELLULAR_CFG_TEST_HTTP_GET_PATH);
+    gBodySizeBytes = 0;
+    gBodyOffsetBad = false;
+    startTimeMs = cellularPortGetTickTimeMs();
+    x = cellularHttpGet(CELLULAR_CFG_TEST_HTTP_GET_PATH,
+                        gBuffer, sizeof(gBuffer),
+                        bodyCallback, NULL);
+    cellularPortLog("CELLULAR_HTTP_TEST: status %d, %d byte(s) of body"
+                    " in %d ms.\n", x, (int32_t) gBodySizeBytes,
+                    (int32_t) (cellularPortGetTickTimeMs() - startTimeMs));
+    CELLULAR_PORT_TEST_ASSERT(x == 200);
+    CELLULAR_PORT_TEST_ASSERT(gBodySizeBytes == CELLULAR_CFG_TEST_HTTP_GET_SIZE_BYTES);
+    CELLULAR_PORT_TEST_ASSERT(!gBodyOffsetBad);
+    // The response file should have been tidied away
+    CELLULAR_PORT_TEST_ASSERT(cellularFsGetSize(CELLULAR_HTTP_RESPONSE_FILE_NAME) < 0);
+
+    // GET to a file
+    cellularFsDelete(CELLULAR_HTTP_TEST_FILE_NAME);
+    CELLULAR_PORT_TEST_ASSERT(cellularHttpGetToFile(CELLULAR_CFG_TEST_HTTP_GET_PATH,
+                                                    CELLULAR_HTTP_TEST_FILE_NAME) == 200);
+    CELLULAR_PORT_TEST_ASSERT(cellularFsGetSize(CELLULAR_HTTP_TEST_FILE_NAME) >
+                              CELLULAR_CFG_TEST_HTTP_GET_SIZE_BYTES);
+    CELLULAR_PORT_TEST_ASSERT(cellularFsDelete(CELLULAR_HTTP_TEST_FILE_NAME) == 0);
+
+    // HEAD, of something there and something not
+    CELLULAR_PORT_TEST_ASSERT(cellularHttpHead(CELLULAR_CFG_TEST_HTTP_GET_PATH) == 200);
+    CELLULAR_PORT_TEST_ASSERT(cellularHttpHead(CELLULAR_CFG_TEST_HTTP_MISSING_PATH) == 404);
+
+    // POST, the server should echo the data back
+    gBodySizeBytes = 0;
+    gBodyOffsetBad = false;
+    gPostDataFound = false;
+    x = cellularHttpPost(CELLULAR_CFG_TEST_HTTP_POST_PATH,
+                         gPostData, sizeof(gPostData) - 1,
+                         CELLULAR_HTTP_CONTENT_TYPE_TEXT_PLAIN,
+                         gBuffer, sizeof(gBuffer),
+                         bodyCallback, NULL);
+    cellularPortLog("CELLULAR_HTTP_TEST: POST status %d, %d byte(s) of body.\n",
+                    x, (int32_t) gBodySizeBytes);
+    CELLULAR_PORT_TEST_ASSERT(x == 200);
+    CELLULAR_PORT_TEST_ASSERT(gPostDataFound);
+    CELLULAR_PORT_TEST_ASSERT(!gBodyOffsetBad);
+    CELLULAR_PORT_TEST_ASSERT(cellularFsGetSize(CELLULAR_HTTP_REQUEST_FILE_NAME) < 0);
+
+    cellularHttpDeinit();
+    cellularCtrlDisconnect();
+    cellularCtrlPowerOff(NULL);
+    cellularCtrlDeinit();
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartDeinit(CELLULAR_CFG_UART) == 0);
+    cellularPortDeinit();
+}
+
+/** Clean-up to be run at the end of this round of tests, just
+ * in case there were test failures which would have resulted
+ * in the deinitialisation being skipped.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularHttpTestCleanUp(),
+                            "httpCleanUp",
+                            "http")
+{
+    cellularHttpDeinit();
+    cellularCtrlDeinit();
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartDeinit(CELLULAR_CFG_UART) == 0);
+    cellularPortDeinit();
+}
+
+#endif // CELLULAR_HTTP_IS_SUPPORTED
+
+// End of file
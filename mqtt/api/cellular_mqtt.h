@@ -65,12 +65,26 @@ extern "C" {
 # error CELLULAR_MQTT_SERVER_RESPONSE_WAIT_SECONDS must be defined in cellular_cfg_module.h.
 #endif
 
-/** The maximum length of an MQTT publish message in bytes.
+/** The maximum length of an MQTT publish message in bytes
+ * that can be sent in a single AT command.
  */
 #ifndef CELLULAR_MQTT_PUBLISH_MAX_LENGTH_BYTES
 # error CELLULAR_MQTT_PUBLISH_MAX_LENGTH_BYTES must be defined in cellular_cfg_module.h.
 #endif
 
+/** The maximum length of an MQTT publish message in bytes
+ * that cellularMqttPublish() will accept: longer messages
+ * than CELLULAR_MQTT_PUBLISH_MAX_LENGTH_BYTES are, where the
+ * module needs it, written to a file on the module and the
+ * file published, without the application needing to know.
+ * The module may still refuse such a message, e.g. if there
+ * is no room for it in the file system, in which case the
+ * publish fails with CELLULAR_MQTT_AT_ERROR.
+ */
+#ifndef CELLULAR_MQTT_PUBLISH_ANY_MAX_LENGTH_BYTES
+# error CELLULAR_MQTT_PUBLISH_ANY_MAX_LENGTH_BYTES must be defined in cellular_cfg_module.h.
+#endif
+
 /** The maximum length of an MQTT read message in bytes.
  */
 #ifndef CELLULAR_MQTT_READ_MESSAGE_MAX_LENGTH_BYTES
@@ -102,6 +116,7 @@ typedef enum {
     CELLULAR_MQTT_NOT_SUPPORTED = -9,
     CELLULAR_MQTT_TIMEOUT = -10,
     CELLULAR_MQTT_BAD_ADDRESS = -11,
+    CELLULAR_MQTT_MESSAGE_TRUNCATED = -12,
     CELLULAR_MQTT_FORCE_32_BIT = 0x7FFFFFFF // Force this enum to be 32 bit
                                             // as it can be used as a size
                                             // also
@@ -116,6 +131,28 @@ typedef enum {
     MAX_NUM_CELLULAR_MQTT_QOS
 } CellularMqttQos_t;
 
+/** Statistics for the MQTT session, see cellularMqttGetStats().
+ * The counters run from cellularMqttInit() or from the last call
+ * to cellularMqttResetStats().
+ */
+typedef struct {
+    uint32_t numPublishes;       //!< publishes sent to the module.
+    uint32_t bytesPublished;     //!< message bytes in those publishes.
+    uint32_t numPublishAcks;     //!< publishes the module said were
+                                 // successful.
+    int64_t publishToAckTotalMs; //!< total time from sending a publish
+                                 // to the module to its success
+                                 // being indicated.
+    int32_t publishToAckMaxMs;   //!< longest time from sending a publish
+                                 // to the module to its success being
+                                 // indicated.
+    uint32_t numMessagesRead;    //!< messages read from the module.
+    uint32_t bytesRead;          //!< message bytes read from the module.
+    uint32_t numAtCommands;      //!< AT commands sent to publish and
+                                 // read messages.
+    uint32_t numErrors;          //!< publishes and reads that failed.
+} CellularMqttStats_t;
+
 /* ----------------------------------------------------------------
  * FUNCTIONS
  * -------------------------------------------------------------- */
@@ -412,6 +449,8 @@ bool cellularMqttIsConnected();
  *                         pMessage. If pMessage happens to
  *                         be an ASCII string this parameter
  *                         should be set to strlen(pMessage).
+ *                         May be up to
+ *                         CELLULAR_MQTT_PUBLISH_ANY_MAX_LENGTH_BYTES.
  * @return                 zero on success else negative error
  *                         code.
  */
@@ -421,6 +460,185 @@ int32_t cellularMqttPublish(CellularMqttQos_t qos,
                             const char *pMessage,
                             int32_t messageSizeBytes);
 
+/** Publish an MQTT message without waiting for the outcome.
+ * The topic and message are copied and put on an outbound
+ * queue of up to CELLULAR_CFG_MQTT_PUBLISH_QUEUE_LENGTH entries;
+ * the module is given the next one as soon as the server has
+ * dealt with the one before, so the rate of publishing is set
+ * by the server rather than by polling.  Queued publishes and
+ * those of cellularMqttPublish() are sent in the order they
+ * were made.
+ *
+ * @param qos              the MQTT QoS to use for this message.
+ * @param clean            if true the message will be cleaned
+ *                         from the server across MQTT disconnects/
+ *                         connects.
+ * @param pTopicNameStr    the NULL terminated topic string
+ *                         for the message; cannot be NULL.
+ * @param pMessage         a pointer to the message; the message
+ *                         is not restricted to ASCII values.
+ *                         Cannot be NULL.
+ * @param messageSizeBytes the length of pMessage.
+ * @param pCallback        a callback to be called when the publish
+ *                         has completed, may be NULL.  The first
+ *                         parameter is zero if the publish succeeded,
+ *                         else negative error code (e.g.
+ *                         CELLULAR_MQTT_TIMEOUT if the server did not
+ *                         respond within
+ *                         CELLULAR_MQTT_SERVER_RESPONSE_WAIT_SECONDS),
+ *                         the second parameter is pCallbackParam.
+ *                         The callback is usually run in the task
+ *                         of the AT parser's callbacks but may be
+ *                         called from within this function or
+ *                         another MQTT function if the outcome is
+ *                         known at once, e.g. on SARA-R4, where
+ *                         the module gives the outcome straight
+ *                         away.  The callback may itself call
+ *                         cellularMqttPublishAsync().
+ * @param pCallbackParam   passed to pCallback as its second
+ *                         parameter.
+ * @return                 zero if the publish has been queued
+ *                         (in which case pCallback will be called),
+ *                         else negative error code;
+ *                         CELLULAR_MQTT_NO_MEMORY if the queue
+ *                         is full.
+ */
+int32_t cellularMqttPublishAsync(CellularMqttQos_t qos,
+                                 bool clean,
+                                 const char *pTopicNameStr,
+                                 const char *pMessage,
+                                 int32_t messageSizeBytes,
+                                 void (*pCallback)(int32_t, void *),
+                                 void *pCallbackParam);
+
+/** Publish an MQTT message through the transmit scheduler, see
+ * cellularCtrlTxSchedulerStart(): if the scheduler is running
+ * and deadlineSeconds is greater than zero the topic and message
+ * are copied and the publish is held back until the radio
+ * conditions are good or deadlineSeconds have passed, whichever
+ * is first, and is then made with cellularMqttPublish() from the
+ * task of the scheduler.  Otherwise this is the same as
+ * cellularMqttPublish().  The outcome of a publish that has been
+ * held back is only logged.
+ *
+ * @param qos              the MQTT QoS to use for this message.
+ * @param clean            if true the message will be cleaned
+ *                         from the server across MQTT disconnects/
+ *                         connects.
+ * @param pTopicNameStr    the NULL terminated topic string
+ *                         for the message; cannot be NULL.
+ * @param pMessage         a pointer to the message; the message
+ *                         is not restricted to ASCII values.
+ *                         Cannot be NULL.
+ * @param messageSizeBytes the length of pMessage.
+ * @param deadlineSeconds  the longest time the publish may be
+ *                         held back for, zero or less to publish
+ *                         at once.
+ * @return                 zero if the publish has been made or
+ *                         held back, else negative error code;
+ *                         CELLULAR_MQTT_NO_MEMORY if there is
+ *                         no room to hold it back.
+ */
+int32_t cellularMqttPublishDeferred(CellularMqttQos_t qos,
+                                   bool clean,
+                                   const char *pTopicNameStr,
+                                   const char *pMessage,
+                                   int32_t messageSizeBytes,
+                                   int32_t deadlineSeconds);
+
+/** Get the number of publishes made with
+ * cellularMqttPublishAsync() which have not yet completed;
+ * a publish which has waited too long for the server is
+ * completed with CELLULAR_MQTT_TIMEOUT by this call.
+ *
+ * @return the number of publishes queued or in progress,
+ *         else negative error code.
+ */
+int32_t cellularMqttGetNumPublishPending();
+
+/** Register a topic, giving back a small handle which may be
+ * used with cellularMqttPublishTopic() and
+ * cellularMqttPublishTopicAsync() in place of the topic string.
+ * The string is not copied, it must remain valid until it is
+ * deregistered and any publishes made against it have completed;
+ * a string literal is ideal.  This saves the topic being copied
+ * for each asynchronous publish.  Note that neither SARA-R4 nor
+ * SARA-R5 offer MQTT topic aliases, so the full topic is still
+ * sent to the module with each publish.  Up to
+ * CELLULAR_CFG_MQTT_MAX_NUM_TOPICS topics may be registered;
+ * registering a topic that is already registered returns the
+ * same handle.
+ *
+ * @param pTopicNameStr the NULL terminated topic string; cannot
+ *                      be NULL.
+ * @return              the handle, zero or greater, else
+ *                      negative error code;
+ *                      CELLULAR_MQTT_NO_MEMORY if the table is
+ *                      full.
+ */
+int32_t cellularMqttTopicRegister(const char *pTopicNameStr);
+
+/** Deregister a topic.
+ *
+ * @param handle the handle returned by cellularMqttTopicRegister().
+ * @return       zero on success else negative error code.
+ */
+int32_t cellularMqttTopicDeregister(int32_t handle);
+
+/** Get the topic string for a handle, e.g. to pass to
+ * cellularMqttSubscribe().
+ *
+ * @param handle the handle returned by cellularMqttTopicRegister().
+ * @return       the topic string or NULL if handle is not registered.
+ */
+const char *pCellularMqttTopicGet(int32_t handle);
+
+/** As cellularMqttPublish() but publishing to a registered
+ * topic.
+ *
+ * @param qos              the MQTT QoS to use for this message.
+ * @param clean            if true the message will be cleaned
+ *                         from the server across MQTT disconnects/
+ *                         connects.
+ * @param handle           the handle returned by
+ *                         cellularMqttTopicRegister().
+ * @param pMessage         a pointer to the message; cannot be NULL.
+ * @param messageSizeBytes the length of pMessage.
+ * @return                 zero on success else negative error
+ *                         code.
+ */
+int32_t cellularMqttPublishTopic(CellularMqttQos_t qos,
+                                 bool clean,
+                                 int32_t handle,
+                                 const char *pMessage,
+                                 int32_t messageSizeBytes);
+
+/** As cellularMqttPublishAsync() but publishing to a registered
+ * topic, which is not copied; only the message is.
+ *
+ * @param qos              the MQTT QoS to use for this message.
+ * @param clean            if true the message will be cleaned
+ *                         from the server across MQTT disconnects/
+ *                         connects.
+ * @param handle           the handle returned by
+ *                         cellularMqttTopicRegister().
+ * @param pMessage         a pointer to the message; cannot be NULL.
+ * @param messageSizeBytes the length of pMessage.
+ * @param pCallback        the completion callback, as for
+ *                         cellularMqttPublishAsync(); may be NULL.
+ * @param pCallbackParam   passed to pCallback as its second
+ *                         parameter.
+ * @return                 zero if the publish has been queued,
+ *                         else negative error code.
+ */
+int32_t cellularMqttPublishTopicAsync(CellularMqttQos_t qos,
+                                      bool clean,
+                                      int32_t handle,
+                                      const char *pMessage,
+                                      int32_t messageSizeBytes,
+                                      void (*pCallback)(int32_t, void *),
+                                      void *pCallbackParam);
+
 /** Subscribe to an MQTT topic. The pKeepGoingCallback()
  * function set during initialisation will called while
  * this function is waiting for a subscription to complete.
@@ -480,7 +698,12 @@ int32_t cellularMqttSetMessageIndicationCallback(void (*pCallback)(int32_t, void
  */
 int32_t cellularMqttGetUnread();
 
-/** Read an MQTT message.
+/** Read an MQTT message.  The topic and message are parsed
+ * straight into the buffers given, no intermediate storage
+ * is used.  If either will not fit, as much as will fit is
+ * written, the rest is thrown away and
+ * CELLULAR_MQTT_MESSAGE_TRUNCATED is returned; the message
+ * has still been read and the other outputs are valid.
  *
  * @param pTopicNameStr       a place to put the NULL terminated
  *                            topic string of the message; cannot
@@ -496,8 +719,10 @@ int32_t cellularMqttGetUnread();
  *                            to pMessage.  Cannot be NULL.
  * @param pQos                a place to put the QoS of the message;
  *                            may be NULL.
- * @return                    zero on success else negative error
- *                            code.
+ * @return                    zero on success,
+ *                            CELLULAR_MQTT_MESSAGE_TRUNCATED if
+ *                            the topic or message was truncated,
+ *                            else negative error code.
  */
 int32_t cellularMqttMessageRead(char *pTopicNameStr,
                                 int32_t topicNameSizeBytes,
@@ -505,6 +730,54 @@ int32_t cellularMqttMessageRead(char *pTopicNameStr,
                                 int32_t *pMessageSizeBytes,
                                 CellularMqttQos_t *pQos);
 
+/** Read all of the unread MQTT messages, passing each one to
+ * a callback as it is read.  The messages are read back to
+ * back, on SARA-R5 without letting go of the AT interface in
+ * between, and each is parsed straight into the buffers given,
+ * which are re-used for every message; no memory is allocated.
+ * This is the thing to call from, or on the back of, the message
+ * indication callback when messages arrive in bursts.
+ *
+ * @param pTopicNameStr       storage for the NULL terminated topic
+ *                            string of each message; cannot be NULL.
+ * @param topicNameSizeBytes  the number of bytes of storage
+ *                            at pTopicNameStr.
+ * @param pMessage            storage for each message; cannot be
+ *                            NULL.
+ * @param messageSizeBytes    the number of bytes of storage at
+ *                            pMessage.
+ * @param pCallback           the callback, called once for each
+ *                            message with, in order, the topic, the
+ *                            message, the number of bytes of message,
+ *                            the QoS, true if the topic or message
+ *                            had to be truncated to fit, and
+ *                            pCallbackParam.  The buffers are only
+ *                            valid for the duration of the callback.
+ *                            The callback should return true to be
+ *                            given the next message or false to stop;
+ *                            messages not yet read stay on the module
+ *                            and are counted by
+ *                            cellularMqttGetUnread().  Since the AT
+ *                            interface may be held, the callback
+ *                            must not call any cellular API.
+ *                            Cannot be NULL.
+ * @param pCallbackParam      passed to pCallback as its last
+ *                            parameter.
+ * @return                    the number of messages passed to
+ *                            pCallback, else negative error code.
+ */
+int32_t cellularMqttMessageDrain(char *pTopicNameStr,
+                                 int32_t topicNameSizeBytes,
+                                 char *pMessage,
+                                 int32_t messageSizeBytes,
+                                 bool (*pCallback)(const char *,
+                                                   const char *,
+                                                   int32_t,
+                                                   CellularMqttQos_t,
+                                                   bool,
+                                                   void *),
+                                 void *pCallbackParam);
+
 /** Get the last MQTT error code.
  *
  * @return an error code, the meaning of which is utterly module
@@ -512,6 +785,18 @@ int32_t cellularMqttMessageRead(char *pTopicNameStr,
  */
 int32_t cellularMqttGetLastErrorCode();
 
+/** Get the statistics of the MQTT session: where its bytes and
+ * its time have gone.
+ *
+ * @param pStats a place to put the statistics.
+ * @return       zero on success else negative error code.
+ */
+int32_t cellularMqttGetStats(CellularMqttStats_t *pStats);
+
+/** Reset the statistics of the MQTT session to zero.
+ */
+void cellularMqttResetStats();
+
 #ifdef __cplusplus
 }
 #endif
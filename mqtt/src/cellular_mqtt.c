@@ -20,6 +20,9 @@
  * cellular_port* to maintain portability.
  */
 
+// The log level threshold of this module, see cellular_port_debug.h.
+#define CELLULAR_PORT_LOG_THRESHOLD CELLULAR_CFG_LOG_LEVEL_MQTT
+
 #ifdef CELLULAR_CFG_OVERRIDE
 # include "cellular_cfg_override.h" // For a customer's configuration override
 #endif
@@ -52,6 +55,19 @@
  */
 #define CELLULAR_MQTT_LOCAL_URC_TIMEOUT_MS 5000
 
+/** The longest to wait on gQueueUrcEvent before calling
+ * gpKeepGoingCallback again while waiting for the server; with
+ * no gpKeepGoingCallback the wait is for as long as is left.
+ */
+#define CELLULAR_MQTT_URC_EVENT_WAIT_MS 1000
+
+#if CELLULAR_MQTT_PUBLISH_FILE_IS_SUPPORTED
+/** The name of the file on the module which a message too
+ * long to be published directly is written to.
+ */
+# define CELLULAR_MQTT_PUBLISH_FILE_NAME "ucell_mqtt_pub"
+#endif
+
 /* ----------------------------------------------------------------
  * TYPES
  * -------------------------------------------------------------- */
@@ -70,21 +86,19 @@ typedef struct {
 typedef struct {
     bool updateFlag;
     bool connected;
-    bool publishSuccess;
     bool subscribeSuccess;
     CellularMqttQos_t subscribeQoS;
     bool unsubscribeSuccess;
     size_t numUnreadMessages;
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
-    // These only required for SARA-R4
-    // which sends the status back in a URC
+    // These only used with the SARA-R4
+    // form of AT+UMQTT, which sends the
+    // status back in a URC
     MqttBuffer_t clientId;
     int32_t localPortNumber;
     int32_t inactivityTimeoutSeconds;
     int32_t secured;
     int32_t securityProfileId;
     int32_t sessionClean;
-#endif
 } MqttUrcStatus_t;
 
 /** Struct to hold a message that has been read in a callback,
@@ -92,6 +106,7 @@ typedef struct {
  */
 typedef struct {
     bool messageRead;
+    bool truncated;
     CellularMqttQos_t qos;
     char *pTopicNameStr;
     int32_t topicNameSizeBytes;
@@ -99,6 +114,37 @@ typedef struct {
     int32_t messageSizeBytes;
 } MqttUrcMessage_t;
 
+/** A publish on the outbound queue.  For an asynchronous
+ * publish the topic and message are copied into the same
+ * allocation, just after the structure; for a blocking
+ * publish they point at the caller's buffers.
+ */
+typedef struct MqttPublish_t {
+    CellularMqttQos_t qos;
+    bool clean;
+    const char *pTopicNameStr;
+    const char *pMessage;
+    int32_t messageSizeBytes;
+    void (*pCallback)(int32_t, void *);
+    void *pCallbackParam;
+    CellularMqttErrorCode_t errorCode;
+    struct MqttPublish_t *pNext;
+} MqttPublish_t;
+
+#if CELLULAR_CFG_STATIC_ALLOC
+/** A slot from which an asynchronous publish is taken when
+ * CELLULAR_CFG_STATIC_ALLOC is set; the topic and message
+ * go in contents, just after the publish, as they would in
+ * a malloc()ed one.
+ */
+typedef struct {
+    MqttPublish_t publish;
+    char contents[CELLULAR_CFG_STATIC_ALLOC_MQTT_TOPIC_MAX_LENGTH_BYTES +
+                  CELLULAR_MQTT_PUBLISH_ANY_MAX_LENGTH_BYTES];
+    bool inUse;
+} MqttPublishSlot_t;
+#endif
+
 /* ----------------------------------------------------------------
  * VARIABLES
  * -------------------------------------------------------------- */
@@ -130,41 +176,676 @@ static bool gKeptAlive = false;
  */
 static volatile MqttUrcStatus_t gUrcStatus;
 
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
+/** Statistics for publishing, protected by gPublishMutex.
+ */
+static CellularMqttStats_t gStatsPublish;
+
+/** Statistics for reading messages, protected by gMutex;
+ * kept apart from gStatsPublish since a message is read
+ * with the AT interface locked and the callback task,
+ * which may be holding gPublishMutex, could be waiting
+ * on the AT interface to send the next publish.
+ */
+static CellularMqttStats_t gStatsRead;
+
+/** Queue which UUMQTTC_urc() uses to wake up a function that
+ * is waiting for the server's response.  Of length two since
+ * both the URC task and the callback task (for a publish) may
+ * post to it before the waiter has had a chance to run.
+ */
+static CellularPortQueueHandle_t gQueueUrcEvent = NULL;
+
+/** Set when an event is waiting on gQueueUrcEvent so that a URC
+ * never blocks trying to send another.
+ */
+static volatile bool gUrcEventPending = false;
+
+/** Mutex protecting the publish queue and the message
+ * indication callback; separate from gMutex, and never held
+ * while waiting on the server, so that the callback task can
+ * lock it while a blocking function is waiting.
+ */
+static CellularPortMutexHandle_t gPublishMutex = NULL;
+
+/** Publishes waiting to be sent, oldest first.
+ */
+static MqttPublish_t *gpPublishQueue = NULL;
+
+/** The number of asynchronous publishes that are either
+ * on gpPublishQueue or in flight.
+ */
+static size_t gPublishQueueLength = 0;
+
+/** The publish which has been sent and for which we are
+ * waiting on the +UUMQTTC URC, NULL if there is none; the
+ * module is only given one publish at a time.
+ */
+static MqttPublish_t *volatile gpPublishInFlight = NULL;
+
+/** The time at which gpPublishInFlight is given up on.
+ */
+static int64_t gPublishInFlightStopTimeMs;
+
+/** The time at which gpPublishInFlight was sent.
+ */
+static int64_t gPublishInFlightStartTimeMs;
+
+/** Publishes that have completed, oldest first, waiting
+ * for their callbacks to be called by publishDeliver().
+ */
+static MqttPublish_t *gpPublishDone = NULL;
+
+/** The publish used by cellularMqttPublish(), which is
+ * protected by gMutex.
+ */
+static MqttPublish_t gPublishSync;
+
+/** Set by publishSyncCallback() when gPublishSync has completed.
+ */
+static volatile bool gPublishSyncDone = false;
+
+/** The registered topics, indexed by handle; the strings
+ * belong to the application, they are not copied.  Protected
+ * by gPublishMutex.
+ */
+static const char *gpTopics[CELLULAR_CFG_MQTT_MAX_NUM_TOPICS];
+
 /** Storage for an MQTT message received in a
- * URC, only required for SARA-R4.
+ * URC, only used with the SARA-R4 form of AT+UMQTT.
  */
 static MqttUrcMessage_t gUrcMessage;
-#endif
 
-/** Hex table.
+#if CELLULAR_CFG_STATIC_ALLOC
+/** The slots for asynchronous publishes, protected by
+ * gPublishMutex.
+ */
+static MqttPublishSlot_t gPublishSlots[CELLULAR_CFG_MQTT_PUBLISH_QUEUE_LENGTH];
+
+/** Buffer in which cellularMqttInit() works on the server
+ * address.
  */
-static const char gHex[] = {'0', '1', '2', '3', '4', '5', '6',
-                            '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'};
+static char gServerAddress[CELLULAR_MQTT_SERVER_ADDRESS_STRING_MAX_LENGTH_BYTES + 1];
+#endif
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS: MODULE DIFFERENCES
+ * -------------------------------------------------------------- */
+
+// Return true if the module in use has the SARA-R4 form of
+// AT+UMQTT, which answers each command with a status and
+// reports back the settings it is asked for in URCs.
+static bool saraR4Syntax()
+{
+    return pCellularCtrlGetModuleProfile()->mqttSaraR4Syntax;
+}
+
+// Stop an AT+UMQTT or AT+UMQTTC command and read the response,
+// returning the status in it: with the SARA-R4 form of AT+UMQTT
+// the response is the command number followed by the status,
+// 1 meaning success, other modules just return OK, which is
+// taken to be a status of 1.
+// Note: the AT interface must be locked.
+static int32_t atStopCmdReadStatus(const char *pPrefix)
+{
+    int32_t status = 1;
+
+    if (saraR4Syntax()) {
+        cellular_ctrl_at_cmd_stop();
+        // Skip the first parameter, which is just
+        // our command number again
+        cellular_ctrl_at_read_fields(pPrefix, "-,i", &status);
+        cellular_ctrl_at_resp_stop();
+    } else {
+        cellular_ctrl_at_cmd_stop_read_resp();
+    }
+
+    return status;
+}
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS: PUBLISH QUEUE
+ * -------------------------------------------------------------- */
+
+// Add a publish to the end of a list.
+static void publishListAdd(MqttPublish_t **ppList,
+                           MqttPublish_t *pPublish)
+{
+    pPublish->pNext = NULL;
+    while (*ppList != NULL) {
+        ppList = &((*ppList)->pNext);
+    }
+    *ppList = pPublish;
+}
+
+// Remove a publish from a list, returning true if it was there.
+static bool publishListRemove(MqttPublish_t **ppList,
+                              MqttPublish_t *pPublish)
+{
+    bool found = false;
+
+    while (!found && (*ppList != NULL)) {
+        if (*ppList == pPublish) {
+            *ppList = pPublish->pNext;
+            found = true;
+        } else {
+            ppList = &((*ppList)->pNext);
+        }
+    }
+
+    return found;
+}
+
+#if CELLULAR_MQTT_PUBLISH_FILE_IS_SUPPORTED
+// Publish a message that is too long to be published directly
+// by writing it to a file on the module in one binary transfer
+// and then publishing the file.
+static CellularMqttErrorCode_t publishSendFile(const MqttPublish_t *pPublish)
+{
+    CellularMqttErrorCode_t errorCode = CELLULAR_MQTT_AT_ERROR;
+    int32_t status = 1;
+
+    cellular_ctrl_at_lock();
+    // Get rid of any file left behind, don't care if
+    // there isn't one
+    cellular_ctrl_at_cmd_start("AT+UDELFILE=");
+    cellular_ctrl_at_write_string(CELLULAR_MQTT_PUBLISH_FILE_NAME, true);
+    cellular_ctrl_at_cmd_stop_read_resp();
+    cellular_ctrl_at_clear_error();
+    // Write the message to the file
+    cellular_ctrl_at_cmd_start("AT+UDWNFILE=");
+    cellular_ctrl_at_write_string(CELLULAR_MQTT_PUBLISH_FILE_NAME, true);
+    cellular_ctrl_at_write_int(pPublish->messageSizeBytes);
+    cellular_ctrl_at_cmd_stop();
+    // Wait for the prompt and then send the
+    // message straight from the buffer
+    if (cellular_ctrl_at_wait_char('>')) {
+        cellular_ctrl_at_write_bytes((const uint8_t *) pPublish->pMessage,
+                                     pPublish->messageSizeBytes);
+        cellular_ctrl_at_resp_start(NULL, false);
+        cellular_ctrl_at_resp_stop();
+    }
+    if (cellular_ctrl_at_get_last_error() == 0) {
+        // Now publish the file
+        cellular_ctrl_at_cmd_start("AT+UMQTTC=");
+        // Publish file
+        cellular_ctrl_at_write_int(3);
+        // QoS
+        cellular_ctrl_at_write_int(pPublish->qos);
+        // Cleaning
+        cellular_ctrl_at_write_int(pPublish->clean);
+        // Topic
+        cellular_ctrl_at_write_string(pPublish->pTopicNameStr, true);
+        // File name
+        cellular_ctrl_at_write_string(CELLULAR_MQTT_PUBLISH_FILE_NAME, true);
+        status = atStopCmdReadStatus("+UMQTTC:");
+        if ((cellular_ctrl_at_get_last_error() == 0) &&
+            (status == 1)) {
+            errorCode = CELLULAR_MQTT_SUCCESS;
+        }
+    }
+    cellular_ctrl_at_unlock();
+
+    return errorCode;
+}
+#endif
+
+// Publish a message in a single AT command.
+// Note: gPublishMutex must be locked.
+static CellularMqttErrorCode_t publishSendDirect(const MqttPublish_t *pPublish)
+{
+    CellularMqttErrorCode_t errorCode = CELLULAR_MQTT_AT_ERROR;
+    int32_t status = 1;
+
+    cellular_ctrl_at_lock();
+    cellular_ctrl_at_cmd_start("AT+UMQTTC=");
+    if (pCellularCtrlGetModuleProfile()->mqttBinaryPublishIsSupported) {
+        // Publish binary message
+        cellular_ctrl_at_write_int(9);
+        // QoS
+        cellular_ctrl_at_write_int(pPublish->qos);
+        // Cleaning
+        cellular_ctrl_at_write_int(pPublish->clean);
+        // Topic
+        cellular_ctrl_at_write_string(pPublish->pTopicNameStr, true);
+        // Number of bytes to follow
+        cellular_ctrl_at_write_int(pPublish->messageSizeBytes);
+        cellular_ctrl_at_cmd_stop();
+        // Wait for the prompt and then send the
+        // message straight from the buffer
+        if (cellular_ctrl_at_wait_char('>')) {
+            cellular_ctrl_at_write_bytes((const uint8_t *) pPublish->pMessage,
+                                         pPublish->messageSizeBytes);
+            cellular_ctrl_at_resp_start(NULL, false);
+            cellular_ctrl_at_resp_stop();
+        }
+    } else {
+        // Publish message
+        cellular_ctrl_at_write_int(2);
+        // QoS
+        cellular_ctrl_at_write_int(pPublish->qos);
+        // Cleaning
+        cellular_ctrl_at_write_int(pPublish->clean);
+        // Hex mode
+        cellular_ctrl_at_write_int(1);
+        // Topic
+        cellular_ctrl_at_write_string(pPublish->pTopicNameStr, true);
+        // Hex message, encoded on the way out
+        cellular_ctrl_at_write_hex(pPublish->pMessage,
+                                   pPublish->messageSizeBytes, true);
+        status = atStopCmdReadStatus("+UMQTTC:");
+    }
+    if ((cellular_ctrl_at_unlock_return_error() == 0) &&
+        (status == 1)) {
+        errorCode = CELLULAR_MQTT_SUCCESS;
+    }
+
+    return errorCode;
+}
+
+// Send a publish to the module, returning zero if it was
+// accepted.  With the SARA-R4 form of AT+UMQTT that is also
+// the outcome of the publish, otherwise the outcome arrives
+// in a +UUMQTTC URC.
+// Note: gPublishMutex must be locked.
+static CellularMqttErrorCode_t publishSend(const MqttPublish_t *pPublish)
+{
+    CellularMqttErrorCode_t errorCode;
+
+    gStatsPublish.numPublishes++;
+    gStatsPublish.bytesPublished += pPublish->messageSizeBytes;
+#if CELLULAR_MQTT_PUBLISH_FILE_IS_SUPPORTED
+    if (pPublish->messageSizeBytes > pCellularCtrlGetModuleProfile()->mqttPublishMaxLengthBytes) {
+        // AT+UDELFILE, AT+UDWNFILE and AT+UMQTTC
+        gStatsPublish.numAtCommands += 3;
+        errorCode = publishSendFile(pPublish);
+    } else {
+        gStatsPublish.numAtCommands++;
+        errorCode = publishSendDirect(pPublish);
+    }
+#else
+    gStatsPublish.numAtCommands++;
+    errorCode = publishSendDirect(pPublish);
+#endif
+
+    return errorCode;
+}
+
+// Note the success of a publish sent at the given time.
+// Note: gPublishMutex must be locked.
+static void statsPublishAck(int64_t startTimeMs)
+{
+    int64_t latencyMs = cellularPortGetTickTimeMs() - startTimeMs;
+
+    gStatsPublish.numPublishAcks++;
+    gStatsPublish.publishToAckTotalMs += latencyMs;
+    if (latencyMs > gStatsPublish.publishToAckMaxMs) {
+        gStatsPublish.publishToAckMaxMs = (int32_t) latencyMs;
+    }
+}
+
+// Move a publish which is neither queued nor in flight
+// onto the done list with the given outcome.
+// Note: gPublishMutex must be locked.
+static void publishComplete(MqttPublish_t *pPublish,
+                            CellularMqttErrorCode_t errorCode)
+{
+    pPublish->errorCode = errorCode;
+    if (errorCode != CELLULAR_MQTT_SUCCESS) {
+        gStatsPublish.numErrors++;
+    }
+    if ((pPublish != &gPublishSync) && (gPublishQueueLength > 0)) {
+        gPublishQueueLength--;
+    }
+    publishListAdd(&gpPublishDone, pPublish);
+}
+
+// Give up on a publish in flight that has passed its time
+// and then, if nothing is in flight, send the next publish
+// on the queue.
+// Note: gPublishMutex must be locked.
+static void publishPump()
+{
+    MqttPublish_t *pPublish;
+    CellularMqttErrorCode_t errorCode;
+
+    pPublish = gpPublishInFlight;
+    if ((pPublish != NULL) &&
+        (cellularPortGetTickTimeMs() > gPublishInFlightStopTimeMs)) {
+        gpPublishInFlight = NULL;
+        publishComplete(pPublish, CELLULAR_MQTT_TIMEOUT);
+    }
+
+    while ((gpPublishInFlight == NULL) && (gpPublishQueue != NULL)) {
+        pPublish = gpPublishQueue;
+        gpPublishQueue = pPublish->pNext;
+        gPublishInFlightStartTimeMs = cellularPortGetTickTimeMs();
+        if (saraR4Syntax()) {
+            // For the SARA-R4 form of AT+UMQTT the
+            // response gives the outcome
+            errorCode = publishSend(pPublish);
+            if (errorCode == CELLULAR_MQTT_SUCCESS) {
+                statsPublishAck(gPublishInFlightStartTimeMs);
+            }
+            publishComplete(pPublish, errorCode);
+        } else {
+            // Mark the publish as in flight before sending
+            // it since the URC may arrive at any time
+            gPublishInFlightStopTimeMs = gPublishInFlightStartTimeMs +
+                                         (CELLULAR_MQTT_SERVER_RESPONSE_WAIT_SECONDS * 1000);
+            gpPublishInFlight = pPublish;
+            errorCode = publishSend(pPublish);
+            if (errorCode != CELLULAR_MQTT_SUCCESS) {
+                gpPublishInFlight = NULL;
+                publishComplete(pPublish, errorCode);
+            }
+        }
+    }
+}
+
+// Allocate an asynchronous publish with room for the given
+// number of bytes of topic and message after it.
+static MqttPublish_t *pPublishAlloc(size_t contentsSizeBytes)
+{
+    MqttPublish_t *pPublish = NULL;
+
+#if CELLULAR_CFG_STATIC_ALLOC
+    if (contentsSizeBytes <= sizeof(gPublishSlots[0].contents)) {
+
+        CELLULAR_PORT_MUTEX_LOCK(gPublishMutex);
+
+        for (size_t x = 0; (pPublish == NULL) &&
+                           (x < sizeof(gPublishSlots) / sizeof(gPublishSlots[0])); x++) {
+            if (!gPublishSlots[x].inUse) {
+                gPublishSlots[x].inUse = true;
+                pPublish = &(gPublishSlots[x].publish);
+            }
+        }
+
+        CELLULAR_PORT_MUTEX_UNLOCK(gPublishMutex);
+    }
+#else
+    pPublish = (MqttPublish_t *) pCellularPort_mallocTag(sizeof(MqttPublish_t) +
+                                                         contentsSizeBytes,
+                                                         CELLULAR_PORT_MALLOC_TAG_MQTT);
+#endif
+
+    return pPublish;
+}
+
+// Free an asynchronous publish; gPublishMutex must NOT be
+// locked.
+static void publishFree(MqttPublish_t *pPublish)
+{
+#if CELLULAR_CFG_STATIC_ALLOC
+    CELLULAR_PORT_MUTEX_LOCK(gPublishMutex);
+
+    for (size_t x = 0; x < sizeof(gPublishSlots) / sizeof(gPublishSlots[0]); x++) {
+        if (pPublish == &(gPublishSlots[x].publish)) {
+            gPublishSlots[x].inUse = false;
+        }
+    }
+
+    CELLULAR_PORT_MUTEX_UNLOCK(gPublishMutex);
+#else
+    cellularPort_free(pPublish);
+#endif
+}
+
+// Call the callbacks of, and free, any publishes on the
+// done list.  Called without gPublishMutex locked so that a
+// callback may queue another publish.
+static void publishDeliver()
+{
+    MqttPublish_t *pPublish;
+
+    do {
+        CELLULAR_PORT_MUTEX_LOCK(gPublishMutex);
+
+        pPublish = gpPublishDone;
+        if (pPublish != NULL) {
+            gpPublishDone = pPublish->pNext;
+        }
+
+        CELLULAR_PORT_MUTEX_UNLOCK(gPublishMutex);
+
+        if (pPublish != NULL) {
+            if (pPublish->pCallback != NULL) {
+                pPublish->pCallback((int32_t) pPublish->errorCode,
+                                    pPublish->pCallbackParam);
+            }
+            if (pPublish != &gPublishSync) {
+                publishFree(pPublish);
+            }
+        }
+    } while (pPublish != NULL);
+}
+
+// Return the longest message that can be published to the
+// module in use: longer than mqttPublishMaxLengthBytes is only
+// possible if publishing from a file is built in and the module
+// supports it.
+static int32_t publishMaxLengthBytes()
+{
+    const CellularCtrlModuleProfile_t *pProfile = pCellularCtrlGetModuleProfile();
+    int32_t maxLengthBytes = pProfile->mqttPublishMaxLengthBytes;
+
+#if CELLULAR_MQTT_PUBLISH_FILE_IS_SUPPORTED
+    if (pProfile->mqttPublishFileIsSupported) {
+        maxLengthBytes = CELLULAR_MQTT_PUBLISH_ANY_MAX_LENGTH_BYTES;
+    }
+#endif
+
+    return maxLengthBytes;
+}
+
+// Check the parameters of a publish.
+static bool publishParametersAreValid(CellularMqttQos_t qos,
+                                      const char *pTopicNameStr,
+                                      const char *pMessage,
+                                      int32_t messageSizeBytes)
+{
+    return (qos >= 0) &&
+           (qos < MAX_NUM_CELLULAR_MQTT_QOS) &&
+           (pTopicNameStr != NULL) &&
+           (pMessage != NULL) &&
+           (messageSizeBytes >= 0) &&
+           (messageSizeBytes <= publishMaxLengthBytes());
+}
+
+// Queue an asynchronous publish.  The message is always copied;
+// the topic is copied only if copyTopic is true, otherwise it
+// must be a registered topic, which stays put.
+static CellularMqttErrorCode_t publishAsync(CellularMqttQos_t qos,
+                                            bool clean,
+                                            const char *pTopicNameStr,
+                                            bool copyTopic,
+                                            const char *pMessage,
+                                            int32_t messageSizeBytes,
+                                            void (*pCallback)(int32_t, void *),
+                                            void *pCallbackParam)
+{
+    CellularMqttErrorCode_t errorCode = CELLULAR_MQTT_INVALID_PARAMETER;
+    MqttPublish_t *pPublish;
+    size_t topicNameSizeBytes = 0;
+    char *pTmp;
+
+    if (publishParametersAreValid(qos, pTopicNameStr,
+                                  pMessage, messageSizeBytes)) {
+        errorCode = CELLULAR_MQTT_NO_MEMORY;
+        // Take a copy of the message and, if required,
+        // the topic, in the same allocation as the
+        // publish, +1 for terminator
+        if (copyTopic) {
+            topicNameSizeBytes = cellularPort_strlen(pTopicNameStr) + 1;
+        }
+        pPublish = pPublishAlloc(topicNameSizeBytes + messageSizeBytes);
+        if (pPublish != NULL) {
+            pTmp = (char *) (pPublish + 1);
+            pPublish->pTopicNameStr = pTopicNameStr;
+            if (copyTopic) {
+                pCellularPort_memcpy(pTmp, pTopicNameStr, topicNameSizeBytes);
+                pPublish->pTopicNameStr = pTmp;
+                pTmp += topicNameSizeBytes;
+            }
+            pCellularPort_memcpy(pTmp, pMessage, messageSizeBytes);
+            pPublish->pMessage = pTmp;
+            pPublish->messageSizeBytes = messageSizeBytes;
+            pPublish->qos = qos;
+            pPublish->clean = clean;
+            pPublish->pCallback = pCallback;
+            pPublish->pCallbackParam = pCallbackParam;
+            pPublish->errorCode = CELLULAR_MQTT_TIMEOUT;
+
+            CELLULAR_PORT_MUTEX_LOCK(gPublishMutex);
+
+            // Give the queue a nudge so that
+            // a publish which has passed its
+            // time doesn't hold up this one
+            publishPump();
+            if (gPublishQueueLength < CELLULAR_CFG_MQTT_PUBLISH_QUEUE_LENGTH) {
+                gPublishQueueLength++;
+                publishListAdd(&gpPublishQueue, pPublish);
+                pPublish = NULL;
+                publishPump();
+                errorCode = CELLULAR_MQTT_SUCCESS;
+            }
+
+            CELLULAR_PORT_MUTEX_UNLOCK(gPublishMutex);
+
+            if (pPublish != NULL) {
+                // The queue was full
+                publishFree(pPublish);
+            }
+            publishDeliver();
+        }
+    }
+
+    return errorCode;
+}
+
+// Get the registered topic for a handle, NULL if there is none.
+// Note: gPublishMutex must be locked.
+static const char *pTopicGet(int32_t handle)
+{
+    const char *pTopicNameStr = NULL;
+
+    if ((handle >= 0) &&
+        (handle < (int32_t) (sizeof(gpTopics) / sizeof(gpTopics[0])))) {
+        pTopicNameStr = gpTopics[handle];
+    }
+
+    return pTopicNameStr;
+}
+
+// The send function given to the transmit scheduler by
+// cellularMqttPublishDeferred(): the data is the NULL terminated
+// topic followed by the message, pParam is the QoS shifted up
+// by one with the clean flag at the bottom.
+static int32_t publishDeferred(const void *pData, size_t dataSizeBytes,
+                               void *pParam)
+{
+    int32_t qosAndClean = (int32_t) (intptr_t) pParam;
+    const char *pTopicNameStr = (const char *) pData;
+    size_t topicSizeBytes = cellularPort_strlen(pTopicNameStr) + 1;
+
+    return cellularMqttPublish((CellularMqttQos_t) (qosAndClean >> 1),
+                               (qosAndClean & 1) != 0,
+                               pTopicNameStr,
+                               pTopicNameStr + topicSizeBytes,
+                               (int32_t) (dataSizeBytes - topicSizeBytes));
+}
 
 /* ----------------------------------------------------------------
  * STATIC FUNCTIONS: URCS AND RELATED FUNCTIONS
  * -------------------------------------------------------------- */
 
+// Let a function waiting on the server know that
+// gUrcStatus has been updated.
+static void signalUrcUpdate()
+{
+    int32_t dummy = 0;
+
+    gUrcStatus.updateFlag = true;
+    if ((gQueueUrcEvent != NULL) && !gUrcEventPending) {
+        gUrcEventPending = true;
+        cellularPortQueueSend(gQueueUrcEvent, &dummy);
+    }
+}
+
+// Called in the AT parser's task callback context when
+// the +UUMQTTC URC for the publish in flight has arrived
+// (or MQTT has been disconnected): completes the publish
+// and sends the next one.
+static void publishCompleteCallback(void *pParam)
+{
+    bool success = ((int32_t) (intptr_t) pParam != 0);
+    MqttPublish_t *pPublish;
+
+    if (gPublishMutex != NULL) {
+
+        CELLULAR_PORT_MUTEX_LOCK(gPublishMutex);
+
+        // Note: if a publish has been given up on and
+        // its URC turns up later this will be taken as
+        // the outcome of the publish now in flight; the
+        // module gives us no way to tell them apart
+        pPublish = gpPublishInFlight;
+        if (pPublish != NULL) {
+            gpPublishInFlight = NULL;
+            if (success) {
+                statsPublishAck(gPublishInFlightStartTimeMs);
+            }
+            publishComplete(pPublish, success ? CELLULAR_MQTT_SUCCESS :
+                                                CELLULAR_MQTT_AT_ERROR);
+        }
+        publishPump();
+
+        CELLULAR_PORT_MUTEX_UNLOCK(gPublishMutex);
+
+        publishDeliver();
+    }
+}
+
+// The callback of the publish used by cellularMqttPublish().
+static void publishSyncCallback(int32_t errorCode, void *pParam)
+{
+    (void) errorCode;
+    (void) pParam;
+
+    // errorCode is also in gPublishSync, all
+    // that's needed is to wake up the waiter
+    gPublishSyncDone = true;
+    signalUrcUpdate();
+}
+
 // A local "trampoline" for the message indication callback,
 // here so that it can be called in the AT parser's
 // task callback context and then hold on the mutex before
 // calling gpMessageIndicationCallback with its parameters.
 static void messageIndicationCallback(void *pParam)
 {
-    int32_t numUnreadMessages = (int32_t) pParam;
-
-    // Lock the mutex as we'll need
-    // two global variables, which could
-    // never be atomic
-    CELLULAR_PORT_MUTEX_LOCK(gMutex);
-
-    if (gpMessageIndicationCallback != NULL) {
-        gpMessageIndicationCallback(numUnreadMessages,
-                                    gpMessageIndicationCallbackParam);
+    int32_t numUnreadMessages = (int32_t) (intptr_t) pParam;
+    void (*pCallback)(int32_t, void *);
+    void *pCallbackParam;
+
+    // Lock a mutex as we'll need two global
+    // variables, which could never be
+    // atomic.  This has to be gPublishMutex
+    // rather than gMutex, which may be held
+    // by a function that needs this task to
+    // complete a publish before it can let go;
+    // the callback is called outside the lock
+    // so that it may itself publish
+    CELLULAR_PORT_MUTEX_LOCK(gPublishMutex);
+
+    pCallback = gpMessageIndicationCallback;
+    pCallbackParam = gpMessageIndicationCallbackParam;
+
+    CELLULAR_PORT_MUTEX_UNLOCK(gPublishMutex);
+
+    if (pCallback != NULL) {
+        pCallback(numUnreadMessages, pCallbackParam);
     }
-
-    CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
 }
 
 // "+UUMQTTC:" URC handler.
@@ -184,28 +865,35 @@ static void UUMQTTC_urc()
                 (urcParam1 == 101)) { // SARA-R5, connection lost
                 // Disconnected
                 gUrcStatus.connected = false;
+                // Any publish in flight won't
+                // now get a URC of its own
+                if (gpPublishInFlight != NULL) {
+                    cellular_ctrl_at_callback(publishCompleteCallback,
+                                              (void *) (size_t) false);
+                }
             }
-            gUrcStatus.updateFlag = true;
+            signalUrcUpdate();
         break;
         case 1: // Login
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
-            // On SARA-R4 , 0 means success, non-zero
-            // values are errors
-            if (urcParam1 == 0) {
-#else
-            if (urcParam1 == 1) {
-#endif
+            // With the SARA-R4 form of AT+UMQTT 0 means
+            // success, non-zero values are errors,
+            // elsewhere 1 means success
+            if ((saraR4Syntax() && (urcParam1 == 0)) ||
+                (!saraR4Syntax() && (urcParam1 == 1))) {
                 // Connected
                 gUrcStatus.connected = true;
             }
-            gUrcStatus.updateFlag = true;
+            signalUrcUpdate();
         break;
         case 2: // Publish, 1 means success
-            if (urcParam1 == 1) {
-                // Published
-                gUrcStatus.publishSuccess = true;
+        case 9: // Binary publish, 1 means success
+            // The outcome goes to the publish in
+            // flight; can't lock gPublishMutex in
+            // here so let the callback task do it
+            if (gpPublishInFlight != NULL) {
+                cellular_ctrl_at_callback(publishCompleteCallback,
+                                          (void *) (size_t) (urcParam1 == 1));
             }
-            gUrcStatus.updateFlag = true;
         break;
         // 3 (publish file) is not used by this driver
         case 4: // Subscribe
@@ -213,26 +901,23 @@ static void UUMQTTC_urc()
             urcParam2 = cellular_ctrl_at_read_int();
             // Skip the topic string
             cellular_ctrl_at_skip_param(1);
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
-            // On SARA-R4, 0 to 2 mean success
-            if ((urcParam1 >= 0) && (urcParam1 <= 2) &&
-                (urcParam2 >= 0)) {
-#else
-            // Elsewhere 1 means success
-            if ((urcParam1 == 1) && (urcParam2 >= 0)) {
-#endif
+            // With the SARA-R4 form of AT+UMQTT 0 to 2
+            // mean success, elsewhere 1 means success
+            if ((saraR4Syntax() && (urcParam1 >= 0) && (urcParam1 <= 2) &&
+                 (urcParam2 >= 0)) ||
+                (!saraR4Syntax() && (urcParam1 == 1) && (urcParam2 >= 0))) {
                 // Subscribed
                 gUrcStatus.subscribeSuccess = true;
                 gUrcStatus.subscribeQoS = urcParam2;
             }
-            gUrcStatus.updateFlag = true;
+            signalUrcUpdate();
         break;
         case 5: // Unsubscribe, 1 means success
             if (urcParam1 == 1) {
                 // Unsubscribed
                 gUrcStatus.unsubscribeSuccess = true;
             }
-            gUrcStatus.updateFlag = true;
+            signalUrcUpdate();
         break;
         case 6: // Num unread messages
             if (urcParam1 >= 0) {
@@ -243,11 +928,13 @@ static void UUMQTTC_urc()
                     // commands.  Instead, launch our
                     // local callback via the AT
                     // parser's callback facility
-                    cellular_ctrl_at_callback(messageIndicationCallback,
-                                              (void *) (gUrcStatus.numUnreadMessages));
+                    cellular_ctrl_at_callback_priority(messageIndicationCallback,
+                                                       (void *) (gUrcStatus.numUnreadMessages),
+                                                       CELLULAR_CTRL_AT_CALLBACK_PRIORITY_LOW,
+                                                       true);
                 }
             }
-            gUrcStatus.updateFlag = true;
+            signalUrcUpdate();
         break;
         default:
             // Do nothing
@@ -255,9 +942,7 @@ static void UUMQTTC_urc()
     }
 }
 
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
-
-// "+UUMQTTx:" URC handler, for SARA-R4 only.
+// "+UUMQTTx:" URC handler, for the SARA-R4 form of AT+UMQTT only.
 // The switch statement here needs to match those in
 // resetUrcStatusField() an checkUrcStatusField()
 static void UUMQTTx_urc(int32_t x)
@@ -346,6 +1031,16 @@ static void UUMQTTCM_urc()
             topicNameBytesRead = cellular_ctrl_at_read_string(gUrcMessage.pTopicNameStr,
                                                               gUrcMessage.topicNameSizeBytes,
                                                               false);
+            // If that filled the buffer there may be more
+            // of the topic, which has to be thrown away to
+            // keep our place in the stream
+            if ((topicNameBytesRead >= 0) &&
+                (topicNameBytesRead >= gUrcMessage.topicNameSizeBytes - 1) &&
+                (cellular_ctrl_at_read_string(NULL,
+                                              CELLULAR_MQTT_READ_TOPIC_MAX_LENGTH_BYTES,
+                                              false) > 0)) {
+                gUrcMessage.truncated = true;
+            }
         }
         if (topicNameBytesRead >= 0) {
             // Skip the additional '\r\n'
@@ -378,12 +1073,18 @@ static void UUMQTTCM_urc()
                                                                                        x);
                             if (gUrcMessage.messageSizeBytes == x) {
                                 // Done.  Phew.
-                                gUrcMessage.messageRead = true;
                                 // Throw away any remainder
                                 if (messageBytesAvailable > x) {
+                                    gUrcMessage.truncated = true;
                                     cellular_ctrl_at_read_bytes(NULL, messageBytesAvailable - x);
                                 }
+                                gUrcMessage.messageRead = true;
+                                // Wake up cellularMqttMessageRead()
+                                signalUrcUpdate();
                             }
+                        } else {
+                            // No-one waiting for it, throw it away
+                            cellular_ctrl_at_read_bytes(NULL, messageBytesAvailable);
                         }
                     }
                 }
@@ -398,15 +1099,15 @@ static void UUMQTTCM_urc()
             // commands.  Instead, launch our
             // local callback via the AT
             // parser's callback facility
-            cellular_ctrl_at_callback(messageIndicationCallback,
-                                      (void *) (gUrcStatus.numUnreadMessages));
+            cellular_ctrl_at_callback_priority(messageIndicationCallback,
+                                               (void *) (gUrcStatus.numUnreadMessages),
+                                               CELLULAR_CTRL_AT_CALLBACK_PRIORITY_LOW,
+                                               true);
         }
     }
     cellular_ctrl_at_set_default_delimiter();
 }
 
-#endif // CELLULAR_CFG_MODULE_SARA_R4
-
 // MQTT URC handler, which hands
 // off to the three MQTT URC types,
 // "+UUMQTTx:" (where x can be a two
@@ -421,18 +1122,17 @@ void UUMQTT_urc(void *pUnused)
 
     (void) pUnused;
 
-    // Sort out if this is "+UUMQTTC:"
-    // or "+UUMQTTx:" or [SARA-R4 only] "+UUMQTTCM:"
+    // Sort out if this is "+UUMQTTC:" or, with the
+    // SARA-R4 form of AT+UMQTT, "+UUMQTTx:" or "+UUMQTTCM:"
     if (cellular_ctrl_at_read_bytes(bytes, sizeof(bytes)) == sizeof(bytes)) {
         if (bytes[0] == 'C') {
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
             // Either "+UUMQTTC" or "+UUMQTTCM"
-            if (bytes[1] == 'M') {
+            if (saraR4Syntax() && (bytes[1] == 'M')) {
                 UUMQTTCM_urc();
             } else {
                 UUMQTTC_urc();
             }
-        } else {
+        } else if (saraR4Syntax()) {
             // Probably "+UUMQTTx:"
             // Derive x as an integer, noting
             // that it can be two digits
@@ -444,9 +1144,6 @@ void UUMQTT_urc(void *pUnused)
                 }
                 UUMQTTx_urc(cellularPort_atoi((char *) bytes));
             }
-#else
-            UUMQTTC_urc();
-#endif
         }
     }
 }
@@ -455,18 +1152,54 @@ void UUMQTT_urc(void *pUnused)
  * STATIC FUNCTIONS: MISC
  * -------------------------------------------------------------- */
 
-// Print the error state of MQTT
-static void printErrorCodes()
+// Clear gUrcStatus.updateFlag and any event left over
+// from before, ready to wait for the server.
+static void clearUrcEvent()
 {
-    int32_t err1;
-    int32_t err2;
+    int32_t dummy;
 
-    cellular_ctrl_at_lock();
+    gUrcStatus.updateFlag = false;
+    while (cellularPortQueueTryReceive(gQueueUrcEvent, 0, &dummy) == 0) {}
+    gUrcEventPending = false;
+}
+
+// Wait for an event from a URC, or for
+// CELLULAR_MQTT_URC_EVENT_WAIT_MS if there is a
+// gpKeepGoingCallback() to call, returning false if
+// stopTimeMs has passed or gpKeepGoingCallback() says stop.
+static bool waitUrcEvent(int64_t stopTimeMs)
+{
+    int32_t dummy;
+    int64_t waitMs = stopTimeMs - cellularPortGetTickTimeMs();
+    bool keepGoing;
+
+    keepGoing = (waitMs > 0) &&
+                ((gpKeepGoingCallback == NULL) ||
+                 gpKeepGoingCallback());
+    if ((gpKeepGoingCallback != NULL) &&
+        (waitMs > CELLULAR_MQTT_URC_EVENT_WAIT_MS)) {
+        waitMs = CELLULAR_MQTT_URC_EVENT_WAIT_MS;
+    }
+    if (keepGoing &&
+        (cellularPortQueueTryReceive(gQueueUrcEvent,
+                                     (int32_t) waitMs,
+                                     &dummy) == 0)) {
+        gUrcEventPending = false;
+    }
+
+    return keepGoing;
+}
+
+// Print the error state of MQTT
+static void printErrorCodes()
+{
+    int32_t err1;
+    int32_t err2;
+
+    cellular_ctrl_at_lock();
     cellular_ctrl_at_cmd_start("AT+UMQTTER");
     cellular_ctrl_at_cmd_stop();
-    cellular_ctrl_at_resp_start("+UMQTTER:", false);
-    err1 = cellular_ctrl_at_read_int();
-    err2 = cellular_ctrl_at_read_int();
+    cellular_ctrl_at_read_fields("+UMQTTER:", "i,i", &err1, &err2);
     cellular_ctrl_at_resp_stop();
     cellular_ctrl_at_unlock();
     cellularPortLog("CELLULAR_MQTT: error codes %d, %d.\n", err1, err2);
@@ -477,19 +1210,9 @@ static void printErrorCodes()
 static CellularMqttErrorCode_t atMqttStopCmdGetRespAndUnlock()
 {
     CellularMqttErrorCode_t errorCode = CELLULAR_MQTT_AT_ERROR;
-    int32_t status = 1;
+    int32_t status;
 
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
-    cellular_ctrl_at_cmd_stop();
-    cellular_ctrl_at_resp_start("+UMQTT:", false);
-    // Skip the first parameter, which is just
-    // our UMQTT command number again
-    cellular_ctrl_at_skip_param(1);
-    status = cellular_ctrl_at_read_int();
-    cellular_ctrl_at_resp_stop();
-#else
-    cellular_ctrl_at_cmd_stop_read_resp();
-#endif
+    status = atStopCmdReadStatus("+UMQTT:");
     if ((cellular_ctrl_at_unlock_return_error() == 0) &&
         (status == 1)) {
         errorCode = CELLULAR_MQTT_SUCCESS;
@@ -500,30 +1223,6 @@ static CellularMqttErrorCode_t atMqttStopCmdGetRespAndUnlock()
     return errorCode;
 }
 
-// Convert a message buffer into a hex version of that buffer,
-// returning the number of bytes (not hex values) in the hex buffer.
-static size_t toHex(char *pHex, const char *pBinary,
-                    size_t binaryLength)
-{
-    size_t hexLength = 0;
-
-    for (size_t x = 0; x < (binaryLength * 2); x++) {
-        if ((x & 1) == 0) {
-            // Even
-            *pHex = gHex[(*pBinary & 0xF0) >> 4];
-        } else {
-            // Odd
-            *pHex = gHex[*pBinary & 0x0F];
-            pBinary++;
-        }
-        pHex++;
-        hexLength++;
-    }
-
-    return hexLength;
-}
-
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
 // Set the given gUrcStatus item to "not filled in".
 // The switch statement here should match that in UUMQTTx_urc()
 static void resetUrcStatusField(int32_t number)
@@ -628,11 +1327,9 @@ static CellularCtrlErrorCode_t doUmqttQuery(int32_t number)
         cellular_ctrl_at_lock();
         cellular_ctrl_at_cmd_start(buffer);
         cellular_ctrl_at_cmd_stop();
-        cellular_ctrl_at_resp_start("+UMQTT:", false);
         // Skip the first parameter, which is just
         // our UMQTT command number again
-        cellular_ctrl_at_skip_param(1);
-        status = cellular_ctrl_at_read_int();
+        cellular_ctrl_at_read_fields("+UMQTT:", "-,i", &status);
         cellular_ctrl_at_resp_stop();
         if ((cellular_ctrl_at_unlock_return_error() == 0) &&
             (status == 1)) {
@@ -652,13 +1349,12 @@ static CellularCtrlErrorCode_t doUmqttQuery(int32_t number)
 
     return errorCode;
 }
-#endif
 
 // Set MQTT ping or "keep alive" on or off.
 static CellularMqttErrorCode_t setKeepAlive(bool onNotOff)
 {
     CellularMqttErrorCode_t errorCode = CELLULAR_MQTT_DEFAULT_ERROR_CODE;
-    int32_t status = 1;
+    int32_t status;
 
     if (gMutex != NULL) {
         // No need to lock the mutex, the
@@ -670,17 +1366,7 @@ static CellularMqttErrorCode_t setKeepAlive(bool onNotOff)
         // Set ping
         cellular_ctrl_at_write_int(8);
         cellular_ctrl_at_write_int(onNotOff);
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
-        cellular_ctrl_at_cmd_stop();
-        cellular_ctrl_at_resp_start("+UMQTTC:", false);
-        // Skip the first parameter, which is just
-        // our UMQTTC command number again
-        cellular_ctrl_at_skip_param(1);
-        status = cellular_ctrl_at_read_int();
-        cellular_ctrl_at_resp_stop();
-#else
-        cellular_ctrl_at_cmd_stop_read_resp();
-#endif
+        status = atStopCmdReadStatus("+UMQTTC:");
         if ((cellular_ctrl_at_unlock_return_error() == 0) &&
             (status == 1)) {
             // This has no URCness to it, that's it
@@ -694,7 +1380,6 @@ static CellularMqttErrorCode_t setKeepAlive(bool onNotOff)
     return errorCode;
 }
 
-#ifndef CELLULAR_CFG_MODULE_SARA_R5
 // Set MQTT session clean on or off.
 static CellularMqttErrorCode_t setSessionClean(bool onNotOff)
 {
@@ -715,7 +1400,6 @@ static CellularMqttErrorCode_t setSessionClean(bool onNotOff)
 
     return errorCode;
 }
-#endif
 
 // Set security on or off.
 static CellularMqttErrorCode_t setSecurity(bool onNotOff,
@@ -746,7 +1430,7 @@ static CellularMqttErrorCode_t setSecurity(bool onNotOff,
 static CellularMqttErrorCode_t connect(bool onNotOff)
 {
     CellularMqttErrorCode_t errorCode = CELLULAR_MQTT_DEFAULT_ERROR_CODE;
-    int32_t status = 1;
+    int32_t status;
     int64_t stopTimeMs;
 
     if (gMutex != NULL) {
@@ -758,7 +1442,7 @@ static CellularMqttErrorCode_t connect(bool onNotOff)
         CELLULAR_PORT_MUTEX_LOCK(gMutex);
 
         errorCode = CELLULAR_MQTT_AT_ERROR;
-        gUrcStatus.updateFlag = false;
+        clearUrcEvent();
         cellular_ctrl_at_lock();
         // Have seen this take a little while
         cellular_ctrl_at_set_at_timeout(15000, false);
@@ -766,17 +1450,7 @@ static CellularMqttErrorCode_t connect(bool onNotOff)
         // Conveniently log-in is command 0 and
         // log out is command 1
         cellular_ctrl_at_write_int(onNotOff);
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
-        cellular_ctrl_at_cmd_stop();
-        cellular_ctrl_at_resp_start("+UMQTTC:", false);
-        // Skip the first parameter, which is just
-        // our UMQTTC command number again
-        cellular_ctrl_at_skip_param(1);
-        status = cellular_ctrl_at_read_int();
-        cellular_ctrl_at_resp_stop();
-#else
-        cellular_ctrl_at_cmd_stop_read_resp();
-#endif
+        status = atStopCmdReadStatus("+UMQTTC:");
         cellular_ctrl_at_restore_at_timeout();
         if ((cellular_ctrl_at_unlock_return_error() == 0) &&
             (status == 1)) {
@@ -790,11 +1464,7 @@ static CellularMqttErrorCode_t connect(bool onNotOff)
                 stopTimeMs = cellularPortGetTickTimeMs() +
                              (CELLULAR_MQTT_SERVER_RESPONSE_WAIT_SECONDS * 1000);
                 while (!gUrcStatus.updateFlag &&
-                       (cellularPortGetTickTimeMs() < stopTimeMs) &&
-                       ((gpKeepGoingCallback == NULL) ||
-                        gpKeepGoingCallback())) {
-                    cellularPortTaskBlock(1000);
-                }
+                       waitUrcEvent(stopTimeMs)) {}
                 if (onNotOff == gUrcStatus.connected) {
                     errorCode = CELLULAR_MQTT_SUCCESS;
                 } else {
@@ -822,48 +1492,230 @@ static bool isSecured(int32_t *pSecurityProfileId)
 {
     bool secured = false;
 
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
-    // Lock the mutex as we'll be
-    // setting gUrcStatus items
-    // and we don't want to trample
-    // on anyone else
-    CELLULAR_PORT_MUTEX_LOCK(gMutex);
-
-    // Run the query, answers come back in gUrcStatus
-    if (doUmqttQuery(11) == 0) {
-        // SARA-R4 doesn't report the security status
-        // if it is the default of unsecured,
-        // so if we got nothing back we are unsecured.
-        if (gUrcStatus.secured >= 0) {
-            secured = gUrcStatus.secured;
-            if (secured && (pSecurityProfileId != NULL)) {
-                *pSecurityProfileId = gUrcStatus.securityProfileId;
+    if (saraR4Syntax()) {
+        // Lock the mutex as we'll be
+        // setting gUrcStatus items
+        // and we don't want to trample
+        // on anyone else
+        CELLULAR_PORT_MUTEX_LOCK(gMutex);
+
+        // Run the query, answers come back in gUrcStatus
+        if (doUmqttQuery(11) == 0) {
+            // SARA-R4 doesn't report the security status
+            // if it is the default of unsecured,
+            // so if we got nothing back we are unsecured.
+            if (gUrcStatus.secured >= 0) {
+                secured = gUrcStatus.secured;
+                if (secured && (pSecurityProfileId != NULL)) {
+                    *pSecurityProfileId = gUrcStatus.securityProfileId;
+                }
             }
         }
+
+        CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
+    } else {
+        // No need to lock the mutex, the
+        // mutex protection of the AT interface
+        // lock is sufficient
+        cellular_ctrl_at_lock();
+        cellular_ctrl_at_cmd_start("AT+UMQTT=");
+        cellular_ctrl_at_write_int(11);
+        cellular_ctrl_at_cmd_stop();
+        cellular_ctrl_at_resp_start("+UMQTT:", false);
+        // Skip the first parameter, which is just
+        // our UMQTT command number again
+        cellular_ctrl_at_skip_param(1);
+        secured = (cellular_ctrl_at_read_int() == 1);
+        if (secured && (pSecurityProfileId != NULL)) {
+            *pSecurityProfileId = cellular_ctrl_at_read_int();
+        }
+        cellular_ctrl_at_resp_stop();
+        cellular_ctrl_at_unlock();
     }
 
-    CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
-#else 
-    // No need to lock the mutex, the
-    // mutex protection of the AT interface
-    // lock is sufficient
+    return secured;
+}
+
+// Read one MQTT message, for the SARA-R4 form of AT+UMQTT,
+// where the message turns up in a +UUMQTTCM URC after the AT
+// command has completed, straight into the given buffers.
+// Note: gMutex must be locked.
+static CellularMqttErrorCode_t messageReadUrc(char *pTopicNameStr,
+                                              int32_t topicNameSizeBytes,
+                                              char *pMessage,
+                                              int32_t *pMessageSizeBytes,
+                                              CellularMqttQos_t *pQos)
+{
+    CellularMqttErrorCode_t errorCode = CELLULAR_MQTT_AT_ERROR;
+    int32_t status;
+    int64_t stopTimeMs;
+
+    // For SARA-R4 we get a standard
+    // indication of success here
+    // then we need to wait for a
+    // URC to receive the message
+    clearUrcEvent();
+    gUrcMessage.messageRead = false;
+    gUrcMessage.truncated = false;
+    gUrcMessage.pTopicNameStr = pTopicNameStr;
+    gUrcMessage.topicNameSizeBytes = topicNameSizeBytes;
+    gUrcMessage.pMessage = pMessage;
+    gUrcMessage.messageSizeBytes = *pMessageSizeBytes;
+    gStatsRead.numAtCommands++;
     cellular_ctrl_at_lock();
-    cellular_ctrl_at_cmd_start("AT+UMQTT=");
-    cellular_ctrl_at_write_int(11);
+    cellular_ctrl_at_cmd_start("AT+UMQTTC=");
+    // Read a message
+    cellular_ctrl_at_write_int(6);
     cellular_ctrl_at_cmd_stop();
-    cellular_ctrl_at_resp_start("+UMQTT:", false);
     // Skip the first parameter, which is just
-    // our UMQTT command number again
+    // our UMQTTC command number again
+    cellular_ctrl_at_read_fields("+UMQTTC:", "-,i", &status);
+    cellular_ctrl_at_resp_stop();
+    if ((cellular_ctrl_at_unlock_return_error() == 0) &&
+        (status == 1)) {
+        // Wait for a URC containing the message
+        errorCode = CELLULAR_MQTT_TIMEOUT;
+        stopTimeMs = cellularPortGetTickTimeMs() + (CELLULAR_MQTT_SERVER_RESPONSE_WAIT_SECONDS * 1000);
+        while (!gUrcMessage.messageRead &&
+               waitUrcEvent(stopTimeMs)) {}
+        if (gUrcMessage.messageRead) {
+            if (gUrcStatus.numUnreadMessages > 0) {
+                gUrcStatus.numUnreadMessages--;
+            }
+            // pTopicNameStr and pMessage were filled
+            // in directly, now fill in the passed-in
+            // parameters that we haven't already done
+            *pMessageSizeBytes = gUrcMessage.messageSizeBytes;
+            if (pQos != NULL) {
+                *pQos = gUrcMessage.qos;
+            }
+            errorCode = CELLULAR_MQTT_SUCCESS;
+            if (gUrcMessage.truncated) {
+                errorCode = CELLULAR_MQTT_MESSAGE_TRUNCATED;
+            }
+        }
+    } else {
+        printErrorCodes();
+    }
+    // Make sure a late URC can't write to
+    // the caller's buffer after we've gone
+    gUrcMessage.pMessage = NULL;
+    gUrcMessage.pTopicNameStr = NULL;
+
+    if ((errorCode == CELLULAR_MQTT_SUCCESS) ||
+        (errorCode == CELLULAR_MQTT_MESSAGE_TRUNCATED)) {
+        gStatsRead.numMessagesRead++;
+        gStatsRead.bytesRead += *pMessageSizeBytes;
+    } else {
+        gStatsRead.numErrors++;
+    }
+
+    return errorCode;
+}
+
+// Read one MQTT message, which arrives in the response
+// to the AT command, straight into the given buffers.
+// Note: gMutex must be locked and so must the AT
+// interface; this function does not unlock it so that
+// several messages may be read in one go.
+static CellularMqttErrorCode_t messageReadLocked(char *pTopicNameStr,
+                                                 int32_t topicNameSizeBytes,
+                                                 char *pMessage,
+                                                 int32_t *pMessageSizeBytes,
+                                                 CellularMqttQos_t *pQos)
+{
+    CellularMqttErrorCode_t errorCode = CELLULAR_MQTT_AT_ERROR;
+    CellularMqttQos_t qos;
+    int32_t topicNameBytesAvailable;
+    int32_t topicNameBytesRead;
+    int32_t messageBytesAvailable;
+    int32_t messageBytesRead;
+    int32_t messageBytesToRead;
+    uint8_t quoteMark;
+
+    gStatsRead.numAtCommands++;
+    cellular_ctrl_at_clear_error();
+    cellular_ctrl_at_cmd_start("AT+UMQTTC=");
+    // Read a message
+    cellular_ctrl_at_write_int(6);
+    // We want just the one message
+    cellular_ctrl_at_write_int(1);
+    cellular_ctrl_at_cmd_stop();
+    cellular_ctrl_at_resp_start("+UMQTTC:", false);
+    // The message now arrives directly
+    // Skip the first parameter, which is just
+    // our UMQTTC command number again
+    cellular_ctrl_at_skip_param(1);
+    // Next comes the QoS
+    qos = cellular_ctrl_at_read_int();
+    // Then we can skip the length of
+    // the topic and message added together
     cellular_ctrl_at_skip_param(1);
-    secured = (cellular_ctrl_at_read_int() == 1);
-    if (secured && (pSecurityProfileId != NULL)) {
-        *pSecurityProfileId = cellular_ctrl_at_read_int();
+    // Next the length of the topic, which
+    // tells us whether it will fit
+    topicNameBytesAvailable = cellular_ctrl_at_read_int();
+    // Now read the topic name string (which
+    // is always an ASCII string so we can read
+    // it as such); should it not fit, the rest
+    // is consumed up to the delimiter
+    topicNameBytesRead = cellular_ctrl_at_read_string(pTopicNameStr,
+                                                      topicNameSizeBytes,
+                                                      false);
+    // Read the number of message bytes to follow
+    messageBytesAvailable = cellular_ctrl_at_read_int();
+    messageBytesToRead = messageBytesAvailable;
+    if (messageBytesToRead > *pMessageSizeBytes) {
+        messageBytesToRead = *pMessageSizeBytes;
+    }
+    // Now read the exact length of message
+    // bytes, being careful to not look for
+    // delimiters or the like as this can be
+    // a binary message
+    cellular_ctrl_at_set_delimiter(0);
+    cellular_ctrl_at_set_stop_tag(NULL);
+    // Get the leading quote mark out of the way
+    cellular_ctrl_at_read_bytes(&quoteMark, 1);
+    // Now read the actual message data
+    // straight into the caller's buffer
+    messageBytesRead = cellular_ctrl_at_read_bytes((uint8_t *) pMessage,
+                                                   messageBytesToRead);
+    // Throw away any remainder
+    if (messageBytesAvailable > messageBytesToRead) {
+        cellular_ctrl_at_read_bytes(NULL,
+                                    messageBytesAvailable - messageBytesToRead);
     }
     cellular_ctrl_at_resp_stop();
-    cellular_ctrl_at_unlock();
-#endif
+    cellular_ctrl_at_set_default_delimiter();
+    if (cellular_ctrl_at_get_last_error() == 0) {
+        // Now have all the bits, check them
+        if ((topicNameBytesRead >= 0) &&
+            (qos >= 0) &&
+            (qos < MAX_NUM_CELLULAR_MQTT_QOS) &&
+            (messageBytesRead >= 0)) {
+            // Good.  pTopicNameStr and pMessage
+            // were filled in above, now fill in
+            // the other passed-in parameters
+            *pMessageSizeBytes = messageBytesRead;
+            if (pQos != NULL) {
+                *pQos = qos;
+            }
+            if (gUrcStatus.numUnreadMessages > 0) {
+                gUrcStatus.numUnreadMessages--;
+            }
+            errorCode = CELLULAR_MQTT_SUCCESS;
+            if ((topicNameBytesAvailable >= topicNameSizeBytes) ||
+                (messageBytesAvailable > messageBytesToRead)) {
+                errorCode = CELLULAR_MQTT_MESSAGE_TRUNCATED;
+            }
+            gStatsRead.numMessagesRead++;
+            gStatsRead.bytesRead += messageBytesRead;
+        }
+    }
+    if (errorCode == CELLULAR_MQTT_AT_ERROR) {
+        gStatsRead.numErrors++;
+    }
 
-    return secured;
+    return errorCode;
 }
 
 /* ----------------------------------------------------------------
@@ -884,13 +1736,13 @@ int32_t cellularMqttInit(const char *pServerNameStr,
     char *pAddress;
     char *pTmp;
     int32_t port;
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
-    int32_t status = 1;
-#endif
+    int32_t status;
     bool keepGoing = true;
 
     errorCode = CELLULAR_MQTT_SUCCESS;
-    if (gMutex == NULL) {
+    if (!pCellularCtrlGetModuleProfile()->mqttIsSupported) {
+        errorCode = CELLULAR_MQTT_NOT_SUPPORTED;
+    } else if (gMutex == NULL) {
         errorCode = CELLULAR_MQTT_BAD_ADDRESS;
         // Check parameters, only pServerNameStr has to be present
         if ((pServerNameStr != NULL) &&
@@ -899,7 +1751,12 @@ int32_t cellularMqttInit(const char *pServerNameStr,
             // Allocate space to fiddle with the
             // server address, +1 for terminator
             errorCode = CELLULAR_MQTT_NO_MEMORY;
-            pAddress = (char *) pCellularPort_malloc(CELLULAR_MQTT_SERVER_ADDRESS_STRING_MAX_LENGTH_BYTES + 1);
+#if CELLULAR_CFG_STATIC_ALLOC
+            pAddress = gServerAddress;
+#else
+            pAddress = (char *) pCellularPort_mallocTag(CELLULAR_MQTT_SERVER_ADDRESS_STRING_MAX_LENGTH_BYTES + 1,
+                                                        CELLULAR_PORT_MALLOC_TAG_MQTT);
+#endif
             if (pAddress != NULL) {
                 errorCode = CELLULAR_MQTT_AT_ERROR;
                 // Determine if the server name given
@@ -950,8 +1807,10 @@ int32_t cellularMqttInit(const char *pServerNameStr,
                     keepGoing = (atMqttStopCmdGetRespAndUnlock() == 0);
                 }
 
+#if !CELLULAR_CFG_STATIC_ALLOC
                 // Free memory
                 cellularPort_free(pAddress);
+#endif
 
                 // Now deal with the credentials
                 if (keepGoing && (pUserNameStr != NULL)) {
@@ -979,37 +1838,51 @@ int32_t cellularMqttInit(const char *pServerNameStr,
                     keepGoing = (atMqttStopCmdGetRespAndUnlock() == 0);
                 }
 
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
-                if (keepGoing) {
-                    // If this is SARA-R4, select verbose message reads
+                if (keepGoing && saraR4Syntax()) {
+                    // With the SARA-R4 form of AT+UMQTT,
+                    // select verbose message reads
                     cellular_ctrl_at_lock();
                     cellular_ctrl_at_cmd_start("AT+UMQTTC=");
                     // Message read format
                     cellular_ctrl_at_write_int(7);
                     // Format: verbose
                     cellular_ctrl_at_write_int(2);
-                    cellular_ctrl_at_cmd_stop();
-                    cellular_ctrl_at_resp_start("+UMQTTC:", false);
-                    // Skip the first parameter, which is just
-                    // our UMQTTC command number again
-                    cellular_ctrl_at_skip_param(1);
-                    status = cellular_ctrl_at_read_int();
-                    cellular_ctrl_at_resp_stop();
+                    status = atStopCmdReadStatus("+UMQTTC:");
                     keepGoing = ((cellular_ctrl_at_unlock_return_error() == 0) &&
                                  (status == 1));
                 }
-#endif
                 // Almost done
                 if (keepGoing) {
-                    // Finally, create the mutex that we use for re-entrancy protection
-                    if (cellularPortMutexCreate(&gMutex) == 0) {
+                    // Finally, create the mutexes that we use for re-entrancy
+                    // protection and the queue a URC uses to wake us up
+                    if ((cellularPortMutexCreate(&gPublishMutex) == 0) &&
+                        (cellularPortQueueCreate(2, sizeof(int32_t),
+                                                 &gQueueUrcEvent) == 0) &&
+                        (cellularPortMutexCreate(&gMutex) == 0)) {
+                        gUrcEventPending = false;
+                        gpPublishQueue = NULL;
+                        gPublishQueueLength = 0;
+                        gpPublishInFlight = NULL;
+                        gpPublishDone = NULL;
+                        pCellularPort_memset(gpTopics, 0, sizeof(gpTopics));
                         pCellularPort_memset((void *) &gUrcStatus, 0, sizeof(gUrcStatus));
+                        pCellularPort_memset(&gStatsPublish, 0, sizeof(gStatsPublish));
+                        pCellularPort_memset(&gStatsRead, 0, sizeof(gStatsRead));
                         cellular_ctrl_at_set_urc_handler("+UUMQTT", UUMQTT_urc, NULL);
                         gpKeepGoingCallback = pKeepGoingCallback;
                         gpMessageIndicationCallback = NULL;
                         gpMessageIndicationCallbackParam = NULL;
                         gKeptAlive = false;
                         errorCode = CELLULAR_MQTT_SUCCESS;
+                    } else {
+                        if (gQueueUrcEvent != NULL) {
+                            cellularPortQueueDelete(gQueueUrcEvent);
+                            gQueueUrcEvent = NULL;
+                        }
+                        if (gPublishMutex != NULL) {
+                            cellularPortMutexDelete(gPublishMutex);
+                            gPublishMutex = NULL;
+                        }
                     }
                 } else {
                     printErrorCodes();
@@ -1025,8 +1898,34 @@ int32_t cellularMqttInit(const char *pServerNameStr,
 // Shut-down the MQTT client.
 void cellularMqttDeinit()
 {
+    MqttPublish_t *pPublish;
+
     if (gMutex != NULL) {
         cellular_ctrl_at_remove_urc_handler("+UUMQTT");
+
+        // Complete anything left on the publish
+        // queue, calling the callbacks
+        CELLULAR_PORT_MUTEX_LOCK(gPublishMutex);
+
+        pPublish = gpPublishInFlight;
+        if (pPublish != NULL) {
+            gpPublishInFlight = NULL;
+            publishComplete(pPublish, CELLULAR_MQTT_NOT_INITIALISED);
+        }
+        while (gpPublishQueue != NULL) {
+            pPublish = gpPublishQueue;
+            gpPublishQueue = pPublish->pNext;
+            publishComplete(pPublish, CELLULAR_MQTT_NOT_INITIALISED);
+        }
+
+        CELLULAR_PORT_MUTEX_UNLOCK(gPublishMutex);
+
+        publishDeliver();
+
+        cellularPortMutexDelete(gPublishMutex);
+        gPublishMutex = NULL;
+        cellularPortQueueDelete(gQueueUrcEvent);
+        gQueueUrcEvent = NULL;
         cellularPortMutexDelete(gMutex);
         gMutex = NULL;
     }
@@ -1037,14 +1936,11 @@ int32_t cellularMqttGetClientId(char *pClientIdStr,
                                 int32_t sizeBytes)
 {
     CellularMqttErrorCode_t errorCode = CELLULAR_MQTT_DEFAULT_ERROR_CODE;
-#ifndef CELLULAR_CFG_MODULE_SARA_R4
     int32_t bytesRead;
-#endif
 
     if (gMutex != NULL) {
         errorCode = CELLULAR_MQTT_INVALID_PARAMETER;
-        if (pClientIdStr != NULL) {
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
+        if ((pClientIdStr != NULL) && saraR4Syntax()) {
             // Lock the mutex as we'll be
             // setting gUrcStatus items
             // and we don't want to trample
@@ -1060,7 +1956,7 @@ int32_t cellularMqttGetClientId(char *pClientIdStr,
             gUrcStatus.clientId.sizeBytes = 0;
 
             CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
-#else
+        } else if (pClientIdStr != NULL) {
             // No need to lock the mutex, the
             // mutex protection of the AT interface
             // lock is sufficient
@@ -1080,7 +1976,6 @@ int32_t cellularMqttGetClientId(char *pClientIdStr,
                 (bytesRead >= 0)) {
                 errorCode = CELLULAR_MQTT_SUCCESS;
             }
-#endif
         }
     }
 
@@ -1092,10 +1987,10 @@ int32_t cellularMqttSetLocalPort(uint16_t port)
 {
     CellularMqttErrorCode_t errorCode = CELLULAR_MQTT_DEFAULT_ERROR_CODE;
 
-    if (gMutex != NULL) {
-#ifdef CELLULAR_CFG_MODULE_SARA_R5
+    if ((gMutex != NULL) &&
+        !pCellularCtrlGetModuleProfile()->mqttLocalPortIsSupported) {
         errorCode = CELLULAR_MQTT_NOT_SUPPORTED;
-#else
+    } else if (gMutex != NULL) {
         // No need to lock the mutex, the
         // mutex protection of the AT interface
         // lock is sufficient
@@ -1105,7 +2000,6 @@ int32_t cellularMqttSetLocalPort(uint16_t port)
         cellular_ctrl_at_write_int(1);
         cellular_ctrl_at_write_int(port);
         errorCode = atMqttStopCmdGetRespAndUnlock();
-#endif
     }
 
     return (int32_t) errorCode;
@@ -1115,12 +2009,9 @@ int32_t cellularMqttSetLocalPort(uint16_t port)
 int32_t cellularMqttGetLocalPort()
 {
     CellularMqttErrorCode_t errorCodeOrPort = CELLULAR_MQTT_DEFAULT_ERROR_CODE;
-#if !defined(CELLULAR_CFG_MODULE_SARA_R4) && !defined(CELLULAR_CFG_MODULE_SARA_R5)
     int32_t x;
-#endif
 
-    if (gMutex != NULL) {
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
+    if ((gMutex != NULL) && saraR4Syntax()) {
         // Lock the mutex as we'll be
         // setting gUrcStatus items
         // and we don't want to trample
@@ -1144,9 +2035,9 @@ int32_t cellularMqttGetLocalPort()
                 errorCodeOrPort = CELLULAR_MQTT_SERVER_PORT_SECURE;
             }
         }
-#else
-# ifdef CELLULAR_CFG_MODULE_SARA_R5
-        // SARA-R5 doesn't support reading
+    } else if ((gMutex != NULL) &&
+               !pCellularCtrlGetModuleProfile()->mqttLocalPortIsSupported) {
+        // The module doesn't support reading
         // the local port number, just return
         // the correct one depending on
         // whether security is on or not
@@ -1154,7 +2045,7 @@ int32_t cellularMqttGetLocalPort()
         if (isSecured(NULL)) {
             errorCodeOrPort = CELLULAR_MQTT_SERVER_PORT_SECURE;
         }
-# else
+    } else if (gMutex != NULL) {
         // No need to lock the mutex, the
         // mutex protection of the AT interface
         // lock is sufficient
@@ -1163,18 +2054,14 @@ int32_t cellularMqttGetLocalPort()
         cellular_ctrl_at_cmd_start("AT+UMQTT=");
         cellular_ctrl_at_write_int(1);
         cellular_ctrl_at_cmd_stop();
-        cellular_ctrl_at_resp_start("+UMQTT:", false);
         // Skip the first parameter, which is just
         // our UMQTT command number again
-        cellular_ctrl_at_skip_param(1);
-        x = cellular_ctrl_at_read_int();
+        cellular_ctrl_at_read_fields("+UMQTT:", "-,i", &x);
         cellular_ctrl_at_resp_stop();
         if ((cellular_ctrl_at_unlock_return_error() == 0) &&
             (x >= 0)) {
             errorCodeOrPort = x;
         }
-# endif
-#endif
     }
 
     return (int32_t) errorCodeOrPort;
@@ -1204,12 +2091,9 @@ int32_t cellularMqttSetInactivityTimeout(int32_t seconds)
 int32_t cellularMqttGetInactivityTimeout()
 {
     CellularMqttErrorCode_t errorCodeOrTimeout = CELLULAR_MQTT_DEFAULT_ERROR_CODE;
-#ifndef CELLULAR_CFG_MODULE_SARA_R4
     int32_t x;
-#endif
 
-    if (gMutex != NULL) {
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
+    if ((gMutex != NULL) && saraR4Syntax()) {
         // Lock the mutex as we'll be
         // setting gUrcStatus items
         // and we don't want to trample
@@ -1222,7 +2106,7 @@ int32_t cellularMqttGetInactivityTimeout()
         }
 
         CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
-#else
+    } else if (gMutex != NULL) {
         // No need to lock the mutex, the
         // mutex protection of the AT interface
         // lock is sufficient
@@ -1231,17 +2115,14 @@ int32_t cellularMqttGetInactivityTimeout()
         cellular_ctrl_at_cmd_start("AT+UMQTT=");
         cellular_ctrl_at_write_int(10);
         cellular_ctrl_at_cmd_stop();
-        cellular_ctrl_at_resp_start("+UMQTT:", false);
         // Skip the first parameter, which is just
         // our UMQTT command number again
-        cellular_ctrl_at_skip_param(1);
-        x = cellular_ctrl_at_read_int();
+        cellular_ctrl_at_read_fields("+UMQTT:", "-,i", &x);
         cellular_ctrl_at_resp_stop();
         if ((cellular_ctrl_at_unlock_return_error() == 0) &&
             (x >= 0)) {
             errorCodeOrTimeout = x;
         }
-#endif
     }
 
     return (int32_t) errorCodeOrTimeout;
@@ -1268,21 +2149,21 @@ bool cellularMqttIsKeptAlive()
 // Switch session cleaning on.
 int32_t cellularMqttSetSessionCleanOn()
 {
-#ifdef CELLULAR_CFG_MODULE_SARA_R5
-    return CELLULAR_MQTT_NOT_SUPPORTED;
-#else
+    if (!pCellularCtrlGetModuleProfile()->mqttSessionCleanIsSupported) {
+        return CELLULAR_MQTT_NOT_SUPPORTED;
+    }
+
     return (int32_t) setSessionClean(true);
-#endif
 }
 
 // Switch MQTT session cleaning off.
 int32_t cellularMqttSetSessionCleanOff()
 {
-#ifdef CELLULAR_CFG_MODULE_SARA_R5
-    return CELLULAR_MQTT_NOT_SUPPORTED;
-#else
+    if (!pCellularCtrlGetModuleProfile()->mqttSessionCleanIsSupported) {
+        return CELLULAR_MQTT_NOT_SUPPORTED;
+    }
+
     return (int32_t) setSessionClean(false);
-#endif
 }
 
 // Determine whether MQTT session cleaning is on.
@@ -1290,8 +2171,7 @@ bool cellularMqttIsSessionClean()
 {
     bool sessionClean = true;
 
-    if (gMutex != NULL) {
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
+    if ((gMutex != NULL) && saraR4Syntax()) {
         // Lock the mutex as we'll be
         // setting gUrcStatus items
         // and we don't want to trample
@@ -1305,12 +2185,12 @@ bool cellularMqttIsSessionClean()
         }
 
         CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
-#else
-        // SARA-R5 only supports session cleaning
-# ifndef CELLULAR_CFG_MODULE_SARA_R5
-        // No need to lock the mutex, the
-        // mutex protection of the AT interface
-        // lock is sufficient
+    } else if ((gMutex != NULL) &&
+               pCellularCtrlGetModuleProfile()->mqttSessionCleanIsSupported) {
+        // A module that can't switch session
+        // cleaning always cleans.  No need to
+        // lock the mutex, the mutex protection
+        // of the AT interface lock is sufficient
         cellular_ctrl_at_lock();
         cellular_ctrl_at_cmd_start("AT+UMQTT=");
         cellular_ctrl_at_write_int(12);
@@ -1322,8 +2202,6 @@ bool cellularMqttIsSessionClean()
         sessionClean = (cellular_ctrl_at_read_int() == 1);
         cellular_ctrl_at_resp_stop();
         cellular_ctrl_at_unlock();
-# endif
-#endif
     }
 
     return sessionClean;
@@ -1414,93 +2292,268 @@ int32_t cellularMqttPublish(CellularMqttQos_t qos,
                             int32_t messageSizeBytes)
 {
     CellularMqttErrorCode_t errorCode = CELLULAR_MQTT_DEFAULT_ERROR_CODE;
-    char *pHexMessage;
-    int32_t status = 1;
-#ifndef CELLULAR_CFG_MODULE_SARA_R4
     int64_t stopTimeMs;
-#endif
 
     if (gMutex != NULL) {
         errorCode = CELLULAR_MQTT_INVALID_PARAMETER;
-        if ((qos >= 0) &&
-            (qos < MAX_NUM_CELLULAR_MQTT_QOS) &&
-            (pTopicNameStr != NULL) &&
-            (pMessage != NULL) &&
-            (messageSizeBytes <= CELLULAR_MQTT_PUBLISH_MAX_LENGTH_BYTES)) {
-            // Allocate memory to store the hex
-            // version of the message
-            errorCode = CELLULAR_MQTT_NO_MEMORY;
-            pHexMessage = (char *) pCellularPort_malloc((messageSizeBytes * 2) + 1);
-            if (pHexMessage != NULL) {
-                // Convert to hex
-                toHex(pHexMessage, pMessage, messageSizeBytes);
-                // Add a terminator to make it a string
-                *(pHexMessage + (messageSizeBytes * 2)) = '\0';
-
-                // Lock the mutex as we'll be
-                // setting gUrcStatus.publishSuccess
-                // and we don't want to trample
-                // on anyone else
-                CELLULAR_PORT_MUTEX_LOCK(gMutex);
+        if (publishParametersAreValid(qos, pTopicNameStr,
+                                      pMessage, messageSizeBytes)) {
 
-                errorCode = CELLULAR_MQTT_AT_ERROR;
-                cellular_ctrl_at_lock();
-                gUrcStatus.updateFlag = false;
-                gUrcStatus.publishSuccess = false;
-                cellular_ctrl_at_cmd_start("AT+UMQTTC=");
-                // Publish message
-                cellular_ctrl_at_write_int(2);
-                // QoS
-                cellular_ctrl_at_write_int(qos);
-                // Cleaning
-                cellular_ctrl_at_write_int(clean);
-                // Hex mode
-                cellular_ctrl_at_write_int(1);
-                // Topic
-                cellular_ctrl_at_write_string(pTopicNameStr, true);
-                // Hex message
-                cellular_ctrl_at_write_string(pHexMessage, true);
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
-                cellular_ctrl_at_cmd_stop();
-                cellular_ctrl_at_resp_start("+UMQTTC:", false);
-                // Skip the first parameter, which is just
-                // our UMQTTC command number again
-                cellular_ctrl_at_skip_param(1);
-                status = cellular_ctrl_at_read_int();
-                cellular_ctrl_at_resp_stop();
-#else
-                cellular_ctrl_at_cmd_stop_read_resp();
-#endif
-                if ((cellular_ctrl_at_unlock_return_error() == 0) &&
-                    (status == 1)) {
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
-                    // For SARA-R4, that's it
-                    errorCode = CELLULAR_MQTT_SUCCESS;
-#else
-                    // Wait for a URC to say that the publish
-                    // has succeeded
-                    errorCode = CELLULAR_MQTT_TIMEOUT;
-                    stopTimeMs = cellularPortGetTickTimeMs() + (CELLULAR_MQTT_SERVER_RESPONSE_WAIT_SECONDS * 1000);
-                    while (!gUrcStatus.updateFlag &&
-                           (cellularPortGetTickTimeMs() < stopTimeMs) &&
-                           ((gpKeepGoingCallback == NULL) ||
-                            gpKeepGoingCallback())) {
-                        cellularPortTaskBlock(1000);
-                    }
-                    if (gUrcStatus.publishSuccess) {
-                        errorCode = CELLULAR_MQTT_SUCCESS;
-                    } else {
-                        printErrorCodes();
+            // Lock the mutex as we'll be
+            // using gPublishSync and we don't
+            // want to trample on anyone else
+            CELLULAR_PORT_MUTEX_LOCK(gMutex);
+
+            clearUrcEvent();
+            gPublishSyncDone = false;
+            // Since we wait here the message can be
+            // sent straight from the caller's buffers
+            gPublishSync.qos = qos;
+            gPublishSync.clean = clean;
+            gPublishSync.pTopicNameStr = pTopicNameStr;
+            gPublishSync.pMessage = pMessage;
+            gPublishSync.messageSizeBytes = messageSizeBytes;
+            gPublishSync.pCallback = publishSyncCallback;
+            gPublishSync.pCallbackParam = NULL;
+            gPublishSync.errorCode = CELLULAR_MQTT_TIMEOUT;
+
+            // Go on the end of the queue, behind any
+            // asynchronous publishes, so that order
+            // is kept
+            CELLULAR_PORT_MUTEX_LOCK(gPublishMutex);
+            publishListAdd(&gpPublishQueue, &gPublishSync);
+            publishPump();
+            CELLULAR_PORT_MUTEX_UNLOCK(gPublishMutex);
+            publishDeliver();
+
+            // Wait for the outcome, which for the SARA-R4
+            // form of AT+UMQTT will already be here
+            stopTimeMs = cellularPortGetTickTimeMs() +
+                         (CELLULAR_MQTT_SERVER_RESPONSE_WAIT_SECONDS * 1000);
+            while (!gPublishSyncDone &&
+                   waitUrcEvent(stopTimeMs)) {}
+
+            if (gPublishSyncDone) {
+                errorCode = gPublishSync.errorCode;
+            } else {
+                // Give up: take the publish back off
+                // whichever list it is on
+                errorCode = CELLULAR_MQTT_TIMEOUT;
+                CELLULAR_PORT_MUTEX_LOCK(gPublishMutex);
+                gStatsPublish.numErrors++;
+                if (!publishListRemove(&gpPublishQueue, &gPublishSync) &&
+                    !publishListRemove(&gpPublishDone, &gPublishSync) &&
+                    (gpPublishInFlight == &gPublishSync)) {
+                    gpPublishInFlight = NULL;
+                    publishPump();
+                }
+                CELLULAR_PORT_MUTEX_UNLOCK(gPublishMutex);
+                publishDeliver();
+            }
+            if (errorCode != CELLULAR_MQTT_SUCCESS) {
+                printErrorCodes();
+            }
+
+            CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Publish an MQTT message without waiting for the outcome.
+int32_t cellularMqttPublishAsync(CellularMqttQos_t qos,
+                                 bool clean,
+                                 const char *pTopicNameStr,
+                                 const char *pMessage,
+                                 int32_t messageSizeBytes,
+                                 void (*pCallback)(int32_t, void *),
+                                 void *pCallbackParam)
+{
+    CellularMqttErrorCode_t errorCode = CELLULAR_MQTT_DEFAULT_ERROR_CODE;
+
+    if (gMutex != NULL) {
+        errorCode = publishAsync(qos, clean, pTopicNameStr, true,
+                                 pMessage, messageSizeBytes,
+                                 pCallback, pCallbackParam);
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Register a topic.
+int32_t cellularMqttTopicRegister(const char *pTopicNameStr)
+{
+    CellularMqttErrorCode_t errorCodeOrHandle = CELLULAR_MQTT_DEFAULT_ERROR_CODE;
+    int32_t freeHandle = -1;
+
+    if (gMutex != NULL) {
+        errorCodeOrHandle = CELLULAR_MQTT_INVALID_PARAMETER;
+        if (pTopicNameStr != NULL) {
+
+            CELLULAR_PORT_MUTEX_LOCK(gPublishMutex);
+
+            // Hand back the existing handle if this
+            // topic is already registered
+            errorCodeOrHandle = CELLULAR_MQTT_NO_MEMORY;
+            for (size_t x = 0; (x < sizeof(gpTopics) / sizeof(gpTopics[0])) &&
+                               (errorCodeOrHandle < 0); x++) {
+                if (gpTopics[x] == NULL) {
+                    if (freeHandle < 0) {
+                        freeHandle = x;
                     }
-#endif
-                } else {
-                    printErrorCodes();
+                } else if (cellularPort_strcmp(gpTopics[x], pTopicNameStr) == 0) {
+                    errorCodeOrHandle = (CellularMqttErrorCode_t) x;
                 }
+            }
+            if ((errorCodeOrHandle < 0) && (freeHandle >= 0)) {
+                gpTopics[freeHandle] = pTopicNameStr;
+                errorCodeOrHandle = (CellularMqttErrorCode_t) freeHandle;
+            }
 
-                CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
+            CELLULAR_PORT_MUTEX_UNLOCK(gPublishMutex);
+        }
+    }
 
-                // Free memory
-                cellularPort_free(pHexMessage);
+    return (int32_t) errorCodeOrHandle;
+}
+
+// Deregister a topic.
+int32_t cellularMqttTopicDeregister(int32_t handle)
+{
+    CellularMqttErrorCode_t errorCode = CELLULAR_MQTT_DEFAULT_ERROR_CODE;
+
+    if (gMutex != NULL) {
+
+        CELLULAR_PORT_MUTEX_LOCK(gPublishMutex);
+
+        errorCode = CELLULAR_MQTT_INVALID_PARAMETER;
+        if (pTopicGet(handle) != NULL) {
+            gpTopics[handle] = NULL;
+            errorCode = CELLULAR_MQTT_SUCCESS;
+        }
+
+        CELLULAR_PORT_MUTEX_UNLOCK(gPublishMutex);
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Get the topic string for a handle.
+const char *pCellularMqttTopicGet(int32_t handle)
+{
+    const char *pTopicNameStr = NULL;
+
+    if (gMutex != NULL) {
+
+        CELLULAR_PORT_MUTEX_LOCK(gPublishMutex);
+
+        pTopicNameStr = pTopicGet(handle);
+
+        CELLULAR_PORT_MUTEX_UNLOCK(gPublishMutex);
+    }
+
+    return pTopicNameStr;
+}
+
+// Publish an MQTT message to a registered topic.
+int32_t cellularMqttPublishTopic(CellularMqttQos_t qos,
+                                 bool clean,
+                                 int32_t handle,
+                                 const char *pMessage,
+                                 int32_t messageSizeBytes)
+{
+    CellularMqttErrorCode_t errorCode = CELLULAR_MQTT_DEFAULT_ERROR_CODE;
+    const char *pTopicNameStr;
+
+    if (gMutex != NULL) {
+        errorCode = CELLULAR_MQTT_INVALID_PARAMETER;
+        pTopicNameStr = pCellularMqttTopicGet(handle);
+        if (pTopicNameStr != NULL) {
+            errorCode = (CellularMqttErrorCode_t) cellularMqttPublish(qos, clean,
+                                                                      pTopicNameStr,
+                                                                      pMessage,
+                                                                      messageSizeBytes);
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Publish an MQTT message to a registered topic without
+// waiting for the outcome.
+int32_t cellularMqttPublishTopicAsync(CellularMqttQos_t qos,
+                                      bool clean,
+                                      int32_t handle,
+                                      const char *pMessage,
+                                      int32_t messageSizeBytes,
+                                      void (*pCallback)(int32_t, void *),
+                                      void *pCallbackParam)
+{
+    CellularMqttErrorCode_t errorCode = CELLULAR_MQTT_DEFAULT_ERROR_CODE;
+    const char *pTopicNameStr;
+
+    if (gMutex != NULL) {
+        errorCode = CELLULAR_MQTT_INVALID_PARAMETER;
+        pTopicNameStr = pCellularMqttTopicGet(handle);
+        if (pTopicNameStr != NULL) {
+            // No need to copy the topic, it stays put
+            errorCode = publishAsync(qos, clean, pTopicNameStr, false,
+                                     pMessage, messageSizeBytes,
+                                     pCallback, pCallbackParam);
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Publish an MQTT message through the transmit scheduler.
+int32_t cellularMqttPublishDeferred(CellularMqttQos_t qos,
+                                   bool clean,
+                                   const char *pTopicNameStr,
+                                   const char *pMessage,
+                                   int32_t messageSizeBytes,
+                                   int32_t deadlineSeconds)
+{
+    CellularMqttErrorCode_t errorCode = CELLULAR_MQTT_DEFAULT_ERROR_CODE;
+    char *pData;
+    size_t topicSizeBytes;
+
+    if (gMutex != NULL) {
+        errorCode = CELLULAR_MQTT_INVALID_PARAMETER;
+        if (publishParametersAreValid(qos, pTopicNameStr,
+                                      pMessage, messageSizeBytes)) {
+            if (deadlineSeconds <= 0) {
+                // Urgent, no need to copy anything
+                errorCode = (CellularMqttErrorCode_t) cellularMqttPublish(qos, clean,
+                                                                          pTopicNameStr,
+                                                                          pMessage,
+                                                                          messageSizeBytes);
+            } else {
+                // The scheduler holds back a single block of
+                // data, so put the topic in front of the message
+                errorCode = CELLULAR_MQTT_NO_MEMORY;
+                topicSizeBytes = cellularPort_strlen(pTopicNameStr) + 1;
+                pData = (char *) pCellularPort_mallocTag(topicSizeBytes + messageSizeBytes,
+                                                         CELLULAR_PORT_MALLOC_TAG_MQTT);
+                if (pData != NULL) {
+                    pCellularPort_memcpy(pData, pTopicNameStr, topicSizeBytes);
+                    pCellularPort_memcpy(pData + topicSizeBytes, pMessage,
+                                         messageSizeBytes);
+                    errorCode = (CellularMqttErrorCode_t) cellularCtrlTxSchedulerSend(publishDeferred,
+                                                                                      (void *) (intptr_t) ((((int32_t) qos) << 1) |
+                                                                                                           (clean ? 1 : 0)),
+                                                                                      pData,
+                                                                                      topicSizeBytes + messageSizeBytes,
+                                                                                      deadlineSeconds);
+                    if (errorCode > 0) {
+                        // Held back
+                        errorCode = CELLULAR_MQTT_SUCCESS;
+                    } else if (errorCode == (CellularMqttErrorCode_t) CELLULAR_CTRL_NO_MEMORY) {
+                        errorCode = CELLULAR_MQTT_NO_MEMORY;
+                    }
+                    cellularPort_free(pData);
+                }
             }
         }
     }
@@ -1508,6 +2561,26 @@ int32_t cellularMqttPublish(CellularMqttQos_t qos,
     return (int32_t) errorCode;
 }
 
+// Get the number of asynchronous publishes not yet completed.
+int32_t cellularMqttGetNumPublishPending()
+{
+    CellularMqttErrorCode_t errorCodeOrNum = CELLULAR_MQTT_DEFAULT_ERROR_CODE;
+
+    if (gMutex != NULL) {
+
+        CELLULAR_PORT_MUTEX_LOCK(gPublishMutex);
+
+        publishPump();
+        errorCodeOrNum = (CellularMqttErrorCode_t) gPublishQueueLength;
+
+        CELLULAR_PORT_MUTEX_UNLOCK(gPublishMutex);
+
+        publishDeliver();
+    }
+
+    return (int32_t) errorCodeOrNum;
+}
+
 // Subscribe to an MQTT topic.
 int32_t cellularMqttSubscribe(CellularMqttQos_t maxQos,
                              const char *pTopicFilterStr)
@@ -1529,7 +2602,7 @@ int32_t cellularMqttSubscribe(CellularMqttQos_t maxQos,
 
             errorCodeOrQos = CELLULAR_MQTT_AT_ERROR;
             cellular_ctrl_at_lock();
-            gUrcStatus.updateFlag = false;
+            clearUrcEvent();
             gUrcStatus.subscribeSuccess = false;
             cellular_ctrl_at_cmd_start("AT+UMQTTC=");
             // Subscribe to a topic
@@ -1538,17 +2611,7 @@ int32_t cellularMqttSubscribe(CellularMqttQos_t maxQos,
             cellular_ctrl_at_write_int(maxQos);
             // Topic
             cellular_ctrl_at_write_string(pTopicFilterStr, true);
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
-            cellular_ctrl_at_cmd_stop();
-            cellular_ctrl_at_resp_start("+UMQTTC:", false);
-            // Skip the first parameter, which is just
-            // our UMQTTC command number again
-            cellular_ctrl_at_skip_param(1);
-            status = cellular_ctrl_at_read_int();
-            cellular_ctrl_at_resp_stop();
-#else
-            cellular_ctrl_at_cmd_stop_read_resp();
-#endif
+            status = atStopCmdReadStatus("+UMQTTC:");
             if ((cellular_ctrl_at_unlock_return_error() == 0) &&
                 (status == 1)) {
                 // On all platforms need to wait for a URC to
@@ -1556,11 +2619,7 @@ int32_t cellularMqttSubscribe(CellularMqttQos_t maxQos,
                 errorCodeOrQos = CELLULAR_MQTT_TIMEOUT;
                 stopTimeMs = cellularPortGetTickTimeMs() + (CELLULAR_MQTT_SERVER_RESPONSE_WAIT_SECONDS * 1000);
                 while (!gUrcStatus.updateFlag &&
-                       (cellularPortGetTickTimeMs() < stopTimeMs) &&
-                       ((gpKeepGoingCallback == NULL) ||
-                        gpKeepGoingCallback())) {
-                    cellularPortTaskBlock(1000);
-                }
+                       waitUrcEvent(stopTimeMs)) {}
                 if (gUrcStatus.subscribeSuccess) {
                     errorCodeOrQos = gUrcStatus.subscribeQoS;
                 } else {
@@ -1581,10 +2640,8 @@ int32_t cellularMqttSubscribe(CellularMqttQos_t maxQos,
 int32_t cellularMqttUnsubscribe(const char *pTopicFilterStr)
 {
     CellularMqttErrorCode_t errorCode = CELLULAR_MQTT_DEFAULT_ERROR_CODE;
-    int32_t status = 1;
-#ifndef CELLULAR_CFG_MODULE_SARA_R4
+    int32_t status;
     int64_t stopTimeMs;
-#endif
 
     if (gMutex != NULL) {
         errorCode = CELLULAR_MQTT_INVALID_PARAMETER;
@@ -1597,46 +2654,32 @@ int32_t cellularMqttUnsubscribe(const char *pTopicFilterStr)
 
             errorCode = CELLULAR_MQTT_AT_ERROR;
             cellular_ctrl_at_lock();
-            gUrcStatus.updateFlag = false;
+            clearUrcEvent();
             gUrcStatus.unsubscribeSuccess = false;
             cellular_ctrl_at_cmd_start("AT+UMQTTC=");
             // Unsubscribe from a topic
             cellular_ctrl_at_write_int(5);
             // Topic
             cellular_ctrl_at_write_string(pTopicFilterStr, true);
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
-            cellular_ctrl_at_cmd_stop();
-            cellular_ctrl_at_resp_start("+UMQTTC:", false);
-            // Skip the first parameter, which is just
-            // our UMQTTC command number again
-            cellular_ctrl_at_skip_param(1);
-            status = cellular_ctrl_at_read_int();
-            cellular_ctrl_at_resp_stop();
-#else
-            cellular_ctrl_at_cmd_stop_read_resp();
-#endif
+            status = atStopCmdReadStatus("+UMQTTC:");
             if ((cellular_ctrl_at_unlock_return_error() == 0) &&
                 (status == 1)) {
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
-                // For SARA-R4, that's it
-                errorCode = CELLULAR_MQTT_SUCCESS;
-#else
-                // Wait for a URC to say that the unsubscribe
-                // has succeeded
-                errorCode = CELLULAR_MQTT_TIMEOUT;
-                stopTimeMs = cellularPortGetTickTimeMs() + (CELLULAR_MQTT_SERVER_RESPONSE_WAIT_SECONDS * 1000);
-                while (!gUrcStatus.updateFlag &&
-                       (cellularPortGetTickTimeMs() < stopTimeMs) &&
-                       ((gpKeepGoingCallback == NULL) ||
-                        gpKeepGoingCallback())) {
-                    cellularPortTaskBlock(1000);
-                }
-                if (gUrcStatus.unsubscribeSuccess) {
+                if (saraR4Syntax()) {
+                    // For the SARA-R4 form of AT+UMQTT, that's it
                     errorCode = CELLULAR_MQTT_SUCCESS;
                 } else {
-                    printErrorCodes();
+                    // Wait for a URC to say that the unsubscribe
+                    // has succeeded
+                    errorCode = CELLULAR_MQTT_TIMEOUT;
+                    stopTimeMs = cellularPortGetTickTimeMs() + (CELLULAR_MQTT_SERVER_RESPONSE_WAIT_SECONDS * 1000);
+                    while (!gUrcStatus.updateFlag &&
+                           waitUrcEvent(stopTimeMs)) {}
+                    if (gUrcStatus.unsubscribeSuccess) {
+                        errorCode = CELLULAR_MQTT_SUCCESS;
+                    } else {
+                        printErrorCodes();
+                    }
                 }
-#endif
             } else {
                 printErrorCodes();
             }
@@ -1656,14 +2699,16 @@ int32_t cellularMqttSetMessageIndicationCallback(void (*pCallback)(int32_t, void
 
     if (gMutex != NULL) {
         // Lock the mutex as we're about
-        // to perform a non-atomic operation
-        CELLULAR_PORT_MUTEX_LOCK(gMutex);
+        // to perform a non-atomic operation;
+        // gPublishMutex since that is what
+        // messageIndicationCallback() uses
+        CELLULAR_PORT_MUTEX_LOCK(gPublishMutex);
 
         gpMessageIndicationCallback = pCallback;
         gpMessageIndicationCallbackParam = pCallbackParam;
         errorCode = CELLULAR_MQTT_SUCCESS;
 
-        CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
+        CELLULAR_PORT_MUTEX_UNLOCK(gPublishMutex);
     }
 
     return (int32_t) errorCode;
@@ -1685,169 +2730,115 @@ int32_t cellularMqttMessageRead(char *pTopicNameStr,
                                 CellularMqttQos_t *pQos)
 {
     CellularMqttErrorCode_t errorCode = CELLULAR_MQTT_DEFAULT_ERROR_CODE;
-    char *pMessageBuffer;
-    int32_t status = 1;
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
-    int64_t stopTimeMs;
-#else
-    CellularMqttQos_t qos;
-    int32_t topicNameBytesRead;
-    int32_t messageBytesAvailable;
-    int32_t messageBytesRead;
-    uint8_t quoteMark;
-#endif
 
     if (gMutex != NULL) {
         errorCode = CELLULAR_MQTT_INVALID_PARAMETER;
         if ((pTopicNameStr != NULL) &&
-            (pMessage != NULL)) {
-            // We read the message into a temporary
-            // buffer as it may be larger than
-            // the caller has room for and we
-            // have to read it all in somehow
-            errorCode = CELLULAR_MQTT_NO_MEMORY;
-            pMessageBuffer = (char *) pCellularPort_malloc(CELLULAR_MQTT_READ_MESSAGE_MAX_LENGTH_BYTES);
-            if (pMessageBuffer != NULL) {
-                // Lock the mutex as we need to
-                // be sure that the URC
-                // we get back was triggered
-                // by us and we might in some cases
-                // be going to use gUrcMessage
-                CELLULAR_PORT_MUTEX_LOCK(gMutex);
+            (pMessage != NULL) &&
+            (pMessageSizeBytes != NULL) &&
+            (*pMessageSizeBytes >= 0)) {
+            // The message is read straight into the
+            // caller's buffer; anything that won't fit
+            // is read from the AT stream and thrown away.
+            // Lock the mutex as we need to
+            // be sure that the URC
+            // we get back was triggered
+            // by us and we might in some cases
+            // be going to use gUrcMessage
+            CELLULAR_PORT_MUTEX_LOCK(gMutex);
 
-                errorCode = CELLULAR_MQTT_AT_ERROR;
+            if (saraR4Syntax()) {
+                errorCode = messageReadUrc(pTopicNameStr, topicNameSizeBytes,
+                                           pMessage, pMessageSizeBytes, pQos);
+            } else {
                 cellular_ctrl_at_lock();
-                cellular_ctrl_at_cmd_start("AT+UMQTTC=");
-                // Read a message
-                cellular_ctrl_at_write_int(6);
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
-                // For SARA-R4 we get a standard
-                // indication of success here
-                // then we need to wait for a
-                // URC to receive the message
-                gUrcMessage.messageRead = false;
-                gUrcMessage.pTopicNameStr = pTopicNameStr;
-                gUrcMessage.topicNameSizeBytes = topicNameSizeBytes;
-                gUrcMessage.pMessage = pMessageBuffer;
-                gUrcMessage.messageSizeBytes = CELLULAR_MQTT_READ_MESSAGE_MAX_LENGTH_BYTES;
-                cellular_ctrl_at_cmd_stop();
-                cellular_ctrl_at_resp_start("+UMQTTC:", false);
-                // Skip the first parameter, which is just
-                // our UMQTTC command number again
-                cellular_ctrl_at_skip_param(1);
-                status = cellular_ctrl_at_read_int();
-                cellular_ctrl_at_resp_stop();
-                if ((cellular_ctrl_at_unlock_return_error() == 0) &&
-                    (status == 1)) {
-                    // Wait for a URC containing the message
-                    errorCode = CELLULAR_MQTT_TIMEOUT;
-                    stopTimeMs = cellularPortGetTickTimeMs() + (CELLULAR_MQTT_SERVER_RESPONSE_WAIT_SECONDS * 1000);
-                    while ((!gUrcMessage.messageRead) &&
-                           (cellularPortGetTickTimeMs() < stopTimeMs) &&
-                           ((gpKeepGoingCallback == NULL) ||
-                            gpKeepGoingCallback())) {
-                        cellularPortTaskBlock(1000);
-                    }
-                    if (gUrcMessage.messageRead) {
-                        if (gUrcStatus.numUnreadMessages > 0) {
-                            gUrcStatus.numUnreadMessages--;
-                        }
-                        // pTopicNameStr was filled in directly,
-                        // now fill in the passed-in parameters
-                        // that we haven't already done
-                        if (gUrcMessage.messageSizeBytes > *pMessageSizeBytes) {
-                            gUrcMessage.messageSizeBytes = *pMessageSizeBytes;
-                        }
-                        pCellularPort_memcpy(pMessage,
-                                             pMessageBuffer,
-                                             gUrcMessage.messageSizeBytes);
-                        *pMessageSizeBytes = gUrcMessage.messageSizeBytes;
-                        if (pQos != NULL) {
-                            *pQos = gUrcMessage.qos;
-                        }
-                        errorCode = CELLULAR_MQTT_SUCCESS;
-                    }
-                } else {
+                errorCode = messageReadLocked(pTopicNameStr, topicNameSizeBytes,
+                                              pMessage, pMessageSizeBytes, pQos);
+                cellular_ctrl_at_unlock();
+                if ((errorCode != CELLULAR_MQTT_SUCCESS) &&
+                    (errorCode != CELLULAR_MQTT_MESSAGE_TRUNCATED)) {
                     printErrorCodes();
                 }
-#else
-                // We want just the one message
-                cellular_ctrl_at_write_int(1);
-                cellular_ctrl_at_cmd_stop();
-                cellular_ctrl_at_resp_start("+UMQTTC:", false);
-                // The message now arrives directly
-                // Skip the first parameter, which is just
-                // our UMQTTC command number again
-                cellular_ctrl_at_skip_param(1);
-                // Next comes the QoS
-                qos = cellular_ctrl_at_read_int();
-                // Then we can skip the length of
-                // the topic and message added together,
-                // and the length of the topic
-                // message (which is always an
-                // ASCII string so we can read it as such)
-                cellular_ctrl_at_skip_param(2);
-                // Now read the topic name string
-                topicNameBytesRead = cellular_ctrl_at_read_string(pTopicNameStr,
-                                                                  topicNameSizeBytes,
-                                                                  false);
-                // Read the number of message bytes to follow
-                messageBytesAvailable = cellular_ctrl_at_read_int();
-                if (messageBytesAvailable > CELLULAR_MQTT_READ_MESSAGE_MAX_LENGTH_BYTES) {
-                    messageBytesAvailable = CELLULAR_MQTT_READ_MESSAGE_MAX_LENGTH_BYTES;
-                }
-                // Now read the exact length of message
-                // bytes, being careful to not look for
-                // delimiters or the like as this can be
-                // a binary message
-                cellular_ctrl_at_set_delimiter(0);
-                cellular_ctrl_at_set_stop_tag(NULL);
-                // Get the leading quote mark out of the way
-                cellular_ctrl_at_read_bytes(&quoteMark, 1);
-                // Now read the actual message data
-                messageBytesRead = cellular_ctrl_at_read_bytes((uint8_t *) pMessageBuffer,
-                                                               messageBytesAvailable);
-                cellular_ctrl_at_resp_stop();
-                cellular_ctrl_at_set_default_delimiter();
-                if ((cellular_ctrl_at_unlock_return_error() == 0) &&
-                    (status == 1)) {
-                    // Now have all the bits, check them
-                    if ((topicNameBytesRead >= 0) &&
-                        (qos >= 0) &&
-                        (qos < MAX_NUM_CELLULAR_MQTT_QOS) &&
-                        (messageBytesRead >= 0)) {
-                        // Good.  pTopicNameStr was filled in
-                        // above, now fill in the other
-                        // passed-in parameters
-                        if (messageBytesRead > *pMessageSizeBytes) {
-                            messageBytesRead = *pMessageSizeBytes;
-                        }
-                        pCellularPort_memcpy(pMessage,
-                                             pMessageBuffer,
-                                             messageBytesRead);
-                        *pMessageSizeBytes = messageBytesRead;
-                        if (pQos != NULL) {
-                            *pQos = qos;
-                        }
-                        if (gUrcStatus.numUnreadMessages > 0) {
-                            gUrcStatus.numUnreadMessages--;
-                        }
-                        errorCode = CELLULAR_MQTT_SUCCESS;
-                    }
+            }
+
+            CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Read all of the unread MQTT messages, passing each to a callback.
+int32_t cellularMqttMessageDrain(char *pTopicNameStr,
+                                 int32_t topicNameSizeBytes,
+                                 char *pMessage,
+                                 int32_t messageSizeBytes,
+                                 bool (*pCallback)(const char *,
+                                                   const char *,
+                                                   int32_t,
+                                                   CellularMqttQos_t,
+                                                   bool,
+                                                   void *),
+                                 void *pCallbackParam)
+{
+    CellularMqttErrorCode_t errorCodeOrNum = CELLULAR_MQTT_DEFAULT_ERROR_CODE;
+    CellularMqttErrorCode_t errorCode = CELLULAR_MQTT_SUCCESS;
+    CellularMqttQos_t qos;
+    int32_t sizeBytes;
+    int32_t numRead = 0;
+    bool keepGoing = true;
+    bool messageInUrc = saraR4Syntax();
+
+    if (gMutex != NULL) {
+        errorCodeOrNum = CELLULAR_MQTT_INVALID_PARAMETER;
+        if ((pTopicNameStr != NULL) &&
+            (pMessage != NULL) &&
+            (messageSizeBytes >= 0) &&
+            (pCallback != NULL)) {
+
+            CELLULAR_PORT_MUTEX_LOCK(gMutex);
+
+            if (!messageInUrc) {
+                // Hold the AT interface for the lot
+                cellular_ctrl_at_lock();
+            }
+            // Carry on while there's something unread,
+            // reads are going well and the consumer
+            // wants more
+            while (keepGoing && (gUrcStatus.numUnreadMessages > 0)) {
+                sizeBytes = messageSizeBytes;
+                if (messageInUrc) {
+                    errorCode = messageReadUrc(pTopicNameStr, topicNameSizeBytes,
+                                               pMessage, &sizeBytes, &qos);
                 } else {
-                    printErrorCodes();
+                    errorCode = messageReadLocked(pTopicNameStr, topicNameSizeBytes,
+                                                  pMessage, &sizeBytes, &qos);
                 }
-#endif
-
-                CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
+                keepGoing = false;
+                if ((errorCode == CELLULAR_MQTT_SUCCESS) ||
+                    (errorCode == CELLULAR_MQTT_MESSAGE_TRUNCATED)) {
+                    numRead++;
+                    keepGoing = pCallback(pTopicNameStr, pMessage, sizeBytes, qos,
+                                          errorCode == CELLULAR_MQTT_MESSAGE_TRUNCATED,
+                                          pCallbackParam);
+                }
+            }
+            if (!messageInUrc) {
+                cellular_ctrl_at_unlock();
+            }
 
-                // Free memory
-                cellularPort_free(pMessageBuffer);
+            errorCodeOrNum = (CellularMqttErrorCode_t) numRead;
+            if ((numRead == 0) &&
+                (errorCode != CELLULAR_MQTT_SUCCESS)) {
+                errorCodeOrNum = errorCode;
+                printErrorCodes();
             }
+
+            CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
         }
     }
 
-    return (int32_t) errorCode;
+    return (int32_t) errorCodeOrNum;
 }
 
 // Get the last module-specific MQTT error code.
@@ -1860,10 +2851,8 @@ int32_t cellularMqttGetLastErrorCode()
         cellular_ctrl_at_lock();
         cellular_ctrl_at_cmd_start("AT+UMQTTER");
         cellular_ctrl_at_cmd_stop();
-        cellular_ctrl_at_resp_start("+UMQTTER:", false);
         // Skip the first error code, which is a generic thing
-        cellular_ctrl_at_skip_param(1);
-        x = cellular_ctrl_at_read_int();
+        cellular_ctrl_at_read_fields("+UMQTTER:", "-,i", &x);
         cellular_ctrl_at_resp_stop();
         if (cellular_ctrl_at_unlock_return_error() == 0) {
             errorCode = x;
@@ -1873,4 +2862,47 @@ int32_t cellularMqttGetLastErrorCode()
     return errorCode;
 }
 
+// Get the statistics of the MQTT session.
+int32_t cellularMqttGetStats(CellularMqttStats_t *pStats)
+{
+    CellularMqttErrorCode_t errorCode = CELLULAR_MQTT_DEFAULT_ERROR_CODE;
+
+    if (gMutex != NULL) {
+        errorCode = CELLULAR_MQTT_INVALID_PARAMETER;
+        if (pStats != NULL) {
+
+            CELLULAR_PORT_MUTEX_LOCK(gMutex);
+            CELLULAR_PORT_MUTEX_LOCK(gPublishMutex);
+
+            pCellularPort_memcpy(pStats, &gStatsPublish, sizeof(*pStats));
+            pStats->numMessagesRead = gStatsRead.numMessagesRead;
+            pStats->bytesRead = gStatsRead.bytesRead;
+            pStats->numAtCommands += gStatsRead.numAtCommands;
+            pStats->numErrors += gStatsRead.numErrors;
+            errorCode = CELLULAR_MQTT_SUCCESS;
+
+            CELLULAR_PORT_MUTEX_UNLOCK(gPublishMutex);
+            CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Reset the statistics of the MQTT session.
+void cellularMqttResetStats()
+{
+    if (gMutex != NULL) {
+
+        CELLULAR_PORT_MUTEX_LOCK(gMutex);
+        CELLULAR_PORT_MUTEX_LOCK(gPublishMutex);
+
+        pCellularPort_memset(&gStatsPublish, 0, sizeof(gStatsPublish));
+        pCellularPort_memset(&gStatsRead, 0, sizeof(gStatsRead));
+
+        CELLULAR_PORT_MUTEX_UNLOCK(gPublishMutex);
+        CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
+    }
+}
+
 // End of file
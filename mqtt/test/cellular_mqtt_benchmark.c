@@ -0,0 +1,409 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Only #includes of cellular_* are allowed here, no C lib,
+ * no platform stuff and no OS stuff.  Anything required from
+ * the platform/C library/OS must be brought in through
+ * cellular_port* to maintain portability.
+ */
+
+/* Benchmarks for the MQTT API: publish rate and the round
+ * trip from publishing a message to a topic we are subscribed
+ * to until it has been read back.  Like the sockets benchmarks
+ * these are only compiled in if CELLULAR_CFG_TEST_BENCHMARK is
+ * defined and have names beginning "benchmark".  Results are
+ * also logged in the machine-readable form of
+ * CELLULAR_CFG_TEST_METRIC_TAG.
+ */
+
+#ifdef CELLULAR_CFG_OVERRIDE
+# include "cellular_cfg_override.h" // For a customer's configuration override
+#endif
+#include "cellular_cfg_sw.h"
+#include "cellular_cfg_module.h"
+#include "cellular_cfg_hw_platform_specific.h"
+#include "cellular_cfg_os_platform_specific.h"
+#include "cellular_port_clib.h"
+#include "cellular_port.h"
+#include "cellular_port_debug.h"
+#include "cellular_port_os.h"
+#include "cellular_port_uart.h"
+#include "cellular_port_test_platform_specific.h"
+#include "cellular_ctrl_at.h" // For the AT stage timings
+#include "cellular_ctrl.h"
+#include "cellular_mqtt.h"
+#include "cellular_cfg_test.h"
+
+// Needs an MQTT broker, which the modem simulator of the POSIX
+// platform does not have
+#if defined(CELLULAR_CFG_TEST_BENCHMARK) && CELLULAR_MQTT_IS_SUPPORTED && \
+    (!defined(CELLULAR_PORT_TEST_SIMULATOR) || !CELLULAR_PORT_TEST_SIMULATOR)
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS
+ * -------------------------------------------------------------- */
+
+// The number of messages published at each size.
+#ifndef CELLULAR_MQTT_BENCHMARK_ITERATIONS
+# define CELLULAR_MQTT_BENCHMARK_ITERATIONS 10
+#endif
+
+// The smallest message size.
+#define CELLULAR_MQTT_BENCHMARK_MIN_MESSAGE_SIZE 16
+
+// The longest name of a machine-readable result.
+#define CELLULAR_MQTT_BENCHMARK_METRIC_NAME_MAX_LENGTH_BYTES 64
+
+/* ----------------------------------------------------------------
+ * VARIABLES
+ * -------------------------------------------------------------- */
+
+// Used for keepGoingCallback() timeout.
+static int64_t gStopTimeMs;
+
+// The UART queue handle: kept as a global variable
+// for the same reasons as in the MQTT tests.
+static CellularPortQueueHandle_t gUartQueueHandle = NULL;
+
+// A place to put the IMEI, used as client ID and topic.
+static char gImei[CELLULAR_CTRL_IMEI_SIZE + 1];
+
+// The number of unread messages, from the callback.
+static volatile int32_t gNumUnread = 0;
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// Callback function for the cellular and MQTT connection processes.
+static bool keepGoingCallback()
+{
+    bool keepGoing = true;
+
+    if (cellularPortGetTickTimeMs() > gStopTimeMs) {
+        keepGoing = false;
+    }
+
+    return keepGoing;
+}
+
+// Callback for unread message indications.
+static void messageIndicationCallback(int32_t numUnread, void *pParam)
+{
+    (void) pParam;
+
+    gNumUnread = numUnread;
+}
+
+// Return the given percentile of some values, using the
+// nearest-rank method; the values are sorted in place.
+static int32_t percentile(int32_t *pValues, int32_t numValues,
+                          int32_t percent)
+{
+    int32_t value = 0;
+    int32_t rank;
+    int32_t y;
+
+    if (numValues > 0) {
+        // Insertion sort: there are only a handful of values
+        for (int32_t x = 1; x < numValues; x++) {
+            value = *(pValues + x);
+            for (y = x; (y > 0) && (*(pValues + y - 1) > value); y--) {
+                *(pValues + y) = *(pValues + y - 1);
+            }
+            *(pValues + y) = value;
+        }
+        rank = ((numValues * percent) + 99) / 100;
+        if (rank < 1) {
+            rank = 1;
+        }
+        value = *(pValues + rank - 1);
+    }
+
+    return value;
+}
+
+// Print one machine-readable result.
+static void printMetric(const char *pName, int32_t sizeBytes,
+                        const char *pMetric, int32_t value,
+                        const char *pUnit)
+{
+    char name[CELLULAR_MQTT_BENCHMARK_METRIC_NAME_MAX_LENGTH_BYTES];
+
+    cellularPort_snprintf(name, sizeof(name), "mqtt%s.%d.%s",
+                          pName, sizeBytes, pMetric);
+    cellularPortLog(CELLULAR_CFG_TEST_METRIC_FORMAT, name, value, pUnit);
+}
+
+// Print the AT stage timings since the last reset, along
+// with the most memory in use (only available with
+// CELLULAR_CFG_PORT_MALLOC_POOL) and the task statistics,
+// the latter two also in machine-readable form under
+// pMetricName.
+static void printTiming(const char *pName, const char *pMetricName,
+                        int32_t sizeBytes)
+{
+    cellular_ctrl_at_timing_t timing;
+    cellular_ctrl_at_task_stats_t taskStats;
+    CellularPortMallocTagStats_t tagStats;
+    const char *pTaskName[] = {"URC", "call-backs"};
+    const char *pTaskMetric[] = {"urc_stack_min_free", "callback_stack_min_free"};
+    int32_t heapBytes = -1;
+
+    cellular_ctrl_at_timing_get(&timing);
+    cellularPortLog("CELLULAR_MQTT_BENCHMARK: %s %d byte(s): %d AT command(s)"
+                    " %d ms, prompt wait %d ms, UART TX %d ms, %d URC(s)"
+                    " %d ms.\n", pName, sizeBytes, timing.num_commands,
+                    (int32_t) timing.command_ms,
+                    (int32_t) timing.prompt_wait_ms,
+                    (int32_t) timing.tx_ms, timing.num_urcs,
+                    (int32_t) timing.urc_ms);
+    for (size_t x = 0; x < sizeof(pTaskName) / sizeof(pTaskName[0]); x++) {
+        if (cellular_ctrl_at_task_stats_get((cellular_ctrl_at_task_t) x,
+                                            &taskStats) == 0) {
+            cellularPortLog("CELLULAR_MQTT_BENCHMARK: %s task busy %d time(s)"
+                            " for %d ms, longest %d ms, minimum free stack"
+                            " %d byte(s).\n", pTaskName[x],
+                            taskStats.num_runs, (int32_t) taskStats.busy_ms,
+                            taskStats.max_busy_ms,
+                            taskStats.stack_min_free_bytes);
+            printMetric(pMetricName, sizeBytes, pTaskMetric[x],
+                        taskStats.stack_min_free_bytes, "B");
+        }
+    }
+    printMetric(pMetricName, sizeBytes, "commands", timing.num_commands, "count");
+    for (size_t x = 0; x < MAX_NUM_CELLULAR_PORT_MALLOC_TAGS; x++) {
+        if (cellularPortMallocGetTagStats((CellularPortMallocTag_t) x,
+                                          &tagStats) == 0) {
+            if (heapBytes < 0) {
+                heapBytes = 0;
+            }
+            heapBytes += (int32_t) tagStats.maxInUseBytes;
+        }
+    }
+    if (heapBytes >= 0) {
+        printMetric(pMetricName, sizeBytes, "heap_max", heapBytes, "B");
+    }
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS: BENCHMARKS
+ * -------------------------------------------------------------- */
+
+/** MQTT publish rate and publish-to-read round trip latency
+ * over a sweep of message sizes.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularMqttBenchmarkPublish(),
+                            "benchmarkMqttPublish",
+                            "benchmark")
+{
+    char *pTopic;
+    char *pTopicIn;
+    char *pMessageOut;
+    char *pMessageIn;
+    int32_t sizeBytes = CELLULAR_MQTT_BENCHMARK_MIN_MESSAGE_SIZE;
+    int32_t x;
+    int32_t numPublished;
+    int64_t startTimeMs;
+    int64_t elapsedMs;
+    int64_t roundTripMs;
+    int64_t publishStartTimeMs;
+    int32_t publishMs[CELLULAR_MQTT_BENCHMARK_ITERATIONS];
+
+    CELLULAR_PORT_TEST_ASSERT(cellularPortInit() == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartInit(CELLULAR_CFG_PIN_TXD,
+                                                   CELLULAR_CFG_PIN_RXD,
+                                                   CELLULAR_CFG_PIN_CTS,
+                                                   CELLULAR_CFG_PIN_RTS,
+                                                   CELLULAR_CFG_BAUD_RATE,
+                                                   CELLULAR_CFG_RTS_THRESHOLD,
+                                                   CELLULAR_CFG_UART,
+                                                   &gUartQueueHandle) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlInit(CELLULAR_CFG_PIN_ENABLE_POWER,
+                                               CELLULAR_CFG_PIN_PWR_ON,
+                                               CELLULAR_CFG_PIN_VINT,
+                                               false,
+                                               CELLULAR_CFG_UART,
+                                               gUartQueueHandle) == 0);
+
+    pTopic = (char *) pCellularPort_malloc(CELLULAR_MQTT_READ_TOPIC_MAX_LENGTH_BYTES);
+    CELLULAR_PORT_TEST_ASSERT(pTopic != NULL);
+    pTopicIn = (char *) pCellularPort_malloc(CELLULAR_MQTT_READ_TOPIC_MAX_LENGTH_BYTES);
+    CELLULAR_PORT_TEST_ASSERT(pTopicIn != NULL);
+    pMessageOut = (char *) pCellularPort_malloc(CELLULAR_MQTT_PUBLISH_MAX_LENGTH_BYTES);
+    CELLULAR_PORT_TEST_ASSERT(pMessageOut != NULL);
+    pMessageIn = (char *) pCellularPort_malloc(CELLULAR_MQTT_READ_MESSAGE_MAX_LENGTH_BYTES);
+    CELLULAR_PORT_TEST_ASSERT(pMessageIn != NULL);
+    for (x = 0; x < CELLULAR_MQTT_PUBLISH_MAX_LENGTH_BYTES; x++) {
+        *(pMessageOut + x) = (char) x;
+    }
+
+    cellularMqttDeinit();
+
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlPowerOn(NULL) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlGetImei(gImei) == 0);
+    gImei[sizeof(gImei) - 1] = 0;
+    cellularPort_snprintf(pTopic, CELLULAR_MQTT_READ_TOPIC_MAX_LENGTH_BYTES,
+                          "ubx_benchmark/%s", gImei);
+
+    // Use whatever RAT and bands the module is already set up for
+    gStopTimeMs = cellularPortGetTickTimeMs() + (CELLULAR_CFG_TEST_CONNECT_TIMEOUT_SECONDS * 1000);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlConnect(keepGoingCallback,
+                                                  CELLULAR_CFG_TEST_APN,
+                                                  CELLULAR_CFG_TEST_USERNAME,
+                                                  CELLULAR_CFG_TEST_PASSWORD) == 0);
+
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttInit(CELLULAR_CFG_TEST_MQTT_SERVER_DOMAIN_NAME,
+                                               gImei,
+                                               CELLULAR_CFG_TEST_MQTT_USERNAME,
+                                               CELLULAR_CFG_TEST_MQTT_PASSWORD,
+                                               keepGoingCallback) == 0);
+    gStopTimeMs = cellularPortGetTickTimeMs() +
+                  (CELLULAR_CFG_TEST_MQTT_SERVER_TIMEOUT_SECONDS * 1000);
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttConnect() == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttSetMessageIndicationCallback(messageIndicationCallback,
+                                                                       NULL) == 0);
+    gStopTimeMs = cellularPortGetTickTimeMs() +
+                  (CELLULAR_CFG_TEST_MQTT_SERVER_TIMEOUT_SECONDS * 1000);
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttSubscribe(CELLULAR_MQTT_AT_LEAST_ONCE, pTopic) >= 0);
+
+    while (sizeBytes > 0) {
+        // Publish rate: the messages are published to our own
+        // topic so that they can then be read back
+        numPublished = 0;
+        cellular_ctrl_at_timing_reset();
+        cellularPortMallocResetStats();
+        startTimeMs = cellularPortGetTickTimeMs();
+        for (x = 0; x < CELLULAR_MQTT_BENCHMARK_ITERATIONS; x++) {
+            publishStartTimeMs = cellularPortGetTickTimeMs();
+            gStopTimeMs = publishStartTimeMs +
+                          (CELLULAR_CFG_TEST_MQTT_SERVER_TIMEOUT_SECONDS * 1000);
+            if (cellularMqttPublish(CELLULAR_MQTT_AT_LEAST_ONCE, false, pTopic,
+                                    pMessageOut, sizeBytes) == 0) {
+                publishMs[numPublished] = (int32_t) (cellularPortGetTickTimeMs() -
+                                                     publishStartTimeMs);
+                numPublished++;
+            }
+        }
+        elapsedMs = cellularPortGetTickTimeMs() - startTimeMs;
+        cellularPortLog("CELLULAR_MQTT_BENCHMARK: publish %d byte(s) x %d: %d ms,"
+                        " %d ms per publish.\n", sizeBytes, numPublished,
+                        (int32_t) elapsedMs,
+                        numPublished > 0 ? (int32_t) (elapsedMs / numPublished) : -1);
+        if (elapsedMs > 0) {
+            printMetric("Publish", sizeBytes, "throughput",
+                        (int32_t) ((((int64_t) sizeBytes) * numPublished * 1000) / elapsedMs),
+                        "B/s");
+        }
+        if (numPublished > 0) {
+            printMetric("Publish", sizeBytes, "latency_p50",
+                        percentile(publishMs, numPublished, 50), "ms");
+            printMetric("Publish", sizeBytes, "latency_p90",
+                        percentile(publishMs, numPublished, 90), "ms");
+            printMetric("Publish", sizeBytes, "latency_max",
+                        percentile(publishMs, numPublished, 100), "ms");
+        }
+        printTiming("publish", "Publish", sizeBytes);
+        CELLULAR_PORT_TEST_ASSERT(numPublished == CELLULAR_MQTT_BENCHMARK_ITERATIONS);
+
+        // Read everything back, which empties the
+        // queue ready for the round trip
+        startTimeMs = cellularPortGetTickTimeMs();
+        while ((gNumUnread < numPublished) &&
+               (cellularPortGetTickTimeMs() - startTimeMs <
+                (CELLULAR_CFG_TEST_MQTT_SERVER_TIMEOUT_SECONDS * 1000))) {
+            cellularPortTaskBlock(100);
+        }
+        cellular_ctrl_at_timing_reset();
+        cellularPortMallocResetStats();
+        startTimeMs = cellularPortGetTickTimeMs();
+        for (x = 0; cellularMqttGetUnread() > 0; x++) {
+            int32_t y = CELLULAR_MQTT_READ_MESSAGE_MAX_LENGTH_BYTES;
+            CELLULAR_PORT_TEST_ASSERT(cellularMqttMessageRead(pTopicIn,
+                                                              CELLULAR_MQTT_READ_TOPIC_MAX_LENGTH_BYTES,
+                                                              pMessageIn, &y,
+                                                              NULL) == 0);
+            CELLULAR_PORT_TEST_ASSERT(y == sizeBytes);
+        }
+        elapsedMs = cellularPortGetTickTimeMs() - startTimeMs;
+        cellularPortLog("CELLULAR_MQTT_BENCHMARK: read %d byte(s) x %d: %d ms.\n",
+                        sizeBytes, x, (int32_t) elapsedMs);
+        if (x > 0) {
+            printMetric("Read", sizeBytes, "latency_mean",
+                        (int32_t) (elapsedMs / x), "ms");
+        }
+        printTiming("read", "Read", sizeBytes);
+
+        // Round trip: a single message out and back
+        gNumUnread = 0;
+        cellular_ctrl_at_timing_reset();
+        cellularPortMallocResetStats();
+        startTimeMs = cellularPortGetTickTimeMs();
+        gStopTimeMs = startTimeMs + (CELLULAR_CFG_TEST_MQTT_SERVER_TIMEOUT_SECONDS * 1000);
+        CELLULAR_PORT_TEST_ASSERT(cellularMqttPublish(CELLULAR_MQTT_AT_LEAST_ONCE, false,
+                                                      pTopic, pMessageOut,
+                                                      sizeBytes) == 0);
+        while ((gNumUnread == 0) &&
+               (cellularPortGetTickTimeMs() < gStopTimeMs)) {
+            cellularPortTaskBlock(10);
+        }
+        x = CELLULAR_MQTT_READ_MESSAGE_MAX_LENGTH_BYTES;
+        CELLULAR_PORT_TEST_ASSERT(cellularMqttMessageRead(pTopicIn,
+                                                          CELLULAR_MQTT_READ_TOPIC_MAX_LENGTH_BYTES,
+                                                          pMessageIn, &x,
+                                                          NULL) == 0);
+        roundTripMs = cellularPortGetTickTimeMs() - startTimeMs;
+        CELLULAR_PORT_TEST_ASSERT(x == sizeBytes);
+        CELLULAR_PORT_TEST_ASSERT(cellularPort_memcmp(pMessageIn, pMessageOut, x) == 0);
+        cellularPortLog("CELLULAR_MQTT_BENCHMARK: round trip %d byte(s): %d ms.\n",
+                        sizeBytes, (int32_t) roundTripMs);
+        printMetric("RoundTrip", sizeBytes, "latency", (int32_t) roundTripMs, "ms");
+        printTiming("round trip", "RoundTrip", sizeBytes);
+
+        // Double up to the maximum, finishing with the maximum
+        if (sizeBytes == CELLULAR_MQTT_PUBLISH_MAX_LENGTH_BYTES) {
+            sizeBytes = 0;
+        } else {
+            sizeBytes *= 2;
+            if (sizeBytes > CELLULAR_MQTT_PUBLISH_MAX_LENGTH_BYTES) {
+                sizeBytes = CELLULAR_MQTT_PUBLISH_MAX_LENGTH_BYTES;
+            }
+        }
+    }
+
+    gStopTimeMs = cellularPortGetTickTimeMs() +
+                  (CELLULAR_CFG_TEST_MQTT_SERVER_TIMEOUT_SECONDS * 1000);
+    cellularMqttUnsubscribe(pTopic);
+    cellularMqttSetMessageIndicationCallback(NULL, NULL);
+    cellularMqttDisconnect();
+    cellularMqttDeinit();
+
+    cellularCtrlDisconnect();
+    cellularCtrlPowerOff(NULL);
+
+    cellularPort_free(pMessageIn);
+    cellularPort_free(pMessageOut);
+    cellularPort_free(pTopicIn);
+    cellularPort_free(pTopic);
+
+    cellularCtrlDeinit();
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartDeinit(CELLULAR_CFG_UART) == 0);
+    cellularPortDeinit();
+}
+
+#endif // defined(CELLULAR_CFG_TEST_BENCHMARK) && CELLULAR_MQTT_IS_SUPPORTED && !CELLULAR_PORT_TEST_SIMULATOR
+
+// End of file
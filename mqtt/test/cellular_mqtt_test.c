@@ -36,7 +36,10 @@
 #include "cellular_mqtt.h"
 #include "cellular_cfg_test.h"
 
-#if CELLULAR_MQTT_IS_SUPPORTED
+// Needs an MQTT broker, which the modem simulator of the POSIX
+// platform does not have
+#if CELLULAR_MQTT_IS_SUPPORTED && \
+    (!defined(CELLULAR_PORT_TEST_SIMULATOR) || !CELLULAR_PORT_TEST_SIMULATOR)
 
 /* ----------------------------------------------------------------
  * COMPILE-TIME MACROS
@@ -59,6 +62,10 @@
 // Used for keepGoingCallback() timeout.
 static int64_t gStopTimeMs;
 
+// Storage for topics to register, enough to fill the
+// table; they have to stay put as they are not copied.
+static char gTopics[CELLULAR_CFG_MQTT_MAX_NUM_TOPICS][8];
+
 // The UART queue handle: kept as a global variable
 // because if a test fails init will have run but
 // deinit will have been skipped.  With this as a global,
@@ -78,6 +85,22 @@ static uint64_t gOriginalMask2;
 // A place to put the IMEI which is used by various of the tests.
 static char gImei[CELLULAR_CTRL_IMEI_SIZE + 1];
 
+// The number of times publishCallback() has been called.
+static volatile int32_t gNumPublishCallbacks;
+
+// The number of times publishCallback() has been called
+// with success.
+static volatile int32_t gNumPublishSuccesses;
+
+// The number of the next message drainCallback() expects.
+static int32_t gDrainNext;
+
+// The number of the last message drainCallback() should accept.
+static int32_t gDrainLast;
+
+// Set if drainCallback() is given something it didn't expect.
+static bool gDrainBad;
+
 // A string of all possible characters, including strings
 // that might appear as terminators in the AT interface
 static const char gAllChars[] = "the quick brown fox jumps over the lazy dog "
@@ -188,6 +211,46 @@ static void messageIndicationCallback(int32_t numUnread, void *pParam)
     *pNumUnread = numUnread;
 }
 
+// Callback for the outcome of cellularMqttPublishAsync().
+static void publishCallback(int32_t errorCode, void *pParam)
+{
+    (void) pParam;
+
+    if (errorCode == 0) {
+        gNumPublishSuccesses++;
+    } else {
+        cellularPortLog("publishCallback() called with error %d.\n",
+                        errorCode);
+    }
+    gNumPublishCallbacks++;
+}
+
+// Callback for cellularMqttMessageDrain(); checks each message
+// and asks for no more after gDrainLast.  Problems are flagged
+// in gDrainBad, rather than asserted, as the AT interface may
+// be locked.
+static bool drainCallback(const char *pTopicNameStr,
+                          const char *pMessage,
+                          int32_t messageSizeBytes,
+                          CellularMqttQos_t qos,
+                          bool truncated,
+                          void *pParam)
+{
+    char buffer[16];
+    const char *pTopicOut = (const char *) pParam;
+
+    cellularPort_snprintf(buffer, sizeof(buffer), "async %d", (int) gDrainNext);
+    if ((cellularPort_strcmp(pTopicNameStr, pTopicOut) != 0) ||
+        (messageSizeBytes != (int32_t) cellularPort_strlen(buffer)) ||
+        (cellularPort_memcmp(pMessage, buffer, messageSizeBytes) != 0) ||
+        (qos < 0) || (qos >= MAX_NUM_CELLULAR_MQTT_QOS) || truncated) {
+        gDrainBad = true;
+    }
+    gDrainNext++;
+
+    return gDrainNext <= gDrainLast;
+}
+
 /* ----------------------------------------------------------------
  * PUBLIC FUNCTIONS: TESTS
  * -------------------------------------------------------------- */
@@ -199,6 +262,7 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularMqttTestInitialisation(),
                             "mqtt")
 {
     char buffer[32];
+    int32_t x;
 
     CELLULAR_PORT_TEST_ASSERT(cellularPortInit() == 0);
     CELLULAR_PORT_TEST_ASSERT(cellularPortUartInit(CELLULAR_CFG_PIN_TXD,
@@ -230,6 +294,26 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularMqttTestInitialisation(),
     cellularPortLog("CELLULAR_MQTT_TEST: getting local MQTT client ID...\n");
     CELLULAR_PORT_TEST_ASSERT(cellularMqttGetClientId(buffer, sizeof(buffer)) == 0);
 
+    // Fill the topic table, checking that a topic
+    // registered twice gets the same handle
+    cellularPortLog("CELLULAR_MQTT_TEST: registering topics...\n");
+    for (x = 0; x < CELLULAR_CFG_MQTT_MAX_NUM_TOPICS; x++) {
+        cellularPort_snprintf(gTopics[x], sizeof(gTopics[x]), "t%d", (int) x);
+        CELLULAR_PORT_TEST_ASSERT(cellularMqttTopicRegister(gTopics[x]) == x);
+    }
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttTopicRegister(gTopics[0]) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttTopicRegister("full") == CELLULAR_MQTT_NO_MEMORY);
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_strcmp(pCellularMqttTopicGet(1), gTopics[1]) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttPublishTopic(CELLULAR_MQTT_AT_MOST_ONCE,
+                                                       false,
+                                                       CELLULAR_CFG_MQTT_MAX_NUM_TOPICS,
+                                                       "x", 1) == CELLULAR_MQTT_INVALID_PARAMETER);
+    // Free one up and use it again
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttTopicDeregister(1) == 0);
+    CELLULAR_PORT_TEST_ASSERT(pCellularMqttTopicGet(1) == NULL);
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttTopicDeregister(1) == CELLULAR_MQTT_INVALID_PARAMETER);
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttTopicRegister("full") == 1);
+
     cellularCtrlPowerOff(NULL);
     cellularMqttDeinit();
 
@@ -362,6 +446,7 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularMqttTestSubscribePublish(),
     char *pMessageOut;
     char *pMessageIn;
     CellularMqttQos_t qos;
+    CellularMqttStats_t stats;
 
     CELLULAR_PORT_TEST_ASSERT(cellularPortInit() == 0);
     CELLULAR_PORT_TEST_ASSERT(cellularPortUartInit(CELLULAR_CFG_PIN_TXD,
@@ -599,6 +684,133 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularMqttTestSubscribePublish(),
 
     CELLULAR_PORT_TEST_ASSERT(cellularMqttGetUnread() == 0);
 
+    cellularPortLog("CELLULAR_MQTT_TEST: publishing %d messages to topic \"%s\""
+                    " without waiting...\n",
+                    CELLULAR_CFG_MQTT_PUBLISH_QUEUE_LENGTH, pTopicOut);
+    gNumPublishCallbacks = 0;
+    gNumPublishSuccesses = 0;
+    numUnread = 0;
+    startTimeMs = cellularPortGetTickTimeMs();
+    for (x = 0; x < CELLULAR_CFG_MQTT_PUBLISH_QUEUE_LENGTH; x++) {
+        cellularPort_snprintf(buffer, sizeof(buffer), "async %d", (int) x);
+        CELLULAR_PORT_TEST_ASSERT(cellularMqttPublishAsync(CELLULAR_MQTT_AT_LEAST_ONCE,
+                                                           false, pTopicOut,
+                                                           buffer,
+                                                           cellularPort_strlen(buffer),
+                                                           publishCallback,
+                                                           NULL) == 0);
+    }
+    // Nothing should be left behind once all the
+    // callbacks have been called
+    while ((gNumPublishCallbacks < CELLULAR_CFG_MQTT_PUBLISH_QUEUE_LENGTH) &&
+           (cellularPortGetTickTimeMs() < startTimeMs +
+                                         (CELLULAR_CFG_TEST_MQTT_SERVER_TIMEOUT_SECONDS * 1000))) {
+        cellularPortTaskBlock(100);
+    }
+    cellularPortLog("CELLULAR_MQTT_TEST: %d publish(es) successful after %d ms.\n",
+                    gNumPublishSuccesses,
+                    (int32_t) (cellularPortGetTickTimeMs() - startTimeMs));
+    CELLULAR_PORT_TEST_ASSERT(gNumPublishCallbacks == CELLULAR_CFG_MQTT_PUBLISH_QUEUE_LENGTH);
+    CELLULAR_PORT_TEST_ASSERT(gNumPublishSuccesses == CELLULAR_CFG_MQTT_PUBLISH_QUEUE_LENGTH);
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttGetNumPublishPending() == 0);
+
+    // Read them all back, they should arrive in order:
+    // the first on its own, the middle ones by draining,
+    // stopping early, and the last one into a buffer too
+    // small for it
+    startTimeMs = cellularPortGetTickTimeMs();
+    while ((cellularMqttGetUnread() < CELLULAR_CFG_MQTT_PUBLISH_QUEUE_LENGTH) &&
+           (cellularPortGetTickTimeMs() < startTimeMs +
+                                         (CELLULAR_CFG_TEST_MQTT_SERVER_TIMEOUT_SECONDS * 1000))) {
+        cellularPortTaskBlock(1000);
+    }
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttGetUnread() == CELLULAR_CFG_MQTT_PUBLISH_QUEUE_LENGTH);
+    y = CELLULAR_MQTT_READ_MESSAGE_MAX_LENGTH_BYTES;
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttMessageRead(pTopicIn,
+                                                      CELLULAR_MQTT_READ_TOPIC_MAX_LENGTH_BYTES,
+                                                      pMessageIn, &y,
+                                                      NULL) == 0);
+    CELLULAR_PORT_TEST_ASSERT(y == (int32_t) cellularPort_strlen("async 0"));
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_memcmp(pMessageIn, "async 0", y) == 0);
+    gDrainNext = 1;
+    gDrainLast = CELLULAR_CFG_MQTT_PUBLISH_QUEUE_LENGTH - 2;
+    gDrainBad = false;
+    y = cellularMqttMessageDrain(pTopicIn, CELLULAR_MQTT_READ_TOPIC_MAX_LENGTH_BYTES,
+                                 pMessageIn, CELLULAR_MQTT_READ_MESSAGE_MAX_LENGTH_BYTES,
+                                 drainCallback, pTopicOut);
+    cellularPortLog("CELLULAR_MQTT_TEST: drained %d message(s).\n", y);
+    CELLULAR_PORT_TEST_ASSERT(y == CELLULAR_CFG_MQTT_PUBLISH_QUEUE_LENGTH - 2);
+    CELLULAR_PORT_TEST_ASSERT(!gDrainBad);
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttGetUnread() == 1);
+    y = 5;
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttMessageRead(pTopicIn,
+                                                      CELLULAR_MQTT_READ_TOPIC_MAX_LENGTH_BYTES,
+                                                      pMessageIn, &y,
+                                                      NULL) == CELLULAR_MQTT_MESSAGE_TRUNCATED);
+    CELLULAR_PORT_TEST_ASSERT(y == 5);
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_memcmp(pMessageIn, "async", y) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_strcmp(pTopicIn, pTopicOut) == 0);
+
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttGetUnread() == 0);
+
+#if CELLULAR_MQTT_PUBLISH_ANY_MAX_LENGTH_BYTES > CELLULAR_MQTT_PUBLISH_MAX_LENGTH_BYTES
+    // Publish a message too long to go in a single AT command,
+    // which should go via a file on the module without us
+    // having to know; small enough to read back in one go
+    z = CELLULAR_MQTT_PUBLISH_MAX_LENGTH_BYTES * 2;
+    if (z > CELLULAR_MQTT_READ_MESSAGE_MAX_LENGTH_BYTES) {
+        z = CELLULAR_MQTT_READ_MESSAGE_MAX_LENGTH_BYTES;
+    }
+    cellularPortLog("CELLULAR_MQTT_TEST: publishing %d byte(s), more than the"
+                    " %d byte(s) of a single publish...\n", z,
+                    CELLULAR_MQTT_PUBLISH_MAX_LENGTH_BYTES);
+    cellularPort_free(pMessageOut);
+    pMessageOut = (char *) pCellularPort_malloc(z);
+    CELLULAR_PORT_TEST_ASSERT(pMessageOut != NULL);
+    for (x = 0; x < z; x++) {
+        *(pMessageOut + x) = gAllChars[x % sizeof(gAllChars)];
+    }
+    numUnread = 0;
+    gStopTimeMs = cellularPortGetTickTimeMs() +
+                  (CELLULAR_CFG_TEST_MQTT_SERVER_TIMEOUT_SECONDS * 1000);
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttPublish(CELLULAR_MQTT_AT_LEAST_ONCE, false,
+                                                  pTopicOut, pMessageOut, z) == 0);
+    startTimeMs = cellularPortGetTickTimeMs();
+    while ((cellularMqttGetUnread() == 0) &&
+           (cellularPortGetTickTimeMs() < startTimeMs +
+                                         (CELLULAR_CFG_TEST_MQTT_SERVER_TIMEOUT_SECONDS * 1000))) {
+        cellularPortTaskBlock(1000);
+    }
+    y = CELLULAR_MQTT_READ_MESSAGE_MAX_LENGTH_BYTES;
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttMessageRead(pTopicIn,
+                                                      CELLULAR_MQTT_READ_TOPIC_MAX_LENGTH_BYTES,
+                                                      pMessageIn, &y,
+                                                      NULL) == 0);
+    CELLULAR_PORT_TEST_ASSERT(y == z);
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_memcmp(pMessageIn, pMessageOut, y) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttGetUnread() == 0);
+#endif
+
+    // Where did it all go?
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttGetStats(NULL) < 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttGetStats(&stats) == 0);
+    cellularPortLog("CELLULAR_MQTT_TEST: %d publish(es) of %d byte(s), %d"
+                    " acknowledged, taking %d ms at most, %d message(s)"
+                    " of %d byte(s) read, %d AT command(s), %d error(s).\n",
+                    stats.numPublishes, stats.bytesPublished,
+                    stats.numPublishAcks, stats.publishToAckMaxMs,
+                    stats.numMessagesRead, stats.bytesRead,
+                    stats.numAtCommands, stats.numErrors);
+    CELLULAR_PORT_TEST_ASSERT(stats.numPublishes >= (uint32_t) numPublished);
+    CELLULAR_PORT_TEST_ASSERT(stats.numPublishAcks >= (uint32_t) numPublished);
+    CELLULAR_PORT_TEST_ASSERT(stats.numMessagesRead > 0);
+    CELLULAR_PORT_TEST_ASSERT(stats.numAtCommands >= stats.numPublishes +
+                                                     stats.numMessagesRead);
+    cellularMqttResetStats();
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttGetStats(&stats) == 0);
+    CELLULAR_PORT_TEST_ASSERT((stats.numPublishes == 0) &&
+                              (stats.numMessagesRead == 0));
+
     // Cancel the subscribe
     cellularPortLog("CELLULAR_MQTT_TEST: unsubscribing from topic \"%s\"...\n",
                     pTopicOut);
@@ -1115,6 +1327,6 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularMqttTestCleanUp(),
     cellularPortDeinit();
 }
 
-#endif // CELLULAR_MQTT_IS_SUPPORTED
+#endif // CELLULAR_MQTT_IS_SUPPORTED && !CELLULAR_PORT_TEST_SIMULATOR
 
 // End of file
@@ -0,0 +1,373 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _CELLULAR_MQTT_SN_H_
+#define _CELLULAR_MQTT_SN_H_
+
+/* No #includes allowed here */
+
+/* This header file defines the cellular MQTT-SN client API, which
+ * uses the MQTT-SN client inside the module (AT+UMQTTSN/AT+UMQTTSNC).
+ * MQTT-SN runs over UDP to an MQTT-SN gateway and, in place of topic
+ * strings, publishes carry a two byte topic ID, either registered
+ * with the gateway once per connection or pre-defined, or a two
+ * character short topic name; a publish of QoS -1 needs no
+ * connection at all.  On an NB1 link this costs several times fewer
+ * bytes per message than MQTT over TCP.  The API follows that of
+ * cellular_mqtt.h and is thread-safe with the proviso that there is
+ * only one MQTT-SN client instance underneath.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS
+ * -------------------------------------------------------------- */
+
+/** The default MQTT-SN gateway port.
+ */
+#define CELLULAR_MQTT_SN_SERVER_PORT 2442
+
+/** The maximum length of an MQTT-SN gateway address string.
+ */
+#ifndef CELLULAR_MQTT_SN_SERVER_ADDRESS_STRING_MAX_LENGTH_BYTES
+# define CELLULAR_MQTT_SN_SERVER_ADDRESS_STRING_MAX_LENGTH_BYTES 256
+#endif
+
+/** Whether the module has an MQTT-SN client.
+ */
+#ifndef CELLULAR_MQTT_SN_IS_SUPPORTED
+# error CELLULAR_MQTT_SN_IS_SUPPORTED must be defined in cellular_cfg_module.h.
+#endif
+
+/** The time to wait for an MQTT-SN gateway-related operation
+ * to be completed.
+ */
+#ifndef CELLULAR_MQTT_SN_SERVER_RESPONSE_WAIT_SECONDS
+# error CELLULAR_MQTT_SN_SERVER_RESPONSE_WAIT_SECONDS must be defined in cellular_cfg_module.h.
+#endif
+
+/** The maximum length of an MQTT-SN publish message in bytes.
+ */
+#ifndef CELLULAR_MQTT_SN_PUBLISH_MAX_LENGTH_BYTES
+# error CELLULAR_MQTT_SN_PUBLISH_MAX_LENGTH_BYTES must be defined in cellular_cfg_module.h.
+#endif
+
+/* ----------------------------------------------------------------
+ * TYPES
+ * -------------------------------------------------------------- */
+
+/** Error codes.
+ */
+typedef enum {
+    CELLULAR_MQTT_SN_SUCCESS = 0,
+    CELLULAR_MQTT_SN_UNKNOWN_ERROR = -1,
+    CELLULAR_MQTT_SN_NOT_INITIALISED = -2,
+    CELLULAR_MQTT_SN_NOT_IMPLEMENTED = -3,
+    CELLULAR_MQTT_SN_NOT_RESPONDING = -4,
+    CELLULAR_MQTT_SN_INVALID_PARAMETER = -5,
+    CELLULAR_MQTT_SN_NO_MEMORY = -6,
+    CELLULAR_MQTT_SN_PLATFORM_ERROR = -7,
+    CELLULAR_MQTT_SN_AT_ERROR = -8,
+    CELLULAR_MQTT_SN_NOT_SUPPORTED = -9,
+    CELLULAR_MQTT_SN_TIMEOUT = -10,
+    CELLULAR_MQTT_SN_BAD_ADDRESS = -11,
+    CELLULAR_MQTT_SN_MESSAGE_TRUNCATED = -12,
+    CELLULAR_MQTT_SN_NOT_CONNECTED = -13,
+    CELLULAR_MQTT_SN_FORCE_32_BIT = 0x7FFFFFFF // Force this enum to be 32 bit
+                                               // as it can be used as a size
+                                               // also
+} CellularMqttSnErrorCode_t;
+
+/** MQTT-SN QoS; the values are those used by the module.
+ */
+typedef enum {
+    CELLULAR_MQTT_SN_AT_MOST_ONCE = 0,
+    CELLULAR_MQTT_SN_AT_LEAST_ONCE = 1,
+    CELLULAR_MQTT_SN_EXACTLY_ONCE = 2,
+    CELLULAR_MQTT_SN_SEND_AND_FORGET = 3, //!< QoS -1: publish only, to a
+                                          // pre-defined or short topic,
+                                          // no connection required.
+    MAX_NUM_CELLULAR_MQTT_SN_QOS
+} CellularMqttSnQos_t;
+
+/** The types of MQTT-SN topic; the values are those used by
+ * the module.
+ */
+typedef enum {
+    CELLULAR_MQTT_SN_TOPIC_NORMAL = 0,     //!< an ID given by the gateway
+                                           // for a topic name, see
+                                           // cellularMqttSnRegister().
+    CELLULAR_MQTT_SN_TOPIC_PREDEFINED = 1, //!< an ID agreed beforehand
+                                           // with the gateway.
+    CELLULAR_MQTT_SN_TOPIC_SHORT = 2,      //!< a two character topic name.
+    MAX_NUM_CELLULAR_MQTT_SN_TOPIC_TYPES
+} CellularMqttSnTopicType_t;
+
+/** An MQTT-SN topic.  For a pre-defined topic or a short topic
+ * name the application may fill this in itself; a normal topic
+ * is filled in by cellularMqttSnRegister() or
+ * cellularMqttSnSubscribe().
+ */
+typedef struct {
+    CellularMqttSnTopicType_t type;
+    uint16_t id;       //!< the topic ID, for a normal or a
+                       // pre-defined topic.
+    char shortName[3]; //!< the NULL terminated name, for a
+                       // short topic.
+} CellularMqttSnTopic_t;
+
+/* ----------------------------------------------------------------
+ * FUNCTIONS
+ * -------------------------------------------------------------- */
+
+/** Initialise the MQTT-SN client.  If the client is already
+ * initialised then this function returns immediately.  The cellular
+ * module must be powered up for this function to work.
+ * IMPORTANT: if you re-boot the cellular module after calling this
+ * function you will lose all settings and must call
+ * cellularMqttSnDeinit() followed by cellularMqttSnInit() to put
+ * them back again.
+ *
+ * @param pServerNameStr     the NULL terminated string that gives
+ *                           the MQTT-SN gateway, a domain name or
+ *                           an IP address, with an optional port
+ *                           number (default
+ *                           CELLULAR_MQTT_SN_SERVER_PORT).
+ * @param pClientIdStr       the NULL terminated client ID for this
+ *                           MQTT-SN session.  May be NULL, in which
+ *                           case the module provides one.
+ * @param pKeepGoingCallback called while waiting for the gateway,
+ *                           exactly as for cellularMqttInit();
+ *                           may be NULL.
+ * @return                   zero on success or negative error code on
+ *                           failure.
+ */
+int32_t cellularMqttSnInit(const char *pServerNameStr,
+                           const char *pClientIdStr,
+                           bool (*pKeepGoingCallback)(void));
+
+/** Shut-down the MQTT-SN client.
+ */
+void cellularMqttSnDeinit();
+
+/** Set the keep-alive time of the MQTT-SN session, which
+ * applies from the next cellularMqttSnConnect(); if this is
+ * not called the module's default is used.
+ * IMPORTANT: a re-boot of the cellular module will lose your
+ * setting.
+ *
+ * @param seconds  the keep-alive time in seconds.
+ * @return         zero on success or negative error code.
+ */
+int32_t cellularMqttSnSetKeepAlive(int32_t seconds);
+
+/** Start an MQTT-SN session, or wake up a sleeping one.  The
+ * pKeepGoingCallback() function set during initialisation will
+ * be called while this function is waiting for the gateway.
+ *
+ * @return zero on success or negative error code.
+ */
+int32_t cellularMqttSnConnect();
+
+/** Stop an MQTT-SN session; a sleeping session is also stopped.
+ *
+ * @return zero on success or negative error code.
+ */
+int32_t cellularMqttSnDisconnect();
+
+/** Determine whether an MQTT-SN session is active or not; a
+ * sleeping session counts as active.
+ *
+ * @return true if an MQTT-SN session is active else false.
+ */
+bool cellularMqttSnIsConnected();
+
+/** Put an MQTT-SN session to sleep: the gateway keeps the
+ * session and holds on to messages for subscribed topics while
+ * the client is asleep so that the module, and the radio, can
+ * be quiet; messages held by the gateway are collected with
+ * cellularMqttSnWake().  If the client has not been in touch
+ * with the gateway within seconds the gateway ends the session.
+ * cellularMqttSnConnect() ends the sleep.
+ *
+ * @param seconds  how long the client may sleep for, in seconds.
+ * @return         zero on success or negative error code.
+ */
+int32_t cellularMqttSnSleep(int32_t seconds);
+
+/** Determine whether the MQTT-SN session is asleep.
+ *
+ * @return true if the session is asleep, else false.
+ */
+bool cellularMqttSnIsAsleep();
+
+/** Wake a sleeping MQTT-SN session briefly to collect the
+ * messages that the gateway is holding, which then arrive as
+ * for an awake session (see
+ * cellularMqttSnSetMessageIndicationCallback()), after which
+ * the session is asleep again and the gateway's sleep timer
+ * has restarted.
+ *
+ * @return zero on success or negative error code.
+ */
+int32_t cellularMqttSnWake();
+
+/** Register a topic name with the gateway, giving back the ID to
+ * publish to; this costs one exchange with the gateway, after
+ * which each publish to the topic carries only two bytes of
+ * topic.  The registration lasts for the MQTT-SN session, i.e.
+ * it has to be done again after cellularMqttSnConnect().
+ *
+ * @param pTopicNameStr the NULL terminated topic name, which
+ *                      may not contain wildcards; cannot be
+ *                      NULL.
+ * @param pTopic        a place to put the topic; cannot be NULL.
+ * @return              zero on success else negative error code.
+ */
+int32_t cellularMqttSnRegister(const char *pTopicNameStr,
+                               CellularMqttSnTopic_t *pTopic);
+
+/** Publish an MQTT-SN message.  For QoS 1 and 2 the
+ * pKeepGoingCallback() function set during initialisation will
+ * be called while this function waits for the gateway; for QoS
+ * 0 and QoS -1 the message is gone once the module has it.
+ *
+ * @param qos              the MQTT-SN QoS to use for this message;
+ *                         CELLULAR_MQTT_SN_SEND_AND_FORGET may only
+ *                         be used with a pre-defined topic or a
+ *                         short topic name.
+ * @param retain           if true the message will be retained
+ *                         by the server.
+ * @param pTopic           the topic; cannot be NULL.
+ * @param pMessage         a pointer to the message, which is not
+ *                         restricted to ASCII values; cannot be
+ *                         NULL.
+ * @param messageSizeBytes the length of pMessage, up to
+ *                         CELLULAR_MQTT_SN_PUBLISH_MAX_LENGTH_BYTES.
+ * @return                 zero on success else negative error
+ *                         code.
+ */
+int32_t cellularMqttSnPublish(CellularMqttSnQos_t qos,
+                              bool retain,
+                              const CellularMqttSnTopic_t *pTopic,
+                              const char *pMessage,
+                              int32_t messageSizeBytes);
+
+/** Subscribe to an MQTT-SN topic.  The pKeepGoingCallback()
+ * function set during initialisation will be called while this
+ * function is waiting for the subscription to complete.
+ *
+ * @param maxQos           the maximum QoS of the messages for
+ *                         this subscription; cannot be
+ *                         CELLULAR_MQTT_SN_SEND_AND_FORGET.
+ * @param pTopicFilterStr  the NULL terminated topic name, which
+ *                         may contain the wildcards of
+ *                         cellularMqttSubscribe(); if NULL then
+ *                         pTopic, which must be a pre-defined topic
+ *                         or a short topic name, is subscribed to
+ *                         instead.
+ * @param pTopic           if pTopicFilterStr is not NULL, a place
+ *                         to put the topic that messages on this
+ *                         subscription will arrive with, which
+ *                         is meaningless where pTopicFilterStr
+ *                         contains wildcards; may be NULL.
+ * @return                 on success the QoS of the subscription,
+ *                         else negative error code.
+ */
+int32_t cellularMqttSnSubscribe(CellularMqttSnQos_t maxQos,
+                                const char *pTopicFilterStr,
+                                CellularMqttSnTopic_t *pTopic);
+
+/** Unsubscribe from an MQTT-SN topic.
+ *
+ * @param pTopicFilterStr  the NULL terminated topic name as
+ *                         given to cellularMqttSnSubscribe(); if
+ *                         NULL then pTopic is unsubscribed from
+ *                         instead.
+ * @param pTopic           the pre-defined or short topic to
+ *                         unsubscribe from if pTopicFilterStr
+ *                         is NULL.
+ * @return                 zero on success else negative error
+ *                         code.
+ */
+int32_t cellularMqttSnUnsubscribe(const char *pTopicFilterStr,
+                                  const CellularMqttSnTopic_t *pTopic);
+
+/** Set a callback to be called when new messages are
+ * available to be read.
+ *
+ * @param pCallback       the callback, exactly as for
+ *                        cellularMqttSetMessageIndicationCallback();
+ *                        use NULL to deregister a previous
+ *                        callback.
+ * @param pCallbackParam  this value will be passed to pCallback
+ *                        as the second parameter.
+ * @return                zero on success else negative error
+ *                        code.
+ */
+int32_t cellularMqttSnSetMessageIndicationCallback(void (*pCallback)(int32_t, void *),
+                                                   void *pCallbackParam);
+
+/** Get the current number of unread messages.
+ *
+ * @return the number of unread messages or negative error code.
+ */
+int32_t cellularMqttSnGetUnread();
+
+/** Read an MQTT-SN message.  The message is read straight into
+ * the buffer given; if it will not fit, as much as will fit is
+ * written, the rest is thrown away and
+ * CELLULAR_MQTT_SN_MESSAGE_TRUNCATED is returned, the other
+ * outputs being valid.
+ *
+ * @param pTopic              a place to put the topic of the
+ *                            message; cannot be NULL.
+ * @param pMessage            a place to put the message; cannot
+ *                            be NULL.
+ * @param pMessageSizeBytes   on entry this should point to the
+ *                            number of bytes of storage at
+ *                            pMessage. On return, this will be
+ *                            updated to the number of bytes written
+ *                            to pMessage.  Cannot be NULL.
+ * @param pQos                a place to put the QoS of the message;
+ *                            may be NULL.
+ * @return                    zero on success,
+ *                            CELLULAR_MQTT_SN_MESSAGE_TRUNCATED if
+ *                            the message was truncated, else
+ *                            negative error code.
+ */
+int32_t cellularMqttSnMessageRead(CellularMqttSnTopic_t *pTopic,
+                                  char *pMessage,
+                                  int32_t *pMessageSizeBytes,
+                                  CellularMqttSnQos_t *pQos);
+
+/** Get the last MQTT-SN error code.
+ *
+ * @return an error code, the meaning of which is utterly module
+ *         specific.
+ */
+int32_t cellularMqttSnGetLastErrorCode();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _CELLULAR_MQTT_SN_H_
+
+// End of file
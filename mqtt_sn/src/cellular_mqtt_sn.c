@@ -0,0 +1,969 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Only #includes of cellular_* are allowed here, no C lib,
+ * no platform stuff and no OS stuff.  Anything required from
+ * the platform/C library/OS must be brought in through
+ * cellular_port* to maintain portability.
+ */
+
+// The log level threshold of this module, see cellular_port_debug.h.
+#define CELLULAR_PORT_LOG_THRESHOLD CELLULAR_CFG_LOG_LEVEL_MQTT
+
+#ifdef CELLULAR_CFG_OVERRIDE
+# include "cellular_cfg_override.h" // For a customer's configuration override
+#endif
+#include "cellular_cfg_sw.h"
+#include "cellular_cfg_module.h"
+#include "cellular_port_clib.h"
+#include "cellular_port.h"
+#include "cellular_port_debug.h"
+#include "cellular_port_os.h"
+#include "cellular_ctrl_at.h"
+#include "cellular_ctrl.h"
+#include "cellular_sock.h" // Required for IP address manipulation
+#include "cellular_mqtt_sn.h"
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS
+ * -------------------------------------------------------------- */
+
+/** Return "not supported" if this module doesn't support MQTT-SN.
+ */
+#if CELLULAR_MQTT_SN_IS_SUPPORTED
+# define CELLULAR_MQTT_SN_DEFAULT_ERROR_CODE CELLULAR_MQTT_SN_NOT_INITIALISED
+#else
+# define CELLULAR_MQTT_SN_DEFAULT_ERROR_CODE CELLULAR_MQTT_SN_NOT_SUPPORTED
+#endif
+
+/** The longest to wait on gQueueUrcEvent before calling
+ * gpKeepGoingCallback again while waiting for the gateway; with
+ * no gpKeepGoingCallback the wait is for as long as is left.
+ */
+#define CELLULAR_MQTT_SN_URC_EVENT_WAIT_MS 1000
+
+/* ----------------------------------------------------------------
+ * TYPES
+ * -------------------------------------------------------------- */
+
+/** The operations of AT+UMQTTSNC, which are also the first
+ * parameter of the +UUMQTTSNC URC.
+ */
+typedef enum {
+    CELLULAR_MQTT_SN_OP_DISCONNECT = 0,
+    CELLULAR_MQTT_SN_OP_CONNECT = 1,
+    CELLULAR_MQTT_SN_OP_REGISTER = 2,
+    CELLULAR_MQTT_SN_OP_PING = 3,
+    CELLULAR_MQTT_SN_OP_PUBLISH = 4,
+    CELLULAR_MQTT_SN_OP_SUBSCRIBE = 5,
+    CELLULAR_MQTT_SN_OP_UNSUBSCRIBE = 6,
+    CELLULAR_MQTT_SN_OP_READ = 9
+} CellularMqttSnOp_t;
+
+/** Struct to hold all the things an MQTT-SN URC might tell us.
+ */
+typedef struct {
+    bool updateFlag;
+    bool connected;
+    bool asleep;
+    int32_t waitingOp;  //!< the operation whose outcome is being
+                        // waited for, -1 if none.
+    int32_t result;     //!< the outcome of waitingOp, 1 for success.
+    int32_t qos;        //!< the QoS of a subscription.
+    int32_t topicId;    //!< the topic ID of a registration or a
+                        // subscription, -1 if none given.
+    size_t numUnreadMessages;
+} MqttSnUrcStatus_t;
+
+/* ----------------------------------------------------------------
+ * VARIABLES
+ * -------------------------------------------------------------- */
+
+/** Callback to be called while in a function which
+ * may have to wait for the gateway's response.
+ */
+static bool (*gpKeepGoingCallback)(void) = NULL;
+
+/** Mutex protection, held while waiting for the gateway.
+ */
+static CellularPortMutexHandle_t gMutex = NULL;
+
+/** Mutex protecting the message indication callback: not
+ * gMutex, which may be held for a long time while waiting
+ * for the gateway.
+ */
+static CellularPortMutexHandle_t gCallbackMutex = NULL;
+
+/** A place to hook the message indication callback.
+ */
+static void (*gpMessageIndicationCallback)(int32_t, void *);
+
+/** A place to hook the parameter for the message indication
+ * callback.
+ */
+static void *gpMessageIndicationCallbackParam;
+
+/** Store the status values from the URCs.
+ */
+static volatile MqttSnUrcStatus_t gUrcStatus;
+
+/** Queue which UUMQTTSNC_urc() uses to wake up a function that
+ * is waiting for the gateway.
+ */
+static CellularPortQueueHandle_t gQueueUrcEvent = NULL;
+
+/** Set when an event is waiting on gQueueUrcEvent so that a URC
+ * never blocks trying to send another.
+ */
+static volatile bool gUrcEventPending = false;
+
+#if CELLULAR_CFG_STATIC_ALLOC
+/** Buffer in which cellularMqttSnInit() works on the gateway
+ * address.
+ */
+static char gServerAddress[CELLULAR_MQTT_SN_SERVER_ADDRESS_STRING_MAX_LENGTH_BYTES + 1];
+#endif
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS: URCS AND RELATED FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// Let a function waiting on the gateway know that
+// gUrcStatus has been updated.
+static void signalUrcUpdate()
+{
+    int32_t dummy = 0;
+
+    gUrcStatus.updateFlag = true;
+    if ((gQueueUrcEvent != NULL) && !gUrcEventPending) {
+        gUrcEventPending = true;
+        cellularPortQueueSend(gQueueUrcEvent, &dummy);
+    }
+}
+
+// A local "trampoline" for the message indication callback,
+// here so that it can be called in the AT parser's
+// task callback context and then hold on the mutex before
+// calling gpMessageIndicationCallback with its parameters.
+static void messageIndicationCallback(void *pParam)
+{
+    int32_t numUnreadMessages = (int32_t) (intptr_t) pParam;
+    void (*pCallback)(int32_t, void *) = NULL;
+    void *pCallbackParam = NULL;
+
+    if (gCallbackMutex != NULL) {
+
+        CELLULAR_PORT_MUTEX_LOCK(gCallbackMutex);
+
+        pCallback = gpMessageIndicationCallback;
+        pCallbackParam = gpMessageIndicationCallbackParam;
+
+        CELLULAR_PORT_MUTEX_UNLOCK(gCallbackMutex);
+    }
+
+    if (pCallback != NULL) {
+        pCallback(numUnreadMessages, pCallbackParam);
+    }
+}
+
+// "+UUMQTTSNC:" URC handler.
+// Note: not marked as static to avoid an "unused" compiler
+// warning if CELLULAR_MQTT_SN_IS_SUPPORTED is 0.
+void UUMQTTSNC_urc(void *pUnused)
+{
+    int32_t op;
+    int32_t param1;
+
+    (void) pUnused;
+
+    op = cellular_ctrl_at_read_int();
+    // All of the URC types have at least one parameter
+    param1 = cellular_ctrl_at_read_int();
+    if (op == CELLULAR_MQTT_SN_OP_READ) {
+        // The number of unread messages
+        if (param1 >= 0) {
+            gUrcStatus.numUnreadMessages = param1;
+            if (gpMessageIndicationCallback != NULL) {
+                // Can't lock a mutex in here, launch our
+                // local callback via the AT parser's
+                // callback facility instead
+                cellular_ctrl_at_callback_priority(messageIndicationCallback,
+                                                   (void *) (gUrcStatus.numUnreadMessages),
+                                                   CELLULAR_CTRL_AT_CALLBACK_PRIORITY_LOW,
+                                                   true);
+            }
+        }
+    } else if (op == gUrcStatus.waitingOp) {
+        // The outcome of what is being waited for
+        gUrcStatus.result = param1;
+        if (op == CELLULAR_MQTT_SN_OP_REGISTER) {
+            gUrcStatus.topicId = cellular_ctrl_at_read_int();
+        } else if (op == CELLULAR_MQTT_SN_OP_SUBSCRIBE) {
+            gUrcStatus.qos = cellular_ctrl_at_read_int();
+            // Only present for a topic name
+            gUrcStatus.topicId = cellular_ctrl_at_read_int();
+        }
+        gUrcStatus.waitingOp = -1;
+        signalUrcUpdate();
+    } else if ((op == CELLULAR_MQTT_SN_OP_DISCONNECT) &&
+               (gUrcStatus.waitingOp != CELLULAR_MQTT_SN_OP_DISCONNECT)) {
+        // Disconnected by the gateway or lost, which
+        // also ends anything that is being waited for
+        gUrcStatus.connected = false;
+        gUrcStatus.asleep = false;
+        gUrcStatus.result = 0;
+        signalUrcUpdate();
+    }
+}
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS: MISC
+ * -------------------------------------------------------------- */
+
+// Clear gUrcStatus and any event left over from before, ready
+// to wait for the outcome of op.
+static void clearUrcEvent(CellularMqttSnOp_t op)
+{
+    int32_t dummy;
+
+    gUrcStatus.updateFlag = false;
+    gUrcStatus.result = -1;
+    gUrcStatus.topicId = -1;
+    gUrcStatus.waitingOp = op;
+    while (cellularPortQueueTryReceive(gQueueUrcEvent, 0, &dummy) == 0) {}
+    gUrcEventPending = false;
+}
+
+// Wait for the outcome set up by clearUrcEvent(), returning
+// true if it arrived and was success; gives up at
+// CELLULAR_MQTT_SN_SERVER_RESPONSE_WAIT_SECONDS or when
+// gpKeepGoingCallback() says stop.
+static bool waitOutcome()
+{
+    int64_t stopTimeMs;
+    int64_t waitMs;
+    int32_t dummy;
+    bool keepGoing = true;
+
+    stopTimeMs = cellularPortGetTickTimeMs() +
+                 (CELLULAR_MQTT_SN_SERVER_RESPONSE_WAIT_SECONDS * 1000);
+    while (!gUrcStatus.updateFlag && keepGoing) {
+        waitMs = stopTimeMs - cellularPortGetTickTimeMs();
+        keepGoing = (waitMs > 0) &&
+                    ((gpKeepGoingCallback == NULL) ||
+                     gpKeepGoingCallback());
+        if ((gpKeepGoingCallback != NULL) &&
+            (waitMs > CELLULAR_MQTT_SN_URC_EVENT_WAIT_MS)) {
+            waitMs = CELLULAR_MQTT_SN_URC_EVENT_WAIT_MS;
+        }
+        if (keepGoing &&
+            (cellularPortQueueTryReceive(gQueueUrcEvent,
+                                         (int32_t) waitMs,
+                                         &dummy) == 0)) {
+            gUrcEventPending = false;
+        }
+    }
+    gUrcStatus.waitingOp = -1;
+
+    return gUrcStatus.updateFlag && (gUrcStatus.result == 1);
+}
+
+// Print the error state of MQTT-SN.
+static void printErrorCodes()
+{
+    int32_t err1 = -1;
+    int32_t err2 = -1;
+
+    cellular_ctrl_at_lock();
+    cellular_ctrl_at_cmd_start("AT+UMQTTSNER");
+    cellular_ctrl_at_cmd_stop();
+    cellular_ctrl_at_read_fields("+UMQTTSNER:", "i,i", &err1, &err2);
+    cellular_ctrl_at_resp_stop();
+    cellular_ctrl_at_unlock();
+    cellularPortLog("CELLULAR_MQTT_SN: error codes %d, %d.\n", err1, err2);
+}
+
+// Send an AT+UMQTTSN or AT+UMQTTSNC command that has been
+// started, returning 0 for success or negative error code.
+static CellularMqttSnErrorCode_t atStopCmdGetRespAndUnlock()
+{
+    CellularMqttSnErrorCode_t errorCode = CELLULAR_MQTT_SN_AT_ERROR;
+
+    cellular_ctrl_at_cmd_stop_read_resp();
+    if (cellular_ctrl_at_unlock_return_error() == 0) {
+        errorCode = CELLULAR_MQTT_SN_SUCCESS;
+    } else {
+        printErrorCodes();
+    }
+
+    return errorCode;
+}
+
+// Set the gateway from a string that may be an IP address
+// or a domain name, either with an optional port number.
+static CellularMqttSnErrorCode_t setServer(const char *pServerNameStr)
+{
+    CellularMqttSnErrorCode_t errorCode = CELLULAR_MQTT_SN_NO_MEMORY;
+    CellularSockAddress_t address;
+    char *pAddress;
+    char *pTmp;
+    int32_t port;
+
+#if CELLULAR_CFG_STATIC_ALLOC
+    pAddress = gServerAddress;
+#else
+    pAddress = (char *) pCellularPort_mallocTag(CELLULAR_MQTT_SN_SERVER_ADDRESS_STRING_MAX_LENGTH_BYTES + 1,
+                                                CELLULAR_PORT_MALLOC_TAG_MQTT_SN);
+#endif
+    if (pAddress != NULL) {
+        errorCode = CELLULAR_MQTT_SN_BAD_ADDRESS;
+        pCellularPort_memset(&address, 0, sizeof(address));
+        if (cellularSockStringToAddress(pServerNameStr,
+                                        &address) == 0) {
+            // An IP address: convert the bit that isn't
+            // a port number back into a string
+            if (cellularSockIpAddressToString(&(address.ipAddress),
+                                              pAddress,
+                                              CELLULAR_MQTT_SN_SERVER_ADDRESS_STRING_MAX_LENGTH_BYTES) == 0) {
+                cellular_ctrl_at_lock();
+                cellular_ctrl_at_cmd_start("AT+UMQTTSN=");
+                // Set the gateway IP address
+                cellular_ctrl_at_write_int(2);
+                cellular_ctrl_at_write_string(pAddress, true);
+                if (address.port > 0) {
+                    cellular_ctrl_at_write_int(address.port);
+                }
+                errorCode = atStopCmdGetRespAndUnlock();
+            }
+        } else {
+            // A domain name, which has to be copied
+            // in order to remove any port number
+            pCellularPort_strcpy(pAddress, pServerNameStr);
+            port = cellularSockDomainGetPort(pAddress);
+            pTmp = pCellularSockDomainRemovePort(pAddress);
+            cellular_ctrl_at_lock();
+            cellular_ctrl_at_cmd_start("AT+UMQTTSN=");
+            // Set the gateway name
+            cellular_ctrl_at_write_int(1);
+            cellular_ctrl_at_write_string(pTmp, true);
+            if (port >= 0) {
+                cellular_ctrl_at_write_int(port);
+            }
+            errorCode = atStopCmdGetRespAndUnlock();
+        }
+#if !CELLULAR_CFG_STATIC_ALLOC
+        cellularPort_free(pAddress);
+#endif
+    }
+
+    return errorCode;
+}
+
+// Write a topic as the parameters of an AT+UMQTTSNC command:
+// the topic type then the ID or the short name.
+static void writeTopic(const CellularMqttSnTopic_t *pTopic)
+{
+    cellular_ctrl_at_write_int(pTopic->type);
+    if (pTopic->type == CELLULAR_MQTT_SN_TOPIC_SHORT) {
+        cellular_ctrl_at_write_string(pTopic->shortName, true);
+    } else {
+        cellular_ctrl_at_write_int(pTopic->id);
+    }
+}
+
+// Check that a topic filled in by the application is valid for
+// subscribing or unsubscribing, i.e. is pre-defined or short.
+static bool topicIsValidNotNormal(const CellularMqttSnTopic_t *pTopic)
+{
+    return (pTopic != NULL) &&
+           (((pTopic->type == CELLULAR_MQTT_SN_TOPIC_SHORT) &&
+             (cellularPort_strlen(pTopic->shortName) == 2)) ||
+            (pTopic->type == CELLULAR_MQTT_SN_TOPIC_PREDEFINED));
+}
+
+// Do an AT+UMQTTSNC operation that takes no parameters except,
+// for disconnect, an optional sleep duration, and wait for its
+// outcome.  Note: gMutex must be locked.
+static CellularMqttSnErrorCode_t doOpLocked(CellularMqttSnOp_t op,
+                                            int32_t sleepSeconds)
+{
+    CellularMqttSnErrorCode_t errorCode = CELLULAR_MQTT_SN_AT_ERROR;
+
+    clearUrcEvent(op);
+    cellular_ctrl_at_lock();
+    cellular_ctrl_at_cmd_start("AT+UMQTTSNC=");
+    cellular_ctrl_at_write_int(op);
+    if (sleepSeconds > 0) {
+        cellular_ctrl_at_write_int(sleepSeconds);
+    }
+    if (atStopCmdGetRespAndUnlock() == CELLULAR_MQTT_SN_SUCCESS) {
+        errorCode = CELLULAR_MQTT_SN_TIMEOUT;
+        if (waitOutcome()) {
+            errorCode = CELLULAR_MQTT_SN_SUCCESS;
+        } else {
+            printErrorCodes();
+        }
+    }
+
+    return errorCode;
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// Initialise the MQTT-SN client.
+int32_t cellularMqttSnInit(const char *pServerNameStr,
+                           const char *pClientIdStr,
+                           bool (*pKeepGoingCallback)(void))
+{
+    CellularMqttSnErrorCode_t errorCode = CELLULAR_MQTT_SN_NOT_SUPPORTED;
+
+#if CELLULAR_MQTT_SN_IS_SUPPORTED
+    errorCode = CELLULAR_MQTT_SN_SUCCESS;
+    if (gMutex == NULL) {
+        errorCode = CELLULAR_MQTT_SN_BAD_ADDRESS;
+        if ((pServerNameStr != NULL) &&
+            (cellularPort_strlen(pServerNameStr) <= CELLULAR_MQTT_SN_SERVER_ADDRESS_STRING_MAX_LENGTH_BYTES)) {
+            errorCode = setServer(pServerNameStr);
+            if ((errorCode == CELLULAR_MQTT_SN_SUCCESS) &&
+                (pClientIdStr != NULL)) {
+                cellular_ctrl_at_lock();
+                cellular_ctrl_at_cmd_start("AT+UMQTTSN=");
+                // Set client ID
+                cellular_ctrl_at_write_int(0);
+                cellular_ctrl_at_write_string(pClientIdStr, true);
+                errorCode = atStopCmdGetRespAndUnlock();
+            }
+            if (errorCode == CELLULAR_MQTT_SN_SUCCESS) {
+                // Create the mutexes that we use for re-entrancy
+                // protection and the queue a URC uses to wake us up
+                errorCode = CELLULAR_MQTT_SN_PLATFORM_ERROR;
+                if ((cellularPortMutexCreate(&gCallbackMutex) == 0) &&
+                    (cellularPortQueueCreate(2, sizeof(int32_t),
+                                             &gQueueUrcEvent) == 0) &&
+                    (cellularPortMutexCreate(&gMutex) == 0)) {
+                    gUrcEventPending = false;
+                    pCellularPort_memset((void *) &gUrcStatus, 0, sizeof(gUrcStatus));
+                    gUrcStatus.waitingOp = -1;
+                    gpKeepGoingCallback = pKeepGoingCallback;
+                    gpMessageIndicationCallback = NULL;
+                    gpMessageIndicationCallbackParam = NULL;
+                    cellular_ctrl_at_set_urc_handler("+UUMQTTSNC:", UUMQTTSNC_urc, NULL);
+                    errorCode = CELLULAR_MQTT_SN_SUCCESS;
+                } else {
+                    if (gQueueUrcEvent != NULL) {
+                        cellularPortQueueDelete(gQueueUrcEvent);
+                        gQueueUrcEvent = NULL;
+                    }
+                    if (gCallbackMutex != NULL) {
+                        cellularPortMutexDelete(gCallbackMutex);
+                        gCallbackMutex = NULL;
+                    }
+                }
+            }
+        }
+    }
+#else
+    (void) pServerNameStr;
+    (void) pClientIdStr;
+    (void) pKeepGoingCallback;
+#endif
+
+    return (int32_t) errorCode;
+}
+
+// Shut-down the MQTT-SN client.
+void cellularMqttSnDeinit()
+{
+    if (gMutex != NULL) {
+        cellular_ctrl_at_remove_urc_handler("+UUMQTTSNC:");
+
+        // Make sure no-one is still in here
+        CELLULAR_PORT_MUTEX_LOCK(gMutex);
+        CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
+
+        cellularPortMutexDelete(gCallbackMutex);
+        gCallbackMutex = NULL;
+        cellularPortQueueDelete(gQueueUrcEvent);
+        gQueueUrcEvent = NULL;
+        cellularPortMutexDelete(gMutex);
+        gMutex = NULL;
+    }
+}
+
+// Set the keep-alive time.
+int32_t cellularMqttSnSetKeepAlive(int32_t seconds)
+{
+    CellularMqttSnErrorCode_t errorCode = CELLULAR_MQTT_SN_DEFAULT_ERROR_CODE;
+
+    if (gMutex != NULL) {
+        errorCode = CELLULAR_MQTT_SN_INVALID_PARAMETER;
+        if ((seconds > 0) && (seconds <= 0xFFFF)) {
+            cellular_ctrl_at_lock();
+            cellular_ctrl_at_cmd_start("AT+UMQTTSN=");
+            // Keep-alive duration
+            cellular_ctrl_at_write_int(3);
+            cellular_ctrl_at_write_int(seconds);
+            errorCode = atStopCmdGetRespAndUnlock();
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Start an MQTT-SN session or wake a sleeping one.
+int32_t cellularMqttSnConnect()
+{
+    CellularMqttSnErrorCode_t errorCode = CELLULAR_MQTT_SN_DEFAULT_ERROR_CODE;
+
+    if (gMutex != NULL) {
+
+        CELLULAR_PORT_MUTEX_LOCK(gMutex);
+
+        // Deliberately don't check if we're connected
+        // already, as for cellularMqttConnect()
+        cellularPortLog("CELLULAR_MQTT_SN: waiting for connection for up to %d"
+                        " second(s)...\n",
+                        CELLULAR_MQTT_SN_SERVER_RESPONSE_WAIT_SECONDS);
+        errorCode = doOpLocked(CELLULAR_MQTT_SN_OP_CONNECT, 0);
+        if (errorCode == CELLULAR_MQTT_SN_SUCCESS) {
+            gUrcStatus.connected = true;
+            gUrcStatus.asleep = false;
+        }
+
+        CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Stop an MQTT-SN session.
+int32_t cellularMqttSnDisconnect()
+{
+    CellularMqttSnErrorCode_t errorCode = CELLULAR_MQTT_SN_DEFAULT_ERROR_CODE;
+
+    if (gMutex != NULL) {
+
+        CELLULAR_PORT_MUTEX_LOCK(gMutex);
+
+        errorCode = doOpLocked(CELLULAR_MQTT_SN_OP_DISCONNECT, 0);
+        // Whatever the gateway thinks, we're done
+        gUrcStatus.connected = false;
+        gUrcStatus.asleep = false;
+
+        CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Determine whether an MQTT-SN session is active or not.
+bool cellularMqttSnIsConnected()
+{
+    // There is no way to ask the module about this,
+    // just return our last status
+    return gUrcStatus.connected;
+}
+
+// Put the MQTT-SN session to sleep.
+int32_t cellularMqttSnSleep(int32_t seconds)
+{
+    CellularMqttSnErrorCode_t errorCode = CELLULAR_MQTT_SN_DEFAULT_ERROR_CODE;
+
+    if (gMutex != NULL) {
+        errorCode = CELLULAR_MQTT_SN_INVALID_PARAMETER;
+        if ((seconds > 0) && (seconds <= 0xFFFF)) {
+
+            CELLULAR_PORT_MUTEX_LOCK(gMutex);
+
+            errorCode = CELLULAR_MQTT_SN_NOT_CONNECTED;
+            if (gUrcStatus.connected) {
+                // A disconnect with a duration is a sleep
+                errorCode = doOpLocked(CELLULAR_MQTT_SN_OP_DISCONNECT,
+                                       seconds);
+                if (errorCode == CELLULAR_MQTT_SN_SUCCESS) {
+                    gUrcStatus.asleep = true;
+                }
+            }
+
+            CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Determine whether the MQTT-SN session is asleep.
+bool cellularMqttSnIsAsleep()
+{
+    return gUrcStatus.connected && gUrcStatus.asleep;
+}
+
+// Collect the messages held by the gateway for a sleeping session.
+int32_t cellularMqttSnWake()
+{
+    CellularMqttSnErrorCode_t errorCode = CELLULAR_MQTT_SN_DEFAULT_ERROR_CODE;
+
+    if (gMutex != NULL) {
+
+        CELLULAR_PORT_MUTEX_LOCK(gMutex);
+
+        errorCode = CELLULAR_MQTT_SN_NOT_CONNECTED;
+        if (gUrcStatus.connected && gUrcStatus.asleep) {
+            // A ping from a sleeping client makes the gateway
+            // send what it has, the outcome arriving once
+            // it has done so
+            errorCode = doOpLocked(CELLULAR_MQTT_SN_OP_PING, 0);
+        }
+
+        CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Register a topic name with the gateway.
+int32_t cellularMqttSnRegister(const char *pTopicNameStr,
+                               CellularMqttSnTopic_t *pTopic)
+{
+    CellularMqttSnErrorCode_t errorCode = CELLULAR_MQTT_SN_DEFAULT_ERROR_CODE;
+
+    if (gMutex != NULL) {
+        errorCode = CELLULAR_MQTT_SN_INVALID_PARAMETER;
+        if ((pTopicNameStr != NULL) && (pTopic != NULL)) {
+
+            CELLULAR_PORT_MUTEX_LOCK(gMutex);
+
+            errorCode = CELLULAR_MQTT_SN_AT_ERROR;
+            clearUrcEvent(CELLULAR_MQTT_SN_OP_REGISTER);
+            cellular_ctrl_at_lock();
+            cellular_ctrl_at_cmd_start("AT+UMQTTSNC=");
+            cellular_ctrl_at_write_int(CELLULAR_MQTT_SN_OP_REGISTER);
+            cellular_ctrl_at_write_string(pTopicNameStr, true);
+            if (atStopCmdGetRespAndUnlock() == CELLULAR_MQTT_SN_SUCCESS) {
+                errorCode = CELLULAR_MQTT_SN_TIMEOUT;
+                if (waitOutcome() && (gUrcStatus.topicId >= 0)) {
+                    pCellularPort_memset(pTopic, 0, sizeof(*pTopic));
+                    pTopic->type = CELLULAR_MQTT_SN_TOPIC_NORMAL;
+                    pTopic->id = (uint16_t) gUrcStatus.topicId;
+                    errorCode = CELLULAR_MQTT_SN_SUCCESS;
+                } else {
+                    printErrorCodes();
+                }
+            }
+
+            CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Publish an MQTT-SN message.
+int32_t cellularMqttSnPublish(CellularMqttSnQos_t qos,
+                              bool retain,
+                              const CellularMqttSnTopic_t *pTopic,
+                              const char *pMessage,
+                              int32_t messageSizeBytes)
+{
+    CellularMqttSnErrorCode_t errorCode = CELLULAR_MQTT_SN_DEFAULT_ERROR_CODE;
+    bool waitForGateway;
+
+    if (gMutex != NULL) {
+        errorCode = CELLULAR_MQTT_SN_INVALID_PARAMETER;
+        if ((qos >= 0) && (qos < MAX_NUM_CELLULAR_MQTT_SN_QOS) &&
+            (pTopic != NULL) &&
+            (pTopic->type >= 0) &&
+            (pTopic->type < MAX_NUM_CELLULAR_MQTT_SN_TOPIC_TYPES) &&
+            ((qos != CELLULAR_MQTT_SN_SEND_AND_FORGET) ||
+             (pTopic->type != CELLULAR_MQTT_SN_TOPIC_NORMAL)) &&
+            (pMessage != NULL) && (messageSizeBytes >= 0) &&
+            (messageSizeBytes <= CELLULAR_MQTT_SN_PUBLISH_MAX_LENGTH_BYTES)) {
+
+            CELLULAR_PORT_MUTEX_LOCK(gMutex);
+
+            errorCode = CELLULAR_MQTT_SN_NOT_CONNECTED;
+            if (gUrcStatus.connected ||
+                (qos == CELLULAR_MQTT_SN_SEND_AND_FORGET)) {
+                // Only QoS 1 and 2 involve the gateway
+                // getting back to us
+                waitForGateway = (qos == CELLULAR_MQTT_SN_AT_LEAST_ONCE) ||
+                                 (qos == CELLULAR_MQTT_SN_EXACTLY_ONCE);
+                clearUrcEvent(waitForGateway ? CELLULAR_MQTT_SN_OP_PUBLISH : -1);
+                cellular_ctrl_at_lock();
+                cellular_ctrl_at_cmd_start("AT+UMQTTSNC=");
+                cellular_ctrl_at_write_int(CELLULAR_MQTT_SN_OP_PUBLISH);
+                cellular_ctrl_at_write_int(qos);
+                cellular_ctrl_at_write_int(retain);
+                // Hex mode
+                cellular_ctrl_at_write_int(1);
+                writeTopic(pTopic);
+                // Hex message, encoded on the way out
+                cellular_ctrl_at_write_hex(pMessage, messageSizeBytes, true);
+                errorCode = atStopCmdGetRespAndUnlock();
+                if ((errorCode == CELLULAR_MQTT_SN_SUCCESS) &&
+                    waitForGateway) {
+                    errorCode = CELLULAR_MQTT_SN_TIMEOUT;
+                    if (waitOutcome()) {
+                        errorCode = CELLULAR_MQTT_SN_SUCCESS;
+                    } else {
+                        printErrorCodes();
+                    }
+                }
+            }
+
+            CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Subscribe to an MQTT-SN topic.
+int32_t cellularMqttSnSubscribe(CellularMqttSnQos_t maxQos,
+                                const char *pTopicFilterStr,
+                                CellularMqttSnTopic_t *pTopic)
+{
+    CellularMqttSnErrorCode_t errorCodeOrQos = CELLULAR_MQTT_SN_DEFAULT_ERROR_CODE;
+
+    if (gMutex != NULL) {
+        errorCodeOrQos = CELLULAR_MQTT_SN_INVALID_PARAMETER;
+        if ((maxQos >= 0) && (maxQos < CELLULAR_MQTT_SN_SEND_AND_FORGET) &&
+            ((pTopicFilterStr != NULL) || topicIsValidNotNormal(pTopic))) {
+
+            CELLULAR_PORT_MUTEX_LOCK(gMutex);
+
+            errorCodeOrQos = CELLULAR_MQTT_SN_AT_ERROR;
+            clearUrcEvent(CELLULAR_MQTT_SN_OP_SUBSCRIBE);
+            cellular_ctrl_at_lock();
+            cellular_ctrl_at_cmd_start("AT+UMQTTSNC=");
+            cellular_ctrl_at_write_int(CELLULAR_MQTT_SN_OP_SUBSCRIBE);
+            cellular_ctrl_at_write_int(maxQos);
+            if (pTopicFilterStr != NULL) {
+                cellular_ctrl_at_write_int(CELLULAR_MQTT_SN_TOPIC_NORMAL);
+                cellular_ctrl_at_write_string(pTopicFilterStr, true);
+            } else {
+                writeTopic(pTopic);
+            }
+            if (atStopCmdGetRespAndUnlock() == CELLULAR_MQTT_SN_SUCCESS) {
+                errorCodeOrQos = CELLULAR_MQTT_SN_TIMEOUT;
+                if (waitOutcome() && (gUrcStatus.qos >= 0)) {
+                    if ((pTopicFilterStr != NULL) && (pTopic != NULL)) {
+                        pCellularPort_memset(pTopic, 0, sizeof(*pTopic));
+                        pTopic->type = CELLULAR_MQTT_SN_TOPIC_NORMAL;
+                        if (gUrcStatus.topicId >= 0) {
+                            pTopic->id = (uint16_t) gUrcStatus.topicId;
+                        }
+                    }
+                    errorCodeOrQos = gUrcStatus.qos;
+                } else {
+                    printErrorCodes();
+                }
+            }
+
+            CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
+        }
+    }
+
+    return (int32_t) errorCodeOrQos;
+}
+
+// Unsubscribe from an MQTT-SN topic.
+int32_t cellularMqttSnUnsubscribe(const char *pTopicFilterStr,
+                                  const CellularMqttSnTopic_t *pTopic)
+{
+    CellularMqttSnErrorCode_t errorCode = CELLULAR_MQTT_SN_DEFAULT_ERROR_CODE;
+
+    if (gMutex != NULL) {
+        errorCode = CELLULAR_MQTT_SN_INVALID_PARAMETER;
+        if ((pTopicFilterStr != NULL) || topicIsValidNotNormal(pTopic)) {
+
+            CELLULAR_PORT_MUTEX_LOCK(gMutex);
+
+            errorCode = CELLULAR_MQTT_SN_AT_ERROR;
+            clearUrcEvent(CELLULAR_MQTT_SN_OP_UNSUBSCRIBE);
+            cellular_ctrl_at_lock();
+            cellular_ctrl_at_cmd_start("AT+UMQTTSNC=");
+            cellular_ctrl_at_write_int(CELLULAR_MQTT_SN_OP_UNSUBSCRIBE);
+            if (pTopicFilterStr != NULL) {
+                cellular_ctrl_at_write_int(CELLULAR_MQTT_SN_TOPIC_NORMAL);
+                cellular_ctrl_at_write_string(pTopicFilterStr, true);
+            } else {
+                writeTopic(pTopic);
+            }
+            if (atStopCmdGetRespAndUnlock() == CELLULAR_MQTT_SN_SUCCESS) {
+                errorCode = CELLULAR_MQTT_SN_TIMEOUT;
+                if (waitOutcome()) {
+                    errorCode = CELLULAR_MQTT_SN_SUCCESS;
+                } else {
+                    printErrorCodes();
+                }
+            }
+
+            CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Set a new messages callback.
+int32_t cellularMqttSnSetMessageIndicationCallback(void (*pCallback)(int32_t, void *),
+                                                   void *pCallbackParam)
+{
+    CellularMqttSnErrorCode_t errorCode = CELLULAR_MQTT_SN_DEFAULT_ERROR_CODE;
+
+    if (gMutex != NULL) {
+
+        CELLULAR_PORT_MUTEX_LOCK(gCallbackMutex);
+
+        gpMessageIndicationCallback = pCallback;
+        gpMessageIndicationCallbackParam = pCallbackParam;
+        errorCode = CELLULAR_MQTT_SN_SUCCESS;
+
+        CELLULAR_PORT_MUTEX_UNLOCK(gCallbackMutex);
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Get the number of unread messages.
+int32_t cellularMqttSnGetUnread()
+{
+    CellularMqttSnErrorCode_t errorCodeOrNum = CELLULAR_MQTT_SN_DEFAULT_ERROR_CODE;
+
+    if (gMutex != NULL) {
+        errorCodeOrNum = (CellularMqttSnErrorCode_t) gUrcStatus.numUnreadMessages;
+    }
+
+    return (int32_t) errorCodeOrNum;
+}
+
+// Read an MQTT-SN message.
+int32_t cellularMqttSnMessageRead(CellularMqttSnTopic_t *pTopic,
+                                  char *pMessage,
+                                  int32_t *pMessageSizeBytes,
+                                  CellularMqttSnQos_t *pQos)
+{
+    CellularMqttSnErrorCode_t errorCode = CELLULAR_MQTT_SN_DEFAULT_ERROR_CODE;
+    CellularMqttSnTopic_t topic;
+    int32_t qos;
+    int32_t topicId = 0;
+    int32_t topicNameBytesRead = 0;
+    int32_t messageBytesAvailable;
+    int32_t messageBytesToRead;
+    int32_t messageBytesRead;
+    uint8_t quoteMark;
+
+    if (gMutex != NULL) {
+        errorCode = CELLULAR_MQTT_SN_INVALID_PARAMETER;
+        if ((pTopic != NULL) && (pMessage != NULL) &&
+            (pMessageSizeBytes != NULL) && (*pMessageSizeBytes >= 0)) {
+
+            CELLULAR_PORT_MUTEX_LOCK(gMutex);
+
+            errorCode = CELLULAR_MQTT_SN_AT_ERROR;
+            pCellularPort_memset(&topic, 0, sizeof(topic));
+            cellular_ctrl_at_lock();
+            cellular_ctrl_at_cmd_start("AT+UMQTTSNC=");
+            cellular_ctrl_at_write_int(CELLULAR_MQTT_SN_OP_READ);
+            cellular_ctrl_at_cmd_stop();
+            // The response is:
+            // +UMQTTSNC: 9,<qos>,<topic_type>,<topic>,<length>,"<message>"
+            cellular_ctrl_at_resp_start("+UMQTTSNC:", false);
+            // Skip our op code
+            cellular_ctrl_at_skip_param(1);
+            qos = cellular_ctrl_at_read_int();
+            topic.type = (CellularMqttSnTopicType_t) cellular_ctrl_at_read_int();
+            if (topic.type == CELLULAR_MQTT_SN_TOPIC_SHORT) {
+                topicNameBytesRead = cellular_ctrl_at_read_string(topic.shortName,
+                                                                  sizeof(topic.shortName),
+                                                                  false);
+            } else {
+                topicId = cellular_ctrl_at_read_int();
+            }
+            messageBytesAvailable = cellular_ctrl_at_read_int();
+            messageBytesToRead = messageBytesAvailable;
+            if (messageBytesToRead > *pMessageSizeBytes) {
+                messageBytesToRead = *pMessageSizeBytes;
+            }
+            // Read the exact length of message bytes straight
+            // into the caller's buffer, being careful not to
+            // look for delimiters as this can be binary
+            cellular_ctrl_at_set_delimiter(0);
+            cellular_ctrl_at_set_stop_tag(NULL);
+            // Get the leading quote mark out of the way
+            cellular_ctrl_at_read_bytes(&quoteMark, 1);
+            messageBytesRead = cellular_ctrl_at_read_bytes((uint8_t *) pMessage,
+                                                           messageBytesToRead);
+            // Throw away any remainder
+            if (messageBytesAvailable > messageBytesToRead) {
+                cellular_ctrl_at_read_bytes(NULL,
+                                            messageBytesAvailable - messageBytesToRead);
+            }
+            cellular_ctrl_at_resp_stop();
+            cellular_ctrl_at_set_default_delimiter();
+            if ((cellular_ctrl_at_unlock_return_error() == 0) &&
+                (qos >= 0) && (qos < MAX_NUM_CELLULAR_MQTT_SN_QOS) &&
+                (topic.type >= 0) &&
+                (topic.type < MAX_NUM_CELLULAR_MQTT_SN_TOPIC_TYPES) &&
+                (topicId >= 0) && (topicNameBytesRead >= 0) &&
+                (messageBytesAvailable >= 0) && (messageBytesRead >= 0)) {
+                topic.id = (uint16_t) topicId;
+                pCellularPort_memcpy(pTopic, &topic, sizeof(*pTopic));
+                *pMessageSizeBytes = messageBytesRead;
+                if (pQos != NULL) {
+                    *pQos = (CellularMqttSnQos_t) qos;
+                }
+                if (gUrcStatus.numUnreadMessages > 0) {
+                    gUrcStatus.numUnreadMessages--;
+                }
+                errorCode = CELLULAR_MQTT_SN_SUCCESS;
+                if (messageBytesAvailable > messageBytesToRead) {
+                    errorCode = CELLULAR_MQTT_SN_MESSAGE_TRUNCATED;
+                }
+            }
+
+            CELLULAR_PORT_MUTEX_UNLOCK(gMutex);
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Get the last module-specific MQTT-SN error code.
+int32_t cellularMqttSnGetLastErrorCode()
+{
+    int32_t errorCode = 0;
+    int32_t x;
+
+    if (gMutex != NULL) {
+        cellular_ctrl_at_lock();
+        cellular_ctrl_at_cmd_start("AT+UMQTTSNER");
+        cellular_ctrl_at_cmd_stop();
+        // Skip the first error code, which is a generic thing
+        cellular_ctrl_at_read_fields("+UMQTTSNER:", "-,i", &x);
+        cellular_ctrl_at_resp_stop();
+        if (cellular_ctrl_at_unlock_return_error() == 0) {
+            errorCode = x;
+        }
+    }
+
+    return errorCode;
+}
+
+// End of file
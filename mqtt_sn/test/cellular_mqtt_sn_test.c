@@ -0,0 +1,261 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Only #includes of cellular_* are allowed here, no C lib,
+ * no platform stuff and no OS stuff.  Anything required from
+ * the platform/C library/OS must be brought in through
+ * cellular_port* to maintain portability.
+ */
+
+#ifdef CELLULAR_CFG_OVERRIDE
+# include "cellular_cfg_override.h" // For a customer's configuration override
+#endif
+#include "cellular_cfg_sw.h"
+#include "cellular_cfg_module.h"
+#include "cellular_cfg_hw_platform_specific.h"
+#include "cellular_port_clib.h"
+#include "cellular_port.h"
+#include "cellular_port_debug.h"
+#include "cellular_port_os.h"
+#include "cellular_port_uart.h"
+#include "cellular_port_test_platform_specific.h"
+#include "cellular_ctrl.h"
+#include "cellular_mqtt_sn.h"
+#include "cellular_cfg_test.h"
+
+#if CELLULAR_MQTT_SN_IS_SUPPORTED
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS
+ * -------------------------------------------------------------- */
+
+// The topic name to register and subscribe to.
+#define CELLULAR_MQTT_SN_TEST_TOPIC_NAME "ubx_cellular_mqtt_sn_test"
+
+// The short topic name to publish to with QoS -1.
+#define CELLULAR_MQTT_SN_TEST_SHORT_TOPIC_NAME "ux"
+
+// How long to wait for a published message to come back.
+#define CELLULAR_MQTT_SN_TEST_ECHO_WAIT_SECONDS 30
+
+/* ----------------------------------------------------------------
+ * TYPES
+ * -------------------------------------------------------------- */
+
+/* ----------------------------------------------------------------
+ * VARIABLES
+ * -------------------------------------------------------------- */
+
+// Used for keepGoingCallback() timeout.
+static int64_t gStopTimeMs;
+
+// The UART queue handle: kept as a global variable
+// for the same reasons as in the sockets tests.
+static CellularPortQueueHandle_t gUartQueueHandle = NULL;
+
+// What is published.
+static const char gPublishData[] = "The quick brown fox jumps over the lazy dog";
+
+// Buffer that messages are read into.
+static char gBuffer[CELLULAR_MQTT_SN_PUBLISH_MAX_LENGTH_BYTES];
+
+// The last number of unread messages the indication
+// callback was given.
+static volatile int32_t gNumUnread = 0;
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// Callback function for the cellular connection process.
+static bool keepGoingCallback()
+{
+    bool keepGoing = true;
+
+    if (cellularPortGetTickTimeMs() > gStopTimeMs) {
+        keepGoing = false;
+    }
+
+    return keepGoing;
+}
+
+// Message indication callback.
+static void messageIndicationCallback(int32_t numUnread, void *pParam)
+{
+    (void) pParam;
+
+    gNumUnread = numUnread;
+}
+
+// Wait for a message to arrive, returning true if one has.
+static bool waitUnread()
+{
+    int64_t stopTimeMs;
+
+    stopTimeMs = cellularPortGetTickTimeMs() +
+                 (CELLULAR_MQTT_SN_TEST_ECHO_WAIT_SECONDS * 1000);
+    while ((cellularMqttSnGetUnread() <= 0) &&
+           (cellularPortGetTickTimeMs() < stopTimeMs)) {
+        cellularPortTaskBlock(100);
+    }
+
+    return cellularMqttSnGetUnread() > 0;
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+/** Connect to an MQTT-SN gateway, register, subscribe, publish
+ * and read back, sleep, wake and disconnect.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularMqttSnTestConnectPublishSubscribe(),
+                            "mqttSnConnectPublishSubscribe",
+                            "mqttSn")
+{
+    CellularMqttSnTopic_t topic;
+    CellularMqttSnTopic_t shortTopic;
+    CellularMqttSnTopic_t readTopic;
+    CellularMqttSnQos_t qos;
+    int32_t sizeBytes;
+
+    CELLULAR_PORT_TEST_ASSERT(cellularPortInit() == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartInit(CELLULAR_CFG_PIN_TXD,
+                                                   CELLULAR_CFG_PIN_RXD,
+                                                   CELLULAR_CFG_PIN_CTS,
+                                                   CELLULAR_CFG_PIN_RTS,
+                                                   CELLULAR_CFG_BAUD_RATE,
+                                                   CELLULAR_CFG_RTS_THRESHOLD,
+                                                   CELLULAR_CFG_UART,
+                                                   &gUartQueueHandle) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlInit(CELLULAR_CFG_PIN_ENABLE_POWER,
+                                               CELLULAR_CFG_PIN_PWR_ON,
+                                               CELLULAR_CFG_PIN_VINT,
+                                               false,
+                                               CELLULAR_CFG_UART,
+                                               gUartQueueHandle) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlPowerOn(NULL) == 0);
+
+    // Not initialised yet
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttSnConnect() == CELLULAR_MQTT_SN_NOT_INITIALISED);
+
+    gStopTimeMs = cellularPortGetTickTimeMs() + (CELLULAR_CFG_TEST_CONNECT_TIMEOUT_SECONDS * 1000);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlConnect(keepGoingCallback,
+                                                  CELLULAR_CFG_TEST_APN,
+                                                  CELLULAR_CFG_TEST_USERNAME,
+                                                  CELLULAR_CFG_TEST_PASSWORD) == 0);
+
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttSnInit(CELLULAR_CFG_TEST_MQTT_SN_SERVER_DOMAIN_NAME,
+                                                 "ubx_cellular_mqtt_sn_test",
+                                                 NULL) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttSnSetMessageIndicationCallback(messageIndicationCallback,
+                                                                         NULL) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttSnSetKeepAlive(60) == 0);
+
+    // Bad parameters
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttSnRegister(NULL, &topic) == CELLULAR_MQTT_SN_INVALID_PARAMETER);
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttSnSleep(0) == CELLULAR_MQTT_SN_INVALID_PARAMETER);
+    CELLULAR_PORT_TEST_ASSERT(!cellularMqttSnIsConnected());
+
+    cellularPortLog("CELLULAR_MQTT_SN_TEST: connecting to \"%s\"...\n",
+                    CELLULAR_CFG_TEST_MQTT_SN_SERVER_DOMAIN_NAME);
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttSnConnect() == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttSnIsConnected());
+    CELLULAR_PORT_TEST_ASSERT(!cellularMqttSnIsAsleep());
+
+    // Register a topic name and subscribe to it
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttSnRegister(CELLULAR_MQTT_SN_TEST_TOPIC_NAME,
+                                                     &topic) == 0);
+    cellularPortLog("CELLULAR_MQTT_SN_TEST: topic ID is %d.\n", topic.id);
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttSnSubscribe(CELLULAR_MQTT_SN_AT_LEAST_ONCE,
+                                                      CELLULAR_MQTT_SN_TEST_TOPIC_NAME,
+                                                      NULL) >= 0);
+
+    // Publish and read the message back
+    gNumUnread = 0;
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttSnPublish(CELLULAR_MQTT_SN_AT_LEAST_ONCE,
+                                                    false, &topic, gPublishData,
+                                                    sizeof(gPublishData) - 1) == 0);
+    CELLULAR_PORT_TEST_ASSERT(waitUnread());
+    CELLULAR_PORT_TEST_ASSERT(gNumUnread > 0);
+    sizeBytes = sizeof(gBuffer);
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttSnMessageRead(&readTopic, gBuffer,
+                                                        &sizeBytes, &qos) == 0);
+    CELLULAR_PORT_TEST_ASSERT(readTopic.id == topic.id);
+    CELLULAR_PORT_TEST_ASSERT(sizeBytes == sizeof(gPublishData) - 1);
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_memcmp(gBuffer, gPublishData, sizeBytes) == 0);
+
+    // Subscribe to a short topic and send to it with QoS -1,
+    // nothing to wait for there
+    pCellularPort_memset(&shortTopic, 0, sizeof(shortTopic));
+    shortTopic.type = CELLULAR_MQTT_SN_TOPIC_SHORT;
+    pCellularPort_strcpy(shortTopic.shortName, CELLULAR_MQTT_SN_TEST_SHORT_TOPIC_NAME);
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttSnSubscribe(CELLULAR_MQTT_SN_AT_MOST_ONCE,
+                                                      NULL, &shortTopic) >= 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttSnPublish(CELLULAR_MQTT_SN_SEND_AND_FORGET,
+                                                    false, &shortTopic, gPublishData,
+                                                    sizeof(gPublishData) - 1) == 0);
+    if (waitUnread()) {
+        // QoS -1 is not guaranteed to arrive but if it does
+        // it should be right
+        sizeBytes = sizeof(gBuffer);
+        CELLULAR_PORT_TEST_ASSERT(cellularMqttSnMessageRead(&readTopic, gBuffer,
+                                                            &sizeBytes, NULL) == 0);
+        CELLULAR_PORT_TEST_ASSERT(readTopic.type == CELLULAR_MQTT_SN_TOPIC_SHORT);
+        CELLULAR_PORT_TEST_ASSERT(cellularPort_strcmp(readTopic.shortName,
+                                                      CELLULAR_MQTT_SN_TEST_SHORT_TOPIC_NAME) == 0);
+        CELLULAR_PORT_TEST_ASSERT(sizeBytes == sizeof(gPublishData) - 1);
+    }
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttSnUnsubscribe(NULL, &shortTopic) == 0);
+
+    // Sleep, still connected, then wake
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttSnSleep(60) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttSnIsConnected());
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttSnIsAsleep());
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttSnWake() == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttSnConnect() == 0);
+    CELLULAR_PORT_TEST_ASSERT(!cellularMqttSnIsAsleep());
+
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttSnUnsubscribe(CELLULAR_MQTT_SN_TEST_TOPIC_NAME,
+                                                        NULL) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularMqttSnDisconnect() == 0);
+    CELLULAR_PORT_TEST_ASSERT(!cellularMqttSnIsConnected());
+
+    cellularMqttSnDeinit();
+    cellularCtrlDisconnect();
+    cellularCtrlPowerOff(NULL);
+    cellularCtrlDeinit();
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartDeinit(CELLULAR_CFG_UART) == 0);
+    cellularPortDeinit();
+}
+
+/** Clean-up to be run at the end of this round of tests, just
+ * in case there were test failures which would have resulted
+ * in the deinitialisation being skipped.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularMqttSnTestCleanUp(),
+                            "mqttSnCleanUp",
+                            "mqttSn")
+{
+    cellularMqttSnDeinit();
+    cellularCtrlDeinit();
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartDeinit(CELLULAR_CFG_UART) == 0);
+    cellularPortDeinit();
+}
+
+#endif // CELLULAR_MQTT_SN_IS_SUPPORTED
+
+// End of file
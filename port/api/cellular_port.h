@@ -98,15 +98,57 @@ int32_t cellularPortInit();
 void cellularPortDeinit();
 
 /** Get the current OS tick converted to a time in milliseconds.
- * This is guaranteed to be unaffected by any time setting activity
- * It is NOT maintained while the processor is sleeping; port
- * initialisation must be called on return from sleep and
- * that will restart this time from zero once more.
+ * This is guaranteed to be unaffected by any time setting activity.
+ * It is maintained while the RTOS sleeps in tickless idle, on the
+ * platforms that support it, but NOT across a sleep from which
+ * the processor returns through a reset; port initialisation must
+ * be called on return from such a sleep and that may restart this
+ * time from zero once more.  Must not be called from interrupt
+ * context.
  *
  * @return the current OS tick converted to milliseconds.
  */
 int64_t cellularPortGetTickTimeMs();
 
+/** Store a small block of data in non-volatile storage so that
+ * it is there after a power cycle, replacing anything previously
+ * stored under the same ID.  This is optional: a platform with
+ * nothing suitable returns CELLULAR_PORT_NOT_IMPLEMENTED and
+ * callers must cope with that.
+ *
+ * @param id    an ID for the block of data, 0 to 15.
+ * @param pData the data to store.
+ * @param size  the amount of data at pData in bytes.
+ * @return      zero on success else negative error code.
+ */
+int32_t cellularPortNvStore(int32_t id, const void *pData,
+                            size_t size);
+
+/** Retrieve a block of data stored with cellularPortNvStore().
+ *
+ * @param id    the ID of the block of data, 0 to 15.
+ * @param pData a place to put the data.
+ * @param size  the amount of storage at pData in bytes.
+ * @return      on success the number of bytes retrieved, else
+ *              negative error code.
+ */
+int32_t cellularPortNvRetrieve(int32_t id, void *pData,
+                               size_t size);
+
+/** Start the task behind cellularPortLogDeferred() (see
+ * cellular_port_debug.h); called by
+ * cellularPortInit(), there is no need for the application to
+ * call this.  Does nothing without CELLULAR_CFG_LOG_DEFERRED.
+ *
+ * @return zero on success else negative error code.
+ */
+int32_t cellularPortLogDeferredInit();
+
+/** Emit any messages still stored by cellularPortLogDeferred()
+ * and stop its task; called by cellularPortDeinit().
+ */
+void cellularPortLogDeferredDeinit();
+
 #ifdef __cplusplus
 }
 #endif
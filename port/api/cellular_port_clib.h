@@ -56,6 +56,46 @@ extern "C" {
  * TYPES
  * -------------------------------------------------------------- */
 
+/** The callers of pCellularPort_mallocTag(), under which memory
+ * use is accounted.
+ */
+typedef enum {
+    CELLULAR_PORT_MALLOC_TAG_OTHER = 0, //<! Includes pCellularPort_malloc().
+    CELLULAR_PORT_MALLOC_TAG_PORT = 1,
+    CELLULAR_PORT_MALLOC_TAG_AT = 2,
+    CELLULAR_PORT_MALLOC_TAG_CTRL = 3,
+    CELLULAR_PORT_MALLOC_TAG_CMUX = 4,
+    CELLULAR_PORT_MALLOC_TAG_SOCK = 5,
+    CELLULAR_PORT_MALLOC_TAG_MQTT = 6,
+    CELLULAR_PORT_MALLOC_TAG_HTTP = 7,
+    CELLULAR_PORT_MALLOC_TAG_MQTT_SN = 8,
+    MAX_NUM_CELLULAR_PORT_MALLOC_TAGS
+} CellularPortMallocTag_t;
+
+/** Memory use by one tag, see cellularPortMallocGetTagStats().
+ * Sizes are those asked for, not including any rounding up
+ * to a pool block.
+ */
+typedef struct {
+    size_t inUseBytes;    //<! Memory currently allocated.
+    size_t maxInUseBytes; //<! High-water mark of inUseBytes.
+    int32_t numAllocs;    //<! Number of successful allocations.
+    int32_t numHeap;      //<! How many of numAllocs were not from a pool.
+    int32_t numFailures;  //<! Number of failed allocations.
+} CellularPortMallocTagStats_t;
+
+/** The state of one pool of fixed-size blocks, see
+ * cellularPortMallocGetPoolStats().
+ */
+typedef struct {
+    size_t blockSizeBytes; //<! The largest allocation a block holds.
+    int32_t numBlocks;     //<! The number of blocks in the pool.
+    int32_t numInUse;      //<! Blocks currently allocated.
+    int32_t maxInUse;      //<! High-water mark of numInUse.
+    int32_t numOverflows;  //<! Allocations that fitted this pool but
+                           //< went to the heap as it was empty.
+} CellularPortMallocPoolStats_t;
+
 /** struct tm.
  */
  typedef struct {
@@ -89,6 +129,56 @@ void cellularPort_free(void *pMem);
  */
 void *pCellularPort_malloc(size_t sizeBytes);
 
+/** malloc(), accounting the memory to the given tag.  With
+ * CELLULAR_CFG_PORT_MALLOC_POOL the memory is taken from the
+ * smallest pool of fixed-size blocks that fits, falling back
+ * to the heap if that pool is empty, else the tag is ignored.
+ * Free the memory with cellularPort_free() as usual.
+ *
+ * @param size the number of bytes to allocate.
+ * @param tag  the tag to account the memory to.
+ * @return     a pointer to the memory allocated or NULL on failure.
+ */
+void *pCellularPort_mallocTag(size_t sizeBytes,
+                              CellularPortMallocTag_t tag);
+
+/** Set up the pools behind pCellularPort_mallocTag(); called by
+ * cellularPortInit(), there is no need for the application to
+ * call this.  Until it has been called all memory comes from
+ * the heap.
+ *
+ * @return zero on success else negative error code.
+ */
+int32_t cellularPortMallocInit();
+
+/** Get the memory use of a tag; only available with
+ * CELLULAR_CFG_PORT_MALLOC_POOL.
+ *
+ * @param tag    the tag.
+ * @param pStats a place to put the statistics; cannot be NULL.
+ * @return       zero on success else negative error code.
+ */
+int32_t cellularPortMallocGetTagStats(CellularPortMallocTag_t tag,
+                                      CellularPortMallocTagStats_t *pStats);
+
+/** Get the state of a pool; only available with
+ * CELLULAR_CFG_PORT_MALLOC_POOL.
+ *
+ * @param index  the index of the pool, starting at zero with
+ *               the pool of smallest blocks; a pool with no
+ *               blocks is still reported.
+ * @param pStats a place to put the statistics; cannot be NULL.
+ * @return       zero on success, negative error code if there
+ *               is no such pool.
+ */
+int32_t cellularPortMallocGetPoolStats(size_t index,
+                                       CellularPortMallocPoolStats_t *pStats);
+
+/** Reset the counters and bring the high-water marks of
+ * the tag and pool statistics down to the current level.
+ */
+void cellularPortMallocResetStats();
+
 /** memcpy().
  *
  * @param pDst      the destination address.
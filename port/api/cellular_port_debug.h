@@ -30,15 +30,52 @@ extern "C" {
  * COMPILE-TIME MACROS
  * -------------------------------------------------------------- */
 
+/** The log levels: a message is emitted only if its level is
+ * at or below the log level threshold of the module it is in,
+ * see CELLULAR_CFG_LOG_LEVEL in cellular_cfg_sw.h.
+ */
+#define CELLULAR_PORT_LOG_LEVEL_NONE  0
+#define CELLULAR_PORT_LOG_LEVEL_ERROR 1
+#define CELLULAR_PORT_LOG_LEVEL_WARN  2
+#define CELLULAR_PORT_LOG_LEVEL_INFO  3
+#define CELLULAR_PORT_LOG_LEVEL_DEBUG 4
+
+/** The log level threshold of the module being compiled: a
+ * module defines this, before its #includes, to its
+ * CELLULAR_CFG_LOG_LEVEL_xxx.
+ */
+#ifndef CELLULAR_PORT_LOG_THRESHOLD
+# define CELLULAR_PORT_LOG_THRESHOLD CELLULAR_CFG_LOG_LEVEL
+#endif
+
 /** Define this to enable debug prints.  How they leave the building
- * depends upon the port.
+ * depends upon the port.  A message above the log level threshold
+ * is a constant-false condition, so the compiler removes it and
+ * its format string entirely.
  */
 #if defined(CELLULAR_CFG_ENABLE_LOGGING) && CELLULAR_CFG_ENABLE_LOGGING
-# define cellularPortLog(format, ...) cellularPortLogF(format, ##__VA_ARGS__)
+# if defined(CELLULAR_CFG_LOG_DEFERRED) && CELLULAR_CFG_LOG_DEFERRED
+#  define CELLULAR_PORT_LOG_F cellularPortLogDeferred
+# else
+#  define CELLULAR_PORT_LOG_F cellularPortLogF
+# endif
+# define cellularPortLogLevel(level, format, ...)         \
+    do {                                                  \
+        if ((level) <= (CELLULAR_PORT_LOG_THRESHOLD)) {   \
+            CELLULAR_PORT_LOG_F(format, ##__VA_ARGS__);   \
+        }                                                 \
+    } while (0)
 #else
-# define cellularPortLog(...)
+# define cellularPortLogLevel(...)
 #endif
 
+/** Log at a given level; cellularPortLog() is information.
+ */
+#define cellularPortLogError(format, ...) cellularPortLogLevel(CELLULAR_PORT_LOG_LEVEL_ERROR, format, ##__VA_ARGS__)
+#define cellularPortLogWarn(format, ...)  cellularPortLogLevel(CELLULAR_PORT_LOG_LEVEL_WARN, format, ##__VA_ARGS__)
+#define cellularPortLog(format, ...)      cellularPortLogLevel(CELLULAR_PORT_LOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#define cellularPortLogDebug(format, ...) cellularPortLogLevel(CELLULAR_PORT_LOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
+
 /* ----------------------------------------------------------------
  * TYPES
  * -------------------------------------------------------------- */
@@ -54,6 +91,22 @@ extern "C" {
  */
 void cellularPortLogF(const char *pFormat, ...);
 
+/** As cellularPortLogF() but, with CELLULAR_CFG_LOG_DEFERRED,
+ * the format and arguments are stored in a ring buffer and
+ * formatted later by a low priority task; pFormat must therefore
+ * be a string that stays put, e.g. a literal.  The conversions
+ * of C99 printf() are supported other than "%n" and "%L".
+ * Before cellularPortLogDeferredInit() has been called, or
+ * without CELLULAR_CFG_LOG_DEFERRED, the message is emitted
+ * straight away.  The logging macros above call this when
+ * CELLULAR_CFG_LOG_DEFERRED is 1, there is no need to call it
+ * directly.
+ *
+ * @param pFormat a printf() style format string.
+ * @param ...     variable argument list.
+ */
+void cellularPortLogDeferred(const char *pFormat, ...);
+
 #ifdef __cplusplus
 }
 #endif
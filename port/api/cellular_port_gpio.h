@@ -73,6 +73,16 @@ typedef enum {
     MAX_NUM_CELLULAR_PORT_GPIO_DRIVE_CAPABILITIES
 } CellularPortGpioDriveCapability_t;
 
+/** The possible GPIO interrupt triggers.
+ */
+typedef enum {
+    CELLULAR_PORT_GPIO_INTERRUPT_NONE,
+    CELLULAR_PORT_GPIO_INTERRUPT_RISING_EDGE,
+    CELLULAR_PORT_GPIO_INTERRUPT_FALLING_EDGE,
+    CELLULAR_PORT_GPIO_INTERRUPT_BOTH_EDGES,
+    MAX_NUM_CELLULAR_PORT_GPIO_INTERRUPTS
+} CellularPortGpioInterrupt_t;
+
 /** GPIO configuration structure.
  * If you update this, don't forget to update
  * CELLULAR_PORT_GPIO_CONFIG_DEFAULT also.
@@ -119,6 +129,33 @@ int32_t cellularPortGpioSet(int32_t pin, int32_t level);
  */
 int32_t cellularPortGpioGet(int32_t pin);
 
+/** Set or remove an edge interrupt on a GPIO that has been
+ * configured as an input.  When the edge occurs the pin number,
+ * an int32_t, is sent to queueHandle from interrupt context, so
+ * the queue must have been created by cellularPortQueueCreate()
+ * with an item size of sizeof(int32_t); a task may then block
+ * on the queue rather than polling the pin.  If the queue is
+ * full the edge is lost, so the receiver should read the pin
+ * with cellularPortGpioGet() once woken rather than count
+ * edges.  Where the platform is able to, the pin is also made
+ * a source of wake-up from low-power sleep while the interrupt
+ * is set.
+ *
+ * @param pin         the pin.
+ * @param interrupt   the edge(s) to interrupt on;
+ *                    CELLULAR_PORT_GPIO_INTERRUPT_NONE removes
+ *                    the interrupt.
+ * @param queueHandle the queue to send the pin number to, may
+ *                    be NULL if interrupt is
+ *                    CELLULAR_PORT_GPIO_INTERRUPT_NONE.
+ * @return            zero on success else negative error code;
+ *                    CELLULAR_PORT_NOT_IMPLEMENTED if the
+ *                    platform has no GPIO interrupts.
+ */
+int32_t cellularPortGpioInterruptSet(int32_t pin,
+                                     CellularPortGpioInterrupt_t interrupt,
+                                     CellularPortQueueHandle_t queueHandle);
+
 #ifdef __cplusplus
 }
 #endif
@@ -110,6 +110,18 @@ bool cellularPortTaskIsThis(const CellularPortTaskHandle_t taskHandle);
  */
 void cellularPortTaskBlock(int32_t delayMs);
 
+/** Get the minimum amount of stack that has ever been free for
+ * a task, i.e. how close the task has come to running out of
+ * stack since it was created: useful when working out how
+ * small a task's stack can safely be made.
+ *
+ * @param taskHandle  the handle of the task to check; use NULL
+ *                    for the current task.
+ * @return            the minimum free stack in bytes else
+ *                    negative error code.
+ */
+int32_t cellularPortTaskStackMinFree(const CellularPortTaskHandle_t taskHandle);
+
 /* ----------------------------------------------------------------
  * FUNCTIONS: QUEUES
  * -------------------------------------------------------------- */
@@ -28,7 +28,8 @@
  * -------------------------------------------------------------- */
 
 #ifndef CELLULAR_PORT_UART_RX_BUFFER_SIZE
-/** The size of ring buffer to use for receive.
+/** The default size of ring buffer to use for receive, see
+ * also cellularPortUartSetRxBufferSize().
  * This is set to accommodate the maximum length of a single
  * AT response from a cellular module.
  */
@@ -47,6 +48,21 @@
  * TYPES
  * -------------------------------------------------------------- */
 
+/** Receive statistics for a UART, accumulated since the UART was
+ * initialised or cellularPortUartResetStats() was last called;
+ * these are intended to help in choosing a receive buffer size
+ * that suits the traffic.
+ */
+typedef struct {
+    size_t rxBufferSizeBytes;    //!< the size of the receive buffer.
+    size_t rxHighWaterMarkBytes; //!< the most data ever seen waiting in the receive buffer.
+    uint32_t rxOverruns;         //!< the number of times received data has been lost.
+    uint32_t rxBytesLost;        //!< the number of bytes known to have been lost,
+                                 //   which may be less than the number actually
+                                 //   lost on platforms that can only detect
+                                 //   that an overrun has happened.
+} CellularPortUartStats_t;
+
 /* ----------------------------------------------------------------
  * FUNCTIONS
  * -------------------------------------------------------------- */
@@ -64,7 +80,12 @@
  *                        modem; use -1 for none.
  * @param baudRate        the baud rate to use.
  * @param rtsThreshold    the buffer length at which pinRts is
- *                        de-asserted.  Ignored if pinRts is -1.
+ *                        de-asserted; use zero to let the
+ *                        platform choose a value that suits its
+ *                        receive buffering.  Not all platforms
+ *                        are able to adjust this, see the
+ *                        cellular_port_uart.c file for the
+ *                        platform.  Ignored if pinRts is -1.
  * @param uart            the UART number to use.
  * @param pUartQueue      a place to put the UART event queue.
  * @return                zero on success, otherwise negative error code.
@@ -104,6 +125,10 @@ int32_t cellularPortUartEventSend(const CellularPortQueueHandle_t queueHandle,
                                   int32_t sizeBytesOrError);
 
 /** Receive a UART event, blocking until one turns up.
+ * A platform may return zero for received data that is of
+ * no interest to the receive thread yet, e.g. data that
+ * doesn't complete a line where the UART driver can detect
+ * line endings.
  *
  * @param queueHandle the handle for the UART event queue.
  * @return            if the event was a receive event then
@@ -113,6 +138,10 @@ int32_t cellularPortUartEventSend(const CellularPortQueueHandle_t queueHandle,
 int32_t cellularPortUartEventReceive(const CellularPortQueueHandle_t queueHandle);
 
 /** Receive a UART event with a timeout.
+ * A platform may return zero for received data that is of
+ * no interest to the receive thread yet, e.g. data that
+ * doesn't complete a line where the UART driver can detect
+ * line endings.
  *
  * @param queueHandle the handle for the UART event queue.
  * @param waitMs      the time to wait in milliseconds.
@@ -124,6 +153,12 @@ int32_t cellularPortUartEventTryReceive(const CellularPortQueueHandle_t queueHan
                                         int32_t waitMs);
 
 /** Get the number of bytes waiting in the receive buffer.
+ * Note: the receive functions, this one,
+ * cellularPortUartRead(), cellularPortUartReadSpan() and
+ * cellularPortUartReadCommit(), assume a single reader, i.e.
+ * they must not be called from more than one task at a
+ * time; the AT layer meets this by calling them only with
+ * the AT interface locked.
  *
  * @param uart      the UART number to use.
  * @return          the number of bytes in the receive buffer
@@ -144,6 +179,36 @@ int32_t cellularPortUartGetReceiveSize(int32_t uart);
 int32_t cellularPortUartRead(int32_t uart, char *pBuffer,
                              size_t sizeBytes);
 
+/** Get a pointer to the data waiting in the receive buffer
+ * of the given UART interface without copying it out.  Only
+ * the contiguous portion of the waiting data is returned:
+ * where the data wraps around the end of the receive buffer,
+ * call this function again after cellularPortUartReadCommit()
+ * to get the remainder.  The data pointed to remains valid
+ * until cellularPortUartReadCommit() is called.  Not all
+ * platforms are able to support this, in which case
+ * CELLULAR_PORT_NOT_IMPLEMENTED is returned and
+ * cellularPortUartRead() should be used instead.
+ *
+ * @param uart      the UART number to use.
+ * @param ppData    a place to put a pointer to the received
+ *                  data; cannot be NULL.
+ * @return          the number of contiguous bytes available
+ *                  at *ppData or negative error code.
+ */
+int32_t cellularPortUartReadSpan(int32_t uart, const char **ppData);
+
+/** Mark data obtained through cellularPortUartReadSpan() as
+ * read, handing the space back to the receive buffer.
+ *
+ * @param uart      the UART number to use.
+ * @param sizeBytes the number of bytes that have been read;
+ *                  must be no more than was returned by the
+ *                  last call to cellularPortUartReadSpan().
+ * @return          zero on success or negative error code.
+ */
+int32_t cellularPortUartReadCommit(int32_t uart, size_t sizeBytes);
+
 /** Write to the given UART interface.  The function will
  * block until all the data has been written.
  *
@@ -157,6 +222,83 @@ int32_t cellularPortUartWrite(int32_t uart,
                               const char *pBuffer,
                               size_t sizeBytes);
 
+/** Change the baud rate of the given UART interface
+ * without otherwise disturbing it: the event queue and
+ * any data already in the receive buffer are kept.  Any
+ * transmission in progress is allowed to complete first.
+ *
+ * @param uart      the UART number to use.
+ * @param baudRate  the new baud rate.
+ * @return          zero on success or negative error code.
+ */
+int32_t cellularPortUartSetBaudRate(int32_t uart,
+                                    int32_t baudRate);
+
+/** Set the size of the receive buffer that the next call to
+ * cellularPortUartInit() for the given UART will use, in place
+ * of CELLULAR_PORT_UART_RX_BUFFER_SIZE; the setting persists
+ * across cellularPortUartDeinit().  The UART must not be
+ * initialised when this is called.  A platform may round the
+ * size down to suit its hardware, the size actually in use can
+ * be read back with cellularPortUartGetStats().
+ *
+ * @param uart      the UART number.
+ * @param sizeBytes the size of receive buffer to use; zero
+ *                  reverts to CELLULAR_PORT_UART_RX_BUFFER_SIZE.
+ * @return          zero on success or negative error code.
+ */
+int32_t cellularPortUartSetRxBufferSize(int32_t uart,
+                                        size_t sizeBytes);
+
+/** Get the receive statistics of a UART.
+ *
+ * @param uart   the UART number.
+ * @param pStats a place to put the statistics; cannot be NULL.
+ * @return       zero on success or negative error code.
+ */
+int32_t cellularPortUartGetStats(int32_t uart,
+                                 CellularPortUartStats_t *pStats);
+
+/** Reset the receive statistics of a UART.
+ *
+ * @param uart the UART number.
+ * @return     zero on success or negative error code.
+ */
+int32_t cellularPortUartResetStats(int32_t uart);
+
+/** Suspend reception on a UART to save power, e.g. because the
+ * module at the far end is asleep.  While suspended the UART
+ * hardware is stopped; reception resumes automatically when
+ * the far end starts to send, when cellularPortUartWrite() is
+ * called, or when cellularPortUartResume() is called.  Since
+ * it is the start of the first character from the far end that
+ * wakes the UART the first character received after
+ * suspension may be lost; this is harmless if, for instance,
+ * the far end is a module which begins everything it sends
+ * with "\r\n".  A UART can only be suspended when there is no
+ * received data waiting to be read; anything that arrives
+ * while the UART is being suspended is discarded and counted
+ * in the rxBytesLost statistic.
+ *
+ * @param uart the UART number.
+ * @return     zero on success, CELLULAR_PORT_NOT_IMPLEMENTED
+ *             if the platform does not support suspension or
+ *             another negative error code, e.g. if there is
+ *             received data waiting to be read.
+ */
+int32_t cellularPortUartSuspend(int32_t uart);
+
+/** Resume a UART that has been suspended with
+ * cellularPortUartSuspend(); does nothing if the UART is
+ * not suspended.
+ *
+ * @param uart the UART number.
+ * @return     zero on success, CELLULAR_PORT_NOT_IMPLEMENTED
+ *             if the platform does not support suspension or
+ *             another negative error code.
+ */
+int32_t cellularPortUartResume(int32_t uart);
+
 /** Determine if RTS flow control, i.e. signalling from
  * the module to this software that the module is ready to
  * receive data, is enabled.
@@ -17,8 +17,10 @@
 #ifdef CELLULAR_CFG_OVERRIDE
 # include "cellular_cfg_override.h" // For a customer's configuration override
 #endif
+#include "cellular_cfg_sw.h"
 #include "cellular_port_clib.h"
 #include "cellular_port.h"
+#include "cellular_port_os.h"
 
 #include "stdlib.h" // For malloc(), free(), strtof(), strtol()
 #include "string.h"
@@ -34,18 +36,110 @@
  * COMPILE-TIME MACROS
  * -------------------------------------------------------------- */
 
+#if CELLULAR_CFG_PORT_MALLOC_POOL
+/** The number of pools, one for each of the
+ * CELLULAR_CFG_PORT_MALLOC_POOL_NUM_xxx block sizes.
+ */
+# define CELLULAR_PORT_MALLOC_NUM_POOLS 7
+
+/** The pool index in a header for memory from the heap.
+ */
+# define CELLULAR_PORT_MALLOC_POOL_HEAP 0xFF
+
+/** The tag in a header for memory allocated before
+ * cellularPortMallocInit(), which is not accounted.
+ */
+# define CELLULAR_PORT_MALLOC_TAG_NONE 0xFF
+
+/** The amount of storage needed for a number of blocks of
+ * a given size, each with its header.
+ */
+# define CELLULAR_PORT_MALLOC_POOL_BYTES(size, num) (((size) + sizeof(CellularPortMallocHeader_t)) * (num))
+
+/** The storage needed for all of the pools.
+ */
+# define CELLULAR_PORT_MALLOC_POOL_STORAGE_BYTES (CELLULAR_PORT_MALLOC_POOL_BYTES(32, CELLULAR_CFG_PORT_MALLOC_POOL_NUM_32) +     \
+                                                 CELLULAR_PORT_MALLOC_POOL_BYTES(64, CELLULAR_CFG_PORT_MALLOC_POOL_NUM_64) +     \
+                                                 CELLULAR_PORT_MALLOC_POOL_BYTES(128, CELLULAR_CFG_PORT_MALLOC_POOL_NUM_128) +   \
+                                                 CELLULAR_PORT_MALLOC_POOL_BYTES(256, CELLULAR_CFG_PORT_MALLOC_POOL_NUM_256) +   \
+                                                 CELLULAR_PORT_MALLOC_POOL_BYTES(512, CELLULAR_CFG_PORT_MALLOC_POOL_NUM_512) +   \
+                                                 CELLULAR_PORT_MALLOC_POOL_BYTES(1024, CELLULAR_CFG_PORT_MALLOC_POOL_NUM_1024) + \
+                                                 CELLULAR_PORT_MALLOC_POOL_BYTES(2048, CELLULAR_CFG_PORT_MALLOC_POOL_NUM_2048))
+#endif
+
 /* ----------------------------------------------------------------
  * TYPES
  * -------------------------------------------------------------- */
 
+#if CELLULAR_CFG_PORT_MALLOC_POOL
+/** The header in front of every allocation, eight bytes long
+ * so that the memory handed out keeps the alignment of the
+ * heap.  A free pool block keeps the pointer to the next free
+ * block just after its header.
+ */
+typedef struct {
+    uint32_t sizeBytes;
+    uint8_t tag;
+    uint8_t pool;
+    uint16_t spare;
+} CellularPortMallocHeader_t;
+#endif
+
 /* ----------------------------------------------------------------
  * VARIABLES
  * -------------------------------------------------------------- */
 
+#if CELLULAR_CFG_PORT_MALLOC_POOL
+/** Mutex protecting the pools and statistics; once created
+ * it is never deleted since memory may be freed at any time.
+ */
+static CellularPortMutexHandle_t gMallocMutex = NULL;
+
+/** The storage for the pools.
+ */
+static uint64_t gMallocPoolStorage[(CELLULAR_PORT_MALLOC_POOL_STORAGE_BYTES /
+                                    sizeof(uint64_t)) + 1];
+
+/** The block size of each pool, smallest first.
+ */
+static const size_t gMallocPoolBlockSizeBytes[CELLULAR_PORT_MALLOC_NUM_POOLS] = {32, 64, 128, 256,
+                                                                                 512, 1024, 2048};
+
+/** The number of blocks in each pool.
+ */
+static const int32_t gMallocPoolNumBlocks[CELLULAR_PORT_MALLOC_NUM_POOLS] = {CELLULAR_CFG_PORT_MALLOC_POOL_NUM_32,
+                                                                             CELLULAR_CFG_PORT_MALLOC_POOL_NUM_64,
+                                                                             CELLULAR_CFG_PORT_MALLOC_POOL_NUM_128,
+                                                                             CELLULAR_CFG_PORT_MALLOC_POOL_NUM_256,
+                                                                             CELLULAR_CFG_PORT_MALLOC_POOL_NUM_512,
+                                                                             CELLULAR_CFG_PORT_MALLOC_POOL_NUM_1024,
+                                                                             CELLULAR_CFG_PORT_MALLOC_POOL_NUM_2048};
+
+/** The first free block of each pool.
+ */
+static CellularPortMallocHeader_t *gpMallocPoolFree[CELLULAR_PORT_MALLOC_NUM_POOLS];
+
+/** Statistics for each pool.
+ */
+static CellularPortMallocPoolStats_t gMallocPoolStats[CELLULAR_PORT_MALLOC_NUM_POOLS];
+
+/** Statistics for each tag.
+ */
+static CellularPortMallocTagStats_t gMallocTagStats[MAX_NUM_CELLULAR_PORT_MALLOC_TAGS];
+#endif
+
 /* ----------------------------------------------------------------
  * STATIC FUNCTIONS
  * -------------------------------------------------------------- */
 
+#if CELLULAR_CFG_PORT_MALLOC_POOL
+// Get the next free block after a free block.
+static CellularPortMallocHeader_t **ppMallocNext(CellularPortMallocHeader_t *pHeader)
+{
+    return (CellularPortMallocHeader_t **) (pHeader + 1);
+}
+#endif
+
 /* ----------------------------------------------------------------
  * PUBLIC FUNCTIONS: MEMORY
  * -------------------------------------------------------------- */
@@ -53,13 +147,225 @@
 // free().
 void cellularPort_free(void *pMem)
 {
+#if CELLULAR_CFG_PORT_MALLOC_POOL
+    CellularPortMallocHeader_t *pHeader;
+    CellularPortMallocPoolStats_t *pPoolStats;
+
+    if (pMem != NULL) {
+        pHeader = ((CellularPortMallocHeader_t *) pMem) - 1;
+        if (pHeader->tag != CELLULAR_PORT_MALLOC_TAG_NONE) {
+
+            CELLULAR_PORT_MUTEX_LOCK(gMallocMutex);
+
+            gMallocTagStats[pHeader->tag].inUseBytes -= pHeader->sizeBytes;
+            if (pHeader->pool != CELLULAR_PORT_MALLOC_POOL_HEAP) {
+                pPoolStats = &(gMallocPoolStats[pHeader->pool]);
+                pPoolStats->numInUse--;
+                *ppMallocNext(pHeader) = gpMallocPoolFree[pHeader->pool];
+                gpMallocPoolFree[pHeader->pool] = pHeader;
+                pHeader = NULL;
+            }
+
+            CELLULAR_PORT_MUTEX_UNLOCK(gMallocMutex);
+        }
+        // Anything left came from the heap
+        free(pHeader);
+    }
+#else
     free(pMem);
+#endif
 }
 
 // malloc().
 void *pCellularPort_malloc(size_t sizeBytes)
 {
+    return pCellularPort_mallocTag(sizeBytes, CELLULAR_PORT_MALLOC_TAG_OTHER);
+}
+
+// malloc() with a tag.
+void *pCellularPort_mallocTag(size_t sizeBytes,
+                              CellularPortMallocTag_t tag)
+{
+#if CELLULAR_CFG_PORT_MALLOC_POOL
+    CellularPortMallocHeader_t *pHeader = NULL;
+    CellularPortMallocTagStats_t *pTagStats;
+    CellularPortMallocPoolStats_t *pPoolStats;
+    size_t pool = 0;
+
+    if ((tag < 0) || (tag >= MAX_NUM_CELLULAR_PORT_MALLOC_TAGS)) {
+        tag = CELLULAR_PORT_MALLOC_TAG_OTHER;
+    }
+    // Find the smallest pool that fits
+    while ((pool < CELLULAR_PORT_MALLOC_NUM_POOLS) &&
+           (sizeBytes > gMallocPoolBlockSizeBytes[pool])) {
+        pool++;
+    }
+
+    if (gMallocMutex != NULL) {
+
+        CELLULAR_PORT_MUTEX_LOCK(gMallocMutex);
+
+        pTagStats = &(gMallocTagStats[tag]);
+        if (pool < CELLULAR_PORT_MALLOC_NUM_POOLS) {
+            pPoolStats = &(gMallocPoolStats[pool]);
+            pHeader = gpMallocPoolFree[pool];
+            if (pHeader != NULL) {
+                gpMallocPoolFree[pool] = *ppMallocNext(pHeader);
+                pHeader->pool = (uint8_t) pool;
+                pPoolStats->numInUse++;
+                if (pPoolStats->numInUse > pPoolStats->maxInUse) {
+                    pPoolStats->maxInUse = pPoolStats->numInUse;
+                }
+            } else {
+                pPoolStats->numOverflows++;
+            }
+        }
+        if (pHeader == NULL) {
+            pHeader = (CellularPortMallocHeader_t *) malloc(sizeof(*pHeader) + sizeBytes);
+            if (pHeader != NULL) {
+                pHeader->pool = CELLULAR_PORT_MALLOC_POOL_HEAP;
+                pTagStats->numHeap++;
+            }
+        }
+        if (pHeader != NULL) {
+            pHeader->sizeBytes = (uint32_t) sizeBytes;
+            pHeader->tag = (uint8_t) tag;
+            pTagStats->numAllocs++;
+            pTagStats->inUseBytes += sizeBytes;
+            if (pTagStats->inUseBytes > pTagStats->maxInUseBytes) {
+                pTagStats->maxInUseBytes = pTagStats->inUseBytes;
+            }
+        } else {
+            pTagStats->numFailures++;
+        }
+
+        CELLULAR_PORT_MUTEX_UNLOCK(gMallocMutex);
+
+    } else {
+        // Not initialised yet, just use the heap
+        pHeader = (CellularPortMallocHeader_t *) malloc(sizeof(*pHeader) + sizeBytes);
+        if (pHeader != NULL) {
+            pHeader->sizeBytes = (uint32_t) sizeBytes;
+            pHeader->tag = CELLULAR_PORT_MALLOC_TAG_NONE;
+            pHeader->pool = CELLULAR_PORT_MALLOC_POOL_HEAP;
+        }
+    }
+
+    return (pHeader != NULL) ? (void *) (pHeader + 1) : NULL;
+#else
+    (void) tag;
     return malloc(sizeBytes);
+#endif
+}
+
+// Initialise the pools.
+int32_t cellularPortMallocInit()
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_SUCCESS;
+#if CELLULAR_CFG_PORT_MALLOC_POOL
+    CellularPortMallocHeader_t *pHeader;
+    char *pStorage = (char *) gMallocPoolStorage;
+
+    if (gMallocMutex == NULL) {
+        // Chain up the blocks of each pool before
+        // anyone can get at them
+        for (size_t x = 0; x < CELLULAR_PORT_MALLOC_NUM_POOLS; x++) {
+            gpMallocPoolFree[x] = NULL;
+            for (int32_t y = 0; y < gMallocPoolNumBlocks[x]; y++) {
+                pHeader = (CellularPortMallocHeader_t *) pStorage;
+                *ppMallocNext(pHeader) = gpMallocPoolFree[x];
+                gpMallocPoolFree[x] = pHeader;
+                pStorage += sizeof(*pHeader) + gMallocPoolBlockSizeBytes[x];
+            }
+        }
+        errorCode = cellularPortMutexCreate(&gMallocMutex);
+    }
+#endif
+
+    return (int32_t) errorCode;
+}
+
+// Get the memory use of a tag.
+int32_t cellularPortMallocGetTagStats(CellularPortMallocTag_t tag,
+                                      CellularPortMallocTagStats_t *pStats)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_NOT_IMPLEMENTED;
+
+#if CELLULAR_CFG_PORT_MALLOC_POOL
+    errorCode = CELLULAR_PORT_NOT_INITIALISED;
+    if (gMallocMutex != NULL) {
+        errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+        if ((tag >= 0) && (tag < MAX_NUM_CELLULAR_PORT_MALLOC_TAGS) &&
+            (pStats != NULL)) {
+
+            CELLULAR_PORT_MUTEX_LOCK(gMallocMutex);
+
+            *pStats = gMallocTagStats[tag];
+            errorCode = CELLULAR_PORT_SUCCESS;
+
+            CELLULAR_PORT_MUTEX_UNLOCK(gMallocMutex);
+        }
+    }
+#else
+    (void) tag;
+    (void) pStats;
+#endif
+
+    return (int32_t) errorCode;
+}
+
+// Get the state of a pool.
+int32_t cellularPortMallocGetPoolStats(size_t index,
+                                       CellularPortMallocPoolStats_t *pStats)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_NOT_IMPLEMENTED;
+
+#if CELLULAR_CFG_PORT_MALLOC_POOL
+    errorCode = CELLULAR_PORT_NOT_INITIALISED;
+    if (gMallocMutex != NULL) {
+        errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+        if ((index < CELLULAR_PORT_MALLOC_NUM_POOLS) && (pStats != NULL)) {
+
+            CELLULAR_PORT_MUTEX_LOCK(gMallocMutex);
+
+            *pStats = gMallocPoolStats[index];
+            pStats->blockSizeBytes = gMallocPoolBlockSizeBytes[index];
+            pStats->numBlocks = gMallocPoolNumBlocks[index];
+            errorCode = CELLULAR_PORT_SUCCESS;
+
+            CELLULAR_PORT_MUTEX_UNLOCK(gMallocMutex);
+        }
+    }
+#else
+    (void) index;
+    (void) pStats;
+#endif
+
+    return (int32_t) errorCode;
+}
+
+// Reset the memory statistics.
+void cellularPortMallocResetStats()
+{
+#if CELLULAR_CFG_PORT_MALLOC_POOL
+    if (gMallocMutex != NULL) {
+
+        CELLULAR_PORT_MUTEX_LOCK(gMallocMutex);
+
+        for (size_t x = 0; x < sizeof(gMallocTagStats) / sizeof(gMallocTagStats[0]); x++) {
+            gMallocTagStats[x].maxInUseBytes = gMallocTagStats[x].inUseBytes;
+            gMallocTagStats[x].numAllocs = 0;
+            gMallocTagStats[x].numHeap = 0;
+            gMallocTagStats[x].numFailures = 0;
+        }
+        for (size_t x = 0; x < sizeof(gMallocPoolStats) / sizeof(gMallocPoolStats[0]); x++) {
+            gMallocPoolStats[x].maxInUse = gMallocPoolStats[x].numInUse;
+            gMallocPoolStats[x].numOverflows = 0;
+        }
+
+        CELLULAR_PORT_MUTEX_UNLOCK(gMallocMutex);
+    }
+#endif
 }
 
 // memcpy().
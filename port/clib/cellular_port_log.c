@@ -0,0 +1,680 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Deferred logging, see cellularPortLogDeferred(): the format and
+ * arguments of each message are packed into a record, the record
+ * is put into a ring buffer and a low priority task takes the
+ * records out again and emits them with cellularPortLogF(), one
+ * conversion at a time.  This is platform independent.
+ */
+
+#ifdef CELLULAR_CFG_OVERRIDE
+# include "cellular_cfg_override.h" // For a customer's configuration override
+#endif
+#include "cellular_cfg_sw.h"
+#include "cellular_cfg_os_platform_specific.h"
+#include "cellular_port_clib.h"
+#include "cellular_port.h"
+#include "cellular_port_debug.h"
+#include "cellular_port_os.h"
+
+#include "stdarg.h" // For va_blah
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS
+ * -------------------------------------------------------------- */
+
+/** The most that one record, the format pointer and the
+ * arguments, may take; a string argument that doesn't fit is
+ * truncated, any arguments after it are lost and "..." is
+ * emitted in their place.
+ */
+#define CELLULAR_PORT_LOG_RECORD_MAX_SIZE_BYTES 128
+
+/** The longest conversion specification, e.g. "%-08.3lld",
+ * once any "*" has been replaced by its value.
+ */
+#define CELLULAR_PORT_LOG_SPEC_MAX_LENGTH_BYTES 24
+
+/** The length of the queue of commands to the log task: one
+ * wake plus one exit.
+ */
+#define CELLULAR_PORT_LOG_QUEUE_LENGTH 2
+
+/* ----------------------------------------------------------------
+ * TYPES
+ * -------------------------------------------------------------- */
+
+/** The type of the argument that a conversion takes.
+ */
+typedef enum {
+    CELLULAR_PORT_LOG_ARG_NONE, //!< e.g. "%%".
+    CELLULAR_PORT_LOG_ARG_INT,
+    CELLULAR_PORT_LOG_ARG_LONG,
+    CELLULAR_PORT_LOG_ARG_LONG_LONG,
+    CELLULAR_PORT_LOG_ARG_SIZE,
+    CELLULAR_PORT_LOG_ARG_DOUBLE,
+    CELLULAR_PORT_LOG_ARG_POINTER,
+    CELLULAR_PORT_LOG_ARG_STRING
+} CellularPortLogArg_t;
+
+/** A conversion specification in a format string.
+ */
+typedef struct {
+    size_t length;            //!< From the '%' to the conversion character inclusive.
+    CellularPortLogArg_t arg;
+    size_t numStars;          //!< The number of int arguments for width/precision.
+    int32_t precision;        //!< -1 if none or if it is a '*'.
+    bool precisionIsStar;
+} CellularPortLogSpec_t;
+
+/** Commands to the log task.
+ */
+typedef enum {
+    CELLULAR_PORT_LOG_COMMAND_WAKE,
+    CELLULAR_PORT_LOG_COMMAND_EXIT
+} CellularPortLogCommand_t;
+
+/* ----------------------------------------------------------------
+ * VARIABLES
+ * -------------------------------------------------------------- */
+
+#if CELLULAR_CFG_LOG_DEFERRED
+
+/** Mutex protecting the ring buffer, NULL until
+ * cellularPortLogDeferredInit() has been called.
+ */
+static CellularPortMutexHandle_t gLogMutex = NULL;
+
+/** true while messages are to be put in the ring buffer
+ * rather than emitted straight away.
+ */
+static volatile bool gLogDeferring = false;
+
+/** Mutex held by the log task while it is running.
+ */
+static CellularPortMutexHandle_t gLogMutexTaskRunning = NULL;
+
+/** The queue of commands to the log task.
+ */
+static CellularPortQueueHandle_t gLogQueue = NULL;
+
+/** The ring buffer: each record is preceded by a byte giving
+ * its size.
+ */
+static char gLogBuffer[CELLULAR_CFG_LOG_DEFERRED_BUFFER_SIZE_BYTES];
+
+/** Where the next record is written in gLogBuffer.
+ */
+static size_t gLogWriteIndex = 0;
+
+/** Where the next record is read from gLogBuffer.
+ */
+static size_t gLogReadIndex = 0;
+
+/** The number of bytes in gLogBuffer.
+ */
+static size_t gLogNumBytes = 0;
+
+/** The number of messages lost since the last was emitted.
+ */
+static int32_t gLogNumLost = 0;
+
+/** true while a wake is on gLogQueue.
+ */
+static bool gLogWakePending = false;
+
+#endif
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS: RECORDS
+ * -------------------------------------------------------------- */
+
+// Parse the conversion specification at pFormat, which points
+// at a '%'.
+static void logSpecParse(const char *pFormat, CellularPortLogSpec_t *pSpec)
+{
+    const char *p = pFormat + 1;
+    size_t numLongs = 0;
+    bool isSize = false;
+
+    pSpec->arg = CELLULAR_PORT_LOG_ARG_NONE;
+    pSpec->numStars = 0;
+    pSpec->precision = -1;
+    pSpec->precisionIsStar = false;
+
+    // Flags
+    while ((*p == '-') || (*p == '+') || (*p == ' ') ||
+           (*p == '#') || (*p == '0')) {
+        p++;
+    }
+    // Width
+    if (*p == '*') {
+        pSpec->numStars++;
+        p++;
+    } else {
+        while ((*p >= '0') && (*p <= '9')) {
+            p++;
+        }
+    }
+    // Precision
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            pSpec->numStars++;
+            pSpec->precisionIsStar = true;
+            p++;
+        } else {
+            pSpec->precision = 0;
+            while ((*p >= '0') && (*p <= '9')) {
+                pSpec->precision = (pSpec->precision * 10) + (*p - '0');
+                p++;
+            }
+        }
+    }
+    // Length modifier
+    while ((*p == 'h') || (*p == 'l') || (*p == 'z') ||
+           (*p == 'j') || (*p == 't')) {
+        if (*p == 'l') {
+            numLongs++;
+        } else if (*p == 'j') {
+            numLongs = 2;
+        } else if ((*p == 'z') || (*p == 't')) {
+            isSize = true;
+        }
+        p++;
+    }
+    // Conversion
+    switch (*p) {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+        case 'c':
+            pSpec->arg = CELLULAR_PORT_LOG_ARG_INT;
+            if (isSize) {
+                pSpec->arg = CELLULAR_PORT_LOG_ARG_SIZE;
+            } else if (numLongs == 1) {
+                pSpec->arg = CELLULAR_PORT_LOG_ARG_LONG;
+            } else if (numLongs > 1) {
+                pSpec->arg = CELLULAR_PORT_LOG_ARG_LONG_LONG;
+            }
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            pSpec->arg = CELLULAR_PORT_LOG_ARG_DOUBLE;
+            break;
+        case 'p':
+            pSpec->arg = CELLULAR_PORT_LOG_ARG_POINTER;
+            break;
+        case 's':
+            pSpec->arg = CELLULAR_PORT_LOG_ARG_STRING;
+            break;
+        default:
+            break;
+    }
+    if (*p != 0) {
+        p++;
+    }
+
+    pSpec->length = p - pFormat;
+}
+
+// Add sizeBytes from pData to the record at pRecord, which already
+// has *pSize bytes in it, returning false if there is no room.
+static bool logRecordAdd(char *pRecord, size_t *pSize,
+                         const void *pData, size_t sizeBytes)
+{
+    bool success = false;
+
+    if (*pSize + sizeBytes <= CELLULAR_PORT_LOG_RECORD_MAX_SIZE_BYTES) {
+        pCellularPort_memcpy(pRecord + *pSize, pData, sizeBytes);
+        *pSize += sizeBytes;
+        success = true;
+    }
+
+    return success;
+}
+
+// Pack pFormat and the arguments it takes into the record at
+// pRecord, which must be CELLULAR_PORT_LOG_RECORD_MAX_SIZE_BYTES
+// long, returning the size of the record.
+static size_t logRecordMake(char *pRecord, const char *pFormat,
+                            va_list args)
+{
+    CellularPortLogSpec_t spec;
+    size_t size = 0;
+    bool room;
+    int intValue;
+    long longValue;
+    long long longLongValue;
+    size_t sizeValue;
+    double doubleValue;
+    void *pPointerValue;
+    const char *pString;
+    size_t length;
+
+    room = logRecordAdd(pRecord, &size, &pFormat, sizeof(pFormat));
+    while (room && (*pFormat != 0)) {
+        if (*pFormat == '%') {
+            logSpecParse(pFormat, &spec);
+            for (size_t x = 0; room && (x < spec.numStars); x++) {
+                intValue = va_arg(args, int);
+                if (spec.precisionIsStar && (x == spec.numStars - 1)) {
+                    spec.precision = intValue;
+                }
+                room = logRecordAdd(pRecord, &size, &intValue, sizeof(intValue));
+            }
+            if (room) {
+                switch (spec.arg) {
+                    case CELLULAR_PORT_LOG_ARG_INT:
+                        intValue = va_arg(args, int);
+                        room = logRecordAdd(pRecord, &size, &intValue, sizeof(intValue));
+                        break;
+                    case CELLULAR_PORT_LOG_ARG_LONG:
+                        longValue = va_arg(args, long);
+                        room = logRecordAdd(pRecord, &size, &longValue, sizeof(longValue));
+                        break;
+                    case CELLULAR_PORT_LOG_ARG_LONG_LONG:
+                        longLongValue = va_arg(args, long long);
+                        room = logRecordAdd(pRecord, &size, &longLongValue, sizeof(longLongValue));
+                        break;
+                    case CELLULAR_PORT_LOG_ARG_SIZE:
+                        sizeValue = va_arg(args, size_t);
+                        room = logRecordAdd(pRecord, &size, &sizeValue, sizeof(sizeValue));
+                        break;
+                    case CELLULAR_PORT_LOG_ARG_DOUBLE:
+                        doubleValue = va_arg(args, double);
+                        room = logRecordAdd(pRecord, &size, &doubleValue, sizeof(doubleValue));
+                        break;
+                    case CELLULAR_PORT_LOG_ARG_POINTER:
+                        pPointerValue = va_arg(args, void *);
+                        room = logRecordAdd(pRecord, &size, &pPointerValue, sizeof(pPointerValue));
+                        break;
+                    case CELLULAR_PORT_LOG_ARG_STRING:
+                        // The string may not be there later: copy
+                        // it, only as far as a precision allows
+                        // since it need not be terminated then,
+                        // truncating it if it doesn't fit
+                        pString = va_arg(args, const char *);
+                        if (pString == NULL) {
+                            pString = "(null)";
+                        }
+                        length = 0;
+                        while ((pString[length] != 0) &&
+                               ((spec.precision < 0) || (length < (size_t) spec.precision)) &&
+                               (size + length + 1 < CELLULAR_PORT_LOG_RECORD_MAX_SIZE_BYTES)) {
+                            length++;
+                        }
+                        room = logRecordAdd(pRecord, &size, pString, length) &&
+                               logRecordAdd(pRecord, &size, "", 1);
+                        break;
+                    default:
+                        break;
+                }
+            }
+            pFormat += spec.length;
+        } else {
+            pFormat++;
+        }
+    }
+
+    return size;
+}
+
+// Take sizeBytes from the record at *ppRecord, which ends at pEnd,
+// moving *ppRecord on, returning false if there aren't enough.
+static bool logRecordTake(const char **ppRecord, const char *pEnd,
+                          void *pData, size_t sizeBytes)
+{
+    bool success = false;
+
+    if (*ppRecord + sizeBytes <= pEnd) {
+        pCellularPort_memcpy(pData, *ppRecord, sizeBytes);
+        *ppRecord += sizeBytes;
+        success = true;
+    }
+
+    return success;
+}
+
+// Emit the record at pRecord, which is sizeBytes long, with
+// cellularPortLogF(): the text between conversions as it is
+// and each conversion with its own argument.
+static void logRecordEmit(const char *pRecord, size_t sizeBytes)
+{
+    const char *pEnd = pRecord + sizeBytes;
+    const char *pFormat;
+    const char *pText;
+    CellularPortLogSpec_t spec;
+    char specStr[CELLULAR_PORT_LOG_SPEC_MAX_LENGTH_BYTES];
+    size_t specLength;
+    bool present;
+    int intValue;
+    long longValue;
+    long long longLongValue;
+    size_t sizeValue;
+    double doubleValue;
+    void *pPointerValue;
+    const char *pString;
+
+    present = logRecordTake(&pRecord, pEnd, &pFormat, sizeof(pFormat));
+    pText = pFormat;
+    while (present && (*pFormat != 0)) {
+        if (*pFormat == '%') {
+            if (pFormat > pText) {
+                cellularPortLogF("%.*s", (int) (pFormat - pText), pText);
+            }
+            logSpecParse(pFormat, &spec);
+            // Copy the specification, putting the values of
+            // any '*' in their place
+            specLength = 0;
+            for (size_t x = 0; x < spec.length; x++) {
+                if ((pFormat[x] == '*') &&
+                    (present = logRecordTake(&pRecord, pEnd, &intValue, sizeof(intValue)))) {
+                    specLength += cellularPort_snprintf(specStr + specLength,
+                                                        sizeof(specStr) - specLength,
+                                                        "%d", intValue);
+                } else if (specLength < sizeof(specStr) - 1) {
+                    specStr[specLength] = pFormat[x];
+                    specLength++;
+                }
+                if (specLength > sizeof(specStr) - 1) {
+                    specLength = sizeof(specStr) - 1;
+                }
+            }
+            specStr[specLength] = 0;
+            if (present) {
+                switch (spec.arg) {
+                    case CELLULAR_PORT_LOG_ARG_NONE:
+                        if ((spec.length == 2) && (pFormat[1] == '%')) {
+                            cellularPortLogF("%%");
+                        }
+                        break;
+                    case CELLULAR_PORT_LOG_ARG_INT:
+                        if ((present = logRecordTake(&pRecord, pEnd, &intValue, sizeof(intValue)))) {
+                            cellularPortLogF(specStr, intValue);
+                        }
+                        break;
+                    case CELLULAR_PORT_LOG_ARG_LONG:
+                        if ((present = logRecordTake(&pRecord, pEnd, &longValue, sizeof(longValue)))) {
+                            cellularPortLogF(specStr, longValue);
+                        }
+                        break;
+                    case CELLULAR_PORT_LOG_ARG_LONG_LONG:
+                        if ((present = logRecordTake(&pRecord, pEnd, &longLongValue, sizeof(longLongValue)))) {
+                            cellularPortLogF(specStr, longLongValue);
+                        }
+                        break;
+                    case CELLULAR_PORT_LOG_ARG_SIZE:
+                        if ((present = logRecordTake(&pRecord, pEnd, &sizeValue, sizeof(sizeValue)))) {
+                            cellularPortLogF(specStr, sizeValue);
+                        }
+                        break;
+                    case CELLULAR_PORT_LOG_ARG_DOUBLE:
+                        if ((present = logRecordTake(&pRecord, pEnd, &doubleValue, sizeof(doubleValue)))) {
+                            cellularPortLogF(specStr, doubleValue);
+                        }
+                        break;
+                    case CELLULAR_PORT_LOG_ARG_POINTER:
+                        if ((present = logRecordTake(&pRecord, pEnd, &pPointerValue, sizeof(pPointerValue)))) {
+                            cellularPortLogF(specStr, pPointerValue);
+                        }
+                        break;
+                    case CELLULAR_PORT_LOG_ARG_STRING:
+                        pString = pRecord;
+                        while ((pRecord < pEnd) && (*pRecord != 0)) {
+                            pRecord++;
+                        }
+                        present = (pRecord < pEnd);
+                        if (present) {
+                            pRecord++;
+                            cellularPortLogF(specStr, pString);
+                        }
+                        break;
+                    default:
+                        break;
+                }
+            }
+            if (!present) {
+                // The record was cut short
+                cellularPortLogF("...\n");
+            }
+            pFormat += spec.length;
+            pText = pFormat;
+        } else {
+            pFormat++;
+        }
+    }
+    if (present && (pFormat > pText)) {
+        cellularPortLogF("%.*s", (int) (pFormat - pText), pText);
+    }
+}
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS: RING BUFFER AND TASK
+ * -------------------------------------------------------------- */
+
+#if CELLULAR_CFG_LOG_DEFERRED
+
+// Copy sizeBytes into the ring buffer; there must be room.
+// gLogMutex must be locked.
+static void logRingPut(const char *pData, size_t sizeBytes)
+{
+    for (size_t x = 0; x < sizeBytes; x++) {
+        gLogBuffer[gLogWriteIndex] = pData[x];
+        gLogWriteIndex++;
+        if (gLogWriteIndex >= sizeof(gLogBuffer)) {
+            gLogWriteIndex = 0;
+        }
+    }
+    gLogNumBytes += sizeBytes;
+}
+
+// Copy sizeBytes out of the ring buffer; they must be there.
+// gLogMutex must be locked.
+static void logRingGet(char *pData, size_t sizeBytes)
+{
+    for (size_t x = 0; x < sizeBytes; x++) {
+        pData[x] = gLogBuffer[gLogReadIndex];
+        gLogReadIndex++;
+        if (gLogReadIndex >= sizeof(gLogBuffer)) {
+            gLogReadIndex = 0;
+        }
+    }
+    gLogNumBytes -= sizeBytes;
+}
+
+// The log task: wait to be woken and then emit all of the
+// records in the ring buffer.
+static void logTask(void *pParameters)
+{
+    char record[CELLULAR_PORT_LOG_RECORD_MAX_SIZE_BYTES];
+    uint8_t command;
+    uint8_t size;
+    int32_t numLost;
+    bool keepGoing = true;
+
+    CELLULAR_PORT_MUTEX_LOCK(gLogMutexTaskRunning);
+
+    (void) pParameters;
+
+    while (keepGoing) {
+        command = CELLULAR_PORT_LOG_COMMAND_WAKE;
+        cellularPortQueueReceive(gLogQueue, &command);
+        keepGoing = (command != CELLULAR_PORT_LOG_COMMAND_EXIT);
+        // Emit everything, on exit as well
+        do {
+            size = 0;
+            CELLULAR_PORT_MUTEX_LOCK(gLogMutex);
+            if (command == CELLULAR_PORT_LOG_COMMAND_WAKE) {
+                gLogWakePending = false;
+            }
+            if (gLogNumBytes > 0) {
+                logRingGet((char *) &size, sizeof(size));
+                logRingGet(record, size);
+            }
+            numLost = gLogNumLost;
+            gLogNumLost = 0;
+            CELLULAR_PORT_MUTEX_UNLOCK(gLogMutex);
+            if (size > 0) {
+                logRecordEmit(record, size);
+            }
+            if (numLost > 0) {
+                cellularPortLogF("CELLULAR_PORT: %d log message(s) lost.\n",
+                                 numLost);
+            }
+        } while (size > 0);
+    }
+
+    CELLULAR_PORT_MUTEX_UNLOCK(gLogMutexTaskRunning);
+
+    // Delete ourself
+    cellularPortTaskDelete(NULL);
+}
+
+#endif
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// Log now or later.
+void cellularPortLogDeferred(const char *pFormat, ...)
+{
+    char record[CELLULAR_PORT_LOG_RECORD_MAX_SIZE_BYTES];
+    uint8_t size;
+    va_list args;
+
+    va_start(args, pFormat);
+    size = (uint8_t) logRecordMake(record, pFormat, args);
+    va_end(args);
+
+#if CELLULAR_CFG_LOG_DEFERRED
+    uint8_t command = CELLULAR_PORT_LOG_COMMAND_WAKE;
+    bool deferred = false;
+
+    if (gLogDeferring) {
+
+        CELLULAR_PORT_MUTEX_LOCK(gLogMutex);
+
+        // Check again now that we have the lock in case
+        // cellularPortLogDeferredDeinit() got in first
+        deferred = gLogDeferring;
+        if (deferred) {
+            if (gLogNumBytes + sizeof(size) + size <= sizeof(gLogBuffer)) {
+                logRingPut((const char *) &size, sizeof(size));
+                logRingPut(record, size);
+                if (!gLogWakePending) {
+                    gLogWakePending = true;
+                    cellularPortQueueSend(gLogQueue, &command);
+                }
+            } else {
+                gLogNumLost++;
+            }
+        }
+
+        CELLULAR_PORT_MUTEX_UNLOCK(gLogMutex);
+    }
+
+    if (!deferred) {
+        logRecordEmit(record, size);
+    }
+#else
+    logRecordEmit(record, size);
+#endif
+}
+
+// Start the log task.
+int32_t cellularPortLogDeferredInit()
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_SUCCESS;
+#if CELLULAR_CFG_LOG_DEFERRED
+    CellularPortTaskHandle_t taskHandle;
+
+    if (gLogMutex == NULL) {
+        errorCode = CELLULAR_PORT_PLATFORM_ERROR;
+        gLogWriteIndex = 0;
+        gLogReadIndex = 0;
+        gLogNumBytes = 0;
+        gLogNumLost = 0;
+        gLogWakePending = false;
+        if ((cellularPortMutexCreate(&gLogMutexTaskRunning) == 0) &&
+            (cellularPortQueueCreate(CELLULAR_PORT_LOG_QUEUE_LENGTH,
+                                     sizeof(uint8_t), &gLogQueue) == 0) &&
+            (cellularPortMutexCreate(&gLogMutex) == 0) &&
+            (cellularPortTaskCreate(logTask, "port_log",
+                                    CELLULAR_PORT_TASK_LOG_STACK_SIZE_BYTES,
+                                    NULL,
+                                    CELLULAR_PORT_TASK_LOG_PRIORITY,
+                                    &taskHandle) == 0)) {
+            gLogDeferring = true;
+            errorCode = CELLULAR_PORT_SUCCESS;
+        }
+        if (errorCode != CELLULAR_PORT_SUCCESS) {
+            if (gLogMutex != NULL) {
+                cellularPortMutexDelete(gLogMutex);
+                gLogMutex = NULL;
+            }
+            if (gLogQueue != NULL) {
+                cellularPortQueueDelete(gLogQueue);
+                gLogQueue = NULL;
+            }
+            if (gLogMutexTaskRunning != NULL) {
+                cellularPortMutexDelete(gLogMutexTaskRunning);
+                gLogMutexTaskRunning = NULL;
+            }
+        }
+    }
+#endif
+
+    return (int32_t) errorCode;
+}
+
+// Stop the log task.
+void cellularPortLogDeferredDeinit()
+{
+#if CELLULAR_CFG_LOG_DEFERRED
+    uint8_t command = CELLULAR_PORT_LOG_COMMAND_EXIT;
+
+    if (gLogMutex != NULL) {
+        // Anything logged from here on is emitted straight away
+        CELLULAR_PORT_MUTEX_LOCK(gLogMutex);
+        gLogDeferring = false;
+        CELLULAR_PORT_MUTEX_UNLOCK(gLogMutex);
+        // Wait for the task to emit what is left and exit
+        cellularPortQueueSend(gLogQueue, &command);
+        CELLULAR_PORT_MUTEX_LOCK(gLogMutexTaskRunning);
+        CELLULAR_PORT_MUTEX_UNLOCK(gLogMutexTaskRunning);
+        cellularPortQueueDelete(gLogQueue);
+        gLogQueue = NULL;
+        cellularPortMutexDelete(gLogMutexTaskRunning);
+        gLogMutexTaskRunning = NULL;
+        cellularPortMutexDelete(gLogMutex);
+        gLogMutex = NULL;
+    }
+#endif
+}
+
+// End of file
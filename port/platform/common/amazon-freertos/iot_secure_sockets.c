@@ -42,6 +42,8 @@
 #include "cellular_port_debug.h" // For cellularPortLog()
 #include "cellular_sock_lwip_itf.h"
 #include "cellular_sock.h"
+#include "cellular_cfg_module.h"
+#include "cellular_ctrl.h"       // For the security profile functions
 
 /* Since AWS freeRTOS has no concept of a cellular interface the Wifi
  * interface is included and re-purposed to drive the cellular interface
@@ -54,8 +56,11 @@
 #include "FreeRTOSConfig.h"
 
 #include "task.h"
+#include "queue.h"
+#include "semphr.h"
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 
 #undef _SECURE_SOCKETS_WRAPPER_NOT_REDEFINE
@@ -68,27 +73,19 @@
 /*
  * secure socket context.
  */
-typedef enum E_AWS_SOCkET_RX_STATE
-{
-    SST_RX_IDLE,
-    SST_RX_READY,
-    SST_RX_CLOSING,
-    SST_RX_CLOSED,
-} T_AWS_SOCKET_RX_STATE;
-
 typedef struct _ss_ctx_t
 {
     int ip_socket;
 
-    int state;
     unsigned int status;
     int send_flag;
     int recv_flag;
 
-    TaskHandle_t rx_handle;
+    int32_t rx_slot; /* Index into xRxSlots[], -1 if there is no receive callback. */
     void ( * rx_callback )( Socket_t pxSocket );
 
     bool enforce_tls;
+    bool module_tls; /* true if the module, rather than mbedTLS, is doing TLS. */
     void * tls_ctx;
     char * destination;
 
@@ -99,6 +96,15 @@ typedef struct _ss_ctx_t
     uint32_t ulAlpnProtocolsCount;
 } ss_ctx_t;
 
+/*
+ * a socket that has a receive callback registered.
+ */
+typedef struct _rx_slot_t
+{
+    ss_ctx_t * ctx;
+    bool pending; /* true if the slot is waiting in xRxDispatchQueue. */
+} rx_slot_t;
+
 /*-----------------------------------------------------------*/
 
 /*#define SUPPORTED_DESCRIPTORS  (2) */
@@ -108,6 +114,15 @@ typedef struct _ss_ctx_t
 /*static int8_t sockets_allocated = SUPPORTED_DESCRIPTORS; */
 static int8_t sockets_allocated = socketsconfigDEFAULT_MAX_NUM_SECURE_SOCKETS;
 
+/*
+ * receive callbacks for all sockets are run by a single dispatcher task.
+ */
+static rx_slot_t xRxSlots[ socketsconfigDEFAULT_MAX_NUM_SECURE_SOCKETS ];
+static SemaphoreHandle_t xRxDispatchMutex = NULL;
+static QueueHandle_t xRxDispatchQueue = NULL;
+static TaskHandle_t xRxDispatchTask = NULL;
+static ss_ctx_t * pxRxDispatchCurrent = NULL;
+
 
 /*-----------------------------------------------------------*/
 
@@ -195,54 +210,71 @@ static BaseType_t prvNetworkRecv( void * pvContext,
 
 /*-----------------------------------------------------------*/
 
-static void vTaskRxSelect( void * param )
+/*
+ * @brief Dispatch receive callbacks: woken through xRxDispatchQueue with
+ * the index of a slot in xRxSlots[] whenever data arrives on the socket
+ * in that slot.
+ */
+static void prvRxDispatchTask( void * param )
 {
-    ss_ctx_t * ctx = ( ss_ctx_t * ) param;
-    int s = ctx->ip_socket;
-
-    fd_set read_fds;
-    fd_set write_fds;
-    fd_set err_fds;
-
-    FD_ZERO( &read_fds );
-    FD_ZERO( &write_fds );
-    FD_ZERO( &err_fds );
-
-    FD_SET( s, &read_fds );
-    FD_SET( s, &err_fds );
+    int32_t lSlot;
+    ss_ctx_t * ctx;
 
-    ctx->state = SST_RX_READY;
+    ( void ) param;
 
     while( 1 )
     {
-        if( ctx->state == SST_RX_CLOSING )
+        if( xQueueReceive( xRxDispatchQueue, &lSlot, portMAX_DELAY ) == pdTRUE )
         {
-            ctx->rx_handle = NULL;
-            ctx->state = SST_RX_CLOSED;
-            vTaskDelete( NULL );
+            xSemaphoreTake( xRxDispatchMutex, portMAX_DELAY );
+            ctx = xRxSlots[ lSlot ].ctx;
+            xRxSlots[ lSlot ].pending = false;
+            pxRxDispatchCurrent = ctx;
+            xSemaphoreGive( xRxDispatchMutex );
+
+            /* Call the callback without the mutex held so that it
+             * may call back into this API, even SOCKETS_Close(). */
+            if( ( ctx != NULL ) && ( ctx->rx_callback != NULL ) )
+            {
+                ctx->rx_callback( ( Socket_t ) ctx );
+            }
+
+            xSemaphoreTake( xRxDispatchMutex, portMAX_DELAY );
+            pxRxDispatchCurrent = NULL;
+            xSemaphoreGive( xRxDispatchMutex );
         }
+    }
+}
 
-        if( cellular_lwip_select( s + 1, &read_fds,
-                                  &write_fds,
-                                  &err_fds, NULL ) == -1 )
-        {
-            /*TaskHandle_t rx_handle = ctx->rx_handle; */
+/*-----------------------------------------------------------*/
 
-            /*ctx->rx_handle   = NULL; */
-            /*ctx->rx_callback = NULL; */
+/*
+ * @brief Queue a dispatch for a slot, unless one is already waiting;
+ * must be called with xRxDispatchMutex held.
+ */
+static void prvRxDispatchQueue( int32_t lSlot )
+{
+    if( ( xRxSlots[ lSlot ].ctx != NULL ) && !xRxSlots[ lSlot ].pending )
+    {
+        /* There is only ever one entry per slot in the queue and the
+         * queue has room for all of the slots so this can't fail. */
+        xRxSlots[ lSlot ].pending = true;
+        xQueueSend( xRxDispatchQueue, &lSlot, 0 );
+    }
+}
 
-            /*vTaskDelete( rx_handle ); */
-            ctx->rx_handle = NULL;
-            vTaskDelete( NULL );
-        }
+/*-----------------------------------------------------------*/
 
-        if( FD_ISSET( s, &read_fds ) )
-        {
-            configASSERT( ctx->rx_callback );
-            ctx->rx_callback( ( Socket_t ) ctx );
-            /*vTaskDelay( 10 ); // delay a little bit to yield time for RX */
-        }
-    }
+/*
+ * @brief Data callback from the cellular sockets layer, called in the
+ * context of the AT call-backs task, which must not be held up, hence
+ * the user's callback is run by prvRxDispatchTask() instead.
+ */
+static void prvRxDataCallback( void * param )
+{
+    xSemaphoreTake( xRxDispatchMutex, portMAX_DELAY );
+    prvRxDispatchQueue( ( int32_t ) ( intptr_t ) param );
+    xSemaphoreGive( xRxDispatchMutex );
 }
 
 /*-----------------------------------------------------------*/
@@ -251,31 +283,213 @@ static void prvRxSelectSet( ss_ctx_t * ctx,
                             const void * pvOptionValue )
 {
     BaseType_t xReturned;
-    TaskHandle_t xHandle = NULL;
     configSTACK_DEPTH_TYPE xStackDepth = socketsconfigRECEIVE_CALLBACK_TASK_STACK_DEPTH;
+    int32_t lSlot = ctx->rx_slot;
+
+    configASSERT( xRxDispatchMutex != NULL );
+
+    xSemaphoreTake( xRxDispatchMutex, portMAX_DELAY );
+
+    /* The one dispatcher task serves all sockets, start it the first
+     * time it is needed. */
+    if( xRxDispatchTask == NULL )
+    {
+        xReturned = xTaskCreate( prvRxDispatchTask, /* pvTaskCode */
+                                 "rxs",             /* pcName */
+                                 xStackDepth,       /* usStackDepth */
+                                 NULL,              /* pvParameters */
+                                 1,                 /* uxPriority */
+                                 &xRxDispatchTask ); /* pxCreatedTask */
+
+        configASSERT( xReturned == pdPASS );
+        configASSERT( xRxDispatchTask != NULL );
+    }
+
+    for( int32_t x = 0; ( lSlot < 0 ) && ( x < socketsconfigDEFAULT_MAX_NUM_SECURE_SOCKETS ); x++ )
+    {
+        if( xRxSlots[ x ].ctx == NULL )
+        {
+            lSlot = x;
+        }
+    }
+
+    /* There is a slot for every socket that can be allocated. */
+    configASSERT( lSlot >= 0 );
 
     ctx->rx_callback = ( void ( * )( Socket_t ) )pvOptionValue;
+    ctx->rx_slot = lSlot;
+    xRxSlots[ lSlot ].ctx = ctx;
 
-    xReturned = xTaskCreate( vTaskRxSelect, /* pvTaskCode */
-                             "rxs",         /* pcName */
-                             xStackDepth,   /* usStackDepth */
-                             ctx,           /* pvParameters */
-                             1,             /* uxPriority */
-                             &xHandle );    /* pxCreatedTask */
+    /* Dispatch once straight away in case data is already waiting. */
+    prvRxDispatchQueue( lSlot );
 
-    configASSERT( xReturned == pdPASS );
-    configASSERT( xHandle != NULL );
+    xSemaphoreGive( xRxDispatchMutex );
 
-    ctx->rx_handle = xHandle;
+    cellularSockRegisterCallbackData( ( CellularSockDescriptor_t ) ctx->ip_socket,
+                                      prvRxDataCallback,
+                                      ( void * ) ( intptr_t ) lSlot );
 }
 
 /*-----------------------------------------------------------*/
 
 static void prvRxSelectClear( ss_ctx_t * ctx )
 {
-    /* TODO */
+    int32_t lSlot = ctx->rx_slot;
+
+    if( lSlot >= 0 )
+    {
+        cellularSockRegisterCallbackData( ( CellularSockDescriptor_t ) ctx->ip_socket,
+                                          NULL, NULL );
+
+        xSemaphoreTake( xRxDispatchMutex, portMAX_DELAY );
+        xRxSlots[ lSlot ].ctx = NULL;
+        ctx->rx_slot = -1;
+
+        /* If the dispatcher is in the middle of calling back on this
+         * socket, wait for it to finish, unless this is the callback. */
+        while( ( pxRxDispatchCurrent == ctx ) &&
+               ( xTaskGetCurrentTaskHandle() != xRxDispatchTask ) )
+        {
+            xSemaphoreGive( xRxDispatchMutex );
+            vTaskDelay( 10 );
+            xSemaphoreTake( xRxDispatchMutex, portMAX_DELAY );
+        }
+
+        xSemaphoreGive( xRxDispatchMutex );
+    }
+
+    ctx->rx_callback = NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+#if CELLULAR_CFG_AFR_SECURE_PROFILE >= 0
+
+/*
+ * @brief What the module's security profile was last set up for: while
+ * that doesn't change the profile is left alone since resetting it would
+ * throw away the TLS session that the module has cached and so every
+ * reconnection, e.g. after a PSM wake-up, would need a full handshake.
+ */
+static struct
+{
+    bool valid;
+    uint32_t cert_hash;
+    int cert_len;
+    char destination[ securesocketsMAX_DNS_NAME_LENGTH + 1 ];
+} xModuleTlsProfile = { 0 };
+
+/*-----------------------------------------------------------*/
+
+/*
+ * @brief FNV-1a hash of a certificate, to tell whether it has changed.
+ */
+static uint32_t prvCertHash( const char * pcCert,
+                             int lLength )
+{
+    uint32_t ulHash = 2166136261UL;
+
+    for( int x = 0; x < lLength; x++ )
+    {
+        ulHash = ( ulHash ^ ( uint8_t ) pcCert[ x ] ) * 16777619UL;
+    }
+
+    return ulHash;
+}
+
+/*-----------------------------------------------------------*/
+
+/*
+ * @brief Store the trusted server certificate of the socket in the module
+ * and set up the security profile to check against it, with TLS session
+ * resumption where the module supports it.
+ */
+static int32_t prvModuleTlsProfileSet( ss_ctx_t * ctx,
+                                       int32_t lProfileId )
+{
+    int32_t lErrorCode;
+    CellularCtrlSecurityProfile_t xProfile = { 0 };
+
+    lErrorCode = cellularCtrlSecurityCredentialStore( CELLULAR_CTRL_SECURITY_CREDENTIAL_ROOT_CA,
+                                                      "afr_server_cert",
+                                                      ctx->server_cert,
+                                                      ctx->server_cert_len );
+
+    if( lErrorCode == 0 )
+    {
+        xProfile.validationLevel = 1;
+        xProfile.tlsVersion = -1;
+        xProfile.cipherSuite = -1;
+        xProfile.pRootCaName = "afr_server_cert";
+        xProfile.pServerNameStr = ctx->destination;
+        xProfile.pSniStr = ctx->destination;
+        xProfile.sessionResumption = CELLULAR_CTRL_SECURITY_TLS_SESSION_RESUMPTION ? 1 : -1;
+        lErrorCode = cellularCtrlSecurityProfileSet( lProfileId, &xProfile );
+    }
+
+    return lErrorCode;
+}
+
+/*-----------------------------------------------------------*/
+
+/*
+ * @brief Have the module do TLS on the socket, with security profile
+ * CELLULAR_CFG_AFR_SECURE_PROFILE.  If a trusted server certificate has
+ * been given the profile is set up for it, unless it is already, else
+ * the profile is used as the application has set it up with
+ * cellularCtrlSecurityProfileSet().
+ */
+static int32_t prvModuleTlsSet( ss_ctx_t * ctx )
+{
+    int32_t lErrorCode = 0;
+    int32_t lProfileId = CELLULAR_CFG_AFR_SECURE_PROFILE;
+    const char * pcDestination = ( ctx->destination != NULL ) ? ctx->destination : "";
+    uint32_t ulCertHash;
+
+    if( ctx->server_cert != NULL )
+    {
+        ulCertHash = prvCertHash( ctx->server_cert, ctx->server_cert_len );
+
+        if( !xModuleTlsProfile.valid ||
+            ( xModuleTlsProfile.cert_hash != ulCertHash ) ||
+            ( xModuleTlsProfile.cert_len != ctx->server_cert_len ) ||
+            ( strcmp( xModuleTlsProfile.destination, pcDestination ) != 0 ) )
+        {
+            xModuleTlsProfile.valid = false;
+            lErrorCode = prvModuleTlsProfileSet( ctx, lProfileId );
+
+            /* Only remember what will fit, anything else is set up
+             * every time. */
+            if( ( lErrorCode == 0 ) &&
+                ( strlen( pcDestination ) < sizeof( xModuleTlsProfile.destination ) ) )
+            {
+                xModuleTlsProfile.cert_hash = ulCertHash;
+                xModuleTlsProfile.cert_len = ctx->server_cert_len;
+                strcpy( xModuleTlsProfile.destination, pcDestination );
+                xModuleTlsProfile.valid = true;
+            }
+        }
+    }
+
+    if( lErrorCode == 0 )
+    {
+        lErrorCode = cellular_lwip_setsockopt( ctx->ip_socket,
+                                               CELLULAR_SOCK_OPT_LEVEL_SOCK,
+                                               CELLULAR_SOCK_OPT_SECURE_PROFILE,
+                                               &lProfileId,
+                                               sizeof( lProfileId ) );
+    }
+
+    if( lErrorCode == 0 )
+    {
+        ctx->module_tls = true;
+    }
+
+    return lErrorCode;
 }
 
+#endif /* CELLULAR_CFG_AFR_SECURE_PROFILE >= 0 */
+
 /*-----------------------------------------------------------*/
 
 Socket_t SOCKETS_Socket( int32_t lDomain,
@@ -304,6 +518,7 @@ Socket_t SOCKETS_Socket( int32_t lDomain,
     if( ctx )
     {
         memset( ctx, 0, sizeof( *ctx ) );
+        ctx->rx_slot = -1;
 
         ctx->ip_socket = cellular_lwip_socket( lDomain,
                                                lType,
@@ -364,6 +579,16 @@ int32_t SOCKETS_Connect( Socket_t xSocket,
         sa_addr.sin_addr.s_addr = pxAddress->ulAddress;
         sa_addr.sin_port = pxAddress->usPort;
 
+        #if CELLULAR_CFG_AFR_SECURE_PROFILE >= 0
+            /* The module does the TLS handshake on connection so
+             * it has to be told beforehand. */
+            if( ctx->enforce_tls && ( prvModuleTlsSet( ctx ) != 0 ) )
+            {
+                configPRINTF( ( "Module TLS set-up fail\n" ) );
+                return SOCKETS_SOCKET_ERROR;
+            }
+        #endif
+
         ret = cellular_lwip_connect( ctx->ip_socket,
                                      ( struct sockaddr * ) &sa_addr,
                                      sizeof( sa_addr ) );
@@ -380,6 +605,12 @@ int32_t SOCKETS_Connect( Socket_t xSocket,
                 return SOCKETS_ERROR_NONE;
             }
 
+            if( ctx->module_tls )
+            {
+                ctx->status |= SS_STATUS_SECURED;
+                return SOCKETS_ERROR_NONE;
+            }
+
             tls_params.ulSize = sizeof( tls_params );
             tls_params.pcDestination = ctx->destination;
             tls_params.pcServerCertificate = ctx->server_cert;
@@ -412,6 +643,16 @@ int32_t SOCKETS_Connect( Socket_t xSocket,
         }
         else
         {
+            #if CELLULAR_CFG_AFR_SECURE_PROFILE >= 0
+                /* The handshake may have failed because the module has
+                 * lost the profile, e.g. it was rebooted: set it up
+                 * again next time. */
+                if( ctx->module_tls )
+                {
+                    xModuleTlsProfile.valid = false;
+                }
+            #endif
+
             configPRINTF( ( "LwIP connect fail %d %d\n", ret, errno ) );
         }
     }
@@ -457,7 +698,7 @@ int32_t SOCKETS_Recv( Socket_t xSocket,
         return SOCKETS_SOCKET_ERROR;
     }
 
-    if( ctx->enforce_tls )
+    if( ctx->enforce_tls && !ctx->module_tls )
     {
         /* Receive through TLS pipe, if negotiated. */
         return TLS_Recv( ctx->tls_ctx, pvBuffer, xBufferLength );
@@ -498,7 +739,7 @@ int32_t SOCKETS_Send( Socket_t xSocket,
         return SOCKETS_SOCKET_ERROR;
     }
 
-    if( ctx->enforce_tls )
+    if( ctx->enforce_tls && !ctx->module_tls )
     {
         /* Send through TLS pipe, if negotiated. */
         return TLS_Send( ctx->tls_ctx, pvBuffer, xDataLength );
@@ -576,24 +817,14 @@ int32_t SOCKETS_Close( Socket_t xSocket )
         vPortFree( ctx->ppcAlpnProtocols );
     }
 
-    if( true == ctx->enforce_tls )
+    if( ( true == ctx->enforce_tls ) && !ctx->module_tls )
     {
         TLS_Cleanup( ctx->tls_ctx );
     }
 
     if( 0 <= ctx->ip_socket )
     {
-        if( ctx->rx_handle != NULL )
-        {
-            int cnt = 0;
-            ctx->state = SST_RX_CLOSING;
-
-            while( ( ctx->state != SST_RX_CLOSED ) && ( cnt < 30 ) )
-            {
-                cnt++;
-                vTaskDelay( 10 );
-            }
-        }
+        prvRxSelectClear( ctx );
 
         cellular_lwip_close( ctx->ip_socket );
 
@@ -862,6 +1093,30 @@ BaseType_t SOCKETS_Init( void )
 
     cellularPortLog("CELLULAR_IOT_SECURE_SOCKETS: SOCKETS_Init() called.\n");
 
+    if( xRxDispatchMutex == NULL )
+    {
+        xRxDispatchMutex = xSemaphoreCreateMutex();
+        xRxDispatchQueue = xQueueCreate( socketsconfigDEFAULT_MAX_NUM_SECURE_SOCKETS,
+                                         sizeof( int32_t ) );
+
+        if( ( xRxDispatchMutex == NULL ) || ( xRxDispatchQueue == NULL ) )
+        {
+            if( xRxDispatchMutex != NULL )
+            {
+                vSemaphoreDelete( xRxDispatchMutex );
+                xRxDispatchMutex = NULL;
+            }
+
+            if( xRxDispatchQueue != NULL )
+            {
+                vQueueDelete( xRxDispatchQueue );
+                xRxDispatchQueue = NULL;
+            }
+
+            xResult = pdFAIL;
+        }
+    }
+
     return xResult;
 }
 
@@ -0,0 +1,98 @@
+#!/usr/bin/env python
+'''Report the static RAM and flash used by each cellular module.'''
+from __future__ import print_function
+import sys
+import os
+import re
+import argparse
+import subprocess
+
+# Prefix to put at the start of all prints
+prompt = "CellularRamReport: "
+
+# The modules reported on, in order, and the object file name
+# prefixes that belong to them; the first match wins
+MODULES = [("ctrl_at", ["cellular_ctrl_at"]),
+           ("ctrl", ["cellular_ctrl"]),
+           ("sock", ["cellular_sock"]),
+           ("mqtt", ["cellular_mqtt"]),
+           ("port", ["cellular_port"])]
+
+# nm symbol types and the section they count against
+SECTIONS = {"b": "bss", "c": "bss", "d": "data", "g": "data", "s": "bss",
+            "t": "text", "r": "rodata"}
+
+def module_of(object_name):
+    '''Return the module an object file belongs to, None if not cellular'''
+    base = os.path.basename(object_name)
+    for module, prefixes in MODULES:
+        for prefix in prefixes:
+            if base.startswith(prefix):
+                return module
+    return None
+
+def sizes_from_nm(nm, path, totals):
+    '''Run nm on an object file or archive and add up the sizes'''
+    try:
+        output = subprocess.check_output([nm, "--print-size", "--radix=d", path])
+    except (OSError, subprocess.CalledProcessError) as ex:
+        print(prompt + "unable to run \"{} {}\" ({}).".format(nm, path, ex))
+        return False
+    member = path
+    for line in output.decode("utf-8", "replace").splitlines():
+        # An archive prints "member.o:" before each member's symbols
+        match = re.match(r"^(\S+\.o\w*):$", line)
+        if match:
+            member = match.group(1)
+            continue
+        fields = line.split()
+        # Only defined symbols have a size: "value size type name"
+        if len(fields) >= 4:
+            section = SECTIONS.get(fields[2].lower())
+            module = module_of(member)
+            if section and module:
+                totals[module][section] += int(fields[1])
+    return True
+
+def main():
+    '''Main as a function'''
+    parser = argparse.ArgumentParser(description="Report the static RAM"  \
+                                     " (.data plus .bss) and flash"        \
+                                     " (.text plus .rodata plus .data)"   \
+                                     " used by each cellular module, from" \
+                                     " the object files of a build.")
+    parser.add_argument("--nm", default="nm", help="the nm to use, e.g."   \
+                        " arm-none-eabi-nm.")
+    parser.add_argument("objects", nargs="+", help="object files or"      \
+                        " archives; anything not from a cellular module"  \
+                        " is ignored.")
+    args = parser.parse_args()
+
+    totals = {}
+    for module, _ in MODULES:
+        totals[module] = {"text": 0, "rodata": 0, "data": 0, "bss": 0}
+    for path in args.objects:
+        if not sizes_from_nm(args.nm, path, totals):
+            return 1
+
+    print("{:<8} {:>8} {:>8} {:>8} {:>8} {:>8}".format("module", "data", "bss",
+                                                       "RAM", "text+ro", "flash"))
+    ram_total = 0
+    flash_total = 0
+    for module, _ in MODULES:
+        sizes = totals[module]
+        ram = sizes["data"] + sizes["bss"]
+        code = sizes["text"] + sizes["rodata"]
+        print("{:<8} {:>8} {:>8} {:>8} {:>8} {:>8}".format(module, sizes["data"],
+                                                           sizes["bss"], ram,
+                                                           code, code + sizes["data"]))
+        ram_total += ram
+        flash_total += code + sizes["data"]
+    print("{:<8} {:>8} {:>8} {:>8} {:>8} {:>8}".format("total", "", "", ram_total,
+                                                       "", flash_total))
+    print(prompt + "stacks and heap are not included: see the"          \
+          " xxx_STACK_SIZE_BYTES values in cellular_cfg_os_platform_specific.h.")
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
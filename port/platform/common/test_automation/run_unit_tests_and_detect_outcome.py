@@ -4,6 +4,7 @@ import sys
 import argparse
 import serial
 import re
+import csv
 import codecs
 import subprocess
 from time import time, ctime, sleep
@@ -30,7 +31,16 @@ tests_failed = 0
 tests_ignored = 0
 overall_start_time = 0
 last_start_time = time()
-test_outcomes = [] # Name, duration in seconds and status string
+test_outcomes = [] # Name, duration in seconds, status string and metrics
+pending_metrics = [] # Metrics emitted by the test that is running
+metrics_regressed = 0
+
+# Metrics that a test emits are [name, value, unit] and are
+# compared with a baseline [value, better, threshold percent],
+# better being "higher" or "lower".  Unless the baseline says
+# otherwise, throughput and free memory are better higher and
+# everything else is better lower.
+DEFAULT_THRESHOLD_PERCENT = 10
 
 def reboot_callback(match):
     '''Handler for reboots occuring unexpectedly'''
@@ -50,8 +60,14 @@ def run_callback(match):
     tests_run += 1
 
 def record_test_outcome(name, duration, status):
-    outcome = [name, duration, status]
+    global pending_metrics
+    outcome = [name, duration, status, pending_metrics]
     test_outcomes.append(outcome)
+    pending_metrics = []
+
+def metric_callback(match):
+    '''Handler for a benchmark result'''
+    pending_metrics.append([match.group(1), int(match.group(2)), match.group(3)])
 
 def pass_callback(match):
     '''Handler for a test passing'''
@@ -103,9 +119,89 @@ interesting = [[r"abort()", reboot_callback],
                [r"(?:^.*?(?:\.c:))(?:[0-9]*:)(.*?):PASS$", pass_callback],
                # Match, for example "C:/temp/file.c:900:tcpEchoAsync:FAIL:Function sock.  Expression Evaluated To FALSE" capturing the "connectThings" part
                [r"(?:^.*?(?:\.c:))(?:[0-9]*:)(.*?):FAIL:", fail_callback],
+               # Match, for example "CELLULAR_TEST_METRIC: sockTCP.128.throughput 1850 B/s" capturing the name, value and unit
+               [r"(?:^.*CELLULAR_TEST_METRIC:) +([^ ]+) +(-?[0-9]+) +([^ ]+)$", metric_callback],
                # Match, for example "22 Tests 1 Failures 0 Ignored" capturing the numbers
                [r"(^[0-9]+) Test(?:s*) ([0-9]+) Failure(?:s*) ([0-9]+) Ignored", finish_callback]]
 
+# Read a file of baseline metrics, a CSV file with a header
+# row which must include the columns "name" and "value" and
+# may include "better" and "threshold"; a metrics file written
+# by this script will do.
+def read_baseline(baseline_file_name):
+    '''RunEspIdfTests: read baseline metrics'''
+    baseline = {}
+    print prompt + "reading baseline metrics from \"" + baseline_file_name + "\"...",
+    try:
+        with open(baseline_file_name, "r") as baseline_file_handle:
+            for row in csv.DictReader(baseline_file_handle):
+                if row.get("name") and row.get("value"):
+                    baseline[row["name"]] = [int(row["value"]),
+                                             row.get("better"),
+                                             row.get("threshold")]
+        print " {} metric(s) read.".format(len(baseline))
+    except (IOError, ValueError) as ex:
+        print " failed: " + str(ex) + "."
+        baseline = None
+    return baseline
+
+# Compare a metric with its baseline, returning the
+# change in percent, positive being worse, and
+# whether that is beyond the threshold.
+def compare_metric(metric, baseline, default_threshold):
+    '''RunEspIdfTests: compare a metric with its baseline'''
+    better = baseline[1]
+    if not better:
+        better = "lower"
+        if metric[2].endswith("/s") or metric[0].endswith("_free"):
+            better = "higher"
+    threshold = default_threshold
+    if baseline[2]:
+        threshold = float(baseline[2])
+    change = 0.0
+    if baseline[0] != 0:
+        change = (float(metric[1] - baseline[0]) * 100) / abs(baseline[0])
+    elif metric[1] != baseline[0]:
+        change = 100.0
+    if better == "higher":
+        change = -change
+    return change, change > threshold
+
+# Compare the metrics of all the tests with a baseline,
+# marking as failed any test that has a metric which
+# has regressed; returns the number of regressed metrics.
+def check_metrics(baseline, default_threshold):
+    '''RunEspIdfTests: check all metrics against a baseline'''
+    regressed = 0
+    for outcome in test_outcomes:
+        for metric in outcome[3]:
+            if metric[0] in baseline:
+                change, worse = compare_metric(metric, baseline[metric[0]],
+                                               default_threshold)
+                metric.append(baseline[metric[0]][0])
+                metric.append(change)
+                if worse:
+                    regressed += 1
+                    print "{}test {}() metric {} REGRESSED: {} {}, baseline {} {}, {:.1f}% worse.".\
+                          format(prompt, outcome[0], metric[0], metric[1], metric[2],
+                                 baseline[metric[0]][0], metric[2], change)
+                    if outcome[2] != "FAIL":
+                        outcome[2] = "FAIL"
+    return regressed
+
+# Write the metrics of all the tests to a CSV file.
+def write_metrics(metrics_file_name):
+    '''RunEspIdfTests: write the metrics to a CSV file'''
+    with open(metrics_file_name, "wb") as metrics_file_handle:
+        writer = csv.writer(metrics_file_handle)
+        writer.writerow(["test", "name", "value", "unit", "baseline", "change_percent"])
+        for outcome in test_outcomes:
+            for metric in outcome[3]:
+                row = [outcome[0]] + metric[0:3]
+                if len(metric) > 3:
+                    row += [metric[3], "{:.1f}".format(metric[4])]
+                writer.writerow(row)
+
 # Read lines from input, returns the line as
 # a string when terminator or '\n' is encountered.
 # Does NOT return the terminating character
@@ -299,6 +395,22 @@ if __name__ == "__main__":
     parser.add_argument("report_file_name", metavar='r', help= \
                         "the file name to write an XML-format report to;" \
                         "any existing file will be overwritten.")
+    parser.add_argument("-m", dest="metrics_file_name", help= \
+                        "a file name to write the benchmark metrics" \
+                        "emitted by the tests to, in CSV format;" \
+                        "any existing file will be overwritten.")
+    parser.add_argument("-b", dest="baseline_file_name", help= \
+                        "a CSV file of baseline metrics, with a header" \
+                        "row including \"name\" and \"value\" and optionally" \
+                        "\"better\" (\"higher\" or \"lower\") and \"threshold\"" \
+                        "(percent); a file written with -m will do. A test" \
+                        "with a metric worse than its baseline by more than" \
+                        "the threshold fails.")
+    parser.add_argument("-t", dest="threshold", type=float, \
+                        default=DEFAULT_THRESHOLD_PERCENT, help= \
+                        "the threshold, in percent, for metrics whose" \
+                        "baseline does not give one, default " \
+                        + str(DEFAULT_THRESHOLD_PERCENT) + ".")
     args = parser.parse_args()
 
     # The following line works around weird encoding problems where Python
@@ -306,8 +418,14 @@ if __name__ == "__main__":
     # See https://stackoverflow.com/questions/878972/windows-cmd-encoding-change-causes-python-crash
     codecs.register(lambda name: codecs.lookup('utf-8') if name == 'cp65001' else None)
 
+    baseline = None
+    if args.baseline_file_name:
+        baseline = read_baseline(args.baseline_file_name)
+        if baseline == None:
+            success = False
+
     # Do the work
-    if args.input_name:
+    if success and args.input_name:
         connection_type = CONNECTION_SERIAL
         in_handle = open_serial(args.input_name)
         if in_handle == None:
@@ -341,13 +459,31 @@ if __name__ == "__main__":
                     overall_start_time = time()
                     watch_tests(in_handle, connection_type, log_file_handle)
                     return_value = tests_failed
-                # Write the report
+                    if baseline != None:
+                        metrics_regressed = check_metrics(baseline, args.threshold)
+                        print "{}{} metric(s) regressed.".format(prompt, metrics_regressed)
+                        return_value += metrics_regressed
+                if args.metrics_file_name:
+                    write_metrics(args.metrics_file_name)
+                    print prompt + "benchmark metrics written to \"" + args.metrics_file_name + "\"."
+                # Write the report, a test which regressed
+                # counting as a failure
                 if report_file_handle:
+                    failures = len([outcome for outcome in test_outcomes if outcome[2] == "FAIL"])
+                    if failures < tests_failed:
+                        failures = tests_failed
                     report_file_handle.write("<testsuite name=\"{}\" tests=\"{}\" failures=\"{}\">\n".\
-                                             format("esp-idf", tests_run, tests_failed))
+                                             format("esp-idf", tests_run, failures))
                     for outcome in test_outcomes:
-                        report_file_handle.write("    <testcase classname=\"{}\" name=\"{}\" time=\"{}\" status=\"{}\"></testcase>\n".\
+                        report_file_handle.write("    <testcase classname=\"{}\" name=\"{}\" time=\"{}\" status=\"{}\">".\
                                                  format("cellular_tests", outcome[0], outcome[1], outcome[2]))
+                        if outcome[3]:
+                            report_file_handle.write("\n        <properties>\n")
+                            for metric in outcome[3]:
+                                report_file_handle.write("            <property name=\"{}\" value=\"{}\" unit=\"{}\"/>\n".\
+                                                         format(metric[0], metric[1], metric[2]))
+                            report_file_handle.write("        </properties>\n    ")
+                        report_file_handle.write("</testcase>\n")
                     report_file_handle.write("</testsuite>\n")
                     report_file_handle.close()
             if log_file_handle:
@@ -37,7 +37,10 @@
 /** The buffer threshold at which RTS is de-asserted, indicating the
  * cellular module should stop sending data to us.  Must be defined
  * if CELLULAR_CFG_PIN_RTS is not -1.
- * Must be less than UART_FIFO_LEN, which is 128.
+ * This is a level in the UART hardware FIFO, which is
+ * UART_FIFO_LEN (128) bytes long; zero, or a value that
+ * would leave too little room in the FIFO, is replaced by
+ * one that leaves CELLULAR_PORT_UART_RTS_FIFO_SPACE bytes.
  */
 # define CELLULAR_CFG_RTS_THRESHOLD                  100
 #endif
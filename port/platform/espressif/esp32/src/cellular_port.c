@@ -19,13 +19,24 @@
 #endif
 #include "cellular_port_clib.h"
 #include "cellular_port.h"
+#include "cellular_port_debug.h"
 
 #include "esp_timer.h" // For esp_timer_get_time()
+#include "nvs_flash.h"
+#include "nvs.h"
 
 /* ----------------------------------------------------------------
  * COMPILE-TIME MACROS
  * -------------------------------------------------------------- */
 
+/** The NVS name-space for cellularPortNvStore().
+ */
+#define CELLULAR_PORT_NV_NAMESPACE "cellular"
+
+/** The maximum value of the ID passed to cellularPortNvStore().
+ */
+#define CELLULAR_PORT_NV_MAX_ID 15
+
 /* ----------------------------------------------------------------
  * TYPES
  * -------------------------------------------------------------- */
@@ -38,6 +49,31 @@
  * STATIC FUNCTIONS
  * -------------------------------------------------------------- */
 
+// Open the NVS name-space, initialising NVS if need be, and
+// return the error from NVS.
+static esp_err_t nvOpen(nvs_handle *pHandle)
+{
+    esp_err_t espError;
+
+    // This returns ESP_OK if NVS is already initialised
+    espError = nvs_flash_init();
+    if (espError == ESP_OK) {
+        espError = nvs_open(CELLULAR_PORT_NV_NAMESPACE,
+                            NVS_READWRITE, pHandle);
+    }
+
+    return espError;
+}
+
+// Make the key for a given ID.
+static void nvKey(int32_t id, char *pKey)
+{
+    pKey[0] = 'n';
+    pKey[1] = 'v';
+    pKey[2] = 'a' + (char) id;
+    pKey[3] = 0;
+}
+
 /* ----------------------------------------------------------------
  * PUBLIC FUNCTIONS
  * -------------------------------------------------------------- */
@@ -65,14 +101,19 @@ int32_t cellularPortPlatformStart(void (*pEntryPoint)(void *),
 // Initialise the porting layer.
 int32_t cellularPortInit()
 {
-    // Nothing to do
-    return CELLULAR_PORT_SUCCESS;
+    int32_t errorCode = cellularPortMallocInit();
+
+    if (errorCode == 0) {
+        errorCode = cellularPortLogDeferredInit();
+    }
+
+    return errorCode;
 }
 
 // Deinitialise the porting layer.
 void cellularPortDeinit()
 {
-    // Nothing to do
+    cellularPortLogDeferredDeinit();
 }
 
 // Get the current tick converted to a time in milliseconds.
@@ -81,4 +122,49 @@ int64_t cellularPortGetTickTimeMs()
     return esp_timer_get_time() / 1000;
 }
 
+// Store a block of data in non-volatile storage.
+int32_t cellularPortNvStore(int32_t id, const void *pData,
+                            size_t size)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    nvs_handle handle;
+    char key[4];
+
+    if ((id >= 0) && (id <= CELLULAR_PORT_NV_MAX_ID) && (pData != NULL)) {
+        errorCode = CELLULAR_PORT_PLATFORM_ERROR;
+        if (nvOpen(&handle) == ESP_OK) {
+            nvKey(id, key);
+            if ((nvs_set_blob(handle, key, pData, size) == ESP_OK) &&
+                (nvs_commit(handle) == ESP_OK)) {
+                errorCode = CELLULAR_PORT_SUCCESS;
+            }
+            nvs_close(handle);
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Retrieve a block of data from non-volatile storage.
+int32_t cellularPortNvRetrieve(int32_t id, void *pData,
+                               size_t size)
+{
+    int32_t errorCodeOrSize = (int32_t) CELLULAR_PORT_INVALID_PARAMETER;
+    nvs_handle handle;
+    char key[4];
+
+    if ((id >= 0) && (id <= CELLULAR_PORT_NV_MAX_ID) && (pData != NULL)) {
+        errorCodeOrSize = (int32_t) CELLULAR_PORT_PLATFORM_ERROR;
+        if (nvOpen(&handle) == ESP_OK) {
+            nvKey(id, key);
+            if (nvs_get_blob(handle, key, pData, &size) == ESP_OK) {
+                errorCodeOrSize = (int32_t) size;
+            }
+            nvs_close(handle);
+        }
+    }
+
+    return errorCodeOrSize;
+}
+
 // End of file
@@ -19,8 +19,12 @@
 #endif
 #include "cellular_port_clib.h"
 #include "cellular_port.h"
+#include "cellular_port_os.h"
 #include "cellular_port_gpio.h"
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
 #include "driver/gpio.h"
 #include "driver/rtc_io.h"
 
@@ -36,10 +40,30 @@
  * VARIABLES
  * -------------------------------------------------------------- */
 
+// The queue that each pin sends interrupts to.
+static CellularPortQueueHandle_t gInterruptQueue[GPIO_NUM_MAX] = {0};
+
 /* ----------------------------------------------------------------
  * STATIC FUNCTIONS
  * -------------------------------------------------------------- */
 
+// GPIO interrupt handler, common to all pins.
+static void IRAM_ATTR gpioIsr(void *pParam)
+{
+    int32_t pin = (int32_t) (intptr_t) pParam;
+    BaseType_t yield = pdFALSE;
+
+    if (gInterruptQueue[pin] != NULL) {
+        xQueueSendFromISR((QueueHandle_t) gInterruptQueue[pin],
+                          &pin, &yield);
+    }
+
+    // Required for correct FreeRTOS operation
+    if (yield) {
+        portYIELD_FROM_ISR();
+    }
+}
+
 /* ----------------------------------------------------------------
  * PUBLIC FUNCTIONS
  * -------------------------------------------------------------- */
@@ -147,4 +171,66 @@ int32_t cellularPortGpioGet(int32_t pin)
     return gpio_get_level(pin);
 }
 
+// Set or remove an interrupt on a GPIO.
+// Note that ESP32 can only wake from light sleep on a level and
+// gpio_wakeup_enable() replaces the edge with that level, so the
+// pin is NOT made a wake-up source here: an application that
+// wants one should use esp_sleep_enable_ext0_wakeup() on the pin.
+int32_t cellularPortGpioInterruptSet(int32_t pin,
+                                     CellularPortGpioInterrupt_t interrupt,
+                                     CellularPortQueueHandle_t queueHandle)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    gpio_int_type_t type = GPIO_INTR_DISABLE;
+    esp_err_t espError;
+
+    if ((pin >= 0) && (pin < GPIO_NUM_MAX) &&
+        ((queueHandle != NULL) ||
+         (interrupt == CELLULAR_PORT_GPIO_INTERRUPT_NONE))) {
+        switch (interrupt) {
+            case CELLULAR_PORT_GPIO_INTERRUPT_NONE:
+            break;
+            case CELLULAR_PORT_GPIO_INTERRUPT_RISING_EDGE:
+                type = GPIO_INTR_POSEDGE;
+            break;
+            case CELLULAR_PORT_GPIO_INTERRUPT_FALLING_EDGE:
+                type = GPIO_INTR_NEGEDGE;
+            break;
+            case CELLULAR_PORT_GPIO_INTERRUPT_BOTH_EDGES:
+                type = GPIO_INTR_ANYEDGE;
+            break;
+            default:
+                interrupt = MAX_NUM_CELLULAR_PORT_GPIO_INTERRUPTS;
+            break;
+        }
+        if (interrupt < MAX_NUM_CELLULAR_PORT_GPIO_INTERRUPTS) {
+            errorCode = CELLULAR_PORT_PLATFORM_ERROR;
+            // Out with the old
+            gpio_intr_disable(pin);
+            gpio_isr_handler_remove(pin);
+            gInterruptQueue[pin] = NULL;
+            if (type == GPIO_INTR_DISABLE) {
+                gpio_set_intr_type(pin, type);
+                errorCode = CELLULAR_PORT_SUCCESS;
+            } else {
+                // The ISR service is shared: it may
+                // already have been installed by someone else
+                espError = gpio_install_isr_service(0);
+                if (((espError == ESP_OK) || (espError == ESP_ERR_INVALID_STATE)) &&
+                    (gpio_set_intr_type(pin, type) == ESP_OK)) {
+                    gInterruptQueue[pin] = queueHandle;
+                    if (gpio_isr_handler_add(pin, gpioIsr,
+                                             (void *) (intptr_t) pin) == ESP_OK) {
+                        errorCode = CELLULAR_PORT_SUCCESS;
+                    } else {
+                        gInterruptQueue[pin] = NULL;
+                    }
+                }
+            }
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
 // End of file
@@ -17,6 +17,7 @@
 #ifdef CELLULAR_CFG_OVERRIDE
 # include "cellular_cfg_override.h" // For a customer's configuration override
 #endif
+#include "cellular_cfg_sw.h"
 #include "cellular_port_clib.h"
 #include "cellular_port.h"
 #include "cellular_port_os.h"
@@ -30,18 +31,254 @@
  * COMPILE-TIME MACROS
  * -------------------------------------------------------------- */
 
+#if CELLULAR_CFG_STATIC_ALLOC && !CONFIG_SUPPORT_STATIC_ALLOCATION
+# error CELLULAR_CFG_STATIC_ALLOC requires CONFIG_SUPPORT_STATIC_ALLOCATION in sdkconfig.
+#endif
+
+#if CELLULAR_CFG_STATIC_ALLOC
+/** How long a task slot is left alone after its task has
+ * deleted itself: the idle task has to take the task off its
+ * termination list before the TCB can be used again.
+ */
+# define CELLULAR_PORT_STATIC_TASK_GUARD_MS 100
+
+/** Lock the static pools; a spinlock as the scheduler of the
+ * dual-core ESP32 can't simply be suspended.
+ */
+# define CELLULAR_PORT_STATIC_POOL_LOCK() portENTER_CRITICAL(&gStaticPoolSpinlock)
+
+/** Unlock the static pools.
+ */
+# define CELLULAR_PORT_STATIC_POOL_UNLOCK() portEXIT_CRITICAL(&gStaticPoolSpinlock)
+#endif
+
 /* ----------------------------------------------------------------
  * TYPES
  * -------------------------------------------------------------- */
 
+#if CELLULAR_CFG_STATIC_ALLOC
+/** A task slot.  The stack is carved from gStaticTaskStacks
+ * the first time the slot is used and is afterwards only
+ * re-used for a task whose stack fits; since the same tasks
+ * come and go with the same sizes this settles quickly.
+ */
+typedef struct {
+    StaticTask_t tcb;
+    StackType_t *pStack;
+    size_t stackDepth;
+    TaskHandle_t handle;
+    int64_t freeTimeMs;
+} CellularPortStaticTask_t;
+
+/** A queue slot, its storage handled in the same way as the
+ * stack of a task slot.
+ */
+typedef struct {
+    StaticQueue_t queue;
+    uint8_t *pStorage;
+    size_t storageSizeBytes;
+    QueueHandle_t handle;
+} CellularPortStaticQueue_t;
+
+/** A mutex slot.
+ */
+typedef struct {
+    StaticSemaphore_t mutex;
+    SemaphoreHandle_t handle;
+} CellularPortStaticMutex_t;
+#endif
+
 /* ----------------------------------------------------------------
  * VARIABLES
  * -------------------------------------------------------------- */
 
+#if CELLULAR_CFG_STATIC_ALLOC
+/** Spinlock protecting the static pools.
+ */
+static portMUX_TYPE gStaticPoolSpinlock = portMUX_INITIALIZER_UNLOCKED;
+
+/** The task slots.
+ */
+static CellularPortStaticTask_t gStaticTasks[CELLULAR_CFG_STATIC_ALLOC_NUM_TASKS];
+
+/** Memory from which task stacks are carved.
+ */
+static StackType_t gStaticTaskStacks[CELLULAR_CFG_STATIC_ALLOC_TASK_STACK_SIZE_BYTES /
+                                     sizeof(StackType_t)];
+
+/** The number of entries of gStaticTaskStacks carved so far.
+ */
+static size_t gStaticTaskStacksUsed = 0;
+
+/** The queue slots.
+ */
+static CellularPortStaticQueue_t gStaticQueues[CELLULAR_CFG_STATIC_ALLOC_NUM_QUEUES];
+
+/** Memory from which queue storage is carved.
+ */
+static uint8_t gStaticQueueStorage[CELLULAR_CFG_STATIC_ALLOC_QUEUE_STORAGE_BYTES];
+
+/** The number of bytes of gStaticQueueStorage carved so far.
+ */
+static size_t gStaticQueueStorageUsed = 0;
+
+/** The mutex slots.
+ */
+static CellularPortStaticMutex_t gStaticMutexes[CELLULAR_CFG_STATIC_ALLOC_NUM_MUTEXES];
+#endif
+
 /* ----------------------------------------------------------------
  * STATIC FUNCTIONS
  * -------------------------------------------------------------- */
 
+#if CELLULAR_CFG_STATIC_ALLOC
+// Reserve a task slot with room for a stack of the given depth,
+// waiting out the guard time of a recently freed slot if that
+// is the only one that fits; returns NULL if there's no room.
+static CellularPortStaticTask_t *pStaticTaskAlloc(size_t stackDepth)
+{
+    CellularPortStaticTask_t *pSlot = NULL;
+    CellularPortStaticTask_t *pUnused;
+    int64_t nowMs;
+    bool waiting;
+
+    do {
+        pUnused = NULL;
+        waiting = false;
+        nowMs = cellularPortGetTickTimeMs();
+        CELLULAR_PORT_STATIC_POOL_LOCK();
+        for (size_t x = 0; (pSlot == NULL) &&
+                           (x < sizeof(gStaticTasks) / sizeof(gStaticTasks[0])); x++) {
+            if (gStaticTasks[x].handle == NULL) {
+                if (gStaticTasks[x].pStack == NULL) {
+                    if (pUnused == NULL) {
+                        pUnused = &(gStaticTasks[x]);
+                    }
+                } else if (gStaticTasks[x].stackDepth >= stackDepth) {
+                    if (nowMs - gStaticTasks[x].freeTimeMs >= CELLULAR_PORT_STATIC_TASK_GUARD_MS) {
+                        pSlot = &(gStaticTasks[x]);
+                    } else {
+                        waiting = true;
+                    }
+                }
+            }
+        }
+        if ((pSlot == NULL) && !waiting && (pUnused != NULL) &&
+            (gStaticTaskStacksUsed + stackDepth <= sizeof(gStaticTaskStacks) /
+                                                  sizeof(gStaticTaskStacks[0]))) {
+            pSlot = pUnused;
+            pSlot->pStack = gStaticTaskStacks + gStaticTaskStacksUsed;
+            pSlot->stackDepth = stackDepth;
+            gStaticTaskStacksUsed += stackDepth;
+        }
+        if (pSlot != NULL) {
+            // The handle of a static task is its TCB, set it
+            // now in case the task runs and deletes itself
+            // before xTaskCreateStatic() has returned
+            pSlot->handle = (TaskHandle_t) &(pSlot->tcb);
+        }
+        CELLULAR_PORT_STATIC_POOL_UNLOCK();
+        if (waiting) {
+            cellularPortTaskBlock(CELLULAR_PORT_STATIC_TASK_GUARD_MS / 10);
+        }
+    } while ((pSlot == NULL) && waiting);
+
+    return pSlot;
+}
+
+// Give back the task slot holding the given task.
+static void staticTaskFree(TaskHandle_t handle)
+{
+    int64_t nowMs = cellularPortGetTickTimeMs();
+
+    CELLULAR_PORT_STATIC_POOL_LOCK();
+    for (size_t x = 0; x < sizeof(gStaticTasks) / sizeof(gStaticTasks[0]); x++) {
+        if (gStaticTasks[x].handle == handle) {
+            gStaticTasks[x].freeTimeMs = nowMs;
+            gStaticTasks[x].handle = NULL;
+        }
+    }
+    CELLULAR_PORT_STATIC_POOL_UNLOCK();
+}
+
+// Reserve a queue slot with the given amount of storage,
+// NULL if there's no room.
+static CellularPortStaticQueue_t *pStaticQueueAlloc(size_t storageSizeBytes)
+{
+    CellularPortStaticQueue_t *pSlot = NULL;
+    CellularPortStaticQueue_t *pUnused = NULL;
+
+    CELLULAR_PORT_STATIC_POOL_LOCK();
+    for (size_t x = 0; (pSlot == NULL) &&
+                       (x < sizeof(gStaticQueues) / sizeof(gStaticQueues[0])); x++) {
+        if (gStaticQueues[x].handle == NULL) {
+            if (gStaticQueues[x].pStorage == NULL) {
+                if (pUnused == NULL) {
+                    pUnused = &(gStaticQueues[x]);
+                }
+            } else if (gStaticQueues[x].storageSizeBytes >= storageSizeBytes) {
+                pSlot = &(gStaticQueues[x]);
+            }
+        }
+    }
+    if ((pSlot == NULL) && (pUnused != NULL) &&
+        (gStaticQueueStorageUsed + storageSizeBytes <= sizeof(gStaticQueueStorage))) {
+        pSlot = pUnused;
+        pSlot->pStorage = gStaticQueueStorage + gStaticQueueStorageUsed;
+        pSlot->storageSizeBytes = storageSizeBytes;
+        gStaticQueueStorageUsed += storageSizeBytes;
+    }
+    if (pSlot != NULL) {
+        pSlot->handle = (QueueHandle_t) &(pSlot->queue);
+    }
+    CELLULAR_PORT_STATIC_POOL_UNLOCK();
+
+    return pSlot;
+}
+
+// Give back the queue slot holding the given queue.
+static void staticQueueFree(QueueHandle_t handle)
+{
+    CELLULAR_PORT_STATIC_POOL_LOCK();
+    for (size_t x = 0; x < sizeof(gStaticQueues) / sizeof(gStaticQueues[0]); x++) {
+        if (gStaticQueues[x].handle == handle) {
+            gStaticQueues[x].handle = NULL;
+        }
+    }
+    CELLULAR_PORT_STATIC_POOL_UNLOCK();
+}
+
+// Reserve a mutex slot, NULL if there are none left.
+static CellularPortStaticMutex_t *pStaticMutexAlloc()
+{
+    CellularPortStaticMutex_t *pSlot = NULL;
+
+    CELLULAR_PORT_STATIC_POOL_LOCK();
+    for (size_t x = 0; (pSlot == NULL) &&
+                       (x < sizeof(gStaticMutexes) / sizeof(gStaticMutexes[0])); x++) {
+        if (gStaticMutexes[x].handle == NULL) {
+            pSlot = &(gStaticMutexes[x]);
+            pSlot->handle = (SemaphoreHandle_t) &(pSlot->mutex);
+        }
+    }
+    CELLULAR_PORT_STATIC_POOL_UNLOCK();
+
+    return pSlot;
+}
+
+// Give back the mutex slot holding the given mutex.
+static void staticMutexFree(SemaphoreHandle_t handle)
+{
+    CELLULAR_PORT_STATIC_POOL_LOCK();
+    for (size_t x = 0; x < sizeof(gStaticMutexes) / sizeof(gStaticMutexes[0]); x++) {
+        if (gStaticMutexes[x].handle == handle) {
+            gStaticMutexes[x].handle = NULL;
+        }
+    }
+    CELLULAR_PORT_STATIC_POOL_UNLOCK();
+}
+#endif
+
 /* ----------------------------------------------------------------
  * PUBLIC FUNCTIONS: TASKS
  * -------------------------------------------------------------- */
@@ -55,13 +292,32 @@ int32_t cellularPortTaskCreate(void (*pFunction)(void *),
                                CellularPortTaskHandle_t *pTaskHandle)
 {
     CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+#if CELLULAR_CFG_STATIC_ALLOC
+    CellularPortStaticTask_t *pSlot;
+    size_t stackDepth;
+#endif
 
     if ((pFunction != NULL) && (pTaskHandle != NULL)) {
+#if CELLULAR_CFG_STATIC_ALLOC
+        errorCode = CELLULAR_PORT_OUT_OF_MEMORY;
+        stackDepth = stackSizeBytes / sizeof(StackType_t);
+        pSlot = pStaticTaskAlloc(stackDepth);
+        if (pSlot != NULL) {
+            *pTaskHandle = (CellularPortTaskHandle_t) xTaskCreateStatic(pFunction, pName,
+                                                                        stackDepth,
+                                                                        pParameter,
+                                                                        priority,
+                                                                        pSlot->pStack,
+                                                                        &(pSlot->tcb));
+            errorCode = CELLULAR_PORT_SUCCESS;
+        }
+#else
         if (xTaskCreate(pFunction, pName, stackSizeBytes,
                         pParameter, priority,
                         (TaskHandle_t *) pTaskHandle) == pdPASS) {
             errorCode = CELLULAR_PORT_SUCCESS;
         }
+#endif
     }
 
     return (int32_t) errorCode;
@@ -74,6 +330,9 @@ int32_t cellularPortTaskDelete(const CellularPortTaskHandle_t taskHandle)
 
     // Can only delete oneself in freeRTOS
     if (taskHandle == NULL) {
+#if CELLULAR_CFG_STATIC_ALLOC
+        staticTaskFree(xTaskGetCurrentTaskHandle());
+#endif
         vTaskDelete((TaskHandle_t) taskHandle);
         errorCode = CELLULAR_PORT_SUCCESS;
     }
@@ -87,6 +346,19 @@ bool cellularPortTaskIsThis(const CellularPortTaskHandle_t taskHandle)
     return xTaskGetCurrentTaskHandle() == (TaskHandle_t) taskHandle;
 }
 
+// Get the minimum free stack for a task; under
+// ESP-IDF the high water mark is already in bytes.
+int32_t cellularPortTaskStackMinFree(const CellularPortTaskHandle_t taskHandle)
+{
+    TaskHandle_t handle = (TaskHandle_t) taskHandle;
+
+    if (handle == NULL) {
+        handle = xTaskGetCurrentTaskHandle();
+    }
+
+    return uxTaskGetStackHighWaterMark(handle);
+}
+
 // Block the current task for a time.
 void cellularPortTaskBlock(int32_t delayMs)
 {
@@ -103,8 +375,22 @@ int32_t cellularPortQueueCreate(size_t queueLength,
                                 CellularPortQueueHandle_t *pQueueHandle)
 {
     CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+#if CELLULAR_CFG_STATIC_ALLOC
+    CellularPortStaticQueue_t *pSlot;
+#endif
 
     if (pQueueHandle != NULL) {
+#if CELLULAR_CFG_STATIC_ALLOC
+        errorCode = CELLULAR_PORT_OUT_OF_MEMORY;
+        pSlot = pStaticQueueAlloc(queueLength * itemSizeBytes);
+        if (pSlot != NULL) {
+            *pQueueHandle = (CellularPortQueueHandle_t) xQueueCreateStatic(queueLength,
+                                                                           itemSizeBytes,
+                                                                           pSlot->pStorage,
+                                                                           &(pSlot->queue));
+            errorCode = CELLULAR_PORT_SUCCESS;
+        }
+#else
         errorCode = CELLULAR_PORT_PLATFORM_ERROR;
         // Actually create the queue
         *pQueueHandle = (CellularPortQueueHandle_t) xQueueCreate(queueLength,
@@ -112,6 +398,7 @@ int32_t cellularPortQueueCreate(size_t queueLength,
         if (*pQueueHandle != NULL) {
             errorCode = CELLULAR_PORT_SUCCESS;
         }
+#endif
     }
 
     return (int32_t) errorCode;
@@ -124,6 +411,9 @@ int32_t cellularPortQueueDelete(const CellularPortQueueHandle_t queueHandle)
 
     if (queueHandle != NULL) {
         vQueueDelete((QueueHandle_t) queueHandle);
+#if CELLULAR_CFG_STATIC_ALLOC
+        staticQueueFree((QueueHandle_t) queueHandle);
+#endif
         errorCode = CELLULAR_PORT_SUCCESS;
     }
 
@@ -192,14 +482,26 @@ int32_t cellularPortQueueTryReceive(const CellularPortQueueHandle_t queueHandle,
 int32_t cellularPortMutexCreate(CellularPortMutexHandle_t *pMutexHandle)
 {
     CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+#if CELLULAR_CFG_STATIC_ALLOC
+    CellularPortStaticMutex_t *pSlot;
+#endif
 
     if (pMutexHandle != NULL) {
+#if CELLULAR_CFG_STATIC_ALLOC
+        errorCode = CELLULAR_PORT_OUT_OF_MEMORY;
+        pSlot = pStaticMutexAlloc();
+        if (pSlot != NULL) {
+            *pMutexHandle = (CellularPortMutexHandle_t) xSemaphoreCreateMutexStatic(&(pSlot->mutex));
+            errorCode = CELLULAR_PORT_SUCCESS;
+        }
+#else
         errorCode = CELLULAR_PORT_PLATFORM_ERROR;
         // Actually create the mutex
         *pMutexHandle = (CellularPortMutexHandle_t) xSemaphoreCreateMutex();
         if (*pMutexHandle != NULL) {
             errorCode = CELLULAR_PORT_SUCCESS;
         }
+#endif
     }
 
     return (int32_t) errorCode;
@@ -212,6 +514,9 @@ int32_t cellularPortMutexDelete(const CellularPortMutexHandle_t mutexHandle)
 
     if (mutexHandle != NULL) {
         vSemaphoreDelete((SemaphoreHandle_t) mutexHandle);
+#if CELLULAR_CFG_STATIC_ALLOC
+        staticMutexFree((SemaphoreHandle_t) mutexHandle);
+#endif
         errorCode = CELLULAR_PORT_SUCCESS;
     }
 
@@ -23,6 +23,11 @@
 #include "cellular_port_uart.h"
 
 #include "driver/uart.h"
+#if defined(__has_include)
+# if __has_include("esp_idf_version.h")
+#  include "esp_idf_version.h"
+# endif
+#endif
 
 /* ----------------------------------------------------------------
  * COMPILE-TIME MACROS
@@ -32,6 +37,28 @@
 // "uart" parameter on this platform
 #define CELLULAR_PORT_UART_MAX_NUM 3
 
+// The space to leave in the UART hardware receive FIFO when RTS
+// is de-asserted if rtsThreshold is given as zero or is too
+// large for the FIFO.  The ESP-IDF UART driver stops emptying
+// the FIFO when its receive ring buffer is full, so the FIFO
+// level that RTS follows is in effect tied to the occupancy
+// of the receive ring buffer.
+#ifndef CELLULAR_PORT_UART_RTS_FIFO_SPACE
+# define CELLULAR_PORT_UART_RTS_FIFO_SPACE 16
+#endif
+
+// Set this to 0 to switch off line detection: by default the
+// ESP-IDF UART driver is asked to detect the '\n' that ends
+// each line from the module, an event reporting data that does
+// not complete a line then being passed on as zero bytes so
+// that the URC task only gets to work on complete lines.
+#ifndef CELLULAR_PORT_UART_LINE_DETECT
+# define CELLULAR_PORT_UART_LINE_DETECT 1
+#endif
+
+// The character that ends a line.
+#define CELLULAR_PORT_UART_LINE_END '\n'
+
 /* ----------------------------------------------------------------
  * TYPES
  * -------------------------------------------------------------- */
@@ -43,10 +70,129 @@
 // Mutexes to protect the UART hardware.
 static CellularPortMutexHandle_t gMutex[CELLULAR_PORT_UART_MAX_NUM] = {NULL};
 
+// The event queue of each UART, so that events arriving
+// on a queue can be attributed to a UART.
+static CellularPortQueueHandle_t gQueue[CELLULAR_PORT_UART_MAX_NUM] = {NULL};
+
+// The receive buffer size for each UART, zero meaning
+// CELLULAR_PORT_UART_RX_BUFFER_SIZE.
+static size_t gRxBufferSize[CELLULAR_PORT_UART_MAX_NUM] = {0};
+
+// The receive statistics for each UART.
+static CellularPortUartStats_t gStats[CELLULAR_PORT_UART_MAX_NUM];
+
 /* ----------------------------------------------------------------
  * STATIC FUNCTIONS
  * -------------------------------------------------------------- */
 
+// Update the receive statistics for a UART event that has been
+// taken from an event queue.
+static void statsEventUpdate(const CellularPortQueueHandle_t queueHandle,
+                             const uart_event_t *pUartEvent)
+{
+    for (size_t x = 0; x < sizeof(gQueue) / sizeof(gQueue[0]); x++) {
+        if ((gQueue[x] != NULL) && (gQueue[x] == queueHandle)) {
+            switch (pUartEvent->type) {
+                case UART_FIFO_OVF:
+                    // The hardware FIFO overflowed, data is lost
+                    gStats[x].rxOverruns++;
+                break;
+                case UART_BUFFER_FULL:
+                    // The driver has stopped emptying the FIFO,
+                    // nothing is lost unless the FIFO then overflows
+                    gStats[x].rxHighWaterMarkBytes = gStats[x].rxBufferSizeBytes;
+                break;
+                default:
+                break;
+            }
+        }
+    }
+}
+
+// Update the receive high-water mark of a UART; the UART
+// mutex must be locked before this is called.
+static void statsHighWaterMarkUpdate(int32_t uart, size_t receiveSize)
+{
+    if (receiveSize > gStats[uart].rxHighWaterMarkBytes) {
+        gStats[uart].rxHighWaterMarkBytes = receiveSize;
+    }
+}
+
+// Switch on detection of the end of a line by the ESP-IDF UART
+// driver, which then sends UART_PATTERN_DET events.
+static esp_err_t lineDetectEnable(int32_t uart)
+{
+    esp_err_t espError = ESP_OK;
+
+#if CELLULAR_PORT_UART_LINE_DETECT
+    // Idle times of zero since a line end can be followed
+    // immediately by the next line
+# if defined(ESP_IDF_VERSION_MAJOR) && (ESP_IDF_VERSION_MAJOR >= 4)
+    espError = uart_enable_pattern_det_baud_intr(uart,
+                                                 CELLULAR_PORT_UART_LINE_END,
+                                                 1, 1, 0, 0);
+# else
+    espError = uart_enable_pattern_det_intr(uart,
+                                            CELLULAR_PORT_UART_LINE_END,
+                                            1, 1, 0, 0);
+# endif
+    if (espError == ESP_OK) {
+        // The driver keeps the positions of the line ends,
+        // moving them along as data is read
+        espError = uart_pattern_queue_reset(uart,
+                                            CELLULAR_PORT_UART_EVENT_QUEUE_SIZE);
+    }
+#else
+    (void) uart;
+#endif
+
+    return espError;
+}
+
+// Convert an event taken from an event queue into the size or
+// error code that cellularPortUartEventReceive() and
+// cellularPortUartEventTryReceive() return.  With line detection
+// on, data that doesn't complete a line is reported as zero
+// bytes; an end of line, or an event sent by
+// cellularPortUartEventSend(), gives the number of bytes waiting.
+static int32_t eventSizeOrError(const CellularPortQueueHandle_t queueHandle,
+                                const uart_event_t *pUartEvent)
+{
+    int32_t sizeOrErrorCode = CELLULAR_PORT_UNKNOWN_ERROR;
+    size_t receiveSize;
+
+    if (pUartEvent->type < UART_EVENT_MAX) {
+        sizeOrErrorCode = 0;
+        if (pUartEvent->type == UART_DATA) {
+            sizeOrErrorCode = pUartEvent->size;
+#if CELLULAR_PORT_UART_LINE_DETECT
+            for (size_t x = 0; x < sizeof(gQueue) / sizeof(gQueue[0]); x++) {
+                if ((gQueue[x] != NULL) && (gQueue[x] == queueHandle) &&
+                    (uart_pattern_get_pos(x) < 0)) {
+                    // No line end in what is waiting
+                    sizeOrErrorCode = 0;
+                }
+            }
+#endif
+        } else if (pUartEvent->type == UART_PATTERN_DET) {
+            sizeOrErrorCode = pUartEvent->size;
+            for (size_t x = 0; x < sizeof(gQueue) / sizeof(gQueue[0]); x++) {
+                if ((gQueue[x] != NULL) && (gQueue[x] == queueHandle) &&
+                    (uart_get_buffered_data_len(x, &receiveSize) == ESP_OK)) {
+                    sizeOrErrorCode = receiveSize;
+                }
+            }
+            if (sizeOrErrorCode == 0) {
+                // Someone has read it already but the
+                // size still has to say "data"
+                sizeOrErrorCode = 1;
+            }
+        }
+    }
+
+    return sizeOrErrorCode;
+}
+
 /* ----------------------------------------------------------------
  * PUBLIC FUNCTIONS
  * -------------------------------------------------------------- */
@@ -62,6 +208,7 @@ int32_t cellularPortUartInit(int32_t pinTx, int32_t pinRx,
     CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
     uart_config_t config;
     esp_err_t espError;
+    size_t rxBufferSize;
 
     if ((pUartQueue != NULL) && (pinRx >= 0) && (pinTx >= 0) &&
         (uart < sizeof(gMutex) / sizeof(gMutex[0]))) {
@@ -82,6 +229,21 @@ int32_t cellularPortUartInit(int32_t pinTx, int32_t pinRx,
                 // Set the baud rate
                 config.baud_rate = baudRate;
 
+                // Sort out the RTS threshold, which is a level
+                // in the hardware FIFO on this platform
+                if ((rtsThreshold == 0) ||
+                    (rtsThreshold > UART_FIFO_LEN - CELLULAR_PORT_UART_RTS_FIFO_SPACE)) {
+                    rtsThreshold = UART_FIFO_LEN - CELLULAR_PORT_UART_RTS_FIFO_SPACE;
+                }
+
+                // Sort out the receive buffer size; the
+                // ESP-IDF driver requires it to be larger
+                // than the hardware FIFO
+                rxBufferSize = gRxBufferSize[uart];
+                if (rxBufferSize == 0) {
+                    rxBufferSize = CELLULAR_PORT_UART_RX_BUFFER_SIZE;
+                }
+
                 // Set flow control
                 config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
                 config.rx_flow_ctrl_thresh = 0;
@@ -113,12 +275,22 @@ int32_t cellularPortUartInit(int32_t pinTx, int32_t pinRx,
                         if (espError == ESP_OK) {
                             // Install the driver
                             espError = uart_driver_install(uart,
-                                                           CELLULAR_PORT_UART_RX_BUFFER_SIZE,
+                                                           rxBufferSize,
                                                            0, /* Blocking transmit */
                                                            CELLULAR_PORT_UART_EVENT_QUEUE_SIZE,
                                                            (QueueHandle_t *) pUartQueue,
                                                            0);
                             if (espError == ESP_OK) {
+                                espError = lineDetectEnable(uart);
+                                if (espError != ESP_OK) {
+                                    uart_driver_delete(uart);
+                                }
+                            }
+                            if (espError == ESP_OK) {
+                                gQueue[uart] = *pUartQueue;
+                                pCellularPort_memset(&(gStats[uart]), 0,
+                                                     sizeof(gStats[uart]));
+                                gStats[uart].rxBufferSizeBytes = rxBufferSize;
                                 errorCode = CELLULAR_PORT_SUCCESS;
                             }
                         }
@@ -158,6 +330,7 @@ int32_t cellularPortUartDeinit(int32_t uart)
             // is in progress when this function is called.
             espError = uart_driver_delete(uart);
             if (espError == ESP_OK) {
+                gQueue[uart] = NULL;
                 cellularPortMutexDelete(gMutex[uart]);
                 gMutex[uart] = NULL;
                 errorCode = CELLULAR_PORT_SUCCESS;
@@ -182,9 +355,14 @@ int32_t cellularPortUartEventSend(const CellularPortQueueHandle_t queueHandle,
         // illegal value
         uartEvent.type = UART_EVENT_MAX;
         uartEvent.size = 0;
-        if (sizeBytesOrError >= 0) {
-            uartEvent.type = UART_DATA;
+        if (sizeBytesOrError > 0) {
+            // The AT client may already have read the line
+            // end out of the driver, so this must never be
+            // held back by line detection: send it as one
+            uartEvent.type = UART_PATTERN_DET;
             uartEvent.size = sizeBytesOrError;
+        } else if (sizeBytesOrError == 0) {
+            uartEvent.type = UART_DATA;
         }
         errorCode = cellularPortQueueSend(queueHandle, (void *) &uartEvent);
     }
@@ -201,14 +379,8 @@ int32_t cellularPortUartEventReceive(const CellularPortQueueHandle_t queueHandle
     if (queueHandle != NULL) {
         sizeOrErrorCode = CELLULAR_PORT_PLATFORM_ERROR;
         if (cellularPortQueueReceive(queueHandle, &uartEvent) == 0) {
-            sizeOrErrorCode = CELLULAR_PORT_UNKNOWN_ERROR;
-            if (uartEvent.type < UART_EVENT_MAX) {
-                if (uartEvent.type == UART_DATA) {
-                    sizeOrErrorCode = uartEvent.size;
-                } else {
-                    sizeOrErrorCode = 0;
-                }
-            }
+            statsEventUpdate(queueHandle, &uartEvent);
+            sizeOrErrorCode = eventSizeOrError(queueHandle, &uartEvent);
         }
     }
 
@@ -225,14 +397,8 @@ int32_t cellularPortUartEventTryReceive(const CellularPortQueueHandle_t queueHan
     if (queueHandle != NULL) {
         sizeOrErrorCode = CELLULAR_PORT_TIMEOUT;
         if (cellularPortQueueTryReceive(queueHandle, waitMs, &uartEvent) == 0) {
-            sizeOrErrorCode = CELLULAR_PORT_UNKNOWN_ERROR;
-            if (uartEvent.type < UART_EVENT_MAX) {
-                if (uartEvent.type == UART_DATA) {
-                    sizeOrErrorCode = uartEvent.size;
-                } else {
-                    sizeOrErrorCode = 0;
-                }
-            }
+            statsEventUpdate(queueHandle, &uartEvent);
+            sizeOrErrorCode = eventSizeOrError(queueHandle, &uartEvent);
         }
     }
 
@@ -254,6 +420,7 @@ int32_t cellularPortUartGetReceiveSize(int32_t uart)
 
             // Will get back either size or -1
             if (uart_get_buffered_data_len(uart, &(receiveSize)) == 0) {
+                statsHighWaterMarkUpdate(uart, receiveSize);
                 sizeOrErrorCode = receiveSize;
             }
 
@@ -269,6 +436,7 @@ int32_t cellularPortUartRead(int32_t uart, char *pBuffer,
                              size_t sizeBytes)
 {
     CellularPortErrorCode_t sizeOrErrorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    size_t receiveSize;
 
     if ((pBuffer != NULL) && (sizeBytes > 0) &&
         (uart < sizeof(gMutex) / sizeof(gMutex[0]))) {
@@ -277,6 +445,10 @@ int32_t cellularPortUartRead(int32_t uart, char *pBuffer,
 
             CELLULAR_PORT_MUTEX_LOCK(gMutex[uart]);
 
+            if (uart_get_buffered_data_len(uart, &(receiveSize)) == 0) {
+                statsHighWaterMarkUpdate(uart, receiveSize);
+            }
+
             // Will get back either size or -1
             sizeOrErrorCode = uart_read_bytes(uart, (uint8_t *) pBuffer, sizeBytes, 0);
             if (sizeOrErrorCode < 0) {
@@ -290,6 +462,27 @@ int32_t cellularPortUartRead(int32_t uart, char *pBuffer,
     return (int32_t) sizeOrErrorCode;
 }
 
+// Get a pointer to the data waiting in the receive buffer:
+// not possible on this platform as the ESP-IDF UART driver keeps
+// its receive ring buffer to itself.
+int32_t cellularPortUartReadSpan(int32_t uart, const char **ppData)
+{
+    (void) uart;
+    (void) ppData;
+
+    return (int32_t) CELLULAR_PORT_NOT_IMPLEMENTED;
+}
+
+// Mark data obtained through cellularPortUartReadSpan() as read:
+// not possible on this platform.
+int32_t cellularPortUartReadCommit(int32_t uart, size_t sizeBytes)
+{
+    (void) uart;
+    (void) sizeBytes;
+
+    return (int32_t) CELLULAR_PORT_NOT_IMPLEMENTED;
+}
+
 // Write to the given UART interface.
 int32_t cellularPortUartWrite(int32_t uart,
                               const char *pBuffer,
@@ -317,6 +510,34 @@ int32_t cellularPortUartWrite(int32_t uart,
     return (int32_t) sizeOrErrorCode;
 }
 
+// Change the baud rate of the given UART interface.
+int32_t cellularPortUartSetBaudRate(int32_t uart,
+                                    int32_t baudRate)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+
+    if ((baudRate > 0) &&
+        (uart < sizeof(gMutex) / sizeof(gMutex[0]))) {
+        errorCode = CELLULAR_PORT_NOT_INITIALISED;
+        if (gMutex[uart] != NULL) {
+
+            CELLULAR_PORT_MUTEX_LOCK(gMutex[uart]);
+
+            errorCode = CELLULAR_PORT_PLATFORM_ERROR;
+            // Let anything on its way out go before
+            // changing the rate underneath it
+            if ((uart_wait_tx_done(uart, portMAX_DELAY) == ESP_OK) &&
+                (uart_set_baudrate(uart, baudRate) == ESP_OK)) {
+                errorCode = CELLULAR_PORT_SUCCESS;
+            }
+
+            CELLULAR_PORT_MUTEX_UNLOCK(gMutex[uart]);
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
 // Determine if RTS flow control is enabled.
 bool cellularPortIsRtsFlowControlEnabled(int32_t uart)
 {
@@ -365,4 +586,85 @@ bool cellularPortIsCtsFlowControlEnabled(int32_t uart)
     return ctsFlowControlIsEnabled;
 }
 
+// Set the receive buffer size for the next initialisation of a UART.
+int32_t cellularPortUartSetRxBufferSize(int32_t uart,
+                                        size_t sizeBytes)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+
+    // The ESP-IDF driver requires the receive buffer
+    // to be larger than the hardware FIFO
+    if ((uart < sizeof(gMutex) / sizeof(gMutex[0])) &&
+        (gMutex[uart] == NULL) &&
+        ((sizeBytes == 0) || (sizeBytes > UART_FIFO_LEN))) {
+        gRxBufferSize[uart] = sizeBytes;
+        errorCode = CELLULAR_PORT_SUCCESS;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Get the receive statistics of a UART.
+int32_t cellularPortUartGetStats(int32_t uart,
+                                 CellularPortUartStats_t *pStats)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+
+    if ((pStats != NULL) &&
+        (uart < sizeof(gMutex) / sizeof(gMutex[0]))) {
+        errorCode = CELLULAR_PORT_NOT_INITIALISED;
+        if (gMutex[uart] != NULL) {
+
+            CELLULAR_PORT_MUTEX_LOCK(gMutex[uart]);
+
+            *pStats = gStats[uart];
+            errorCode = CELLULAR_PORT_SUCCESS;
+
+            CELLULAR_PORT_MUTEX_UNLOCK(gMutex[uart]);
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Reset the receive statistics of a UART.
+int32_t cellularPortUartResetStats(int32_t uart)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+
+    if (uart < sizeof(gMutex) / sizeof(gMutex[0])) {
+        errorCode = CELLULAR_PORT_NOT_INITIALISED;
+        if (gMutex[uart] != NULL) {
+
+            CELLULAR_PORT_MUTEX_LOCK(gMutex[uart]);
+
+            gStats[uart].rxHighWaterMarkBytes = 0;
+            gStats[uart].rxOverruns = 0;
+            gStats[uart].rxBytesLost = 0;
+            errorCode = CELLULAR_PORT_SUCCESS;
+
+            CELLULAR_PORT_MUTEX_UNLOCK(gMutex[uart]);
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Suspend a UART: not supported on this platform, the ESP-IDF
+// UART driver looks after its own power management.
+int32_t cellularPortUartSuspend(int32_t uart)
+{
+    (void) uart;
+
+    return (int32_t) CELLULAR_PORT_NOT_IMPLEMENTED;
+}
+
+// Resume a UART: not supported on this platform.
+int32_t cellularPortUartResume(int32_t uart)
+{
+    (void) uart;
+
+    return (int32_t) CELLULAR_PORT_NOT_IMPLEMENTED;
+}
+
 // End of file
@@ -0,0 +1,137 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _CELLULAR_CFG_HW_PLATFORM_SPECIFIC_H_
+#define _CELLULAR_CFG_HW_PLATFORM_SPECIFIC_H_
+
+/* No #includes allowed here */
+
+/* This header file contains hardware configuration information for
+ * a Linux (or other POSIX) host.  The "UART" is a serial device,
+ * e.g. a USB to serial adapter wired to a real module or the
+ * pseudo-terminal of the modem simulator in the simulator
+ * directory, and the "pins" are virtual.
+ */
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS FOR POSIX: UART
+ * -------------------------------------------------------------- */
+
+#ifndef CELLULAR_CFG_UART
+/** The UART number to use; the device behind it is given by
+ * CELLULAR_PORT_UART_DEVICE_FORMAT.
+ */
+# define CELLULAR_CFG_UART                           0
+#endif
+
+#ifndef CELLULAR_PORT_UART_DEVICE_FORMAT
+/** The device path of a UART, a printf()-style format into
+ * which the UART number is put.  The default is where the
+ * modem simulator puts its pseudo-terminal.  The environment
+ * variable CELLULAR_PORT_UART_<n>, e.g. CELLULAR_PORT_UART_0,
+ * overrides this at run-time, e.g. with /dev/ttyUSB0.
+ */
+# define CELLULAR_PORT_UART_DEVICE_FORMAT            "/tmp/cellular_uart%d"
+#endif
+
+#ifndef CELLULAR_CFG_RTS_THRESHOLD
+/** The buffer threshold at which RTS is de-asserted.  Hardware
+ * flow control, where used, is done by the serial driver of the
+ * host so this is not used on this platform.
+ */
+# define CELLULAR_CFG_RTS_THRESHOLD                  0
+#endif
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS FOR POSIX: NON-VOLATILE STORAGE
+ * -------------------------------------------------------------- */
+
+#ifndef CELLULAR_PORT_NV_PATH_FORMAT
+/** The path of the file in which cellularPortNvStore() keeps a
+ * block of data, a printf()-style format into which the ID is
+ * put; relative to the current working directory.
+ */
+# define CELLULAR_PORT_NV_PATH_FORMAT                "cellular_nv_%d.bin"
+#endif
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS FOR POSIX: PINS
+ * -------------------------------------------------------------- */
+
+/* There are no real pins: cellularPortGpioSet() and
+ * cellularPortGpioGet() work on an array of virtual pins,
+ * numbered 0 to CELLULAR_PORT_GPIO_MAX_NUM - 1, which is enough
+ * for the power control code to run against the modem
+ * simulator.  The pins of the UART are ignored.
+ */
+
+#ifndef CELLULAR_CFG_PIN_ENABLE_POWER
+/** The GPIO output that enables power to the cellular module.
+ * -1 is used where there is no such connection.
+ */
+# define CELLULAR_CFG_PIN_ENABLE_POWER     -1
+#endif
+
+#ifndef CELLULAR_CFG_PIN_PWR_ON
+/** The GPIO output that that is connected to the PWR_ON pin of
+ * the cellular module.
+ */
+# define CELLULAR_CFG_PIN_PWR_ON            0
+#endif
+
+#ifndef CELLULAR_CFG_PIN_VINT
+/** The GPIO input that is connected to the VInt pin of the
+ * cellular module.
+ * -1 is used where there is no such connection.
+ */
+# define CELLULAR_CFG_PIN_VINT              -1
+#endif
+
+#ifndef CELLULAR_CFG_PIN_TXD
+/** The GPIO output pin that sends UART data to the cellular
+ * module; not used on this platform.
+ */
+# define CELLULAR_CFG_PIN_TXD               -1
+#endif
+
+#ifndef CELLULAR_CFG_PIN_RXD
+/** The GPIO input pin that receives UART data from the cellular
+ * module; not used on this platform.
+ */
+# define CELLULAR_CFG_PIN_RXD               -1
+#endif
+
+#ifndef CELLULAR_CFG_PIN_CTS
+/** The GPIO input pin that the cellular modem will use to
+ * indicate that data can be sent to it; set this to anything
+ * other than -1 to switch on hardware flow control (CRTSCTS)
+ * on the serial device.
+ */
+# define CELLULAR_CFG_PIN_CTS               -1
+#endif
+
+#ifndef CELLULAR_CFG_PIN_RTS
+/** The GPIO output pin that tells the cellular modem that it
+ * can send more data; set this to anything other than -1 to
+ * switch on hardware flow control (CRTSCTS) on the serial
+ * device.
+ */
+# define CELLULAR_CFG_PIN_RTS               -1
+#endif
+
+#endif // _CELLULAR_CFG_HW_PLATFORM_SPECIFIC_H_
+
+// End of file
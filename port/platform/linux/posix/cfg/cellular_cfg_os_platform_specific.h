@@ -0,0 +1,161 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _CELLULAR_CFG_OS_PLATFORM_SPECIFIC_H_
+#define _CELLULAR_CFG_OS_PLATFORM_SPECIFIC_H_
+
+/* No #includes allowed here */
+
+/* This header file contains OS configuration information for
+ * a Linux (or other POSIX) host.
+ */
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS FOR POSIX: OS GENERIC
+ * -------------------------------------------------------------- */
+
+#ifndef CELLULAR_PORT_OS_PRIORITY_MIN
+/** The minimum task priority.  Tasks are pthreads running
+ * under the normal (SCHED_OTHER) scheduling policy, which has
+ * no priorities, so the priority numbers are kept only so that
+ * the checks made by the portable code still hold.
+ */
+# define CELLULAR_PORT_OS_PRIORITY_MIN 0
+#endif
+
+#ifndef CELLULAR_PORT_OS_PRIORITY_MAX
+/** The maximum task priority; see CELLULAR_PORT_OS_PRIORITY_MIN.
+ */
+# define CELLULAR_PORT_OS_PRIORITY_MAX 15
+#endif
+
+#ifndef CELLULAR_PORT_TASK_STACK_EXTRA_BYTES
+/** The stack of a task is this much larger than was asked for,
+ * to make room for the C library of the host, which needs a lot
+ * more stack (e.g. in vsnprintf()) than that of an embedded
+ * target.  cellularPortTaskStackMinFree() reports against the
+ * size that was asked for, leaving out what the host had
+ * already used when the task started, so that the figure can be
+ * compared with that of an embedded target.
+ */
+# define CELLULAR_PORT_TASK_STACK_EXTRA_BYTES (1024 * 32)
+#endif
+
+#ifndef CELLULAR_PORT_TASK_STACK_PAINT
+/** Set this to 1 to fill the stack of each task with a pattern
+ * when it starts so that cellularPortTaskStackMinFree() can work
+ * out how far down the stack has been used.  Set it to 0 when
+ * running under valgrind, which otherwise complains about the
+ * pattern being read back from below the stack pointer;
+ * cellularPortTaskStackMinFree() then returns
+ * CELLULAR_PORT_NOT_IMPLEMENTED.
+ */
+# define CELLULAR_PORT_TASK_STACK_PAINT 1
+#endif
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS FOR POSIX: AT CLIENT RELATED
+ * -------------------------------------------------------------- */
+
+#ifndef CELLULAR_CTRL_AT_TASK_URC_STACK_SIZE_BYTES
+/** The stack size for the AT task that handles URCs.
+ */
+# define CELLULAR_CTRL_AT_TASK_URC_STACK_SIZE_BYTES (1024 * 5)
+#endif
+
+#ifndef CELLULAR_CTRL_AT_TASK_URC_PRIORITY
+/** The task priority for the URC handler.
+ */
+# define CELLULAR_CTRL_AT_TASK_URC_PRIORITY (CELLULAR_PORT_OS_PRIORITY_MAX - 5)
+#endif
+
+#ifndef CELLULAR_CTRL_TASK_CALLBACK_STACK_SIZE_BYTES
+/** The stack size of the task in the context of which the callbacks
+ * of AT command URCs will be run.
+ */
+# define CELLULAR_CTRL_TASK_CALLBACK_STACK_SIZE_BYTES (1024 * 5)
+#endif
+
+#ifndef CELLULAR_CTRL_TASK_CALLBACK_PRIORITY
+/** The task priority for any callback made via
+ * cellular_ctrl_at_callback().
+ */
+# define CELLULAR_CTRL_TASK_CALLBACK_PRIORITY (CELLULAR_PORT_OS_PRIORITY_MIN + 2)
+#endif
+
+#ifndef CELLULAR_SOCK_TASK_DNS_STACK_SIZE_BYTES
+/** The stack size of the task in which the look-ups of
+ * cellularSockGetHostByNameAsync() are done and their callbacks
+ * are run.
+ */
+# define CELLULAR_SOCK_TASK_DNS_STACK_SIZE_BYTES (1024 * 3)
+#endif
+
+#ifndef CELLULAR_SOCK_TASK_DNS_PRIORITY
+/** The task priority for the look-ups of
+ * cellularSockGetHostByNameAsync().
+ */
+# define CELLULAR_SOCK_TASK_DNS_PRIORITY (CELLULAR_PORT_OS_PRIORITY_MIN + 1)
+#endif
+
+#ifndef CELLULAR_CTRL_TASK_TX_SCHEDULER_STACK_SIZE_BYTES
+/** The stack size of the task of the transmit scheduler, see
+ * cellularCtrlTxSchedulerStart(), in which the sends that were
+ * held back are made.
+ */
+# define CELLULAR_CTRL_TASK_TX_SCHEDULER_STACK_SIZE_BYTES (1024 * 3)
+#endif
+
+#ifndef CELLULAR_CTRL_TASK_TX_SCHEDULER_PRIORITY
+/** The task priority of the transmit scheduler.
+ */
+# define CELLULAR_CTRL_TASK_TX_SCHEDULER_PRIORITY (CELLULAR_PORT_OS_PRIORITY_MIN + 1)
+#endif
+
+#ifndef CELLULAR_PORT_TASK_LOG_STACK_SIZE_BYTES
+/** The stack size of the task that emits the messages stored
+ * with CELLULAR_CFG_LOG_DEFERRED.
+ */
+# define CELLULAR_PORT_TASK_LOG_STACK_SIZE_BYTES (1024 * 2)
+#endif
+
+#ifndef CELLULAR_PORT_TASK_LOG_PRIORITY
+/** The task priority of the task that emits the messages stored
+ * with CELLULAR_CFG_LOG_DEFERRED: the lowest there is.
+ */
+# define CELLULAR_PORT_TASK_LOG_PRIORITY CELLULAR_PORT_OS_PRIORITY_MIN
+#endif
+
+#ifndef CELLULAR_CTRL_CMUX_TASK_STACK_SIZE_BYTES
+/** The stack size of the task that takes CMUX frames off the
+ * UART and hands their contents to the virtual channels.
+ */
+# define CELLULAR_CTRL_CMUX_TASK_STACK_SIZE_BYTES (1024 * 2)
+#endif
+
+#ifndef CELLULAR_CTRL_CMUX_TASK_PRIORITY
+/** The task priority of the CMUX demultiplexer.
+ */
+# define CELLULAR_CTRL_CMUX_TASK_PRIORITY (CELLULAR_PORT_OS_PRIORITY_MAX - 4)
+#endif
+
+#if (CELLULAR_CTRL_TASK_CALLBACK_PRIORITY >= CELLULAR_CTRL_AT_TASK_URC_PRIORITY)
+# error CELLULAR_CTRL_TASK_CALLBACK_PRIORITY must be less than CELLULAR_CTRL_AT_TASK_URC_PRIORITY
+#endif
+
+#endif // _CELLULAR_CFG_OS_PLATFORM_SPECIFIC_H_
+
+// End of file
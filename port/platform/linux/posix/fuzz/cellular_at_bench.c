@@ -0,0 +1,320 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* A micro-benchmark of the tokenizer of the AT client: typical
+ * responses are received, through the memory UART of
+ * cellular_port_uart_memory.h, and read the way the cellular
+ * code reads them, over and over, giving the CPU time taken
+ * per byte and per response with no UART, no module and no
+ * waiting in the figures.  Each response is checked on the way
+ * so that an optimisation which breaks the tokenizer shows up
+ * here as a failure rather than as a speed-up.
+ *
+ * Usage: cellular_at_bench [iterations]
+ *
+ * The results are also given in the machine-readable form of
+ * CELLULAR_CFG_TEST_METRIC_TAG.  The exit code is the number
+ * of responses that were not read as expected.
+ */
+
+#ifdef CELLULAR_CFG_OVERRIDE
+# include "cellular_cfg_override.h" // For a customer's configuration override
+#endif
+#include "cellular_cfg_sw.h"
+#include "cellular_cfg_module.h"
+#include "cellular_cfg_hw_platform_specific.h"
+#include "cellular_port_clib.h"
+#include "cellular_port.h"
+#include "cellular_port_debug.h"
+#include "cellular_port_os.h"
+#include "cellular_port_uart.h"
+#include "cellular_port_uart_memory.h"
+#include "cellular_ctrl_at.h"
+#include "cellular_cfg_test.h"
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "time.h"
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS
+ * -------------------------------------------------------------- */
+
+// The default number of times each response is read.
+#define CELLULAR_AT_BENCH_DEFAULT_ITERATIONS 100000
+
+// The amount of socket data in the +USORD response.
+#define CELLULAR_AT_BENCH_USORD_DATA_LENGTH_BYTES 512
+
+// Room for a response.
+#define CELLULAR_AT_BENCH_RESPONSE_MAX_LENGTH_BYTES 1280
+
+// The longest name of a machine-readable result.
+#define CELLULAR_AT_BENCH_METRIC_NAME_MAX_LENGTH_BYTES 64
+
+/* ----------------------------------------------------------------
+ * TYPES
+ * -------------------------------------------------------------- */
+
+/** A response to benchmark.
+ */
+typedef struct {
+    const char *pName;            //!< for the results, no spaces.
+    bool (*pRead)();              //!< reads and checks the response.
+    char *pData;                  //!< the response.
+    size_t length;                //!< the length of pData.
+} CellularAtBenchResponse_t;
+
+/* ----------------------------------------------------------------
+ * VARIABLES
+ * -------------------------------------------------------------- */
+
+// Where the socket data read from +USORD is put.
+static uint8_t gUsordData[CELLULAR_AT_BENCH_USORD_DATA_LENGTH_BYTES];
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// Get the CPU time of this process in nanoseconds.
+static int64_t cpuTimeNs()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+
+    return ((int64_t) now.tv_sec * 1000000000) + now.tv_nsec;
+}
+
+// Read +CEREG as the control code does.
+static bool readCereg()
+{
+    char tac[8];
+    char cellId[12];
+    int32_t n = -1;
+    int32_t stat = -1;
+    int32_t rat = -1;
+
+    cellular_ctrl_at_read_fields("+CEREG:", "i,i,s,s,i", &n, &stat,
+                                 tac, sizeof(tac), cellId, sizeof(cellId),
+                                 &rat);
+    cellular_ctrl_at_resp_stop();
+
+    return (n == 2) && (stat == 5) && (rat == 7) &&
+           (cellularPort_strcmp(tac, "1A2B") == 0) &&
+           (cellularPort_strcmp(cellId, "01A2B3C4") == 0);
+}
+
+// Read +USORD as the sockets code does.
+static bool readUsord()
+{
+    int32_t length = -1;
+    uint8_t quoteMark;
+
+    cellular_ctrl_at_read_fields("+USORD:", "-,i", &length);
+    if (length == sizeof(gUsordData)) {
+        cellular_ctrl_at_set_delimiter(0);
+        cellular_ctrl_at_set_stop_tag(NULL);
+        cellular_ctrl_at_read_bytes(&quoteMark, 1);
+        cellular_ctrl_at_read_bytes(gUsordData, length);
+        cellular_ctrl_at_resp_stop();
+        cellular_ctrl_at_set_default_delimiter();
+    }
+
+    return (length == sizeof(gUsordData)) &&
+           (gUsordData[0] == '0') &&
+           (gUsordData[sizeof(gUsordData) - 1] == (uint8_t) ('0' + ((sizeof(gUsordData) - 1) % 64)));
+}
+
+// Read +USORD in hex mode, as the sockets code would with
+// AT+UDCONF=1,1.
+static bool readUsordHex()
+{
+    int32_t length = -1;
+    int32_t readLength = -1;
+
+    cellular_ctrl_at_read_fields("+USORD:", "-,i", &length);
+    if (length == sizeof(gUsordData)) {
+        readLength = cellular_ctrl_at_read_hex_string((char *) gUsordData,
+                                                      length);
+        cellular_ctrl_at_resp_stop();
+    }
+
+    return (readLength == sizeof(gUsordData)) &&
+           (gUsordData[0] == 0) &&
+           (gUsordData[sizeof(gUsordData) - 1] == (uint8_t) (sizeof(gUsordData) - 1));
+}
+
+// Read +CSQ with a +UUSORD URC in front of it, which the
+// search for the prefix hands to the URC handler.
+static bool readCsqWithUrc()
+{
+    int32_t rssi = -1;
+    int32_t ber = -1;
+
+    cellular_ctrl_at_read_fields("+CSQ:", "i,i", &rssi, &ber);
+    cellular_ctrl_at_resp_stop();
+
+    return (rssi == 20) && (ber == 99);
+}
+
+// The URC handler for +UUSORD.
+static void uusordUrc(void *pParam)
+{
+    (void) pParam;
+
+    cellular_ctrl_at_read_int();
+    cellular_ctrl_at_read_int();
+}
+
+// Print one machine-readable result.
+static void printMetric(const char *pName, const char *pMetric,
+                        int32_t value, const char *pUnit)
+{
+    char name[CELLULAR_AT_BENCH_METRIC_NAME_MAX_LENGTH_BYTES];
+
+    cellularPort_snprintf(name, sizeof(name), "atBench%s.%s", pName, pMetric);
+    cellularPortLog(CELLULAR_CFG_TEST_METRIC_FORMAT, name, value, pUnit);
+}
+
+// Benchmark a response, returning the number of
+// times it was not read as expected.
+static int benchmark(const CellularAtBenchResponse_t *pResponse,
+                     int32_t iterations)
+{
+    int failures = 0;
+    int64_t startNs;
+    int64_t cpuNs;
+
+    startNs = cpuTimeNs();
+    for (int32_t x = 0; x < iterations; x++) {
+        cellular_ctrl_at_lock();
+        cellularPortUartMemorySet(pResponse->pData, pResponse->length);
+        if (!pResponse->pRead() ||
+            (cellular_ctrl_at_get_last_error() != 0) ||
+            (cellularPortUartGetReceiveSize(CELLULAR_CFG_UART) != 0)) {
+            failures++;
+        }
+        cellular_ctrl_at_unlock();
+    }
+    cpuNs = cpuTimeNs() - startNs;
+
+    cellularPortLog("CELLULAR_AT_BENCH: %s %d byte(s) x %d: %d ns per byte,"
+                    " %d ns per response, %d not as expected.\n",
+                    pResponse->pName, (int32_t) pResponse->length, iterations,
+                    (int32_t) (cpuNs / ((int64_t) pResponse->length * iterations)),
+                    (int32_t) (cpuNs / iterations), failures);
+    printMetric(pResponse->pName, "ns_per_byte",
+                (int32_t) (cpuNs / ((int64_t) pResponse->length * iterations)),
+                "ns");
+    printMetric(pResponse->pName, "ns_per_response",
+                (int32_t) (cpuNs / iterations), "ns");
+
+    return failures;
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// Entry point.
+int main(int argc, char *argv[])
+{
+    CellularPortQueueHandle_t queueUart = NULL;
+    CellularAtBenchResponse_t responses[] = {{"Cereg", readCereg, NULL, 0},
+                                             {"Usord", readUsord, NULL, 0},
+                                             {"CsqWithUrc", readCsqWithUrc, NULL, 0},
+                                             {"UsordHex", readUsordHex, NULL, 0}};
+    int32_t iterations = CELLULAR_AT_BENCH_DEFAULT_ITERATIONS;
+    int failures = 0;
+    char *pTmp;
+
+    if (argc > 1) {
+        iterations = atoi(argv[1]);
+    }
+    if ((argc > 2) || (iterations <= 0)) {
+        fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Put the responses together
+    for (size_t x = 0; x < sizeof(responses) / sizeof(responses[0]); x++) {
+        responses[x].pData = (char *) malloc(CELLULAR_AT_BENCH_RESPONSE_MAX_LENGTH_BYTES);
+        if (responses[x].pData == NULL) {
+            return EXIT_FAILURE;
+        }
+    }
+    responses[0].length = snprintf(responses[0].pData,
+                                   CELLULAR_AT_BENCH_RESPONSE_MAX_LENGTH_BYTES,
+                                   "\r\n+CEREG: 2,5,\"1A2B\",\"01A2B3C4\",7\r\n\r\nOK\r\n");
+    pTmp = responses[1].pData;
+    pTmp += snprintf(pTmp, CELLULAR_AT_BENCH_RESPONSE_MAX_LENGTH_BYTES,
+                     "\r\n+USORD: 0,%d,\"", CELLULAR_AT_BENCH_USORD_DATA_LENGTH_BYTES);
+    for (size_t x = 0; x < CELLULAR_AT_BENCH_USORD_DATA_LENGTH_BYTES; x++) {
+        *pTmp = (char) ('0' + (x % 64));
+        pTmp++;
+    }
+    pTmp += snprintf(pTmp, CELLULAR_AT_BENCH_RESPONSE_MAX_LENGTH_BYTES -
+                     (pTmp - responses[1].pData), "\"\r\n\r\nOK\r\n");
+    responses[1].length = pTmp - responses[1].pData;
+    responses[2].length = snprintf(responses[2].pData,
+                                   CELLULAR_AT_BENCH_RESPONSE_MAX_LENGTH_BYTES,
+                                   "\r\n+UUSORD: 0,512\r\n\r\n+CSQ: 20,99\r\n\r\nOK\r\n");
+    pTmp = responses[3].pData;
+    pTmp += snprintf(pTmp, CELLULAR_AT_BENCH_RESPONSE_MAX_LENGTH_BYTES,
+                     "\r\n+USORD: 0,%d,\"", CELLULAR_AT_BENCH_USORD_DATA_LENGTH_BYTES);
+    for (size_t x = 0; x < CELLULAR_AT_BENCH_USORD_DATA_LENGTH_BYTES; x++) {
+        pTmp += sprintf(pTmp, "%02X", (unsigned int) (x & 0xFF));
+    }
+    pTmp += snprintf(pTmp, CELLULAR_AT_BENCH_RESPONSE_MAX_LENGTH_BYTES -
+                     (pTmp - responses[3].pData), "\"\r\n\r\nOK\r\n");
+    responses[3].length = pTmp - responses[3].pData;
+
+    if ((cellularPortInit() == 0) &&
+        (cellularPortUartInit(CELLULAR_CFG_PIN_TXD,
+                              CELLULAR_CFG_PIN_RXD,
+                              CELLULAR_CFG_PIN_CTS,
+                              CELLULAR_CFG_PIN_RTS,
+                              CELLULAR_CFG_BAUD_RATE,
+                              CELLULAR_CFG_RTS_THRESHOLD,
+                              CELLULAR_CFG_UART,
+                              &queueUart) == 0) &&
+        (cellular_ctrl_at_init(CELLULAR_CFG_UART, queueUart) == 0)) {
+        // Printing would swamp everything else
+        cellular_ctrl_at_print_at_set(false);
+        cellular_ctrl_at_debug_set(false);
+        cellular_ctrl_at_set_urc_handler("+UUSORD:", uusordUrc, NULL);
+        for (size_t x = 0; x < sizeof(responses) / sizeof(responses[0]); x++) {
+            failures += benchmark(&(responses[x]), iterations);
+        }
+        cellular_ctrl_at_deinit();
+    } else {
+        cellularPortLog("CELLULAR_AT_BENCH: unable to start the AT client.\n");
+        failures = 1;
+    }
+    if (queueUart != NULL) {
+        cellularPortUartDeinit(CELLULAR_CFG_UART);
+    }
+    cellularPortDeinit();
+
+    for (size_t x = 0; x < sizeof(responses) / sizeof(responses[0]); x++) {
+        free(responses[x].pData);
+    }
+
+    return failures;
+}
+
+// End of file
@@ -0,0 +1,287 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* A fuzz target for the tokenizer of the AT client: each input
+ * is received, through the memory UART of
+ * cellular_port_uart_memory.h, by one of a set of response
+ * readers chosen by the first byte of the input, which between
+ * them cover cellular_ctrl_at_resp_start(), _resp_next(),
+ * _info_resp(), _info_elem(), _read_string(), _read_hex_string(),
+ * _read_int(), _read_uint64(), _read_bytes(), _read_fields(),
+ * _consume_to_stop_tag() and _wait_char(), plus the URC handling
+ * that the search for a prefix does along the way.
+ *
+ * Built with clang this is a libFuzzer target
+ * (CELLULAR_FUZZ_LIBFUZZER is defined), e.g.:
+ *
+ * cellular_at_fuzz -max_len=4096 port/platform/linux/posix/fuzz/corpus
+ *
+ * Otherwise it has a main() of its own which runs each of the
+ * files given on the command line through the same code once,
+ * which is how a crash found by libFuzzer is reproduced, or the
+ * corpus checked, with any compiler.
+ *
+ * Each input ends with the AT client waiting for more that
+ * never comes, hence the AT time-out is cut to
+ * CELLULAR_AT_FUZZ_AT_TIMEOUT_MS for the duration.
+ */
+
+#ifdef CELLULAR_CFG_OVERRIDE
+# include "cellular_cfg_override.h" // For a customer's configuration override
+#endif
+#include "cellular_cfg_sw.h"
+#include "cellular_cfg_module.h"
+#include "cellular_cfg_hw_platform_specific.h"
+#include "cellular_port_clib.h"
+#include "cellular_port.h"
+#include "cellular_port_debug.h"
+#include "cellular_port_os.h"
+#include "cellular_port_uart.h"
+#include "cellular_port_uart_memory.h"
+#include "cellular_ctrl_at.h"
+
+#include "stdio.h"
+#include "stdlib.h"
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS
+ * -------------------------------------------------------------- */
+
+// The AT time-out while an input is being read: long enough for
+// the AT client to get through any input libFuzzer is likely to
+// generate, short enough not to slow the fuzzing down too much.
+#ifndef CELLULAR_AT_FUZZ_AT_TIMEOUT_MS
+# define CELLULAR_AT_FUZZ_AT_TIMEOUT_MS 2
+#endif
+
+// The size of the buffers that strings are read into: small,
+// so that truncation is exercised.
+#define CELLULAR_AT_FUZZ_STRING_LENGTH_BYTES 16
+
+// The number of response readers.
+#define CELLULAR_AT_FUZZ_NUM_READERS 8
+
+/* ----------------------------------------------------------------
+ * VARIABLES
+ * -------------------------------------------------------------- */
+
+// Set once the AT client is up.
+static bool gInitialised = false;
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// A URC handler, reading what a typical one does.
+static void urcHandler(void *pParam)
+{
+    char buffer[CELLULAR_AT_FUZZ_STRING_LENGTH_BYTES];
+
+    (void) pParam;
+
+    cellular_ctrl_at_read_int();
+    cellular_ctrl_at_read_string(buffer, sizeof(buffer), false);
+    cellular_ctrl_at_read_hex_string(buffer, sizeof(buffer));
+}
+
+// Bring up the porting layer, the memory UART and the AT client.
+static bool init()
+{
+    CellularPortQueueHandle_t queueUart;
+
+    if (!gInitialised &&
+        (cellularPortInit() == 0) &&
+        (cellularPortUartInit(CELLULAR_CFG_PIN_TXD,
+                              CELLULAR_CFG_PIN_RXD,
+                              CELLULAR_CFG_PIN_CTS,
+                              CELLULAR_CFG_PIN_RTS,
+                              CELLULAR_CFG_BAUD_RATE,
+                              CELLULAR_CFG_RTS_THRESHOLD,
+                              CELLULAR_CFG_UART,
+                              &queueUart) == 0) &&
+        (cellular_ctrl_at_init(CELLULAR_CFG_UART, queueUart) == 0)) {
+        // Printing would swamp everything else
+        cellular_ctrl_at_print_at_set(false);
+        cellular_ctrl_at_debug_set(false);
+        cellular_ctrl_at_set_urc_handler("+UUSORD:", urcHandler, NULL);
+        cellular_ctrl_at_set_urc_handler("+CEREG:", urcHandler, NULL);
+        gInitialised = true;
+    }
+
+    return gInitialised;
+}
+
+// Read a response in one of the ways the cellular code does.
+static void readResponse(size_t reader)
+{
+    char buffer[CELLULAR_AT_FUZZ_STRING_LENGTH_BYTES];
+    uint8_t bytes[CELLULAR_AT_FUZZ_STRING_LENGTH_BYTES];
+    uint64_t uint64;
+    int32_t x;
+    int32_t y;
+
+    switch (reader) {
+        case 0:
+            // Unprefixed lines, e.g. AT+CGSN
+            cellular_ctrl_at_resp_start(NULL, false);
+            while (cellular_ctrl_at_info_resp()) {
+                cellular_ctrl_at_read_string(buffer, sizeof(buffer), false);
+                cellular_ctrl_at_read_int();
+            }
+            break;
+        case 1:
+            // A typical multi-field response
+            cellular_ctrl_at_read_fields("+CEREG:", "i,i,s,s,i", &x, &y,
+                                         buffer, sizeof(buffer),
+                                         NULL, (size_t) 0, NULL);
+            break;
+        case 2:
+            // Binary data, as read by the sockets code
+            cellular_ctrl_at_read_fields("+USORD:", "-,i", &x);
+            if (x > (int32_t) sizeof(bytes)) {
+                x = sizeof(bytes);
+            }
+            if (x > 0) {
+                cellular_ctrl_at_set_delimiter(0);
+                cellular_ctrl_at_set_stop_tag(NULL);
+                cellular_ctrl_at_read_bytes(bytes, 1);
+                cellular_ctrl_at_read_bytes(bytes, x);
+            }
+            break;
+        case 3:
+            // Hex data, and skipping
+            cellular_ctrl_at_resp_start("+USORF:", false);
+            cellular_ctrl_at_skip_param(2);
+            cellular_ctrl_at_read_hex_string(buffer, sizeof(buffer));
+            break;
+        case 4:
+            // To a stop tag of our own
+            cellular_ctrl_at_resp_start("+CMGR:", false);
+            cellular_ctrl_at_set_stop_tag("\r\n\r\n");
+            cellular_ctrl_at_consume_to_stop_tag();
+            break;
+        case 5:
+            // A prompt
+            if (cellular_ctrl_at_wait_char('@')) {
+                cellular_ctrl_at_resp_start("+USOWR:", false);
+                cellular_ctrl_at_read_int();
+                cellular_ctrl_at_read_int();
+            }
+            break;
+        case 6:
+            // Elements and big numbers
+            cellular_ctrl_at_resp_start("+UBANDMASK:", false);
+            while (cellular_ctrl_at_info_elem('(')) {
+                cellular_ctrl_at_read_uint64(&uint64);
+            }
+            cellular_ctrl_at_read_uint64(&uint64);
+            break;
+        default:
+            // Several information responses on one line
+            cellular_ctrl_at_resp_next("+CCID:");
+            cellular_ctrl_at_read_string(buffer, sizeof(buffer), false);
+            cellular_ctrl_at_resp_next(NULL);
+            cellular_ctrl_at_read_string(buffer, sizeof(buffer), true);
+            cellular_ctrl_at_resp_next("+CSQ:");
+            cellular_ctrl_at_read_int();
+            break;
+    }
+    cellular_ctrl_at_resp_stop();
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// The fuzz target.
+int LLVMFuzzerTestOneInput(const uint8_t *pData, size_t size)
+{
+    if ((size > 0) && init()) {
+        cellular_ctrl_at_lock();
+        cellular_ctrl_at_set_at_timeout(CELLULAR_AT_FUZZ_AT_TIMEOUT_MS, false);
+        // The data is not copied, so that reading
+        // beyond the end of it is caught
+        cellularPortUartMemorySet((const char *) pData + 1, size - 1);
+        readResponse(*pData % CELLULAR_AT_FUZZ_NUM_READERS);
+        // Throw away whatever is left so that the
+        // URC task has nothing to pick up
+        cellularPortUartMemorySet(NULL, 0);
+        cellular_ctrl_at_flush();
+        cellular_ctrl_at_set_default_delimiter();
+        cellular_ctrl_at_restore_at_timeout();
+        cellular_ctrl_at_unlock();
+    }
+
+    return 0;
+}
+
+#ifndef CELLULAR_FUZZ_LIBFUZZER
+
+// Entry point when not built with libFuzzer: run each of the
+// files given on the command line through the fuzz target.
+int main(int argc, char *argv[])
+{
+    FILE *pFile;
+    uint8_t *pData;
+    long size;
+    int failures = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s file [file...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    for (int x = 1; x < argc; x++) {
+        pData = NULL;
+        size = -1;
+        pFile = fopen(argv[x], "rb");
+        if ((pFile != NULL) && (fseek(pFile, 0, SEEK_END) == 0)) {
+            size = ftell(pFile);
+            rewind(pFile);
+        }
+        if (size >= 0) {
+            // Exactly the size of the file, as libFuzzer would
+            pData = (uint8_t *) malloc(size > 0 ? size : 1);
+            if ((pData != NULL) &&
+                (fread(pData, 1, size, pFile) == (size_t) size)) {
+                LLVMFuzzerTestOneInput(pData, size);
+                printf("CELLULAR_AT_FUZZ: %s, %d byte(s).\n", argv[x], (int) size);
+            } else {
+                size = -1;
+            }
+            free(pData);
+        }
+        if (size < 0) {
+            fprintf(stderr, "CELLULAR_AT_FUZZ: unable to read %s.\n", argv[x]);
+            failures++;
+        }
+        if (pFile != NULL) {
+            fclose(pFile);
+        }
+    }
+
+    if (gInitialised) {
+        cellular_ctrl_at_deinit();
+        cellularPortUartDeinit(CELLULAR_CFG_UART);
+        cellularPortDeinit();
+    }
+
+    return failures;
+}
+
+#endif // CELLULAR_FUZZ_LIBFUZZER
+
+// End of file
@@ -0,0 +1,349 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* An implementation of cellular_port_uart.h that receives from a
+ * block of memory, see cellular_port_uart_memory.h.  There is only
+ * ever one UART; reads are served straight from the memory, with
+ * no ring in between, so that a tool such as AddressSanitizer
+ * sees any read by the AT client beyond what it was given.
+ */
+
+#ifdef CELLULAR_CFG_OVERRIDE
+# include "cellular_cfg_override.h" // For a customer's configuration override
+#endif
+#include "cellular_cfg_hw_platform_specific.h"
+#include "cellular_port_clib.h"
+#include "cellular_port.h"
+#include "cellular_port_os.h"
+#include "cellular_port_uart.h"
+#include "cellular_port_uart_memory.h"
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS
+ * -------------------------------------------------------------- */
+
+/* ----------------------------------------------------------------
+ * TYPES
+ * -------------------------------------------------------------- */
+
+/** A UART event: as for the real UART, just the size or error.
+ */
+typedef int32_t CellularPortUartEventData_t;
+
+/* ----------------------------------------------------------------
+ * VARIABLES
+ * -------------------------------------------------------------- */
+
+// The number of the UART, -1 if it is not initialised.
+static int32_t gUart = -1;
+
+// The event queue of the UART.
+static CellularPortQueueHandle_t gQueue = NULL;
+
+// The data to be received.
+static const char *gpData = NULL;
+
+// The number of bytes at gpData.
+static size_t gSizeBytes = 0;
+
+// How far through gpData reading has got.
+static size_t gReadBytes = 0;
+
+// The number of bytes written.
+static size_t gWrittenBytes = 0;
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS: SPECIFIC TO THIS UART
+ * -------------------------------------------------------------- */
+
+// Set the data to be received.
+void cellularPortUartMemorySet(const char *pData, size_t sizeBytes)
+{
+    gpData = pData;
+    gSizeBytes = sizeBytes;
+    gReadBytes = 0;
+    gWrittenBytes = 0;
+}
+
+// Get the number of bytes written.
+size_t cellularPortUartMemoryGetWritten()
+{
+    return gWrittenBytes;
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// Initialise the UART.
+int32_t cellularPortUartInit(int32_t pinTx, int32_t pinRx,
+                             int32_t pinCts, int32_t pinRts,
+                             int32_t baudRate,
+                             size_t rtsThreshold,
+                             int32_t uart,
+                             CellularPortQueueHandle_t *pUartQueue)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+
+    (void) pinTx;
+    (void) pinRx;
+    (void) pinCts;
+    (void) pinRts;
+    (void) rtsThreshold;
+
+    if ((pUartQueue != NULL) && (uart >= 0) && (baudRate > 0) &&
+        ((gUart < 0) || (gUart == uart))) {
+        errorCode = CELLULAR_PORT_SUCCESS;
+        if (gUart < 0) {
+            errorCode = cellularPortQueueCreate(CELLULAR_PORT_UART_EVENT_QUEUE_SIZE,
+                                                sizeof(CellularPortUartEventData_t),
+                                                &gQueue);
+            if (errorCode == 0) {
+                gUart = uart;
+                cellularPortUartMemorySet(NULL, 0);
+            }
+        }
+        if (errorCode == 0) {
+            *pUartQueue = gQueue;
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Shutdown the UART.
+int32_t cellularPortUartDeinit(int32_t uart)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+
+    if (uart >= 0) {
+        errorCode = CELLULAR_PORT_SUCCESS;
+        if (uart == gUart) {
+            cellularPortQueueDelete(gQueue);
+            gQueue = NULL;
+            gUart = -1;
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Push a UART event onto the UART event queue.
+int32_t cellularPortUartEventSend(const CellularPortQueueHandle_t queueHandle,
+                                  int32_t sizeBytesOrError)
+{
+    int32_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortUartEventData_t uartSizeOrError;
+
+    if (queueHandle != NULL) {
+        uartSizeOrError = sizeBytesOrError;
+        errorCode = cellularPortQueueSend(queueHandle, (void *) &uartSizeOrError);
+    }
+
+    return errorCode;
+}
+
+// Receive a UART event, blocking until one turns up.
+int32_t cellularPortUartEventReceive(const CellularPortQueueHandle_t queueHandle)
+{
+    int32_t sizeOrErrorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortUartEventData_t uartSizeOrError;
+
+    if (queueHandle != NULL) {
+        sizeOrErrorCode = CELLULAR_PORT_PLATFORM_ERROR;
+        if (cellularPortQueueReceive(queueHandle, &uartSizeOrError) == 0) {
+            sizeOrErrorCode = uartSizeOrError;
+        }
+    }
+
+    return sizeOrErrorCode;
+}
+
+// Receive a UART event with a timeout.
+int32_t cellularPortUartEventTryReceive(const CellularPortQueueHandle_t queueHandle,
+                                        int32_t waitMs)
+{
+    int32_t sizeOrErrorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortUartEventData_t uartSizeOrError;
+
+    if (queueHandle != NULL) {
+        sizeOrErrorCode = CELLULAR_PORT_TIMEOUT;
+        if (cellularPortQueueTryReceive(queueHandle, waitMs, &uartSizeOrError) == 0) {
+            sizeOrErrorCode = uartSizeOrError;
+        }
+    }
+
+    return sizeOrErrorCode;
+}
+
+// Get the number of bytes waiting to be read.
+int32_t cellularPortUartGetReceiveSize(int32_t uart)
+{
+    CellularPortErrorCode_t sizeOrErrorCode = CELLULAR_PORT_INVALID_PARAMETER;
+
+    if ((uart >= 0) && (uart == gUart)) {
+        sizeOrErrorCode = gSizeBytes - gReadBytes;
+    }
+
+    return (int32_t) sizeOrErrorCode;
+}
+
+// Read from the UART.
+int32_t cellularPortUartRead(int32_t uart, char *pBuffer,
+                             size_t sizeBytes)
+{
+    CellularPortErrorCode_t sizeOrErrorCode = CELLULAR_PORT_INVALID_PARAMETER;
+
+    if ((uart >= 0) && (uart == gUart) && (pBuffer != NULL)) {
+        if (sizeBytes > gSizeBytes - gReadBytes) {
+            sizeBytes = gSizeBytes - gReadBytes;
+        }
+        if (sizeBytes > 0) {
+            pCellularPort_memcpy(pBuffer, gpData + gReadBytes, sizeBytes);
+            gReadBytes += sizeBytes;
+        }
+        sizeOrErrorCode = sizeBytes;
+    }
+
+    return (int32_t) sizeOrErrorCode;
+}
+
+// Get a pointer to the data waiting to be read.
+int32_t cellularPortUartReadSpan(int32_t uart, const char **ppData)
+{
+    CellularPortErrorCode_t sizeOrErrorCode = CELLULAR_PORT_INVALID_PARAMETER;
+
+    if ((uart >= 0) && (uart == gUart) && (ppData != NULL)) {
+        sizeOrErrorCode = gSizeBytes - gReadBytes;
+        *ppData = gpData + gReadBytes;
+    }
+
+    return (int32_t) sizeOrErrorCode;
+}
+
+// Mark data obtained through cellularPortUartReadSpan() as read.
+int32_t cellularPortUartReadCommit(int32_t uart, size_t sizeBytes)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+
+    if ((uart >= 0) && (uart == gUart) &&
+        (sizeBytes <= gSizeBytes - gReadBytes)) {
+        gReadBytes += sizeBytes;
+        errorCode = CELLULAR_PORT_SUCCESS;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Write to the UART: the data is counted and thrown away.
+int32_t cellularPortUartWrite(int32_t uart,
+                              const char *pBuffer,
+                              size_t sizeBytes)
+{
+    CellularPortErrorCode_t sizeOrErrorCode = CELLULAR_PORT_INVALID_PARAMETER;
+
+    if ((uart >= 0) && (uart == gUart) && (pBuffer != NULL)) {
+        gWrittenBytes += sizeBytes;
+        sizeOrErrorCode = sizeBytes;
+    }
+
+    return (int32_t) sizeOrErrorCode;
+}
+
+// Change the baud rate of the UART: there is nothing to change.
+int32_t cellularPortUartSetBaudRate(int32_t uart,
+                                    int32_t baudRate)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+
+    if ((uart >= 0) && (uart == gUart) && (baudRate > 0)) {
+        errorCode = CELLULAR_PORT_SUCCESS;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Determine if RTS flow control is enabled.
+bool cellularPortIsRtsFlowControlEnabled(int32_t uart)
+{
+    (void) uart;
+
+    return false;
+}
+
+// Determine if CTS flow control is enabled.
+bool cellularPortIsCtsFlowControlEnabled(int32_t uart)
+{
+    (void) uart;
+
+    return false;
+}
+
+// Set the receive buffer size: there is no buffer.
+int32_t cellularPortUartSetRxBufferSize(int32_t uart,
+                                        size_t sizeBytes)
+{
+    (void) uart;
+    (void) sizeBytes;
+
+    return (int32_t) CELLULAR_PORT_SUCCESS;
+}
+
+// Get the receive statistics of the UART.
+int32_t cellularPortUartGetStats(int32_t uart,
+                                 CellularPortUartStats_t *pStats)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+
+    if ((uart >= 0) && (uart == gUart) && (pStats != NULL)) {
+        pCellularPort_memset(pStats, 0, sizeof(*pStats));
+        pStats->rxBufferSizeBytes = gSizeBytes;
+        pStats->rxHighWaterMarkBytes = gSizeBytes;
+        errorCode = CELLULAR_PORT_SUCCESS;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Reset the receive statistics of the UART.
+int32_t cellularPortUartResetStats(int32_t uart)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+
+    if ((uart >= 0) && (uart == gUart)) {
+        errorCode = CELLULAR_PORT_SUCCESS;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Suspend the UART: not supported.
+int32_t cellularPortUartSuspend(int32_t uart)
+{
+    (void) uart;
+
+    return (int32_t) CELLULAR_PORT_NOT_IMPLEMENTED;
+}
+
+// Resume the UART: not supported.
+int32_t cellularPortUartResume(int32_t uart)
+{
+    (void) uart;
+
+    return (int32_t) CELLULAR_PORT_NOT_IMPLEMENTED;
+}
+
+// End of file
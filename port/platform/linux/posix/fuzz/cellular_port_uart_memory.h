@@ -0,0 +1,60 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _CELLULAR_PORT_UART_MEMORY_H_
+#define _CELLULAR_PORT_UART_MEMORY_H_
+
+/* No #includes allowed here */
+
+/** A UART that receives from a block of memory, used in place
+ * of cellular_port_uart.c by the AT tokenizer fuzzer and
+ * micro-benchmark so that the AT client can be fed at memory
+ * speed, without a device, a receive thread or any timing in
+ * the way.  Everything written is thrown away and no receive
+ * events are ever sent.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ----------------------------------------------------------------
+ * FUNCTIONS
+ * -------------------------------------------------------------- */
+
+/** Set the data that the UART is to receive, replacing anything
+ * not yet read.  The data is not copied: it must remain valid
+ * until it has all been read or this is called again.
+ *
+ * @param pData     the data, may be NULL if sizeBytes is zero.
+ * @param sizeBytes the number of bytes at pData.
+ */
+void cellularPortUartMemorySet(const char *pData, size_t sizeBytes);
+
+/** Get the number of bytes written to the UART since
+ * cellularPortUartMemorySet() was last called.
+ *
+ * @return the number of bytes written.
+ */
+size_t cellularPortUartMemoryGetWritten();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _CELLULAR_PORT_UART_MEMORY_H_
+
+// End of file
@@ -0,0 +1,199 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Reading of an AT capture for the host programs; like them it
+ * uses the C library of the host directly.  The format of a
+ * line is described with cellular_ctrl_at_capture_set().
+ */
+
+#include "stdbool.h"
+#include "stdint.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "cellular_capture.h"
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS
+ * -------------------------------------------------------------- */
+
+// The longest line that is expected in a capture; a line of
+// capture is much shorter than this but it may be in a log
+// alongside longer ones.
+#define CELLULAR_CAPTURE_LINE_MAX_LENGTH_BYTES 4096
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// Convert a hex digit to its value, -1 if it is not one.
+static int hexValue(char c)
+{
+    int value = -1;
+
+    if ((c >= '0') && (c <= '9')) {
+        value = c - '0';
+    } else if ((c >= 'a') && (c <= 'f')) {
+        value = c - 'a' + 10;
+    } else if ((c >= 'A') && (c <= 'F')) {
+        value = c - 'A' + 10;
+    }
+
+    return value;
+}
+
+// Decode a hex string into the data of a chunk at the given
+// offset, returning false if it doesn't fit or isn't hex.
+static bool hexDecode(const char *pHex, CellularCaptureChunk_t *pChunk,
+                      size_t offset)
+{
+    bool success = true;
+    int high;
+    int low;
+
+    while (success && (*pHex != 0) && (*pHex != '\n') && (*pHex != '\r')) {
+        high = hexValue(*pHex);
+        low = hexValue(*(pHex + 1));
+        if ((high >= 0) && (low >= 0) && (offset < pChunk->length)) {
+            pChunk->pData[offset] = (char) ((high << 4) | low);
+            offset++;
+            pHex += 2;
+        } else {
+            success = false;
+        }
+    }
+
+    return success;
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// Read an AT capture from a file.
+bool cellularCaptureRead(const char *pPath,
+                         CellularCaptureChunk_t **ppChunks,
+                         size_t *pNumChunks)
+{
+    char *pLine;
+    const char *pTag;
+    FILE *pFile;
+    CellularCaptureChunk_t *pChunks = NULL;
+    CellularCaptureChunk_t *pTmp;
+    size_t numChunks = 0;
+    size_t lineNumber = 0;
+    long long timeMs;
+    int uart;
+    int firstUart = -1;
+    char direction[3];
+    int length;
+    int offset;
+    int hexStart;
+    bool success = true;
+
+    *ppChunks = NULL;
+    *pNumChunks = 0;
+    pFile = fopen(pPath, "r");
+    if (pFile == NULL) {
+        fprintf(stderr, "cellular_capture: unable to open %s.\n", pPath);
+        return false;
+    }
+    pLine = (char *) malloc(CELLULAR_CAPTURE_LINE_MAX_LENGTH_BYTES);
+    if (pLine == NULL) {
+        fclose(pFile);
+        return false;
+    }
+
+    while (success &&
+           (fgets(pLine, CELLULAR_CAPTURE_LINE_MAX_LENGTH_BYTES, pFile) != NULL)) {
+        lineNumber++;
+        pTag = strstr(pLine, CELLULAR_CAPTURE_TAG);
+        if (pTag == NULL) {
+            continue;
+        }
+        pTag += strlen(CELLULAR_CAPTURE_TAG);
+        if ((sscanf(pTag, " %lld %d %2s %d %d %n", &timeMs, &uart,
+                    direction, &length, &offset, &hexStart) != 5) ||
+            (length <= 0) || (offset < 0) || (offset >= length) ||
+            ((strcmp(direction, "TX") != 0) && (strcmp(direction, "RX") != 0))) {
+            fprintf(stderr, "cellular_capture: line %d of %s is not understood.\n",
+                    (int) lineNumber, pPath);
+            success = false;
+        } else {
+            if (firstUart < 0) {
+                firstUart = uart;
+            }
+            if (uart == firstUart) {
+                if (offset == 0) {
+                    // A new chunk
+                    pTmp = (CellularCaptureChunk_t *) realloc(pChunks,
+                                                              (numChunks + 1) * sizeof(*pChunks));
+                    if (pTmp != NULL) {
+                        pChunks = pTmp;
+                        pChunks[numChunks].timeMs = timeMs;
+                        pChunks[numChunks].tx = (direction[0] == 'T');
+                        pChunks[numChunks].length = length;
+                        pChunks[numChunks].pData = (char *) malloc(length);
+                        if (pChunks[numChunks].pData != NULL) {
+                            numChunks++;
+                        } else {
+                            success = false;
+                        }
+                    } else {
+                        success = false;
+                    }
+                } else if ((numChunks == 0) ||
+                           (pChunks[numChunks - 1].length != (size_t) length)) {
+                    // The continuation of a chunk whose start is missing
+                    fprintf(stderr, "cellular_capture: line %d of %s continues"
+                            " a chunk that isn't there.\n",
+                            (int) lineNumber, pPath);
+                    success = false;
+                }
+                if (success &&
+                    !hexDecode(pTag + hexStart, &(pChunks[numChunks - 1]), offset)) {
+                    fprintf(stderr, "cellular_capture: bad data on line %d of %s.\n",
+                            (int) lineNumber, pPath);
+                    success = false;
+                }
+            }
+        }
+    }
+
+    free(pLine);
+    fclose(pFile);
+
+    if (success) {
+        *ppChunks = pChunks;
+        *pNumChunks = numChunks;
+    } else {
+        cellularCaptureFree(pChunks, numChunks);
+    }
+
+    return success;
+}
+
+// Free an AT capture.
+void cellularCaptureFree(CellularCaptureChunk_t *pChunks,
+                         size_t numChunks)
+{
+    for (size_t x = 0; x < numChunks; x++) {
+        free(pChunks[x].pData);
+    }
+    free(pChunks);
+}
+
+// End of file
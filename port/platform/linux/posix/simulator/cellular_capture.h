@@ -0,0 +1,87 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _CELLULAR_CAPTURE_H_
+#define _CELLULAR_CAPTURE_H_
+
+/* No #includes allowed here */
+
+/** Reading of an AT capture, as logged by the AT client when
+ * cellular_ctrl_at_capture_set() is on, for the host programs
+ * cellular_sim and cellular_replay.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS
+ * -------------------------------------------------------------- */
+
+/** The tag at the start of each line of an AT capture: must be
+ * the same as CELLULAR_CTRL_AT_CAPTURE_TAG.
+ */
+#define CELLULAR_CAPTURE_TAG "CELLULAR_AT_CAPTURE:"
+
+/* ----------------------------------------------------------------
+ * TYPES
+ * -------------------------------------------------------------- */
+
+/** A chunk of an AT capture: the data of one write to, or one
+ * read from, the UART.
+ */
+typedef struct {
+    int64_t timeMs;  //!< when the chunk was written or read.
+    bool tx;         //!< true if written by the AT client.
+    size_t length;   //!< the number of bytes in pData.
+    char *pData;     //!< the data.
+} CellularCaptureChunk_t;
+
+/* ----------------------------------------------------------------
+ * FUNCTIONS
+ * -------------------------------------------------------------- */
+
+/** Read an AT capture from a file; lines without the capture
+ * tag on them are ignored, as are lines for any UART other
+ * than the first one that appears.
+ *
+ * @param pPath       the file to read.
+ * @param ppChunks    a place to put the array of chunks, which
+ *                    must be freed with cellularCaptureFree().
+ * @param pNumChunks  a place to put the number of chunks.
+ * @return            true on success, else false, in which case
+ *                    a reason will have been printed.
+ */
+bool cellularCaptureRead(const char *pPath,
+                         CellularCaptureChunk_t **ppChunks,
+                         size_t *pNumChunks);
+
+/** Free an AT capture read by cellularCaptureRead().
+ *
+ * @param pChunks    the chunks.
+ * @param numChunks  the number of chunks.
+ */
+void cellularCaptureFree(CellularCaptureChunk_t *pChunks,
+                         size_t numChunks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _CELLULAR_CAPTURE_H_
+
+// End of file
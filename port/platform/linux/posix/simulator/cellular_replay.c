@@ -0,0 +1,337 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Plays back the AT client side of an AT capture (see
+ * cellular_ctrl_at_capture_set()) through the AT client, against
+ * "cellular_sim -r" playing back the module side of the same
+ * capture, and reports the CPU time that the AT client took over
+ * it.  Since the module side arrives with its original timing and
+ * chunking, the AT client sees the bytes it saw when the capture
+ * was made; the figures are a regression benchmark for the AT
+ * parser built from real traffic.
+ *
+ * Usage: cellular_replay capture
+ *
+ * Each command in the capture is sent with
+ * cellular_ctrl_at_cmd_start()/cellular_ctrl_at_cmd_stop() and
+ * anything else, e.g. the data following an AT+USOWR prompt,
+ * with cellular_ctrl_at_write_bytes().  What the module sent
+ * back in the capture decides how the response is read: to "OK"
+ * or "ERROR" with cellular_ctrl_at_resp_start()/
+ * cellular_ctrl_at_resp_stop(), to a prompt with
+ * cellular_ctrl_at_wait_char() or not at all, leaving whatever
+ * it is to the URC task; the gap to the next command in the
+ * capture is kept so that URCs interleave as they did.
+ *
+ * This is a host program, linked with the cellular library,
+ * and uses the C library of the host for the CPU time.
+ */
+
+#ifdef CELLULAR_CFG_OVERRIDE
+# include "cellular_cfg_override.h" // For a customer's configuration override
+#endif
+#include "cellular_cfg_sw.h"
+#include "cellular_cfg_module.h"
+#include "cellular_cfg_hw_platform_specific.h"
+#include "cellular_cfg_os_platform_specific.h"
+#include "cellular_port_clib.h"
+#include "cellular_port.h"
+#include "cellular_port_debug.h"
+#include "cellular_port_os.h"
+#include "cellular_port_uart.h"
+#include "cellular_ctrl_at.h"
+#include "cellular_capture.h"
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "time.h"
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS
+ * -------------------------------------------------------------- */
+
+// The stack size of the task that does the playback.
+#define CELLULAR_REPLAY_TASK_STACK_SIZE_BYTES (1024 * 8)
+
+// The priority of the task that does the playback.
+#define CELLULAR_REPLAY_TASK_PRIORITY (CELLULAR_PORT_OS_PRIORITY_MIN + 1)
+
+// The longest command that will be played back; the
+// AT client's own limit is rather less.
+#define CELLULAR_REPLAY_COMMAND_MAX_LENGTH_BYTES 1024
+
+/* ----------------------------------------------------------------
+ * TYPES
+ * -------------------------------------------------------------- */
+
+/** How the response to a transaction is read.
+ */
+typedef enum {
+    CELLULAR_REPLAY_RESPONSE_NONE,    //!< not at all.
+    CELLULAR_REPLAY_RESPONSE_FINAL,   //!< to "OK" or "ERROR".
+    CELLULAR_REPLAY_RESPONSE_PROMPT   //!< to a prompt.
+} CellularReplayResponse_t;
+
+/* ----------------------------------------------------------------
+ * VARIABLES
+ * -------------------------------------------------------------- */
+
+// The capture file.
+static const char *gpCapturePath = NULL;
+
+// The number of transactions whose outcome was not as it was
+// in the capture, returned as the exit code.
+static int gFailures = 0;
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// Get the CPU time of this process in microseconds.
+static int64_t cpuTimeUs()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+
+    return ((int64_t) now.tv_sec * 1000000) + (now.tv_nsec / 1000);
+}
+
+// Return true if a chunk contains the given string.
+static bool contains(const CellularCaptureChunk_t *pChunk, const char *pStr)
+{
+    size_t length = cellularPort_strlen(pStr);
+    bool found = false;
+
+    for (size_t x = 0; !found && (x + length <= pChunk->length); x++) {
+        found = (cellularPort_memcmp(pChunk->pData + x, pStr, length) == 0);
+    }
+
+    return found;
+}
+
+// Work out how to read the response to the transaction that
+// ends at chunk index from what the module sent before the
+// next transaction, returning the prompt character if there
+// is one in *pPrompt and whether the response was an error
+// in *pError.
+static CellularReplayResponse_t responseType(const CellularCaptureChunk_t *pChunks,
+                                             size_t numChunks, size_t index,
+                                             char *pPrompt, bool *pError)
+{
+    CellularReplayResponse_t response = CELLULAR_REPLAY_RESPONSE_NONE;
+    const CellularCaptureChunk_t *pChunk;
+    char last = 0;
+
+    for (size_t x = index + 1; (x < numChunks) && !pChunks[x].tx &&
+                               (response != CELLULAR_REPLAY_RESPONSE_FINAL); x++) {
+        pChunk = &(pChunks[x]);
+        if (contains(pChunk, "ERROR")) {
+            response = CELLULAR_REPLAY_RESPONSE_FINAL;
+            *pError = true;
+        } else if (contains(pChunk, "OK\r\n")) {
+            response = CELLULAR_REPLAY_RESPONSE_FINAL;
+        }
+        for (size_t y = 0; y < pChunk->length; y++) {
+            if ((pChunk->pData[y] != '\r') && (pChunk->pData[y] != '\n') &&
+                (pChunk->pData[y] != ' ')) {
+                last = pChunk->pData[y];
+            }
+        }
+    }
+    if ((response == CELLULAR_REPLAY_RESPONSE_NONE) &&
+        ((last == '@') || (last == '>'))) {
+        response = CELLULAR_REPLAY_RESPONSE_PROMPT;
+        *pPrompt = last;
+    }
+
+    return response;
+}
+
+// Play back one transaction, the chunks sent by the AT client
+// from index up to but not including end, returning true if
+// the outcome was as it was in the capture.
+static bool transaction(const CellularCaptureChunk_t *pChunks,
+                        size_t numChunks, size_t index, size_t end)
+{
+    char command[CELLULAR_REPLAY_COMMAND_MAX_LENGTH_BYTES];
+    CellularReplayResponse_t response;
+    size_t length = 0;
+    char prompt = 0;
+    bool isCommand;
+    bool error = false;
+    bool success;
+
+    // A command goes out as a whole, anything else chunk
+    // by chunk, as it was written
+    for (size_t x = index; x < end; x++) {
+        length += pChunks[x].length;
+    }
+    isCommand = (length > 2) && (length < sizeof(command)) &&
+                ((pChunks[index].pData[0] == 'A') || (pChunks[index].pData[0] == 'a')) &&
+                ((pChunks[index].pData[1] == 'T') || (pChunks[index].pData[1] == 't')) &&
+                (pChunks[end - 1].pData[pChunks[end - 1].length - 1] == '\r');
+    response = responseType(pChunks, numChunks, end - 1, &prompt, &error);
+
+    cellular_ctrl_at_lock();
+    if (isCommand) {
+        length = 0;
+        for (size_t x = index; x < end; x++) {
+            pCellularPort_memcpy(command + length, pChunks[x].pData,
+                                 pChunks[x].length);
+            length += pChunks[x].length;
+        }
+        command[length - 1] = 0;
+        cellular_ctrl_at_cmd_start(command);
+        cellular_ctrl_at_cmd_stop();
+    } else {
+        for (size_t x = index; x < end; x++) {
+            cellular_ctrl_at_write_bytes((const uint8_t *) pChunks[x].pData,
+                                         pChunks[x].length);
+        }
+    }
+    switch (response) {
+        case CELLULAR_REPLAY_RESPONSE_FINAL:
+            cellular_ctrl_at_resp_start(NULL, false);
+            cellular_ctrl_at_resp_stop();
+            break;
+        case CELLULAR_REPLAY_RESPONSE_PROMPT:
+            cellular_ctrl_at_wait_char(prompt);
+            break;
+        default:
+            break;
+    }
+    success = ((cellular_ctrl_at_unlock_return_error() != 0) == error);
+
+    return success;
+}
+
+// The task that does the playback.
+static void replayTask(void *pParam)
+{
+    CellularCaptureChunk_t *pChunks = NULL;
+    CellularPortQueueHandle_t queueUart = NULL;
+    size_t numChunks = 0;
+    size_t numTransactions = 0;
+    size_t rxBytes = 0;
+    size_t txBytes = 0;
+    size_t end;
+    int64_t startMs;
+    int64_t startCpuUs;
+    int64_t thisMs;
+    int64_t durationMs;
+    int64_t cpuUs;
+
+    (void) pParam;
+
+    cellularPortInit();
+    if (!cellularCaptureRead(gpCapturePath, &pChunks, &numChunks) ||
+        (numChunks == 0)) {
+        cellularPortLog("CELLULAR_REPLAY: nothing to play back in %s.\n",
+                        gpCapturePath);
+        gFailures = 1;
+    } else if ((cellularPortUartInit(CELLULAR_CFG_PIN_TXD,
+                                     CELLULAR_CFG_PIN_RXD,
+                                     CELLULAR_CFG_PIN_CTS,
+                                     CELLULAR_CFG_PIN_RTS,
+                                     CELLULAR_CFG_BAUD_RATE,
+                                     CELLULAR_CFG_RTS_THRESHOLD,
+                                     CELLULAR_CFG_UART,
+                                     &queueUart) != 0) ||
+               (cellular_ctrl_at_init(CELLULAR_CFG_UART, queueUart) != 0)) {
+        cellularPortLog("CELLULAR_REPLAY: unable to start the AT client on"
+                        " UART %d.\n", CELLULAR_CFG_UART);
+        gFailures = 1;
+    } else {
+        cellularPortLog("CELLULAR_REPLAY: playing back %d chunk(s) from %s.\n",
+                        (int32_t) numChunks, gpCapturePath);
+        startMs = cellularPortGetTickTimeMs();
+        startCpuUs = cpuTimeUs();
+        for (size_t x = 0; x < numChunks; x = end) {
+            end = x + 1;
+            if (pChunks[x].tx) {
+                // A transaction is everything the AT client
+                // sent before anything came back
+                while ((end < numChunks) && pChunks[end].tx) {
+                    end++;
+                }
+                thisMs = cellularPortGetTickTimeMs();
+                for (size_t y = x; y < end; y++) {
+                    txBytes += pChunks[y].length;
+                }
+                if (!transaction(pChunks, numChunks, x, end)) {
+                    gFailures++;
+                }
+                numTransactions++;
+                // Keep the gap to the next transaction
+                for (size_t y = end; y < numChunks; y++) {
+                    if (pChunks[y].tx) {
+                        durationMs = (pChunks[y].timeMs - pChunks[x].timeMs) -
+                                     (cellularPortGetTickTimeMs() - thisMs);
+                        if (durationMs > 0) {
+                            cellularPortTaskBlock(durationMs);
+                        }
+                        break;
+                    }
+                }
+            } else {
+                rxBytes += pChunks[x].length;
+            }
+        }
+        cpuUs = cpuTimeUs() - startCpuUs;
+        durationMs = cellularPortGetTickTimeMs() - startMs;
+
+        cellularPortLog("CELLULAR_REPLAY: %d transaction(s) (%d not as captured), %d"
+                        " byte(s) received, %d byte(s) sent, in %d ms.\n",
+                        (int32_t) numTransactions, gFailures,
+                        (int32_t) rxBytes, (int32_t) txBytes,
+                        (int32_t) durationMs);
+        cellularPortLog("CELLULAR_REPLAY: CPU %d us, %d ns per byte received,"
+                        " %d us per transaction.\n", (int32_t) cpuUs,
+                        (rxBytes > 0) ? (int32_t) ((cpuUs * 1000) / rxBytes) : 0,
+                        (int32_t) (cpuUs / numTransactions));
+        cellular_ctrl_at_deinit();
+    }
+    if (queueUart != NULL) {
+        cellularPortUartDeinit(CELLULAR_CFG_UART);
+    }
+    cellularCaptureFree(pChunks, numChunks);
+    cellularPortDeinit();
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// Entry point.
+int main(int argc, char *argv[])
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s capture\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    gpCapturePath = argv[1];
+
+    if (cellularPortPlatformStart(replayTask, NULL,
+                                  CELLULAR_REPLAY_TASK_STACK_SIZE_BYTES,
+                                  CELLULAR_REPLAY_TASK_PRIORITY) != 0) {
+        gFailures = 1;
+    }
+
+    return gFailures;
+}
+
+// End of file
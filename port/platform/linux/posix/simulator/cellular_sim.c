@@ -0,0 +1,1985 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// For posix_openpt(), ptsname() and cfmakeraw(), must come
+// before any system header
+#define _GNU_SOURCE
+
+/* A scriptable simulator of the AT interface of a SARA-R4/R5
+ * module, presented on a pseudo-terminal so that the POSIX
+ * porting layer can talk to it as if it were a UART.  It is a
+ * host program in its own right, not part of the porting layer,
+ * and so uses the C library of the host directly.
+ *
+ * Usage: cellular_sim [-v] [-l link] [-r capture | script]
+ *
+ * -v prints each command as it arrives; link defaults to
+ * /tmp/cellular_uart0, where the POSIX porting layer looks for
+ * UART 0.  With -r the simulator plays back the module side of
+ * an AT capture (see cellular_ctrl_at_capture_set()): the chunks
+ * received in the capture are sent, with their original chunking
+ * and timing, once the chunk sent ahead of them in the capture
+ * has arrived, so that URCs interleave with responses exactly
+ * as they did; use cellular_replay to send the AT client side.
+ * Otherwise the script, see sara_r5.sim for an
+ * example, contains lines of the form:
+ *
+ * # comment
+ * latency <ms>                  delay every response by this
+ *                               much.
+ * fragment <bytes> <gap ms>     send everything in pieces of
+ *                               at most this many bytes with
+ *                               this gap between them.
+ * urc <period ms> <text>        send a URC every period.
+ * cmd <prefix>                  start a rule for commands that
+ *                               begin with prefix; rules are
+ *                               tried in the order given, before
+ *                               the built-in commands.
+ *   rsp <text>                  send "\r\n<text>\r\n".
+ *   raw <text>                  send text exactly as given.
+ *   wait <ms>                   pause before sending the next
+ *                               line of the rule.
+ *
+ * In text, \r, \n, \\ and \xHH are understood.  Commands that
+ * match no rule are handled by the built-ins: ATE0/ATE1 (also at
+ * the start of a compound command), radio and registration
+ * state (AT+CFUN=, AT+CFUN?, AT+COPS=, AT+CEREG?, AT+CGATT?,
+ * where AT+CFUN=0 or 4 or AT+COPS=2 deregister and the reset
+ * of AT+CFUN=15 or 16 closes all sockets), PDP contexts
+ * (AT+CGDCONT=, AT+CGACT=, AT+CGACT? and AT+CGPADDR=, the first
+ * context being brought up by registration and all of them down
+ * by deregistration), settings that need only be remembered
+ * (AT+UBANDMASK, AT+UMNOPROF, AT+CPSMS and AT+CEDRXS, set and
+ * read) and a loop-back socket implementation (AT+USOCR, AT+USOCO,
+ * AT+USOWR and AT+USOST in binary mode, AT+USORD, AT+USORF,
+ * AT+USOCL, the asynchronous forms of AT+USOCO and AT+USOCL
+ * being answered with +UUSOCO and +UUSOCL straight after the
+ * "OK", AT+USOSO storing an integer socket option that AT+USOGO
+ * then returns, zero if it has not been set, and AT+USODL
+ * entering direct-link mode, left with "+++" and a second of
+ * silence either side), where whatever is written to a TCP
+ * socket comes back with a +UUSORD URC, or straight away in
+ * direct-link mode, and each datagram sent on a UDP socket
+ * comes back with a +UUSORF URC, from the address it was sent
+ * to, so that sock throughput can be measured, and a small RAM file
+ * system (AT+UDWNFILE, which appends to an existing file,
+ * AT+URDBLOCK, AT+ULSTFILE=2 and AT+UDELFILE) with an HTTP
+ * client on top (AT+UHTTPC HEAD, GET and POST-from-file, the
+ * response being written to the file system and +UUHTTPCR sent
+ * straight after the "OK": "/bytes/<n>" gets a body of n bytes,
+ * a POST has the request echoed back as the body and anything
+ * else gets a 404) and a loop-back MQTT-SN gateway (AT+UMQTTSNC
+ * connect, disconnect/sleep, register, ping, publish in hex
+ * mode, subscribe, unsubscribe and read, each outcome being sent
+ * as +UUMQTTSNC straight after the "OK", where a message published
+ * to a topic that has been subscribed to comes back as an unread
+ * message, held while asleep); anything else gets "OK".  SIGINT or
+ * SIGTERM end the simulator.
+ */
+
+#include "stdarg.h"
+#include "stdbool.h"
+#include "stdint.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "fcntl.h"
+#include "poll.h"
+#include "signal.h"
+#include "termios.h"
+#include "time.h"
+#include "unistd.h"
+#include "cellular_capture.h"
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS
+ * -------------------------------------------------------------- */
+
+// The default link to the pseudo-terminal.
+#define CELLULAR_SIM_LINK_DEFAULT "/tmp/cellular_uart0"
+
+// The maximum length of a line of script or of an AT command.
+#define CELLULAR_SIM_LINE_MAX_LENGTH_BYTES 1024
+
+// The maximum number of rules in a script.
+#define CELLULAR_SIM_MAX_NUM_RULES 128
+
+// The maximum number of lines in a rule.
+#define CELLULAR_SIM_MAX_NUM_RULE_LINES 16
+
+// The maximum number of periodic URCs in a script.
+#define CELLULAR_SIM_MAX_NUM_URCS 8
+
+// The number of loop-back sockets.
+#define CELLULAR_SIM_MAX_NUM_SOCKETS 7
+
+// The size of the receive buffer of a loop-back socket, the
+// most that a SARA-R5 will hold.
+#define CELLULAR_SIM_SOCKET_BUFFER_SIZE_BYTES 8192
+
+// The most that a single AT+USORD will return.
+#define CELLULAR_SIM_SOCKET_READ_MAX_BYTES 1024
+
+// The number of socket options that a loop-back socket can hold.
+#define CELLULAR_SIM_SOCKET_MAX_NUM_OPTIONS 16
+
+// The number of datagrams that a loop-back UDP socket can hold;
+// any more are dropped, as UDP is allowed to do.
+#define CELLULAR_SIM_SOCKET_MAX_NUM_DATAGRAMS 64
+
+// The maximum length of the address a datagram is sent to.
+#define CELLULAR_SIM_ADDRESS_MAX_LENGTH_BYTES 64
+
+// The number of PDP contexts.
+#define CELLULAR_SIM_MAX_NUM_CONTEXTS 8
+
+// The number of <AcT-type>s of AT+CEDRXS.
+#define CELLULAR_SIM_MAX_NUM_EDRX_ACT_TYPES 6
+
+// The silence needed either side of the "+++" that leaves
+// direct-link mode, the default of a SARA-R5 (ATS12).
+#define CELLULAR_SIM_ESCAPE_GUARD_TIME_MS 1000
+
+// The number of files in the file system.
+#define CELLULAR_SIM_MAX_NUM_FILES 4
+
+// The maximum length of a file name.
+#define CELLULAR_SIM_FILE_NAME_MAX_LENGTH_BYTES 248
+
+// The maximum size of a file.
+#define CELLULAR_SIM_FILE_MAX_SIZE_BYTES 65536
+
+/** The number of MQTT-SN topics the gateway can know of.
+ */
+#define CELLULAR_SIM_MQTT_SN_MAX_NUM_TOPICS 8
+
+/** The number of MQTT-SN messages that can be waiting to be read.
+ */
+#define CELLULAR_SIM_MQTT_SN_MAX_NUM_MESSAGES 4
+
+/** The largest MQTT-SN message.
+ */
+#define CELLULAR_SIM_MQTT_SN_MESSAGE_MAX_LENGTH_BYTES 512
+
+/* ----------------------------------------------------------------
+ * TYPES
+ * -------------------------------------------------------------- */
+
+/** A line of a rule.
+ */
+typedef struct {
+    int32_t waitMs;
+    char *pText;
+    size_t length;
+} CellularSimLine_t;
+
+/** A rule.
+ */
+typedef struct {
+    char *pPrefix;
+    CellularSimLine_t line[CELLULAR_SIM_MAX_NUM_RULE_LINES];
+    size_t numLines;
+} CellularSimRule_t;
+
+/** A periodic URC.
+ */
+typedef struct {
+    int32_t periodMs;
+    int64_t nextMs;
+    char *pText;
+    size_t length;
+} CellularSimUrc_t;
+
+/** A chunk of output waiting to be sent.
+ */
+typedef struct CellularSimOutput_t {
+    int64_t dueMs;
+    size_t length;
+    struct CellularSimOutput_t *pNext;
+    char data[];
+} CellularSimOutput_t;
+
+/** A socket option set with AT+USOSO.
+ */
+typedef struct {
+    int level;
+    int option;
+    int value;
+} CellularSimSocketOption_t;
+
+/** A datagram held by a loop-back UDP socket, its data being
+ * in the buffer of the socket; it comes back from the address
+ * it was sent to.
+ */
+typedef struct {
+    size_t length;
+    char address[CELLULAR_SIM_ADDRESS_MAX_LENGTH_BYTES];
+    int port;
+} CellularSimDatagram_t;
+
+/** A loop-back socket.
+ */
+typedef struct {
+    bool inUse;
+    bool udp;
+    char buffer[CELLULAR_SIM_SOCKET_BUFFER_SIZE_BYTES];
+    size_t length;
+    CellularSimDatagram_t datagram[CELLULAR_SIM_SOCKET_MAX_NUM_DATAGRAMS];
+    size_t numDatagrams;
+    CellularSimSocketOption_t option[CELLULAR_SIM_SOCKET_MAX_NUM_OPTIONS];
+    size_t numOptions;
+} CellularSimSocket_t;
+
+/** A file.
+ */
+typedef struct {
+    bool inUse;
+    char name[CELLULAR_SIM_FILE_NAME_MAX_LENGTH_BYTES + 1];
+    char data[CELLULAR_SIM_FILE_MAX_SIZE_BYTES];
+    size_t length;
+} CellularSimFile_t;
+
+/** An MQTT-SN topic: a registered or subscribed-to topic name,
+ * whose ID is its index plus one, or a subscribed-to short name.
+ */
+typedef struct {
+    bool inUse;
+    bool isShort;
+    bool subscribed;
+    char name[CELLULAR_SIM_FILE_NAME_MAX_LENGTH_BYTES + 1];
+} CellularSimMqttSnTopic_t;
+
+/** An MQTT-SN message waiting to be read.
+ */
+typedef struct {
+    int qos;
+    int topicType;
+    int topicId;
+    char shortName[3];
+    char data[CELLULAR_SIM_MQTT_SN_MESSAGE_MAX_LENGTH_BYTES];
+    size_t length;
+} CellularSimMqttSnMessage_t;
+
+/* ----------------------------------------------------------------
+ * VARIABLES
+ * -------------------------------------------------------------- */
+
+// The master side of the pseudo-terminal.
+static int gFd = -1;
+
+// The script.
+static CellularSimRule_t gRule[CELLULAR_SIM_MAX_NUM_RULES];
+static size_t gNumRules = 0;
+static CellularSimUrc_t gUrc[CELLULAR_SIM_MAX_NUM_URCS];
+static size_t gNumUrcs = 0;
+static int32_t gLatencyMs = 0;
+static size_t gFragmentBytes = 0;
+static int32_t gFragmentGapMs = 0;
+
+// Output waiting to be sent, in order.
+static CellularSimOutput_t *gpOutputHead = NULL;
+static CellularSimOutput_t *gpOutputTail = NULL;
+
+// The command being assembled.
+static char gCommand[CELLULAR_SIM_LINE_MAX_LENGTH_BYTES];
+static size_t gCommandLength = 0;
+
+// Whether commands are echoed.
+static bool gEcho = true;
+
+// Whether commands are printed.
+static bool gVerbose = false;
+
+// Whether the radio of the simulated module is on.
+static bool gRadioOn = true;
+
+// Whether the simulated module is registered.
+static bool gRegistered = true;
+
+// The PDP contexts that have been defined and that are active,
+// indexed by context ID minus one.
+static bool gContextDefined[CELLULAR_SIM_MAX_NUM_CONTEXTS] = {true};
+static bool gContextActive[CELLULAR_SIM_MAX_NUM_CONTEXTS] = {true};
+
+// The settings: the band masks for cat-M1 and NB1, the MNO
+// profile, PSM with its periodic TAU and active time and the
+// eDRX value for each <AcT-type>, empty if eDRX is off.
+static unsigned long long gBandMask[2][2] = {{185473183, 0}, {185473183, 0}};
+static int gMnoProfile = 100;
+static int gPsmMode = 0;
+static char gPsmPeriodicTau[9] = "01000011";
+static char gPsmActiveTime[9] = "00000010";
+static char gEdrx[CELLULAR_SIM_MAX_NUM_EDRX_ACT_TYPES][5] = {"", "", "", "", "0101", ""};
+
+// The loop-back sockets.
+static CellularSimSocket_t gSocket[CELLULAR_SIM_MAX_NUM_SOCKETS];
+
+// Set while binary data for AT+USOWR or AT+USOST is being
+// collected, gWriteDatagram being where an AT+USOST is sent.
+static CellularSimSocket_t *gpWriteSocket = NULL;
+static int gWriteSocketId = -1;
+static size_t gWriteLeft = 0;
+static size_t gWriteTotal = 0;
+static CellularSimDatagram_t gWriteDatagram;
+
+// The socket in direct-link mode, -1 if there is none, the
+// number of '+' characters of a possible escape sequence held
+// back and when something was last received in direct-link mode.
+static int gDirectLinkSocketId = -1;
+static size_t gEscapeLength = 0;
+static int64_t gDirectLinkReceiveMs = 0;
+
+// The files.
+static CellularSimFile_t gFile[CELLULAR_SIM_MAX_NUM_FILES];
+
+// Set while binary data for AT+UDWNFILE is being collected;
+// anything beyond the maximum size of a file is thrown away.
+static CellularSimFile_t *gpWriteFile = NULL;
+static size_t gWriteFileLeft = 0;
+
+// Room for an AT+URDBLOCK response.
+static char gFileReadBuffer[CELLULAR_SIM_FILE_MAX_SIZE_BYTES +
+                            CELLULAR_SIM_FILE_NAME_MAX_LENGTH_BYTES + 32];
+
+// The MQTT-SN gateway's topics and the messages waiting to
+// be read, oldest first.
+static CellularSimMqttSnTopic_t gMqttSnTopic[CELLULAR_SIM_MQTT_SN_MAX_NUM_TOPICS];
+static CellularSimMqttSnMessage_t gMqttSnMessage[CELLULAR_SIM_MQTT_SN_MAX_NUM_MESSAGES];
+static size_t gMqttSnNumMessages = 0;
+
+// The state of the MQTT-SN session.
+static bool gMqttSnConnected = false;
+static bool gMqttSnAsleep = false;
+
+// The capture being played back.
+static CellularCaptureChunk_t *gpReplay = NULL;
+static size_t gReplayNumChunks = 0;
+static size_t gReplayIndex = 0;
+static size_t gReplayTxReceived = 0;
+static size_t gReplayMismatches = 0;
+
+// Set by the signal handler to stop.
+static volatile sig_atomic_t gStop = 0;
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS: MISC
+ * -------------------------------------------------------------- */
+
+// Get the monotonic time in milliseconds.
+static int64_t nowMs()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (((int64_t) now.tv_sec) * 1000) + (now.tv_nsec / 1000000);
+}
+
+// Signal handler.
+static void signalHandler(int signal)
+{
+    (void) signal;
+    gStop = 1;
+}
+
+// Convert the escapes in a string, in place, returning the
+// resulting length.
+static size_t unescape(char *pStr)
+{
+    char *pStart = pStr;
+    char *pOut = pStr;
+    unsigned int x;
+
+    while (*pStr != 0) {
+        if ((*pStr == '\\') && (*(pStr + 1) != 0)) {
+            pStr++;
+            switch (*pStr) {
+                case 'r':
+                    *pOut = '\r';
+                break;
+                case 'n':
+                    *pOut = '\n';
+                break;
+                case 'x':
+                    x = 0;
+                    if (sscanf(pStr + 1, "%2x", &x) == 1) {
+                        pStr += 2;
+                    }
+                    *pOut = (char) x;
+                break;
+                default:
+                    *pOut = *pStr;
+                break;
+            }
+        } else {
+            *pOut = *pStr;
+        }
+        pOut++;
+        pStr++;
+    }
+    *pOut = 0;
+
+    return pOut - pStart;
+}
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS: OUTPUT
+ * -------------------------------------------------------------- */
+
+// Queue a single chunk of output at the given time.
+static void outputChunk(const char *pData, size_t length, int64_t dueMs)
+{
+    CellularSimOutput_t *pOutput;
+
+    pOutput = (CellularSimOutput_t *) malloc(sizeof(*pOutput) + length);
+    if (pOutput != NULL) {
+        pOutput->dueMs = dueMs;
+        pOutput->length = length;
+        pOutput->pNext = NULL;
+        memcpy(pOutput->data, pData, length);
+        if (gpOutputTail != NULL) {
+            gpOutputTail->pNext = pOutput;
+        } else {
+            gpOutputHead = pOutput;
+        }
+        gpOutputTail = pOutput;
+    }
+}
+
+// Queue output, applying latency and fragmentation; output
+// is never reordered, so nothing goes out before whatever was
+// queued ahead of it.
+static void output(const char *pData, size_t length, int32_t extraDelayMs)
+{
+    int64_t dueMs = nowMs() + gLatencyMs + extraDelayMs;
+    size_t thisLength;
+
+    if ((gpOutputTail != NULL) && (gpOutputTail->dueMs > dueMs)) {
+        dueMs = gpOutputTail->dueMs + extraDelayMs;
+    }
+    while (length > 0) {
+        thisLength = length;
+        if ((gFragmentBytes > 0) && (thisLength > gFragmentBytes)) {
+            thisLength = gFragmentBytes;
+        }
+        outputChunk(pData, thisLength, dueMs);
+        pData += thisLength;
+        length -= thisLength;
+        dueMs += gFragmentGapMs;
+    }
+}
+
+// Queue a string of output.
+static void outputString(const char *pStr)
+{
+    output(pStr, strlen(pStr), 0);
+}
+
+// Queue a response line, "\r\n<text>\r\n".
+static void outputLine(const char *pFormat, ...)
+{
+    char buffer[CELLULAR_SIM_LINE_MAX_LENGTH_BYTES];
+    va_list args;
+    int x;
+
+    buffer[0] = '\r';
+    buffer[1] = '\n';
+    va_start(args, pFormat);
+    x = vsnprintf(buffer + 2, sizeof(buffer) - 4, pFormat, args);
+    va_end(args);
+    if (x > (int) sizeof(buffer) - 5) {
+        x = (int) sizeof(buffer) - 5;
+    }
+    buffer[x + 2] = '\r';
+    buffer[x + 3] = '\n';
+    output(buffer, x + 4, 0);
+}
+
+// Send whatever output is due, returning the time until
+// the next is due or -1 if there is none.
+static int outputService()
+{
+    CellularSimOutput_t *pOutput;
+    int64_t now = nowMs();
+    int timeoutMs = -1;
+    ssize_t x;
+
+    while ((gpOutputHead != NULL) && (gpOutputHead->dueMs <= now)) {
+        pOutput = gpOutputHead;
+        x = write(gFd, pOutput->data, pOutput->length);
+        if (x == (ssize_t) pOutput->length) {
+            gpOutputHead = pOutput->pNext;
+            if (gpOutputHead == NULL) {
+                gpOutputTail = NULL;
+            }
+            free(pOutput);
+        } else {
+            if (x > 0) {
+                // Partial write, keep the rest
+                memmove(pOutput->data, pOutput->data + x,
+                        pOutput->length - x);
+                pOutput->length -= x;
+            }
+            // Try again shortly
+            return 1;
+        }
+    }
+    if (gpOutputHead != NULL) {
+        timeoutMs = (int) (gpOutputHead->dueMs - now);
+    }
+
+    return timeoutMs;
+}
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS: SCRIPT
+ * -------------------------------------------------------------- */
+
+// Read the script, returning false on error.
+static bool scriptRead(const char *pPath)
+{
+    char line[CELLULAR_SIM_LINE_MAX_LENGTH_BYTES];
+    CellularSimRule_t *pRule = NULL;
+    CellularSimLine_t *pLine;
+    int32_t waitMs = 0;
+    bool success = true;
+    size_t lineNumber = 0;
+    FILE *pFile;
+    char *pArg;
+    char *pEnd;
+
+    pFile = fopen(pPath, "r");
+    if (pFile == NULL) {
+        fprintf(stderr, "cellular_sim: unable to open %s.\n", pPath);
+        return false;
+    }
+
+    while (success && (fgets(line, sizeof(line), pFile) != NULL)) {
+        lineNumber++;
+        // Lose the line ending
+        line[strcspn(line, "\r\n")] = 0;
+        if ((line[0] == 0) || (line[0] == '#')) {
+            continue;
+        }
+        pArg = line + strcspn(line, " \t");
+        if (*pArg != 0) {
+            *pArg = 0;
+            pArg++;
+            pArg += strspn(pArg, " \t");
+        }
+        if (strcmp(line, "latency") == 0) {
+            gLatencyMs = strtol(pArg, NULL, 10);
+        } else if (strcmp(line, "fragment") == 0) {
+            gFragmentBytes = strtoul(pArg, &pEnd, 10);
+            gFragmentGapMs = strtol(pEnd, NULL, 10);
+        } else if ((strcmp(line, "urc") == 0) &&
+                   (gNumUrcs < CELLULAR_SIM_MAX_NUM_URCS)) {
+            gUrc[gNumUrcs].periodMs = strtol(pArg, &pEnd, 10);
+            pEnd += strspn(pEnd, " \t");
+            gUrc[gNumUrcs].pText = malloc(strlen(pEnd) + 5);
+            if ((gUrc[gNumUrcs].periodMs > 0) && (gUrc[gNumUrcs].pText != NULL)) {
+                sprintf(gUrc[gNumUrcs].pText, "\r\n%s\r\n", pEnd);
+                gUrc[gNumUrcs].length = unescape(gUrc[gNumUrcs].pText);
+                gUrc[gNumUrcs].nextMs = nowMs() + gUrc[gNumUrcs].periodMs;
+                gNumUrcs++;
+            } else {
+                success = false;
+            }
+        } else if ((strcmp(line, "cmd") == 0) &&
+                   (gNumRules < CELLULAR_SIM_MAX_NUM_RULES)) {
+            pRule = &(gRule[gNumRules]);
+            pRule->pPrefix = strdup(pArg);
+            pRule->numLines = 0;
+            waitMs = 0;
+            success = (pRule->pPrefix != NULL);
+            gNumRules++;
+        } else if ((strcmp(line, "wait") == 0) && (pRule != NULL)) {
+            waitMs += strtol(pArg, NULL, 10);
+        } else if (((strcmp(line, "rsp") == 0) || (strcmp(line, "raw") == 0)) &&
+                   (pRule != NULL) &&
+                   (pRule->numLines < CELLULAR_SIM_MAX_NUM_RULE_LINES)) {
+            pLine = &(pRule->line[pRule->numLines]);
+            pLine->waitMs = waitMs;
+            waitMs = 0;
+            pLine->pText = malloc(strlen(pArg) + 5);
+            if (pLine->pText != NULL) {
+                if (line[1] == 's') {
+                    sprintf(pLine->pText, "\r\n%s\r\n", pArg);
+                } else {
+                    strcpy(pLine->pText, pArg);
+                }
+                pLine->length = unescape(pLine->pText);
+                pRule->numLines++;
+            } else {
+                success = false;
+            }
+        } else {
+            success = false;
+        }
+        if (!success) {
+            fprintf(stderr, "cellular_sim: error at line %d of %s.\n",
+                    (int) lineNumber, pPath);
+        }
+    }
+
+    fclose(pFile);
+
+    return success;
+}
+
+// Run the rule that matches a command, returning false if
+// there is none.
+static bool scriptRun(const char *pCommand)
+{
+    CellularSimRule_t *pRule;
+    bool found = false;
+
+    for (size_t x = 0; (x < gNumRules) && !found; x++) {
+        pRule = &(gRule[x]);
+        if (strncmp(pCommand, pRule->pPrefix, strlen(pRule->pPrefix)) == 0) {
+            for (size_t y = 0; y < pRule->numLines; y++) {
+                output(pRule->line[y].pText, pRule->line[y].length,
+                       pRule->line[y].waitMs);
+            }
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+// Send any periodic URCs that are due, returning the time
+// until the next is due or -1 if there is none.
+static int urcService()
+{
+    int64_t now = nowMs();
+    int timeoutMs = -1;
+
+    for (size_t x = 0; x < gNumUrcs; x++) {
+        if (gUrc[x].nextMs <= now) {
+            output(gUrc[x].pText, gUrc[x].length, 0);
+            gUrc[x].nextMs = now + gUrc[x].periodMs;
+        }
+        if ((timeoutMs < 0) || (gUrc[x].nextMs - now < timeoutMs)) {
+            timeoutMs = (int) (gUrc[x].nextMs - now);
+        }
+    }
+
+    return timeoutMs;
+}
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS: REPLAY
+ * -------------------------------------------------------------- */
+
+// Queue the received chunks of the capture that follow on from
+// where playback has got to, timed relative to baseMs, the time
+// in the capture of whatever they are following.
+static void replayQueueRx(int64_t baseMs)
+{
+    CellularCaptureChunk_t *pChunk;
+    int64_t now = nowMs();
+    int64_t dueMs;
+
+    while ((gReplayIndex < gReplayNumChunks) &&
+           !gpReplay[gReplayIndex].tx) {
+        pChunk = &(gpReplay[gReplayIndex]);
+        dueMs = now + pChunk->timeMs - baseMs;
+        if ((gpOutputTail != NULL) && (gpOutputTail->dueMs > dueMs)) {
+            dueMs = gpOutputTail->dueMs;
+        }
+        outputChunk(pChunk->pData, pChunk->length, dueMs);
+        gReplayIndex++;
+    }
+    if (gReplayIndex >= gReplayNumChunks) {
+        printf("cellular_sim: end of capture, %d byte(s) sent by the AT"
+               " client did not match.\n", (int) gReplayMismatches);
+        fflush(stdout);
+    }
+}
+
+// Handle received bytes when playing back a capture.
+static void replayReceive(const char *pData, size_t length)
+{
+    CellularCaptureChunk_t *pChunk;
+
+    for (size_t x = 0; (x < length) && (gReplayIndex < gReplayNumChunks); x++) {
+        pChunk = &(gpReplay[gReplayIndex]);
+        if (pData[x] != pChunk->pData[gReplayTxReceived]) {
+            if (gVerbose && (gReplayMismatches == 0)) {
+                printf("cellular_sim: first mismatch is in chunk %d at"
+                       " offset %d.\n", (int) gReplayIndex,
+                       (int) gReplayTxReceived);
+            }
+            gReplayMismatches++;
+        }
+        gReplayTxReceived++;
+        if (gReplayTxReceived >= pChunk->length) {
+            if (gVerbose) {
+                printf("cellular_sim: chunk %d of %d (%d byte(s)) received.\n",
+                       (int) gReplayIndex + 1, (int) gReplayNumChunks,
+                       (int) pChunk->length);
+            }
+            gReplayTxReceived = 0;
+            gReplayIndex++;
+            replayQueueRx(pChunk->timeMs);
+        }
+    }
+    fflush(stdout);
+}
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS: BUILT-IN COMMANDS
+ * -------------------------------------------------------------- */
+
+// Get a loop-back socket from its ID, NULL if it is not in use.
+static CellularSimSocket_t *pSocketGet(int id)
+{
+    CellularSimSocket_t *pSocket = NULL;
+
+    if ((id >= 0) && (id < CELLULAR_SIM_MAX_NUM_SOCKETS) &&
+        gSocket[id].inUse) {
+        pSocket = &(gSocket[id]);
+    }
+
+    return pSocket;
+}
+
+// Find an option of a loop-back socket, adding it if
+// requested, NULL if it is not there or there is no room.
+static CellularSimSocketOption_t *pSocketOptionFind(CellularSimSocket_t *pSocket,
+                                                    int level, int option,
+                                                    bool add)
+{
+    CellularSimSocketOption_t *pOption = NULL;
+
+    for (size_t x = 0; (x < pSocket->numOptions) && (pOption == NULL); x++) {
+        if ((pSocket->option[x].level == level) &&
+            (pSocket->option[x].option == option)) {
+            pOption = &(pSocket->option[x]);
+        }
+    }
+    if ((pOption == NULL) && add &&
+        (pSocket->numOptions < CELLULAR_SIM_SOCKET_MAX_NUM_OPTIONS)) {
+        pOption = &(pSocket->option[pSocket->numOptions]);
+        pOption->level = level;
+        pOption->option = option;
+        pOption->value = 0;
+        pSocket->numOptions++;
+    }
+
+    return pOption;
+}
+
+// Handle the binary data of an AT+USOWR or an AT+USOST.
+static void socketWriteData(const char *pData, size_t length)
+{
+    size_t room;
+
+    room = sizeof(gpWriteSocket->buffer) - gpWriteSocket->length;
+    if (room > length) {
+        room = length;
+    }
+    if (gpWriteSocket->udp &&
+        (gpWriteSocket->numDatagrams >= CELLULAR_SIM_SOCKET_MAX_NUM_DATAGRAMS)) {
+        // Nowhere to keep the datagram
+        room = 0;
+    }
+    memcpy(gpWriteSocket->buffer + gpWriteSocket->length, pData, room);
+    gpWriteSocket->length += room;
+    gWriteDatagram.length += room;
+    gWriteLeft -= length;
+    if (gWriteLeft == 0) {
+        if (gpWriteSocket->udp) {
+            if (gWriteDatagram.length == gWriteTotal) {
+                gpWriteSocket->datagram[gpWriteSocket->numDatagrams] = gWriteDatagram;
+                gpWriteSocket->numDatagrams++;
+            } else {
+                // Only whole datagrams are kept
+                gpWriteSocket->length -= gWriteDatagram.length;
+            }
+            outputLine("+USOST: %d,%d", gWriteSocketId, (int) gWriteTotal);
+            outputLine("OK");
+            if (gpWriteSocket->length > 0) {
+                outputLine("+UUSORF: %d,%d", gWriteSocketId,
+                           (int) gpWriteSocket->length);
+            }
+        } else {
+            outputLine("+USOWR: %d,%d", gWriteSocketId, (int) gWriteTotal);
+            outputLine("OK");
+            outputLine("+UUSORD: %d,%d", gWriteSocketId,
+                       (int) gpWriteSocket->length);
+        }
+        gpWriteSocket = NULL;
+    }
+}
+
+// Read the oldest datagram of a loop-back UDP socket into
+// pBuffer as the response to AT+USORF, at most length bytes
+// of it, the rest being lost, returning the size of the
+// response.
+static int socketReadDatagram(CellularSimSocket_t *pSocket, int id,
+                              int length, char *pBuffer)
+{
+    CellularSimDatagram_t *pDatagram = &(pSocket->datagram[0]);
+    int x;
+
+    if (length > (int) pDatagram->length) {
+        length = (int) pDatagram->length;
+    }
+    x = sprintf(pBuffer, "\r\n+USORF: %d,\"%s\",%d,%d,\"", id,
+                pDatagram->address, pDatagram->port, length);
+    memcpy(pBuffer + x, pSocket->buffer, length);
+    x += length;
+    memcpy(pBuffer + x, "\"\r\n", 3);
+    x += 3;
+    pSocket->length -= pDatagram->length;
+    memmove(pSocket->buffer, pSocket->buffer + pDatagram->length,
+            pSocket->length);
+    pSocket->numDatagrams--;
+    memmove(pDatagram, pDatagram + 1,
+            pSocket->numDatagrams * sizeof(*pDatagram));
+
+    return x;
+}
+
+// Handle bytes received in direct-link mode: they are looped
+// straight back apart from an escape sequence, "+++" with
+// silence either side, the '+' characters of which are held
+// back until it is clear whether they are data.
+static void directLinkReceive(const char *pData, size_t length)
+{
+    char buffer[CELLULAR_SIM_LINE_MAX_LENGTH_BYTES + 3];
+    int64_t now = nowMs();
+    size_t y = 0;
+
+    for (size_t x = 0; x < length; x++) {
+        if ((pData[x] == '+') && (gEscapeLength < 3) &&
+            ((gEscapeLength > 0) ||
+             ((x == 0) && (now - gDirectLinkReceiveMs >= CELLULAR_SIM_ESCAPE_GUARD_TIME_MS)))) {
+            gEscapeLength++;
+        } else {
+            if (gEscapeLength > 0) {
+                // Not an escape sequence after all
+                memset(buffer + y, '+', gEscapeLength);
+                y += gEscapeLength;
+                gEscapeLength = 0;
+            }
+            buffer[y] = pData[x];
+            y++;
+            if (y >= sizeof(buffer) - 3) {
+                output(buffer, y, 0);
+                y = 0;
+            }
+        }
+    }
+    if (y > 0) {
+        output(buffer, y, 0);
+    }
+    gDirectLinkReceiveMs = now;
+}
+
+// Leave direct-link mode once an escape sequence has been
+// followed by silence, returning the time until that might
+// happen or -1 if it can't.
+static int directLinkService()
+{
+    int64_t now = nowMs();
+    int timeoutMs = -1;
+
+    if ((gDirectLinkSocketId >= 0) && (gEscapeLength == 3)) {
+        timeoutMs = (int) (gDirectLinkReceiveMs +
+                           CELLULAR_SIM_ESCAPE_GUARD_TIME_MS - now);
+        if (timeoutMs <= 0) {
+            gDirectLinkSocketId = -1;
+            gEscapeLength = 0;
+            timeoutMs = -1;
+            outputLine("DISCONNECT");
+        }
+    }
+
+    return timeoutMs;
+}
+
+// Get the quoted file name at the start of pStr into pName,
+// returning a pointer to what follows the closing quote or
+// NULL if there is no usable file name.
+static const char *pFileNameGet(const char *pStr, char *pName)
+{
+    const char *pEnd = NULL;
+
+    if (*pStr == '"') {
+        pStr++;
+        pEnd = strchr(pStr, '"');
+        if ((pEnd != NULL) && (pEnd > pStr) &&
+            (pEnd - pStr <= CELLULAR_SIM_FILE_NAME_MAX_LENGTH_BYTES)) {
+            memcpy(pName, pStr, pEnd - pStr);
+            pName[pEnd - pStr] = 0;
+            pEnd++;
+        } else {
+            pEnd = NULL;
+        }
+    }
+
+    return pEnd;
+}
+
+// Find a file by name, NULL if there is no such file.
+static CellularSimFile_t *pFileFind(const char *pName)
+{
+    CellularSimFile_t *pFile = NULL;
+
+    for (size_t x = 0; (x < CELLULAR_SIM_MAX_NUM_FILES) && (pFile == NULL); x++) {
+        if (gFile[x].inUse && (strcmp(gFile[x].name, pName) == 0)) {
+            pFile = &(gFile[x]);
+        }
+    }
+
+    return pFile;
+}
+
+// Create an empty file, NULL if there is no room; an existing
+// file of the same name is emptied.
+static CellularSimFile_t *pFileCreate(const char *pName)
+{
+    CellularSimFile_t *pFile = pFileFind(pName);
+
+    for (size_t x = 0; (x < CELLULAR_SIM_MAX_NUM_FILES) && (pFile == NULL); x++) {
+        if (!gFile[x].inUse) {
+            pFile = &(gFile[x]);
+            pFile->inUse = true;
+            strcpy(pFile->name, pName);
+        }
+    }
+    if (pFile != NULL) {
+        pFile->length = 0;
+    }
+
+    return pFile;
+}
+
+// Append a string to a file, truncating it if it won't fit.
+static void fileAppendString(CellularSimFile_t *pFile, const char *pStr)
+{
+    size_t length = strlen(pStr);
+
+    if (length > sizeof(pFile->data) - pFile->length) {
+        length = sizeof(pFile->data) - pFile->length;
+    }
+    memcpy(pFile->data + pFile->length, pStr, length);
+    pFile->length += length;
+}
+
+// Do an AT+UHTTPC request, writing the response into pFile:
+// "/bytes/<n>" gets a body of n bytes, a POST gets the
+// contents of pRequest back as the body, a HEAD gets headers
+// only and any other path gets a 404.
+static void httpRequest(int command, const char *pPath,
+                        CellularSimFile_t *pRequest,
+                        CellularSimFile_t *pFile)
+{
+    char line[64];
+    int size = -1;
+
+    if (command == 4) {
+        size = (pRequest != NULL) ? (int) pRequest->length : 0;
+    } else if (sscanf(pPath, "/bytes/%d", &size) != 1) {
+        size = -1;
+    }
+    if (size > (int) sizeof(pFile->data) - 128) {
+        size = (int) sizeof(pFile->data) - 128;
+    }
+    if (size >= 0) {
+        fileAppendString(pFile, "HTTP/1.1 200 OK\r\n");
+        snprintf(line, sizeof(line), "Content-Length: %d\r\n\r\n", size);
+        fileAppendString(pFile, line);
+        if (command != 0) {
+            for (int x = 0; x < size; x++) {
+                pFile->data[pFile->length + x] = (command == 4) ?
+                                                 pRequest->data[x] :
+                                                 (char) (x & 0xFF);
+            }
+            pFile->length += size;
+        }
+    } else {
+        fileAppendString(pFile, "HTTP/1.1 404 Not Found\r\n"
+                         "Content-Length: 0\r\n\r\n");
+    }
+}
+
+// Handle the binary data of an AT+UDWNFILE.
+static void fileWriteData(const char *pData, size_t length)
+{
+    size_t room;
+
+    room = sizeof(gpWriteFile->data) - gpWriteFile->length;
+    if (room > length) {
+        room = length;
+    }
+    memcpy(gpWriteFile->data + gpWriteFile->length, pData, room);
+    gpWriteFile->length += room;
+    gWriteFileLeft -= length;
+    if (gWriteFileLeft == 0) {
+        outputLine("OK");
+        gpWriteFile = NULL;
+    }
+}
+
+// Handle a built-in file system command, returning true if
+// the command was one.
+static bool builtInFileRun(const char *pCommand)
+{
+    CellularSimFile_t *pFile = NULL;
+    char name[CELLULAR_SIM_FILE_NAME_MAX_LENGTH_BYTES + 1];
+    const char *pStr;
+    int offset = -1;
+    int length = -1;
+    int x;
+    bool isFileCommand = true;
+
+    if (strncmp(pCommand, "AT+UDWNFILE=", 12) == 0) {
+        pStr = pFileNameGet(pCommand + 12, name);
+        if ((pStr != NULL) && (sscanf(pStr, ",%d", &length) == 1) &&
+            (length > 0)) {
+            pFile = pFileFind(name);
+            if (pFile == NULL) {
+                pFile = pFileCreate(name);
+            }
+        }
+        if (pFile != NULL) {
+            gpWriteFile = pFile;
+            gWriteFileLeft = length;
+            outputString("\r\n>");
+        } else {
+            outputLine("ERROR");
+        }
+    } else if (strncmp(pCommand, "AT+URDBLOCK=", 12) == 0) {
+        pStr = pFileNameGet(pCommand + 12, name);
+        if ((pStr != NULL) &&
+            (sscanf(pStr, ",%d,%d", &offset, &length) == 2)) {
+            pFile = pFileFind(name);
+        }
+        if ((pFile != NULL) && (offset >= 0) && (length >= 0)) {
+            if (offset > (int) pFile->length) {
+                offset = (int) pFile->length;
+            }
+            if (length > (int) pFile->length - offset) {
+                length = (int) pFile->length - offset;
+            }
+            x = snprintf(gFileReadBuffer, sizeof(gFileReadBuffer),
+                         "\r\n+URDBLOCK: \"%s\",%d,\"", name, length);
+            memcpy(gFileReadBuffer + x, pFile->data + offset, length);
+            x += length;
+            memcpy(gFileReadBuffer + x, "\"\r\n", 3);
+            x += 3;
+            output(gFileReadBuffer, x, 0);
+            outputLine("OK");
+        } else {
+            outputLine("ERROR");
+        }
+    } else if (strncmp(pCommand, "AT+ULSTFILE=2,", 14) == 0) {
+        pStr = pFileNameGet(pCommand + 14, name);
+        if (pStr != NULL) {
+            pFile = pFileFind(name);
+        }
+        if (pFile != NULL) {
+            outputLine("+ULSTFILE: %d", (int) pFile->length);
+            outputLine("OK");
+        } else {
+            outputLine("ERROR");
+        }
+    } else if (strncmp(pCommand, "AT+UHTTPC=", 10) == 0) {
+        CellularSimFile_t *pRequest = NULL;
+        char path[CELLULAR_SIM_FILE_NAME_MAX_LENGTH_BYTES + 1];
+        int profileId = -1;
+        int command = -1;
+
+        pStr = NULL;
+        if ((sscanf(pCommand + 10, "%d,%d,%n", &profileId, &command, &x) == 2) &&
+            (profileId >= 0) && ((command == 0) || (command == 1) || (command == 4))) {
+            pStr = pFileNameGet(pCommand + 10 + x, path);
+        }
+        if ((pStr != NULL) && (*pStr == ',')) {
+            pStr = pFileNameGet(pStr + 1, name);
+        } else {
+            pStr = NULL;
+        }
+        if ((pStr != NULL) && (command == 4)) {
+            char requestName[CELLULAR_SIM_FILE_NAME_MAX_LENGTH_BYTES + 1];
+
+            if ((*pStr == ',') &&
+                (pFileNameGet(pStr + 1, requestName) != NULL)) {
+                pRequest = pFileFind(requestName);
+            }
+            if (pRequest == NULL) {
+                pStr = NULL;
+            }
+        }
+        if (pStr != NULL) {
+            pFile = pFileCreate(name);
+        }
+        if (pFile != NULL) {
+            httpRequest(command, path, pRequest, pFile);
+            outputLine("OK");
+            outputLine("+UUHTTPCR: %d,%d,1", profileId, command);
+        } else {
+            outputLine("ERROR");
+        }
+    } else if (strncmp(pCommand, "AT+UDELFILE=", 12) == 0) {
+        pStr = pFileNameGet(pCommand + 12, name);
+        if (pStr != NULL) {
+            pFile = pFileFind(name);
+        }
+        if (pFile != NULL) {
+            pFile->inUse = false;
+            outputLine("OK");
+        } else {
+            outputLine("ERROR");
+        }
+    } else {
+        isFileCommand = false;
+    }
+
+    return isFileCommand;
+}
+
+// Find an MQTT-SN topic, adding it if add is true, NULL if
+// there is no such topic or no room.
+static CellularSimMqttSnTopic_t *pMqttSnTopicFind(const char *pName,
+                                                  bool isShort, bool add)
+{
+    CellularSimMqttSnTopic_t *pTopic = NULL;
+    CellularSimMqttSnTopic_t *pFree = NULL;
+
+    for (size_t x = 0; (x < CELLULAR_SIM_MQTT_SN_MAX_NUM_TOPICS) && (pTopic == NULL); x++) {
+        if (gMqttSnTopic[x].inUse) {
+            if ((gMqttSnTopic[x].isShort == isShort) &&
+                (strcmp(gMqttSnTopic[x].name, pName) == 0)) {
+                pTopic = &(gMqttSnTopic[x]);
+            }
+        } else if (pFree == NULL) {
+            pFree = &(gMqttSnTopic[x]);
+        }
+    }
+    if ((pTopic == NULL) && add && (pFree != NULL)) {
+        pTopic = pFree;
+        memset(pTopic, 0, sizeof(*pTopic));
+        pTopic->inUse = true;
+        pTopic->isShort = isShort;
+        strcpy(pTopic->name, pName);
+    }
+
+    return pTopic;
+}
+
+// Get a registered or pre-defined MQTT-SN topic by its ID,
+// NULL if there is no such topic.
+static CellularSimMqttSnTopic_t *pMqttSnTopicIdGet(int topicId)
+{
+    CellularSimMqttSnTopic_t *pTopic = NULL;
+
+    if ((topicId > 0) && (topicId <= CELLULAR_SIM_MQTT_SN_MAX_NUM_TOPICS) &&
+        gMqttSnTopic[topicId - 1].inUse && !gMqttSnTopic[topicId - 1].isShort) {
+        pTopic = &(gMqttSnTopic[topicId - 1]);
+    }
+
+    return pTopic;
+}
+
+// Get the topic of an AT+UMQTTSNC command, <topic_type>,<topic>,
+// at the start of pStr, returning a pointer to what follows or
+// NULL if it can't be understood; pTopicId is set for a topic
+// ID, pName for a quoted topic name or short name.
+static const char *pMqttSnTopicGet(const char *pStr, int *pTopicType,
+                                   int *pTopicId, char *pName)
+{
+    int x = 0;
+
+    *pTopicId = 0;
+    pName[0] = 0;
+    if (sscanf(pStr, "%d,%n", pTopicType, &x) == 1) {
+        pStr += x;
+        if (((*pTopicType == 0) || (*pTopicType == 1)) && (*pStr != '"')) {
+            if (sscanf(pStr, "%d%n", pTopicId, &x) == 1) {
+                pStr += x;
+            } else {
+                pStr = NULL;
+            }
+        } else if ((*pTopicType == 0) || (*pTopicType == 2)) {
+            pStr = pFileNameGet(pStr, pName);
+            if ((pStr != NULL) && (*pTopicType == 2) && (strlen(pName) != 2)) {
+                pStr = NULL;
+            }
+        } else {
+            pStr = NULL;
+        }
+    } else {
+        pStr = NULL;
+    }
+
+    return pStr;
+}
+
+// Handle an MQTT-SN command, returning false if it isn't one.
+// The gateway is a loop-back: a message published to a topic
+// that has been subscribed to comes back as an unread message.
+static bool builtInMqttSnRun(const char *pCommand)
+{
+    bool isMqttSnCommand = true;
+    CellularSimMqttSnTopic_t *pTopic = NULL;
+    CellularSimMqttSnMessage_t *pMessage;
+    char name[CELLULAR_SIM_FILE_NAME_MAX_LENGTH_BYTES + 1];
+    char buffer[CELLULAR_SIM_LINE_MAX_LENGTH_BYTES];
+    const char *pStr;
+    int op = -1;
+    int qos = 0;
+    int retain = 0;
+    int hexMode = 0;
+    int topicType = -1;
+    int topicId = 0;
+    int x = 0;
+    unsigned int byte;
+
+    if (strcmp(pCommand, "AT+UMQTTSNER") == 0) {
+        outputLine("+UMQTTSNER: 0,0");
+        outputLine("OK");
+    } else if (strncmp(pCommand, "AT+UMQTTSNC=", 12) == 0) {
+        pStr = pCommand + 12;
+        if (sscanf(pStr, "%d%n", &op, &x) == 1) {
+            pStr += x;
+        }
+        switch (op) {
+            case 0:
+                // Disconnect or, with a duration, sleep
+                if (sscanf(pStr, ",%d", &x) == 1) {
+                    gMqttSnAsleep = true;
+                } else {
+                    gMqttSnConnected = false;
+                    gMqttSnAsleep = false;
+                }
+                outputLine("+UMQTTSNC: 0,1");
+                outputLine("OK");
+                outputLine("+UUMQTTSNC: 0,1");
+                break;
+            case 1:
+                gMqttSnConnected = true;
+                gMqttSnAsleep = false;
+                outputLine("+UMQTTSNC: 1,1");
+                outputLine("OK");
+                outputLine("+UUMQTTSNC: 1,1");
+                if (gMqttSnNumMessages > 0) {
+                    outputLine("+UUMQTTSNC: 9,%d", (int) gMqttSnNumMessages);
+                }
+                break;
+            case 2:
+                // Register
+                if ((*pStr == ',') && gMqttSnConnected &&
+                    (pFileNameGet(pStr + 1, name) != NULL)) {
+                    pTopic = pMqttSnTopicFind(name, false, true);
+                }
+                if (pTopic != NULL) {
+                    outputLine("+UMQTTSNC: 2,1");
+                    outputLine("OK");
+                    outputLine("+UUMQTTSNC: 2,1,%d",
+                               (int) (pTopic - gMqttSnTopic) + 1);
+                } else {
+                    outputLine("ERROR");
+                }
+                break;
+            case 3:
+                // Ping, which wakes a sleeping client up
+                // long enough to get its messages
+                outputLine("+UMQTTSNC: 3,1");
+                outputLine("OK");
+                if (gMqttSnNumMessages > 0) {
+                    outputLine("+UUMQTTSNC: 9,%d", (int) gMqttSnNumMessages);
+                }
+                outputLine("+UUMQTTSNC: 3,1");
+                break;
+            case 4:
+                // Publish
+                pMessage = NULL;
+                if ((sscanf(pStr, ",%d,%d,%d,%n", &qos, &retain, &hexMode, &x) == 3) &&
+                    (hexMode == 1)) {
+                    pStr = pMqttSnTopicGet(pStr + x, &topicType, &topicId, name);
+                    if ((pStr != NULL) && (strncmp(pStr, ",\"", 2) == 0)) {
+                        pStr += 2;
+                    } else {
+                        pStr = NULL;
+                    }
+                    if ((pStr != NULL) && (gMqttSnConnected || (qos == 3))) {
+                        if (topicType == 2) {
+                            pTopic = pMqttSnTopicFind(name, true, false);
+                        } else if (name[0] == 0) {
+                            // Always published by ID
+                            pTopic = pMqttSnTopicIdGet(topicId);
+                        } else {
+                            pStr = NULL;
+                        }
+                    } else {
+                        pStr = NULL;
+                    }
+                    if ((pStr != NULL) && (pTopic != NULL) && pTopic->subscribed &&
+                        (gMqttSnNumMessages < CELLULAR_SIM_MQTT_SN_MAX_NUM_MESSAGES)) {
+                        pMessage = &(gMqttSnMessage[gMqttSnNumMessages]);
+                        memset(pMessage, 0, sizeof(*pMessage));
+                        pMessage->qos = (qos == 3) ? 0 : qos;
+                        pMessage->topicType = topicType;
+                        pMessage->topicId = topicId;
+                        if (topicType == 2) {
+                            strcpy(pMessage->shortName, name);
+                        }
+                    }
+                }
+                if (pStr != NULL) {
+                    while ((*pStr != '"') && (*pStr != 0) &&
+                           (sscanf(pStr, "%2x", &byte) == 1)) {
+                        if ((pMessage != NULL) &&
+                            (pMessage->length < sizeof(pMessage->data))) {
+                            pMessage->data[pMessage->length] = (char) byte;
+                            pMessage->length++;
+                        }
+                        pStr += 2;
+                    }
+                    outputLine("+UMQTTSNC: 4,1");
+                    outputLine("OK");
+                    if ((qos == 1) || (qos == 2)) {
+                        outputLine("+UUMQTTSNC: 4,1");
+                    }
+                    if (pMessage != NULL) {
+                        gMqttSnNumMessages++;
+                        if (!gMqttSnAsleep) {
+                            outputLine("+UUMQTTSNC: 9,%d", (int) gMqttSnNumMessages);
+                        }
+                    }
+                } else {
+                    outputLine("ERROR");
+                }
+                break;
+            case 5:
+            case 6:
+                // Subscribe or unsubscribe
+                if (op == 5) {
+                    if (sscanf(pStr, ",%d%n", &qos, &x) == 1) {
+                        pStr += x;
+                    } else {
+                        pStr = NULL;
+                    }
+                }
+                if ((pStr != NULL) && (*pStr == ',') && gMqttSnConnected) {
+                    pStr = pMqttSnTopicGet(pStr + 1, &topicType, &topicId, name);
+                } else {
+                    pStr = NULL;
+                }
+                if (pStr != NULL) {
+                    if (name[0] == 0) {
+                        pTopic = pMqttSnTopicIdGet(topicId);
+                    } else {
+                        pTopic = pMqttSnTopicFind(name, topicType == 2, op == 5);
+                    }
+                }
+                if (pTopic != NULL) {
+                    pTopic->subscribed = (op == 5);
+                    outputLine("+UMQTTSNC: %d,1", op);
+                    outputLine("OK");
+                    if (op == 6) {
+                        outputLine("+UUMQTTSNC: 6,1");
+                    } else if ((topicType == 0) && (name[0] != 0)) {
+                        outputLine("+UUMQTTSNC: 5,1,%d,%d", qos,
+                                   (int) (pTopic - gMqttSnTopic) + 1);
+                    } else {
+                        outputLine("+UUMQTTSNC: 5,1,%d", qos);
+                    }
+                } else {
+                    outputLine("ERROR");
+                }
+                break;
+            case 9:
+                // Read the oldest message
+                if (gMqttSnNumMessages > 0) {
+                    pMessage = &(gMqttSnMessage[0]);
+                    if (pMessage->topicType == 2) {
+                        x = snprintf(buffer, sizeof(buffer),
+                                     "\r\n+UMQTTSNC: 9,%d,2,\"%s\",%d,\"",
+                                     pMessage->qos, pMessage->shortName,
+                                     (int) pMessage->length);
+                    } else {
+                        x = snprintf(buffer, sizeof(buffer),
+                                     "\r\n+UMQTTSNC: 9,%d,%d,%d,%d,\"",
+                                     pMessage->qos, pMessage->topicType,
+                                     pMessage->topicId, (int) pMessage->length);
+                    }
+                    output(buffer, x, 0);
+                    output(pMessage->data, pMessage->length, 0);
+                    outputString("\"\r\n");
+                    outputLine("OK");
+                    gMqttSnNumMessages--;
+                    memmove(&(gMqttSnMessage[0]), &(gMqttSnMessage[1]),
+                            gMqttSnNumMessages * sizeof(gMqttSnMessage[0]));
+                } else {
+                    outputLine("ERROR");
+                }
+                break;
+            default:
+                outputLine("ERROR");
+                break;
+        }
+    } else {
+        isMqttSnCommand = false;
+    }
+
+    return isMqttSnCommand;
+}
+
+// Register or deregister: registration brings up the first
+// PDP context, as the default bearer of LTE, deregistration
+// takes them all down.
+static void registeredSet(bool registered)
+{
+    gRegistered = registered;
+    for (size_t x = 0; x < CELLULAR_SIM_MAX_NUM_CONTEXTS; x++) {
+        gContextActive[x] = registered && (x == 0);
+    }
+}
+
+// Handle the PDP context and settings commands, returning
+// false if the command is not one of them.
+static bool builtInSettingsRun(const char *pCommand)
+{
+    unsigned long long mask1;
+    unsigned long long mask2 = 0;
+    char value[9];
+    bool handled = true;
+    int x;
+    int y = 1;
+
+    if (strncmp(pCommand, "AT+CGDCONT=", 11) == 0) {
+        x = atoi(pCommand + 11);
+        if ((x > 0) && (x <= CELLULAR_SIM_MAX_NUM_CONTEXTS)) {
+            gContextDefined[x - 1] = true;
+            outputLine("OK");
+        } else {
+            outputLine("ERROR");
+        }
+    } else if (strncmp(pCommand, "AT+CGACT=", 9) == 0) {
+        // Without a context ID the first context is meant
+        x = atoi(pCommand + 9);
+        sscanf(pCommand + 9, "%*d,%d", &y);
+        if ((y > 0) && (y <= CELLULAR_SIM_MAX_NUM_CONTEXTS) &&
+            gContextDefined[y - 1] && (gRegistered || (x == 0))) {
+            gContextActive[y - 1] = (x == 1);
+            outputLine("OK");
+        } else {
+            outputLine("ERROR");
+        }
+    } else if (strcmp(pCommand, "AT+CGACT?") == 0) {
+        for (x = 0; x < CELLULAR_SIM_MAX_NUM_CONTEXTS; x++) {
+            if (gContextDefined[x]) {
+                outputLine("+CGACT: %d,%d", x + 1, gContextActive[x] ? 1 : 0);
+            }
+        }
+        outputLine("OK");
+    } else if (strncmp(pCommand, "AT+CGPADDR=", 11) == 0) {
+        x = atoi(pCommand + 11);
+        if ((x > 0) && (x <= CELLULAR_SIM_MAX_NUM_CONTEXTS) &&
+            gContextActive[x - 1]) {
+            outputLine("+CGPADDR: %d,\"10.0.0.%d\"", x, x + 1);
+        } else {
+            outputLine("+CGPADDR: %d", x);
+        }
+        outputLine("OK");
+    } else if (strncmp(pCommand, "AT+UBANDMASK=", 13) == 0) {
+        // 0 is cat-M1 and 1 is NB1, a second mask is optional
+        if ((sscanf(pCommand + 13, "%d,%llu,%llu", &x, &mask1, &mask2) >= 2) &&
+            (x >= 0) && (x <= 1)) {
+            gBandMask[x][0] = mask1;
+            gBandMask[x][1] = mask2;
+            outputLine("OK");
+        } else {
+            outputLine("ERROR");
+        }
+    } else if (strcmp(pCommand, "AT+UBANDMASK?") == 0) {
+        outputLine("+UBANDMASK: 0,%llu,%llu,1,%llu,%llu",
+                   gBandMask[0][0], gBandMask[0][1],
+                   gBandMask[1][0], gBandMask[1][1]);
+        outputLine("OK");
+    } else if (strncmp(pCommand, "AT+UMNOPROF=", 12) == 0) {
+        gMnoProfile = atoi(pCommand + 12);
+        outputLine("OK");
+    } else if (strcmp(pCommand, "AT+UMNOPROF?") == 0) {
+        outputLine("+UMNOPROF: %d", gMnoProfile);
+        outputLine("OK");
+    } else if (strncmp(pCommand, "AT+CPSMS=", 9) == 0) {
+        // AT+CPSMS=<mode>[,,,"<periodic TAU>"[,"<active time>"]]
+        gPsmMode = atoi(pCommand + 9);
+        if (sscanf(pCommand + 9, "%*d,,,\"%8[01]\"", value) == 1) {
+            strcpy(gPsmPeriodicTau, value);
+        }
+        if (sscanf(pCommand + 9, "%*d,,,\"%*8[01]\",\"%8[01]\"", value) == 1) {
+            strcpy(gPsmActiveTime, value);
+        }
+        outputLine("OK");
+    } else if (strcmp(pCommand, "AT+CPSMS?") == 0) {
+        outputLine("+CPSMS: %d,,,\"%s\",\"%s\"", gPsmMode,
+                   gPsmPeriodicTau, gPsmActiveTime);
+        outputLine("OK");
+    } else if (strncmp(pCommand, "AT+CEDRXS=", 10) == 0) {
+        // AT+CEDRXS=<mode>,<AcT-type>[,"<value>"], modes 1 and 2
+        // being on, 0 and 3 off
+        value[0] = 0;
+        if ((sscanf(pCommand + 10, "%d,%d,\"%4[01]\"", &x, &y, value) >= 2) &&
+            (y >= 0) && (y < CELLULAR_SIM_MAX_NUM_EDRX_ACT_TYPES)) {
+            if ((x == 1) || (x == 2)) {
+                if (strlen(value) == 4) {
+                    strcpy(gEdrx[y], value);
+                }
+            } else {
+                gEdrx[y][0] = 0;
+            }
+            outputLine("OK");
+        } else {
+            outputLine("ERROR");
+        }
+    } else if (strcmp(pCommand, "AT+CEDRXS?") == 0) {
+        for (x = 0; x < CELLULAR_SIM_MAX_NUM_EDRX_ACT_TYPES; x++) {
+            if (gEdrx[x][0] != 0) {
+                outputLine("+CEDRXS: %d,\"%s\"", x, gEdrx[x]);
+            }
+        }
+        outputLine("OK");
+    } else {
+        handled = false;
+    }
+
+    return handled;
+}
+
+// Handle a built-in command; anything not recognised gets OK.
+static void builtInRun(const char *pCommand)
+{
+    CellularSimSocket_t *pSocket;
+    CellularSimSocketOption_t *pOption;
+    int level;
+    int option;
+    char buffer[CELLULAR_SIM_SOCKET_READ_MAX_BYTES +
+                CELLULAR_SIM_ADDRESS_MAX_LENGTH_BYTES + 32];
+    const char *pStr;
+    int id = -1;
+    int length = 0;
+    int x;
+
+    if ((strncmp(pCommand, "ATE0", 4) == 0) || (strncmp(pCommand, "ATE1", 4) == 0)) {
+        // Anything that follows, e.g. "&C1", is just OK'ed
+        gEcho = (pCommand[3] == '1');
+        outputLine("OK");
+    } else if (strncmp(pCommand, "AT+CFUN=", 8) == 0) {
+        // A module with its radio on registers straight away
+        x = atoi(pCommand + 8);
+        if ((x == 15) || (x == 16)) {
+            // Sockets do not survive a reset
+            for (size_t y = 0; y < CELLULAR_SIM_MAX_NUM_SOCKETS; y++) {
+                gSocket[y].inUse = false;
+            }
+        }
+        gRadioOn = (x != 0) && (x != 4);
+        registeredSet(gRadioOn);
+        outputLine("OK");
+        outputLine("+CEREG: %d", gRegistered ? 1 : 0);
+    } else if (strcmp(pCommand, "AT+CFUN?") == 0) {
+        outputLine("+CFUN: %d,0", gRadioOn ? 1 : 4);
+        outputLine("OK");
+    } else if (strncmp(pCommand, "AT+COPS=", 8) == 0) {
+        registeredSet(gRadioOn && (atoi(pCommand + 8) != 2));
+        outputLine("OK");
+        outputLine("+CEREG: %d", gRegistered ? 1 : 0);
+    } else if (strcmp(pCommand, "AT+CEREG?") == 0) {
+        outputLine("+CEREG: 1,%d", gRegistered ? 1 : 0);
+        outputLine("OK");
+    } else if (strcmp(pCommand, "AT+CGATT?") == 0) {
+        outputLine("+CGATT: %d", gRegistered ? 1 : 0);
+        outputLine("OK");
+    } else if (strncmp(pCommand, "AT+USOCR=", 9) == 0) {
+        for (x = 0; (x < CELLULAR_SIM_MAX_NUM_SOCKETS) && (id < 0); x++) {
+            if (!gSocket[x].inUse) {
+                id = x;
+            }
+        }
+        if (id >= 0) {
+            // The protocol is 6 for TCP or 17 for UDP
+            gSocket[id].inUse = true;
+            gSocket[id].udp = (atoi(pCommand + 9) == 17);
+            gSocket[id].length = 0;
+            gSocket[id].numDatagrams = 0;
+            gSocket[id].numOptions = 0;
+            outputLine("+USOCR: %d", id);
+            outputLine("OK");
+        } else {
+            outputLine("ERROR");
+        }
+    } else if (strncmp(pCommand, "AT+USOCL=", 9) == 0) {
+        x = 0;
+        sscanf(pCommand + 9, "%d,%d", &id, &x);
+        pSocket = pSocketGet(id);
+        if (pSocket != NULL) {
+            pSocket->inUse = false;
+            outputLine("OK");
+            if (x == 1) {
+                // Asynchronous close
+                outputLine("+UUSOCL: %d", id);
+            }
+        } else {
+            outputLine("ERROR");
+        }
+    } else if (strncmp(pCommand, "AT+USOCO=", 9) == 0) {
+        // A loop-back socket connects to anything; the last
+        // parameter, after the port number, is the
+        // asynchronous flag
+        pSocket = pSocketGet(atoi(pCommand + 9));
+        if (pSocket != NULL) {
+            outputLine("OK");
+            if (strrchr(pCommand, '"') != NULL) {
+                x = 0;
+                sscanf(strrchr(pCommand, '"'), "\",%d,%d", &length, &x);
+                if (x == 1) {
+                    outputLine("+UUSOCO: %d,0", atoi(pCommand + 9));
+                }
+            }
+        } else {
+            outputLine("ERROR");
+        }
+    } else if (strncmp(pCommand, "AT+USOWR=", 9) == 0) {
+        if ((sscanf(pCommand + 9, "%d,%d", &id, &length) == 2) &&
+            (pSocketGet(id) != NULL) && !pSocketGet(id)->udp &&
+            (length > 0) && (strchr(pCommand, '"') == NULL)) {
+            gpWriteSocket = pSocketGet(id);
+            gWriteSocketId = id;
+            gWriteLeft = length;
+            gWriteTotal = length;
+            outputString("\r\n@");
+        } else {
+            outputLine("ERROR");
+        }
+    } else if (strncmp(pCommand, "AT+USOST=", 9) == 0) {
+        // AT+USOST=<id>,"<address>",<port>,<length>: anything
+        // after the length would be the data in-line
+        pSocket = NULL;
+        pStr = strchr(pCommand, '"');
+        memset(&gWriteDatagram, 0, sizeof(gWriteDatagram));
+        if ((pStr != NULL) && (strchr(pStr + 1, '"') != NULL) &&
+            (strchr(pStr + 1, '"') - pStr - 1 < (int) sizeof(gWriteDatagram.address)) &&
+            (sscanf(strchr(pStr + 1, '"'), "\",%d,%d%c",
+                    &gWriteDatagram.port, &length, buffer) == 2)) {
+            memcpy(gWriteDatagram.address, pStr + 1,
+                   strchr(pStr + 1, '"') - pStr - 1);
+            pSocket = pSocketGet(atoi(pCommand + 9));
+        }
+        if ((pSocket != NULL) && pSocket->udp && (length > 0) &&
+            (length <= CELLULAR_SIM_SOCKET_READ_MAX_BYTES)) {
+            gpWriteSocket = pSocket;
+            gWriteSocketId = atoi(pCommand + 9);
+            gWriteLeft = length;
+            gWriteTotal = length;
+            outputString("\r\n@");
+        } else {
+            outputLine("ERROR");
+        }
+    } else if (strncmp(pCommand, "AT+USORD=", 9) == 0) {
+        pSocket = NULL;
+        if (sscanf(pCommand + 9, "%d,%d", &id, &length) == 2) {
+            pSocket = pSocketGet(id);
+        }
+        if ((pSocket != NULL) && (length >= 0)) {
+            if (length == 0) {
+                outputLine("+USORD: %d,%d", id, (int) pSocket->length);
+            } else {
+                if (length > (int) pSocket->length) {
+                    length = (int) pSocket->length;
+                }
+                if (length > CELLULAR_SIM_SOCKET_READ_MAX_BYTES) {
+                    length = CELLULAR_SIM_SOCKET_READ_MAX_BYTES;
+                }
+                x = snprintf(buffer, sizeof(buffer), "\r\n+USORD: %d,%d,\"",
+                             id, length);
+                memcpy(buffer + x, pSocket->buffer, length);
+                x += length;
+                memcpy(buffer + x, "\"\r\n", 3);
+                x += 3;
+                output(buffer, x, 0);
+                pSocket->length -= length;
+                memmove(pSocket->buffer, pSocket->buffer + length,
+                        pSocket->length);
+            }
+            outputLine("OK");
+        } else {
+            outputLine("ERROR");
+        }
+    } else if (strncmp(pCommand, "AT+USORF=", 9) == 0) {
+        pSocket = NULL;
+        if (sscanf(pCommand + 9, "%d,%d", &id, &length) == 2) {
+            pSocket = pSocketGet(id);
+        }
+        if ((pSocket != NULL) && pSocket->udp && (length >= 0)) {
+            if ((length == 0) || (pSocket->numDatagrams == 0)) {
+                outputLine("+USORF: %d,%d", id, (int) pSocket->length);
+            } else {
+                if (length > CELLULAR_SIM_SOCKET_READ_MAX_BYTES) {
+                    length = CELLULAR_SIM_SOCKET_READ_MAX_BYTES;
+                }
+                output(buffer, socketReadDatagram(pSocket, id, length, buffer), 0);
+            }
+            outputLine("OK");
+        } else {
+            outputLine("ERROR");
+        }
+    } else if (strncmp(pCommand, "AT+USODL=", 9) == 0) {
+        // Whatever has already arrived follows the CONNECT
+        id = atoi(pCommand + 9);
+        pSocket = pSocketGet(id);
+        if ((pSocket != NULL) && !pSocket->udp) {
+            outputLine("CONNECT");
+            output(pSocket->buffer, pSocket->length, 0);
+            pSocket->length = 0;
+            gDirectLinkSocketId = id;
+            gEscapeLength = 0;
+            gDirectLinkReceiveMs = nowMs();
+        } else {
+            outputLine("ERROR");
+        }
+    } else if (strncmp(pCommand, "AT+USOSO=", 9) == 0) {
+        // Any further parameter, e.g. the linger time, is ignored
+        pOption = NULL;
+        if (sscanf(pCommand + 9, "%d,%d,%d,%d", &id, &level, &option, &x) == 4) {
+            pSocket = pSocketGet(id);
+            if (pSocket != NULL) {
+                pOption = pSocketOptionFind(pSocket, level, option, true);
+            }
+        }
+        if (pOption != NULL) {
+            pOption->value = x;
+            outputLine("OK");
+        } else {
+            outputLine("ERROR");
+        }
+    } else if (strncmp(pCommand, "AT+USOGO=", 9) == 0) {
+        pSocket = NULL;
+        if (sscanf(pCommand + 9, "%d,%d,%d", &id, &level, &option) == 3) {
+            pSocket = pSocketGet(id);
+        }
+        if (pSocket != NULL) {
+            pOption = pSocketOptionFind(pSocket, level, option, false);
+            outputLine("+USOGO: %d", (pOption != NULL) ? pOption->value : 0);
+            outputLine("OK");
+        } else {
+            outputLine("ERROR");
+        }
+    } else {
+        outputLine("OK");
+    }
+}
+
+// Handle received bytes.
+static void receive(const char *pData, size_t length)
+{
+    size_t x;
+
+    while (length > 0) {
+        if (gDirectLinkSocketId >= 0) {
+            // Data for the far end
+            x = length;
+            directLinkReceive(pData, x);
+        } else if (gpWriteSocket != NULL) {
+            // Collecting binary data for AT+USOWR
+            x = length;
+            if (x > gWriteLeft) {
+                x = gWriteLeft;
+            }
+            socketWriteData(pData, x);
+        } else if (gpWriteFile != NULL) {
+            // Collecting binary data for AT+UDWNFILE
+            x = length;
+            if (x > gWriteFileLeft) {
+                x = gWriteFileLeft;
+            }
+            fileWriteData(pData, x);
+        } else {
+            x = 1;
+            if (*pData == '\r') {
+                gCommand[gCommandLength] = 0;
+                if (gVerbose) {
+                    printf("cellular_sim: %s\n", gCommand);
+                    fflush(stdout);
+                }
+                if (gEcho) {
+                    output(gCommand, gCommandLength, 0);
+                    outputString("\r");
+                }
+                if ((gCommandLength >= 2) &&
+                    (strncasecmp(gCommand, "AT", 2) == 0) &&
+                    !scriptRun(gCommand) &&
+                    !builtInSettingsRun(gCommand) &&
+                    !builtInFileRun(gCommand) &&
+                    !builtInMqttSnRun(gCommand)) {
+                    builtInRun(gCommand);
+                }
+                gCommandLength = 0;
+            } else if ((*pData != '\n') &&
+                       (gCommandLength < sizeof(gCommand) - 1)) {
+                gCommand[gCommandLength] = *pData;
+                gCommandLength++;
+            }
+        }
+        pData += x;
+        length -= x;
+    }
+}
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS: PSEUDO-TERMINAL
+ * -------------------------------------------------------------- */
+
+// Open the pseudo-terminal and link to it, returning the
+// file descriptor of the slave side, which is kept open so
+// that the master does not see a hang-up when the porting
+// layer closes and re-opens it.
+static int ptyOpen(const char *pLink)
+{
+    struct termios options;
+    const char *pName;
+    int slaveFd = -1;
+
+    gFd = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((gFd >= 0) && (grantpt(gFd) == 0) && (unlockpt(gFd) == 0)) {
+        fcntl(gFd, F_SETFL, fcntl(gFd, F_GETFL) | O_NONBLOCK);
+        pName = ptsname(gFd);
+        slaveFd = open(pName, O_RDWR | O_NOCTTY);
+        if (slaveFd >= 0) {
+            // Raw, so that nothing the simulator sends is
+            // echoed back to it before the porting layer
+            // has opened the device
+            tcgetattr(slaveFd, &options);
+            cfmakeraw(&options);
+            tcsetattr(slaveFd, TCSANOW, &options);
+            unlink(pLink);
+            if (symlink(pName, pLink) == 0) {
+                printf("cellular_sim: %s -> %s.\n", pLink, pName);
+            } else {
+                fprintf(stderr, "cellular_sim: unable to link %s to %s (%d).\n",
+                        pLink, pName, errno);
+                close(slaveFd);
+                slaveFd = -1;
+            }
+        }
+    }
+
+    return slaveFd;
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// Entry point.
+int main(int argc, char *argv[])
+{
+    const char *pLink = CELLULAR_SIM_LINK_DEFAULT;
+    const char *pScript = NULL;
+    const char *pCapture = NULL;
+    char buffer[CELLULAR_SIM_LINE_MAX_LENGTH_BYTES];
+    struct pollfd fds;
+    int slaveFd;
+    int timeoutMs;
+    int x;
+    ssize_t y;
+
+    for (x = 1; x < argc; x++) {
+        if (strcmp(argv[x], "-v") == 0) {
+            gVerbose = true;
+        } else if ((strcmp(argv[x], "-l") == 0) && (x + 1 < argc)) {
+            x++;
+            pLink = argv[x];
+        } else if ((strcmp(argv[x], "-r") == 0) && (x + 1 < argc)) {
+            x++;
+            pCapture = argv[x];
+        } else if (argv[x][0] != '-') {
+            pScript = argv[x];
+        } else {
+            fprintf(stderr, "usage: %s [-v] [-l link] [-r capture | script]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ((pScript != NULL) && !scriptRead(pScript)) {
+        return EXIT_FAILURE;
+    }
+    if (pCapture != NULL) {
+        if (!cellularCaptureRead(pCapture, &gpReplay, &gReplayNumChunks)) {
+            return EXIT_FAILURE;
+        }
+        printf("cellular_sim: playing back %d chunk(s) from %s.\n",
+               (int) gReplayNumChunks, pCapture);
+    }
+
+    slaveFd = ptyOpen(pLink);
+    if (slaveFd < 0) {
+        return EXIT_FAILURE;
+    }
+
+    signal(SIGINT, signalHandler);
+    signal(SIGTERM, signalHandler);
+    fflush(stdout);
+
+    if (gReplayNumChunks > 0) {
+        // Anything the module sent before the first command
+        // goes out straight away
+        replayQueueRx(gpReplay[0].timeMs);
+    }
+
+    fds.fd = gFd;
+    fds.events = POLLIN;
+    while (!gStop) {
+        // URCs and leaving direct-link mode queue output,
+        // so service them before the output is serviced
+        timeoutMs = urcService();
+        x = directLinkService();
+        if ((x >= 0) && ((timeoutMs < 0) || (x < timeoutMs))) {
+            timeoutMs = x;
+        }
+        x = outputService();
+        if ((x >= 0) && ((timeoutMs < 0) || (x < timeoutMs))) {
+            timeoutMs = x;
+        }
+        if (poll(&fds, 1, timeoutMs) > 0) {
+            y = read(gFd, buffer, sizeof(buffer));
+            if (y > 0) {
+                if (gpReplay != NULL) {
+                    replayReceive(buffer, y);
+                } else {
+                    receive(buffer, y);
+                }
+            }
+        }
+    }
+
+    unlink(pLink);
+    close(slaveFd);
+    close(gFd);
+    cellularCaptureFree(gpReplay, gReplayNumChunks);
+
+    return EXIT_SUCCESS;
+}
+
+// End of file
@@ -0,0 +1,176 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef CELLULAR_CFG_OVERRIDE
+# include "cellular_cfg_override.h" // For a customer's configuration override
+#endif
+#include "cellular_cfg_hw_platform_specific.h"
+#include "cellular_port_clib.h"
+#include "cellular_port.h"
+#include "cellular_port_debug.h"
+#include "cellular_port_os.h"
+#include "cellular_port_private.h"
+
+#include "stdio.h"
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS
+ * -------------------------------------------------------------- */
+
+/** The maximum value of the ID passed to cellularPortNvStore().
+ */
+#define CELLULAR_PORT_NV_MAX_ID 15
+
+/** The room needed for the path of a non-volatile storage file.
+ */
+#define CELLULAR_PORT_NV_PATH_MAX_LENGTH_BYTES 256
+
+/* ----------------------------------------------------------------
+ * TYPES
+ * -------------------------------------------------------------- */
+
+/* ----------------------------------------------------------------
+ * VARIABLES
+ * -------------------------------------------------------------- */
+
+// Keep track of whether we've been initialised or not.
+static bool gInitialised = false;
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// Open the non-volatile storage file for a given ID.
+static FILE *pNvOpen(int32_t id, const char *pMode)
+{
+    char path[CELLULAR_PORT_NV_PATH_MAX_LENGTH_BYTES];
+
+    snprintf(path, sizeof(path), CELLULAR_PORT_NV_PATH_FORMAT, (int) id);
+
+    return fopen(path, pMode);
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// Start the platform.  There is no scheduler to start on this
+// platform: the entry point is run as a task and, unlike the
+// embedded platforms, this returns when the entry point does.
+int32_t cellularPortPlatformStart(void (*pEntryPoint)(void *),
+                                  void *pParameter,
+                                  size_t stackSizeBytes,
+                                  int32_t priority)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+
+    if (pEntryPoint != NULL) {
+        errorCode = cellularPortPrivateTaskRun(pEntryPoint, "EntryPoint",
+                                               stackSizeBytes, pParameter,
+                                               priority);
+    }
+
+    return errorCode;
+}
+
+// Initialise the porting layer.
+int32_t cellularPortInit()
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_SUCCESS;
+
+    if (!gInitialised) {
+        errorCode = cellularPortMallocInit();
+        if (errorCode == 0) {
+            errorCode = cellularPortPrivateInit();
+        }
+        if (errorCode == 0) {
+            errorCode = cellularPortLogDeferredInit();
+        }
+        gInitialised = (errorCode == 0);
+    }
+
+    return errorCode;
+}
+
+// Deinitialise the porting layer.
+void cellularPortDeinit()
+{
+    if (gInitialised) {
+        cellularPortLogDeferredDeinit();
+        cellularPortPrivateDeinit();
+        gInitialised = false;
+    }
+}
+
+// Get the current tick converted to a time in milliseconds.
+int64_t cellularPortGetTickTimeMs()
+{
+    int64_t tickTime = 0;
+
+    if (gInitialised) {
+        tickTime = cellularPortPrivateGetTickTimeMs();
+    }
+
+    return tickTime;
+}
+
+// Store a block of data in non-volatile storage, which on
+// this platform is a file.
+int32_t cellularPortNvStore(int32_t id, const void *pData,
+                            size_t size)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    FILE *pFile;
+
+    if ((id >= 0) && (id <= CELLULAR_PORT_NV_MAX_ID) && (pData != NULL)) {
+        errorCode = CELLULAR_PORT_PLATFORM_ERROR;
+        pFile = pNvOpen(id, "wb");
+        if (pFile != NULL) {
+            if (fwrite(pData, 1, size, pFile) == size) {
+                errorCode = CELLULAR_PORT_SUCCESS;
+            }
+            if (fclose(pFile) != 0) {
+                errorCode = CELLULAR_PORT_PLATFORM_ERROR;
+            }
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Retrieve a block of data from non-volatile storage.
+int32_t cellularPortNvRetrieve(int32_t id, void *pData,
+                               size_t size)
+{
+    int32_t errorCodeOrSize = (int32_t) CELLULAR_PORT_INVALID_PARAMETER;
+    FILE *pFile;
+
+    if ((id >= 0) && (id <= CELLULAR_PORT_NV_MAX_ID) && (pData != NULL)) {
+        errorCodeOrSize = (int32_t) CELLULAR_PORT_PLATFORM_ERROR;
+        pFile = pNvOpen(id, "rb");
+        if (pFile != NULL) {
+            errorCodeOrSize = (int32_t) fread(pData, 1, size, pFile);
+            if (ferror(pFile)) {
+                errorCodeOrSize = (int32_t) CELLULAR_PORT_PLATFORM_ERROR;
+            }
+            fclose(pFile);
+        }
+    }
+
+    return errorCodeOrSize;
+}
+
+// End of file
@@ -0,0 +1,164 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef CELLULAR_CFG_OVERRIDE
+# include "cellular_cfg_override.h" // For a customer's configuration override
+#endif
+#include "cellular_port_clib.h"
+#include "cellular_port.h"
+#include "cellular_port_os.h"
+#include "cellular_port_gpio.h"
+#include "cellular_port_private.h"
+
+/* There is no GPIO on this platform: these functions work on an
+ * array of virtual pins so that code which drives pins, e.g. the
+ * power control code of cellular_ctrl, can run against the modem
+ * simulator.  A pin reads back what was last written to it; until
+ * anything is written it reads as its pull mode would leave it.
+ * Writing a level that makes an edge which a pin has an interrupt
+ * on sends the pin to the interrupt queue, just as a real edge
+ * would.
+ */
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS
+ * -------------------------------------------------------------- */
+
+#ifndef CELLULAR_PORT_GPIO_MAX_NUM
+/** The number of virtual pins.
+ */
+# define CELLULAR_PORT_GPIO_MAX_NUM 64
+#endif
+
+/* ----------------------------------------------------------------
+ * TYPES
+ * -------------------------------------------------------------- */
+
+/* ----------------------------------------------------------------
+ * VARIABLES
+ * -------------------------------------------------------------- */
+
+// The level of each virtual pin.
+static int32_t gLevel[CELLULAR_PORT_GPIO_MAX_NUM] = {0};
+
+// The interrupt set on each virtual pin.
+static CellularPortGpioInterrupt_t gInterrupt[CELLULAR_PORT_GPIO_MAX_NUM] = {0};
+
+// The queue that each virtual pin sends interrupts to.
+static CellularPortQueueHandle_t gInterruptQueue[CELLULAR_PORT_GPIO_MAX_NUM] = {0};
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// Change the level of a pin, "interrupting" if that is an
+// edge that an interrupt is set for.
+static void levelSet(int32_t pin, int32_t level)
+{
+    CellularPortGpioInterrupt_t interrupt = gInterrupt[pin];
+    bool interrupted;
+    int32_t sentPin = pin;
+
+    interrupted = (level != gLevel[pin]) &&
+                  ((interrupt == CELLULAR_PORT_GPIO_INTERRUPT_BOTH_EDGES) ||
+                   ((interrupt == CELLULAR_PORT_GPIO_INTERRUPT_RISING_EDGE) && (level != 0)) ||
+                   ((interrupt == CELLULAR_PORT_GPIO_INTERRUPT_FALLING_EDGE) && (level == 0)));
+    gLevel[pin] = level;
+    if (interrupted) {
+        // As for a real interrupt, don't wait for room
+        cellularPortPrivateQueueSendNoWait(gInterruptQueue[pin], &sentPin);
+    }
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// Configure a GPIO.
+int32_t cellularPortGpioConfig(CellularPortGpioConfig_t *pConfig)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+
+    if ((pConfig != NULL) && (pConfig->pin >= 0) &&
+        (pConfig->pin < CELLULAR_PORT_GPIO_MAX_NUM) &&
+        (pConfig->direction < MAX_NUM_CELLULAR_PORT_GPIO_DIRECTIONS) &&
+        (pConfig->pullMode < MAX_NUM_CELLULAR_PORT_GPIO_PULL_MODES) &&
+        (pConfig->driveMode < MAX_NUM_CELLULAR_PORT_GPIO_DRIVE_MODES) &&
+        (pConfig->driveCapability < MAX_NUM_CELLULAR_PORT_GPIO_DRIVE_CAPABILITIES)) {
+        if (pConfig->direction == CELLULAR_PORT_GPIO_DIRECTION_INPUT) {
+            switch (pConfig->pullMode) {
+                case CELLULAR_PORT_GPIO_PULL_MODE_PULL_UP:
+                    levelSet(pConfig->pin, 1);
+                break;
+                case CELLULAR_PORT_GPIO_PULL_MODE_PULL_DOWN:
+                    levelSet(pConfig->pin, 0);
+                break;
+                default:
+                break;
+            }
+        }
+        errorCode = CELLULAR_PORT_SUCCESS;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Set the state of a GPIO.
+int32_t cellularPortGpioSet(int32_t pin, int32_t level)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+
+    if ((pin >= 0) && (pin < CELLULAR_PORT_GPIO_MAX_NUM)) {
+        levelSet(pin, (level != 0));
+        errorCode = CELLULAR_PORT_SUCCESS;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Get the state of a GPIO.
+int32_t cellularPortGpioGet(int32_t pin)
+{
+    int32_t levelOrErrorCode = (int32_t) CELLULAR_PORT_INVALID_PARAMETER;
+
+    if ((pin >= 0) && (pin < CELLULAR_PORT_GPIO_MAX_NUM)) {
+        levelOrErrorCode = gLevel[pin];
+    }
+
+    return levelOrErrorCode;
+}
+
+// Set or remove an interrupt on a GPIO.
+int32_t cellularPortGpioInterruptSet(int32_t pin,
+                                     CellularPortGpioInterrupt_t interrupt,
+                                     CellularPortQueueHandle_t queueHandle)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+
+    if ((pin >= 0) && (pin < CELLULAR_PORT_GPIO_MAX_NUM) &&
+        (interrupt < MAX_NUM_CELLULAR_PORT_GPIO_INTERRUPTS) &&
+        ((queueHandle != NULL) ||
+         (interrupt == CELLULAR_PORT_GPIO_INTERRUPT_NONE))) {
+        gInterrupt[pin] = CELLULAR_PORT_GPIO_INTERRUPT_NONE;
+        gInterruptQueue[pin] = queueHandle;
+        gInterrupt[pin] = interrupt;
+        errorCode = CELLULAR_PORT_SUCCESS;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// End of file
@@ -0,0 +1,656 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// For pthread_getattr_np(), must come before any system header
+#define _GNU_SOURCE
+
+#ifdef CELLULAR_CFG_OVERRIDE
+# include "cellular_cfg_override.h" // For a customer's configuration override
+#endif
+#include "cellular_cfg_sw.h"
+#include "cellular_cfg_os_platform_specific.h"
+#include "cellular_port_clib.h"
+#include "cellular_port.h"
+#include "cellular_port_os.h"
+#include "cellular_port_private.h"
+
+#include "pthread.h"
+#include "time.h"
+#include "errno.h"
+
+/* Tasks are pthreads, detached so that they tidy themselves up
+ * when they exit.  Queues and mutexes are built from a pthread
+ * mutex and condition variables, timed waits being made against
+ * CLOCK_MONOTONIC so that a change to the wall-clock time of the
+ * host does not disturb them.  A mutex is built in the same way,
+ * rather than being a pthread mutex, since, as with a FreeRTOS
+ * mutex, a timed lock is needed and that must be against
+ * CLOCK_MONOTONIC.
+ */
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS
+ * -------------------------------------------------------------- */
+
+/** The byte that the stack of a task is filled with so that
+ * the amount used can be measured.
+ */
+#define CELLULAR_PORT_TASK_STACK_PAINT_BYTE 0xA5
+
+/** The amount of stack below the current stack pointer to leave
+ * alone when painting: room for the call to memset().
+ */
+#define CELLULAR_PORT_TASK_STACK_PAINT_MARGIN_BYTES 1024
+
+/* ----------------------------------------------------------------
+ * TYPES
+ * -------------------------------------------------------------- */
+
+/** A task.
+ */
+typedef struct {
+    void (*pFunction)(void *);
+    void *pParameter;
+    uint8_t *pStackBottom; //!< NULL if the stack has not been painted.
+    size_t stackSizeBytes; //!< the actual size of the stack.
+    size_t stackStartBytes; //!< the stack already in use, by the
+                            // host, when the task started.
+    size_t stackSizeBytesRequested;
+} CellularPortTask_t;
+
+/** A queue.
+ */
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+    uint8_t *pStorage;
+    size_t itemSizeBytes;
+    size_t queueLength;
+    size_t readIndex;
+    size_t numItems;
+} CellularPortQueue_t;
+
+/** A mutex.
+ */
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t unlocked;
+    bool locked;
+} CellularPortMutex_t;
+
+/* ----------------------------------------------------------------
+ * VARIABLES
+ * -------------------------------------------------------------- */
+
+// The task that is running, NULL if the current thread was
+// not created through this API (e.g. main()).
+static __thread CellularPortTask_t *gpThisTask = NULL;
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS: MISC
+ * -------------------------------------------------------------- */
+
+// Work out the absolute CLOCK_MONOTONIC time that is a given
+// number of milliseconds from now.
+static void timeoutSet(struct timespec *pTimeout, int32_t waitMs)
+{
+    if (waitMs < 0) {
+        waitMs = 0;
+    }
+    clock_gettime(CLOCK_MONOTONIC, pTimeout);
+    pTimeout->tv_sec += waitMs / 1000;
+    pTimeout->tv_nsec += (waitMs % 1000) * 1000000L;
+    if (pTimeout->tv_nsec >= 1000000000L) {
+        pTimeout->tv_sec++;
+        pTimeout->tv_nsec -= 1000000000L;
+    }
+}
+
+// Initialise a condition variable to use CLOCK_MONOTONIC.
+static int condInit(pthread_cond_t *pCond)
+{
+    pthread_condattr_t attr;
+    int error;
+
+    error = pthread_condattr_init(&attr);
+    if (error == 0) {
+        error = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        if (error == 0) {
+            error = pthread_cond_init(pCond, &attr);
+        }
+        pthread_condattr_destroy(&attr);
+    }
+
+    return error;
+}
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS: TASKS
+ * -------------------------------------------------------------- */
+
+#if CELLULAR_PORT_TASK_STACK_PAINT
+// Fill the unused part of the stack of the current task with
+// a known value.  The stack grows downwards on all the hosts
+// this is likely to run on.
+static void taskStackPaint(CellularPortTask_t *pTask)
+{
+    pthread_attr_t attr;
+    void *pStackBottom;
+    size_t stackSizeBytes;
+    uint8_t here;
+
+    if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+        if ((pthread_attr_getstack(&attr, &pStackBottom,
+                                   &stackSizeBytes) == 0) &&
+            (&here - CELLULAR_PORT_TASK_STACK_PAINT_MARGIN_BYTES >
+             (uint8_t *) pStackBottom)) {
+            pCellularPort_memset(pStackBottom,
+                                 CELLULAR_PORT_TASK_STACK_PAINT_BYTE,
+                                 &here - CELLULAR_PORT_TASK_STACK_PAINT_MARGIN_BYTES -
+                                 (uint8_t *) pStackBottom);
+            pTask->stackSizeBytes = stackSizeBytes;
+            pTask->stackStartBytes = (uint8_t *) pStackBottom + stackSizeBytes -
+                                     (&here - CELLULAR_PORT_TASK_STACK_PAINT_MARGIN_BYTES);
+            pTask->pStackBottom = (uint8_t *) pStackBottom;
+        }
+        pthread_attr_destroy(&attr);
+    }
+}
+#endif
+
+// Tidy up after a task, called when its thread exits.
+static void taskCleanUp(void *pParam)
+{
+    gpThisTask = NULL;
+    cellularPort_free(pParam);
+}
+
+// The start routine of all tasks.
+static void *pTaskEntry(void *pParam)
+{
+    CellularPortTask_t *pTask = (CellularPortTask_t *) pParam;
+
+    gpThisTask = pTask;
+#if CELLULAR_PORT_TASK_STACK_PAINT
+    taskStackPaint(pTask);
+#endif
+    pthread_cleanup_push(taskCleanUp, pTask);
+    pTask->pFunction(pTask->pParameter);
+    pthread_cleanup_pop(1);
+
+    return NULL;
+}
+
+// Create a task, detached or not.
+static CellularPortErrorCode_t taskCreate(void (*pFunction)(void *),
+                                          size_t stackSizeBytes,
+                                          void *pParameter,
+                                          bool detached,
+                                          pthread_t *pThread,
+                                          CellularPortTask_t **ppTask)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_OUT_OF_MEMORY;
+    CellularPortTask_t *pTask;
+    pthread_attr_t attr;
+
+    pTask = (CellularPortTask_t *) pCellularPort_mallocTag(sizeof(*pTask),
+                                                           CELLULAR_PORT_MALLOC_TAG_PORT);
+    if (pTask != NULL) {
+        pCellularPort_memset(pTask, 0, sizeof(*pTask));
+        pTask->pFunction = pFunction;
+        pTask->pParameter = pParameter;
+        pTask->stackSizeBytesRequested = stackSizeBytes;
+        errorCode = CELLULAR_PORT_PLATFORM_ERROR;
+        if (pthread_attr_init(&attr) == 0) {
+            stackSizeBytes += CELLULAR_PORT_TASK_STACK_EXTRA_BYTES;
+            if (stackSizeBytes < PTHREAD_STACK_MIN) {
+                stackSizeBytes = PTHREAD_STACK_MIN;
+            }
+            if ((pthread_attr_setstacksize(&attr, stackSizeBytes) == 0) &&
+                (pthread_attr_setdetachstate(&attr,
+                                             detached ? PTHREAD_CREATE_DETACHED :
+                                                        PTHREAD_CREATE_JOINABLE) == 0)) {
+                // Set the handle before the task starts in case
+                // it runs and exits before pthread_create() returns
+                *ppTask = pTask;
+                if (pthread_create(pThread, &attr, pTaskEntry, pTask) == 0) {
+                    errorCode = CELLULAR_PORT_SUCCESS;
+                }
+            }
+            pthread_attr_destroy(&attr);
+        }
+        if (errorCode != 0) {
+            *ppTask = NULL;
+            cellularPort_free(pTask);
+        }
+    }
+
+    return errorCode;
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS: PRIVATE TO THIS PORT
+ * -------------------------------------------------------------- */
+
+// Run a function as a task and wait for it to return.
+int32_t cellularPortPrivateTaskRun(void (*pFunction)(void *),
+                                   const char *pName,
+                                   size_t stackSizeBytes,
+                                   void *pParameter,
+                                   int32_t priority)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortTask_t *pTask;
+    pthread_t thread;
+
+    (void) pName;
+    (void) priority;
+
+    if (pFunction != NULL) {
+        errorCode = taskCreate(pFunction, stackSizeBytes, pParameter,
+                               false, &thread, &pTask);
+        if (errorCode == 0) {
+            if (pthread_join(thread, NULL) != 0) {
+                errorCode = CELLULAR_PORT_PLATFORM_ERROR;
+            }
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS: TASKS
+ * -------------------------------------------------------------- */
+
+// Create a task.  Priority is ignored on this platform.
+int32_t cellularPortTaskCreate(void (*pFunction)(void *),
+                               const char *pName,
+                               size_t stackSizeBytes,
+                               void *pParameter,
+                               int32_t priority,
+                               CellularPortTaskHandle_t *pTaskHandle)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    pthread_t thread;
+
+    (void) pName;
+    (void) priority;
+
+    if ((pFunction != NULL) && (pTaskHandle != NULL)) {
+        errorCode = taskCreate(pFunction, stackSizeBytes, pParameter,
+                               true, &thread,
+                               (CellularPortTask_t **) pTaskHandle);
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Delete the given task; as in FreeRTOS, a task can only
+// delete itself.
+int32_t cellularPortTaskDelete(const CellularPortTaskHandle_t taskHandle)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+
+    if ((taskHandle == NULL) && (gpThisTask != NULL)) {
+        // This runs taskCleanUp() and doesn't return
+        pthread_exit(NULL);
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Check if the current task handle is equal to the given task handle.
+bool cellularPortTaskIsThis(const CellularPortTaskHandle_t taskHandle)
+{
+    return (gpThisTask != NULL) &&
+           (gpThisTask == (CellularPortTask_t *) taskHandle);
+}
+
+// Get the minimum free stack for a task, as if its stack were
+// the size that was asked for when it was created.
+int32_t cellularPortTaskStackMinFree(const CellularPortTaskHandle_t taskHandle)
+{
+    int32_t sizeOrErrorCode = (int32_t) CELLULAR_PORT_NOT_IMPLEMENTED;
+#if CELLULAR_PORT_TASK_STACK_PAINT
+    CellularPortTask_t *pTask = (CellularPortTask_t *) taskHandle;
+    size_t x = 0;
+
+    if (pTask == NULL) {
+        pTask = gpThisTask;
+    }
+    sizeOrErrorCode = (int32_t) CELLULAR_PORT_INVALID_PARAMETER;
+    if ((pTask != NULL) && (pTask->pStackBottom != NULL)) {
+        while ((x < pTask->stackSizeBytes) &&
+               (*(pTask->pStackBottom + x) == CELLULAR_PORT_TASK_STACK_PAINT_BYTE)) {
+            x++;
+        }
+        // Work out how much the task has used beyond what the
+        // host had used when it started and take that off the
+        // size that was asked for
+        x = pTask->stackSizeBytes - x;
+        if (x > pTask->stackStartBytes) {
+            x -= pTask->stackStartBytes;
+        } else {
+            x = 0;
+        }
+        sizeOrErrorCode = 0;
+        if (x < pTask->stackSizeBytesRequested) {
+            sizeOrErrorCode = (int32_t) (pTask->stackSizeBytesRequested - x);
+        }
+    }
+#else
+    (void) taskHandle;
+#endif
+
+    return sizeOrErrorCode;
+}
+
+// Block the current task for a time.
+void cellularPortTaskBlock(int32_t delayMs)
+{
+    struct timespec remaining;
+
+    if (delayMs > 0) {
+        remaining.tv_sec = delayMs / 1000;
+        remaining.tv_nsec = (delayMs % 1000) * 1000000L;
+        while ((nanosleep(&remaining, &remaining) != 0) &&
+               (errno == EINTR)) {}
+    }
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS: QUEUES
+ * -------------------------------------------------------------- */
+
+// Create a queue.
+int32_t cellularPortQueueCreate(size_t queueLength,
+                                size_t itemSizeBytes,
+                                CellularPortQueueHandle_t *pQueueHandle)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortQueue_t *pQueue;
+
+    if ((pQueueHandle != NULL) && (queueLength > 0) && (itemSizeBytes > 0)) {
+        errorCode = CELLULAR_PORT_OUT_OF_MEMORY;
+        pQueue = (CellularPortQueue_t *) pCellularPort_mallocTag(sizeof(*pQueue) +
+                                                                 (queueLength * itemSizeBytes),
+                                                                 CELLULAR_PORT_MALLOC_TAG_PORT);
+        if (pQueue != NULL) {
+            errorCode = CELLULAR_PORT_PLATFORM_ERROR;
+            pQueue->pStorage = (uint8_t *) (pQueue + 1);
+            pQueue->itemSizeBytes = itemSizeBytes;
+            pQueue->queueLength = queueLength;
+            pQueue->readIndex = 0;
+            pQueue->numItems = 0;
+            if (pthread_mutex_init(&(pQueue->mutex), NULL) == 0) {
+                if (condInit(&(pQueue->notEmpty)) == 0) {
+                    if (condInit(&(pQueue->notFull)) == 0) {
+                        *pQueueHandle = (CellularPortQueueHandle_t) pQueue;
+                        errorCode = CELLULAR_PORT_SUCCESS;
+                    } else {
+                        pthread_cond_destroy(&(pQueue->notEmpty));
+                        pthread_mutex_destroy(&(pQueue->mutex));
+                    }
+                } else {
+                    pthread_mutex_destroy(&(pQueue->mutex));
+                }
+            }
+            if (errorCode != 0) {
+                cellularPort_free(pQueue);
+            }
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Delete the given queue.
+int32_t cellularPortQueueDelete(const CellularPortQueueHandle_t queueHandle)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortQueue_t *pQueue = (CellularPortQueue_t *) queueHandle;
+
+    if (pQueue != NULL) {
+        pthread_cond_destroy(&(pQueue->notFull));
+        pthread_cond_destroy(&(pQueue->notEmpty));
+        pthread_mutex_destroy(&(pQueue->mutex));
+        cellularPort_free(pQueue);
+        errorCode = CELLULAR_PORT_SUCCESS;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Send to the given queue, blocking if it is full.
+int32_t cellularPortQueueSend(const CellularPortQueueHandle_t queueHandle,
+                              const void *pEventData)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortQueue_t *pQueue = (CellularPortQueue_t *) queueHandle;
+    size_t writeIndex;
+
+    if ((pQueue != NULL) && (pEventData != NULL)) {
+        pthread_mutex_lock(&(pQueue->mutex));
+        while (pQueue->numItems >= pQueue->queueLength) {
+            pthread_cond_wait(&(pQueue->notFull), &(pQueue->mutex));
+        }
+        writeIndex = (pQueue->readIndex + pQueue->numItems) % pQueue->queueLength;
+        pCellularPort_memcpy(pQueue->pStorage + (writeIndex * pQueue->itemSizeBytes),
+                             pEventData, pQueue->itemSizeBytes);
+        pQueue->numItems++;
+        pthread_cond_signal(&(pQueue->notEmpty));
+        pthread_mutex_unlock(&(pQueue->mutex));
+        errorCode = CELLULAR_PORT_SUCCESS;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Send to the given queue without blocking, the equivalent of
+// sending from an interrupt on the embedded platforms.
+int32_t cellularPortPrivateQueueSendNoWait(const CellularPortQueueHandle_t queueHandle,
+                                           const void *pEventData)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortQueue_t *pQueue = (CellularPortQueue_t *) queueHandle;
+    size_t writeIndex;
+
+    if ((pQueue != NULL) && (pEventData != NULL)) {
+        errorCode = CELLULAR_PORT_TIMEOUT;
+        pthread_mutex_lock(&(pQueue->mutex));
+        if (pQueue->numItems < pQueue->queueLength) {
+            writeIndex = (pQueue->readIndex + pQueue->numItems) % pQueue->queueLength;
+            pCellularPort_memcpy(pQueue->pStorage + (writeIndex * pQueue->itemSizeBytes),
+                                 pEventData, pQueue->itemSizeBytes);
+            pQueue->numItems++;
+            pthread_cond_signal(&(pQueue->notEmpty));
+            errorCode = CELLULAR_PORT_SUCCESS;
+        }
+        pthread_mutex_unlock(&(pQueue->mutex));
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Receive from the given queue, blocking.
+int32_t cellularPortQueueReceive(const CellularPortQueueHandle_t queueHandle,
+                                 void *pEventData)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortQueue_t *pQueue = (CellularPortQueue_t *) queueHandle;
+
+    if ((pQueue != NULL) && (pEventData != NULL)) {
+        pthread_mutex_lock(&(pQueue->mutex));
+        while (pQueue->numItems == 0) {
+            pthread_cond_wait(&(pQueue->notEmpty), &(pQueue->mutex));
+        }
+        pCellularPort_memcpy(pEventData,
+                             pQueue->pStorage + (pQueue->readIndex * pQueue->itemSizeBytes),
+                             pQueue->itemSizeBytes);
+        pQueue->readIndex = (pQueue->readIndex + 1) % pQueue->queueLength;
+        pQueue->numItems--;
+        pthread_cond_signal(&(pQueue->notFull));
+        pthread_mutex_unlock(&(pQueue->mutex));
+        errorCode = CELLULAR_PORT_SUCCESS;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Receive from the given queue, with a wait time.
+int32_t cellularPortQueueTryReceive(const CellularPortQueueHandle_t queueHandle,
+                                    int32_t waitMs, void *pEventData)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortQueue_t *pQueue = (CellularPortQueue_t *) queueHandle;
+    struct timespec timeout;
+
+    if ((pQueue != NULL) && (pEventData != NULL)) {
+        errorCode = CELLULAR_PORT_TIMEOUT;
+        timeoutSet(&timeout, waitMs);
+        pthread_mutex_lock(&(pQueue->mutex));
+        while ((pQueue->numItems == 0) &&
+               (pthread_cond_timedwait(&(pQueue->notEmpty), &(pQueue->mutex),
+                                       &timeout) == 0)) {}
+        if (pQueue->numItems > 0) {
+            pCellularPort_memcpy(pEventData,
+                                 pQueue->pStorage + (pQueue->readIndex * pQueue->itemSizeBytes),
+                                 pQueue->itemSizeBytes);
+            pQueue->readIndex = (pQueue->readIndex + 1) % pQueue->queueLength;
+            pQueue->numItems--;
+            pthread_cond_signal(&(pQueue->notFull));
+            errorCode = CELLULAR_PORT_SUCCESS;
+        }
+        pthread_mutex_unlock(&(pQueue->mutex));
+    }
+
+    return (int32_t) errorCode;
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS: MUTEXES
+ * -------------------------------------------------------------- */
+
+// Create a mutex.
+int32_t cellularPortMutexCreate(CellularPortMutexHandle_t *pMutexHandle)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortMutex_t *pMutex;
+
+    if (pMutexHandle != NULL) {
+        errorCode = CELLULAR_PORT_OUT_OF_MEMORY;
+        pMutex = (CellularPortMutex_t *) pCellularPort_mallocTag(sizeof(*pMutex),
+                                                                 CELLULAR_PORT_MALLOC_TAG_PORT);
+        if (pMutex != NULL) {
+            errorCode = CELLULAR_PORT_PLATFORM_ERROR;
+            pMutex->locked = false;
+            if (pthread_mutex_init(&(pMutex->mutex), NULL) == 0) {
+                if (condInit(&(pMutex->unlocked)) == 0) {
+                    *pMutexHandle = (CellularPortMutexHandle_t) pMutex;
+                    errorCode = CELLULAR_PORT_SUCCESS;
+                } else {
+                    pthread_mutex_destroy(&(pMutex->mutex));
+                }
+            }
+            if (errorCode != 0) {
+                cellularPort_free(pMutex);
+            }
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Destroy a mutex.
+int32_t cellularPortMutexDelete(const CellularPortMutexHandle_t mutexHandle)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortMutex_t *pMutex = (CellularPortMutex_t *) mutexHandle;
+
+    if (pMutex != NULL) {
+        pthread_cond_destroy(&(pMutex->unlocked));
+        pthread_mutex_destroy(&(pMutex->mutex));
+        cellularPort_free(pMutex);
+        errorCode = CELLULAR_PORT_SUCCESS;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Lock the given mutex.
+int32_t cellularPortMutexLock(const CellularPortMutexHandle_t mutexHandle)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortMutex_t *pMutex = (CellularPortMutex_t *) mutexHandle;
+
+    if (pMutex != NULL) {
+        pthread_mutex_lock(&(pMutex->mutex));
+        while (pMutex->locked) {
+            pthread_cond_wait(&(pMutex->unlocked), &(pMutex->mutex));
+        }
+        pMutex->locked = true;
+        pthread_mutex_unlock(&(pMutex->mutex));
+        errorCode = CELLULAR_PORT_SUCCESS;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Try to lock the given mutex.
+int32_t cellularPortMutexTryLock(const CellularPortMutexHandle_t mutexHandle,
+                                 int32_t delayMs)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortMutex_t *pMutex = (CellularPortMutex_t *) mutexHandle;
+    struct timespec timeout;
+
+    if (pMutex != NULL) {
+        errorCode = CELLULAR_PORT_TIMEOUT;
+        timeoutSet(&timeout, delayMs);
+        pthread_mutex_lock(&(pMutex->mutex));
+        while (pMutex->locked &&
+               (pthread_cond_timedwait(&(pMutex->unlocked), &(pMutex->mutex),
+                                       &timeout) == 0)) {}
+        if (!pMutex->locked) {
+            pMutex->locked = true;
+            errorCode = CELLULAR_PORT_SUCCESS;
+        }
+        pthread_mutex_unlock(&(pMutex->mutex));
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Unlock the given mutex.
+int32_t cellularPortMutexUnlock(const CellularPortMutexHandle_t mutexHandle)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortMutex_t *pMutex = (CellularPortMutex_t *) mutexHandle;
+
+    if (pMutex != NULL) {
+        pthread_mutex_lock(&(pMutex->mutex));
+        pMutex->locked = false;
+        pthread_cond_signal(&(pMutex->unlocked));
+        pthread_mutex_unlock(&(pMutex->mutex));
+        errorCode = CELLULAR_PORT_SUCCESS;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// End of file
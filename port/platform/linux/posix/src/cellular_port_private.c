@@ -0,0 +1,84 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef CELLULAR_CFG_OVERRIDE
+# include "cellular_cfg_override.h" // For a customer's configuration override
+#endif
+#include "cellular_port_clib.h"
+#include "cellular_port.h"
+#include "cellular_port_os.h"
+#include "cellular_port_private.h"
+
+#include "time.h"
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS
+ * -------------------------------------------------------------- */
+
+/* ----------------------------------------------------------------
+ * TYPES
+ * -------------------------------------------------------------- */
+
+/* ----------------------------------------------------------------
+ * VARIABLES
+ * -------------------------------------------------------------- */
+
+// The monotonic time, in milliseconds, at which the tick started;
+// set once only so that time never goes backwards across a
+// deinitialisation and re-initialisation.
+static int64_t gTickStartMs = -1;
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// Get the monotonic time of the host in milliseconds.
+static int64_t monotonicTimeMs()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (((int64_t) now.tv_sec) * 1000) + (now.tv_nsec / 1000000);
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// Initialise the private stuff.
+int32_t cellularPortPrivateInit()
+{
+    if (gTickStartMs < 0) {
+        gTickStartMs = monotonicTimeMs();
+    }
+
+    return (int32_t) CELLULAR_PORT_SUCCESS;
+}
+
+// Deinitialise the private stuff.
+void cellularPortPrivateDeinit()
+{
+    // Nothing to do
+}
+
+// Get the current tick converted to a time in milliseconds.
+int64_t cellularPortPrivateGetTickTimeMs()
+{
+    return monotonicTimeMs() - gTickStartMs;
+}
+
+// End of file
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _CELLULAR_PORT_PRIVATE_H_
+#define _CELLULAR_PORT_PRIVATE_H_
+
+/** Stuff private to the POSIX porting layer.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS
+ * -------------------------------------------------------------- */
+
+/* ----------------------------------------------------------------
+ * TYPES
+ * -------------------------------------------------------------- */
+
+/* ----------------------------------------------------------------
+ * FUNCTIONS
+ * -------------------------------------------------------------- */
+
+/** Initialise the private stuff.
+ *
+ * @return zero on success else negative error code.
+ */
+int32_t cellularPortPrivateInit();
+
+/** Deinitialise the private stuff.
+ */
+void cellularPortPrivateDeinit();
+
+/** Get the monotonic time of the host in milliseconds since
+ * cellularPortPrivateInit() was first called.
+ */
+int64_t cellularPortPrivateGetTickTimeMs();
+
+/** Run a function as a task, in the same way as
+ * cellularPortTaskCreate(), and wait for it to return.
+ *
+ * @param pFunction      the function to run.
+ * @param pName          a name for the task.
+ * @param stackSizeBytes the stack size of the task.
+ * @param pParameter     the parameter to pass to pFunction.
+ * @param priority       the priority of the task, ignored on
+ *                       this platform.
+ * @return               zero once pFunction has returned, else
+ *                       negative error code.
+ */
+int32_t cellularPortPrivateTaskRun(void (*pFunction)(void *),
+                                   const char *pName,
+                                   size_t stackSizeBytes,
+                                   void *pParameter,
+                                   int32_t priority);
+
+/** Send to a queue without blocking: if the queue is full the
+ * event is dropped.  This is what the receive thread of the
+ * UART uses, in place of the send-from-interrupt of the
+ * embedded platforms, so that it can never be held up by a
+ * reader that is busy.
+ *
+ * @param queueHandle the handle of the queue.
+ * @param pEventData  pointer to the data to send.
+ * @return            zero on success, CELLULAR_PORT_TIMEOUT
+ *                    if the queue was full, else negative
+ *                    error code.
+ */
+int32_t cellularPortPrivateQueueSendNoWait(const CellularPortQueueHandle_t queueHandle,
+                                           const void *pEventData);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _CELLULAR_PORT_PRIVATE_H_
+
+// End of file
@@ -0,0 +1,796 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// For cfmakeraw(), cfsetspeed() and CRTSCTS, must come before
+// any system header
+#define _DEFAULT_SOURCE
+
+// The log level threshold of this module, see cellular_port_debug.h.
+#define CELLULAR_PORT_LOG_THRESHOLD CELLULAR_CFG_LOG_LEVEL_PORT
+
+#ifdef CELLULAR_CFG_OVERRIDE
+# include "cellular_cfg_override.h" // For a customer's configuration override
+#endif
+#include "cellular_cfg_sw.h"
+#include "cellular_cfg_hw_platform_specific.h"
+#include "cellular_port_debug.h"
+#include "cellular_port_clib.h"
+#include "cellular_port.h"
+#include "cellular_port_os.h"
+#include "cellular_port_uart.h"
+#include "cellular_port_private.h"
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "errno.h"
+#include "fcntl.h"
+#include "poll.h"
+#include "pthread.h"
+#include "termios.h"
+#include "unistd.h"
+
+/* A UART is a serial device of the host: a real one, e.g. a USB
+ * to serial adapter wired to a module, or the pseudo-terminal
+ * of the modem simulator.  A receive thread per UART does the job
+ * of the DMA and interrupt handlers of the embedded platforms:
+ * it reads from the device into a single-producer/single-consumer
+ * ring and sends an event to the UART event queue, in exactly
+ * the same way as the STM32F4 code, so that the AT client
+ * sees the same behaviour.  Where the ring is full the receive
+ * thread stops reading, leaving the data in the driver of the
+ * host, which is the equivalent of flow control; nothing is
+ * ever lost, which keeps runs against the simulator
+ * repeatable.
+ */
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS
+ * -------------------------------------------------------------- */
+
+// The maximum number of UARTs.
+#define CELLULAR_PORT_MAX_NUM_UARTS 8
+
+// The room needed for the path of a UART device.
+#define CELLULAR_PORT_UART_DEVICE_PATH_MAX_LENGTH_BYTES 256
+
+// How long the receive thread waits before trying again when
+// the receive ring is full or the device has gone away (e.g.
+// the simulator has been restarted).
+#define CELLULAR_PORT_UART_RX_RETRY_MS 1
+
+/* ----------------------------------------------------------------
+ * TYPES
+ * -------------------------------------------------------------- */
+
+/** A UART event.  Since we only ever need to signal
+ * size or error then on this platform the
+ * CellularPortUartEventData_t can simply be an int32_t.
+ */
+typedef int32_t CellularPortUartEventData_t;
+
+/** Structure of the data per UART.  The receive buffer is
+ * a single-producer/single-consumer ring: rxWrite is only
+ * ever written by the receive thread and rxRead is only
+ * ever written by the (single) reader, hence no mutex is
+ * required on the receive path.  One byte of the ring is
+ * always left empty so that a full ring can be told apart
+ * from an empty one.
+ */
+typedef struct CellularPortUartData_t {
+    int32_t number;
+    int fd;
+    int wakeFd[2]; //!< a pipe, written to stop the receive thread.
+    bool flowControl;
+    pthread_t rxThread;
+    CellularPortMutexHandle_t mutex; //!< protects transmit only.
+    CellularPortQueueHandle_t queue;
+    size_t rxBufferSize;
+    char *pRxBufferStart;
+    size_t rxRead;
+    size_t rxWrite;
+    bool userNeedsNotify; //!< set by the reader when the
+                          // ring has been emptied and
+                          // hence the user would like a
+                          // notification when new data
+                          // arrives; cleared by whoever
+                          // sends that notification, so
+                          // that there is at most one
+                          // event outstanding.
+    CellularPortUartStats_t stats;
+    struct CellularPortUartData_t *pNext;
+} CellularPortUartData_t;
+
+/* ----------------------------------------------------------------
+ * VARIABLES
+ * -------------------------------------------------------------- */
+
+// Root of the UART linked list.
+static CellularPortUartData_t *gpUartDataHead = NULL;
+
+// The receive buffer size for each UART, zero meaning
+// CELLULAR_PORT_UART_RX_BUFFER_SIZE.
+static size_t gRxBufferSize[CELLULAR_PORT_MAX_NUM_UARTS] = {0};
+
+// Table to map a baud rate to a termios speed.
+static const struct {
+    int32_t baudRate;
+    speed_t speed;
+} gSpeed[] = {{9600, B9600},
+              {19200, B19200},
+              {38400, B38400},
+              {57600, B57600},
+              {115200, B115200},
+              {230400, B230400},
+              {460800, B460800},
+              {921600, B921600}};
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// Find the UART data structure for a given UART.
+static CellularPortUartData_t *pGetUart(int32_t uart)
+{
+    CellularPortUartData_t *pUartData = gpUartDataHead;
+    bool found = false;
+
+    while (!found && (pUartData != NULL)) {
+        if (pUartData->number == uart) {
+            found = true;
+        } else {
+            pUartData = pUartData->pNext;
+        }
+    }
+
+    return pUartData;
+}
+
+// Remove a UART from the list.
+// The memory occupied is free()ed.
+static bool removeUart(int32_t uart)
+{
+    CellularPortUartData_t **ppUartData = &gpUartDataHead;
+    CellularPortUartData_t *pTmp;
+    bool found = false;
+
+    while (!found && (*ppUartData != NULL)) {
+        if ((*ppUartData)->number == uart) {
+            found = true;
+            pTmp = *ppUartData;
+            *ppUartData = pTmp->pNext;
+            cellularPort_free(pTmp);
+        } else {
+            ppUartData = &((*ppUartData)->pNext);
+        }
+    }
+
+    return found;
+}
+
+// Get the number of bytes in the receive ring between the
+// read index and the given write index.
+static inline size_t rxBufferCount(const CellularPortUartData_t *pUartData,
+                                   size_t rxWrite)
+{
+    size_t count = 0;
+
+    if (pUartData->rxRead < rxWrite) {
+        count = rxWrite - pUartData->rxRead;
+    } else if (pUartData->rxRead > rxWrite) {
+        count = pUartData->rxBufferSize - pUartData->rxRead + rxWrite;
+    }
+
+    return count;
+}
+
+// Get the write index as published by the receive thread; the
+// acquire makes sure that none of the data covered by the write
+// index is read before the write index itself.
+static inline size_t rxWriteGet(const CellularPortUartData_t *pUartData)
+{
+    return __atomic_load_n(&(pUartData->rxWrite), __ATOMIC_ACQUIRE);
+}
+
+// Called by the reader when it has emptied the receive ring
+// to ask for an event when more data arrives.  Should data
+// have slipped in between the reader emptying the ring and
+// the request being made, the receive thread will have
+// seen no request and so will not send an event; in that
+// case take the request back and send the event from here.
+static void rxNotifyRequest(CellularPortUartData_t *pUartData)
+{
+    CellularPortUartEventData_t uartSizeOrError;
+
+    __atomic_store_n(&(pUartData->userNeedsNotify), true, __ATOMIC_SEQ_CST);
+    uartSizeOrError = rxBufferCount(pUartData, rxWriteGet(pUartData));
+    if ((uartSizeOrError > 0) &&
+        __atomic_exchange_n(&(pUartData->userNeedsNotify), false,
+                            __ATOMIC_ACQ_REL)) {
+        cellularPortPrivateQueueSendNoWait(pUartData->queue, &uartSizeOrError);
+    }
+}
+
+// Wait for the device to become readable, the wake pipe to be
+// written or the given time to pass; returns false if the
+// receive thread should stop.
+static bool rxWait(CellularPortUartData_t *pUartData, bool device,
+                   int timeoutMs)
+{
+    struct pollfd fds[2];
+
+    fds[0].fd = pUartData->wakeFd[0];
+    fds[0].events = POLLIN;
+    fds[1].fd = pUartData->fd;
+    fds[1].events = POLLIN;
+    poll(fds, device ? 2 : 1, timeoutMs);
+
+    return (fds[0].revents == 0);
+}
+
+// The receive thread: does the job of the DMA and the
+// interrupt handlers of the embedded platforms.
+static void *pRxTask(void *pParam)
+{
+    CellularPortUartData_t *pUartData = (CellularPortUartData_t *) pParam;
+    CellularPortUartEventData_t uartSizeOrError;
+    size_t rxRead;
+    size_t room;
+    size_t count;
+    ssize_t x;
+
+    while (rxWait(pUartData, true, -1)) {
+        // Work out how much contiguous room there is,
+        // leaving one byte empty
+        rxRead = __atomic_load_n(&(pUartData->rxRead), __ATOMIC_ACQUIRE);
+        if (rxRead > pUartData->rxWrite) {
+            room = rxRead - pUartData->rxWrite - 1;
+        } else {
+            room = pUartData->rxBufferSize - pUartData->rxWrite;
+            if (rxRead == 0) {
+                room--;
+            }
+        }
+        x = 0;
+        if (room > 0) {
+            x = read(pUartData->fd,
+                     pUartData->pRxBufferStart + pUartData->rxWrite,
+                     room);
+        }
+        if (x > 0) {
+            // Publish the new write index
+            __atomic_store_n(&(pUartData->rxWrite),
+                             (pUartData->rxWrite + x) % pUartData->rxBufferSize,
+                             __ATOMIC_RELEASE);
+            count = rxBufferCount(pUartData, pUartData->rxWrite);
+            if (count > pUartData->stats.rxHighWaterMarkBytes) {
+                pUartData->stats.rxHighWaterMarkBytes = count;
+            }
+            // Let the user know, if they want to know
+            if (__atomic_exchange_n(&(pUartData->userNeedsNotify), false,
+                                    __ATOMIC_ACQ_REL)) {
+                uartSizeOrError = (CellularPortUartEventData_t) count;
+                cellularPortPrivateQueueSendNoWait(pUartData->queue, &uartSizeOrError);
+            }
+        } else if ((x == 0) || ((errno != EINTR) && (errno != EAGAIN))) {
+            // The ring is full or the device has gone
+            // away (a pseudo-terminal with nothing at the
+            // far end returns EIO): try again in a moment
+            if (!rxWait(pUartData, false, CELLULAR_PORT_UART_RX_RETRY_MS)) {
+                break;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+// Open and configure the device for a UART.
+static int openDevice(int32_t uart, int32_t baudRate, bool flowControl)
+{
+    char path[CELLULAR_PORT_UART_DEVICE_PATH_MAX_LENGTH_BYTES];
+    char name[32];
+    const char *pPath;
+    struct termios options;
+    int fd;
+
+    snprintf(name, sizeof(name), "CELLULAR_PORT_UART_%d", (int) uart);
+    pPath = getenv(name);
+    if (pPath == NULL) {
+        snprintf(path, sizeof(path), CELLULAR_PORT_UART_DEVICE_FORMAT,
+                 (int) uart);
+        pPath = path;
+    }
+
+    fd = open(pPath, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd >= 0) {
+        if (tcgetattr(fd, &options) == 0) {
+            cfmakeraw(&options);
+            options.c_cflag |= CLOCAL | CREAD;
+            if (flowControl) {
+                options.c_cflag |= CRTSCTS;
+            } else {
+                options.c_cflag &= ~CRTSCTS;
+            }
+            for (size_t x = 0; x < sizeof(gSpeed) / sizeof(gSpeed[0]); x++) {
+                if (gSpeed[x].baudRate == baudRate) {
+                    cfsetspeed(&options, gSpeed[x].speed);
+                }
+            }
+            if (tcsetattr(fd, TCSANOW, &options) != 0) {
+                close(fd);
+                fd = -1;
+            } else {
+                tcflush(fd, TCIOFLUSH);
+            }
+        } else {
+            close(fd);
+            fd = -1;
+        }
+        if (fd < 0) {
+            cellularPortLog("CELLULAR_PORT_UART: unable to configure %s.\n",
+                            pPath);
+        }
+    } else {
+        cellularPortLog("CELLULAR_PORT_UART: unable to open %s (%d).\n",
+                        pPath, errno);
+    }
+
+    return fd;
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// Initialise a UART.  The pins are ignored on this platform
+// other than to switch on hardware flow control.
+int32_t cellularPortUartInit(int32_t pinTx, int32_t pinRx,
+                             int32_t pinCts, int32_t pinRts,
+                             int32_t baudRate,
+                             size_t rtsThreshold,
+                             int32_t uart,
+                             CellularPortQueueHandle_t *pUartQueue)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortUartData_t *pUartData;
+
+    (void) pinTx;
+    (void) pinRx;
+    (void) rtsThreshold;
+
+    if ((pUartQueue != NULL) && (uart >= 0) &&
+        (uart < CELLULAR_PORT_MAX_NUM_UARTS) && (baudRate > 0)) {
+        errorCode = CELLULAR_PORT_SUCCESS;
+        pUartData = pGetUart(uart);
+        if (pUartData == NULL) {
+            errorCode = CELLULAR_PORT_OUT_OF_MEMORY;
+            pUartData = (CellularPortUartData_t *) pCellularPort_mallocTag(sizeof(CellularPortUartData_t),
+                                                                           CELLULAR_PORT_MALLOC_TAG_PORT);
+            if (pUartData != NULL) {
+                pCellularPort_memset(pUartData, 0, sizeof(*pUartData));
+                pUartData->number = uart;
+                pUartData->flowControl = (pinCts >= 0) || (pinRts >= 0);
+                pUartData->rxBufferSize = gRxBufferSize[uart];
+                if (pUartData->rxBufferSize == 0) {
+                    pUartData->rxBufferSize = CELLULAR_PORT_UART_RX_BUFFER_SIZE;
+                }
+                pUartData->stats.rxBufferSizeBytes = pUartData->rxBufferSize;
+                pUartData->pRxBufferStart = (char *) pCellularPort_mallocTag(pUartData->rxBufferSize,
+                                                                             CELLULAR_PORT_MALLOC_TAG_PORT);
+                if (pUartData->pRxBufferStart != NULL) {
+                    errorCode = cellularPortMutexCreate(&(pUartData->mutex));
+                    if (errorCode == 0) {
+                        errorCode = cellularPortQueueCreate(CELLULAR_PORT_UART_EVENT_QUEUE_SIZE,
+                                                            sizeof(CellularPortUartEventData_t),
+                                                            &(pUartData->queue));
+                        if (errorCode == 0) {
+                            errorCode = CELLULAR_PORT_PLATFORM_ERROR;
+                            pUartData->fd = openDevice(uart, baudRate,
+                                                       pUartData->flowControl);
+                            if (pUartData->fd >= 0) {
+                                if (pipe(pUartData->wakeFd) == 0) {
+                                    // The user wants to know about
+                                    // the first thing that arrives
+                                    pUartData->userNeedsNotify = true;
+                                    if (pthread_create(&(pUartData->rxThread), NULL,
+                                                       pRxTask, pUartData) == 0) {
+                                        pUartData->pNext = gpUartDataHead;
+                                        gpUartDataHead = pUartData;
+                                        errorCode = CELLULAR_PORT_SUCCESS;
+                                    } else {
+                                        close(pUartData->wakeFd[0]);
+                                        close(pUartData->wakeFd[1]);
+                                    }
+                                }
+                                if (errorCode != 0) {
+                                    close(pUartData->fd);
+                                }
+                            }
+                            if (errorCode != 0) {
+                                cellularPortQueueDelete(pUartData->queue);
+                            }
+                        }
+                        if (errorCode != 0) {
+                            cellularPortMutexDelete(pUartData->mutex);
+                        }
+                    }
+                    if (errorCode != 0) {
+                        cellularPort_free(pUartData->pRxBufferStart);
+                    }
+                }
+                if (errorCode != 0) {
+                    cellularPort_free(pUartData);
+                    pUartData = NULL;
+                }
+            }
+        }
+        if (pUartData != NULL) {
+            *pUartQueue = pUartData->queue;
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Shutdown a UART.
+int32_t cellularPortUartDeinit(int32_t uart)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortUartData_t *pUartData;
+    char wake = 0;
+
+    if ((uart >= 0) && (uart < CELLULAR_PORT_MAX_NUM_UARTS)) {
+        errorCode = CELLULAR_PORT_SUCCESS;
+        pUartData = pGetUart(uart);
+        if (pUartData != NULL) {
+            // Stop the receive thread and wait for it to go
+            if (write(pUartData->wakeFd[1], &wake, 1) == 1) {
+                pthread_join(pUartData->rxThread, NULL);
+            }
+            close(pUartData->wakeFd[0]);
+            close(pUartData->wakeFd[1]);
+            close(pUartData->fd);
+            cellularPortQueueDelete(pUartData->queue);
+            cellularPort_free(pUartData->pRxBufferStart);
+            cellularPortMutexDelete(pUartData->mutex);
+            removeUart(uart);
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Push a UART event onto the UART event queue.
+int32_t cellularPortUartEventSend(const CellularPortQueueHandle_t queueHandle,
+                                  int32_t sizeBytesOrError)
+{
+    int32_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortUartEventData_t uartSizeOrError;
+
+    if (queueHandle != NULL) {
+        uartSizeOrError = sizeBytesOrError;
+        errorCode = cellularPortQueueSend(queueHandle, (void *) &uartSizeOrError);
+    }
+
+    return errorCode;
+}
+
+// Receive a UART event, blocking until one turns up.
+int32_t cellularPortUartEventReceive(const CellularPortQueueHandle_t queueHandle)
+{
+    int32_t sizeOrErrorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortUartEventData_t uartSizeOrError;
+
+    if (queueHandle != NULL) {
+        sizeOrErrorCode = CELLULAR_PORT_PLATFORM_ERROR;
+        if (cellularPortQueueReceive(queueHandle, &uartSizeOrError) == 0) {
+            sizeOrErrorCode = uartSizeOrError;
+        }
+    }
+
+    return sizeOrErrorCode;
+}
+
+// Receive a UART event with a timeout.
+int32_t cellularPortUartEventTryReceive(const CellularPortQueueHandle_t queueHandle,
+                                        int32_t waitMs)
+{
+    int32_t sizeOrErrorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortUartEventData_t uartSizeOrError;
+
+    if (queueHandle != NULL) {
+        sizeOrErrorCode = CELLULAR_PORT_TIMEOUT;
+        if (cellularPortQueueTryReceive(queueHandle, waitMs, &uartSizeOrError) == 0) {
+            sizeOrErrorCode = uartSizeOrError;
+        }
+    }
+
+    return sizeOrErrorCode;
+}
+
+// Get the number of bytes waiting in the receive buffer.
+int32_t cellularPortUartGetReceiveSize(int32_t uart)
+{
+    CellularPortErrorCode_t sizeOrErrorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortUartData_t *pUartData = pGetUart(uart);
+
+    if (pUartData != NULL) {
+        // No need to lock the mutex, the receive
+        // ring is lock-free
+        sizeOrErrorCode = rxBufferCount(pUartData, rxWriteGet(pUartData));
+        // If there's nothing waiting, need to inform
+        // the user when something arrives
+        if (sizeOrErrorCode == 0) {
+            rxNotifyRequest(pUartData);
+        }
+    }
+
+    return (int32_t) sizeOrErrorCode;
+}
+
+// Read from the given UART interface.
+int32_t cellularPortUartRead(int32_t uart, char *pBuffer,
+                             size_t sizeBytes)
+{
+    CellularPortErrorCode_t sizeOrErrorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortUartData_t *pUartData = pGetUart(uart);
+    size_t rxWrite;
+    size_t rxRead;
+    size_t thisSize;
+
+    if ((pUartData != NULL) && (pBuffer != NULL)) {
+        // No need to lock the mutex, the receive
+        // ring is lock-free
+        sizeOrErrorCode = 0;
+        rxWrite = rxWriteGet(pUartData);
+        rxRead = pUartData->rxRead;
+        // At most two goes: up to the end of the
+        // buffer and then from the start
+        for (size_t x = 0; (x < 2) && (sizeBytes > 0) &&
+                           (rxRead != rxWrite); x++) {
+            if (rxRead < rxWrite) {
+                thisSize = rxWrite - rxRead;
+            } else {
+                thisSize = pUartData->rxBufferSize - rxRead;
+            }
+            if (thisSize > sizeBytes) {
+                thisSize = sizeBytes;
+            }
+            pCellularPort_memcpy(pBuffer, pUartData->pRxBufferStart + rxRead,
+                                 thisSize);
+            pBuffer += thisSize;
+            sizeBytes -= thisSize;
+            sizeOrErrorCode += thisSize;
+            rxRead = (rxRead + thisSize) % pUartData->rxBufferSize;
+        }
+        // Hand the space back to the receive thread
+        __atomic_store_n(&(pUartData->rxRead), rxRead, __ATOMIC_RELEASE);
+
+        // If everything has been read, a notification
+        // is needed for the next one
+        if (rxRead == rxWrite) {
+            rxNotifyRequest(pUartData);
+        }
+    }
+
+    return (int32_t) sizeOrErrorCode;
+}
+
+// Get a pointer to the data waiting in the receive buffer.
+int32_t cellularPortUartReadSpan(int32_t uart, const char **ppData)
+{
+    CellularPortErrorCode_t sizeOrErrorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortUartData_t *pUartData = pGetUart(uart);
+    size_t rxWrite;
+
+    if ((pUartData != NULL) && (ppData != NULL)) {
+        // No need to lock the mutex, the receive
+        // ring is lock-free
+        sizeOrErrorCode = 0;
+        rxWrite = rxWriteGet(pUartData);
+        if (pUartData->rxRead < rxWrite) {
+            sizeOrErrorCode = rxWrite - pUartData->rxRead;
+        } else if (pUartData->rxRead > rxWrite) {
+            // Offer up to the end of the buffer, the
+            // remainder will be offered on the next call
+            sizeOrErrorCode = pUartData->rxBufferSize - pUartData->rxRead;
+        }
+        *ppData = pUartData->pRxBufferStart + pUartData->rxRead;
+    }
+
+    return (int32_t) sizeOrErrorCode;
+}
+
+// Mark data obtained through cellularPortUartReadSpan() as read.
+int32_t cellularPortUartReadCommit(int32_t uart, size_t sizeBytes)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortUartData_t *pUartData = pGetUart(uart);
+    size_t rxRead;
+
+    if (pUartData != NULL) {
+        // No need to lock the mutex, the receive
+        // ring is lock-free
+        rxRead = (pUartData->rxRead + sizeBytes) % pUartData->rxBufferSize;
+        __atomic_store_n(&(pUartData->rxRead), rxRead, __ATOMIC_RELEASE);
+
+        // If everything has been read, a notification
+        // is needed for the next one
+        if (rxRead == rxWriteGet(pUartData)) {
+            rxNotifyRequest(pUartData);
+        }
+        errorCode = CELLULAR_PORT_SUCCESS;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Write to the given UART interface.  The data is handed to
+// the driver of the host, which is as close as this platform
+// can get to "written".
+int32_t cellularPortUartWrite(int32_t uart,
+                              const char *pBuffer,
+                              size_t sizeBytes)
+{
+    CellularPortErrorCode_t sizeOrErrorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortUartData_t *pUartData = pGetUart(uart);
+    struct pollfd fds;
+    ssize_t x;
+
+    if ((pUartData != NULL) && (pBuffer != NULL)) {
+
+        CELLULAR_PORT_MUTEX_LOCK(pUartData->mutex);
+
+        sizeOrErrorCode = sizeBytes;
+        fds.fd = pUartData->fd;
+        fds.events = POLLOUT;
+        while ((sizeBytes > 0) && (sizeOrErrorCode >= 0)) {
+            x = write(pUartData->fd, pBuffer, sizeBytes);
+            if (x > 0) {
+                pBuffer += x;
+                sizeBytes -= x;
+            } else if ((x < 0) && (errno == EAGAIN)) {
+                // The device is non-blocking, wait for room
+                poll(&fds, 1, -1);
+            } else if ((x == 0) || (errno != EINTR)) {
+                sizeOrErrorCode = CELLULAR_PORT_PLATFORM_ERROR;
+            }
+        }
+
+        CELLULAR_PORT_MUTEX_UNLOCK(pUartData->mutex);
+
+    }
+
+    return (int32_t) sizeOrErrorCode;
+}
+
+// Change the baud rate of the given UART interface.
+int32_t cellularPortUartSetBaudRate(int32_t uart,
+                                    int32_t baudRate)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortUartData_t *pUartData = pGetUart(uart);
+    struct termios options;
+
+    if ((pUartData != NULL) && (baudRate > 0)) {
+
+        CELLULAR_PORT_MUTEX_LOCK(pUartData->mutex);
+
+        for (size_t x = 0; (x < sizeof(gSpeed) / sizeof(gSpeed[0])) &&
+                           (errorCode != 0); x++) {
+            if (gSpeed[x].baudRate == baudRate) {
+                errorCode = CELLULAR_PORT_PLATFORM_ERROR;
+                // TCSADRAIN lets any transmission
+                // in progress complete first
+                if ((tcgetattr(pUartData->fd, &options) == 0) &&
+                    (cfsetspeed(&options, gSpeed[x].speed) == 0) &&
+                    (tcsetattr(pUartData->fd, TCSADRAIN, &options) == 0)) {
+                    errorCode = CELLULAR_PORT_SUCCESS;
+                }
+            }
+        }
+
+        CELLULAR_PORT_MUTEX_UNLOCK(pUartData->mutex);
+
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Determine if RTS flow control is enabled.
+bool cellularPortIsRtsFlowControlEnabled(int32_t uart)
+{
+    CellularPortUartData_t *pUartData = pGetUart(uart);
+
+    return (pUartData != NULL) && pUartData->flowControl;
+}
+
+// Determine if CTS flow control is enabled.
+bool cellularPortIsCtsFlowControlEnabled(int32_t uart)
+{
+    CellularPortUartData_t *pUartData = pGetUart(uart);
+
+    return (pUartData != NULL) && pUartData->flowControl;
+}
+
+// Set the receive buffer size for the next initialisation of a UART.
+int32_t cellularPortUartSetRxBufferSize(int32_t uart,
+                                        size_t sizeBytes)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+
+    if ((uart >= 0) && (uart < CELLULAR_PORT_MAX_NUM_UARTS) &&
+        (pGetUart(uart) == NULL) &&
+        ((sizeBytes == 0) || (sizeBytes >= 2))) {
+        gRxBufferSize[uart] = sizeBytes;
+        errorCode = CELLULAR_PORT_SUCCESS;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Get the receive statistics of a UART.
+int32_t cellularPortUartGetStats(int32_t uart,
+                                 CellularPortUartStats_t *pStats)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortUartData_t *pUartData = pGetUart(uart);
+
+    if ((pUartData != NULL) && (pStats != NULL)) {
+        // No need to lock the mutex, the statistics are
+        // only ever written by the receive thread; nothing
+        // is ever lost on this platform so rxOverruns and
+        // rxBytesLost stay at zero
+        *pStats = pUartData->stats;
+        errorCode = CELLULAR_PORT_SUCCESS;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Reset the receive statistics of a UART.
+int32_t cellularPortUartResetStats(int32_t uart)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortUartData_t *pUartData = pGetUart(uart);
+
+    if (pUartData != NULL) {
+        pUartData->stats.rxHighWaterMarkBytes = 0;
+        pUartData->stats.rxOverruns = 0;
+        pUartData->stats.rxBytesLost = 0;
+        errorCode = CELLULAR_PORT_SUCCESS;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Suspend a UART: not supported on this platform.
+int32_t cellularPortUartSuspend(int32_t uart)
+{
+    (void) uart;
+
+    return (int32_t) CELLULAR_PORT_NOT_IMPLEMENTED;
+}
+
+// Resume a UART: not supported on this platform.
+int32_t cellularPortUartResume(int32_t uart)
+{
+    (void) uart;
+
+    return (int32_t) CELLULAR_PORT_NOT_IMPLEMENTED;
+}
+
+// End of file
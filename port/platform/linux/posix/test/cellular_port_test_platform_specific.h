@@ -0,0 +1,158 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _CELLULAR_PORT_TEST_PLATFORM_SPECIFIC_H_
+#define _CELLULAR_PORT_TEST_PLATFORM_SPECIFIC_H_
+
+/* Only bring in #includes specifically related to the test framework */
+
+#include "cellular_port_unity_addons.h"
+
+/** Porting layer for test execution on the POSIX platform.
+ * Since test execution is often macro-ised rather than
+ * function-calling this header file forms part of the platform
+ * test source code rather than pretending to be a generic API.
+ */
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS: UNITY RELATED
+ * -------------------------------------------------------------- */
+
+/** Macro to wrap a test assertion and map it to our Unity port.
+ */
+#define CELLULAR_PORT_TEST_ASSERT(condition) CELLULAR_PORT_UNITY_TEST_ASSERT(condition)
+
+/** Macro to wrap the definition of a test function and
+ * map it to our Unity port.
+ */
+#define CELLULAR_PORT_TEST_FUNCTION(function, name, group) CELLULAR_PORT_UNITY_TEST_FUNCTION(name, group)
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS: OS RELATED
+ * -------------------------------------------------------------- */
+
+/** The stack size to use for the test task created during OS testing.
+ */
+#define CELLULAR_PORT_TEST_OS_TASK_STACK_SIZE_BYTES (1024 * 3)
+
+/** The task priority to use for the task created during.
+ * testing.
+ */
+#define CELLULAR_PORT_TEST_OS_TASK_PRIORITY (CELLULAR_PORT_OS_PRIORITY_MIN + 5)
+
+/** The stack size to use for the test task created during sockets testing.
+ */
+#define CELLULAR_PORT_TEST_SOCK_TASK_STACK_SIZE_BYTES (1024 * 5)
+
+/** The priority to use for the test task created during sockets testing;
+ * lower priority than the URC handler.
+ */
+#define CELLULAR_PORT_TEST_SOCK_TASK_PRIORITY (CELLULAR_CTRL_AT_TASK_URC_PRIORITY - 1)
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS: HW RELATED
+ * -------------------------------------------------------------- */
+
+/* There are no real pins on this platform and the virtual pins
+ * are not wired to each other, hence the GPIO test is switched
+ * off by default.
+ */
+
+/** Pin A for GPIO testing.
+ */
+#ifndef CELLULAR_PORT_TEST_PIN_A
+# define CELLULAR_PORT_TEST_PIN_A         -1
+#endif
+
+/** Pin B for GPIO testing.
+ */
+#ifndef CELLULAR_PORT_TEST_PIN_B
+# define CELLULAR_PORT_TEST_PIN_B         -1
+#endif
+
+/** Pin C for GPIO testing.
+ */
+#ifndef CELLULAR_PORT_TEST_PIN_C
+# define CELLULAR_PORT_TEST_PIN_C         -1
+#endif
+
+/** UART for UART driver testing.  The UART test needs
+ * whatever is written to come straight back, which the modem
+ * simulator does not do, hence it is switched off by default;
+ * to run it, point CELLULAR_PORT_UART_<n> at a serial device
+ * with its Tx and Rx wired together and set
+ * CELLULAR_PORT_TEST_PIN_UART_TXD and
+ * CELLULAR_PORT_TEST_PIN_UART_RXD to 0.
+ */
+#ifndef CELLULAR_PORT_TEST_UART
+# define CELLULAR_PORT_TEST_UART          1
+#endif
+
+/** Handshake threshold for UART testing.
+ */
+#ifndef CELLULAR_PORT_TEST_UART_RTS_THRESHOLD
+# define CELLULAR_PORT_TEST_UART_RTS_THRESHOLD 0 // Not used on this platform
+#endif
+
+/** Tx pin for UART testing.
+ */
+#ifndef CELLULAR_PORT_TEST_PIN_UART_TXD
+# define CELLULAR_PORT_TEST_PIN_UART_TXD   -1
+#endif
+
+/** Rx pin for UART testing.
+ */
+#ifndef CELLULAR_PORT_TEST_PIN_UART_RXD
+# define CELLULAR_PORT_TEST_PIN_UART_RXD   -1
+#endif
+
+/** CTS pin for UART testing: any value other than -1 switches
+ * on hardware flow control.
+ */
+#ifndef CELLULAR_PORT_TEST_PIN_UART_CTS
+# define CELLULAR_PORT_TEST_PIN_UART_CTS  -1
+#endif
+
+/** RTS pin for UART testing: any value other than -1 switches
+ * on hardware flow control.
+ */
+#ifndef CELLULAR_PORT_TEST_PIN_UART_RTS
+# define CELLULAR_PORT_TEST_PIN_UART_RTS  -1
+#endif
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS: MODULE RELATED
+ * -------------------------------------------------------------- */
+
+/** Set to 1 when the tests are to be run against the modem
+ * simulator, cellular_sim, rather than a real module: the
+ * tests that need what the simulator doesn't do, switching
+ * the module off, CMUX framing and an MQTT broker, are then
+ * switched off.  Add
+ * -DCELLULAR_PORT_TEST_SIMULATOR=0 to CELLULAR_FLAGS when
+ * testing a real module.
+ */
+#ifndef CELLULAR_PORT_TEST_SIMULATOR
+# define CELLULAR_PORT_TEST_SIMULATOR     1
+#endif
+
+/* ----------------------------------------------------------------
+ * FUNCTIONS
+ * -------------------------------------------------------------- */
+
+#endif // _CELLULAR_PORT_TEST_PLATFORM_SPECIFIC_H_
+
+// End of file
@@ -66,6 +66,9 @@
 #define configMAX_PRIORITIES                                                      ( 15 )
 #define configMINIMAL_STACK_SIZE                                                  ( 60 )
 #define configTOTAL_HEAP_SIZE                                                     ( 1024 * 16 )
+#if defined(CELLULAR_CFG_STATIC_ALLOC) && CELLULAR_CFG_STATIC_ALLOC
+# define configSUPPORT_STATIC_ALLOCATION                                          1
+#endif
 #define configMAX_TASK_NAME_LEN                                                   ( 16 )
 #define configUSE_16_BIT_TICKS                                                    0
 #define configIDLE_SHOULD_YIELD                                                   1
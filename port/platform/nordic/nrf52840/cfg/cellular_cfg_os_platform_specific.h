@@ -75,6 +75,63 @@
 # define CELLULAR_CTRL_TASK_CALLBACK_PRIORITY (CELLULAR_PORT_OS_PRIORITY_MIN + 2)
 #endif
 
+#ifndef CELLULAR_SOCK_TASK_DNS_STACK_SIZE_BYTES
+/** The stack size of the task in which the look-ups of
+ * cellularSockGetHostByNameAsync() are done and their callbacks
+ * are run.
+ */
+# define CELLULAR_SOCK_TASK_DNS_STACK_SIZE_BYTES (1024 * 3)
+#endif
+
+#ifndef CELLULAR_SOCK_TASK_DNS_PRIORITY
+/** The task priority for the look-ups of
+ * cellularSockGetHostByNameAsync().
+ */
+# define CELLULAR_SOCK_TASK_DNS_PRIORITY (CELLULAR_PORT_OS_PRIORITY_MIN + 1)
+#endif
+
+#ifndef CELLULAR_CTRL_TASK_TX_SCHEDULER_STACK_SIZE_BYTES
+/** The stack size of the task of the transmit scheduler, see
+ * cellularCtrlTxSchedulerStart(), in which the sends that were
+ * held back are made.
+ */
+# define CELLULAR_CTRL_TASK_TX_SCHEDULER_STACK_SIZE_BYTES (1024 * 3)
+#endif
+
+#ifndef CELLULAR_CTRL_TASK_TX_SCHEDULER_PRIORITY
+/** The task priority of the transmit scheduler.
+ */
+# define CELLULAR_CTRL_TASK_TX_SCHEDULER_PRIORITY (CELLULAR_PORT_OS_PRIORITY_MIN + 1)
+#endif
+
+#ifndef CELLULAR_PORT_TASK_LOG_STACK_SIZE_BYTES
+/** The stack size of the task that emits the messages stored
+ * with CELLULAR_CFG_LOG_DEFERRED.
+ */
+# define CELLULAR_PORT_TASK_LOG_STACK_SIZE_BYTES (1024 * 2)
+#endif
+
+#ifndef CELLULAR_PORT_TASK_LOG_PRIORITY
+/** The task priority of the task that emits the messages stored
+ * with CELLULAR_CFG_LOG_DEFERRED: the lowest there is.
+ */
+# define CELLULAR_PORT_TASK_LOG_PRIORITY CELLULAR_PORT_OS_PRIORITY_MIN
+#endif
+
+#ifndef CELLULAR_CTRL_CMUX_TASK_STACK_SIZE_BYTES
+/** The stack size of the task that takes CMUX frames off the
+ * UART and hands their contents to the virtual channels.
+ */
+# define CELLULAR_CTRL_CMUX_TASK_STACK_SIZE_BYTES (1024 * 2)
+#endif
+
+#ifndef CELLULAR_CTRL_CMUX_TASK_PRIORITY
+/** The task priority of the CMUX demultiplexer, above that of
+ * the URC task so that channel data is ready for it.
+ */
+# define CELLULAR_CTRL_CMUX_TASK_PRIORITY (CELLULAR_PORT_OS_PRIORITY_MAX - 4)
+#endif
+
 #if (CELLULAR_CTRL_TASK_CALLBACK_PRIORITY >= CELLULAR_CTRL_AT_TASK_URC_PRIORITY)
 # error CELLULAR_CTRL_TASK_CALLBACK_PRIORITY must be less than CELLULAR_CTRL_AT_TASK_URC_PRIORITY
 #endif
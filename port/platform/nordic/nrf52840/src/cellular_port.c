@@ -19,6 +19,7 @@
 #endif
 #include "cellular_port_clib.h"
 #include "cellular_port.h"
+#include "cellular_port_debug.h"
 #include "cellular_port_private.h"
 
 #include "FreeRTOS.h"
@@ -108,7 +109,13 @@ int32_t cellularPortInit()
     CellularPortErrorCode_t errorCode = CELLULAR_PORT_SUCCESS;
 
     if (!gInitialised) {
-        errorCode = cellularPortPrivateInit();
+        errorCode = cellularPortMallocInit();
+        if (errorCode == 0) {
+            errorCode = cellularPortPrivateInit();
+        }
+        if (errorCode == 0) {
+            errorCode = cellularPortLogDeferredInit();
+        }
         gInitialised = (errorCode == 0);
     }
 
@@ -119,6 +126,7 @@ int32_t cellularPortInit()
 void cellularPortDeinit()
 {
     if (gInitialised) {
+        cellularPortLogDeferredDeinit();
         cellularPortPrivateDeinit();
         gInitialised = false;
     }
@@ -127,7 +135,7 @@ void cellularPortDeinit()
 // Get the current tick converted to a time in milliseconds.
 int64_t cellularPortGetTickTimeMs()
 {
-    int32_t tickTime = 0;
+    int64_t tickTime = 0;
 
     if (gInitialised) {
         tickTime = cellularPortPrivateGetTickTimeMs();
@@ -136,4 +144,27 @@ int64_t cellularPortGetTickTimeMs()
     return tickTime;
 }
 
+// Store a block of data in non-volatile storage.
+int32_t cellularPortNvStore(int32_t id, const void *pData,
+                            size_t size)
+{
+    (void) id;
+    (void) pData;
+    (void) size;
+
+    // Nowhere set aside for this on this platform
+    return CELLULAR_PORT_NOT_IMPLEMENTED;
+}
+
+// Retrieve a block of data from non-volatile storage.
+int32_t cellularPortNvRetrieve(int32_t id, void *pData,
+                               size_t size)
+{
+    (void) id;
+    (void) pData;
+    (void) size;
+
+    return CELLULAR_PORT_NOT_IMPLEMENTED;
+}
+
 // End of file
@@ -19,10 +19,15 @@
 #endif
 #include "cellular_port_clib.h"
 #include "cellular_port.h"
+#include "cellular_port_os.h"
 #include "cellular_port_gpio.h"
 
+#include "FreeRTOS.h"
+#include "queue.h"
+
 #include "nrf.h"
 #include "nrf_gpio.h"
+#include "nrfx_gpiote.h"
 
 /* ----------------------------------------------------------------
  * COMPILE-TIME MACROS
@@ -36,10 +41,31 @@
  * VARIABLES
  * -------------------------------------------------------------- */
 
+// The queue that each pin sends interrupts to.
+static CellularPortQueueHandle_t gInterruptQueue[NUMBER_OF_PINS] = {0};
+
 /* ----------------------------------------------------------------
  * STATIC FUNCTIONS
  * -------------------------------------------------------------- */
 
+// GPIOTE event handler, called in interrupt context.
+static void gpioteHandler(nrfx_gpiote_pin_t pin,
+                          nrf_gpiote_polarity_t action)
+{
+    int32_t sentPin = (int32_t) pin;
+    BaseType_t yield = pdFALSE;
+
+    (void) action;
+
+    if (gInterruptQueue[pin] != NULL) {
+        xQueueSendFromISR((QueueHandle_t) gInterruptQueue[pin],
+                          &sentPin, &yield);
+    }
+
+    // Required for correct FreeRTOS operation
+    portYIELD_FROM_ISR(yield);
+}
+
 /* ----------------------------------------------------------------
  * PUBLIC FUNCTIONS
  * -------------------------------------------------------------- */
@@ -164,4 +190,54 @@ int32_t cellularPortGpioGet(int32_t pin)
     return nrf_gpio_pin_read(pin);
 }
 
+// Set or remove an interrupt on a GPIO.
+// The low-accuracy (PORT event) form of GPIOTE is used: it
+// costs no current while waiting and wakes the chip from
+// System ON sleep, at the expense of possibly missing pulses
+// shorter than the interrupt latency.
+int32_t cellularPortGpioInterruptSet(int32_t pin,
+                                     CellularPortGpioInterrupt_t interrupt,
+                                     CellularPortQueueHandle_t queueHandle)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    nrfx_gpiote_in_config_t config = NRFX_GPIOTE_CONFIG_IN_SENSE_TOGGLE(false);
+
+    if ((pin >= 0) && (pin < NUMBER_OF_PINS) &&
+        (interrupt < MAX_NUM_CELLULAR_PORT_GPIO_INTERRUPTS) &&
+        ((queueHandle != NULL) ||
+         (interrupt == CELLULAR_PORT_GPIO_INTERRUPT_NONE))) {
+        errorCode = CELLULAR_PORT_PLATFORM_ERROR;
+        if (nrfx_gpiote_is_init() ||
+            (nrfx_gpiote_init() == NRFX_SUCCESS)) {
+            // Out with the old
+            if (gInterruptQueue[pin] != NULL) {
+                nrfx_gpiote_in_event_disable(pin);
+                nrfx_gpiote_in_uninit(pin);
+                gInterruptQueue[pin] = NULL;
+            }
+            errorCode = CELLULAR_PORT_SUCCESS;
+            if (interrupt != CELLULAR_PORT_GPIO_INTERRUPT_NONE) {
+                errorCode = CELLULAR_PORT_PLATFORM_ERROR;
+                if (interrupt == CELLULAR_PORT_GPIO_INTERRUPT_RISING_EDGE) {
+                    config.sense = NRF_GPIOTE_POLARITY_LOTOHI;
+                } else if (interrupt == CELLULAR_PORT_GPIO_INTERRUPT_FALLING_EDGE) {
+                    config.sense = NRF_GPIOTE_POLARITY_HITOLO;
+                }
+                // Keep whatever pull cellularPortGpioConfig() set
+                config.pull = nrf_gpio_pin_pull_get(pin);
+                gInterruptQueue[pin] = queueHandle;
+                if (nrfx_gpiote_in_init(pin, &config,
+                                        gpioteHandler) == NRFX_SUCCESS) {
+                    nrfx_gpiote_in_event_enable(pin, true);
+                    errorCode = CELLULAR_PORT_SUCCESS;
+                } else {
+                    gInterruptQueue[pin] = NULL;
+                }
+            }
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
 // End of file
@@ -22,8 +22,13 @@
 #include "cellular_port.h"
 #include "cellular_port_private.h"
 
+#include "FreeRTOS.h"
+#include "task.h"
+
 #include "nrfx.h"
 #include "nrfx_timer.h"
+#include "nrf_gpio.h"
+#include "nrf_gpiote.h"
 
 /* ----------------------------------------------------------------
  * COMPILE-TIME MACROS
@@ -39,6 +44,13 @@
  * TYPES
  * -------------------------------------------------------------- */
 
+// A pin armed to wake on going low.
+typedef struct {
+    int32_t pin; //!< -1 if this entry is not in use.
+    void (*pCb) (void *);
+    void *pCbParameter;
+} CellularPortPrivateWakePin_t;
+
 /* ----------------------------------------------------------------
  * VARIABLES
  * -------------------------------------------------------------- */
@@ -78,6 +90,9 @@ static void (*gpCb) (void *);
 // The user parameter for the callback.
 static void *gpCbParameter;
 
+// The pins armed to wake on going low.
+static CellularPortPrivateWakePin_t gWakePin[CELLULAR_PORT_PRIVATE_MAX_NUM_WAKE_PINS];
+
 /* ----------------------------------------------------------------
  * STATIC FUNCTIONS
  * -------------------------------------------------------------- */
@@ -132,6 +147,40 @@ static void tickTimerStop()
     nrfx_timer_uninit(&gTickTimer);
 }
 
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS: INTERRUPT HANDLERS
+ * -------------------------------------------------------------- */
+
+#if !NRFX_GPIOTE_ENABLED
+// The GPIOTE interrupt handler, only the PORT event is used.
+void GPIOTE_IRQHandler(void)
+{
+    CellularPortPrivateWakePin_t *pWakePin;
+    void (*pCb) (void *);
+
+    if (nrf_gpiote_event_is_set(NRF_GPIOTE_EVENTS_PORT)) {
+        nrf_gpiote_event_clear(NRF_GPIOTE_EVENTS_PORT);
+        for (size_t x = 0; x < sizeof(gWakePin) / sizeof(gWakePin[0]); x++) {
+            pWakePin = &(gWakePin[x]);
+            // The latch catches a pin that went low only
+            // briefly, e.g. for a start bit, and has since
+            // gone high again
+            if ((pWakePin->pin >= 0) &&
+                (nrf_gpio_pin_latch_get(pWakePin->pin) ||
+                 (nrf_gpio_pin_read(pWakePin->pin) == 0))) {
+                // Disarm before calling the callback
+                // so that it is free to re-arm
+                nrf_gpio_cfg_sense_set(pWakePin->pin, NRF_GPIO_PIN_NOSENSE);
+                nrf_gpio_pin_latch_clear(pWakePin->pin);
+                pCb = pWakePin->pCb;
+                pWakePin->pin = -1;
+                pCb(pWakePin->pCbParameter);
+            }
+        }
+    }
+}
+#endif
+
 /* ----------------------------------------------------------------
  * PUBLIC FUNCTIONS SPECIFIC TO THIS PORT
  * -------------------------------------------------------------- */
@@ -148,17 +197,30 @@ inline int64_t cellularPortPrivateTicksToUs(int32_t tickValue)
 int32_t cellularPortPrivateInit()
 {
     nrfx_timer_config_t timerCfg = NRFX_TIMER_DEFAULT_CONFIG;
+    int32_t errorCode;
 
     gTickTimerOverflowCount = 0;
     gTickTimerOffset = 0;
     gTickTimerUartMode = false;
     gpCb = NULL;
     gpCbParameter = NULL;
+    for (size_t x = 0; x < sizeof(gWakePin) / sizeof(gWakePin[0]); x++) {
+        gWakePin[x].pin = -1;
+    }
     timerCfg.frequency = CELLULAR_PORT_TICK_TIMER_FREQUENCY_HZ;
     timerCfg.bit_width = CELLULAR_PORT_TICK_TIMER_BIT_WIDTH;
 
-    return tickTimerStart(&timerCfg,
-                          CELLULAR_PORT_TICK_TIMER_LIMIT_NORMAL_MODE);
+    errorCode = tickTimerStart(&timerCfg,
+                               CELLULAR_PORT_TICK_TIMER_LIMIT_NORMAL_MODE);
+#if configUSE_TICKLESS_IDLE
+    // Time comes from the RTOS tick, the tick timer
+    // is only needed once a UART is running
+    if (errorCode == 0) {
+        nrfx_timer_pause(&gTickTimer);
+    }
+#endif
+
+    return errorCode;
 }
 
 // Deinitialise the private stuff.
@@ -263,12 +325,97 @@ void cellularPortPrivateTickTimeNormalMode()
         // the overflow value into the offset
         gTickTimerOffset += remainderOverflowTicks;
 
-        // Continue ticking
         gTickTimerUartMode = false;
+#if !configUSE_TICKLESS_IDLE
+        // Continue ticking; with tickless idle time comes
+        // from the RTOS tick and the tick timer is only
+        // needed by a UART
         nrfx_timer_resume(&gTickTimer);
+#endif
     }
 }
 
+// Stop the tick timer while nothing needs its interrupt.
+void cellularPortPrivateTickTimeSuspend()
+{
+#if configUSE_TICKLESS_IDLE
+    nrfx_timer_pause(&gTickTimer);
+#endif
+}
+
+// Restart the tick timer after cellularPortPrivateTickTimeSuspend().
+void cellularPortPrivateTickTimeResume()
+{
+#if configUSE_TICKLESS_IDLE
+    nrfx_timer_resume(&gTickTimer);
+#endif
+}
+
+// Arm a wake-up on a GPIO input pin going low.
+int32_t cellularPortPrivateWakeOnLowArm(int32_t pin,
+                                        void (*pCb) (void *),
+                                        void *pCbParameter)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+#if !NRFX_GPIOTE_ENABLED
+    CellularPortPrivateWakePin_t *pWakePin = NULL;
+
+    if ((pin >= 0) && (pCb != NULL)) {
+        errorCode = CELLULAR_PORT_OUT_OF_MEMORY;
+        NRFX_CRITICAL_SECTION_ENTER();
+        for (size_t x = 0; (x < sizeof(gWakePin) / sizeof(gWakePin[0])) &&
+                           (pWakePin == NULL); x++) {
+            if (gWakePin[x].pin < 0) {
+                pWakePin = &(gWakePin[x]);
+            }
+        }
+        if (pWakePin != NULL) {
+            pWakePin->pCb = pCb;
+            pWakePin->pCbParameter = pCbParameter;
+            pWakePin->pin = pin;
+            nrf_gpio_pin_latch_clear(pin);
+            nrf_gpio_cfg_sense_set(pin, NRF_GPIO_PIN_SENSE_LOW);
+            errorCode = CELLULAR_PORT_SUCCESS;
+        }
+        NRFX_CRITICAL_SECTION_EXIT();
+        if (errorCode == CELLULAR_PORT_SUCCESS) {
+            // If the pin is already low the DETECT signal
+            // will have set the PORT event, in which case
+            // the interrupt will go off straight away
+            nrf_gpiote_int_enable(NRF_GPIOTE_INT_PORT_MASK);
+            NRFX_IRQ_PRIORITY_SET(GPIOTE_IRQn,
+                                  NRFX_GPIOTE_CONFIG_IRQ_PRIORITY);
+            NRFX_IRQ_ENABLE(GPIOTE_IRQn);
+        }
+    }
+#else
+    (void) pin;
+    (void) pCb;
+    (void) pCbParameter;
+    errorCode = CELLULAR_PORT_NOT_IMPLEMENTED;
+#endif
+
+    return (int32_t) errorCode;
+}
+
+// Disarm a wake-up on a GPIO input pin going low.
+void cellularPortPrivateWakeOnLowDisarm(int32_t pin)
+{
+#if !NRFX_GPIOTE_ENABLED
+    NRFX_CRITICAL_SECTION_ENTER();
+    for (size_t x = 0; x < sizeof(gWakePin) / sizeof(gWakePin[0]); x++) {
+        if ((pin >= 0) && (gWakePin[x].pin == pin)) {
+            nrf_gpio_cfg_sense_set(pin, NRF_GPIO_PIN_NOSENSE);
+            nrf_gpio_pin_latch_clear(pin);
+            gWakePin[x].pin = -1;
+        }
+    }
+    NRFX_CRITICAL_SECTION_EXIT();
+#else
+    (void) pin;
+#endif
+}
+
 // Get the current tick converted to a time in milliseconds.
 // NOTE: if you make changes here and are using
 // CELLULAR_PORT_UART_DETAILED_DEBUG (see cellular_port_uart.c)
@@ -278,6 +425,19 @@ int64_t cellularPortPrivateGetTickTimeMs()
 {
     int64_t tickTimerValue = 0;
 
+#if configUSE_TICKLESS_IDLE
+    TimeOut_t timeOut;
+
+    // The RTOS tick is driven by the RTC, which keeps running
+    // while the processor sleeps, and FreeRTOS steps the tick
+    // count on to make up for a tickless idle period; the
+    // time-out state is a consistent snapshot of the tick
+    // count and the number of times it has wrapped
+    vTaskSetTimeOutState(&timeOut);
+    tickTimerValue = (((int64_t) timeOut.xOverflowCount) << 32) +
+                     (uint32_t) timeOut.xTimeOnEntering;
+    tickTimerValue = tickTimerValue * 1000 / configTICK_RATE_HZ;
+#else
     // Read the timer
     tickTimerValue = nrfx_timer_capture(&gTickTimer,
                                         CELLULAR_PORT_TICK_TIMER_CAPTURE_CHANNEL);
@@ -299,6 +459,7 @@ int64_t cellularPortPrivateGetTickTimeMs()
         // Here just multiply 'cos ARM can do that in one clock cycle
         tickTimerValue += gTickTimerOverflowCount * 536871;
     }
+#endif
 
     return tickTimerValue;
 }
@@ -66,6 +66,13 @@ extern "C" {
 #define CELLULAR_PORT_TICK_TIMER_LIMIT_DIFF (CELLULAR_PORT_TICK_TIMER_LIMIT_NORMAL_MODE_BITS - \
                                              CELLULAR_PORT_TICK_TIMER_LIMIT_UART_MODE_BITS)
 
+// The maximum number of pins that may be armed with
+// cellularPortPrivateWakeOnLowArm() at any one time:
+// one per UART.
+#ifndef CELLULAR_PORT_PRIVATE_MAX_NUM_WAKE_PINS
+# define CELLULAR_PORT_PRIVATE_MAX_NUM_WAKE_PINS 2
+#endif
+
 /* ----------------------------------------------------------------
  * TYPES
  * -------------------------------------------------------------- */
@@ -85,6 +92,9 @@ int32_t cellularPortPrivateInit();
 void cellularPortPrivateDeinit();
 
 /** Get the current OS tick converted to a time in milliseconds.
+ * With configUSE_TICKLESS_IDLE this is the FreeRTOS tick, which
+ * is kept across tickless idle, rather than the tick timer, and
+ * must not be called from interrupt context.
  */
 int64_t cellularPortPrivateGetTickTimeMs();
 
@@ -118,6 +128,50 @@ void cellularPortPrivateTickTimeUartMode();
  */
 void cellularPortPrivateTickTimeNormalMode();
 
+/** Stop the tick timer, e.g. while the UART that needs it is
+ * suspended, so that it neither holds the HF clock on nor wakes
+ * the processor every 66 milliseconds.  Does nothing unless
+ * configUSE_TICKLESS_IDLE is set since otherwise the tick timer
+ * is the source of time.  May be called from interrupt context.
+ */
+void cellularPortPrivateTickTimeSuspend();
+
+/** Restart the tick timer after
+ * cellularPortPrivateTickTimeSuspend().  May be called from
+ * interrupt context.
+ */
+void cellularPortPrivateTickTimeResume();
+
+/** Arm a wake-up on a GPIO input pin going low.  This uses
+ * the DETECT signal of the GPIO block and the PORT event of
+ * the GPIOTE peripheral, which need neither the HF clock nor
+ * any other peripheral to be running.  The pin must already
+ * be configured as an input.  When the pin is seen to be low,
+ * which may be immediately, the wake-up is disarmed and pCb
+ * is called.  Not available if the Nordic GPIOTE driver
+ * (NRFX_GPIOTE_ENABLED) is in use since that owns the GPIOTE
+ * interrupt.
+ *
+ * @param pin          the pin.
+ * @param pCb          the callback.  This will be called from
+ *                     interrupt context and so must do
+ *                     virtually nothing!
+ * @param pCbParameter a parameter which will be passed to
+ *                     pCb when it is called, may be NULL.
+ * @return             zero on success else negative error code.
+ */
+int32_t cellularPortPrivateWakeOnLowArm(int32_t pin,
+                                        void (*pCb) (void *),
+                                        void *pCbParameter);
+
+/** Disarm a wake-up armed with cellularPortPrivateWakeOnLowArm();
+ * does nothing if the pin is not armed.  This may be called
+ * from interrupt context.
+ *
+ * @param pin the pin.
+ */
+void cellularPortPrivateWakeOnLowDisarm(int32_t pin);
+
 #ifdef __cplusplus
 }
 #endif
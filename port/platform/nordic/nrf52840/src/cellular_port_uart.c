@@ -17,6 +17,9 @@
 // Uncomment the following line to enable detailed UART logging.
 //#define CELLULAR_PORT_UART_DETAILED_DEBUG
 
+// The log level threshold of this module, see cellular_port_debug.h.
+#define CELLULAR_PORT_LOG_THRESHOLD CELLULAR_CFG_LOG_LEVEL_PORT
+
 #ifdef CELLULAR_CFG_OVERRIDE
 # include "cellular_cfg_override.h" // For a customer's configuration override
 #endif
@@ -61,6 +64,19 @@
  * least two buffers.  Any attempt to stop and restart
  * the UARTE ends up with character loss; believe me I've tried them
  * all.
+ *
+ * The exception is cellularPortUartSuspend(), which is used when
+ * the far end is known to be quiet, e.g. asleep: it stops the
+ * UARTE and the counter/timer, which otherwise keep the HF clock
+ * running, but only when there is nothing waiting to be read, so
+ * that reception can be resumed with a clean ring of sub-buffers
+ * exactly as at initialisation.  While suspended the RX pin is
+ * watched with the GPIO DETECT mechanism and the start bit of the
+ * first character from the far end resumes reception; that first
+ * character may not be received intact.  With FreeRTOS tickless
+ * idle the tick timer, which provides the RX timeout, is stopped
+ * as well, so that nothing but the RX pin (or the RTOS) wakes the
+ * processor.
  */
 
 #ifdef CELLULAR_PORT_UART_DETAILED_DEBUG
@@ -106,7 +122,9 @@
 # define CELLULAR_PORT_UART_SUB_BUFFER_SIZE 128
 #endif
 
-// The number of sub-buffers.
+// The number of sub-buffers in a receive buffer of the default
+// size; a receive buffer set with cellularPortUartSetRxBufferSize()
+// is likewise a whole number of sub-buffers, at least two.
 #define CELLULAR_PORT_UART_NUM_SUB_BUFFERS (CELLULAR_PORT_UART_RX_BUFFER_SIZE / \
                                             CELLULAR_PORT_UART_SUB_BUFFER_SIZE)
 
@@ -114,6 +132,26 @@
 # error Cannot accommodate two sub-buffers, either increase CELLULAR_PORT_UART_RX_BUFFER_SIZE to a larger multiple of CELLULAR_PORT_UART_SUB_BUFFER_SIZE or reduce CELLULAR_PORT_UART_SUB_BUFFER_SIZE.
 #endif
 
+// The size of the static buffer, one per UART, through which
+// data that is not in DMA-capable memory (e.g. a string
+// constant in flash) is transmitted.  Such data is sent in
+// chunks of this size.
+#ifndef CELLULAR_PORT_UART_TX_BOUNCE_BUFFER_SIZE
+# define CELLULAR_PORT_UART_TX_BOUNCE_BUFFER_SIZE 128
+#endif
+
+// The maximum length of a single transmit DMA on NRF52840 HW,
+// MAXCNT being a 16 bit register.
+#define CELLULAR_PORT_UART_TX_DMA_MAX_LENGTH 0xFFFF
+
+// The time to allow for a transmission to complete, over
+// and above the time the characters take on the line at the
+// configured baud rate; this covers the far end holding off
+// transmission with CTS.
+#ifndef CELLULAR_PORT_UART_TX_TIMEOUT_MARGIN_MS
+# define CELLULAR_PORT_UART_TX_TIMEOUT_MARGIN_MS 5000
+#endif
+
 
 #ifdef CELLULAR_PORT_UART_DETAILED_DEBUG
 // To do detailed UART logging we can't afford to do time calculations on each call,
@@ -149,13 +187,6 @@ extern bool gTickTimerUartMode;
  */
 typedef int32_t CellularPortUartEventData_t;
 
-/** UART receive buffer structure, which can be used as a list.
- */
-typedef struct CellularPortUartBuffer_t {
-    char *pStart;
-    struct CellularPortUartBuffer_t *pNext;
-} CellularPortUartBuffer_t;
-
 /** Structure of the things we need to keep track of per UART.
  */
 typedef struct {
@@ -164,8 +195,17 @@ typedef struct {
     nrf_ppi_channel_t ppiChannel;
     CellularPortMutexHandle_t mutex;
     CellularPortQueueHandle_t queue;
+    CellularPortQueueHandle_t txQueue; //!< written by the interrupt
+                                       // handler at the end of a
+                                       // transmission.
+    int32_t baudRate;
+    size_t rxBufferSizeNext; //!< the receive buffer size to
+                             // use at the next initialisation,
+                             // zero for the default.
+    size_t rxBufferSize;
     char *pRxStart;
-    CellularPortUartBuffer_t *pRxBufferWriteNext;
+    char *pRxBufferWriteNext; //!< the sub-buffer that the DMA
+                              // will be given next.
     char *pRxRead;
     size_t startRxByteCount;
     volatile size_t endRxByteCount;
@@ -173,7 +213,11 @@ typedef struct {
                           // been read and hence the user
                           // would like a notification
                           // when new data arrives.
-    CellularPortUartBuffer_t rxBufferList[CELLULAR_PORT_UART_NUM_SUB_BUFFERS];
+    volatile bool suspended; //!< set by cellularPortUartSuspend(),
+                             // cleared by uartResume(), which
+                             // may be called from the GPIOTE
+                             // interrupt.
+    CellularPortUartStats_t stats;
 } CellularPortUartData_t;
 
 #ifdef CELLULAR_PORT_UART_DETAILED_DEBUG
@@ -207,6 +251,7 @@ typedef enum {
     UART_LOG_EVENT_INT_ENDRX,
     UART_LOG_EVENT_INT_RXSTARTED,
     UART_LOG_EVENT_INT_ERROR,
+    UART_LOG_EVENT_INT_ENDTX,
     UART_LOG_EVENT_MUTEX_HANDLE,
     UART_LOG_EVENT_QUEUE_HANDLE,
     UART_LOG_EVENT_RX_DATA_SIZE,
@@ -303,6 +348,7 @@ static const char *gLogText[] = {"NULL",
                                  "INT_ENDRX",
                                  "INT_RXSTARTED",
                                  "INT_ERROR",
+                                 "INT_ENDTX",
                                  "MUTEX_HANDLE",
                                  "QUEUE_HANDLE",
                                  "RX_DATA_SIZE",
@@ -331,13 +377,20 @@ static const char *gLogText[] = {"NULL",
                                  "X"};
 #endif
 
+// Buffers, one per UART, through which data that is not in
+// DMA-capable memory is transmitted.
+static char gTxBounceBuffer[sizeof(gUartData) / sizeof(gUartData[0])]
+                           [CELLULAR_PORT_UART_TX_BOUNCE_BUFFER_SIZE] __attribute__ ((aligned (4)));
+
 /* ----------------------------------------------------------------
  * STATIC FUNCTIONS
  * -------------------------------------------------------------- */
 
-// Get the number of received bytes waiting in the buffer.
+// Get the number of bytes received since the read pointer was
+// last moved on, which will be larger than the size of the
+// receive buffer if the buffer has been overrun.
 // Note: this may be called from interrupt context.
-static size_t uartGetRxBytes(CellularPortUartData_t *pUartData)
+static size_t uartGetRxBytesRaw(CellularPortUartData_t *pUartData)
 {
     size_t x;
 
@@ -352,14 +405,55 @@ static size_t uartGetRxBytes(CellularPortUartData_t *pUartData)
         // Wrapped
         x = INT_MAX - pUartData->startRxByteCount + pUartData->endRxByteCount;
     }
-    if (x > CELLULAR_PORT_UART_RX_BUFFER_SIZE) {
-        x = CELLULAR_PORT_UART_RX_BUFFER_SIZE;
+
+    return x;
+}
+
+// Get the number of received bytes waiting in the buffer.
+// Note: this may be called from interrupt context.
+static size_t uartGetRxBytes(CellularPortUartData_t *pUartData)
+{
+    size_t x;
+
+    x = uartGetRxBytesRaw(pUartData);
+    if (x > pUartData->rxBufferSize) {
+        x = pUartData->rxBufferSize;
+    }
+    if (x > pUartData->stats.rxHighWaterMarkBytes) {
+        pUartData->stats.rxHighWaterMarkBytes = x;
     }
     UART_DETAILED_LOG(UART_LOG_EVENT_GET_RX_BYTES, x);
 
     return x;
 }
 
+// Check whether the receive buffer has been overrun, i.e. the
+// DMA, which never stops, has come round and written over data
+// that had not yet been read.  If it has, move the read pointer
+// on past the lost data and past the sub-buffer that the DMA may
+// be writing into now, so that what remains is intact, and count
+// what was lost.  The UART mutex must be locked before this is
+// called; it must not be called from interrupt context.
+static void uartRxOverrunCheck(CellularPortUartData_t *pUartData)
+{
+    size_t x = uartGetRxBytesRaw(pUartData);
+
+    if (x > pUartData->rxBufferSize) {
+        x -= pUartData->rxBufferSize - CELLULAR_PORT_UART_SUB_BUFFER_SIZE;
+        pUartData->pRxRead += x % pUartData->rxBufferSize;
+        if (pUartData->pRxRead >= pUartData->pRxStart +
+                                  pUartData->rxBufferSize) {
+            pUartData->pRxRead -= pUartData->rxBufferSize;
+        }
+        pUartData->startRxByteCount += x;
+        pUartData->stats.rxOverruns++;
+        pUartData->stats.rxBytesLost += x;
+        UART_DETAILED_LOG(UART_LOG_EVENT_READ_PTR, pUartData->pRxRead);
+        UART_DETAILED_LOG(UART_LOG_EVENT_START_RX_BYTE_COUNT,
+                          pUartData->startRxByteCount);
+    }
+}
+
 // Callback to be called when the receive check timer has expired.
 // pParameter must be a pointer to CellularPortUartData_t.
 static void rxCb(void *pParameter)
@@ -369,7 +463,10 @@ static void rxCb(void *pParameter)
     BaseType_t yield = false;
 
     UART_DETAILED_LOG(UART_LOG_EVENT_INT_TIMER_CALLBACK, pUartData->pReg);
-    x = uartGetRxBytes(pUartData);
+    x = 0;
+    if (!pUartData->suspended) {
+        x = uartGetRxBytes(pUartData);
+    }
     // If there is at least some data and the user needs to
     // be notified, let them know
     if ((x > 0) && pUartData->userNeedsNotify) {
@@ -388,10 +485,24 @@ static void rxCb(void *pParameter)
     }
 }
 
-// The interrupt handler: only handles Rx events as Tx is blocking.
-static void rxIrqHandler(CellularPortUartData_t *pUartData)
+// The interrupt handler: handles Rx events and the end
+// of a transmission.
+static void irqHandler(CellularPortUartData_t *pUartData)
 {
     NRF_UARTE_Type *pReg = pUartData->pReg;
+    CellularPortUartEventData_t uartSizeOrError;
+    BaseType_t yield = false;
+
+    if (nrf_uarte_event_check(pReg, NRF_UARTE_EVENT_ENDTX)) {
+        // A transmit DMA has finished, let the
+        // writing task know so that it can
+        // carry on
+        UART_DETAILED_LOG(UART_LOG_EVENT_INT_ENDTX, pReg);
+        nrf_uarte_event_clear(pReg, NRF_UARTE_EVENT_ENDTX);
+        uartSizeOrError = nrf_uarte_tx_amount_get(pReg);
+        xQueueSendFromISR((QueueHandle_t) (pUartData->txQueue),
+                          &uartSizeOrError, &yield);
+    }
 
     if (nrf_uarte_event_check(pReg, NRF_UARTE_EVENT_ENDRX)) {
         UART_DETAILED_LOG(UART_LOG_EVENT_INT_ENDRX, pReg);
@@ -410,12 +521,17 @@ static void rxIrqHandler(CellularPortUartData_t *pUartData)
         UART_DETAILED_LOG(UART_LOG_EVENT_INT_RXSTARTED, pReg);
         nrf_uarte_event_clear(pReg, NRF_UARTE_EVENT_RXSTARTED);
         UART_DETAILED_LOG(UART_LOG_EVENT_WRITE_NEXT_BUFFER_START_PTR,
-                          pUartData->pRxBufferWriteNext->pStart);
+                          pUartData->pRxBufferWriteNext);
         nrf_uarte_rx_buffer_set(pReg,
-                                (uint8_t *) (pUartData->pRxBufferWriteNext->pStart),
+                                (uint8_t *) (pUartData->pRxBufferWriteNext),
                                 CELLULAR_PORT_UART_SUB_BUFFER_SIZE);
-        // Move the write next buffer pointer on
-        pUartData->pRxBufferWriteNext = pUartData->pRxBufferWriteNext->pNext;
+        // Move the write next buffer pointer on, round
+        // the ring of sub-buffers
+        pUartData->pRxBufferWriteNext += CELLULAR_PORT_UART_SUB_BUFFER_SIZE;
+        if (pUartData->pRxBufferWriteNext >= pUartData->pRxStart +
+                                             pUartData->rxBufferSize) {
+            pUartData->pRxBufferWriteNext = pUartData->pRxStart;
+        }
         UART_DETAILED_LOG(UART_LOG_EVENT_WRITE_NEXT_BUFFER_PTR,
                           pUartData->pRxBufferWriteNext);
     } else if (nrf_uarte_event_check(pReg, NRF_UARTE_EVENT_ERROR)) {
@@ -428,6 +544,109 @@ static void rxIrqHandler(CellularPortUartData_t *pUartData)
         nrf_uarte_errorsrc_get_and_clear(pReg);
 #endif
     }
+
+    // Required for FreeRTOS task scheduling to work
+    portYIELD_FROM_ISR(yield);
+}
+
+// Transmit a block of data from DMA-capable memory, the
+// calling task sleeping until the transmission has ended.
+// The UART mutex must be locked before this is called.
+// Returns the number of bytes transmitted.
+static size_t txDma(CellularPortUartData_t *pUartData,
+                    const char *pBuffer, size_t sizeBytes)
+{
+    NRF_UARTE_Type *pReg = pUartData->pReg;
+    CellularPortUartEventData_t uartSizeOrError = 0;
+    int32_t timeoutMs;
+    bool timedOut;
+
+    // Bits per character is ten: start, eight data and stop
+    timeoutMs = (((int32_t) sizeBytes) * 10 * 1000) / pUartData->baudRate +
+                CELLULAR_PORT_UART_TX_TIMEOUT_MARGIN_MS;
+
+    // Make sure there's no stale end-of-transmission
+    // event from a previous timed-out write lying around
+    while (cellularPortQueueTryReceive(pUartData->txQueue, 0,
+                                       &uartSizeOrError) == 0) {}
+
+    UART_DETAILED_LOG(UART_LOG_EVENT_USER_TX_BUFFER, pBuffer);
+    UART_DETAILED_LOG(UART_LOG_EVENT_TX_DATA_SIZE, sizeBytes);
+    nrf_uarte_event_clear(pReg, NRF_UARTE_EVENT_ENDTX);
+    nrf_uarte_tx_buffer_set(pReg, (uint8_t const *) pBuffer, sizeBytes);
+    nrf_uarte_task_trigger(pReg, NRF_UARTE_TASK_STARTTX);
+
+    // Sleep until the interrupt handler says we're done
+    timedOut = (cellularPortQueueTryReceive(pUartData->txQueue, timeoutMs,
+                                            &uartSizeOrError) != 0);
+
+    // Put UARTE into lowest power state; if we timed out
+    // this also stops the transmission
+    nrf_uarte_event_clear(pReg, NRF_UARTE_EVENT_TXSTOPPED);
+    nrf_uarte_task_trigger(pReg, NRF_UARTE_TASK_STOPTX);
+    while (!nrf_uarte_event_check(pReg, NRF_UARTE_EVENT_TXSTOPPED)) {}
+    if (timedOut) {
+        // Report what made it out
+        uartSizeOrError = nrf_uarte_tx_amount_get(pReg);
+    }
+
+    return (size_t) uartSizeOrError;
+}
+
+// Resume reception on a UART suspended by cellularPortUartSuspend().
+// Since there was nothing waiting to be read when the UART was
+// suspended reception starts again from the top of the receive
+// buffer, just as it does at initialisation.  This may be called
+// from task context, with the UART mutex locked, or from the
+// GPIOTE interrupt.
+static void uartResume(CellularPortUartData_t *pUartData)
+{
+    NRF_UARTE_Type *pReg = pUartData->pReg;
+    bool resume;
+
+    NRFX_CRITICAL_SECTION_ENTER();
+    resume = pUartData->suspended;
+    pUartData->suspended = false;
+    NRFX_CRITICAL_SECTION_EXIT();
+
+    if (resume) {
+        // Stop watching the RX pin and hand it back
+        // to the UARTE
+        cellularPortPrivateWakeOnLowDisarm(nrf_uarte_rx_pin_get(pReg));
+        nrf_gpio_cfg_default(nrf_uarte_rx_pin_get(pReg));
+
+        // Start the ring of sub-buffers afresh
+        pUartData->pRxRead = pUartData->pRxStart;
+        pUartData->pRxBufferWriteNext = pUartData->pRxStart;
+        pUartData->startRxByteCount = 0;
+        pUartData->endRxByteCount = 0;
+        nrfx_timer_enable(&(pUartData->timer));
+        nrfx_timer_clear(&(pUartData->timer));
+        nrfx_ppi_channel_enable(pUartData->ppiChannel);
+        cellularPortPrivateTickTimeResume();
+
+        // Enable the UARTE and let it go
+        nrf_uarte_enable(pReg);
+        nrf_uarte_event_clear(pReg, NRF_UARTE_EVENT_ENDRX);
+        nrf_uarte_event_clear(pReg, NRF_UARTE_EVENT_ERROR);
+        nrf_uarte_event_clear(pReg, NRF_UARTE_EVENT_RXSTARTED);
+        nrf_uarte_event_clear(pReg, NRF_UARTE_EVENT_RXTO);
+        nrf_uarte_shorts_enable(pReg, NRF_UARTE_SHORT_ENDRX_STARTRX);
+        nrf_uarte_rx_buffer_set(pReg,
+                                (uint8_t *) (pUartData->pRxBufferWriteNext),
+                                CELLULAR_PORT_UART_SUB_BUFFER_SIZE);
+        pUartData->pRxBufferWriteNext += CELLULAR_PORT_UART_SUB_BUFFER_SIZE;
+        nrf_uarte_task_trigger(pReg, NRF_UARTE_TASK_STARTRX);
+        UART_DETAILED_LOG(UART_LOG_EVENT_WRITE_NEXT_BUFFER_PTR,
+                          pUartData->pRxBufferWriteNext);
+    }
+}
+
+// Callback for the RX pin going low while the UART is suspended.
+// pParameter must be a pointer to CellularPortUartData_t.
+static void wakeCb(void *pParameter)
+{
+    uartResume((CellularPortUartData_t *) pParameter);
 }
 
 // Dummy counter event handler, required by
@@ -567,14 +786,14 @@ static void printDetailedDebug()
 #if !NRFX_UARTE0_ENABLED
 void nrfx_uarte_0_irq_handler(void)
 {
-    rxIrqHandler(&(gUartData[0]));
+    irqHandler(&(gUartData[0]));
 }
 #endif
 
 #if !NRFX_UARTE1_ENABLED
 void nrfx_uarte_1_irq_handler(void)
 {
-    rxIrqHandler(&(gUartData[1]));
+    irqHandler(&(gUartData[1]));
 }
 #endif
 
@@ -612,7 +831,10 @@ int32_t cellularPortUartInit(int32_t pinTx, int32_t pinRx,
     // "The RTS signal will be deactivated when the receiver
     // is stopped via the STOPRX task or when the UARTE is
     // only able to receive four more bytes in its internal
-    // RX FIFO."
+    // RX FIFO."  Since the DMA never stops, RTS cannot follow the
+    // occupancy of the receive buffer either: should the buffer
+    // be overrun that is detected and counted instead, see
+    // cellularPortUartGetStats().
     (void) rtsThreshold;
 
     if ((pUartQueue != NULL) && (pinRx >= 0) && (pinTx >= 0) &&
@@ -681,7 +903,13 @@ int32_t cellularPortUartInit(int32_t pinTx, int32_t pinRx,
                     errorCode = CELLULAR_PORT_OUT_OF_MEMORY;
 
                     // Malloc memory for the read buffer
-                    pRxBuffer = pCellularPort_malloc(CELLULAR_PORT_UART_RX_BUFFER_SIZE);
+                    gUartData[uart].rxBufferSize = gUartData[uart].rxBufferSizeNext;
+                    if (gUartData[uart].rxBufferSize == 0) {
+                        gUartData[uart].rxBufferSize = CELLULAR_PORT_UART_NUM_SUB_BUFFERS *
+                                                       CELLULAR_PORT_UART_SUB_BUFFER_SIZE;
+                    }
+                    pRxBuffer = pCellularPort_mallocTag(gUartData[uart].rxBufferSize,
+                                                        CELLULAR_PORT_MALLOC_TAG_PORT);
                     if (pRxBuffer != NULL) {
                         UART_DETAILED_LOG(UART_LOG_EVENT_RX_BUFFER_MALLOC,
                                           pRxBuffer);
@@ -691,33 +919,22 @@ int32_t cellularPortUartInit(int32_t pinTx, int32_t pinRx,
                         // Set up the read pointer
                         gUartData[uart].pRxRead = pRxBuffer;
                         UART_DETAILED_LOG(UART_LOG_EVENT_READ_PTR, gUartData[uart].pRxRead);
-                        // Set up the buffer list for the DMA write process
-                        for (size_t x = 0; x < sizeof(gUartData[uart].rxBufferList) /
-                                               sizeof(gUartData[uart].rxBufferList[0]); x++) {
-                            UART_DETAILED_LOG(UART_LOG_EVENT_WRITE_NEXT_BUFFER_PTR,
-                                              &(gUartData[uart].rxBufferList[x]));
-                            gUartData[uart].rxBufferList[x].pStart = pRxBuffer;
-                            UART_DETAILED_LOG(UART_LOG_EVENT_WRITE_NEXT_BUFFER_START_PTR,
-                                              gUartData[uart].rxBufferList[x].pStart);
-                            // Set up the next pointers in a ring
-                            if (x < (sizeof(gUartData[uart].rxBufferList) /
-                                     sizeof(gUartData[uart].rxBufferList[0])) - 1) {
-                                gUartData[uart].rxBufferList[x].pNext =  &(gUartData[uart].rxBufferList[x + 1]);
-                            } else {
-                                gUartData[uart].rxBufferList[x].pNext = &(gUartData[uart].rxBufferList[0]);
-                            }
-                            UART_DETAILED_LOG(UART_LOG_EVENT_WRITE_NEXT_BUFFER_NEXT_PTR,
-                                              gUartData[uart].rxBufferList[x].pNext);
-                            pRxBuffer += CELLULAR_PORT_UART_SUB_BUFFER_SIZE;
-                        }
-                        // Set up the write buffer pointer etc.
-                        gUartData[uart].pRxBufferWriteNext = &(gUartData[uart].rxBufferList[0]);
+                        // The DMA writes to the buffer as a ring of
+                        // sub-buffers, starting with the first
+                        gUartData[uart].pRxBufferWriteNext = pRxBuffer;
+                        UART_DETAILED_LOG(UART_LOG_EVENT_WRITE_NEXT_BUFFER_PTR,
+                                          gUartData[uart].pRxBufferWriteNext);
+                        // Start the statistics afresh
+                        pCellularPort_memset(&(gUartData[uart].stats), 0,
+                                             sizeof(gUartData[uart].stats));
+                        gUartData[uart].stats.rxBufferSizeBytes = gUartData[uart].rxBufferSize;
                         gUartData[uart].startRxByteCount = 0;
                         UART_DETAILED_LOG(UART_LOG_EVENT_START_RX_BYTE_COUNT, gUartData[uart].startRxByteCount);
                         gUartData[uart].endRxByteCount = 0;
                         UART_DETAILED_LOG(UART_LOG_EVENT_END_RX_BYTE_COUNT, gUartData[uart].endRxByteCount);
                         gUartData[uart].userNeedsNotify = true;
                         UART_DETAILED_LOG(UART_LOG_EVENT_USER_NEEDS_NOTIFY, gUartData[uart].userNeedsNotify);
+                        gUartData[uart].suspended = false;
 
                         // Create the queue
                         errorCode = cellularPortQueueCreate(CELLULAR_PORT_UART_EVENT_QUEUE_SIZE,
@@ -726,6 +943,18 @@ int32_t cellularPortUartInit(int32_t pinTx, int32_t pinRx,
                         if (errorCode == 0) {
                             gUartData[uart].queue = *pUartQueue;
                             UART_DETAILED_LOG(UART_LOG_EVENT_QUEUE_HANDLE, gUartData[uart].queue);
+                            // Create the queue on which the interrupt
+                            // handler signals the end of a transmission
+                            errorCode = cellularPortQueueCreate(1,
+                                                                sizeof(CellularPortUartEventData_t),
+                                                                &(gUartData[uart].txQueue));
+                            if (errorCode != 0) {
+                                cellularPortQueueDelete(gUartData[uart].queue);
+                                gUartData[uart].queue = NULL;
+                            }
+                        }
+                        if (errorCode == 0) {
+                            gUartData[uart].baudRate = baudRate;
 
                             // Set baud rate
                             nrf_uarte_baudrate_set(pReg, baudRateNrf);
@@ -790,13 +1019,14 @@ int32_t cellularPortUartInit(int32_t pinTx, int32_t pinRx,
 
                             // Off we go
                             nrf_uarte_rx_buffer_set(pReg,
-                                                    (uint8_t *) (gUartData[uart].pRxBufferWriteNext->pStart),
+                                                    (uint8_t *) (gUartData[uart].pRxBufferWriteNext),
                                                     CELLULAR_PORT_UART_SUB_BUFFER_SIZE);
-                            gUartData[uart].pRxBufferWriteNext = gUartData[uart].pRxBufferWriteNext->pNext;
+                            gUartData[uart].pRxBufferWriteNext += CELLULAR_PORT_UART_SUB_BUFFER_SIZE;
                             nrf_uarte_task_trigger(pReg, NRF_UARTE_TASK_STARTRX);
                             nrf_uarte_int_enable(pReg, NRF_UARTE_INT_ENDRX_MASK     |
                                                        NRF_UARTE_INT_ERROR_MASK     |
-                                                       NRF_UARTE_INT_RXSTARTED_MASK);
+                                                       NRF_UARTE_INT_RXSTARTED_MASK |
+                                                       NRF_UARTE_INT_ENDTX_MASK);
                             NRFX_IRQ_PRIORITY_SET(getIrqNumber((void *) pReg),
                                                   NRFX_UARTE_DEFAULT_CONFIG_IRQ_PRIORITY);
                             NRFX_IRQ_ENABLE(getIrqNumber((void *) (pReg)));
@@ -861,6 +1091,10 @@ int32_t cellularPortUartDeinit(int32_t uart)
             // The caller needs to make sure that no read/write
             // is in progress when this function is called.
 
+            // The UARTE must be running for it to be
+            // stopped cleanly below
+            uartResume(&(gUartData[uart]));
+
             // Disable the counter/timer and associated PPI
             // channel.
             nrfx_timer_disable(&(gUartData[uart].timer));
@@ -869,10 +1103,11 @@ int32_t cellularPortUartDeinit(int32_t uart)
             nrfx_ppi_channel_free(gUartData[uart].ppiChannel);
             gUartData[uart].ppiChannel = -1;
 
-            // Disable Rx interrupts
+            // Disable interrupts
             nrf_uarte_int_disable(pReg, NRF_UARTE_INT_ENDRX_MASK     |
                                         NRF_UARTE_INT_ERROR_MASK     |
-                                        NRF_UARTE_INT_RXSTARTED_MASK);
+                                        NRF_UARTE_INT_RXSTARTED_MASK |
+                                        NRF_UARTE_INT_ENDTX_MASK);
             NRFX_IRQ_DISABLE(nrfx_get_irq_number((void *) (pReg)));
 
             // Deregister the timer callback and 
@@ -914,9 +1149,11 @@ int32_t cellularPortUartDeinit(int32_t uart)
             UART_DETAILED_LOG(UART_LOG_EVENT_START_PTR,
                               gUartData[uart].pRxStart);
 
-            // Delete the queue
+            // Delete the queues
             cellularPortQueueDelete(gUartData[uart].queue);
             gUartData[uart].queue = NULL;
+            cellularPortQueueDelete(gUartData[uart].txQueue);
+            gUartData[uart].txQueue = NULL;
             // Free the buffer
             cellularPort_free(gUartData[uart].pRxStart);
             // Delete the mutex
@@ -1009,6 +1246,7 @@ int32_t cellularPortUartGetReceiveSize(int32_t uart)
 
             CELLULAR_PORT_MUTEX_LOCK(gUartData[uart].mutex);
 
+            uartRxOverrunCheck(&(gUartData[uart]));
             sizeOrErrorCode = uartGetRxBytes(&(gUartData[uart]));
             UART_DETAILED_LOG(UART_LOG_EVENT_RX_DATA_SIZE, sizeOrErrorCode);
             if (sizeOrErrorCode == 0) {
@@ -1046,11 +1284,14 @@ int32_t cellularPortUartRead(int32_t uart, char *pBuffer,
             CELLULAR_PORT_MUTEX_LOCK(gUartData[uart].mutex);
 
             // The user can't read more than 
-            // CELLULAR_PORT_UART_RX_BUFFER_SIZE
-            if (sizeBytes > CELLULAR_PORT_UART_RX_BUFFER_SIZE) {
-                sizeBytes = CELLULAR_PORT_UART_RX_BUFFER_SIZE;
+            // the size of the receive buffer
+            if (sizeBytes > gUartData[uart].rxBufferSize) {
+                sizeBytes = gUartData[uart].rxBufferSize;
             }
 
+            // Lose anything that has been overwritten
+            uartRxOverrunCheck(&(gUartData[uart]));
+
             // Get the number of bytes available to read
             totalRead = uartGetRxBytes(&(gUartData[uart]));
             if (totalRead > sizeBytes) {
@@ -1061,7 +1302,7 @@ int32_t cellularPortUartRead(int32_t uart, char *pBuffer,
             // stopping at the end of the buffer or
             // totalRead, whichever comes first
             thisRead = gUartData[uart].pRxStart +
-                       CELLULAR_PORT_UART_RX_BUFFER_SIZE
+                       gUartData[uart].rxBufferSize
                        - gUartData[uart].pRxRead;
             if (thisRead > totalRead) {
                 thisRead = totalRead;
@@ -1074,7 +1315,7 @@ int32_t cellularPortUartRead(int32_t uart, char *pBuffer,
                                  thisRead);
             gUartData[uart].pRxRead += thisRead;
             if (gUartData[uart].pRxRead >= gUartData[uart].pRxStart +
-                                          CELLULAR_PORT_UART_RX_BUFFER_SIZE) {
+                                          gUartData[uart].rxBufferSize) {
                 gUartData[uart].pRxRead = gUartData[uart].pRxStart;
             }
 
@@ -1084,7 +1325,7 @@ int32_t cellularPortUartRead(int32_t uart, char *pBuffer,
                 UART_DETAILED_LOG(UART_LOG_EVENT_READ_PTR,
                                   gUartData[uart].pRxRead);
                 UART_DETAILED_LOG(UART_LOG_EVENT_RX_DATA_SIZE, thisRead);
-                pCellularPort_memcpy(pBuffer,
+                pCellularPort_memcpy(pBuffer + totalRead - thisRead,
                                      gUartData[uart].pRxRead,
                                      thisRead);
                 gUartData[uart].pRxRead += thisRead;
@@ -1117,14 +1358,95 @@ int32_t cellularPortUartRead(int32_t uart, char *pBuffer,
     return (int32_t) sizeOrErrorCode;
 }
 
+// Get a pointer to the data waiting in the receive buffer.
+int32_t cellularPortUartReadSpan(int32_t uart, const char **ppData)
+{
+    CellularPortErrorCode_t sizeOrErrorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    size_t thisRead;
+
+    if ((ppData != NULL) &&
+        (uart < sizeof(gUartData) / sizeof(gUartData[0]))) {
+        sizeOrErrorCode = CELLULAR_PORT_NOT_INITIALISED;
+        if (gUartData[uart].mutex != NULL) {
+
+            CELLULAR_PORT_MUTEX_LOCK(gUartData[uart].mutex);
+
+            // Lose anything that has been overwritten
+            uartRxOverrunCheck(&(gUartData[uart]));
+
+            // Offer from the read pointer onwards,
+            // stopping at the end of the buffer or
+            // the number of bytes available, whichever
+            // comes first
+            thisRead = gUartData[uart].pRxStart +
+                       gUartData[uart].rxBufferSize
+                       - gUartData[uart].pRxRead;
+            sizeOrErrorCode = uartGetRxBytes(&(gUartData[uart]));
+            if (sizeOrErrorCode > thisRead) {
+                sizeOrErrorCode = thisRead;
+            }
+            *ppData = gUartData[uart].pRxRead;
+            UART_DETAILED_LOG(UART_LOG_EVENT_READ_PTR,
+                              gUartData[uart].pRxRead);
+            UART_DETAILED_LOG(UART_LOG_EVENT_RX_DATA_SIZE, sizeOrErrorCode);
+
+            CELLULAR_PORT_MUTEX_UNLOCK(gUartData[uart].mutex);
+        }
+    }
+
+    return (int32_t) sizeOrErrorCode;
+}
+
+// Mark data obtained through cellularPortUartReadSpan() as read.
+int32_t cellularPortUartReadCommit(int32_t uart, size_t sizeBytes)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+
+    if (uart < sizeof(gUartData) / sizeof(gUartData[0])) {
+        errorCode = CELLULAR_PORT_NOT_INITIALISED;
+        if (gUartData[uart].mutex != NULL) {
+
+            CELLULAR_PORT_MUTEX_LOCK(gUartData[uart].mutex);
+
+            errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+            if (sizeBytes <= uartGetRxBytes(&(gUartData[uart]))) {
+                // Move the read pointer on, wrapping as necessary
+                gUartData[uart].pRxRead += sizeBytes;
+                if (gUartData[uart].pRxRead >= gUartData[uart].pRxStart +
+                                              gUartData[uart].rxBufferSize) {
+                    gUartData[uart].pRxRead -= gUartData[uart].rxBufferSize;
+                }
+                // Update the starting number for the byte count
+                gUartData[uart].startRxByteCount += sizeBytes;
+                UART_DETAILED_LOG(UART_LOG_EVENT_START_RX_BYTE_COUNT,
+                                  gUartData[uart].startRxByteCount);
+                // Set the notify flag if everything
+                // has now been read
+                gUartData[uart].userNeedsNotify = false;
+                if (uartGetRxBytes(&(gUartData[uart])) == 0) {
+                    gUartData[uart].userNeedsNotify = true;
+                    UART_DETAILED_LOG(UART_LOG_EVENT_USER_NEEDS_NOTIFY,
+                                      gUartData[uart].userNeedsNotify);
+                }
+                errorCode = CELLULAR_PORT_SUCCESS;
+            }
+
+            CELLULAR_PORT_MUTEX_UNLOCK(gUartData[uart].mutex);
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
 // Write to the given UART interface.
 int32_t cellularPortUartWrite(int32_t uart,
                               const char *pBuffer,
                               size_t sizeBytes)
 {
     CellularPortErrorCode_t sizeOrErrorCode = CELLULAR_PORT_INVALID_PARAMETER;
-    const char *pTxBuffer = NULL;
-    char *pTmpBuffer = NULL;
+    bool goodForDma;
+    size_t thisSize;
+    size_t sentSize;
     NRF_UARTE_Type *pReg;
 
     UART_DETAILED_LOG(UART_LOG_EVENT_API_WRITE_START, uart);
@@ -1136,53 +1458,80 @@ int32_t cellularPortUartWrite(int32_t uart,
 
             CELLULAR_PORT_MUTEX_LOCK(gUartData[uart].mutex);
 
-            sizeOrErrorCode = CELLULAR_PORT_OUT_OF_MEMORY;
             pReg = gUartData[uart].pReg;
 
             UART_DETAILED_LOG(UART_LOG_EVENT_REG, pReg);
 
+            // Can't transmit if the UARTE is suspended
+            uartResume(&(gUartData[uart]));
+
             // If the provided buffer is not good for
-            // DMA (e.g. if it's in flash) then copy
-            // it to somewhere that is
-            if (!isGoodForDma(pBuffer)) {
-                pTmpBuffer = pCellularPort_malloc(sizeBytes);
-                if (pTmpBuffer != NULL) {
-                    pCellularPort_memcpy(pTmpBuffer, pBuffer, sizeBytes);
-                    pTxBuffer = pTmpBuffer;
+            // DMA (e.g. if it's in flash) then it is sent
+            // in chunks through the bounce buffer, else
+            // it is sent directly.  Either way the
+            // transmission is interrupt-completed, this
+            // task sleeping while it is in progress.
+            goodForDma = isGoodForDma(pBuffer);
+            sizeOrErrorCode = 0;
+            thisSize = 0;
+            sentSize = 0;
+            while ((sizeBytes > 0) && (sentSize == thisSize)) {
+                if (goodForDma) {
+                    thisSize = sizeBytes;
+                    if (thisSize > CELLULAR_PORT_UART_TX_DMA_MAX_LENGTH) {
+                        thisSize = CELLULAR_PORT_UART_TX_DMA_MAX_LENGTH;
+                    }
+                    sentSize = txDma(&(gUartData[uart]), pBuffer, thisSize);
+                } else {
+                    thisSize = sizeBytes;
+                    if (thisSize > sizeof(gTxBounceBuffer[uart])) {
+                        thisSize = sizeof(gTxBounceBuffer[uart]);
+                    }
+                    pCellularPort_memcpy(gTxBounceBuffer[uart], pBuffer, thisSize);
+                    sentSize = txDma(&(gUartData[uart]),
+                                     gTxBounceBuffer[uart], thisSize);
                 }
-            } else {
-                pTxBuffer = pBuffer;
+                pBuffer += sentSize;
+                sizeBytes -= sentSize;
+                sizeOrErrorCode += sentSize;
             }
 
-            if (pTxBuffer != NULL) {
-                // Set up the flags
-                nrf_uarte_event_clear(pReg, NRF_UARTE_EVENT_ENDTX);
-                nrf_uarte_event_clear(pReg, NRF_UARTE_EVENT_TXSTOPPED);
-                UART_DETAILED_LOG(UART_LOG_EVENT_USER_TX_BUFFER, pTxBuffer);
-                UART_DETAILED_LOG(UART_LOG_EVENT_TX_DATA_SIZE, sizeBytes);
-                nrf_uarte_tx_buffer_set(pReg, (uint8_t const *) pTxBuffer, sizeBytes);
-                nrf_uarte_task_trigger(pReg, NRF_UARTE_TASK_STARTTX);
+            CELLULAR_PORT_MUTEX_UNLOCK(gUartData[uart].mutex);
+        }
+    }
+
+    UART_DETAILED_LOG(UART_LOG_EVENT_API_WRITE_END, sizeOrErrorCode);
+
+    return (int32_t) sizeOrErrorCode;
+}
 
-                // Wait for the transmission to complete
-                while (!nrf_uarte_event_check(pReg, NRF_UARTE_EVENT_ENDTX)) {}
+// Change the baud rate of the given UART interface.
+int32_t cellularPortUartSetBaudRate(int32_t uart,
+                                    int32_t baudRate)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    int32_t baudRateNrf = baudRateToNrfBaudRate(baudRate);
 
-                // Put UARTE into lowest power state.
-                nrf_uarte_task_trigger(pReg, NRF_UARTE_TASK_STOPTX);
-                while (!nrf_uarte_event_check(pReg, NRF_UARTE_EVENT_TXSTOPPED)) {}
+    if ((baudRateNrf >= 0) &&
+        (uart < sizeof(gUartData) / sizeof(gUartData[0]))) {
+        errorCode = CELLULAR_PORT_NOT_INITIALISED;
+        if (gUartData[uart].mutex != NULL) {
 
-                sizeOrErrorCode = sizeBytes;
-            }
+            CELLULAR_PORT_MUTEX_LOCK(gUartData[uart].mutex);
 
-            // Free memory (it is valid C to free a NULL buffer)
-            cellularPort_free(pTmpBuffer);
+            // Transmission is complete by the time
+            // the mutex is released by a write, so
+            // the rate can be changed here; reception
+            // carries on with the same buffers
+            nrf_uarte_baudrate_set(gUartData[uart].pReg, baudRateNrf);
+            gUartData[uart].baudRate = baudRate;
+            errorCode = CELLULAR_PORT_SUCCESS;
 
             CELLULAR_PORT_MUTEX_UNLOCK(gUartData[uart].mutex);
         }
     }
 
-    UART_DETAILED_LOG(UART_LOG_EVENT_API_WRITE_END, sizeOrErrorCode);
-
-    return (int32_t) sizeOrErrorCode;
+    return (int32_t) errorCode;
 }
 
 // Determine if RTS flow control is enabled.
@@ -1245,4 +1594,159 @@ bool cellularPortIsCtsFlowControlEnabled(int32_t uart)
     return ctsFlowControlIsEnabled;
 }
 
+// Set the receive buffer size for the next initialisation of a UART.
+int32_t cellularPortUartSetRxBufferSize(int32_t uart,
+                                        size_t sizeBytes)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+
+    // The receive buffer must be a whole number of
+    // sub-buffers and there must be at least two of them
+    sizeBytes -= sizeBytes % CELLULAR_PORT_UART_SUB_BUFFER_SIZE;
+    if ((uart < sizeof(gUartData) / sizeof(gUartData[0])) &&
+        (gUartData[uart].mutex == NULL) &&
+        ((sizeBytes == 0) ||
+         (sizeBytes >= CELLULAR_PORT_UART_SUB_BUFFER_SIZE * 2))) {
+        gUartData[uart].rxBufferSizeNext = sizeBytes;
+        errorCode = CELLULAR_PORT_SUCCESS;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Get the receive statistics of a UART.
+int32_t cellularPortUartGetStats(int32_t uart,
+                                 CellularPortUartStats_t *pStats)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+
+    if ((pStats != NULL) &&
+        (uart < sizeof(gUartData) / sizeof(gUartData[0]))) {
+        errorCode = CELLULAR_PORT_NOT_INITIALISED;
+        if (gUartData[uart].mutex != NULL) {
+
+            CELLULAR_PORT_MUTEX_LOCK(gUartData[uart].mutex);
+
+            // Bring the overrun count up to date
+            uartRxOverrunCheck(&(gUartData[uart]));
+            *pStats = gUartData[uart].stats;
+            errorCode = CELLULAR_PORT_SUCCESS;
+
+            CELLULAR_PORT_MUTEX_UNLOCK(gUartData[uart].mutex);
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Reset the receive statistics of a UART.
+int32_t cellularPortUartResetStats(int32_t uart)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+
+    if (uart < sizeof(gUartData) / sizeof(gUartData[0])) {
+        errorCode = CELLULAR_PORT_NOT_INITIALISED;
+        if (gUartData[uart].mutex != NULL) {
+
+            CELLULAR_PORT_MUTEX_LOCK(gUartData[uart].mutex);
+
+            gUartData[uart].stats.rxHighWaterMarkBytes = 0;
+            gUartData[uart].stats.rxOverruns = 0;
+            gUartData[uart].stats.rxBytesLost = 0;
+            errorCode = CELLULAR_PORT_SUCCESS;
+
+            CELLULAR_PORT_MUTEX_UNLOCK(gUartData[uart].mutex);
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Suspend a UART.
+int32_t cellularPortUartSuspend(int32_t uart)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortUartData_t *pUartData;
+    NRF_UARTE_Type *pReg;
+    uint32_t pinRx;
+    size_t x;
+
+    if (uart < sizeof(gUartData) / sizeof(gUartData[0])) {
+        errorCode = CELLULAR_PORT_NOT_INITIALISED;
+        pUartData = &(gUartData[uart]);
+        if (pUartData->mutex != NULL) {
+
+            CELLULAR_PORT_MUTEX_LOCK(pUartData->mutex);
+
+            errorCode = CELLULAR_PORT_SUCCESS;
+            if (!pUartData->suspended) {
+                pReg = pUartData->pReg;
+                // Can only suspend if everything has been read
+                errorCode = CELLULAR_PORT_PLATFORM_ERROR;
+                uartRxOverrunCheck(pUartData);
+                if (uartGetRxBytes(pUartData) == 0) {
+                    // Stop reception, waiting for the UARTE
+                    // to let go of the current sub-buffer
+                    nrf_uarte_shorts_disable(pReg, NRF_UARTE_SHORT_ENDRX_STARTRX);
+                    nrf_uarte_event_clear(pReg, NRF_UARTE_EVENT_RXTO);
+                    nrf_uarte_task_trigger(pReg, NRF_UARTE_TASK_STOPRX);
+                    while (!nrf_uarte_event_check(pReg, NRF_UARTE_EVENT_RXTO)) {}
+                    // Anything that slipped in while reception was
+                    // being stopped can't be kept since reception
+                    // will resume from the top of the buffer
+                    x = uartGetRxBytesRaw(pUartData);
+                    if (x > 0) {
+                        pUartData->stats.rxBytesLost += x;
+                    }
+
+                    // Transmission is always stopped at the end of
+                    // a write, so the UARTE can now be disabled,
+                    // along with the counter/timer and PPI channel
+                    nrf_uarte_disable(pReg);
+                    nrfx_ppi_channel_disable(pUartData->ppiChannel);
+                    nrfx_timer_disable(&(pUartData->timer));
+                    cellularPortPrivateTickTimeSuspend();
+                    pUartData->userNeedsNotify = true;
+                    pUartData->suspended = true;
+
+                    // Watch the RX pin, which idles high, for the
+                    // start bit of a character from the far end
+                    pinRx = nrf_uarte_rx_pin_get(pReg);
+                    nrf_gpio_cfg_input(pinRx, NRF_GPIO_PIN_NOPULL);
+                    errorCode = cellularPortPrivateWakeOnLowArm(pinRx, wakeCb,
+                                                                pUartData);
+                    if (errorCode != 0) {
+                        uartResume(pUartData);
+                    }
+                }
+            }
+
+            CELLULAR_PORT_MUTEX_UNLOCK(pUartData->mutex);
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Resume a suspended UART.
+int32_t cellularPortUartResume(int32_t uart)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+
+    if (uart < sizeof(gUartData) / sizeof(gUartData[0])) {
+        errorCode = CELLULAR_PORT_NOT_INITIALISED;
+        if (gUartData[uart].mutex != NULL) {
+
+            CELLULAR_PORT_MUTEX_LOCK(gUartData[uart].mutex);
+
+            uartResume(&(gUartData[uart]));
+            errorCode = CELLULAR_PORT_SUCCESS;
+
+            CELLULAR_PORT_MUTEX_UNLOCK(gUartData[uart].mutex);
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
 // End of file
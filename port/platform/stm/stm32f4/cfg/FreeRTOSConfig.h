@@ -56,11 +56,15 @@
 #define configUSE_PREEMPTION              1
 #define configUSE_IDLE_HOOK               0
 #define configUSE_TICK_HOOK               0
-#define configUSE_TICKLESS_IDLE           0
+#define configUSE_TICKLESS_IDLE           1
 // If you change this you must change CELLULAR_PORT_OS_PRIORITY_MAX
 // in cellular_cfg_os_platform_specific.h to match.
 #define configMAX_PRIORITIES              (15)
-#define configSUPPORT_STATIC_ALLOCATION   0
+#if defined(CELLULAR_CFG_STATIC_ALLOC) && CELLULAR_CFG_STATIC_ALLOC
+# define configSUPPORT_STATIC_ALLOCATION  1
+#else
+# define configSUPPORT_STATIC_ALLOCATION  0
+#endif
 #define configCPU_CLOCK_HZ                (SystemCoreClock)
 #define configTICK_RATE_HZ                ((TickType_t) 1000)
 #define configMINIMAL_STACK_SIZE          ((uint16_t) 128)
@@ -100,6 +104,7 @@ to exclude the API function. */
 #define INCLUDE_vTaskDelayUntil        0
 #define INCLUDE_vTaskDelay             1
 #define INCLUDE_xTaskGetSchedulerState 1
+#define INCLUDE_uxTaskGetStackHighWaterMark 1
 
  /*------------- CMSIS-RTOS V2 specific defines -----------*/
 /* When using CMSIS-RTOSv2 set configSUPPORT_STATIC_ALLOCATION to 1
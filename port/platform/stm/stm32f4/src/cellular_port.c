@@ -20,6 +20,8 @@
 #include "cellular_cfg_hw_platform_specific.h"
 #include "cellular_port_clib.h"
 #include "cellular_port.h"
+#include "cellular_port_debug.h"
+#include "cellular_port_os.h"
 #include "cellular_port_gpio.h"
 
 #include "stm32f437xx.h"
@@ -165,7 +167,13 @@ int32_t cellularPortInit()
     CellularPortErrorCode_t errorCode = CELLULAR_PORT_SUCCESS;
 
     if (!gInitialised) {
-        errorCode = cellularPortPrivateInit();
+        errorCode = cellularPortMallocInit();
+        if (errorCode == 0) {
+            errorCode = cellularPortPrivateInit();
+        }
+        if (errorCode == 0) {
+            errorCode = cellularPortLogDeferredInit();
+        }
         gInitialised = (errorCode == 0);
     }
 
@@ -176,6 +184,7 @@ int32_t cellularPortInit()
 void cellularPortDeinit()
 {
     if (gInitialised) {
+        cellularPortLogDeferredDeinit();
         cellularPortPrivateDeinit();
         gInitialised = false;
     }
@@ -184,7 +193,7 @@ void cellularPortDeinit()
 // Get the current tick converted to a time in milliseconds.
 int64_t cellularPortGetTickTimeMs()
 {
-    int32_t tickTime = 0;
+    int64_t tickTime = 0;
 
     if (gInitialised) {
         tickTime = cellularPortPrivateGetTickTimeMs();
@@ -193,4 +202,27 @@ int64_t cellularPortGetTickTimeMs()
     return tickTime;
 }
 
+// Store a block of data in non-volatile storage.
+int32_t cellularPortNvStore(int32_t id, const void *pData,
+                            size_t size)
+{
+    (void) id;
+    (void) pData;
+    (void) size;
+
+    // Nowhere set aside for this on this platform
+    return CELLULAR_PORT_NOT_IMPLEMENTED;
+}
+
+// Retrieve a block of data from non-volatile storage.
+int32_t cellularPortNvRetrieve(int32_t id, void *pData,
+                               size_t size)
+{
+    (void) id;
+    (void) pData;
+    (void) size;
+
+    return CELLULAR_PORT_NOT_IMPLEMENTED;
+}
+
 // End of file
@@ -19,17 +19,24 @@
 #endif
 #include "cellular_port_clib.h"
 #include "cellular_port.h"
+#include "cellular_port_os.h"
 #include "cellular_port_gpio.h"
 
 #include "stm32f4xx_hal.h"
 #include "stm32f4xx_hal_gpio.h"
 
+#include "cmsis_os.h"
+
 #include "cellular_port_private.h" // Down here 'cos it needs GPIO_TypeDef
 
 /* ----------------------------------------------------------------
  * COMPILE-TIME MACROS
  * -------------------------------------------------------------- */
 
+// The number of EXTI lines that serve GPIOs: line n is shared
+// by pin n of every port.
+#define CELLULAR_PORT_GPIO_EXTI_NUM_LINES 16
+
 /* ----------------------------------------------------------------
  * TYPES
  * -------------------------------------------------------------- */
@@ -38,10 +45,58 @@
  * VARIABLES
  * -------------------------------------------------------------- */
 
+// The pin that each EXTI line is interrupting for.
+static int32_t gExtiPin[CELLULAR_PORT_GPIO_EXTI_NUM_LINES] = {0};
+
+// The queue that each EXTI line sends interrupts to, NULL
+// if the line is not in use.
+static CellularPortQueueHandle_t gExtiQueue[CELLULAR_PORT_GPIO_EXTI_NUM_LINES] = {0};
+
+// The interrupt that serves each EXTI line.
+static const IRQn_Type gExtiIrq[CELLULAR_PORT_GPIO_EXTI_NUM_LINES] = {EXTI0_IRQn,
+                                                                      EXTI1_IRQn,
+                                                                      EXTI2_IRQn,
+                                                                      EXTI3_IRQn,
+                                                                      EXTI4_IRQn,
+                                                                      EXTI9_5_IRQn,
+                                                                      EXTI9_5_IRQn,
+                                                                      EXTI9_5_IRQn,
+                                                                      EXTI9_5_IRQn,
+                                                                      EXTI9_5_IRQn,
+                                                                      EXTI15_10_IRQn,
+                                                                      EXTI15_10_IRQn,
+                                                                      EXTI15_10_IRQn,
+                                                                      EXTI15_10_IRQn,
+                                                                      EXTI15_10_IRQn,
+                                                                      EXTI15_10_IRQn};
+
 /* ----------------------------------------------------------------
  * STATIC FUNCTIONS
  * -------------------------------------------------------------- */
 
+// Handle the pending EXTI lines from firstLine to lastLine,
+// called in interrupt context.
+static void extiIrqHandler(int32_t firstLine, int32_t lastLine)
+{
+    BaseType_t yield = false;
+    uint32_t mask;
+
+    for (int32_t line = firstLine; line <= lastLine; line++) {
+        mask = 1U << line;
+        if (EXTI->PR & mask) {
+            // Writing 1 clears it
+            EXTI->PR = mask;
+            if (gExtiQueue[line] != NULL) {
+                xQueueSendFromISR((QueueHandle_t) gExtiQueue[line],
+                                  &(gExtiPin[line]), &yield);
+            }
+        }
+    }
+
+    // Required for correct FreeRTOS operation
+    portEND_SWITCHING_ISR(yield);
+}
+
 /* ----------------------------------------------------------------
  * PUBLIC FUNCTIONS
  * -------------------------------------------------------------- */
@@ -144,4 +199,110 @@ int32_t cellularPortGpioGet(int32_t pin)
                             1U << CELLULAR_PORT_STM32F4_GPIO_PIN(pin));
 }
 
+// Set or remove an interrupt on a GPIO.
+// EXTI line n is shared by pin n of all ports so only one of
+// them can have an interrupt at a time.  EXTI also wakes the
+// chip from Stop mode.
+int32_t cellularPortGpioInterruptSet(int32_t pin,
+                                     CellularPortGpioInterrupt_t interrupt,
+                                     CellularPortQueueHandle_t queueHandle)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    int32_t line = CELLULAR_PORT_STM32F4_GPIO_PIN(pin);
+    GPIO_TypeDef *pReg;
+    GPIO_InitTypeDef config = {0};
+
+    if ((pin >= 0) &&
+        (interrupt < MAX_NUM_CELLULAR_PORT_GPIO_INTERRUPTS) &&
+        ((queueHandle != NULL) ||
+         (interrupt == CELLULAR_PORT_GPIO_INTERRUPT_NONE)) &&
+        ((gExtiQueue[line] == NULL) || (gExtiPin[line] == pin))) {
+        errorCode = CELLULAR_PORT_SUCCESS;
+        // Out with the old
+        EXTI->IMR &= ~(1U << line);
+        EXTI->RTSR &= ~(1U << line);
+        EXTI->FTSR &= ~(1U << line);
+        gExtiQueue[line] = NULL;
+        if (interrupt != CELLULAR_PORT_GPIO_INTERRUPT_NONE) {
+            switch (interrupt) {
+                case CELLULAR_PORT_GPIO_INTERRUPT_RISING_EDGE:
+                    config.Mode = GPIO_MODE_IT_RISING;
+                break;
+                case CELLULAR_PORT_GPIO_INTERRUPT_FALLING_EDGE:
+                    config.Mode = GPIO_MODE_IT_FALLING;
+                break;
+                default:
+                    config.Mode = GPIO_MODE_IT_RISING_FALLING;
+                break;
+            }
+            cellularPortPrivateGpioEnableClock(pin);
+            // The SYSCFG clock is needed to route the line
+            __HAL_RCC_SYSCFG_CLK_ENABLE();
+            pReg = pCellularPortPrivateGpioGetReg(pin);
+            config.Pin = 1U << line;
+            // Keep whatever pull cellularPortGpioConfig() set
+            config.Pull = (pReg->PUPDR >> (line * 2)) & 0x03;
+            config.Speed = GPIO_SPEED_FREQ_LOW;
+            gExtiPin[line] = pin;
+            gExtiQueue[line] = queueHandle;
+            // Don't let an edge from before now through
+            EXTI->PR = 1U << line;
+            HAL_GPIO_Init(pReg, &config);
+            // Same priority as the UART, low enough to be
+            // allowed to call FreeRTOS
+            NVIC_SetPriority(gExtiIrq[line],
+                             NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 5, 0));
+            NVIC_EnableIRQ(gExtiIrq[line]);
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS: INTERRUPT HANDLERS
+ * -------------------------------------------------------------- */
+
+// EXTI line 0 interrupt handler.
+void EXTI0_IRQHandler()
+{
+    extiIrqHandler(0, 0);
+}
+
+// EXTI line 1 interrupt handler.
+void EXTI1_IRQHandler()
+{
+    extiIrqHandler(1, 1);
+}
+
+// EXTI line 2 interrupt handler.
+void EXTI2_IRQHandler()
+{
+    extiIrqHandler(2, 2);
+}
+
+// EXTI line 3 interrupt handler.
+void EXTI3_IRQHandler()
+{
+    extiIrqHandler(3, 3);
+}
+
+// EXTI line 4 interrupt handler.
+void EXTI4_IRQHandler()
+{
+    extiIrqHandler(4, 4);
+}
+
+// EXTI lines 5 to 9 interrupt handler.
+void EXTI9_5_IRQHandler()
+{
+    extiIrqHandler(5, 9);
+}
+
+// EXTI lines 10 to 15 interrupt handler.
+void EXTI15_10_IRQHandler()
+{
+    extiIrqHandler(10, 15);
+}
+
 // End of file
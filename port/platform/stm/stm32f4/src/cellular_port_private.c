@@ -20,6 +20,9 @@
 #include "cellular_port_clib.h"
 #include "cellular_port.h"
 
+#include "FreeRTOS.h"
+#include "task.h"
+
 #include "stm32f4xx_hal.h"
 #include "stm32f4xx_ll_bus.h"
 
@@ -37,10 +40,6 @@
  * VARIABLES
  * -------------------------------------------------------------- */
 
-// Counter to keep track of RTOS ticks: NOT static
-// so that the stm32f4xx_it.c can update it.
-int32_t gTickTimerRtosCount;
-
 // Get the GPIOx address for a given GPIO port.
 static GPIO_TypeDef * const gpGpioReg[] = {GPIOA,
                                            GPIOB,
@@ -78,7 +77,6 @@ static const int32_t gLlApbGrpPeriphGpioPort[] = {LL_AHB1_GRP1_PERIPH_GPIOA,
 // Initalise the private stuff.
 int32_t cellularPortPrivateInit()
 {
-    gTickTimerRtosCount = 0;
     return CELLULAR_PORT_SUCCESS;
 }
 
@@ -95,7 +93,18 @@ void cellularPortPrivateDeinit()
 // Get the current tick converted to a time in milliseconds.
 int64_t cellularPortPrivateGetTickTimeMs()
 {
-    return gTickTimerRtosCount;
+    TimeOut_t timeOut;
+    int64_t tickTime;
+
+    // FreeRTOS steps the tick count on to make up for a
+    // tickless idle period; the time-out state is a
+    // consistent snapshot of the tick count and the number
+    // of times it has wrapped
+    vTaskSetTimeOutState(&timeOut);
+    tickTime = (((int64_t) timeOut.xOverflowCount) << 32) +
+               (uint32_t) timeOut.xTimeOnEntering;
+
+    return tickTime * 1000 / configTICK_RATE_HZ;
 }
 
 /* ----------------------------------------------------------------
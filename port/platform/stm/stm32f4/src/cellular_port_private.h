@@ -53,6 +53,8 @@ int32_t cellularPortPrivateInit();
 void cellularPortPrivateDeinit();
 
 /** Get the current OS tick converted to a time in milliseconds.
+ * This is the FreeRTOS tick, which is kept across tickless idle;
+ * it must not be called from interrupt context.
  */
 int64_t cellularPortPrivateGetTickTimeMs();
 
@@ -26,6 +26,7 @@
 #include "cellular_port_uart.h"
 
 #include "stm32f4xx_ll_bus.h"
+#include "stm32f4xx_ll_rcc.h"
 #include "stm32f4xx_ll_gpio.h"
 #include "stm32f4xx_ll_dma.h"
 #include "stm32f4xx_ll_usart.h"
@@ -91,19 +92,35 @@ typedef struct CellularPortUartConstData_t {
     IRQn_Type irq;
 } CellularPortUartConstData_t;
 
-/** Structure of the data per UART.
+/** Structure of the data per UART.  The receive buffer is
+ * a single-producer/single-consumer ring: pRxBufferWrite is
+ * only ever written by the interrupt handlers and
+ * pRxBufferRead is only ever written by the (single) reader,
+ * hence no mutex is required on the receive path.
  */
 typedef struct CellularPortUartData_t {
     int32_t number;
     const CellularPortUartConstData_t * pConstData;
-    CellularPortMutexHandle_t mutex;
+    CellularPortMutexHandle_t mutex; //!< protects transmit only.
     CellularPortQueueHandle_t queue;
+    size_t rxBufferSize;
     char *pRxBufferStart;
     char *pRxBufferRead;
     volatile char *pRxBufferWrite;
-    bool userNeedsNotify; //!< set this if toRead has hit zero and
-                          // hence the user would like a notification
-                          // when new data arrives.
+    volatile bool userNeedsNotify; //!< set by the reader when the
+                                   // ring has been emptied and
+                                   // hence the user would like a
+                                   // notification when new data
+                                   // arrives; cleared by whoever
+                                   // sends that notification, so
+                                   // that there is at most one
+                                   // event outstanding.
+    volatile bool rxOverrun; //!< set by the interrupt handlers
+                             // when data has arrived faster
+                             // than it was read and so the
+                             // DMA has written over unread
+                             // data; cleared by the reader.
+    CellularPortUartStats_t stats;
     struct CellularPortUartData_t *pNext;
 } CellularPortUartData_t;
 
@@ -316,6 +333,10 @@ static CellularPortUartData_t *gpUart[CELLULAR_PORT_MAX_NUM_UARTS + 1] = {NULL};
 static CellularPortUartData_t *gpDmaUart[(CELLULAR_PORT_MAX_NUM_DMA_ENGINES + 1) *
                                           CELLULAR_PORT_MAX_NUM_DMA_STREAMS] = {NULL};
 
+// The receive buffer size for each UART, zero meaning
+// CELLULAR_PORT_UART_RX_BUFFER_SIZE.  +1 is for the usual reason.
+static size_t gRxBufferSize[CELLULAR_PORT_MAX_NUM_UARTS + 1] = {0};
+
 /* ----------------------------------------------------------------
  * STATIC FUNCTIONS
  * -------------------------------------------------------------- */
@@ -333,7 +354,8 @@ static CellularPortUartData_t *pAddUart(int32_t uart,
     }
 
     // Malloc memory for the item
-    *ppUartData = (CellularPortUartData_t *) pCellularPort_malloc(sizeof(CellularPortUartData_t));
+    *ppUartData = (CellularPortUartData_t *) pCellularPort_mallocTag(sizeof(CellularPortUartData_t),
+                                                                     CELLULAR_PORT_MALLOC_TAG_PORT);
     if (*ppUartData != NULL) {
         // Copy the data in
         pCellularPort_memcpy(*ppUartData, pUartData, sizeof(CellularPortUartData_t));
@@ -404,12 +426,86 @@ static bool removeUart(int32_t uart)
     return found;
 }
 
+// Get the number of bytes in the receive ring between the
+// read pointer and the given write pointer.
+static inline size_t rxBufferCount(const CellularPortUartData_t *pUartData,
+                                   const char *pRxBufferWrite)
+{
+    size_t count = 0;
+
+    if (pUartData->pRxBufferRead < pRxBufferWrite) {
+        // Read pointer is behind write, bytes
+        // received is simply the difference
+        count = pRxBufferWrite - pUartData->pRxBufferRead;
+    } else if (pUartData->pRxBufferRead > pRxBufferWrite) {
+        // Read pointer is ahead of write, bytes received
+        // is from the read pointer up to the end of the buffer
+        // then wrap around to the write pointer
+        count = (pUartData->pRxBufferStart +
+                 pUartData->rxBufferSize -
+                 pUartData->pRxBufferRead) +
+                (pRxBufferWrite - pUartData->pRxBufferStart);
+    }
+
+    return count;
+}
+
+// Get the write pointer as published by the interrupt
+// handlers.  This is the acquire half of the pair with
+// dataIrqHandler(): the barrier makes sure that none of
+// the data covered by the write pointer is read before the
+// write pointer itself.
+static inline const char *pRxBufferWriteGet(const CellularPortUartData_t *pUartData)
+{
+    const char *pRxBufferWrite = (const char *) pUartData->pRxBufferWrite;
+
+    __DMB();
+
+    return pRxBufferWrite;
+}
+
+// Called by the reader when it has emptied the receive ring
+// to ask for an event when more data arrives.  Should data
+// have slipped in between the reader emptying the ring and
+// the request being made, the interrupt handler will have
+// seen no request and so will not send an event; in that
+// case take the request back and send the event from here.
+static void rxNotifyRequest(CellularPortUartData_t *pUartData)
+{
+    CellularPortUartEventData_t uartSizeOrError;
+
+    pUartData->userNeedsNotify = true;
+    // Make sure the request is visible before looking again
+    __DMB();
+    uartSizeOrError = rxBufferCount(pUartData,
+                                    pRxBufferWriteGet(pUartData));
+    if ((uartSizeOrError > 0) &&
+        __atomic_exchange_n(&(pUartData->userNeedsNotify), false,
+                            __ATOMIC_ACQ_REL)) {
+        xQueueSend((QueueHandle_t) (pUartData->queue),
+                   &uartSizeOrError, 0);
+    }
+}
+
+// Called by the reader before it looks at the receive ring: if
+// the interrupt handlers have found that the ring was overrun
+// then what is in it can't be trusted, so throw it away.
+static void rxOverrunCheck(CellularPortUartData_t *pUartData)
+{
+    if (pUartData->rxOverrun &&
+        __atomic_exchange_n(&(pUartData->rxOverrun), false,
+                            __ATOMIC_ACQ_REL)) {
+        pUartData->pRxBufferRead = (char *) pRxBufferWriteGet(pUartData);
+    }
+}
+
 // Deal with data already received by the DMA; this
 // code is run in INTERRUPT CONTEXT.
 static inline void dataIrqHandler(CellularPortUartData_t *pUartData,
                                   char *pRxBufferWriteDma)
 {
     CellularPortUartEventData_t uartSizeOrError = 0;
+    size_t count;
 
     // Work out how much new data there is
     if (pUartData->pRxBufferWrite < pRxBufferWriteDma) {
@@ -422,21 +518,51 @@ static inline void dataIrqHandler(CellularPortUartData_t *pUartData,
         // is up to the end of the buffer then wrap
         // around to the DMA write pointer pointer
         uartSizeOrError = (pUartData->pRxBufferStart +
-                           CELLULAR_PORT_UART_RX_BUFFER_SIZE -
+                           pUartData->rxBufferSize -
                            pUartData->pRxBufferWrite) +
                           (pRxBufferWriteDma - pUartData->pRxBufferStart);
     }
 
-    // Move the write pointer on
-    pUartData->pRxBufferWrite += uartSizeOrError;
-    if (pUartData->pRxBufferWrite >= pUartData->pRxBufferStart +
-                                     CELLULAR_PORT_UART_RX_BUFFER_SIZE) {
-        pUartData->pRxBufferWrite = pUartData->pRxBufferWrite -
-                                    CELLULAR_PORT_UART_RX_BUFFER_SIZE;
+    // Keep track of how full the ring gets and spot the DMA,
+    // which never stops, coming round to data that has not
+    // yet been read.  The ring holds one byte less than its
+    // size since equal pointers mean empty.  If the DMA has
+    // gone round more than once the loss is larger than can
+    // be seen here.
+    count = rxBufferCount(pUartData, (const char *) pUartData->pRxBufferWrite) +
+            uartSizeOrError;
+    if (count >= pUartData->rxBufferSize) {
+        pUartData->stats.rxOverruns++;
+        pUartData->stats.rxBytesLost += count - (pUartData->rxBufferSize - 1);
+        pUartData->rxOverrun = true;
+        count = pUartData->rxBufferSize - 1;
     }
+    if (count > pUartData->stats.rxHighWaterMarkBytes) {
+        pUartData->stats.rxHighWaterMarkBytes = count;
+    }
+
+    // Move the write pointer on, working on a local copy
+    // so that the reader never sees an un-wrapped value.
+    // The barrier beforehand is the release half of the
+    // pair with pRxBufferWriteGet(): the reader must not be
+    // able to see the new write pointer before the data
+    // it covers.
+    pRxBufferWriteDma = (char *) pUartData->pRxBufferWrite + uartSizeOrError;
+    if (pRxBufferWriteDma >= pUartData->pRxBufferStart +
+                             pUartData->rxBufferSize) {
+        pRxBufferWriteDma -= pUartData->rxBufferSize;
+    }
+    __DMB();
+    pUartData->pRxBufferWrite = pRxBufferWriteDma;
+    // Make sure the write pointer is out before looking
+    // at the notification request, see rxNotifyRequest()
+    __DMB();
 
     // If there is new data and the user wanted to know
-    // then send a message to let them know.
+    // then send a message to let them know; since the
+    // reader only asks again once it has emptied the ring,
+    // any number of interrupts are coalesced into a single
+    // event.
     if ((uartSizeOrError > 0) && pUartData->userNeedsNotify) {
         BaseType_t yield = false;
 
@@ -485,7 +611,7 @@ void dmaIrqHandler(uint32_t dmaEngine, uint32_t dmaStream)
         // an Rx DMA we have to subtract the number from
         // the Rx buffer size
         pRxBufferWriteDma = pUartData->pRxBufferStart +
-                            CELLULAR_PORT_UART_RX_BUFFER_SIZE -
+                            pUartData->rxBufferSize -
                             LL_DMA_GetDataLength(pDmaReg, dmaStream);
         // Deal with the data
         dataIrqHandler(pUartData, pRxBufferWriteDma);
@@ -503,6 +629,15 @@ void uartIrqHandler(CellularPortUartData_t *pUartData)
         LL_USART_IsActiveFlag_IDLE(pUartReg)) {
         char *pRxBufferWriteDma;
 
+        // If the DMA failed to empty the receive register
+        // in time, a character has been lost; the overrun
+        // flag is cleared by the same sequence that clears
+        // the IDLE flag
+        if (LL_USART_IsActiveFlag_ORE(pUartReg)) {
+            pUartData->stats.rxOverruns++;
+            pUartData->stats.rxBytesLost++;
+        }
+
         // Clear flag
         LL_USART_ClearFlag_IDLE(pUartReg);
 
@@ -512,7 +647,7 @@ void uartIrqHandler(CellularPortUartData_t *pUartData)
         // an Rx DMA we have to subtract the number from
         // the Rx buffer size
         pRxBufferWriteDma = pUartData->pRxBufferStart +
-                            CELLULAR_PORT_UART_RX_BUFFER_SIZE -
+                            pUartData->rxBufferSize -
                             LL_DMA_GetDataLength(gpDmaReg[pUartCfg->dmaEngine],
                                                  pUartCfg->dmaStream);
         // Deal with the data
@@ -737,7 +872,12 @@ int32_t cellularPortUartInit(int32_t pinTx, int32_t pinRx,
     IRQn_Type uartIrq;
     IRQn_Type dmaIrq;
 
-    // TODO: use this
+    // The RTS threshold is not adjustable on this platform:
+    // the USART de-asserts RTS while its receive register is
+    // full, which the DMA, never stopping, does not allow to
+    // happen, so RTS cannot follow the occupancy of the receive
+    // ring either.  Should the ring be overrun that is detected
+    // and counted instead, see cellularPortUartGetStats().
     (void) rtsThreshold;
 
     if ((pUartQueue != NULL) && (pinRx >= 0) && (pinTx >= 0) &&
@@ -754,7 +894,13 @@ int32_t cellularPortUartInit(int32_t pinTx, int32_t pinRx,
                 errorCode = CELLULAR_PORT_OUT_OF_MEMORY;
                 uartData.number = uart;
                 // Malloc memory for the read buffer
-                uartData.pRxBufferStart = (char *) pCellularPort_malloc(CELLULAR_PORT_UART_RX_BUFFER_SIZE);
+                uartData.rxBufferSize = gRxBufferSize[uart];
+                if (uartData.rxBufferSize == 0) {
+                    uartData.rxBufferSize = CELLULAR_PORT_UART_RX_BUFFER_SIZE;
+                }
+                uartData.stats.rxBufferSizeBytes = uartData.rxBufferSize;
+                uartData.pRxBufferStart = (char *) pCellularPort_mallocTag(uartData.rxBufferSize,
+                                                                           CELLULAR_PORT_MALLOC_TAG_PORT);
                 if (uartData.pRxBufferStart != NULL) {
                     uartData.pConstData = &(gUartCfg[uart]);
                     uartData.pRxBufferRead = uartData.pRxBufferStart;
@@ -863,7 +1009,7 @@ int32_t cellularPortUartInit(int32_t pinTx, int32_t pinRx,
                             LL_DMA_SetMemoryAddress(pDmaReg, dmaStream,
                                                     (uint32_t) (uartData.pRxBufferStart));
                             LL_DMA_SetDataLength(pDmaReg, dmaStream,
-                                                 CELLULAR_PORT_UART_RX_BUFFER_SIZE);
+                                                 uartData.rxBufferSize);
 
                             // Clear all the DMA flags and the DMA pending IRQ from any previous
                             // session first, or an unexpected interrupt may result
@@ -1057,36 +1203,18 @@ int32_t cellularPortUartGetReceiveSize(int32_t uart)
 {
     CellularPortErrorCode_t sizeOrErrorCode = CELLULAR_PORT_INVALID_PARAMETER;
     CellularPortUartData_t *pUartData = pGetUart(uart);
-    const volatile char *pRxBufferWrite;
 
     if (pUartData != NULL) {
-
-        CELLULAR_PORT_MUTEX_LOCK(pUartData->mutex);
-
-        pRxBufferWrite = pUartData->pRxBufferWrite;
-        sizeOrErrorCode = 0;
-        if (pUartData->pRxBufferRead < pRxBufferWrite) {
-            // Read pointer is behind write, bytes
-            // received is simply the difference
-            sizeOrErrorCode = pRxBufferWrite - pUartData->pRxBufferRead;
-        } else if (pUartData->pRxBufferRead > pRxBufferWrite) {
-            // Read pointer is ahead of write, bytes received
-            // is from the read pointer up to the end of the buffer
-            // then wrap around to the write pointer
-            sizeOrErrorCode = (pUartData->pRxBufferStart +
-                               CELLULAR_PORT_UART_RX_BUFFER_SIZE -
-                               pUartData->pRxBufferRead) +
-                              (pRxBufferWrite - pUartData->pRxBufferStart);
-        }
-
-        // If there's nothing waiting, need to information
+        // No need to lock the mutex, the receive
+        // ring is lock-free
+        rxOverrunCheck(pUartData);
+        sizeOrErrorCode = rxBufferCount(pUartData,
+                                        pRxBufferWriteGet(pUartData));
+        // If there's nothing waiting, need to inform
         // the user when something arrives
-        if (sizeOrErrorCode) {
-            pUartData->userNeedsNotify = true;
+        if (sizeOrErrorCode == 0) {
+            rxNotifyRequest(pUartData);
         }
-
-        CELLULAR_PORT_MUTEX_UNLOCK(pUartData->mutex);
-
     }
 
     return (int32_t) sizeOrErrorCode;
@@ -1099,14 +1227,14 @@ int32_t cellularPortUartRead(int32_t uart, char *pBuffer,
     CellularPortErrorCode_t sizeOrErrorCode = CELLULAR_PORT_INVALID_PARAMETER;
     size_t thisSize;
     CellularPortUartData_t *pUartData = pGetUart(uart);
-    const volatile char *pRxBufferWrite;
+    const char *pRxBufferWrite;
 
     if (pUartData != NULL) {
-
-        CELLULAR_PORT_MUTEX_LOCK(pUartData->mutex);
-
+        // No need to lock the mutex, the receive
+        // ring is lock-free
+        rxOverrunCheck(pUartData);
         sizeOrErrorCode = 0;
-        pRxBufferWrite = pUartData->pRxBufferWrite;
+        pRxBufferWrite = pRxBufferWriteGet(pUartData);
         if (pUartData->pRxBufferRead < pRxBufferWrite) {
             // Read pointer is behind write, just take as much
             // of the difference as the user allows
@@ -1122,7 +1250,7 @@ int32_t cellularPortUartRead(int32_t uart, char *pBuffer,
             // Read pointer is ahead of write, first take up to the
             // end of the buffer as far as the user allows
             thisSize = pUartData->pRxBufferStart +
-                       CELLULAR_PORT_UART_RX_BUFFER_SIZE -
+                       pUartData->rxBufferSize -
                        pUartData->pRxBufferRead;
             if (thisSize > sizeBytes) {
                 thisSize = sizeBytes;
@@ -1135,7 +1263,7 @@ int32_t cellularPortUartRead(int32_t uart, char *pBuffer,
             // Move the read pointer on, wrapping as necessary
             pUartData->pRxBufferRead += thisSize;
             if (pUartData->pRxBufferRead >= pUartData->pRxBufferStart +
-                                            CELLULAR_PORT_UART_RX_BUFFER_SIZE) {
+                                            pUartData->rxBufferSize) {
                 pUartData->pRxBufferRead = pUartData->pRxBufferStart;
             }
             // If there is still room in the user buffer then
@@ -1158,16 +1286,72 @@ int32_t cellularPortUartRead(int32_t uart, char *pBuffer,
         // If everything has been read, a notification
         // is needed for the next one
         if (pUartData->pRxBufferRead == pRxBufferWrite) {
-            pUartData->userNeedsNotify = true;
+            rxNotifyRequest(pUartData);
         }
+    }
 
-        CELLULAR_PORT_MUTEX_UNLOCK(pUartData->mutex);
+    return (int32_t) sizeOrErrorCode;
+}
+
+// Get a pointer to the data waiting in the receive buffer.
+int32_t cellularPortUartReadSpan(int32_t uart, const char **ppData)
+{
+    CellularPortErrorCode_t sizeOrErrorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortUartData_t *pUartData = pGetUart(uart);
+    const char *pRxBufferWrite;
 
+    if ((pUartData != NULL) && (ppData != NULL)) {
+        // No need to lock the mutex, the receive
+        // ring is lock-free
+        rxOverrunCheck(pUartData);
+        sizeOrErrorCode = 0;
+        pRxBufferWrite = pRxBufferWriteGet(pUartData);
+        if (pUartData->pRxBufferRead < pRxBufferWrite) {
+            // Read pointer is behind write, offer
+            // all of the difference
+            sizeOrErrorCode = pRxBufferWrite - pUartData->pRxBufferRead;
+        } else if (pUartData->pRxBufferRead > pRxBufferWrite) {
+            // Read pointer is ahead of write, offer up
+            // to the end of the buffer, the remainder
+            // will be offered on the next call
+            sizeOrErrorCode = pUartData->pRxBufferStart +
+                              pUartData->rxBufferSize -
+                              pUartData->pRxBufferRead;
+        }
+        *ppData = pUartData->pRxBufferRead;
     }
 
     return (int32_t) sizeOrErrorCode;
 }
 
+// Mark data obtained through cellularPortUartReadSpan() as read.
+int32_t cellularPortUartReadCommit(int32_t uart, size_t sizeBytes)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortUartData_t *pUartData = pGetUart(uart);
+
+    if (pUartData != NULL) {
+        // No need to lock the mutex, the receive
+        // ring is lock-free
+
+        // Move the read pointer on, wrapping as necessary
+        pUartData->pRxBufferRead += sizeBytes;
+        if (pUartData->pRxBufferRead >= pUartData->pRxBufferStart +
+                                        pUartData->rxBufferSize) {
+            pUartData->pRxBufferRead -= pUartData->rxBufferSize;
+        }
+
+        // If everything has been read, a notification
+        // is needed for the next one
+        if (pUartData->pRxBufferRead == pRxBufferWriteGet(pUartData)) {
+            rxNotifyRequest(pUartData);
+        }
+        errorCode = CELLULAR_PORT_SUCCESS;
+    }
+
+    return (int32_t) errorCode;
+}
+
 // Write to the given UART interface.
 int32_t cellularPortUartWrite(int32_t uart,
                               const char *pBuffer,
@@ -1200,6 +1384,46 @@ int32_t cellularPortUartWrite(int32_t uart,
     return (int32_t) sizeOrErrorCode;
 }
 
+// Change the baud rate of the given UART interface.
+int32_t cellularPortUartSetBaudRate(int32_t uart,
+                                    int32_t baudRate)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortUartData_t *pUartData = pGetUart(uart);
+    LL_RCC_ClocksTypeDef clocks;
+    uint32_t periphClk;
+    USART_TypeDef *pReg;
+
+    if ((pUartData != NULL) && (baudRate > 0)) {
+
+        CELLULAR_PORT_MUTEX_LOCK(pUartData->mutex);
+
+        pReg = gUartCfg[uart].pReg;
+        // The UART/USART is clocked from whichever
+        // APB bus it sits on
+        LL_RCC_GetSystemClocksFreq(&clocks);
+        periphClk = clocks.PCLK1_Frequency;
+        if (gLlApbClkEnable[uart] == LL_APB2_GRP1_EnableClock) {
+            periphClk = clocks.PCLK2_Frequency;
+        }
+
+        // Transmission is complete by the time a
+        // write releases the mutex so the USART can
+        // be stopped briefly to change the rate;
+        // the receive DMA carries on regardless
+        LL_USART_Disable(pReg);
+        LL_USART_SetBaudRate(pReg, periphClk,
+                             LL_USART_OVERSAMPLING_16, baudRate);
+        LL_USART_Enable(pReg);
+        errorCode = CELLULAR_PORT_SUCCESS;
+
+        CELLULAR_PORT_MUTEX_UNLOCK(pUartData->mutex);
+
+    }
+
+    return (int32_t) errorCode;
+}
+
 // Determine if RTS flow control is enabled.
 bool cellularPortIsRtsFlowControlEnabled(int32_t uart)
 {
@@ -1238,4 +1462,70 @@ bool cellularPortIsCtsFlowControlEnabled(int32_t uart)
     return ctsFlowControlIsEnabled;
 }
 
+// Set the receive buffer size for the next initialisation of a UART.
+int32_t cellularPortUartSetRxBufferSize(int32_t uart,
+                                        size_t sizeBytes)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+
+    // The DMA length register is 16 bits wide
+    if ((uart > 0) && (uart <= CELLULAR_PORT_MAX_NUM_UARTS) &&
+        (pGetUart(uart) == NULL) && (sizeBytes <= 0xFFFF) &&
+        ((sizeBytes == 0) || (sizeBytes >= 2))) {
+        gRxBufferSize[uart] = sizeBytes;
+        errorCode = CELLULAR_PORT_SUCCESS;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Get the receive statistics of a UART.
+int32_t cellularPortUartGetStats(int32_t uart,
+                                 CellularPortUartStats_t *pStats)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortUartData_t *pUartData = pGetUart(uart);
+
+    if ((pUartData != NULL) && (pStats != NULL)) {
+        // No need to lock the mutex, the statistics are
+        // only ever written by the interrupt handlers
+        *pStats = pUartData->stats;
+        errorCode = CELLULAR_PORT_SUCCESS;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Reset the receive statistics of a UART.
+int32_t cellularPortUartResetStats(int32_t uart)
+{
+    CellularPortErrorCode_t errorCode = CELLULAR_PORT_INVALID_PARAMETER;
+    CellularPortUartData_t *pUartData = pGetUart(uart);
+
+    if (pUartData != NULL) {
+        pUartData->stats.rxHighWaterMarkBytes = 0;
+        pUartData->stats.rxOverruns = 0;
+        pUartData->stats.rxBytesLost = 0;
+        errorCode = CELLULAR_PORT_SUCCESS;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Suspend a UART: not supported on this platform.
+int32_t cellularPortUartSuspend(int32_t uart)
+{
+    (void) uart;
+
+    return (int32_t) CELLULAR_PORT_NOT_IMPLEMENTED;
+}
+
+// Resume a UART: not supported on this platform.
+int32_t cellularPortUartResume(int32_t uart)
+{
+    (void) uart;
+
+    return (int32_t) CELLULAR_PORT_NOT_IMPLEMENTED;
+}
+
 // End of file
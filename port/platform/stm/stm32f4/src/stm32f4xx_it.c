@@ -30,9 +30,6 @@
 #include "stm32f4xx_it.h"
 #include "cmsis_os.h"
 
-/* Need to update this value in cellular_port_private.c. */
-extern int32_t gTickTimerRtosCount;
-
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
 /* Private macro -------------------------------------------------------------*/
@@ -112,7 +109,6 @@ void DebugMon_Handler(void)
   */
 void SysTick_Handler(void)
 {
-    gTickTimerRtosCount++;
     osSystickHandler();
 }
 
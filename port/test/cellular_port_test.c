@@ -48,6 +48,17 @@
 // The guard time for the OS test.
 #define CELLULAR_PORT_TEST_OS_GUARD_DURATION_MS 4200
 
+// The number of bytes sent at each setting of the UART benchmark.
+#define CELLULAR_PORT_TEST_UART_BENCHMARK_SIZE_BYTES 20000
+
+// The number of single bytes sent at each setting of the UART
+// benchmark to measure the latency of the UART event.
+#define CELLULAR_PORT_TEST_UART_BENCHMARK_LATENCY_COUNT 20
+
+// How long the UART benchmark waits for received data to stop
+// arriving before it gives up on the rest.
+#define CELLULAR_PORT_TEST_UART_BENCHMARK_QUIET_MS 500
+
 /* ----------------------------------------------------------------
  * TYPES
  * -------------------------------------------------------------- */
@@ -59,6 +70,16 @@ typedef struct {
     CellularPortQueueHandle_t controlQueueHandle;
 } UartTestTaskData_t;
 
+// Type to hold the stuff that the UART benchmark task needs to
+// know about and the results it passes back.
+typedef struct {
+    CellularPortMutexHandle_t runningMutexHandle;
+    CellularPortQueueHandle_t uartQueueHandle;
+    CellularPortQueueHandle_t controlQueueHandle;
+    volatile int32_t bytesReceived;
+    volatile int64_t lastReceiveTimeMs;
+} UartBenchmarkTaskData_t;
+
 /* ----------------------------------------------------------------
  * VARIABLES
  * -------------------------------------------------------------- */
@@ -83,6 +104,9 @@ static int32_t gStuffToSend[] = {0, 100, 25, 3};
 // The number of bytes correctly received during UART testing.
 static int32_t gUartBytesReceived = 0;
 
+// The size of the UART receive buffer during UART testing.
+static size_t gUartRxBufferSize = CELLULAR_PORT_UART_RX_BUFFER_SIZE;
+
 // The data to send during UART testing.
 static const char gUartTestData[] =  "_____0000:0123456789012345678901234567890123456789"
                                      "01234567890123456789012345678901234567890123456789"
@@ -108,6 +132,15 @@ static const char gUartTestData[] =  "_____0000:01234567890123456789012345678901
 // A buffer to receive UART data into
 static char gUartBuffer[1024];
 
+// The baud rates at which to run the UART benchmark.
+static const int32_t gUartBenchmarkBaudRate[] = {115200, 230400, 460800, 921600};
+
+// The receive buffer sizes with which to run the UART benchmark.
+static const size_t gUartBenchmarkRxBufferSize[] = {CELLULAR_PORT_UART_RX_BUFFER_SIZE / 2,
+                                                    CELLULAR_PORT_UART_RX_BUFFER_SIZE,
+                                                    CELLULAR_PORT_UART_RX_BUFFER_SIZE * 2
+                                                   };
+
 #endif // (CELLULAR_PORT_TEST_PIN_UART_TXD >= 0) && (CELLULAR_PORT_TEST_PIN_UART_RXD >= 0)
 
 /* ----------------------------------------------------------------
@@ -206,7 +239,7 @@ static void uartTestTask(void *pParameters)
             // can't easily check cellularPortUartGetReceiveSize()
             // for accuracy, so instead do a range check here
             CELLULAR_PORT_TEST_ASSERT(receiveSize >= 0);
-            CELLULAR_PORT_TEST_ASSERT(receiveSize <= CELLULAR_PORT_UART_RX_BUFFER_SIZE);
+            CELLULAR_PORT_TEST_ASSERT(receiveSize <= gUartRxBufferSize);
             // Compare the data with the expected data
             for (size_t x = 0; x < dataSize; x++) {
                 if (gUartTestData[indexInBlock] == *pReceive) {
@@ -250,8 +283,41 @@ static void uartTestTask(void *pParameters)
     CELLULAR_PORT_TEST_ASSERT(cellularPortTaskDelete(NULL) == 0);
 }
 
+// If we want to test with flow control off but the flow
+// control pins are actually connected then they need to be
+// set to "get on with it".
+static void uartFlowControlPinsGo()
+{
+#if (CELLULAR_PORT_TEST_PIN_UART_CTS >= 0) || (CELLULAR_PORT_TEST_PIN_UART_RTS >= 0)
+    CellularPortGpioConfig_t gpioConfig = CELLULAR_PORT_GPIO_CONFIG_DEFAULT;
+#endif
+
+#if (CELLULAR_PORT_TEST_PIN_UART_CTS >= 0)
+    // Make it an output pin and low
+    CELLULAR_PORT_TEST_ASSERT(cellularPortGpioSet(CELLULAR_PORT_TEST_PIN_UART_CTS, 0) == 0);
+    gpioConfig.pin = CELLULAR_PORT_TEST_PIN_UART_CTS;
+    gpioConfig.direction = CELLULAR_PORT_GPIO_DIRECTION_OUTPUT;
+    CELLULAR_PORT_TEST_ASSERT(cellularPortGpioConfig(&gpioConfig) == 0);
+    cellularPortTaskBlock(1);
+#endif
+#if (CELLULAR_PORT_TEST_PIN_UART_RTS >= 0)
+    // Make it an output pin and low
+    CELLULAR_PORT_TEST_ASSERT(cellularPortGpioSet(CELLULAR_PORT_TEST_PIN_UART_RTS, 0) == 0);
+    gpioConfig.pin = CELLULAR_PORT_TEST_PIN_UART_RTS;
+    gpioConfig.direction = CELLULAR_PORT_GPIO_DIRECTION_OUTPUT;
+    CELLULAR_PORT_TEST_ASSERT(cellularPortGpioConfig(&gpioConfig) == 0);
+    cellularPortTaskBlock(1);
+#endif
+}
+
 // Run a UART test at the given baud rate and with/without flow control.
-static void runUartTest(int32_t size, int32_t speed, bool flowControlOn)
+// If newSpeed is greater than zero the UART is moved to that
+// speed with cellularPortUartSetBaudRate() before sending.  If
+// suspend is true the UART is suspended half way through, once
+// everything sent so far has been received, and is resumed by
+// the next write.
+static void runUartTest(int32_t size, int32_t speed, int32_t newSpeed,
+                        bool flowControlOn, bool suspend)
 {
     UartTestTaskData_t uartTestTaskData;
     CellularPortTaskHandle_t uartTaskHandle;
@@ -260,7 +326,8 @@ static void runUartTest(int32_t size, int32_t speed, bool flowControlOn)
     int32_t bytesSent = 0;
     int32_t pinCts = -1;
     int32_t pinRts = -1;
-    CellularPortGpioConfig_t gpioConfig = CELLULAR_PORT_GPIO_CONFIG_DEFAULT;
+    CellularPortUartStats_t stats;
+    int32_t errorCode;
 
     gUartBytesReceived = 0;
 
@@ -268,26 +335,7 @@ static void runUartTest(int32_t size, int32_t speed, bool flowControlOn)
         pinCts = CELLULAR_PORT_TEST_PIN_UART_CTS;
         pinRts = CELLULAR_PORT_TEST_PIN_UART_RTS;
     } else {
-        // If we want to test with flow control off
-        // but the flow control pins are actually
-        // connected then they need to be set
-        // to "get on with it"
-#if (CELLULAR_PORT_TEST_PIN_UART_CTS >= 0)
-            // Make it an output pin and low
-            CELLULAR_PORT_TEST_ASSERT(cellularPortGpioSet(CELLULAR_PORT_TEST_PIN_UART_CTS, 0) == 0);
-            gpioConfig.pin = CELLULAR_PORT_TEST_PIN_UART_CTS;
-            gpioConfig.direction = CELLULAR_PORT_GPIO_DIRECTION_OUTPUT;
-            CELLULAR_PORT_TEST_ASSERT(cellularPortGpioConfig(&gpioConfig) == 0);
-            cellularPortTaskBlock(1);
-#endif
-#if (CELLULAR_PORT_TEST_PIN_UART_RTS >= 0)
-            // Make it an output pin and low
-            CELLULAR_PORT_TEST_ASSERT(cellularPortGpioSet(CELLULAR_PORT_TEST_PIN_UART_RTS, 0) == 0);
-            gpioConfig.pin = CELLULAR_PORT_TEST_PIN_UART_RTS;
-            gpioConfig.direction = CELLULAR_PORT_GPIO_DIRECTION_OUTPUT;
-            CELLULAR_PORT_TEST_ASSERT(cellularPortGpioConfig(&gpioConfig) == 0);
-            cellularPortTaskBlock(1);
-#endif
+        uartFlowControlPinsGo();
     }
 
     cellularPortLog("CELLULAR_PORT_TEST: testing UART loop-back, %d byte(s) at %d bits/s with flow control %s.\n",
@@ -300,6 +348,16 @@ static void runUartTest(int32_t size, int32_t speed, bool flowControlOn)
                                                    CELLULAR_PORT_TEST_UART_RTS_THRESHOLD,
                                                    CELLULAR_PORT_TEST_UART,
                                                    &(uartTestTaskData.uartQueueHandle)) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartGetStats(CELLULAR_PORT_TEST_UART,
+                                                       &stats) == 0);
+    gUartRxBufferSize = stats.rxBufferSizeBytes;
+
+    if (newSpeed > 0) {
+        cellularPortLog("CELLULAR_PORT_TEST: changing UART speed to %d bits/s.\n",
+                        newSpeed);
+        CELLULAR_PORT_TEST_ASSERT(cellularPortUartSetBaudRate(CELLULAR_PORT_TEST_UART,
+                                                              newSpeed) == 0);
+    }
 
     cellularPortLog("CELLULAR_PORT_TEST: creating OS items to test UART...\n");
 
@@ -332,6 +390,20 @@ static void runUartTest(int32_t size, int32_t speed, bool flowControlOn)
                                                         bytesToSend) == bytesToSend);
         bytesSent += bytesToSend;
         cellularPortLog("CELLULAR_PORT_TEST: %d byte(s) sent.\n", bytesSent);
+        if (suspend && (bytesSent >= size / 2)) {
+            suspend = false;
+            // Wait for everything to have been received
+            // and read, then suspend the UART; the next
+            // write should resume it
+            cellularPortTaskBlock(1000);
+            CELLULAR_PORT_TEST_ASSERT(gUartBytesReceived == bytesSent);
+            errorCode = cellularPortUartSuspend(CELLULAR_PORT_TEST_UART);
+            cellularPortLog("CELLULAR_PORT_TEST: suspending UART returned %d.\n",
+                            errorCode);
+            CELLULAR_PORT_TEST_ASSERT((errorCode == 0) ||
+                                      (errorCode == CELLULAR_PORT_NOT_IMPLEMENTED));
+            cellularPortTaskBlock(100);
+        }
     }
 
     // Wait long enough for everything to have been received
@@ -340,6 +412,20 @@ static void runUartTest(int32_t size, int32_t speed, bool flowControlOn)
                     bytesSent, gUartBytesReceived);
     CELLULAR_PORT_TEST_ASSERT(gUartBytesReceived == bytesSent);
 
+    // Nothing should have been lost along the way
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartGetStats(CELLULAR_PORT_TEST_UART,
+                                                       &stats) == 0);
+    cellularPortLog("CELLULAR_PORT_TEST: receive buffer %d byte(s), high-water mark %d byte(s), %d overrun(s).\n",
+                    stats.rxBufferSizeBytes, stats.rxHighWaterMarkBytes,
+                    stats.rxOverruns);
+    CELLULAR_PORT_TEST_ASSERT(stats.rxOverruns == 0);
+    CELLULAR_PORT_TEST_ASSERT(stats.rxBytesLost == 0);
+    CELLULAR_PORT_TEST_ASSERT(stats.rxHighWaterMarkBytes <= stats.rxBufferSizeBytes);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartResetStats(CELLULAR_PORT_TEST_UART) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartGetStats(CELLULAR_PORT_TEST_UART,
+                                                       &stats) == 0);
+    CELLULAR_PORT_TEST_ASSERT(stats.rxOverruns == 0);
+
     cellularPortLog("CELLULAR_PORT_TEST: tidying up after UART test...\n");
 
     // Tell the UART Rx task to exit
@@ -359,6 +445,169 @@ static void runUartTest(int32_t size, int32_t speed, bool flowControlOn)
     CELLULAR_PORT_TEST_ASSERT(cellularPortUartDeinit(CELLULAR_PORT_TEST_UART) == 0);
 }
 
+// The task for the UART benchmark: just counts what arrives.
+static void uartBenchmarkTask(void *pParameters)
+{
+    UartBenchmarkTaskData_t *pData = (UartBenchmarkTaskData_t *) pParameters;
+    int32_t control = 0;
+    int32_t dataSize;
+
+    CELLULAR_PORT_MUTEX_LOCK(pData->runningMutexHandle);
+
+    while (control == 0) {
+        if (cellularPortUartEventTryReceive(pData->uartQueueHandle, 100) >= 0) {
+            do {
+                dataSize = cellularPortUartRead(CELLULAR_PORT_TEST_UART,
+                                                gUartBuffer,
+                                                sizeof(gUartBuffer));
+                if (dataSize > 0) {
+                    pData->bytesReceived += dataSize;
+                    pData->lastReceiveTimeMs = cellularPortGetTickTimeMs();
+                }
+            } while (dataSize > 0);
+        }
+        cellularPortQueueTryReceive(pData->controlQueueHandle,
+                                    0, (void *) &control);
+    }
+
+    CELLULAR_PORT_MUTEX_UNLOCK(pData->runningMutexHandle);
+
+    CELLULAR_PORT_TEST_ASSERT(cellularPortTaskDelete(NULL) == 0);
+}
+
+// Run the UART benchmark at one baud rate and receive buffer
+// size, without flow control: first the time from sending a
+// single byte to the UART event that says it has arrived, then
+// the throughput and the number of bytes lost when sending
+// flat out.  This characterises the port rather than testing
+// it so the only things asserted are that the APIs work and
+// that no more comes back than was sent.
+static void runUartBenchmark(int32_t speed, size_t rxBufferSize)
+{
+    UartBenchmarkTaskData_t data;
+    CellularPortTaskHandle_t taskHandle;
+    CellularPortUartStats_t stats;
+    int32_t control;
+    int32_t bytesToSend;
+    int32_t bytesSent = 0;
+    int32_t bytesReceived;
+    int64_t startTimeMs;
+    int32_t latencyMs;
+    int32_t latencyMinMs = INT32_MAX;
+    int32_t latencyMaxMs = 0;
+    int32_t latencyTotalMs = 0;
+    int32_t latencyCount = 0;
+    int32_t durationMs;
+    int32_t bytesPerSecond = 0;
+    char c = 'x';
+
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartSetRxBufferSize(CELLULAR_PORT_TEST_UART,
+                                                              rxBufferSize) == 0);
+    if (cellularPortUartInit(CELLULAR_PORT_TEST_PIN_UART_TXD,
+                             CELLULAR_PORT_TEST_PIN_UART_RXD,
+                             -1, -1, speed,
+                             CELLULAR_PORT_TEST_UART_RTS_THRESHOLD,
+                             CELLULAR_PORT_TEST_UART,
+                             &(data.uartQueueHandle)) != 0) {
+        cellularPortLog("CELLULAR_PORT_TEST: UART benchmark, %d bits/s not supported.\n",
+                        speed);
+        return;
+    }
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartGetStats(CELLULAR_PORT_TEST_UART,
+                                                       &stats) == 0);
+
+    // Event latency, with nothing else going on
+    for (size_t x = 0; x < CELLULAR_PORT_TEST_UART_BENCHMARK_LATENCY_COUNT; x++) {
+        // Throw away any events left over
+        while (cellularPortUartEventTryReceive(data.uartQueueHandle, 0) >= 0) {}
+        startTimeMs = cellularPortGetTickTimeMs();
+        CELLULAR_PORT_TEST_ASSERT(cellularPortUartWrite(CELLULAR_PORT_TEST_UART,
+                                                        &c, 1) == 1);
+        if (cellularPortUartEventTryReceive(data.uartQueueHandle, 1000) >= 0) {
+            latencyMs = (int32_t) (cellularPortGetTickTimeMs() - startTimeMs);
+            latencyTotalMs += latencyMs;
+            latencyCount++;
+            if (latencyMs < latencyMinMs) {
+                latencyMinMs = latencyMs;
+            }
+            if (latencyMs > latencyMaxMs) {
+                latencyMaxMs = latencyMs;
+            }
+        }
+        cellularPortTaskBlock(10);
+        while (cellularPortUartRead(CELLULAR_PORT_TEST_UART, gUartBuffer,
+                                    sizeof(gUartBuffer)) > 0) {}
+    }
+    if (latencyCount == 0) {
+        latencyMinMs = -1;
+        latencyMaxMs = -1;
+    }
+
+    // Throughput
+    data.bytesReceived = 0;
+    data.lastReceiveTimeMs = -1;
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartResetStats(CELLULAR_PORT_TEST_UART) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortMutexCreate(&(data.runningMutexHandle)) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortQueueCreate(5, sizeof(int32_t),
+                                                      &(data.controlQueueHandle)) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortTaskCreate(uartBenchmarkTask, "uartBenchmarkTask",
+                                                     CELLULAR_PORT_TEST_OS_TASK_STACK_SIZE_BYTES,
+                                                     (void *) &data,
+                                                     CELLULAR_PORT_TEST_OS_TASK_PRIORITY,
+                                                     &taskHandle) == 0);
+    cellularPortTaskBlock(100);
+
+    startTimeMs = cellularPortGetTickTimeMs();
+    while (bytesSent < CELLULAR_PORT_TEST_UART_BENCHMARK_SIZE_BYTES) {
+        // -1 below to omit gUartTestData string terminator
+        bytesToSend = sizeof(gUartTestData) - 1;
+        if (bytesToSend > CELLULAR_PORT_TEST_UART_BENCHMARK_SIZE_BYTES - bytesSent) {
+            bytesToSend = CELLULAR_PORT_TEST_UART_BENCHMARK_SIZE_BYTES - bytesSent;
+        }
+        CELLULAR_PORT_TEST_ASSERT(cellularPortUartWrite(CELLULAR_PORT_TEST_UART,
+                                                        gUartTestData,
+                                                        bytesToSend) == bytesToSend);
+        bytesSent += bytesToSend;
+    }
+
+    // Wait for the received data to stop arriving
+    do {
+        bytesReceived = data.bytesReceived;
+        cellularPortTaskBlock(CELLULAR_PORT_TEST_UART_BENCHMARK_QUIET_MS);
+    } while ((data.bytesReceived != bytesReceived) &&
+             (bytesReceived < bytesSent));
+    bytesReceived = data.bytesReceived;
+    durationMs = (int32_t) (data.lastReceiveTimeMs - startTimeMs);
+    if (durationMs > 0) {
+        bytesPerSecond = (int32_t) (((int64_t) bytesReceived) * 1000 / durationMs);
+    }
+    CELLULAR_PORT_TEST_ASSERT(bytesReceived <= bytesSent);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartGetStats(CELLULAR_PORT_TEST_UART,
+                                                       &stats) == 0);
+
+    // A byte on the wire is ten bits, with start and stop bits
+    cellularPortLog("CELLULAR_PORT_TEST: UART benchmark, %d bits/s, receive buffer %d byte(s):"
+                    " %d byte(s)/s (%d%% of line rate), event latency %d/%d/%d ms (min/average/max),"
+                    " %d byte(s) dropped, %d overrun(s), %d byte(s) known lost,"
+                    " high-water mark %d byte(s).\n", speed, stats.rxBufferSizeBytes,
+                    bytesPerSecond, (int32_t) (((int64_t) bytesPerSecond) * 1000 / speed),
+                    latencyMinMs, (latencyCount > 0) ? latencyTotalMs / latencyCount : -1,
+                    latencyMaxMs, bytesSent - bytesReceived, stats.rxOverruns,
+                    stats.rxBytesLost, stats.rxHighWaterMarkBytes);
+
+    // Tidy up
+    control = -1;
+    CELLULAR_PORT_TEST_ASSERT(cellularPortQueueSend(data.controlQueueHandle,
+                                                    (void *) &control) == 0);
+    CELLULAR_PORT_MUTEX_LOCK(data.runningMutexHandle);
+    CELLULAR_PORT_MUTEX_UNLOCK(data.runningMutexHandle);
+    cellularPortTaskBlock(100);
+    cellularPortQueueDelete(data.controlQueueHandle);
+    cellularPortMutexDelete(data.runningMutexHandle);
+
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartDeinit(CELLULAR_PORT_TEST_UART) == 0);
+}
+
 #endif // (CELLULAR_PORT_TEST_PIN_UART_TXD >= 0) && (CELLULAR_PORT_TEST_PIN_UART_RXD >= 0)
 
 /* ----------------------------------------------------------------
@@ -427,6 +676,15 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularPortTestOs(),
     cellularPortLog("CELLULAR_PORT_TEST: trying to lock the mutex, should fail...\n");
     CELLULAR_PORT_TEST_ASSERT(cellularPortMutexTryLock(gMutexHandle, 10) != 0);
 
+    errorCode = cellularPortTaskStackMinFree(gTaskHandle);
+    cellularPortLog("CELLULAR_PORT_TEST: test task has used at most %d byte(s)"
+                    " of its stack of %d byte(s).\n",
+                    CELLULAR_PORT_TEST_OS_TASK_STACK_SIZE_BYTES - errorCode,
+                    CELLULAR_PORT_TEST_OS_TASK_STACK_SIZE_BYTES);
+    CELLULAR_PORT_TEST_ASSERT((errorCode > 0) &&
+                              (errorCode < CELLULAR_PORT_TEST_OS_TASK_STACK_SIZE_BYTES));
+    CELLULAR_PORT_TEST_ASSERT(cellularPortTaskStackMinFree(NULL) > 0);
+
     cellularPortLog("CELLULAR_PORT_TEST: sending stuff to task...\n");
     for (size_t x = 0; x < sizeof(gStuffToSend) / sizeof(gStuffToSend[0]); x++) {
         // Actually send the stuff in a function so as to check that the
@@ -536,6 +794,128 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularPortTest_strtok_r(),
     cellularPortDeinit();
 }
 
+/** Test: tagged memory allocation and, if the pools are
+ * compiled in, the statistics for it.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularPortTestMalloc(),
+                            "portMalloc",
+                            "port")
+{
+    char *pSmall;
+    char *pLarge;
+    char *pHuge;
+#if CELLULAR_CFG_PORT_MALLOC_POOL
+    CellularPortMallocTagStats_t tagStats;
+    CellularPortMallocPoolStats_t poolStats;
+    size_t inUseBytes;
+    int32_t numInUse;
+#endif
+
+    CELLULAR_PORT_TEST_ASSERT(cellularPortInit() == 0);
+
+    cellularPortLog("CELLULAR_PORT_TEST: testing memory allocation...\n");
+
+#if CELLULAR_CFG_PORT_MALLOC_POOL
+    CELLULAR_PORT_TEST_ASSERT(cellularPortMallocGetTagStats(CELLULAR_PORT_MALLOC_TAG_OTHER,
+                                                            &tagStats) == 0);
+    inUseBytes = tagStats.inUseBytes;
+    CELLULAR_PORT_TEST_ASSERT(cellularPortMallocGetPoolStats(0, &poolStats) == 0);
+    CELLULAR_PORT_TEST_ASSERT(poolStats.blockSizeBytes == 32);
+    numInUse = poolStats.numInUse;
+    CELLULAR_PORT_TEST_ASSERT(cellularPortMallocGetPoolStats(100, &poolStats) < 0);
+    cellularPortMallocResetStats();
+#else
+    CELLULAR_PORT_TEST_ASSERT(cellularPortMallocGetTagStats(CELLULAR_PORT_MALLOC_TAG_OTHER,
+                                                            NULL) < 0);
+#endif
+
+    // A small one, a large one and one bigger than any pool
+    pSmall = (char *) pCellularPort_mallocTag(10, CELLULAR_PORT_MALLOC_TAG_OTHER);
+    CELLULAR_PORT_TEST_ASSERT(pSmall != NULL);
+    pCellularPort_memset(pSmall, 0xa5, 10);
+    pLarge = (char *) pCellularPort_malloc(1000);
+    CELLULAR_PORT_TEST_ASSERT(pLarge != NULL);
+    pCellularPort_memset(pLarge, 0x5a, 1000);
+    pHuge = (char *) pCellularPort_mallocTag(5000, CELLULAR_PORT_MALLOC_TAG_OTHER);
+    CELLULAR_PORT_TEST_ASSERT(pHuge != NULL);
+    pCellularPort_memset(pHuge, 0xff, 5000);
+    CELLULAR_PORT_TEST_ASSERT((*pSmall == (char) 0xa5) && (*(pSmall + 9) == (char) 0xa5));
+    CELLULAR_PORT_TEST_ASSERT((*pLarge == 0x5a) && (*(pLarge + 999) == 0x5a));
+
+#if CELLULAR_CFG_PORT_MALLOC_POOL
+    CELLULAR_PORT_TEST_ASSERT(cellularPortMallocGetTagStats(CELLULAR_PORT_MALLOC_TAG_OTHER,
+                                                            &tagStats) == 0);
+    cellularPortLog("CELLULAR_PORT_TEST: tag OTHER has %d byte(s) in use, %d"
+                    " allocation(s), %d from the heap.\n",
+                    tagStats.inUseBytes, tagStats.numAllocs, tagStats.numHeap);
+    CELLULAR_PORT_TEST_ASSERT(tagStats.inUseBytes == inUseBytes + 10 + 1000 + 5000);
+    CELLULAR_PORT_TEST_ASSERT(tagStats.maxInUseBytes >= tagStats.inUseBytes);
+    CELLULAR_PORT_TEST_ASSERT(tagStats.numAllocs >= 3);
+    CELLULAR_PORT_TEST_ASSERT(tagStats.numHeap >= 1);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortMallocGetPoolStats(0, &poolStats) == 0);
+    if (poolStats.numBlocks > numInUse) {
+        CELLULAR_PORT_TEST_ASSERT(poolStats.numInUse == numInUse + 1);
+        CELLULAR_PORT_TEST_ASSERT(poolStats.maxInUse >= poolStats.numInUse);
+    }
+#endif
+
+    cellularPort_free(pHuge);
+    cellularPort_free(pLarge);
+    cellularPort_free(pSmall);
+    cellularPort_free(NULL);
+
+#if CELLULAR_CFG_PORT_MALLOC_POOL
+    CELLULAR_PORT_TEST_ASSERT(cellularPortMallocGetTagStats(CELLULAR_PORT_MALLOC_TAG_OTHER,
+                                                            &tagStats) == 0);
+    CELLULAR_PORT_TEST_ASSERT(tagStats.inUseBytes == inUseBytes);
+    CELLULAR_PORT_TEST_ASSERT(tagStats.maxInUseBytes >= inUseBytes + 10 + 1000 + 5000);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortMallocGetPoolStats(0, &poolStats) == 0);
+    CELLULAR_PORT_TEST_ASSERT(poolStats.numInUse == numInUse);
+#endif
+
+    cellularPortDeinit();
+}
+
+/** Test: cellularPortLogDeferred() with the conversions that
+ * this code uses, deferred if CELLULAR_CFG_LOG_DEFERRED is 1,
+ * and enough messages to overflow the ring buffer; the output
+ * has to be checked by eye.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularPortTestLogDeferred(),
+                            "portLogDeferred",
+                            "port")
+{
+    char buffer[200];
+    int64_t value64 = 0x123456789LL;
+
+    pCellularPort_memset(buffer, 'x', sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = 0;
+
+    CELLULAR_PORT_TEST_ASSERT(cellularPortInit() == 0);
+
+    cellularPortLogDeferred("CELLULAR_PORT_TEST: no arguments, 100%% of them.\n");
+    cellularPortLogDeferred("CELLULAR_PORT_TEST: %d, %u, 0x%08x, %c, \"%-5s\".\n",
+                            -1, 2, 0xa5a5, 'z', "ab");
+    cellularPortLogDeferred("CELLULAR_PORT_TEST: %lld, %d.\n", value64, 3);
+    cellularPortLogDeferred("CELLULAR_PORT_TEST: \"%.*s\", [%*d], %d.\n",
+                            3, "abcdef", 6, 42, (int32_t) sizeof(buffer));
+    // The string logged is what it was at the time, not what it becomes
+    buffer[sizeof(buffer) - 3] = 'a';
+    buffer[sizeof(buffer) - 2] = 'b';
+    cellularPortLogDeferred("CELLULAR_PORT_TEST: \"%s\" (should be \"ab\").\n",
+                            buffer + sizeof(buffer) - 3);
+    buffer[sizeof(buffer) - 3] = 'x';
+    // Too long to fit: should end "..."
+    cellularPortLogDeferred("CELLULAR_PORT_TEST: %s %d\n", buffer, 4);
+    for (int32_t x = 0; x < CELLULAR_CFG_LOG_DEFERRED_BUFFER_SIZE_BYTES / 16; x++) {
+        cellularPortLogDeferred("CELLULAR_PORT_TEST: message %d.\n", x);
+    }
+
+    // Emits anything left
+    cellularPortDeinit();
+    cellularPortLog("CELLULAR_PORT_TEST: deferred logging done.\n");
+}
+
 #if (CELLULAR_PORT_TEST_PIN_A >= 0) && (CELLULAR_PORT_TEST_PIN_B >= 0) && \
     (CELLULAR_PORT_TEST_PIN_C >= 0)
 /** Test GPIOs.
@@ -545,6 +925,8 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularPortTestGpio(),
                             "port")
 {
     CellularPortGpioConfig_t gpioConfig = CELLULAR_PORT_GPIO_CONFIG_DEFAULT;
+    CellularPortQueueHandle_t queueHandle = NULL;
+    int32_t pin = -1;
 
     CELLULAR_PORT_TEST_ASSERT(cellularPortInit() == 0);
 
@@ -582,6 +964,13 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularPortTestGpio(),
     CELLULAR_PORT_TEST_ASSERT(cellularPortGpioGet(CELLULAR_PORT_TEST_PIN_B) == 1);
     CELLULAR_PORT_TEST_ASSERT(cellularPortGpioGet(CELLULAR_PORT_TEST_PIN_C) == 1);
 
+    // Ask for an interrupt when pin C falls
+    CELLULAR_PORT_TEST_ASSERT(cellularPortQueueCreate(1, sizeof(int32_t),
+                                                      &queueHandle) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortGpioInterruptSet(CELLULAR_PORT_TEST_PIN_C,
+                                                           CELLULAR_PORT_GPIO_INTERRUPT_FALLING_EDGE,
+                                                           queueHandle) == 0);
+
     // Set pin A low
     CELLULAR_PORT_TEST_ASSERT(cellularPortGpioSet(CELLULAR_PORT_TEST_PIN_A, 0) == 0);
     cellularPortTaskBlock(1);
@@ -590,6 +979,24 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularPortTestGpio(),
     CELLULAR_PORT_TEST_ASSERT(cellularPortGpioGet(CELLULAR_PORT_TEST_PIN_B) == 0);
     CELLULAR_PORT_TEST_ASSERT(cellularPortGpioGet(CELLULAR_PORT_TEST_PIN_C) == 0);
 
+    // Pin C should have interrupted, once
+    CELLULAR_PORT_TEST_ASSERT(cellularPortQueueTryReceive(queueHandle, 100,
+                                                          &pin) == 0);
+    CELLULAR_PORT_TEST_ASSERT(pin == CELLULAR_PORT_TEST_PIN_C);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortQueueTryReceive(queueHandle, 100,
+                                                          &pin) != 0);
+
+    // Remove the interrupt: a rising edge shouldn't interrupt
+    // anyway but make sure that nothing is sent now
+    CELLULAR_PORT_TEST_ASSERT(cellularPortGpioInterruptSet(CELLULAR_PORT_TEST_PIN_C,
+                                                           CELLULAR_PORT_GPIO_INTERRUPT_NONE,
+                                                           NULL) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortGpioSet(CELLULAR_PORT_TEST_PIN_A, 1) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortGpioSet(CELLULAR_PORT_TEST_PIN_A, 0) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortQueueTryReceive(queueHandle, 100,
+                                                          &pin) != 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortQueueDelete(queueHandle) == 0);
+
     // Make pin B an output, low, open drain
     CELLULAR_PORT_TEST_ASSERT(cellularPortGpioSet(CELLULAR_PORT_TEST_PIN_B, 0) == 0);
     gpioConfig.pin = CELLULAR_PORT_TEST_PIN_B;
@@ -667,10 +1074,40 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularPortTestUart(),
     // Run a UART test at 115,200
 #if (CELLULAR_PORT_TEST_PIN_UART_CTS >= 0) && (CELLULAR_PORT_TEST_PIN_UART_RTS >= 0)
     // ...with flow control
-    runUartTest(50000, 115200, true);
+    runUartTest(50000, 115200, -1, true, false);
 #endif
     // ...without flow control
-    runUartTest(50000, 115200, false);
+    runUartTest(50000, 115200, -1, false, false);
+    // ...and again having changed speed on the fly
+    runUartTest(50000, 115200, 460800, false, false);
+    // ...and again with a larger receive buffer
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartSetRxBufferSize(CELLULAR_PORT_TEST_UART,
+                                                              CELLULAR_PORT_UART_RX_BUFFER_SIZE * 2) == 0);
+    runUartTest(50000, 115200, -1, false, false);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartSetRxBufferSize(CELLULAR_PORT_TEST_UART, 0) == 0);
+    // ...and again suspending the UART part way through
+    runUartTest(50000, 115200, -1, false, true);
+
+    cellularPortDeinit();
+}
+
+/** Benchmark the UART: event latency, throughput and lost
+ * bytes across baud rates and receive buffer sizes, with flow
+ * control off.  The results are logged, there is no pass mark.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularPortTestUartBenchmark(),
+                            "portUartBenchmark",
+                            "port")
+{
+    CELLULAR_PORT_TEST_ASSERT(cellularPortInit() == 0);
+
+    uartFlowControlPinsGo();
+    for (size_t x = 0; x < sizeof(gUartBenchmarkBaudRate) / sizeof(gUartBenchmarkBaudRate[0]); x++) {
+        for (size_t y = 0; y < sizeof(gUartBenchmarkRxBufferSize) / sizeof(gUartBenchmarkRxBufferSize[0]); y++) {
+            runUartBenchmark(gUartBenchmarkBaudRate[x], gUartBenchmarkRxBufferSize[y]);
+        }
+    }
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartSetRxBufferSize(CELLULAR_PORT_TEST_UART, 0) == 0);
 
     cellularPortDeinit();
 }
@@ -51,7 +51,12 @@
  */
 #define CELLULAR_SOCK_OPT_REUSEADDR    0x0004
 
-/** Socket option: keep connections alive.
+/** Socket option: keep connections alive.  For a TCP socket
+ * this is passed to the module (AT+USOSO), which then sends the
+ * keep-alive probes itself, once the connection has been idle
+ * for CELLULAR_SOCK_OPT_TCP_KEEPIDLE, without any involvement of
+ * this MCU; there is no need for an application-level heartbeat
+ * to keep a NAT binding or a long-lived connection open.
  * The value matches LWIP.
  */
 #define CELLULAR_SOCK_OPT_KEEPALIVE    0x0008
@@ -81,12 +86,26 @@
  */
 #define CELLULAR_SOCK_OPT_REUSEPORT    0x0200
 
-/** Socket option: send buffer size.
+/** Socket option: send buffer size.  For a TCP socket this
+ * sets the size of a local send buffer (default zero, i.e. none,
+ * limited to CELLULAR_SOCK_MAX_SEGMENT_LENGTH_BYTES) in which
+ * small writes are coalesced into a single AT+USOWR.  Buffered
+ * data is sent when the buffer is full, on the first write after
+ * CELLULAR_CFG_SOCK_TX_COALESCE_TIME_MS, when
+ * CELLULAR_SOCK_OPT_TCP_NODELAY is set and before a read, select,
+ * shutdown or close.  Setting CELLULAR_SOCK_OPT_TCP_NODELAY
+ * switches coalescing off.
  * The value matches LWIP.
  */
 #define CELLULAR_SOCK_OPT_SNDBUF       0x1001
 
-/** Socket option: receive buffer size.
+/** Socket option: receive buffer size.  For a TCP socket this
+ * sets the size of a local read-ahead buffer (default zero, i.e.
+ * none, limited to CELLULAR_SOCK_MAX_SEGMENT_LENGTH_BYTES): reads
+ * smaller than this fetch a whole buffer-full from the module
+ * in one go and subsequent reads are served from RAM.  This
+ * is useful for TLS where small record headers are read
+ * separately from the record body.
  * The value matches LWIP.
  */
 #define CELLULAR_SOCK_OPT_RCVBUF       0x1002
@@ -131,6 +150,17 @@
  */
 #define CELLULAR_SOCK_OPT_NO_CHECK     0x100a
 
+/** Socket option: have the module run TLS on a TCP socket
+ * using one of its security profiles, set up beforehand with
+ * cellularCtrlSecurityProfileSet(), so that the handshake and
+ * the encryption happen in the module and only plain text
+ * crosses the UART.  The parameter is an int32_t, the security
+ * profile ID, or -1 to switch TLS off again.  This can only be
+ * set before the socket is connected.  This is NOT an LWIP
+ * option.
+ */
+#define CELLULAR_SOCK_OPT_SECURE_PROFILE 0x2001
+
 /* ----------------------------------------------------------------
  * COMPILE-TIME MACROS: SOCKET OPTIONS FOR IP LEVEL (0)
  * -------------------------------------------------------------- */
@@ -157,12 +187,20 @@
  */
 #define CELLULAR_SOCK_OPT_LEVEL_TCP     6
 
-/** TCP socket option: turn off Nagle's algorithm.
+/** TCP socket option: turn off Nagle's algorithm.  This is
+ * passed to the module (AT+USOSO) and also switches off the
+ * local coalescing of CELLULAR_SOCK_OPT_SNDBUF.
  * The value matches LWIP.
  */
 #define CELLULAR_SOCK_OPT_TCP_NODELAY  0x0001
 
-/** TCP socket option: turn off Nagle's algorithm.
+/** TCP socket option: the time, in milliseconds, for which a
+ * connection must be idle before the module sends keep-alive
+ * probes, should CELLULAR_SOCK_OPT_KEEPALIVE be set.  This is
+ * passed to the module (AT+USOSO); the module default is two
+ * hours, which is usually longer than a mobile network's NAT
+ * will keep an idle TCP connection open.  Not supported by
+ * SARA-R4.
  * The value matches LWIP.
  */
 #define CELLULAR_SOCK_OPT_TCP_KEEPIDLE 0x0002
@@ -200,6 +238,12 @@
  */
 #define CELLULAR_SOCK_ADDRESS_STRING_MAX_LENGTH_BYTES 64
 
+/** The maximum length of a host name, including the terminator,
+ * that can be held in the DNS cache or passed to
+ * cellularSockGetHostByNameAsync().
+ */
+#define CELLULAR_SOCK_HOST_NAME_MAX_LENGTH_BYTES 64
+
 /** The maximum amount of data that we can cram in
  * over the cellular interface in one go.  For UDP this
  * is the maximum packet size, though of course the public
@@ -216,12 +260,14 @@
  */
 #define CELLULAR_SOCK_MODULE_MAX_NUM_SOCKETS 7
 
-/** The number of statically allocated sockets.  When
- * more than this number of sockets are required to
- * be open simultaneously they will be malloc()ed and
- * it is up to the user to call cellularSockCleanUp()
- * to release the memory occupied by closed malloc()ed
- * sockets when done.
+/** The number of statically allocated sockets.  With this
+ * equal to CELLULAR_SOCK_MAX, the default, the static
+ * sockets are a fixed pool and no socket is ever malloc()ed.
+ * If it is made smaller, when more than this number of
+ * sockets are required to be open simultaneously they will
+ * be malloc()ed and it is up to the user to call
+ * cellularSockCleanUp() to release the memory occupied by
+ * closed malloc()ed sockets when done.
  */
 #define CELLULAR_SOCK_NUM_STATIC_SOCKETS CELLULAR_SOCK_MODULE_MAX_NUM_SOCKETS
 
@@ -264,10 +310,9 @@
 
 /** Determine if the bit corresponding to a given file descriptor is set.
  */
-#define CELLULAR_SOCK_FD_ISSET(d, pSet) if (((d) >= 0) &&                               \
-                                            ((d) < CELLULAR_SOCK_DESCRIPTOR_SETSIZE)) { \
-                                            (*(pSet))[(d) / 8] & (1 << ((d) & 7));      \
-                                        }
+#define CELLULAR_SOCK_FD_ISSET(d, pSet) ((((d) >= 0) &&                                \
+                                          ((d) < CELLULAR_SOCK_DESCRIPTOR_SETSIZE)) && \
+                                         (((*(pSet))[(d) / 8] & (1 << ((d) & 7))) != 0))
 
 /* ----------------------------------------------------------------
  * TYPES
@@ -331,6 +376,27 @@ typedef enum {
     CELLULAR_SOCK_SHUTDOWN_READ_WRITE = 2
 } CellularSockShutdown_t;
 
+/** One of a list of buffers to send with cellularSockWriteV().
+ * This struct matches struct iovec of LWIP.
+ */
+typedef struct {
+    void *iov_base;
+    size_t iov_len;
+} CellularSockIovec_t;
+
+/** One of a list of datagrams to send with
+ * cellularSockSendToBatch().
+ */
+typedef struct {
+    const CellularSockAddress_t *pRemoteAddress; //<! may be NULL, see
+                                                 // cellularSockSendTo().
+    const void *pData;    //<! the data to send.
+    size_t dataSizeBytes; //<! the number of bytes at pData.
+    int32_t result;       //<! filled in: the number of bytes
+                          // sent else the negated errno value,
+                          // e.g. -CELLULAR_SOCK_EMSGSIZE.
+} CellularSockDatagram_t;
+
 /** Struct to define the CELLULAR_SOCK_OPT_LINGER socket option.
  * This struct matches that of LWIP.
  */
@@ -339,6 +405,31 @@ typedef struct {
        int32_t l_linger;  //<! linger time in seconds.
 } CellularSockLinger_t;
 
+/** Statistics for a socket, see cellularSockGetStats().  The
+ * counters run from creation of the socket or from the last
+ * call to cellularSockResetStats().
+ */
+typedef struct {
+    uint32_t bytesTx;           //<! bytes the module has taken to send.
+    uint32_t bytesRx;           //<! bytes received from the module.
+    uint32_t numAtCommands;     //<! AT+USOWR, AT+USOST, AT+USORD and
+                                // AT+USORF commands sent.
+    uint32_t numPartialWrites;  //<! AT+USOWR commands for which the
+                                // module took fewer bytes than it
+                                // was given, each costing a retry.
+    uint32_t numErrors;         //<! sends and receives that failed,
+                                // not counting those that would
+                                // have blocked.
+    int64_t blockedMs;          //<! time spent blocked in a receive
+                                // waiting for data to arrive.
+    uint32_t numUrcReads;       //<! reads that followed a data URC,
+                                // i.e. +UUSORD or +UUSORF.
+    int64_t urcToReadTotalMs;   //<! total time from a data URC to
+                                // the read that followed it.
+    int32_t urcToReadMaxMs;     //<! longest time from a data URC to
+                                // the read that followed it.
+} CellularSockStats_t;
+
 /** Error codes.
  */
 typedef enum {
@@ -372,7 +463,35 @@ typedef enum {
 int32_t cellularSockCreate(CellularSockType_t type,
                            CellularSockProtocol_t protocol);
 
+/** Create a socket that uses a PDP context other than the
+ * one brought up by cellularCtrlConnect(), e.g. one activated
+ * with cellularCtrlActivateContext() on a private APN.  The
+ * context must be active when the socket is created and when
+ * it is connected, else errno will be set to
+ * CELLULAR_SOCK_ENETDOWN.  cellularSockCreate() is the same
+ * as calling this with CELLULAR_CTRL_CONTEXT_ID.
+ *
+ * @param type      the type of socket to create.
+ * @param protocol  the protocol that will run over the given
+ *                  socket.
+ * @param contextId the ID of the PDP context to use.
+ * @return          the descriptor of the socket else negative
+ *                  error code.
+ */
+int32_t cellularSockCreateOnContext(CellularSockType_t type,
+                                    CellularSockProtocol_t protocol,
+                                    int32_t contextId);
+
 /** Make an outgoing connection on the given socket.
+ * If the socket is a non-blocking TCP socket and the module
+ * supports it (CELLULAR_SOCK_ASYNC_CONNECT_IS_SUPPORTED) this
+ * returns without waiting for the remote host, errno being
+ * set to CELLULAR_SOCK_EINPROGRESS, as BSD does: the socket
+ * becomes writable in cellularSockSelect() when the connection
+ * has been made or has failed, reading CELLULAR_SOCK_OPT_ERROR
+ * with cellularSockGetOption() then gives zero or the errno
+ * of the failure.  A callback may also be registered with
+ * cellularSockRegisterCallbackConnected().
  *
  * @param descriptor     the descriptor of the socket.
  * @param pRemoteAddress the address of the remote host to connect
@@ -384,6 +503,13 @@ int32_t cellularSockConnect(CellularSockDescriptor_t descriptor,
 
 /** Close a socket.  Note that a TCP socket should be shutdown
  * with a call to cellularSockShutdown() before it is closed.
+ * If the module supports it
+ * (CELLULAR_SOCK_ASYNC_CLOSE_IS_SUPPORTED) a connected TCP
+ * socket is closed without waiting for the remote host to
+ * complete the closure, the callback registered by
+ * cellularSockRegisterCallbackClosed() being called when it
+ * has; either way the socket may no longer be used once
+ * this has returned successfully.
  *
  * @param descriptor the descriptor of the socket to be closed.
  * @return           zero on success else negative error code.
@@ -517,6 +643,28 @@ int32_t cellularSockSendTo(CellularSockDescriptor_t descriptor,
                            const CellularSockAddress_t *pRemoteAddress,
                            const void *pData, size_t dataSizeBytes);
 
+/** Send a batch of datagrams, holding on to the AT interface
+ * for the whole batch rather than for each datagram.  When
+ * consecutive datagrams go to the same address, the address
+ * is only converted to a string once.  A datagram that fails
+ * does not stop the rest of the batch being sent; check the
+ * result field of each entry to find out what happened to
+ * it.  Note that no other AT command can be sent while the
+ * batch is being sent, so don't make the batch too large.
+ *
+ * @param descriptor   the descriptor of the socket.
+ * @param pDatagrams   the datagrams to send; the result
+ *                     field of each one is written.
+ * @param numDatagrams the number of entries at pDatagrams.
+ * @return             on success the number of datagrams
+ *                     successfully sent (which may be fewer
+ *                     than numDatagrams, see the result fields)
+ *                     else negative error code.
+ */
+int32_t cellularSockSendToBatch(CellularSockDescriptor_t descriptor,
+                                CellularSockDatagram_t *pDatagrams,
+                                size_t numDatagrams);
+
 /** Receive a single datagram from the given host.
  *
  * @param descriptor     the descriptor of the socket.
@@ -556,6 +704,43 @@ int32_t cellularSockReceiveFrom(CellularSockDescriptor_t descriptor,
 int32_t cellularSockWrite(CellularSockDescriptor_t descriptor,
                           const void *pData, size_t dataSizeBytes);
 
+/** Send data gathered from several buffers.  The buffers are
+ * streamed to the module one after the other behind the same
+ * AT+USOWR prompt(s), without being copied, so the data goes in
+ * as few AT commands as if it had been a single buffer.
+ *
+ * @param descriptor     the descriptor of the socket.
+ * @param pIov           the list of buffers to send.
+ * @param numIov         the number of entries at pIov.
+ * @return               on success the number of bytes sent else
+ *                       negative error code.
+ */
+int32_t cellularSockWriteV(CellularSockDescriptor_t descriptor,
+                           const CellularSockIovec_t *pIov,
+                           size_t numIov);
+
+/** Send data through the transmit scheduler, see
+ * cellularCtrlTxSchedulerStart(): if the scheduler is running
+ * and deadlineSeconds is greater than zero the data is copied
+ * and held back until the radio conditions are good or
+ * deadlineSeconds have passed, whichever is first, otherwise
+ * this is the same as cellularSockWrite().  Anything written to
+ * the same socket with cellularSockWrite() in the meantime will
+ * overtake what is held back.  The outcome of a send that has
+ * been held back is only logged.
+ *
+ * @param descriptor      the descriptor of the socket.
+ * @param pData           the data to send.
+ * @param dataSizeBytes   the number of bytes of data to send.
+ * @param deadlineSeconds the longest time the data may be held
+ *                        back for, zero or less to send at once.
+ * @return                on success the number of bytes sent
+ *                        or held back, else negative error code.
+ */
+int32_t cellularSockWriteDeferred(CellularSockDescriptor_t descriptor,
+                                  const void *pData, size_t dataSizeBytes,
+                                  int32_t deadlineSeconds);
+
 /** Receive data.
  *
  * @param descriptor     the descriptor of the socket.
@@ -581,6 +766,50 @@ int32_t cellularSockRead(CellularSockDescriptor_t descriptor,
 int32_t cellularSockShutdown(CellularSockDescriptor_t descriptor,
                              CellularSockShutdown_t how);
 
+/** Put a connected TCP socket into, or take it out of,
+ * direct-link mode (AT+USODL).  In direct-link mode the
+ * module passes the bytes on the UART straight to and from
+ * the socket, with none of the AT+USOWR/AT+USORD framing,
+ * so bulk transfers go at close to the UART rate.  While
+ * a socket is in direct-link mode cellularSockWrite(),
+ * cellularSockWriteV() and cellularSockRead() move data as
+ * normal but the socket belongs to the UART: no other AT
+ * command can be sent, so every other socket and every
+ * other cellular API will fail, no URCs arrive and
+ * cellularSockSelect() will not see data arriving on the
+ * socket.  Only one socket can be in direct-link mode at
+ * a time.  Leaving direct-link mode involves a guard time
+ * of CELLULAR_CFG_SOCK_DIRECT_LINK_GUARD_TIME_MS either
+ * side of the escape sequence; cellularSockClose() will
+ * do this for you.  Note that the module may close the
+ * socket of its own accord when direct-link mode ends.
+ *
+ * @param descriptor the descriptor of the socket.
+ * @param onNotOff   true to enter direct-link mode, false
+ *                   to leave it.
+ * @return           zero on success else negative error code.
+ */
+int32_t cellularSockSetDirectLink(CellularSockDescriptor_t descriptor,
+                                  bool onNotOff);
+
+/** Get the statistics of a socket: where its bytes and its
+ * time have gone, e.g. for tuning segment sizes or spotting
+ * stalls.
+ *
+ * @param descriptor the descriptor of the socket.
+ * @param pStats     a place to put the statistics.
+ * @return           zero on success else negative error code.
+ */
+int32_t cellularSockGetStats(CellularSockDescriptor_t descriptor,
+                             CellularSockStats_t *pStats);
+
+/** Reset the statistics of a socket to zero.
+ *
+ * @param descriptor the descriptor of the socket.
+ * @return           zero on success else negative error code.
+ */
+int32_t cellularSockResetStats(CellularSockDescriptor_t descriptor);
+
 /* ----------------------------------------------------------------
  * FUNCTIONS: ASYNC
  * -------------------------------------------------------------- */
@@ -637,6 +866,32 @@ int32_t cellularSockRegisterCallbackClosed(CellularSockDescriptor_t descriptor,
                                            void (*pCallback) (void *),
                                            void *pCallbackParam);
 
+/** Register a callback which will be called when an
+ * asynchronous connect, see cellularSockConnect(), has
+ * completed, whether it succeeded or not: read
+ * CELLULAR_SOCK_OPT_ERROR to find out which.
+ * The callback will be run in a task with stack size
+ * CELLULAR_CTRL_TASK_CALLBACK_STACK_SIZE_BYTES and priority
+ * CELLULAR_CTRL_TASK_CALLBACK_PRIORITY.
+ *
+ * IMPORTANT: don't spend long in your callback, i.e. don't
+ * call back into this API, don't call things that will cause any
+ * sort of processing load or might get stuck.
+ *
+ * @param descriptor     the descriptor of the socket.
+ * @param pCallback      the function to call, use NULL
+ *                       to cancel a previously registered
+ *                       callback.
+ * @param pCallbackParam parameter to be passed to the
+ *                       pCallback function when it is
+ *                       called; may be NULL.
+ * @return               zero on success else negative error
+ *                       code.
+ */
+int32_t cellularSockRegisterCallbackConnected(CellularSockDescriptor_t descriptor,
+                                              void (*pCallback) (void *),
+                                              void *pCallbackParam);
+
 /* ----------------------------------------------------------------
  * FUNCTIONS: TCP INCOMING (TCP SERVER) ONLY
  * -------------------------------------------------------------- */
@@ -691,12 +946,21 @@ int32_t cellularSockAccept(CellularSockDescriptor_t descriptor,
  * @param pExceptDescriptorSet  the set of descriptors to check for
  *                              exceptional conditions. May be NULL.
  * @param timeMs                the timeout for the select operation
- *                              in milliseconds.
- * @return                      a positive value if an unblocking
- *                              occurred, zero on timeout, negative
- *                              on any other error.  Use
- *                              CELLULAR_SOCK_FD_ISSET() to determine
- *                              which descriptor(s) were unblocked.
+ *                              in milliseconds; a negative value
+ *                              means wait forever.
+ * @return                      the number of descriptors that are
+ *                              unblocked, counted across all
+ *                              three sets, zero on timeout, negative
+ *                              on any other error.  On success the
+ *                              sets are over-written so that only
+ *                              the unblocked descriptors remain:
+ *                              use CELLULAR_SOCK_FD_ISSET() to
+ *                              determine which they are.  A socket
+ *                              is unblocked for read when it has
+ *                              data waiting or has been closed,
+ *                              for write when it is connected (or
+ *                              is UDP) and for exceptional
+ *                              conditions when it has been closed.
  */
 int32_t cellularSockSelect(int32_t maxDescriptor,
                            CellularSockDescriptorSet_t *pReadDescriptorSet,
@@ -739,11 +1003,48 @@ int32_t cellularSockGetLocalAddress(CellularSockDescriptor_t descriptor,
  *                       of the host.  Set this to NULL to determine
  *                       if a host is there without bothering to return
  *                       the address.
+ *                       Successful look-ups are kept in a cache
+ *                       for CELLULAR_CFG_SOCK_DNS_CACHE_TTL_SECONDS
+ *                       so that a repeated look-up of the same host
+ *                       name does not go to the module.
  * @return               zero on success else negative error code.
  */
 int32_t cellularSockGetHostByName(const char *pHostName,
                                   CellularSockIpAddress_t *pHostIpAddress);
 
+/** Get the IP address of the given host name without blocking:
+ * the look-up is done in a task of its own and the result is
+ * passed to a callback.  Note that the module can do nothing
+ * else over AT while a look-up is in progress, just as with
+ * cellularSockGetHostByName(), it is only the caller that is
+ * free to carry on.  If the answer is already in the DNS cache
+ * the callback is called before this function returns.  The
+ * callback will be run in a task with stack size
+ * CELLULAR_SOCK_TASK_DNS_STACK_SIZE_BYTES and priority
+ * CELLULAR_SOCK_TASK_DNS_PRIORITY.
+ *
+ * @param pHostName      a string representing the host to search
+ *                       for, e.g. "google.com", must be shorter
+ *                       than CELLULAR_SOCK_HOST_NAME_MAX_LENGTH_BYTES;
+ *                       it is copied, it need not be kept.
+ * @param pCallback      the callback, which is given the host name,
+ *                       zero on success else negative error code,
+ *                       the IP address (NULL on failure) and
+ *                       pCallbackParam.
+ * @param pCallbackParam a parameter to pass to the callback.
+ * @return               zero if the callback has been or will
+ *                       be called else negative error code, e.g.
+ *                       CELLULAR_SOCK_WOULD_BLOCK if there are
+ *                       already CELLULAR_CFG_SOCK_DNS_ASYNC_QUEUE_LENGTH
+ *                       look-ups waiting.
+ */
+int32_t cellularSockGetHostByNameAsync(const char *pHostName,
+                                       void (*pCallback) (const char *,
+                                                          int32_t,
+                                                          const CellularSockIpAddress_t *,
+                                                          void *),
+                                       void *pCallbackParam);
+
 
 /* ----------------------------------------------------------------
  * FUNCTIONS: ADDRESS CONVERSION
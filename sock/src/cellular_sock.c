@@ -20,11 +20,15 @@
  * cellular_port* to maintain portability.
  */
 
+// The log level threshold of this module, see cellular_port_debug.h.
+#define CELLULAR_PORT_LOG_THRESHOLD CELLULAR_CFG_LOG_LEVEL_SOCK
+
 #ifdef CELLULAR_CFG_OVERRIDE
 # include "cellular_cfg_override.h" // For a customer's configuration override
 #endif
 #include "cellular_cfg_sw.h"
 #include "cellular_cfg_module.h"
+#include "cellular_cfg_os_platform_specific.h"
 #include "cellular_port_clib.h"
 #include "cellular_port.h"
 #include "cellular_port_debug.h"
@@ -40,10 +44,13 @@
  * COMPILE-TIME MACROS
  * -------------------------------------------------------------- */
 
-// Increment a socket descriptor.
-#define CELLULAR_SOCK_INC_DESCRIPTOR(d) (d)++;         \
-                                        if ((d) < 0) { \
-                                            d = 0;     \
+// Increment a socket descriptor, wrapping at the
+// descriptor set size so that every descriptor can be
+// used with cellularSockSelect().
+#define CELLULAR_SOCK_INC_DESCRIPTOR(d) (d)++;                                           \
+                                        if (((d) < 0) ||                                 \
+                                            ((d) >= CELLULAR_SOCK_DESCRIPTOR_SETSIZE)) { \
+                                            d = 0;                                       \
                                         }
 
 // Swap endianness.
@@ -64,14 +71,32 @@
 // this many times then return an error.
 #define CELLULAR_SOCK_TCP_RETRY_LIMIT 10
 
-// The timeout value for a socket close operation: quite large,
-// as the module could be waiting for the ack of the ack of the ack.
+// The timeout value for a synchronous socket close operation:
+// quite large, as the module could be waiting for the ack of the
+// ack of the ack; an asynchronous close, see
+// CELLULAR_SOCK_ASYNC_CLOSE_IS_SUPPORTED, doesn't need it.
 #define CELLULAR_SOCK_CLOSE_TIMEOUT_SECONDS 60
 
+// The timeout value for a synchronous socket connect operation.
+#define CELLULAR_SOCK_CONNECT_TIMEOUT_SECONDS 10
+
 // The value to use for socket-level options when talking to the
 // module (-1 as an int16_t)
 #define CELLULAR_SOCK_OPT_LEVEL_SOCK_INT16 65535
 
+// The number of tasks that can be waiting on socket events
+// (e.g. in cellularSockSelect()) at any one time.  A task
+// that can't get a waiter falls back to polling every
+// CELLULAR_SOCK_WAITER_POLL_INTERVAL_MS.
+#define CELLULAR_SOCK_MAX_NUM_WAITERS CELLULAR_SOCK_MAX
+
+// The polling interval to use when no waiter is available.
+#define CELLULAR_SOCK_WAITER_POLL_INTERVAL_MS 10
+
+#if CELLULAR_CFG_STATIC_ALLOC && (CELLULAR_SOCK_NUM_STATIC_SOCKETS < CELLULAR_SOCK_MAX)
+# error CELLULAR_CFG_STATIC_ALLOC needs CELLULAR_SOCK_NUM_STATIC_SOCKETS to be CELLULAR_SOCK_MAX.
+#endif
+
 /* ----------------------------------------------------------------
  * TYPES
  * -------------------------------------------------------------- */
@@ -79,6 +104,8 @@
 // Socket state
 typedef enum {
     CELLULAR_SOCK_STATE_CREATED,   //<! Freshly created, unsullied.
+    CELLULAR_SOCK_STATE_CONNECTING, //<! TCP connection under way,
+                                    //< waiting for +UUSOCO.
     CELLULAR_SOCK_STATE_CONNECTED, //<! TCP connected or UDP has an address.
     CELLULAR_SOCK_STATE_SHUTDOWN_FOR_READ,  //<! Block all reads.
     CELLULAR_SOCK_STATE_SHUTDOWN_FOR_WRITE, //<! Block all writes.
@@ -96,15 +123,35 @@ typedef enum {
      CellularSockType_t type;
      CellularSockProtocol_t protocol;
      int32_t modemHandle;
+     int32_t contextId;
      CellularSockState_t state;
      CellularSockAddress_t remoteAddress;
      int64_t receiveTimeoutMs;
      bool nonBlocking;
+     volatile int32_t pendingError; //<! errno of a failed asynchronous
+                                    //< connect, for CELLULAR_SOCK_OPT_ERROR.
      volatile int32_t pendingBytes;
+     uint8_t *pRxBuffer;
+     size_t rxBufferSizeBytes;
+     size_t rxBufferStart;
+     size_t rxBufferLength;
+     uint8_t *pTxBuffer;
+     size_t txBufferSizeBytes;
+     size_t txBufferLength;
+     int64_t txBufferStartTimeMs;
+     bool noDelay;
+     bool directLink;
+     int32_t securityProfileId; //<! -1 if the module isn't doing TLS.
      void (*pPendingDataCallback) (void *);
      void *pPendingDataCallbackParam;
      void (*pConnectionClosedCallback) (void *);
      void *pConnectionClosedCallbackParam;
+     void (*pConnectedCallback) (void *);
+     void *pConnectedCallbackParam;
+     volatile int64_t dataUrcTimeMs; //<! when a data URC arrived that
+                                     //< has not yet been read from,
+                                     //< -1 if there isn't one.
+     CellularSockStats_t stats;
  } CellularSockSocket_t;
 
 // A socket container.
@@ -112,10 +159,38 @@ typedef struct CellularSockContainer_t {
     struct CellularSockContainer_t *pPrevious;
     CellularSockDescriptor_t descriptor;
     bool isStatic;
+    CellularPortMutexHandle_t mutex;
+    size_t numUsers; //<! tasks between pContainerLock() and
+                     //< containerUnlock(), protected by
+                     //< gMutexContainer; a container with users
+                     //< is never freed or re-used.
     CellularSockSocket_t socket;
     struct CellularSockContainer_t *pNext;
 } CellularSockContainer_t;
 
+// Something that a task can block on until a URC indicates
+// that the state of one of the sockets may have changed.
+typedef struct {
+    CellularPortQueueHandle_t queue;
+    volatile bool inUse;
+    volatile bool signalled;
+} CellularSockWaiter_t;
+
+// An entry in the DNS cache.
+typedef struct {
+    char hostName[CELLULAR_SOCK_HOST_NAME_MAX_LENGTH_BYTES];
+    CellularSockIpAddress_t ipAddress;
+    int64_t expiryTimeMs; //<! zero if the entry is empty.
+} CellularSockDnsCacheEntry_t;
+
+// A request for the DNS task.
+typedef struct {
+    char hostName[CELLULAR_SOCK_HOST_NAME_MAX_LENGTH_BYTES];
+    void (*pCallback) (const char *, int32_t,
+                       const CellularSockIpAddress_t *, void *);
+    void *pCallbackParam;
+} CellularSockDnsRequest_t;
+
 /* ----------------------------------------------------------------
  * VARIABLES
  * -------------------------------------------------------------- */
@@ -138,6 +213,42 @@ static CellularSockDescriptor_t gNextDescriptor = 0;
 // Containers for statically allocated sockets.
 static CellularSockContainer_t gStaticContainers[CELLULAR_SOCK_NUM_STATIC_SOCKETS];
 
+// Look-up tables of containers indexed by descriptor and by
+// modem handle.  An entry may be stale, e.g. the container may
+// since have been re-used for another socket, so it is only
+// valid if the descriptor/modem handle in the container matches.
+static CellularSockContainer_t *gpContainerByDescriptor[CELLULAR_SOCK_DESCRIPTOR_SETSIZE];
+static CellularSockContainer_t *gpContainerByModemHandle[CELLULAR_SOCK_MODULE_MAX_NUM_SOCKETS];
+
+// Waiters, protected by gMutexCallbacks.
+static CellularSockWaiter_t gWaiters[CELLULAR_SOCK_MAX_NUM_WAITERS];
+
+// The container of the socket that is in direct-link mode,
+// if any: only set with the container and then gMutexContainer
+// locked, cleared with the container locked.
+static CellularSockContainer_t *gpDirectLinkContainer = NULL;
+
+// Mutex to protect the DNS cache and gDnsNumRequests.
+static CellularPortMutexHandle_t gMutexDns = NULL;
+
+#if CELLULAR_CFG_SOCK_DNS_CACHE_NUM_ENTRIES > 0
+// The DNS cache.
+static CellularSockDnsCacheEntry_t gDnsCache[CELLULAR_CFG_SOCK_DNS_CACHE_NUM_ENTRIES];
+#endif
+
+// The queue of requests to the DNS task.
+static CellularPortQueueHandle_t gQueueDns = NULL;
+
+// The DNS task.
+static CellularPortTaskHandle_t gTaskHandleDns = NULL;
+
+// Mutex that the DNS task holds while it is running.
+static CellularPortMutexHandle_t gMutexDnsTaskRunning = NULL;
+
+// The number of requests waiting for or being
+// handled by the DNS task.
+static size_t gDnsNumRequests = 0;
+
 /* ----------------------------------------------------------------
  * STATIC FUNCTION PROTOTYPES (ONLY WHERE REQUIRED)
  * -------------------------------------------------------------- */
@@ -146,6 +257,18 @@ static CellularSockContainer_t gStaticContainers[CELLULAR_SOCK_NUM_STATIC_SOCKET
 // This does NOT lock the mutex, you need to do that.
 static CellularSockContainer_t *pContainerFindByModemHandle(int32_t modemHandle);
 
+// Wake up everyone waiting on a socket event.
+// This does NOT lock gMutexCallbacks, you need to do that.
+static void signalWaiters();
+
+// Unlock a container locked with pContainerLock().
+// This DOES lock gMutexContainer.
+static void containerUnlock(CellularSockContainer_t *pContainer);
+
+// Send anything held in the send buffer of a socket.
+// The container must be locked on entry.
+static int32_t txBufferFlush(CellularSockContainer_t *pContainer);
+
 /* ----------------------------------------------------------------
  * STATIC FUNCTIONS: URCs
  * -------------------------------------------------------------- */
@@ -160,8 +283,7 @@ static void UUSORD_UUSORF_urc(void *pUnused)
     (void) pUnused;
 
     // +UUSORx: <socket>,<length>
-    modemHandle = cellular_ctrl_at_read_int();
-    dataSizeBytes = cellular_ctrl_at_read_int();
+    cellular_ctrl_at_read_fields(NULL, "i,i", &modemHandle, &dataSizeBytes);
 
     if (modemHandle >= 0) {
 
@@ -173,10 +295,20 @@ static void UUSORD_UUSORF_urc(void *pUnused)
         pContainer = pContainerFindByModemHandle(modemHandle);
         if (pContainer != NULL) {
             pContainer->socket.pendingBytes = dataSizeBytes;
+            if (pContainer->socket.dataUrcTimeMs < 0) {
+                // Time from the first URC, later ones
+                // only say that there is more
+                pContainer->socket.dataUrcTimeMs = cellularPortGetTickTimeMs();
+            }
             CELLULAR_PORT_MUTEX_LOCK(gMutexCallbacks);
+            signalWaiters();
             if (pContainer->socket.pPendingDataCallback != NULL) {
-                cellular_ctrl_at_callback(pContainer->socket.pPendingDataCallback,
-                                          pContainer->socket.pPendingDataCallbackParam);
+                // Repeated data notifications for the same socket
+                // say nothing new, don't let them queue up
+                cellular_ctrl_at_callback_priority(pContainer->socket.pPendingDataCallback,
+                                                   pContainer->socket.pPendingDataCallbackParam,
+                                                   CELLULAR_CTRL_AT_CALLBACK_PRIORITY_LOW,
+                                                   true);
             }
             CELLULAR_PORT_MUTEX_UNLOCK(gMutexCallbacks);
         }
@@ -203,6 +335,7 @@ static void UUSOCL_urc(void *pUnused)
             // Mark the container as closed
             pContainer->socket.state = CELLULAR_SOCK_STATE_CLOSED;
             CELLULAR_PORT_MUTEX_LOCK(gMutexCallbacks);
+            signalWaiters();
             if (pContainer->socket.pConnectionClosedCallback != NULL) {
                 cellular_ctrl_at_callback(pContainer->socket.pConnectionClosedCallback,
                                           pContainer->socket.pConnectionClosedCallbackParam);
@@ -212,6 +345,45 @@ static void UUSOCL_urc(void *pUnused)
     }
 }
 
+// Callback for the URC indicating that an asynchronous
+// connect has completed.
+static void UUSOCO_urc(void *pUnused)
+{
+    int32_t modemHandle;
+    int32_t socketError;
+    CellularSockContainer_t *pContainer = NULL;
+
+    (void) pUnused;
+
+    // +UUSOCO: <socket>,<socket_error>
+    modemHandle = cellular_ctrl_at_read_int();
+    socketError = cellular_ctrl_at_read_int();
+    if (modemHandle >= 0) {
+
+        // Don't lock the container mutex here, as for UUSOCL_urc()
+        pContainer = pContainerFindByModemHandle(modemHandle);
+        if ((pContainer != NULL) &&
+            (pContainer->socket.state == CELLULAR_SOCK_STATE_CONNECTING)) {
+            if (socketError == 0) {
+                pContainer->socket.state = CELLULAR_SOCK_STATE_CONNECTED;
+            } else {
+                // Back to the start, with the reason kept
+                // for CELLULAR_SOCK_OPT_ERROR
+                pContainer->socket.pendingError = CELLULAR_SOCK_EHOSTUNREACH;
+                pContainer->socket.state = CELLULAR_SOCK_STATE_CREATED;
+            }
+            // Writable either way, let anyone select()ing know
+            CELLULAR_PORT_MUTEX_LOCK(gMutexCallbacks);
+            signalWaiters();
+            if (pContainer->socket.pConnectedCallback != NULL) {
+                cellular_ctrl_at_callback(pContainer->socket.pConnectedCallback,
+                                          pContainer->socket.pConnectedCallbackParam);
+            }
+            CELLULAR_PORT_MUTEX_UNLOCK(gMutexCallbacks);
+        }
+    }
+}
+
 // Callback for Connection Lost URC.
 static void UUPSDD_urc(void *pUnused)
 {
@@ -235,24 +407,39 @@ static bool init()
     CellularSockContainer_t *pTmp = NULL;
     CellularSockContainer_t **ppPreviousNext = NULL;
 
-    // The mutexes are set up once only
+    // The mutexes and the waiter queues are set up once only
     if (gMutexContainer == NULL) {
         cellularPortMutexCreate(&gMutexContainer);
     }
     if (gMutexCallbacks == NULL) {
         cellularPortMutexCreate(&gMutexCallbacks);
     }
+    for (size_t x = 0; x < sizeof(gStaticContainers) / sizeof(gStaticContainers[0]); x++) {
+        if (gStaticContainers[x].mutex == NULL) {
+            cellularPortMutexCreate(&(gStaticContainers[x].mutex));
+        }
+    }
+    for (size_t x = 0; x < sizeof(gWaiters) / sizeof(gWaiters[0]); x++) {
+        if (gWaiters[x].queue == NULL) {
+            // Length two since a signal may be left over
+            // from the previous pass of a waiting loop
+            cellularPortQueueCreate(2, sizeof(uint8_t),
+                                    &(gWaiters[x].queue));
+        }
+    }
 
     if (!gInitialised) {
         cellular_ctrl_at_set_urc_handler("+UUSORD:", UUSORD_UUSORF_urc, NULL);
         cellular_ctrl_at_set_urc_handler("+UUSORF:", UUSORD_UUSORF_urc, NULL);
         cellular_ctrl_at_set_urc_handler("+UUSOCL:", UUSOCL_urc, NULL);
+        cellular_ctrl_at_set_urc_handler("+UUSOCO:", UUSOCO_urc, NULL);
         cellular_ctrl_at_set_urc_handler("+UUPSDD:", UUPSDD_urc, NULL);
 
         //  Link the static containers into the start of the container list
         for (size_t x = 0; x < sizeof(gStaticContainers) / sizeof(gStaticContainers[0]); x++) {
             *ppContainer = &gStaticContainers[x];
             (*ppContainer)->isStatic = true;
+            (*ppContainer)->descriptor = -1;
             (*ppContainer)->socket.state= CELLULAR_SOCK_STATE_CLOSED;
             (*ppContainer)->pNext = NULL;
             if (ppPreviousNext != NULL) {
@@ -279,6 +466,7 @@ static void deinitButNotMutex()
         cellular_ctrl_at_remove_urc_handler("+UUSORD:");
         cellular_ctrl_at_remove_urc_handler("+UUSORF:");
         cellular_ctrl_at_remove_urc_handler("+UUSOCL:");
+        cellular_ctrl_at_remove_urc_handler("+UUSOCO:");
         cellular_ctrl_at_remove_urc_handler("+UUPSDD:");
         gInitialised = false;
     }
@@ -305,15 +493,33 @@ static bool inline isBigEndian()
 static CellularSockContainer_t *pContainerFindByDescriptor(CellularSockDescriptor_t descriptor)
 {
     CellularSockContainer_t *pContainer = NULL;
-    CellularSockContainer_t *pContainerThis = gpContainerListHead;
 
-    while ((pContainerThis != NULL) &&
-           (pContainer == NULL)) {
-        if ((pContainerThis->descriptor == descriptor) &&
-            (pContainerThis->socket.state != CELLULAR_SOCK_STATE_CLOSED)) {
-            pContainer = pContainerThis;
+    if ((descriptor >= 0) && (descriptor < CELLULAR_SOCK_DESCRIPTOR_SETSIZE)) {
+        pContainer = gpContainerByDescriptor[descriptor];
+        if ((pContainer != NULL) &&
+            ((pContainer->descriptor != descriptor) ||
+             (pContainer->socket.state == CELLULAR_SOCK_STATE_CLOSED))) {
+            pContainer = NULL;
+        }
+    }
+
+    return pContainer;
+}
+
+// Find a socket container in state CLOSED that still
+// carries the given descriptor.
+// This does NOT lock the mutex, you need to do that.
+static CellularSockContainer_t *pContainerFindClosedByDescriptor(CellularSockDescriptor_t descriptor)
+{
+    CellularSockContainer_t *pContainer = NULL;
+
+    if ((descriptor >= 0) && (descriptor < CELLULAR_SOCK_DESCRIPTOR_SETSIZE)) {
+        pContainer = gpContainerByDescriptor[descriptor];
+        if ((pContainer != NULL) &&
+            ((pContainer->descriptor != descriptor) ||
+             (pContainer->socket.state != CELLULAR_SOCK_STATE_CLOSED))) {
+            pContainer = NULL;
         }
-        pContainerThis = pContainerThis->pNext;
     }
 
     return pContainer;
@@ -321,24 +527,112 @@ static CellularSockContainer_t *pContainerFindByDescriptor(CellularSockDescripto
 
 // Find the socket container for the given modem handle.
 // Will not find sockets in state CLOSED.
-// This does NOT lock the mutex, you need to do that.
+// This does NOT lock the mutex, you need to do that; it is
+// called from URC context so must never allocate or block.
 static CellularSockContainer_t *pContainerFindByModemHandle(int32_t modemHandle)
 {
     CellularSockContainer_t *pContainer = NULL;
-    CellularSockContainer_t *pContainerThis = gpContainerListHead;
 
-    while ((pContainerThis != NULL) &&
-           (pContainer == NULL)) {
-        if ((pContainerThis->socket.modemHandle == modemHandle) &&
-            (pContainerThis->socket.state != CELLULAR_SOCK_STATE_CLOSED)) {
-            pContainer = pContainerThis;
+    if ((modemHandle >= 0) &&
+        (modemHandle < CELLULAR_SOCK_MODULE_MAX_NUM_SOCKETS)) {
+        pContainer = gpContainerByModemHandle[modemHandle];
+        if ((pContainer != NULL) &&
+            ((pContainer->socket.modemHandle != modemHandle) ||
+             (pContainer->socket.state == CELLULAR_SOCK_STATE_CLOSED))) {
+            pContainer = NULL;
+        }
+    }
+
+    return pContainer;
+}
+
+// Remove any look-up table entries for a container, which
+// must be done before a malloc()ed container is free()d.
+// This does NOT lock the mutex, you need to do that.
+static void containerUnindex(CellularSockContainer_t *pContainer)
+{
+    for (size_t x = 0; x < sizeof(gpContainerByDescriptor) /
+                           sizeof(gpContainerByDescriptor[0]); x++) {
+        if (gpContainerByDescriptor[x] == pContainer) {
+            gpContainerByDescriptor[x] = NULL;
+        }
+    }
+    for (size_t x = 0; x < sizeof(gpContainerByModemHandle) /
+                           sizeof(gpContainerByModemHandle[0]); x++) {
+        if (gpContainerByModemHandle[x] == pContainer) {
+            gpContainerByModemHandle[x] = NULL;
+        }
+    }
+}
+
+// Find the socket container for the given descriptor and
+// lock it: gMutexContainer is only held for the look-up,
+// the container lock is held for the operation on the
+// socket so that sockets are independent of one another.
+// gMutexContainer is NOT held while waiting for the container
+// lock, which may be held for as long as a blocking receive,
+// since containerUnlock() needs it; the container is instead
+// marked as in use so that it cannot be freed or re-used in
+// the meantime and, once locked, is checked to still be the
+// same open socket.  Hence whoever holds gMutexContainer
+// must never wait for the lock of a container that has users.
+// Will not find sockets in state CLOSED.
+// This DOES lock gMutexContainer, call containerUnlock()
+// when done.
+static CellularSockContainer_t *pContainerLock(CellularSockDescriptor_t descriptor)
+{
+    CellularSockContainer_t *pContainer;
+
+    cellularPortMutexLock(gMutexContainer);
+    pContainer = pContainerFindByDescriptor(descriptor);
+    if (pContainer != NULL) {
+        pContainer->numUsers++;
+    }
+    cellularPortMutexUnlock(gMutexContainer);
+
+    if (pContainer != NULL) {
+        cellularPortMutexLock(pContainer->mutex);
+        if ((pContainer->descriptor != descriptor) ||
+            (pContainer->socket.state == CELLULAR_SOCK_STATE_CLOSED)) {
+            // Closed while we were waiting
+            containerUnlock(pContainer);
+            pContainer = NULL;
         }
-        pContainerThis = pContainerThis->pNext;
     }
 
     return pContainer;
 }
 
+// Unlock a container locked with pContainerLock(); pContainer
+// may be NULL.
+// This DOES lock gMutexContainer.
+static void containerUnlock(CellularSockContainer_t *pContainer)
+{
+    if (pContainer != NULL) {
+        cellularPortMutexUnlock(pContainer->mutex);
+        cellularPortMutexLock(gMutexContainer);
+        pContainer->numUsers--;
+        cellularPortMutexUnlock(gMutexContainer);
+    }
+}
+
+// Determine the number of containers with users.
+// This does NOT lock the mutex, you need to do that.
+static size_t numContainersWithUsers()
+{
+    CellularSockContainer_t *pContainer = gpContainerListHead;
+    size_t numContainersWithUsers = 0;
+
+    while (pContainer != NULL) {
+        if (pContainer->numUsers > 0) {
+            numContainersWithUsers++;
+        }
+        pContainer = pContainer->pNext;
+    }
+
+    return numContainersWithUsers;
+}
+
 // Determine the number of non-closed sockets.
 // This does NOT lock the mutex, you need to do that.
 static size_t numContainersInUse()
@@ -356,6 +650,47 @@ static size_t numContainersInUse()
     return numContainersInUse;
 }
 
+// Free the read-ahead and send buffers of a socket, if
+// there are any; anything in them is lost.
+// This does NOT lock the mutex, you need to do that.
+static void buffersFree(CellularSockContainer_t *pContainer)
+{
+    cellularPort_free(pContainer->socket.pRxBuffer);
+    pContainer->socket.pRxBuffer = NULL;
+    pContainer->socket.rxBufferSizeBytes = 0;
+    pContainer->socket.rxBufferStart = 0;
+    pContainer->socket.rxBufferLength = 0;
+    cellularPort_free(pContainer->socket.pTxBuffer);
+    pContainer->socket.pTxBuffer = NULL;
+    pContainer->socket.txBufferSizeBytes = 0;
+    pContainer->socket.txBufferLength = 0;
+}
+
+// Copy up to dataSizeBytes out of the read-ahead buffer of
+// a socket, returning the number of bytes copied.
+// This does NOT lock the mutex, you need to do that.
+static size_t rxBufferRead(CellularSockContainer_t *pContainer,
+                           uint8_t *pData, size_t dataSizeBytes)
+{
+    CellularSockSocket_t *pSocket = &(pContainer->socket);
+
+    if (dataSizeBytes > pSocket->rxBufferLength) {
+        dataSizeBytes = pSocket->rxBufferLength;
+    }
+    if (dataSizeBytes > 0) {
+        pCellularPort_memcpy(pData,
+                             pSocket->pRxBuffer + pSocket->rxBufferStart,
+                             dataSizeBytes);
+        pSocket->rxBufferStart += dataSizeBytes;
+        pSocket->rxBufferLength -= dataSizeBytes;
+        if (pSocket->rxBufferLength == 0) {
+            pSocket->rxBufferStart = 0;
+        }
+    }
+
+    return dataSizeBytes;
+}
+
 // Create a socket in a container with the given descriptor.
 // This does NOT lock the mutex, you need to do that.
 static CellularSockContainer_t *pSockContainerCreate(CellularSockDescriptor_t descriptor,
@@ -367,29 +702,49 @@ static CellularSockContainer_t *pSockContainerCreate(CellularSockDescriptor_t de
     CellularSockContainer_t **ppContainerThis = &gpContainerListHead;
 
     // Traverse the list, stopping if there is a container
-    // that holds a closed socket, which we could re-use
+    // that holds a closed socket, which we could re-use,
+    // provided that no-one is still on their way out of a
+    // call on it
     while ((*ppContainerThis != NULL) && (pContainer == NULL)) {
-        if ((*ppContainerThis)->socket.state == CELLULAR_SOCK_STATE_CLOSED) {
+        if (((*ppContainerThis)->socket.state == CELLULAR_SOCK_STATE_CLOSED) &&
+            ((*ppContainerThis)->numUsers == 0)) {
             pContainer = *ppContainerThis;
         }
         pContainerPrevious = *ppContainerThis;
         ppContainerThis = &((*ppContainerThis)->pNext);
     }
 
+#if CELLULAR_SOCK_NUM_STATIC_SOCKETS < CELLULAR_SOCK_MAX
     if (pContainer == NULL) {
         // Reached the end of the list and found no re-usable
         // containers, so allocate memory for the new container
         // and add it to the list
-        pContainer = (CellularSockContainer_t *) pCellularPort_malloc(sizeof (*pContainer));
+        pContainer = (CellularSockContainer_t *) pCellularPort_mallocTag(sizeof (*pContainer),
+                                                                         CELLULAR_PORT_MALLOC_TAG_SOCK);
+        if ((pContainer != NULL) &&
+            (cellularPortMutexCreate(&(pContainer->mutex)) != 0)) {
+            cellularPort_free(pContainer);
+            pContainer = NULL;
+        }
         if (pContainer != NULL) {
             pContainer->pPrevious = pContainerPrevious;
             pContainer->pNext = NULL;
+            pContainer->isStatic = false;
+            pContainer->numUsers = 0;
+            pContainer->socket.pRxBuffer = NULL;
+            pContainer->socket.pTxBuffer = NULL;
             *ppContainerThis = pContainer;
         }
     }
+#else
+    // The static containers are all there is
+    (void) pContainerPrevious;
+#endif
 
     // Set up the new container and socket
     if (pContainer != NULL) {
+        // A re-used container may still have buffers
+        buffersFree(pContainer);
         pContainer->descriptor = descriptor;
         pCellularPort_memset(&(pContainer->socket),
                              0,
@@ -400,50 +755,58 @@ static CellularSockContainer_t *pSockContainerCreate(CellularSockDescriptor_t de
         pContainer->socket.state = CELLULAR_SOCK_STATE_CREATED;
         pContainer->socket.receiveTimeoutMs = CELLULAR_SOCK_RECEIVE_TIMEOUT_DEFAULT_MS;
         pContainer->socket.nonBlocking = false;
+        pContainer->socket.securityProfileId = -1;
         pContainer->socket.pPendingDataCallback = NULL;
         pContainer->socket.pPendingDataCallbackParam = NULL;
         pContainer->socket.pConnectionClosedCallback = NULL;
         pContainer->socket.pConnectionClosedCallbackParam = NULL;
+        pContainer->socket.pConnectedCallback = NULL;
+        pContainer->socket.pConnectedCallbackParam = NULL;
+        pContainer->socket.dataUrcTimeMs = -1;
+        if ((descriptor >= 0) && (descriptor < CELLULAR_SOCK_DESCRIPTOR_SETSIZE)) {
+            gpContainerByDescriptor[descriptor] = pContainer;
+        }
     }
 
     return pContainer;
 }
 
 // Free the container corresponding to the descriptor.
-// Has no effect on static containers.
+// Will not find sockets in state CLOSED, since descriptors
+// are re-used and a closed socket may still hold the same
+// descriptor until cellularSockCleanUp() is called.
+// A static container is simply returned to the pool.
 // This does NOT lock the mutex, you need to do that.
 static bool containerFree(CellularSockDescriptor_t descriptor)
 {
-    CellularSockContainer_t **ppContainer = NULL;
-    CellularSockContainer_t **ppContainerThis = &gpContainerListHead;
+    CellularSockContainer_t *pContainer = pContainerFindByDescriptor(descriptor);
     bool success = false;
 
-    while ((*ppContainerThis != NULL) &&
-           (ppContainer == NULL)) {
-        if ((*ppContainerThis)->descriptor == descriptor) {
-            ppContainer = ppContainerThis;
-        } else {
-            ppContainerThis = &((*ppContainerThis)->pNext);
-        }
-    }
-
-    if ((ppContainer != NULL) && (*ppContainer != NULL)) {
-        if (!(*ppContainer)->isStatic) {
+    if (pContainer != NULL) {
+        if (!pContainer->isStatic) {
             // If we found it, and it wasn't static, free it
+            containerUnindex(pContainer);
             // If there is a previous container, move its pNext
-            if ((*ppContainer)->pPrevious != NULL) {
-                (*ppContainer)->pPrevious->pNext = (*ppContainer)->pNext;
+            if (pContainer->pPrevious != NULL) {
+                pContainer->pPrevious->pNext = pContainer->pNext;
+            } else {
+                // If there is no previous container, must be
+                // at the start of the list so move the head
+                // pointer on instead
+                gpContainerListHead = pContainer->pNext;
             }
             // If there is a next container, move its pPrevious
-            if ((*ppContainer)->pNext != NULL) {
-                (*ppContainer)->pNext->pPrevious = (*ppContainer)->pPrevious;
+            if (pContainer->pNext != NULL) {
+                pContainer->pNext->pPrevious = pContainer->pPrevious;
             }
 
-            // Free the memory and NULL the pointer
-            cellularPort_free(*ppContainer);
-            *ppContainer = NULL;
+            // Free the memory
+            cellularPortMutexDelete(pContainer->mutex);
+            cellularPort_free(pContainer);
         } else {
-            // Nothing to do for a static container, 
+            // Give a static container back to the pool
+            pContainer->socket.state = CELLULAR_SOCK_STATE_CLOSED;
+            pContainer->descriptor = -1;
         }
 
         success = true;
@@ -453,135 +816,586 @@ static bool containerFree(CellularSockDescriptor_t descriptor)
 }
 
 /* ----------------------------------------------------------------
- * STATIC FUNCTIONS: ADDRESS CONVERSION
+ * STATIC FUNCTIONS: WAITERS
  * -------------------------------------------------------------- */
 
-// Given a string, which may be an IP address or a
-// domain name, return a pointer to the separator
-// character for the port number part of it,
-// or NULL if there is no port number
-static const char *pAddressPortSeparator(const char *pAddress)
+// Wake up everyone waiting on a socket event.
+// This does NOT lock gMutexCallbacks, you need to do that.
+static void signalWaiters()
 {
-    const char *pColon = NULL;
-
-    if (pAddress != NULL) {
-        // If there's a square bracket at the start of
-        // the domain string then we've been given an
-        // IPV6 address with port number so move
-        // the pointer to the closing square bracket
-        if (*pAddress == '[') {
-            pAddress = pCellularPort_strchr(pAddress, ']');
+    uint8_t signal = 0;
+
+    for (size_t x = 0; x < sizeof(gWaiters) / sizeof(gWaiters[0]); x++) {
+        // Only send one signal per pass of the waiting loop
+        // so that the queue can never fill and this, which
+        // is called from URC context, can never block
+        if (gWaiters[x].inUse && !gWaiters[x].signalled) {
+            gWaiters[x].signalled = true;
+            cellularPortQueueSend(gWaiters[x].queue, &signal);
         }
-        if (pAddress != NULL) {
-            // Check for a port number on the end
-            pColon = pCellularPort_strchr(pAddress, ':');
-            if (pColon != NULL) {
-                // Check if there are more colons in the
-                // string: if so this is an IPV6 address
-                // without a port number on the end
-                if (pCellularPort_strchr(pColon + 1, ':') != NULL) {
-                    pColon = NULL;
-                }
-            }
+    }
+}
+
+// Get a waiter, returns NULL if none are free.
+static CellularSockWaiter_t *pWaiterAcquire()
+{
+    CellularSockWaiter_t *pWaiter = NULL;
+    uint8_t signal;
+
+    CELLULAR_PORT_MUTEX_LOCK(gMutexCallbacks);
+
+    for (size_t x = 0; (x < sizeof(gWaiters) / sizeof(gWaiters[0])) &&
+                       (pWaiter == NULL); x++) {
+        if ((gWaiters[x].queue != NULL) && !gWaiters[x].inUse) {
+            pWaiter = &(gWaiters[x]);
+            // Flush out anything left by the previous user
+            while (cellularPortQueueTryReceive(pWaiter->queue, 0,
+                                               &signal) == 0) {}
+            pWaiter->signalled = false;
+            pWaiter->inUse = true;
         }
     }
 
-    return pColon;
+    CELLULAR_PORT_MUTEX_UNLOCK(gMutexCallbacks);
+
+    return pWaiter;
 }
 
-// Determine whether the given IP address string is IPV4.
-static bool addressStringIsIpv4(const char *pAddressString)
+// Give a waiter back.
+static void waiterRelease(CellularSockWaiter_t *pWaiter)
 {
-    // If it's got a dot in it, must be IPV4
-    return (pCellularPort_strchr(pAddressString, '.') != NULL);
+    if (pWaiter != NULL) {
+        CELLULAR_PORT_MUTEX_LOCK(gMutexCallbacks);
+        pWaiter->inUse = false;
+        CELLULAR_PORT_MUTEX_UNLOCK(gMutexCallbacks);
+    }
 }
 
-// Convert an IPV4 address string "xxx.yyy.www.zzz:65535" into
-// a struct.
-static bool ipv4StringToAddress(const char *pAddressString,
-                                CellularSockAddress_t *pAddress)
+// Arm a waiter: this must be called BEFORE checking
+// whatever condition is to be waited for so that a
+// URC which arrives during the check is not missed.
+static void waiterArm(CellularSockWaiter_t *pWaiter)
 {
-    bool success = true;
-    uint32_t a;
-    uint32_t b;
-    uint32_t c;
-    uint32_t d;
-    uint32_t port;
-    const char *pColon;
+    if (pWaiter != NULL) {
+        pWaiter->signalled = false;
+    }
+}
 
-    pAddress->ipAddress.type = CELLULAR_SOCK_ADDRESS_TYPE_V4;
-    pAddress->ipAddress.address.ipv4 = 0;
-    pAddress->port = 0;
+// Block until the waiter is signalled or waitMs has passed;
+// a negative waitMs means wait forever.  If pWaiter is NULL
+// this just blocks for a poll interval.
+static void waiterWait(CellularSockWaiter_t *pWaiter, int64_t waitMs)
+{
+    uint8_t signal;
 
-    // Get the IP address part
-    if (cellularPort_sscanf(pAddressString, "%u.%u.%u.%u",
-                            &a, &b, &c, &d) == 4) {
-        // Range check
-        if ((a <= UCHAR_MAX) && (b <= UCHAR_MAX) &&
-            (c <= UCHAR_MAX) && (d <= UCHAR_MAX)) {
+    if (pWaiter != NULL) {
+        if (waitMs < 0) {
+            cellularPortQueueReceive(pWaiter->queue, &signal);
+        } else {
+            if (waitMs > INT32_MAX) {
+                waitMs = INT32_MAX;
+            }
+            cellularPortQueueTryReceive(pWaiter->queue,
+                                        (int32_t) waitMs, &signal);
+        }
+    } else {
+        if ((waitMs < 0) || (waitMs > CELLULAR_SOCK_WAITER_POLL_INTERVAL_MS)) {
+            waitMs = CELLULAR_SOCK_WAITER_POLL_INTERVAL_MS;
+        }
+        cellularPortTaskBlock((int32_t) waitMs);
+    }
+}
 
-            // Calculate the IP address part, network byte order
-            pAddress->ipAddress.address.ipv4 = (a << 24) |
-                                               (b << 16) |
-                                               (c << 8)  |
-                                               (d << 0);
+// Send anything held in the send buffers of all sockets.
+// This DOES lock gMutexContainer.
+static void txBufferFlushAll()
+{
+    CellularSockContainer_t *pContainer;
 
-            // Check for a port number on the end
-            pColon = pCellularPort_strchr(pAddressString, ':');
-            if (pColon != NULL) {
-                // Fill in the port number
-                port = cellularPort_strtol(pColon + 1, NULL, 10);
-                if (port <= USHRT_MAX) {
-                    pAddress->port = port;
-                } else {
-                    success = false;
+    CELLULAR_PORT_MUTEX_LOCK(gMutexContainer);
+
+    for (pContainer = gpContainerListHead; pContainer != NULL;
+         pContainer = pContainer->pNext) {
+        // A socket that is busy will flush itself
+        if ((pContainer->socket.state == CELLULAR_SOCK_STATE_CONNECTED) &&
+            (cellularPortMutexTryLock(pContainer->mutex, 0) == 0)) {
+            txBufferFlush(pContainer);
+            cellularPortMutexUnlock(pContainer->mutex);
+        }
+    }
+
+    CELLULAR_PORT_MUTEX_UNLOCK(gMutexContainer);
+}
+
+// Check which of the descriptors in the given sets are ready,
+// writing the results to the output sets (which must not be NULL),
+// returning the total number of bits set in the output sets or
+// -1 if a descriptor in the input sets is not known.
+// This DOES lock gMutexContainer.
+static int32_t selectCheck(int32_t maxDescriptor,
+                           CellularSockDescriptorSet_t *pReadSetIn,
+                           CellularSockDescriptorSet_t *pWriteSetIn,
+                           CellularSockDescriptorSet_t *pExceptSetIn,
+                           CellularSockDescriptorSet_t *pReadSetOut,
+                           CellularSockDescriptorSet_t *pWriteSetOut,
+                           CellularSockDescriptorSet_t *pExceptSetOut)
+{
+    int32_t numReady = 0;
+    CellularSockContainer_t *pContainer;
+    CellularSockState_t state;
+    bool wantRead;
+    bool wantWrite;
+    bool wantExcept;
+
+    CELLULAR_SOCK_FD_ZERO(pReadSetOut);
+    CELLULAR_SOCK_FD_ZERO(pWriteSetOut);
+    CELLULAR_SOCK_FD_ZERO(pExceptSetOut);
+
+    CELLULAR_PORT_MUTEX_LOCK(gMutexContainer);
+
+    for (int32_t d = 0; (d < maxDescriptor) && (numReady >= 0); d++) {
+        wantRead = (pReadSetIn != NULL) && CELLULAR_SOCK_FD_ISSET(d, pReadSetIn);
+        wantWrite = (pWriteSetIn != NULL) && CELLULAR_SOCK_FD_ISSET(d, pWriteSetIn);
+        wantExcept = (pExceptSetIn != NULL) && CELLULAR_SOCK_FD_ISSET(d, pExceptSetIn);
+        if (wantRead || wantWrite || wantExcept) {
+            pContainer = pContainerFindByDescriptor(d);
+            if (pContainer == NULL) {
+                // May have been closed by the far end, which
+                // must be reported, rather than never opened
+                pContainer = pContainerFindClosedByDescriptor(d);
+            }
+            if (pContainer != NULL) {
+                state = pContainer->socket.state;
+                // Readable if there is data or if a read would
+                // return immediately with an error
+                if (wantRead &&
+                    ((pContainer->socket.pendingBytes > 0) ||
+                     (pContainer->socket.rxBufferLength > 0) ||
+                     (state == CELLULAR_SOCK_STATE_SHUTDOWN_FOR_READ) ||
+                     (state == CELLULAR_SOCK_STATE_SHUTDOWN_FOR_READ_WRITE) ||
+                     (state == CELLULAR_SOCK_STATE_CLOSING) ||
+                     (state == CELLULAR_SOCK_STATE_CLOSED))) {
+                    CELLULAR_SOCK_FD_SET(d, pReadSetOut);
+                    numReady++;
                 }
+                // Sends never wait for buffer space so anything
+                // other than an unconnected TCP socket is writable,
+                // as is one where an asynchronous connect has failed
+                if (wantWrite &&
+                    (((state != CELLULAR_SOCK_STATE_CREATED) &&
+                      (state != CELLULAR_SOCK_STATE_CONNECTING)) ||
+                     (pContainer->socket.pendingError != 0) ||
+                     (pContainer->socket.protocol != CELLULAR_SOCK_PROTOCOL_TCP))) {
+                    CELLULAR_SOCK_FD_SET(d, pWriteSetOut);
+                    numReady++;
+                }
+                if (wantExcept &&
+                    ((state == CELLULAR_SOCK_STATE_CLOSING) ||
+                     (state == CELLULAR_SOCK_STATE_CLOSED))) {
+                    CELLULAR_SOCK_FD_SET(d, pExceptSetOut);
+                    numReady++;
+                }
+            } else {
+                numReady = -1;
             }
-        } else {
-            success = false;
         }
-    } else {
-        success = false;
     }
 
-    return success;
+    CELLULAR_PORT_MUTEX_UNLOCK(gMutexContainer);
+
+    return numReady;
 }
 
-// Convert an IPV6 address string "2001:0db8:85a3:0000:0000:8a2e:0370:7334" 
-// or "[2001:0db8:85a3:0000:0000:8a2e:0370:7334]:65535" into a struct.
-static bool ipv6StringToAddress(const char *pAddressString,
-                                CellularSockAddress_t *pAddress)
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS: DNS
+ * -------------------------------------------------------------- */
+
+// Create the DNS mutex, which is set up once only.
+static bool dnsInit()
 {
-    bool success = true;
-    size_t stringLength = cellularPort_strlen(pAddressString);
-    bool hasPort = false;
-    uint32_t a;
-    uint32_t b;
-    uint32_t c;
-    uint32_t d;
-    uint32_t e;
-    uint32_t f;
-    uint32_t g;
-    uint32_t h;
-    uint32_t port;
-    const char *pStr;
+    if (gMutexDns == NULL) {
+        cellularPortMutexCreate(&gMutexDns);
+    }
 
-    pAddress->ipAddress.type = CELLULAR_SOCK_ADDRESS_TYPE_V6;
-    pCellularPort_memset(pAddress->ipAddress.address.ipv6, 0,
-                         sizeof(pAddress->ipAddress.address.ipv6));
-    pAddress->port = 0;
+    return gMutexDns != NULL;
+}
 
-    // See if there's a '[' on the start
-    if ((stringLength > 0) && (*pAddressString == '[')) {
-        hasPort = true;
-        pAddressString++;
+// Find a host name in the DNS cache, returning true and
+// copying out the IP address if it is there and has
+// not expired.
+// This DOES lock gMutexDns.
+static bool dnsCacheGet(const char *pHostName,
+                        CellularSockIpAddress_t *pIpAddress)
+{
+    bool found = false;
+#if CELLULAR_CFG_SOCK_DNS_CACHE_NUM_ENTRIES > 0
+    size_t length = cellularPort_strlen(pHostName) + 1;
+    CellularSockDnsCacheEntry_t *pEntry;
+
+    CELLULAR_PORT_MUTEX_LOCK(gMutexDns);
+
+    for (size_t x = 0; !found &&
+                       (x < sizeof(gDnsCache) / sizeof(gDnsCache[0])); x++) {
+        pEntry = &(gDnsCache[x]);
+        if ((pEntry->expiryTimeMs != 0) &&
+            (length <= sizeof(pEntry->hostName)) &&
+            (cellularPort_memcmp(pEntry->hostName, pHostName, length) == 0)) {
+            if (cellularPortGetTickTimeMs() < pEntry->expiryTimeMs) {
+                pCellularPort_memcpy(pIpAddress, &(pEntry->ipAddress),
+                                     sizeof(*pIpAddress));
+                found = true;
+            } else {
+                // Stale, empty it
+                pEntry->expiryTimeMs = 0;
+            }
+        }
     }
 
-    // Get the IP address part
-    if (cellularPort_sscanf(pAddressString, "%x:%x:%x:%x:%x:%x:%x:%x",
-                            &a, &b, &c, &d, &e, &f, &g, &h) == 8) {
-        // Range check
-        if ((a <= USHRT_MAX) && (b <= USHRT_MAX) &&
+    CELLULAR_PORT_MUTEX_UNLOCK(gMutexDns);
+#else
+    (void) pHostName;
+    (void) pIpAddress;
+#endif
+
+    return found;
+}
+
+// Put a host name into the DNS cache, replacing the entry
+// that is closest to expiry if the cache is full; host
+// names that are too long are not cached.
+// This DOES lock gMutexDns.
+static void dnsCachePut(const char *pHostName,
+                        const CellularSockIpAddress_t *pIpAddress)
+{
+#if CELLULAR_CFG_SOCK_DNS_CACHE_NUM_ENTRIES > 0
+    size_t length = cellularPort_strlen(pHostName) + 1;
+    CellularSockDnsCacheEntry_t *pEntry = &(gDnsCache[0]);
+
+    if (length <= sizeof(pEntry->hostName)) {
+
+        CELLULAR_PORT_MUTEX_LOCK(gMutexDns);
+
+        for (size_t x = 0; x < sizeof(gDnsCache) / sizeof(gDnsCache[0]); x++) {
+            if ((gDnsCache[x].expiryTimeMs == 0) ||
+                (cellularPort_memcmp(gDnsCache[x].hostName, pHostName, length) == 0)) {
+                // Empty or already there, can't do better
+                pEntry = &(gDnsCache[x]);
+                break;
+            }
+            if (gDnsCache[x].expiryTimeMs < pEntry->expiryTimeMs) {
+                pEntry = &(gDnsCache[x]);
+            }
+        }
+        pCellularPort_memcpy(pEntry->hostName, pHostName, length);
+        pCellularPort_memcpy(&(pEntry->ipAddress), pIpAddress,
+                             sizeof(pEntry->ipAddress));
+        pEntry->expiryTimeMs = cellularPortGetTickTimeMs() +
+                               (CELLULAR_CFG_SOCK_DNS_CACHE_TTL_SECONDS * 1000LL);
+
+        CELLULAR_PORT_MUTEX_UNLOCK(gMutexDns);
+    }
+#else
+    (void) pHostName;
+    (void) pIpAddress;
+#endif
+}
+
+// Empty the DNS cache.
+// This DOES lock gMutexDns.
+static void dnsCacheFlush()
+{
+#if CELLULAR_CFG_SOCK_DNS_CACHE_NUM_ENTRIES > 0
+    if (gMutexDns != NULL) {
+
+        CELLULAR_PORT_MUTEX_LOCK(gMutexDns);
+
+        for (size_t x = 0; x < sizeof(gDnsCache) / sizeof(gDnsCache[0]); x++) {
+            gDnsCache[x].expiryTimeMs = 0;
+        }
+
+        CELLULAR_PORT_MUTEX_UNLOCK(gMutexDns);
+    }
+#endif
+}
+
+// Look up a host name, from the cache if possible else by
+// asking the module, which can take a long time.
+static int32_t dnsLookUp(const char *pHostName,
+                         CellularSockIpAddress_t *pIpAddress,
+                         bool *pIpAddressValid)
+{
+    CellularSockErrorCode_t errorCode = CELLULAR_SOCK_BSD_ERROR;
+    char buffer[CELLULAR_SOCK_ADDRESS_STRING_MAX_LENGTH_BYTES];
+    CellularSockAddress_t address;
+    int32_t bytesRead;
+    int32_t atError;
+
+    *pIpAddressValid = false;
+    if (dnsCacheGet(pHostName, pIpAddress)) {
+        cellularPortLog("CELLULAR_SOCK: IP address of \"%s\" is cached.\n",
+                        pHostName);
+        *pIpAddressValid = true;
+        errorCode = CELLULAR_SOCK_SUCCESS;
+    } else {
+        cellularPortLog("CELLULAR_SOCK: looking up IP address of \"%s\".\n",
+                        pHostName);
+        cellular_ctrl_at_lock();
+        // Allow plenty of time
+        cellular_ctrl_at_set_at_timeout(60000, false);
+        cellular_ctrl_at_cmd_start("AT+UDNSRN=");
+        cellular_ctrl_at_write_int(0);
+        cellular_ctrl_at_write_string(pHostName, true);
+        cellular_ctrl_at_cmd_stop();
+        cellular_ctrl_at_resp_start("+UDNSRN:", false);
+        bytesRead = cellular_ctrl_at_read_string(buffer,
+                                                 sizeof(buffer),
+                                                 false);
+        cellular_ctrl_at_resp_stop();
+        cellular_ctrl_at_restore_at_timeout();
+        atError = cellular_ctrl_at_unlock_return_error();
+        if ((bytesRead >= 0) && (atError == 0)) {
+            // All is good
+            cellularPortLog("CELLULAR_SOCK: found it at \"%.*s\".\n",
+                            bytesRead, buffer);
+            errorCode = CELLULAR_SOCK_SUCCESS;
+            // Convert to struct
+            if (cellularSockStringToAddress(buffer,
+                                            &address) == 0) {
+                pCellularPort_memcpy(pIpAddress,
+                                     &(address.ipAddress),
+                                     sizeof(*pIpAddress));
+                *pIpAddressValid = true;
+                dnsCachePut(pHostName, pIpAddress);
+            }
+        } else {
+            cellularPortLog("CELLULAR_SOCK: host not found.\n");
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Task that does the look-ups for
+// cellularSockGetHostByNameAsync().
+static void dnsTask(void *pParameters)
+{
+    CellularSockDnsRequest_t request;
+    CellularSockIpAddress_t ipAddress;
+    bool ipAddressValid;
+    int32_t errorCode;
+    bool keepGoing = true;
+
+    CELLULAR_PORT_MUTEX_LOCK(gMutexDnsTaskRunning);
+
+    (void) pParameters;
+
+    while (keepGoing) {
+        if (cellularPortQueueReceive(gQueueDns, &request) == 0) {
+            // A NULL callback is the signal to exit
+            keepGoing = (request.pCallback != NULL);
+            if (keepGoing) {
+                errorCode = dnsLookUp(request.hostName, &ipAddress,
+                                      &ipAddressValid);
+                if ((errorCode == 0) && !ipAddressValid) {
+                    // Found but not understood
+                    errorCode = CELLULAR_SOCK_INVALID_ADDRESS;
+                }
+
+                // Free up the slot before the callback so
+                // that it can ask for another look-up
+                CELLULAR_PORT_MUTEX_LOCK(gMutexDns);
+                gDnsNumRequests--;
+                CELLULAR_PORT_MUTEX_UNLOCK(gMutexDns);
+
+                request.pCallback(request.hostName, errorCode,
+                                  (errorCode == 0) ? &ipAddress : NULL,
+                                  request.pCallbackParam);
+            }
+        }
+    }
+
+    CELLULAR_PORT_MUTEX_UNLOCK(gMutexDnsTaskRunning);
+
+    // Delete ourself
+    cellularPortTaskDelete(NULL);
+}
+
+// Start the DNS task if it is not already running.
+// gMutexDns must be locked on entry.
+static bool dnsTaskStart()
+{
+    if (gTaskHandleDns == NULL) {
+        if ((gMutexDnsTaskRunning == NULL) &&
+            (cellularPortMutexCreate(&gMutexDnsTaskRunning) != 0)) {
+            gMutexDnsTaskRunning = NULL;
+        }
+        if ((gMutexDnsTaskRunning != NULL) &&
+            (cellularPortQueueCreate(CELLULAR_CFG_SOCK_DNS_ASYNC_QUEUE_LENGTH,
+                                     sizeof(CellularSockDnsRequest_t),
+                                     &gQueueDns) == 0)) {
+            if (cellularPortTaskCreate(dnsTask, "sock_dns",
+                                       CELLULAR_SOCK_TASK_DNS_STACK_SIZE_BYTES,
+                                       NULL,
+                                       CELLULAR_SOCK_TASK_DNS_PRIORITY,
+                                       &gTaskHandleDns) != 0) {
+                cellularPortQueueDelete(gQueueDns);
+                gQueueDns = NULL;
+                gTaskHandleDns = NULL;
+            }
+        }
+    }
+
+    return gTaskHandleDns != NULL;
+}
+
+// Stop the DNS task, waiting for any look-ups that are
+// queued to complete.
+static void dnsTaskStop()
+{
+    CellularSockDnsRequest_t request;
+
+    if (gTaskHandleDns != NULL) {
+        request.pCallback = NULL;
+        cellularPortQueueSend(gQueueDns, &request);
+        CELLULAR_PORT_MUTEX_LOCK(gMutexDnsTaskRunning);
+        CELLULAR_PORT_MUTEX_UNLOCK(gMutexDnsTaskRunning);
+        cellularPortQueueDelete(gQueueDns);
+        gQueueDns = NULL;
+        gTaskHandleDns = NULL;
+        gDnsNumRequests = 0;
+    }
+}
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS: ADDRESS CONVERSION
+ * -------------------------------------------------------------- */
+
+// Given a string, which may be an IP address or a
+// domain name, return a pointer to the separator
+// character for the port number part of it,
+// or NULL if there is no port number
+static const char *pAddressPortSeparator(const char *pAddress)
+{
+    const char *pColon = NULL;
+
+    if (pAddress != NULL) {
+        // If there's a square bracket at the start of
+        // the domain string then we've been given an
+        // IPV6 address with port number so move
+        // the pointer to the closing square bracket
+        if (*pAddress == '[') {
+            pAddress = pCellularPort_strchr(pAddress, ']');
+        }
+        if (pAddress != NULL) {
+            // Check for a port number on the end
+            pColon = pCellularPort_strchr(pAddress, ':');
+            if (pColon != NULL) {
+                // Check if there are more colons in the
+                // string: if so this is an IPV6 address
+                // without a port number on the end
+                if (pCellularPort_strchr(pColon + 1, ':') != NULL) {
+                    pColon = NULL;
+                }
+            }
+        }
+    }
+
+    return pColon;
+}
+
+// Determine whether the given IP address string is IPV4.
+static bool addressStringIsIpv4(const char *pAddressString)
+{
+    // If it's got a dot in it, must be IPV4
+    return (pCellularPort_strchr(pAddressString, '.') != NULL);
+}
+
+// Convert an IPV4 address string "xxx.yyy.www.zzz:65535" into
+// a struct.
+static bool ipv4StringToAddress(const char *pAddressString,
+                                CellularSockAddress_t *pAddress)
+{
+    bool success = true;
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+    uint32_t d;
+    uint32_t port;
+    const char *pColon;
+
+    pAddress->ipAddress.type = CELLULAR_SOCK_ADDRESS_TYPE_V4;
+    pAddress->ipAddress.address.ipv4 = 0;
+    pAddress->port = 0;
+
+    // Get the IP address part
+    if (cellularPort_sscanf(pAddressString, "%u.%u.%u.%u",
+                            &a, &b, &c, &d) == 4) {
+        // Range check
+        if ((a <= UCHAR_MAX) && (b <= UCHAR_MAX) &&
+            (c <= UCHAR_MAX) && (d <= UCHAR_MAX)) {
+
+            // Calculate the IP address part, network byte order
+            pAddress->ipAddress.address.ipv4 = (a << 24) |
+                                               (b << 16) |
+                                               (c << 8)  |
+                                               (d << 0);
+
+            // Check for a port number on the end
+            pColon = pCellularPort_strchr(pAddressString, ':');
+            if (pColon != NULL) {
+                // Fill in the port number
+                port = cellularPort_strtol(pColon + 1, NULL, 10);
+                if (port <= USHRT_MAX) {
+                    pAddress->port = port;
+                } else {
+                    success = false;
+                }
+            }
+        } else {
+            success = false;
+        }
+    } else {
+        success = false;
+    }
+
+    return success;
+}
+
+// Convert an IPV6 address string "2001:0db8:85a3:0000:0000:8a2e:0370:7334" 
+// or "[2001:0db8:85a3:0000:0000:8a2e:0370:7334]:65535" into a struct.
+static bool ipv6StringToAddress(const char *pAddressString,
+                                CellularSockAddress_t *pAddress)
+{
+    bool success = true;
+    size_t stringLength = cellularPort_strlen(pAddressString);
+    bool hasPort = false;
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+    uint32_t d;
+    uint32_t e;
+    uint32_t f;
+    uint32_t g;
+    uint32_t h;
+    uint32_t port;
+    const char *pStr;
+
+    pAddress->ipAddress.type = CELLULAR_SOCK_ADDRESS_TYPE_V6;
+    pCellularPort_memset(pAddress->ipAddress.address.ipv6, 0,
+                         sizeof(pAddress->ipAddress.address.ipv6));
+    pAddress->port = 0;
+
+    // See if there's a '[' on the start
+    if ((stringLength > 0) && (*pAddressString == '[')) {
+        hasPort = true;
+        pAddressString++;
+    }
+
+    // Get the IP address part
+    if (cellularPort_sscanf(pAddressString, "%x:%x:%x:%x:%x:%x:%x:%x",
+                            &a, &b, &c, &d, &e, &f, &g, &h) == 8) {
+        // Range check
+        if ((a <= USHRT_MAX) && (b <= USHRT_MAX) &&
             (c <= USHRT_MAX) && (d <= USHRT_MAX) &&
             (e <= USHRT_MAX) && (f <= USHRT_MAX) &&
             (g <= USHRT_MAX) && (h <= USHRT_MAX)) {
@@ -960,11 +1774,338 @@ static int32_t getOptionLinger(CellularSockDescriptor_t descriptor,
     return (int32_t) errorCode;
 }
 
+// Set the size of the read-ahead buffer of a TCP socket,
+// zero to not have one.
+static int32_t setOptionRxBuffer(CellularSockContainer_t *pContainer,
+                                 const void *pOptionValue,
+                                 size_t optionValueLength,
+                                 int32_t *pErrno)
+{
+    CellularSockErrorCode_t errorCode = CELLULAR_SOCK_BSD_ERROR;
+    CellularSockSocket_t *pSocket = &(pContainer->socket);
+    int32_t sizeBytes;
+    uint8_t *pBuffer = NULL;
+
+    if ((pOptionValue != NULL) &&
+        (optionValueLength >= sizeof(int32_t)) &&
+        (*((int32_t *) pOptionValue) >= 0) &&
+        (pSocket->protocol == CELLULAR_SOCK_PROTOCOL_TCP)) {
+        // No point in having more than one segment
+        sizeBytes = *((int32_t *) pOptionValue);
+        if (sizeBytes > CELLULAR_SOCK_MAX_SEGMENT_LENGTH_BYTES) {
+            sizeBytes = CELLULAR_SOCK_MAX_SEGMENT_LENGTH_BYTES;
+        }
+        if (sizeBytes >= pSocket->rxBufferLength) {
+            if (sizeBytes > 0) {
+                pBuffer = (uint8_t *) pCellularPort_mallocTag(sizeBytes,
+                                                              CELLULAR_PORT_MALLOC_TAG_SOCK);
+            }
+            if ((sizeBytes == 0) || (pBuffer != NULL)) {
+                // Hang on to anything already read-ahead
+                if (pSocket->rxBufferLength > 0) {
+                    pCellularPort_memcpy(pBuffer,
+                                         pSocket->pRxBuffer + pSocket->rxBufferStart,
+                                         pSocket->rxBufferLength);
+                }
+                cellularPort_free(pSocket->pRxBuffer);
+                pSocket->pRxBuffer = pBuffer;
+                pSocket->rxBufferSizeBytes = sizeBytes;
+                pSocket->rxBufferStart = 0;
+                cellularPortLog("CELLULAR_SOCK: socket with descriptor %d, modem handle %d, has a read-ahead buffer of %d byte(s).\n",
+                                pContainer->descriptor, pSocket->modemHandle,
+                                sizeBytes);
+                errorCode = CELLULAR_SOCK_SUCCESS;
+            } else {
+                *pErrno = CELLULAR_SOCK_ENOMEM;
+            }
+        } else {
+            // Would lose data that has already been read-ahead
+            *pErrno = CELLULAR_SOCK_EBUSY;
+        }
+    } else {
+        *pErrno = CELLULAR_SOCK_EINVAL;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Get the size of the read-ahead buffer of a socket.
+static int32_t getOptionRxBuffer(CellularSockContainer_t *pContainer,
+                                 void *pOptionValue,
+                                 size_t *pOptionValueLength,
+                                 int32_t *pErrno)
+{
+    CellularSockErrorCode_t errorCode = CELLULAR_SOCK_BSD_ERROR;
+
+    if (pOptionValueLength != NULL) {
+        if (pOptionValue != NULL) {
+            if (*pOptionValueLength >= sizeof(int32_t)) {
+                *((int32_t *) pOptionValue) = pContainer->socket.rxBufferSizeBytes;
+                *pOptionValueLength = sizeof(int32_t);
+                errorCode = CELLULAR_SOCK_SUCCESS;
+            } else {
+                // Caller hasn't left enough room
+                *pErrno = CELLULAR_SOCK_EINVAL;
+            }
+        } else {
+            // Caller just wants to know the length required
+            *pOptionValueLength = sizeof(int32_t);
+            errorCode = CELLULAR_SOCK_SUCCESS;
+        }
+    } else {
+        // Invalid argument, there must be a value length pointer
+        *pErrno = CELLULAR_SOCK_EINVAL;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Set the size of the send buffer of a TCP socket, zero
+// to not have one.
+// The container must be locked on entry.
+static int32_t setOptionTxBuffer(CellularSockContainer_t *pContainer,
+                                 const void *pOptionValue,
+                                 size_t optionValueLength,
+                                 int32_t *pErrno)
+{
+    CellularSockErrorCode_t errorCode = CELLULAR_SOCK_BSD_ERROR;
+    CellularSockSocket_t *pSocket = &(pContainer->socket);
+    int32_t sizeBytes;
+
+    if ((pOptionValue != NULL) &&
+        (optionValueLength >= sizeof(int32_t)) &&
+        (*((int32_t *) pOptionValue) >= 0) &&
+        (pSocket->protocol == CELLULAR_SOCK_PROTOCOL_TCP)) {
+        // No point in having more than one segment
+        sizeBytes = *((int32_t *) pOptionValue);
+        if (sizeBytes > CELLULAR_SOCK_MAX_SEGMENT_LENGTH_BYTES) {
+            sizeBytes = CELLULAR_SOCK_MAX_SEGMENT_LENGTH_BYTES;
+        }
+        // Get rid of anything we're holding first
+        if (txBufferFlush(pContainer) == 0) {
+            cellularPort_free(pSocket->pTxBuffer);
+            pSocket->pTxBuffer = NULL;
+            pSocket->txBufferSizeBytes = 0;
+            if (sizeBytes > 0) {
+                pSocket->pTxBuffer = (uint8_t *) pCellularPort_mallocTag(sizeBytes,
+                                                                         CELLULAR_PORT_MALLOC_TAG_SOCK);
+            }
+            if ((sizeBytes == 0) || (pSocket->pTxBuffer != NULL)) {
+                pSocket->txBufferSizeBytes = sizeBytes;
+                cellularPortLog("CELLULAR_SOCK: socket with descriptor %d, modem handle %d, has a send buffer of %d byte(s).\n",
+                                pContainer->descriptor, pSocket->modemHandle,
+                                sizeBytes);
+                errorCode = CELLULAR_SOCK_SUCCESS;
+            } else {
+                *pErrno = CELLULAR_SOCK_ENOMEM;
+            }
+        } else {
+            *pErrno = CELLULAR_SOCK_EIO;
+        }
+    } else {
+        *pErrno = CELLULAR_SOCK_EINVAL;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Get the size of the send buffer of a socket.
+static int32_t getOptionTxBuffer(CellularSockContainer_t *pContainer,
+                                 void *pOptionValue,
+                                 size_t *pOptionValueLength,
+                                 int32_t *pErrno)
+{
+    CellularSockErrorCode_t errorCode = CELLULAR_SOCK_BSD_ERROR;
+
+    if (pOptionValueLength != NULL) {
+        if (pOptionValue != NULL) {
+            if (*pOptionValueLength >= sizeof(int32_t)) {
+                *((int32_t *) pOptionValue) = pContainer->socket.txBufferSizeBytes;
+                *pOptionValueLength = sizeof(int32_t);
+                errorCode = CELLULAR_SOCK_SUCCESS;
+            } else {
+                // Caller hasn't left enough room
+                *pErrno = CELLULAR_SOCK_EINVAL;
+            }
+        } else {
+            // Caller just wants to know the length required
+            *pOptionValueLength = sizeof(int32_t);
+            errorCode = CELLULAR_SOCK_SUCCESS;
+        }
+    } else {
+        // Invalid argument, there must be a value length pointer
+        *pErrno = CELLULAR_SOCK_EINVAL;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Have the module do TLS on a socket using one of its
+// security profiles, or stop it doing so.
+static int32_t setOptionSecureProfile(CellularSockContainer_t *pContainer,
+                                      const void *pOptionValue,
+                                      size_t optionValueLength,
+                                      int32_t *pErrno)
+{
+    CellularSockErrorCode_t errorCode = CELLULAR_SOCK_BSD_ERROR;
+    int32_t securityProfileId;
+
+    if ((pOptionValue != NULL) &&
+        (optionValueLength >= sizeof(int32_t)) &&
+        (pContainer->socket.protocol == CELLULAR_SOCK_PROTOCOL_TCP)) {
+        securityProfileId = *((int32_t *) pOptionValue);
+        if (pContainer->socket.state == CELLULAR_SOCK_STATE_CREATED) {
+            cellular_ctrl_at_lock();
+            cellular_ctrl_at_cmd_start("AT+USOSEC=");
+            cellular_ctrl_at_write_int(pContainer->socket.modemHandle);
+            if (securityProfileId >= 0) {
+                cellular_ctrl_at_write_int(1);
+                cellular_ctrl_at_write_int(securityProfileId);
+            } else {
+                cellular_ctrl_at_write_int(0);
+            }
+            cellular_ctrl_at_cmd_stop_read_resp();
+            if (cellular_ctrl_at_unlock_return_error() == 0) {
+                if (securityProfileId < 0) {
+                    securityProfileId = -1;
+                }
+                pContainer->socket.securityProfileId = securityProfileId;
+                cellularPortLog("CELLULAR_SOCK: socket with descriptor %d, modem handle %d, security profile set to %d.\n",
+                                pContainer->descriptor,
+                                pContainer->socket.modemHandle,
+                                securityProfileId);
+                errorCode = CELLULAR_SOCK_SUCCESS;
+            } else {
+                // Most likely the profile doesn't exist
+                *pErrno = CELLULAR_SOCK_EINVAL;
+            }
+        } else {
+            // Too late, the TLS handshake happens on connection
+            *pErrno = CELLULAR_SOCK_EISCONN;
+        }
+    } else {
+        *pErrno = CELLULAR_SOCK_EINVAL;
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Get the security profile the module is using for TLS
+// on a socket, -1 if none.
+static int32_t getOptionSecureProfile(CellularSockContainer_t *pContainer,
+                                      void *pOptionValue,
+                                      size_t *pOptionValueLength,
+                                      int32_t *pErrno)
+{
+    CellularSockErrorCode_t errorCode = CELLULAR_SOCK_BSD_ERROR;
+
+    if (pOptionValueLength != NULL) {
+        if (pOptionValue != NULL) {
+            if (*pOptionValueLength >= sizeof(int32_t)) {
+                *((int32_t *) pOptionValue) = pContainer->socket.securityProfileId;
+                *pOptionValueLength = sizeof(int32_t);
+                errorCode = CELLULAR_SOCK_SUCCESS;
+            } else {
+                // Caller hasn't left enough room
+                *pErrno = CELLULAR_SOCK_EINVAL;
+            }
+        } else {
+            // Caller just wants to know the length required
+            *pOptionValueLength = sizeof(int32_t);
+            errorCode = CELLULAR_SOCK_SUCCESS;
+        }
+    } else {
+        // Invalid argument, there must be a value length pointer
+        *pErrno = CELLULAR_SOCK_EINVAL;
+    }
+
+    return (int32_t) errorCode;
+}
+
 /* ----------------------------------------------------------------
  * STATIC FUNCTIONS: SENDING AND RECEIVING
  * -------------------------------------------------------------- */
 
+// Determine whether two addresses are the same.
+static bool addressIsSame(const CellularSockAddress_t *pAddress1,
+                          const CellularSockAddress_t *pAddress2)
+{
+    bool isSame = (pAddress1->port == pAddress2->port) &&
+                  (pAddress1->ipAddress.type == pAddress2->ipAddress.type);
+
+    if (isSame) {
+        if (pAddress1->ipAddress.type == CELLULAR_SOCK_ADDRESS_TYPE_V4) {
+            isSame = (pAddress1->ipAddress.address.ipv4 ==
+                      pAddress2->ipAddress.address.ipv4);
+        } else {
+            for (size_t x = 0; isSame &&
+                               (x < sizeof(pAddress1->ipAddress.address.ipv6) /
+                                    sizeof(pAddress1->ipAddress.address.ipv6[0])); x++) {
+                isSame = (pAddress1->ipAddress.address.ipv6[x] ==
+                          pAddress2->ipAddress.address.ipv6[x]);
+            }
+        }
+    }
+
+    return isSame;
+}
+
+// Send a datagram with AT+USOST, the caller having locked
+// the AT interface and turned the IP address into a string.
+// Returns the number of bytes sent or a negated errno value.
+// The container must be locked on entry.
+static int32_t sendToAtLocked(CellularSockContainer_t *pContainer,
+                              const char *pAddressString, uint16_t port,
+                              const void *pData, size_t dataSizeBytes)
+{
+    int32_t sizeOrErrno = -CELLULAR_SOCK_EIO;
+    int32_t sentSize;
+
+    pContainer->socket.stats.numAtCommands++;
+    cellular_ctrl_at_clear_error();
+    cellular_ctrl_at_set_send_delay_class(CELLULAR_CTRL_AT_SEND_DELAY_CLASS_DATA);
+    cellular_ctrl_at_cmd_start("AT+USOST=");
+    // Handle
+    cellular_ctrl_at_write_int(pContainer->socket.modemHandle);
+    // IP address
+    cellular_ctrl_at_write_string(pAddressString, true);
+    // Port number
+    cellular_ctrl_at_write_int(port);
+    // Number of bytes to follow
+    cellular_ctrl_at_write_int(dataSizeBytes);
+    cellular_ctrl_at_cmd_stop();
+    // Wait for the prompt
+    if (cellular_ctrl_at_wait_char('@')) {
+        // Wait for it...
+        cellularPortTaskBlock(CELLULAR_SOCK_PROMPT_GUARD_TIME_MS);
+        // Go!
+        cellular_ctrl_at_write_bytes((uint8_t *) pData,
+                                     dataSizeBytes);
+        // Grab the response
+        cellular_ctrl_at_resp_start("+USOST:", false);
+        // Skip the socket ID
+        cellular_ctrl_at_skip_param(1);
+        // Bytes sent
+        sentSize = cellular_ctrl_at_read_int();
+        cellular_ctrl_at_resp_stop();
+        if (cellular_ctrl_at_get_last_error() == 0) {
+            // All is good, probably
+            sizeOrErrno = sentSize;
+            pContainer->socket.stats.bytesTx += sentSize;
+        } else {
+            // No route to host
+            sizeOrErrno = -CELLULAR_SOCK_EHOSTUNREACH;
+        }
+    }
+    if (sizeOrErrno < 0) {
+        pContainer->socket.stats.numErrors++;
+    }
+
+    return sizeOrErrno;
+}
+
 // Send data, UDP style.
+// The container must be locked on entry.
 int32_t sendTo(CellularSockContainer_t *pContainer,
                const CellularSockAddress_t *pRemoteAddress,
                const void *pData, size_t dataSizeBytes)
@@ -972,7 +2113,7 @@ int32_t sendTo(CellularSockContainer_t *pContainer,
     CellularSockErrorCode_t errorCodeOrSize = CELLULAR_SOCK_BSD_ERROR;
     int32_t errno = CELLULAR_SOCK_ENONE;
     char buffer[CELLULAR_SOCK_ADDRESS_STRING_MAX_LENGTH_BYTES];
-    int32_t sentSize = 0;
+    int32_t sizeOrErrno;
 
     // Get the address as a string
     if (addressToString(pRemoteAddress,
@@ -982,39 +2123,14 @@ int32_t sendTo(CellularSockContainer_t *pContainer,
         if (dataSizeBytes > 0) {
             if (dataSizeBytes <= CELLULAR_SOCK_MAX_SEGMENT_LENGTH_BYTES) {
                 cellular_ctrl_at_lock();
-                cellular_ctrl_at_cmd_start("AT+USOST=");
-                // Handle
-                cellular_ctrl_at_write_int(pContainer->socket.modemHandle);
-                // IP address
-                cellular_ctrl_at_write_string(buffer, true);
-                // Port number
-                cellular_ctrl_at_write_int(pRemoteAddress->port);
-                // Number of bytes to follow
-                cellular_ctrl_at_write_int(dataSizeBytes);
-                cellular_ctrl_at_cmd_stop();
-                // Wait for the prompt
-                if (cellular_ctrl_at_wait_char('@')) {
-                    // Wait for it...
-                    cellularPortTaskBlock(50);
-                    // Go!
-                    cellular_ctrl_at_write_bytes((uint8_t *) pData,
-                                                 dataSizeBytes);
-                    // Grab the response
-                    cellular_ctrl_at_resp_start("+USOST:", false);
-                    // Skip the socket ID
-                    cellular_ctrl_at_skip_param(1);
-                    // Bytes sent
-                    sentSize = cellular_ctrl_at_read_int();
-                    cellular_ctrl_at_resp_stop();
-                    if (cellular_ctrl_at_unlock_return_error() == 0) {
-                        // All is good, probably
-                        errorCodeOrSize = sentSize;
-                    } else {
-                        // No route to host
-                        errno = CELLULAR_SOCK_EHOSTUNREACH;
-                    }
+                sizeOrErrno = sendToAtLocked(pContainer, buffer,
+                                             pRemoteAddress->port,
+                                             pData, dataSizeBytes);
+                cellular_ctrl_at_unlock();
+                if (sizeOrErrno >= 0) {
+                    errorCodeOrSize = sizeOrErrno;
                 } else {
-                    cellular_ctrl_at_unlock();
+                    errno = -sizeOrErrno;
                 }
             } else {
                 // Indicate that the message was too long
@@ -1037,24 +2153,53 @@ int32_t sendTo(CellularSockContainer_t *pContainer,
     return (int32_t) errorCodeOrSize;
 }
 
-// Send data, TCP style.
-int32_t send(CellularSockContainer_t *pContainer,
-             const void *pData, size_t dataSizeBytes)
+// Send data gathered from several buffers, TCP style.
+// The buffers are streamed one after another behind
+// each AT+USOWR prompt so nothing is copied.
+// The container must be locked on entry.
+static int32_t sendV(CellularSockContainer_t *pContainer,
+                     const CellularSockIovec_t *pIov, size_t numIov)
 {
     CellularSockErrorCode_t errorCodeOrSize = CELLULAR_SOCK_BSD_ERROR;
     int32_t errno = CELLULAR_SOCK_ENONE;
     int32_t sentSize = 0;
-    int32_t leftToSendSize = dataSizeBytes;
+    int32_t leftToSendSize = 0;
     int32_t thisSendSize = CELLULAR_SOCK_MAX_SEGMENT_LENGTH_BYTES;
+    int32_t totalSize;
+    int32_t x;
+    int32_t y;
+    size_t iovIndex = 0;
+    size_t iovOffset = 0;
     size_t loopCounter = 0;
     bool success = true;
+#if CELLULAR_CFG_SOCK_WRITE_PIPELINE
+    uint32_t sendDelayMs;
+#endif
+
+    for (size_t z = 0; z < numIov; z++) {
+        leftToSendSize += (pIov + z)->iov_len;
+    }
+    totalSize = leftToSendSize;
+
+#if CELLULAR_CFG_SOCK_WRITE_PIPELINE
+    // Hold on to the AT interface for the whole write
+    // and send each AT+USOWR as soon as the previous
+    // one has been answered
+    cellular_ctrl_at_lock();
+    sendDelayMs = cellular_ctrl_at_get_send_delay();
+    cellular_ctrl_at_set_send_delay(0);
+#endif
 
     while ((leftToSendSize > 0) && success) {
         loopCounter++;
         if (leftToSendSize < thisSendSize) {
             thisSendSize = leftToSendSize;
         }
+#if !CELLULAR_CFG_SOCK_WRITE_PIPELINE
         cellular_ctrl_at_lock();
+#endif
+        pContainer->socket.stats.numAtCommands++;
+        cellular_ctrl_at_set_send_delay_class(CELLULAR_CTRL_AT_SEND_DELAY_CLASS_DATA);
         cellular_ctrl_at_cmd_start("AT+USOWR=");
         // Handle
         cellular_ctrl_at_write_int(pContainer->socket.modemHandle);
@@ -1065,10 +2210,24 @@ int32_t send(CellularSockContainer_t *pContainer,
         success = cellular_ctrl_at_wait_char('@');
         if (success) {
             // Wait for it...
-            cellularPortTaskBlock(50);
-            // Go!
-            cellular_ctrl_at_write_bytes((uint8_t *) pData,
-                                         dataSizeBytes);
+            cellularPortTaskBlock(CELLULAR_SOCK_PROMPT_GUARD_TIME_MS);
+            // Go!  Stream this segment's worth out of
+            // however many buffers it takes, starting
+            // where the last segment left off
+            x = 0;
+            y = iovOffset;
+            for (size_t z = iovIndex; (z < numIov) && (x < thisSendSize); z++) {
+                sentSize = (pIov + z)->iov_len - y;
+                if (sentSize > thisSendSize - x) {
+                    sentSize = thisSendSize - x;
+                }
+                if (sentSize > 0) {
+                    cellular_ctrl_at_write_bytes(((uint8_t *) (pIov + z)->iov_base) + y,
+                                                 sentSize);
+                    x += sentSize;
+                }
+                y = 0;
+            }
             // Grab the response
             cellular_ctrl_at_resp_start("+USOWR:", false);
             // Skip the socket ID
@@ -1076,9 +2235,24 @@ int32_t send(CellularSockContainer_t *pContainer,
             // Bytes sent
             sentSize = cellular_ctrl_at_read_int();
             cellular_ctrl_at_resp_stop();
-            if (cellular_ctrl_at_unlock_return_error() == 0) {
-                pData += sentSize;
+            if ((cellular_ctrl_at_get_last_error() == 0) &&
+                (sentSize >= 0)) {
+                if (sentSize > thisSendSize) {
+                    sentSize = thisSendSize;
+                }
                 leftToSendSize -= sentSize;
+                pContainer->socket.stats.bytesTx += sentSize;
+                if (sentSize < thisSendSize) {
+                    pContainer->socket.stats.numPartialWrites++;
+                }
+                // Move on by however much the module
+                // actually took
+                iovOffset += sentSize;
+                while ((iovIndex < numIov) &&
+                       (iovOffset >= (pIov + iovIndex)->iov_len)) {
+                    iovOffset -= (pIov + iovIndex)->iov_len;
+                    iovIndex++;
+                }
                 // Technically, it should be OK to
                 // send fewer bytes than asked for,
                 // however if this happens a lot we'll
@@ -1091,14 +2265,22 @@ int32_t send(CellularSockContainer_t *pContainer,
             } else {
                 success = false;
             }
-        } else {
-            cellular_ctrl_at_unlock();
         }
+#if !CELLULAR_CFG_SOCK_WRITE_PIPELINE
+        cellular_ctrl_at_unlock();
+#endif
     }
 
-    if (success && (cellular_ctrl_at_get_last_error() == 0)) {
+#if CELLULAR_CFG_SOCK_WRITE_PIPELINE
+    cellular_ctrl_at_set_send_delay(sendDelayMs);
+    cellular_ctrl_at_unlock();
+#endif
+
+    if (success) {
         // All is good
-        errorCodeOrSize = dataSizeBytes - leftToSendSize;
+        errorCodeOrSize = totalSize - leftToSendSize;
+    } else {
+        pContainer->socket.stats.numErrors++;
     }
 
     if (errno != CELLULAR_SOCK_ENONE) {
@@ -1109,18 +2291,223 @@ int32_t send(CellularSockContainer_t *pContainer,
     return (int32_t) errorCodeOrSize;
 }
 
+// Send data, TCP style.
+// The container must be locked on entry.
+int32_t send(CellularSockContainer_t *pContainer,
+             const void *pData, size_t dataSizeBytes)
+{
+    CellularSockIovec_t iov;
+
+    iov.iov_base = (void *) pData;
+    iov.iov_len = dataSizeBytes;
+
+    return sendV(pContainer, &iov, 1);
+}
+
+// Send anything held in the send buffer of a socket,
+// returning zero on success (including there being
+// nothing to send) else negative error code.
+// The container must be locked on entry.
+static int32_t txBufferFlush(CellularSockContainer_t *pContainer)
+{
+    CellularSockErrorCode_t errorCode = CELLULAR_SOCK_SUCCESS;
+    CellularSockSocket_t *pSocket = &(pContainer->socket);
+    int32_t sentSize;
+
+    if (pSocket->txBufferLength > 0) {
+        sentSize = send(pContainer, pSocket->pTxBuffer,
+                        pSocket->txBufferLength);
+        if (sentSize >= 0) {
+            pSocket->txBufferLength -= sentSize;
+            if (pSocket->txBufferLength > 0) {
+                // Keep what the module didn't take
+                // for the next go
+                pCellularPort_memmove(pSocket->pTxBuffer,
+                                      pSocket->pTxBuffer + sentSize,
+                                      pSocket->txBufferLength);
+                errorCode = CELLULAR_SOCK_BSD_ERROR;
+            }
+        } else {
+            errorCode = CELLULAR_SOCK_BSD_ERROR;
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Send data, TCP style, with coalescing of small writes
+// if the socket has a send buffer.  Buffered data is sent
+// when the buffer fills, when the next write comes along
+// after CELLULAR_CFG_SOCK_TX_COALESCE_TIME_MS, when
+// TCP_NODELAY is set and before anything that might wait
+// for a response (receive, select, shutdown, close).
+// The container must be locked on entry.
+static int32_t sendCoalesce(CellularSockContainer_t *pContainer,
+                            const void *pData, size_t dataSizeBytes)
+{
+    CellularSockErrorCode_t errorCodeOrSize = CELLULAR_SOCK_BSD_ERROR;
+    CellularSockSocket_t *pSocket = &(pContainer->socket);
+
+    if ((pSocket->pTxBuffer == NULL) || pSocket->noDelay) {
+        // Nothing of ours to do
+        errorCodeOrSize = send(pContainer, pData, dataSizeBytes);
+    } else {
+        if ((pSocket->txBufferLength > 0) &&
+            ((pSocket->txBufferLength + dataSizeBytes > pSocket->txBufferSizeBytes) ||
+             (cellularPortGetTickTimeMs() - pSocket->txBufferStartTimeMs >=
+              CELLULAR_CFG_SOCK_TX_COALESCE_TIME_MS))) {
+            // Won't fit or has waited long enough
+            txBufferFlush(pContainer);
+        }
+        if (pSocket->txBufferLength + dataSizeBytes <= pSocket->txBufferSizeBytes) {
+            if (pSocket->txBufferLength == 0) {
+                pSocket->txBufferStartTimeMs = cellularPortGetTickTimeMs();
+            }
+            pCellularPort_memcpy(pSocket->pTxBuffer + pSocket->txBufferLength,
+                                 pData, dataSizeBytes);
+            pSocket->txBufferLength += dataSizeBytes;
+            errorCodeOrSize = dataSizeBytes;
+            if (pSocket->txBufferLength == pSocket->txBufferSizeBytes) {
+                // Full, send it now
+                txBufferFlush(pContainer);
+            }
+        } else if (pSocket->txBufferLength == 0) {
+            // Too big to buffer, just send it
+            errorCodeOrSize = send(pContainer, pData, dataSizeBytes);
+        } else {
+            // Couldn't get the buffered stuff away, an
+            // error in the grand tradition of TCP: it
+            // is down to something that happened earlier
+            cellularPort_errno_set(CELLULAR_SOCK_EIO);
+        }
+    }
+
+    return (int32_t) errorCodeOrSize;
+}
+
+// Take a socket out of direct-link mode, returning true if
+// the module confirmed it.  If it didn't the AT interface is
+// still back in command mode, we just can't be sure what
+// happened at the far end.
+// The container must be locked on entry.
+static bool directLinkStop(CellularSockContainer_t *pContainer)
+{
+    bool success = cellular_ctrl_at_direct_link_exit(CELLULAR_CFG_SOCK_DIRECT_LINK_GUARD_TIME_MS);
+
+    pContainer->socket.directLink = false;
+    gpDirectLinkContainer = NULL;
+
+    return success;
+}
+
+// Send data on a socket in direct-link mode.
+// The container must be locked on entry.
+static int32_t directLinkWrite(CellularSockContainer_t *pContainer,
+                               const void *pData, size_t dataSizeBytes)
+{
+    int32_t errorCodeOrSize;
+
+    errorCodeOrSize = cellular_ctrl_at_direct_link_write((const uint8_t *) pData,
+                                                         dataSizeBytes);
+    if (errorCodeOrSize >= 0) {
+        pContainer->socket.stats.bytesTx += errorCodeOrSize;
+    } else {
+        pContainer->socket.stats.numErrors++;
+        errorCodeOrSize = CELLULAR_SOCK_BSD_ERROR;
+        cellularPort_errno_set(CELLULAR_SOCK_EIO);
+    }
+
+    return errorCodeOrSize;
+}
+
+// Receive data on a socket in direct-link mode.  There are
+// no URCs in direct-link mode so, if blocking, this polls.
+// The container must be locked on entry.
+static int32_t directLinkRead(CellularSockContainer_t *pContainer,
+                              void *pData, size_t dataSizeBytes)
+{
+    CellularSockErrorCode_t errorCodeOrSize = CELLULAR_SOCK_BSD_ERROR;
+    int32_t errno = CELLULAR_SOCK_ENONE;
+    int64_t startTimeMs = cellularPortGetTickTimeMs();
+    int32_t receivedSize;
+    int32_t thisSize;
+    bool success = true;
+
+    // Anything read ahead before direct-link mode
+    // began comes first
+    receivedSize = rxBufferRead(pContainer, (uint8_t *) pData,
+                                dataSizeBytes);
+    while (receivedSize < (int32_t) dataSizeBytes) {
+        thisSize = cellular_ctrl_at_direct_link_read((uint8_t *) pData + receivedSize,
+                                                     dataSizeBytes - receivedSize);
+        if (thisSize > 0) {
+            receivedSize += thisSize;
+            pContainer->socket.stats.bytesRx += thisSize;
+        } else if (thisSize < 0) {
+            if (receivedSize == 0) {
+                success = false;
+                errno = CELLULAR_SOCK_EIO;
+                pContainer->socket.stats.numErrors++;
+            }
+            break;
+        } else if (receivedSize > 0) {
+            // Leave with what we have
+            break;
+        } else if (!pContainer->socket.nonBlocking &&
+                   cellularPortGetTickTimeMs() - startTimeMs < pContainer->socket.receiveTimeoutMs) {
+            cellularPortTaskBlock(CELLULAR_SOCK_WAITER_POLL_INTERVAL_MS);
+            pContainer->socket.stats.blockedMs += CELLULAR_SOCK_WAITER_POLL_INTERVAL_MS;
+        } else {
+            // Indicate that we would have blocked here
+            success = false;
+            errno = CELLULAR_SOCK_EWOULDBLOCK;
+            break;
+        }
+    }
+
+    if (success) {
+        errorCodeOrSize = receivedSize;
+    }
+
+    if (errno != CELLULAR_SOCK_ENONE) {
+        // Write the errno
+        cellularPort_errno_set(errno);
+    }
+
+    return (int32_t) errorCodeOrSize;
+}
+
+// Note the time from a data URC to the read that it led to.
+// The container must be locked on entry.
+static void statsUrcToRead(CellularSockContainer_t *pContainer)
+{
+    int64_t latencyMs;
+
+    if (pContainer->socket.dataUrcTimeMs >= 0) {
+        latencyMs = cellularPortGetTickTimeMs() - pContainer->socket.dataUrcTimeMs;
+        pContainer->socket.dataUrcTimeMs = -1;
+        pContainer->socket.stats.numUrcReads++;
+        pContainer->socket.stats.urcToReadTotalMs += latencyMs;
+        if (latencyMs > pContainer->socket.stats.urcToReadMaxMs) {
+            pContainer->socket.stats.urcToReadMaxMs = (int32_t) latencyMs;
+        }
+    }
+}
+
 // Receive data, UDP style.
 // Notes: pRemoteAddress may be NULL, it is valid
 // to receive a zero length UDP packet, one whole
 // UDP packet is received by each USORF command,
-// gMutexContainer must be locked on entry.
+// the container must be locked on entry.
 int32_t receiveFrom(CellularSockContainer_t *pContainer,
                     CellularSockAddress_t *pRemoteAddress,
                     void *pData, size_t dataSizeBytes)
 {
     CellularSockErrorCode_t errorCodeOrSize = CELLULAR_SOCK_BSD_ERROR;
     int32_t errno = CELLULAR_SOCK_ENONE;
-    int32_t startTimeMs = cellularPortGetTickTimeMs();
+    int64_t startTimeMs = cellularPortGetTickTimeMs();
+    int64_t blockStartTimeMs;
+    CellularSockWaiter_t *pWaiter = NULL;
     char buffer[CELLULAR_SOCK_ADDRESS_STRING_MAX_LENGTH_BYTES];
     int32_t x = -1;
     int32_t actualReceiveSize;
@@ -1143,6 +2530,8 @@ int32_t receiveFrom(CellularSockContainer_t *pContainer,
         // If the URC has not filled in pendingBytes, 
         // ask the module directly if there is anything
         // to read
+        pContainer->socket.stats.numAtCommands++;
+        cellular_ctrl_at_set_send_delay_class(CELLULAR_CTRL_AT_SEND_DELAY_CLASS_DATA);
         cellular_ctrl_at_cmd_start("AT+USORF=");
         // Handle
         cellular_ctrl_at_write_int(pContainer->socket.modemHandle);
@@ -1150,40 +2539,43 @@ int32_t receiveFrom(CellularSockContainer_t *pContainer,
         // of bytes waiting
         cellular_ctrl_at_write_int(0);
         cellular_ctrl_at_cmd_stop();
-        cellular_ctrl_at_resp_start("+USORF:", false);
-        // Skip the socket ID
-        cellular_ctrl_at_skip_param(1);
-        // Read the amount of data
-        x = cellular_ctrl_at_read_int();
+        // Skip the socket ID, read the amount of data
+        cellular_ctrl_at_read_fields("+USORF:", "-,i", &x);
         cellular_ctrl_at_resp_stop();
         if (x >= 0) {
             pContainer->socket.pendingBytes = x;
         }
         cellular_ctrl_at_unlock();
     }
+    if (!pContainer->socket.nonBlocking) {
+        // Get something to wait on for the URC that
+        // indicates incoming data; if there is nothing
+        // free waiterWait() will just poll
+        pWaiter = pWaiterAcquire();
+    }
     // Run around the loop until a packet of data turns up or we time out
     while (success && (dataSizeBytes > 0) && (receivedSize < 0)) {
+        // Arm before checking so that a URC can't be missed
+        waiterArm(pWaiter);
         if (pContainer->socket.pendingBytes > 0) {
             // In the UDP case we HAVE to read the number
             // of bytes pending as this will be the size
             // of the next UDP packet in the module and the
             // module can only deliver whole UDP packets.
             cellular_ctrl_at_lock();
+            pContainer->socket.stats.numAtCommands++;
+            cellular_ctrl_at_set_send_delay_class(CELLULAR_CTRL_AT_SEND_DELAY_CLASS_DATA);
             cellular_ctrl_at_cmd_start("AT+USORF=");
             // Handle
             cellular_ctrl_at_write_int(pContainer->socket.modemHandle);
             // Number of bytes to read
             cellular_ctrl_at_write_int(CELLULAR_SOCK_MAX_SEGMENT_LENGTH_BYTES);
             cellular_ctrl_at_cmd_stop();
-            cellular_ctrl_at_resp_start("+USORF:", false);
-            // Skip the socket ID
-            cellular_ctrl_at_skip_param(1);
-            // Read the IP address
-            cellular_ctrl_at_read_string(buffer, sizeof(buffer), false);
-            // Read the port
-            x = cellular_ctrl_at_read_int();
-            // Read the amount of data
-            actualReceiveSize = cellular_ctrl_at_read_int();
+            // Skip the socket ID, read the IP address,
+            // the port and the amount of data
+            cellular_ctrl_at_read_fields("+USORF:", "-,s,i,i",
+                                         buffer, sizeof(buffer),
+                                         &x, &actualReceiveSize);
             if (actualReceiveSize > CELLULAR_SOCK_MAX_SEGMENT_LENGTH_BYTES) {
                 actualReceiveSize = CELLULAR_SOCK_MAX_SEGMENT_LENGTH_BYTES;
             }
@@ -1229,6 +2621,8 @@ int32_t receiveFrom(CellularSockContainer_t *pContainer,
                 if (actualReceiveSize >= 0) {
                     receivedSize = actualReceiveSize;
                     dataSizeBytes -= actualReceiveSize;
+                    pContainer->socket.stats.bytesRx += actualReceiveSize;
+                    statsUrcToRead(pContainer);
                 } else {
                     // cellular_ctrl_at_read_bytes() should not fail
                     success = false;
@@ -1237,11 +2631,19 @@ int32_t receiveFrom(CellularSockContainer_t *pContainer,
                 success = false;
             }
             cellular_ctrl_at_unlock();
+        } else if (pContainer->socket.state == CELLULAR_SOCK_STATE_CLOSED) {
+            // Closed by the module while we were waiting
+            success = false;
+            errno = CELLULAR_SOCK_ENOTCONN;
         } else if (!pContainer->socket.nonBlocking &&
                    (cellularPortGetTickTimeMs() - startTimeMs < pContainer->socket.receiveTimeoutMs)) {
-            // Yield to the AT parser task that is listening for URCs
-            // that indicated incoming data
-            cellularPortTaskBlock(10);
+            // Wait for the AT parser task to get a URC
+            // that indicates incoming data or closure
+            blockStartTimeMs = cellularPortGetTickTimeMs();
+            waiterWait(pWaiter, pContainer->socket.receiveTimeoutMs -
+                                (blockStartTimeMs - startTimeMs));
+            pContainer->socket.stats.blockedMs += cellularPortGetTickTimeMs() -
+                                                  blockStartTimeMs;
         } else {
             // Timeout with nothing received
             // Indicate that we would have blocked here
@@ -1250,6 +2652,8 @@ int32_t receiveFrom(CellularSockContainer_t *pContainer,
         }
     }
 
+    waiterRelease(pWaiter);
+
     if (success && (receivedSize >= 0) && (pRemoteAddress != NULL) && (x >= 0)) {
         success = (cellularSockStringToAddress(buffer, pRemoteAddress) == 0);
         pRemoteAddress->port = x;
@@ -1258,6 +2662,8 @@ int32_t receiveFrom(CellularSockContainer_t *pContainer,
     // Set the return code
     if (success) {
         errorCodeOrSize = receivedSize;
+    } else if (errno != CELLULAR_SOCK_EWOULDBLOCK) {
+        pContainer->socket.stats.numErrors++;
     }
 
     if (errno != CELLULAR_SOCK_ENONE) {
@@ -1269,13 +2675,16 @@ int32_t receiveFrom(CellularSockContainer_t *pContainer,
 }
 
 // Receive data, TCP style.
-// Note: gMutexContainer must be locked on entry.
+// Note: the container must be locked on entry.
 int32_t receive(CellularSockContainer_t *pContainer,
                 void *pData, size_t dataSizeBytes)
 {
     CellularSockErrorCode_t errorCodeOrSize = CELLULAR_SOCK_BSD_ERROR;
     int32_t errno = CELLULAR_SOCK_ENONE;
-    int32_t startTimeMs = cellularPortGetTickTimeMs();
+    int64_t startTimeMs = cellularPortGetTickTimeMs();
+    int64_t blockStartTimeMs;
+    CellularSockWaiter_t *pWaiter = NULL;
+    uint8_t *pReadTo;
     int32_t wantedReceiveSize;
     int32_t actualReceiveSize;
     int32_t receivedSize = 0;
@@ -1283,11 +2692,18 @@ int32_t receive(CellularSockContainer_t *pContainer,
     bool success = true;
     uint8_t quoteMark;
 
-    if (pContainer->socket.pendingBytes == 0) {
+    // Serve what we can from the read-ahead buffer first
+    receivedSize = rxBufferRead(pContainer, (uint8_t *) pData,
+                                dataSizeBytes);
+    dataSizeBytes -= receivedSize;
+
+    if ((dataSizeBytes > 0) && (pContainer->socket.pendingBytes == 0)) {
         cellular_ctrl_at_lock();
         // If the URC has not filled in pendingBytes, 
         // ask the module directly if there is anything
         // to read
+        pContainer->socket.stats.numAtCommands++;
+        cellular_ctrl_at_set_send_delay_class(CELLULAR_CTRL_AT_SEND_DELAY_CLASS_DATA);
         cellular_ctrl_at_cmd_start("AT+USORD=");
         // Handle
         cellular_ctrl_at_write_int(pContainer->socket.modemHandle);
@@ -1295,39 +2711,52 @@ int32_t receive(CellularSockContainer_t *pContainer,
         // of bytes waiting
         cellular_ctrl_at_write_int(0);
         cellular_ctrl_at_cmd_stop();
-        cellular_ctrl_at_resp_start("+USORD:", false);
-        // Skip the socket ID
-        cellular_ctrl_at_skip_param(1);
-        // Read the amount of data
-        x = cellular_ctrl_at_read_int();
+        // Skip the socket ID, read the amount of data
+        cellular_ctrl_at_read_fields("+USORD:", "-,i", &x);
         cellular_ctrl_at_resp_stop();
         if (x >= 0) {
             pContainer->socket.pendingBytes = x;
         }
         cellular_ctrl_at_unlock();
     }
+    if (!pContainer->socket.nonBlocking && (dataSizeBytes > 0)) {
+        // Get something to wait on for the URC that
+        // indicates incoming data; if there is nothing
+        // free waiterWait() will just poll
+        pWaiter = pWaiterAcquire();
+    }
     // Run around the loop until we run out of room in the buffer
     // or we time out
     while (success && (dataSizeBytes > 0)) {
+        // Arm before checking so that a URC can't be missed
+        waiterArm(pWaiter);
         wantedReceiveSize = CELLULAR_SOCK_MAX_SEGMENT_LENGTH_BYTES;
         if (wantedReceiveSize > dataSizeBytes) {
             wantedReceiveSize = dataSizeBytes;
         }
+        pReadTo = ((uint8_t *) pData) + receivedSize;
+        if ((pContainer->socket.pRxBuffer != NULL) &&
+            (wantedReceiveSize < pContainer->socket.rxBufferSizeBytes)) {
+            // A small read: fill the (by now empty) read-ahead
+            // buffer instead so that the next read may not
+            // need to go to the module at all
+            wantedReceiveSize = pContainer->socket.rxBufferSizeBytes;
+            pReadTo = pContainer->socket.pRxBuffer;
+        }
         if (pContainer->socket.pendingBytes > 0) {
             cellular_ctrl_at_lock();
+            pContainer->socket.stats.numAtCommands++;
+            cellular_ctrl_at_set_send_delay_class(CELLULAR_CTRL_AT_SEND_DELAY_CLASS_DATA);
             cellular_ctrl_at_cmd_start("AT+USORD=");
             // Handle
             cellular_ctrl_at_write_int(pContainer->socket.modemHandle);
             // Number of bytes to read
             cellular_ctrl_at_write_int(wantedReceiveSize);
             cellular_ctrl_at_cmd_stop();
-            cellular_ctrl_at_resp_start("+USORD:", false);
-            // Skip the socket ID
-            cellular_ctrl_at_skip_param(1);
-            // Read the amount of data
-            actualReceiveSize = cellular_ctrl_at_read_int();
-            if (actualReceiveSize > dataSizeBytes) {
-                actualReceiveSize = dataSizeBytes;
+            // Skip the socket ID, read the amount of data
+            cellular_ctrl_at_read_fields("+USORD:", "-,i", &actualReceiveSize);
+            if (actualReceiveSize > wantedReceiveSize) {
+                actualReceiveSize = wantedReceiveSize;
             }
             if (actualReceiveSize > 0) {
                 // Don't stop for anything!
@@ -1336,8 +2765,7 @@ int32_t receive(CellularSockContainer_t *pContainer,
                 // Get the leading quote mark out of the way
                 cellular_ctrl_at_read_bytes(&quoteMark, 1);
                 // Now read the actual data
-                cellular_ctrl_at_read_bytes((uint8_t *) (pData + receivedSize),
-                                            actualReceiveSize);
+                cellular_ctrl_at_read_bytes(pReadTo, actualReceiveSize);
                 cellular_ctrl_at_resp_stop();
                 cellular_ctrl_at_set_default_delimiter();
             }
@@ -1360,21 +2788,47 @@ int32_t receive(CellularSockContainer_t *pContainer,
                     pContainer->socket.pendingBytes -= actualReceiveSize;
                 }
                 if (actualReceiveSize > 0) {
+                    pContainer->socket.stats.bytesRx += actualReceiveSize;
+                    statsUrcToRead(pContainer);
+                    if (pReadTo == pContainer->socket.pRxBuffer) {
+                        // Give the caller what they wanted from
+                        // the read-ahead buffer
+                        pContainer->socket.rxBufferLength = actualReceiveSize;
+                        actualReceiveSize = rxBufferRead(pContainer,
+                                                         ((uint8_t *) pData) + receivedSize,
+                                                         dataSizeBytes);
+                    }
                     receivedSize += actualReceiveSize;
                     dataSizeBytes -= actualReceiveSize;
-                } else {
+                } else if (receivedSize == 0) {
                     // cellular_ctrl_at_read_bytes() should not fail
                     success = false;
+                } else {
+                    // Nothing there after all, don't lose what
+                    // has already come from the read-ahead buffer
+                    pContainer->socket.pendingBytes = 0;
                 }
             } else {
                 success = false;
             }
             cellular_ctrl_at_unlock();
+        } else if (pContainer->socket.state == CELLULAR_SOCK_STATE_CLOSED) {
+            // Closed by the module while we were waiting,
+            // leave with what we have
+            if (receivedSize == 0) {
+                success = false;
+                errno = CELLULAR_SOCK_ENOTCONN;
+            }
+            break;
         } else if (!pContainer->socket.nonBlocking &&
                    cellularPortGetTickTimeMs() - startTimeMs < pContainer->socket.receiveTimeoutMs) {
-            // Yield to the AT parser task that is listening for URCs
-            // that indicate incoming data
-            cellularPortTaskBlock(10);
+            // Wait for the AT parser task to get a URC
+            // that indicates incoming data or closure
+            blockStartTimeMs = cellularPortGetTickTimeMs();
+            waiterWait(pWaiter, pContainer->socket.receiveTimeoutMs -
+                                (blockStartTimeMs - startTimeMs));
+            pContainer->socket.stats.blockedMs += cellularPortGetTickTimeMs() -
+                                                  blockStartTimeMs;
         } else {
             if (receivedSize == 0) {
                 // Timeout with nothing received
@@ -1388,9 +2842,13 @@ int32_t receive(CellularSockContainer_t *pContainer,
         }
     }
 
+    waiterRelease(pWaiter);
+
     // Set the return code
     if (success) {
         errorCodeOrSize = receivedSize;
+    } else if (errno != CELLULAR_SOCK_EWOULDBLOCK) {
+        pContainer->socket.stats.numErrors++;
     }
 
     if (errno != CELLULAR_SOCK_ENONE) {
@@ -1401,6 +2859,33 @@ int32_t receive(CellularSockContainer_t *pContainer,
     return (int32_t) errorCodeOrSize;
 }
 
+// The send function given to the transmit scheduler by
+// cellularSockWriteDeferred(): pParam is the descriptor.
+static int32_t deferredWrite(const void *pData, size_t dataSizeBytes,
+                             void *pParam)
+{
+    CellularSockDescriptor_t descriptor = (CellularSockDescriptor_t) (intptr_t) pParam;
+    int32_t errorCodeOrSize = CELLULAR_SOCK_SUCCESS;
+    size_t sentSizeBytes = 0;
+
+    while ((sentSizeBytes < dataSizeBytes) && (errorCodeOrSize >= 0)) {
+        errorCodeOrSize = cellularSockWrite(descriptor,
+                                            ((const char *) pData) + sentSizeBytes,
+                                            dataSizeBytes - sentSizeBytes);
+        if (errorCodeOrSize > 0) {
+            sentSizeBytes += errorCodeOrSize;
+        } else if (errorCodeOrSize == 0) {
+            // Don't spin on a socket that has stopped taking data
+            errorCodeOrSize = CELLULAR_SOCK_BSD_ERROR;
+        }
+    }
+    if (errorCodeOrSize >= 0) {
+        errorCodeOrSize = (int32_t) sentSizeBytes;
+    }
+
+    return errorCodeOrSize;
+}
+
 /* ----------------------------------------------------------------
  * PUBLIC FUNCTIONS: CREATE/OPEN/CLOSE
  * -------------------------------------------------------------- */
@@ -1408,6 +2893,15 @@ int32_t receive(CellularSockContainer_t *pContainer,
 // Create a socket.
 int32_t cellularSockCreate(CellularSockType_t type,
                            CellularSockProtocol_t protocol)
+{
+    return cellularSockCreateOnContext(type, protocol,
+                                       CELLULAR_CTRL_CONTEXT_ID);
+}
+
+// Create a socket that uses the given PDP context.
+int32_t cellularSockCreateOnContext(CellularSockType_t type,
+                                    CellularSockProtocol_t protocol,
+                                    int32_t contextId)
 {
     CellularSockErrorCode_t descriptorOrErrorCode = CELLULAR_SOCK_BSD_ERROR;
     int32_t errno = CELLULAR_SOCK_ENONE;
@@ -1422,7 +2916,14 @@ int32_t cellularSockCreate(CellularSockType_t type,
 
                 CELLULAR_PORT_MUTEX_LOCK(gMutexContainer);
 
-                if (numContainersInUse() < CELLULAR_SOCK_MAX) {
+                if ((contextId != CELLULAR_CTRL_CONTEXT_ID) &&
+                    (cellularCtrlGetIpAddressStrForContext(contextId, NULL) <= 0)) {
+                    // A secondary context must have been
+                    // brought up with cellularCtrlActivateContext()
+                    errno = CELLULAR_SOCK_ENETDOWN;
+                    cellularPortLog("CELLULAR_SOCK: context %d is not active.\n",
+                                    contextId);
+                } else if (numContainersInUse() < CELLULAR_SOCK_MAX) {
                     // Find the next free descriptor
                     while (descriptorOrErrorCode < 0) {
                         // Try the descriptor value, making sure 
@@ -1435,6 +2936,7 @@ int32_t cellularSockCreate(CellularSockType_t type,
                             pContainer = pSockContainerCreate(descriptor,
                                                               type, protocol);
                             if (pContainer != NULL) {
+                                pContainer->socket.contextId = contextId;
                                 descriptorOrErrorCode = descriptor;
                             } else {
                                 cellularPortLog("CELLULAR_SOCK: unable to allocate memory for socket.\n");
@@ -1463,6 +2965,10 @@ int32_t cellularSockCreate(CellularSockType_t type,
                         if (cellular_ctrl_at_unlock_return_error() == 0) {
                             // All is good, no need to set descriptorOrErrorCode
                             // as it was already set above
+                            if ((pContainer->socket.modemHandle >= 0) &&
+                                (pContainer->socket.modemHandle < CELLULAR_SOCK_MODULE_MAX_NUM_SOCKETS)) {
+                                gpContainerByModemHandle[pContainer->socket.modemHandle] = pContainer;
+                            }
                             cellularPortLog("CELLULAR_SOCK: socket created, descriptor %d, modem handle %d.\n",
                                             descriptorOrErrorCode,
                                             pContainer->socket.modemHandle);
@@ -1515,26 +3021,45 @@ int32_t cellularSockConnect(CellularSockDescriptor_t descriptor,
     int32_t errno = CELLULAR_SOCK_ENONE;
     CellularSockContainer_t *pContainer = NULL;
     char buffer[CELLULAR_SOCK_ADDRESS_STRING_MAX_LENGTH_BYTES];
+    bool asyncConnect = false;
 
     if (init()) {
         // Check that the remote IP address is sensible
         if ((pRemoteAddress != NULL) &&
             (addressToString(pRemoteAddress, false, buffer, sizeof(buffer)) > 0)) {
 
-            CELLULAR_PORT_MUTEX_LOCK(gMutexContainer);
-
-            // Find the container
-            pContainer = pContainerFindByDescriptor(descriptor);
+            // Find the container, locking it
+            pContainer = pContainerLock(descriptor);
 
             // If we have found the container, talk to cellular to
             // make the connection
             if (pContainer != NULL) {
-                if (pContainer->socket.state == CELLULAR_SOCK_STATE_CREATED) {
+                if ((pContainer->socket.contextId != CELLULAR_CTRL_CONTEXT_ID) &&
+                    (cellularCtrlGetIpAddressStrForContext(pContainer->socket.contextId,
+                                                           NULL) <= 0)) {
+                    // The context this socket was created on
+                    // has since gone away
+                    errno = CELLULAR_SOCK_ENETDOWN;
+                } else if (pContainer->socket.state == CELLULAR_SOCK_STATE_CONNECTING) {
+                    // Still waiting for the last one
+                    errno = CELLULAR_SOCK_EALREADY;
+                } else if (pContainer->socket.state == CELLULAR_SOCK_STATE_CREATED) {
                     cellularPortLog("CELLULAR_CTRL_SOCK: connecting socket to \"%s\"...\n",
                                     buffer);
+#if CELLULAR_SOCK_ASYNC_CONNECT_IS_SUPPORTED
+                    // A non-blocking TCP socket doesn't wait for
+                    // the far end, +UUSOCO tells us how it went
+                    asyncConnect = pContainer->socket.nonBlocking &&
+                                   (pContainer->socket.protocol == CELLULAR_SOCK_PROTOCOL_TCP) &&
+                                   (pRemoteAddress->port > 0);
+#endif
+                    pContainer->socket.pendingError = 0;
                     cellular_ctrl_at_lock();
-                    // TODO: set timeout correctly for this socket
-                    cellular_ctrl_at_set_at_timeout(10000, false);
+                    if (!asyncConnect) {
+                        // TODO: set timeout correctly for this socket
+                        cellular_ctrl_at_set_at_timeout(CELLULAR_SOCK_CONNECT_TIMEOUT_SECONDS * 1000,
+                                                        false);
+                    }
                     cellular_ctrl_at_cmd_start("AT+USOCO=");
                     // Handle
                     cellular_ctrl_at_write_int(pContainer->socket.modemHandle);
@@ -1544,14 +3069,48 @@ int32_t cellularSockConnect(CellularSockDescriptor_t descriptor,
                     if (pRemoteAddress->port > 0) {
                         cellular_ctrl_at_write_int(pRemoteAddress->port);
                     }
+                    if (asyncConnect) {
+                        cellular_ctrl_at_write_int(1);
+                        // The URC could arrive before we get to
+                        // set the state below, so set it now
+                        pContainer->socket.state = CELLULAR_SOCK_STATE_CONNECTING;
+                    }
                     cellular_ctrl_at_cmd_stop_read_resp();
-                    cellular_ctrl_at_restore_at_timeout();
-                    if (cellular_ctrl_at_unlock_return_error() == 0) {
+                    if (!asyncConnect) {
+                        cellular_ctrl_at_restore_at_timeout();
+                    }
+                    if (cellular_ctrl_at_unlock_return_error() != 0) {
+                        pContainer->socket.state = CELLULAR_SOCK_STATE_CREATED;
+                        // Host is not reachable
+                        errno = CELLULAR_SOCK_EHOSTUNREACH;
+                        cellularPortLog("CELLULAR_SOCK: remote address %.*s is not reachable.\n",
+                                        addressToString(pRemoteAddress, true,
+                                                        buffer, sizeof(buffer)),
+                                        buffer);
+                    } else if (asyncConnect) {
+                        pCellularPort_memcpy(&pContainer->socket.remoteAddress,
+                                             pRemoteAddress,
+                                             sizeof (pContainer->socket.remoteAddress));
+                        // As BSD: the caller finds out how it went
+                        // with select() and CELLULAR_SOCK_OPT_ERROR
+                        errno = CELLULAR_SOCK_EINPROGRESS;
+                        cellularPortLog("CELLULAR_SOCK: socket with descriptor %d, modem handle %d, is connecting to address %.*s.\n",
+                                        descriptor,
+                                        pContainer->socket.modemHandle,
+                                        addressToString(&pContainer->socket.remoteAddress,
+                                                        true,
+                                                        buffer, sizeof(buffer)),
+                                        buffer);
+                    } else {
                         // All is good
                         pCellularPort_memcpy(&pContainer->socket.remoteAddress,
                                              pRemoteAddress,
                                              sizeof (pContainer->socket.remoteAddress));
                         pContainer->socket.state = CELLULAR_SOCK_STATE_CONNECTED;
+                        // Now writable, let anyone select()ing know
+                        CELLULAR_PORT_MUTEX_LOCK(gMutexCallbacks);
+                        signalWaiters();
+                        CELLULAR_PORT_MUTEX_UNLOCK(gMutexCallbacks);
                         errorCode = CELLULAR_SOCK_SUCCESS;
                         cellularPortLog("CELLULAR_SOCK: socket with descriptor %d, modem handle %d, is connected to address %.*s.\n",
                                         descriptor,
@@ -1560,13 +3119,6 @@ int32_t cellularSockConnect(CellularSockDescriptor_t descriptor,
                                                         true,
                                                         buffer, sizeof(buffer)),
                                         buffer);
-                    } else {
-                        // Host is not reachable
-                        errno = CELLULAR_SOCK_EHOSTUNREACH;
-                        cellularPortLog("CELLULAR_SOCK: remote address %.*s is not reachable.\n",
-                                        addressToString(pRemoteAddress, true,
-                                                        buffer, sizeof(buffer)),
-                                        buffer);
                     }
                 } else {
                     // TODO: is "operation not permitted" the right error?
@@ -1577,7 +3129,7 @@ int32_t cellularSockConnect(CellularSockDescriptor_t descriptor,
                 errno = CELLULAR_SOCK_EBADF;
             }
 
-            CELLULAR_PORT_MUTEX_UNLOCK(gMutexContainer);
+            containerUnlock(pContainer);
 
         } else {
             // Seems appropriate
@@ -1603,36 +3155,49 @@ int32_t cellularSockClose(CellularSockDescriptor_t descriptor)
     int32_t errno = CELLULAR_SOCK_ENONE;
     CellularSockContainer_t *pContainer = NULL;
     CellularSockState_t finalState = CELLULAR_SOCK_STATE_CLOSED;
+    bool asyncClose = false;
 
     if (init()) {
 
-        CELLULAR_PORT_MUTEX_LOCK(gMutexContainer);
-
-        // Find the container
-        pContainer = pContainerFindByDescriptor(descriptor);
+        // Find the container, locking it
+        pContainer = pContainerLock(descriptor);
 
         // If we have found the container, talk to cellular to
         // close the socket there
         if (pContainer != NULL) {
+            if (pContainer->socket.directLink) {
+                // Need to be talking AT commands to close
+                directLinkStop(pContainer);
+            }
+            // Send whatever we're sat on first
+            txBufferFlush(pContainer);
+#if CELLULAR_SOCK_ASYNC_CLOSE_IS_SUPPORTED
+            // Closing a connected TCP socket can take a long
+            // time, waiting for the ack for the ack for the
+            // ack, so ask for an asynchronous indication
+            // (+UUSOCL) rather than holding everyone up
+            asyncClose = (pContainer->socket.protocol == CELLULAR_SOCK_PROTOCOL_TCP) &&
+                         ((pContainer->socket.state == CELLULAR_SOCK_STATE_CONNECTED) ||
+                          (pContainer->socket.state == CELLULAR_SOCK_STATE_SHUTDOWN_FOR_READ) ||
+                          (pContainer->socket.state == CELLULAR_SOCK_STATE_SHUTDOWN_FOR_WRITE) ||
+                          (pContainer->socket.state == CELLULAR_SOCK_STATE_SHUTDOWN_FOR_READ_WRITE));
+#endif
             cellular_ctrl_at_lock();
-            // Closing can take a loong time sometimes
-            cellular_ctrl_at_set_at_timeout(CELLULAR_SOCK_CLOSE_TIMEOUT_SECONDS * 1000,
-                                            false);
+            if (!asyncClose) {
+                // Closing can take a loong time sometimes
+                cellular_ctrl_at_set_at_timeout(CELLULAR_SOCK_CLOSE_TIMEOUT_SECONDS * 1000,
+                                                false);
+            }
             cellular_ctrl_at_cmd_start("AT+USOCL=");
             cellular_ctrl_at_write_int(pContainer->socket.modemHandle);
-#ifdef CELLULAR_CFG_MODULE_SARA_R4
-            // SARA-R4, can take a long time to close a TCP
-            // socket due to being strict about waiting
-            // for the ack for the ack for the ack, so
-            // ask for an asynchronous indication
-            if ((pContainer->socket.protocol == CELLULAR_SOCK_PROTOCOL_TCP) &&
-                (pContainer->socket.state == CELLULAR_SOCK_STATE_CONNECTED)) {
+            if (asyncClose) {
                 cellular_ctrl_at_write_int(1);
                 finalState = CELLULAR_SOCK_STATE_CLOSING;
             }
-#endif
             cellular_ctrl_at_cmd_stop_read_resp();
-            cellular_ctrl_at_restore_at_timeout();
+            if (!asyncClose) {
+                cellular_ctrl_at_restore_at_timeout();
+            }
             if (cellular_ctrl_at_unlock_return_error() == 0) {
                 cellularPortLog("CELLULAR_SOCK: socket with descriptor %d, modem handle %d, has been closed.\n",
                                 descriptor,
@@ -1643,6 +3208,10 @@ int32_t cellularSockClose(CellularSockDescriptor_t descriptor)
                 // cellularSockCleanUp() in order to ensure
                 // thread-safeness
                 pContainer->socket.state = finalState;
+                // Let anyone select()ing on it know
+                CELLULAR_PORT_MUTEX_LOCK(gMutexCallbacks);
+                signalWaiters();
+                CELLULAR_PORT_MUTEX_UNLOCK(gMutexCallbacks);
             } else {
                 // Use a distinctly different errno for this
                 errno = CELLULAR_SOCK_EIO;
@@ -1655,7 +3224,7 @@ int32_t cellularSockClose(CellularSockDescriptor_t descriptor)
             errno = CELLULAR_SOCK_EBADF;
         }
 
-        CELLULAR_PORT_MUTEX_UNLOCK(gMutexContainer);
+        containerUnlock(pContainer);
 
     } else {
         // The only reason initialisation might fail
@@ -1682,9 +3251,14 @@ void cellularSockCleanUp()
         CELLULAR_PORT_MUTEX_LOCK(gMutexContainer);
 
         // Move through the list removing closed sockets
+        // that no-one is still busy with
         while (pContainer != NULL) {
-            if ((pContainer->socket.state == CELLULAR_SOCK_STATE_CLOSED) ||
-                (pContainer->socket.state == CELLULAR_SOCK_STATE_CLOSING)) {
+            if (((pContainer->socket.state == CELLULAR_SOCK_STATE_CLOSED) ||
+                 (pContainer->socket.state == CELLULAR_SOCK_STATE_CLOSING)) &&
+                (pContainer->numUsers == 0)) {
+                // With no users this won't wait
+                cellularPortMutexLock(pContainer->mutex);
+                buffersFree(pContainer);
                 if (!(pContainer->isStatic)) {
                     // If this socket is not static, uncouple it
                     // If there is a previous container, move its pNext
@@ -1704,16 +3278,24 @@ void cellularSockCleanUp()
                     // Remember the next pointer
                     pTmp = pContainer->pNext;
                     // Free the memory
+                    containerUnindex(pContainer);
+                    cellularPortMutexUnlock(pContainer->mutex);
+                    cellularPortMutexDelete(pContainer->mutex);
                     cellularPort_free(pContainer);
                     // Move to the next entry
                     pContainer = pTmp;
                 } else {
                     pContainer->socket.state = CELLULAR_SOCK_STATE_CLOSED;
+                    // Forget the descriptor so that select()
+                    // reports it as bad from now on
+                    pContainer->descriptor = -1;
+                    cellularPortMutexUnlock(pContainer->mutex);
                     // Move on
                     pContainer = pContainer->pNext;
                 }
             } else {
-                // Move on but count the number of non-closed sockets
+                // Move on but count the number of non-closed
+                // (or still busy) sockets
                 numNonClosedSockets++;
                 pContainer = pContainer->pNext;
             }
@@ -1736,10 +3318,28 @@ void cellularSockDeinit()
 
     if (gInitialised) {
 
-        CELLULAR_PORT_MUTEX_LOCK(gMutexContainer);
+        // Wait for anyone still busy with a socket: they need
+        // gMutexContainer to say that they are done
+        cellularPortMutexLock(gMutexContainer);
+        while (numContainersWithUsers() > 0) {
+            cellularPortMutexUnlock(gMutexContainer);
+            cellularPortTaskBlock(CELLULAR_SOCK_WAITER_POLL_INTERVAL_MS);
+            cellularPortMutexLock(gMutexContainer);
+        }
+
+        if (gpDirectLinkContainer != NULL) {
+            // Leave the AT interface as we found it
+            pTmp = gpDirectLinkContainer;
+            cellularPortMutexLock(pTmp->mutex);
+            directLinkStop(pTmp);
+            cellularPortMutexUnlock(pTmp->mutex);
+        }
 
         // Move through the list removing sockets
         while (pContainer != NULL) {
+            // With no users this won't wait
+            cellularPortMutexLock(pContainer->mutex);
+            buffersFree(pContainer);
             if (!(pContainer->isStatic)) {
                 // If this socket is not static, uncouple it
                 // If there is a previous container, move its pNext
@@ -1759,11 +3359,15 @@ void cellularSockDeinit()
                 // Remember the next pointer
                 pTmp = pContainer->pNext;
                 // Free the memory
+                containerUnindex(pContainer);
+                cellularPortMutexUnlock(pContainer->mutex);
+                cellularPortMutexDelete(pContainer->mutex);
                 cellularPort_free(pContainer);
                 // Move to the next entry
                 pContainer = pTmp;
             } else {
                 pContainer->socket.state = CELLULAR_SOCK_STATE_CLOSED;
+                cellularPortMutexUnlock(pContainer->mutex);
                 // Move on
                 pContainer = pContainer->pNext;
             }
@@ -1772,8 +3376,13 @@ void cellularSockDeinit()
         // We can now deinit()
         deinitButNotMutex();
 
-        CELLULAR_PORT_MUTEX_UNLOCK(gMutexContainer);
+        cellularPortMutexUnlock(gMutexContainer);
     }
+
+    // The DNS side doesn't need init() so
+    // tidy it up regardless
+    dnsTaskStop();
+    dnsCacheFlush();
 }
 
 /* ----------------------------------------------------------------
@@ -1793,10 +3402,8 @@ int32_t cellularSockFcntl(CellularSockDescriptor_t descriptor,
 
     if (init()) {
 
-        CELLULAR_PORT_MUTEX_LOCK(gMutexContainer);
-
-        // Find the container
-        pContainer = pContainerFindByDescriptor(descriptor);
+        // Find the container, locking it
+        pContainer = pContainerLock(descriptor);
 
         if (pContainer != NULL) {
             switch (command) {
@@ -1822,7 +3429,7 @@ int32_t cellularSockFcntl(CellularSockDescriptor_t descriptor,
             errno = CELLULAR_SOCK_EBADF;
         }
 
-        CELLULAR_PORT_MUTEX_UNLOCK(gMutexContainer);
+        containerUnlock(pContainer);
 
     } else {
         // The only reason initialisation might fail
@@ -1848,10 +3455,8 @@ int32_t cellularSockIoctl(CellularSockDescriptor_t descriptor,
 
     if (init()) {
 
-        CELLULAR_PORT_MUTEX_LOCK(gMutexContainer);
-
-        // Find the container
-        pContainer = pContainerFindByDescriptor(descriptor);
+        // Find the container, locking it
+        pContainer = pContainerLock(descriptor);
 
         if (pContainer != NULL) {
             switch (command) {
@@ -1871,7 +3476,7 @@ int32_t cellularSockIoctl(CellularSockDescriptor_t descriptor,
             errno = CELLULAR_SOCK_EBADF;
         }
 
-        CELLULAR_PORT_MUTEX_UNLOCK(gMutexContainer);
+        containerUnlock(pContainer);
 
     } else {
         // The only reason initialisation might fail
@@ -1902,10 +3507,8 @@ int32_t cellularSockSetOption(CellularSockDescriptor_t descriptor,
 
     if (init()) {
 
-        CELLULAR_PORT_MUTEX_LOCK(gMutexContainer);
-
-        // Find the container
-        pContainer = pContainerFindByDescriptor(descriptor);
+        // Find the container, locking it
+        pContainer = pContainerLock(descriptor);
 
         if (pContainer != NULL) {
             // Check parameters
@@ -1938,6 +3541,20 @@ int32_t cellularSockSetOption(CellularSockDescriptor_t descriptor,
                                                             optionValueLength,
                                                             &errno);
                             break;
+                            // Read-ahead buffer size, which is local
+                            case CELLULAR_SOCK_OPT_RCVBUF:
+                                errorCode = setOptionRxBuffer(pContainer,
+                                                              pOptionValue,
+                                                              optionValueLength,
+                                                              &errno);
+                            break;
+                            // Send buffer size, which is also local
+                            case CELLULAR_SOCK_OPT_SNDBUF:
+                                errorCode = setOptionTxBuffer(pContainer,
+                                                              pOptionValue,
+                                                              optionValueLength,
+                                                              &errno);
+                            break;
                             // Receive timeout, which we set locally
                             case CELLULAR_SOCK_OPT_RCVTIMEO:
                                 if ((pOptionValue != NULL) && 
@@ -1950,6 +3567,13 @@ int32_t cellularSockSetOption(CellularSockDescriptor_t descriptor,
                                     errno = CELLULAR_SOCK_EINVAL;
                                 }
                             break;
+                            // TLS in the module
+                            case CELLULAR_SOCK_OPT_SECURE_PROFILE:
+                                errorCode = setOptionSecureProfile(pContainer,
+                                                                   pOptionValue,
+                                                                   optionValueLength,
+                                                                   &errno);
+                            break;
                             default:
                                 // Invalid argument
                                 errno = CELLULAR_SOCK_EINVAL;
@@ -1979,10 +3603,25 @@ int32_t cellularSockSetOption(CellularSockDescriptor_t descriptor,
                     break;
                     case CELLULAR_SOCK_OPT_LEVEL_TCP:
                         switch (option) {
-                            // The supported options, both of
-                            // which have an integer as a
-                            // parameter
+                            // No delay goes to the module but
+                            // also governs our send buffer
                             case CELLULAR_SOCK_OPT_TCP_NODELAY:
+                                errorCode = setOptionInt(descriptor,
+                                                         pContainer->socket.modemHandle,
+                                                         level,
+                                                         option,
+                                                         pOptionValue,
+                                                         optionValueLength,
+                                                         &errno);
+                                if (errorCode == CELLULAR_SOCK_SUCCESS) {
+                                    pContainer->socket.noDelay = (*((int32_t *) pOptionValue) != 0);
+                                    if (pContainer->socket.noDelay) {
+                                        // Don't hold anything back
+                                        txBufferFlush(pContainer);
+                                    }
+                                }
+                            break;
+                            // Integer options handled by the module
                             case CELLULAR_SOCK_OPT_TCP_KEEPIDLE:
                                 errorCode = setOptionInt(descriptor,
                                                          pContainer->socket.modemHandle,
@@ -2012,7 +3651,7 @@ int32_t cellularSockSetOption(CellularSockDescriptor_t descriptor,
             errno = CELLULAR_SOCK_EBADF;
         }
 
-        CELLULAR_PORT_MUTEX_UNLOCK(gMutexContainer);
+        containerUnlock(pContainer);
 
     } else {
         // The only reason initialisation might fail
@@ -2040,10 +3679,8 @@ int32_t cellularSockGetOption(CellularSockDescriptor_t descriptor,
 
     if (init()) {
 
-        CELLULAR_PORT_MUTEX_LOCK(gMutexContainer);
-
-        // Find the container
-        pContainer = pContainerFindByDescriptor(descriptor);
+        // Find the container, locking it
+        pContainer = pContainerLock(descriptor);
 
         if (pContainer != NULL) {
             // If there's an optionValue then there must be a length
@@ -2076,6 +3713,20 @@ int32_t cellularSockGetOption(CellularSockDescriptor_t descriptor,
                                                             pOptionValueLength,
                                                             &errno);
                             break;
+                            // Read-ahead buffer size, which is local
+                            case CELLULAR_SOCK_OPT_RCVBUF:
+                                errorCode = getOptionRxBuffer(pContainer,
+                                                              pOptionValue,
+                                                              pOptionValueLength,
+                                                              &errno);
+                            break;
+                            // Send buffer size, which is also local
+                            case CELLULAR_SOCK_OPT_SNDBUF:
+                                errorCode = getOptionTxBuffer(pContainer,
+                                                              pOptionValue,
+                                                              pOptionValueLength,
+                                                              &errno);
+                            break;
                             // Receive timeout, which we just get locally
                             case CELLULAR_SOCK_OPT_RCVTIMEO:
                                 if (pOptionValueLength != NULL) {
@@ -2102,6 +3753,37 @@ int32_t cellularSockGetOption(CellularSockDescriptor_t descriptor,
                                     errno = CELLULAR_SOCK_EINVAL;
                                 }
                             break;
+                            // TLS in the module
+                            case CELLULAR_SOCK_OPT_SECURE_PROFILE:
+                                errorCode = getOptionSecureProfile(pContainer,
+                                                                   pOptionValue,
+                                                                   pOptionValueLength,
+                                                                   &errno);
+                            break;
+                            // The outcome of an asynchronous connect,
+                            // which is local and cleared on reading
+                            case CELLULAR_SOCK_OPT_ERROR:
+                                if (pOptionValueLength != NULL) {
+                                    if (pOptionValue != NULL) {
+                                        if (*pOptionValueLength >= sizeof(int32_t)) {
+                                            *((int32_t *) pOptionValue) = pContainer->socket.pendingError;
+                                            pContainer->socket.pendingError = 0;
+                                            *pOptionValueLength = sizeof(int32_t);
+                                            errorCode = CELLULAR_SOCK_SUCCESS;
+                                        } else {
+                                            // Caller hasn't left enough room
+                                            errno = CELLULAR_SOCK_EINVAL;
+                                        }
+                                    } else {
+                                        // Caller just wants to know the length required
+                                        *pOptionValueLength = sizeof(int32_t);
+                                        errorCode = CELLULAR_SOCK_SUCCESS;
+                                    }
+                                } else {
+                                    // Invalid argument, there must be a value length
+                                    errno = CELLULAR_SOCK_EINVAL;
+                                }
+                            break;
                             default:
                                 // Invalid argument
                                 errno = CELLULAR_SOCK_EINVAL;
@@ -2164,7 +3846,7 @@ int32_t cellularSockGetOption(CellularSockDescriptor_t descriptor,
             errno = CELLULAR_SOCK_EBADF;
         }
 
-        CELLULAR_PORT_MUTEX_UNLOCK(gMutexContainer);
+        containerUnlock(pContainer);
 
     } else {
         // The only reason initialisation might fail
@@ -2194,10 +3876,8 @@ int32_t cellularSockSendTo(CellularSockDescriptor_t descriptor,
 
     if (init()) {
 
-        CELLULAR_PORT_MUTEX_LOCK(gMutexContainer);
-
-        // Find the container
-        pContainer = pContainerFindByDescriptor(descriptor);
+        // Find the container, locking it
+        pContainer = pContainerLock(descriptor);
 
         // If we have found the container, talk to cellular to
         // do the sending
@@ -2252,7 +3932,7 @@ int32_t cellularSockSendTo(CellularSockDescriptor_t descriptor,
             errno = CELLULAR_SOCK_EBADF;
         }
 
-        CELLULAR_PORT_MUTEX_UNLOCK(gMutexContainer);
+        containerUnlock(pContainer);
 
     } else {
         // The only reason initialisation might fail
@@ -2267,6 +3947,111 @@ int32_t cellularSockSendTo(CellularSockDescriptor_t descriptor,
     return (int32_t) errorCodeOrSize;
 }
 
+// Send a batch of datagrams.
+int32_t cellularSockSendToBatch(CellularSockDescriptor_t descriptor,
+                                CellularSockDatagram_t *pDatagrams,
+                                size_t numDatagrams)
+{
+    CellularSockErrorCode_t errorCodeOrNum = CELLULAR_SOCK_BSD_ERROR;
+    int32_t errno = CELLULAR_SOCK_ENONE;
+    CellularSockContainer_t *pContainer = NULL;
+    CellularSockDatagram_t *pDatagram;
+    const CellularSockAddress_t *pRemoteAddress;
+    const CellularSockAddress_t *pBufferAddress = NULL;
+    char buffer[CELLULAR_SOCK_ADDRESS_STRING_MAX_LENGTH_BYTES];
+    int32_t numSent = 0;
+
+    if (init()) {
+        // Check parameters
+        if ((pDatagrams != NULL) || (numDatagrams == 0)) {
+
+            // Find the container, locking it
+            pContainer = pContainerLock(descriptor);
+
+            if (pContainer != NULL) {
+                // It's OK to send UDP packets on a TCP socket
+                if ((pContainer->socket.protocol == CELLULAR_SOCK_PROTOCOL_UDP) ||
+                    (pContainer->socket.protocol == CELLULAR_SOCK_PROTOCOL_TCP)) {
+                    // Hold on to the AT interface for the lot
+                    cellular_ctrl_at_lock();
+                    for (size_t x = 0; x < numDatagrams; x++) {
+                        pDatagram = pDatagrams + x;
+                        pRemoteAddress = pDatagram->pRemoteAddress;
+                        if ((pRemoteAddress == NULL) &&
+                            (pContainer->socket.state == CELLULAR_SOCK_STATE_CONNECTED)) {
+                            // Use the stored address
+                            pRemoteAddress = &(pContainer->socket.remoteAddress);
+                        }
+                        if (pRemoteAddress == NULL) {
+                            // Destination address required
+                            pDatagram->result = -CELLULAR_SOCK_EDESTADDRREQ;
+                        } else if ((pDatagram->pData == NULL) &&
+                                   (pDatagram->dataSizeBytes > 0)) {
+                            // Invalid argument
+                            pDatagram->result = -CELLULAR_SOCK_EINVAL;
+                        } else if (pDatagram->dataSizeBytes > CELLULAR_SOCK_MAX_SEGMENT_LENGTH_BYTES) {
+                            // Indicate that the message was too long
+                            pDatagram->result = -CELLULAR_SOCK_EMSGSIZE;
+                        } else if (pDatagram->dataSizeBytes == 0) {
+                            // Nothing to do
+                            pDatagram->result = 0;
+                        } else {
+                            // Only re-do the address string when the
+                            // destination changes
+                            if ((pBufferAddress == NULL) ||
+                                !addressIsSame(pRemoteAddress, pBufferAddress)) {
+                                pBufferAddress = NULL;
+                                if (addressToString(pRemoteAddress, false,
+                                                    buffer, sizeof(buffer)) > 0) {
+                                    pBufferAddress = pRemoteAddress;
+                                }
+                            }
+                            if (pBufferAddress != NULL) {
+                                pDatagram->result = sendToAtLocked(pContainer,
+                                                                   buffer,
+                                                                   pRemoteAddress->port,
+                                                                   pDatagram->pData,
+                                                                   pDatagram->dataSizeBytes);
+                            } else {
+                                // Seems appropriate
+                                pDatagram->result = -CELLULAR_SOCK_EDESTADDRREQ;
+                            }
+                        }
+                        if (pDatagram->result >= 0) {
+                            numSent++;
+                        }
+                    }
+                    cellular_ctrl_at_unlock();
+                    errorCodeOrNum = numSent;
+                } else {
+                    // Should never get here, throw 'em a googley so that the
+                    // error is distinct
+                    errno = CELLULAR_SOCK_EPROTOTYPE;
+                }
+            } else {
+                // Indicate that we weren't passed a valid socket descriptor
+                errno = CELLULAR_SOCK_EBADF;
+            }
+
+            containerUnlock(pContainer);
+
+        } else {
+            // Invalid argument
+            errno = CELLULAR_SOCK_EINVAL;
+        }
+    } else {
+        // The only reason initialisation might fail
+        errno = CELLULAR_SOCK_ENOMEM;
+    }
+
+    if (errno != CELLULAR_SOCK_ENONE) {
+        // Write the errno
+        cellularPort_errno_set(errno);
+    }
+
+    return (int32_t) errorCodeOrNum;
+}
+
 // Receive a datagram from the given host.
 int32_t cellularSockReceiveFrom(CellularSockDescriptor_t descriptor,
                                 CellularSockAddress_t *pRemoteAddress,
@@ -2278,10 +4063,8 @@ int32_t cellularSockReceiveFrom(CellularSockDescriptor_t descriptor,
 
     if (init()) {
 
-        CELLULAR_PORT_MUTEX_LOCK(gMutexContainer);
-
-        // Find the container
-        pContainer = pContainerFindByDescriptor(descriptor);
+        // Find the container, locking it
+        pContainer = pContainerLock(descriptor);
 
         // If we have found the container, talk to cellular to
         // do the receiving
@@ -2324,7 +4107,7 @@ int32_t cellularSockReceiveFrom(CellularSockDescriptor_t descriptor,
             errno = CELLULAR_SOCK_EBADF;
         }
 
-        CELLULAR_PORT_MUTEX_UNLOCK(gMutexContainer);
+        containerUnlock(pContainer);
 
     } else {
         // The only reason initialisation might fail
@@ -2355,10 +4138,8 @@ int32_t cellularSockWrite(CellularSockDescriptor_t descriptor,
         // Check parameters
         if (pData != NULL) {
 
-            CELLULAR_PORT_MUTEX_LOCK(gMutexContainer);
-
-            // Find the container
-            pContainer = pContainerFindByDescriptor(descriptor);
+            // Find the container, locking it
+            pContainer = pContainerLock(descriptor);
 
             // If we have found the container, talk to cellular to
             // do the sending
@@ -2369,11 +4150,157 @@ int32_t cellularSockWrite(CellularSockDescriptor_t descriptor,
                             // Invalid argument
                             errno = CELLULAR_SOCK_EINVAL;
                         } else {
-                            if ((pData != NULL) && (dataSizeBytes > 0)) {
-                                errorCodeOrSize = send(pContainer, pData, dataSizeBytes);
+                            if ((pData != NULL) && (dataSizeBytes > 0)) {
+                                if (pContainer->socket.directLink) {
+                                    errorCodeOrSize = directLinkWrite(pContainer, pData,
+                                                                      dataSizeBytes);
+                                } else {
+                                    errorCodeOrSize = sendCoalesce(pContainer, pData,
+                                                                   dataSizeBytes);
+                                }
+                            } else {
+                                // Nothing to do
+                                errorCodeOrSize = CELLULAR_SOCK_SUCCESS;
+                            }
+                        }
+                    } else {
+                        if ((pContainer->socket.state == CELLULAR_SOCK_STATE_SHUTDOWN_FOR_WRITE) ||
+                            (pContainer->socket.state == CELLULAR_SOCK_STATE_SHUTDOWN_FOR_READ_WRITE)) {
+                            // Socket is shut down
+                            errno = CELLULAR_SOCK_ESHUTDOWN;
+                        } else if (pContainer->socket.state == CELLULAR_SOCK_STATE_CLOSING) {
+                            // Not connected mate
+                            errno = CELLULAR_SOCK_ENOTCONN;
+                        } else {
+                            // No route to host?
+                            errno = CELLULAR_SOCK_EHOSTUNREACH;
+                        }
+                    }
+                } else {
+                    // Should never get here, throw 'em a googley so that the
+                    // error is distinct
+                    errno = CELLULAR_SOCK_EPROTOTYPE;
+                }
+            } else {
+                // Indicate that we weren't passed a valid socket descriptor
+                errno = CELLULAR_SOCK_EBADF;
+            }
+
+            containerUnlock(pContainer);
+
+        } else {
+            // Invalid argument
+            errno = CELLULAR_SOCK_EINVAL;
+        }
+    } else {
+        // The only reason initialisation might fail
+        errno = CELLULAR_SOCK_ENOMEM;
+    }
+
+    if (errno != CELLULAR_SOCK_ENONE) {
+        // Write the errno
+        cellularPort_errno_set(errno);
+    }
+
+    return (int32_t) errorCodeOrSize;
+}
+
+// Send data through the transmit scheduler.
+int32_t cellularSockWriteDeferred(CellularSockDescriptor_t descriptor,
+                                  const void *pData, size_t dataSizeBytes,
+                                  int32_t deadlineSeconds)
+{
+    int32_t errorCodeOrSize = CELLULAR_SOCK_BSD_ERROR;
+
+    if (pData != NULL) {
+        errorCodeOrSize = cellularCtrlTxSchedulerSend(deferredWrite,
+                                                      (void *) (intptr_t) descriptor,
+                                                      pData, dataSizeBytes,
+                                                      deadlineSeconds);
+        if (errorCodeOrSize < 0) {
+            // Set errno if the error was the scheduler's rather
+            // than cellularSockWrite()'s
+            if (errorCodeOrSize == CELLULAR_CTRL_NO_MEMORY) {
+                cellularPort_errno_set(CELLULAR_SOCK_ENOBUFS);
+            }
+            errorCodeOrSize = CELLULAR_SOCK_BSD_ERROR;
+        }
+    } else {
+        // Invalid argument
+        cellularPort_errno_set(CELLULAR_SOCK_EINVAL);
+    }
+
+    return errorCodeOrSize;
+}
+
+// Send data gathered from several buffers.
+int32_t cellularSockWriteV(CellularSockDescriptor_t descriptor,
+                           const CellularSockIovec_t *pIov,
+                           size_t numIov)
+{
+    CellularSockErrorCode_t errorCodeOrSize = CELLULAR_SOCK_BSD_ERROR;
+    int32_t errno = CELLULAR_SOCK_ENONE;
+    CellularSockContainer_t *pContainer = NULL;
+    size_t dataSizeBytes = 0;
+    bool parametersOk = (pIov != NULL) || (numIov == 0);
+
+    if (init()) {
+        // Check parameters
+        for (size_t x = 0; parametersOk && (x < numIov); x++) {
+            if (((pIov + x)->iov_base == NULL) && ((pIov + x)->iov_len > 0)) {
+                parametersOk = false;
+            } else {
+                dataSizeBytes += (pIov + x)->iov_len;
+            }
+        }
+        if (parametersOk) {
+
+            // Find the container, locking it
+            pContainer = pContainerLock(descriptor);
+
+            // If we have found the container, talk to cellular to
+            // do the sending
+            if (pContainer != NULL) {
+                if (pContainer->socket.protocol == CELLULAR_SOCK_PROTOCOL_TCP) {
+                    if (pContainer->socket.state == CELLULAR_SOCK_STATE_CONNECTED) {
+                        if (dataSizeBytes == 0) {
+                            // Nothing to do
+                            errorCodeOrSize = CELLULAR_SOCK_SUCCESS;
+                        } else if (pContainer->socket.directLink) {
+                            // No framing to worry about, just
+                            // write the buffers out in turn
+                            errorCodeOrSize = CELLULAR_SOCK_SUCCESS;
+                            for (size_t x = 0; (x < numIov) && (errorCodeOrSize >= 0); x++) {
+                                if ((pIov + x)->iov_len > 0) {
+                                    errorCodeOrSize = directLinkWrite(pContainer,
+                                                                      (pIov + x)->iov_base,
+                                                                      (pIov + x)->iov_len);
+                                }
+                            }
+                            if (errorCodeOrSize >= 0) {
+                                errorCodeOrSize = dataSizeBytes;
+                            }
+                        } else if ((pContainer->socket.pTxBuffer != NULL) &&
+                                   !pContainer->socket.noDelay &&
+                                   (dataSizeBytes < pContainer->socket.txBufferSizeBytes)) {
+                            // Small enough to be worth coalescing
+                            errorCodeOrSize = CELLULAR_SOCK_SUCCESS;
+                            for (size_t x = 0; (x < numIov) && (errorCodeOrSize >= 0); x++) {
+                                if ((pIov + x)->iov_len > 0) {
+                                    errorCodeOrSize = sendCoalesce(pContainer,
+                                                                   (pIov + x)->iov_base,
+                                                                   (pIov + x)->iov_len);
+                                }
+                            }
+                            if (errorCodeOrSize >= 0) {
+                                errorCodeOrSize = dataSizeBytes;
+                            }
+                        } else {
+                            // Anything buffered has to go first
+                            if (txBufferFlush(pContainer) == 0) {
+                                errorCodeOrSize = sendV(pContainer, pIov, numIov);
                             } else {
-                                // Nothing to do
-                                errorCodeOrSize = CELLULAR_SOCK_SUCCESS;
+                                errno = CELLULAR_SOCK_EIO;
                             }
                         }
                     } else {
@@ -2399,7 +4326,7 @@ int32_t cellularSockWrite(CellularSockDescriptor_t descriptor,
                 errno = CELLULAR_SOCK_EBADF;
             }
 
-            CELLULAR_PORT_MUTEX_UNLOCK(gMutexContainer);
+            containerUnlock(pContainer);
 
         } else {
             // Invalid argument
@@ -2428,10 +4355,8 @@ int32_t cellularSockRead(CellularSockDescriptor_t descriptor,
 
     if (init()) {
 
-        CELLULAR_PORT_MUTEX_LOCK(gMutexContainer);
-
-        // Find the container
-        pContainer = pContainerFindByDescriptor(descriptor);
+        // Find the container, locking it
+        pContainer = pContainerLock(descriptor);
 
         // If we have found the container, talk to cellular to
         // do the receiving
@@ -2443,7 +4368,13 @@ int32_t cellularSockRead(CellularSockDescriptor_t descriptor,
                         errno = CELLULAR_SOCK_EINVAL;
                     } else {
                         if ((pData != NULL) && (dataSizeBytes != 0)) {
-                            if (pContainer->socket.protocol == CELLULAR_SOCK_PROTOCOL_TCP) {
+                            if (pContainer->socket.directLink) {
+                                errorCodeOrSize = directLinkRead(pContainer, pData,
+                                                                 dataSizeBytes);
+                            } else if (pContainer->socket.protocol == CELLULAR_SOCK_PROTOCOL_TCP) {
+                                // The other end may be waiting for
+                                // something we've buffered
+                                txBufferFlush(pContainer);
                                 errorCodeOrSize = receive(pContainer, pData, dataSizeBytes);
                             }
                         } else {
@@ -2474,7 +4405,7 @@ int32_t cellularSockRead(CellularSockDescriptor_t descriptor,
             errno = CELLULAR_SOCK_EBADF;
         }
 
-        CELLULAR_PORT_MUTEX_UNLOCK(gMutexContainer);
+        containerUnlock(pContainer);
 
     } else {
         // The only reason initialisation might fail
@@ -2499,11 +4430,13 @@ int32_t cellularSockShutdown(CellularSockDescriptor_t descriptor,
 
     if (init()) {
 
-        CELLULAR_PORT_MUTEX_LOCK(gMutexContainer);
-
-        // Find the container
-        pContainer = pContainerFindByDescriptor(descriptor);
+        // Find the container, locking it
+        pContainer = pContainerLock(descriptor);
         if (pContainer != NULL) {
+            if (how != CELLULAR_SOCK_SHUTDOWN_READ) {
+                // Send whatever we're sat on first
+                txBufferFlush(pContainer);
+            }
             // Set the socket state
             switch (how) {
                 case CELLULAR_SOCK_SHUTDOWN_READ:
@@ -2523,12 +4456,181 @@ int32_t cellularSockShutdown(CellularSockDescriptor_t descriptor,
                     errno = CELLULAR_SOCK_EINVAL;
                 break;
             }
+            if (errorCode == CELLULAR_SOCK_SUCCESS) {
+                // Reads may now not block, let anyone select()ing know
+                CELLULAR_PORT_MUTEX_LOCK(gMutexCallbacks);
+                signalWaiters();
+                CELLULAR_PORT_MUTEX_UNLOCK(gMutexCallbacks);
+            }
         } else {
             // Indicate that we weren't passed a valid socket descriptor
             errno = CELLULAR_SOCK_EBADF;
         }
 
-        CELLULAR_PORT_MUTEX_UNLOCK(gMutexContainer);
+        containerUnlock(pContainer);
+
+    } else {
+        // The only reason initialisation might fail
+        errno = CELLULAR_SOCK_ENOMEM;
+    }
+
+    if (errno != CELLULAR_SOCK_ENONE) {
+        // Write the errno
+        cellularPort_errno_set(errno);
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Put a TCP socket into or take it out of direct-link mode.
+int32_t cellularSockSetDirectLink(CellularSockDescriptor_t descriptor,
+                                  bool onNotOff)
+{
+    CellularSockErrorCode_t errorCode = CELLULAR_SOCK_BSD_ERROR;
+    int32_t errno = CELLULAR_SOCK_ENONE;
+    CellularSockContainer_t *pContainer = NULL;
+
+    if (init()) {
+
+        // Find the container, locking it
+        pContainer = pContainerLock(descriptor);
+
+        if (pContainer != NULL) {
+            // gMutexContainer is held, once the container is
+            // locked, so that no other socket can claim the UART
+            CELLULAR_PORT_MUTEX_LOCK(gMutexContainer);
+            if (pContainer->socket.protocol == CELLULAR_SOCK_PROTOCOL_TCP) {
+                if (!onNotOff) {
+                    errorCode = CELLULAR_SOCK_SUCCESS;
+                    if (pContainer->socket.directLink &&
+                        !directLinkStop(pContainer)) {
+                        // Out of direct-link mode but the module
+                        // didn't say DISCONNECT
+                        errorCode = CELLULAR_SOCK_BSD_ERROR;
+                        errno = CELLULAR_SOCK_EIO;
+                    }
+                } else if (pContainer->socket.directLink) {
+                    // Nothing to do
+                    errorCode = CELLULAR_SOCK_SUCCESS;
+                } else if (gpDirectLinkContainer != NULL) {
+                    // Only one socket can have the UART
+                    errno = CELLULAR_SOCK_EBUSY;
+                } else if (pContainer->socket.state != CELLULAR_SOCK_STATE_CONNECTED) {
+                    // Not connected mate
+                    errno = CELLULAR_SOCK_ENOTCONN;
+                } else if (txBufferFlush(pContainer) != 0) {
+                    // Buffered data would end up
+                    // behind the direct-link data
+                    errno = CELLULAR_SOCK_EIO;
+                } else {
+                    cellular_ctrl_at_lock();
+                    cellular_ctrl_at_cmd_start("AT+USODL=");
+                    cellular_ctrl_at_write_int(pContainer->socket.modemHandle);
+                    cellular_ctrl_at_cmd_stop();
+                    if (cellular_ctrl_at_direct_link_enter()) {
+                        pContainer->socket.directLink = true;
+                        gpDirectLinkContainer = pContainer;
+                        errorCode = CELLULAR_SOCK_SUCCESS;
+                        cellularPortLog("CELLULAR_SOCK: socket with descriptor %d, modem handle %d,"
+                                        " is in direct-link mode.\n",
+                                        descriptor,
+                                        pContainer->socket.modemHandle);
+                    } else {
+                        errno = CELLULAR_SOCK_EIO;
+                    }
+                    cellular_ctrl_at_unlock();
+                }
+            } else {
+                // Direct-link mode is only for TCP
+                errno = CELLULAR_SOCK_EOPNOTSUPP;
+            }
+            CELLULAR_PORT_MUTEX_UNLOCK(gMutexContainer);
+        } else {
+            // Indicate that we weren't passed a valid socket descriptor
+            errno = CELLULAR_SOCK_EBADF;
+        }
+
+        containerUnlock(pContainer);
+
+    } else {
+        // The only reason initialisation might fail
+        errno = CELLULAR_SOCK_ENOMEM;
+    }
+
+    if (errno != CELLULAR_SOCK_ENONE) {
+        // Write the errno
+        cellularPort_errno_set(errno);
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Get the statistics of a socket.
+int32_t cellularSockGetStats(CellularSockDescriptor_t descriptor,
+                             CellularSockStats_t *pStats)
+{
+    CellularSockErrorCode_t errorCode = CELLULAR_SOCK_BSD_ERROR;
+    int32_t errno = CELLULAR_SOCK_ENONE;
+    CellularSockContainer_t *pContainer = NULL;
+
+    if (init()) {
+
+        // Check parameters
+        if (pStats != NULL) {
+
+            // Find the container, locking it
+            pContainer = pContainerLock(descriptor);
+
+            if (pContainer != NULL) {
+                pCellularPort_memcpy(pStats, &(pContainer->socket.stats),
+                                     sizeof(*pStats));
+                errorCode = CELLULAR_SOCK_SUCCESS;
+            } else {
+                // Indicate that we weren't passed a valid socket descriptor
+                errno = CELLULAR_SOCK_EBADF;
+            }
+
+            containerUnlock(pContainer);
+
+        } else {
+            // Invalid argument
+            errno = CELLULAR_SOCK_EINVAL;
+        }
+    } else {
+        // The only reason initialisation might fail
+        errno = CELLULAR_SOCK_ENOMEM;
+    }
+
+    if (errno != CELLULAR_SOCK_ENONE) {
+        // Write the errno
+        cellularPort_errno_set(errno);
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Reset the statistics of a socket.
+int32_t cellularSockResetStats(CellularSockDescriptor_t descriptor)
+{
+    CellularSockErrorCode_t errorCode = CELLULAR_SOCK_BSD_ERROR;
+    int32_t errno = CELLULAR_SOCK_ENONE;
+    CellularSockContainer_t *pContainer = NULL;
+
+    if (init()) {
+
+        // Find the container, locking it
+        pContainer = pContainerLock(descriptor);
+
+        if (pContainer != NULL) {
+            pCellularPort_memset(&(pContainer->socket.stats), 0,
+                                 sizeof(pContainer->socket.stats));
+            errorCode = CELLULAR_SOCK_SUCCESS;
+        } else {
+            // Indicate that we weren't passed a valid socket descriptor
+            errno = CELLULAR_SOCK_EBADF;
+        }
+
+        containerUnlock(pContainer);
 
     } else {
         // The only reason initialisation might fail
@@ -2558,10 +4660,8 @@ int32_t cellularSockRegisterCallbackData(CellularSockDescriptor_t descriptor,
 
     if (init()) {
 
-        CELLULAR_PORT_MUTEX_LOCK(gMutexContainer);
-
-        // Find the container
-        pContainer = pContainerFindByDescriptor(descriptor);
+        // Find the container, locking it
+        pContainer = pContainerLock(descriptor);
 
         // If we have found the container, set up the callback
         if (pContainer != NULL) {
@@ -2579,7 +4679,7 @@ int32_t cellularSockRegisterCallbackData(CellularSockDescriptor_t descriptor,
             errno = CELLULAR_SOCK_EBADF;
         }
 
-        CELLULAR_PORT_MUTEX_UNLOCK(gMutexContainer);
+        containerUnlock(pContainer);
 
     } else {
         // The only reason initialisation might fail
@@ -2605,10 +4705,8 @@ int32_t cellularSockRegisterCallbackClosed(CellularSockDescriptor_t descriptor,
 
     if (init()) {
 
-        CELLULAR_PORT_MUTEX_LOCK(gMutexContainer);
-
-        // Find the container
-        pContainer = pContainerFindByDescriptor(descriptor);
+        // Find the container, locking it
+        pContainer = pContainerLock(descriptor);
 
         // If we have found the container, set up the callbacks
         if (pContainer != NULL) {
@@ -2626,7 +4724,52 @@ int32_t cellularSockRegisterCallbackClosed(CellularSockDescriptor_t descriptor,
             errno = CELLULAR_SOCK_EBADF;
         }
 
-        CELLULAR_PORT_MUTEX_UNLOCK(gMutexContainer);
+        containerUnlock(pContainer);
+
+    } else {
+        // The only reason initialisation might fail
+        errno = CELLULAR_SOCK_ENOMEM;
+    }
+
+    if (errno != CELLULAR_SOCK_ENONE) {
+        // Write the errno
+        cellularPort_errno_set(errno);
+    }
+
+    return (int32_t) errorCode;
+}
+
+// Register a callback for an asynchronous connect completing.
+int32_t cellularSockRegisterCallbackConnected(CellularSockDescriptor_t descriptor,
+                                              void (*pCallback) (void *),
+                                              void *pCallbackParam)
+{
+    CellularSockErrorCode_t errorCode = CELLULAR_SOCK_BSD_ERROR;
+    int32_t errno = CELLULAR_SOCK_ENONE;
+    CellularSockContainer_t *pContainer = NULL;
+
+    if (init()) {
+
+        // Find the container, locking it
+        pContainer = pContainerLock(descriptor);
+
+        // If we have found the container, set up the callback
+        if (pContainer != NULL) {
+
+            CELLULAR_PORT_MUTEX_LOCK(gMutexCallbacks);
+
+            pContainer->socket.pConnectedCallback = pCallback;
+            pContainer->socket.pConnectedCallbackParam = pCallbackParam;
+
+            CELLULAR_PORT_MUTEX_UNLOCK(gMutexCallbacks);
+
+            errorCode = CELLULAR_SOCK_SUCCESS;
+        } else {
+            // Indicate that we weren't passed a valid socket descriptor
+            errno = CELLULAR_SOCK_EBADF;
+        }
+
+        containerUnlock(pContainer);
 
     } else {
         // The only reason initialisation might fail
@@ -2703,17 +4846,85 @@ int32_t cellularSockSelect(int32_t maxDescriptor,
                            CellularSockDescriptorSet_t *pExceptDescriptorSet,
                            int32_t timeMs)
 {
-    CellularSockErrorCode_t errorCode = CELLULAR_SOCK_NOT_IMPLEMENTED;
-    int32_t errno = CELLULAR_SOCK_ENOSYS;
+    CellularSockErrorCode_t errorCodeOrNumReady = CELLULAR_SOCK_BSD_ERROR;
+    int32_t errno = CELLULAR_SOCK_ENONE;
+    int64_t startTimeMs = cellularPortGetTickTimeMs();
+    int32_t waitMs = -1;
+    int32_t numReady = 0;
+    CellularSockWaiter_t *pWaiter;
+    CellularSockDescriptorSet_t readSet;
+    CellularSockDescriptorSet_t writeSet;
+    CellularSockDescriptorSet_t exceptSet;
 
-    // TODO
+    if (init()) {
+        if (maxDescriptor >= 0) {
+            if (maxDescriptor > CELLULAR_SOCK_DESCRIPTOR_SETSIZE) {
+                maxDescriptor = CELLULAR_SOCK_DESCRIPTOR_SETSIZE;
+            }
+            // The far end may be waiting on something
+            // sat in a send buffer
+            txBufferFlushAll();
+            // If there's no waiter free waiterWait() will poll
+            pWaiter = pWaiterAcquire();
+            do {
+                waiterArm(pWaiter);
+                numReady = selectCheck(maxDescriptor,
+                                       pReadDescriptorSet,
+                                       pWriteDescriptoreSet,
+                                       pExceptDescriptorSet,
+                                       &readSet, &writeSet,
+                                       &exceptSet);
+                if (numReady == 0) {
+                    // A negative timeMs means wait forever
+                    if (timeMs >= 0) {
+                        waitMs = timeMs - (int32_t) (cellularPortGetTickTimeMs() -
+                                                     startTimeMs);
+                        if (waitMs < 0) {
+                            waitMs = 0;
+                        }
+                    }
+                    if (waitMs != 0) {
+                        // Wait for a URC to change something
+                        waiterWait(pWaiter, waitMs);
+                    }
+                }
+            } while ((numReady == 0) && (waitMs != 0));
+            waiterRelease(pWaiter);
+
+            if (numReady >= 0) {
+                // Write back the results; sets that
+                // weren't given weren't checked
+                if (pReadDescriptorSet != NULL) {
+                    pCellularPort_memcpy(*pReadDescriptorSet, readSet,
+                                         sizeof(readSet));
+                }
+                if (pWriteDescriptoreSet != NULL) {
+                    pCellularPort_memcpy(*pWriteDescriptoreSet, writeSet,
+                                         sizeof(writeSet));
+                }
+                if (pExceptDescriptorSet != NULL) {
+                    pCellularPort_memcpy(*pExceptDescriptorSet, exceptSet,
+                                         sizeof(exceptSet));
+                }
+                errorCodeOrNumReady = numReady;
+            } else {
+                // One of the descriptors was not a socket
+                errno = CELLULAR_SOCK_EBADF;
+            }
+        } else {
+            errno = CELLULAR_SOCK_EINVAL;
+        }
+    } else {
+        // The only reason initialisation might fail
+        errno = CELLULAR_SOCK_ENOMEM;
+    }
 
     if (errno != CELLULAR_SOCK_ENONE) {
         // Write the errno
         cellularPort_errno_set(errno);
     }
 
-    return (int32_t) errorCode;
+    return (int32_t) errorCodeOrNumReady;
 }
 
 /* ----------------------------------------------------------------
@@ -2733,10 +4944,8 @@ int32_t cellularSockGetRemoteAddress(CellularSockDescriptor_t descriptor,
         // Check parameters
         if (pRemoteAddress != NULL) {
 
-            CELLULAR_PORT_MUTEX_LOCK(gMutexContainer);
-
-            // Find the container
-            pContainer = pContainerFindByDescriptor(descriptor);
+            // Find the container, locking it
+            pContainer = pContainerLock(descriptor);
 
             if (pContainer != NULL) {
                 if (pContainer->socket.state == CELLULAR_SOCK_STATE_CONNECTED) {
@@ -2753,7 +4962,7 @@ int32_t cellularSockGetRemoteAddress(CellularSockDescriptor_t descriptor,
                 errno = CELLULAR_SOCK_EBADF;
             }
 
-            CELLULAR_PORT_MUTEX_UNLOCK(gMutexContainer);
+            containerUnlock(pContainer);
 
         } else {
             // Invalid argument
@@ -2786,10 +4995,8 @@ int32_t cellularSockGetLocalAddress(CellularSockDescriptor_t descriptor,
         // Check parameters
         if (pLocalAddress != NULL) {
 
-            CELLULAR_PORT_MUTEX_LOCK(gMutexContainer);
-
-            // Check that the descriptor is at least valid
-            pContainer = pContainerFindByDescriptor(descriptor);
+            // Check that the descriptor is at least valid, locking it
+            pContainer = pContainerLock(descriptor);
             if (pContainer != NULL) {
                 // IP address is that of cellular, for all sockets
                 if (cellularCtrlGetIpAddressStr(buffer) > 0) {
@@ -2807,7 +5014,7 @@ int32_t cellularSockGetLocalAddress(CellularSockDescriptor_t descriptor,
                 errno = CELLULAR_SOCK_EBADF;
             }
 
-            CELLULAR_PORT_MUTEX_UNLOCK(gMutexContainer);
+            containerUnlock(pContainer);
 
         } else {
             // Nothing to do
@@ -2831,47 +5038,22 @@ int32_t cellularSockGetHostByName(const char *pHostName,
                                   CellularSockIpAddress_t *pHostIpAddress)
 {
     CellularSockErrorCode_t errorCode = CELLULAR_SOCK_BSD_ERROR;
-    char buffer[CELLULAR_SOCK_ADDRESS_STRING_MAX_LENGTH_BYTES];
-    CellularSockAddress_t address;
-    int32_t bytesRead;
-    int32_t atError;
+    CellularSockIpAddress_t ipAddress;
+    bool ipAddressValid;
 
-    // No need to call init() here, this does not use the mutexes
+    // No need to call init() here, this only
+    // uses the DNS mutex
     if (pHostName != NULL) {
-        cellularPortLog("CELLULAR_SOCK: looking up IP address of \"%s\".\n",
-                        pHostName);
-        cellular_ctrl_at_lock();
-        // Allow plenty of time
-        cellular_ctrl_at_set_at_timeout(60000, false);
-        cellular_ctrl_at_cmd_start("AT+UDNSRN=");
-        cellular_ctrl_at_write_int(0);
-        cellular_ctrl_at_write_string(pHostName, true);
-        cellular_ctrl_at_cmd_stop();
-        cellular_ctrl_at_resp_start("+UDNSRN:", false);
-        bytesRead = cellular_ctrl_at_read_string(buffer,
-                                                 sizeof(buffer),
-                                                 false);
-        cellular_ctrl_at_resp_stop();
-        cellular_ctrl_at_restore_at_timeout();
-        atError = cellular_ctrl_at_unlock_return_error();
-        if ((bytesRead >= 0) && (atError == 0)) {
-            // All is good
-            cellularPortLog("CELLULAR_SOCK: found it at \"%.*s\".\n",
-                            bytesRead, buffer);
-            if (pHostIpAddress != NULL) {
-                // Convert to struct
-                if (cellularSockStringToAddress(buffer,
-                                                &address) == 0) {
-                    pCellularPort_memcpy(pHostIpAddress,
-                                         &(address.ipAddress),
+        if (dnsInit()) {
+            errorCode = dnsLookUp(pHostName, &ipAddress, &ipAddressValid);
+            if ((errorCode == 0) && (pHostIpAddress != NULL)) {
+                if (ipAddressValid) {
+                    pCellularPort_memcpy(pHostIpAddress, &ipAddress,
                                          sizeof(*pHostIpAddress));
-                    errorCode = CELLULAR_SOCK_SUCCESS;
+                } else {
+                    errorCode = CELLULAR_SOCK_BSD_ERROR;
                 }
-            } else {
-                errorCode = CELLULAR_SOCK_SUCCESS;
             }
-        } else {
-            cellularPortLog("CELLULAR_SOCK: host not found.\n");
         }
     } else {
         // Nothing to do
@@ -2881,6 +5063,60 @@ int32_t cellularSockGetHostByName(const char *pHostName,
     return (int32_t) errorCode;
 }
 
+// Get the IP address of the given host name without blocking.
+int32_t cellularSockGetHostByNameAsync(const char *pHostName,
+                                       void (*pCallback) (const char *,
+                                                          int32_t,
+                                                          const CellularSockIpAddress_t *,
+                                                          void *),
+                                       void *pCallbackParam)
+{
+    CellularSockErrorCode_t errorCode = CELLULAR_SOCK_INVALID_PARAMETER;
+    CellularSockDnsRequest_t request;
+    CellularSockIpAddress_t ipAddress;
+    size_t length;
+
+    if ((pHostName != NULL) && (pCallback != NULL)) {
+        length = cellularPort_strlen(pHostName) + 1;
+        if (length <= sizeof(request.hostName)) {
+            errorCode = CELLULAR_SOCK_NO_MEMORY;
+            if (dnsInit()) {
+                if (dnsCacheGet(pHostName, &ipAddress)) {
+                    // No need to bother the task
+                    errorCode = CELLULAR_SOCK_SUCCESS;
+                    pCallback(pHostName, errorCode, &ipAddress,
+                              pCallbackParam);
+                } else {
+
+                    CELLULAR_PORT_MUTEX_LOCK(gMutexDns);
+
+                    if (dnsTaskStart()) {
+                        if (gDnsNumRequests < CELLULAR_CFG_SOCK_DNS_ASYNC_QUEUE_LENGTH) {
+                            pCellularPort_memcpy(request.hostName, pHostName, length);
+                            request.pCallback = pCallback;
+                            request.pCallbackParam = pCallbackParam;
+                            // There is room so this won't block
+                            if (cellularPortQueueSend(gQueueDns, &request) == 0) {
+                                gDnsNumRequests++;
+                                errorCode = CELLULAR_SOCK_SUCCESS;
+                            } else {
+                                errorCode = CELLULAR_SOCK_PLATFORM_ERROR;
+                            }
+                        } else {
+                            // Come back later
+                            errorCode = CELLULAR_SOCK_WOULD_BLOCK;
+                        }
+                    }
+
+                    CELLULAR_PORT_MUTEX_UNLOCK(gMutexDns);
+                }
+            }
+        }
+    }
+
+    return (int32_t) errorCode;
+}
+
 /* ----------------------------------------------------------------
  * PUBIC FUNCTIONS: ADDRESS CONVERSION
  * -------------------------------------------------------------- */
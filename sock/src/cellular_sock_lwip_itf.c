@@ -383,21 +383,15 @@ int cellular_lwip_send(int s, const void *dataptr,
 int cellular_lwip_writev(int s, const struct iovec *iov,
                          int iovcnt)
 {
-    int errorCodeOrSize = 0;
-    int thisSize = 0;
-
-    for (size_t x = 0; (x < iovcnt) &&
-                       (thisSize >= 0); x++) {
-        thisSize = cellularSockWrite((CellularSockDescriptor_t) s,
-                                     (iov + x)->iov_base,
-                                     (iov + x)->iov_len);
-        if (thisSize >= 0) {
-            errorCodeOrSize += thisSize;
-        }
-    }
+    int errorCodeOrSize = -1;
 
-    if (thisSize < 0) {
-        errorCodeOrSize = thisSize;
+    if (iovcnt >= 0) {
+        // CellularSockIovec_t matches struct iovec
+        errorCodeOrSize = cellularSockWriteV((CellularSockDescriptor_t) s,
+                                             (const CellularSockIovec_t *) iov,
+                                             iovcnt);
+    } else {
+        cellularPort_errno_set(CELLULAR_SOCK_EINVAL);
     }
 
     return errorCodeOrSize;
@@ -490,7 +484,12 @@ int cellular_lwip_select(int maxfdp1, fd_set *readset,
                          fd_set *exceptset,
                          struct timeval *timeout)
 {
-    int32_t timeMs = (timeout->tv_sec * 1000) + (timeout->tv_usec / 1000);
+    int32_t timeMs = -1;
+
+    // A NULL timeout means wait forever
+    if (timeout != NULL) {
+        timeMs = (timeout->tv_sec * 1000) + (timeout->tv_usec / 1000);
+    }
 
     return cellularSockSelect(maxfdp1,
                               (CellularSockDescriptorSet_t *) readset,
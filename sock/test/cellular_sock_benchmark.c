@@ -0,0 +1,499 @@
+/*
+ * Copyright 2020 u-blox Cambourne Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Only #includes of cellular_* are allowed here, no C lib,
+ * no platform stuff and no OS stuff.  Anything required from
+ * the platform/C library/OS must be brought in through
+ * cellular_port* to maintain portability.
+ */
+
+/* Throughput benchmarks for the sockets API, run against the
+ * same echo servers as the sockets tests.  These take a while
+ * and so are only compiled in if CELLULAR_CFG_TEST_BENCHMARK
+ * is defined; all of them have names beginning "benchmark"
+ * so that they can be selected with CELLULAR_CFG_TEST_FILTER.
+ * Each result line gives the overall rate followed by where
+ * the time went: in AT commands (sending a command to the end
+ * of its response), waiting for a '@' prompt, writing to the
+ * UART and in URC handlers, plus the time from handing the
+ * data over to the first of the echo arriving back.  The
+ * same results, plus the spread of round trip times and the
+ * memory and stack high-water marks, are also logged in the
+ * machine-readable form of CELLULAR_CFG_TEST_METRIC_TAG.
+ */
+
+#ifdef CELLULAR_CFG_OVERRIDE
+# include "cellular_cfg_override.h" // For a customer's configuration override
+#endif
+#include "cellular_cfg_sw.h"
+#include "cellular_cfg_module.h"
+#include "cellular_cfg_hw_platform_specific.h"
+#include "cellular_cfg_os_platform_specific.h"
+#include "cellular_port_clib.h"
+#include "cellular_port.h"
+#include "cellular_port_debug.h"
+#include "cellular_port_os.h"
+#include "cellular_port_uart.h"
+#include "cellular_port_test_platform_specific.h"
+#include "cellular_ctrl_at.h" // For the AT stage timings
+#include "cellular_ctrl.h"
+#include "cellular_sock.h"
+#include "cellular_cfg_test.h"
+
+#ifdef CELLULAR_CFG_TEST_BENCHMARK
+
+/* ----------------------------------------------------------------
+ * COMPILE-TIME MACROS
+ * -------------------------------------------------------------- */
+
+// The number of times each size is sent.
+#ifndef CELLULAR_SOCK_BENCHMARK_ITERATIONS
+# define CELLULAR_SOCK_BENCHMARK_ITERATIONS 10
+#endif
+
+// The smallest TCP size: as in the sockets tests, sending
+// much less than this doesn't always cause all modules to
+// send the data in a reasonable time.
+#define CELLULAR_SOCK_BENCHMARK_MIN_TCP_READ_WRITE_SIZE 128
+
+// The largest TCP size, several segments so that
+// segmentation costs show up.
+#define CELLULAR_SOCK_BENCHMARK_MAX_TCP_READ_WRITE_SIZE (CELLULAR_SOCK_MAX_SEGMENT_LENGTH_BYTES * 4)
+
+// The smallest UDP size.
+#define CELLULAR_SOCK_BENCHMARK_MIN_UDP_PACKET_SIZE 128
+
+// The largest UDP size: a sensible maximum for UDP packets
+// sent over the public internet.
+#define CELLULAR_SOCK_BENCHMARK_MAX_UDP_PACKET_SIZE 500
+
+// How long to wait for an echo to come back.
+#define CELLULAR_SOCK_BENCHMARK_ECHO_TIMEOUT_MS 20000
+
+// The longest name of a machine-readable result.
+#define CELLULAR_SOCK_BENCHMARK_METRIC_NAME_MAX_LENGTH_BYTES 64
+
+/* ----------------------------------------------------------------
+ * TYPES
+ * -------------------------------------------------------------- */
+
+// The results of one benchmark run.
+typedef struct {
+    int32_t sizeBytes;
+    int32_t count;
+    int32_t totalBytes;
+    int64_t elapsedMs;
+    int64_t arrivalMs;
+    int32_t roundTripMs[CELLULAR_SOCK_BENCHMARK_ITERATIONS];
+    cellular_ctrl_at_timing_t timing;
+} CellularSockBenchmarkResult_t;
+
+/* ----------------------------------------------------------------
+ * VARIABLES
+ * -------------------------------------------------------------- */
+
+// Used for keepGoingCallback() timeout.
+static int64_t gStopTimeMs;
+
+// The UART queue handle: kept as a global variable
+// for the same reasons as in the sockets tests.
+static CellularPortQueueHandle_t gUartQueueHandle;
+
+// Data to send: malloc()ed as it is large.
+static char *gpSendData = NULL;
+
+// Buffer to receive into: malloc()ed as it is large.
+static char *gpReceiveData = NULL;
+
+/* ----------------------------------------------------------------
+ * STATIC FUNCTIONS
+ * -------------------------------------------------------------- */
+
+// Callback function for the cellular connection process.
+static bool keepGoingCallback()
+{
+    bool keepGoing = true;
+
+    if (cellularPortGetTickTimeMs() > gStopTimeMs) {
+        keepGoing = false;
+    }
+
+    return keepGoing;
+}
+
+// Return the given percentile of some values, using the
+// nearest-rank method; the values are sorted in place.
+static int32_t percentile(int32_t *pValues, int32_t numValues,
+                          int32_t percent)
+{
+    int32_t value = 0;
+    int32_t rank;
+    int32_t y;
+
+    if (numValues > 0) {
+        // Insertion sort: there are only a handful of values
+        for (int32_t x = 1; x < numValues; x++) {
+            value = *(pValues + x);
+            for (y = x; (y > 0) && (*(pValues + y - 1) > value); y--) {
+                *(pValues + y) = *(pValues + y - 1);
+            }
+            *(pValues + y) = value;
+        }
+        rank = ((numValues * percent) + 99) / 100;
+        if (rank < 1) {
+            rank = 1;
+        }
+        value = *(pValues + rank - 1);
+    }
+
+    return value;
+}
+
+// Print one machine-readable result of a benchmark run.
+static void printMetric(const char *pName, int32_t sizeBytes,
+                        const char *pMetric, int32_t value,
+                        const char *pUnit)
+{
+    char name[CELLULAR_SOCK_BENCHMARK_METRIC_NAME_MAX_LENGTH_BYTES];
+
+    cellularPort_snprintf(name, sizeof(name), "sock%s.%d.%s",
+                          pName, sizeBytes, pMetric);
+    cellularPortLog(CELLULAR_CFG_TEST_METRIC_FORMAT, name, value, pUnit);
+}
+
+// Print the machine-readable results of a benchmark run:
+// throughput, round trip percentiles, the most memory
+// in use (only available with CELLULAR_CFG_PORT_MALLOC_POOL)
+// and the least stack ever free in the AT client tasks.
+static void printMetrics(const char *pName,
+                         CellularSockBenchmarkResult_t *pResult,
+                         int32_t bytesPerSecond)
+{
+    CellularPortMallocTagStats_t tagStats;
+    cellular_ctrl_at_task_stats_t taskStats;
+    const char *pTaskName[] = {"urc_stack_min_free", "callback_stack_min_free"};
+    int32_t heapBytes = -1;
+
+    printMetric(pName, pResult->sizeBytes, "throughput", bytesPerSecond, "B/s");
+    printMetric(pName, pResult->sizeBytes, "commands",
+                pResult->timing.num_commands, "count");
+    if (pResult->count > 0) {
+        printMetric(pName, pResult->sizeBytes, "round_trip_p50",
+                    percentile(pResult->roundTripMs, pResult->count, 50), "ms");
+        printMetric(pName, pResult->sizeBytes, "round_trip_p90",
+                    percentile(pResult->roundTripMs, pResult->count, 90), "ms");
+        printMetric(pName, pResult->sizeBytes, "round_trip_max",
+                    percentile(pResult->roundTripMs, pResult->count, 100), "ms");
+    }
+    for (size_t x = 0; x < MAX_NUM_CELLULAR_PORT_MALLOC_TAGS; x++) {
+        if (cellularPortMallocGetTagStats((CellularPortMallocTag_t) x,
+                                          &tagStats) == 0) {
+            if (heapBytes < 0) {
+                heapBytes = 0;
+            }
+            heapBytes += (int32_t) tagStats.maxInUseBytes;
+        }
+    }
+    if (heapBytes >= 0) {
+        printMetric(pName, pResult->sizeBytes, "heap_max", heapBytes, "B");
+    }
+    for (size_t x = 0; x < sizeof(pTaskName) / sizeof(pTaskName[0]); x++) {
+        if (cellular_ctrl_at_task_stats_get((cellular_ctrl_at_task_t) x,
+                                            &taskStats) == 0) {
+            printMetric(pName, pResult->sizeBytes, pTaskName[x],
+                        taskStats.stack_min_free_bytes, "B");
+        }
+    }
+}
+
+// Print the result of a benchmark run.
+static void printResult(const char *pName,
+                        CellularSockBenchmarkResult_t *pResult)
+{
+    int32_t bytesPerSecond = 0;
+
+    if (pResult->elapsedMs > 0) {
+        bytesPerSecond = (int32_t) ((((int64_t) pResult->totalBytes) * 1000) /
+                                    pResult->elapsedMs);
+    }
+    cellularPortLog("CELLULAR_SOCK_BENCHMARK: %s %d byte(s) x %d: %d byte(s)"
+                    " in %d ms, %d byte(s)/s.\n", pName,
+                    pResult->sizeBytes, pResult->count, pResult->totalBytes,
+                    (int32_t) pResult->elapsedMs, bytesPerSecond);
+    cellularPortLog("CELLULAR_SOCK_BENCHMARK: %s %d byte(s): %d AT command(s)"
+                    " %d ms, prompt wait %d ms, UART TX %d ms, %d URC(s)"
+                    " %d ms, echo arrival %d ms.\n", pName, pResult->sizeBytes,
+                    pResult->timing.num_commands,
+                    (int32_t) pResult->timing.command_ms,
+                    (int32_t) pResult->timing.prompt_wait_ms,
+                    (int32_t) pResult->timing.tx_ms,
+                    pResult->timing.num_urcs,
+                    (int32_t) pResult->timing.urc_ms,
+                    (int32_t) pResult->arrivalMs);
+    printMetrics(pName, pResult, bytesPerSecond);
+}
+
+// Bring up the module, connect to the network, look up
+// the echo server and create a socket.
+static CellularSockDescriptor_t benchmarkInit(const char *pRemoteDomainName,
+                                              int32_t remotePort,
+                                              CellularSockAddress_t *pRemoteAddress,
+                                              CellularSockType_t type,
+                                              CellularSockProtocol_t protocol)
+{
+    CellularSockDescriptor_t sockDescriptor;
+
+    cellularSockDeinit();
+
+    CELLULAR_PORT_TEST_ASSERT(cellularPortInit() == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartInit(CELLULAR_CFG_PIN_TXD,
+                                                   CELLULAR_CFG_PIN_RXD,
+                                                   CELLULAR_CFG_PIN_CTS,
+                                                   CELLULAR_CFG_PIN_RTS,
+                                                   CELLULAR_CFG_BAUD_RATE,
+                                                   CELLULAR_CFG_RTS_THRESHOLD,
+                                                   CELLULAR_CFG_UART,
+                                                   &gUartQueueHandle) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlInit(CELLULAR_CFG_PIN_ENABLE_POWER,
+                                               CELLULAR_CFG_PIN_PWR_ON,
+                                               CELLULAR_CFG_PIN_VINT,
+                                               false,
+                                               CELLULAR_CFG_UART,
+                                               gUartQueueHandle) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlPowerOn(NULL) == 0);
+
+    // Use whatever RAT and bands the module is already
+    // set up for: the sockets tests are the place
+    // where those are exercised
+    cellularPortLog("CELLULAR_SOCK_BENCHMARK: connecting...\n");
+    gStopTimeMs = cellularPortGetTickTimeMs() + (CELLULAR_CFG_TEST_CONNECT_TIMEOUT_SECONDS * 1000);
+    CELLULAR_PORT_TEST_ASSERT(cellularCtrlConnect(keepGoingCallback,
+                                                  CELLULAR_CFG_TEST_APN,
+                                                  CELLULAR_CFG_TEST_USERNAME,
+                                                  CELLULAR_CFG_TEST_PASSWORD) == 0);
+
+    CELLULAR_PORT_TEST_ASSERT(cellularSockGetHostByName(pRemoteDomainName,
+                                                        &(pRemoteAddress->ipAddress)) == 0);
+    pRemoteAddress->port = remotePort;
+
+    sockDescriptor = cellularSockCreate(type, protocol);
+    CELLULAR_PORT_TEST_ASSERT(sockDescriptor >= 0);
+
+    // Malloc the data buffers and fill the send buffer with
+    // something that isn't all the same
+    gpSendData = (char *) pCellularPort_malloc(CELLULAR_SOCK_BENCHMARK_MAX_TCP_READ_WRITE_SIZE);
+    CELLULAR_PORT_TEST_ASSERT(gpSendData != NULL);
+    gpReceiveData = (char *) pCellularPort_malloc(CELLULAR_SOCK_BENCHMARK_MAX_TCP_READ_WRITE_SIZE);
+    CELLULAR_PORT_TEST_ASSERT(gpReceiveData != NULL);
+    for (size_t x = 0; x < CELLULAR_SOCK_BENCHMARK_MAX_TCP_READ_WRITE_SIZE; x++) {
+        *(gpSendData + x) = (char) ('0' + (x % 64));
+    }
+
+    return sockDescriptor;
+}
+
+// Tidy up after a benchmark.
+static void benchmarkDeinit(CellularSockDescriptor_t sockDescriptor)
+{
+    cellularPort_free(gpReceiveData);
+    gpReceiveData = NULL;
+    cellularPort_free(gpSendData);
+    gpSendData = NULL;
+
+    CELLULAR_PORT_TEST_ASSERT(cellularSockClose(sockDescriptor) >= 0);
+    cellularSockCleanUp();
+
+    cellularCtrlDisconnect();
+    cellularCtrlPowerOff(NULL);
+    cellularCtrlDeinit();
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartDeinit(CELLULAR_CFG_UART) == 0);
+    cellularPortDeinit();
+}
+
+// Write sizeBytes of TCP data and read the echo back,
+// returning true if it all came back intact.
+static bool tcpEcho(CellularSockDescriptor_t sockDescriptor,
+                    int32_t sizeBytes,
+                    CellularSockBenchmarkResult_t *pResult)
+{
+    int32_t x;
+    int32_t offset = 0;
+    int64_t startTimeMs;
+    int64_t sentTimeMs;
+    bool arrived = false;
+
+    startTimeMs = cellularPortGetTickTimeMs();
+    while ((offset < sizeBytes) &&
+           (cellularPortGetTickTimeMs() - startTimeMs < CELLULAR_SOCK_BENCHMARK_ECHO_TIMEOUT_MS)) {
+        x = cellularSockWrite(sockDescriptor, gpSendData + offset,
+                              sizeBytes - offset);
+        if (x > 0) {
+            offset += x;
+        }
+    }
+    sentTimeMs = cellularPortGetTickTimeMs();
+
+    offset = 0;
+    while ((offset < sizeBytes) &&
+           (cellularPortGetTickTimeMs() - sentTimeMs < CELLULAR_SOCK_BENCHMARK_ECHO_TIMEOUT_MS)) {
+        x = cellularSockRead(sockDescriptor, gpReceiveData + offset,
+                             sizeBytes - offset);
+        if (x > 0) {
+            if (!arrived) {
+                pResult->arrivalMs += cellularPortGetTickTimeMs() - sentTimeMs;
+                arrived = true;
+            }
+            offset += x;
+        }
+    }
+
+    pResult->roundTripMs[pResult->count] = (int32_t) (cellularPortGetTickTimeMs() -
+                                                      startTimeMs);
+
+    return (offset == sizeBytes) &&
+           (cellularPort_memcmp(gpSendData, gpReceiveData, sizeBytes) == 0);
+}
+
+// Send a UDP packet of sizeBytes and receive the echo back,
+// returning true if it came back intact.
+static bool udpEcho(CellularSockDescriptor_t sockDescriptor,
+                    const CellularSockAddress_t *pRemoteAddress,
+                    int32_t sizeBytes,
+                    CellularSockBenchmarkResult_t *pResult)
+{
+    CellularSockAddress_t address;
+    int32_t x = -1;
+    int64_t startTimeMs;
+    int64_t sentTimeMs;
+
+    startTimeMs = cellularPortGetTickTimeMs();
+    if (cellularSockSendTo(sockDescriptor, pRemoteAddress,
+                           gpSendData, sizeBytes) == sizeBytes) {
+        sentTimeMs = cellularPortGetTickTimeMs();
+        x = cellularSockReceiveFrom(sockDescriptor, &address,
+                                    gpReceiveData, sizeBytes);
+        if (x > 0) {
+            pResult->arrivalMs += cellularPortGetTickTimeMs() - sentTimeMs;
+            pResult->roundTripMs[pResult->count] = (int32_t) (cellularPortGetTickTimeMs() -
+                                                              startTimeMs);
+        }
+    }
+
+    return (x == sizeBytes) &&
+           (cellularPort_memcmp(gpSendData, gpReceiveData, sizeBytes) == 0);
+}
+
+/* ----------------------------------------------------------------
+ * PUBLIC FUNCTIONS: BENCHMARKS
+ * -------------------------------------------------------------- */
+
+/** TCP write/read throughput over a sweep of sizes up to
+ * several segments.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularSockBenchmarkTcp(),
+                            "benchmarkSockTcp",
+                            "benchmark")
+{
+    CellularSockAddress_t remoteAddress;
+    CellularSockDescriptor_t sockDescriptor;
+    CellularSockBenchmarkResult_t result;
+    int64_t startTimeMs;
+
+    sockDescriptor = benchmarkInit(CELLULAR_CFG_TEST_ECHO_TCP_SERVER_DOMAIN_NAME,
+                                   CELLULAR_CFG_TEST_ECHO_TCP_SERVER_PORT,
+                                   &remoteAddress,
+                                   CELLULAR_SOCK_TYPE_STREAM,
+                                   CELLULAR_SOCK_PROTOCOL_TCP);
+    CELLULAR_PORT_TEST_ASSERT(cellularSockConnect(sockDescriptor,
+                                                  &remoteAddress) == 0);
+
+    for (int32_t sizeBytes = CELLULAR_SOCK_BENCHMARK_MIN_TCP_READ_WRITE_SIZE;
+         sizeBytes <= CELLULAR_SOCK_BENCHMARK_MAX_TCP_READ_WRITE_SIZE;
+         sizeBytes *= 2) {
+        pCellularPort_memset(&result, 0, sizeof(result));
+        result.sizeBytes = sizeBytes;
+        cellular_ctrl_at_timing_reset();
+        cellularPortMallocResetStats();
+        startTimeMs = cellularPortGetTickTimeMs();
+        for (size_t x = 0; x < CELLULAR_SOCK_BENCHMARK_ITERATIONS; x++) {
+            CELLULAR_PORT_TEST_ASSERT(tcpEcho(sockDescriptor, sizeBytes, &result));
+            result.count++;
+            // Both directions
+            result.totalBytes += sizeBytes * 2;
+        }
+        result.elapsedMs = cellularPortGetTickTimeMs() - startTimeMs;
+        cellular_ctrl_at_timing_get(&result.timing);
+        printResult("TCP", &result);
+    }
+
+    benchmarkDeinit(sockDescriptor);
+}
+
+/** UDP sendto/recvfrom throughput over a sweep of sizes;
+ * since datagrams may be lost in the internet a lost packet
+ * just doesn't count.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularSockBenchmarkUdp(),
+                            "benchmarkSockUdp",
+                            "benchmark")
+{
+    CellularSockAddress_t remoteAddress;
+    CellularSockDescriptor_t sockDescriptor;
+    CellularSockBenchmarkResult_t result;
+    int64_t startTimeMs;
+    int32_t sizeBytes = CELLULAR_SOCK_BENCHMARK_MIN_UDP_PACKET_SIZE;
+
+    sockDescriptor = benchmarkInit(CELLULAR_CFG_TEST_ECHO_UDP_SERVER_DOMAIN_NAME,
+                                   CELLULAR_CFG_TEST_ECHO_UDP_SERVER_PORT,
+                                   &remoteAddress,
+                                   CELLULAR_SOCK_TYPE_DGRAM,
+                                   CELLULAR_SOCK_PROTOCOL_UDP);
+
+    while (sizeBytes > 0) {
+        pCellularPort_memset(&result, 0, sizeof(result));
+        result.sizeBytes = sizeBytes;
+        cellular_ctrl_at_timing_reset();
+        cellularPortMallocResetStats();
+        startTimeMs = cellularPortGetTickTimeMs();
+        for (size_t x = 0; x < CELLULAR_SOCK_BENCHMARK_ITERATIONS; x++) {
+            if (udpEcho(sockDescriptor, &remoteAddress, sizeBytes, &result)) {
+                result.count++;
+                result.totalBytes += sizeBytes * 2;
+            }
+        }
+        result.elapsedMs = cellularPortGetTickTimeMs() - startTimeMs;
+        cellular_ctrl_at_timing_get(&result.timing);
+        printResult("UDP", &result);
+        // There should be at least something
+        CELLULAR_PORT_TEST_ASSERT(result.count > 0);
+
+        // Double up to the maximum, finishing with the maximum
+        if (sizeBytes == CELLULAR_SOCK_BENCHMARK_MAX_UDP_PACKET_SIZE) {
+            sizeBytes = 0;
+        } else {
+            sizeBytes *= 2;
+            if (sizeBytes > CELLULAR_SOCK_BENCHMARK_MAX_UDP_PACKET_SIZE) {
+                sizeBytes = CELLULAR_SOCK_BENCHMARK_MAX_UDP_PACKET_SIZE;
+            }
+        }
+    }
+
+    benchmarkDeinit(sockDescriptor);
+}
+
+#endif // CELLULAR_CFG_TEST_BENCHMARK
+
+// End of file
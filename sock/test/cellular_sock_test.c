@@ -69,6 +69,10 @@
 // Margin on timers.
 #define CELLULAR_SOCK_TEST_TIME_MARGIN_MS 100
 
+// The receive timeout to use when testing that a blocked
+// receive on one socket doesn't hold up the others.
+#define CELLULAR_SOCK_TEST_BLOCKED_RECEIVE_TIMEOUT_MS 5000
+
 /* ----------------------------------------------------------------
  * TYPES
  * -------------------------------------------------------------- */
@@ -249,6 +253,17 @@ static CellularPortMutexHandle_t gMutexHandleDataReceivedTaskRunning = NULL;
 // Task to receive data.
 static CellularPortTaskHandle_t gTaskHandleDataReceived = NULL;
 
+// Result of an asynchronous DNS look-up, -1 until it completes.
+static volatile int32_t gDnsErrorCode = -1;
+
+// IP address from an asynchronous DNS look-up.
+static CellularSockIpAddress_t gDnsIpAddress;
+
+// The datagrams of the batch test, the whole of gSendData
+// chopped up into pieces of at least 32 bytes plus an invalid
+// one at the end: too big for the stack of the test task.
+static CellularSockDatagram_t gDatagrams[(sizeof(gSendData) / 32) + 2];
+
 /* ----------------------------------------------------------------
  * STATIC FUNCTIONS: SOCKET OPTIONS RELATED
  * These functions are not marked as static as they are only used
@@ -366,6 +381,8 @@ static CellularSockTestOption_t gSupportedOptions[] = {
     {CELLULAR_SOCK_OPT_LEVEL_SOCK, CELLULAR_SOCK_OPT_LINGER,       sizeof(CellularSockLinger_t), compareLinger,  changeLinger},
 # endif
 #endif
+    {CELLULAR_SOCK_OPT_LEVEL_SOCK, CELLULAR_SOCK_OPT_SNDBUF,       sizeof(int32_t),              compareInt32,   changeInt32Positive},
+    {CELLULAR_SOCK_OPT_LEVEL_SOCK, CELLULAR_SOCK_OPT_RCVBUF,       sizeof(int32_t),              compareInt32,   changeInt32Positive},
     {CELLULAR_SOCK_OPT_LEVEL_SOCK, CELLULAR_SOCK_OPT_RCVTIMEO,     sizeof(CellularPort_timeval), compareTimeval, changeTimevalMs},
     {CELLULAR_SOCK_OPT_LEVEL_IP,   CELLULAR_SOCK_OPT_IP_TOS,       sizeof(int32_t),              compareInt32,   changeMod256},
     {CELLULAR_SOCK_OPT_LEVEL_IP,   CELLULAR_SOCK_OPT_IP_TTL,       sizeof(int32_t),              compareInt32,   changeMod256NonZero},
@@ -688,7 +705,7 @@ static bool checkAgainstSentData(const char *pDataSent, size_t dataSentSizeBytes
         } else {
             // If they were all the same, check for overrun and underrun
             for (x = 0; x < CELLULAR_SOCK_TEST_GUARD_LENGTH_SIZE_BYTES; x++) {
-                if (*(pDataReceived + x) != CELLULAR_SOCK_TEST_FILL_CHARACTER) {
+                if (*(pDataReceived + x) != (char) CELLULAR_SOCK_TEST_FILL_CHARACTER) {
                     cellularPortLog("CELLULAR_SOCK_TEST: guard area %d byte(s) before start"
                                     " of buffer has been overwritten (expected 0x%02x,"
                                     " got 0x%02x %d '%c').\n",
@@ -700,7 +717,7 @@ static bool checkAgainstSentData(const char *pDataSent, size_t dataSentSizeBytes
                     success = false;
                 }
                 if (*(pDataReceived + CELLULAR_SOCK_TEST_GUARD_LENGTH_SIZE_BYTES +
-                      dataSentSizeBytes + x) != CELLULAR_SOCK_TEST_FILL_CHARACTER) {
+                      dataSentSizeBytes + x) != (char) CELLULAR_SOCK_TEST_FILL_CHARACTER) {
                     cellularPortLog("CELLULAR_SOCK_TEST: guard area %d byte(s) after end of"
                                      " buffer has been overwritten (expected 0x%02x, got"
                                      " 0x%02x %d '%c').\n",
@@ -775,10 +792,10 @@ static void doUdpEchoBasic(CellularSockDescriptor_t sockDescriptor,
                                                               CELLULAR_SOCK_TEST_GUARD_LENGTH_SIZE_BYTES,
                                                               sendSizeBytes) == 0);
                 for (size_t x = 0; x < CELLULAR_SOCK_TEST_GUARD_LENGTH_SIZE_BYTES; x++) {
-                    CELLULAR_PORT_TEST_ASSERT(*(pDataReceived + x) == CELLULAR_SOCK_TEST_FILL_CHARACTER);
+                    CELLULAR_PORT_TEST_ASSERT(*(pDataReceived + x) == (char) CELLULAR_SOCK_TEST_FILL_CHARACTER);
                     CELLULAR_PORT_TEST_ASSERT(*(pDataReceived +
                                                 CELLULAR_SOCK_TEST_GUARD_LENGTH_SIZE_BYTES +
-                                                sendSizeBytes + x) == CELLULAR_SOCK_TEST_FILL_CHARACTER);
+                                                sendSizeBytes + x) == (char) CELLULAR_SOCK_TEST_FILL_CHARACTER);
                 }
                 if (pRemoteAddress != NULL) {
                     addressAssert(pRemoteAddress, &senderAddress, true);
@@ -893,6 +910,23 @@ static int32_t sendTcp(CellularSockDescriptor_t sockDescriptor,
     return sentSizeBytes;
 }
 
+// Task to do a blocking read on a TCP socket which has nothing
+// to read, sending the return value to gQueueHandleDataReceived.
+static void blockedReceiveTaskTcp(void *pParameters)
+{
+    char buffer[1];
+    int32_t sizeBytes;
+
+    sizeBytes = cellularSockRead(*((CellularSockDescriptor_t *) pParameters),
+                                 buffer, sizeof(buffer));
+    cellularPortLog("CELLULAR_SOCK_TEST: blocked read returned %d @%d ms.\n",
+                    sizeBytes, (int32_t) cellularPortGetTickTimeMs());
+    cellularPortQueueSend(gQueueHandleDataReceived, &sizeBytes);
+
+    // Delete ourself: only valid way out in Free RTOS
+    cellularPortTaskDelete(NULL);
+}
+
 // Task to send and receive TCP packets asynchronously
 // checking for everything being present and correct.
 static void echoDataTaskTcp(void *pParameters)
@@ -1069,6 +1103,21 @@ static void setBool(void *pParam)
     }
 }
 
+// Callback for an asynchronous DNS look-up.
+static void dnsCallback(const char *pHostName, int32_t errorCode,
+                        const CellularSockIpAddress_t *pHostIpAddress,
+                        void *pParam)
+{
+    (void) pHostName;
+    (void) pParam;
+
+    if (pHostIpAddress != NULL) {
+        pCellularPort_memcpy(&gDnsIpAddress, pHostIpAddress,
+                             sizeof(gDnsIpAddress));
+    }
+    gDnsErrorCode = errorCode;
+}
+
 // Check getting an option.
 static void checkGetOption(CellularSockDescriptor_t sockDescriptor,
                            int32_t level,
@@ -1427,6 +1476,105 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularSockTestUdpEchoBasic(),
     stdDataTestDeinit(sockDescriptor);
 }
 
+/** Test select(): time-out, unblocking on write and on
+ * data arrival and the bad descriptor case.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularSockTestSelect(),
+                            "sockSelect",
+                            "sock")
+{
+    CellularSockAddress_t remoteAddress;
+    CellularSockDescriptor_t sockDescriptor;
+    CellularSockDescriptorSet_t readSet;
+    CellularSockDescriptorSet_t writeSet;
+    char *pDataReceived;
+    int32_t errorCode = 0;
+    int64_t startTimeMs;
+    int32_t timeMs;
+
+    // Call clean up to release OS resources that may
+    // have been left hanging by a previous failed test
+    osCleanup();
+
+    stdDataTestInit(CELLULAR_CFG_TEST_ECHO_UDP_SERVER_DOMAIN_NAME,
+                    CELLULAR_CFG_TEST_ECHO_UDP_SERVER_PORT,
+                    &remoteAddress,
+                    CELLULAR_SOCK_TYPE_DGRAM,
+                    CELLULAR_SOCK_PROTOCOL_UDP,
+                    &sockDescriptor);
+
+    pDataReceived = (char *) pCellularPort_malloc(CELLULAR_SOCK_TEST_MAX_UDP_PACKET_SIZE);
+    CELLULAR_PORT_TEST_ASSERT(pDataReceived != NULL);
+
+    cellularPortLog("CELLULAR_SOCK_TEST: a UDP socket should be writable...\n");
+    CELLULAR_SOCK_FD_ZERO(&writeSet);
+    CELLULAR_SOCK_FD_SET(sockDescriptor, &writeSet);
+    errorCode = cellularSockSelect(sockDescriptor + 1, NULL, &writeSet,
+                                   NULL, 0);
+    cellularPortLog("CELLULAR_SOCK_TEST: cellularSockSelect() returned %d.\n",
+                    errorCode);
+    CELLULAR_PORT_TEST_ASSERT(errorCode == 1);
+    CELLULAR_PORT_TEST_ASSERT(CELLULAR_SOCK_FD_ISSET(sockDescriptor, &writeSet));
+
+    cellularPortLog("CELLULAR_SOCK_TEST: nothing has been sent so select() for"
+                    " read should time out...\n");
+    CELLULAR_SOCK_FD_ZERO(&readSet);
+    CELLULAR_SOCK_FD_SET(sockDescriptor, &readSet);
+    startTimeMs = cellularPortGetTickTimeMs();
+    errorCode = cellularSockSelect(sockDescriptor + 1, &readSet, NULL,
+                                   NULL, 1000);
+    timeMs = (int32_t) (cellularPortGetTickTimeMs() - startTimeMs);
+    cellularPortLog("CELLULAR_SOCK_TEST: cellularSockSelect() returned %d after %d ms.\n",
+                    errorCode, timeMs);
+    CELLULAR_PORT_TEST_ASSERT(errorCode == 0);
+    CELLULAR_PORT_TEST_ASSERT(timeMs > 1000 - CELLULAR_SOCK_TEST_TIME_MARGIN_MS);
+    CELLULAR_PORT_TEST_ASSERT(timeMs < 1000 + CELLULAR_SOCK_TEST_TIME_MARGIN_MS);
+    CELLULAR_PORT_TEST_ASSERT(!CELLULAR_SOCK_FD_ISSET(sockDescriptor, &readSet));
+
+    // Retry this a few times, don't want to fail due to a flaky link
+    errorCode = 0;
+    for (size_t x = 0; (errorCode <= 0) && (x < CELLULAR_CFG_TEST_UDP_RETRIES); x++) {
+        cellularPortLog("CELLULAR_SOCK_TEST: sending a UDP packet and waiting in"
+                        " select() for the echo, try %d.\n", x + 1);
+        CELLULAR_PORT_TEST_ASSERT(cellularSockSendTo(sockDescriptor, &remoteAddress,
+                                                     (void *) gSendData,
+                                                     CELLULAR_SOCK_TEST_MAX_UDP_PACKET_SIZE) ==
+                                  CELLULAR_SOCK_TEST_MAX_UDP_PACKET_SIZE);
+        CELLULAR_SOCK_FD_ZERO(&readSet);
+        CELLULAR_SOCK_FD_SET(sockDescriptor, &readSet);
+        startTimeMs = cellularPortGetTickTimeMs();
+        errorCode = cellularSockSelect(sockDescriptor + 1, &readSet, NULL,
+                                       NULL, 10000);
+        timeMs = (int32_t) (cellularPortGetTickTimeMs() - startTimeMs);
+        cellularPortLog("CELLULAR_SOCK_TEST: cellularSockSelect() returned %d after %d ms.\n",
+                        errorCode, timeMs);
+        CELLULAR_PORT_TEST_ASSERT(errorCode >= 0);
+    }
+    CELLULAR_PORT_TEST_ASSERT(errorCode == 1);
+    CELLULAR_PORT_TEST_ASSERT(CELLULAR_SOCK_FD_ISSET(sockDescriptor, &readSet));
+    // The data should now be there without waiting
+    CELLULAR_PORT_TEST_ASSERT(cellularSockReceiveFrom(sockDescriptor, NULL,
+                                                      pDataReceived,
+                                                      CELLULAR_SOCK_TEST_MAX_UDP_PACKET_SIZE) ==
+                              CELLULAR_SOCK_TEST_MAX_UDP_PACKET_SIZE);
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_memcmp(pDataReceived, gSendData,
+                                                  CELLULAR_SOCK_TEST_MAX_UDP_PACKET_SIZE) == 0);
+
+    cellularPortLog("CELLULAR_SOCK_TEST: select() on a descriptor that isn't"
+                    " open should fail...\n");
+    CELLULAR_SOCK_FD_ZERO(&readSet);
+    CELLULAR_SOCK_FD_SET((sockDescriptor + 1) % CELLULAR_SOCK_DESCRIPTOR_SETSIZE,
+                         &readSet);
+    CELLULAR_PORT_TEST_ASSERT(cellularSockSelect(CELLULAR_SOCK_DESCRIPTOR_SETSIZE,
+                                                 &readSet, NULL, NULL, 0) < 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_errno_get() == CELLULAR_SOCK_EBADF);
+    cellularPort_errno_set(0);
+
+    cellularPort_free(pDataReceived);
+
+    stdDataTestDeinit(sockDescriptor);
+}
+
 /** Basic TCP echo test.
  * TODO: test error cases.
  */
@@ -1444,6 +1592,8 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularSockTestTcpEchoBasic(),
     int32_t x;
     char *pDataReceived;
     int64_t startTimeMs;
+    CellularSockIovec_t iov[3];
+    CellularSockStats_t stats;
 
     // Call clean up to release OS resources that may
     // have been left hanging by a previous failed test
@@ -1549,6 +1699,56 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularSockTestTcpEchoBasic(),
     CELLULAR_PORT_TEST_ASSERT(checkAgainstSentData(gSendData, sizeof(gSendData) - 1,
                                                    pDataReceived, sizeBytes));
 
+    cellularPortLog("CELLULAR_SOCK_TEST: sending the same data again from three"
+                    " buffers with cellularSockWriteV()...\n");
+    iov[0].iov_base = (void *) gSendData;
+    iov[0].iov_len = 5;
+    iov[1].iov_base = (void *) (gSendData + iov[0].iov_len);
+    iov[1].iov_len = CELLULAR_SOCK_MAX_SEGMENT_LENGTH_BYTES;
+    iov[2].iov_base = (void *) (gSendData + iov[0].iov_len + iov[1].iov_len);
+    iov[2].iov_len = sizeof(gSendData) - 1 - iov[0].iov_len - iov[1].iov_len;
+    CELLULAR_PORT_TEST_ASSERT(cellularSockWriteV(sockDescriptor, iov,
+                                                 sizeof(iov) / sizeof(iov[0])) ==
+                              sizeof(gSendData) - 1);
+    pCellularPort_memset(pDataReceived,
+                        CELLULAR_SOCK_TEST_FILL_CHARACTER,
+                        sizeof(gSendData) - 1 + (CELLULAR_SOCK_TEST_GUARD_LENGTH_SIZE_BYTES * 2));
+    startTimeMs = cellularPortGetTickTimeMs();
+    offset = 0;
+    while ((offset < sizeof(gSendData) - 1) &&
+           (cellularPortGetTickTimeMs() - startTimeMs < 20000)) {
+        x = cellularSockRead(sockDescriptor,
+                             pDataReceived + offset +
+                             CELLULAR_SOCK_TEST_GUARD_LENGTH_SIZE_BYTES,
+                             sizeof(gSendData) - 1 - offset);
+        if (x > 0) {
+            offset += x;
+        }
+    }
+    CELLULAR_PORT_TEST_ASSERT(checkAgainstSentData(gSendData, sizeof(gSendData) - 1,
+                                                   pDataReceived, offset));
+
+    cellularPortLog("CELLULAR_SOCK_TEST: checking the socket statistics...\n");
+    CELLULAR_PORT_TEST_ASSERT(cellularSockGetStats(sockDescriptor, NULL) < 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_errno_get() > 0);
+    cellularPort_errno_set(0);
+    CELLULAR_PORT_TEST_ASSERT(cellularSockGetStats(sockDescriptor, &stats) == 0);
+    cellularPortLog("CELLULAR_SOCK_TEST: %d byte(s) sent, %d byte(s) received,"
+                    " %d AT command(s), %d partial write(s), %d error(s),"
+                    " %d ms blocked, %d read(s) after a URC taking %d ms"
+                    " at most.\n", stats.bytesTx, stats.bytesRx,
+                    stats.numAtCommands, stats.numPartialWrites,
+                    stats.numErrors, (int32_t) stats.blockedMs,
+                    stats.numUrcReads, stats.urcToReadMaxMs);
+    CELLULAR_PORT_TEST_ASSERT(stats.bytesTx >= (sizeof(gSendData) - 1) * 2);
+    CELLULAR_PORT_TEST_ASSERT(stats.bytesRx >= (sizeof(gSendData) - 1) * 2);
+    CELLULAR_PORT_TEST_ASSERT(stats.numAtCommands > 0);
+    CELLULAR_PORT_TEST_ASSERT(stats.urcToReadTotalMs >= 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularSockResetStats(sockDescriptor) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularSockGetStats(sockDescriptor, &stats) == 0);
+    CELLULAR_PORT_TEST_ASSERT((stats.bytesTx == 0) && (stats.bytesRx == 0) &&
+                              (stats.numAtCommands == 0));
+
     cellularPortLog("CELLULAR_SOCK_TEST: shutting down socket for read...\n");
     errorCode = cellularSockShutdown(sockDescriptor,
                                      CELLULAR_SOCK_SHUTDOWN_READ);
@@ -1580,6 +1780,266 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularSockTestTcpEchoBasic(),
     stdDataTestDeinit(sockDescriptor);
 }
 
+/** TCP echo test with a read-ahead buffer and a send buffer, using
+ * lots of small reads and writes of the kind a TLS or MQTT stack
+ * would perform.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularSockTestTcpEchoBuffered(),
+                            "sockTcpEchoBuffered",
+                            "sock")
+{
+    CellularSockAddress_t remoteAddress;
+    CellularSockDescriptor_t sockDescriptor;
+    int32_t bufferSizeBytes = CELLULAR_SOCK_MAX_SEGMENT_LENGTH_BYTES;
+    int32_t value;
+    size_t length;
+    size_t sizeBytes;
+    size_t offset;
+    size_t count = 0;
+    int32_t x;
+    char *pDataReceived;
+    int64_t startTimeMs;
+
+    // Call clean up to release OS resources that may
+    // have been left hanging by a previous failed test
+    osCleanup();
+
+    stdDataTestInit(CELLULAR_CFG_TEST_ECHO_TCP_SERVER_DOMAIN_NAME,
+                    CELLULAR_CFG_TEST_ECHO_TCP_SERVER_PORT,
+                    &remoteAddress,
+                    CELLULAR_SOCK_TYPE_STREAM,
+                    CELLULAR_SOCK_PROTOCOL_TCP,
+                    &sockDescriptor);
+
+    cellularPortLog("CELLULAR_SOCK_TEST: setting send and receive buffers of"
+                    " %d byte(s)...\n", bufferSizeBytes);
+    CELLULAR_PORT_TEST_ASSERT(cellularSockSetOption(sockDescriptor,
+                                                    CELLULAR_SOCK_OPT_LEVEL_SOCK,
+                                                    CELLULAR_SOCK_OPT_SNDBUF,
+                                                    (void *) &bufferSizeBytes,
+                                                    sizeof(bufferSizeBytes)) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularSockSetOption(sockDescriptor,
+                                                    CELLULAR_SOCK_OPT_LEVEL_SOCK,
+                                                    CELLULAR_SOCK_OPT_RCVBUF,
+                                                    (void *) &bufferSizeBytes,
+                                                    sizeof(bufferSizeBytes)) == 0);
+    length = sizeof(value);
+    CELLULAR_PORT_TEST_ASSERT(cellularSockGetOption(sockDescriptor,
+                                                    CELLULAR_SOCK_OPT_LEVEL_SOCK,
+                                                    CELLULAR_SOCK_OPT_RCVBUF,
+                                                    (void *) &value,
+                                                    &length) == 0);
+    CELLULAR_PORT_TEST_ASSERT(value == bufferSizeBytes);
+
+    cellularPortLog("CELLULAR_SOCK_TEST: connect socket to \"%s:%d\"...\n",
+                    CELLULAR_CFG_TEST_ECHO_TCP_SERVER_DOMAIN_NAME,
+                    CELLULAR_CFG_TEST_ECHO_TCP_SERVER_PORT);
+    CELLULAR_PORT_TEST_ASSERT(cellularSockConnect(sockDescriptor,
+                                                  &remoteAddress) == 0);
+
+    // Write the data in small pieces, which should be
+    // coalesced in the send buffer
+    startTimeMs = cellularPortGetTickTimeMs();
+    offset = 0;
+    while ((offset < sizeof(gSendData) - 1) &&
+           (cellularPortGetTickTimeMs() - startTimeMs < 20000)) {
+        sizeBytes = (cellularPort_rand() % 32) + 1;
+        if (offset + sizeBytes > sizeof(gSendData) - 1) {
+            sizeBytes = sizeof(gSendData) - 1 - offset;
+        }
+        x = cellularSockWrite(sockDescriptor, gSendData + offset, sizeBytes);
+        if (x > 0) {
+            offset += x;
+        }
+    }
+    cellularPortLog("CELLULAR_SOCK_TEST: %d byte(s) written in %d ms.\n",
+                    offset, (int32_t) (cellularPortGetTickTimeMs() - startTimeMs));
+    CELLULAR_PORT_TEST_ASSERT(offset == sizeof(gSendData) - 1);
+
+    // Read it back in small pieces, the first read
+    // flushing the remains of the send buffer
+    pDataReceived = (char *) pCellularPort_malloc(sizeof(gSendData) - 1 +
+                                                  (CELLULAR_SOCK_TEST_GUARD_LENGTH_SIZE_BYTES * 2));
+    CELLULAR_PORT_TEST_ASSERT(pDataReceived != NULL);
+    pCellularPort_memset(pDataReceived,
+                        CELLULAR_SOCK_TEST_FILL_CHARACTER,
+                        sizeof(gSendData) - 1 + (CELLULAR_SOCK_TEST_GUARD_LENGTH_SIZE_BYTES * 2));
+    startTimeMs = cellularPortGetTickTimeMs();
+    offset = 0;
+    while ((offset < sizeof(gSendData) - 1) &&
+           (cellularPortGetTickTimeMs() - startTimeMs < 20000)) {
+        // Alternate a five byte "header" with a random "body"
+        sizeBytes = 5;
+        if ((count % 2) != 0) {
+            sizeBytes = (cellularPort_rand() % 64) + 1;
+        }
+        count++;
+        if (offset + sizeBytes > sizeof(gSendData) - 1) {
+            sizeBytes = sizeof(gSendData) - 1 - offset;
+        }
+        x = cellularSockRead(sockDescriptor,
+                             pDataReceived + offset +
+                             CELLULAR_SOCK_TEST_GUARD_LENGTH_SIZE_BYTES,
+                             sizeBytes);
+        if (x > 0) {
+            offset += x;
+        }
+    }
+    cellularPortLog("CELLULAR_SOCK_TEST: %d byte(s) read back in %d ms.\n",
+                    offset, (int32_t) (cellularPortGetTickTimeMs() - startTimeMs));
+
+    // Check that we reassembled everything correctly
+    CELLULAR_PORT_TEST_ASSERT(checkAgainstSentData(gSendData, sizeof(gSendData) - 1,
+                                                   pDataReceived, offset));
+
+    cellularPort_free(pDataReceived);
+
+    stdDataTestDeinit(sockDescriptor);
+}
+
+/** Test TCP echo in direct-link mode.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularSockTestTcpEchoDirectLink(),
+                            "sockTcpEchoDirectLink",
+                            "sock")
+{
+    CellularSockAddress_t remoteAddress;
+    CellularSockDescriptor_t sockDescriptor;
+    size_t offset;
+    int32_t x;
+    char *pDataReceived;
+    int64_t startTimeMs;
+
+    // Call clean up to release OS resources that may
+    // have been left hanging by a previous failed test
+    osCleanup();
+
+    stdDataTestInit(CELLULAR_CFG_TEST_ECHO_TCP_SERVER_DOMAIN_NAME,
+                    CELLULAR_CFG_TEST_ECHO_TCP_SERVER_PORT,
+                    &remoteAddress,
+                    CELLULAR_SOCK_TYPE_STREAM,
+                    CELLULAR_SOCK_PROTOCOL_TCP,
+                    &sockDescriptor);
+
+    // Direct-link mode is not possible until connected
+    CELLULAR_PORT_TEST_ASSERT(cellularSockSetDirectLink(sockDescriptor, true) < 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_errno_get() == CELLULAR_SOCK_ENOTCONN);
+    cellularPort_errno_set(0);
+
+    cellularPortLog("CELLULAR_SOCK_TEST: connect socket to \"%s:%d\"...\n",
+                    CELLULAR_CFG_TEST_ECHO_TCP_SERVER_DOMAIN_NAME,
+                    CELLULAR_CFG_TEST_ECHO_TCP_SERVER_PORT);
+    CELLULAR_PORT_TEST_ASSERT(cellularSockConnect(sockDescriptor,
+                                                  &remoteAddress) == 0);
+
+    cellularPortLog("CELLULAR_SOCK_TEST: entering direct-link mode...\n");
+    CELLULAR_PORT_TEST_ASSERT(cellularSockSetDirectLink(sockDescriptor, true) == 0);
+
+    // Write the lot in one go
+    startTimeMs = cellularPortGetTickTimeMs();
+    CELLULAR_PORT_TEST_ASSERT(cellularSockWrite(sockDescriptor, gSendData,
+                                                sizeof(gSendData) - 1) == sizeof(gSendData) - 1);
+    cellularPortLog("CELLULAR_SOCK_TEST: %d byte(s) written in %d ms.\n",
+                    sizeof(gSendData) - 1,
+                    (int32_t) (cellularPortGetTickTimeMs() - startTimeMs));
+
+    // Read it back
+    pDataReceived = (char *) pCellularPort_malloc(sizeof(gSendData) - 1 +
+                                                  (CELLULAR_SOCK_TEST_GUARD_LENGTH_SIZE_BYTES * 2));
+    CELLULAR_PORT_TEST_ASSERT(pDataReceived != NULL);
+    pCellularPort_memset(pDataReceived,
+                        CELLULAR_SOCK_TEST_FILL_CHARACTER,
+                        sizeof(gSendData) - 1 + (CELLULAR_SOCK_TEST_GUARD_LENGTH_SIZE_BYTES * 2));
+    startTimeMs = cellularPortGetTickTimeMs();
+    offset = 0;
+    while ((offset < sizeof(gSendData) - 1) &&
+           (cellularPortGetTickTimeMs() - startTimeMs < 20000)) {
+        x = cellularSockRead(sockDescriptor,
+                             pDataReceived + offset +
+                             CELLULAR_SOCK_TEST_GUARD_LENGTH_SIZE_BYTES,
+                             sizeof(gSendData) - 1 - offset);
+        if (x > 0) {
+            offset += x;
+        }
+    }
+    cellularPortLog("CELLULAR_SOCK_TEST: %d byte(s) read back in %d ms.\n",
+                    offset, (int32_t) (cellularPortGetTickTimeMs() - startTimeMs));
+
+    // Check that we reassembled everything correctly
+    CELLULAR_PORT_TEST_ASSERT(checkAgainstSentData(gSendData, sizeof(gSendData) - 1,
+                                                   pDataReceived, offset));
+
+    cellularPort_free(pDataReceived);
+
+    cellularPortLog("CELLULAR_SOCK_TEST: leaving direct-link mode...\n");
+    CELLULAR_PORT_TEST_ASSERT(cellularSockSetDirectLink(sockDescriptor, false) == 0);
+
+    stdDataTestDeinit(sockDescriptor);
+}
+
+/** Test DNS look-ups, cached and asynchronous.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularSockTestGetHostByName(),
+                            "sockGetHostByName",
+                            "sock")
+{
+    CellularSockAddress_t remoteAddress;
+    CellularSockDescriptor_t sockDescriptor;
+    CellularSockIpAddress_t ipAddress;
+    int64_t startTimeMs;
+
+    // Call clean up to release OS resources that may
+    // have been left hanging by a previous failed test
+    osCleanup();
+
+    // This does the first look-up, which fills the cache
+    stdDataTestInit(CELLULAR_CFG_TEST_ECHO_UDP_SERVER_DOMAIN_NAME,
+                    CELLULAR_CFG_TEST_ECHO_UDP_SERVER_PORT,
+                    &remoteAddress,
+                    CELLULAR_SOCK_TYPE_DGRAM,
+                    CELLULAR_SOCK_PROTOCOL_UDP,
+                    &sockDescriptor);
+
+    cellularPortLog("CELLULAR_SOCK_TEST: looking up \"%s\" again...\n",
+                    CELLULAR_CFG_TEST_ECHO_UDP_SERVER_DOMAIN_NAME);
+    pCellularPort_memset(&ipAddress, 0, sizeof(ipAddress));
+    CELLULAR_PORT_TEST_ASSERT(cellularSockGetHostByName(CELLULAR_CFG_TEST_ECHO_UDP_SERVER_DOMAIN_NAME,
+                                                        &ipAddress) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_memcmp(&ipAddress, &(remoteAddress.ipAddress),
+                                                  sizeof(ipAddress)) == 0);
+
+    // From the cache the callback is called straight away
+    gDnsErrorCode = -1;
+    pCellularPort_memset(&gDnsIpAddress, 0, sizeof(gDnsIpAddress));
+    CELLULAR_PORT_TEST_ASSERT(cellularSockGetHostByNameAsync(CELLULAR_CFG_TEST_ECHO_UDP_SERVER_DOMAIN_NAME,
+                                                             dnsCallback, NULL) == 0);
+    CELLULAR_PORT_TEST_ASSERT(gDnsErrorCode == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_memcmp(&gDnsIpAddress, &(remoteAddress.ipAddress),
+                                                  sizeof(gDnsIpAddress)) == 0);
+
+    // Something not in the cache goes via the DNS task
+    cellularPortLog("CELLULAR_SOCK_TEST: looking up \"%s\" asynchronously...\n",
+                    CELLULAR_CFG_TEST_ECHO_TCP_SERVER_DOMAIN_NAME);
+    gDnsErrorCode = -1;
+    startTimeMs = cellularPortGetTickTimeMs();
+    CELLULAR_PORT_TEST_ASSERT(cellularSockGetHostByNameAsync(CELLULAR_CFG_TEST_ECHO_TCP_SERVER_DOMAIN_NAME,
+                                                             dnsCallback, NULL) == 0);
+    while ((gDnsErrorCode == -1) &&
+           (cellularPortGetTickTimeMs() - startTimeMs < 60000)) {
+        cellularPortTaskBlock(100);
+    }
+    cellularPortLog("CELLULAR_SOCK_TEST: callback gave %d after %d ms.\n",
+                    gDnsErrorCode,
+                    (int32_t) (cellularPortGetTickTimeMs() - startTimeMs));
+    CELLULAR_PORT_TEST_ASSERT(gDnsErrorCode == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularSockGetHostByName(CELLULAR_CFG_TEST_ECHO_TCP_SERVER_DOMAIN_NAME,
+                                                        &ipAddress) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_memcmp(&ipAddress, &gDnsIpAddress,
+                                                  sizeof(ipAddress)) == 0);
+
+    stdDataTestDeinit(sockDescriptor);
+}
+
 /** Test max num sockets.
  */
 CELLULAR_PORT_TEST_FUNCTION(void cellularSockTestMaxNumSockets(),
@@ -1787,6 +2247,23 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularSockTestSetGetOptions(),
                        gSupportedOptions[x].pComparer);
     }
 
+    // The module's TLS can be switched on, using the default
+    // settings of security profile 0, and off again before
+    // the socket is connected
+    length = sizeof(int32_t);
+    CELLULAR_PORT_TEST_ASSERT(cellularSockGetOption(sockDescriptor,
+                                                    CELLULAR_SOCK_OPT_LEVEL_SOCK,
+                                                    CELLULAR_SOCK_OPT_SECURE_PROFILE,
+                                                    pValue, &length) == 0);
+    CELLULAR_PORT_TEST_ASSERT(*((int32_t *) pValue) == -1);
+    for (int32_t x = 0; x >= -1; x--) {
+        *((int32_t *) pValue) = x;
+        checkSetOption(sockDescriptor,
+                       CELLULAR_SOCK_OPT_LEVEL_SOCK,
+                       CELLULAR_SOCK_OPT_SECURE_PROFILE,
+                       pValue, sizeof(int32_t), compareInt32);
+    }
+
     // Test that setting the socket receive timeout
     // option has an effect, since that is handled
     // locally in our driver code
@@ -2094,6 +2571,111 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularSockTestNonBlocking(),
     cellularPortDeinit();
 }
 
+/** Test non-blocking connect and close of a TCP socket.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularSockTestNonBlockingConnectClose(),
+                            "sockNonBlockingConnectClose",
+                            "sock")
+{
+    CellularSockAddress_t remoteAddress;
+    CellularSockDescriptor_t sockDescriptor;
+    CellularSockDescriptorSet_t writeSet;
+    int32_t returnCode;
+    int32_t value;
+    size_t length;
+    volatile bool connected = false;
+    int64_t startTime;
+    int64_t elapsedMs;
+
+    // Call clean up to release OS resources that may
+    // have been left hanging by a previous failed test
+    osCleanup();
+
+    stdDataTestInit(CELLULAR_CFG_TEST_ECHO_TCP_SERVER_DOMAIN_NAME,
+                    CELLULAR_CFG_TEST_ECHO_TCP_SERVER_PORT,
+                    &remoteAddress,
+                    CELLULAR_SOCK_TYPE_STREAM,
+                    CELLULAR_SOCK_PROTOCOL_TCP,
+                    &sockDescriptor);
+
+    value = 1;
+    CELLULAR_PORT_TEST_ASSERT(cellularSockIoctl(sockDescriptor,
+                                                CELLULAR_SOCK_IOCTL_SET_NONBLOCK,
+                                                &value) == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularSockRegisterCallbackConnected(sockDescriptor,
+                                                                    setBool,
+                                                                    (void *) &connected) == 0);
+
+    cellularPortLog("CELLULAR_SOCK_TEST: non-blocking connect of socket to \"%s:%d\"...\n",
+                    CELLULAR_CFG_TEST_ECHO_TCP_SERVER_DOMAIN_NAME,
+                    CELLULAR_CFG_TEST_ECHO_TCP_SERVER_PORT);
+    startTime = cellularPortGetTickTimeMs();
+    returnCode = cellularSockConnect(sockDescriptor, &remoteAddress);
+    elapsedMs = cellularPortGetTickTimeMs() - startTime;
+    cellularPortLog("CELLULAR_SOCK_TEST: cellularSockConnect() returned %d, errno %d,"
+                    " after %d millisecond(s).\n", returnCode,
+                    cellularPort_errno_get(), (int32_t) elapsedMs);
+#if CELLULAR_SOCK_ASYNC_CONNECT_IS_SUPPORTED
+    CELLULAR_PORT_TEST_ASSERT(returnCode < 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_errno_get() == CELLULAR_SOCK_EINPROGRESS);
+    cellularPort_errno_set(0);
+
+    cellularPortLog("CELLULAR_SOCK_TEST: waiting for the socket to become writable...\n");
+    CELLULAR_SOCK_FD_ZERO(&writeSet);
+    CELLULAR_SOCK_FD_SET(sockDescriptor, &writeSet);
+    returnCode = cellularSockSelect(sockDescriptor + 1, NULL, &writeSet, NULL,
+                                    CELLULAR_CFG_TEST_CONNECT_TIMEOUT_SECONDS * 1000);
+    cellularPortLog("CELLULAR_SOCK_TEST: cellularSockSelect() returned %d.\n",
+                    returnCode);
+    CELLULAR_PORT_TEST_ASSERT(returnCode == 1);
+    CELLULAR_PORT_TEST_ASSERT(CELLULAR_SOCK_FD_ISSET(sockDescriptor, &writeSet));
+    // The callback runs in a task of its own
+    startTime = cellularPortGetTickTimeMs();
+    while (!connected && (cellularPortGetTickTimeMs() - startTime < 1000)) {
+        cellularPortTaskBlock(10);
+    }
+    CELLULAR_PORT_TEST_ASSERT(connected);
+#else
+    (void) writeSet;
+    CELLULAR_PORT_TEST_ASSERT(returnCode == 0);
+    CELLULAR_PORT_TEST_ASSERT(!connected);
+#endif
+    value = -1;
+    length = sizeof(value);
+    CELLULAR_PORT_TEST_ASSERT(cellularSockGetOption(sockDescriptor,
+                                                    CELLULAR_SOCK_OPT_LEVEL_SOCK,
+                                                    CELLULAR_SOCK_OPT_ERROR,
+                                                    &value, &length) == 0);
+    CELLULAR_PORT_TEST_ASSERT(length == sizeof(value));
+    CELLULAR_PORT_TEST_ASSERT(value == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_errno_get() == 0);
+
+    cellularPortLog("CELLULAR_SOCK_TEST: closing socket...\n");
+    startTime = cellularPortGetTickTimeMs();
+    returnCode = cellularSockClose(sockDescriptor);
+    elapsedMs = cellularPortGetTickTimeMs() - startTime;
+    cellularPortLog("CELLULAR_SOCK_TEST: cellularSockClose() returned %d, errno %d,"
+                    " after %d millisecond(s).\n", returnCode,
+                    cellularPort_errno_get(), (int32_t) elapsedMs);
+    CELLULAR_PORT_TEST_ASSERT(returnCode == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_errno_get() == 0);
+    // A closed socket, or one that is closing, can't be connected
+    CELLULAR_PORT_TEST_ASSERT(cellularSockConnect(sockDescriptor, &remoteAddress) < 0);
+    cellularPort_errno_set(0);
+
+    cellularPortLog("CELLULAR_SOCK_TEST: cleaning up...\n");
+    cellularSockCleanUp();
+
+    // Disconnect from the cellular network and tidy up
+    networkDisconnect();
+
+    cellularCtrlPowerOff(NULL);
+
+    cellularCtrlDeinit();
+    CELLULAR_PORT_TEST_ASSERT(cellularPortUartDeinit(CELLULAR_CFG_UART) == 0);
+    cellularPortDeinit();
+}
+
 /** UDP echo test that throws up multiple packets
  * before addressing the received packets.
  * TODO: test error cases.
@@ -2203,6 +2785,105 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularSockTestUdpEchoNonPingPong(),
     stdDataTestDeinit(sockDescriptor);
 }
 
+/** UDP echo test that sends the datagrams as a batch.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularSockTestUdpEchoBatch(),
+                            "sockUdpEchoBatch",
+                            "sock")
+{
+    CellularSockAddress_t remoteAddress;
+    CellularSockDescriptor_t sockDescriptor;
+    bool allPacketsReceived;
+    int32_t tries = 0;
+    int32_t sizeBytes = 0;
+    size_t numDatagrams;
+    size_t offset;
+    int32_t x;
+    char *pDataReceived;
+    int64_t startTimeMs;
+
+    // Call clean up to release OS resources that may
+    // have been left hanging by a previous failed test
+    osCleanup();
+
+    stdDataTestInit(CELLULAR_CFG_TEST_ECHO_UDP_SERVER_DOMAIN_NAME,
+                    CELLULAR_CFG_TEST_ECHO_UDP_SERVER_PORT,
+                    &remoteAddress,
+                    CELLULAR_SOCK_TYPE_DGRAM,
+                    CELLULAR_SOCK_PROTOCOL_UDP,
+                    &sockDescriptor);
+
+    cellularPortLog("CELLULAR_SOCK_TEST: sending to address ");
+    printAddress(&remoteAddress, true);
+    cellularPortLog("...\n");
+
+    do {
+        // Reset errno 'cos we might retry and subsequent things might be upset by it
+        cellularPort_errno_set(0);
+        // Chop the data up into small datagrams, all to the
+        // same address, with an invalid one at the end
+        numDatagrams = 0;
+        offset = 0;
+        while (offset < sizeof(gSendData) - 1) {
+            sizeBytes = (cellularPort_rand() % 32) + 32;
+            if (offset + sizeBytes > sizeof(gSendData) - 1) {
+                sizeBytes = sizeof(gSendData) - 1 - offset;
+            }
+            gDatagrams[numDatagrams].pRemoteAddress = &remoteAddress;
+            gDatagrams[numDatagrams].pData = gSendData + offset;
+            gDatagrams[numDatagrams].dataSizeBytes = sizeBytes;
+            numDatagrams++;
+            offset += sizeBytes;
+        }
+        gDatagrams[numDatagrams].pRemoteAddress = &remoteAddress;
+        gDatagrams[numDatagrams].pData = NULL;
+        gDatagrams[numDatagrams].dataSizeBytes = 1;
+        numDatagrams++;
+
+        startTimeMs = cellularPortGetTickTimeMs();
+        x = cellularSockSendToBatch(sockDescriptor, gDatagrams, numDatagrams);
+        cellularPortLog("CELLULAR_SOCK_TEST: %d of %d UDP packet(s) sent in %d ms, now receiving...\n",
+                        x, numDatagrams,
+                        (int32_t) (cellularPortGetTickTimeMs() - startTimeMs));
+        CELLULAR_PORT_TEST_ASSERT(x == numDatagrams - 1);
+        for (size_t y = 0; y < numDatagrams - 1; y++) {
+            CELLULAR_PORT_TEST_ASSERT(gDatagrams[y].result == gDatagrams[y].dataSizeBytes);
+        }
+        CELLULAR_PORT_TEST_ASSERT(gDatagrams[numDatagrams - 1].result == -CELLULAR_SOCK_EINVAL);
+
+        // ...and capture them all again afterwards
+        pDataReceived = (char *) pCellularPort_malloc(sizeof(gSendData) - 1 +
+                                                     (CELLULAR_SOCK_TEST_GUARD_LENGTH_SIZE_BYTES * 2));
+        CELLULAR_PORT_TEST_ASSERT(pDataReceived != NULL);
+        pCellularPort_memset(pDataReceived, CELLULAR_SOCK_TEST_FILL_CHARACTER,
+                             sizeof(gSendData) - 1 + (CELLULAR_SOCK_TEST_GUARD_LENGTH_SIZE_BYTES * 2));
+        startTimeMs = cellularPortGetTickTimeMs();
+        offset = 0;
+        for (x = 0; (offset < sizeof(gSendData) - 1) &&
+                    (cellularPortGetTickTimeMs() - startTimeMs < 10000); x++) {
+            sizeBytes = cellularSockReceiveFrom(sockDescriptor, NULL,
+                                                pDataReceived + offset +
+                                                CELLULAR_SOCK_TEST_GUARD_LENGTH_SIZE_BYTES,
+                                                sizeof(gSendData) - 1 - offset);
+            if (sizeBytes > 0) {
+                offset += sizeBytes;
+            }
+        }
+        sizeBytes = offset;
+        cellularPortLog("CELLULAR_SOCK_TEST: either received everything back or timed out waiting.\n");
+
+        // Check that we reassembled everything correctly
+        allPacketsReceived = checkAgainstSentData(gSendData, sizeof(gSendData) - 1,
+                                                  pDataReceived, sizeBytes);
+        cellularPort_free(pDataReceived);
+        tries++;
+    } while (!allPacketsReceived && (tries < CELLULAR_CFG_TEST_UDP_RETRIES));
+
+    CELLULAR_PORT_TEST_ASSERT(allPacketsReceived);
+
+    stdDataTestDeinit(sockDescriptor);
+}
+
 /** UDP echo test that does asynchronous receive.
  */
 CELLULAR_PORT_TEST_FUNCTION(void cellularSockTestUdpEchoAsyncMayMayFailDueToInternetDatagramDrop(),
@@ -2451,6 +3132,103 @@ CELLULAR_PORT_TEST_FUNCTION(void cellularSockTestTcpEchoAsync(),
     stdDataTestDeinit(params.sockDescriptor);
 }
 
+/** Check that a receive blocked on one socket, with a second
+ * receive waiting behind it on the same socket, doesn't hold up
+ * calls on another socket.
+ */
+CELLULAR_PORT_TEST_FUNCTION(void cellularSockTestBlockedReceive(),
+                            "sockBlockedReceive",
+                            "sock")
+{
+    CellularSockAddress_t remoteAddress;
+    CellularSockDescriptor_t sockDescriptor;
+    CellularSockDescriptor_t sockDescriptorOther;
+    CellularPortTaskHandle_t taskHandle;
+    CellularPort_timeval timeout;
+    size_t length = sizeof(timeout);
+    int64_t startTimeMs;
+    int32_t sizeBytes;
+    int32_t errorCode;
+
+    // Call clean up to release OS resources that may
+    // have been left hanging by a previous failed test
+    osCleanup();
+
+    stdDataTestInit(CELLULAR_CFG_TEST_ECHO_TCP_SERVER_DOMAIN_NAME,
+                    CELLULAR_CFG_TEST_ECHO_TCP_SERVER_PORT,
+                    &remoteAddress,
+                    CELLULAR_SOCK_TYPE_STREAM,
+                    CELLULAR_SOCK_PROTOCOL_TCP,
+                    &sockDescriptor);
+
+    cellularPortLog("CELLULAR_SOCK_TEST: connect socket to \"%s:%d\"...\n",
+                    CELLULAR_CFG_TEST_ECHO_TCP_SERVER_DOMAIN_NAME,
+                    CELLULAR_CFG_TEST_ECHO_TCP_SERVER_PORT);
+    errorCode = cellularSockConnect(sockDescriptor, &remoteAddress);
+    cellularPortLog("CELLULAR_SOCK_TEST: cellularSockConnect() returned %d, errno %d.\n",
+                    errorCode, cellularPort_errno_get());
+    CELLULAR_PORT_TEST_ASSERT(errorCode == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPort_errno_get() == 0);
+
+    timeout.tv_sec = CELLULAR_SOCK_TEST_BLOCKED_RECEIVE_TIMEOUT_MS / 1000;
+    timeout.tv_usec = 0;
+    CELLULAR_PORT_TEST_ASSERT(cellularSockSetOption(sockDescriptor,
+                                                    CELLULAR_SOCK_OPT_LEVEL_SOCK,
+                                                    CELLULAR_SOCK_OPT_RCVTIMEO,
+                                                    &timeout, sizeof(timeout)) == 0);
+
+    sockDescriptorOther = cellularSockCreate(CELLULAR_SOCK_TYPE_STREAM,
+                                             CELLULAR_SOCK_PROTOCOL_TCP);
+    CELLULAR_PORT_TEST_ASSERT(sockDescriptorOther >= 0);
+
+    // A queue on which the tasks send the outcome of their reads
+    CELLULAR_PORT_TEST_ASSERT(cellularPortQueueCreate(CELLULAR_SOCK_TEST_RECEIVE_QUEUE_LENGTH,
+                                                      sizeof(int32_t),
+                                                      &gQueueHandleDataReceived) == 0);
+
+    // Two tasks reading the first socket, which has nothing
+    // to read, the second waiting for the first
+    cellularPortLog("CELLULAR_SOCK_TEST: blocking two reads on the first socket...\n");
+    for (size_t x = 0; x < 2; x++) {
+        CELLULAR_PORT_TEST_ASSERT(cellularPortTaskCreate(blockedReceiveTaskTcp,
+                                                         "testTaskBlockedRx",
+                                                         CELLULAR_PORT_TEST_SOCK_TASK_STACK_SIZE_BYTES,
+                                                         (void *) &sockDescriptor,
+                                                         CELLULAR_PORT_TEST_SOCK_TASK_PRIORITY,
+                                                         &taskHandle) == 0);
+    }
+    cellularPortTaskBlock(1000);
+
+    // A call on the other socket must not wait for them
+    startTimeMs = cellularPortGetTickTimeMs();
+    errorCode = cellularSockGetOption(sockDescriptorOther,
+                                      CELLULAR_SOCK_OPT_LEVEL_SOCK,
+                                      CELLULAR_SOCK_OPT_RCVTIMEO,
+                                      &timeout, &length);
+    cellularPortLog("CELLULAR_SOCK_TEST: cellularSockGetOption() on the other socket"
+                    " returned %d after %d ms.\n", errorCode,
+                    (int32_t) (cellularPortGetTickTimeMs() - startTimeMs));
+    CELLULAR_PORT_TEST_ASSERT(errorCode == 0);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortGetTickTimeMs() - startTimeMs <
+                              CELLULAR_SOCK_TEST_BLOCKED_RECEIVE_TIMEOUT_MS / 2);
+
+    // Both reads should time out
+    for (size_t x = 0; x < 2; x++) {
+        CELLULAR_PORT_TEST_ASSERT(cellularPortQueueTryReceive(gQueueHandleDataReceived,
+                                                              CELLULAR_SOCK_TEST_BLOCKED_RECEIVE_TIMEOUT_MS * 3,
+                                                              &sizeBytes) == 0);
+        CELLULAR_PORT_TEST_ASSERT(sizeBytes < 0);
+    }
+    // Let the tasks finish deleting themselves
+    cellularPortTaskBlock(100);
+    CELLULAR_PORT_TEST_ASSERT(cellularPortQueueDelete(gQueueHandleDataReceived) == 0);
+    gQueueHandleDataReceived = NULL;
+    cellularPort_errno_set(0);
+
+    CELLULAR_PORT_TEST_ASSERT(cellularSockClose(sockDescriptorOther) == 0);
+    stdDataTestDeinit(sockDescriptor);
+}
+
 /** Clean-up to be run at the end of this round of tests, just
  * in case there were test failures which would have resulted
  * in the deinitialisation being skipped.